@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+#
+# bench-import.py: Time the import of recorded blocks into metrixd.
+#
+# Copyright (c) 2021 The Metrix Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#
+
+import argparse
+import json
+import os
+import re
+import shlex
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+CHAIN_ARGS = {'main': [], 'test': ['-testnet'], 'regtest': ['-regtest']}
+CHAIN_DIRS = {'main': '', 'test': 'testnet1', 'regtest': 'regtest'}
+
+# "  - Connect total: 1.23ms [4.56s (7.89ms/blk)]", the bracket holds the total of the run so far
+BENCH_LINE = re.compile(r'^\S+\s+(?:- )?([A-Za-z][^:]*): [0-9.]+ms[^\[\n]*\[([0-9.]+)s')
+UPDATE_TIP = re.compile(r'UpdateTip: new best=\S+ height=(\d+)')
+
+
+def node_args(settings, datadir, blockfiles, extra_args):
+    args = [settings.metrixd, '-datadir=' + datadir] + CHAIN_ARGS[settings.chain]
+    args += ['-listen=0', '-connect=0', '-dnsseed=0', '-server=0', '-printtoconsole=0', '-stopafterblockimport']
+    args += ['-loadblock=' + os.path.abspath(f) for f in blockfiles]
+    if settings.bench:
+        args.append('-debug=bench')
+    return args + extra_args
+
+
+def run_node(args):
+    """Run metrixd until it stops, return the wall time in seconds and the peak RSS in MiB"""
+    start = time.time()
+    proc = subprocess.Popen(args, stdout=subprocess.DEVNULL)
+    _, status, rusage = os.wait4(proc.pid, 0)
+    proc.returncode = os.waitstatus_to_exitcode(status) if hasattr(os, 'waitstatus_to_exitcode') else status
+    if proc.returncode != 0:
+        raise RuntimeError('%s exited with status %d' % (args[0], proc.returncode))
+    return time.time() - start, rusage.ru_maxrss / 1024
+
+
+def parse_log(path, offset):
+    """The last height connected and the bench totals per phase, from the debug.log after offset"""
+    height = None
+    phases = {}
+    with open(path, encoding='utf-8', errors='replace') as f:
+        f.seek(offset)
+        for line in f:
+            m = UPDATE_TIP.search(line)
+            if m:
+                height = int(m.group(1))
+                continue
+            m = BENCH_LINE.match(line)
+            if m:
+                phases[re.sub(r'\d+', 'N', m.group(1).strip())] = float(m.group(2))
+    return height, phases
+
+
+def bench(settings, template, extra_args, run):
+    datadir = tempfile.mkdtemp(prefix='bench-import-', dir=settings.tmpdir)
+    try:
+        if template:
+            shutil.rmtree(datadir)
+            shutil.copytree(template, datadir)
+        log_path = os.path.join(datadir, CHAIN_DIRS[settings.chain], 'debug.log')
+        log_offset = os.path.getsize(log_path) if os.path.exists(log_path) else 0
+        start_height, _ = parse_log(log_path, 0) if log_offset else (None, {})
+
+        if settings.reindex:
+            # Import untimed first, then time the reindex of the same blocks
+            run_node(node_args(settings, datadir, settings.blocks, extra_args))
+            log_offset = os.path.getsize(log_path)
+            elapsed, peak_rss = run_node(node_args(settings, datadir, [], ['-reindex'] + extra_args))
+            start_height = None
+        else:
+            elapsed, peak_rss = run_node(node_args(settings, datadir, settings.blocks, extra_args))
+
+        height, phases = parse_log(log_path, log_offset)
+        blocks = (height if height is not None else -1) - (start_height if start_height is not None else -1)
+        return {
+            'args': extra_args,
+            'run': run,
+            'blocks': blocks,
+            'height': height,
+            'seconds': elapsed,
+            'blocks_per_second': blocks / elapsed if elapsed else 0.0,
+            'peak_rss_mib': peak_rss,
+            'phases': phases,
+        }
+    finally:
+        if not settings.keep:
+            shutil.rmtree(datadir, ignore_errors=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Time the import of recorded blocks into metrixd with -loadblock, '
+                                     'for each set of node arguments given with --args.')
+    parser.add_argument('blocks', nargs='+', help='Block files to import, as written by linearize-data.py or blkNNNNN.dat files')
+    parser.add_argument('--metrixd', default=os.getenv('METRIXD', 'metrixd'), help='The metrixd binary (default: $METRIXD or metrixd)')
+    parser.add_argument('--chain', choices=sorted(CHAIN_ARGS), default='main', help='Chain the blocks belong to (default: %(default)s)')
+    parser.add_argument('--args', action='append', dest='arg_sets',
+                        help='Node arguments of one configuration, e.g. --args="-dbcache=1000 -par=4 -logevents". Can be given several times')
+    parser.add_argument('--prefix', action='append', default=[],
+                        help='Block files imported untimed before the measured ones, so a segment of a recorded chain can be replayed')
+    parser.add_argument('--reindex', action='store_true', help='Time a -reindex of the blocks instead of their import')
+    parser.add_argument('--repeat', type=int, default=1, help='Runs of each configuration (default: %(default)s)')
+    parser.add_argument('--nobench', dest='bench', action='store_false', help='Do not log -debug=bench phase timings')
+    parser.add_argument('--tmpdir', help='Directory the data directories are created in')
+    parser.add_argument('--keep', action='store_true', help='Keep the data directories')
+    parser.add_argument('--report', help='Write the results as JSON to this file')
+    settings = parser.parse_args()
+    arg_sets = [shlex.split(s) for s in settings.arg_sets or ['']]
+
+    template = None
+    if settings.prefix:
+        template = tempfile.mkdtemp(prefix='bench-import-prefix-', dir=settings.tmpdir)
+        print('Importing the prefix blocks', file=sys.stderr)
+        prefix_settings = argparse.Namespace(**vars(settings))
+        prefix_settings.bench = False
+        run_node(node_args(prefix_settings, template, settings.prefix, []))
+
+    results = []
+    try:
+        for extra_args in arg_sets:
+            for run in range(settings.repeat):
+                result = bench(settings, template, extra_args, run)
+                results.append(result)
+                print('%-40s run %d: %d blocks in %.1fs, %.1f blocks/s, peak RSS %.0f MiB' %
+                      (' '.join(extra_args) or '(defaults)', run, result['blocks'], result['seconds'],
+                       result['blocks_per_second'], result['peak_rss_mib']))
+                for phase, seconds in sorted(result['phases'].items(), key=lambda item: -item[1]):
+                    print('    %-40s %10.2fs' % (phase, seconds))
+    finally:
+        if template and not settings.keep:
+            shutil.rmtree(template, ignore_errors=True)
+
+    if settings.report:
+        with open(settings.report, 'w', encoding='utf-8') as f:
+            json.dump(results, f, indent=2)
+
+
+if __name__ == '__main__':
+    main()
@@ -1,4 +1,4 @@
-packages:=boost openssl libevent gmp
+packages:=boost openssl libevent gmp zlib
 
 protobuf_native_packages = native_protobuf
 protobuf_packages = protobuf
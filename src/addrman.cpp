@@ -5,9 +5,12 @@
 
 #include <addrman.h>
 
+#include <crypto/siphash.h>
 #include <hash.h>
 #include <serialize.h>
 
+#include <limits>
+
 int CAddrInfo::GetTriedBucket(const uint256& nKey) const
 {
     uint64_t hash1 = (CHashWriter(SER_GETHASH, 0) << nKey << GetKey()).GetCheapHash();
@@ -64,29 +67,46 @@ double CAddrInfo::GetChance(int64_t nNow) const
     return fChance;
 }
 
+CAddrHasher::CAddrHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+size_t CAddrHasher::operator()(const CNetAddr& addr) const
+{
+    unsigned char ip[16];
+    for (int n = 0; n < 16; n++) {
+        ip[n] = addr.GetByte(15 - n);
+    }
+    return CSipHasher(k0, k1).Write(ip, sizeof(ip)).Finalize();
+}
+
 CAddrInfo* CAddrMan::Find(const CNetAddr& addr, int* pnId)
 {
-    std::map<CNetAddr, int>::iterator it = mapAddr.find(addr);
+    auto it = mapAddr.find(addr);
     if (it == mapAddr.end())
         return nullptr;
     if (pnId)
         *pnId = (*it).second;
-    std::map<int, CAddrInfo>::iterator it2 = mapInfo.find((*it).second);
-    if (it2 != mapInfo.end())
-        return &(*it2).second;
+    if (IsUsed((*it).second))
+        return &vInfo[(*it).second];
     return nullptr;
 }
 
 CAddrInfo* CAddrMan::Create(const CAddress& addr, const CNetAddr& addrSource, int* pnId)
 {
-    int nId = nIdCount++;
-    mapInfo[nId] = CAddrInfo(addr, addrSource);
+    int nId;
+    if (vFreeIds.empty()) {
+        nId = vInfo.size();
+        vInfo.emplace_back(addr, addrSource);
+    } else {
+        nId = vFreeIds.back();
+        vFreeIds.pop_back();
+        vInfo[nId] = CAddrInfo(addr, addrSource);
+    }
     mapAddr[addr] = nId;
-    mapInfo[nId].nRandomPos = vRandom.size();
+    vInfo[nId].nRandomPos = vRandom.size();
     vRandom.push_back(nId);
     if (pnId)
         *pnId = nId;
-    return &mapInfo[nId];
+    return &vInfo[nId];
 }
 
 void CAddrMan::SwapRandom(unsigned int nRndPos1, unsigned int nRndPos2)
@@ -99,11 +119,11 @@ void CAddrMan::SwapRandom(unsigned int nRndPos1, unsigned int nRndPos2)
     int nId1 = vRandom[nRndPos1];
     int nId2 = vRandom[nRndPos2];
 
-    assert(mapInfo.count(nId1) == 1);
-    assert(mapInfo.count(nId2) == 1);
+    assert(IsUsed(nId1));
+    assert(IsUsed(nId2));
 
-    mapInfo[nId1].nRandomPos = nRndPos2;
-    mapInfo[nId2].nRandomPos = nRndPos1;
+    vInfo[nId1].nRandomPos = nRndPos2;
+    vInfo[nId2].nRandomPos = nRndPos1;
 
     vRandom[nRndPos1] = nId2;
     vRandom[nRndPos2] = nId1;
@@ -111,15 +131,18 @@ void CAddrMan::SwapRandom(unsigned int nRndPos1, unsigned int nRndPos2)
 
 void CAddrMan::Delete(int nId)
 {
-    assert(mapInfo.count(nId) != 0);
-    CAddrInfo& info = mapInfo[nId];
+    assert(IsUsed(nId));
+    CAddrInfo& info = vInfo[nId];
     assert(!info.fInTried);
     assert(info.nRefCount == 0);
 
     SwapRandom(info.nRandomPos, vRandom.size() - 1);
     vRandom.pop_back();
     mapAddr.erase(info);
-    mapInfo.erase(nId);
+    // the slot is reused by the next entry created, drop the last reference to it
+    m_tried_collisions.erase(nId);
+    info = CAddrInfo();
+    vFreeIds.push_back(nId);
     nNew--;
 }
 
@@ -128,7 +151,7 @@ void CAddrMan::ClearNew(int nUBucket, int nUBucketPos)
     // if there is an entry in the specified bucket, delete it.
     if (vvNew[nUBucket][nUBucketPos] != -1) {
         int nIdDelete = vvNew[nUBucket][nUBucketPos];
-        CAddrInfo& infoDelete = mapInfo[nIdDelete];
+        CAddrInfo& infoDelete = vInfo[nIdDelete];
         assert(infoDelete.nRefCount > 0);
         infoDelete.nRefCount--;
         vvNew[nUBucket][nUBucketPos] = -1;
@@ -140,8 +163,8 @@ void CAddrMan::ClearNew(int nUBucket, int nUBucketPos)
 
 void CAddrMan::MakeTried(CAddrInfo& info, int nId)
 {
-    // remove the entry from all new buckets
-    for (int bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; bucket++) {
+    // remove the entry from all new buckets, nRefCount of them hold it
+    for (int bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT && info.nRefCount > 0; bucket++) {
         int pos = info.GetBucketPosition(nKey, true, bucket);
         if (vvNew[bucket][pos] == nId) {
             vvNew[bucket][pos] = -1;
@@ -160,8 +183,8 @@ void CAddrMan::MakeTried(CAddrInfo& info, int nId)
     if (vvTried[nKBucket][nKBucketPos] != -1) {
         // find an item to evict
         int nIdEvict = vvTried[nKBucket][nKBucketPos];
-        assert(mapInfo.count(nIdEvict) == 1);
-        CAddrInfo& infoOld = mapInfo[nIdEvict];
+        assert(IsUsed(nIdEvict));
+        CAddrInfo& infoOld = vInfo[nIdEvict];
 
         // Remove the to-be-evicted item from the tried set.
         infoOld.fInTried = false;
@@ -215,21 +238,10 @@ void CAddrMan::Good_(const CService& addr, bool test_before_evict, int64_t nTime
     if (info.fInTried)
         return;
 
-    // find a bucket it is in now
-    int nRnd = insecure_rand.randrange(ADDRMAN_NEW_BUCKET_COUNT);
-    int nUBucket = -1;
-    for (unsigned int n = 0; n < ADDRMAN_NEW_BUCKET_COUNT; n++) {
-        int nB = (n + nRnd) % ADDRMAN_NEW_BUCKET_COUNT;
-        int nBpos = info.GetBucketPosition(nKey, true, nB);
-        if (vvNew[nB][nBpos] == nId) {
-            nUBucket = nB;
-            break;
-        }
-    }
-
-    // if no bucket is found, something bad happened;
+    // an entry of the new table is held by nRefCount of its buckets, if it is in none
+    // something bad happened;
     // TODO: maybe re-add the node, but for now, just bail out
-    if (nUBucket == -1)
+    if (info.nRefCount == 0)
         return;
 
     // which tried bucket to move the entry to
@@ -239,8 +251,8 @@ void CAddrMan::Good_(const CService& addr, bool test_before_evict, int64_t nTime
     // Will moving this address into tried evict another entry?
     if (test_before_evict && (vvTried[tried_bucket][tried_bucket_pos] != -1)) {
         // Output the entry we'd be colliding with, for debugging purposes
-        auto colliding_entry = mapInfo.find(vvTried[tried_bucket][tried_bucket_pos]);
-        LogPrint(BCLog::ADDRMAN, "Collision inserting element into tried table (%s), moving %s to m_tried_collisions=%d\n", colliding_entry != mapInfo.end() ? colliding_entry->second.ToString() : "", addr.ToString(), m_tried_collisions.size());
+        int colliding_id = vvTried[tried_bucket][tried_bucket_pos];
+        LogPrint(BCLog::ADDRMAN, "Collision inserting element into tried table (%s), moving %s to m_tried_collisions=%d\n", IsUsed(colliding_id) ? vInfo[colliding_id].ToString() : "", addr.ToString(), m_tried_collisions.size());
         if (m_tried_collisions.size() < ADDRMAN_SET_TRIED_COLLISION_SIZE) {
             m_tried_collisions.insert(nId);
         }
@@ -306,7 +318,7 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
     if (vvNew[nUBucket][nUBucketPos] != nId) {
         bool fInsert = vvNew[nUBucket][nUBucketPos] == -1;
         if (!fInsert) {
-            CAddrInfo& infoExisting = mapInfo[vvNew[nUBucket][nUBucketPos]];
+            CAddrInfo& infoExisting = vInfo[vvNew[nUBucket][nUBucketPos]];
             if (infoExisting.IsTerrible() || (infoExisting.nRefCount > 1 && pinfo->nRefCount == 0)) {
                 // Overwrite the existing new table entry.
                 fInsert = true;
@@ -368,8 +380,8 @@ CAddrInfo CAddrMan::Select_(bool newOnly)
                 nKBucketPos = (nKBucketPos + insecure_rand.randbits(ADDRMAN_BUCKET_SIZE_LOG2)) % ADDRMAN_BUCKET_SIZE;
             }
             int nId = vvTried[nKBucket][nKBucketPos];
-            assert(mapInfo.count(nId) == 1);
-            CAddrInfo& info = mapInfo[nId];
+            assert(IsUsed(nId));
+            CAddrInfo& info = vInfo[nId];
             if (insecure_rand.randbits(30) < fChanceFactor * info.GetChance() * (1 << 30))
                 return info;
             fChanceFactor *= 1.2;
@@ -385,8 +397,8 @@ CAddrInfo CAddrMan::Select_(bool newOnly)
                 nUBucketPos = (nUBucketPos + insecure_rand.randbits(ADDRMAN_BUCKET_SIZE_LOG2)) % ADDRMAN_BUCKET_SIZE;
             }
             int nId = vvNew[nUBucket][nUBucketPos];
-            assert(mapInfo.count(nId) == 1);
-            CAddrInfo& info = mapInfo[nId];
+            assert(IsUsed(nId));
+            CAddrInfo& info = vInfo[nId];
             if (insecure_rand.randbits(30) < fChanceFactor * info.GetChance() * (1 << 30))
                 return info;
             fChanceFactor *= 1.2;
@@ -403,9 +415,10 @@ int CAddrMan::Check_()
     if (vRandom.size() != (size_t)(nTried + nNew))
         return -7;
 
-    for (const auto& entry : mapInfo) {
-        int n = entry.first;
-        const CAddrInfo& info = entry.second;
+    for (int n = 0; n < (int)vInfo.size(); n++) {
+        if (!IsUsed(n))
+            continue;
+        const CAddrInfo& info = vInfo[n];
         if (info.fInTried) {
             if (!info.nLastSuccess)
                 return -1;
@@ -439,9 +452,9 @@ int CAddrMan::Check_()
              if (vvTried[n][i] != -1) {
                  if (!setTried.count(vvTried[n][i]))
                      return -11;
-                 if (mapInfo[vvTried[n][i]].GetTriedBucket(nKey) != n)
+                 if (vInfo[vvTried[n][i]].GetTriedBucket(nKey) != n)
                      return -17;
-                 if (mapInfo[vvTried[n][i]].GetBucketPosition(nKey, false, n) != i)
+                 if (vInfo[vvTried[n][i]].GetBucketPosition(nKey, false, n) != i)
                      return -18;
                  setTried.erase(vvTried[n][i]);
              }
@@ -453,7 +466,7 @@ int CAddrMan::Check_()
             if (vvNew[n][i] != -1) {
                 if (!mapNew.count(vvNew[n][i]))
                     return -12;
-                if (mapInfo[vvNew[n][i]].GetBucketPosition(nKey, true, n) != i)
+                if (vInfo[vvNew[n][i]].GetBucketPosition(nKey, true, n) != i)
                     return -19;
                 if (--mapNew[vvNew[n][i]] == 0)
                     mapNew.erase(vvNew[n][i]);
@@ -485,9 +498,9 @@ void CAddrMan::GetAddr_(std::vector<CAddress>& vAddr)
 
         int nRndPos = insecure_rand.randrange(vRandom.size() - n) + n;
         SwapRandom(n, nRndPos);
-        assert(mapInfo.count(vRandom[n]) == 1);
+        assert(IsUsed(vRandom[n]));
 
-        const CAddrInfo& ai = mapInfo[vRandom[n]];
+        const CAddrInfo& ai = vInfo[vRandom[n]];
         if (!ai.IsTerrible())
             vAddr.push_back(ai);
     }
@@ -538,11 +551,11 @@ void CAddrMan::ResolveCollisions_()
 
         bool erase_collision = false;
 
-        // If id_new not found in mapInfo remove it from m_tried_collisions
-        if (mapInfo.count(id_new) != 1) {
+        // If id_new not found in vInfo remove it from m_tried_collisions
+        if (!IsUsed(id_new)) {
             erase_collision = true;
         } else {
-            CAddrInfo& info_new = mapInfo[id_new];
+            CAddrInfo& info_new = vInfo[id_new];
 
             // Which tried bucket to move the entry to.
             int tried_bucket = info_new.GetTriedBucket(nKey);
@@ -553,7 +566,7 @@ void CAddrMan::ResolveCollisions_()
 
                 // Get the to-be-evicted address that is being tested
                 int id_old = vvTried[tried_bucket][tried_bucket_pos];
-                CAddrInfo& info_old = mapInfo[id_old];
+                CAddrInfo& info_old = vInfo[id_old];
 
                 // Has successfully connected in last X hours
                 if (GetAdjustedTime() - info_old.nLastSuccess < ADDRMAN_REPLACEMENT_HOURS*(60*60)) {
@@ -600,19 +613,20 @@ CAddrInfo CAddrMan::SelectTriedCollision_()
     std::advance(it, insecure_rand.randrange(m_tried_collisions.size()));
     int id_new = *it;
 
-    // If id_new not found in mapInfo remove it from m_tried_collisions
-    if (mapInfo.count(id_new) != 1) {
+    // If id_new not found in vInfo remove it from m_tried_collisions
+    if (!IsUsed(id_new)) {
         m_tried_collisions.erase(it);
         return CAddrInfo();
     }
 
-    CAddrInfo& newInfo = mapInfo[id_new];
+    CAddrInfo& newInfo = vInfo[id_new];
 
     // which tried bucket to move the entry to
     int tried_bucket = newInfo.GetTriedBucket(nKey);
     int tried_bucket_pos = newInfo.GetBucketPosition(nKey, false, tried_bucket);
 
     int id_old = vvTried[tried_bucket][tried_bucket_pos];
+    if (id_old == -1) return CAddrInfo();
 
-    return mapInfo[id_old];
+    return vInfo[id_old];
 }
@@ -16,6 +16,7 @@
 #include <map>
 #include <set>
 #include <stdint.h>
+#include <unordered_map>
 #include <vector>
 
 /**
@@ -169,6 +170,18 @@ public:
 //! the maximum time we'll spend trying to resolve a tried table collision, in seconds
 static const int64_t ADDRMAN_TEST_WINDOW = 40*60; // 40 minutes
 
+/** Salted SipHash of the address bytes, the key of the entries of an address manager. */
+class CAddrHasher
+{
+private:
+    const uint64_t k0, k1;
+
+public:
+    CAddrHasher();
+
+    size_t operator()(const CNetAddr& addr) const;
+};
+
 /**
  * Stochastical (IP) address manager
  */
@@ -179,14 +192,15 @@ protected:
     mutable CCriticalSection cs;
 
 private:
-    //! last used nId
-    int nIdCount GUARDED_BY(cs);
+    //! information about all nIds, indexed by nId. Slots of deleted entries are
+    //! kept with nRandomPos -1 and reused by the next entries created.
+    std::vector<CAddrInfo> vInfo GUARDED_BY(cs);
 
-    //! table with information about all nIds
-    std::map<int, CAddrInfo> mapInfo GUARDED_BY(cs);
+    //! nIds of the unused slots in vInfo
+    std::vector<int> vFreeIds GUARDED_BY(cs);
 
     //! find an nId based on its network address
-    std::map<CNetAddr, int> mapAddr GUARDED_BY(cs);
+    std::unordered_map<CNetAddr, int, CAddrHasher> mapAddr GUARDED_BY(cs);
 
     //! randomly-ordered vector of all nIds
     std::vector<int> vRandom GUARDED_BY(cs);
@@ -209,6 +223,12 @@ private:
     //! Holds addrs inserted into tried table that collide with existing entries. Test-before-evict discipline used to resolve these collisions.
     std::set<int> m_tried_collisions;
 
+    //! Whether nId refers to an entry of vInfo.
+    bool IsUsed(int nId) const EXCLUSIVE_LOCKS_REQUIRED(cs)
+    {
+        return nId >= 0 && (size_t)nId < vInfo.size() && vInfo[nId].nRandomPos != -1;
+    }
+
 protected:
     //! secret key to randomize bucket select with
     uint256 nKey;
@@ -311,11 +331,12 @@ public:
 
         int nUBuckets = ADDRMAN_NEW_BUCKET_COUNT ^ (1 << 30);
         s << nUBuckets;
-        std::map<int, int> mapUnkIds;
+        std::vector<int> mapUnkIds(vInfo.size(), -1);
         int nIds = 0;
-        for (const auto& entry : mapInfo) {
-            mapUnkIds[entry.first] = nIds;
-            const CAddrInfo &info = entry.second;
+        for (size_t n = 0; n < vInfo.size(); n++) {
+            if (!IsUsed(n)) continue;
+            mapUnkIds[n] = nIds;
+            const CAddrInfo &info = vInfo[n];
             if (info.nRefCount) {
                 assert(nIds != nNew); // this means nNew was wrong, oh ow
                 s << info;
@@ -323,8 +344,9 @@ public:
             }
         }
         nIds = 0;
-        for (const auto& entry : mapInfo) {
-            const CAddrInfo &info = entry.second;
+        for (size_t n = 0; n < vInfo.size(); n++) {
+            if (!IsUsed(n)) continue;
+            const CAddrInfo &info = vInfo[n];
             if (info.fInTried) {
                 assert(nIds != nTried); // this means nTried was wrong, oh ow
                 s << info;
@@ -377,8 +399,9 @@ public:
         }
 
         // Deserialize entries from the new table.
+        vInfo.resize(nNew);
         for (int n = 0; n < nNew; n++) {
-            CAddrInfo &info = mapInfo[n];
+            CAddrInfo &info = vInfo[n];
             s >> info;
             mapAddr[info] = n;
             info.nRandomPos = vRandom.size();
@@ -394,7 +417,6 @@ public:
                 }
             }
         }
-        nIdCount = nNew;
 
         // Deserialize entries from the tried table.
         int nLost = 0;
@@ -404,13 +426,13 @@ public:
             int nKBucket = info.GetTriedBucket(nKey);
             int nKBucketPos = info.GetBucketPosition(nKey, false, nKBucket);
             if (vvTried[nKBucket][nKBucketPos] == -1) {
+                int nId = vInfo.size();
                 info.nRandomPos = vRandom.size();
                 info.fInTried = true;
-                vRandom.push_back(nIdCount);
-                mapInfo[nIdCount] = info;
-                mapAddr[info] = nIdCount;
-                vvTried[nKBucket][nKBucketPos] = nIdCount;
-                nIdCount++;
+                vRandom.push_back(nId);
+                vInfo.push_back(info);
+                mapAddr[info] = nId;
+                vvTried[nKBucket][nKBucketPos] = nId;
             } else {
                 nLost++;
             }
@@ -425,7 +447,7 @@ public:
                 int nIndex = 0;
                 s >> nIndex;
                 if (nIndex >= 0 && nIndex < nNew) {
-                    CAddrInfo &info = mapInfo[nIndex];
+                    CAddrInfo &info = vInfo[nIndex];
                     int nUBucketPos = info.GetBucketPosition(nKey, true, bucket);
                     if (nVersion == 1 && nUBuckets == ADDRMAN_NEW_BUCKET_COUNT && vvNew[bucket][nUBucketPos] == -1 && info.nRefCount < ADDRMAN_NEW_BUCKETS_PER_ADDRESS) {
                         info.nRefCount++;
@@ -437,13 +459,10 @@ public:
 
         // Prune new entries with refcount 0 (as a result of collisions).
         int nLostUnk = 0;
-        for (std::map<int, CAddrInfo>::const_iterator it = mapInfo.begin(); it != mapInfo.end(); ) {
-            if (it->second.fInTried == false && it->second.nRefCount == 0) {
-                std::map<int, CAddrInfo>::const_iterator itCopy = it++;
-                Delete(itCopy->first);
+        for (int n = 0; n < (int)vInfo.size(); n++) {
+            if (IsUsed(n) && vInfo[n].fInTried == false && vInfo[n].nRefCount == 0) {
+                Delete(n);
                 nLostUnk++;
-            } else {
-                it++;
             }
         }
         if (nLost + nLostUnk > 0) {
@@ -469,12 +488,13 @@ public:
             }
         }
 
-        nIdCount = 0;
         nTried = 0;
         nNew = 0;
         nLastGood = 1; //Initially at 1 so that "never" is strictly worse.
-        mapInfo.clear();
+        vInfo.clear();
+        vFreeIds.clear();
         mapAddr.clear();
+        m_tried_collisions.clear();
     }
 
     CAddrMan()
@@ -0,0 +1,93 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <libff/algebra/curves/alt_bn128/alt_bn128_pp.hpp>
+#include <libff/algebra/scalar_multiplication/multiexp.hpp>
+
+#include <vector>
+
+// The alt_bn128 operations behind the ecadd, ecmul and ecpairing precompiles, as libff runs them.
+// The field arithmetic uses the x86-64 assembly of libff when it is built with USE_ASM.
+
+static const size_t MUL_BATCH = 16;
+
+static void InitAltBn128()
+{
+    static bool initialized = false;
+    if (!initialized) {
+        libff::inhibit_profiling_info = true;
+        libff::inhibit_profiling_counters = true;
+        libff::alt_bn128_pp::init_public_params();
+        initialized = true;
+    }
+}
+
+static void AltBn128Add(benchmark::State& state)
+{
+    InitAltBn128();
+    libff::alt_bn128_G1 p = libff::alt_bn128_G1::random_element();
+    const libff::alt_bn128_G1 q = libff::alt_bn128_G1::random_element();
+    while (state.KeepRunning()) {
+        p = p + q;
+    }
+}
+
+// One ecmul per point, the way a contract summing scalar products calls the precompile
+static void AltBn128MulSeparate(benchmark::State& state)
+{
+    InitAltBn128();
+    std::vector<libff::alt_bn128_G1> points(MUL_BATCH);
+    std::vector<libff::alt_bn128_Fr> scalars(MUL_BATCH);
+    for (size_t i = 0; i < MUL_BATCH; i++) {
+        points[i] = libff::alt_bn128_G1::random_element();
+        scalars[i] = libff::alt_bn128_Fr::random_element();
+    }
+    while (state.KeepRunning()) {
+        libff::alt_bn128_G1 sum = libff::alt_bn128_G1::zero();
+        for (size_t i = 0; i < MUL_BATCH; i++) {
+            sum = sum + scalars[i] * points[i];
+        }
+        sum.to_affine_coordinates();
+    }
+}
+
+// The same sum as one multi-scalar multiplication
+static void AltBn128MulBatched(benchmark::State& state)
+{
+    InitAltBn128();
+    std::vector<libff::alt_bn128_G1> points(MUL_BATCH);
+    std::vector<libff::alt_bn128_Fr> scalars(MUL_BATCH);
+    for (size_t i = 0; i < MUL_BATCH; i++) {
+        points[i] = libff::alt_bn128_G1::random_element();
+        scalars[i] = libff::alt_bn128_Fr::random_element();
+    }
+    while (state.KeepRunning()) {
+        libff::alt_bn128_G1 sum = libff::multi_exp<libff::alt_bn128_G1, libff::alt_bn128_Fr, libff::multi_exp_method_bos_coster>(
+            points.cbegin(), points.cend(), scalars.cbegin(), scalars.cend(), 1);
+        sum.to_affine_coordinates();
+    }
+}
+
+// A two pair ecpairing check, with a single final exponentiation
+static void AltBn128Pairing(benchmark::State& state)
+{
+    InitAltBn128();
+    const libff::alt_bn128_G1 p1 = libff::alt_bn128_G1::random_element();
+    const libff::alt_bn128_G2 q1 = libff::alt_bn128_G2::random_element();
+    const libff::alt_bn128_G1 p2 = libff::alt_bn128_G1::random_element();
+    const libff::alt_bn128_G2 q2 = libff::alt_bn128_G2::random_element();
+    while (state.KeepRunning()) {
+        libff::alt_bn128_Fq12 f = libff::alt_bn128_pp::double_miller_loop(
+            libff::alt_bn128_pp::precompute_G1(p1), libff::alt_bn128_pp::precompute_G2(q1),
+            libff::alt_bn128_pp::precompute_G1(p2), libff::alt_bn128_pp::precompute_G2(q2));
+        libff::alt_bn128_pp::final_exponentiation(f);
+    }
+}
+
+BENCHMARK(AltBn128Add, 500000);
+BENCHMARK(AltBn128MulSeparate, 200);
+BENCHMARK(AltBn128MulBatched, 500);
+BENCHMARK(AltBn128Pairing, 100);
@@ -20,7 +20,7 @@ static const unsigned int QUEUE_BATCH_SIZE = 128;
 // This Benchmark tests the CheckQueue with a slightly realistic workload,
 // where checks all contain a prevector that is indirect 50% of the time
 // and there is a little bit of work done between calls to Add.
-static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
+static void RunCCheckQueueSpeedPrevectorJob(benchmark::State& state, int threads)
 {
     struct PrevectorJob {
         prevector<PREVECTOR_SIZE, uint8_t> p;
@@ -37,7 +37,7 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     };
     CCheckQueue<PrevectorJob> queue {QUEUE_BATCH_SIZE};
     boost::thread_group tg;
-    for (auto x = 0; x < std::max(MIN_CORES, GetNumCores()); ++x) {
+    for (auto x = 0; x < threads; ++x) {
        tg.create_thread([&]{queue.Thread();});
     }
     while (state.KeepRunning()) {
@@ -58,4 +58,23 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     tg.interrupt_all();
     tg.join_all();
 }
+
+static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
+{
+    RunCCheckQueueSpeedPrevectorJob(state, std::max(MIN_CORES, GetNumCores()));
+}
+
+// The same workload with the worker counts of -par=16 and above, whatever the cores of the machine
+static void CCheckQueueSpeedPrevectorJob16(benchmark::State& state)
+{
+    RunCCheckQueueSpeedPrevectorJob(state, 16);
+}
+
+static void CCheckQueueSpeedPrevectorJob32(benchmark::State& state)
+{
+    RunCCheckQueueSpeedPrevectorJob(state, 32);
+}
+
 BENCHMARK(CCheckQueueSpeedPrevectorJob, 1400);
+BENCHMARK(CCheckQueueSpeedPrevectorJob16, 1400);
+BENCHMARK(CCheckQueueSpeedPrevectorJob32, 1400);
@@ -59,6 +59,53 @@ static void SHA256D64_1024(benchmark::State& state)
     }
 }
 
+/** 1024 messages the size of a typical transaction, hashed one at a time */
+static void SHA256D_1024x250(benchmark::State& state)
+{
+    std::vector<uint8_t> in(250 * 1024, 0);
+    std::vector<uint8_t> out(32 * 1024);
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < 1024; ++i) {
+            CHash256().Write(in.data() + 250 * i, 250).Finalize(out.data() + 32 * i);
+        }
+    }
+}
+
+/** The same messages hashed together */
+static void SHA256DMany_1024x250(benchmark::State& state)
+{
+    std::vector<uint8_t> in(250 * 1024, 0);
+    std::vector<uint8_t> out(32 * 1024);
+    std::vector<const unsigned char*> inputs;
+    for (size_t i = 0; i < 1024; ++i) {
+        inputs.push_back(in.data() + 250 * i);
+    }
+    const std::vector<size_t> lengths(1024, 250);
+    while (state.KeepRunning()) {
+        SHA256DMany(out.data(), inputs.data(), lengths.data(), 1024);
+    }
+}
+
+/** 1024 stake kernels, each 12 bytes continuing the precomputed first block of its preimage */
+static void SHA256DMany_1024Kernels(benchmark::State& state)
+{
+    std::vector<uint8_t> prefix(64, 1);
+    std::vector<CSHA256> prefixes(1024);
+    for (CSHA256& sha : prefixes) {
+        sha.Write(prefix.data(), prefix.size());
+    }
+    std::vector<uint8_t> in(12 * 1024, 0);
+    std::vector<uint8_t> out(32 * 1024);
+    std::vector<const unsigned char*> inputs;
+    for (size_t i = 0; i < 1024; ++i) {
+        inputs.push_back(in.data() + 12 * i);
+    }
+    const std::vector<size_t> lengths(1024, 12);
+    while (state.KeepRunning()) {
+        SHA256DMany(out.data(), prefixes.data(), inputs.data(), lengths.data(), 1024);
+    }
+}
+
 static void SHA512(benchmark::State& state)
 {
     uint8_t hash[CSHA512::OUTPUT_SIZE];
@@ -100,5 +147,8 @@ BENCHMARK(SHA512, 330);
 BENCHMARK(SHA256_32b, 4700 * 1000);
 BENCHMARK(SipHash_32b, 40 * 1000 * 1000);
 BENCHMARK(SHA256D64_1024, 7400);
+BENCHMARK(SHA256D_1024x250, 1500);
+BENCHMARK(SHA256DMany_1024x250, 4400);
+BENCHMARK(SHA256DMany_1024Kernels, 11000);
 BENCHMARK(FastRandom_32bit, 110 * 1000 * 1000);
 BENCHMARK(FastRandom_1bit, 440 * 1000 * 1000);
@@ -39,5 +39,79 @@ static void MatchGCSFilter(benchmark::State& state)
     }
 }
 
+static GCSFilter::ElementSet WalletScripts(int count)
+{
+    GCSFilter::ElementSet elements;
+    for (int i = 0; i < count; ++i) {
+        GCSFilter::Element element(25);
+        element[0] = 0x76;
+        element[1] = static_cast<unsigned char>(i);
+        element[2] = static_cast<unsigned char>(i >> 8);
+        elements.insert(std::move(element));
+    }
+    return elements;
+}
+
+/** Filters of blocks with a few hundred scripts each, as a rescan reads them */
+static std::vector<GCSFilter> BlockFilters(int count)
+{
+    std::vector<GCSFilter> filters;
+    for (int f = 0; f < count; ++f) {
+        GCSFilter::ElementSet elements;
+        for (int i = 0; i < 200; ++i) {
+            GCSFilter::Element element(25);
+            element[0] = 0xa9;
+            element[1] = static_cast<unsigned char>(i);
+            element[2] = static_cast<unsigned char>(f);
+            element[3] = static_cast<unsigned char>(f >> 8);
+            elements.insert(std::move(element));
+        }
+        filters.emplace_back(GCSFilter::Params(f, f, BASIC_FILTER_P, BASIC_FILTER_M), elements);
+    }
+    return filters;
+}
+
+static void DecodeGCSFilter(benchmark::State& state)
+{
+    GCSFilter filter({0, 0, BASIC_FILTER_P, BASIC_FILTER_M}, WalletScripts(10000));
+
+    while (state.KeepRunning()) {
+        GCSFilter decoded(filter.GetParams(), filter.GetEncoded());
+    }
+}
+
+static void MatchAnyGCSFilterWallet(benchmark::State& state)
+{
+    const GCSFilter::ElementSet wallet = WalletScripts(2000);
+    const std::vector<GCSFilter> filters = BlockFilters(100);
+
+    while (state.KeepRunning()) {
+        for (const GCSFilter& filter : filters) {
+            filter.MatchAny(wallet);
+        }
+    }
+}
+
+static void MatchAllGCSFilterQuery(benchmark::State& state, int n_threads)
+{
+    const GCSFilterQuery query(WalletScripts(2000));
+    const std::vector<GCSFilter> filters = BlockFilters(100);
+    std::vector<const GCSFilter*> filter_ptrs;
+    for (const GCSFilter& filter : filters) {
+        filter_ptrs.push_back(&filter);
+    }
+
+    while (state.KeepRunning()) {
+        query.MatchAll(filter_ptrs, n_threads);
+    }
+}
+
+static void MatchAllGCSFilterQuery1Thread(benchmark::State& state) { MatchAllGCSFilterQuery(state, 1); }
+static void MatchAllGCSFilterQuery4Threads(benchmark::State& state) { MatchAllGCSFilterQuery(state, 4); }
+
 BENCHMARK(ConstructGCSFilter, 1000);
 BENCHMARK(MatchGCSFilter, 50 * 1000);
+BENCHMARK(DecodeGCSFilter, 1000);
+BENCHMARK(MatchAnyGCSFilterWallet, 10);
+BENCHMARK(MatchAllGCSFilterQuery1Thread, 10);
+BENCHMARK(MatchAllGCSFilterQuery4Threads, 10);
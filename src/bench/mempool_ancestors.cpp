@@ -0,0 +1,75 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <policy/policy.h>
+#include <txmempool.h>
+
+#include <vector>
+
+/** Length of the transaction chains, like the contract calls of one sender each spending the change of the last */
+static const size_t CHAIN_LENGTH = 100;
+
+static std::vector<CTransactionRef> MakeChain()
+{
+    std::vector<CTransactionRef> chain;
+    COutPoint prevout;
+    for (size_t i = 0; i < CHAIN_LENGTH; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = prevout;
+        tx.vin[0].scriptSig = CScript() << OP_1;
+        tx.vout.resize(2);
+        tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        tx.vout[0].nValue = 10 * COIN;
+        tx.vout[1].scriptPubKey = CScript() << OP_2 << OP_EQUAL;
+        tx.vout[1].nValue = COIN;
+        chain.push_back(MakeTransactionRef(tx));
+        prevout = COutPoint(chain.back()->GetHash(), 0);
+    }
+    return chain;
+}
+
+static void AddTx(const CTransactionRef& tx, CTxMemPool& pool) EXCLUSIVE_LOCKS_REQUIRED(cs_main, pool.cs)
+{
+    LockPoints lp;
+    pool.addUnchecked(CTxMemPoolEntry(tx, 1000, 0, 1, false, 4, lp));
+}
+
+// Add a chain of transactions parent first, so every addition walks all ancestors, then evict it
+static void MempoolAncestorChain(benchmark::State& state)
+{
+    const std::vector<CTransactionRef> chain = MakeChain();
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+
+    while (state.KeepRunning()) {
+        for (const CTransactionRef& tx : chain) {
+            AddTx(tx, pool);
+        }
+        pool.removeRecursive(*chain.front(), MemPoolRemovalReason::CONFLICT);
+        assert(pool.size() == 0);
+    }
+}
+
+// Add a chain children first and then its root, like a reorg returning the root to the mempool
+static void MempoolReorgChain(benchmark::State& state)
+{
+    const std::vector<CTransactionRef> chain = MakeChain();
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+
+    while (state.KeepRunning()) {
+        for (size_t i = 1; i < chain.size(); i++) {
+            AddTx(chain[i], pool);
+        }
+        AddTx(chain.front(), pool);
+        pool.UpdateTransactionsFromBlock({chain.front()->GetHash()});
+        pool.removeRecursive(*chain.front(), MemPoolRemovalReason::CONFLICT);
+        assert(pool.size() == 0);
+    }
+}
+
+BENCHMARK(MempoolAncestorChain, 50);
+BENCHMARK(MempoolReorgChain, 50);
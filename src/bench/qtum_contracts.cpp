@@ -0,0 +1,249 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <fs.h>
+#include <qtum/qtumDGP.h>
+#include <qtum/qtumstate.h>
+#include <qtum/storageresults.h>
+#include <random.h>
+#include <test/setup_common.h>
+#include <txmempool.h>
+#include <util/convert.h>
+#include <util/strencodings.h>
+#include <validation.h>
+
+#include <vector>
+
+extern std::unique_ptr<QtumState> globalState;
+
+/*
+    contract Token {
+        mapping (address => uint) balances;
+
+        event Transfer(address _from, address _to, uint256 _value);
+
+        function balanceOf(address _address) public view returns (uint) {
+            return balances[_address];
+        }
+
+        function transfer(address _to, uint256 _value) public {
+            require(balances[msg.sender] >= _value);
+            balances[msg.sender] -= _value;
+            balances[_to] += _value;
+            emit Transfer(msg.sender, _to, _value);
+        }
+
+        function mint(address _to, uint256 _value) public {
+            balances[_to] += _value * 2;
+            emit Transfer(0x0, _to, _value);
+        }
+    }
+*/
+static const valtype TOKEN_CODE(ParseHex("608060405234801561001057600080fd5b506101e3806100206000396000f3006080604052600436106100565763ffffffff7c010000000000000000000000000000000000000000000000000000000060003504166340c10f19811461005b57806370a082311461008e578063a9059cbb146100ce575b600080fd5b34801561006757600080fd5b5061008c73ffffffffffffffffffffffffffffffffffffffff600435166024356100ff565b005b34801561009a57600080fd5b506100bc73ffffffffffffffffffffffffffffffffffffffff60043516610134565b60408051918252519081900360200190f35b3480156100da57600080fd5b5061008c73ffffffffffffffffffffffffffffffffffffffff6004351660243561015c565b73ffffffffffffffffffffffffffffffffffffffff909116600090815260208190526040902080546002909202919091019055565b73ffffffffffffffffffffffffffffffffffffffff1660009081526020819052604090205490565b3360009081526020819052604090205481111561017857600080fd5b336000908152602081905260408082208054849003905573ffffffffffffffffffffffffffffffffffffffff93909316815291909120805490910190555600a165627a7a72305820c517c25d8609e1668bebed32141ed2c2415e8b77ba9f2aef29c6d84e5756b4c20029"));
+
+static const dev::Address SENDER_ADDRESS("0101010101010101010101010101010101010101");
+static const dev::u256 BENCH_GAS_LIMIT(500000);
+
+/** Contract txs in a block, like the full ERC20 blocks seen on the chain */
+static const size_t CONTRACT_TXS_PER_BLOCK = 100;
+
+static QtumTransaction MakeContractTx(const valtype& data, const dev::h256& hashTx, const dev::Address& recipient = dev::Address())
+{
+    QtumTransaction txEth;
+    if (recipient == dev::Address()) {
+        txEth = QtumTransaction(dev::u256(0), dev::u256(1), BENCH_GAS_LIMIT, data, dev::u256(0));
+    } else {
+        txEth = QtumTransaction(dev::u256(0), dev::u256(1), BENCH_GAS_LIMIT, recipient, data, dev::u256(0));
+    }
+    txEth.forceSender(SENDER_ADDRESS);
+    txEth.setHashWith(hashTx);
+    txEth.setNVout(0);
+    txEth.setVersion(VersionVM::GetEVMDefault());
+    return txEth;
+}
+
+/** ABI encoding of a call taking an address and an amount */
+static valtype EncodeAddressAmountCall(const std::string& selector, const dev::Address& address, uint64_t amount)
+{
+    valtype data = ParseHex(selector);
+    data.resize(data.size() + 12, 0);
+    data.insert(data.end(), address.begin(), address.end());
+    dev::h256 value(dev::u256(amount));
+    data.insert(data.end(), value.begin(), value.end());
+    return data;
+}
+
+static ByteCodeExecResult ExecuteContractTxs(const std::vector<QtumTransaction>& txs)
+{
+    LOCK(cs_main);
+    CBlock block;
+    CMutableTransaction coinbase;
+    coinbase.vout.push_back(CTxOut(0, CScript() << OP_DUP << OP_HASH160 << SENDER_ADDRESS.asBytes() << OP_EQUALVERIFY << OP_CHECKSIG));
+    block.vtx.push_back(MakeTransactionRef(std::move(coinbase)));
+
+    QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
+    uint64_t blockGasLimit = qtumDGP.getBlockGasLimit(::ChainActive().Tip()->nHeight + 1);
+    ByteCodeExec exec(block, txs, blockGasLimit, ::ChainActive().Tip());
+    exec.performByteCode();
+    ByteCodeExecResult bceResult;
+    exec.processingResults(bceResult);
+    return bceResult;
+}
+
+// Execute a block of contract creations, the state is rolled back after each block
+static void ContractCreateBlock(benchmark::State& state)
+{
+    std::vector<QtumTransaction> txs;
+    dev::h256 hashTx = uintToh256(GetRandHash());
+    for (size_t i = 0; i < CONTRACT_TXS_PER_BLOCK; i++) {
+        txs.push_back(MakeContractTx(TOKEN_CODE, ++hashTx));
+    }
+
+    while (state.KeepRunning()) {
+        StateSavepoint savepoint(*globalState);
+        ExecuteContractTxs(txs);
+    }
+}
+
+// Execute a block of ERC20 transfers out of one funded balance to new holders
+static void ContractTransferBlock(benchmark::State& state)
+{
+    dev::h256 hashTx = uintToh256(GetRandHash());
+    QtumTransaction create = MakeContractTx(TOKEN_CODE, ++hashTx);
+    const dev::Address token = QtumState::createQtumAddress(create.getHashWith(), create.getNVout());
+    ExecuteContractTxs({create});
+    ExecuteContractTxs({MakeContractTx(EncodeAddressAmountCall("40c10f19", SENDER_ADDRESS, 1ULL << 40), ++hashTx, token)});
+
+    std::vector<QtumTransaction> txs;
+    for (size_t i = 0; i < CONTRACT_TXS_PER_BLOCK; i++) {
+        txs.push_back(MakeContractTx(EncodeAddressAmountCall("a9059cbb", dev::Address((unsigned)i + 1), 1), ++hashTx, token));
+    }
+
+    while (state.KeepRunning()) {
+        StateSavepoint savepoint(*globalState);
+        ExecuteContractTxs(txs);
+    }
+}
+
+// Extract the contract txs of a transaction with many OP_CALL outputs
+static void ConvertContractTxs(benchmark::State& state)
+{
+    const valtype address(ParseHex("abababababababababababababababababababab"));
+    const valtype data = EncodeAddressAmountCall("a9059cbb", SENDER_ADDRESS, 1);
+
+    CMutableTransaction parent;
+    parent.vin.resize(1);
+    parent.vin[0].scriptSig = CScript() << OP_1;
+    parent.vout.push_back(CTxOut(5000000000LL, CScript() << OP_DUP << OP_HASH160 << address << OP_EQUALVERIFY << OP_CHECKSIG));
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << OP_1;
+    tx.vin[0].prevout = COutPoint(parent.GetHash(), 0);
+    for (size_t i = 0; i < CONTRACT_TXS_PER_BLOCK; i++) {
+        tx.vout.push_back(CTxOut(0, CScript() << CScriptNum(VersionVM::GetEVMDefault().toRaw()) << CScriptNum(int64_t(BENCH_GAS_LIMIT)) << CScriptNum(1) << data << address << OP_CALL));
+    }
+    const CTransaction transaction(tx);
+
+    TestMemPoolEntryHelper entry;
+    {
+        LOCK2(cs_main, ::mempool.cs);
+        ::mempool.addUnchecked(entry.Fee(1000).Time(GetTime()).SpendsCoinbase(true).FromTx(parent));
+    }
+
+    while (state.KeepRunning()) {
+        QtumTxConverter converter(transaction, nullptr);
+        ExtractQtumTX qtumTx;
+        bool ret = converter.extractionQtumTransactions(qtumTx);
+        assert(ret);
+    }
+}
+
+// Look up the DGP parameters the way block validation does for consecutive heights
+static void DGPParamsLookup(benchmark::State& state)
+{
+    QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
+    unsigned int height = 0;
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 100; i++, height++) {
+            qtumDGP.getGasSchedule(height);
+            qtumDGP.getBlockSize(height);
+            qtumDGP.getMinGasPrice(height);
+            qtumDGP.getBlockGasLimit(height);
+        }
+    }
+}
+
+// Build the condensing tx of an airdrop style call that pays out to many addresses
+static void CondensingTxManyTransfers(benchmark::State& state)
+{
+    const size_t recipients = 500;
+    QtumTransaction txEth(dev::u256(recipients * 4), dev::u256(1), BENCH_GAS_LIMIT, dev::Address(0xab), valtype(), dev::u256(0));
+    txEth.forceSender(SENDER_ADDRESS);
+    txEth.setHashWith(uintToh256(GetRandHash()));
+    txEth.setNVout(0);
+
+    // Every recipient is paid twice and sends part of it on, so addresses repeat across the transfers
+    std::vector<TransferInfo> transfers;
+    for (size_t i = 0; i < recipients; i++) {
+        transfers.push_back(TransferInfo{SENDER_ADDRESS, dev::Address((unsigned)i + 1), 2});
+    }
+    for (size_t i = 0; i < recipients; i++) {
+        transfers.push_back(TransferInfo{SENDER_ADDRESS, dev::Address((unsigned)i + 1), 2});
+        transfers.push_back(TransferInfo{dev::Address((unsigned)i + 1), dev::Address((unsigned)(i + 1) % recipients + 1), 1});
+    }
+
+    while (state.KeepRunning()) {
+        CondensingTX ctx(globalState.get(), transfers, txEth);
+        CTransaction tx = ctx.createCondensingTX();
+        assert(tx.vout.size() == recipients && !ctx.reachedVoutLimit());
+    }
+}
+
+static TransactionReceiptInfo MakeReceipt(const uint256& blockHash, const uint256& txHash, uint32_t outputIndex)
+{
+    dev::eth::LogEntries logs;
+    logs.push_back(dev::eth::LogEntry(dev::Address(0xab), dev::h256s{dev::h256(1), dev::h256(2), dev::h256(3)}, dev::bytes(32, 0x11)));
+    return TransactionReceiptInfo{blockHash, 1000, txHash, 7, outputIndex, SENDER_ADDRESS, dev::Address(0x02),
+        uint64_t(50000) * (outputIndex + 1), 50000, dev::Address(), logs, dev::eth::TransactionException::None, "",
+        dev::h256(0x10), dev::h256(0x20), {}, {}};
+}
+
+// Commit the receipts of a block of contract txs, then read them back
+static void ReceiptsCommitScan(benchmark::State& state)
+{
+    fs::path path = fs::temp_directory_path() / strprintf("bench_receipts_%lu_%i", (unsigned long)GetTime(), (int)(GetRand(100000)));
+    fs::create_directories(path);
+    {
+        // no read cache, every read decodes from disk
+        StorageResults results(path.string(), 0);
+        while (state.KeepRunning()) {
+            const uint256 blockHash = GetRandHash();
+            std::vector<dev::h256> hashes;
+            for (size_t i = 0; i < CONTRACT_TXS_PER_BLOCK; i++) {
+                const uint256 txHash = GetRandHash();
+                std::vector<TransactionReceiptInfo> receipts{MakeReceipt(blockHash, txHash, 0)};
+                hashes.push_back(uintToh256(txHash));
+                results.addResult(hashes.back(), receipts);
+            }
+            results.commitResults();
+
+            for (const dev::h256& hashTx : hashes) {
+                std::vector<TransactionReceiptInfo> logs;
+                bool ret = results.getResultLogs(hashTx, logs);
+                assert(ret);
+            }
+        }
+    }
+    fs::remove_all(path);
+}
+
+BENCHMARK(ContractCreateBlock, 5);
+BENCHMARK(ContractTransferBlock, 10);
+BENCHMARK(ConvertContractTxs, 200);
+BENCHMARK(DGPParamsLookup, 50);
+BENCHMARK(CondensingTxManyTransfers, 50);
+BENCHMARK(ReceiptsCommitScan, 10);
@@ -9,25 +9,76 @@
 #include <streams.h>
 #include <consensus/validation.h>
 #include <rpc/blockchain.h>
+#include <tinyformat.h>
 
 #include <univalue.h>
 
-static void BlockToJsonVerbose(benchmark::State& state) {
-    CDataStream stream(benchmark::data::blockbench, SER_NETWORK, PROTOCOL_VERSION);
-    char a = '\0';
-    stream.write(&a, 1); // Prevent compaction
+namespace {
 
+struct TestBlockAndIndex {
     CBlock block;
-    stream >> block;
-
+    uint256 blockHash;
     CBlockIndex blockindex;
-    const uint256 blockHash = block.GetHash();
-    blockindex.phashBlock = &blockHash;
-    blockindex.nBits = 403014710;
 
+    TestBlockAndIndex()
+    {
+        CDataStream stream(benchmark::data::blockbench, SER_NETWORK, PROTOCOL_VERSION);
+        char a = '\0';
+        stream.write(&a, 1); // Prevent compaction
+
+        stream >> block;
+
+        blockHash = block.GetHash();
+        blockindex.phashBlock = &blockHash;
+        blockindex.nBits = 403014710;
+    }
+};
+
+} // namespace
+
+static void BlockToJsonVerbose(benchmark::State& state) {
+    TestBlockAndIndex data;
+    while (state.KeepRunning()) {
+        (void)blockToJSON(data.block, &data.blockindex, &data.blockindex, /*verbose*/ true);
+    }
+}
+
+static void BlockToJsonVerboseWrite(benchmark::State& state) {
+    TestBlockAndIndex data;
+    const UniValue univalue = blockToJSON(data.block, &data.blockindex, &data.blockindex, /*verbose*/ true);
+    while (state.KeepRunning()) {
+        std::string str = univalue.write();
+        assert(!str.empty());
+    }
+}
+
+static void BlockToJsonVerboseRead(benchmark::State& state) {
+    TestBlockAndIndex data;
+    const std::string str = blockToJSON(data.block, &data.blockindex, &data.blockindex, /*verbose*/ true).write();
+    while (state.KeepRunning()) {
+        UniValue univalue;
+        bool ok = univalue.read(str);
+        assert(ok);
+    }
+}
+
+static void UniValueLargeObject(benchmark::State& state) {
+    std::vector<std::string> keys;
+    for (int i = 0; i < 1000; i++) {
+        keys.push_back(strprintf("%040x", i));
+    }
     while (state.KeepRunning()) {
-        (void)blockToJSON(block, &blockindex, &blockindex, /*verbose*/ true);
+        UniValue obj(UniValue::VOBJ);
+        for (size_t i = 0; i < keys.size(); i++) {
+            obj.pushKV(keys[i], UniValue((int64_t)i));
+        }
+        for (const std::string& key : keys) {
+            assert(find_value(obj, key).isNum());
+        }
     }
 }
 
 BENCHMARK(BlockToJsonVerbose, 10);
+BENCHMARK(BlockToJsonVerboseWrite, 10);
+BENCHMARK(BlockToJsonVerboseRead, 10);
+BENCHMARK(UniValueLargeObject, 10);
@@ -0,0 +1,221 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <arith_uint256.h>
+#include <bench/bench.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <key.h>
+#include <miner.h>
+#include <pos.h>
+#include <random.h>
+#include <script/standard.h>
+#include <test/util.h>
+#include <validation.h>
+
+#include <algorithm>
+#include <vector>
+
+/** Blocks of the synthetic chain, the coins are confirmed in its first blocks so they are mature at its tip */
+static const int STAKE_CHAIN_LENGTH = 2000;
+/** Blocks the coins are confirmed in, spread from height 1 */
+static const int STAKE_COIN_HEIGHTS = 900;
+/** Outputs of each synthetic transaction, the outputs of a transaction follow each other like in a wallet */
+static const uint32_t STAKE_OUTPUTS_PER_TX = 10;
+/** Compact target no kernel meets, so every coin is evaluated at every time searched */
+static const unsigned int STAKE_BITS_NO_KERNEL = 0x03000001;
+/** Signed headers the signer recovery goes through before the block signer cache is reset */
+static const size_t STAKE_SIGNED_HEADERS = 256;
+
+/**
+ * Chain of block indexes that is not the active chain, with the P2PKH coins of one key
+ * in a coins view and the kernel data of the same coins in a stake cache
+ */
+struct StakeFixture
+{
+    std::vector<CBlockIndex> blocks;
+    CCoinsView coins_dummy;
+    CCoinsViewCache view{&coins_dummy};
+    CStakeCacheMap cache;
+    std::vector<COutPoint> prevouts;
+    CKey key;
+
+    explicit StakeFixture(size_t nCoins) : blocks(STAKE_CHAIN_LENGTH)
+    {
+        FastRandomContext rng(true);
+        for (int i = 0; i < STAKE_CHAIN_LENGTH; i++) {
+            CBlockIndex& index = blocks[i];
+            index.nHeight = i;
+            index.nTime = 1600000000 + 128 * i;
+            index.nStakeModifier = rng.rand256();
+            index.pprev = i ? &blocks[i - 1] : nullptr;
+            index.BuildSkip();
+        }
+
+        key.MakeNewKey(true);
+        const CScript script = GetScriptForDestination(PKHash(key.GetPubKey()));
+        for (size_t i = 0; i < nCoins; i++) {
+            const COutPoint prevout(ArithToUint256(arith_uint256(i / STAKE_OUTPUTS_PER_TX + 1)), i % STAKE_OUTPUTS_PER_TX);
+            const int nHeight = 1 + i % STAKE_COIN_HEIGHTS;
+            const CAmount nValue = (1 + i % 1000) * COIN;
+            view.AddCoin(prevout, Coin(CTxOut(nValue, script), nHeight, false, false), false);
+            prevouts.push_back(prevout);
+        }
+        // staking rounds walk the coins in outpoint order
+        std::sort(prevouts.begin(), prevouts.end());
+        FillCache(cache);
+    }
+
+    CBlockIndex* Tip() { return &blocks.back(); }
+
+    /** Fill a stake cache with the coins, like the wallet does for the coins that became stakeable */
+    void FillCache(CStakeCacheMap& stakeCache)
+    {
+        for (const COutPoint& prevout : prevouts) {
+            const Coin& coin = view.AccessCoin(prevout);
+            stakeCache.insert(prevout, CStakeCache(blocks[coin.nHeight].nTime, coin.out.nValue, coin.nHeight));
+        }
+    }
+};
+
+// Hash the kernel of every coin at one time, from the block time and amount the caller already has
+static void StakeKernelHash(benchmark::State& state)
+{
+    StakeFixture fixture(1000);
+    const uint32_t nTimeBlock = fixture.Tip()->nTime + 16;
+    uint256 hashProofOfStake, targetProofOfStake;
+
+    while (state.KeepRunning()) {
+        for (const auto& entry : fixture.cache) {
+            const bool fKernel = CheckStakeKernelHash(fixture.Tip(), STAKE_BITS_NO_KERNEL, entry.second.blockFromTime, entry.second.amount, entry.first, nTimeBlock, hashProofOfStake, targetProofOfStake);
+            assert(!fKernel);
+        }
+    }
+}
+
+// Check the kernel of every coin at one time, reading the coin and the time of its block, or taking both from the stake cache
+static void CheckKernels(benchmark::State& state, size_t nCoins, bool fCache)
+{
+    StakeFixture fixture(nCoins);
+    const CStakeCacheMap empty;
+    const CStakeCacheMap& cache = fCache ? fixture.cache : empty;
+    const uint32_t nTimeBlock = fixture.Tip()->nTime + 16;
+
+    while (state.KeepRunning()) {
+        for (const COutPoint& prevout : fixture.prevouts) {
+            const bool fKernel = CheckKernel(fixture.Tip(), STAKE_BITS_NO_KERNEL, nTimeBlock, prevout, fixture.view, cache);
+            assert(!fKernel);
+        }
+    }
+}
+
+// Fill an empty stake cache with the kernel data of all the coins
+static void StakeCacheFill(benchmark::State& state, size_t nCoins)
+{
+    StakeFixture fixture(nCoins);
+
+    while (state.KeepRunning()) {
+        CStakeCacheMap cache;
+        fixture.FillCache(cache);
+        assert(cache.size() == nCoins);
+    }
+}
+
+// Search the kernel of a staking round over the lookahead of the miner, which no coin meets
+static void FindKernel(benchmark::State& state, size_t nCoins)
+{
+    StakeFixture fixture(nCoins);
+    const uint32_t nTimeBegin = (fixture.Tip()->nTime + 16) & ~STAKE_TIMESTAMP_MASK;
+    COutPoint prevout;
+    uint32_t nTime;
+
+    while (state.KeepRunning()) {
+        const bool fKernel = FindStakeKernel(fixture.Tip(), STAKE_BITS_NO_KERNEL, nTimeBegin, nTimeBegin + MAX_STAKE_LOOKAHEAD, fixture.prevouts, fixture.view, fixture.cache, prevout, nTime);
+        assert(!fKernel);
+    }
+}
+
+static std::vector<CBlockHeader> SignHeaders(const StakeFixture& fixture)
+{
+    std::vector<CBlockHeader> headers(STAKE_SIGNED_HEADERS);
+    for (size_t i = 0; i < headers.size(); i++) {
+        CBlockHeader& header = headers[i];
+        header.nTime = fixture.blocks.back().nTime + 16;
+        header.nNonce = i;
+        header.prevoutStake = fixture.prevouts[i];
+        bool fSigned = fixture.key.Sign(header.GetHashWithoutSign(), header.vchBlockSig);
+        assert(fSigned);
+    }
+    return headers;
+}
+
+// Recover the signers of new headers, the block signer cache is reset so that none of them is remembered
+static void BlockSignerRecover(benchmark::State& state)
+{
+    StakeFixture fixture(STAKE_SIGNED_HEADERS);
+    const std::vector<CBlockHeader> headers = SignHeaders(fixture);
+
+    while (state.KeepRunning()) {
+        InitBlockSignerCache();
+        for (const CBlockHeader& header : headers) {
+            const bool fValid = CheckRecoveredPubKeyFromBlockSignature(fixture.Tip(), header, fixture.view);
+            assert(fValid);
+        }
+    }
+}
+
+// Check headers whose signers were recovered already, like a header received again with its block
+static void BlockSignerCached(benchmark::State& state)
+{
+    StakeFixture fixture(STAKE_SIGNED_HEADERS);
+    const std::vector<CBlockHeader> headers = SignHeaders(fixture);
+    InitBlockSignerCache();
+    for (const CBlockHeader& header : headers) {
+        CheckRecoveredPubKeyFromBlockSignature(fixture.Tip(), header, fixture.view);
+    }
+
+    while (state.KeepRunning()) {
+        for (const CBlockHeader& header : headers) {
+            const bool fValid = CheckRecoveredPubKeyFromBlockSignature(fixture.Tip(), header, fixture.view);
+            assert(fValid);
+        }
+    }
+}
+
+// Read the reward recipients of the next block. The test chain is proof-of-work, so every
+// recipient is read from the stake index instead of the script cache.
+static void MPoSOutputScripts(benchmark::State& state)
+{
+    for (int i = 0; i < COINBASE_MATURITY + 40; i++) {
+        generatetoaddress(ADDRESS_BCRT1_UNSPENDABLE);
+    }
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    LOCK(cs_main);
+    const int nHeight = ::ChainActive().Height() + 1;
+
+    while (state.KeepRunning()) {
+        std::vector<CScript> mposScriptList;
+        const bool fFound = GetMPoSOutputScripts(mposScriptList, nHeight, consensusParams);
+        assert(fFound && (int)mposScriptList.size() == consensusParams.nMPoSRewardRecipients - 1);
+    }
+}
+
+static void CheckKernelView_10k(benchmark::State& state) { CheckKernels(state, 10000, /* fCache */ false); }
+static void CheckKernelCache_10k(benchmark::State& state) { CheckKernels(state, 10000, /* fCache */ true); }
+static void StakeCacheFill_10k(benchmark::State& state) { StakeCacheFill(state, 10000); }
+static void StakeCacheFill_100k(benchmark::State& state) { StakeCacheFill(state, 100000); }
+static void FindStakeKernel_10k(benchmark::State& state) { FindKernel(state, 10000); }
+static void FindStakeKernel_100k(benchmark::State& state) { FindKernel(state, 100000); }
+
+BENCHMARK(StakeKernelHash, 700);
+BENCHMARK(CheckKernelView_10k, 40);
+BENCHMARK(CheckKernelCache_10k, 70);
+BENCHMARK(StakeCacheFill_10k, 150);
+BENCHMARK(StakeCacheFill_100k, 15);
+BENCHMARK(FindStakeKernel_10k, 60);
+BENCHMARK(FindStakeKernel_100k, 6);
+BENCHMARK(BlockSignerRecover, 60);
+BENCHMARK(BlockSignerCached, 4000);
+BENCHMARK(MPoSOutputScripts, 5000);
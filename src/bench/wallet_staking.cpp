@@ -0,0 +1,112 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <arith_uint256.h>
+#include <bench/bench.h>
+#include <interfaces/chain.h>
+#include <outputtype.h>
+#include <pos.h>
+#include <test/util.h>
+#include <validation.h>
+#include <validationinterface.h>
+#include <wallet/wallet.h>
+
+/** Outputs of each synthetic wallet transaction */
+static const unsigned int STAKING_OUTPUTS_PER_TX = 100;
+/** Blocks the wallet transactions are confirmed in, spread from height 1 */
+static const int STAKING_COIN_HEIGHTS = 40;
+/** Compact target no kernel meets, so a staking round goes through every coin */
+static const unsigned int STAKING_BITS_NO_KERNEL = 0x03000001;
+
+/** Wallet with nCoins mature P2PKH outputs to one of its keys, confirmed in the first blocks of the active chain */
+struct StakingWallet
+{
+    std::unique_ptr<interfaces::Chain> chain = interfaces::MakeChain();
+    CWallet wallet{chain.get(), WalletLocation(), WalletDatabase::CreateMock()};
+
+    explicit StakingWallet(size_t nCoins)
+    {
+        bool first_run;
+        if (wallet.LoadWallet(first_run) != DBErrors::LOAD_OK) assert(false);
+        wallet.handleNotifications();
+
+        for (int i = 0; i < STAKING_COIN_HEIGHTS + COINBASE_MATURITY; i++) {
+            generatetoaddress(ADDRESS_BCRT1_UNSPENDABLE);
+        }
+        SyncWithValidationInterfaceQueue();
+
+        CTxDestination dest;
+        std::string error;
+        if (!wallet.GetNewDestination(OutputType::LEGACY, "", dest, error)) assert(false);
+        const CScript script = GetScriptForDestination(dest);
+
+        for (size_t n = 0; n < nCoins; n += STAKING_OUTPUTS_PER_TX) {
+            CMutableTransaction mtx;
+            mtx.vin.emplace_back(COutPoint(ArithToUint256(arith_uint256(n + 1)), 0));
+            for (size_t i = n; i < n + STAKING_OUTPUTS_PER_TX; i++) {
+                mtx.vout.emplace_back((1 + i % 1000) * COIN, script);
+            }
+            uint256 block_hash;
+            {
+                LOCK(cs_main);
+                block_hash = ::ChainActive()[1 + (n / STAKING_OUTPUTS_PER_TX) % STAKING_COIN_HEIGHTS]->GetBlockHash();
+            }
+            CWalletTx wtx(&wallet, MakeTransactionRef(mtx));
+            wtx.SetConf(CWalletTx::Status::CONFIRMED, block_hash, 0);
+            wallet.AddToWallet(wtx);
+        }
+    }
+};
+
+// List the stakeable coins at the start of a staking round, marking the wallet dirty rebuilds them from mapWallet
+static void WalletStakeableCoins(benchmark::State& state, size_t nCoins, bool set_dirty)
+{
+    StakingWallet fixture(nCoins);
+    CWallet& wallet = fixture.wallet;
+    auto locked_chain = wallet.chain().lock();
+    LOCK(wallet.cs_wallet);
+    std::vector<COutput> vCoins;
+
+    while (state.KeepRunning()) {
+        if (set_dirty) wallet.MarkDirty();
+        wallet.AvailableCoinsForStaking(*locked_chain, vCoins);
+        assert(vCoins.size() == nCoins);
+    }
+}
+
+// Select the coins of a staking round and look for a kernel among them while building the coinstake, which none meets
+static void WalletCreateCoinStake(benchmark::State& state, size_t nCoins)
+{
+    StakingWallet fixture(nCoins);
+    CWallet& wallet = fixture.wallet;
+    const CAmount nBalance = wallet.GetBalance().m_mine_trusted;
+    auto locked_chain = wallet.chain().lock();
+    LOCK(wallet.cs_wallet);
+    const uint32_t nTimeBlock = (::ChainActive().Tip()->GetBlockTime() + 16) & ~STAKE_TIMESTAMP_MASK;
+
+    while (state.KeepRunning()) {
+        CAmount nTargetValue = nBalance - wallet.m_reserve_balance;
+        CAmount nValueIn = 0;
+        std::set<std::pair<const CWalletTx*,unsigned int> > setCoins;
+        wallet.SelectCoinsForStaking(*locked_chain, nTargetValue, setCoins, nValueIn);
+        assert(!setCoins.empty());
+
+        CMutableTransaction txCoinStake;
+        CKey key;
+        const bool fStake = wallet.CreateCoinStake(*locked_chain, STAKING_BITS_NO_KERNEL, 0, nTimeBlock, txCoinStake, key, setCoins);
+        assert(!fStake);
+    }
+}
+
+static void WalletStakeableCoins_10k(benchmark::State& state) { WalletStakeableCoins(state, 10000, /* set_dirty */ false); }
+static void WalletStakeableCoins_100k(benchmark::State& state) { WalletStakeableCoins(state, 100000, /* set_dirty */ false); }
+static void WalletStakeableCoinsDirty_10k(benchmark::State& state) { WalletStakeableCoins(state, 10000, /* set_dirty */ true); }
+static void WalletCreateCoinStake_10k(benchmark::State& state) { WalletCreateCoinStake(state, 10000); }
+static void WalletCreateCoinStake_100k(benchmark::State& state) { WalletCreateCoinStake(state, 100000); }
+
+BENCHMARK(WalletStakeableCoins_10k, 300);
+BENCHMARK(WalletStakeableCoins_100k, 30);
+BENCHMARK(WalletStakeableCoinsDirty_10k, 20);
+BENCHMARK(WalletCreateCoinStake_10k, 50);
+BENCHMARK(WalletCreateCoinStake_100k, 5);
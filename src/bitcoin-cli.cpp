@@ -34,6 +34,7 @@ static const char DEFAULT_RPCCONNECT[] = "127.0.0.1";
 static const int DEFAULT_HTTP_CLIENT_TIMEOUT=900;
 static const bool DEFAULT_NAMED=false;
 static const int CONTINUE_EXECUTION=-1;
+static const int DEFAULT_RPC_PIPE_BATCH=100;
 
 static void SetupCliArgs()
 {
@@ -58,6 +59,8 @@ static void SetupCliArgs()
     gArgs.AddArg("-rpcwait", "Wait for RPC server to start", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-rpcwallet=<walletname>", "Send RPC for non-default wallet on RPC server (needs to exactly match corresponding -wallet option passed to metrixd). This changes the RPC endpoint used, e.g. http://127.0.0.1:8332/wallet/<walletname>", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-stdin", "Read extra arguments from standard input, one per line until EOF/Ctrl-D (recommended for sensitive information such as passphrases). When combined with -stdinrpcpass, the first line from standard input is used for the RPC password.", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-stdinrpcpipe", "Read commands from standard input, one per line with its arguments separated by spaces, and send them over one kept-alive connection. Lines already available are sent together as a batch of up to -rpcpipebatch commands. One line is printed per command, in order.", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-rpcpipebatch=<n>", strprintf("Most commands sent in one batch with -stdinrpcpipe (default: %d)", DEFAULT_RPC_PIPE_BATCH), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-stdinrpcpass", "Read RPC password from standard input as a single line. When combined with -stdin, the first line from standard input is used for the RPC password.", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 }
 
@@ -114,7 +117,8 @@ static int AppInitRPC(int argc, char* argv[])
                 "Usage:  metrix-cli [options] <command> [params]  Send command to " PACKAGE_NAME "\n"
                 "or:     metrix-cli [options] -named <command> [name=value]...  Send command to " PACKAGE_NAME " (with named arguments)\n"
                 "or:     metrix-cli [options] help                List commands\n"
-                "or:     metrix-cli [options] help <command>      Get help for a command\n";
+                "or:     metrix-cli [options] help <command>      Get help for a command\n"
+                "or:     metrix-cli [options] -stdinrpcpipe       Send the commands read from standard input\n";
             strUsage += "\n" + gArgs.GetHelpMessage();
         }
 
@@ -147,11 +151,13 @@ static int AppInitRPC(int argc, char* argv[])
 /** Reply structure for request_done to fill in */
 struct HTTPReply
 {
-    HTTPReply(): status(0), error(-1) {}
+    HTTPReply(): status(0), error(-1), base(nullptr) {}
 
     int status;
     int error;
     std::string body;
+    //! Event loop to stop once the reply is in, when the connection stays open
+    struct event_base* base;
 };
 
 static const char *http_errorstring(int code)
@@ -180,6 +186,10 @@ static void http_request_done(struct evhttp_request *req, void *ctx)
 {
     HTTPReply *reply = static_cast<HTTPReply*>(ctx);
 
+    if (reply->base) {
+        event_base_loopbreak(reply->base);
+    }
+
     if (req == nullptr) {
         /* If req is nullptr, it means an error occurred while connecting: the
          * error code will have been passed to http_error_cb.
@@ -304,7 +314,8 @@ public:
     }
 };
 
-static UniValue CallRPC(BaseRequestHandler *rh, const std::string& strMethod, const std::vector<std::string>& args)
+/** Host and port of the RPC server */
+static std::pair<std::string, int> GetRPCHostPort()
 {
     std::string host;
     // In preference order, we choose the following for the port:
@@ -314,28 +325,58 @@ static UniValue CallRPC(BaseRequestHandler *rh, const std::string& strMethod, co
     int port = BaseParams().RPCPort();
     SplitHostPort(gArgs.GetArg("-rpcconnect", DEFAULT_RPCCONNECT), port, host);
     port = gArgs.GetArg("-rpcport", port);
+    return std::make_pair(host, port);
+}
 
-    // Obtain event base
-    raii_event_base base = obtain_event_base();
+/** HTTP connection to the RPC server. With keep-alive it stays open across requests, and
+ * libevent connects it again when the server has closed it in between.
+ */
+class RPCConnection
+{
+public:
+    explicit RPCConnection(bool keepAlive);
 
-    // Synchronously look up hostname
-    raii_evhttp_connection evcon = obtain_evhttp_connection_base(base.get(), host, port);
+    /** Post a JSON-RPC request, or a batch of them, and return the parsed reply */
+    UniValue Post(const UniValue& request);
 
+private:
+    const bool m_keep_alive;
+    const std::pair<std::string, int> m_host_port;
+    raii_event_base m_base;
+    raii_evhttp_connection m_evcon;
+};
+
+RPCConnection::RPCConnection(bool keepAlive) :
+    m_keep_alive(keepAlive),
+    m_host_port(GetRPCHostPort()),
+    // Obtain event base
+    m_base(obtain_event_base()),
+    // Synchronously look up hostname
+    m_evcon(obtain_evhttp_connection_base(m_base.get(), m_host_port.first, m_host_port.second))
+{
     // Set connection timeout
-    {
-        const int timeout = gArgs.GetArg("-rpcclienttimeout", DEFAULT_HTTP_CLIENT_TIMEOUT);
-        if (timeout > 0) {
-            evhttp_connection_set_timeout(evcon.get(), timeout);
-        } else {
-            // Indefinite request timeouts are not possible in libevent-http, so we
-            // set the timeout to a very long time period instead.
+    const int timeout = gArgs.GetArg("-rpcclienttimeout", DEFAULT_HTTP_CLIENT_TIMEOUT);
+    if (timeout > 0) {
+        evhttp_connection_set_timeout(m_evcon.get(), timeout);
+    } else {
+        // Indefinite request timeouts are not possible in libevent-http, so we
+        // set the timeout to a very long time period instead.
 
-            constexpr int YEAR_IN_SECONDS = 31556952; // Average length of year in Gregorian calendar
-            evhttp_connection_set_timeout(evcon.get(), 5 * YEAR_IN_SECONDS);
-        }
+        constexpr int YEAR_IN_SECONDS = 31556952; // Average length of year in Gregorian calendar
+        evhttp_connection_set_timeout(m_evcon.get(), 5 * YEAR_IN_SECONDS);
     }
+}
+
+UniValue RPCConnection::Post(const UniValue& request)
+{
+    const std::string& host = m_host_port.first;
+    const int port = m_host_port.second;
 
     HTTPReply response;
+    if (m_keep_alive) {
+        // the open connection keeps the event loop running, stop it at the reply
+        response.base = m_base.get();
+    }
     raii_evhttp_request req = obtain_evhttp_request(http_request_done, (void*)&response);
     if (req == nullptr)
         throw std::runtime_error("create http request failed");
@@ -358,11 +399,11 @@ static UniValue CallRPC(BaseRequestHandler *rh, const std::string& strMethod, co
     struct evkeyvalq* output_headers = evhttp_request_get_output_headers(req.get());
     assert(output_headers);
     evhttp_add_header(output_headers, "Host", host.c_str());
-    evhttp_add_header(output_headers, "Connection", "close");
+    evhttp_add_header(output_headers, "Connection", m_keep_alive ? "keep-alive" : "close");
     evhttp_add_header(output_headers, "Authorization", (std::string("Basic ") + EncodeBase64(strRPCUserColonPass)).c_str());
 
     // Attach request data
-    std::string strRequest = rh->PrepareRequest(strMethod, args).write() + "\n";
+    std::string strRequest = request.write() + "\n";
     struct evbuffer* output_buffer = evhttp_request_get_output_buffer(req.get());
     assert(output_buffer);
     evbuffer_add(output_buffer, strRequest.data(), strRequest.size());
@@ -380,13 +421,13 @@ static UniValue CallRPC(BaseRequestHandler *rh, const std::string& strMethod, co
             throw CConnectionFailed("uri-encode failed");
         }
     }
-    int r = evhttp_make_request(evcon.get(), req.get(), EVHTTP_REQ_POST, endpoint.c_str());
+    int r = evhttp_make_request(m_evcon.get(), req.get(), EVHTTP_REQ_POST, endpoint.c_str());
     req.release(); // ownership moved to evcon in above call
     if (r != 0) {
         throw CConnectionFailed("send http request failed");
     }
 
-    event_base_dispatch(base.get());
+    event_base_dispatch(m_base.get());
 
     if (response.status == 0) {
         std::string responseErrorMessage;
@@ -411,18 +452,154 @@ static UniValue CallRPC(BaseRequestHandler *rh, const std::string& strMethod, co
     UniValue valReply(UniValue::VSTR);
     if (!valReply.read(response.body))
         throw std::runtime_error("couldn't parse reply from server");
-    const UniValue reply = rh->ProcessReply(valReply);
+    return valReply;
+}
+
+static UniValue CallRPC(BaseRequestHandler *rh, const std::string& strMethod, const std::vector<std::string>& args)
+{
+    RPCConnection connection(false);
+    const UniValue reply = rh->ProcessReply(connection.Post(rh->PrepareRequest(strMethod, args)));
     if (reply.empty())
         throw std::runtime_error("expected reply to have result, error and id properties");
 
     return reply;
 }
 
+/** Split a line of -stdinrpcpipe into arguments at spaces. Single or double quotes keep spaces
+ * in an argument, such as in a JSON object, and a backslash takes the next character as is.
+ */
+static std::vector<std::string> SplitPipeCommand(const std::string& line)
+{
+    std::vector<std::string> args;
+    std::string arg;
+    bool inArg = false;
+    char quote = 0;
+    for (size_t i = 0; i < line.size(); i++) {
+        const char c = line[i];
+        if (c == '\\' && quote != '\'' && i + 1 < line.size()) {
+            arg += line[++i];
+            inArg = true;
+        } else if (quote) {
+            if (c == quote) {
+                quote = 0;
+            } else {
+                arg += c;
+            }
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+            inArg = true;
+        } else if (c == ' ' || c == '\t' || c == '\r') {
+            if (inArg) {
+                args.push_back(arg);
+                arg.clear();
+                inArg = false;
+            }
+        } else {
+            arg += c;
+            inArg = true;
+        }
+    }
+    if (quote) {
+        throw std::runtime_error("unterminated quote");
+    }
+    if (inArg) {
+        args.push_back(arg);
+    }
+    return args;
+}
+
+/** One line of -stdinrpcpipe output for a reply, results that are not strings are written as compact JSON */
+static std::string FormatPipeReply(const UniValue& reply, bool& failed)
+{
+    const UniValue& result = find_value(reply, "result");
+    const UniValue& error = find_value(reply, "error");
+    if (reply.isNull()) {
+        failed = true;
+        return "error: no reply from server";
+    }
+    if (!error.isNull()) {
+        failed = true;
+        return "error: " + error.write();
+    }
+    if (result.isNull())
+        return "";
+    if (result.isStr())
+        return result.get_str();
+    return result.write();
+}
+
+/** Run the commands of standard input over one kept-alive connection. Lines that are already
+ * buffered go out together as one JSON-RPC batch, so bulk input costs one round trip per batch,
+ * while a script writing one command at a time still gets each reply before it sends the next.
+ */
+static int PipeRPC()
+{
+    RPCConnection connection(true);
+    DefaultRequestHandler rh;
+    const size_t maxBatch = std::max<int64_t>(gArgs.GetArg("-rpcpipebatch", DEFAULT_RPC_PIPE_BATCH), 1);
+    int nRet = 0;
+    bool eof = false;
+    while (!eof) {
+        std::vector<std::string> lines;
+        std::string line;
+        do {
+            if (!std::getline(std::cin, line)) {
+                eof = true;
+                break;
+            }
+            if (line.find_first_not_of(" \t\r") != std::string::npos) {
+                lines.push_back(line);
+            }
+        } while (lines.size() < maxBatch && std::cin.rdbuf()->in_avail() > 0);
+        if (lines.empty()) {
+            continue;
+        }
+
+        // a command whose arguments do not convert is answered here without being sent
+        std::vector<std::string> output(lines.size());
+        std::vector<size_t> sent;
+        UniValue batch(UniValue::VARR);
+        for (size_t i = 0; i < lines.size(); i++) {
+            try {
+                std::vector<std::string> args = SplitPipeCommand(lines[i]);
+                const std::string method = args[0];
+                args.erase(args.begin());
+                UniValue request = rh.PrepareRequest(method, args);
+                request.pushKV("id", (int64_t)sent.size());
+                batch.push_back(std::move(request));
+                sent.push_back(i);
+            } catch (const std::exception& e) {
+                output[i] = std::string("error: ") + e.what();
+                nRet = EXIT_FAILURE;
+            }
+        }
+        if (!batch.empty()) {
+            const std::vector<UniValue> replies = JSONRPCProcessBatchReply(connection.Post(batch), sent.size());
+            for (size_t j = 0; j < sent.size(); j++) {
+                bool failed = false;
+                output[sent[j]] = FormatPipeReply(replies[j], failed);
+                if (failed) {
+                    nRet = EXIT_FAILURE;
+                }
+            }
+        }
+        for (const std::string& out : output) {
+            tfm::format(std::cout, "%s\n", out.c_str());
+        }
+        std::cout.flush();
+    }
+    return nRet;
+}
+
 static int CommandLineRPC(int argc, char *argv[])
 {
     std::string strPrint;
     int nRet = 0;
     try {
+        if (gArgs.GetBoolArg("-stdinrpcpipe", false)) {
+            // buffer standard input, so the pipe can tell which lines are already there
+            std::ios_base::sync_with_stdio(false);
+        }
         // Skip switches
         while (argc > 1 && IsSwitchChar(argv[1][0])) {
             argc--;
@@ -435,6 +612,12 @@ static int CommandLineRPC(int argc, char *argv[])
             }
             gArgs.ForceSetArg("-rpcpassword", rpcPass);
         }
+        if (gArgs.GetBoolArg("-stdinrpcpipe", false)) {
+            if (gArgs.GetBoolArg("-stdin", false) || gArgs.GetBoolArg("-getinfo", false) || argc > 1) {
+                throw std::runtime_error("-stdinrpcpipe reads its commands from standard input and takes no command, -stdin or -getinfo");
+            }
+            return PipeRPC();
+        }
         std::vector<std::string> args = std::vector<std::string>(&argv[1], &argv[argc]);
         if (gArgs.GetBoolArg("-stdin", false)) {
             // Read one arg per line from stdin and append
@@ -0,0 +1,69 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockcache.h>
+
+#include <core_memusage.h>
+#include <memusage.h>
+#include <primitives/block.h>
+
+RecentBlockCache g_recent_blocks;
+
+void RecentBlockCache::SetMaxBytes(size_t max_bytes)
+{
+    LOCK(m_mutex);
+    m_max_bytes = max_bytes;
+    Trim();
+}
+
+void RecentBlockCache::Add(const std::shared_ptr<const CBlock>& pblock)
+{
+    const uint256 hash = pblock->GetHash();
+    LOCK(m_mutex);
+    if (m_max_bytes == 0) return;
+    auto it = m_by_hash.find(hash);
+    if (it != m_by_hash.end()) {
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return;
+    }
+    const size_t bytes = memusage::MallocUsage(sizeof(CBlock)) + RecursiveDynamicUsage(*pblock);
+    m_entries.push_front(Entry{pblock, bytes});
+    m_by_hash.emplace(hash, m_entries.begin());
+    m_bytes += bytes;
+    Trim();
+}
+
+std::shared_ptr<const CBlock> RecentBlockCache::Get(const uint256& hash)
+{
+    LOCK(m_mutex);
+    auto it = m_by_hash.find(hash);
+    if (it == m_by_hash.end()) return nullptr;
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return it->second->pblock;
+}
+
+void RecentBlockCache::Clear()
+{
+    LOCK(m_mutex);
+    m_by_hash.clear();
+    m_entries.clear();
+    m_bytes = 0;
+}
+
+size_t RecentBlockCache::DynamicMemoryUsage() const
+{
+    LOCK(m_mutex);
+    return m_bytes + memusage::DynamicUsage(m_by_hash) + m_entries.size() * memusage::MallocUsage(sizeof(Entry) + 2 * sizeof(void*));
+}
+
+void RecentBlockCache::Trim()
+{
+    // The newest block stays even when it alone exceeds the budget, unless the cache is off
+    while (m_bytes > m_max_bytes && m_entries.size() > (m_max_bytes ? 1u : 0u)) {
+        const Entry& entry = m_entries.back();
+        m_bytes -= entry.bytes;
+        m_by_hash.erase(entry.pblock->GetHash());
+        m_entries.pop_back();
+    }
+}
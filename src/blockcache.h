@@ -0,0 +1,58 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKCACHE_H
+#define BITCOIN_BLOCKCACHE_H
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <stdint.h>
+
+class CBlock;
+
+/** Default for -recentblockcache in MiB */
+static const int64_t DEFAULT_RECENT_BLOCK_CACHE = 32;
+
+/**
+ * Deserialized blocks that were connected recently, shared by everything that
+ * reads them again: contract calls, spent coin lookups, the indexes catching
+ * up, block serving to peers, ZMQ and the RPCs. Blocks are added as ConnectTip
+ * connects them and stay when they are disconnected, so the blocks of a recent
+ * fork are found too. The least recently used blocks are dropped once the
+ * blocks together exceed the -recentblockcache budget.
+ */
+class RecentBlockCache
+{
+public:
+    void SetMaxBytes(size_t max_bytes);
+    void Add(const std::shared_ptr<const CBlock>& pblock);
+    //! The block with this hash, null when it is not cached
+    std::shared_ptr<const CBlock> Get(const uint256& hash);
+    void Clear();
+    size_t DynamicMemoryUsage() const;
+
+private:
+    struct Entry {
+        std::shared_ptr<const CBlock> pblock;
+        size_t bytes;
+    };
+    typedef std::list<Entry> EntryList;
+
+    void Trim() EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+    mutable Mutex m_mutex;
+    size_t m_max_bytes GUARDED_BY(m_mutex){size_t(DEFAULT_RECENT_BLOCK_CACHE) << 20};
+    size_t m_bytes GUARDED_BY(m_mutex){0};
+    //! Most recently used first
+    EntryList m_entries GUARDED_BY(m_mutex);
+    std::map<uint256, EntryList::iterator> m_by_hash GUARDED_BY(m_mutex);
+};
+
+extern RecentBlockCache g_recent_blocks;
+
+#endif // BITCOIN_BLOCKCACHE_H
@@ -18,13 +18,21 @@
 
 CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block, bool fUseWTXID) :
         nonce(GetRand(std::numeric_limits<uint64_t>::max())),
-        shorttxids(block.vtx.size() - 1), prefilledtxn(1), header(block) {
+        header(block) {
     FillShortTxIDSelector();
-    //TODO: Use our mempool prior to block acceptance to predictively fill more than just the coinbase
-    prefilledtxn[0] = {0, block.vtx[0]};
-    for (size_t i = 1; i < block.vtx.size(); i++) {
+    //TODO: Use our mempool prior to block acceptance to predictively fill more than just the transactions below
+    // The coinbase, the coinstake and the condensing transactions of contract executions (which spend
+    // with OP_SPEND) are made by the block producer and never relayed, no mempool can have them
+    int32_t lastprefilledindex = -1;
+    for (size_t i = 0; i < block.vtx.size(); i++) {
         const CTransaction& tx = *block.vtx[i];
-        shorttxids[i - 1] = GetShortID(fUseWTXID ? tx.GetWitnessHash() : tx.GetHash());
+        if (i == 0 || (i == 1 && block.IsProofOfStake()) || tx.HasOpSpend()) {
+            // indexes are differentially encoded
+            prefilledtxn.push_back({(uint16_t)(i - lastprefilledindex - 1), block.vtx[i]});
+            lastprefilledindex = i;
+        } else {
+            shorttxids.push_back(GetShortID(fUseWTXID ? tx.GetWitnessHash() : tx.GetHash()));
+        }
     }
 }
 
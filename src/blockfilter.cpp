@@ -2,11 +2,14 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <algorithm>
 #include <mutex>
 #include <sstream>
 #include <set>
+#include <thread>
 
 #include <blockfilter.h>
+#include <crypto/common.h>
 #include <crypto/siphash.h>
 #include <hash.h>
 #include <primitives/transaction.h>
@@ -21,6 +24,7 @@ static constexpr int GCS_SER_VERSION = 0;
 
 static const std::map<BlockFilterType, std::string> g_filter_types = {
     {BlockFilterType::BASIC, "basic"},
+    {BlockFilterType::EVM_LOGS, "evmlog"},
 };
 
 template <typename OStream>
@@ -40,19 +44,87 @@ static void GolombRiceEncode(BitStreamWriter<OStream>& bitwriter, uint8_t P, uin
     bitwriter.Write(x, P);
 }
 
-template <typename IStream>
-static uint64_t GolombRiceDecode(BitStreamReader<IStream>& bitreader, uint8_t P)
+/** Filters a thread of GCSFilterQuery::MatchAll matches at least */
+static constexpr size_t MIN_FILTERS_PER_THREAD = 16;
+
+/**
+ * Reads the Golomb-Rice coded values of an encoded filter a 64 bit word at a
+ * time. The unary quotient is counted from the leading ones of the word
+ * instead of bit by bit, and the remainder is taken from it in one shift.
+ */
+class GolombRiceReader
 {
-    // Read unary-encoded quotient: q 1's followed by one 0.
-    uint64_t q = 0;
-    while (bitreader.Read(1) == 1) {
-        ++q;
+private:
+    const unsigned char* m_data;
+    size_t m_size;
+    size_t m_pos{0};
+    /// Bits loaded and not returned yet, the next one in the most significant bit
+    uint64_t m_bits{0};
+    int m_avail{0};
+
+    void Refill()
+    {
+        while (m_avail <= 56 && m_pos < m_size) {
+            m_bits |= static_cast<uint64_t>(m_data[m_pos++]) << (56 - m_avail);
+            m_avail += 8;
+        }
     }
 
-    uint64_t r = bitreader.Read(P);
+    void Skip(int nbits)
+    {
+        m_bits = nbits < 64 ? m_bits << nbits : 0;
+        m_avail -= nbits;
+    }
 
-    return (q << P) + r;
-}
+    /** Read up to 32 bits */
+    uint64_t ReadBits(int nbits)
+    {
+        if (nbits == 0) return 0;
+        Refill();
+        if (m_avail < nbits) {
+            throw std::ios_base::failure("GolombRiceReader: end of data");
+        }
+        uint64_t value = m_bits >> (64 - nbits);
+        Skip(nbits);
+        return value;
+    }
+
+public:
+    GolombRiceReader(const unsigned char* data, size_t size) : m_data(data), m_size(size) {}
+
+    uint64_t Decode(uint8_t P)
+    {
+        // Read unary-encoded quotient: q 1's followed by one 0.
+        uint64_t q = 0;
+        while (true) {
+            Refill();
+            if (m_avail == 0) {
+                throw std::ios_base::failure("GolombRiceReader: end of data");
+            }
+            // The bits past m_avail are 0, so the leading 1's stop there at the latest
+            int ones = 64 - static_cast<int>(CountBits(~m_bits));
+            if (ones < m_avail) {
+                q += ones;
+                Skip(ones + 1);
+                break;
+            }
+            q += m_avail;
+            Skip(m_avail);
+        }
+
+        uint64_t r = 0;
+        for (int left = P; left > 0; ) {
+            int nbits = std::min(left, 32);
+            r = (r << nbits) | ReadBits(nbits);
+            left -= nbits;
+        }
+
+        return (q << P) + r;
+    }
+
+    /** Whether the values read so far needed every byte of the data */
+    bool AtEnd() const { return m_pos == m_size && m_avail < 8; }
+};
 
 // Map a value x that is uniformly distributed in the range [0, 2^64) to a
 // value uniformly distributed in [0, n) by returning the upper 64 bits of
@@ -122,11 +194,12 @@ GCSFilter::GCSFilter(const Params& params, std::vector<unsigned char> encoded_fi
 
     // Verify that the encoded filter contains exactly N elements. If it has too much or too little
     // data, a std::ios_base::failure exception will be raised.
-    BitStreamReader<VectorReader> bitreader(stream);
+    const size_t offset = m_encoded.size() - stream.size();
+    GolombRiceReader reader(m_encoded.data() + offset, m_encoded.size() - offset);
     for (uint64_t i = 0; i < m_N; ++i) {
-        GolombRiceDecode(bitreader, m_params.m_P);
+        reader.Decode(m_params.m_P);
     }
-    if (!stream.empty()) {
+    if (!reader.AtEnd()) {
         throw std::ios_base::failure("encoded_filter contains excess data");
     }
 }
@@ -163,18 +236,14 @@ GCSFilter::GCSFilter(const Params& params, const ElementSet& elements)
 
 bool GCSFilter::MatchInternal(const uint64_t* element_hashes, size_t size) const
 {
-    VectorReader stream(GCS_SER_TYPE, GCS_SER_VERSION, m_encoded, 0);
-
     // Seek forward by size of N
-    uint64_t N = ReadCompactSize(stream);
-    assert(N == m_N);
-
-    BitStreamReader<VectorReader> bitreader(stream);
+    const size_t offset = GetSizeOfCompactSize(m_N);
+    GolombRiceReader reader(m_encoded.data() + offset, m_encoded.size() - offset);
 
     uint64_t value = 0;
     size_t hashes_index = 0;
     for (uint32_t i = 0; i < m_N; ++i) {
-        uint64_t delta = GolombRiceDecode(bitreader, m_params.m_P);
+        uint64_t delta = reader.Decode(m_params.m_P);
         value += delta;
 
         while (true) {
@@ -193,6 +262,27 @@ bool GCSFilter::MatchInternal(const uint64_t* element_hashes, size_t size) const
     return false;
 }
 
+bool GCSFilter::MatchDecoded(const uint64_t* element_hashes, size_t size) const
+{
+    const size_t offset = GetSizeOfCompactSize(m_N);
+    GolombRiceReader reader(m_encoded.data() + offset, m_encoded.size() - offset);
+
+    std::vector<uint64_t> values;
+    values.reserve(m_N);
+    uint64_t value = 0;
+    for (uint32_t i = 0; i < m_N; ++i) {
+        value += reader.Decode(m_params.m_P);
+        values.push_back(value);
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        if (std::binary_search(values.begin(), values.end(), element_hashes[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool GCSFilter::Match(const Element& element) const
 {
     uint64_t query = HashToRange(element);
@@ -205,6 +295,62 @@ bool GCSFilter::MatchAny(const ElementSet& elements) const
     return MatchInternal(queries.data(), queries.size());
 }
 
+bool GCSFilter::MatchAny(const GCSFilterQuery& query) const
+{
+    if (m_N == 0 || query.size() == 0) {
+        return false;
+    }
+
+    const CSipHasher hasher(m_params.m_siphash_k0, m_params.m_siphash_k1);
+    std::vector<uint64_t> queries;
+    queries.reserve(query.size());
+    for (size_t i = 0; i < query.size(); ++i) {
+        uint64_t hash = CSipHasher(hasher).Write(query.data(i), query.length(i)).Finalize();
+        queries.push_back(MapIntoRange(hash, m_F));
+    }
+
+    // With more elements than the filter has, as a wallet against a block, decoding the
+    // filter once and searching it costs less than sorting the element hashes
+    if (queries.size() > m_N) {
+        return MatchDecoded(queries.data(), queries.size());
+    }
+    std::sort(queries.begin(), queries.end());
+    return MatchInternal(queries.data(), queries.size());
+}
+
+GCSFilterQuery::GCSFilterQuery(const GCSFilter::ElementSet& elements)
+{
+    m_offsets.reserve(elements.size() + 1);
+    for (const GCSFilter::Element& element : elements) {
+        m_offsets.push_back(m_data.size());
+        m_data.insert(m_data.end(), element.begin(), element.end());
+    }
+    m_offsets.push_back(m_data.size());
+}
+
+std::vector<unsigned char> GCSFilterQuery::MatchAll(const std::vector<const GCSFilter*>& filters, int n_threads) const
+{
+    std::vector<unsigned char> matches(filters.size(), 0);
+    auto match_range = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            matches[i] = filters[i]->MatchAny(*this);
+        }
+    };
+
+    // consecutive filters per thread
+    const size_t n_lanes = std::max<size_t>(1, std::min<size_t>(std::max(n_threads, 1), filters.size() / MIN_FILTERS_PER_THREAD));
+    const size_t per_lane = (filters.size() + n_lanes - 1) / n_lanes;
+    std::vector<std::thread> threads;
+    for (size_t lane = 1; lane < n_lanes; ++lane) {
+        threads.emplace_back(match_range, std::min(filters.size(), lane * per_lane), std::min(filters.size(), (lane + 1) * per_lane));
+    }
+    match_range(0, std::min(filters.size(), per_lane));
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    return matches;
+}
+
 const std::string& BlockFilterTypeName(BlockFilterType filter_type)
 {
     static std::string unknown_retval = "";
@@ -293,6 +439,9 @@ BlockFilter::BlockFilter(BlockFilterType filter_type, const uint256& block_hash,
 BlockFilter::BlockFilter(BlockFilterType filter_type, const CBlock& block, const CBlockUndo& block_undo)
     : m_filter_type(filter_type), m_block_hash(block.GetHash())
 {
+    if (filter_type != BlockFilterType::BASIC) {
+        throw std::invalid_argument("filter_type is not built from the block outputs");
+    }
     GCSFilter::Params params;
     if (!BuildParams(params)) {
         throw std::invalid_argument("unknown filter_type");
@@ -300,6 +449,17 @@ BlockFilter::BlockFilter(BlockFilterType filter_type, const CBlock& block, const
     m_filter = GCSFilter(params, BasicFilterElements(block, block_undo));
 }
 
+BlockFilter::BlockFilter(BlockFilterType filter_type, const uint256& block_hash,
+                         const GCSFilter::ElementSet& elements)
+    : m_filter_type(filter_type), m_block_hash(block_hash)
+{
+    GCSFilter::Params params;
+    if (!BuildParams(params)) {
+        throw std::invalid_argument("unknown filter_type");
+    }
+    m_filter = GCSFilter(params, elements);
+}
+
 bool BlockFilter::BuildParams(GCSFilter::Params& params) const
 {
     switch (m_filter_type) {
@@ -309,6 +469,12 @@ bool BlockFilter::BuildParams(GCSFilter::Params& params) const
         params.m_P = BASIC_FILTER_P;
         params.m_M = BASIC_FILTER_M;
         return true;
+    case BlockFilterType::EVM_LOGS:
+        params.m_siphash_k0 = m_block_hash.GetUint64(0);
+        params.m_siphash_k1 = m_block_hash.GetUint64(1);
+        params.m_P = EVMLOG_FILTER_P;
+        params.m_M = EVMLOG_FILTER_M;
+        return true;
     case BlockFilterType::INVALID:
         return false;
     }
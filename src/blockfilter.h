@@ -21,6 +21,8 @@
  * This implements a Golomb-coded set as defined in BIP 158. It is a
  * compact, probabilistic data structure for testing set membership.
  */
+class GCSFilterQuery;
+
 class GCSFilter
 {
 public:
@@ -53,6 +55,9 @@ private:
     /** Helper method used to implement Match and MatchAny */
     bool MatchInternal(const uint64_t* sorted_element_hashes, size_t size) const;
 
+    /** Decode the whole filter into its sorted values and look each element hash up among them */
+    bool MatchDecoded(const uint64_t* element_hashes, size_t size) const;
+
 public:
 
     /** Constructs an empty filter. */
@@ -80,14 +85,50 @@ public:
      * efficient that checking Match on multiple elements separately.
      */
     bool MatchAny(const ElementSet& elements) const;
+
+    /** MatchAny with elements laid out once for many filters, see GCSFilterQuery. */
+    bool MatchAny(const GCSFilterQuery& query) const;
+};
+
+/**
+ * A set of elements prepared to be matched against many filters, such as the
+ * scripts of a wallet against the filters of the blocks it rescans. The
+ * elements are hashed with the keys of each filter, so only their layout is
+ * shared, but matching reuses it without walking the hash set again.
+ */
+class GCSFilterQuery
+{
+private:
+    std::vector<unsigned char> m_data;
+    //! Start of each element in m_data, followed by the end of the last
+    std::vector<size_t> m_offsets;
+
+public:
+    explicit GCSFilterQuery(const GCSFilter::ElementSet& elements);
+
+    size_t size() const { return m_offsets.size() - 1; }
+    const unsigned char* data(size_t i) const { return m_data.data() + m_offsets[i]; }
+    size_t length(size_t i) const { return m_offsets[i + 1] - m_offsets[i]; }
+
+    /**
+     * Match against every filter on up to n_threads threads. Entry i of the
+     * result is set when filters[i] may contain one of the elements.
+     */
+    std::vector<unsigned char> MatchAll(const std::vector<const GCSFilter*>& filters, int n_threads) const;
 };
 
 constexpr uint8_t BASIC_FILTER_P = 19;
 constexpr uint32_t BASIC_FILTER_M = 784931;
 
+constexpr uint8_t EVMLOG_FILTER_P = 19;
+constexpr uint32_t EVMLOG_FILTER_M = 784931;
+
 enum class BlockFilterType : uint8_t
 {
     BASIC = 0,
+    /// The contract address (20 bytes) and each topic (32 bytes) of the EVM logs in the block
+    /// receipts, as separate elements. Built by the filter index, it requires -logevents.
+    EVM_LOGS = 1,
     INVALID = 255,
 };
 
@@ -124,9 +165,13 @@ public:
     BlockFilter(BlockFilterType filter_type, const uint256& block_hash,
                 std::vector<unsigned char> filter);
 
-    //! Construct a new BlockFilter of the specified type from a block.
+    //! Construct a new BASIC BlockFilter from a block.
     BlockFilter(BlockFilterType filter_type, const CBlock& block, const CBlockUndo& block_undo);
 
+    //! Construct a new BlockFilter of the specified type from the elements of a block.
+    BlockFilter(BlockFilterType filter_type, const uint256& block_hash,
+                const GCSFilter::ElementSet& elements);
+
     BlockFilterType GetFilterType() const { return m_filter_type; }
     const uint256& GetBlockHash() const { return m_block_hash; }
     const GCSFilter& GetFilter() const { return m_filter; }
@@ -144,8 +189,8 @@ public:
 
     template <typename Stream>
     void Serialize(Stream& s) const {
-        s << m_block_hash
-          << static_cast<uint8_t>(m_filter_type)
+        s << static_cast<uint8_t>(m_filter_type)
+          << m_block_hash
           << m_filter.GetEncoded();
     }
 
@@ -154,8 +199,8 @@ public:
         std::vector<unsigned char> encoded_filter;
         uint8_t filter_type;
 
-        s >> m_block_hash
-          >> filter_type
+        s >> filter_type
+          >> m_block_hash
           >> encoded_filter;
 
         m_filter_type = static_cast<BlockFilterType>(filter_type);
@@ -11,11 +11,14 @@
 void CChain::SetTip(CBlockIndex *pindex) {
     if (pindex == nullptr) {
         vChain.clear();
+        vTime.clear();
         return;
     }
     vChain.resize(pindex->nHeight + 1);
+    vTime.resize(pindex->nHeight + 1);
     while (pindex && vChain[pindex->nHeight] != pindex) {
         vChain[pindex->nHeight] = pindex;
+        vTime[pindex->nHeight] = pindex->nTime;
         pindex = pindex->pprev;
     }
 }
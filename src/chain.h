@@ -131,6 +131,11 @@ enum BlockStatus: uint32_t {
     BLOCK_OPT_WITNESS       =   128, //!< block data in blk*.data was received with a witness-enforcing client
 };
 
+class CBlockIndex;
+
+/** Read the signature of a proof-of-stake block index entry from the block tree database */
+bool ReadBlockIndexSignature(const CBlockIndex& index, std::vector<unsigned char>& vchBlockSig);
+
 /** The block chain is a tree shaped structure starting with the
  * genesis block at the root, with each block potentially having multiple
  * candidates to be the next block. A blockindex may have multiple pprev pointing
@@ -187,6 +192,8 @@ public:
     uint256 hashStateRoot; // qtum
     uint256 hashUTXORoot; // qtum
     // block signature - proof-of-stake protect the block by signing the block using a stake holder private key
+    // Only kept until the entry is written to the block tree database, it is read back from there (or from a
+    // small cache of recent reads) when it is needed, see GetBlockHeader().
     std::vector<unsigned char> vchBlockSig;
     uint256 nStakeModifier;
     // proof-of-stake specific fields
@@ -286,6 +293,8 @@ public:
         block.hashUTXORoot   = hashUTXORoot; // qtum
         block.vchBlockSig    = vchBlockSig;
         block.prevoutStake   = prevoutStake;
+        if (block.vchBlockSig.empty() && IsProofOfStake())
+            ReadBlockIndexSignature(*this, block.vchBlockSig);
         return block;
     }
 
@@ -465,6 +474,8 @@ public:
 class CChain {
 private:
     std::vector<CBlockIndex*> vChain;
+    //! nTime of the blocks in vChain, read by the stake kernel checks without following the pointers
+    std::vector<uint32_t> vTime;
 
 public:
     /** Returns the index entry for the genesis block of this chain, or nullptr if none. */
@@ -484,6 +495,11 @@ public:
         return vChain[nHeight];
     }
 
+    /** Returns the time of the block at a particular height in this chain, which must exist. */
+    uint32_t TimeAt(int nHeight) const {
+        return vTime[nHeight];
+    }
+
     /** Compare two chains efficiently. */
     friend bool operator==(const CChain &a, const CChain &b) {
         return a.vChain.size() == b.vChain.size() &&
@@ -8,6 +8,10 @@
 #include <sync.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
@@ -16,6 +20,11 @@
 template <typename T>
 class CCheckQueueControl;
 
+/** Number of independently locked parts the pending checks are spread over */
+static const unsigned int CHECKQUEUE_SHARDS = 16;
+/** Times an idle thread looks for new checks before it sleeps */
+static const unsigned int CHECKQUEUE_SPINS = 2000;
+
 /**
  * Queue for verifications that have to be performed.
   * The verifications are represented by a type T, which must provide an
@@ -25,12 +34,35 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * The pending checks are spread over CHECKQUEUE_SHARDS shards with a lock
+  * each. Every thread takes from its own shard first and steals from the
+  * others when it runs dry, so threads rarely contend for the same lock.
+  * Idle threads spin for a while before they sleep, which saves the wakeup
+  * latency between the transactions of a block.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
+    struct Shard
+    {
+        std::mutex mutex;
+        //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
+        std::vector<T> checks;
+        //! Size of checks, read without the lock to skip empty shards
+        std::atomic<size_t> size{0};
+    };
+
+    std::array<Shard, CHECKQUEUE_SHARDS> shards;
+
+    //! Shard the next thread to enter takes from first
+    std::atomic<unsigned int> nNextHome{0};
+
+    //! Shard the next added batch goes to
+    std::atomic<unsigned int> nNextAdd{0};
+
+    //! Mutex the idle threads sleep with
     boost::mutex mutex;
 
     //! Worker threads block on this when out of work
@@ -39,88 +71,107 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
+    //! The number of checks queued in the shards.
+    std::atomic<unsigned int> nQueued{0};
 
-    //! The number of workers (including the master) that are idle.
-    int nIdle;
+    //! The number of workers (including the master) that are asleep.
+    std::atomic<int> nIdle{0};
 
     //! The total number of workers (including the master).
-    int nTotal;
+    std::atomic<int> nTotal{0};
 
     //! The temporary evaluation result.
-    bool fAllOk;
+    std::atomic<bool> fAllOk{true};
 
     /**
      * Number of verifications that haven't completed yet.
      * This includes elements that are no longer queued, but still in the
      * worker's own batches.
      */
-    unsigned int nTodo;
+    std::atomic<unsigned int> nTodo{0};
 
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    /** Move a batch of checks from shard into vChecks, returning how many */
+    unsigned int Take(Shard& shard, std::vector<T>& vChecks)
+    {
+        if (shard.size.load(std::memory_order_relaxed) == 0)
+            return 0;
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        // Aim for smaller batches as the shard empties so all workers finish approximately simultaneously
+        const unsigned int nNow = std::min<size_t>(shard.checks.size(), std::max(1U, std::min(nBatchSize, (unsigned int)shard.checks.size() / 2)));
+        vChecks.resize(nNow);
+        for (unsigned int i = 0; i < nNow; i++) {
+            // swap jobs from the shard to the local batch vector instead of copying
+            vChecks[i].swap(shard.checks.back());
+            shard.checks.pop_back();
+        }
+        shard.size.store(shard.checks.size(), std::memory_order_relaxed);
+        nQueued -= nNow;
+        return nNow;
+    }
+
+    /** Take a batch from the home shard, or steal one from the others */
+    unsigned int TakeAny(unsigned int nHome, std::vector<T>& vChecks)
+    {
+        for (unsigned int i = 0; i < CHECKQUEUE_SHARDS; i++) {
+            const unsigned int nNow = Take(shards[(nHome + i) % CHECKQUEUE_SHARDS], vChecks);
+            if (nNow)
+                return nNow;
+        }
+        return 0;
+    }
+
     /** Internal function that does bulk of the verification work. */
     bool Loop(bool fMaster = false)
     {
-        boost::condition_variable& cond = fMaster ? condMaster : condWorker;
+        const unsigned int nHome = nNextHome++ % CHECKQUEUE_SHARDS;
         std::vector<T> vChecks;
         vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
-        do {
-            {
+        nTotal++;
+        while (true) {
+            unsigned int nNow = TakeAny(nHome, vChecks);
+            for (unsigned int nSpins = 0; nNow == 0 && nSpins < CHECKQUEUE_SPINS; nSpins++) {
+                if (fMaster && nTodo == 0)
+                    break;
+                std::this_thread::yield();
+                nNow = TakeAny(nHome, vChecks);
+            }
+            if (nNow == 0) {
                 boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master it can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
-                }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if (fMaster && nTodo == 0) {
+                if (fMaster) {
+                    while (nTodo != 0 && nQueued == 0)
+                        condMaster.wait(lock);
+                    if (nTodo == 0) {
                         nTotal--;
-                        bool fRet = fAllOk;
-                        // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
-                        // return the current status
-                        return fRet;
+                        // return the current status and reset it for new work later
+                        return fAllOk.exchange(true);
                     }
+                } else {
+                    // Add checks nIdle after raising nQueued, so either it sees us or we see the checks
                     nIdle++;
-                    cond.wait(lock); // wait
+                    while (nQueued == 0)
+                        condWorker.wait(lock); // wait
                     nIdle--;
                 }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
-                }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
+                continue;
             }
-            // execute work
+            // execute work, unless a check already failed
+            bool fOk = fAllOk;
             for (T& check : vChecks)
                 if (fOk)
                     fOk = check();
+            if (!fOk)
+                fAllOk = false;
+            // the checks are destroyed before they count as done
             vChecks.clear();
-        } while (true);
+            if (nTodo.fetch_sub(nNow) == nNow && !fMaster) {
+                // We processed the last element; inform the master it can exit and return the result
+                boost::unique_lock<boost::mutex> lock(mutex);
+                condMaster.notify_one();
+            }
+        }
     }
 
 public:
@@ -128,7 +179,7 @@ public:
     boost::mutex ControlMutex;
 
     //! Create a new check queue
-    explicit CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), nBatchSize(nBatchSizeIn) {}
+    explicit CCheckQueue(unsigned int nBatchSizeIn) : nBatchSize(nBatchSizeIn) {}
 
     //! Worker thread
     void Thread()
@@ -145,16 +196,32 @@ public:
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        for (T& check : vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
-        }
+        if (vChecks.empty())
+            return;
         nTodo += vChecks.size();
-        if (vChecks.size() == 1)
-            condWorker.notify_one();
-        else if (vChecks.size() > 1)
-            condWorker.notify_all();
+        // Large batches are split over the shards, small ones go to the next shard in turn
+        const size_t nChunk = std::max<size_t>(nBatchSize, (vChecks.size() + CHECKQUEUE_SHARDS - 1) / CHECKQUEUE_SHARDS);
+        for (size_t nBegin = 0; nBegin < vChecks.size(); nBegin += nChunk) {
+            const size_t nEnd = std::min(vChecks.size(), nBegin + nChunk);
+            Shard& shard = shards[nNextAdd++ % CHECKQUEUE_SHARDS];
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                for (size_t i = nBegin; i < nEnd; i++) {
+                    shard.checks.emplace_back();
+                    vChecks[i].swap(shard.checks.back());
+                }
+                shard.size.store(shard.checks.size(), std::memory_order_relaxed);
+                // counted under the shard lock so takers never see it drop below zero
+                nQueued += nEnd - nBegin;
+            }
+        }
+        if (nIdle > 0) {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (vChecks.size() == 1)
+                condWorker.notify_one();
+            else
+                condWorker.notify_all();
+        }
     }
 
     ~CCheckQueue()
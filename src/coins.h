@@ -12,6 +12,7 @@
 #include <crypto/siphash.h>
 #include <memusage.h>
 #include <serialize.h>
+#include <support/allocators/pool.h>
 #include <uint256.h>
 
 #include <assert.h>
@@ -212,7 +213,23 @@ struct CCoinsCacheEntry
     explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+/**
+ * PoolAllocator's MAX_BLOCK_SIZE_BYTES parameter here uses sizeof the data, and adds the size
+ * of 4 pointers. We do not know the exact node size used in the std::unordered_node implementation
+ * because it is implementation defined. Most implementations have an overhead of 1 or 2 pointers,
+ * so nodes can be connected in a linked list, and in some cases the hash value is stored as well.
+ * Using an additional sizeof(void*)*4 for MAX_BLOCK_SIZE_BYTES should thus be sufficient so that
+ * all implementations can allocate the nodes from the PoolAllocator.
+ */
+using CCoinsMap = std::unordered_map<COutPoint,
+                                     CCoinsCacheEntry,
+                                     SaltedOutpointHasher,
+                                     std::equal_to<COutPoint>,
+                                     PoolAllocator<std::pair<const COutPoint, CCoinsCacheEntry>,
+                                                   sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) + sizeof(void*) * 4,
+                                                   alignof(void*)>>;
+
+using CCoinsMapMemoryResource = CCoinsMap::allocator_type::ResourceType;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -299,6 +316,8 @@ protected:
      * declared as "const".
      */
     mutable uint256 hashBlock;
+    /* The nodes of cacheCoins are carved out of the chunks of this resource, see ReallocateCache(). */
+    mutable CCoinsMapMemoryResource m_cache_coins_memory_resource{};
     mutable CCoinsMap cacheCoins;
 
     /* Cached dynamic memory usage for the inner Coin objects. */
@@ -329,6 +348,13 @@ public:
      */
     bool HaveCoinInCache(const COutPoint &outpoint) const;
 
+    /**
+     * Cache a coin that was read from the base view outside of this cache, as an
+     * unmodified entry. The caller must make sure coin is what the base view holds
+     * for outpoint. Outpoints that are already cached are left alone.
+     */
+    void CacheBaseCoin(const COutPoint &outpoint, Coin&& coin);
+
     /**
      * Return a reference to Coin in the cache, or a pruned one if not found. This is
      * more efficient than GetCoin.
@@ -370,6 +396,9 @@ public:
     //! Calculate the size of the cache (in number of transaction outputs)
     unsigned int GetCacheSize() const;
 
+    //! Free the memory of an empty cache at once by recreating the map and its pool resource.
+    void ReallocateCache();
+
     //! Calculate the size of the cache (in bytes)
     size_t DynamicMemoryUsage() const;
 
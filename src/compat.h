@@ -93,6 +93,8 @@ typedef char* sockopt_arg_type;
 // __APPLE__ poll is broke https://github.com/bitcoin/bitcoin/pull/14336#issuecomment-437384408
 #if defined(__linux__)
 #define USE_POLL
+// epoll keeps the sockets registered between waits, see CConnman::SocketEventsEpoll
+#define USE_EPOLL
 #endif
 
 bool static inline IsSelectableSocket(const SOCKET& s) {
@@ -0,0 +1,209 @@
+// Copyright (c) 2017-2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/muhash.h>
+
+#include <crypto/chacha20.h>
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+
+#include <limits>
+
+namespace {
+
+using limb_t = Num3072::limb_t;
+using double_limb_t = Num3072::double_limb_t;
+constexpr int LIMB_SIZE = Num3072::LIMB_SIZE;
+constexpr int LIMBS = Num3072::LIMBS;
+/** 2^3072 - 1103717, the largest 3072-bit safe prime number, is used as the modulus. */
+constexpr limb_t MAX_PRIME_DIFF = 1103717;
+/** Bits of the exponent handled per multiplication by a table entry in GetInverse. */
+constexpr int INVERSE_WINDOW = 4;
+
+} // namespace
+
+bool Num3072::IsOverflow() const
+{
+    if (this->limbs[0] <= std::numeric_limits<limb_t>::max() - MAX_PRIME_DIFF) return false;
+    for (int i = 1; i < LIMBS; ++i) {
+        if (this->limbs[i] != std::numeric_limits<limb_t>::max()) return false;
+    }
+    return true;
+}
+
+void Num3072::FullReduce()
+{
+    // x - p = x + MAX_PRIME_DIFF - 2^3072, so add and drop the carry out of the top limb
+    double_limb_t c = MAX_PRIME_DIFF;
+    for (int i = 0; i < LIMBS; ++i) {
+        c += this->limbs[i];
+        this->limbs[i] = (limb_t)c;
+        c >>= LIMB_SIZE;
+    }
+}
+
+void Num3072::Reduce(const limb_t (&product)[2 * LIMBS])
+{
+    // 2^3072 = MAX_PRIME_DIFF (mod p), fold the upper half into the lower half
+    limb_t carry = 0;
+    for (int i = 0; i < LIMBS; ++i) {
+        double_limb_t t = (double_limb_t)product[LIMBS + i] * MAX_PRIME_DIFF + product[i] + carry;
+        this->limbs[i] = (limb_t)t;
+        carry = t >> LIMB_SIZE;
+    }
+
+    // The carry is at most MAX_PRIME_DIFF, fold it in the same way
+    double_limb_t c = (double_limb_t)carry * MAX_PRIME_DIFF;
+    for (int i = 0; i < LIMBS; ++i) {
+        c += this->limbs[i];
+        this->limbs[i] = (limb_t)c;
+        c >>= LIMB_SIZE;
+    }
+
+    // A carry out of the top limb leaves a small number behind, adding once more cannot carry again
+    if (c) {
+        c = MAX_PRIME_DIFF;
+        for (int i = 0; i < LIMBS && c; ++i) {
+            c += this->limbs[i];
+            this->limbs[i] = (limb_t)c;
+            c >>= LIMB_SIZE;
+        }
+    }
+
+    if (this->IsOverflow()) this->FullReduce();
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    limb_t product[2 * LIMBS];
+    for (int j = 0; j < LIMBS; ++j) {
+        product[j] = 0;
+    }
+    for (int i = 0; i < LIMBS; ++i) {
+        limb_t carry = 0;
+        for (int j = 0; j < LIMBS; ++j) {
+            double_limb_t t = (double_limb_t)this->limbs[i] * a.limbs[j] + product[i + j] + carry;
+            product[i + j] = (limb_t)t;
+            carry = t >> LIMB_SIZE;
+        }
+        product[i + LIMBS] = carry;
+    }
+    Reduce(product);
+}
+
+Num3072 Num3072::GetInverse() const
+{
+    // Fermat's little theorem: x^(p-2) = x^-1 (mod p). The exponent is all ones
+    // apart from the low limb, and is processed from the top in fixed windows.
+    Num3072 table[1 << INVERSE_WINDOW];
+    table[1] = *this;
+    for (int i = 2; i < (1 << INVERSE_WINDOW); ++i) {
+        table[i] = table[i - 1];
+        table[i].Multiply(*this);
+    }
+
+    Num3072 exponent;
+    for (int i = 0; i < LIMBS; ++i) {
+        exponent.limbs[i] = std::numeric_limits<limb_t>::max();
+    }
+    exponent.limbs[0] -= MAX_PRIME_DIFF + 1;
+
+    Num3072 out;
+    for (int bit = LIMBS * LIMB_SIZE - INVERSE_WINDOW; bit >= 0; bit -= INVERSE_WINDOW) {
+        for (int i = 0; i < INVERSE_WINDOW; ++i) {
+            out.Multiply(out);
+        }
+        int window = (exponent.limbs[bit / LIMB_SIZE] >> (bit % LIMB_SIZE)) & ((1 << INVERSE_WINDOW) - 1);
+        if (window) out.Multiply(table[window]);
+    }
+    return out;
+}
+
+void Num3072::Divide(const Num3072& a)
+{
+    if (this->IsOverflow()) this->FullReduce();
+    this->Multiply(a.GetInverse());
+    if (this->IsOverflow()) this->FullReduce();
+}
+
+void Num3072::SetToOne()
+{
+    this->limbs[0] = 1;
+    for (int i = 1; i < LIMBS; ++i) {
+        this->limbs[i] = 0;
+    }
+}
+
+Num3072::Num3072(const unsigned char (&data)[BYTE_SIZE])
+{
+    for (int i = 0; i < LIMBS; ++i) {
+        if (sizeof(limb_t) == 4) {
+            this->limbs[i] = ReadLE32(data + 4 * i);
+        } else if (sizeof(limb_t) == 8) {
+            this->limbs[i] = ReadLE64(data + 8 * i);
+        }
+    }
+}
+
+void Num3072::ToBytes(unsigned char (&out)[BYTE_SIZE]) const
+{
+    for (int i = 0; i < LIMBS; ++i) {
+        if (sizeof(limb_t) == 4) {
+            WriteLE32(out + i * 4, this->limbs[i]);
+        } else if (sizeof(limb_t) == 8) {
+            WriteLE64(out + i * 8, this->limbs[i]);
+        }
+    }
+}
+
+Num3072 MuHash3072::ToNum3072(Span<const unsigned char> in)
+{
+    unsigned char tmp[Num3072::BYTE_SIZE];
+    unsigned char hashed_in[CSHA256::OUTPUT_SIZE];
+
+    CSHA256().Write(in.data(), in.size()).Finalize(hashed_in);
+    ChaCha20(hashed_in, sizeof(hashed_in)).Keystream(tmp, Num3072::BYTE_SIZE);
+    return Num3072(tmp);
+}
+
+MuHash3072::MuHash3072(Span<const unsigned char> in) noexcept
+{
+    m_numerator = ToNum3072(in);
+}
+
+void MuHash3072::Finalize(uint256& out) noexcept
+{
+    m_numerator.Divide(m_denominator);
+    m_denominator.SetToOne();  // Needed to keep the MuHash object valid
+
+    unsigned char data[Num3072::BYTE_SIZE];
+    m_numerator.ToBytes(data);
+
+    CSHA256().Write(data, sizeof(data)).Finalize(out.begin());
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& mul) noexcept
+{
+    m_numerator.Multiply(mul.m_numerator);
+    m_denominator.Multiply(mul.m_denominator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator/=(const MuHash3072& div) noexcept
+{
+    m_numerator.Multiply(div.m_denominator);
+    m_denominator.Multiply(div.m_numerator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::Insert(Span<const unsigned char> in) noexcept
+{
+    m_numerator.Multiply(ToNum3072(in));
+    return *this;
+}
+
+MuHash3072& MuHash3072::Remove(Span<const unsigned char> in) noexcept {
+    m_denominator.Multiply(ToNum3072(in));
+    return *this;
+}
@@ -0,0 +1,136 @@
+// Copyright (c) 2017-2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_MUHASH_H
+#define BITCOIN_CRYPTO_MUHASH_H
+
+#include <serialize.h>
+#include <span.h>
+#include <uint256.h>
+
+#include <stdint.h>
+
+/** A class representing MuHash sets, numbers modulo 2^3072 - 1103717 */
+class Num3072
+{
+public:
+    static constexpr size_t BYTE_SIZE = 384;
+
+#ifdef __SIZEOF_INT128__
+    typedef unsigned __int128 double_limb_t;
+    typedef uint64_t limb_t;
+    static constexpr int LIMBS = 48;
+    static constexpr int LIMB_SIZE = 64;
+#else
+    typedef uint64_t double_limb_t;
+    typedef uint32_t limb_t;
+    static constexpr int LIMBS = 96;
+    static constexpr int LIMB_SIZE = 32;
+#endif
+    limb_t limbs[LIMBS];
+
+    // Sanity check for Num3072 constants
+    static_assert(LIMB_SIZE * LIMBS == 3072, "Num3072 isn't 3072 bits");
+    static_assert(sizeof(double_limb_t) == sizeof(limb_t) * 2, "bad size for double_limb_t");
+    static_assert(sizeof(limb_t) * 8 == LIMB_SIZE, "LIMB_SIZE is incorrect");
+
+    void Multiply(const Num3072& a);
+    void Divide(const Num3072& a);
+    void SetToOne();
+    void ToBytes(unsigned char (&out)[BYTE_SIZE]) const;
+
+    Num3072() { SetToOne(); }
+    explicit Num3072(const unsigned char (&data)[BYTE_SIZE]);
+
+    //! Serialized as the little-endian bytes, so the format does not depend on the limb size.
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        unsigned char data[BYTE_SIZE];
+        ToBytes(data);
+        s.write((const char*)data, BYTE_SIZE);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        unsigned char data[BYTE_SIZE];
+        s.read((char*)data, BYTE_SIZE);
+        *this = Num3072(data);
+    }
+
+private:
+    //! Whether the number is at least the modulus.
+    bool IsOverflow() const;
+    //! Subtract the modulus, only valid when IsOverflow().
+    void FullReduce();
+    //! Reduce a double-width product into this number.
+    void Reduce(const limb_t (&product)[2 * LIMBS]);
+    Num3072 GetInverse() const;
+};
+
+/** A class representing MuHash sets
+ *
+ * MuHash is a hashing algorithm that supports adding set elements in any
+ * order but also deleting in any order. As a result, it can maintain a
+ * running sum for a set of data as a whole, and add/remove when data
+ * is added to or removed from it. A downside of MuHash is that computing
+ * an inverse is relatively expensive. This is solved by representing
+ * the running value as a fraction, and multiplying added elements into
+ * the numerator and removed elements into the denominator. Only when the
+ * final hash is desired, a single modular inverse and multiplication is
+ * needed to combine the two.
+ *
+ * As the update operations are also associative, H(a)+H(b)+H(c)+H(d) can
+ * in fact be computed as (H(a)+H(b)) + (H(c)+H(d)). This implies that
+ * all of this is perfectly parallellizable: each thread can process an
+ * arbitrary subset of the update operations, allowing them to be
+ * efficiently combined later.
+ *
+ * An element is hashed to a number modulo 2^3072 - 1103717 by taking its
+ * SHA256 as a ChaCha20 key and using the first 384 bytes of the keystream.
+ * The set hash is the SHA256 of the 384-byte little-endian representation
+ * of the product. See https://cseweb.ucsd.edu/~mihir/papers/inchash.pdf for
+ * the construction and its security.
+ */
+class MuHash3072
+{
+private:
+    Num3072 m_numerator;
+    Num3072 m_denominator;
+
+    Num3072 ToNum3072(Span<const unsigned char> in);
+
+public:
+    /* The empty set. */
+    MuHash3072() noexcept {};
+
+    /* A singleton with variable sized data in it. */
+    explicit MuHash3072(Span<const unsigned char> in) noexcept;
+
+    /* Insert a single piece of data into the set. */
+    MuHash3072& Insert(Span<const unsigned char> in) noexcept;
+
+    /* Remove a single piece of data from the set. */
+    MuHash3072& Remove(Span<const unsigned char> in) noexcept;
+
+    /* Multiply (resulting in a hash for the union of the sets) */
+    MuHash3072& operator*=(const MuHash3072& mul) noexcept;
+
+    /* Divide (resulting in a hash for the difference of the sets) */
+    MuHash3072& operator/=(const MuHash3072& div) noexcept;
+
+    /* Finalize into a 32-byte hash. Does not change this object's value. */
+    void Finalize(uint256& out) noexcept;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(m_numerator);
+        READWRITE(m_denominator);
+    }
+};
+
+#endif // BITCOIN_CRYPTO_MUHASH_H
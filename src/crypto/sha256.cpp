@@ -7,7 +7,9 @@
 
 #include <assert.h>
 #include <string.h>
+#include <algorithm>
 #include <atomic>
+#include <vector>
 
 #if defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
 #if defined(USE_ASM)
@@ -22,11 +24,13 @@ void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks);
 namespace sha256d64_sse41
 {
 void Transform_4way(unsigned char* out, const unsigned char* in);
+void TransformLanes_4way(uint32_t* s, const unsigned char* const* chunks);
 }
 
 namespace sha256d64_avx2
 {
 void Transform_8way(unsigned char* out, const unsigned char* in);
+void TransformLanes_8way(uint32_t* s, const unsigned char* const* chunks);
 }
 
 namespace sha256d64_shani
@@ -416,6 +420,7 @@ void TransformD64(unsigned char* out, const unsigned char* in)
 
 typedef void (*TransformType)(uint32_t*, const unsigned char*, size_t);
 typedef void (*TransformD64Type)(unsigned char*, const unsigned char*);
+typedef void (*TransformLanesType)(uint32_t*, const unsigned char* const*);
 
 template<TransformType tr>
 void TransformD64Wrapper(unsigned char* out, const unsigned char* in)
@@ -461,6 +466,8 @@ TransformD64Type TransformD64 = sha256::TransformD64;
 TransformD64Type TransformD64_2way = nullptr;
 TransformD64Type TransformD64_4way = nullptr;
 TransformD64Type TransformD64_8way = nullptr;
+TransformLanesType TransformLanes_4way = nullptr;
+TransformLanesType TransformLanes_8way = nullptr;
 
 bool SelfTest() {
     // Input state (equal to the initial SHA256 state)
@@ -544,6 +551,24 @@ bool SelfTest() {
         if (!std::equal(out, out + 256, result_d64)) return false;
     }
 
+    // Test the lane transforms, if available: lane i continues the state after i blocks with block i.
+    for (size_t lanes : {4, 8}) {
+        TransformLanesType tr = lanes == 4 ? TransformLanes_4way : TransformLanes_8way;
+        if (!tr) continue;
+        uint32_t state[64];
+        const unsigned char* chunks[8];
+        for (size_t i = 0; i < lanes; ++i) {
+            for (size_t w = 0; w < 8; ++w) state[w * lanes + i] = result[i][w];
+            chunks[i] = data + 1 + 64 * i;
+        }
+        tr(state, chunks);
+        for (size_t i = 0; i < lanes; ++i) {
+            for (size_t w = 0; w < 8; ++w) {
+                if (state[w * lanes + i] != result[i + 1][w]) return false;
+            }
+        }
+    }
+
     return true;
 }
 
@@ -622,6 +647,7 @@ std::string SHA256AutoDetect()
 #endif
 #if defined(ENABLE_SSE41) && !defined(BUILD_BITCOIN_INTERNAL)
         TransformD64_4way = sha256d64_sse41::Transform_4way;
+        TransformLanes_4way = sha256d64_sse41::TransformLanes_4way;
         ret += ",sse41(4way)";
 #endif
     }
@@ -629,6 +655,7 @@ std::string SHA256AutoDetect()
 #if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
     if (have_avx2 && have_avx && enabled_avx) {
         TransformD64_8way = sha256d64_avx2::Transform_8way;
+        TransformLanes_8way = sha256d64_avx2::TransformLanes_8way;
         ret += ",avx2(8way)";
     }
 #endif
@@ -638,6 +665,100 @@ std::string SHA256AutoDetect()
     return ret;
 }
 
+namespace {
+
+/** A message hashed by one lane of a multi-way transform. */
+struct Lane
+{
+    size_t msg;                 //!< index of the message, count when the lane is idle
+    const unsigned char* data;  //!< next full block of the message
+    size_t blocks;              //!< full blocks of the message left
+    unsigned char tail[128];    //!< the last partial block and the padding, later the padded first hash
+    const unsigned char* next;  //!< next block of tail
+    size_t tail_blocks;         //!< blocks of tail left
+    bool second;                //!< hashing the first hash
+};
+
+/** Double-SHA256 of many messages, each lane of tr hashing one message after the other. */
+template<size_t LANES>
+void SHA256DLanes(TransformLanesType tr, unsigned char* output, const uint32_t* const* states, const uint64_t* offsets, const unsigned char* const* inputs, const size_t* lengths, size_t count)
+{
+    static const unsigned char idle[64] = {0};
+    uint32_t s[8 * LANES];
+    Lane lanes[LANES];
+    const unsigned char* chunks[LANES];
+    size_t next = 0;
+
+    auto start = [&](size_t l) {
+        Lane& lane = lanes[l];
+        lane.msg = next;
+        if (next == count) return;
+        const size_t i = next++;
+        uint32_t init[8];
+        if (states) {
+            std::copy(states[i], states[i] + 8, init);
+        } else {
+            sha256::Initialize(init);
+        }
+        for (size_t w = 0; w < 8; ++w) s[w * LANES + l] = init[w];
+        lane.data = inputs[i];
+        lane.blocks = lengths[i] / 64;
+        const size_t rem = lengths[i] % 64;
+        memset(lane.tail, 0, sizeof(lane.tail));
+        if (rem) memcpy(lane.tail, inputs[i] + lane.blocks * 64, rem);
+        lane.tail[rem] = 0x80;
+        lane.tail_blocks = rem < 56 ? 1 : 2;
+        WriteBE64(lane.tail + 64 * lane.tail_blocks - 8, ((offsets ? offsets[i] : 0) + lengths[i]) << 3);
+        lane.next = lane.tail;
+        lane.second = false;
+    };
+
+    for (size_t l = 0; l < LANES; ++l) start(l);
+    while (true) {
+        bool active = false;
+        for (size_t l = 0; l < LANES; ++l) {
+            const Lane& lane = lanes[l];
+            if (lane.msg == count) {
+                chunks[l] = idle;
+            } else {
+                chunks[l] = lane.blocks ? lane.data : lane.next;
+                active = true;
+            }
+        }
+        if (!active) break;
+        tr(s, chunks);
+        for (size_t l = 0; l < LANES; ++l) {
+            Lane& lane = lanes[l];
+            if (lane.msg == count) continue;
+            if (lane.blocks) {
+                lane.data += 64;
+                --lane.blocks;
+                continue;
+            }
+            lane.next += 64;
+            if (--lane.tail_blocks) continue;
+            if (!lane.second) {
+                // The first hash, padded, is the one block of the second.
+                memset(lane.tail, 0, 64);
+                for (size_t w = 0; w < 8; ++w) WriteBE32(lane.tail + 4 * w, s[w * LANES + l]);
+                lane.tail[32] = 0x80;
+                lane.tail[62] = 0x01;
+                uint32_t init[8];
+                sha256::Initialize(init);
+                for (size_t w = 0; w < 8; ++w) s[w * LANES + l] = init[w];
+                lane.next = lane.tail;
+                lane.tail_blocks = 1;
+                lane.second = true;
+                continue;
+            }
+            for (size_t w = 0; w < 8; ++w) WriteBE32(output + 32 * lane.msg + 4 * w, s[w * LANES + l]);
+            start(l);
+        }
+    }
+}
+
+} // namespace
+
 ////// SHA-256
 
 CSHA256::CSHA256() : bytes(0)
@@ -728,3 +849,38 @@ void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks)
         --blocks;
     }
 }
+
+void SHA256DMany(unsigned char* output, const CSHA256* prefixes, const unsigned char* const* inputs, const size_t* lengths, size_t count)
+{
+    // A lane left idle costs as much as a busy one, so few messages are hashed one at a time.
+    if ((TransformLanes_8way && count > 4) || (TransformLanes_4way && count > 1)) {
+        std::vector<const uint32_t*> states;
+        std::vector<uint64_t> offsets;
+        if (prefixes) {
+            states.reserve(count);
+            offsets.reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                assert(prefixes[i].bytes % 64 == 0);
+                states.push_back(prefixes[i].s);
+                offsets.push_back(prefixes[i].bytes);
+            }
+        }
+        if (TransformLanes_8way && count > 4) {
+            SHA256DLanes<8>(TransformLanes_8way, output, prefixes ? states.data() : nullptr, prefixes ? offsets.data() : nullptr, inputs, lengths, count);
+        } else {
+            SHA256DLanes<4>(TransformLanes_4way, output, prefixes ? states.data() : nullptr, prefixes ? offsets.data() : nullptr, inputs, lengths, count);
+        }
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        CSHA256 sha = prefixes ? prefixes[i] : CSHA256();
+        unsigned char* out = output + 32 * i;
+        sha.Write(inputs[i], lengths[i]).Finalize(out);
+        CSHA256().Write(out, CSHA256::OUTPUT_SIZE).Finalize(out);
+    }
+}
+
+void SHA256DMany(unsigned char* output, const unsigned char* const* inputs, const size_t* lengths, size_t count)
+{
+    SHA256DMany(output, nullptr, inputs, lengths, count);
+}
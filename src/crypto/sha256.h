@@ -24,6 +24,8 @@ public:
     CSHA256& Write(const unsigned char* data, size_t len);
     void Finalize(unsigned char hash[OUTPUT_SIZE]);
     CSHA256& Reset();
+
+    friend void SHA256DMany(unsigned char* output, const CSHA256* prefixes, const unsigned char* const* inputs, const size_t* lengths, size_t count);
 };
 
 /** Autodetect the best available SHA256 implementation.
@@ -38,4 +40,19 @@ std::string SHA256AutoDetect();
  */
 void SHA256D64(unsigned char* output, const unsigned char* input, size_t blocks);
 
+/** Compute the double-SHA256's of several messages of any length at once, spread
+ *  over the lanes of the multi-way transforms when the CPU has them.
+ *  output:  pointer to a count*32 byte output buffer
+ *  inputs:  pointers to the count messages
+ *  lengths: the size of each message
+ *  count:   the number of hashes to compute.
+ */
+void SHA256DMany(unsigned char* output, const unsigned char* const* inputs, const size_t* lengths, size_t count);
+
+/** As above, message i continuing the hasher prefixes[i], which must have been
+ *  written a multiple of 64 bytes. Used to hash many messages with a shared
+ *  or precomputed first part. prefixes may be null.
+ */
+void SHA256DMany(unsigned char* output, const CSHA256* prefixes, const unsigned char* const* inputs, const size_t* lengths, size_t count);
+
 #endif // BITCOIN_CRYPTO_SHA256_H
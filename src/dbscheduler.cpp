@@ -0,0 +1,192 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <dbscheduler.h>
+
+#include <fs.h>
+#include <sync.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+
+#include <leveldb/env.h>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+int64_t ElapsedMillis(Clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+}
+
+class DBIOScheduler
+{
+public:
+    void SetRate(int64_t bytes_per_second)
+    {
+        LOCK(m_mutex);
+        m_rate = bytes_per_second;
+    }
+
+    void BeginPriority(int64_t max_defer_ms)
+    {
+        LOCK(m_mutex);
+        const Clock::time_point until = Clock::now() + std::chrono::milliseconds(max_defer_ms);
+        m_defer_until = m_priority == 0 ? until : std::max(m_defer_until, until);
+        m_priority++;
+    }
+
+    void EndPriority()
+    {
+        {
+            LOCK(m_mutex);
+            m_priority--;
+        }
+        m_cv.notify_all();
+    }
+
+    void FileOpened(const std::string& db)
+    {
+        LOCK(m_mutex);
+        Stats(db).files++;
+    }
+
+    /** Wait until bytes of a table file of db may be written */
+    void Throttle(const std::string& db, size_t bytes)
+    {
+        WAIT_LOCK(m_mutex, lock);
+        const Clock::time_point start = Clock::now();
+        while (m_priority > 0 && Clock::now() < m_defer_until) {
+            m_cv.wait_until(lock, m_defer_until);
+        }
+        Stats(db).deferred_ms += ElapsedMillis(start);
+
+        Stats(db).bytes += bytes;
+        if (m_rate <= 0) return;
+
+        // The writes are spaced by their size, one written after an idle period goes through at once
+        const Clock::time_point throttled = Clock::now();
+        m_next_write = std::max(m_next_write, throttled) + std::chrono::microseconds(bytes * 1000000 / m_rate);
+        const Clock::time_point until = m_next_write - std::chrono::microseconds(bytes * 1000000 / m_rate);
+        while (Clock::now() < until) {
+            m_cv.wait_until(lock, until);
+        }
+        Stats(db).throttled_ms += ElapsedMillis(throttled);
+    }
+
+    std::vector<DBCompactionStats> GetStats(bool reset)
+    {
+        LOCK(m_mutex);
+        std::vector<DBCompactionStats> result;
+        for (const std::string& name : m_order) {
+            result.push_back(m_stats[name]);
+            if (reset) m_stats[name] = DBCompactionStats{name};
+        }
+        return result;
+    }
+
+private:
+    Mutex m_mutex;
+    std::condition_variable m_cv;
+    int64_t m_rate GUARDED_BY(m_mutex){0};
+    int m_priority GUARDED_BY(m_mutex){0};
+    Clock::time_point m_defer_until GUARDED_BY(m_mutex);
+    Clock::time_point m_next_write GUARDED_BY(m_mutex);
+    std::map<std::string, DBCompactionStats> m_stats GUARDED_BY(m_mutex);
+    std::vector<std::string> m_order GUARDED_BY(m_mutex);
+
+    DBCompactionStats& Stats(const std::string& db) EXCLUSIVE_LOCKS_REQUIRED(m_mutex)
+    {
+        auto it = m_stats.find(db);
+        if (it == m_stats.end()) {
+            it = m_stats.emplace(db, DBCompactionStats{db}).first;
+            m_order.push_back(db);
+        }
+        return it->second;
+    }
+};
+
+DBIOScheduler& GetScheduler()
+{
+    // Never destroyed, LevelDB's background thread may still write at exit
+    static DBIOScheduler* scheduler = new DBIOScheduler();
+    return *scheduler;
+}
+
+class ScheduledWritableFile : public leveldb::WritableFile
+{
+public:
+    ScheduledWritableFile(leveldb::WritableFile* file, const std::string& db) : m_file(file), m_db(db) {}
+    ~ScheduledWritableFile() override { delete m_file; }
+
+    leveldb::Status Append(const leveldb::Slice& data) override
+    {
+        GetScheduler().Throttle(m_db, data.size());
+        return m_file->Append(data);
+    }
+    leveldb::Status Close() override { return m_file->Close(); }
+    leveldb::Status Flush() override { return m_file->Flush(); }
+    leveldb::Status Sync() override { return m_file->Sync(); }
+    std::string GetName() const override { return m_file->GetName(); }
+
+private:
+    leveldb::WritableFile* m_file;
+    const std::string m_db;
+};
+
+class ScheduledEnv : public leveldb::EnvWrapper
+{
+public:
+    explicit ScheduledEnv(leveldb::Env* target) : leveldb::EnvWrapper(target) {}
+
+    leveldb::Status NewWritableFile(const std::string& fname, leveldb::WritableFile** result) override
+    {
+        leveldb::Status status = target()->NewWritableFile(fname, result);
+        // Table files are written by compactions and memtable dumps, the log by the foreground writes
+        if (status.ok() && IsTableFile(fname)) {
+            const std::string db = fs::path(fname).parent_path().filename().string();
+            GetScheduler().FileOpened(db);
+            *result = new ScheduledWritableFile(*result, db);
+        }
+        return status;
+    }
+
+private:
+    static bool IsTableFile(const std::string& fname)
+    {
+        const size_t dot = fname.rfind('.');
+        return dot != std::string::npos && (fname.compare(dot, std::string::npos, ".ldb") == 0 || fname.compare(dot, std::string::npos, ".sst") == 0);
+    }
+};
+
+} // namespace
+
+leveldb::Env* GetDBEnv()
+{
+    static ScheduledEnv* env = new ScheduledEnv(leveldb::Env::Default());
+    return env;
+}
+
+void SetDBCompactionRate(int64_t bytes_per_second)
+{
+    GetScheduler().SetRate(bytes_per_second);
+}
+
+std::vector<DBCompactionStats> GetDBCompactionStats(bool reset)
+{
+    return GetScheduler().GetStats(reset);
+}
+
+DBPriorityScope::DBPriorityScope(int64_t max_defer_ms)
+{
+    GetScheduler().BeginPriority(max_defer_ms);
+}
+
+DBPriorityScope::~DBPriorityScope()
+{
+    GetScheduler().EndPriority();
+}
@@ -0,0 +1,66 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_DBSCHEDULER_H
+#define BITCOIN_DBSCHEDULER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace leveldb {
+class Env;
+}
+
+/** Default for -dbcompactionrate in MiB/s, 0 leaves the compactions unthrottled */
+static const int64_t DEFAULT_DB_COMPACTION_RATE = 0;
+/** Milliseconds a flush of the chain state holds back the compactions for at most */
+static const int64_t DB_FLUSH_MAX_DEFER = 2000;
+/** Milliseconds the staker holds back the compactions for at most once it found a kernel */
+static const int64_t DB_STAKE_MAX_DEFER = 5000;
+
+/** Table files one database wrote through the shared environment */
+struct DBCompactionStats
+{
+    std::string name;
+    uint64_t files{0};
+    uint64_t bytes{0};
+    //! Time the writes waited for a priority scope to end
+    int64_t deferred_ms{0};
+    //! Time the writes waited for the -dbcompactionrate budget
+    int64_t throttled_ms{0};
+};
+
+/**
+ * Environment of the databases opened with GetDBOptions. LevelDB writes the
+ * table files of every database from the one background thread of the
+ * default environment, as it compacts them or dumps their memtables, so the
+ * writes of all of them pass through here. They share the -dbcompactionrate
+ * budget and wait while a DBPriorityScope is alive.
+ */
+leveldb::Env* GetDBEnv();
+
+/** Limit the table file writes of all databases to bytes_per_second, 0 for no limit */
+void SetDBCompactionRate(int64_t bytes_per_second);
+
+/** Table file writes per database, in the order the databases first wrote */
+std::vector<DBCompactionStats> GetDBCompactionStats(bool reset);
+
+/**
+ * Holds back the table file writes of the databases while alive, giving the
+ * disk to a foreground write or the staker. A foreground write may itself
+ * wait for a compaction once too many level 0 files piled up, so the writes
+ * only wait for max_defer_ms after the scope started.
+ */
+class DBPriorityScope
+{
+public:
+    explicit DBPriorityScope(int64_t max_defer_ms);
+    ~DBPriorityScope();
+
+    DBPriorityScope(const DBPriorityScope&) = delete;
+    DBPriorityScope& operator=(const DBPriorityScope&) = delete;
+};
+
+#endif // BITCOIN_DBSCHEDULER_H
@@ -2,8 +2,13 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
 #include <dbwrapper.h>
 
+#include <dbscheduler.h>
 #include <memory>
 #include <random.h>
 
@@ -97,7 +102,42 @@ static void SetMaxOpenFiles(leveldb::Options *options) {
              options->max_open_files, default_open_files);
 }
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+/** Apply the -dboption settings of the form <name>:<option>=<value> meant for the database name */
+static void SetDBOptionsFromArgs(const std::string& name, leveldb::Options& options)
+{
+    for (const std::string& arg : gArgs.GetArgs("-dboption")) {
+        if (arg.empty()) continue;
+        size_t colon = arg.find(':');
+        size_t equals = arg.find('=', colon == std::string::npos ? 0 : colon);
+        if (colon == std::string::npos || equals == std::string::npos) {
+            LogPrintf("Ignoring malformed -dboption=%s\n", arg);
+            continue;
+        }
+        if (arg.substr(0, colon) != name) continue;
+        const std::string option = arg.substr(colon + 1, equals - colon - 1);
+        const std::string value = arg.substr(equals + 1);
+        int64_t n;
+        if (option == "compression" && (value == "none" || value == "snappy")) {
+            options.compression = value == "snappy" ? leveldb::kSnappyCompression : leveldb::kNoCompression;
+        } else if (!ParseInt64(value, &n) || n < 0) {
+            LogPrintf("Ignoring -dboption=%s, invalid value\n", arg);
+        } else if (option == "bloombits") {
+            delete options.filter_policy;
+            options.filter_policy = n > 0 ? leveldb::NewBloomFilterPolicy(n) : nullptr;
+        } else if (option == "blockcache") {
+            delete options.block_cache;
+            options.block_cache = leveldb::NewLRUCache(n);
+        } else if (option == "writebuffer") {
+            options.write_buffer_size = n;
+        } else if (option == "maxfilesize") {
+            options.max_file_size = n;
+        } else {
+            LogPrintf("Ignoring -dboption=%s, unknown option\n", arg);
+        }
+    }
+}
+
+leveldb::Options GetDBOptions(const std::string& name, size_t nCacheSize)
 {
     leveldb::Options options;
     options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
@@ -105,15 +145,30 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     options.filter_policy = leveldb::NewBloomFilterPolicy(10);
     options.compression = leveldb::kNoCompression;
     options.info_log = new CBitcoinLevelDBLogger();
+    options.env = GetDBEnv();
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
         // on corruption in later versions.
         options.paranoid_checks = true;
     }
     SetMaxOpenFiles(&options);
+    SetDBOptionsFromArgs(name, options);
+    LogPrint(BCLog::LEVELDB, "LevelDB options for %s: write buffer %u, max file size %u, bloom filter %s, compression %s\n",
+             name, options.write_buffer_size, options.max_file_size,
+             options.filter_policy ? options.filter_policy->Name() : "none", options.compression == leveldb::kSnappyCompression ? "snappy" : "none");
     return options;
 }
 
+void FreeDBOptions(leveldb::Options& options)
+{
+    delete options.filter_policy;
+    options.filter_policy = nullptr;
+    delete options.info_log;
+    options.info_log = nullptr;
+    delete options.block_cache;
+    options.block_cache = nullptr;
+}
+
 CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
     : m_name{path.stem().string()}
 {
@@ -122,7 +177,7 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetDBOptions(m_name, nCacheSize);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -163,6 +218,7 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
         LogPrintf("Wrote new obfuscate key for %s: %s\n", path.string(), HexStr(obfuscate_key));
     }
 
+    m_obfuscated = std::any_of(obfuscate_key.begin(), obfuscate_key.end(), [](unsigned char c) { return c != 0; });
     LogPrintf("Using obfuscation key for %s: %s\n", path.string(), HexStr(obfuscate_key));
 }
 
@@ -170,12 +226,7 @@ CDBWrapper::~CDBWrapper()
 {
     delete pdb;
     pdb = nullptr;
-    delete options.filter_policy;
-    options.filter_policy = nullptr;
-    delete options.info_log;
-    options.info_log = nullptr;
-    delete options.block_cache;
-    options.block_cache = nullptr;
+    FreeDBOptions(options);
     delete penv;
     options.env = nullptr;
 }
@@ -236,7 +287,9 @@ bool CDBWrapper::IsEmpty()
 CDBIterator::~CDBIterator() { delete piter; }
 bool CDBIterator::Valid() const { return piter->Valid(); }
 void CDBIterator::SeekToFirst() { piter->SeekToFirst(); }
+void CDBIterator::SeekToLast() { piter->SeekToLast(); }
 void CDBIterator::Next() { piter->Next(); }
+void CDBIterator::Prev() { piter->Prev(); }
 
 namespace dbwrapper_private {
 
@@ -255,4 +308,40 @@ const std::vector<unsigned char>& GetObfuscateKey(const CDBWrapper &w)
     return w.obfuscate_key;
 }
 
+bool IsObfuscated(const CDBWrapper &w)
+{
+    return w.m_obfuscated;
+}
+
+/** Capacity a buffer keeps between the reads, a larger value gives its memory back */
+static const size_t VALUE_BUFFER_KEEP_SIZE = 64 * 1024;
+
+#if defined(HAVE_THREAD_LOCAL)
+static thread_local std::string g_value_buffer;
+static thread_local bool g_value_buffer_taken = false;
+
+ValueBuffer::ValueBuffer()
+{
+    // A value deserializes without reading the database again, but be safe
+    if (g_value_buffer_taken) {
+        m_value = &m_local;
+    } else {
+        g_value_buffer_taken = true;
+        m_value = &g_value_buffer;
+    }
+}
+
+ValueBuffer::~ValueBuffer()
+{
+    if (m_value != &g_value_buffer) return;
+    if (g_value_buffer.capacity() > VALUE_BUFFER_KEEP_SIZE) {
+        std::string().swap(g_value_buffer);
+    }
+    g_value_buffer_taken = false;
+}
+#else
+ValueBuffer::ValueBuffer() : m_value(&m_local) {}
+ValueBuffer::~ValueBuffer() {}
+#endif
+
 } // namespace dbwrapper_private
@@ -16,6 +16,8 @@
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
+#include <memory>
+
 static const size_t DBWRAPPER_PREALLOC_KEY_SIZE = 64;
 static const size_t DBWRAPPER_PREALLOC_VALUE_SIZE = 1024;
 
@@ -27,6 +29,15 @@ public:
 
 class CDBWrapper;
 
+/**
+ * LevelDB options for the database in the directory name, sized from nCacheSize and
+ * adjusted by the -dboption=<name>:<option>=<value> settings (bloombits, blockcache,
+ * writebuffer, maxfilesize in bytes, compression none or snappy). The block cache,
+ * filter policy and logger are allocated and released by FreeDBOptions.
+ */
+leveldb::Options GetDBOptions(const std::string& name, size_t nCacheSize);
+void FreeDBOptions(leveldb::Options& options);
+
 /** These should be considered an implementation detail of the specific database.
  */
 namespace dbwrapper_private {
@@ -41,6 +52,35 @@ void HandleError(const leveldb::Status& status);
  */
 const std::vector<unsigned char>& GetObfuscateKey(const CDBWrapper &w);
 
+/** Whether the obfuscation key of the database is not all zeros, the values of the others are read in place
+ */
+bool IsObfuscated(const CDBWrapper &w);
+
+/** The string a value is read into. The reads of a thread reuse one, so that
+ * reading the small values of the databases does not allocate.
+ */
+class ValueBuffer
+{
+public:
+    ValueBuffer();
+    ~ValueBuffer();
+
+    ValueBuffer(const ValueBuffer&) = delete;
+    ValueBuffer& operator=(const ValueBuffer&) = delete;
+
+    std::string& Get() { return *m_value; }
+
+private:
+    std::string* m_value;
+    //! Used when the buffer of the thread is taken or threads have none
+    std::string m_local;
+};
+
+inline Span<const unsigned char> MakeByteSpan(const char* data, size_t size)
+{
+    return Span<const unsigned char>(reinterpret_cast<const unsigned char*>(data), size);
+}
+
 };
 
 /** Batch of changes queued to be written to a CDBWrapper */
@@ -78,7 +118,9 @@ public:
 
         ssValue.reserve(DBWRAPPER_PREALLOC_VALUE_SIZE);
         ssValue << value;
-        ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
+        if (dbwrapper_private::IsObfuscated(parent)) {
+            ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
+        }
         leveldb::Slice slValue(ssValue.data(), ssValue.size());
 
         batch.Put(slKey, slValue);
@@ -119,20 +161,27 @@ class CDBIterator
 private:
     const CDBWrapper &parent;
     leveldb::Iterator *piter;
+    //! The deobfuscated copy of the current value
+    std::string m_value;
+    //! The snapshot iterated over, released after the iterator
+    std::shared_ptr<const leveldb::Snapshot> m_snapshot;
 
 public:
 
     /**
      * @param[in] _parent          Parent CDBWrapper instance.
      * @param[in] _piter           The original leveldb iterator.
+     * @param[in] snapshot         The snapshot _piter reads, if any.
      */
-    CDBIterator(const CDBWrapper &_parent, leveldb::Iterator *_piter) :
-        parent(_parent), piter(_piter) { };
+    CDBIterator(const CDBWrapper &_parent, leveldb::Iterator *_piter,
+                std::shared_ptr<const leveldb::Snapshot> snapshot = nullptr) :
+        parent(_parent), piter(_piter), m_snapshot(std::move(snapshot)) { };
     ~CDBIterator();
 
     bool Valid() const;
 
     void SeekToFirst();
+    void SeekToLast();
 
     template<typename K> void Seek(const K& key) {
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
@@ -143,11 +192,12 @@ public:
     }
 
     void Next();
+    void Prev();
 
     template<typename K> bool GetKey(K& key) {
         leveldb::Slice slKey = piter->key();
         try {
-            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            SpanReader ssKey(SER_DISK, CLIENT_VERSION, dbwrapper_private::MakeByteSpan(slKey.data(), slKey.size()));
             ssKey >> key;
         } catch (const std::exception&) {
             return false;
@@ -158,8 +208,14 @@ public:
     template<typename V> bool GetValue(V& value) {
         leveldb::Slice slValue = piter->value();
         try {
-            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-            ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
+            Span<const unsigned char> data = dbwrapper_private::MakeByteSpan(slValue.data(), slValue.size());
+            if (dbwrapper_private::IsObfuscated(parent)) {
+                // The slice belongs to the iterator, deobfuscate a copy of it
+                m_value.assign(slValue.data(), slValue.size());
+                Xor(Span<char>(&m_value[0], m_value.size()), dbwrapper_private::GetObfuscateKey(parent));
+                data = dbwrapper_private::MakeByteSpan(m_value.data(), m_value.size());
+            }
+            SpanReader ssValue(SER_DISK, CLIENT_VERSION, data);
             ssValue >> value;
         } catch (const std::exception&) {
             return false;
@@ -176,6 +232,7 @@ public:
 class CDBWrapper
 {
     friend const std::vector<unsigned char>& dbwrapper_private::GetObfuscateKey(const CDBWrapper &w);
+    friend bool dbwrapper_private::IsObfuscated(const CDBWrapper &w);
 private:
     //! custom environment this database is using (may be nullptr in case of default environment)
     leveldb::Env* penv;
@@ -204,6 +261,9 @@ private:
     //! a key used for optional XOR-obfuscation of the database
     std::vector<unsigned char> obfuscate_key;
 
+    //! whether obfuscate_key is not all zeros
+    bool m_obfuscated{false};
+
     //! the key under which the obfuscation key is stored
     static const std::string OBFUSCATE_KEY_KEY;
 
@@ -235,7 +295,8 @@ public:
         ssKey << key;
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
 
-        std::string strValue;
+        dbwrapper_private::ValueBuffer buffer;
+        std::string& strValue = buffer.Get();
         leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
         if (!status.ok()) {
             if (status.IsNotFound())
@@ -244,8 +305,10 @@ public:
             dbwrapper_private::HandleError(status);
         }
         try {
-            CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
-            ssValue.Xor(obfuscate_key);
+            if (m_obfuscated) {
+                Xor(Span<char>(&strValue[0], strValue.size()), obfuscate_key);
+            }
+            SpanReader ssValue(SER_DISK, CLIENT_VERSION, dbwrapper_private::MakeByteSpan(strValue.data(), strValue.size()));
             ssValue >> value;
         } catch (const std::exception&) {
             return false;
@@ -269,8 +332,8 @@ public:
         ssKey << key;
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
 
-        std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        dbwrapper_private::ValueBuffer buffer;
+        leveldb::Status status = pdb->Get(readoptions, slKey, &buffer.Get());
         if (!status.ok()) {
             if (status.IsNotFound())
                 return false;
@@ -310,6 +373,23 @@ public:
         return new CDBIterator(*this, pdb->NewIterator(iteroptions));
     }
 
+    /**
+     * Take a snapshot of the database. Iterators made over the same snapshot all
+     * see the same state, however the database is written to in between.
+     */
+    std::shared_ptr<const leveldb::Snapshot> GetSnapshot() const
+    {
+        leveldb::DB* db = pdb;
+        return std::shared_ptr<const leveldb::Snapshot>(db->GetSnapshot(), [db](const leveldb::Snapshot* snapshot) { db->ReleaseSnapshot(snapshot); });
+    }
+
+    CDBIterator *NewIterator(std::shared_ptr<const leveldb::Snapshot> snapshot) const
+    {
+        leveldb::ReadOptions snapshot_options = iteroptions;
+        snapshot_options.snapshot = snapshot.get();
+        return new CDBIterator(*this, pdb->NewIterator(snapshot_options), std::move(snapshot));
+    }
+
     /**
      * Return true if the database managed by this class contains no entries.
      */
@@ -3,13 +3,109 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
 #include <stdexcept>
 
+#include <clientversion.h>
 #include <flatfile.h>
 #include <logging.h>
+#include <streams.h>
 #include <tinyformat.h>
 #include <util/system.h>
 
+#include <string.h>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+const char ARCHIVE_MAGIC[4] = {'M', 'R', 'X', 'Z'};
+const uint32_t ARCHIVE_VERSION = 1;
+/** Magic, version, frame size, file size and frame count */
+const long ARCHIVE_HEADER_SIZE = 24;
+
+#ifdef USE_ZLIB
+/** Write the length bytes from pos of the archive at path to a temporary file, positioned at pos */
+FILE* OpenArchive(const fs::path& path, unsigned int pos, size_t length)
+{
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        LogPrintf("Unable to open file %s\n", path.string());
+        return nullptr;
+    }
+    FILE* out = nullptr;
+    try {
+        char magic[sizeof(ARCHIVE_MAGIC)];
+        uint32_t version, frame_size, frames;
+        uint64_t size;
+        file.read(magic, sizeof(magic));
+        file >> version >> frame_size >> size >> frames;
+        if (memcmp(magic, ARCHIVE_MAGIC, sizeof(magic)) || version != ARCHIVE_VERSION || frame_size == 0 ||
+            frames != (size + frame_size - 1) / frame_size || pos > size) {
+            LogPrintf("Unable to read position %u of archive %s\n", pos, path.string());
+            return nullptr;
+        }
+        std::vector<uint32_t> sizes(frames);
+        for (uint32_t& frame : sizes) {
+            file >> frame;
+        }
+
+        const uint64_t end = length ? std::min<uint64_t>(size, (uint64_t)pos + length) : size;
+        const uint32_t first = pos / frame_size;
+        uint64_t offset = ARCHIVE_HEADER_SIZE + 4 * (uint64_t)frames;
+        for (uint32_t i = 0; i < first; i++) {
+            offset += sizes[i];
+        }
+        if (fseek(file.Get(), offset, SEEK_SET)) {
+            throw std::ios_base::failure("seek failed");
+        }
+
+        out = tmpfile();
+        if (!out) {
+            LogPrintf("Unable to create a temporary file for %s\n", path.string());
+            return nullptr;
+        }
+        std::vector<unsigned char> compressed, frame(frame_size);
+        for (uint32_t i = first; i < frames && (uint64_t)i * frame_size < end; i++) {
+            compressed.resize(sizes[i]);
+            file.read((char*)compressed.data(), compressed.size());
+            uLongf frame_length = std::min<uint64_t>(frame_size, size - (uint64_t)i * frame_size);
+            const uLongf expected = frame_length;
+            if (uncompress(frame.data(), &frame_length, compressed.data(), compressed.size()) != Z_OK || frame_length != expected) {
+                throw std::ios_base::failure(strprintf("frame %u is corrupt", i));
+            }
+            if (fwrite(frame.data(), 1, frame_length, out) != frame_length) {
+                throw std::ios_base::failure("cannot write the temporary file");
+            }
+        }
+        if (fseek(out, pos - (uint64_t)first * frame_size, SEEK_SET)) {
+            throw std::ios_base::failure("seek failed");
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("Unable to read position %u of archive %s: %s\n", pos, path.string(), e.what());
+        if (out) fclose(out);
+        return nullptr;
+    }
+    return out;
+}
+#endif
+
+} // namespace
+
+bool CanArchiveFlatFiles()
+{
+#ifdef USE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
 FlatFileSeq::FlatFileSeq(fs::path dir, const char* prefix, size_t chunk_size) :
     m_dir(std::move(dir)),
     m_prefix(prefix),
@@ -30,7 +126,17 @@ fs::path FlatFileSeq::FileName(const FlatFilePos& pos) const
     return m_dir / strprintf("%s%05u.dat", m_prefix, pos.nFile);
 }
 
-FILE* FlatFileSeq::Open(const FlatFilePos& pos, bool read_only)
+fs::path FlatFileSeq::ArchiveName(const FlatFilePos& pos) const
+{
+    return m_dir / strprintf("%s%05u.zdat", m_prefix, pos.nFile);
+}
+
+bool FlatFileSeq::IsArchived(const FlatFilePos& pos) const
+{
+    return !fs::exists(FileName(pos)) && fs::exists(ArchiveName(pos));
+}
+
+FILE* FlatFileSeq::Open(const FlatFilePos& pos, bool read_only, size_t length)
 {
     if (pos.IsNull()) {
         return nullptr;
@@ -38,6 +144,15 @@ FILE* FlatFileSeq::Open(const FlatFilePos& pos, bool read_only)
     fs::path path = FileName(pos);
     fs::create_directories(path.parent_path());
     FILE* file = fsbridge::fopen(path, read_only ? "rb": "rb+");
+    if (!file && fs::exists(ArchiveName(pos))) {
+#ifdef USE_ZLIB
+        if (read_only) {
+            return OpenArchive(ArchiveName(pos), pos.nPos, length);
+        }
+#endif
+        LogPrintf("Unable to open file %s, it was archived to %s\n", path.string(), ArchiveName(pos).string());
+        return nullptr;
+    }
     if (!file && !read_only)
         file = fsbridge::fopen(path, "wb+");
     if (!file) {
@@ -80,6 +195,9 @@ size_t FlatFileSeq::Allocate(const FlatFilePos& pos, size_t add_size, bool& out_
 
 bool FlatFileSeq::Flush(const FlatFilePos& pos, bool finalize)
 {
+    if (IsArchived(pos)) {
+        return true; // Archived files were final and committed
+    }
     FILE* file = Open(FlatFilePos(pos.nFile, 0)); // Avoid fseek to nPos
     if (!file) {
         return error("%s: failed to open file %d", __func__, pos.nFile);
@@ -96,3 +214,75 @@ bool FlatFileSeq::Flush(const FlatFilePos& pos, bool finalize)
     fclose(file);
     return true;
 }
+
+bool FlatFileSeq::Archive(const FlatFilePos& pos)
+{
+#ifdef USE_ZLIB
+    const fs::path path = FileName(pos);
+    const fs::path archive_path = ArchiveName(pos);
+    const fs::path tmp_path = archive_path.string() + ".new";
+    try {
+        CAutoFile filein(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull()) {
+            return error("%s: failed to open %s", __func__, path.string());
+        }
+        CAutoFile fileout(fsbridge::fopen(tmp_path, "wb"), SER_DISK, CLIENT_VERSION);
+        if (fileout.IsNull()) {
+            return error("%s: failed to create %s", __func__, tmp_path.string());
+        }
+
+        const uint64_t size = fs::file_size(path);
+        const uint32_t frame_size = FLATFILE_ARCHIVE_FRAME_SIZE;
+        std::vector<uint32_t> sizes((size + frame_size - 1) / frame_size);
+        fileout.write(ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+        fileout << ARCHIVE_VERSION << frame_size << size << (uint32_t)sizes.size();
+        // The index of the compressed frame sizes is filled in once they are known
+        for (const uint32_t frame : sizes) {
+            fileout << frame;
+        }
+
+        std::vector<unsigned char> frame(frame_size), compressed(compressBound(frame_size)), check(frame_size);
+        for (size_t i = 0; i < sizes.size(); i++) {
+            const uLong frame_length = std::min<uint64_t>(frame_size, size - (uint64_t)i * frame_size);
+            filein.read((char*)frame.data(), frame_length);
+            uLongf compressed_length = compressed.size();
+            if (compress2(compressed.data(), &compressed_length, frame.data(), frame_length, Z_BEST_COMPRESSION) != Z_OK) {
+                throw std::ios_base::failure(strprintf("cannot compress frame %u", i));
+            }
+            // The file is deleted afterwards, make sure the frame reads back
+            uLongf check_length = frame_length;
+            if (uncompress(check.data(), &check_length, compressed.data(), compressed_length) != Z_OK ||
+                check_length != frame_length || memcmp(check.data(), frame.data(), frame_length)) {
+                throw std::ios_base::failure(strprintf("frame %u does not read back", i));
+            }
+            fileout.write((const char*)compressed.data(), compressed_length);
+            sizes[i] = compressed_length;
+        }
+
+        if (fseek(fileout.Get(), ARCHIVE_HEADER_SIZE, SEEK_SET)) {
+            throw std::ios_base::failure("seek failed");
+        }
+        for (const uint32_t frame : sizes) {
+            fileout << frame;
+        }
+        if (!FileCommit(fileout.Get())) {
+            throw std::ios_base::failure("cannot commit the archive");
+        }
+        fileout.fclose();
+        filein.fclose();
+        if (!RenameOver(tmp_path, archive_path)) {
+            throw std::ios_base::failure("cannot rename the archive into place");
+        }
+        // Reads use the file while it exists, the archive is complete before it goes
+        fs::remove(path);
+        LogPrintf("Archived %s: %u bytes compressed to %u\n", path.filename().string(), size, fs::file_size(archive_path));
+    } catch (const std::exception& e) {
+        boost::system::error_code ec;
+        fs::remove(tmp_path, ec);
+        return error("%s: failed to archive %s: %s", __func__, path.string(), e.what());
+    }
+    return true;
+#else
+    return false;
+#endif
+}
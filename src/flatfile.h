@@ -11,6 +11,12 @@
 #include <fs.h>
 #include <serialize.h>
 
+/** Bytes of a flat file compressed together in its archive, the least a read of it decompresses */
+static const size_t FLATFILE_ARCHIVE_FRAME_SIZE = 256 * 1024;
+
+/** Whether this build can archive flat files and read them back */
+bool CanArchiveFlatFiles();
+
 struct FlatFilePos
 {
     int nFile;
@@ -69,8 +75,25 @@ public:
     /** Get the name of the file at the given position. */
     fs::path FileName(const FlatFilePos& pos) const;
 
-    /** Open a handle to the file at the given position. */
-    FILE* Open(const FlatFilePos& pos, bool read_only = false);
+    /** Get the name of the compressed archive that may have replaced the file at the given position. */
+    fs::path ArchiveName(const FlatFilePos& pos) const;
+
+    /** Whether the file at the given position was replaced by its compressed archive. */
+    bool IsArchived(const FlatFilePos& pos) const;
+
+    /**
+     * Open a handle to the file at the given position. A file replaced by its archive can only
+     * be opened read only. The handle then reads a temporary copy of the length bytes from the
+     * position, or of the rest of the file when length is 0, decompressed from the frames that
+     * hold them.
+     */
+    FILE* Open(const FlatFilePos& pos, bool read_only = false, size_t length = 0);
+
+    /**
+     * Replace the file at the given position by an archive compressing it in frames of
+     * FLATFILE_ARCHIVE_FRAME_SIZE bytes. The file must not be written any more.
+     */
+    bool Archive(const FlatFilePos& pos);
 
     /**
      * Allocate additional space in a file after the given starting position. The amount allocated
@@ -8,6 +8,7 @@
 #include <crypto/hmac_sha256.h>
 #include <httpserver.h>
 #include <key_io.h>
+#include <rpc/cache.h>
 #include <rpc/protocol.h>
 #include <rpc/server.h>
 #include <sync.h>
@@ -17,6 +18,7 @@
 #include <util/translation.h>
 #include <walletinitinterface.h>
 
+#include <algorithm>
 #include <memory>
 #include <stdio.h>
 
@@ -195,15 +197,38 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
+            std::string strResult;
+            if (RPCCacheEnabled()) {
+                if (RPCCacheLookup(jreq, strResult)) {
+                    req->WriteHeader("Content-Type", "application/json");
+                    req->WriteReply(HTTP_OK, JSONRPCReplyWritten(strResult, jreq.id));
+                    return true;
+                }
+                jreq.cacheInfo = std::make_shared<RPCResultCacheInfo>();
+            }
+
             UniValue result = tableRPC.execute(jreq);
 
+            if (jreq.isStreaming) {
+                RPCRecordResponseSize(jreq.strMethod, jreq.nStreamedBytes);
+                if (jreq.cacheInfo) RPCCacheStore(jreq, jreq.cacheInfo->streamed);
+                return true;
+            }
+
+            if (jreq.isDeferred) {
+                return true;
+            }
+
             if (jreq.isLongPolling) {
                 jreq.PollReply(result);
                 return true;
             }
 
             // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            strResult = result.write();
+            if (jreq.cacheInfo) RPCCacheStore(jreq, strResult);
+            strReply = JSONRPCReplyWritten(strResult, jreq.id);
+            RPCRecordResponseSize(jreq.strMethod, strReply.size());
 
         // array of requests
         } else if (valRequest.isArray())
@@ -214,9 +239,18 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         req->WriteHeader("Content-Type", "application/json");
         req->WriteReply(HTTP_OK, strReply);
     } catch (const UniValue& objError) {
+        if (jreq.isStreaming) {
+            // part of the result is out already, cut the reply short
+            req->ChunkEnd();
+            return false;
+        }
         JSONErrorReply(req, objError, jreq.id);
         return false;
     } catch (const std::exception& e) {
+        if (jreq.isStreaming) {
+            req->ChunkEnd();
+            return false;
+        }
         JSONErrorReply(req, JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
         return false;
     }
@@ -251,6 +285,8 @@ bool StartHTTPRPC()
     if (!InitRPCAuthentication())
         return false;
 
+    InitRPCCache(std::max<int64_t>(0, gArgs.GetArg("-rpccachesize", DEFAULT_RPC_CACHE_SIZE)) << 20, gArgs.GetArg("-rpccachedepth", DEFAULT_RPC_CACHE_DEPTH));
+
     RegisterHTTPHandler("/", true, HTTPReq_JSONRPC);
     if (g_wallet_init_interface.HasWalletSupport()) {
         RegisterHTTPHandler("/wallet/", false, HTTPReq_JSONRPC);
@@ -278,4 +314,5 @@ void StopHTTPRPC()
         RPCUnsetTimerInterface(httpRPCTimerInterface.get());
         httpRPCTimerInterface.reset();
     }
+    InitRPCCache(0, DEFAULT_RPC_CACHE_DEPTH);
 }
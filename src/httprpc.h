@@ -5,8 +5,14 @@
 #ifndef BITCOIN_HTTPRPC_H
 #define BITCOIN_HTTPRPC_H
 
-#include <string>
 #include <map>
+#include <stdint.h>
+#include <string>
+
+/** Default for -restsubscribers, the most event streams open at /rest/subscribe */
+static const int DEFAULT_REST_SUBSCRIBERS = 1000;
+/** Default for -restcallgaslimit, the gas a call at /rest/call may use */
+static const int64_t DEFAULT_REST_CALL_GAS_LIMIT = 10000000;
 
 /** Start HTTP RPC subsystem.
  * Precondition; HTTP and RPC has been started.
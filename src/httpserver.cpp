@@ -55,6 +55,11 @@ public:
     void operator()() override
     {
         func(req.get(), path);
+        if (req && req->deferred) {
+            auto take = std::move(req->deferred);
+            req->deferred = nullptr;
+            take(std::move(req));
+        }
     }
 
     std::unique_ptr<HTTPRequest> req;
@@ -64,6 +69,22 @@ private:
     HTTPRequestHandler func;
 };
 
+/** Work item running a task that does not belong to a request */
+class HTTPTaskItem final : public HTTPClosure
+{
+public:
+    explicit HTTPTaskItem(const std::function<void()>& _task): task(_task)
+    {
+    }
+    void operator()() override
+    {
+        task();
+    }
+
+private:
+    std::function<void()> task;
+};
+
 /** Simple work queue for distributing work over multiple threads.
  * Work items are simply callable objects.
  */
@@ -486,6 +507,36 @@ struct event_base* EventBase()
     return eventBase;
 }
 
+bool EnqueueHTTPWork(std::unique_ptr<HTTPRequest>& req, const std::function<void(HTTPRequest*)>& work)
+{
+    if (!workQueue) {
+        return false;
+    }
+    std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(req), "", [work](HTTPRequest* r, const std::string&) {
+        work(r);
+        return true;
+    }));
+    if (workQueue->Enqueue(item.get())) {
+        item.release(); /* if true, queue took ownership */
+        return true;
+    }
+    req = std::move(item->req);
+    return false;
+}
+
+bool EnqueueHTTPTask(const std::function<void()>& task)
+{
+    if (!workQueue) {
+        return false;
+    }
+    std::unique_ptr<HTTPTaskItem> item(new HTTPTaskItem(task));
+    if (workQueue->Enqueue(item.get())) {
+        item.release(); /* if true, queue took ownership */
+        return true;
+    }
+    return false;
+}
+
 static void httpevent_callback_fn(evutil_socket_t, short, void* data)
 {
     // Static handler: simply call inner handler
@@ -518,7 +569,9 @@ void HTTPEvent::trigger(struct timeval* tv)
 HTTPRequest::HTTPRequest(struct evhttp_request* _req) : req(_req),
                                                         replySent(false),
                                                         startedChunkTransfer(false),
-                                                        connClosed(false)
+                                                        connClosed(false),
+                                                        nQueueTime(GetTimeMicros()),
+                                                        pendingOutput(std::make_shared<std::atomic<size_t>>(0))
 {
 }
 HTTPRequest::~HTTPRequest()
@@ -626,6 +679,11 @@ bool HTTPRequest::ReplySent() {
     return replySent;
 }
 
+void HTTPRequest::Defer(std::function<void(std::unique_ptr<HTTPRequest>)> take) {
+    assert(startedChunkTransfer && !replySent);
+    deferred = std::move(take);
+}
+
 void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
 {
     struct evkeyvalq* headers = evhttp_request_get_output_headers(req);
@@ -670,8 +728,14 @@ void HTTPRequest::Chunk(const std::string& chunk) {
     if (chunk.size() > 0) {
         auto databuf = evbuffer_new(); // HTTPEvent will free this buffer
         evbuffer_add(databuf, chunk.data(), chunk.size());
-        HTTPEvent* ev = new HTTPEvent(eventBase, true, databuf,
-                std::bind(evhttp_send_reply_chunk, req, databuf));
+        auto req_copy = req;
+        auto pending = pendingOutput;
+        HTTPEvent* ev = new HTTPEvent(eventBase, true, databuf, [req_copy, databuf, pending] {
+            evhttp_send_reply_chunk(req_copy, databuf);
+            evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+            bufferevent* bev = conn ? evhttp_connection_get_bufferevent(conn) : nullptr;
+            *pending = bev ? evbuffer_get_length(bufferevent_get_output(bev)) : 0;
+        });
         ev->trigger(0);
     }
 }
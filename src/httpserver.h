@@ -5,9 +5,11 @@
 #ifndef BITCOIN_HTTPSERVER_H
 #define BITCOIN_HTTPSERVER_H
 
+#include <atomic>
 #include <string>
 #include <stdint.h>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <condition_variable>
 
@@ -53,6 +55,16 @@ void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
  */
 struct event_base* EventBase();
 
+/** Run work for a request that was kept open past its handler on an HTTP worker thread.
+ * Returns false if the work queue is full, in which case req is left untouched.
+ */
+bool EnqueueHTTPWork(std::unique_ptr<HTTPRequest>& req, const std::function<void(HTTPRequest*)>& work);
+
+/** Run task on an HTTP worker thread. Returns false if there is no work queue or it is full.
+ * Queued tasks are dropped without running when the server stops.
+ */
+bool EnqueueHTTPTask(const std::function<void()>& task);
+
 /** In-flight HTTP request.
  * Thin C++ wrapper around evhttp_request.
  */
@@ -67,9 +79,20 @@ private:
     std::mutex cs;
     std::condition_variable closeCv;
 
+    /** When the request was queued for a worker, in microseconds */
+    int64_t nQueueTime;
+
+    /** Unsent bytes on the connection, updated on the event thread after each chunk */
+    std::shared_ptr<std::atomic<size_t>> pendingOutput;
+
+    /** Set by Defer, receives the request once its handler has returned */
+    std::function<void(std::unique_ptr<HTTPRequest>)> deferred;
+
     void startDetectClientClose();
     void waitClientClose();
 
+    friend class HTTPWorkItem;
+
 public:
     explicit HTTPRequest(struct evhttp_request* req);
     ~HTTPRequest();
@@ -82,6 +105,9 @@ public:
         PUT
     };
 
+    /** When the request was queued for a worker, in microseconds */
+    int64_t GetQueueTime() const { return nQueueTime; }
+
     void setConnClosed();
     bool isConnClosed();
     bool isChunkMode();
@@ -139,10 +165,22 @@ public:
 	 */
     void ChunkEnd();
 
+    /**
+     * Bytes of a chunked reply still queued on the connection, as of the last chunk sent.
+     * Lets streams notice a client that reads slower than they write.
+     */
+    size_t PendingOutput() const { return *pendingOutput; }
+
     /**
      * Is reply sent?
      */
     bool ReplySent();
+
+    /**
+     * Keep the request open after the handler returns instead of releasing the worker
+     * with an unhandled request. take is given ownership of the request, to reply later.
+     */
+    void Defer(std::function<void(std::unique_ptr<HTTPRequest>)> take);
 };
 
 /** Event handler closure.
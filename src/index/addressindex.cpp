@@ -0,0 +1,407 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/addressindex.h>
+
+#ifdef ENABLE_BITCORE_RPC
+#include <chainparams.h>
+#include <script/standard.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <boost/thread.hpp>
+
+#include <limits>
+#include <map>
+
+/* The index database keeps the entries the block tree database used to keep for -addrindex:
+ *
+ * [DB_ADDRESSINDEX, CAddressIndexKey] -> amount received (positive) or spent (negative)
+ * [DB_ADDRESSUNSPENTINDEX, CAddressUnspentKey] -> CAddressUnspentValue
+ * [DB_ADDRESSBALANCEINDEX, CAddressIndexIteratorKey] -> CAddressBalanceValue
+ * [DB_SPENTINDEX, CSpentIndexKey] -> CSpentIndexValue
+ * [DB_TIMESTAMPINDEX, CTimestampIndexKey] -> 0
+ * [DB_BLOCKHASHINDEX, block hash] -> CTimestampBlockIndexValue
+ *
+ * The timestamp entries of disconnected blocks are left behind, queries of active blocks check
+ * them against the active chain.
+ */
+constexpr char DB_ADDRESSINDEX = 'a';
+constexpr char DB_ADDRESSUNSPENTINDEX = 'u';
+constexpr char DB_ADDRESSBALANCEINDEX = 'A';
+constexpr char DB_TIMESTAMPINDEX = 'S';
+constexpr char DB_BLOCKHASHINDEX = 'z';
+constexpr char DB_SPENTINDEX = 'p';
+
+std::unique_ptr<AddressIndex> g_addressindex;
+
+/** Access to the address index database (indexes/addressindex/) */
+class AddressIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+};
+
+AddressIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "addressindex", n_cache_size, f_memory, f_wipe)
+{}
+
+AddressIndex::AddressIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<AddressIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+AddressIndex::~AddressIndex() {}
+
+/** The index type and 32 byte hash of the destination of a script, false when it has none */
+static bool GetIndexAddress(const COutPoint& prevout, const CScript& scriptPubKey, unsigned int& type, uint256& hash)
+{
+    CTxDestination dest;
+    if (!ExtractDestination(prevout, scriptPubKey, dest)) {
+        return false;
+    }
+    valtype bytesID(boost::apply_visitor(DataVisitor(), dest));
+    if (bytesID.empty()) {
+        return false;
+    }
+    valtype addressBytes(32);
+    std::copy(bytesID.begin(), bytesID.end(), addressBytes.begin());
+    type = dest.which();
+    hash = uint256(addressBytes);
+    return true;
+}
+
+/** Add the address index entries of a block to the balances in the batch writing them, or take them away
+ *  when the block is disconnected. The entries of a transaction are next to each other for an address.
+ *  The balances changed by writes still in the batch are read from balances. */
+static void UpdateAddressBalances(const CDBWrapper& db, CDBBatch& batch, std::map<std::pair<unsigned int, uint256>, CAddressBalanceValue>& balances,
+                                  const std::vector<std::pair<CAddressIndexKey, CAmount> >& vect, bool fDisconnect)
+{
+    std::map<std::pair<unsigned int, uint256>, CAddressBalanceValue> deltas;
+    std::map<std::pair<unsigned int, uint256>, uint256> lastTx;
+    for (const std::pair<CAddressIndexKey, CAmount>& entry : vect) {
+        std::pair<unsigned int, uint256> key(entry.first.type, entry.first.hashBytes);
+        CAddressBalanceValue& delta = deltas[key];
+        delta.balance += entry.second;
+        if (entry.second > 0)
+            delta.received += entry.second;
+        auto it = lastTx.find(key);
+        if (it == lastTx.end() || it->second != entry.first.txhash) {
+            delta.txCount++;
+            lastTx[key] = entry.first.txhash;
+        }
+    }
+
+    for (const auto& delta : deltas) {
+        const auto key = std::make_pair(DB_ADDRESSBALANCEINDEX, CAddressIndexIteratorKey(delta.first.first, delta.first.second));
+        CAddressBalanceValue value;
+        auto it = balances.find(delta.first);
+        if (it != balances.end()) {
+            value = it->second;
+        } else {
+            db.Read(key, value);
+        }
+        int sign = fDisconnect ? -1 : 1;
+        value.balance += sign * delta.second.balance;
+        value.received += sign * delta.second.received;
+        value.txCount += sign * delta.second.txCount;
+        if (value.IsNull()) {
+            batch.Erase(key);
+        } else {
+            batch.Write(key, value);
+        }
+        balances[delta.first] = value;
+    }
+}
+
+bool AddressIndex::WriteBlockEntries(CDBBatch& batch, const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, bool fDisconnect)
+{
+    if (blockundo.vtxundo.size() + 1 != block.vtx.size()) {
+        return error("%s: block and undo data of %s inconsistent", __func__, pindex->GetBlockHash().ToString());
+    }
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+
+    // Disconnected transactions are undone last to first, so that outputs spent within the block end up erased
+    for (size_t n = 0; n < block.vtx.size(); n++) {
+        const unsigned int i = fDisconnect ? block.vtx.size() - 1 - n : n;
+        const CTransaction& tx = *block.vtx[i];
+        const uint256 hash = tx.GetHash();
+        unsigned int type;
+        uint256 addressHash;
+
+        if (i > 0) {
+            const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+            if (txundo.vprevout.size() != tx.vin.size()) {
+                return error("%s: transaction and undo data of %s inconsistent", __func__, hash.ToString());
+            }
+            for (unsigned int j = 0; j < tx.vin.size(); j++) {
+                const COutPoint& prevout = tx.vin[j].prevout;
+                const Coin& coin = txundo.vprevout[j];
+                if (!GetIndexAddress(prevout, coin.out.scriptPubKey, type, addressHash)) {
+                    continue;
+                }
+                addressIndex.push_back(std::make_pair(CAddressIndexKey(type, addressHash, pindex->nHeight, i, hash, j, true), coin.out.nValue * -1));
+
+                const auto unspentKey = std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressUnspentKey(type, addressHash, prevout.hash, prevout.n));
+                const auto spentKey = std::make_pair(DB_SPENTINDEX, CSpentIndexKey(prevout.hash, prevout.n));
+                if (fDisconnect) {
+                    batch.Write(unspentKey, CAddressUnspentValue(coin.out.nValue, coin.out.scriptPubKey, coin.nHeight, coin.fCoinStake));
+                    batch.Erase(spentKey);
+                } else {
+                    batch.Erase(unspentKey);
+                    batch.Write(spentKey, CSpentIndexValue(hash, j, pindex->nHeight, coin.out.nValue, type, addressHash));
+                }
+            }
+        }
+
+        for (unsigned int k = 0; k < tx.vout.size(); k++) {
+            const CTxOut& out = tx.vout[k];
+            if (!GetIndexAddress({hash, k}, out.scriptPubKey, type, addressHash)) {
+                continue;
+            }
+            addressIndex.push_back(std::make_pair(CAddressIndexKey(type, addressHash, pindex->nHeight, i, hash, k, false), out.nValue));
+
+            const auto unspentKey = std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressUnspentKey(type, addressHash, hash, k));
+            if (fDisconnect) {
+                batch.Erase(unspentKey);
+            } else {
+                batch.Write(unspentKey, CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight, tx.IsCoinStake()));
+            }
+        }
+    }
+
+    for (const std::pair<CAddressIndexKey, CAmount>& entry : addressIndex) {
+        if (fDisconnect) {
+            batch.Erase(std::make_pair(DB_ADDRESSINDEX, entry.first));
+        } else {
+            batch.Write(std::make_pair(DB_ADDRESSINDEX, entry.first), entry.second);
+        }
+    }
+    std::map<std::pair<unsigned int, uint256>, CAddressBalanceValue> balances;
+    UpdateAddressBalances(*m_db, batch, balances, addressIndex, fDisconnect);
+    return true;
+}
+
+bool AddressIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    // The genesis block outputs are not spendable and were never indexed
+    if (pindex->nHeight == 0) {
+        return true;
+    }
+
+    CBlockUndo blockundo;
+    if (!UndoReadFromDisk(blockundo, pindex)) {
+        return false;
+    }
+
+    CDBBatch batch(*m_db);
+    if (!WriteBlockEntries(batch, block, blockundo, pindex, false)) {
+        return false;
+    }
+
+    unsigned int logicalTS = pindex->nTime;
+    CTimestampBlockIndexValue prevLogicalTS;
+
+    // retrieve logical timestamp of the previous block
+    if (pindex->pprev && !m_db->Read(std::make_pair(DB_BLOCKHASHINDEX, pindex->pprev->GetBlockHash()), prevLogicalTS))
+        LogPrint(BCLog::COINDB, "%s: Failed to read previous block's logical timestamp\n", __func__);
+
+    if (logicalTS <= prevLogicalTS.ltimestamp) {
+        logicalTS = prevLogicalTS.ltimestamp + 1;
+        LogPrint(BCLog::COINDB, "%s: Previous logical timestamp is newer Actual[%d] prevLogical[%d] Logical[%d]\n", __func__, pindex->nTime, prevLogicalTS.ltimestamp, logicalTS);
+    }
+
+    batch.Write(std::make_pair(DB_TIMESTAMPINDEX, CTimestampIndexKey(logicalTS, pindex->GetBlockHash())), 0);
+    batch.Write(std::make_pair(DB_BLOCKHASHINDEX, CTimestampBlockIndexKey(pindex->GetBlockHash())), CTimestampBlockIndexValue(logicalTS));
+    return m_db->WriteBatch(batch);
+}
+
+bool AddressIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    // One batch per block, the balances of the next block down are read back from the database
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        CBlock block;
+        CBlockUndo blockundo;
+        if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus()) || !UndoReadFromDisk(blockundo, pindex)) {
+            return error("%s: Failed to read block %s from disk", __func__, pindex->GetBlockHash().ToString());
+        }
+        CDBBatch batch(*m_db);
+        if (!WriteBlockEntries(batch, block, blockundo, pindex, true) || !m_db->WriteBatch(batch)) {
+            return false;
+        }
+    }
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+BaseIndex::DB& AddressIndex::GetDB() const { return *m_db; }
+
+bool AddressIndex::FindAddressIndex(uint256 addressHash, int type, std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                                    int start, int end) const
+{
+    std::unique_ptr<CDBIterator> pcursor(m_db->NewIterator());
+
+    if (start > 0 && end > 0) {
+        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
+    } else {
+        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash) {
+            if (end > 0 && key.second.blockHeight > end) {
+                break;
+            }
+            CAmount nValue;
+            if (pcursor->GetValue(nValue)) {
+                addressIndex.push_back(std::make_pair(key.second, nValue));
+                pcursor->Next();
+            } else {
+                return error("failed to get address index value");
+            }
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool AddressIndex::FindAddressIndexPage(uint256 addressHash, int type, int start, int end, const CAddressIndexKey* cursor,
+                                        bool reverse, size_t limit, std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex) const
+{
+    std::unique_ptr<CDBIterator> pcursor(m_db->NewIterator());
+
+    // A cursor outside of the heights is where the heights start
+    if (cursor && (reverse ? (end > 0 && cursor->blockHeight > end) : (start > 0 && cursor->blockHeight < start))) {
+        cursor = nullptr;
+    }
+
+    if (cursor) {
+        CAddressIndexKey from(type, addressHash, cursor->blockHeight, cursor->txindex, cursor->txhash, cursor->index, cursor->spending);
+        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, from));
+        std::pair<char,CAddressIndexKey> key;
+        if (reverse) {
+            if (pcursor->Valid()) {
+                pcursor->Prev();
+            } else {
+                pcursor->SeekToLast();
+            }
+        } else if (pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX &&
+                   key.second.type == from.type && key.second.hashBytes == from.hashBytes && key.second.blockHeight == from.blockHeight &&
+                   key.second.txindex == from.txindex && key.second.txhash == from.txhash && key.second.index == from.index &&
+                   key.second.spending == from.spending) {
+            pcursor->Next();
+        }
+    } else if (reverse) {
+        // Step back from the first entry above the heights
+        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, end > 0 ? end + 1 : std::numeric_limits<int>::max())));
+        if (pcursor->Valid()) {
+            pcursor->Prev();
+        } else {
+            pcursor->SeekToLast();
+        }
+    } else if (start > 0) {
+        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
+    } else {
+        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
+
+    size_t nRead = 0;
+    while (pcursor->Valid() && (limit == 0 || nRead < limit)) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSINDEX || key.second.type != (unsigned int)type || key.second.hashBytes != addressHash) {
+            break;
+        }
+        if (reverse ? (start > 0 && key.second.blockHeight < start) : (end > 0 && key.second.blockHeight > end)) {
+            break;
+        }
+        CAmount nValue;
+        if (!pcursor->GetValue(nValue)) {
+            return error("failed to get address index value");
+        }
+        addressIndex.push_back(std::make_pair(key.second, nValue));
+        nRead++;
+        if (reverse) {
+            pcursor->Prev();
+        } else {
+            pcursor->Next();
+        }
+    }
+
+    return true;
+}
+
+bool AddressIndex::FindAddressUnspent(uint256 addressHash, int type, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) const
+{
+    std::unique_ptr<CDBIterator> pcursor(m_db->NewIterator());
+    pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressUnspentKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
+            CAddressUnspentValue nValue;
+            if (pcursor->GetValue(nValue)) {
+                unspentOutputs.push_back(std::make_pair(key.second, nValue));
+                pcursor->Next();
+            } else {
+                return error("failed to get address unspent value");
+            }
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool AddressIndex::FindAddressBalance(uint256 addressHash, int type, CAddressBalanceValue &value) const
+{
+    value.SetNull();
+    // No entry is an address without index entries
+    m_db->Read(std::make_pair(DB_ADDRESSBALANCEINDEX, CAddressIndexIteratorKey(type, addressHash)), value);
+    return true;
+}
+
+bool AddressIndex::FindSpentIndex(const CSpentIndexKey &key, CSpentIndexValue &value) const
+{
+    return m_db->Read(std::make_pair(DB_SPENTINDEX, key), value);
+}
+
+bool AddressIndex::FindTimestampIndex(unsigned int high, unsigned int low, bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &hashes) const
+{
+    std::unique_ptr<CDBIterator> pcursor(m_db->NewIterator());
+
+    pcursor->Seek(std::make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low)));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CTimestampIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp < high) {
+            if (fActiveOnly) {
+                LOCK(cs_main);
+                const CBlockIndex* pblockindex = LookupBlockIndex(key.second.blockHash);
+                if (pblockindex && ::ChainActive().Contains(pblockindex)) {
+                    hashes.push_back(std::make_pair(key.second.blockHash, key.second.timestamp));
+                }
+            } else {
+                hashes.push_back(std::make_pair(key.second.blockHash, key.second.timestamp));
+            }
+
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+#endif // ENABLE_BITCORE_RPC
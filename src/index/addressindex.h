@@ -0,0 +1,84 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_ADDRESSINDEX_H
+#define BITCOIN_INDEX_ADDRESSINDEX_H
+
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
+#ifdef ENABLE_BITCORE_RPC
+#include <chain.h>
+#include <coins.h>
+#include <index/base.h>
+#include <txdb.h>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+class CBlockUndo;
+
+/**
+ * AddressIndex keeps the address, unspent, spent and timestamp indexes used by
+ * the block explorer RPCs in their own database. The entries of a block are
+ * computed from the block and its undo data, so the index catches up in the
+ * background and follows the chain through the validation interface instead
+ * of being written by ConnectBlock.
+ */
+class AddressIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+    /// Write the entries of a block to the batch, or take them away when fDisconnect is set.
+    bool WriteBlockEntries(CDBBatch& batch, const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, bool fDisconnect);
+
+protected:
+    bool RewindsOnDisconnect() const override { return true; }
+
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "addressindex"; }
+
+    bool ReadsUndoData() const override { return true; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit AddressIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~AddressIndex() override;
+
+    bool FindAddressIndex(uint256 addressHash, int type, std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                          int start = 0, int end = 0) const;
+
+    /** Find at most limit entries (all when 0) between the heights start and end (unbounded when 0), in
+     *  height order or from the highest height down. With a cursor, reading resumes past that position. */
+    bool FindAddressIndexPage(uint256 addressHash, int type, int start, int end, const CAddressIndexKey* cursor,
+                              bool reverse, size_t limit, std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex) const;
+
+    bool FindAddressUnspent(uint256 addressHash, int type, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) const;
+
+    bool FindAddressBalance(uint256 addressHash, int type, CAddressBalanceValue &value) const;
+
+    bool FindSpentIndex(const CSpentIndexKey &key, CSpentIndexValue &value) const;
+
+    bool FindTimestampIndex(unsigned int high, unsigned int low, bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &hashes) const;
+};
+
+/// The global address index, used by the block explorer RPCs. May be null.
+extern std::unique_ptr<AddressIndex> g_addressindex;
+
+#endif // ENABLE_BITCORE_RPC
+
+#endif // BITCOIN_INDEX_ADDRESSINDEX_H
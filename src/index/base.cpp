@@ -11,10 +11,20 @@
 #include <validation.h>
 #include <warnings.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+
 constexpr char DB_BEST_BLOCK = 'B';
 
 constexpr int64_t SYNC_LOG_INTERVAL = 30; // seconds
 constexpr int64_t SYNC_LOCATOR_WRITE_INTERVAL = 30; // seconds
+/** Maximum number of threads reading blocks ahead of the sync thread */
+constexpr int MAX_SYNC_READ_THREADS = 4;
+/** Number of blocks read ahead of the one being written during the initial sync */
+constexpr int SYNC_READ_AHEAD = 32;
 
 template<typename... Args>
 static void FatalError(const char* fmt, const Args&... args)
@@ -85,11 +95,148 @@ static const CBlockIndex* NextSyncBlock(const CBlockIndex* pindex_prev) EXCLUSIV
     return ::ChainActive().Next(::ChainActive().FindFork(pindex_prev));
 }
 
+namespace {
+
+/**
+ * Reads the blocks an index syncs with on worker threads, ahead of the sync thread which writes
+ * them in chain order. Blocks are scheduled in chain order and taken back in the same order, the
+ * ones scheduled on a branch that got reorganized away are dropped with Cancel.
+ */
+class SyncBlockReader
+{
+public:
+    struct Job {
+        const CBlockIndex* pindex;
+        CBlock block;
+        bool done{false};
+        bool read_ok{false};
+        bool prepare_ok{false};
+
+        explicit Job(const CBlockIndex* pindex_in) : pindex(pindex_in) {}
+    };
+
+private:
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    //! Jobs not taken by a worker yet
+    std::deque<std::shared_ptr<Job>> m_pending GUARDED_BY(m_mutex);
+    //! All scheduled jobs in chain order, done or not
+    std::deque<std::shared_ptr<Job>> m_scheduled GUARDED_BY(m_mutex);
+    bool m_stop GUARDED_BY(m_mutex){false};
+    std::vector<std::thread> m_threads;
+
+    void ThreadRead(const std::function<bool(const CBlock&, const CBlockIndex*)>& prepare)
+    {
+        const Consensus::Params& consensus_params = Params().GetConsensus();
+        while (true) {
+            std::shared_ptr<Job> job;
+            {
+                WAIT_LOCK(m_mutex, lock);
+                m_cond.wait(lock, [&] { return m_stop || !m_pending.empty(); });
+                if (m_stop) return;
+                job = std::move(m_pending.front());
+                m_pending.pop_front();
+            }
+
+            bool read_ok = ReadBlockFromDisk(job->block, job->pindex, consensus_params);
+            bool prepare_ok = read_ok && prepare(job->block, job->pindex);
+            {
+                LOCK(m_mutex);
+                job->read_ok = read_ok;
+                job->prepare_ok = prepare_ok;
+                job->done = true;
+            }
+            m_cond.notify_all();
+        }
+    }
+
+public:
+    SyncBlockReader(const std::string& name, int n_threads, std::function<bool(const CBlock&, const CBlockIndex*)> prepare)
+    {
+        for (int i = 0; i < n_threads; ++i) {
+            std::string thread_name = strprintf("%s.read.%d", name, i);
+            m_threads.emplace_back([this, prepare, thread_name] {
+                TraceThread(thread_name.c_str(), [&] { ThreadRead(prepare); });
+            });
+        }
+    }
+
+    ~SyncBlockReader()
+    {
+        {
+            LOCK(m_mutex);
+            m_stop = true;
+        }
+        m_cond.notify_all();
+        for (std::thread& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    size_t Size()
+    {
+        LOCK(m_mutex);
+        return m_scheduled.size();
+    }
+
+    /** The block scheduled first, null when nothing is scheduled */
+    const CBlockIndex* Front()
+    {
+        LOCK(m_mutex);
+        return m_scheduled.empty() ? nullptr : m_scheduled.front()->pindex;
+    }
+
+    /** The block scheduled last, null when nothing is scheduled */
+    const CBlockIndex* Back()
+    {
+        LOCK(m_mutex);
+        return m_scheduled.empty() ? nullptr : m_scheduled.back()->pindex;
+    }
+
+    void Schedule(const CBlockIndex* pindex)
+    {
+        {
+            LOCK(m_mutex);
+            std::shared_ptr<Job> job = std::make_shared<Job>(pindex);
+            m_scheduled.push_back(job);
+            m_pending.push_back(std::move(job));
+        }
+        m_cond.notify_one();
+    }
+
+    /** Drop all scheduled blocks, the ones being read are thrown away when done */
+    void Cancel()
+    {
+        LOCK(m_mutex);
+        m_pending.clear();
+        m_scheduled.clear();
+    }
+
+    /** Wait for the block scheduled first and take it, null when interrupted first */
+    std::shared_ptr<Job> Pop(const CThreadInterrupt& interrupt)
+    {
+        WAIT_LOCK(m_mutex, lock);
+        assert(!m_scheduled.empty());
+        while (!m_scheduled.front()->done) {
+            if (interrupt) return nullptr;
+            m_cond.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        std::shared_ptr<Job> job = std::move(m_scheduled.front());
+        m_scheduled.pop_front();
+        return job;
+    }
+};
+
+} // namespace
+
 void BaseIndex::ThreadSync()
 {
     const CBlockIndex* pindex = m_best_block_index.load();
     if (!m_synced) {
-        auto& consensus_params = Params().GetConsensus();
+        const int n_threads = std::max(1, std::min(GetNumCores(), MAX_SYNC_READ_THREADS));
+        SyncBlockReader reader(GetName(), n_threads, [this](const CBlock& block, const CBlockIndex* block_index) {
+            return PrepareBlock(block, block_index);
+        });
 
         int64_t last_log_time = 0;
         int64_t last_locator_write_time = 0;
@@ -119,6 +266,23 @@ void BaseIndex::ThreadSync()
                     return;
                 }
                 pindex = pindex_next;
+
+                // Blocks read ahead on a branch that is no longer active are of no use
+                if (reader.Front() != pindex) {
+                    reader.Cancel();
+                    reader.Schedule(pindex);
+                }
+                for (const CBlockIndex* pindex_ahead = ::ChainActive().Next(reader.Back());
+                     pindex_ahead && reader.Size() < (size_t)SYNC_READ_AHEAD;
+                     pindex_ahead = ::ChainActive().Next(pindex_ahead)) {
+                    reader.Schedule(pindex_ahead);
+                }
+                if (ReadsUndoData()) {
+                    const CBlockIndex* pindex_ahead = pindex;
+                    for (int i = 0; i <= UNDO_READ_AHEAD && pindex_ahead; i++, pindex_ahead = ::ChainActive().Next(pindex_ahead)) {
+                        PrefetchUndo(pindex_ahead);
+                    }
+                }
             }
 
             int64_t current_time = GetTime();
@@ -128,24 +292,37 @@ void BaseIndex::ThreadSync()
                 last_log_time = current_time;
             }
 
-            if (last_locator_write_time + SYNC_LOCATOR_WRITE_INTERVAL < current_time) {
-                m_best_block_index = pindex;
-                last_locator_write_time = current_time;
-                // No need to handle errors in Commit. See rationale above.
+            std::shared_ptr<SyncBlockReader::Job> job = reader.Pop(m_interrupt);
+            if (!job) {
+                // Interrupted while the block was being read, it is written on restart
+                m_best_block_index = pindex->pprev;
                 Commit();
+                return;
             }
-
-            CBlock block;
-            if (!ReadBlockFromDisk(block, pindex, consensus_params)) {
+            if (!job->read_ok) {
                 FatalError("%s: Failed to read block %s from disk",
                            __func__, pindex->GetBlockHash().ToString());
                 return;
             }
-            if (!WriteBlock(block, pindex)) {
+            if (!job->prepare_ok || !WriteBlock(job->block, pindex)) {
+                if (m_interrupt || ShutdownRequested()) {
+                    // A WriteBlock cut short by shutdown resumes from this block on restart.
+                    m_best_block_index = pindex->pprev;
+                    Commit();
+                    return;
+                }
                 FatalError("%s: Failed to write block %s to index database",
                            __func__, pindex->GetBlockHash().ToString());
                 return;
             }
+
+            // The locator only ever points at blocks that have been written in full
+            m_best_block_index = pindex;
+            if (last_locator_write_time + SYNC_LOCATOR_WRITE_INTERVAL < current_time) {
+                last_locator_write_time = current_time;
+                // No need to handle errors in Commit. See rationale above.
+                Commit();
+            }
         }
     }
 
@@ -231,6 +408,22 @@ void BaseIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const
     }
 }
 
+void BaseIndex::BlockDisconnected(const std::shared_ptr<const CBlock>& block)
+{
+    if (!m_synced || !RewindsOnDisconnect()) {
+        return;
+    }
+
+    const CBlockIndex* best_block_index = m_best_block_index.load();
+    if (!best_block_index || best_block_index->GetBlockHash() != block->GetHash() || !best_block_index->pprev) {
+        return;
+    }
+    // A failed rewind is tried again by the next connected block
+    if (!Rewind(best_block_index, best_block_index->pprev)) {
+        LogPrintf("%s: WARNING: Failed to rewind index %s to a previous chain tip\n", __func__, GetName());
+    }
+}
+
 void BaseIndex::ChainStateFlushed(const CBlockLocator& locator)
 {
     if (!m_synced) {
@@ -302,8 +495,9 @@ void BaseIndex::Interrupt()
 void BaseIndex::Start()
 {
     // Need to register this ValidationInterface before running Init(), so that
-    // callbacks are not missed if Init sets m_synced to true.
-    RegisterValidationInterface(this);
+    // callbacks are not missed if Init sets m_synced to true. A queue of its own
+    // keeps a slow index from holding up the other subscribers.
+    RegisterQueuedValidationInterface(this, GetName());
     if (!Init()) {
         FatalError("%s: %s failed to initialize", __func__, GetName());
         return;
@@ -315,7 +509,7 @@ void BaseIndex::Start()
 
 void BaseIndex::Stop()
 {
-    UnregisterValidationInterface(this);
+    UnregisterQueuedValidationInterface(this);
 
     if (m_thread_sync.joinable()) {
         m_thread_sync.join();
@@ -70,12 +70,20 @@ protected:
 
     void ChainStateFlushed(const CBlockLocator& locator) override;
 
+    void BlockDisconnected(const std::shared_ptr<const CBlock>& block) override;
+
     /// Initialize internal state from the database and block index.
     virtual bool Init();
 
     /// Write update index entries for a newly connected block.
     virtual bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) { return true; }
 
+    /// Work on a newly connected block that does not depend on the blocks before it. During the
+    /// initial sync it runs on the threads reading blocks ahead, before WriteBlock is called for
+    /// the block in chain order, so it must be thread safe. WriteBlock must still handle blocks
+    /// that were not prepared, such as those from BlockConnected.
+    virtual bool PrepareBlock(const CBlock& block, const CBlockIndex* pindex) { return true; }
+
     /// Virtual method called internally by Commit that can be overridden to atomically
     /// commit more index state.
     virtual bool CommitInternal(CDBBatch& batch);
@@ -84,6 +92,13 @@ protected:
     /// be an ancestor of the current best block.
     virtual bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip);
 
+    /// Whether WriteBlock reads the undo data of the block, which the sync thread then reads ahead.
+    virtual bool ReadsUndoData() const { return false; }
+
+    /// Whether the index is rewound as soon as its tip is disconnected, instead of when the next
+    /// block is connected, so its lookups do not return entries of blocks no longer in the chain.
+    virtual bool RewindsOnDisconnect() const { return false; }
+
     virtual DB& GetDB() const = 0;
 
     /// Get the name of the index for display in logs.
@@ -102,6 +117,12 @@ public:
 
     void Interrupt();
 
+    /// Whether the index has caught up with the chain once and follows it through ValidationInterface.
+    bool IsSynced() const { return m_synced; }
+
+    /// The last block the index is in sync with, which may be off the active chain after a reorg. May be null.
+    const CBlockIndex* GetBestBlockIndex() const { return m_best_block_index.load(); }
+
     /// Start initializes the sync state and registers the instance as a
     /// ValidationInterface so that it stays in sync with blockchain updates.
     void Start();
@@ -6,6 +6,9 @@
 
 #include <dbwrapper.h>
 #include <index/blockfilterindex.h>
+#include <index/receiptindex.h>
+#include <qtum/storageresults.h>
+#include <util/convert.h>
 #include <util/system.h>
 #include <validation.h>
 
@@ -28,6 +31,9 @@ constexpr char DB_BLOCK_HASH = 's';
 constexpr char DB_BLOCK_HEIGHT = 't';
 constexpr char DB_FILTER_POS = 'P';
 
+/** Maximum number of checkpoint filter headers kept in memory, enough for 2M blocks */
+constexpr size_t CF_HEADERS_CACHE_MAX_SZ = 2000;
+
 constexpr unsigned int MAX_FLTR_FILE_SIZE = 0x1000000; // 16 MiB
 /** The pre-allocation chunk size for fltr?????.dat files */
 constexpr unsigned int FLTR_FILE_CHUNK_SIZE = 0x100000; // 1 MiB
@@ -153,6 +159,11 @@ bool BlockFilterIndex::ReadFilterFromDisk(const FlatFilePos& pos, BlockFilter& f
         return false;
     }
 
+    return ReadFilterFromFile(filein, filter);
+}
+
+bool BlockFilterIndex::ReadFilterFromFile(CAutoFile& filein, BlockFilter& filter) const
+{
     uint256 block_hash;
     std::vector<unsigned char> encoded_filter;
     try {
@@ -212,16 +223,74 @@ size_t BlockFilterIndex::WriteFilterToDisk(FlatFilePos& pos, const BlockFilter&
     return data_size;
 }
 
-bool BlockFilterIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+/** The contract addresses and topics of the logs the block emitted, from its receipts. */
+static GCSFilter::ElementSet EvmLogFilterElements(const CBlock& block, const uint256& block_hash)
+{
+    GCSFilter::ElementSet elements;
+
+    for (const CTransactionRef& tx : block.vtx) {
+        if (!tx->HasCreateOrCall()) {
+            continue;
+        }
+        std::vector<TransactionReceiptInfo> receipts;
+        if (!pstorageresult->getResultLogs(uintToh256(tx->GetHash()), receipts)) {
+            continue;
+        }
+        for (const TransactionReceiptInfo& receipt : receipts) {
+            // receipts of the transaction in blocks of other branches
+            if (receipt.blockHash != block_hash) {
+                continue;
+            }
+            for (const dev::eth::LogEntry& log : receipt.logs) {
+                elements.emplace(log.address.asBytes());
+                for (const dev::h256& topic : log.topics) {
+                    elements.emplace(topic.asBytes());
+                }
+            }
+        }
+    }
+
+    return elements;
+}
+
+bool BlockFilterIndex::BuildBasicFilter(const CBlock& block, const CBlockIndex* pindex, BlockFilter& filter) const
 {
     CBlockUndo block_undo;
+    if (pindex->nHeight > 0 && !UndoReadFromDisk(block_undo, pindex)) {
+        return false;
+    }
+    filter = BlockFilter(m_filter_type, block, block_undo);
+    return true;
+}
+
+bool BlockFilterIndex::PrepareBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    // The log filters wait for the receipts of the block, which are written in chain order
+    if (m_filter_type != BlockFilterType::BASIC) {
+        return true;
+    }
+
+    BlockFilter filter;
+    if (!BuildBasicFilter(block, pindex, filter)) {
+        return false;
+    }
+    LOCK(m_cs_prepared_filters);
+    m_prepared_filters.emplace(pindex->GetBlockHash(), std::move(filter));
+    return true;
+}
+
+bool BlockFilterIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
     uint256 prev_header;
 
-    if (pindex->nHeight > 0) {
-        if (!UndoReadFromDisk(block_undo, pindex)) {
+    if (m_filter_type == BlockFilterType::EVM_LOGS) {
+        // receipts of blocks connected before -logevents are still being rebuilt
+        if (g_receiptindex && !g_receiptindex->BlockUntilReceipts(pindex)) {
             return false;
         }
+    }
 
+    if (pindex->nHeight > 0) {
         std::pair<uint256, DBVal> read_out;
         if (!m_db->Read(DBHeightKey(pindex->nHeight - 1), read_out)) {
             return false;
@@ -236,7 +305,24 @@ bool BlockFilterIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex
         prev_header = read_out.second.header;
     }
 
-    BlockFilter filter(m_filter_type, block, block_undo);
+    BlockFilter filter;
+    if (m_filter_type == BlockFilterType::EVM_LOGS) {
+        filter = BlockFilter(m_filter_type, pindex->GetBlockHash(), EvmLogFilterElements(block, pindex->GetBlockHash()));
+    } else {
+        bool prepared = false;
+        {
+            LOCK(m_cs_prepared_filters);
+            auto it = m_prepared_filters.find(pindex->GetBlockHash());
+            if (it != m_prepared_filters.end()) {
+                filter = std::move(it->second);
+                m_prepared_filters.erase(it);
+                prepared = true;
+            }
+        }
+        if (!prepared && !BuildBasicFilter(block, pindex, filter)) {
+            return false;
+        }
+    }
 
     size_t bytes_written = WriteFilterToDisk(m_next_filter_pos, filter);
     if (bytes_written == 0) return false;
@@ -389,11 +475,28 @@ bool BlockFilterIndex::LookupFilter(const CBlockIndex* block_index, BlockFilter&
 
 bool BlockFilterIndex::LookupFilterHeader(const CBlockIndex* block_index, uint256& header_out) const
 {
+    LOCK(m_cs_headers_cache);
+
+    // Only the headers of checkpoint heights are cached, they are what getcfcheckpt asks for over
+    // and over, every time from the genesis block.
+    const bool is_checkpoint = block_index->nHeight % CFCHECKPT_INTERVAL == 0;
+    if (is_checkpoint) {
+        auto header = m_headers_cache.find(block_index->GetBlockHash());
+        if (header != m_headers_cache.end()) {
+            header_out = header->second;
+            return true;
+        }
+    }
+
     DBVal entry;
     if (!LookupOne(*m_db, block_index, entry)) {
         return false;
     }
 
+    if (is_checkpoint && m_headers_cache.size() < CF_HEADERS_CACHE_MAX_SZ) {
+        m_headers_cache.emplace(block_index->GetBlockHash(), entry.header);
+    }
+
     header_out = entry.header;
     return true;
 }
@@ -406,13 +509,31 @@ bool BlockFilterIndex::LookupFilterRange(int start_height, const CBlockIndex* st
         return false;
     }
 
+    // Filters of consecutive blocks are appended to the same file one after the other, so each file
+    // is opened once for the run of entries it holds and only repositioned when they are not adjacent.
     filters_out.resize(entries.size());
     auto filter_pos_it = filters_out.begin();
-    for (const auto& entry : entries) {
-        if (!ReadFilterFromDisk(entry.pos, *filter_pos_it)) {
+    auto entry_it = entries.cbegin();
+    while (entry_it != entries.cend()) {
+        const int file_num = entry_it->pos.nFile;
+        CAutoFile filein(m_filter_fileseq->Open(entry_it->pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull()) {
             return false;
         }
-        ++filter_pos_it;
+
+        unsigned int next_pos = entry_it->pos.nPos;
+        for (; entry_it != entries.cend() && entry_it->pos.nFile == file_num; ++entry_it) {
+            if (entry_it->pos.nPos != next_pos && fseek(filein.Get(), entry_it->pos.nPos, SEEK_SET)) {
+                return error("%s: Failed to seek to %s", __func__, entry_it->pos.ToString());
+            }
+            if (!ReadFilterFromFile(filein, *filter_pos_it)) {
+                return false;
+            }
+            next_pos = entry_it->pos.nPos +
+                GetSerializeSize(filter_pos_it->GetBlockHash(), CLIENT_VERSION) +
+                GetSerializeSize(filter_pos_it->GetEncodedFilter(), CLIENT_VERSION);
+            ++filter_pos_it;
+        }
     }
 
     return true;
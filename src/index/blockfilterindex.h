@@ -7,8 +7,22 @@
 
 #include <blockfilter.h>
 #include <chain.h>
+#include <crypto/common.h>
 #include <flatfile.h>
 #include <index/base.h>
+#include <sync.h>
+
+#include <unordered_map>
+
+class CAutoFile;
+
+/** Interval between compact filter checkpoints. See BIP 157. */
+static constexpr int CFCHECKPT_INTERVAL = 1000;
+
+struct FilterHeaderHasher
+{
+    size_t operator()(const uint256& hash) const { return ReadLE64(hash.begin()); }
+};
 
 /**
  * BlockFilterIndex is used to store and retrieve block filters, hashes, and headers for a range of
@@ -27,7 +41,18 @@ private:
     FlatFilePos m_next_filter_pos;
     std::unique_ptr<FlatFileSeq> m_filter_fileseq;
 
+    /** Filter headers of checkpoint blocks by block hash, most requested by getcfcheckpt. */
+    mutable Mutex m_cs_headers_cache;
+    mutable std::unordered_map<uint256, uint256, FilterHeaderHasher> m_headers_cache GUARDED_BY(m_cs_headers_cache);
+
+    /** Basic filters built by PrepareBlock during the initial sync, waiting for WriteBlock. */
+    Mutex m_cs_prepared_filters;
+    std::unordered_map<uint256, BlockFilter, FilterHeaderHasher> m_prepared_filters GUARDED_BY(m_cs_prepared_filters);
+
+    bool BuildBasicFilter(const CBlock& block, const CBlockIndex* pindex, BlockFilter& filter) const;
+
     bool ReadFilterFromDisk(const FlatFilePos& pos, BlockFilter& filter) const;
+    bool ReadFilterFromFile(CAutoFile& filein, BlockFilter& filter) const;
     size_t WriteFilterToDisk(FlatFilePos& pos, const BlockFilter& filter);
 
 protected:
@@ -35,6 +60,8 @@ protected:
 
     bool CommitInternal(CDBBatch& batch) override;
 
+    bool PrepareBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
     bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
 
     bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
@@ -43,6 +70,9 @@ protected:
 
     const char* GetName() const override { return m_name.c_str(); }
 
+    /** Only the basic filters need the spent outputs. */
+    bool ReadsUndoData() const override { return m_filter_type == BlockFilterType::BASIC; }
+
 public:
     /** Constructs the index, which becomes available to be queried. */
     explicit BlockFilterIndex(BlockFilterType filter_type,
@@ -0,0 +1,196 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <coins.h>
+#include <index/coinstatsindex.h>
+#include <node/coinstats.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+
+/* The index database keeps a single State under DB_STATE, written with every block. The block
+ * locator of the base index is only written now and then, so after a restart the state may be
+ * ahead of it and Init takes the extra blocks back out.
+ */
+constexpr char DB_STATE = 'S';
+
+std::unique_ptr<CoinStatsIndex> g_coin_stats_index;
+
+CoinStatsIndex::CoinStatsIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<BaseIndex::DB>(GetDataDir() / "indexes" / "coinstatsindex", n_cache_size, f_memory, f_wipe))
+{}
+
+bool CoinStatsIndex::Init()
+{
+    State state;
+    if (!m_db->Read(DB_STATE, state) && m_db->Exists(DB_STATE)) {
+        return error("%s: Cannot read current %s state; index may be corrupted",
+                     __func__, GetName());
+    }
+    WITH_LOCK(m_state_mutex, m_state = state);
+
+    if (!BaseIndex::Init()) {
+        return false;
+    }
+
+    const CBlockIndex* best_block_index = GetBestBlockIndex();
+    const CBlockIndex* state_index = nullptr;
+    if (!state.block_hash.IsNull()) {
+        LOCK(cs_main);
+        state_index = LookupBlockIndex(state.block_hash);
+        if (!state_index) {
+            return error("%s: %s state belongs to unknown block %s",
+                         __func__, GetName(), state.block_hash.ToString());
+        }
+    }
+    if (state_index == best_block_index) {
+        return true;
+    }
+    if (!state_index || (best_block_index && state_index->GetAncestor(best_block_index->nHeight) != best_block_index)) {
+        return error("%s: %s state at block %s is not ahead of the best block; index may be corrupted",
+                     __func__, GetName(), state.block_hash.ToString());
+    }
+    return RewindState(state_index, best_block_index);
+}
+
+/** Add a coin to the state or take it away */
+template <typename State>
+static void ApplyCoin(State& state, const COutPoint& outpoint, const Coin& coin, bool fAdd)
+{
+    const CScript& script = coin.out.scriptPubKey;
+    if (fAdd) {
+        ApplyCoinHash(state.muhash, outpoint, coin);
+        state.transaction_output_count++;
+        state.bogo_size += GetBogoSize(script);
+        state.total_amount += coin.out.nValue;
+        if (IsContractOutput(script)) {
+            state.contract_output_count++;
+            state.contract_amount += coin.out.nValue;
+        }
+    } else {
+        RemoveCoinHash(state.muhash, outpoint, coin);
+        state.transaction_output_count--;
+        state.bogo_size -= GetBogoSize(script);
+        state.total_amount -= coin.out.nValue;
+        if (IsContractOutput(script)) {
+            state.contract_output_count--;
+            state.contract_amount -= coin.out.nValue;
+        }
+    }
+}
+
+bool CoinStatsIndex::ApplyBlock(State& state, const CBlock& block, const CBlockIndex* pindex, bool fDisconnect) const
+{
+    // The outputs of the genesis block are never added to the coin set
+    if (pindex->nHeight == 0) {
+        return true;
+    }
+
+    CBlockUndo block_undo;
+    if (!UndoReadFromDisk(block_undo, pindex)) {
+        return error("%s: Failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+    }
+    if (block_undo.vtxundo.size() + 1 != block.vtx.size()) {
+        return error("%s: Block %s and undo data inconsistent", __func__, pindex->GetBlockHash().ToString());
+    }
+
+    for (size_t i = 0; i < block.vtx.size(); ++i) {
+        const CTransaction& tx = *block.vtx[i];
+        for (uint32_t j = 0; j < tx.vout.size(); ++j) {
+            if (tx.vout[j].scriptPubKey.IsUnspendable()) {
+                continue;
+            }
+            Coin coin(tx.vout[j], pindex->nHeight, tx.IsCoinBase(), tx.IsCoinStake());
+            ApplyCoin(state, COutPoint(tx.GetHash(), j), coin, !fDisconnect);
+        }
+
+        if (tx.IsCoinBase()) {
+            continue;
+        }
+        const CTxUndo& tx_undo = block_undo.vtxundo[i - 1];
+        if (tx_undo.vprevout.size() != tx.vin.size()) {
+            return error("%s: Transaction %s and undo data inconsistent", __func__, tx.GetHash().ToString());
+        }
+        for (size_t j = 0; j < tx.vin.size(); ++j) {
+            ApplyCoin(state, tx.vin[j].prevout, tx_undo.vprevout[j], fDisconnect);
+        }
+    }
+    return true;
+}
+
+bool CoinStatsIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    State state = WITH_LOCK(m_state_mutex, return m_state);
+    const uint256 prev_hash = pindex->pprev ? pindex->pprev->GetBlockHash() : uint256();
+    if (state.block_hash != prev_hash) {
+        return error("%s: %s state belongs to block %s, expected %s",
+                     __func__, GetName(), state.block_hash.ToString(), prev_hash.ToString());
+    }
+
+    if (!ApplyBlock(state, block, pindex, false)) {
+        return false;
+    }
+    state.block_hash = pindex->GetBlockHash();
+    if (!m_db->Write(DB_STATE, state)) {
+        return false;
+    }
+
+    LOCK(m_state_mutex);
+    m_state = std::move(state);
+    return true;
+}
+
+bool CoinStatsIndex::RewindState(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    const Consensus::Params& consensus_params = Params().GetConsensus();
+    State state = WITH_LOCK(m_state_mutex, return m_state);
+    assert(state.block_hash == current_tip->GetBlockHash());
+
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, consensus_params)) {
+            return error("%s: Failed to read block %s from disk", __func__, pindex->GetBlockHash().ToString());
+        }
+        if (!ApplyBlock(state, block, pindex, true)) {
+            return false;
+        }
+    }
+    state.block_hash = new_tip ? new_tip->GetBlockHash() : uint256();
+    if (!m_db->Write(DB_STATE, state)) {
+        return false;
+    }
+
+    LOCK(m_state_mutex);
+    m_state = std::move(state);
+    return true;
+}
+
+bool CoinStatsIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    if (!RewindState(current_tip, new_tip)) {
+        return false;
+    }
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+bool CoinStatsIndex::LookUpStats(const CBlockIndex* block_index, CCoinsStats& stats) const
+{
+    State state = WITH_LOCK(m_state_mutex, return m_state);
+    if (state.block_hash != block_index->GetBlockHash()) {
+        return false;
+    }
+
+    stats.hashBlock = state.block_hash;
+    stats.nHeight = block_index->nHeight;
+    stats.nTransactionOutputs = state.transaction_output_count;
+    stats.nBogoSize = state.bogo_size;
+    stats.nTotalAmount = state.total_amount;
+    stats.nContractOutputs = state.contract_output_count;
+    stats.nContractAmount = state.contract_amount;
+    state.muhash.Finalize(stats.hashSerialized);
+    return true;
+}
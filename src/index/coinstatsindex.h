@@ -0,0 +1,93 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_COINSTATSINDEX_H
+#define BITCOIN_INDEX_COINSTATSINDEX_H
+
+#include <amount.h>
+#include <chain.h>
+#include <crypto/muhash.h>
+#include <index/base.h>
+#include <serialize.h>
+#include <sync.h>
+#include <uint256.h>
+
+struct CCoinsStats;
+
+static const bool DEFAULT_COINSTATSINDEX = false;
+
+/**
+ * CoinStatsIndex keeps the MuHash of the coin set and its totals up to date
+ * block by block, from the outputs a block creates and the coins its undo data
+ * spends, so gettxoutsetinfo does not have to read the whole coin set. Only the
+ * state at the last indexed block is kept, the blocks of a reorganization are
+ * taken back out with their undo data.
+ */
+class CoinStatsIndex final : public BaseIndex
+{
+private:
+    /** The coin set after the block with hash block_hash */
+    struct State {
+        //! Null before the genesis block is indexed
+        uint256 block_hash;
+        MuHash3072 muhash;
+        uint64_t transaction_output_count{0};
+        uint64_t bogo_size{0};
+        CAmount total_amount{0};
+        uint64_t contract_output_count{0};
+        CAmount contract_amount{0};
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action) {
+            READWRITE(block_hash);
+            READWRITE(muhash);
+            READWRITE(transaction_output_count);
+            READWRITE(bogo_size);
+            READWRITE(total_amount);
+            READWRITE(contract_output_count);
+            READWRITE(contract_amount);
+        }
+    };
+
+    const std::unique_ptr<BaseIndex::DB> m_db;
+
+    mutable Mutex m_state_mutex;
+    State m_state GUARDED_BY(m_state_mutex);
+
+    /// Add the coins the block created to the state and take the ones it spent away, or the reverse when fDisconnect is set.
+    bool ApplyBlock(State& state, const CBlock& block, const CBlockIndex* pindex, bool fDisconnect) const;
+
+    /// Take the blocks after new_tip back out of the state, which must be at current_tip.
+    bool RewindState(const CBlockIndex* current_tip, const CBlockIndex* new_tip);
+
+protected:
+    bool Init() override;
+
+    bool RewindsOnDisconnect() const override { return true; }
+
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    bool ReadsUndoData() const override { return true; }
+
+    BaseIndex::DB& GetDB() const override { return *m_db; }
+
+    const char* GetName() const override { return "coinstatsindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit CoinStatsIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /// Statistics of the coin set after block_index, with the MuHash as the hash. Fails unless
+    /// block_index is the last block indexed. The transactions are not counted.
+    bool LookUpStats(const CBlockIndex* block_index, CCoinsStats& stats) const;
+};
+
+/// The global coin stats index, used by gettxoutsetinfo. May be null.
+extern std::unique_ptr<CoinStatsIndex> g_coin_stats_index;
+
+#endif // BITCOIN_INDEX_COINSTATSINDEX_H
@@ -0,0 +1,241 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/contractindex.h>
+#include <index/receiptindex.h>
+#include <qtum/storageresults.h>
+#include <util/convert.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <algorithm>
+
+/* The index database stores every live contract under its creation and under its address.
+ *
+ * Creation keys have the type [DB_CONTRACT_CREATION, uint32 height (BE), uint32 tx index (BE),
+ * uint160 address] and the value is the ContractEntry, so a page of contracts in a range of heights
+ * is read with a single seek. Address keys have the type [DB_CONTRACT_ADDRESS, uint160 address] and
+ * the same value, they find the creation key of a destructed contract. The number of live contracts
+ * is kept under DB_CONTRACT_COUNT. The contracts created and destructed by each block are also kept
+ * by block hash, the receipts of disconnected blocks are deleted before the index could read them
+ * again to rewind.
+ */
+constexpr char DB_CONTRACT_CREATION = 'c';
+constexpr char DB_CONTRACT_ADDRESS = 'a';
+constexpr char DB_CONTRACT_COUNT = 'n';
+constexpr char DB_CONTRACT_BLOCK = 'k';
+
+std::unique_ptr<ContractIndex> g_contractindex;
+
+namespace {
+
+struct DBCreationKey {
+    int height;
+    uint32_t tx_index;
+    uint160 address;
+
+    DBCreationKey() : height(0), tx_index(0) {}
+    DBCreationKey(int height_in, uint32_t tx_index_in = 0, const uint160& address_in = uint160()) :
+        height(height_in), tx_index(tx_index_in), address(address_in) {}
+    explicit DBCreationKey(const ContractEntry& contract) :
+        DBCreationKey(contract.height, contract.tx_index, contract.address) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_CONTRACT_CREATION);
+        ser_writedata32be(s, height);
+        ser_writedata32be(s, tx_index);
+        s << address;
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_CONTRACT_CREATION) {
+            throw std::ios_base::failure("Invalid format for contract index DB creation key");
+        }
+        height = ser_readdata32be(s);
+        tx_index = ser_readdata32be(s);
+        s >> address;
+    }
+};
+
+/** Contracts created and destructed by a block */
+struct ContractBlockUndo {
+    std::vector<ContractEntry> created;
+    std::vector<ContractEntry> destructed;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(created);
+        READWRITE(destructed);
+    }
+};
+
+}; // namespace
+
+/** Access to the contract index database (indexes/contractindex/) */
+class ContractIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /// Write the changes of a block to the batch, or take them away when fDisconnect is set.
+    bool WriteChanges(CDBBatch& batch, const ContractBlockUndo& changes, bool fDisconnect) const;
+};
+
+ContractIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "contractindex", n_cache_size, f_memory, f_wipe)
+{}
+
+bool ContractIndex::DB::WriteChanges(CDBBatch& batch, const ContractBlockUndo& changes, bool fDisconnect) const
+{
+    uint64_t count = 0;
+    Read(DB_CONTRACT_COUNT, count);
+
+    const std::vector<ContractEntry>& added = fDisconnect ? changes.destructed : changes.created;
+    const std::vector<ContractEntry>& removed = fDisconnect ? changes.created : changes.destructed;
+    for (const ContractEntry& contract : removed) {
+        batch.Erase(DBCreationKey(contract));
+        batch.Erase(std::make_pair(DB_CONTRACT_ADDRESS, contract.address));
+    }
+    for (const ContractEntry& contract : added) {
+        batch.Write(DBCreationKey(contract), contract);
+        batch.Write(std::make_pair(DB_CONTRACT_ADDRESS, contract.address), contract);
+    }
+
+    if (count + added.size() < removed.size()) {
+        return error("%s: Contract count would become negative", __func__);
+    }
+    batch.Write(DB_CONTRACT_COUNT, count + added.size() - removed.size());
+    return true;
+}
+
+ContractIndex::ContractIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<ContractIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+ContractIndex::~ContractIndex() {}
+
+bool ContractIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    // receipts of blocks connected before -logevents are still being rebuilt
+    if (g_receiptindex && !g_receiptindex->BlockUntilReceipts(pindex)) {
+        return false;
+    }
+
+    ContractBlockUndo changes;
+    const uint256 block_hash = pindex->GetBlockHash();
+    for (const CTransactionRef& tx : block.vtx) {
+        if (!tx->HasCreateOrCall()) {
+            continue;
+        }
+        TransactionReceiptsRef receipts = pstorageresult->getResult(uintToh256(tx->GetHash()));
+        for (const TransactionReceiptInfo& receipt : *receipts) {
+            if (receipt.blockHash != block_hash) {
+                continue;
+            }
+            for (const auto& created : receipt.createdContracts) {
+                ContractEntry contract;
+                contract.address = uint160(created.first.asBytes());
+                contract.tx_hash = tx->GetHash();
+                contract.height = pindex->nHeight;
+                contract.tx_index = receipt.transactionIndex;
+                changes.created.push_back(contract);
+            }
+            for (const dev::Address& destructed : receipt.destructedContracts) {
+                const uint160 address(destructed.asBytes());
+                // a contract created and destructed within the block never shows up
+                auto it = std::find_if(changes.created.begin(), changes.created.end(),
+                                       [&](const ContractEntry& contract) { return contract.address == address; });
+                if (it != changes.created.end()) {
+                    changes.created.erase(it);
+                    continue;
+                }
+                ContractEntry contract;
+                if (m_db->Read(std::make_pair(DB_CONTRACT_ADDRESS, address), contract)) {
+                    changes.destructed.push_back(contract);
+                }
+            }
+        }
+    }
+
+    if (changes.created.empty() && changes.destructed.empty()) {
+        return true;
+    }
+
+    CDBBatch batch(*m_db);
+    if (!m_db->WriteChanges(batch, changes, false)) {
+        return false;
+    }
+    batch.Write(std::make_pair(DB_CONTRACT_BLOCK, block_hash), changes);
+    return m_db->WriteBatch(batch);
+}
+
+bool ContractIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    // one batch per block, WriteChanges reads the count left by the block before
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        const auto block_key = std::make_pair(DB_CONTRACT_BLOCK, pindex->GetBlockHash());
+        ContractBlockUndo changes;
+        if (!m_db->Read(block_key, changes)) {
+            continue;
+        }
+        CDBBatch batch(*m_db);
+        if (!m_db->WriteChanges(batch, changes, true)) {
+            return false;
+        }
+        batch.Erase(block_key);
+        if (!m_db->WriteBatch(batch)) {
+            return false;
+        }
+    }
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+BaseIndex::DB& ContractIndex::GetDB() const { return *m_db; }
+
+bool ContractIndex::CountContracts(uint64_t& count) const
+{
+    count = 0;
+    return !m_db->Exists(DB_CONTRACT_COUNT) || m_db->Read(DB_CONTRACT_COUNT, count);
+}
+
+bool ContractIndex::FindContract(const uint160& address, ContractEntry& contract) const
+{
+    return m_db->Read(std::make_pair(DB_CONTRACT_ADDRESS, address), contract);
+}
+
+bool ContractIndex::FindContracts(int from_height, int to_height, size_t skip, size_t limit,
+                                  std::vector<ContractEntry>& contracts) const
+{
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+    db_it->Seek(DBCreationKey(from_height));
+    for (; db_it->Valid() && (limit == 0 || contracts.size() < limit); db_it->Next()) {
+        DBCreationKey key;
+        if (!db_it->GetKey(key)) {
+            break;
+        }
+        if (to_height > -1 && key.height > to_height) {
+            break;
+        }
+        if (skip > 0) {
+            skip--;
+            continue;
+        }
+        ContractEntry contract;
+        if (!db_it->GetValue(contract)) {
+            return error("%s: Cannot read contract %s", __func__, key.address.GetReverseHex());
+        }
+        contracts.push_back(contract);
+    }
+    return true;
+}
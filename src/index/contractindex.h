@@ -0,0 +1,89 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_CONTRACTINDEX_H
+#define BITCOIN_INDEX_CONTRACTINDEX_H
+
+#include <chain.h>
+#include <index/base.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <vector>
+
+static const bool DEFAULT_CONTRACTINDEX = false;
+
+/** A contract account created by a transaction, live until it self-destructs */
+struct ContractEntry {
+    uint160 address;
+    /// Transaction whose execution created the contract.
+    uint256 tx_hash;
+    int height;
+    uint32_t tx_index;
+
+    ContractEntry() : height(0), tx_index(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(address);
+        READWRITE(tx_hash);
+        READWRITE(height);
+        READWRITE(tx_index);
+    }
+};
+
+/**
+ * ContractIndex keeps the live contracts in creation order, so listing them
+ * is an index seek instead of a walk over every account of the state trie.
+ * Entries are built from the created and destructed contracts of the receipts
+ * in resultsDB and require -logevents.
+ */
+class ContractIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool RewindsOnDisconnect() const override { return true; }
+
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "contractindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit ContractIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~ContractIndex() override;
+
+    /// Number of live contracts.
+    bool CountContracts(uint64_t& count) const;
+
+    /// Look up the live contract at address.
+    bool FindContract(const uint160& address, ContractEntry& contract) const;
+
+    /// Collect the live contracts created between the heights, in creation order.
+    ///
+    /// @param[in]   from_height  First block height to search.
+    /// @param[in]   to_height  Last block height to search, -1 for no limit.
+    /// @param[in]   skip  Number of matching contracts to pass over first.
+    /// @param[in]   limit  Most contracts returned, 0 for no limit.
+    bool FindContracts(int from_height, int to_height, size_t skip, size_t limit,
+                       std::vector<ContractEntry>& contracts) const;
+};
+
+/// The global contract index, used by listcontracts. May be null.
+extern std::unique_ptr<ContractIndex> g_contractindex;
+
+#endif // BITCOIN_INDEX_CONTRACTINDEX_H
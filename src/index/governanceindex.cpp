@@ -0,0 +1,376 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/governanceindex.h>
+#include <index/receiptindex.h>
+#include <qtum/qtumDGP.h>
+#include <qtum/storageresults.h>
+#include <script/standard.h>
+#include <util/convert.h>
+#include <util/strencodings.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <algorithm>
+#include <map>
+
+/* The index database stores the enrolled governors and the calls to the budget contract.
+ *
+ * Governor keys have the type [DB_GOVERNOR, uint160 address] and the value is the GovernorEntry.
+ * Budget keys have the type [DB_BUDGET_PROPOSAL or DB_BUDGET_VOTE, uint32 height (BE), uint256 tx
+ * hash, uint32 output (BE)] and the value is the BudgetCall, so the calls of a range of heights are
+ * read with a single seek. The changes of each block are also kept by block hash, the receipts of
+ * disconnected blocks are deleted before the index could read them again to rewind.
+ */
+constexpr char DB_GOVERNOR = 'g';
+constexpr char DB_BUDGET_PROPOSAL = 'p';
+constexpr char DB_BUDGET_VOTE = 'v';
+constexpr char DB_GOVERNANCE_BLOCK = 'k';
+
+/** rewardGovernor(address) of the governance contract, called by the coinstake */
+static const std::vector<unsigned char> GOVERNANCE_REWARD_SELECTOR = ParseHex("1c0318cd");
+/** settleBudget() of the budget contract, called by the coinstake */
+static const std::vector<unsigned char> BUDGET_SETTLE_SELECTOR = ParseHex("104ad86f");
+
+std::unique_ptr<GovernanceIndex> g_governanceindex;
+
+namespace {
+
+struct DBBudgetKey {
+    char type;
+    int height;
+    uint256 tx_hash;
+    uint32_t vout;
+
+    DBBudgetKey() : type(DB_BUDGET_PROPOSAL), height(0), vout(0) {}
+    DBBudgetKey(char type_in, int height_in, const uint256& tx_hash_in = uint256(), uint32_t vout_in = 0) :
+        type(type_in), height(height_in), tx_hash(tx_hash_in), vout(vout_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, type);
+        ser_writedata32be(s, height);
+        s << tx_hash;
+        ser_writedata32be(s, vout);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        type = ser_readdata8(s);
+        if (type != DB_BUDGET_PROPOSAL && type != DB_BUDGET_VOTE) {
+            throw std::ios_base::failure("Invalid format for governance index DB budget key");
+        }
+        height = ser_readdata32be(s);
+        s >> tx_hash;
+        vout = ser_readdata32be(s);
+    }
+};
+
+/** Governor state before a block changed it, enrolled is false when the block enrolled the governor */
+struct GovernorUndo {
+    uint160 address;
+    bool enrolled;
+    GovernorEntry entry;
+
+    GovernorUndo() : enrolled(false) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(address);
+        READWRITE(enrolled);
+        READWRITE(entry);
+    }
+};
+
+/** Changes of a block to the index */
+struct GovernanceBlockUndo {
+    std::vector<GovernorUndo> governors;
+    std::vector<BudgetCall> proposals;
+    std::vector<BudgetCall> votes;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(governors);
+        READWRITE(proposals);
+        READWRITE(votes);
+    }
+};
+
+/** A call to a contract found in a transaction output */
+struct ContractCall {
+    uint160 contract;
+    std::vector<unsigned char> data;
+};
+
+/** The contract and the data of an OP_CALL output, the last two pushes before the opcode */
+bool ExtractContractCall(const CScript& script, ContractCall& call)
+{
+    if (!script.HasOpCall()) {
+        return false;
+    }
+    std::vector<unsigned char> prev, last;
+    opcodetype opcode;
+    std::vector<unsigned char> push;
+    CScript::const_iterator pc = script.begin();
+    while (pc < script.end()) {
+        if (!script.GetOp(pc, opcode, push)) {
+            return false;
+        }
+        if (opcode == OP_CALL) {
+            if (last.size() != 20) {
+                return false;
+            }
+            call.contract = uint160(last);
+            call.data = prev;
+            return true;
+        }
+        prev = std::move(last);
+        last = push;
+    }
+    return false;
+}
+
+bool HasSelector(const std::vector<unsigned char>& data, const std::vector<unsigned char>& selector)
+{
+    return data.size() >= selector.size() && std::equal(selector.begin(), selector.end(), data.begin());
+}
+
+}; // namespace
+
+/** Access to the governance index database (indexes/governanceindex/) */
+class GovernanceIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /// Write the budget calls of a block to the batch, or take them away when fDisconnect is set.
+    void WriteBudgetCalls(CDBBatch& batch, const GovernanceBlockUndo& changes, bool fDisconnect) const;
+};
+
+GovernanceIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "governanceindex", n_cache_size, f_memory, f_wipe)
+{}
+
+void GovernanceIndex::DB::WriteBudgetCalls(CDBBatch& batch, const GovernanceBlockUndo& changes, bool fDisconnect) const
+{
+    for (char type : {DB_BUDGET_PROPOSAL, DB_BUDGET_VOTE}) {
+        for (const BudgetCall& call : type == DB_BUDGET_PROPOSAL ? changes.proposals : changes.votes) {
+            const DBBudgetKey key(type, call.height, call.tx_hash, call.vout);
+            if (fDisconnect) {
+                batch.Erase(key);
+            } else {
+                batch.Write(key, call);
+            }
+        }
+    }
+}
+
+GovernanceIndex::GovernanceIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<GovernanceIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+GovernanceIndex::~GovernanceIndex() {}
+
+bool GovernanceIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    // receipts of blocks connected before -logevents are still being rebuilt
+    if (g_receiptindex && !g_receiptindex->BlockUntilReceipts(pindex)) {
+        return false;
+    }
+
+    GovernanceBlockUndo changes;
+    // Governors changed by the block, as they are after it
+    std::map<uint160, GovernorEntry> pending;
+    auto governor = [&](const uint160& address) -> GovernorEntry& {
+        auto it = pending.find(address);
+        if (it == pending.end()) {
+            GovernorUndo undo;
+            undo.address = address;
+            undo.enrolled = m_db->Read(std::make_pair(DB_GOVERNOR, address), undo.entry);
+            changes.governors.push_back(undo);
+            it = pending.emplace(address, undo.entry).first;
+        }
+        return it->second;
+    };
+
+    // The contracts of the coinstake run after those of the other transactions
+    std::vector<size_t> order;
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        if (!(block.IsProofOfStake() && i == 1)) order.push_back(i);
+    }
+    if (block.IsProofOfStake()) order.push_back(1);
+
+    const uint256 block_hash = pindex->GetBlockHash();
+    for (size_t i : order) {
+        const CTransactionRef& tx = block.vtx[i];
+        if (!tx->HasCreateOrCall()) {
+            continue;
+        }
+        TransactionReceiptsRef receipts;
+        for (uint32_t n = 0; n < tx->vout.size(); n++) {
+            ContractCall call;
+            if (!ExtractContractCall(tx->vout[n].scriptPubKey, call) ||
+                (call.contract != uint160(GovernanceDGP.asBytes()) && call.contract != uint160(BudgetDGP.asBytes()))) {
+                continue;
+            }
+            if (!receipts) {
+                receipts = pstorageresult->getResult(uintToh256(tx->GetHash()));
+            }
+            auto receipt = std::find_if(receipts->begin(), receipts->end(), [&](const TransactionReceiptInfo& info) {
+                return info.blockHash == block_hash && info.outputIndex == n;
+            });
+            if (receipt == receipts->end() || receipt->excepted != dev::eth::TransactionException::None) {
+                continue;
+            }
+            const uint160 sender(receipt->from.asBytes());
+            const CAmount value = tx->vout[n].nValue;
+
+            if (call.contract == uint160(GovernanceDGP.asBytes())) {
+                if (HasSelector(call.data, GOVERNANCE_REWARD_SELECTOR)) {
+                    if (call.data.size() < 36) continue;
+                    const uint160 winner(std::vector<unsigned char>(call.data.begin() + 16, call.data.begin() + 36));
+                    if (winner.IsNull() || (!pending.count(winner) && !m_db->Exists(std::make_pair(DB_GOVERNOR, winner)))) continue;
+                    GovernorEntry& entry = governor(winner);
+                    if (entry.registration_height == 0) continue;
+                    entry.last_reward_height = pindex->nHeight;
+                    entry.rewards++;
+                } else if (value > 0) {
+                    GovernorEntry& entry = governor(sender);
+                    if (entry.registration_height == 0) {
+                        entry.registration_height = pindex->nHeight;
+                    }
+                    entry.collateral += value;
+                    entry.last_call_height = pindex->nHeight;
+                } else if (pending.count(sender) || m_db->Exists(std::make_pair(DB_GOVERNOR, sender))) {
+                    GovernorEntry& entry = governor(sender);
+                    if (entry.registration_height > 0) entry.last_call_height = pindex->nHeight;
+                }
+            } else if (!HasSelector(call.data, BUDGET_SETTLE_SELECTOR)) {
+                BudgetCall budget_call;
+                budget_call.tx_hash = tx->GetHash();
+                budget_call.vout = n;
+                budget_call.height = pindex->nHeight;
+                budget_call.sender = sender;
+                budget_call.value = value;
+                budget_call.data = call.data;
+                (value > 0 ? changes.proposals : changes.votes).push_back(budget_call);
+            }
+        }
+    }
+
+    // A governor leaves once a condensing transaction pays its collateral back
+    for (const CTransactionRef& tx : block.vtx) {
+        if (!tx->HasOpSpend()) {
+            continue;
+        }
+        for (const CTxOut& out : tx->vout) {
+            CTxDestination dest;
+            if (!ExtractDestination(out.scriptPubKey, dest) || !boost::get<PKHash>(&dest)) {
+                continue;
+            }
+            const uint160 address(*boost::get<PKHash>(&dest));
+            if (!pending.count(address) && !m_db->Exists(std::make_pair(DB_GOVERNOR, address))) {
+                continue;
+            }
+            GovernorEntry& entry = governor(address);
+            if (entry.registration_height > 0 && out.nValue == entry.collateral) {
+                entry = GovernorEntry();
+            }
+        }
+    }
+
+    if (changes.governors.empty() && changes.proposals.empty() && changes.votes.empty()) {
+        return true;
+    }
+
+    CDBBatch batch(*m_db);
+    for (const auto& it : pending) {
+        if (it.second.registration_height > 0) {
+            batch.Write(std::make_pair(DB_GOVERNOR, it.first), it.second);
+        } else {
+            batch.Erase(std::make_pair(DB_GOVERNOR, it.first));
+        }
+    }
+    m_db->WriteBudgetCalls(batch, changes, false);
+    batch.Write(std::make_pair(DB_GOVERNANCE_BLOCK, block_hash), changes);
+    return m_db->WriteBatch(batch);
+}
+
+bool GovernanceIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    CDBBatch batch(*m_db);
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        const auto block_key = std::make_pair(DB_GOVERNANCE_BLOCK, pindex->GetBlockHash());
+        GovernanceBlockUndo changes;
+        if (!m_db->Read(block_key, changes)) {
+            continue;
+        }
+        // Blocks are undone from the tip down, the state before the oldest one is written last
+        for (const GovernorUndo& undo : changes.governors) {
+            if (undo.enrolled) {
+                batch.Write(std::make_pair(DB_GOVERNOR, undo.address), undo.entry);
+            } else {
+                batch.Erase(std::make_pair(DB_GOVERNOR, undo.address));
+            }
+        }
+        m_db->WriteBudgetCalls(batch, changes, true);
+        batch.Erase(block_key);
+    }
+    if (!m_db->WriteBatch(batch)) {
+        return false;
+    }
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+BaseIndex::DB& GovernanceIndex::GetDB() const { return *m_db; }
+
+bool GovernanceIndex::FindGovernors(std::vector<GovernorEntry>& governors) const
+{
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+    db_it->Seek(std::make_pair(DB_GOVERNOR, uint160()));
+    for (; db_it->Valid(); db_it->Next()) {
+        std::pair<char, uint160> key;
+        if (!db_it->GetKey(key) || key.first != DB_GOVERNOR) {
+            break;
+        }
+        GovernorEntry governor;
+        if (!db_it->GetValue(governor)) {
+            return error("%s: Cannot read governor %s", __func__, key.second.GetReverseHex());
+        }
+        governor.address = key.second;
+        governors.push_back(governor);
+    }
+    return true;
+}
+
+bool GovernanceIndex::FindBudgetCalls(bool votes, int from_height, int to_height, std::vector<BudgetCall>& calls) const
+{
+    const char type = votes ? DB_BUDGET_VOTE : DB_BUDGET_PROPOSAL;
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+    db_it->Seek(DBBudgetKey(type, from_height));
+    for (; db_it->Valid(); db_it->Next()) {
+        DBBudgetKey key;
+        if (!db_it->GetKey(key) || key.type != type) {
+            break;
+        }
+        if (to_height > -1 && key.height > to_height) {
+            break;
+        }
+        BudgetCall call;
+        if (!db_it->GetValue(call)) {
+            return error("%s: Cannot read a budget call of block %d", __func__, key.height);
+        }
+        calls.push_back(call);
+    }
+    return true;
+}
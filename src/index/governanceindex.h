@@ -0,0 +1,124 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_GOVERNANCEINDEX_H
+#define BITCOIN_INDEX_GOVERNANCEINDEX_H
+
+#include <amount.h>
+#include <chain.h>
+#include <index/base.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <vector>
+
+static const bool DEFAULT_GOVERNANCEINDEX = false;
+
+/** A governor enrolled in the governance contract */
+struct GovernorEntry {
+    /// Not serialized, the address is the database key.
+    uint160 address;
+    int registration_height;
+    /// Value sent with the enrolling calls.
+    CAmount collateral;
+    /// Height of the last block that rewarded the governor, 0 if never rewarded.
+    int last_reward_height;
+    uint32_t rewards;
+    /// Height of the last successful call of the governor to the governance contract.
+    int last_call_height;
+
+    GovernorEntry() : registration_height(0), collateral(0), last_reward_height(0), rewards(0), last_call_height(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(registration_height);
+        READWRITE(collateral);
+        READWRITE(last_reward_height);
+        READWRITE(rewards);
+        READWRITE(last_call_height);
+    }
+};
+
+/** A successful call to the budget contract, a proposal when it pays the fee or else a vote */
+struct BudgetCall {
+    uint256 tx_hash;
+    uint32_t vout;
+    int height;
+    uint160 sender;
+    CAmount value;
+    /// ABI encoded call data, selector included.
+    std::vector<unsigned char> data;
+
+    BudgetCall() : vout(0), height(0), value(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(tx_hash);
+        READWRITE(vout);
+        READWRITE(height);
+        READWRITE(sender);
+        READWRITE(value);
+        READWRITE(data);
+    }
+};
+
+/**
+ * GovernanceIndex follows the calls to the governance (0x89) and budget
+ * (0x90) contracts, so listing the governors and the budget proposals is a
+ * database read instead of one contract execution per entry. Entries are
+ * built from the contract calls of each block and their receipts in
+ * resultsDB, which tell whether a call succeeded and who sent it, so the
+ * index requires -logevents.
+ *
+ * A successful governance call carrying value enrolls its sender, or adds
+ * to its collateral, and a reward call of the coinstake updates the winner.
+ * A governor leaves once a condensing transaction pays its collateral back.
+ * The budget calls are kept as they were made, a dashboard decodes their
+ * arguments from the call data.
+ */
+class GovernanceIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool RewindsOnDisconnect() const override { return true; }
+
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "governanceindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit GovernanceIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~GovernanceIndex() override;
+
+    /// Collect the enrolled governors, by address.
+    bool FindGovernors(std::vector<GovernorEntry>& governors) const;
+
+    /// Collect the budget proposals, or the votes, made between the heights in chain order.
+    ///
+    /// @param[in]   votes  Collect the votes instead of the proposals.
+    /// @param[in]   from_height  First block height to search.
+    /// @param[in]   to_height  Last block height to search, -1 for no limit.
+    bool FindBudgetCalls(bool votes, int from_height, int to_height, std::vector<BudgetCall>& calls) const;
+};
+
+/// The global governance index, used by listgovernors and listbudgetproposals. May be null.
+extern std::unique_ptr<GovernanceIndex> g_governanceindex;
+
+#endif // BITCOIN_INDEX_GOVERNANCEINDEX_H
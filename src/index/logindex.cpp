@@ -0,0 +1,153 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/logindex.h>
+#include <index/receiptindex.h>
+#include <qtum/storageresults.h>
+#include <util/convert.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <limits>
+
+/* The index database stores one entry per topic of every log emitted on the chain.
+ *
+ * Keys have the type [DB_LOG_TOPIC, uint256 topic, uint32 height (BE), uint32 tx index (BE),
+ * uint32 log index (BE), uint8 topic position] and the value is the transaction hash. Heights
+ * are big-endian so that the entries of a topic are read in chain order with a single seek.
+ * Entries of disconnected blocks are overwritten or left behind; callers check the candidates
+ * against the height index, which only describes the active chain.
+ */
+constexpr char DB_LOG_TOPIC = 't';
+
+std::unique_ptr<LogIndex> g_logindex;
+
+namespace {
+
+struct DBTopicKey {
+    uint256 topic;
+    int height;
+    uint32_t tx_index;
+    uint32_t log_index;
+    uint8_t position;
+
+    DBTopicKey() : height(0), tx_index(0), log_index(0), position(0) {}
+    DBTopicKey(const uint256& topic_in, int height_in, uint32_t tx_index_in = 0, uint32_t log_index_in = 0, uint8_t position_in = 0) :
+        topic(topic_in), height(height_in), tx_index(tx_index_in), log_index(log_index_in), position(position_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_LOG_TOPIC);
+        s << topic;
+        ser_writedata32be(s, height);
+        ser_writedata32be(s, tx_index);
+        ser_writedata32be(s, log_index);
+        ser_writedata8(s, position);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_LOG_TOPIC) {
+            throw std::ios_base::failure("Invalid format for log index DB topic key");
+        }
+        s >> topic;
+        height = ser_readdata32be(s);
+        tx_index = ser_readdata32be(s);
+        log_index = ser_readdata32be(s);
+        position = ser_readdata8(s);
+    }
+};
+
+}; // namespace
+
+/** Access to the log index database (indexes/logindex/) */
+class LogIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+};
+
+LogIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "logindex", n_cache_size, f_memory, f_wipe)
+{}
+
+LogIndex::LogIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<LogIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+LogIndex::~LogIndex() {}
+
+bool LogIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    // receipts of blocks connected before -logevents are still being rebuilt
+    if (g_receiptindex && !g_receiptindex->BlockUntilReceipts(pindex)) {
+        return false;
+    }
+
+    CDBBatch batch(*m_db);
+    const uint256 block_hash = pindex->GetBlockHash();
+    for (const CTransactionRef& tx : block.vtx) {
+        // contract transactions and the coinstake running the DGP contracts carry receipts
+        if (!tx->HasCreateOrCall() && !tx->IsCoinStake()) {
+            continue;
+        }
+        std::vector<TransactionReceiptInfo> receipts;
+        if (!pstorageresult->getResultLogs(uintToh256(tx->GetHash()), receipts)) {
+            continue;
+        }
+        uint32_t log_index = 0;
+        for (const TransactionReceiptInfo& receipt : receipts) {
+            if (receipt.blockHash != block_hash) {
+                continue;
+            }
+            for (const dev::eth::LogEntry& log : receipt.logs) {
+                for (size_t position = 0; position < log.topics.size() && position <= std::numeric_limits<uint8_t>::max(); position++) {
+                    batch.Write(DBTopicKey(h256Touint(log.topics[position]), pindex->nHeight, receipt.transactionIndex, log_index, (uint8_t)position), tx->GetHash());
+                }
+                log_index++;
+            }
+        }
+    }
+    return m_db->WriteBatch(batch);
+}
+
+BaseIndex::DB& LogIndex::GetDB() const { return *m_db; }
+
+int LogIndex::IndexedHeight() const
+{
+    AssertLockHeld(cs_main);
+    const CBlockIndex* best = GetBestBlockIndex();
+    if (!best) {
+        return -1;
+    }
+    const CBlockIndex* fork = ::ChainActive().FindFork(best);
+    return fork ? fork->nHeight : -1;
+}
+
+void LogIndex::FindTopicTransactions(const uint256& topic, uint8_t position, int from_height, int to_height,
+                                     std::map<int, std::set<uint256>>& txs_by_height) const
+{
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+    db_it->Seek(DBTopicKey(topic, from_height));
+    for (; db_it->Valid(); db_it->Next()) {
+        DBTopicKey key;
+        if (!db_it->GetKey(key) || key.topic != topic) {
+            break;
+        }
+        if (to_height > -1 && key.height > to_height) {
+            break;
+        }
+        if (key.position != position) {
+            continue;
+        }
+        uint256 tx_hash;
+        if (!db_it->GetValue(tx_hash)) {
+            break;
+        }
+        txs_by_height[key.height].insert(tx_hash);
+    }
+}
@@ -0,0 +1,63 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_LOGINDEX_H
+#define BITCOIN_INDEX_LOGINDEX_H
+
+#include <chain.h>
+#include <index/base.h>
+
+#include <map>
+#include <set>
+
+static const bool DEFAULT_LOGINDEX = false;
+
+/**
+ * LogIndex maps the EVM log topics of the active chain to the transactions
+ * that emitted them, so searchlogs and waitforlogs can answer topic filters
+ * with index seeks instead of deserializing every receipt in the range.
+ * Entries are built from the receipts in resultsDB and require -logevents.
+ */
+class LogIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "logindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit LogIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~LogIndex() override;
+
+    /// Height of the last active chain block the index covers, -1 if none.
+    int IndexedHeight() const EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    /// Collect the transactions with a log carrying topic at the given position.
+    ///
+    /// @param[in]   topic  The log topic to look up.
+    /// @param[in]   position  Index of the topic within the log entry.
+    /// @param[in]   from_height  First block height to search.
+    /// @param[in]   to_height  Last block height to search, -1 for no limit.
+    /// @param[out]  txs_by_height  Matching transaction hashes, added by block height.
+    /// The entries may include blocks reorganized out of the active chain, callers
+    /// must check the candidates against the height index.
+    void FindTopicTransactions(const uint256& topic, uint8_t position, int from_height, int to_height,
+                               std::map<int, std::set<uint256>>& txs_by_height) const;
+};
+
+/// The global log index, used in searchlogs and waitforlogs. May be null.
+extern std::unique_ptr<LogIndex> g_logindex;
+
+#endif // BITCOIN_INDEX_LOGINDEX_H
@@ -0,0 +1,299 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/receiptindex.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <qtum/qtumDGP.h>
+#include <qtum/qtumstateview.h>
+#include <qtum/storageresults.h>
+#include <shutdown.h>
+#include <txdb.h>
+#include <undo.h>
+#include <util/convert.h>
+#include <util/strencodings.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <thread>
+
+std::unique_ptr<ReceiptIndex> g_receiptindex;
+
+/** The index database only keeps the locator of the last block whose receipts were rebuilt */
+static const size_t RECEIPT_INDEX_CACHE = 1 << 20;
+
+/** Receipts and height index entries of a replayed block, empty when it needs none */
+struct ReceiptIndex::ReplayedBlock {
+    bool ok = false;
+    std::vector<std::pair<dev::h256, std::vector<TransactionReceiptInfo>>> receipts;
+    std::map<dev::Address, std::pair<CHeightTxIndexKey, std::vector<uint256>>> heightIndexes;
+};
+
+/** Access to the receipt index database (indexes/receiptindex/) */
+class ReceiptIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(bool f_memory = false, bool f_wipe = false);
+};
+
+ReceiptIndex::DB::DB(bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "receiptindex", RECEIPT_INDEX_CACHE, f_memory, f_wipe)
+{}
+
+ReceiptIndex::ReceiptIndex(int n_threads, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<ReceiptIndex::DB>(f_memory, f_wipe)),
+      m_threads(std::max(1, std::min(n_threads, MAX_RECEIPT_REPLAY_THREADS)))
+{}
+
+ReceiptIndex::~ReceiptIndex() {}
+
+BaseIndex::DB& ReceiptIndex::GetDB() const { return *m_db; }
+
+static bool IsContractExecution(const CTransaction& tx)
+{
+    return tx.HasCreateOrCall() && !tx.HasOpSpend() && !tx.IsCoinStake();
+}
+
+/** Whether the coinstake pays for DGP contract calls, the ones GetDGPTransactions runs */
+static bool HasDGPCalls(const CBlock& block)
+{
+    CTxOut vout;
+    uint32_t n;
+    return GetDGPVout(block, GovernanceDGP.asBytes(), ParseHex("1c0318cd"), vout, n) ||
+           GetDGPVout(block, GovernanceDGP.asBytes(), ParseHex("6faaa74c"), vout, n) ||
+           GetDGPVout(block, BudgetDGP.asBytes(), ParseHex("104ad86f"), vout, n);
+}
+
+/** Receipts of one transaction's executions, numbered and accumulated as ConnectBlock does */
+static void AddReceipts(ReceiptIndex::ReplayedBlock& replayed, const CBlock& block, const CBlockIndex* pindex, const CTransaction& tx, uint32_t txIndex,
+                        const std::vector<QtumTransaction>& txs, const std::vector<ResultExecute>& results, uint64_t& blockGasUsed)
+{
+    std::vector<TransactionReceiptInfo> tri;
+    for (size_t k = 0; k < txs.size(); k++) {
+        for (const dev::eth::LogEntry& log : results[k].txRec.log()) {
+            if (!replayed.heightIndexes.count(log.address)) {
+                replayed.heightIndexes[log.address].first = CHeightTxIndexKey(pindex->nHeight, log.address);
+            }
+            replayed.heightIndexes[log.address].second.push_back(tx.GetHash());
+        }
+        uint64_t gasUsed = uint64_t(results[k].execRes.gasUsed);
+        blockGasUsed += gasUsed;
+        tri.push_back(TransactionReceiptInfo{
+            block.GetHash(),
+            uint32_t(pindex->nHeight),
+            tx.GetHash(),
+            txIndex,
+            txs[k].getNVout(),
+            txs[k].from(),
+            txs[k].to(),
+            blockGasUsed,
+            gasUsed,
+            results[k].execRes.newAddress,
+            results[k].txRec.log(),
+            results[k].execRes.excepted,
+            exceptedMessage(results[k].execRes.excepted, results[k].execRes.output),
+            results[k].txRec.stateRoot(),
+            results[k].txRec.utxoRoot(),
+            results[k].txRec.createdContracts(),
+            results[k].txRec.destructedContracts()
+        });
+    }
+    replayed.receipts.emplace_back(uintToh256(tx.GetHash()), std::move(tri));
+}
+
+/** Execute the contracts of a block on view, positioned on the roots of its parent */
+static bool ReplayBlock(const CBlockIndex* pindex, QtumStateView& view, ReceiptIndex::ReplayedBlock& replayed)
+{
+    const Consensus::Params& consensus_params = Params().GetConsensus();
+    if (!pindex->pprev) {
+        return replayed.ok = true;
+    }
+
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex, consensus_params)) {
+        return error("%s: Failed to read block %s from disk", __func__, pindex->GetBlockHash().ToString());
+    }
+
+    // the first transaction with receipts tells whether the block still needs them
+    const CTransaction* first = nullptr;
+    for (const CTransactionRef& tx : block.vtx) {
+        if (IsContractExecution(*tx)) {
+            first = tx.get();
+            break;
+        }
+    }
+    bool dgp_calls = block.IsProofOfStake() && HasDGPCalls(block);
+    if (!first && dgp_calls) {
+        first = block.vtx[1].get();
+    }
+    if (!first) {
+        return replayed.ok = true;
+    }
+    std::vector<TransactionReceiptInfo> existing;
+    if (pstorageresult->getResultLogs(uintToh256(first->GetHash()), existing)) {
+        for (const TransactionReceiptInfo& receipt : existing) {
+            if (receipt.blockHash == block.GetHash()) {
+                return replayed.ok = true;
+            }
+        }
+    }
+
+    // the coins spent by the block come from its undo data, created ones are never needed to convert
+    CBlockUndo blockundo;
+    if (!UndoReadFromDisk(blockundo, pindex) || blockundo.vtxundo.size() + 1 != block.vtx.size()) {
+        return error("%s: Failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+    }
+    CCoinsView coins_base;
+    CCoinsViewCache coins(&coins_base);
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+        if (txundo.vprevout.size() != tx.vin.size()) {
+            return error("%s: Undo data of block %s does not match its transactions", __func__, pindex->GetBlockHash().ToString());
+        }
+        for (size_t j = 0; j < tx.vin.size(); j++) {
+            coins.AddCoin(tx.vin[j].prevout, Coin(txundo.vprevout[j]), true);
+        }
+    }
+
+    view.rollback();
+    view.setRoots(uintToh256(pindex->pprev->hashStateRoot), uintToh256(pindex->pprev->hashUTXORoot));
+
+    // same parameters as ConnectBlock, read from the state the block was connected on
+    CBlockIndex* pindex_prev = const_cast<CBlockIndex*>(pindex->pprev);
+    int dgp_height = pindex->nHeight + (pindex->nHeight + 1 >= consensus_params.QIP7Height ? 0 : 1);
+    QtumDGP qtumDGP(view, pindex_prev, fGettingValuesDGP);
+    view.sealEngine().setQtumSchedule(qtumDGP.getGasSchedule(dgp_height));
+    uint64_t blockGasLimit = qtumDGP.getBlockGasLimit(dgp_height);
+    unsigned int contractflags = GetContractScriptFlags(pindex->nHeight, consensus_params);
+    EVMBlockEnvironment evmEnv(block, pindex->pprev, blockGasLimit);
+
+    uint64_t blockGasUsed = 0;
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        if (!IsContractExecution(tx)) {
+            continue;
+        }
+        ContractTxsRef contractTxs;
+        if (!ExtractContractTxs(tx, &coins, &block.vtx, contractflags, contractTxs)) {
+            return error("%s: Failed to convert transaction %s", __func__, tx.GetHash().ToString());
+        }
+        ByteCodeExec exec(block, contractTxs->first, blockGasLimit, pindex_prev, &view.state(), &view.sealEngine(), &evmEnv);
+        if (!exec.performByteCode()) {
+            return error("%s: Failed to execute transaction %s", __func__, tx.GetHash().ToString());
+        }
+        AddReceipts(replayed, block, pindex, tx, i, contractTxs->first, exec.getResult(), blockGasUsed);
+    }
+
+    if (dgp_calls) {
+        std::vector<QtumTransaction> qtumTransactions = GetDGPTransactions(block, qtumDGP, pindex->nHeight);
+        if (qtumTransactions.size() > 0) {
+            ByteCodeExec exec(block, qtumTransactions, blockGasLimit, pindex_prev, &view.state(), &view.sealEngine(), &evmEnv);
+            if (!exec.performByteCode()) {
+                return error("%s: Failed to execute the DGP contracts of block %s", __func__, pindex->GetBlockHash().ToString());
+            }
+            AddReceipts(replayed, block, pindex, *block.vtx[1], 1, qtumTransactions, exec.getResult(), blockGasUsed);
+        }
+    }
+
+    // the replay must end on the roots the block header commits to, or the receipts are not the ones of the chain
+    if (view.state().rootHash() != uintToh256(pindex->hashStateRoot) || view.state().rootHashUTXO() != uintToh256(pindex->hashUTXORoot)) {
+        return error("%s: Replayed state of block %s does not match its header", __func__, pindex->GetBlockHash().ToString());
+    }
+    return replayed.ok = true;
+}
+
+void ReceiptIndex::ReplayAhead(const CBlockIndex* pindex)
+{
+    std::vector<const CBlockIndex*> blocks;
+    {
+        LOCK(cs_main);
+        for (const CBlockIndex* next = pindex; next && blocks.size() < (size_t)(m_threads * RECEIPT_REPLAY_SHARD); next = ::ChainActive().Next(next)) {
+            blocks.push_back(next);
+        }
+    }
+
+    std::vector<std::unique_ptr<ReplayedBlock>> replayed(blocks.size());
+    for (std::unique_ptr<ReplayedBlock>& block : replayed) {
+        block = MakeUnique<ReplayedBlock>();
+    }
+
+    auto replay_shard = [&](size_t begin, size_t end) {
+        QtumStateView view(*globalState);
+        for (size_t i = begin; i < end && !ShutdownRequested(); i++) {
+            try {
+                ReplayBlock(blocks[i], view, *replayed[i]);
+            } catch (const std::exception& e) {
+                LogPrintf("%s: Failed to replay block %s: %s\n", __func__, blocks[i]->GetBlockHash().ToString(), e.what());
+            }
+        }
+        view.rollback();
+    };
+
+    // consecutive blocks per thread, every block only depends on the state roots of its parent
+    std::vector<std::thread> threads;
+    for (size_t begin = RECEIPT_REPLAY_SHARD; begin < blocks.size(); begin += RECEIPT_REPLAY_SHARD) {
+        threads.emplace_back(replay_shard, begin, std::min(blocks.size(), begin + RECEIPT_REPLAY_SHARD));
+    }
+    replay_shard(0, std::min(blocks.size(), (size_t)RECEIPT_REPLAY_SHARD));
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    LOCK(m_replayed_mutex);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        m_replayed[blocks[i]->GetBlockHash()] = std::move(replayed[i]);
+    }
+}
+
+bool ReceiptIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    std::unique_ptr<ReplayedBlock> replayed;
+    for (int attempt = 0; attempt < 2 && !replayed; attempt++) {
+        {
+            LOCK(m_replayed_mutex);
+            auto it = m_replayed.find(pindex->GetBlockHash());
+            if (it != m_replayed.end()) {
+                replayed = std::move(it->second);
+                m_replayed.erase(it);
+            } else {
+                // anything left belongs to a chain the index moved away from
+                m_replayed.clear();
+            }
+        }
+        if (!replayed) {
+            ReplayAhead(pindex);
+        }
+    }
+    if (!replayed || !replayed->ok) {
+        return ShutdownRequested() ? false : error("%s: Failed to rebuild the receipts of block %s", __func__, pindex->GetBlockHash().ToString());
+    }
+
+    if (!replayed->receipts.empty()) {
+        pstorageresult->writeResults(replayed->receipts);
+    }
+    for (const auto& e : replayed->heightIndexes) {
+        if (!pblocktree->WriteHeightIndex(e.second.first, e.second.second)) {
+            return error("%s: Failed to write the height index of block %s", __func__, pindex->GetBlockHash().ToString());
+        }
+    }
+    m_last_written = pindex;
+    return true;
+}
+
+bool ReceiptIndex::BlockUntilReceipts(const CBlockIndex* pindex) const
+{
+    while (!IsSynced()) {
+        for (const CBlockIndex* best : {m_last_written.load(), GetBestBlockIndex()}) {
+            if (best && best->GetAncestor(pindex->nHeight) == pindex) {
+                return true;
+            }
+        }
+        if (ShutdownRequested()) {
+            return false;
+        }
+        MilliSleep(100);
+    }
+    return true;
+}
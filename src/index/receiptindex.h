@@ -0,0 +1,79 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_RECEIPTINDEX_H
+#define BITCOIN_INDEX_RECEIPTINDEX_H
+
+#include <chain.h>
+#include <index/base.h>
+#include <sync.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+
+/** Most threads replaying blocks at once */
+static const int MAX_RECEIPT_REPLAY_THREADS = 16;
+
+/** Blocks each replay thread takes from the chain at a time */
+static const int RECEIPT_REPLAY_SHARD = 16;
+
+/**
+ * ReceiptIndex rebuilds the transaction receipts and the height index of the
+ * blocks connected before -logevents was enabled. Each block is replayed on a
+ * private state view opened on the state roots of its parent, so the active
+ * chainstate is left untouched and consecutive ranges of blocks are replayed
+ * on several threads at once. Blocks that already have receipts are skipped,
+ * which keeps following the chain cheap once the index has caught up.
+ */
+class ReceiptIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+public:
+    struct ReplayedBlock;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+    const int m_threads;
+
+    /// Last block written while catching up, the locator is only committed from time to time.
+    std::atomic<const CBlockIndex*> m_last_written{nullptr};
+
+    Mutex m_replayed_mutex;
+
+    /// Blocks replayed ahead of the one being written, by block hash.
+    std::map<uint256, std::unique_ptr<ReplayedBlock>> m_replayed GUARDED_BY(m_replayed_mutex);
+
+    /// Replay pindex and the active chain blocks following it, split in shards over the threads.
+    void ReplayAhead(const CBlockIndex* pindex);
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "receiptindex"; }
+
+    bool ReadsUndoData() const override { return true; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit ReceiptIndex(int n_threads, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~ReceiptIndex() override;
+
+    /// Block until the receipts of pindex have been rebuilt. Only waits while
+    /// the index is catching up, blocks connected after that carry receipts
+    /// written by ConnectBlock. Returns false when shutdown is requested.
+    bool BlockUntilReceipts(const CBlockIndex* pindex) const;
+};
+
+/// The global receipt index, only running while -logevents receipts are rebuilt. May be null.
+extern std::unique_ptr<ReceiptIndex> g_receiptindex;
+
+#endif // BITCOIN_INDEX_RECEIPTINDEX_H
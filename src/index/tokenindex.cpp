@@ -0,0 +1,290 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/receiptindex.h>
+#include <index/tokenindex.h>
+#include <qtum/storageresults.h>
+#include <util/convert.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <map>
+
+/* The index database stores the Transfer events of every token contract twice, under the receiver
+ * and under the sender, along with the totals of each holder.
+ *
+ * Transfer keys have the type [DB_TOKEN_TRANSFER, uint160 token, uint160 holder, uint32 height (BE),
+ * uint32 tx index (BE), uint32 log index (BE), uint8 sent] and the value is the TokenTransfer.
+ * Balance keys have the type [DB_TOKEN_BALANCE, uint160 holder, uint160 token] so the tokens of a
+ * holder are read with a single seek. The transfers of each block are also kept by block hash, the
+ * receipts of disconnected blocks are deleted before the index could read them again to rewind.
+ */
+constexpr char DB_TOKEN_TRANSFER = 'x';
+constexpr char DB_TOKEN_BALANCE = 'b';
+constexpr char DB_TOKEN_BLOCK = 'k';
+
+/** keccak256("Transfer(address,address,uint256)") */
+static const dev::h256 TRANSFER_EVENT_TOPIC("ddf252ad1be2c89b69c2b068fc378daa952ba7f163c4a11628f55a4df523b3ef");
+
+std::unique_ptr<TokenIndex> g_tokenindex;
+
+namespace {
+
+struct DBTransferKey {
+    uint160 token;
+    uint160 holder;
+    int height;
+    uint32_t tx_index;
+    uint32_t log_index;
+    uint8_t sent;
+
+    DBTransferKey() : height(0), tx_index(0), log_index(0), sent(0) {}
+    DBTransferKey(const uint160& token_in, const uint160& holder_in, int height_in, uint32_t tx_index_in = 0, uint32_t log_index_in = 0, uint8_t sent_in = 0) :
+        token(token_in), holder(holder_in), height(height_in), tx_index(tx_index_in), log_index(log_index_in), sent(sent_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_TOKEN_TRANSFER);
+        s << token;
+        s << holder;
+        ser_writedata32be(s, height);
+        ser_writedata32be(s, tx_index);
+        ser_writedata32be(s, log_index);
+        ser_writedata8(s, sent);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_TOKEN_TRANSFER) {
+            throw std::ios_base::failure("Invalid format for token index DB transfer key");
+        }
+        s >> token;
+        s >> holder;
+        height = ser_readdata32be(s);
+        tx_index = ser_readdata32be(s);
+        log_index = ser_readdata32be(s);
+        sent = ser_readdata8(s);
+    }
+};
+
+struct DBBalanceKey {
+    uint160 holder;
+    uint160 token;
+
+    DBBalanceKey() {}
+    DBBalanceKey(const uint160& holder_in, const uint160& token_in) : holder(holder_in), token(token_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_TOKEN_BALANCE);
+        s << holder;
+        s << token;
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_TOKEN_BALANCE) {
+            throw std::ios_base::failure("Invalid format for token index DB balance key");
+        }
+        s >> holder;
+        s >> token;
+    }
+};
+
+using PendingBalances = std::map<std::pair<uint160, uint160>, TokenBalance>;
+
+}; // namespace
+
+/** Access to the token index database (indexes/tokenindex/) */
+class TokenIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /// Write the transfers to the batch, or take them away when fDisconnect is set. The balances
+    /// changed by writes still in the batch are read from pending.
+    void WriteTransfers(CDBBatch& batch, const std::vector<TokenTransfer>& transfers, bool fDisconnect, PendingBalances& pending) const;
+};
+
+TokenIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "tokenindex", n_cache_size, f_memory, f_wipe)
+{}
+
+void TokenIndex::DB::WriteTransfers(CDBBatch& batch, const std::vector<TokenTransfer>& transfers, bool fDisconnect, PendingBalances& pending) const
+{
+    for (const TokenTransfer& transfer : transfers) {
+        const dev::u256 value = uintTou256(transfer.value);
+        for (uint8_t sent = 0; sent < 2; sent++) {
+            const uint160& holder = sent ? transfer.from : transfer.to;
+            const DBTransferKey key(transfer.token, holder, transfer.height, transfer.tx_index, transfer.log_index, sent);
+            if (fDisconnect) {
+                batch.Erase(key);
+            } else {
+                batch.Write(key, transfer);
+            }
+
+            const DBBalanceKey balance_key(holder, transfer.token);
+            auto it = pending.find(std::make_pair(holder, transfer.token));
+            if (it == pending.end()) {
+                TokenBalance balance;
+                Read(balance_key, balance);
+                it = pending.emplace(std::make_pair(holder, transfer.token), balance).first;
+            }
+            TokenBalance& balance = it->second;
+            uint256& total = sent ? balance.sent : balance.received;
+            total = u256Touint(fDisconnect ? uintTou256(total) - value : uintTou256(total) + value);
+            if (fDisconnect) {
+                balance.transfers--;
+            } else {
+                balance.transfers++;
+            }
+            if (balance.transfers == 0) {
+                batch.Erase(balance_key);
+            } else {
+                batch.Write(balance_key, balance);
+            }
+        }
+    }
+}
+
+TokenIndex::TokenIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<TokenIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+TokenIndex::~TokenIndex() {}
+
+bool TokenIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    // receipts of blocks connected before -logevents are still being rebuilt
+    if (g_receiptindex && !g_receiptindex->BlockUntilReceipts(pindex)) {
+        return false;
+    }
+
+    std::vector<TokenTransfer> transfers;
+    const uint256 block_hash = pindex->GetBlockHash();
+    for (const CTransactionRef& tx : block.vtx) {
+        if (!tx->HasCreateOrCall()) {
+            continue;
+        }
+        std::vector<TransactionReceiptInfo> receipts;
+        if (!pstorageresult->getResultLogs(uintToh256(tx->GetHash()), receipts)) {
+            continue;
+        }
+        uint32_t log_index = 0;
+        for (const TransactionReceiptInfo& receipt : receipts) {
+            if (receipt.blockHash != block_hash) {
+                continue;
+            }
+            for (const dev::eth::LogEntry& log : receipt.logs) {
+                if (log.topics.size() == 3 && log.topics[0] == TRANSFER_EVENT_TOPIC && log.data.size() == 32) {
+                    TokenTransfer transfer;
+                    transfer.token = uint160(log.address.asBytes());
+                    transfer.from = uint160(dev::right160(log.topics[1]).asBytes());
+                    transfer.to = uint160(dev::right160(log.topics[2]).asBytes());
+                    transfer.value = uint256(log.data);
+                    transfer.tx_hash = tx->GetHash();
+                    transfer.height = pindex->nHeight;
+                    transfer.tx_index = receipt.transactionIndex;
+                    transfer.log_index = log_index;
+                    transfers.push_back(transfer);
+                }
+                log_index++;
+            }
+        }
+    }
+
+    if (transfers.empty()) {
+        return true;
+    }
+
+    CDBBatch batch(*m_db);
+    PendingBalances pending;
+    m_db->WriteTransfers(batch, transfers, false, pending);
+    batch.Write(std::make_pair(DB_TOKEN_BLOCK, block_hash), transfers);
+    return m_db->WriteBatch(batch);
+}
+
+bool TokenIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    CDBBatch batch(*m_db);
+    PendingBalances pending;
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        const auto block_key = std::make_pair(DB_TOKEN_BLOCK, pindex->GetBlockHash());
+        std::vector<TokenTransfer> transfers;
+        if (!m_db->Read(block_key, transfers)) {
+            continue;
+        }
+        m_db->WriteTransfers(batch, transfers, true, pending);
+        batch.Erase(block_key);
+    }
+    if (!m_db->WriteBatch(batch)) {
+        return false;
+    }
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+BaseIndex::DB& TokenIndex::GetDB() const { return *m_db; }
+
+bool TokenIndex::FindBalances(const uint160& holder, const uint160& token, std::vector<TokenBalance>& balances) const
+{
+    if (!token.IsNull()) {
+        TokenBalance balance;
+        if (m_db->Read(DBBalanceKey(holder, token), balance)) {
+            balance.token = token;
+            balances.push_back(balance);
+        }
+        return true;
+    }
+
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+    db_it->Seek(DBBalanceKey(holder, uint160()));
+    for (; db_it->Valid(); db_it->Next()) {
+        DBBalanceKey key;
+        if (!db_it->GetKey(key) || key.holder != holder) {
+            break;
+        }
+        TokenBalance balance;
+        if (!db_it->GetValue(balance)) {
+            return error("%s: Cannot read the balance of token %s", __func__, key.token.GetReverseHex());
+        }
+        balance.token = key.token;
+        balances.push_back(balance);
+    }
+    return true;
+}
+
+bool TokenIndex::FindTransfers(const uint160& token, const uint160& holder, int from_height, int to_height, size_t limit,
+                               std::vector<TokenTransfer>& transfers) const
+{
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+    db_it->Seek(DBTransferKey(token, holder, from_height));
+    for (; db_it->Valid() && (limit == 0 || transfers.size() < limit); db_it->Next()) {
+        DBTransferKey key;
+        if (!db_it->GetKey(key) || key.token != token || key.holder != holder) {
+            break;
+        }
+        if (to_height > -1 && key.height > to_height) {
+            break;
+        }
+        TokenTransfer transfer;
+        if (!db_it->GetValue(transfer)) {
+            return error("%s: Cannot read a transfer of token %s", __func__, token.GetReverseHex());
+        }
+        // a transfer to self is listed once
+        if (key.sent && transfer.from == transfer.to) {
+            continue;
+        }
+        transfers.push_back(transfer);
+    }
+    return true;
+}
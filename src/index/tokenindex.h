@@ -0,0 +1,116 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_TOKENINDEX_H
+#define BITCOIN_INDEX_TOKENINDEX_H
+
+#include <chain.h>
+#include <index/base.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <vector>
+
+static const bool DEFAULT_TOKENINDEX = false;
+
+/** A Transfer(address,address,uint256) event of a QRC20 token contract */
+struct TokenTransfer {
+    uint160 token;
+    uint160 from;
+    uint160 to;
+    /// Amount transferred, the big-endian bytes of the event data.
+    uint256 value;
+    uint256 tx_hash;
+    int height;
+    uint32_t tx_index;
+    uint32_t log_index;
+
+    TokenTransfer() : height(0), tx_index(0), log_index(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(token);
+        READWRITE(from);
+        READWRITE(to);
+        READWRITE(value);
+        READWRITE(tx_hash);
+        READWRITE(height);
+        READWRITE(tx_index);
+        READWRITE(log_index);
+    }
+};
+
+/** Running totals of the transfers of a token to and from a holder */
+struct TokenBalance {
+    /// Not serialized, the token is part of the database key.
+    uint160 token;
+    /// Amounts received and sent, as big-endian bytes.
+    uint256 received;
+    uint256 sent;
+    uint32_t transfers;
+
+    TokenBalance() : transfers(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(received);
+        READWRITE(sent);
+        READWRITE(transfers);
+    }
+};
+
+/**
+ * TokenIndex keeps the Transfer events of QRC20 token contracts by token and
+ * holder, along with running balances of every holder, so token histories and
+ * portfolios are index seeks instead of scans of all the Transfer logs.
+ * Entries are built from the receipts in resultsDB and require -logevents.
+ * Balances only follow the Transfer events, tokens that assign balances
+ * without emitting one are not accounted for.
+ */
+class TokenIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool RewindsOnDisconnect() const override { return true; }
+
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "tokenindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit TokenIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~TokenIndex() override;
+
+    /// Collect the balances of the tokens holder has received or sent, all tokens when token is null.
+    bool FindBalances(const uint160& holder, const uint160& token, std::vector<TokenBalance>& balances) const;
+
+    /// Collect the transfers of token to and from holder between the heights, in chain order.
+    ///
+    /// @param[in]   from_height  First block height to search.
+    /// @param[in]   to_height  Last block height to search, -1 for no limit.
+    /// @param[in]   limit  Most transfers returned, 0 for no limit.
+    bool FindTransfers(const uint160& token, const uint160& holder, int from_height, int to_height, size_t limit,
+                       std::vector<TokenTransfer>& transfers) const;
+};
+
+/// The global token index, used by gettokenbalances and gettokentransfers. May be null.
+extern std::unique_ptr<TokenIndex> g_tokenindex;
+
+#endif // BITCOIN_INDEX_TOKENINDEX_H
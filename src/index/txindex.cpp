@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <crypto/common.h>
 #include <index/txindex.h>
 #include <shutdown.h>
 #include <ui_interface.h>
@@ -9,11 +10,60 @@
 #include <util/translation.h>
 #include <validation.h>
 
+#include <algorithm>
+#include <tuple>
+
 #include <boost/thread.hpp>
 
 constexpr char DB_BEST_BLOCK = 'B';
 constexpr char DB_TXINDEX = 't';
 constexpr char DB_TXINDEX_BLOCK = 'T';
+constexpr char DB_TXINDEX_SHORT = 'x';
+
+/** Key of the compact index entries, the first 8 bytes of the txid followed by the position of
+ * the transaction. The position keeps the entries of transactions sharing a prefix apart, which
+ * are told apart by the hash of the transaction read from disk. The value is empty.
+ */
+struct DBTxKey {
+    uint64_t txid_prefix;
+    CDiskTxPos pos;
+
+    DBTxKey() : txid_prefix(0) {}
+    DBTxKey(const uint256& txid, const CDiskTxPos& pos_in) : txid_prefix(ReadBE64(txid.begin())), pos(pos_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_TXINDEX_SHORT);
+        ser_writedata64be(s, txid_prefix);
+        s << pos;
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_TXINDEX_SHORT) {
+            throw std::ios_base::failure("Invalid format for txindex key");
+        }
+        txid_prefix = ser_readdata64be(s);
+        s >> pos;
+    }
+};
+
+/** Where the iteration over the compact entries of a txid prefix starts */
+struct DBTxPrefixKey {
+    uint64_t txid_prefix;
+
+    explicit DBTxPrefixKey(uint64_t txid_prefix_in) : txid_prefix(txid_prefix_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_TXINDEX_SHORT);
+        ser_writedata64be(s, txid_prefix);
+    }
+};
 
 std::unique_ptr<TxIndex> g_txindex;
 
@@ -32,9 +82,9 @@ class TxIndex::DB : public BaseIndex::DB
 public:
     explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
 
-    /// Read the disk location of the transaction data with the given hash. Returns false if the
-    /// transaction hash is not indexed.
-    bool ReadTxPos(const uint256& txid, CDiskTxPos& pos) const;
+    /// Read the disk locations of the transactions whose hash starts like each of the given ones,
+    /// with one iterator.
+    void ReadTxCandidates(const std::vector<uint256>& txids, std::vector<std::vector<CDiskTxPos>>& candidates);
 
     /// Write a batch of transaction positions to the DB.
     bool WriteTxs(const std::vector<std::pair<uint256, CDiskTxPos>>& v_pos);
@@ -42,22 +92,44 @@ public:
     /// Migrate txindex data from the block tree DB, where it may be for older nodes that have not
     /// been upgraded yet to the new database.
     bool MigrateData(CBlockTreeDB& block_tree_db, const CBlockLocator& best_locator);
+
+    /// Rewrite the entries keyed by the full txid into compact entries.
+    bool MigrateToShortKeys();
 };
 
 TxIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
     BaseIndex::DB(GetDataDir() / "indexes" / "txindex", n_cache_size, f_memory, f_wipe)
 {}
 
-bool TxIndex::DB::ReadTxPos(const uint256 &txid, CDiskTxPos& pos) const
+void TxIndex::DB::ReadTxCandidates(const std::vector<uint256>& txids, std::vector<std::vector<CDiskTxPos>>& candidates)
 {
-    return Read(std::make_pair(DB_TXINDEX, txid), pos);
+    candidates.assign(txids.size(), {});
+
+    // Seek the prefixes in key order so the iterator only moves forward
+    std::vector<std::pair<uint64_t, size_t>> prefixes;
+    prefixes.reserve(txids.size());
+    for (size_t i = 0; i < txids.size(); ++i) {
+        prefixes.emplace_back(ReadBE64(txids[i].begin()), i);
+    }
+    std::sort(prefixes.begin(), prefixes.end());
+
+    std::unique_ptr<CDBIterator> cursor(NewIterator());
+    for (const auto& prefix : prefixes) {
+        for (cursor->Seek(DBTxPrefixKey(prefix.first)); cursor->Valid(); cursor->Next()) {
+            DBTxKey key;
+            if (!cursor->GetKey(key) || key.txid_prefix != prefix.first) {
+                break;
+            }
+            candidates[prefix.second].push_back(key.pos);
+        }
+    }
 }
 
 bool TxIndex::DB::WriteTxs(const std::vector<std::pair<uint256, CDiskTxPos>>& v_pos)
 {
     CDBBatch batch(*this);
     for (const auto& tuple : v_pos) {
-        batch.Write(std::make_pair(DB_TXINDEX, tuple.first), tuple.second);
+        batch.Write(DBTxKey(tuple.first, tuple.second), uint8_t(0));
     }
     return WriteBatch(batch);
 }
@@ -200,6 +272,62 @@ bool TxIndex::DB::MigrateData(CBlockTreeDB& block_tree_db, const CBlockLocator&
     return true;
 }
 
+bool TxIndex::DB::MigrateToShortKeys()
+{
+    std::pair<unsigned char, uint256> begin_key{DB_TXINDEX, uint256()};
+    std::unique_ptr<CDBIterator> cursor(NewIterator());
+    cursor->Seek(begin_key);
+    std::pair<unsigned char, uint256> key;
+    if (!cursor->Valid() || !cursor->GetKey(key) || key.first != DB_TXINDEX) {
+        return true;
+    }
+
+    LogPrintf("Compacting txindex database...\n");
+    uiInterface.ShowProgress(_("Compacting txindex database").translated, 0, true);
+    const size_t batch_size = 1 << 24; // 16 MiB
+    CDBBatch batch(*this);
+    std::pair<unsigned char, uint256> prev_key = begin_key;
+    bool interrupted = false;
+    for (; cursor->Valid(); cursor->Next()) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested()) {
+            interrupted = true;
+            break;
+        }
+        if (!cursor->GetKey(key) || key.first != DB_TXINDEX) {
+            break;
+        }
+        CDiskTxPos value;
+        if (!cursor->GetValue(value)) {
+            return error("%s: cannot parse txindex record", __func__);
+        }
+        batch.Write(DBTxKey(key.second, value), uint8_t(0));
+        batch.Erase(key);
+
+        if (batch.SizeEstimate() > batch_size) {
+            // The rewritten entries and the removal of the old ones are written together, an
+            // interrupted migration picks up at the first entry left.
+            WriteBatch(batch, /*fSync=*/ true);
+            CompactRange(prev_key, key);
+            batch.Clear();
+            prev_key = key;
+
+            const int percentage_done = (int)(ReadBE64(key.second.begin()) * 100.0 / 18446744073709551616.0);
+            uiInterface.ShowProgress(_("Compacting txindex database").translated, percentage_done, true);
+        }
+    }
+    WriteBatch(batch, /*fSync=*/ true);
+    CompactRange(prev_key, key);
+    uiInterface.ShowProgress("", 100, false);
+
+    if (interrupted) {
+        LogPrintf("[CANCELLED].\n");
+        return false;
+    }
+    LogPrintf("[DONE].\n");
+    return true;
+}
+
 TxIndex::TxIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
     : m_db(MakeUnique<TxIndex::DB>(n_cache_size, f_memory, f_wipe))
 {}
@@ -216,6 +344,9 @@ bool TxIndex::Init()
     if (!m_db->MigrateData(*pblocktree, ::ChainActive().GetLocator())) {
         return false;
     }
+    if (!m_db->MigrateToShortKeys()) {
+        return false;
+    }
 
     return BaseIndex::Init();
 }
@@ -239,28 +370,90 @@ BaseIndex::DB& TxIndex::GetDB() const { return *m_db; }
 
 bool TxIndex::FindTx(const uint256& tx_hash, uint256& block_hash, CTransactionRef& tx) const
 {
-    CDiskTxPos postx;
-    if (!m_db->ReadTxPos(tx_hash, postx)) {
+    std::vector<uint256> block_hashes;
+    std::vector<CTransactionRef> txs;
+    FindTxs({tx_hash}, block_hashes, txs);
+    if (!txs[0]) {
         return false;
     }
+    block_hash = block_hashes[0];
+    tx = std::move(txs[0]);
+    return true;
+}
 
-    CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-    if (file.IsNull()) {
-        return error("%s: OpenBlockFile failed", __func__);
+void TxIndex::FindTxs(const std::vector<uint256>& tx_hashes, std::vector<uint256>& block_hashes, std::vector<CTransactionRef>& txs) const
+{
+    block_hashes.assign(tx_hashes.size(), uint256());
+    txs.assign(tx_hashes.size(), nullptr);
+
+    std::vector<std::vector<CDiskTxPos>> candidates;
+    m_db->ReadTxCandidates(tx_hashes, candidates);
+
+    // Read the candidates in file order, the header of each block once
+    std::vector<std::pair<CDiskTxPos, size_t>> reads;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        for (const CDiskTxPos& pos : candidates[i]) {
+            reads.emplace_back(pos, i);
+        }
     }
-    CBlockHeader header;
-    try {
-        file >> header;
-        if (fseek(file.Get(), postx.nTxOffset, SEEK_CUR)) {
-            return error("%s: fseek(...) failed", __func__);
+    std::sort(reads.begin(), reads.end(), [](const std::pair<CDiskTxPos, size_t>& a, const std::pair<CDiskTxPos, size_t>& b) {
+        return std::make_tuple(a.first.nFile, a.first.nPos, a.first.nTxOffset) < std::make_tuple(b.first.nFile, b.first.nPos, b.first.nTxOffset);
+    });
+
+    // A transaction indexed in several blocks after a reorg is taken from the active chain
+    std::vector<std::vector<std::pair<uint256, CTransactionRef>>> found(tx_hashes.size());
+    size_t i = 0;
+    while (i < reads.size()) {
+        const FlatFilePos block_pos(reads[i].first.nFile, reads[i].first.nPos);
+        size_t block_end = i;
+        while (block_end < reads.size() && reads[block_end].first.nFile == block_pos.nFile && reads[block_end].first.nPos == block_pos.nPos) {
+            ++block_end;
+        }
+
+        CAutoFile file(OpenBlockFile(block_pos, true), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull()) {
+            error("%s: OpenBlockFile failed", __func__);
+            i = block_end;
+            continue;
+        }
+        try {
+            CBlockHeader header;
+            file >> header;
+            const long tx_start = ftell(file.Get());
+            const uint256 header_hash = header.GetHash();
+            for (; i < block_end; ++i) {
+                if (fseek(file.Get(), tx_start + reads[i].first.nTxOffset, SEEK_SET)) {
+                    error("%s: fseek(...) failed", __func__);
+                    continue;
+                }
+                CTransactionRef tx;
+                file >> tx;
+                if (tx->GetHash() == tx_hashes[reads[i].second]) {
+                    found[reads[i].second].emplace_back(header_hash, std::move(tx));
+                }
+            }
+        } catch (const std::exception& e) {
+            error("%s: Deserialize or I/O error - %s", __func__, e.what());
+            i = block_end;
         }
-        file >> tx;
-    } catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
     }
-    if (tx->GetHash() != tx_hash) {
-        return error("%s: txid mismatch", __func__);
+
+    for (size_t j = 0; j < found.size(); ++j) {
+        if (found[j].empty()) {
+            continue;
+        }
+        size_t pick = 0;
+        if (found[j].size() > 1) {
+            LOCK(cs_main);
+            for (size_t k = 0; k < found[j].size(); ++k) {
+                const CBlockIndex* pindex = LookupBlockIndex(found[j][k].first);
+                if (pindex && ::ChainActive().Contains(pindex)) {
+                    pick = k;
+                    break;
+                }
+            }
+        }
+        block_hashes[j] = found[j][pick].first;
+        txs[j] = std::move(found[j][pick].second);
     }
-    block_hash = header.GetHash();
-    return true;
 }
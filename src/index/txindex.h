@@ -12,7 +12,7 @@
 /**
  * TxIndex is used to look up transactions included in the blockchain by hash.
  * The index is written to a LevelDB database and records the filesystem
- * location of each transaction by transaction hash.
+ * location of each transaction under a short prefix of its hash.
  */
 class TxIndex final : public BaseIndex
 {
@@ -46,6 +46,15 @@ public:
     /// @param[out]  tx  The transaction itself.
     /// @return  true if transaction is found, false otherwise
     bool FindTx(const uint256& tx_hash, uint256& block_hash, CTransactionRef& tx) const;
+
+    /// Look up several transactions by hash at once. The index entries are read with one database
+    /// iterator and the transactions in block file order, so batches of lookups cost far fewer
+    /// seeks than calling FindTx for each.
+    ///
+    /// @param[in]   tx_hashes  The hashes of the transactions to be returned.
+    /// @param[out]  block_hashes  The hash of the block each transaction is found in, null if not found.
+    /// @param[out]  txs  The transactions, in the order of tx_hashes, null if not found.
+    void FindTxs(const std::vector<uint256>& tx_hashes, std::vector<uint256>& block_hashes, std::vector<CTransactionRef>& txs) const;
 };
 
 /// The global transaction index, used in GetTransaction. May be null.
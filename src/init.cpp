@@ -12,29 +12,46 @@
 #include <addrman.h>
 #include <amount.h>
 #include <banman.h>
+#include <blockcache.h>
 #include <blockfilter.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <compat/sanity.h>
 #include <consensus/validation.h>
+#include <dbscheduler.h>
+#include <flatfile.h>
 #include <fs.h>
 #include <httprpc.h>
 #include <httpserver.h>
 #include <index/blockfilterindex.h>
+#include <index/addressindex.h>
+#include <index/logindex.h>
+#include <index/coinstatsindex.h>
+#include <index/contractindex.h>
+#include <index/governanceindex.h>
+#include <index/tokenindex.h>
+#include <index/receiptindex.h>
 #include <index/txindex.h>
 #include <interfaces/chain.h>
 #include <key.h>
 #include <logging.h>
+#include <mempooljournal.h>
 #include <miner.h>
 #include <net.h>
 #include <net_permissions.h>
 #include <net_processing.h>
 #include <netbase.h>
+#include <netcompression.h>
+#include <policy/exectime.h>
 #include <policy/feerate.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <policy/settings.h>
+#include <pos.h>
+#include <qtum/statepruner.h>
+#include <qtum/vmlogwriter.h>
 #include <rpc/blockchain.h>
+#include <rpc/cache.h>
 #include <rpc/register.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
@@ -50,6 +67,7 @@
 #include <util/convert.h>
 #include <util/moneystr.h>
 #include <util/system.h>
+#include <util/threadaffinity.h>
 #include <util/threadnames.h>
 #include <util/translation.h>
 #include <util/validation.h>
@@ -59,6 +77,7 @@
 #include <wallet/wallet.h>
 #endif
 #include <walletinitinterface.h>
+#include <libevm/VMFactory.h>
 
 #include <stdint.h>
 #include <stdio.h>
@@ -74,6 +93,7 @@
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/split.hpp>
+#include <boost/program_options.hpp>
 #include <boost/thread.hpp>
 
 #if ENABLE_ZMQ
@@ -86,6 +106,8 @@ static bool fFeeEstimatesInitialized = false;
 static const bool DEFAULT_PROXYRANDOMIZE = true;
 static const bool DEFAULT_REST_ENABLE = false;
 static const bool DEFAULT_STOPAFTERBLOCKIMPORT = false;
+//! Threads servicing the scheduler, which runs the validation notification queues and the periodic tasks
+static const int DEFAULT_SCHEDULER_THREADS = 2;
 
 // Dump addresses to banlist.dat every 15 minutes (900s)
 static constexpr int DUMP_BANS_INTERVAL = 60 * 15;
@@ -173,6 +195,29 @@ void Interrupt()
     if (g_txindex) {
         g_txindex->Interrupt();
     }
+    if (g_receiptindex) {
+        g_receiptindex->Interrupt();
+    }
+    if (g_logindex) {
+        g_logindex->Interrupt();
+    }
+    if (g_tokenindex) {
+        g_tokenindex->Interrupt();
+    }
+    if (g_contractindex) {
+        g_contractindex->Interrupt();
+    }
+    if (g_governanceindex) {
+        g_governanceindex->Interrupt();
+    }
+    if (g_coin_stats_index) {
+        g_coin_stats_index->Interrupt();
+    }
+#ifdef ENABLE_BITCORE_RPC
+    if (g_addressindex) {
+        g_addressindex->Interrupt();
+    }
+#endif
     ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Interrupt(); });
 }
 
@@ -205,6 +250,15 @@ void Shutdown(InitInterfaces& interfaces)
     if (peerLogic) UnregisterValidationInterface(peerLogic.get());
     if (g_connman) g_connman->Stop();
     if (g_txindex) g_txindex->Stop();
+    if (g_receiptindex) g_receiptindex->Stop();
+    if (g_logindex) g_logindex->Stop();
+    if (g_tokenindex) g_tokenindex->Stop();
+    if (g_contractindex) g_contractindex->Stop();
+    if (g_governanceindex) g_governanceindex->Stop();
+    if (g_coin_stats_index) g_coin_stats_index->Stop();
+#ifdef ENABLE_BITCORE_RPC
+    if (g_addressindex) g_addressindex->Stop();
+#endif
     ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Stop(); });
 
     StopTorControl();
@@ -220,11 +274,30 @@ void Shutdown(InitInterfaces& interfaces)
     g_connman.reset();
     g_banman.reset();
     g_txindex.reset();
+    g_receiptindex.reset();
+    g_logindex.reset();
+    g_tokenindex.reset();
+    g_contractindex.reset();
+    g_governanceindex.reset();
+    g_coin_stats_index.reset();
+#ifdef ENABLE_BITCORE_RPC
+    g_addressindex.reset();
+#endif
     DestroyAllBlockFilterIndexes();
 
     if (::mempool.IsLoaded() && gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
-        DumpMempool(::mempool);
+        if (g_mempool_journal) {
+            LOCK(cs_main);
+            if (::ChainActive().Tip()) {
+                g_mempool_journal->Close(::ChainActive().Tip()->GetBlockHash());
+            } else {
+                g_mempool_journal->Flush();
+            }
+        } else {
+            DumpMempool(::mempool);
+        }
     }
+    g_mempool_journal.reset();
 
     if (fFeeEstimatesInitialized)
     {
@@ -267,9 +340,14 @@ void Shutdown(InitInterfaces& interfaces)
         }
         pblocktree.reset();
         pstorageresult.reset();
+        stateViewPool.clear();
         globalState.reset();
         globalSealEngine.reset();
     }
+    if (g_vmlog_writer) {
+        g_vmlog_writer->Stop();
+        g_vmlog_writer.reset();
+    }
     for (const auto& client : interfaces.chain_clients) {
         client->stop();
     }
@@ -296,6 +374,7 @@ void Shutdown(InitInterfaces& interfaces)
     globalVerifyHandle.reset();
     ECC_Stop();
     LogPrintf("%s: done\n", __func__);
+    LogInstance().StopWriter();
 }
 
 /**
@@ -369,6 +448,7 @@ void SetupServerArgs()
 #if HAVE_SYSTEM
     gArgs.AddArg("-alertnotify=<cmd>", "Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #endif
+    gArgs.AddArg("-archiveblocks=<n>", strprintf("Compress the block and undo files of blocks more than <n> deep in the background, they are read back transparently. Incompatible with -prune (0 = keep them uncompressed, minimum %d, default: %d)", MIN_BLOCKS_TO_KEEP, DEFAULT_ARCHIVE_BLOCKS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-assumevalid=<hex>", strprintf("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: %s, testnet: %s)", defaultChainParams->GetConsensus().defaultAssumeValid.GetHex(), testnetChainParams->GetConsensus().defaultAssumeValid.GetHex()), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocksdir=<dir>", "Specify directory to hold blocks subdirectory for *.dat files (default: <datadir>)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #if HAVE_SYSTEM
@@ -379,38 +459,63 @@ void SetupServerArgs()
     gArgs.AddArg("-conf=<file>", strprintf("Specify configuration file. Relative paths will be prefixed by datadir location. (default: %s)", BITCOIN_CONF_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-datadir=<dir>", "Specify data directory", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-dboption=<db>:<option>=<value>", "Override a LevelDB option of the database in the directory <db> (chainstate, index, resultsDB, ...): bloombits, blockcache, writebuffer, maxfilesize (bytes) or compression (none, snappy). Can be specified multiple times", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbcache=<n>", strprintf("Maximum database cache size <n> MiB (%d to %d, default: %d). In addition, unused mempool memory is shared for this cache (see -maxmempool).", nMinDbCache, nMaxDbCache, nDefaultDbCache), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-dbcompactionrate=<n>", strprintf("Limit the table file writes of the LevelDB compactions of all databases together to <n> MiB/s, 0 for no limit. Flushes of the chain state and the staker hold them back for a moment regardless (default: %u)", DEFAULT_DB_COMPACTION_RATE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-debuglogfile=<file>", strprintf("Specify location of debug log file. Relative paths will be prefixed by a net-specific datadir location. (-nodebuglogfile to disable; default: %s)", DEFAULT_DEBUGLOGFILE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-debugvmlogfile=<file>", strprintf("Specify location of EMV debug log file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)", DEFAULT_DEBUGVMLOGFILE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-includeconf=<file>", "Specify additional configuration file, relative to the -datadir path (only useable from configuration file, not command line)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-loadblock=<file>", "Imports blocks from external blk000??.dat file on startup", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxmempool=<n>", strprintf("Keep the transaction memory pool below <n> megabytes (default: %u)", DEFAULT_MAX_MEMPOOL_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-maxmempoolgas=<n>", strprintf("Keep the gas declared by the contract transactions of the memory pool below <n>, evicting the lowest gas price first, lowered for the contracts observed to execute slowly (default: %u)", DEFAULT_MAX_MEMPOOL_GAS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-maxpeerexectime=<n>", strprintf("Ignore the contract transactions relayed by a peer once they took more than <n> milliseconds of contract execution in the last minute, 0 to disable (default: %u)", DEFAULT_MAX_PEER_EXEC_TIME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-maxsenderexectime=<n>", strprintf("Reject the contract transactions of a sender once they took more than <n> milliseconds of contract execution in the last minute, 0 to disable (default: %u)", DEFAULT_MAX_SENDER_EXEC_TIME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxorphantx=<n>", strprintf("Keep at most <n> unconnectable transactions in memory (default: %u)", DEFAULT_MAX_ORPHAN_TRANSACTIONS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxorphanblocksmib=<n>", strprintf("Keep at most <n> unconnectable blocks in memory (default: %u)", DEFAULT_MAX_ORPHAN_BLOCKS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-mempoolexpiry=<n>", strprintf("Do not keep transactions in the mempool longer than <n> hours (default: %u)", DEFAULT_MEMPOOL_EXPIRY), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-minimumchainwork=<hex>", strprintf("Minimum work assumed to exist on a valid chain in hex (default: %s, testnet: %s)", defaultChainParams->GetConsensus().nMinimumChainWork.GetHex(), testnetChainParams->GetConsensus().nMinimumChainWork.GetHex()), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-par=<n>", strprintf("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)",
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-contractprefetch=<n>", strprintf("Set the number of threads that speculatively pre-execute the contract transactions of a connecting block to warm the state database (0 to %d, default: %d)",
+        MAX_CONTRACT_PREFETCH_THREADS, DEFAULT_CONTRACT_PREFETCH_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-inputprefetch=<n>", strprintf("Set the number of threads that read the coins spent by a connecting block from the database ahead of time (0 to %d, default: %d)",
+        MAX_INPUT_PREFETCH_THREADS, DEFAULT_INPUT_PREFETCH_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-persistmempool", strprintf("Whether to save the mempool on shutdown and load on restart (default: %u)", DEFAULT_PERSIST_MEMPOOL), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-pid=<file>", strprintf("Specify pid file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)", BITCOIN_PID_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-prune=<n>", strprintf("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex and -rescan. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >=%u = automatically prune block files to stay under the specified target size in MiB)", MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-reindex", "Rebuild chain state and block index from the blk*.dat files on disk", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-recentblockcache=<n>", strprintf("Keep up to <n> MiB of recently connected blocks deserialized in memory for contract calls, indexes, peers and RPCs that read them again, 0 to disable (default: %u)", DEFAULT_RECENT_BLOCK_CACHE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-reindex-chainstate", "Rebuild chain state from the currently indexed blocks. When in pruning mode or if blocks on disk might be corrupted, use full -reindex instead.", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
-    gArgs.AddArg("-record-log-opcodes", "Logs all EVM LOG opcode operations to the file vmExecLogs.json", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-record-log-opcodes", strprintf("Logs all EVM LOG opcode operations to the file %s, one JSON object per line", VMLOG_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-vmlogmaxsize=<n>", strprintf("Rotate the -record-log-opcodes file once it grows past <n> MiB (default: %u)", DEFAULT_VMLOG_MAX_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #ifndef WIN32
     gArgs.AddArg("-sysperms", "Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #else
     hidden_args.emplace_back("-sysperms");
 #endif
+    gArgs.AddArg("-threadaffinity=<policy>", strprintf("Pin the threads to CPUs by their role, \"numa\" keeps validation, contract execution and its memory on one NUMA node, one CPU of it for the staker, and the network threads on the others (Linux only, none or numa, default: %s)", DEFAULT_THREAD_AFFINITY), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-txindex", strprintf("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)", DEFAULT_TXINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blockfilterindex=<type>",
                  strprintf("Maintain an index of compact filters by block (default: %s, values: %s).", DEFAULT_BLOCKFILTERINDEX, ListBlockFilterTypes()) +
-                 " If <type> is not supplied or if <type> = 1, indexes for all known types are enabled.",
+                 " If <type> is not supplied or if <type> = 1, indexes for all known types are enabled."
+                 " The evmlog filters of contract log addresses and topics require -logevents.",
                  ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-receiptcache=<n>", strprintf("Maximum memory used to cache transaction receipts read by searchlogs and gettransactionreceipt in MiB (default: %u)", DEFAULT_RECEIPT_CACHE_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-logindex", strprintf("Maintain an index of EVM log topics, used by searchlogs and waitforlogs to answer topic filters, requires -logevents (default: %u)", DEFAULT_LOGINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-tokenindex", strprintf("Maintain an index of QRC20 token transfers and holder balances, used by gettokenbalances and gettokentransfers, requires -logevents (default: %u)", DEFAULT_TOKENINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-coinstatsindex", strprintf("Maintain the MuHash and totals of the coin set block by block, used by gettxoutsetinfo (default: %u)", DEFAULT_COINSTATSINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-contractindex", strprintf("Maintain an index of the live contracts by creation height, used by listcontracts, requires -logevents (default: %u)", DEFAULT_CONTRACTINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-governanceindex", strprintf("Maintain an index of the governors and budget proposals, used by listgovernors, listbudgetproposals and listbudgetvotes, requires -logevents (default: %u)", DEFAULT_GOVERNANCEINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-evmbackend=<name>", strprintf("EVM implementation that runs contracts: legacy, or interpreter for the EVMC based aleth interpreter (default: %s)", DEFAULT_EVM_BACKEND), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-logevents", strprintf("Maintain a full EVM log index, used by searchlogs and gettransactionreceipt rpc calls (default: %u)", DEFAULT_LOGEVENTS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-logeventsprune=<n>", strprintf("Delete the receipts of blocks more than <n> deep and of pruned blocks, as part of block pruning. Requires -prune and -logevents (0 = keep all receipts, default: %u)", DEFAULT_LOGEVENTSPRUNE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-prunestate=<n>", strprintf("Delete the contract state that the last <n> blocks do not need when starting, at most every %d blocks. "
+                 "The state of older blocks is no longer available to the RPC calls and -logevents needs -reindex (0 = keep all, minimum %d, default: 0, or %d with -prune)",
+                 STATE_PRUNE_INTERVAL, MIN_BLOCKS_TO_KEEP, MIN_BLOCKS_TO_KEEP), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-prunestatekeep=<height>", "Also keep the contract state of the block at <height> with -prunestate, can be specified multiple times", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #ifdef ENABLE_BITCORE_RPC
     gArgs.AddArg("-addrindex", strprintf("Maintain a full address index (default: %u)", DEFAULT_ADDRINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #endif
@@ -433,10 +538,17 @@ void SetupServerArgs()
     gArgs.AddArg("-maxreceivebuffer=<n>", strprintf("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)", DEFAULT_MAXRECEIVEBUFFER), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxsendbuffer=<n>", strprintf("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)", DEFAULT_MAXSENDBUFFER), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxtimeadjustment", strprintf("Maximum allowed median peer time offset adjustment. Local perspective of time may be influenced by peers forward or backward by this amount. (default: %u seconds)", DEFAULT_MAX_TIME_ADJUSTMENT), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-maxpeerblockrate=<n>", strprintf("Serve historical blocks to each peer at most at the given rate (in KiB per second), blocks near the tip are always sent right away, 0 = no limit (default: %d)", DEFAULT_MAX_PEER_BLOCK_RATE), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxuploadtarget=<n>", strprintf("Tries to keep outbound traffic under the given target (in MiB per 24h), 0 = no limit (default: %d)", DEFAULT_MAX_UPLOAD_TARGET), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-onion=<ip:port>", "Use separate SOCKS5 proxy to reach peers via Tor hidden services, set -noonion to disable (default: -proxy)", ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-onlynet=<net>", "Make outgoing connections only through network <net> (ipv4, ipv6 or onion). Incoming connections are not affected by this option. This option can be specified multiple times to allow multiple networks.", ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-peerbloomfilters", strprintf("Support filtering of blocks and transaction with bloom filters (default: %u)", DEFAULT_PEERBLOOMFILTERS), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-peerblockfilters", strprintf("Serve compact block filters to peers per BIP 157 (default: %u)", DEFAULT_PEERBLOCKFILTERS), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
+#ifdef USE_ZLIB
+    gArgs.AddArg("-peercompression", strprintf("Compress large blocks and transactions sent to peers that support it and accept them compressed (default: %u)", DEFAULT_PEERCOMPRESSION), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
+#else
+    hidden_args.emplace_back("-peercompression");
+#endif
     gArgs.AddArg("-permitbaremultisig", strprintf("Relay non-P2SH multisig (default: %u)", DEFAULT_PERMIT_BAREMULTISIG), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-port=<port>", strprintf("Listen for connections on <port> (default: %u, testnet: %u, regtest: %u)", defaultChainParams->GetDefaultPort(), testnetChainParams->GetDefaultPort(), regtestChainParams->GetDefaultPort()), ArgsManager::ALLOW_ANY | ArgsManager::NETWORK_ONLY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-proxy=<ip:port>", "Connect through SOCKS5 proxy, set -noproxy to disable (default: disabled)", ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
@@ -477,19 +589,33 @@ void SetupServerArgs()
     gArgs.AddArg("-zmqpubhashtx=<address>", "Enable publish hash transaction in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawblock=<address>", "Enable publish raw block in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawtx=<address>", "Enable publish raw transaction in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubsequence=<address>", "Enable publish hash block and tx sequence in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawreceipt=<address>", "Enable publish raw transaction receipts in <address> (requires -logevents)", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpublogs=<address>", "Enable publish contract event logs in <address> (requires -logevents)", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpublogsaddress=<hex>", "Only publish the event logs of this contract address with -zmqpublogs (can be specified multiple times)", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubhashblockhwm=<n>", strprintf("Set publish hash block outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubhashtxhwm=<n>", strprintf("Set publish hash transaction outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawblockhwm=<n>", strprintf("Set publish raw block outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawtxhwm=<n>", strprintf("Set publish raw transaction outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubsequencehwm=<n>", strprintf("Set publish hash sequence message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawreceipthwm=<n>", strprintf("Set publish raw transaction receipts outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpublogshwm=<n>", strprintf("Set publish contract event logs outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
 #else
     hidden_args.emplace_back("-zmqpubhashblock=<address>");
     hidden_args.emplace_back("-zmqpubhashtx=<address>");
     hidden_args.emplace_back("-zmqpubrawblock=<address>");
     hidden_args.emplace_back("-zmqpubrawtx=<address>");
+    hidden_args.emplace_back("-zmqpubsequence=<address>");
+    hidden_args.emplace_back("-zmqpubrawreceipt=<address>");
+    hidden_args.emplace_back("-zmqpublogs=<address>");
+    hidden_args.emplace_back("-zmqpublogsaddress=<hex>");
     hidden_args.emplace_back("-zmqpubhashblockhwm=<n>");
     hidden_args.emplace_back("-zmqpubhashtxhwm=<n>");
     hidden_args.emplace_back("-zmqpubrawblockhwm=<n>");
     hidden_args.emplace_back("-zmqpubrawtxhwm=<n>");
+    hidden_args.emplace_back("-zmqpubsequencehwm=<n>");
+    hidden_args.emplace_back("-zmqpubrawreceipthwm=<n>");
+    hidden_args.emplace_back("-zmqpublogshwm=<n>");
 #endif
 
     gArgs.AddArg("-checkblocks=<n>", strprintf("How many blocks to check at startup (default: %u, 0 = all)", DEFAULT_CHECKBLOCKS), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
@@ -501,6 +627,7 @@ void SetupServerArgs()
         "and level 4 tries to reconnect the blocks, "
         "each level includes the checks of the previous levels "
         "(0-4, default: %u)", DEFAULT_CHECKLEVEL), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-checkblocksample=<n>", strprintf("How many random blocks of the chain to check in the background after startup, reading them and their undo data from disk (default: %u)", DEFAULT_CHECKBLOCKSAMPLE), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkblockindex", strprintf("Do a consistency check for the block tree, chainstate, and other validation data structures occasionally. (default: %u, regtest: %u)", defaultChainParams->DefaultConsistencyChecks(), regtestChainParams->DefaultConsistencyChecks()), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u, regtest: %u)", defaultChainParams->DefaultConsistencyChecks(), regtestChainParams->DefaultConsistencyChecks()), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkpoints", strprintf("Disable expensive verification for known chain history (default: %u)", DEFAULT_CHECKPOINTS_ENABLED), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
@@ -508,6 +635,7 @@ void SetupServerArgs()
     gArgs.AddArg("-dropmessagestest=<n>", "Randomly drop 1 of every <n> network messages", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-stopafterblockimport", strprintf("Stop running after importing blocks from disk (default: %u)", DEFAULT_STOPAFTERBLOCKIMPORT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-stopatheight", strprintf("Stop running after reaching the given height in the main chain (default: %u)", DEFAULT_STOPATHEIGHT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-lockstats", strprintf("Count how long locks are waited for and held, see getlockstats (default: %u)", DEFAULT_LOCK_STATS), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-limitancestorcount=<n>", strprintf("Do not accept transactions if number of in-mempool ancestors is <n> or more (default: %u)", DEFAULT_ANCESTOR_LIMIT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-limitancestorsize=<n>", strprintf("Do not accept transactions whose size with all in-mempool ancestors exceeds <n> kilobytes (default: %u)", DEFAULT_ANCESTOR_SIZE_LIMIT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-limitdescendantcount=<n>", strprintf("Do not accept transactions if any ancestor would have <n> or more in-mempool descendants (default: %u)", DEFAULT_DESCENDANT_LIMIT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
@@ -515,6 +643,8 @@ void SetupServerArgs()
     gArgs.AddArg("-addrmantest", "Allows to test address relay on localhost", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-debug=<category>", "Output debugging information (default: -nodebug, supplying <category> is optional). "
         "If <category> is not supplied or if <category> = 1, output all debugging information. <category> can be: " + ListLogCategories() + ".", ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-debugratelimit=<n>", strprintf("Log at most <n> messages per second of each debug category and drop the rest, 0 for no limit (default: %u)", DEFAULT_DEBUGRATELIMIT), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-asynclogging", strprintf("Write the debug log on a background thread instead of the threads logging (default: %u)", DEFAULT_ASYNCLOGGING), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-debugexclude=<category>", strprintf("Exclude debugging information for a category. Can be used in conjunction with -debug=1 to output debug logs for all categories except one or more specified categories."), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-logips", strprintf("Include IP addresses in debug output (default: %u)", DEFAULT_LOGIPS), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-logtimestamps", strprintf("Prepend debug output with timestamp (default: %u)", DEFAULT_LOGTIMESTAMPS), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
@@ -522,6 +652,7 @@ void SetupServerArgs()
     gArgs.AddArg("-logtimemicros", strprintf("Add microsecond precision to debug timestamps (default: %u)", DEFAULT_LOGTIMEMICROS), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-showevmlogs", strprintf("Print evm logs to console (default: %u)", DEFAULT_SHOWEVMLOGS), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-mocktime=<n>", "Replace actual time with <n> seconds since epoch (default: 0)", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-schedulerthreads=<n>", strprintf("Set the number of threads servicing validation notifications and periodic tasks (default: %d)", DEFAULT_SCHEDULER_THREADS), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-maxsigcachesize=<n>", strprintf("Limit sum of signature cache and script execution cache sizes to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-minmempoolgaslimit=<limit>", strprintf("The minimum transaction gas limit we are willing to accept into the mempool (default: %s)",MEMPOOL_MIN_GAS_LIMIT), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
@@ -560,9 +691,15 @@ void SetupServerArgs()
     gArgs.AddArg("-emergencystaking", "Allows for staking to happen even if the node doesn't think it is up to date (Useful for when the chain gets stuck and then nodes think they aren't synced and so they don't stake, waiting for a new block)", ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
 
     gArgs.AddArg("-rest", strprintf("Accept public REST requests (default: %u)", DEFAULT_REST_ENABLE), ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
+    gArgs.AddArg("-restcallgaslimit=<n>", strprintf("Gas a contract call at /rest/call may use, at most the block gas limit, requires -rest (default: %u)", DEFAULT_REST_CALL_GAS_LIMIT), ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
+    gArgs.AddArg("-restrpcmetrics", strprintf("Serve the statistics of getrpcmetrics in the Prometheus text format at /rest/rpcmetrics, requires -rest (default: %u)", DEFAULT_REST_RPC_METRICS), ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
+    gArgs.AddArg("-restsubscribers=<n>", strprintf("Keep up to <n> server-sent event streams of new blocks, transactions and logs open at /rest/subscribe, 0 to disable, requires -rest (default: %u)", DEFAULT_REST_SUBSCRIBERS), ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
     gArgs.AddArg("-rpcallowip=<ip>", "Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times", ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
     gArgs.AddArg("-rpcauth=<userpw>", "Username and HMAC-SHA-256 hashed password for JSON-RPC connections. The field <userpw> comes in the format: <USERNAME>:<SALT>$<HASH>. A canonical python script is included in share/rpcauth. The client then connects normally using the rpcuser=<USERNAME>/rpcpassword=<PASSWORD> pair of arguments. This option can be specified multiple times", ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
+    gArgs.AddArg("-rpcbatchthreads=<n>", strprintf("Set the number of threads one JSON-RPC batch request may use at once, 1 runs the calls of a batch one after the other (default: %d)", DEFAULT_RPC_BATCH_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
     gArgs.AddArg("-rpcbind=<addr>[:port]", "Bind to given address to listen for JSON-RPC connections. Do not expose the RPC server to untrusted networks such as the public internet! This option is ignored unless -rpcallowip is also passed. Port is optional and overrides -rpcport. Use [host]:port notation for IPv6. This option can be specified multiple times (default: 127.0.0.1 and ::1 i.e., localhost)", ArgsManager::ALLOW_ANY | ArgsManager::NETWORK_ONLY, OptionsCategory::RPC);
+    gArgs.AddArg("-rpccachedepth=<n>", strprintf("Only cache the results of blocks with at least <n> confirmations, at least 2 (default: %d)", DEFAULT_RPC_CACHE_DEPTH), ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
+    gArgs.AddArg("-rpccachesize=<n>", strprintf("Keep up to <n> MiB of the results of calls on confirmed blocks, such as getblock, getblockheader, getrawtransaction with a block hash and gettransactionreceipt, and answer repeated calls from it, 0 to disable (default: %d)", DEFAULT_RPC_CACHE_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
     gArgs.AddArg("-rpccookiefile=<loc>", "Location of the auth cookie. Relative paths will be prefixed by a net-specific datadir location. (default: data dir)", ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
     gArgs.AddArg("-rpcpassword=<pw>", "Password for JSON-RPC connections", ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
     gArgs.AddArg("-rpcport=<port>", strprintf("Listen for JSON-RPC connections on <port> (default: %u, testnet: %u, regtest: %u)", defaultBaseParams->RPCPort(), testnetBaseParams->RPCPort(), regtestBaseParams->RPCPort()), ArgsManager::ALLOW_ANY | ArgsManager::NETWORK_ONLY, OptionsCategory::RPC);
@@ -706,6 +843,7 @@ void DeleteBlockChainData()
     fs::remove(GetDataDir() / "banlist.dat");
     fs::remove(GetDataDir() / FEE_ESTIMATES_FILENAME);
     fs::remove(GetDataDir() / "mempool.dat");
+    fs::remove(GetDataDir() / "mempool.journal");
 }
 
 static void ThreadImport(std::vector<fs::path> vImportFiles)
@@ -719,10 +857,12 @@ static void ThreadImport(std::vector<fs::path> vImportFiles)
 
     // -reindex
     if (fReindex) {
+        // The reindex writes the undo data again, into plain files
+        DeleteArchivedUndoFiles();
         int nFile = 0;
         while (true) {
             FlatFilePos pos(nFile, 0);
-            if (!fs::exists(GetBlockPosFilename(pos)))
+            if (!fs::exists(GetBlockPosFilename(pos)) && !IsBlockFileArchived(pos))
                 break; // No block files left to reindex
             FILE *file = OpenBlockFile(pos, true);
             if (!file)
@@ -778,7 +918,14 @@ static void ThreadImport(std::vector<fs::path> vImportFiles)
     }
     } // End scope of CImportingNow
     if (gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
-        LoadMempool(::mempool);
+        MempoolJournalContents journal;
+        if (g_mempool_journal) {
+            ReadMempoolJournal(GetDataDir() / "mempool.journal", journal);
+        }
+        LoadMempool(::mempool, journal);
+        if (g_mempool_journal) {
+            g_mempool_journal->Start(journal);
+        }
     }
     ::mempool.SetIsLoaded(!ShutdownRequested());
 }
@@ -899,6 +1046,7 @@ void InitLogging()
     LogInstance().m_log_time_micros = gArgs.GetBoolArg("-logtimemicros", DEFAULT_LOGTIMEMICROS);
     LogInstance().m_log_threadnames = gArgs.GetBoolArg("-logthreadnames", DEFAULT_LOGTHREADNAMES);
     LogInstance().m_show_evm_logs = gArgs.GetBoolArg("-showevmlogs", DEFAULT_SHOWEVMLOGS);
+    LogInstance().m_category_rate_limit = (uint32_t)std::max<int64_t>(0, gArgs.GetArg("-debugratelimit", DEFAULT_DEBUGRATELIMIT));
 
     fLogIPs = gArgs.GetBoolArg("-logips", DEFAULT_LOGIPS);
 
@@ -1004,6 +1152,10 @@ bool AppInitParameterInteraction()
     std::string blockfilterindex_value = gArgs.GetArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX);
     if (blockfilterindex_value == "" || blockfilterindex_value == "1") {
         g_enabled_filter_types = AllBlockFilterTypes();
+        // the EVM log filters are only built with the receipts, leave them out unless asked for
+        if (!gArgs.GetBoolArg("-logevents", DEFAULT_LOGEVENTS)) {
+            g_enabled_filter_types.erase(BlockFilterType::EVM_LOGS);
+        }
     } else if (blockfilterindex_value != "0") {
         const std::vector<std::string> names = gArgs.GetArgs("-blockfilterindex");
         for (const auto& name : names) {
@@ -1015,6 +1167,17 @@ bool AppInitParameterInteraction()
         }
     }
 
+    if (g_enabled_filter_types.count(BlockFilterType::EVM_LOGS) && !gArgs.GetBoolArg("-logevents", DEFAULT_LOGEVENTS)) {
+        return InitError(strprintf(_("-blockfilterindex=%s requires -logevents.").translated, BlockFilterTypeName(BlockFilterType::EVM_LOGS)));
+    }
+
+    // Basic filters must be indexed to serve compact filters, the other types are served
+    // along with them when indexed.
+    if (gArgs.GetBoolArg("-peerblockfilters", DEFAULT_PEERBLOCKFILTERS) &&
+        g_enabled_filter_types.count(BlockFilterType::BASIC) != 1) {
+        return InitError(_("Cannot set -peerblockfilters without -blockfilterindex.").translated);
+    }
+
     // if using block pruning, then disallow txindex
     if (gArgs.GetArg("-prune", 0)) {
         if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX))
@@ -1022,6 +1185,45 @@ bool AppInitParameterInteraction()
         if (!g_enabled_filter_types.empty()) {
             return InitError(_("Prune mode is incompatible with -blockfilterindex.").translated);
         }
+        if (gArgs.GetBoolArg("-logindex", DEFAULT_LOGINDEX))
+            return InitError(_("Prune mode is incompatible with -logindex.").translated);
+        if (gArgs.GetBoolArg("-tokenindex", DEFAULT_TOKENINDEX))
+            return InitError(_("Prune mode is incompatible with -tokenindex.").translated);
+        if (gArgs.GetBoolArg("-contractindex", DEFAULT_CONTRACTINDEX))
+            return InitError(_("Prune mode is incompatible with -contractindex.").translated);
+        if (gArgs.GetBoolArg("-governanceindex", DEFAULT_GOVERNANCEINDEX))
+            return InitError(_("Prune mode is incompatible with -governanceindex.").translated);
+        if (gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX))
+            return InitError(_("Prune mode is incompatible with -coinstatsindex.").translated);
+#ifdef ENABLE_BITCORE_RPC
+        if (gArgs.GetBoolArg("-addrindex", DEFAULT_ADDRINDEX))
+            return InitError(_("Prune mode is incompatible with -addrindex.").translated);
+#endif
+    }
+
+    if (gArgs.GetBoolArg("-logindex", DEFAULT_LOGINDEX) && !gArgs.GetBoolArg("-logevents", DEFAULT_LOGEVENTS))
+        return InitError(_("-logindex requires -logevents.").translated);
+
+    if (gArgs.GetBoolArg("-tokenindex", DEFAULT_TOKENINDEX) && !gArgs.GetBoolArg("-logevents", DEFAULT_LOGEVENTS))
+        return InitError(_("-tokenindex requires -logevents.").translated);
+
+    if (gArgs.GetBoolArg("-contractindex", DEFAULT_CONTRACTINDEX) && !gArgs.GetBoolArg("-logevents", DEFAULT_LOGEVENTS))
+        return InitError(_("-contractindex requires -logevents.").translated);
+
+    if (gArgs.GetBoolArg("-governanceindex", DEFAULT_GOVERNANCEINDEX) && !gArgs.GetBoolArg("-logevents", DEFAULT_LOGEVENTS))
+        return InitError(_("-governanceindex requires -logevents.").translated);
+
+    // The VM is picked by VMFactory for every Executive, select it through the cpp-ethereum options
+    const std::string evm_backend = gArgs.GetArg("-evmbackend", DEFAULT_EVM_BACKEND);
+    if (evm_backend != "legacy" && evm_backend != "interpreter")
+        return InitError(strprintf(_("Unknown -evmbackend: '%s'.").translated, evm_backend));
+    try {
+        const char* vm_args[] = {"", "--vm", evm_backend.c_str()};
+        boost::program_options::variables_map vm_options;
+        boost::program_options::store(boost::program_options::parse_command_line(3, vm_args, dev::eth::vmProgramOptions()), vm_options);
+        boost::program_options::notify(vm_options);
+    } catch (const std::exception& e) {
+        return InitError(strprintf(_("Cannot select -evmbackend=%s: %s").translated, evm_backend, e.what()));
     }
 
     // -bind and -whitebind can't be set when not listening
@@ -1079,6 +1281,7 @@ bool AppInitParameterInteraction()
         mempool.setSanityCheck(1.0 / ratio);
     }
     fCheckBlockIndex = gArgs.GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
+    g_lock_stats = gArgs.GetBoolArg("-lockstats", DEFAULT_LOCK_STATS);
     fCheckpointsEnabled = gArgs.GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
 
     hashAssumeValid = uint256S(gArgs.GetArg("-assumevalid", chainparams.GetConsensus().defaultAssumeValid.GetHex()));
@@ -1125,6 +1328,14 @@ bool AppInitParameterInteraction()
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    nContractPrefetchThreads = std::max(0, std::min((int)gArgs.GetArg("-contractprefetch", DEFAULT_CONTRACT_PREFETCH_THREADS), MAX_CONTRACT_PREFETCH_THREADS));
+    nInputPrefetchThreads = std::max(0, std::min((int)gArgs.GetArg("-inputprefetch", DEFAULT_INPUT_PREFETCH_THREADS), MAX_INPUT_PREFETCH_THREADS));
+
+    std::string affinity_error;
+    if (!util::SetupThreadAffinity(gArgs.GetArg("-threadaffinity", DEFAULT_THREAD_AFFINITY), affinity_error)) {
+        return InitError(affinity_error);
+    }
+
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
     int64_t nPruneArg = gArgs.GetArg("-prune", 0);
     if (nPruneArg < 0) {
@@ -1143,6 +1354,33 @@ bool AppInitParameterInteraction()
         fPruneMode = true;
     }
 
+    int64_t nLogEventsPruneArg = gArgs.GetArg("-logeventsprune", DEFAULT_LOGEVENTSPRUNE);
+    if (nLogEventsPruneArg < 0) {
+        return InitError(_("-logeventsprune cannot be configured with a negative value.").translated);
+    }
+    if (nLogEventsPruneArg > 0 && (!fPruneMode || !gArgs.GetBoolArg("-logevents", DEFAULT_LOGEVENTS))) {
+        return InitError(_("-logeventsprune requires -prune and -logevents.").translated);
+    }
+    nLogEventsPrune = (unsigned int)std::min<int64_t>(nLogEventsPruneArg, std::numeric_limits<int>::max());
+
+    int64_t nPruneStateArg = gArgs.GetArg("-prunestate", fPruneMode ? MIN_BLOCKS_TO_KEEP : DEFAULT_PRUNESTATE);
+    if (nPruneStateArg != 0 && (nPruneStateArg < MIN_BLOCKS_TO_KEEP || nPruneStateArg > std::numeric_limits<int>::max())) {
+        return InitError(strprintf(_("-prunestate must keep at least %d blocks.").translated, MIN_BLOCKS_TO_KEEP));
+    }
+
+    int64_t nArchiveBlocksArg = gArgs.GetArg("-archiveblocks", DEFAULT_ARCHIVE_BLOCKS);
+    if (nArchiveBlocksArg != 0) {
+        if (nArchiveBlocksArg < MIN_BLOCKS_TO_KEEP || nArchiveBlocksArg > std::numeric_limits<int>::max()) {
+            return InitError(strprintf(_("-archiveblocks must keep at least %d blocks uncompressed.").translated, MIN_BLOCKS_TO_KEEP));
+        }
+        if (fPruneMode) {
+            return InitError(_("Prune mode is incompatible with -archiveblocks.").translated);
+        }
+        if (!CanArchiveFlatFiles()) {
+            return InitError(_("-archiveblocks requires a build with zlib.").translated);
+        }
+    }
+
     nConnectTimeout = gArgs.GetArg("-timeout", DEFAULT_CONNECT_TIMEOUT);
     if (nConnectTimeout <= 0) {
         nConnectTimeout = DEFAULT_CONNECT_TIMEOUT;
@@ -1203,6 +1441,12 @@ bool AppInitParameterInteraction()
     if (gArgs.GetBoolArg("-peerbloomfilters", DEFAULT_PEERBLOOMFILTERS))
         nLocalServices = ServiceFlags(nLocalServices | NODE_BLOOM);
 
+    if (gArgs.GetBoolArg("-peerblockfilters", DEFAULT_PEERBLOCKFILTERS))
+        nLocalServices = ServiceFlags(nLocalServices | NODE_COMPACT_FILTERS);
+
+    if (gArgs.GetBoolArg("-peercompression", DEFAULT_PEERCOMPRESSION) && CanCompressNetMessages())
+        nLocalServices = ServiceFlags(nLocalServices | NODE_COMPRESSED);
+
     if (gArgs.GetArg("-rpcserialversion", DEFAULT_RPC_SERIALIZE_VERSION) < 0)
         return InitError("rpcserialversion must be non-negative.");
 
@@ -1335,6 +1579,9 @@ bool AppInitMain(InitInterfaces& interfaces)
             return InitError(strprintf("Could not open debug log file %s",
                 LogInstance().m_file_path.string()));
     }
+    if (gArgs.GetBoolArg("-asynclogging", DEFAULT_ASYNCLOGGING)) {
+        LogInstance().StartWriter();
+    }
 
 ////////////////////////////////////////////////////////////////////// // qtum
     dev::g_logPost = [&](std::string const& s, char const* c){ LogInstance().LogPrintStr(s + '\n', true); };
@@ -1376,6 +1623,7 @@ bool AppInitMain(InitInterfaces& interfaces)
 
     InitSignatureCache();
     InitScriptExecutionCache();
+    InitBlockSignerCache();
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
@@ -1383,9 +1631,15 @@ bool AppInitMain(InitInterfaces& interfaces)
             threadGroup.create_thread([i]() { return ThreadScriptCheck(i); });
     }
 
-    // Start the lightweight task scheduler thread
-    CScheduler::Function serviceLoop = std::bind(&CScheduler::serviceQueue, &scheduler);
-    threadGroup.create_thread(std::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
+    // Start the lightweight task scheduler threads. The callbacks of each validation interface
+    // queue still run one at a time, the threads let a slow subscriber run beside the others.
+    const int n_scheduler_threads = std::max(1, (int)gArgs.GetArg("-schedulerthreads", DEFAULT_SCHEDULER_THREADS));
+    for (int i = 0; i < n_scheduler_threads; i++) {
+        threadGroup.create_thread([i] {
+            const std::string thread_name = i == 0 ? "scheduler" : strprintf("scheduler.%d", i);
+            TraceThread(thread_name.c_str(), std::bind(&CScheduler::serviceQueue, &scheduler));
+        });
+    }
 
     GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
     GetMainSignals().RegisterWithMempoolSignals(mempool);
@@ -1550,24 +1804,39 @@ bool AppInitMain(InitInterfaces& interfaces)
     fReindex = gArgs.GetBoolArg("-reindex", false);
     bool fReindexChainState = gArgs.GetBoolArg("-reindex-chainstate", false);
 
+    // The compactions of all the databases share one budget
+    SetDBCompactionRate(std::max<int64_t>(0, gArgs.GetArg("-dbcompactionrate", DEFAULT_DB_COMPACTION_RATE)) << 20);
+
+    g_recent_blocks.SetMaxBytes(std::max<int64_t>(0, gArgs.GetArg("-recentblockcache", DEFAULT_RECENT_BLOCK_CACHE)) << 20);
+
     // cache size calculations
     int64_t nTotalCache = (gArgs.GetArg("-dbcache", nDefaultDbCache) << 20);
     nTotalCache = std::max(nTotalCache, nMinDbCache << 20); // total cache cannot be less than nMinDbCache
     nTotalCache = std::min(nTotalCache, nMaxDbCache << 20); // total cache cannot be greater than nMaxDbcache
     int64_t nBlockTreeDBCache = std::min(nTotalCache / 8, nMaxBlockDBCache << 20);
 #ifdef ENABLE_BITCORE_RPC
-    if (gArgs.GetBoolArg("-addrindex", DEFAULT_ADDRINDEX)) {
-        // enable 3/4 of the cache if addressindex and/or spentindex is enabled
-        nBlockTreeDBCache = nTotalCache * 3 / 4;
-    } else {
-        if (nBlockTreeDBCache > (1 << 21) && !gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
-            nBlockTreeDBCache = (1 << 21); // block tree db cache shouldn't be larger than 2 MiB
-        }
+    if (nBlockTreeDBCache > (1 << 21) && !gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
+        nBlockTreeDBCache = (1 << 21); // block tree db cache shouldn't be larger than 2 MiB
     }
 #endif
     nTotalCache -= nBlockTreeDBCache;
     int64_t nTxIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxTxIndexCache << 20 : 0);
     nTotalCache -= nTxIndexCache;
+    int64_t nLogIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-logindex", DEFAULT_LOGINDEX) ? nMaxLogIndexCache << 20 : 0);
+    nTotalCache -= nLogIndexCache;
+    int64_t nTokenIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-tokenindex", DEFAULT_TOKENINDEX) ? nMaxTokenIndexCache << 20 : 0);
+    nTotalCache -= nTokenIndexCache;
+    int64_t nContractIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-contractindex", DEFAULT_CONTRACTINDEX) ? nMaxContractIndexCache << 20 : 0);
+    nTotalCache -= nContractIndexCache;
+    int64_t nGovernanceIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-governanceindex", DEFAULT_GOVERNANCEINDEX) ? nMaxGovernanceIndexCache << 20 : 0);
+    nTotalCache -= nGovernanceIndexCache;
+    int64_t nCoinStatsIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX) ? nMaxCoinStatsIndexCache << 20 : 0);
+    nTotalCache -= nCoinStatsIndexCache;
+#ifdef ENABLE_BITCORE_RPC
+    // the address index writes several entries per output, give it a quarter of the cache
+    int64_t nAddressIndexCache = std::min(nTotalCache / 4, gArgs.GetBoolArg("-addrindex", DEFAULT_ADDRINDEX) ? nMaxAddressIndexCache << 20 : 0);
+    nTotalCache -= nAddressIndexCache;
+#endif
     int64_t filter_index_cache = 0;
     if (!g_enabled_filter_types.empty()) {
         size_t n_indexes = g_enabled_filter_types.size();
@@ -1575,6 +1844,9 @@ bool AppInitMain(InitInterfaces& interfaces)
         filter_index_cache = max_cache / n_indexes;
         nTotalCache -= filter_index_cache * n_indexes;
     }
+    int64_t nStateCache = std::min(nTotalCache / 8, nMaxStateCache << 20); // uncommitted EVM state trie nodes
+    nTotalCache -= nStateCache;
+    nStateCacheUsage = nStateCache;
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
@@ -1585,14 +1857,37 @@ bool AppInitMain(InitInterfaces& interfaces)
     if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
         LogPrintf("* Using %.1f MiB for transaction index database\n", nTxIndexCache * (1.0 / 1024 / 1024));
     }
+    if (gArgs.GetBoolArg("-logindex", DEFAULT_LOGINDEX)) {
+        LogPrintf("* Using %.1f MiB for log index database\n", nLogIndexCache * (1.0 / 1024 / 1024));
+    }
+    if (gArgs.GetBoolArg("-tokenindex", DEFAULT_TOKENINDEX)) {
+        LogPrintf("* Using %.1f MiB for token index database\n", nTokenIndexCache * (1.0 / 1024 / 1024));
+    }
+    if (gArgs.GetBoolArg("-contractindex", DEFAULT_CONTRACTINDEX)) {
+        LogPrintf("* Using %.1f MiB for contract index database\n", nContractIndexCache * (1.0 / 1024 / 1024));
+    }
+    if (gArgs.GetBoolArg("-governanceindex", DEFAULT_GOVERNANCEINDEX)) {
+        LogPrintf("* Using %.1f MiB for governance index database\n", nGovernanceIndexCache * (1.0 / 1024 / 1024));
+    }
+    if (gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
+        LogPrintf("* Using %.1f MiB for coin stats index database\n", nCoinStatsIndexCache * (1.0 / 1024 / 1024));
+    }
+#ifdef ENABLE_BITCORE_RPC
+    if (gArgs.GetBoolArg("-addrindex", DEFAULT_ADDRINDEX)) {
+        LogPrintf("* Using %.1f MiB for address index database\n", nAddressIndexCache * (1.0 / 1024 / 1024));
+    }
+#endif
     for (BlockFilterType filter_type : g_enabled_filter_types) {
         LogPrintf("* Using %.1f MiB for %s block filter index database\n",
                   filter_index_cache * (1.0 / 1024 / 1024), BlockFilterTypeName(filter_type));
     }
+    LogPrintf("* Using %.1f MiB for uncommitted contract state\n", nStateCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1f MiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1f MiB for in-memory UTXO set (plus up to %.1f MiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
 
     bool fLoaded = false;
+    // -logevents was just enabled and the receipts of the connected blocks must be rebuilt from scratch
+    bool fReceiptBackfillReset = false;
     while (!fLoaded && !ShutdownRequested()) {
         bool fReset = fReindex;
         std::string strLoadError;
@@ -1612,8 +1907,11 @@ bool AppInitMain(InitInterfaces& interfaces)
                 // fails if it's still open from the previous loop. Close it first:
                 pblocktree.reset();
                 pstorageresult.reset();
+                stateViewPool.clear();
                 globalState.reset();
                 globalSealEngine.reset();
+                dgpCache.clear();
+                governanceWinnerCache.clear();
                 pblocktree.reset(new CBlockTreeDB(nBlockTreeDBCache, false, fReset));
 
                 if (fReset) {
@@ -1718,6 +2016,36 @@ bool AppInitMain(InitInterfaces& interfaces)
                 bool fStatus = fs::exists(qtumStateDir);
                 const std::string dirQtum(qtumStateDir.string());
                 const dev::h256 hashDB(dev::sha3(dev::rlp("")));
+
+                // The trie nodes are collected before OverlayDB opens the database, the blocks reconnected
+                // by a reindex write the state of every height again
+                int nStatePruneHeight = 0;
+                g_state_keep_heights.clear();
+                for (const std::string& height : gArgs.GetArgs("-prunestatekeep")) {
+                    g_state_keep_heights.insert(atoi(height));
+                }
+                if (fReset || fReindexChainState) {
+                    pblocktree->WriteStatePruneHeight(0);
+                } else {
+                    pblocktree->ReadStatePruneHeight(nStatePruneHeight);
+                }
+                const int nPruneStateDepth = (int)gArgs.GetArg("-prunestate", fPruneMode ? MIN_BLOCKS_TO_KEEP : DEFAULT_PRUNESTATE);
+                bool fReceiptBackfillPending = false;
+                pblocktree->ReadFlag("receiptbackfill", fReceiptBackfillPending);
+                const CBlockIndex* pindexStateTip = ::ChainActive().Tip();
+                if (fStatus && nPruneStateDepth > 0 && pindexStateTip != nullptr && !fReset && !fReindexChainState &&
+                    pindexStateTip->nHeight - nPruneStateDepth >= nStatePruneHeight + STATE_PRUNE_INTERVAL) {
+                    if (fReceiptBackfillPending) {
+                        // The receipt index replays the connected blocks on their historical state
+                        LogPrintf("Not pruning the contract state while the receipts are rebuilt\n");
+                    } else {
+                        if (PruneContractState(qtumStateDir, ::ChainActive(), nPruneStateDepth, g_state_keep_heights)) {
+                            nStatePruneHeight = pindexStateTip->nHeight - nPruneStateDepth;
+                            pblocktree->WriteStatePruneHeight(nStatePruneHeight);
+                        }
+                    }
+                }
+                g_state_prune_height = nStatePruneHeight;
                 dev::eth::BaseState existsQtumstate = fStatus ? dev::eth::BaseState::PreExisting : dev::eth::BaseState::Empty;
                 globalState = std::unique_ptr<QtumState>(new QtumState(dev::u256(0), QtumState::openDB(dirQtum, hashDB, dev::WithExisting::Trust), dirQtum, existsQtumstate));
                 dev::eth::Network ethNetwork;// = dev::eth::Network::qtumMainNetwork;
@@ -1729,9 +2057,12 @@ bool AppInitMain(InitInterfaces& interfaces)
                 dev::eth::ChainParams cp((chainparams.EVMGenesisInfo(ethNetwork)));
                 globalSealEngine = std::unique_ptr<dev::eth::SealEngineFace>(cp.createSealEngine());
 
-                pstorageresult.reset(new StorageResults(qtumStateDir.string()));
-                if (fReset) {
-                    pstorageresult->wipeResults();
+                try {
+                    pstorageresult.reset(new StorageResults(qtumStateDir.string(), std::max<int64_t>(0, gArgs.GetArg("-receiptcache", DEFAULT_RECEIPT_CACHE_SIZE)) << 20, fReset));
+                } catch (const std::exception& e) {
+                    LogPrintf("%s\n", e.what());
+                    strLoadError = _("Error opening the transaction receipts database, it was written by a newer version").translated;
+                    break;
                 }
 
                 if(::ChainActive().Tip() != nullptr){
@@ -1746,7 +2077,14 @@ bool AppInitMain(InitInterfaces& interfaces)
                 globalState->dbUtxo().commit();
 
                 fRecordLogOpcodes = gArgs.IsArgSet("-record-log-opcodes");
-                fIsVMlogFile = fs::exists(GetDataDir() / "vmExecLogs.json");
+                if (fRecordLogOpcodes && !g_vmlog_writer) {
+                    int64_t vmlog_max_size = std::max<int64_t>(1, gArgs.GetArg("-vmlogmaxsize", DEFAULT_VMLOG_MAX_SIZE));
+                    g_vmlog_writer = MakeUnique<VMLogWriter>(GetDataDir() / VMLOG_FILENAME, (uint64_t)vmlog_max_size << 20);
+                    if (!g_vmlog_writer->Start()) {
+                        g_vmlog_writer.reset();
+                        fRecordLogOpcodes = false;
+                    }
+                }
                 ///////////////////////////////////////////////////////////
 
                 ///////////////////////////////////////////////////////////// // metrix
@@ -1755,18 +2093,17 @@ bool AppInitMain(InitInterfaces& interfaces)
                 }
                 /////////////////////////////////////////////////////////////
 
-#ifdef ENABLE_BITCORE_RPC
-                /////////////////////////////////////////////////////////////// // qtum
-                if (fAddressIndex != gArgs.GetBoolArg("-addrindex", DEFAULT_ADDRINDEX)) {
-                    strLoadError = _("You need to rebuild the database using -reindex-chainstate to change -addrindex").translated;
-                    break;
-                }
-                ///////////////////////////////////////////////////////////////
-#endif
-                // Check for changed -logevents state
+                // Check for changed -logevents state, the receipts of the blocks already connected
+                // are rebuilt by the receipt index unless their undo data may have been pruned
                 if (fLogEvents != gArgs.GetBoolArg("-logevents", DEFAULT_LOGEVENTS) && !fLogEvents) {
-                    strLoadError = _("You need to rebuild the database using -reindex to enable -logevents").translated;
-                    break;
+                    if (fPruneMode || g_state_prune_height > 0) {
+                        strLoadError = _("You need to rebuild the database using -reindex to enable -logevents").translated;
+                        break;
+                    }
+                    fLogEvents = true;
+                    pblocktree->WriteFlag("logevents", fLogEvents);
+                    pblocktree->WriteFlag("receiptbackfill", true);
+                    fReceiptBackfillReset = true;
                 }
 
                 if (!gArgs.GetBoolArg("-logevents", DEFAULT_LOGEVENTS))
@@ -1775,6 +2112,13 @@ bool AppInitMain(InitInterfaces& interfaces)
                     pblocktree->WipeHeightIndex();
                     fLogEvents = false;
                     pblocktree->WriteFlag("logevents", fLogEvents);
+                    pblocktree->WriteFlag("receiptbackfill", false);
+                    pblocktree->WriteReceiptPruneHeight(0);
+                }
+
+                if (fLogEvents && !pblocktree->UpgradeHeightIndex()) {
+                    strLoadError = _("Error upgrading the height index").translated;
+                    break;
                 }
 
             if (!fReset) {
@@ -1806,8 +2150,15 @@ bool AppInitMain(InitInterfaces& interfaces)
                         break;
                     }
 
+                    // Disconnecting a block needs the contract state of its parent
+                    int nCheckBlocks = gArgs.GetArg("-checkblocks", DEFAULT_CHECKBLOCKS);
+                    if (tip && g_state_prune_height > 0 && (nCheckBlocks <= 0 || nCheckBlocks > tip->nHeight - g_state_prune_height)) {
+                        nCheckBlocks = std::max(1, tip->nHeight - g_state_prune_height);
+                        LogPrintf("Prune: the contract state below height %d was pruned; only checking %d blocks\n", g_state_prune_height.load(), nCheckBlocks);
+                    }
+
                     if (!CVerifyDB().VerifyDB(chainparams, &::ChainstateActive().CoinsDB(), gArgs.GetArg("-checklevel", DEFAULT_CHECKLEVEL),
-                                  gArgs.GetArg("-checkblocks", DEFAULT_CHECKBLOCKS))) {
+                                  nCheckBlocks)) {
                         strLoadError = _("Corrupted block database detected").translated;
                         break;
                     }
@@ -1863,8 +2214,50 @@ bool AppInitMain(InitInterfaces& interfaces)
         g_txindex->Start();
     }
 
+    bool fReceiptBackfill = false;
+    if (fLogEvents && pblocktree->ReadFlag("receiptbackfill", fReceiptBackfill) && fReceiptBackfill) {
+        int n_threads = std::max(1, std::min(GetNumCores(), MAX_RECEIPT_REPLAY_THREADS));
+        g_receiptindex = MakeUnique<ReceiptIndex>(n_threads, false, fReceiptBackfillReset);
+        g_receiptindex->Start();
+    }
+
+    if (gArgs.GetBoolArg("-logindex", DEFAULT_LOGINDEX)) {
+        g_logindex = MakeUnique<LogIndex>(nLogIndexCache, false, fReindex || fReceiptBackfillReset);
+        g_logindex->Start();
+    }
+
+    if (gArgs.GetBoolArg("-tokenindex", DEFAULT_TOKENINDEX)) {
+        g_tokenindex = MakeUnique<TokenIndex>(nTokenIndexCache, false, fReindex || fReceiptBackfillReset);
+        g_tokenindex->Start();
+    }
+
+    if (gArgs.GetBoolArg("-contractindex", DEFAULT_CONTRACTINDEX)) {
+        g_contractindex = MakeUnique<ContractIndex>(nContractIndexCache, false, fReindex || fReceiptBackfillReset);
+        g_contractindex->Start();
+    }
+
+    if (gArgs.GetBoolArg("-governanceindex", DEFAULT_GOVERNANCEINDEX)) {
+        g_governanceindex = MakeUnique<GovernanceIndex>(nGovernanceIndexCache, false, fReindex || fReceiptBackfillReset);
+        g_governanceindex->Start();
+    }
+
+    if (gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
+        g_coin_stats_index = MakeUnique<CoinStatsIndex>(nCoinStatsIndexCache, false, fReindex);
+        g_coin_stats_index->Start();
+    }
+
+#ifdef ENABLE_BITCORE_RPC
+    fAddressIndex = gArgs.GetBoolArg("-addrindex", DEFAULT_ADDRINDEX);
+    if (fAddressIndex) {
+        g_addressindex = MakeUnique<AddressIndex>(nAddressIndexCache, false, fReindex);
+        g_addressindex->Start();
+    }
+#endif
+
     for (const auto& filter_type : g_enabled_filter_types) {
-        InitBlockFilterIndex(filter_type, filter_index_cache, false, fReindex);
+        // the EVM log filters are rebuilt with the receipts when -logevents was just enabled
+        const bool f_wipe = fReindex || (filter_type == BlockFilterType::EVM_LOGS && fReceiptBackfillReset);
+        InitBlockFilterIndex(filter_type, filter_index_cache, false, f_wipe);
         GetBlockFilterIndex(filter_type)->Start();
     }
 
@@ -1924,11 +2317,23 @@ bool AppInitMain(InitInterfaces& interfaces)
         vImportFiles.push_back(strFile);
     }
 
+    if (gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
+        g_mempool_journal = MakeUnique<CMempoolJournal>(::mempool, GetDataDir() / "mempool.journal");
+    }
+
     threadGroup.create_thread(std::bind(&ThreadImport, vImportFiles));
 
     if(gArgs.GetBoolArg("-cleanblockindex", DEFAULT_CLEANBLOCKINDEX))
         threadGroup.create_thread(std::bind(&CleanBlockIndex));
 
+    const int nArchiveBlocks = gArgs.GetArg("-archiveblocks", DEFAULT_ARCHIVE_BLOCKS);
+    if (nArchiveBlocks > 0)
+        threadGroup.create_thread(std::bind(&TraceThread<std::function<void()>>, "blockarchive", std::function<void()>(std::bind(&ThreadArchiveBlockFiles, nArchiveBlocks))));
+
+    const int nCheckBlockSample = gArgs.GetArg("-checkblocksample", DEFAULT_CHECKBLOCKSAMPLE);
+    if (nCheckBlockSample > 0)
+        threadGroup.create_thread(std::bind(&TraceThread<std::function<void()>>, "checksample", std::function<void()>(std::bind(&ThreadCheckBlockSample, nCheckBlockSample))));
+
     // Wait for genesis block to be processed
     {
         WAIT_LOCK(g_genesis_wait_mutex, lock);
@@ -1984,6 +2389,7 @@ bool AppInitMain(InitInterfaces& interfaces)
 
     connOptions.nMaxOutboundTimeframe = nMaxOutboundTimeframe;
     connOptions.nMaxOutboundLimit = nMaxOutboundLimit;
+    connOptions.nMaxPeerBlockRate = std::max<int64_t>(0, gArgs.GetArg("-maxpeerblockrate", DEFAULT_MAX_PEER_BLOCK_RATE)) * 1024;
     connOptions.m_peer_connect_timeout = peer_connect_timeout;
 
     for (const std::string& strBind : gArgs.GetArgs("-bind")) {
@@ -2034,6 +2440,12 @@ bool AppInitMain(InitInterfaces& interfaces)
         g_banman->DumpBanlist();
     }, DUMP_BANS_INTERVAL * 1000);
 
+    if (g_mempool_journal) {
+        scheduler.scheduleEvery([]{
+            g_mempool_journal->Flush();
+        }, MEMPOOL_JOURNAL_FLUSH_INTERVAL * 1000);
+    }
+
     return true;
 }
 
@@ -75,9 +75,8 @@ class LockImpl : public Chain::Lock, public UniqueLock<CCriticalSection>
     int64_t getBlockTime(int height) override
     {
         LockAssertion lock(::cs_main);
-        CBlockIndex* block = ::ChainActive()[height];
-        assert(block != nullptr);
-        return block->GetBlockTime();
+        assert(height >= 0 && height <= ::ChainActive().Height());
+        return ::ChainActive().TimeAt(height);
     }
     int64_t getBlockMedianTimePast(int height) override
     {
@@ -161,14 +160,16 @@ public:
     explicit NotificationsHandlerImpl(Chain& chain, Chain::Notifications& notifications)
         : m_chain(chain), m_notifications(&notifications)
     {
-        RegisterValidationInterface(this);
+        // a queue per wallet, so that loaded wallets do not slow down block connection
+        RegisterQueuedValidationInterface(this, "wallet");
     }
     ~NotificationsHandlerImpl() override { disconnect(); }
     void disconnect() override
     {
         if (m_notifications) {
+            // runs the notifications already queued, which need m_notifications
+            UnregisterQueuedValidationInterface(this);
             m_notifications = nullptr;
-            UnregisterValidationInterface(this);
         }
     }
     void TransactionAddedToMempool(const CTransactionRef& tx) override
@@ -320,6 +321,10 @@ public:
     {
         return ::feeEstimator.HighestTargetTracked(FeeEstimateHorizon::LONG_HALFLIFE);
     }
+    CAmount estimateGasPrice(int num_blocks) override
+    {
+        return ::feeEstimator.estimateGasPrice(num_blocks);
+    }
     CFeeRate mempoolMinFee() override
     {
         return ::mempool.GetMinFee(gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000);
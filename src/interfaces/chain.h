@@ -172,6 +172,9 @@ public:
     //! Fee estimator max target.
     virtual unsigned int estimateMaxBlocks() = 0;
 
+    //! Estimate the gas price of contract transactions, 0 when there is no estimate.
+    virtual CAmount estimateGasPrice(int num_blocks) = 0;
+
     //! Mempool minimum fee.
     virtual CFeeRate mempoolMinFee() = 0;
 
@@ -410,6 +410,21 @@ public:
         }
         return result;
     }
+    std::vector<WalletTx> getWalletTxsBefore(int64_t before_pos, size_t count, int64_t& next_pos) override
+    {
+        auto locked_chain = m_wallet->chain().lock();
+        LOCK(m_wallet->cs_wallet);
+        std::vector<WalletTx> result;
+        next_pos = before_pos;
+        auto it = m_wallet->wtxOrdered.lower_bound(before_pos);
+        while (it != m_wallet->wtxOrdered.begin()) {
+            --it;
+            if (result.size() >= count && it->first != next_pos) break;
+            result.emplace_back(MakeWalletTx(*locked_chain, *m_wallet, *it->second));
+            next_pos = it->first;
+        }
+        return result;
+    }
     bool tryGetTxStatus(const uint256& txid,
         interfaces::WalletTxStatus& tx_status,
         int& num_blocks,
@@ -669,6 +684,14 @@ public:
     {
         return m_wallet->AddTokenTxEntry(MakeTokenTx(tokenTx), fFlushOnClose);
     }
+    bool addTokenTxEntries(const std::vector<TokenTx>& tokenTxs, bool fFlushOnClose) override
+    {
+        std::vector<CTokenTx> entries;
+        for (const TokenTx& tokenTx : tokenTxs) {
+            entries.push_back(MakeTokenTx(tokenTx));
+        }
+        return m_wallet->AddTokenTxEntries(entries, fFlushOnClose);
+    }
     bool existTokenEntry(const TokenInfo &token) override
     {
         auto locked_chain = m_wallet->chain().lock();
@@ -774,6 +797,14 @@ public:
     {
         return m_wallet->IsTokenTxMine(MakeTokenTx(wtx));
     }
+    bool getTokenBalance(const uint256& id, std::string& balance) override
+    {
+        return m_wallet->GetTokenBalance(id, balance);
+    }
+    bool setTokenBalance(const uint256& id, const std::string& balance, const uint256& block_hash) override
+    {
+        return m_wallet->SetTokenBalance(id, balance, block_hash);
+    }
     ContractBookData getContractBook(const std::string& id) override
     {
         LOCK(m_wallet->cs_wallet);
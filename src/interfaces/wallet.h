@@ -186,6 +186,11 @@ public:
     //! Get list of all wallet transactions.
     virtual std::vector<WalletTx> getWalletTxs() = 0;
 
+    //! Get up to count wallet transactions ordered before before_pos, newest
+    //! first. Transactions sharing an order position are never split, so more
+    //! can be returned. next_pos is set to the position to continue from.
+    virtual std::vector<WalletTx> getWalletTxsBefore(int64_t before_pos, size_t count, int64_t& next_pos) = 0;
+
     //! Try to get updated status for a particular transaction, if possible without blocking.
     virtual bool tryGetTxStatus(const uint256& txid,
         WalletTxStatus& tx_status,
@@ -279,6 +284,9 @@ public:
     //! Add wallet token transaction entry.
     virtual bool addTokenTxEntry(const TokenTx& tokenTx, bool fFlushOnClose=true) = 0;
 
+    //! Add wallet token transaction entries in a single database transaction.
+    virtual bool addTokenTxEntries(const std::vector<TokenTx>& tokenTxs, bool fFlushOnClose=true) = 0;
+
     //! Check if exist wallet token entry.
     virtual bool existTokenEntry(const TokenInfo &token) = 0;
 
@@ -315,6 +323,12 @@ public:
     //! Check if token transaction is mine
     virtual bool isTokenTxMine(const TokenTx &wtx) = 0;
 
+    //! Get the cached balance of a token
+    virtual bool getTokenBalance(const uint256& id, std::string& balance) = 0;
+
+    //! Cache the balance of a token read at the block
+    virtual bool setTokenBalance(const uint256& id, const std::string& balance, const uint256& block_hash) = 0;
+
     //! Get contract book data.
     virtual ContractBookData getContractBook(const std::string& address) = 0;
 
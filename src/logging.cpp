@@ -35,6 +35,9 @@ BCLog::Logger& LogInstance()
 
 bool fLogIPs = DEFAULT_LOGIPS;
 
+/** Bytes of messages queued for the writer thread before callers have to wait for it */
+static constexpr size_t MAX_PENDING_LOG_BYTES = 8 << 20;
+
 static int FileWriteStr(const std::string &str, FILE *fp)
 {
     return fwrite(str.data(), 1, str.size(), fp);
@@ -76,7 +79,7 @@ bool BCLog::Logger::StartLogging()
 
     // dump buffered messages from before we opened the log
     while (!m_msgs_before_open.empty()) {
-        LogMsg logmsg= m_msgs_before_open.front();
+        const LogMsg& logmsg = m_msgs_before_open.front();
 
         FILE* file = logmsg.useVMLog ? m_fileoutVM : m_fileout;
         if (file && m_print_to_file) FileWriteStr(logmsg.msg, file);
@@ -134,6 +137,30 @@ bool BCLog::Logger::WillLogCategory(BCLog::LogFlags category) const
     return (m_categories.load(std::memory_order_relaxed) & category) != 0;
 }
 
+bool BCLog::Logger::RateLimitCategory(BCLog::LogFlags category)
+{
+    const uint32_t limit = m_category_rate_limit.load(std::memory_order_relaxed);
+    if (limit == 0) return true;
+
+    size_t index = 0;
+    while (index + 1 < m_rate_limits.size() && !(category & (1u << index))) ++index;
+    RateLimit& rate_limit = m_rate_limits[index];
+
+    // The counts are only approximate when several threads start a new second at once
+    int64_t now = GetTimeMillis() / 1000;
+    int64_t second = rate_limit.second.load(std::memory_order_relaxed);
+    if (second != now && rate_limit.second.compare_exchange_strong(second, now)) {
+        rate_limit.logged = 0;
+        uint32_t dropped = rate_limit.dropped.exchange(0);
+        if (dropped) {
+            LogPrintStr(strprintf("Dropped %u %s debug messages over the rate limit of %u per second\n", dropped, LogCategoryToStr(category), limit));
+        }
+    }
+    if (++rate_limit.logged <= limit) return true;
+    ++rate_limit.dropped;
+    return false;
+}
+
 bool BCLog::Logger::DefaultShrinkDebugFile() const
 {
     return m_categories == BCLog::NONE;
@@ -191,6 +218,16 @@ bool GetLogCategory(BCLog::LogFlags& flag, const std::string& str)
     return false;
 }
 
+std::string LogCategoryToStr(BCLog::LogFlags category)
+{
+    for (const CLogCategoryDesc& category_desc : LogCategories) {
+        if (category_desc.flag == category) {
+            return category_desc.category;
+        }
+    }
+    return "";
+}
+
 std::string ListLogCategories()
 {
     std::string ret;
@@ -270,7 +307,7 @@ namespace BCLog {
 
 void BCLog::Logger::LogPrintStr(const std::string& str, bool useVMLog)
 {
-    std::lock_guard<std::mutex> scoped_lock(m_cs);
+    std::unique_lock<std::mutex> lock(m_cs);
     std::string str_prefixed = LogEscapeMessage(str);
 
     if (m_log_threadnames && m_started_new_line) {
@@ -283,17 +320,32 @@ void BCLog::Logger::LogPrintStr(const std::string& str, bool useVMLog)
 
     if (m_buffering) {
         // buffer if we haven't started logging yet
-        LogMsg logmsg(str_prefixed, useVMLog);
-        m_msgs_before_open.push_back(logmsg);
+        m_msgs_before_open.emplace_back(std::move(str_prefixed), useVMLog);
         return;
     }
 
+    if (m_writer_running) {
+        m_space_cond.wait(lock, [this] { return !m_writer_running || m_pending_bytes < MAX_PENDING_LOG_BYTES; });
+    }
+    if (m_writer_running) {
+        bool wake_writer = m_msgs_pending.empty();
+        m_pending_bytes += str_prefixed.size();
+        m_msgs_pending.emplace_back(std::move(str_prefixed), useVMLog);
+        if (wake_writer) m_writer_cond.notify_one();
+        return;
+    }
+
+    WriteStr(str_prefixed, useVMLog);
+}
+
+void BCLog::Logger::WriteStr(const std::string& str, bool useVMLog)
+{
     bool print_to_console = m_print_to_console;
     if(print_to_console && useVMLog && !m_show_evm_logs) print_to_console = false;
 
     if (print_to_console) {
         // print to console
-        fwrite(str_prefixed.data(), 1, str_prefixed.size(), stdout);
+        fwrite(str.data(), 1, str.size(), stdout);
         fflush(stdout);
     }
     if (m_print_to_file) {
@@ -318,8 +370,60 @@ void BCLog::Logger::LogPrintStr(const std::string& str, bool useVMLog)
                 file = new_fileout;
             }
         }
-        FileWriteStr(str_prefixed, file);
+        FileWriteStr(str, file);
+    }
+}
+
+void BCLog::Logger::ThreadWriter()
+{
+    util::ThreadRename("logwriter");
+
+    std::unique_lock<std::mutex> lock(m_cs);
+    while (true) {
+        m_writer_cond.wait(lock, [this] { return m_writer_stop || !m_msgs_pending.empty(); });
+        if (m_msgs_pending.empty()) break;
+
+        std::deque<LogMsg> msgs;
+        msgs.swap(m_msgs_pending);
+        m_pending_bytes = 0;
+        lock.unlock();
+        m_space_cond.notify_all();
+
+        // The files are unbuffered, so the messages for the same file are joined into one write
+        std::string str;
+        for (size_t i = 0; i < msgs.size(); ++i) {
+            str += msgs[i].msg;
+            if (i + 1 == msgs.size() || msgs[i + 1].useVMLog != msgs[i].useVMLog) {
+                WriteStr(str, msgs[i].useVMLog);
+                str.clear();
+            }
+        }
+        lock.lock();
+    }
+    m_writer_running = false;
+    lock.unlock();
+    m_space_cond.notify_all();
+}
+
+void BCLog::Logger::StartWriter()
+{
+    std::lock_guard<std::mutex> scoped_lock(m_cs);
+    if (m_buffering || m_writer_running) return;
+
+    m_writer_stop = false;
+    m_writer_running = true;
+    m_writer_thread = std::thread(&BCLog::Logger::ThreadWriter, this);
+}
+
+void BCLog::Logger::StopWriter()
+{
+    {
+        std::lock_guard<std::mutex> scoped_lock(m_cs);
+        if (!m_writer_thread.joinable()) return;
+        m_writer_stop = true;
     }
+    m_writer_cond.notify_one();
+    m_writer_thread.join();
 }
 
 void BCLog::Logger::ShrinkDebugFile()
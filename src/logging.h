@@ -9,11 +9,15 @@
 #include <fs.h>
 #include <tinyformat.h>
 
+#include <array>
 #include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
 #include <list>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 static const bool DEFAULT_LOGTIMEMICROS = false;
@@ -21,6 +25,8 @@ static const bool DEFAULT_LOGIPS        = false;
 static const bool DEFAULT_LOGTIMESTAMPS = true;
 static const bool DEFAULT_LOGTHREADNAMES = false;
 static const bool DEFAULT_SHOWEVMLOGS   = false;
+static const bool DEFAULT_ASYNCLOGGING  = true;
+static const unsigned int DEFAULT_DEBUGRATELIMIT = 0;
 extern const char * const DEFAULT_DEBUGLOGFILE;
 extern const char * const DEFAULT_DEBUGVMLOGFILE;
 
@@ -63,8 +69,8 @@ namespace BCLog {
 
     struct LogMsg
     {
-        LogMsg(const std::string& _msg, bool _useVMLog) :
-            msg(_msg),
+        LogMsg(std::string _msg, bool _useVMLog) :
+            msg(std::move(_msg)),
             useVMLog(_useVMLog)
         {}
 
@@ -79,7 +85,28 @@ namespace BCLog {
         FILE* m_fileout = nullptr;                 // GUARDED_BY(m_cs)
         FILE* m_fileoutVM = nullptr;               // GUARDED_BY(m_cs)
         std::list<LogMsg> m_msgs_before_open; // GUARDED_BY(m_cs)
-        bool m_buffering{true};                    //!< Buffer messages before logging can be started. GUARDED_BY(m_cs)
+        std::atomic_bool m_buffering{true};        //!< Buffer messages before logging can be started. Written under m_cs
+
+        /**
+         * Once the writer thread is started, messages are queued in m_msgs_pending and
+         * written to the outputs by that thread only, so the calling threads do not wait
+         * for the disk. The queue is bounded, a full queue makes the callers wait.
+         */
+        std::thread m_writer_thread;
+        std::condition_variable m_writer_cond;     //!< Wakes the writer thread
+        std::condition_variable m_space_cond;      //!< Wakes callers waiting for room in the queue
+        std::deque<LogMsg> m_msgs_pending;         // GUARDED_BY(m_cs)
+        size_t m_pending_bytes{0};                 // GUARDED_BY(m_cs)
+        bool m_writer_running{false};              // GUARDED_BY(m_cs)
+        bool m_writer_stop{false};                 // GUARDED_BY(m_cs)
+
+        /** Messages of a debug category logged in the current second, and those dropped in it */
+        struct RateLimit {
+            std::atomic<int64_t> second{0};
+            std::atomic<uint32_t> logged{0};
+            std::atomic<uint32_t> dropped{0};
+        };
+        std::array<RateLimit, 32> m_rate_limits;
 
         /**
          * m_started_new_line is a state variable that will suppress printing of
@@ -93,6 +120,11 @@ namespace BCLog {
 
         std::string LogTimestampStr(const std::string& str);
 
+        /** Write to the console and the log files. Called with m_cs held, or by the writer thread once it runs */
+        void WriteStr(const std::string& str, bool useVMLog);
+
+        void ThreadWriter();
+
     public:
         bool m_print_to_console = false;
         bool m_print_to_file = false;
@@ -106,18 +138,24 @@ namespace BCLog {
         fs::path m_file_pathVM;
         std::atomic<bool> m_reopen_file{false};
 
+        /** Messages per second logged for each debug category, the rest are dropped and counted. 0 for no limit */
+        std::atomic<uint32_t> m_category_rate_limit{DEFAULT_DEBUGRATELIMIT};
+
         /** Send a string to the log output */
         void LogPrintStr(const std::string& str, bool useVMLog = false);
 
         /** Returns whether logs will be written to any output */
         bool Enabled() const
         {
-            std::lock_guard<std::mutex> scoped_lock(m_cs);
             return m_buffering || m_print_to_console || m_print_to_file;
         }
 
         /** Start logging (and flush all buffered messages) */
         bool StartLogging();
+        /** Hand the writing over to a background thread. Does nothing before StartLogging */
+        void StartWriter();
+        /** Write out the queued messages and go back to writing on the calling thread */
+        void StopWriter();
         /** Only for testing */
         void DisconnectTestLogger();
 
@@ -132,6 +170,9 @@ namespace BCLog {
 
         bool WillLogCategory(LogFlags category) const;
 
+        /** Count a message of the category against m_category_rate_limit, false if it is to be dropped */
+        bool RateLimitCategory(LogFlags category);
+
         bool DefaultShrinkDebugFile() const;
     };
 
@@ -145,6 +186,9 @@ static inline bool LogAcceptCategory(BCLog::LogFlags category)
     return LogInstance().WillLogCategory(category);
 }
 
+/** Returns the name of a single log category. */
+std::string LogCategoryToStr(BCLog::LogFlags category);
+
 /** Returns a string with the log categories. */
 std::string ListLogCategories();
 
@@ -176,7 +220,7 @@ static inline void LogPrintf(const char* fmt, const Args&... args)
 template <typename... Args>
 static inline void LogPrint(const BCLog::LogFlags& category, const Args&... args)
 {
-    if (LogAcceptCategory((category))) {
+    if (LogAcceptCategory((category)) && LogInstance().RateLimitCategory(category)) {
         LogPrintf(args...);
     }
 }
@@ -0,0 +1,252 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <mempooljournal.h>
+
+#include <clientversion.h>
+#include <logging.h>
+#include <streams.h>
+#include <txmempool.h>
+#include <util/system.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <list>
+#include <unordered_map>
+
+#include <boost/bind.hpp>
+
+std::unique_ptr<CMempoolJournal> g_mempool_journal;
+
+static const uint64_t MEMPOOL_JOURNAL_VERSION = 1;
+/** Size of the version the journal starts with */
+static const uint64_t MEMPOOL_JOURNAL_HEADER_SIZE = sizeof(MEMPOOL_JOURNAL_VERSION);
+
+CMempoolJournal::CMempoolJournal(CTxMemPool& pool, const fs::path& path) : m_pool(pool), m_path(path) {}
+
+CMempoolJournal::~CMempoolJournal()
+{
+    m_conn_added.disconnect();
+    m_conn_removed.disconnect();
+    LOCK(cs_file);
+    if (m_file) fclose(m_file);
+}
+
+void CMempoolJournal::Start(const MempoolJournalContents& loaded)
+{
+    {
+        LOCK(cs_file);
+        // Keep the records read at load, without the one a crash may have cut short
+        m_file_records = loaded.records;
+        m_started = true;
+        Open(loaded.size);
+    }
+    m_conn_added = m_pool.NotifyEntryAdded.connect(boost::bind(&CMempoolJournal::TransactionAdded, this, _1));
+    m_conn_removed = m_pool.NotifyEntryRemoved.connect(boost::bind(&CMempoolJournal::TransactionRemoved, this, _1, _2));
+}
+
+void CMempoolJournal::TransactionAdded(CTransactionRef tx)
+{
+    // The pool signals with its lock held, the fee delta cannot change meanwhile
+    LOCK(m_pool.cs);
+    const auto it = m_pool.mapDeltas.find(tx->GetHash());
+    const int64_t fee_delta = it == m_pool.mapDeltas.end() ? 0 : it->second;
+    LOCK(m_queue_mutex);
+    m_queue.push_back(Record{ADD, std::move(tx), GetTime(), fee_delta});
+}
+
+void CMempoolJournal::TransactionRemoved(CTransactionRef tx, MemPoolRemovalReason reason)
+{
+    LOCK(m_queue_mutex);
+    m_queue.push_back(Record{REMOVE, std::move(tx), 0, 0});
+}
+
+bool CMempoolJournal::Open(uint64_t keep_size)
+{
+    if (m_file) {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+    try {
+        if (keep_size >= MEMPOOL_JOURNAL_HEADER_SIZE && fs::exists(m_path)) {
+            fs::resize_file(m_path, keep_size);
+            m_file = fsbridge::fopen(m_path, "ab");
+            if (m_file) return true;
+        }
+        m_file_records = 0;
+        m_file = fsbridge::fopen(m_path, "wb");
+        if (!m_file) {
+            LogPrintf("%s: cannot open %s\n", __func__, m_path.string());
+            return false;
+        }
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << MEMPOOL_JOURNAL_VERSION;
+        if (fwrite(ss.data(), 1, ss.size(), m_file) != ss.size() || !FileCommit(m_file)) {
+            LogPrintf("%s: cannot write %s\n", __func__, m_path.string());
+            fclose(m_file);
+            m_file = nullptr;
+            return false;
+        }
+    } catch (const fs::filesystem_error& e) {
+        LogPrintf("%s: %s\n", __func__, e.what());
+        return false;
+    }
+    return true;
+}
+
+bool CMempoolJournal::Write(const std::vector<Record>& records)
+{
+    if (!m_file && !Open(0)) return false;
+    if (records.empty()) return true;
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    for (const Record& record : records) {
+        ss << (uint8_t)record.type;
+        if (record.type == ADD) {
+            ss << record.tx << record.nTime << record.nFeeDelta;
+        } else {
+            ss << record.tx->GetHash();
+        }
+    }
+    if (fwrite(ss.data(), 1, ss.size(), m_file) != ss.size() || fflush(m_file) != 0) {
+        LogPrintf("%s: cannot append to %s\n", __func__, m_path.string());
+        // A partial record would hide the ones appended after it
+        fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+    m_file_records += records.size();
+    return true;
+}
+
+bool CMempoolJournal::NeedsCompaction()
+{
+    return m_file_records > std::max<uint64_t>(MEMPOOL_JOURNAL_MIN_COMPACT, 2 * m_pool.size());
+}
+
+bool CMempoolJournal::Flush()
+{
+    LOCK(cs_file);
+    if (!m_started) return false;
+    if (NeedsCompaction()) {
+        return Compact();
+    }
+    std::vector<Record> records;
+    {
+        LOCK(m_queue_mutex);
+        records.swap(m_queue);
+    }
+    if (!Write(records)) {
+        // Without a complete journal only a snapshot of the pool persists it
+        return Compact();
+    }
+    return true;
+}
+
+bool CMempoolJournal::Compact()
+{
+    LOCK(cs_file);
+    if (!m_started) return false;
+    // The changes recorded before the pool was copied are in mempool.dat, the later ones stay queued
+    std::vector<Record> copied;
+    if (!WriteMempoolSnapshot(m_pool, [this, &copied] { LOCK(m_queue_mutex); copied.swap(m_queue); })) {
+        LOCK(m_queue_mutex);
+        m_queue.insert(m_queue.begin(), copied.begin(), copied.end());
+        return false;
+    }
+    return Open(0);
+}
+
+bool CMempoolJournal::Close(const uint256& tip)
+{
+    LOCK(cs_file);
+    if (!m_started) return false;
+    if (NeedsCompaction()) {
+        Compact();
+    }
+    std::vector<Record> records;
+    std::map<uint256, CAmount> deltas;
+    {
+        LOCK2(m_pool.cs, m_queue_mutex);
+        records.swap(m_queue);
+        deltas = m_pool.mapDeltas;
+    }
+    if (!Write(records) && !Compact()) {
+        return false;
+    }
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << (uint8_t)CLOSE << tip << deltas;
+    if (fwrite(ss.data(), 1, ss.size(), m_file) != ss.size() || !FileCommit(m_file)) {
+        LogPrintf("%s: cannot close %s\n", __func__, m_path.string());
+        return false;
+    }
+    m_file_records++;
+    LogPrintf("Closed the mempool journal at %s with %u records\n", tip.ToString(), m_file_records);
+    return true;
+}
+
+bool ReadMempoolJournal(const fs::path& path, MempoolJournalContents& contents)
+{
+    contents = MempoolJournalContents();
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        return false;
+    }
+
+    // The transactions still added, in the order of their last addition
+    std::list<PersistedMempoolTx> added;
+    std::unordered_map<uint256, std::list<PersistedMempoolTx>::iterator, SaltedTxidHasher> index;
+    try {
+        uint64_t version;
+        file >> version;
+        if (version != MEMPOOL_JOURNAL_VERSION) {
+            LogPrintf("%s: unknown version %u of %s\n", __func__, version, path.string());
+            return false;
+        }
+        contents.size = MEMPOOL_JOURNAL_HEADER_SIZE;
+
+        while (true) {
+            const int type = fgetc(file.Get());
+            if (type == EOF) break;
+
+            uint256 hash;
+            if (type == CMempoolJournal::ADD) {
+                PersistedMempoolTx entry;
+                file >> entry.tx >> entry.nTime >> entry.nFeeDelta;
+                hash = entry.tx->GetHash();
+                const auto it = index.find(hash);
+                if (it != index.end()) added.erase(it->second);
+                index[hash] = added.insert(added.end(), std::move(entry));
+            } else if (type == CMempoolJournal::REMOVE) {
+                file >> hash;
+                const auto it = index.find(hash);
+                if (it != index.end()) {
+                    added.erase(it->second);
+                    index.erase(it);
+                }
+            } else if (type == CMempoolJournal::CLOSE) {
+                file >> contents.closed_tip >> contents.deltas;
+            } else {
+                LogPrintf("%s: unknown record type %d in %s\n", __func__, type, path.string());
+                break;
+            }
+            if (type != CMempoolJournal::CLOSE) {
+                contents.touched.insert(hash);
+                contents.closed_tip.SetNull();
+                contents.deltas.clear();
+            }
+            contents.records++;
+            contents.size = ftell(file.Get());
+        }
+    } catch (const std::exception& e) {
+        // A crash cut the last record short, the pool was not closed after it
+        LogPrintf("%s: %s ends after %u records: %s\n", __func__, path.string(), contents.records, e.what());
+        contents.closed_tip.SetNull();
+        contents.deltas.clear();
+    }
+
+    contents.added.assign(std::make_move_iterator(added.begin()), std::make_move_iterator(added.end()));
+    return true;
+}
@@ -0,0 +1,129 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_MEMPOOLJOURNAL_H
+#define BITCOIN_MEMPOOLJOURNAL_H
+
+#include <amount.h>
+#include <fs.h>
+#include <primitives/transaction.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <map>
+#include <memory>
+#include <set>
+#include <stdint.h>
+#include <vector>
+
+#include <boost/signals2/connection.hpp>
+
+class CTxMemPool;
+enum class MemPoolRemovalReason;
+
+/** Seconds between two appends to mempool.journal */
+static const int64_t MEMPOOL_JOURNAL_FLUSH_INTERVAL = 10;
+/** Records mempool.journal holds at least before it is folded into mempool.dat */
+static const uint64_t MEMPOOL_JOURNAL_MIN_COMPACT = 10000;
+
+/** A transaction of the persisted mempool with its acceptance time and fee delta */
+struct PersistedMempoolTx
+{
+    CTransactionRef tx;
+    int64_t nTime;
+    int64_t nFeeDelta;
+};
+
+/** What mempool.journal changes in the pool of mempool.dat */
+struct MempoolJournalContents
+{
+    //! Transactions added by the journal and still in the pool at its end, in the order they were added
+    std::vector<PersistedMempoolTx> added;
+    //! Transactions the journal added or removed, the ones of mempool.dat are superseded
+    std::set<uint256> touched;
+    //! Tip the pool was valid at when the node shut down cleanly after the last change, null otherwise
+    uint256 closed_tip;
+    //! Fee deltas at the clean shutdown
+    std::map<uint256, CAmount> deltas;
+    //! Records read and the size of the journal up to the last complete one
+    uint64_t records{0};
+    uint64_t size{0};
+};
+
+/**
+ * Changes of the mempool since mempool.dat was written. They are appended to
+ * mempool.journal from the scheduler thread, so that neither a crash loses the
+ * pool nor a shutdown rewrites it. The journal is folded into mempool.dat once
+ * it grows larger than the pool. A clean shutdown closes it with the tip the
+ * pool was validated against, the next start then skips the script checks of
+ * the transactions when the tip has not changed.
+ */
+class CMempoolJournal
+{
+public:
+    CMempoolJournal(CTxMemPool& pool, const fs::path& path);
+    ~CMempoolJournal();
+
+    /** Start recording the changes of the pool once it was loaded, appending to the journal read at load */
+    void Start(const MempoolJournalContents& loaded);
+
+    /** Append the recorded changes, folding the journal into mempool.dat when it outgrew the pool */
+    bool Flush();
+
+    /** Append the recorded changes and close the journal with the tip and the fee deltas */
+    bool Close(const uint256& tip);
+
+    /** Write mempool.dat and empty the journal */
+    bool Compact();
+
+    /** The pool whose changes are recorded */
+    const CTxMemPool& GetPool() const { return m_pool; }
+
+private:
+    friend bool ReadMempoolJournal(const fs::path& path, MempoolJournalContents& contents);
+
+    enum Type : uint8_t {
+        ADD = 1,
+        REMOVE = 2,
+        CLOSE = 3,
+    };
+
+    struct Record {
+        Type type;
+        CTransactionRef tx;
+        int64_t nTime;
+        int64_t nFeeDelta;
+    };
+
+    CTxMemPool& m_pool;
+    const fs::path m_path;
+
+    //! Serializes the writes of the journal and of mempool.dat
+    CCriticalSection cs_file;
+    //! Nothing is written before the journal of the last run was read
+    bool m_started GUARDED_BY(cs_file){false};
+    FILE* m_file GUARDED_BY(cs_file){nullptr};
+    uint64_t m_file_records GUARDED_BY(cs_file){0};
+
+    //! Changes not written yet, filled with the pool lock held
+    Mutex m_queue_mutex;
+    std::vector<Record> m_queue GUARDED_BY(m_queue_mutex);
+
+    boost::signals2::scoped_connection m_conn_added;
+    boost::signals2::scoped_connection m_conn_removed;
+
+    void TransactionAdded(CTransactionRef tx);
+    void TransactionRemoved(CTransactionRef tx, MemPoolRemovalReason reason);
+    bool Open(uint64_t keep_size) EXCLUSIVE_LOCKS_REQUIRED(cs_file);
+    bool Write(const std::vector<Record>& records) EXCLUSIVE_LOCKS_REQUIRED(cs_file);
+    bool NeedsCompaction() EXCLUSIVE_LOCKS_REQUIRED(cs_file);
+};
+
+/** The journal of ::mempool, set while -persistmempool is enabled */
+extern std::unique_ptr<CMempoolJournal> g_mempool_journal;
+
+/** Read mempool.journal, a record cut short by a crash ends it */
+bool ReadMempoolJournal(const fs::path& path, MempoolJournalContents& contents);
+
+#endif // BITCOIN_MEMPOOLJOURNAL_H
@@ -6,6 +6,7 @@
 #define BITCOIN_MEMUSAGE_H
 
 #include <indirectmap.h>
+#include <support/allocators/pool.h>
 
 #include <stdlib.h>
 
@@ -165,6 +166,18 @@ static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z>& m)
     return MallocUsage(sizeof(unordered_node<std::pair<const X, Y> >)) * m.size() + MallocUsage(sizeof(void*) * m.bucket_count());
 }
 
+template<typename X, typename Y, typename Z, typename P, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z, P, PoolAllocator<std::pair<const X, Y>, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> >& m)
+{
+    // The nodes live in the chunks of the pool, whether they are in use or in
+    // its freelists. The chunks themselves are kept in a std::list, whose nodes
+    // hold the previous and next pointers and the pointer to the chunk.
+    const auto* pool_resource = m.get_allocator().resource();
+    size_t usage_list = MallocUsage(sizeof(void*) * 3) * pool_resource->NumAllocatedChunks();
+    size_t usage_chunks = MallocUsage(pool_resource->ChunkSizeBytes()) * pool_resource->NumAllocatedChunks();
+    return usage_list + usage_chunks + MallocUsage(sizeof(void*) * m.bucket_count());
+}
+
 }
 
 #endif // BITCOIN_MEMUSAGE_H
@@ -13,12 +13,14 @@
 #include <consensus/merkle.h>
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
+#include <dbscheduler.h>
 #include <policy/feerate.h>
 #include <policy/policy.h>
 #include <pow.h>
 #include <pos.h>
 #include <primitives/transaction.h>
 #include <script/standard.h>
+#include <shutdown.h>
 #include <timedata.h>
 #include <util/convert.h>
 #include <util/moneystr.h>
@@ -30,7 +32,12 @@
 #endif
 
 #include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <map>
 #include <queue>
+#include <set>
+#include <thread>
 #include <utility>
 
 unsigned int nMinerSleep = STAKER_POLLING_PERIOD;
@@ -98,6 +105,7 @@ void BlockAssembler::resetBlock()
     // These counters do not include coinbase tx
     nBlockTx = 0;
     nFees = 0;
+    nContractExecTime = 0;
 }
 
 void BlockAssembler::RebuildRefundTransaction(){
@@ -243,18 +251,17 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
 
     nBlockMaxWeight = blockSizeDGP ? blockSizeDGP * WITNESS_SCALE_FACTOR : nBlockMaxWeight;
     
-    dev::h256 oldHashStateRoot(globalState->rootHash());
-    dev::h256 oldHashUTXORoot(globalState->rootHashUTXO());
     int nPackagesSelected = 0;
     int nDescendantsUpdated = 0;
-    addPackageTxs(nPackagesSelected, nDescendantsUpdated, minGasPrice);
-    pblock->hashStateRoot = uint256(h256Touint(dev::h256(globalState->rootHash())));
-    pblock->hashUTXORoot = uint256(h256Touint(dev::h256(globalState->rootHashUTXO())));
-    globalState->setRoot(oldHashStateRoot);
-    globalState->setRootUTXO(oldHashUTXORoot);
+    {
+        StateSavepoint savepoint(*globalState);
+        addPackageTxs(nPackagesSelected, nDescendantsUpdated, minGasPrice);
+        pblock->hashStateRoot = uint256(h256Touint(dev::h256(globalState->rootHash())));
+        pblock->hashUTXORoot = uint256(h256Touint(dev::h256(globalState->rootHashUTXO())));
+    }
 
-    //this should already be populated by AddBlock in case of contracts, but if no contracts
-    //then it won't get populated
+    //the refund outputs of the contracts are accumulated in bceResult while filling the block
+    //and added to the refund/proof tx once here
     RebuildRefundTransaction();
     ////////////////////////////////////////////////////////
     if (!fProofOfStake)
@@ -286,6 +293,71 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
 
     return std::move(pblocktemplate);
 }
+bool BlockAssembler::UpdateNewBlock(std::unique_ptr<CBlockTemplate>& blocktemplate)
+{
+    if (!blocktemplate || &blocktemplate->block != pblock)
+        return false;
+
+    int64_t nTimeStart = GetTimeMicros();
+
+    LOCK2(cs_main, mempool.cs);
+    CBlockIndex* pindexPrev = ::ChainActive().Tip();
+    assert(pindexPrev != nullptr);
+    if (pblock->hashPrevBlock != pindexPrev->GetBlockHash())
+        return false;
+
+    // Find the transactions of the template in the mempool again, the value transfers
+    // created by the contracts were never there
+    const bool fProofOfStake = pblock->IsProofOfStake();
+    CTxMemPool::setEntries inTemplate;
+    for (size_t i = fProofOfStake ? 2 : 1; i < pblock->vtx.size(); i++) {
+        const CTransaction& tx = *pblock->vtx[i];
+        CTxMemPool::txiter it = mempool.mapTx.find(tx.GetHash());
+        if (it != mempool.mapTx.end()) {
+            inTemplate.insert(it);
+        } else if (!tx.HasOpSpend()) {
+            return false;
+        }
+    }
+
+    pblocktemplate = std::move(blocktemplate);
+    inBlock = std::move(inTemplate);
+    uint64_t nBlockTxBefore = nBlockTx;
+
+    QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
+    globalSealEngine->setQtumSchedule(qtumDGP.getGasSchedule(nHeight));
+
+    int nPackagesSelected = 0;
+    int nDescendantsUpdated = 0;
+    {
+        // Go on from the state the contracts of the template left
+        StateSavepoint savepoint(*globalState);
+        globalState->setRoot(uintToh256(pblock->hashStateRoot));
+        globalState->setRootUTXO(uintToh256(pblock->hashUTXORoot));
+        addPackageTxs(nPackagesSelected, nDescendantsUpdated, minGasPrice);
+        pblock->hashStateRoot = uint256(h256Touint(dev::h256(globalState->rootHash())));
+        pblock->hashUTXORoot = uint256(h256Touint(dev::h256(globalState->rootHashUTXO())));
+    }
+
+    RebuildRefundTransaction();
+    if (!fProofOfStake)
+        pblocktemplate->vchCoinbaseCommitment = GenerateCoinbaseCommitment(*pblock, pindexPrev, chainparams.GetConsensus(), fProofOfStake);
+    pblocktemplate->vTxFees[0] = -nFees;
+    pblocktemplate->vTxSigOpsCost[0] = WITNESS_SCALE_FACTOR * GetLegacySigOpCount(*pblock->vtx[0]);
+
+    LogPrintf("UpdateNewBlock(): block weight: %u txs: %u (%u new) fees: %ld sigops %d\n", GetBlockWeight(*pblock), nBlockTx, nBlockTx - nBlockTxBefore, nFees, nBlockSigOpsCost);
+
+    CValidationState state;
+    if (!fProofOfStake && !TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
+        throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
+    }
+
+    LogPrint(BCLog::BENCH, "UpdateNewBlock() packages: %.2fms (%d packages, %d updated descendants)\n", 0.001 * (GetTimeMicros() - nTimeStart), nPackagesSelected, nDescendantsUpdated);
+
+    blocktemplate = std::move(pblocktemplate);
+    return true;
+}
+
 std::unique_ptr<CBlockTemplate> BlockAssembler::CreateEmptyBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx, bool fProofOfStake, int64_t* pTotalFees, int32_t nTime)
 {
     resetBlock();
@@ -444,6 +516,87 @@ bool BlockAssembler::TestPackageTransactions(const CTxMemPool::setEntries& packa
     return true;
 }
 
+ContractExecTimes g_contract_exec_times;
+
+ContractExecTimes::Key ContractExecTimes::GetKey(const QtumTransaction& tx)
+{
+    if (tx.isCreation())
+        return Key(dev::Address(), 0);
+    const dev::bytes& data = tx.data();
+    uint32_t selector = 0;
+    for (size_t i = 0; i < 4 && i < data.size(); i++)
+        selector = (selector << 8) | data[i];
+    return Key(tx.receiveAddress(), selector);
+}
+
+int64_t ContractExecTimes::Predict(const std::vector<QtumTransaction>& txs) const
+{
+    LOCK(m_mutex);
+    int64_t nPredicted = 0;
+    for (const QtumTransaction& tx : txs) {
+        auto it = m_times.find(GetKey(tx));
+        if (it != m_times.end())
+            nPredicted += it->second.nAverage;
+    }
+    return nPredicted;
+}
+
+void ContractExecTimes::Add(const std::vector<QtumTransaction>& txs, int64_t nMicros)
+{
+    if (txs.empty())
+        return;
+    // The transactions run in one ByteCodeExec, each is accounted an equal share
+    int64_t nShare = nMicros / (int64_t)txs.size();
+    int64_t nNow = GetTime();
+    LOCK(m_mutex);
+    for (const QtumTransaction& tx : txs) {
+        Key key = GetKey(tx);
+        auto it = m_times.find(key);
+        if (it == m_times.end()) {
+            if (m_times.size() >= MAX_CONTRACT_EXEC_TIMES) {
+                m_times.erase(std::min_element(m_times.begin(), m_times.end(), [](const std::pair<const Key, ContractExecTime>& a, const std::pair<const Key, ContractExecTime>& b) {
+                    return a.second.nLastTime < b.second.nLastTime;
+                }));
+            }
+            it = m_times.emplace(key, ContractExecTime()).first;
+        }
+        ContractExecTime& time = it->second;
+        time.nAverage = time.nCount ? time.nAverage + (nShare - time.nAverage) / 8 : nShare;
+        time.nMax = std::max(time.nMax, nShare);
+        time.nLastTime = nNow;
+        time.nCount++;
+    }
+}
+
+std::map<ContractExecTimes::Key, ContractExecTime> ContractExecTimes::GetAll() const
+{
+    LOCK(m_mutex);
+    return m_times;
+}
+
+bool BlockAssembler::TestPackageGas(const CTxMemPool::setEntries& package, uint64_t minGasPrice) const
+{
+    unsigned int contractflags = GetContractScriptFlags(nHeight, chainparams.GetConsensus());
+    for (CTxMemPool::txiter it : package) {
+        if (!it->GetTx().HasCreateOrCall())
+            continue;
+        // Entries without extracted contract txs are left to AttemptToAddContractToBlock
+        ContractTxsRef contractTxs = it->GetContractTxs(contractflags);
+        if (!contractTxs)
+            continue;
+        dev::u256 txGas = 0;
+        for (const QtumTransaction& qtumTransaction : contractTxs->first) {
+            txGas += qtumTransaction.gas();
+            // The gas used by the block only grows, so these keep failing for the rest of the block
+            if (txGas > txGasLimit || bceResult.usedGas + qtumTransaction.gas() > softBlockGasLimit)
+                return false;
+            if (qtumTransaction.gasPrice() < minGasPrice)
+                return false;
+        }
+    }
+    return true;
+}
+
 bool BlockAssembler::AttemptToAddContractToBlock(CTxMemPool::txiter iter, uint64_t minGasPrice) {
     if (nTimeLimit != 0 && GetAdjustedTime() >= nTimeLimit - BYTECODE_TIME_BUFFER) {
         return false;
@@ -452,25 +605,23 @@ bool BlockAssembler::AttemptToAddContractToBlock(CTxMemPool::txiter iter, uint64
     {
         return false;
     }
-    
-    dev::h256 oldHashStateRoot(globalState->rootHash());
-    dev::h256 oldHashUTXORoot(globalState->rootHashUTXO());
+
     // operate on local vars first, then later apply to `this`
     uint64_t nBlockWeight = this->nBlockWeight;
     uint64_t nBlockSigOpsCost = this->nBlockSigOpsCost;
 
     unsigned int contractflags = GetContractScriptFlags(nHeight, chainparams.GetConsensus());
-    QtumTxConverter convert(iter->GetTx(), NULL, &pblock->vtx, contractflags);
-
-    ExtractQtumTX resultConverter;
-    if(!convert.extractionQtumTransactions(resultConverter)){
+    // Reuse the contract transactions extracted when the tx entered the mempool, the sender
+    // lookup they need can otherwise go to disk for every attempt
+    ContractTxsRef contractTxs = iter->GetContractTxs(contractflags);
+    if(!contractTxs && !ExtractContractTxs(iter->GetTx(), NULL, &pblock->vtx, contractflags, contractTxs)){
         //this check already happens when accepting txs into mempool
         //therefore, this can only be triggered by using raw transactions on the staker itself
         return false;
     }
-    std::vector<QtumTransaction> qtumTransactions = resultConverter.first;
+    const std::vector<QtumTransaction>& qtumTransactions = contractTxs->first;
     dev::u256 txGas = 0;
-    for(QtumTransaction qtumTransaction : qtumTransactions){
+    for(const QtumTransaction& qtumTransaction : qtumTransactions){
         txGas += qtumTransaction.gas();
         if(txGas > txGasLimit) {
             // Limit the tx gas limit by the soft limit if such a limit has been specified.
@@ -486,26 +637,32 @@ bool BlockAssembler::AttemptToAddContractToBlock(CTxMemPool::txiter iter, uint64
             return false;
         }
     }
+    // Skip the candidates that previously took longer to execute than the time left for contracts
+    int64_t nTimeExecStart = GetTimeMicros();
+    if (nTimeLimit != 0) {
+        int64_t nPredicted = g_contract_exec_times.Predict(qtumTransactions);
+        if (nPredicted > 0 && nTimeExecStart + GetTimeOffset() * 1000000 + nPredicted >= (nTimeLimit - BYTECODE_TIME_BUFFER) * (int64_t)1000000) {
+            return false;
+        }
+    }
+    // Nested in the savepoint of CreateNewBlock, a rejected candidate only rolls back its own changes
+    StateSavepoint savepoint(*globalState);
     // We need to pass the DGP's block gas limit (not the soft limit) since it is consensus critical.
     ByteCodeExec exec(*pblock, qtumTransactions, hardBlockGasLimit, ::ChainActive().Tip());
-    if(!exec.performByteCode()){
-        //error, don't add contract
-        globalState->setRoot(oldHashStateRoot);
-        globalState->setRootUTXO(oldHashUTXORoot);
-        return false;
-    }
-
     ByteCodeExecResult testExecResult;
-    if(!exec.processingResults(testExecResult)){
-        globalState->setRoot(oldHashStateRoot);
-        globalState->setRootUTXO(oldHashUTXORoot);
+    bool fExecuted = exec.performByteCode() && exec.processingResults(testExecResult);
+    int64_t nExecTime = GetTimeMicros() - nTimeExecStart;
+    nContractExecTime += nExecTime;
+    g_contract_exec_times.Add(qtumTransactions, nExecTime);
+    // Keep the measured time on the entry, the mempool evicts the contracts that execute slowly for their gas first
+    mempool.mapTx.modify(iter, update_exec_time(nExecTime));
+    if(!fExecuted){
+        //error, don't add contract
         return false;
     }
 
     if(bceResult.usedGas + testExecResult.usedGas > softBlockGasLimit){
         //if this transaction could cause block gas limit to be exceeded, then don't add it
-        globalState->setRoot(oldHashStateRoot);
-        globalState->setRootUTXO(oldHashUTXORoot);
         return false;
     }
 
@@ -518,35 +675,24 @@ bool BlockAssembler::AttemptToAddContractToBlock(CTxMemPool::txiter iter, uint64
         nBlockSigOpsCost += GetLegacySigOpCount(t);
     }
 
-    int proofTx = pblock->IsProofOfStake() ? 1 : 0;
-
-    //calculate sigops from new refund/proof tx
-
-    //first, subtract old proof tx
-    nBlockSigOpsCost -= GetLegacySigOpCount(*pblock->vtx[proofTx]);
-
-    // manually rebuild refundtx
-    CMutableTransaction contrTx(*pblock->vtx[proofTx]);
-    //note, this will need changed for MPoS
-    int i=contrTx.vout.size();
-    contrTx.vout.resize(contrTx.vout.size()+testExecResult.refundOutputs.size());
-    for(CTxOut& vout : testExecResult.refundOutputs){
-        contrTx.vout[i]=vout;
-        i++;
+    //calculate sigops of the new refund outputs, they are only appended to the refund/proof tx
+    //once the block is finalized by RebuildRefundTransaction, and add up like GetLegacySigOpCount
+    unsigned int nRefundSigOps = 0;
+    for(const CTxOut& vout : testExecResult.refundOutputs){
+        nRefundSigOps += vout.scriptPubKey.GetSigOpCount(false);
     }
-    nBlockSigOpsCost += GetLegacySigOpCount(contrTx);
+    nBlockSigOpsCost += nRefundSigOps;
     //all contract costs now applied to local state
 
     //Check if block will be too big or too expensive with this contract execution
     if (nBlockSigOpsCost * WITNESS_SCALE_FACTOR > (uint64_t)dgpMaxBlockSigOps ||
             nBlockWeight > dgpMaxBlockWeight) {
         //contract will not be added to block, so revert state to before we tried
-        globalState->setRoot(oldHashStateRoot);
-        globalState->setRootUTXO(oldHashUTXORoot);
         return false;
     }
 
     //block is not too big, so apply the contract execution and it's results to the actual block
+    savepoint.Merge();
 
     //apply local bytecode to global bytecode state
     bceResult.usedGas += testExecResult.usedGas;
@@ -569,10 +715,8 @@ bool BlockAssembler::AttemptToAddContractToBlock(CTxMemPool::txiter iter, uint64
         this->nBlockSigOpsCost += GetLegacySigOpCount(t);
         ++nBlockTx;
     }
-    //calculate sigops from new refund/proof tx
-    this->nBlockSigOpsCost -= GetLegacySigOpCount(*pblock->vtx[proofTx]);
-    RebuildRefundTransaction();
-    this->nBlockSigOpsCost += GetLegacySigOpCount(*pblock->vtx[proofTx]);
+    //sigops from the new refund outputs
+    this->nBlockSigOpsCost += nRefundSigOps;
 
     bceResult.valueTransfers.clear();
 
@@ -813,6 +957,17 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
             continue;
         }
 
+        // Test the declared gas before executing any contract of the package, an
+        // ancestor that fits on its own is still considered with its own score
+        if (!TestPackageGas(ancestors, minGasPrice)) {
+            if (fUsingModified) {
+                mapModifiedTx.get<ancestor_score_or_gas_price>().erase(modit);
+                failedTx.insert(iter);
+            }
+            ++nConsecutiveFailed;
+            continue;
+        }
+
         // This transaction will make it in; reset the failed counter.
         nConsecutiveFailed = 0;
 
@@ -928,17 +1083,336 @@ bool CheckStake(const std::shared_ptr<const CBlock> pblock, CWallet& wallet)
     return true;
 }
 
-void ThreadStakeMiner(CWallet *pwallet, CConnman* connman)
+/**
+ * Keeps a block filled with transactions and executed contracts for the next time slot on top of
+ * the tip, built for the coinstake script of the last block the staker signed. Contracts see the
+ * block time and the staker's address, so the block can only be used for a kernel found with that
+ * script and time, and is built again when the tip or the time slot change, and at most once per
+ * STAKER_POLLING_PERIOD when transactions entered the mempool. A kernel that matches only needs
+ * its coinstake and signature.
+ */
+class StakeTemplateBuilder
 {
-    SetThreadPriority(THREAD_PRIORITY_LOWEST);
+public:
+    explicit StakeTemplateBuilder(const std::string& threadName) : m_thread(&StakeTemplateBuilder::ThreadBuild, this, threadName) {}
+    ~StakeTemplateBuilder()
+    {
+        {
+            LOCK(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        m_thread.join();
+    }
 
-    // Make this thread recognisable as the mining thread
-    std::string threadName = "qtumstake";
-    if(pwallet && pwallet->GetName() != "")
+    // Build templates for script, or stop building them when it is empty
+    void SetScript(const CScript& script)
+    {
+        LOCK(m_mutex);
+        if(script != m_script) {
+            m_script = script;
+            m_template.reset();
+        }
+    }
+
+    // Get the template built for script and nTime on top of hashPrevBlock, if there is one
+    std::unique_ptr<CBlockTemplate> Take(const CScript& script, uint32_t nTime, const uint256& hashPrevBlock, int64_t& nTotalFees)
+    {
+        LOCK(m_mutex);
+        if(!m_template || script != m_script || m_template->block.nTime != nTime || m_template->block.hashPrevBlock != hashPrevBlock)
+            return nullptr;
+        nTotalFees = m_fees;
+        return std::move(m_template);
+    }
+
+private:
+    Mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stop GUARDED_BY(m_mutex) = false;
+    CScript m_script GUARDED_BY(m_mutex);
+    std::unique_ptr<CBlockTemplate> m_template GUARDED_BY(m_mutex);
+    int64_t m_fees GUARDED_BY(m_mutex) = 0;
+    std::thread m_thread;
+
+    void ThreadBuild(std::string threadName)
+    {
+        util::ThreadRename(threadName.c_str());
+
+        uint256 hashBuiltTip;
+        uint32_t nBuiltTime = 0;
+        unsigned int nBuiltMempool = 0;
+        int64_t nBuiltAt = 0;
+        CScript builtScript;
+        while(true) {
+            CScript script;
+            {
+                WAIT_LOCK(m_mutex, lock);
+                m_cv.wait_for(lock, std::chrono::milliseconds(STAKE_TEMPLATE_POLLING_PERIOD));
+                if(m_stop)
+                    return;
+                script = m_script;
+            }
+            if(script.empty() || ShutdownRequested())
+                continue;
+
+            uint256 hashTip;
+            uint32_t nTime = GetAdjustedTime() & ~STAKE_TIMESTAMP_MASK;
+            {
+                // the tip is only compared with the one of the last template, the snapshot does without cs_main
+                const CBlockIndex* pindexTip = GetChainTipSnapshot()->tip;
+                if(!pindexTip || ::ChainstateActive().IsInitialBlockDownload())
+                    continue;
+                hashTip = pindexTip->GetBlockHash();
+                // the block time has to be after the tip
+                nTime = std::max(nTime, (pindexTip->nTime & ~STAKE_TIMESTAMP_MASK) + STAKE_TIMESTAMP_MASK + 1);
+            }
+            unsigned int nMempool = mempool.GetTransactionsUpdated();
+            if(script == builtScript && hashTip == hashBuiltTip && nTime == nBuiltTime &&
+               (nMempool == nBuiltMempool || GetTimeMillis() - nBuiltAt < STAKER_POLLING_PERIOD))
+                continue;
+
+            int64_t nFees = 0;
+            std::unique_ptr<CBlockTemplate> pblocktemplate;
+            try {
+                pblocktemplate = BlockAssembler(Params()).CreateNewBlock(script, true, true, &nFees, nTime, FutureDrift(GetAdjustedTime()) - STAKE_TIME_BUFFER);
+            } catch (const std::runtime_error& e) {
+                LogPrintf("StakeTemplateBuilder: %s\n", e.what());
+            }
+            hashBuiltTip = hashTip;
+            nBuiltTime = nTime;
+            nBuiltMempool = nMempool;
+            nBuiltAt = GetTimeMillis();
+            builtScript = script;
+
+            LOCK(m_mutex);
+            if(pblocktemplate && script == m_script && pblocktemplate->block.hashPrevBlock == hashTip) {
+                m_template = std::move(pblocktemplate);
+                m_fees = nFees;
+            }
+        }
+    }
+};
+
+/**
+ * Stakes with every wallet that has staking enabled from one thread. Each round shares one empty
+ * block on one tip, searches the coins of all the wallets over the lookahead and only builds the
+ * block of the wallet with the earliest kernel. A round starts when a new tip is connected, or
+ * nMinerSleep after the last one so that the lookahead follows the time.
+ */
+class StakeScheduler
+{
+public:
+    void Add(CWallet* pwallet, CConnman* connman);
+    // Waits until the running round is done with pwallet, its cs_wallet must not be held
+    void Remove(CWallet* pwallet);
+    bool GetStats(const CWallet* pwallet, StakingStats& stats);
+
+private:
+    Mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<CWallet*> m_wallets GUARDED_BY(m_mutex);
+    // The wallets the running round took coins from
+    std::set<CWallet*> m_round GUARDED_BY(m_mutex);
+    CConnman* m_connman GUARDED_BY(m_mutex) = nullptr;
+    std::unique_ptr<boost::thread_group> m_thread GUARDED_BY(m_mutex);
+    std::map<const CWallet*, StakingStats> m_stats GUARDED_BY(m_mutex);
+
+    bool IsStaking(CWallet* pwallet);
+    void UpdateStats(const CWallet* pwallet, const std::function<void(StakingStats&)>& update);
+    void EndRound();
+    void ThreadStake();
+    void StakeBlock(CWallet* pwallet, const std::set<std::pair<const CWalletTx*,unsigned int> >& setCoins, CBlockTemplate& blocktemplate, int64_t nTotalFees,
+                    CBlockIndex* pindexPrev, uint32_t kernelTime, uint32_t endTime, StakeTemplateBuilder& templateBuilder);
+};
+
+static StakeScheduler g_stake_scheduler;
+
+void StakeScheduler::Add(CWallet* pwallet, CConnman* connman)
+{
+    LOCK(m_mutex);
+    if(connman)
+        m_connman = connman;
+    if(std::find(m_wallets.begin(), m_wallets.end(), pwallet) == m_wallets.end())
+        m_wallets.push_back(pwallet);
+    if(!m_thread)
+    {
+        m_thread.reset(new boost::thread_group());
+        m_thread->create_thread(boost::bind(&StakeScheduler::ThreadStake, this));
+    }
+}
+
+void StakeScheduler::Remove(CWallet* pwallet)
+{
+    AssertLockNotHeld(pwallet->cs_wallet);
+
+    std::unique_ptr<boost::thread_group> thread;
+    {
+        WAIT_LOCK(m_mutex, lock);
+        m_wallets.erase(std::remove(m_wallets.begin(), m_wallets.end(), pwallet), m_wallets.end());
+        m_cv.wait(lock, [&]{ return m_round.count(pwallet) == 0; });
+        m_stats.erase(pwallet);
+        if(m_wallets.empty())
+            thread = std::move(m_thread);
+    }
+    if(thread)
+    {
+        thread->interrupt_all();
+        thread->join_all();
+    }
+}
+
+bool StakeScheduler::IsStaking(CWallet* pwallet)
+{
+    LOCK(m_mutex);
+    return std::find(m_wallets.begin(), m_wallets.end(), pwallet) != m_wallets.end();
+}
+
+bool StakeScheduler::GetStats(const CWallet* pwallet, StakingStats& stats)
+{
+    LOCK(m_mutex);
+    if(std::find(m_wallets.begin(), m_wallets.end(), pwallet) == m_wallets.end())
+        return false;
+    stats = m_stats[pwallet];
+    return true;
+}
+
+void StakeScheduler::UpdateStats(const CWallet* pwallet, const std::function<void(StakingStats&)>& update)
+{
+    LOCK(m_mutex);
+    update(m_stats[pwallet]);
+}
+
+void StakeScheduler::EndRound()
+{
     {
-        threadName = threadName + "-" + pwallet->GetName();
+        LOCK(m_mutex);
+        m_round.clear();
+    }
+    m_cv.notify_all();
+}
+
+void StakeScheduler::StakeBlock(CWallet* pwallet, const std::set<std::pair<const CWalletTx*,unsigned int> >& setCoins, CBlockTemplate& blocktemplate, int64_t nTotalFees,
+                                CBlockIndex* pindexPrev, uint32_t kernelTime, uint32_t endTime, StakeTemplateBuilder& templateBuilder)
+{
+    for(uint32_t i=kernelTime;i<endTime;i+=STAKE_TIMESTAMP_MASK+1) {
+
+        // The information is needed for status bar to determine if the staker is trying to create block and when it will be created approximately,
+        if(pwallet->m_last_coin_stake_search_time == 0) pwallet->m_last_coin_stake_search_time = GetAdjustedTime(); // startup timestamp
+        // nLastCoinStakeSearchInterval > 0 mean that the staker is running
+        pwallet->m_last_coin_stake_search_interval = i - pwallet->m_last_coin_stake_search_time;
+
+        // Try to sign a block (this also checks for a PoS stake)
+        blocktemplate.block.nTime = i;
+        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>(blocktemplate.block);
+        if (SignBlock(pblock, *pwallet, nTotalFees, i, setCoins)) {
+            // increase priority so we can build the full PoS block ASAP to ensure the timestamp doesn't expire
+            SetThreadPriority(THREAD_PRIORITY_ABOVE_NORMAL);
+            // and keep the database compactions off the disk while the block is built and submitted
+            DBPriorityScope dbPriority(DB_STAKE_MAX_DEFER);
+            int64_t nTimeKernel = GetTimeMicros();
+            UpdateStats(pwallet, [](StakingStats& stats) { stats.nKernels++; });
+
+            if (::ChainActive().Tip()->GetBlockHash() != pblock->hashPrevBlock) {
+                //another block was received while building ours, scrap progress
+                LogPrintf("ThreadStakeMiner(): Valid future PoS block was orphaned before becoming valid");
+                UpdateStats(pwallet, [](StakingStats& stats) { stats.nOrphaned++; });
+                break;
+            }
+            // Use the block kept filled in the background when it was built for this kernel,
+            // otherwise create a block that's properly populated with transactions
+            const CScript& scriptPubKeyStake = pblock->vtx[1]->vout[1].scriptPubKey;
+            std::unique_ptr<CBlockTemplate> pblocktemplatefilled = templateBuilder.Take(scriptPubKeyStake, i, pblock->hashPrevBlock, nTotalFees);
+            if (pblocktemplatefilled) {
+                UpdateStats(pwallet, [](StakingStats& stats) { stats.nWarmTemplates++; });
+            } else {
+                BlockAssembler assembler(Params());
+                int64_t nTimeCreate = GetTimeMicros();
+                pblocktemplatefilled = assembler.CreateNewBlock(scriptPubKeyStake, true, true, &nTotalFees,
+                                                                i, FutureDrift(GetAdjustedTime()) - STAKE_TIME_BUFFER);
+                nTimeCreate = GetTimeMicros() - nTimeCreate;
+                int64_t nTimeContracts = assembler.nContractExecTime;
+                UpdateStats(pwallet, [&](StakingStats& stats) {
+                    stats.createBlock.Add(nTimeCreate);
+                    stats.contractExec.Add(nTimeContracts);
+                });
+            }
+            templateBuilder.SetScript(scriptPubKeyStake);
+            if (!pblocktemplatefilled.get())
+                break;
+            if (::ChainActive().Tip()->GetBlockHash() != pblock->hashPrevBlock) {
+                //another block was received while building ours, scrap progress
+                LogPrintf("ThreadStakeMiner(): Valid future PoS block was orphaned before becoming valid");
+                UpdateStats(pwallet, [](StakingStats& stats) { stats.nOrphaned++; });
+                break;
+            }
+            // Sign the full block and use the timestamp from earlier for a valid stake
+            std::shared_ptr<CBlock> pblockfilled = std::make_shared<CBlock>(pblocktemplatefilled->block);
+            if (SignBlock(pblockfilled, *pwallet, nTotalFees, i, setCoins)) {
+                // Should always reach here unless we spent too much time processing transactions and the timestamp is now invalid
+                // CheckStake also does CheckBlock and AcceptBlock to propogate it to the network
+                bool validBlock = false;
+                while(!validBlock) {
+                    if (::ChainActive().Tip()->GetBlockHash() != pblockfilled->hashPrevBlock) {
+                        //another block was received while building ours, scrap progress
+                        LogPrintf("ThreadStakeMiner(): Valid future PoS block was orphaned before becoming valid");
+                        UpdateStats(pwallet, [](StakingStats& stats) { stats.nOrphaned++; });
+                        break;
+                    }
+                    //check timestamps
+                    if (pblockfilled->GetBlockTime() <= pindexPrev->GetBlockTime() ||
+                        FutureDrift(pblockfilled->GetBlockTime()) < pindexPrev->GetBlockTime()) {
+                        LogPrintf("ThreadStakeMiner(): Valid PoS block took too long to create and has expired");
+                        UpdateStats(pwallet, [](StakingStats& stats) { stats.nExpired++; });
+                        break; //timestamp too late, so ignore
+                    }
+                    if (!IsStaking(pwallet)) {
+                        //the wallet stopped staking, its coins can not be used any more
+                        break;
+                    }
+                    if (pblockfilled->GetBlockTime() > FutureDrift(GetAdjustedTime())) {
+                        if (gArgs.IsArgSet("-aggressive-staking")) {
+                            //if being agressive, then check more often to publish immediately when valid. This might allow you to find more blocks, 
+                            //but also increases the chance of broadcasting invalid blocks and getting DoS banned by nodes,
+                            //or receiving more stale/orphan blocks than normal. Use at your own risk.
+                            MilliSleep(100);
+                        }else{
+                            //too early, so wait 3 seconds and try again
+                            MilliSleep(3000);
+                        }
+                        continue;
+                    }
+                    validBlock=true;
+                }
+                if(validBlock) {
+                    int64_t nTimeToStake = GetTimeMicros() - nTimeKernel;
+                    bool fStaked = CheckStake(pblockfilled, *pwallet);
+                    UpdateStats(pwallet, [&](StakingStats& stats) {
+                        stats.kernelToStake.Add(nTimeToStake);
+                        if (fStaked)
+                            stats.nStaked++;
+                        else
+                            stats.nRejected++;
+                    });
+                    // Update the search time when new valid block is created, needed for status bar icon
+                    pwallet->m_last_coin_stake_search_time = pblockfilled->GetBlockTime();
+                }
+                break;
+            }
+            //return back to low priority
+            SetThreadPriority(THREAD_PRIORITY_LOWEST);
+        }
     }
-    util::ThreadRename(threadName.c_str());
+    SetThreadPriority(THREAD_PRIORITY_LOWEST);
+}
+
+void StakeScheduler::ThreadStake()
+{
+    SetThreadPriority(THREAD_PRIORITY_LOWEST);
+
+    // Make this thread recognisable as the mining thread
+    util::ThreadRename("qtumstake");
+
+    StakeTemplateBuilder templateBuilder("qtumstake-tmpl");
 
     bool fTryToSync = true;
     bool regtestMode = Params().MineBlocksOnDemand();
@@ -948,142 +1422,154 @@ void ThreadStakeMiner(CWallet *pwallet, CConnman* connman)
 
     while (true)
     {
-        while (pwallet->IsLocked() || !pwallet->m_enabled_staking)
+        uint256 hashBestBlock;
+        {
+            LOCK(g_best_block_mutex);
+            hashBestBlock = g_best_block;
+        }
+        CConnman* connman;
         {
-            pwallet->m_last_coin_stake_search_interval = 0;
-            MilliSleep(10000);
+            LOCK(m_mutex);
+            connman = m_connman;
         }
         //don't disable PoS mining for no connections if in regtest mode
         if(!regtestMode && !gArgs.GetBoolArg("-emergencystaking", false)) {
-            while (connman->GetNodeCount(CConnman::CONNECTIONS_ALL) == 0 || ::ChainstateActive().IsInitialBlockDownload()) {
-                pwallet->m_last_coin_stake_search_interval = 0;
+            if (connman->GetNodeCount(CConnman::CONNECTIONS_ALL) == 0 || ::ChainstateActive().IsInitialBlockDownload()) {
+                {
+                    LOCK(m_mutex);
+                    for (CWallet* pwallet : m_wallets)
+                        pwallet->m_last_coin_stake_search_interval = 0;
+                }
                 fTryToSync = true;
                 MilliSleep(1000);
+                continue;
             }
             if (fTryToSync) {
                 fTryToSync = false;
                 if (connman->GetNodeCount(CConnman::CONNECTIONS_ALL) < 3 ||
-                	::ChainActive().Tip()->GetBlockTime() < GetTime() - 10 * 60) {
+                    GetChainTipSnapshot()->tip->GetBlockTime() < GetTime() - 10 * 60) {
                     MilliSleep(60000);
                     continue;
                 }
             }
         }
-        //
-        // Create new block
-        //
-        CAmount nBalance = pwallet->GetBalance().m_mine_trusted;
-        CAmount nTargetValue = nBalance - pwallet->m_reserve_balance;
-        CAmount nValueIn = 0;
-        std::set<std::pair<const CWalletTx*,unsigned int> > setCoins;
-        int64_t start = GetAdjustedTime();
-        {
-            auto locked_chain = pwallet->chain().lock();
-            LOCK(pwallet->cs_wallet);
-            pwallet->SelectCoinsForStaking(*locked_chain, nTargetValue, setCoins, nValueIn);
-        }
-        if(setCoins.size() > 0)
         {
+            // Removed wallets wait until the round is done with their coins
+            struct RoundGuard {
+                StakeScheduler& scheduler;
+                ~RoundGuard() { scheduler.EndRound(); }
+            } roundGuard{*this};
+
+            std::vector<CWallet*> wallets;
+            {
+                LOCK(m_mutex);
+                for (CWallet* pwallet : m_wallets)
+                {
+                    if (pwallet->IsLocked() || !pwallet->m_enabled_staking) {
+                        pwallet->m_last_coin_stake_search_interval = 0;
+                        continue;
+                    }
+                    wallets.push_back(pwallet);
+                    m_round.insert(pwallet);
+                }
+            }
+            if (wallets.empty()) {
+                templateBuilder.SetScript(CScript());
+                MilliSleep(10000);
+                continue;
+            }
+            //
+            // Create new block
+            //
             int64_t nTotalFees = 0;
-            // First just create an empty block. No need to process transactions until we know we can create a block
+            // First just create an empty block shared by the wallets. No need to process transactions until we know we can create a block
             std::unique_ptr<CBlockTemplate> pblocktemplate(BlockAssembler(Params()).CreateEmptyBlock(CScript(), true, true, &nTotalFees));
             if (!pblocktemplate.get())
                 return;
-            CBlockIndex* pindexPrev =  ::ChainActive().Tip();
+            CBlockIndex* pindexPrev;
+            {
+                LOCK(cs_main);
+                pindexPrev = LookupBlockIndex(pblocktemplate->block.hashPrevBlock);
+            }
 
             uint32_t beginningTime=GetAdjustedTime();
             beginningTime &= ~STAKE_TIMESTAMP_MASK;
-            for(uint32_t i=beginningTime;i<beginningTime + MAX_STAKE_LOOKAHEAD;i+=STAKE_TIMESTAMP_MASK+1) {
-
-                // The information is needed for status bar to determine if the staker is trying to create block and when it will be created approximately,
-                if(pwallet->m_last_coin_stake_search_time == 0) pwallet->m_last_coin_stake_search_time = GetAdjustedTime(); // startup timestamp
-                // nLastCoinStakeSearchInterval > 0 mean that the staker is running
-                pwallet->m_last_coin_stake_search_interval = i - pwallet->m_last_coin_stake_search_time;
-
-                // Try to sign a block (this also checks for a PoS stake)
-                pblocktemplate->block.nTime = i;
-                std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>(pblocktemplate->block);
-                if (SignBlock(pblock, *pwallet, nTotalFees, i, setCoins)) {
-                    // increase priority so we can build the full PoS block ASAP to ensure the timestamp doesn't expire
-                    SetThreadPriority(THREAD_PRIORITY_ABOVE_NORMAL);
-
-                    if (::ChainActive().Tip()->GetBlockHash() != pblock->hashPrevBlock) {
-                        //another block was received while building ours, scrap progress
-                        LogPrintf("ThreadStakeMiner(): Valid future PoS block was orphaned before becoming valid");
-                        break;
-                    }
-                    // Create a block that's properly populated with transactions
-                    std::unique_ptr<CBlockTemplate> pblocktemplatefilled(
-                            BlockAssembler(Params()).CreateNewBlock(pblock->vtx[1]->vout[1].scriptPubKey, true, true, &nTotalFees,
-                                                                    i, FutureDrift(GetAdjustedTime()) - STAKE_TIME_BUFFER));
-                    if (!pblocktemplatefilled.get())
-                        return;
-                    if (::ChainActive().Tip()->GetBlockHash() != pblock->hashPrevBlock) {
-                        //another block was received while building ours, scrap progress
-                        LogPrintf("ThreadStakeMiner(): Valid future PoS block was orphaned before becoming valid");
-                        break;
-                    }
-                    // Sign the full block and use the timestamp from earlier for a valid stake
-                    std::shared_ptr<CBlock> pblockfilled = std::make_shared<CBlock>(pblocktemplatefilled->block);
-                    if (SignBlock(pblockfilled, *pwallet, nTotalFees, i, setCoins)) {
-                        // Should always reach here unless we spent too much time processing transactions and the timestamp is now invalid
-                        // CheckStake also does CheckBlock and AcceptBlock to propogate it to the network
-                        bool validBlock = false;
-                        while(!validBlock) {
-                            if (::ChainActive().Tip()->GetBlockHash() != pblockfilled->hashPrevBlock) {
-                                //another block was received while building ours, scrap progress
-                                LogPrintf("ThreadStakeMiner(): Valid future PoS block was orphaned before becoming valid");
-                                break;
-                            }
-                            //check timestamps
-                            if (pblockfilled->GetBlockTime() <= pindexPrev->GetBlockTime() ||
-                                FutureDrift(pblockfilled->GetBlockTime()) < pindexPrev->GetBlockTime()) {
-                                LogPrintf("ThreadStakeMiner(): Valid PoS block took too long to create and has expired");
-                                break; //timestamp too late, so ignore
-                            }
-                            if (pblockfilled->GetBlockTime() > FutureDrift(GetAdjustedTime())) {
-                                if (gArgs.IsArgSet("-aggressive-staking")) {
-                                    //if being agressive, then check more often to publish immediately when valid. This might allow you to find more blocks, 
-                                    //but also increases the chance of broadcasting invalid blocks and getting DoS banned by nodes,
-                                    //or receiving more stale/orphan blocks than normal. Use at your own risk.
-                                    MilliSleep(100);
-                                }else{
-                                    //too early, so wait 3 seconds and try again
-                                    MilliSleep(3000);
-                                }
-                                continue;
-                            }
-                            validBlock=true;
-                        }
-                        if(validBlock) {
-                            CheckStake(pblockfilled, *pwallet);
-                            // Update the search time when new valid block is created, needed for status bar icon
-                            pwallet->m_last_coin_stake_search_time = pblockfilled->GetBlockTime();
-                        }
-                        break;
-                    }
-                    //return back to low priority
-                    SetThreadPriority(THREAD_PRIORITY_LOWEST);
+            uint32_t endTime = beginningTime + MAX_STAKE_LOOKAHEAD;
+
+            // Search the coins of every wallet over the whole lookahead, only the wallet with the earliest kernel builds a coinstake.
+            // The search of the next wallets stops before the earliest kernel found so far.
+            CWallet* pwalletKernel = nullptr;
+            std::set<std::pair<const CWalletTx*,unsigned int> > setCoinsKernel;
+            uint32_t kernelTime = endTime;
+            for (CWallet* pwallet : wallets)
+            {
+                CAmount nBalance = pwallet->GetBalance().m_mine_trusted;
+                CAmount nTargetValue = nBalance - pwallet->m_reserve_balance;
+                CAmount nValueIn = 0;
+                std::set<std::pair<const CWalletTx*,unsigned int> > setCoins;
+                COutPoint prevout;
+                uint32_t nTime = 0;
+                bool fKernel = false;
+                {
+                    auto locked_chain = pwallet->chain().lock();
+                    LOCK(pwallet->cs_wallet);
+                    pwallet->SelectCoinsForStaking(*locked_chain, nTargetValue, setCoins, nValueIn);
+                    std::vector<COutPoint> prevouts;
+                    prevouts.reserve(setCoins.size());
+                    for(const std::pair<const CWalletTx*,unsigned int> &pcoin : setCoins)
+                        prevouts.emplace_back(pcoin.first->GetHash(), pcoin.second);
+                    fKernel = !prevouts.empty() && FindStakeKernel(pindexPrev, pblocktemplate->block.nBits, beginningTime, kernelTime, prevouts,
+                                                                   ::ChainstateActive().CoinsTip(), pwallet->stakeCache, prevout, nTime);
+                }
+                if (!setCoins.empty()) {
+                    if(pwallet->m_last_coin_stake_search_time == 0) pwallet->m_last_coin_stake_search_time = GetAdjustedTime(); // startup timestamp
+                    pwallet->m_last_coin_stake_search_interval = endTime - (STAKE_TIMESTAMP_MASK+1) - pwallet->m_last_coin_stake_search_time;
+                }
+                if (fKernel) {
+                    pwalletKernel = pwallet;
+                    setCoinsKernel = std::move(setCoins);
+                    kernelTime = nTime;
                 }
             }
+
+            if (pwalletKernel)
+                StakeBlock(pwalletKernel, setCoinsKernel, *pblocktemplate, nTotalFees, pindexPrev, kernelTime, endTime, templateBuilder);
+        }
+
+        // Start the next round on a new tip, or when the lookahead moved on
+        int64_t nNextRound = GetTimeMillis() + nMinerSleep;
+        while (GetTimeMillis() < nNextRound)
+        {
+            boost::this_thread::interruption_point();
+            WAIT_LOCK(g_best_block_mutex, lock);
+            if (g_best_block != hashBestBlock)
+                break;
+            g_best_block_cv.wait_for(lock, std::chrono::milliseconds(STAKE_TEMPLATE_POLLING_PERIOD));
         }
-        MilliSleep(nMinerSleep);
     }
 }
 
-void StakeQtums(bool fStake, CWallet *pwallet, CConnman* connman, boost::thread_group*& stakeThread)
+void StakingLatency::Add(int64_t nMicros)
 {
-    if (stakeThread != nullptr)
-    {
-        stakeThread->interrupt_all();
-        delete stakeThread;
-        stakeThread = nullptr;
-    }
+    nCount++;
+    nTotal += nMicros;
+    nMax = std::max(nMax, nMicros);
+    size_t nBucket = 0;
+    while (nBucket < STAKING_LATENCY_BUCKET_COUNT - 1 && nMicros > STAKING_LATENCY_BUCKETS[nBucket] * 1000)
+        nBucket++;
+    nBuckets[nBucket]++;
+}
 
+bool GetStakingStats(const CWallet* pwallet, StakingStats& stats)
+{
+    return g_stake_scheduler.GetStats(pwallet, stats);
+}
+
+void StakeQtums(bool fStake, CWallet *pwallet, CConnman* connman)
+{
     if(fStake)
-    {
-        stakeThread = new boost::thread_group();
-        stakeThread->create_thread(boost::bind(&ThreadStakeMiner, pwallet, connman));
-    }
+        g_stake_scheduler.Add(pwallet, connman);
+    else
+        g_stake_scheduler.Remove(pwallet);
 }
 #endif
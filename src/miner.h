@@ -8,11 +8,14 @@
 
 #include <optional.h>
 #include <primitives/block.h>
+#include <sync.h>
 #include <txmempool.h>
 #include <validation.h>
 
+#include <map>
 #include <memory>
 #include <stdint.h>
+#include <utility>
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
@@ -51,6 +54,16 @@ static const int32_t STAKE_TIME_BUFFER = 2;
 //Note this is overridden for regtest mode
 static const int32_t STAKER_POLLING_PERIOD = 5000;
 
+//How often the warm staking template checks the tip, mempool and time slot in milliseconds
+static const int32_t STAKE_TEMPLATE_POLLING_PERIOD = 100;
+
+//Most contract and selector pairs whose execution time is remembered by the block assembler
+static const size_t MAX_CONTRACT_EXEC_TIMES = 10000;
+
+//How often getblocktemplate assembles its template from scratch in seconds, in between, the
+//transactions that enter the mempool are added to the template it already has
+static const int64_t BLOCK_TEMPLATE_REBUILD_INTERVAL = 60;
+
 //How much time to spend trying to process transactions when using the generate RPC call
 static const int32_t POW_MINER_MAX_TIME = 60;
 
@@ -252,6 +265,8 @@ public:
     uint64_t hardBlockGasLimit;
     uint64_t softBlockGasLimit;
     uint64_t txGasLimit;
+    // Microseconds spent executing the contracts tried for the block
+    int64_t nContractExecTime = 0;
 /////////////////////////////////////////////
 
     // The original constructed reward tx (either coinbase or coinstake) without gas refund adjustments
@@ -262,6 +277,10 @@ public:
 
     /** Construct a new block template with coinbase to scriptPubKeyIn */
     std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx=true, bool fProofOfStake=false, int64_t* pTotalFees = 0, int32_t nTime=0, int32_t nTimeLimit=0);
+    /** Add the mempool transactions that arrived since CreateNewBlock returned the template of this
+     *  assembler. Returns false when the tip changed or a transaction of the template left the
+     *  mempool, the template then has to be created again. The template is given back either way. */
+    bool UpdateNewBlock(std::unique_ptr<CBlockTemplate>& blocktemplate);
     std::unique_ptr<CBlockTemplate> CreateEmptyBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx=true, bool fProofOfStake=false, int64_t* pTotalFees = 0, int32_t nTime=0);
 
     static Optional<int64_t> m_last_block_num_txs;
@@ -274,7 +293,7 @@ private:
     /** Add a tx to the block */
     void AddToBlock(CTxMemPool::txiter iter);
 
-    bool AttemptToAddContractToBlock(CTxMemPool::txiter iter, uint64_t minGasPrice);
+    bool AttemptToAddContractToBlock(CTxMemPool::txiter iter, uint64_t minGasPrice) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
 
     // Methods for how to add transactions to a block.
     /** Add transactions based on feerate including unconfirmed ancestors
@@ -294,6 +313,10 @@ private:
       * These checks should always succeed, and they're here
       * only as an extra check in case of suboptimal node configuration */
     bool TestPackageTransactions(const CTxMemPool::setEntries& package);
+    /** Test the declared gas of the contract transactions in a package against the
+      * gas still left in the block, the same limits AttemptToAddContractToBlock
+      * enforces, so a package that cannot fit is skipped before anything runs */
+    bool TestPackageGas(const CTxMemPool::setEntries& package, uint64_t minGasPrice) const;
     /** Return true if given transaction from mapTx has already been evaluated,
       * or if the transaction's cached data in mapTx is incorrect. */
     bool SkipMapTxEntry(CTxMemPool::txiter it, indexed_modified_transaction_set &mapModifiedTx, CTxMemPool::setEntries &failedTx) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
@@ -308,9 +331,87 @@ private:
     void AddCoinstakeContracts(CMutableTransaction* coinstakeTx);
 };
 
+/** Execution time of the calls to a contract with one selector, in microseconds */
+struct ContractExecTime
+{
+    uint64_t nCount = 0;
+    // Moving average over the last executions
+    int64_t nAverage = 0;
+    int64_t nMax = 0;
+    // Last time the calls were executed, to evict the entries not seen for the longest
+    int64_t nLastTime = 0;
+};
+
+/**
+ * Execution times of the contract calls executed by the block assembler, by contract
+ * address and by the selector in the first 4 bytes of the call data. Contract creations
+ * are kept under the null address. It predicts how long a candidate takes to execute,
+ * so the ones that would run past the contract deadline of the block are skipped.
+ */
+class ContractExecTimes
+{
+public:
+    using Key = std::pair<dev::Address, uint32_t>;
+
+    /** Predicted execution time of the contract transactions of a tx in microseconds, 0 when none of the calls was seen yet */
+    int64_t Predict(const std::vector<QtumTransaction>& txs) const;
+
+    /** Record the time the contract transactions of a tx took to execute together */
+    void Add(const std::vector<QtumTransaction>& txs, int64_t nMicros);
+
+    std::map<Key, ContractExecTime> GetAll() const;
+
+    static Key GetKey(const QtumTransaction& tx);
+
+private:
+    mutable Mutex m_mutex;
+    std::map<Key, ContractExecTime> m_times GUARDED_BY(m_mutex);
+};
+
+extern ContractExecTimes g_contract_exec_times;
+
 #ifdef ENABLE_WALLET
-/** Generate a new block, without valid proof-of-work */
-void StakeQtums(bool fStake, CWallet *pwallet, CConnman* connman, boost::thread_group*& stakeThread);
+/** Upper bounds in milliseconds of the staking latency buckets, the longer ones are counted in one more bucket */
+static const int64_t STAKING_LATENCY_BUCKETS[] = {10, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000};
+static const size_t STAKING_LATENCY_BUCKET_COUNT = sizeof(STAKING_LATENCY_BUCKETS) / sizeof(STAKING_LATENCY_BUCKETS[0]) + 1;
+
+struct StakingLatency
+{
+    uint64_t nCount = 0;
+    // Microseconds
+    int64_t nTotal = 0;
+    int64_t nMax = 0;
+    uint64_t nBuckets[STAKING_LATENCY_BUCKET_COUNT] = {};
+
+    void Add(int64_t nMicros);
+};
+
+/** Counters of the blocks staked with a wallet since it started staking */
+struct StakingStats
+{
+    // Kernels that signed a block
+    uint64_t nKernels = 0;
+    // Blocks accepted or refused by CheckStake
+    uint64_t nStaked = 0;
+    uint64_t nRejected = 0;
+    // Blocks that took too long to create and expired
+    uint64_t nExpired = 0;
+    // Blocks orphaned by another block before their time was valid
+    uint64_t nOrphaned = 0;
+    // Blocks filled from the template kept warm in the background
+    uint64_t nWarmTemplates = 0;
+    // From the kernel signing a block to CheckStake
+    StakingLatency kernelToStake;
+    // CreateNewBlock of the filled block, and the contract execution within it
+    StakingLatency createBlock;
+    StakingLatency contractExec;
+};
+
+/** Get the staking counters of the wallet, false when it is not staking */
+bool GetStakingStats(const CWallet* pwallet, StakingStats& stats);
+
+/** Start or stop staking with the wallet, all the wallets stake from one thread */
+void StakeQtums(bool fStake, CWallet *pwallet, CConnman* connman);
 #endif
 
 /** Modify the extranonce in a block */
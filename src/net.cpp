@@ -16,6 +16,7 @@
 #include <crypto/common.h>
 #include <crypto/sha256.h>
 #include <netbase.h>
+#include <netcompression.h>
 #include <net_permissions.h>
 #include <primitives/transaction.h>
 #include <scheduler.h>
@@ -27,12 +28,17 @@
 #include <string.h>
 #else
 #include <fcntl.h>
+#include <sys/uio.h>
 #endif
 
 #ifdef USE_POLL
 #include <poll.h>
 #endif
 
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/miniwget.h>
@@ -56,6 +62,9 @@ static constexpr int DNSSEEDS_TO_QUERY_AT_ONCE = 3;
 // We add a random period time (0 to 1 seconds) to feeler connections to prevent synchronization.
 #define FEELER_SLEEP_WINDOW 1
 
+/** Most queued buffers handed to a single sendmsg call */
+static const size_t SEND_IOV_MAX = 64;
+
 // MSG_NOSIGNAL is not available on some platforms, if it doesn't exist define it as 0
 #if !defined(MSG_NOSIGNAL)
 #define MSG_NOSIGNAL 0
@@ -462,6 +471,17 @@ void CNode::CloseSocketDisconnect()
     }
 }
 
+bool CNode::HasBlockMessageNext()
+{
+    if (!vRecvGetData.empty() || !orphan_work_set.empty())
+        return false;
+    LOCK(cs_vProcessMsg);
+    if (vProcessMsg.empty())
+        return false;
+    const std::string command = vProcessMsg.front().hdr.GetCommand();
+    return command == NetMsgType::BLOCK || command == NetMsgType::CMPCTBLOCK || command == NetMsgType::BLOCKTXN;
+}
+
 void CConnman::AddWhitelistPermissionFlags(NetPermissionFlags& flags, const CNetAddr &addr) const {
     for (const auto& subnet : vWhitelistedRange) {
         if (subnet.m_subnet.Match(addr)) NetPermissions::AddFlag(flags, subnet.m_flags);
@@ -533,6 +553,12 @@ void CNode::copyStats(CNodeStats &stats)
     }
     X(m_legacyWhitelisted);
     X(m_permissionFlags);
+    X(nHistoricalBlockBytes);
+    X(nHistoricalBlockDeferrals);
+    X(nCompressedBytesSent);
+    X(nCompressedRawBytesSent);
+    X(nCompressedBytesRecv);
+    X(nCompressedRawBytesRecv);
     if (m_tx_relay != nullptr) {
         LOCK(m_tx_relay->cs_feeFilter);
         stats.minFeeFilter = m_tx_relay->minFeeFilter;
@@ -688,6 +714,24 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
     return nCopy;
 }
 
+void BlockServeBucket::Refill(int64_t nRate, int64_t nBurst, int64_t nTimeMicros)
+{
+    if (nLastRefill == 0) {
+        nTokens = nBurst;
+    } else if (nTimeMicros > nLastRefill) {
+        const int64_t nElapsed = nTimeMicros - nLastRefill;
+        // a long idle time fills the bucket without multiplying it by the rate
+        if (nElapsed / 1000000 > (nBurst - nTokens) / nRate) {
+            nTokens = nBurst;
+        } else {
+            nTokens = std::min(nBurst, nTokens + nElapsed * nRate / 1000000);
+        }
+    } else {
+        return;
+    }
+    nLastRefill = nTimeMicros;
+}
+
 const uint256& CNetMessage::GetMessageHash() const
 {
     assert(complete());
@@ -702,27 +746,57 @@ size_t CConnman::SocketSendData(CNode *pnode) const EXCLUSIVE_LOCKS_REQUIRED(pno
     size_t nSentSize = 0;
 
     while (it != pnode->vSendMsg.end()) {
-        const auto &data = *it;
-        assert(data.size() > pnode->nSendOffset);
+        assert((*it)->size() > pnode->nSendOffset);
         int nBytes = 0;
+        size_t nToSend = 0;
+#ifndef WIN32
+        // Hand the queued buffers to the kernel in one call
+        struct iovec iov[SEND_IOV_MAX];
+        size_t nIov = 0;
+        for (auto it_iov = it; it_iov != pnode->vSendMsg.end() && nIov < SEND_IOV_MAX; ++it_iov, ++nIov) {
+            const size_t nOffset = nIov == 0 ? pnode->nSendOffset : 0;
+            iov[nIov].iov_base = const_cast<unsigned char*>((*it_iov)->data()) + nOffset;
+            iov[nIov].iov_len = (*it_iov)->size() - nOffset;
+            nToSend += iov[nIov].iov_len;
+        }
+        struct msghdr msg = {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = nIov;
         {
             LOCK(pnode->cs_hSocket);
             if (pnode->hSocket == INVALID_SOCKET)
                 break;
-            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(data.data()) + pnode->nSendOffset, data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+            nBytes = sendmsg(pnode->hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
         }
+#else
+        const auto &data = **it;
+        nToSend = data.size() - pnode->nSendOffset;
+        {
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                break;
+            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(data.data()) + pnode->nSendOffset, nToSend, MSG_NOSIGNAL | MSG_DONTWAIT);
+        }
+#endif
         if (nBytes > 0) {
             pnode->nLastSend = GetSystemTimeInSeconds();
             pnode->nSendBytes += nBytes;
-            pnode->nSendOffset += nBytes;
             nSentSize += nBytes;
-            if (pnode->nSendOffset == data.size()) {
+            size_t nLeft = nBytes;
+            while (nLeft > 0) {
+                const size_t nRemaining = (*it)->size() - pnode->nSendOffset;
+                if (nLeft < nRemaining) {
+                    pnode->nSendOffset += nLeft;
+                    break;
+                }
+                nLeft -= nRemaining;
                 pnode->nSendOffset = 0;
-                pnode->nSendSize -= data.size();
+                pnode->nSendSize -= (*it)->size();
                 pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
                 it++;
-            } else {
-                // could not send full message; stop sending more
+            }
+            if ((size_t)nBytes < nToSend) {
+                // could not send everything; stop sending more
                 break;
             }
         } else {
@@ -1115,7 +1189,7 @@ void CConnman::InactivityCheck(CNode *pnode)
     }
 }
 
-bool CConnman::GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set)
+bool CConnman::GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set, std::map<SOCKET, NodeId>* socket_owners)
 {
     for (const ListenSocket& hListenSocket : vhListenSocket) {
         recv_set.insert(hListenSocket.socket);
@@ -1148,6 +1222,7 @@ bool CConnman::GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &s
                 continue;
 
             error_set.insert(pnode->hSocket);
+            if (socket_owners) (*socket_owners)[pnode->hSocket] = pnode->GetId();
             if (select_send) {
                 send_set.insert(pnode->hSocket);
                 continue;
@@ -1279,10 +1354,86 @@ void CConnman::SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_s
 }
 #endif
 
+#ifdef USE_EPOLL
+bool CConnman::SocketEventsEpoll(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set)
+{
+    if (m_epoll_fd == -1) {
+        m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (m_epoll_fd == -1) {
+            LogPrintf("epoll_create1 failed with error %s, using poll\n", NetworkErrorString(errno));
+            m_epoll_fd = -2;
+        }
+    }
+    if (m_epoll_fd < 0) return false;
+
+    std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
+    std::map<SOCKET, NodeId> socket_owners;
+    if (!GenerateSelectSet(recv_select_set, send_select_set, error_select_set, &socket_owners)) {
+        interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
+        return true;
+    }
+
+    // Every peer socket is in the error set, errors and hangups are reported whatever events it is
+    // registered for. Listening sockets have no owner.
+    std::map<SOCKET, std::pair<NodeId, uint32_t>> wanted;
+    for (SOCKET socket_id : error_select_set) wanted[socket_id] = std::make_pair(socket_owners[socket_id], 0u);
+    for (SOCKET socket_id : recv_select_set) wanted.emplace(socket_id, std::make_pair(NodeId(-1), 0u)).first->second.second |= EPOLLIN;
+    for (SOCKET socket_id : send_select_set) wanted[socket_id].second |= EPOLLOUT;
+
+    // Only sockets whose owner or wanted events changed cost a system call. Closing a socket removes
+    // it from the epoll instance, and its number may come back for the socket of another peer.
+    for (auto it = m_epoll_events.begin(); it != m_epoll_events.end(); ) {
+        auto wanted_it = wanted.find(it->first);
+        if (wanted_it != wanted.end() && wanted_it->second.first == it->second.first) {
+            ++it;
+            continue;
+        }
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, it->first, nullptr);
+        it = m_epoll_events.erase(it);
+    }
+    for (const auto& entry : wanted) {
+        auto it = m_epoll_events.find(entry.first);
+        if (it != m_epoll_events.end() && it->second.second == entry.second.second) continue;
+        struct epoll_event event = {};
+        event.events = entry.second.second;
+        event.data.fd = entry.first;
+        int op = it == m_epoll_events.end() ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+        int ret = epoll_ctl(m_epoll_fd, op, entry.first, &event);
+        if (ret == -1 && (errno == ENOENT || errno == EEXIST)) {
+            op = errno == ENOENT ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+            ret = epoll_ctl(m_epoll_fd, op, entry.first, &event);
+        }
+        if (ret == -1) {
+            LogPrint(BCLog::NET, "epoll_ctl failed for socket %d with error %s\n", entry.first, NetworkErrorString(errno));
+            if (it != m_epoll_events.end()) m_epoll_events.erase(it);
+            continue;
+        }
+        m_epoll_events[entry.first] = entry.second;
+    }
+
+    std::vector<struct epoll_event> events(m_epoll_events.size() + 1);
+    int nEvents = epoll_wait(m_epoll_fd, events.data(), events.size(), SELECT_TIMEOUT_MILLISECONDS);
+    if (nEvents < 0) return true;
+
+    if (interruptNet) return true;
+
+    for (int i = 0; i < nEvents; i++) {
+        const struct epoll_event& event = events[i];
+        if (event.events & EPOLLIN)                recv_set.insert(event.data.fd);
+        if (event.events & EPOLLOUT)               send_set.insert(event.data.fd);
+        if (event.events & (EPOLLERR|EPOLLHUP))    error_set.insert(event.data.fd);
+    }
+    return true;
+}
+#endif
+
 void CConnman::SocketHandler()
 {
     std::set<SOCKET> recv_set, send_set, error_set;
-    SocketEvents(recv_set, send_set, error_set);
+#ifdef USE_EPOLL
+    if (!SocketEventsEpoll(recv_set, send_set, error_set))
+#endif
+        SocketEvents(recv_set, send_set, error_set);
 
     if (interruptNet) return;
 
@@ -1990,6 +2141,20 @@ void CConnman::ThreadMessageHandler()
 
         bool fMoreWork = false;
 
+        // Blocks first: peers relaying a block get their message processed ahead of the round,
+        // so a new tip does not wait behind a message of every other peer. Each peer's messages
+        // are still processed in the order they arrived.
+        for (CNode* pnode : vNodesCopy)
+        {
+            if (pnode->fDisconnect || !pnode->HasBlockMessageNext())
+                continue;
+
+            bool fMoreNodeWork = m_msgproc->ProcessMessages(pnode, flagInterruptMsgProc);
+            fMoreWork |= (fMoreNodeWork && !pnode->fPauseSend);
+            if (flagInterruptMsgProc)
+                return;
+        }
+
         for (CNode* pnode : vNodesCopy)
         {
             if (pnode->fDisconnect)
@@ -2387,6 +2552,11 @@ void CConnman::Stop()
     vhListenSocket.clear();
     semOutbound.reset();
     semAddnode.reset();
+#ifdef USE_EPOLL
+    if (m_epoll_fd >= 0) close(m_epoll_fd);
+    m_epoll_fd = -1;
+    m_epoll_events.clear();
+#endif
 }
 
 void CConnman::DeleteNode(CNode* pnode)
@@ -2608,6 +2778,27 @@ bool CConnman::OutboundTargetReached(bool historicalBlockServingLimit)
     return false;
 }
 
+bool CConnman::HistoricalBlockAllowed(CNode* pnode)
+{
+    if (nMaxPeerBlockRate == 0)
+        return true;
+
+    // one second worth of blocks may go out at once
+    pnode->m_block_serve_bucket.Refill(nMaxPeerBlockRate, nMaxPeerBlockRate, GetTimeMicros());
+    if (pnode->m_block_serve_bucket.Available())
+        return true;
+
+    pnode->nHistoricalBlockDeferrals++;
+    return false;
+}
+
+void CConnman::RecordHistoricalBlock(CNode* pnode, uint64_t bytes)
+{
+    pnode->nHistoricalBlockBytes += bytes;
+    if (nMaxPeerBlockRate != 0)
+        pnode->m_block_serve_bucket.Consume(bytes);
+}
+
 uint64_t CConnman::GetOutboundTargetBytesLeft()
 {
     LOCK(cs_totalBytesSent);
@@ -2629,6 +2820,21 @@ uint64_t CConnman::GetTotalBytesSent()
     return nTotalBytesSent;
 }
 
+size_t CConnman::GetBufferedBytes()
+{
+    size_t bytes = 0;
+    LOCK(cs_vNodes);
+    for (CNode* pnode : vNodes) {
+        {
+            LOCK(pnode->cs_vSend);
+            bytes += pnode->nSendSize;
+        }
+        LOCK(pnode->cs_vProcessMsg);
+        bytes += pnode->nProcessQueueSize;
+    }
+    return bytes;
+}
+
 ServiceFlags CConnman::GetLocalServices() const
 {
     return nLocalServices;
@@ -2690,20 +2896,43 @@ bool CConnman::NodeFullyConnected(const CNode* pnode)
     return pnode && pnode->fSuccessfullyConnected && !pnode->fDisconnect;
 }
 
-void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
+CSharedNetMsg CConnman::ShareMessage(CSerializedNetMsg&& msg) const
 {
-    size_t nMessageSize = msg.data.size();
-    size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
-    LogPrint(BCLog::NET, "sending %s (%d bytes) peer=%d\n",  SanitizeString(msg.command.c_str()), nMessageSize, pnode->GetId());
-
     std::vector<unsigned char> serializedHeader;
     serializedHeader.reserve(CMessageHeader::HEADER_SIZE);
-    uint256 hash = Hash(msg.data.data(), msg.data.data() + nMessageSize);
-    CMessageHeader hdr(Params().MessageStart(), msg.command.c_str(), nMessageSize);
+    uint256 hash = Hash(msg.data.data(), msg.data.data() + msg.data.size());
+    CMessageHeader hdr(Params().MessageStart(), msg.command.c_str(), msg.data.size());
     memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
 
     CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, serializedHeader, 0, hdr};
 
+    CSharedNetMsg shared;
+    shared.header = std::make_shared<const std::vector<unsigned char>>(std::move(serializedHeader));
+    if (!msg.data.empty())
+        shared.data = std::make_shared<const std::vector<unsigned char>>(std::move(msg.data));
+    shared.command = std::move(msg.command);
+    return shared;
+}
+
+void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
+{
+    // Large blocks and transactions go compressed when both sides offer NODE_COMPRESSED
+    if ((pnode->GetLocalServices() & NODE_COMPRESSED) && (pnode->nServices & NODE_COMPRESSED) && pnode->fSuccessfullyConnected) {
+        const size_t nRawSize = msg.data.size();
+        if (CompressNetMessage(msg)) {
+            pnode->nCompressedBytesSent += msg.data.size();
+            pnode->nCompressedRawBytesSent += nRawSize;
+        }
+    }
+    PushMessage(pnode, ShareMessage(std::move(msg)));
+}
+
+void CConnman::PushMessage(CNode* pnode, const CSharedNetMsg& msg)
+{
+    size_t nMessageSize = msg.data ? msg.data->size() : 0;
+    size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
+    LogPrint(BCLog::NET, "sending %s (%d bytes) peer=%d\n",  SanitizeString(msg.command.c_str()), nMessageSize, pnode->GetId());
+
     size_t nBytesSent = 0;
     {
         LOCK(pnode->cs_vSend);
@@ -2715,9 +2944,9 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 
         if (pnode->nSendSize > nSendBufferMaxSize)
             pnode->fPauseSend = true;
-        pnode->vSendMsg.push_back(std::move(serializedHeader));
+        pnode->vSendMsg.push_back(msg.header);
         if (nMessageSize)
-            pnode->vSendMsg.push_back(std::move(msg.data));
+            pnode->vSendMsg.push_back(msg.data);
 
         // If write queue empty, attempt "optimistic write"
         if (optimisticSend == true)
@@ -81,6 +81,8 @@ static const unsigned int DEFAULT_MAX_PEER_CONNECTIONS = 125;
 static const uint64_t DEFAULT_MAX_UPLOAD_TARGET = 0;
 /** The default timeframe for -maxuploadtarget. 1 day. */
 static const uint64_t MAX_UPLOAD_TIMEFRAME = 60 * 60 * 24;
+/** The default for -maxpeerblockrate, in KiB per second. 0 = Unlimited */
+static const uint64_t DEFAULT_MAX_PEER_BLOCK_RATE = 0;
 /** Default for blocks only*/
 static const bool DEFAULT_BLOCKSONLY = false;
 /** -peertimeout default */
@@ -116,6 +118,14 @@ struct CSerializedNetMsg
     std::string command;
 };
 
+/** A message with its serialized header, queued unchanged to any number of peers without a copy */
+struct CSharedNetMsg
+{
+    std::shared_ptr<const std::vector<unsigned char>> header;
+    /** Null for an empty payload */
+    std::shared_ptr<const std::vector<unsigned char>> data;
+    std::string command;
+};
 
 class NetEventsInterface;
 class CConnman
@@ -145,6 +155,7 @@ public:
         unsigned int nReceiveFloodSize = 0;
         uint64_t nMaxOutboundTimeframe = 0;
         uint64_t nMaxOutboundLimit = 0;
+        uint64_t nMaxPeerBlockRate = 0;
         int64_t m_peer_connect_timeout = DEFAULT_PEER_CONNECT_TIMEOUT;
         std::vector<std::string> vSeedNodes;
         std::vector<NetWhitelistPermissions> vWhitelistedRange;
@@ -176,6 +187,7 @@ public:
             nMaxOutboundTimeframe = connOptions.nMaxOutboundTimeframe;
             nMaxOutboundLimit = connOptions.nMaxOutboundLimit;
         }
+        nMaxPeerBlockRate = connOptions.nMaxPeerBlockRate;
         vWhitelistedRange = connOptions.vWhitelistedRange;
         {
             LOCK(cs_vAddedNodes);
@@ -208,6 +220,10 @@ public:
     bool ForNode(NodeId id, std::function<bool(CNode* pnode)> func);
 
     void PushMessage(CNode* pnode, CSerializedNetMsg&& msg);
+    void PushMessage(CNode* pnode, const CSharedNetMsg& msg);
+
+    /** Serialize the header of msg once, for a message pushed to several peers */
+    CSharedNetMsg ShareMessage(CSerializedNetMsg&& msg) const;
 
     template<typename Callable>
     void ForEachNode(Callable&& func)
@@ -311,9 +327,19 @@ public:
     //! in case of no limit, it will always response 0
     uint64_t GetMaxOutboundTimeLeftInCycle();
 
+    //! check if pnode may be served another historical block under -maxpeerblockrate,
+    //! counts the request as deferred when it has to wait
+    bool HistoricalBlockAllowed(CNode* pnode);
+
+    //! charge the size of a historical block served to pnode
+    void RecordHistoricalBlock(CNode* pnode, uint64_t bytes);
+
     uint64_t GetTotalBytesRecv();
     uint64_t GetTotalBytesSent();
 
+    //! bytes of messages queued to be sent to the peers or waiting to be processed
+    size_t GetBufferedBytes();
+
     void SetBestHeight(int height);
     int GetBestHeight() const;
 
@@ -352,8 +378,13 @@ private:
     void DisconnectNodes();
     void NotifyNumConnectionsChanged();
     void InactivityCheck(CNode *pnode);
-    bool GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set);
+    /** Collect the sockets to wait for, and the peer owning each peer socket in socket_owners when it is set */
+    bool GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set, std::map<SOCKET, NodeId>* socket_owners = nullptr);
     void SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set);
+#ifdef USE_EPOLL
+    /** SocketEvents through the persistent epoll registrations, false when epoll is not available */
+    bool SocketEventsEpoll(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set);
+#endif
     void SocketHandler();
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
@@ -395,6 +426,9 @@ private:
     uint64_t nMaxOutboundLimit GUARDED_BY(cs_totalBytesSent);
     uint64_t nMaxOutboundTimeframe GUARDED_BY(cs_totalBytesSent);
 
+    // historical blocks served per peer, in bytes per second (0 = unlimited)
+    uint64_t nMaxPeerBlockRate;
+
     // P2P timeout in seconds
     int64_t m_peer_connect_timeout;
 
@@ -465,6 +499,12 @@ private:
 
     CThreadInterrupt interruptNet;
 
+#ifdef USE_EPOLL
+    /** The epoll instance of the socket handler thread, and the owner and events each socket is registered with */
+    int m_epoll_fd{-1};
+    std::map<SOCKET, std::pair<NodeId, uint32_t>> m_epoll_events;
+#endif
+
     std::thread threadDNSAddressSeed;
     std::thread threadSocketHandler;
     std::thread threadOpenAddedConnections;
@@ -570,6 +610,22 @@ struct LocalServiceInfo {
 extern CCriticalSection cs_mapLocalHost;
 extern std::map<CNetAddr, LocalServiceInfo> mapLocalHost GUARDED_BY(cs_mapLocalHost);
 
+/**
+ * Token bucket shaping the historical blocks served to one peer. A block is
+ * sent while the balance is positive and its size is taken afterwards, so a
+ * block larger than the burst only delays the next one.
+ */
+struct BlockServeBucket
+{
+    int64_t nTokens{0};
+    int64_t nLastRefill{0};
+
+    //! add the bytes earned since the last refill at nRate bytes per second, holding at most nBurst
+    void Refill(int64_t nRate, int64_t nBurst, int64_t nTimeMicros);
+    bool Available() const { return nTokens > 0; }
+    void Consume(int64_t nBytes) { nTokens -= nBytes; }
+};
+
 extern const std::string NET_MESSAGE_COMMAND_OTHER;
 typedef std::map<std::string, uint64_t> mapMsgCmdSize; //command, total bytes
 
@@ -599,6 +655,12 @@ public:
     double dPingWait;
     double dMinPing;
     CAmount minFeeFilter;
+    uint64_t nHistoricalBlockBytes;
+    uint64_t nHistoricalBlockDeferrals;
+    uint64_t nCompressedBytesSent;
+    uint64_t nCompressedRawBytesSent;
+    uint64_t nCompressedBytesRecv;
+    uint64_t nCompressedRawBytesRecv;
     // Our address, as reported by the peer
     std::string addrLocal;
     // Address of this peer
@@ -665,7 +727,7 @@ public:
     size_t nSendSize{0}; // total size of all vSendMsg entries
     size_t nSendOffset{0}; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes GUARDED_BY(cs_vSend){0};
-    std::deque<std::vector<unsigned char>> vSendMsg GUARDED_BY(cs_vSend);
+    std::deque<std::shared_ptr<const std::vector<unsigned char>>> vSendMsg GUARDED_BY(cs_vSend);
     CCriticalSection cs_vSend;
     CCriticalSection cs_hSocket;
     CCriticalSection cs_vRecv;
@@ -725,6 +787,16 @@ protected:
 
 public:
     uint256 hashContinue;
+
+    // historical block serving, shaped by -maxpeerblockrate from the message handler thread
+    BlockServeBucket m_block_serve_bucket;
+    std::atomic<uint64_t> nHistoricalBlockBytes{0};
+    std::atomic<uint64_t> nHistoricalBlockDeferrals{0};
+    // compressed messages with NODE_COMPRESSED, by their size on the wire and their size once decompressed
+    std::atomic<uint64_t> nCompressedBytesSent{0};
+    std::atomic<uint64_t> nCompressedRawBytesSent{0};
+    std::atomic<uint64_t> nCompressedBytesRecv{0};
+    std::atomic<uint64_t> nCompressedRawBytesRecv{0};
     std::atomic<int> nStartingHeight{-1};
 
     // flood relay
@@ -931,6 +1003,9 @@ public:
 
     void CloseSocketDisconnect();
 
+    /** Whether the next message to process relays a block and no getdata or orphans are pending, the message handler serves these peers first */
+    bool HasBlockMessageNext();
+
     void copyStats(CNodeStats &stats);
 
     ServiceFlags GetLocalServices() const
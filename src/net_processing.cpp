@@ -12,10 +12,13 @@
 #include <chainparams.h>
 #include <consensus/validation.h>
 #include <hash.h>
+#include <index/blockfilterindex.h>
 #include <validation.h>
 #include <merkleblock.h>
 #include <netmessagemaker.h>
 #include <netbase.h>
+#include <netcompression.h>
+#include <policy/exectime.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <primitives/block.h>
@@ -33,6 +36,7 @@
 #include <consensus/merkle.h>
 #include <shutdown.h>
 
+#include <limits>
 #include <memory>
 #include <typeinfo>
 
@@ -84,6 +88,10 @@ static_assert(INBOUND_PEER_TX_DELAY >= MAX_GETDATA_RANDOM_DELAY,
 "To preserve security, MAX_GETDATA_RANDOM_DELAY should not exceed INBOUND_PEER_DELAY");
 /** Limit to avoid sending big packets. Not used in processing incoming GETDATA for compatibility */
 static const unsigned int MAX_GETDATA_SZ = 1000;
+/** Maximum number of compact filters that may be requested with one getcfilters. See BIP 157. */
+static constexpr uint32_t MAX_GETCFILTERS_SIZE = 1000;
+/** Maximum number of cf hashes that may be requested with one getcfheaders. See BIP 157. */
+static constexpr uint32_t MAX_GETCFHEADERS_SIZE = 2000;
 
 
 struct COrphanTx {
@@ -162,6 +170,30 @@ namespace {
     std::unique_ptr<CRollingBloomFilter> recentRejects GUARDED_BY(cs_main);
     uint256 hashRecentRejectsChainTip GUARDED_BY(cs_main);
 
+    /*
+     * Filter for transactions that have been recently confirmed.
+     * We use this to avoid requesting transactions that have already been
+     * confirmed, peers that are behind on the tip keep announcing them.
+     * The coins cache check in AlreadyHave() misses most of these once the
+     * cache is flushed, and contract txs whose first outputs are OP_CREATE or
+     * OP_CALL leave no coin to find at all, so without the filter the
+     * multi-kilobyte contract creations of a block are downloaded again from
+     * every lagging peer.
+     *
+     * Blocks don't typically have more than 4000 transactions, so this should
+     * be at least six blocks (~1 hr) worth of transactions that we can store.
+     * If the number of transactions appearing in a block goes up, or if we are
+     * seeing getdata requests more than an hour after initial announcement, we
+     * can increase this number.
+     * The false positive rate of 1/1M should come out to less than 1
+     * transaction per day that would be inadvertently ignored (which is the
+     * same probability that we have in the reject filter).
+     *
+     * Memory used: 600 KB
+     */
+    Mutex g_cs_recent_confirmed_transactions;
+    std::unique_ptr<CRollingBloomFilter> g_recent_confirmed_transactions GUARDED_BY(g_cs_recent_confirmed_transactions);
+
     /** Blocks that are in flight, and that are in the queue to be downloaded. */
     struct QueuedBlock {
         uint256 hash;
@@ -215,10 +247,17 @@ struct CBlockReject {
     uint256 hashBlock;
 };
 
+/**
+ * Counts how many times a peer sent the header at each height, as ranges of heights
+ * counted the same number of times, so a headers message costs one range update
+ * instead of one update per header.
+ */
 class CNodeHeaders
 {
 public:
     CNodeHeaders():
+        nHeights(0),
+        nHeaders(0),
         maxSize(0),
         maxAvg(0)
     {
@@ -230,16 +269,8 @@ public:
     {
         if(pindexFirst && pindexLast && maxSize && maxAvg)
         {
-            // Get the begin block index
-            int nBegin = pindexFirst->nHeight;
-
-            // Get the end block index
-            int nEnd = pindexLast->nHeight;
-
-            for(int point = nBegin; point<= nEnd; point++)
-            {
-                addPoint(point);
-            }
+            if(pindexFirst->nHeight <= pindexLast->nHeight)
+                addRange(pindexFirst->nHeight, pindexLast->nHeight);
 
             return true;
         }
@@ -250,28 +281,22 @@ public:
     bool updateState(CValidationState& state, bool ret)
     {
         // No headers
-        size_t size = points.size();
-        if(size == 0)
+        if(nHeights == 0)
             return ret;
 
-        // Compute the number of the received headers
-        size_t nHeaders = 0;
-        for(auto point : points)
-        {
-            nHeaders += point.second;
-        }
-
         // Compute the average value per height
-        double nAvgValue = (double)nHeaders / size;
+        double nAvgValue = (double)nHeaders / nHeights;
 
         // Ban the node if try to spam
-        bool banNode = (nAvgValue >= 1.5 * maxAvg && size >= maxAvg) ||
+        bool banNode = (nAvgValue >= 1.5 * maxAvg && nHeights >= maxAvg) ||
                        (nAvgValue >= maxAvg && nHeaders >= maxSize) ||
                        (nHeaders >= maxSize * 4.1);
         if(banNode)
         {
-            // Clear the points and ban the node
-            points.clear();
+            // Clear the ranges and ban the node
+            ranges.clear();
+            nHeights = 0;
+            nHeaders = 0;
             return state.Invalid(ValidationInvalidReason::BLOCK_HEADER_SPAM, false, REJECT_INVALID, "header-spam", "ban node for sending spam");
         }
 
@@ -279,25 +304,81 @@ public:
     }
 
 private:
-    void addPoint(int height)
+    /** Heights counted the same number of times in a row, keyed by the first height */
+    struct Range {
+        int end;
+        int count;
+    };
+
+    /** Make a range begin at height if one covers it */
+    void split(int height)
     {
-        // Erace the last element in the list
-        if(points.size() == maxSize)
-        {
-            points.erase(points.begin());
+        auto it = ranges.upper_bound(height);
+        if (it == ranges.begin())
+            return;
+        --it;
+        if (it->first == height || it->second.end < height)
+            return;
+        ranges.emplace_hint(std::next(it), height, Range{it->second.end, it->second.count});
+        it->second.end = height - 1;
+    }
+
+    /** Count every height of [nBegin, nEnd] once more */
+    void addRange(int nBegin, int nEnd)
+    {
+        split(nBegin);
+        split(nEnd + 1);
+
+        // Count the ranges inside once more and fill the gaps between them
+        auto it = ranges.lower_bound(nBegin);
+        for (int next = nBegin; next <= nEnd; ) {
+            if (it != ranges.end() && it->first == next) {
+                it->second.count++;
+                nHeaders += it->second.end - it->first + 1;
+                next = it->second.end + 1;
+                ++it;
+            } else {
+                int gapEnd = (it != ranges.end() && it->first <= nEnd) ? it->first - 1 : nEnd;
+                ranges.emplace_hint(it, next, Range{gapEnd, 1});
+                nHeights += gapEnd - next + 1;
+                nHeaders += gapEnd - next + 1;
+                next = gapEnd + 1;
+            }
+        }
+
+        // Join the neighbouring ranges that ended up with the same count
+        it = ranges.lower_bound(nBegin);
+        if (it != ranges.begin())
+            --it;
+        while (it != ranges.end() && it->first <= nEnd + 1) {
+            auto next = std::next(it);
+            if (next != ranges.end() && next->first <= nEnd + 1 && next->first == it->second.end + 1 && next->second.count == it->second.count) {
+                it->second.end = next->second.end;
+                ranges.erase(next);
+            } else {
+                it = next;
+            }
         }
 
-        // Add the point to the list
-        int occurrence = 0;
-        auto mi = points.find(height);
-        if (mi != points.end())
-            occurrence = (*mi).second;
-        occurrence++;
-        points[height] = occurrence;
+        // Forget the lowest heights past the size of the filter
+        while (nHeights > maxSize) {
+            it = ranges.begin();
+            const size_t nLength = it->second.end - it->first + 1;
+            const size_t nExcess = std::min(nLength, nHeights - maxSize);
+            nHeights -= nExcess;
+            nHeaders -= nExcess * it->second.count;
+            if (nExcess < nLength)
+                ranges.emplace_hint(std::next(it), it->first + nExcess, it->second);
+            ranges.erase(it);
+        }
     }
 
 private:
-    std::map<int,int> points;
+    std::map<int, Range> ranges;
+    //! Number of heights counted, at most maxSize, the lowest heights are forgotten first
+    size_t nHeights;
+    //! Sum of the counts of all heights
+    size_t nHeaders;
     size_t maxSize;
     size_t maxAvg;
 };
@@ -394,6 +475,9 @@ struct CNodeState {
     //! Time of last new block announcement
     int64_t m_last_block_announcement;
 
+    //! Contract execution time of the txs the peer relayed to our mempool recently
+    ExecTimeBucket m_exec_time;
+
     /*
      * State associated with transaction download.
      *
@@ -498,7 +582,9 @@ limitedmap<uint256, std::chrono::microseconds> g_already_asked_for GUARDED_BY(cs
 
 /** Map maintaining per-node state. */
 static std::map<NodeId, CNodeState> mapNodeState GUARDED_BY(cs_main);
-static std::map<CService, CNodeHeaders> mapServiceHeaders GUARDED_BY(cs_main);
+/** Guards the header spam filter, so headers sync accounts the headers of a peer without cs_main. Taken after cs_main. */
+static Mutex cs_service_headers;
+static std::map<CService, CNodeHeaders> mapServiceHeaders GUARDED_BY(cs_service_headers);
 
 static CNodeState *State(NodeId pnode) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
     std::map<NodeId, CNodeState>::iterator it = mapNodeState.find(pnode);
@@ -507,23 +593,21 @@ static CNodeState *State(NodeId pnode) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
     return &it->second;
 }
 
-static CNodeHeaders &ServiceHeaders(const CService& address) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+static CNodeHeaders &ServiceHeaders(const CService& address) EXCLUSIVE_LOCKS_REQUIRED(cs_service_headers) {
     unsigned short port =
             gArgs.GetBoolArg("-headerspamfilterignoreport", DEFAULT_HEADER_SPAM_FILTER_IGNORE_PORT) ? 0 : address.GetPort();
     CService addr(address, port);
     return mapServiceHeaders[addr];
 }
 
-static void CleanAddressHeaders(const CAddress& addr) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
-    CSubNet subNet(addr);
-    for (std::map<CService, CNodeHeaders>::iterator it=mapServiceHeaders.begin(); it!=mapServiceHeaders.end();){
-        if(subNet.Match(it->first))
-        {
-            it = mapServiceHeaders.erase(it);
-        }
-        else{
-            it++;
-        }
+static void CleanAddressHeaders(const CAddress& addr) LOCKS_EXCLUDED(cs_service_headers) {
+    if (!addr.IsValid())
+        return;
+    LOCK(cs_service_headers);
+    // Services sort by address before port, the ports of an address are next to each other
+    const CNetAddr& netAddr = addr;
+    for (auto it = mapServiceHeaders.lower_bound(CService(netAddr, 0)); it != mapServiceHeaders.end() && static_cast<const CNetAddr&>(it->first) == netAddr; ) {
+        it = mapServiceHeaders.erase(it);
     }
 }
 
@@ -533,9 +617,8 @@ bool ProcessNetBlockHeaders(CNode* pfrom, const std::vector<CBlockHeader>& block
     bool ret = ProcessNewBlockHeaders(block, state, chainparams, ppindex, first_invalid, &pindexFirst);
     if(gArgs.GetBoolArg("-headerspamfilter", DEFAULT_HEADER_SPAM_FILTER))
     {
-        LOCK(cs_main);
-        CNodeState *nodestate = State(pfrom->GetId());
-        CNodeHeaders& headers = ServiceHeaders(nodestate->address);
+        LOCK(cs_service_headers);
+        CNodeHeaders& headers = ServiceHeaders(pfrom->addr);
         const CBlockIndex *pindexLast = ppindex == nullptr ? nullptr : *ppindex;
         headers.addHeaders(pindexFirst, pindexLast);
         return headers.updateState(state, ret);
@@ -1254,6 +1337,11 @@ PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn, BanMan* banman, CS
     // Initialize global variables that cannot be constructed at startup.
     recentRejects.reset(new CRollingBloomFilter(120000, 0.000001));
 
+    {
+        LOCK(g_cs_recent_confirmed_transactions);
+        g_recent_confirmed_transactions.reset(new CRollingBloomFilter(48000, 0.000001));
+    }
+
     const Consensus::Params& consensusParams = Params().GetConsensus();
     // Stale tip checking and peer eviction are on two different timers, but we
     // don't want them to get out of sync due to drift in the scheduler, so we
@@ -1265,9 +1353,17 @@ PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn, BanMan* banman, CS
 
 /**
  * Evict orphan txn pool entries (EraseOrphanTx) based on a newly connected
- * block. Also save the time of the last tip update.
+ * block, and remember its transactions so that we don't download them again.
+ * Also save the time of the last tip update.
  */
 void PeerLogicValidation::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const std::vector<CTransactionRef>& vtxConflicted) {
+    {
+        LOCK(g_cs_recent_confirmed_transactions);
+        for (const auto& ptx : pblock->vtx) {
+            g_recent_confirmed_transactions->insert(ptx->GetHash());
+        }
+    }
+
     LOCK(g_cs_orphans);
 
     std::vector<uint256> vOrphanErase;
@@ -1299,6 +1395,20 @@ void PeerLogicValidation::BlockConnected(const std::shared_ptr<const CBlock>& pb
     g_last_tip_update = GetTime();
 }
 
+void PeerLogicValidation::BlockDisconnected(const std::shared_ptr<const CBlock> &block)
+{
+    // To avoid relay problems with transactions that were previously
+    // confirmed, clear our filter of recently confirmed transactions whenever
+    // there's a reorg.
+    // This means that in a 1-block reorg (where 1 block is disconnected and
+    // then another block reconnected), our filter will drop to having only one
+    // block's worth of transactions in it, but that should be fine, since
+    // presumably the most common case of relaying a confirmed transaction
+    // should be just after a new block containing it is found.
+    LOCK(g_cs_recent_confirmed_transactions);
+    g_recent_confirmed_transactions->reset();
+}
+
 // All of the following cache a recent block, and are protected by cs_most_recent_block
 static CCriticalSection cs_most_recent_block;
 static std::shared_ptr<const CBlock> most_recent_block GUARDED_BY(cs_most_recent_block);
@@ -1332,10 +1442,12 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
         fWitnessesPresentInMostRecentCompactBlock = fWitnessEnabled;
     }
 
-    connman->ForEachNode([this, &pcmpctblock, pindex, &msgMaker, fWitnessEnabled, &hashBlock](CNode* pnode) {
+    // Serialized once for every peer it is announced to
+    CSharedNetMsg msgCmpctBlock;
+
+    connman->ForEachNode([this, &pcmpctblock, pindex, &msgMaker, fWitnessEnabled, &hashBlock, &msgCmpctBlock](CNode* pnode) {
         AssertLockHeld(cs_main);
 
-        // TODO: Avoid the repeated-serialization here
         if (pnode->nVersion < INVALID_CB_NO_BAN_VERSION || pnode->fDisconnect)
             return;
         ProcessBlockAvailability(pnode->GetId());
@@ -1347,7 +1459,9 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
 
             LogPrint(BCLog::NET, "%s sending header-and-ids %s to peer=%d\n", "PeerLogicValidation::NewPoWValidBlock",
                     hashBlock.ToString(), pnode->GetId());
-            connman->PushMessage(pnode, msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
+            if (!msgCmpctBlock.header)
+                msgCmpctBlock = connman->ShareMessage(msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
+            connman->PushMessage(pnode, msgCmpctBlock);
             state.pindexBestHeaderSent = pindex;
         }
     });
@@ -1450,6 +1564,11 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
                 LOCK(g_cs_orphans);
                 if (mapOrphanTransactions.count(inv.hash)) return true;
             }
+            {
+                LOCK(g_cs_recent_confirmed_transactions);
+                if (g_recent_confirmed_transactions->contains(inv.hash)) return true;
+            }
+
             const CCoinsViewCache& coins_cache = ::ChainstateActive().CoinsTip();
 
             return recentRejects->contains(inv.hash) ||
@@ -1510,6 +1629,30 @@ static void RelayAddress(const CAddress& addr, bool fReachable, CConnman* connma
     connman->ForEachNodeThen(std::move(sortfunc), std::move(pushfunc));
 }
 
+/** Blocks deeper than MAX_BLOCKTXN_DEPTH are historical, the tip is relayed ahead of them */
+static bool IsHistoricalBlock(const CBlockIndex* pindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    return pindex->nHeight < ::ChainActive().Height() - MAX_BLOCKTXN_DEPTH;
+}
+
+/**
+ * Whether the block of inv has to wait for the -maxpeerblockrate budget of pfrom.
+ * New tip blocks, compact blocks and blocktxn are never held back, so staked blocks
+ * propagate at full speed while we serve peers in initial block download.
+ */
+static bool DeferBlockRequest(CNode* pfrom, const CInv& inv, CConnman* connman) LOCKS_EXCLUDED(cs_main)
+{
+    if (pfrom->HasPermission(PF_NOBAN))
+        return false;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindex = LookupBlockIndex(inv.hash);
+        if (!pindex || !IsHistoricalBlock(pindex))
+            return false;
+    }
+    return !connman->HistoricalBlockAllowed(pfrom);
+}
+
 void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, const CInv& inv, CConnman* connman)
 {
     bool send = false;
@@ -1581,25 +1724,31 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
     if (send && (pindex->nStatus & BLOCK_HAVE_DATA))
     {
         std::shared_ptr<const CBlock> pblock;
+        size_t nBlockSize = 0;
+        // Old blocks asked for as compact blocks are sent in full, with witnesses when the peer wants them
+        const bool fCmpctAsWitnessBlock = inv.type == MSG_CMPCT_BLOCK && State(pfrom->GetId())->fWantsCmpctWitness &&
+            !(CanDirectFetch(consensusParams) && pindex->nHeight >= ::ChainActive().Height() - MAX_CMPCTBLOCK_DEPTH);
         if (a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash()) {
             pblock = a_recent_block;
-        } else if (inv.type == MSG_WITNESS_BLOCK) {
+        } else if (inv.type == MSG_WITNESS_BLOCK || fCmpctAsWitnessBlock) {
             // Fast-path: in this case it is possible to serve the block directly from disk,
-            // as the network format matches the format on disk
-            std::vector<uint8_t> block_data;
-            if (!ReadRawBlockFromDisk(block_data, pindex, chainparams.MessageStart())) {
+            // as the network format matches the format on disk. The bytes are read straight
+            // into the message payload, nothing is deserialized or copied again.
+            CSerializedNetMsg msg;
+            msg.command = NetMsgType::BLOCK;
+            if (!ReadRawBlockFromDisk(msg.data, pindex, chainparams.MessageStart())) {
                 assert(!"cannot load block from disk");
             }
-            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, MakeSpan(block_data)));
+            nBlockSize = msg.data.size();
+            connman->PushMessage(pfrom, std::move(msg));
             // Don't set pblock as we've sent the block
         } else {
-            // Send block from disk
-            std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
-            if (!ReadBlockFromDisk(*pblockRead, pindex, consensusParams))
+            // Send block from the recent block cache or disk
+            if (!ReadBlockFromDisk(pblock, pindex, consensusParams))
                 assert(!"cannot load block from disk");
-            pblock = pblockRead;
         }
         if (pblock) {
+            nBlockSize = ::GetSerializeSize(*pblock, PROTOCOL_VERSION);
             if (inv.type == MSG_BLOCK)
                 connman->PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, *pblock));
             else if (inv.type == MSG_WITNESS_BLOCK)
@@ -1651,6 +1800,10 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
             }
         }
 
+        if (IsHistoricalBlock(pindex)) {
+            connman->RecordHistoricalBlock(pfrom, nBlockSize);
+        }
+
         // Trigger the peer node to send a getblocks request for the next batch of inventory
         if (inv.hash == pfrom->hashContinue)
         {
@@ -1665,7 +1818,8 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
     }
 }
 
-void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc) LOCKS_EXCLUDED(cs_main)
+/** Answer the queued getdata requests of pfrom, returns false while a historical block waits for its turn */
+bool static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc) LOCKS_EXCLUDED(cs_main)
 {
     AssertLockNotHeld(cs_main);
 
@@ -1682,7 +1836,7 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
 
         while (it != pfrom->vRecvGetData.end() && (it->type == MSG_TX || it->type == MSG_WITNESS_TX)) {
             if (interruptMsgProc)
-                return;
+                return true;
             // Don't bother if send buffer is too full to respond anyway
             if (pfrom->fPauseSend)
                 break;
@@ -1712,11 +1866,15 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
         }
     } // release cs_main
 
+    bool fDeferred = false;
     if (it != pfrom->vRecvGetData.end() && !pfrom->fPauseSend) {
         const CInv &inv = *it;
         if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK || inv.type == MSG_WITNESS_BLOCK) {
-            it++;
-            ProcessGetBlockData(pfrom, chainparams, inv, connman);
+            fDeferred = DeferBlockRequest(pfrom, inv, connman);
+            if (!fDeferred) {
+                it++;
+                ProcessGetBlockData(pfrom, chainparams, inv, connman);
+            }
         }
     }
 
@@ -1744,6 +1902,7 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
         // assume we have them and request the parents from us.
         connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::NOTFOUND, vNotFound));
     }
+    return !fDeferred;
 }
 
 static uint32_t GetFetchFlags(CNode* pfrom) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
@@ -2015,6 +2174,217 @@ void static ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_se
     }
 }
 
+/**
+ * Validation logic for compact filters request handling.
+ *
+ * May disconnect from the peer in the case of a bad request.
+ *
+ * @param[in]   pfrom           The peer that we received the request from
+ * @param[in]   chain_params    Chain parameters
+ * @param[in]   filter_type     The filter type the request is for. Must be an indexed type.
+ * @param[in]   start_height    The start height for the request
+ * @param[in]   stop_hash       The stop_hash for the request
+ * @param[in]   max_height_diff The maximum number of items permitted to request, as specified in BIP 157
+ * @param[out]  stop_index      The CBlockIndex for the stop_hash block, if the request can be serviced.
+ * @param[out]  filter_index    The filter index, if the request can be serviced.
+ * @return                      True if the request can be serviced.
+ */
+static bool PrepareBlockFilterRequest(CNode* pfrom, const CChainParams& chain_params,
+                                      BlockFilterType filter_type, uint32_t start_height,
+                                      const uint256& stop_hash, uint32_t max_height_diff,
+                                      const CBlockIndex*& stop_index,
+                                      BlockFilterIndex*& filter_index)
+{
+    // Basic filters are always indexed when NODE_COMPACT_FILTERS is offered, the EVM log filters
+    // are served as well when their index is enabled.
+    const bool supported_filter_type =
+        ((filter_type == BlockFilterType::BASIC || filter_type == BlockFilterType::EVM_LOGS) &&
+         (pfrom->GetLocalServices() & NODE_COMPACT_FILTERS) &&
+         GetBlockFilterIndex(filter_type) != nullptr);
+    if (!supported_filter_type) {
+        LogPrint(BCLog::NET, "peer %d requested unsupported block filter type: %d\n",
+                 pfrom->GetId(), static_cast<uint8_t>(filter_type));
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    {
+        LOCK(cs_main);
+        stop_index = LookupBlockIndex(stop_hash);
+
+        // Check that the stop block exists and the peer would be allowed to fetch it.
+        if (!stop_index || !BlockRequestAllowed(stop_index, chain_params.GetConsensus())) {
+            LogPrint(BCLog::NET, "peer %d requested invalid block hash: %s\n",
+                     pfrom->GetId(), stop_hash.ToString());
+            pfrom->fDisconnect = true;
+            return false;
+        }
+    }
+
+    uint32_t stop_height = stop_index->nHeight;
+    if (start_height > stop_height) {
+        LogPrint(BCLog::NET, "peer %d sent invalid getcfilters/getcfheaders with "
+                 "start height %d and stop height %d\n",
+                 pfrom->GetId(), start_height, stop_height);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    if (stop_height - start_height >= max_height_diff) {
+        LogPrint(BCLog::NET, "peer %d requested too many cfilters/cfheaders: %d / %d\n",
+                 pfrom->GetId(), stop_height - start_height + 1, max_height_diff);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    filter_index = GetBlockFilterIndex(filter_type);
+    return true;
+}
+
+/**
+ * Handle a cfilters request.
+ *
+ * May disconnect from the peer in the case of a bad request.
+ *
+ * @param[in]   pfrom           The peer that we received the request from
+ * @param[in]   vRecv           The raw message received
+ * @param[in]   chain_params    Chain parameters
+ * @param[in]   connman         Pointer to the connection manager
+ */
+static void ProcessGetCFilters(CNode* pfrom, CDataStream& vRecv, const CChainParams& chain_params,
+                               CConnman* connman)
+{
+    uint8_t filter_type_ser;
+    uint32_t start_height;
+    uint256 stop_hash;
+
+    vRecv >> filter_type_ser >> start_height >> stop_hash;
+
+    const BlockFilterType filter_type = static_cast<BlockFilterType>(filter_type_ser);
+
+    const CBlockIndex* stop_index;
+    BlockFilterIndex* filter_index;
+    if (!PrepareBlockFilterRequest(pfrom, chain_params, filter_type, start_height, stop_hash,
+                                   MAX_GETCFILTERS_SIZE, stop_index, filter_index)) {
+        return;
+    }
+
+    std::vector<BlockFilter> filters;
+    if (!filter_index->LookupFilterRange(start_height, stop_index, filters)) {
+        LogPrint(BCLog::NET, "Failed to find block filter in index: filter_type=%s, start_height=%d, stop_hash=%s\n",
+                 BlockFilterTypeName(filter_type), start_height, stop_hash.ToString());
+        return;
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    for (const auto& filter : filters) {
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFILTER, filter));
+    }
+}
+
+/**
+ * Handle a cfheaders request.
+ *
+ * May disconnect from the peer in the case of a bad request.
+ *
+ * @param[in]   pfrom           The peer that we received the request from
+ * @param[in]   vRecv           The raw message received
+ * @param[in]   chain_params    Chain parameters
+ * @param[in]   connman         Pointer to the connection manager
+ */
+static void ProcessGetCFHeaders(CNode* pfrom, CDataStream& vRecv, const CChainParams& chain_params,
+                                CConnman* connman)
+{
+    uint8_t filter_type_ser;
+    uint32_t start_height;
+    uint256 stop_hash;
+
+    vRecv >> filter_type_ser >> start_height >> stop_hash;
+
+    const BlockFilterType filter_type = static_cast<BlockFilterType>(filter_type_ser);
+
+    const CBlockIndex* stop_index;
+    BlockFilterIndex* filter_index;
+    if (!PrepareBlockFilterRequest(pfrom, chain_params, filter_type, start_height, stop_hash,
+                                   MAX_GETCFHEADERS_SIZE, stop_index, filter_index)) {
+        return;
+    }
+
+    uint256 prev_header;
+    if (start_height > 0) {
+        const CBlockIndex* const prev_block =
+            stop_index->GetAncestor(static_cast<int>(start_height - 1));
+        if (!filter_index->LookupFilterHeader(prev_block, prev_header)) {
+            LogPrint(BCLog::NET, "Failed to find block filter header in index: filter_type=%s, block_hash=%s\n",
+                     BlockFilterTypeName(filter_type), prev_block->GetBlockHash().ToString());
+            return;
+        }
+    }
+
+    std::vector<uint256> filter_hashes;
+    if (!filter_index->LookupFilterHashRange(start_height, stop_index, filter_hashes)) {
+        LogPrint(BCLog::NET, "Failed to find block filter hashes in index: filter_type=%s, start_height=%d, stop_hash=%s\n",
+                 BlockFilterTypeName(filter_type), start_height, stop_hash.ToString());
+        return;
+    }
+
+    connman->PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion())
+                         .Make(NetMsgType::CFHEADERS,
+                               filter_type_ser,
+                               stop_index->GetBlockHash(),
+                               prev_header,
+                               filter_hashes));
+}
+
+/**
+ * Handle a getcfcheckpt request.
+ *
+ * May disconnect from the peer in the case of a bad request.
+ *
+ * @param[in]   pfrom           The peer that we received the request from
+ * @param[in]   vRecv           The raw message received
+ * @param[in]   chain_params    Chain parameters
+ * @param[in]   connman         Pointer to the connection manager
+ */
+static void ProcessGetCFCheckPt(CNode* pfrom, CDataStream& vRecv, const CChainParams& chain_params,
+                                CConnman* connman)
+{
+    uint8_t filter_type_ser;
+    uint256 stop_hash;
+
+    vRecv >> filter_type_ser >> stop_hash;
+
+    const BlockFilterType filter_type = static_cast<BlockFilterType>(filter_type_ser);
+
+    const CBlockIndex* stop_index;
+    BlockFilterIndex* filter_index;
+    if (!PrepareBlockFilterRequest(pfrom, chain_params, filter_type, /*start_height=*/0, stop_hash,
+                                   /*max_height_diff=*/std::numeric_limits<uint32_t>::max(),
+                                   stop_index, filter_index)) {
+        return;
+    }
+
+    std::vector<uint256> headers(stop_index->nHeight / CFCHECKPT_INTERVAL);
+
+    // Populate headers.
+    const CBlockIndex* block_index = stop_index;
+    for (int i = headers.size() - 1; i >= 0; i--) {
+        int height = (i + 1) * CFCHECKPT_INTERVAL;
+        block_index = block_index->GetAncestor(height);
+
+        if (!filter_index->LookupFilterHeader(block_index, headers[i])) {
+            LogPrint(BCLog::NET, "Failed to find block filter header in index: filter_type=%s, block_hash=%s\n",
+                     BlockFilterTypeName(filter_type), block_index->GetBlockHash().ToString());
+            return;
+        }
+    }
+
+    connman->PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion())
+                         .Make(NetMsgType::CFCHECKPT,
+                               filter_type_ser,
+                               stop_index->GetBlockHash(),
+                               headers));
+}
+
 bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc, bool enable_bip61)
 {
     LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->GetId());
@@ -2303,6 +2673,21 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         return false;
     }
 
+    if (strCommand == NetMsgType::COMPRESSED) {
+        // Only peers we offered NODE_COMPRESSED to may wrap their messages
+        const size_t nCompressedSize = vRecv.size();
+        std::string strWrappedCommand;
+        CDataStream vWrapped(vRecv.GetType(), vRecv.GetVersion());
+        if (!(pfrom->GetLocalServices() & NODE_COMPRESSED) || !DecompressNetMessage(vRecv, strWrappedCommand, vWrapped)) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 100, strprintf("invalid compressed message peer=%d", pfrom->GetId()));
+            return false;
+        }
+        pfrom->nCompressedBytesRecv += nCompressedSize;
+        pfrom->nCompressedRawBytesRecv += vWrapped.size();
+        return ProcessMessage(pfrom, strWrappedCommand, vWrapped, nTimeReceived, chainparams, connman, interruptMsgProc, enable_bip61);
+    }
+
     if (strCommand == NetMsgType::ADDR) {
         std::vector<CAddress> vAddr;
         vRecv >> vAddr;
@@ -2578,11 +2963,11 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             return true;
         }
 
-        CBlock block;
-        bool ret = ReadBlockFromDisk(block, pindex, chainparams.GetConsensus());
+        std::shared_ptr<const CBlock> pblock;
+        bool ret = ReadBlockFromDisk(pblock, pindex, chainparams.GetConsensus());
         assert(ret);
 
-        SendBlockTransactions(block, req, pfrom, connman);
+        SendBlockTransactions(*pblock, req, pfrom, connman);
         return true;
     }
 
@@ -2683,9 +3068,22 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
         std::list<CTransactionRef> lRemovedTxn;
 
+        // Contract txs of a peer whose txs took too much execution time recently are dropped without validation
+        const int64_t nPeerExecLimit = pfrom->HasPermission(PF_RELAY) ? 0 : gArgs.GetArg("-maxpeerexectime", DEFAULT_MAX_PEER_EXEC_TIME) * 1000;
+        if (tx.HasCreateOrCall() && nodestate->m_exec_time.IsFull(nPeerExecLimit, GetTimeMicros())) {
+            LogPrint(BCLog::MEMPOOL, "ignoring contract tx %s from peer=%d over the execution time limit\n", tx.GetHash().ToString(), pfrom->GetId());
+            return true;
+        }
+
         if (!AlreadyHave(inv) &&
             AcceptToMemoryPool(mempool, state, ptx, &fMissingInputs, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */)) {
             mempool.check(&::ChainstateActive().CoinsTip());
+            if (tx.HasCreateOrCall()) {
+                LOCK(mempool.cs);
+                CTxMemPool::txiter it = mempool.mapTx.find(tx.GetHash());
+                if (it != mempool.mapTx.end())
+                    nodestate->m_exec_time.Add(GetContractExecCost(it->GetExecTime(), it->GetGasLimit()), nPeerExecLimit, GetTimeMicros());
+            }
             RelayTransaction(tx.GetHash(), *connman);
             for (unsigned int i = 0; i < tx.vout.size(); i++) {
                 auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(inv.hash, i));
@@ -3375,6 +3773,21 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         return true;
     }
 
+    if (strCommand == NetMsgType::GETCFILTERS) {
+        ProcessGetCFilters(pfrom, vRecv, chainparams, connman);
+        return true;
+    }
+
+    if (strCommand == NetMsgType::GETCFHEADERS) {
+        ProcessGetCFHeaders(pfrom, vRecv, chainparams, connman);
+        return true;
+    }
+
+    if (strCommand == NetMsgType::GETCFCHECKPT) {
+        ProcessGetCFCheckPt(pfrom, vRecv, chainparams, connman);
+        return true;
+    }
+
     if (strCommand == NetMsgType::NOTFOUND) {
         // Remove the NOTFOUND transactions from the peer
         LOCK(cs_main);
@@ -3453,9 +3866,10 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     //  (x) data
     //
     bool fMoreWork = false;
+    bool fGetDataReady = true;
 
     if (!pfrom->vRecvGetData.empty())
-        ProcessGetData(pfrom, chainparams, connman, interruptMsgProc);
+        fGetDataReady = ProcessGetData(pfrom, chainparams, connman, interruptMsgProc);
 
     if (!pfrom->orphan_work_set.empty()) {
         std::list<CTransactionRef> removed_txn;
@@ -3470,8 +3884,9 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         return false;
 
     // this maintains the order of responses
-    // and prevents vRecvGetData to grow unbounded
-    if (!pfrom->vRecvGetData.empty()) return true;
+    // and prevents vRecvGetData to grow unbounded, a deferred block
+    // is retried by the next wake-up of the message handler
+    if (!pfrom->vRecvGetData.empty()) return fGetDataReady;
     if (!pfrom->orphan_work_set.empty()) return true;
 
     // Don't bother if send buffer is too full to respond anyway
@@ -3899,10 +4314,10 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                         }
                     }
                     if (!fGotBlockFromCache) {
-                        CBlock block;
-                        bool ret = ReadBlockFromDisk(block, pBestIndex, consensusParams);
+                        std::shared_ptr<const CBlock> pblock;
+                        bool ret = ReadBlockFromDisk(pblock, pBestIndex, consensusParams);
                         assert(ret);
-                        CBlockHeaderAndShortTxIDs cmpctblock(block, state.fWantsCmpctWitness);
+                        CBlockHeaderAndShortTxIDs cmpctblock(*pblock, state.fWantsCmpctWitness);
                         connman->PushMessage(pto, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
                     }
                     state.pindexBestHeaderSent = pBestIndex;
@@ -22,6 +22,8 @@ static const unsigned int DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN = 100;
 /** Default for BIP61 (sending reject messages) */
 static constexpr bool DEFAULT_ENABLE_BIP61{false};
 static const bool DEFAULT_PEERBLOOMFILTERS = false;
+static const bool DEFAULT_PEERBLOCKFILTERS = false;
+static const bool DEFAULT_PEERCOMPRESSION = false;
 /** Default maximum orphan blocks */
 static const unsigned int DEFAULT_MAX_ORPHAN_BLOCKS = 40;
 /** Default for -headerspamfilter, use header spam filter */
@@ -51,6 +53,10 @@ public:
      * Overridden from CValidationInterface.
      */
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted) override;
+    /**
+     * Overridden from CValidationInterface.
+     */
+    void BlockDisconnected(const std::shared_ptr<const CBlock> &block) override;
     /**
      * Overridden from CValidationInterface.
      */
@@ -0,0 +1,77 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
+#include <netcompression.h>
+
+#include <consensus/consensus.h>
+#include <protocol.h>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+bool CanCompressNetMessages()
+{
+#ifdef USE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool IsCompressibleNetMessage(const std::string& command)
+{
+    return command == NetMsgType::BLOCK || command == NetMsgType::BLOCKTXN || command == NetMsgType::TX;
+}
+
+bool CompressNetMessage(CSerializedNetMsg& msg)
+{
+#ifdef USE_ZLIB
+    if (msg.data.size() < MIN_COMPRESSED_MESSAGE_SIZE || !IsCompressibleNetMessage(msg.command)) {
+        return false;
+    }
+    // The wrapped command and its payload size, then the compressed payload up to the end of the message
+    std::vector<unsigned char> data;
+    CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, data, 0, msg.command, (uint32_t)msg.data.size()};
+    const size_t header_size = data.size();
+    uLongf compressed_size = compressBound(msg.data.size());
+    data.resize(header_size + compressed_size);
+    if (compress2(data.data() + header_size, &compressed_size, msg.data.data(), msg.data.size(), Z_BEST_SPEED) != Z_OK ||
+        header_size + compressed_size >= msg.data.size()) {
+        return false;
+    }
+    data.resize(header_size + compressed_size);
+    msg.data = std::move(data);
+    msg.command = NetMsgType::COMPRESSED;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool DecompressNetMessage(CDataStream& vRecv, std::string& command, CDataStream& payload)
+{
+#ifdef USE_ZLIB
+    uint32_t size;
+    vRecv >> LIMITED_STRING(command, CMessageHeader::COMMAND_SIZE) >> size;
+    if (!IsCompressibleNetMessage(command) || size > dgpMaxProtoMsgLength) {
+        return false;
+    }
+    // The declared size bounds the output, a payload that expands any further fails
+    payload.resize(size);
+    uLongf decompressed_size = size;
+    if (uncompress((Bytef*)payload.data(), &decompressed_size, (const Bytef*)vRecv.data(), vRecv.size()) != Z_OK ||
+        decompressed_size != size) {
+        return false;
+    }
+    vRecv.clear();
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,36 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NETCOMPRESSION_H
+#define BITCOIN_NETCOMPRESSION_H
+
+#include <net.h>
+#include <streams.h>
+
+#include <string>
+
+/** Smallest payload sent compressed, smaller ones gain too little for the work */
+static const size_t MIN_COMPRESSED_MESSAGE_SIZE = 1024;
+
+/** Whether this build can compress and decompress P2P messages */
+bool CanCompressNetMessages();
+
+/** Whether messages of this command are compressed for peers offering NODE_COMPRESSED */
+bool IsCompressibleNetMessage(const std::string& command);
+
+/**
+ * Replace msg by a compressed message wrapping it. msg is left alone, and false
+ * returned, when its command is not compressible, it is too small or it would
+ * not get smaller.
+ */
+bool CompressNetMessage(CSerializedNetMsg& msg);
+
+/**
+ * Unwrap the payload of a compressed message into the command and payload of
+ * the message it wraps. False when it is malformed, wraps a command that is
+ * not compressible or would expand beyond the maximum message size.
+ */
+bool DecompressNetMessage(CDataStream& vRecv, std::string& command, CDataStream& payload);
+
+#endif // BITCOIN_NETCOMPRESSION_H
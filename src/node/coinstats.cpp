@@ -8,70 +8,281 @@
 #include <amount.h>
 #include <coins.h>
 #include <chain.h>
+#include <crypto/muhash.h>
 #include <hash.h>
 #include <serialize.h>
+#include <streams.h>
+#include <sync.h>
+#include <txdb.h>
 #include <validation.h>
 #include <uint256.h>
 #include <util/system.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <map>
+#include <thread>
 
 #include <boost/thread.hpp>
 
+/** Number of txid ranges the coin set is read in, by the first 12 bits of the txid */
+static constexpr int UTXO_STATS_RANGES = 4096;
+/** Maximum number of threads reading the coin set */
+static constexpr int MAX_UTXO_STATS_THREADS = 8;
+/** Ranges read ahead of the one being hashed, bounds the memory held for hash_serialized_2 */
+static constexpr int UTXO_STATS_READ_AHEAD = 64;
 
-static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
+uint64_t GetBogoSize(const CScript& script_pub_key)
+{
+    return 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
+           2 /* scriptPubKey len */ + script_pub_key.size() /* scriptPubKey */;
+}
+
+bool IsContractOutput(const CScript& script_pub_key)
+{
+    return script_pub_key.HasOpCall() || script_pub_key.HasOpCreate();
+}
+
+template <typename T>
+static void TxOutSer(T& ss, const COutPoint& outpoint, const Coin& coin)
+{
+    ss << outpoint;
+    ss << static_cast<uint32_t>((coin.nHeight << 2) + (coin.fCoinStake ? 2u : 0u) + (coin.fCoinBase ? 1u : 0u));
+    ss << coin.out;
+}
+
+void ApplyCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin)
+{
+    std::vector<unsigned char> data;
+    CVectorWriter writer(SER_DISK, PROTOCOL_VERSION, data, 0);
+    TxOutSer(writer, outpoint, coin);
+    muhash.Insert(Span<const unsigned char>(data.data(), data.size()));
+}
+
+void RemoveCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin)
+{
+    std::vector<unsigned char> data;
+    CVectorWriter writer(SER_DISK, PROTOCOL_VERSION, data, 0);
+    TxOutSer(writer, outpoint, coin);
+    muhash.Remove(Span<const unsigned char>(data.data(), data.size()));
+}
+
+static void ApplyHash(CVectorWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
 {
-    assert(!outputs.empty());
     ss << hash;
     ss << VARINT((outputs.begin()->second.nHeight << 2) + (outputs.begin()->second.fCoinBase ? 1u : 0u) + (outputs.begin()->second.fCoinStake ? 2u : 0u));
-    stats.nTransactions++;
     for (const auto& output : outputs) {
         ss << VARINT(output.first + 1);
         ss << *(const CScriptBase*)(&output.second.out.scriptPubKey);
         ss << VARINT(output.second.out.nValue, VarIntMode::NONNEGATIVE_SIGNED);
+    }
+    ss << VARINT(0u);
+}
+
+static void ApplyHash(MuHash3072& muhash, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
+{
+    for (const auto& output : outputs) {
+        ApplyCoinHash(muhash, COutPoint(hash, output.first), output.second);
+    }
+}
+
+static void ApplyHash(std::nullptr_t, const uint256& hash, const std::map<uint32_t, Coin>& outputs) {}
+
+template <typename T>
+static void ApplyStats(CCoinsStats &stats, T& hash_obj, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
+{
+    assert(!outputs.empty());
+    ApplyHash(hash_obj, hash, outputs);
+    stats.nTransactions++;
+    for (const auto& output : outputs) {
         stats.nTransactionOutputs++;
         stats.nTotalAmount += output.second.out.nValue;
-        stats.nBogoSize += 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
-                           2 /* scriptPubKey len */ + output.second.out.scriptPubKey.size() /* scriptPubKey */;
+        stats.nBogoSize += GetBogoSize(output.second.out.scriptPubKey);
+        if (IsContractOutput(output.second.out.scriptPubKey)) {
+            stats.nContractOutputs++;
+            stats.nContractAmount += output.second.out.nValue;
+        }
     }
-    ss << VARINT(0u);
 }
 
+static int TxidRange(const uint256& txid)
+{
+    return (txid.begin()[0] << 4) | (txid.begin()[1] >> 4);
+}
+
+/** Read the coins of a txid range. Stops early once interrupt is set, returns false on a read error. */
+template <typename T>
+static bool ReadRange(CCoinsViewDBCursor& cursor, int range, CCoinsStats& stats, T& hash_obj, const std::atomic<bool>& interrupt)
+{
+    uint256 start;
+    start.begin()[0] = range >> 4;
+    start.begin()[1] = (range & 0xf) << 4;
+    cursor.Seek(COutPoint(start, 0));
+
+    uint256 prevkey;
+    std::map<uint32_t, Coin> outputs;
+    for (; cursor.Valid() && !interrupt; cursor.Next()) {
+        COutPoint key;
+        Coin coin;
+        if (!cursor.GetKey(key) || !cursor.GetValue(coin)) {
+            return error("%s: unable to read value", __func__);
+        }
+        if (TxidRange(key.hash) != range) {
+            break;
+        }
+        if (!outputs.empty() && key.hash != prevkey) {
+            ApplyStats(stats, hash_obj, prevkey, outputs);
+            outputs.clear();
+        }
+        prevkey = key.hash;
+        outputs[key.n] = std::move(coin);
+    }
+    if (!outputs.empty()) {
+        ApplyStats(stats, hash_obj, prevkey, outputs);
+    }
+    return true;
+}
+
+namespace {
+
+/** What a worker read from one txid range, taken over by GetUTXOStats in range order */
+struct RangeStats {
+    CCoinsStats stats;
+    //! The part of the hash_serialized_2 stream of the range
+    std::vector<unsigned char> serialized;
+    MuHash3072 muhash;
+};
+
+} // namespace
+
 //! Calculate statistics about the unspent transaction output set
-bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
+//!
+//! The coin set is split into ranges of txids which are read by several threads
+//! from one snapshot of the database. hash_serialized_2 hashes the coins in key
+//! order, so the serialized ranges are hashed one after the other as they come in,
+//! while the MuHash of each range is simply multiplied in.
+bool GetUTXOStats(CCoinsViewDB* view, CCoinsStats& stats, CoinStatsHashType hash_type)
 {
-    std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor());
-    assert(pcursor);
+    const int n_threads = std::max(1, std::min(GetNumCores(), MAX_UTXO_STATS_THREADS));
+    std::vector<std::unique_ptr<CCoinsViewDBCursor>> cursors = view->Cursors(n_threads);
 
-    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    stats.hashBlock = pcursor->GetBestBlock();
+    stats.hashBlock = cursors[0]->GetBestBlock();
     {
         LOCK(cs_main);
         stats.nHeight = LookupBlockIndex(stats.hashBlock)->nHeight;
     }
+
+    Mutex mutex;
+    std::condition_variable cond;
+    std::vector<std::unique_ptr<RangeStats>> ranges(UTXO_STATS_RANGES);
+    int next_range = 0;
+    int hashed_ranges = 0;
+    bool failed = false;
+    std::atomic<bool> interrupt{false};
+
+    auto read_ranges = [&](CCoinsViewDBCursor& cursor) {
+        while (true) {
+            int range;
+            {
+                WAIT_LOCK(mutex, lock);
+                cond.wait(lock, [&] { return interrupt || next_range == UTXO_STATS_RANGES || next_range < hashed_ranges + UTXO_STATS_READ_AHEAD; });
+                if (interrupt || next_range == UTXO_STATS_RANGES) return;
+                range = next_range++;
+            }
+
+            std::unique_ptr<RangeStats> range_stats = MakeUnique<RangeStats>();
+            bool ok = false;
+            switch (hash_type) {
+            case CoinStatsHashType::HASH_SERIALIZED: {
+                CVectorWriter writer(SER_GETHASH, PROTOCOL_VERSION, range_stats->serialized, 0);
+                ok = ReadRange(cursor, range, range_stats->stats, writer, interrupt);
+                break;
+            }
+            case CoinStatsHashType::MUHASH:
+                ok = ReadRange(cursor, range, range_stats->stats, range_stats->muhash, interrupt);
+                break;
+            case CoinStatsHashType::NONE: {
+                std::nullptr_t none = nullptr;
+                ok = ReadRange(cursor, range, range_stats->stats, none, interrupt);
+                break;
+            }
+            } // no default case, so the compiler can warn about missing cases
+
+            {
+                LOCK(mutex);
+                if (ok) {
+                    ranges[range] = std::move(range_stats);
+                } else {
+                    failed = true;
+                    interrupt = true;
+                }
+            }
+            cond.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    auto stop_threads = [&] {
+        {
+            LOCK(mutex);
+            interrupt = true;
+        }
+        cond.notify_all();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    };
+
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
     ss << stats.hashBlock;
-    uint256 prevkey;
-    std::map<uint32_t, Coin> outputs;
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        COutPoint key;
-        Coin coin;
-        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
-            if (!outputs.empty() && key.hash != prevkey) {
-                ApplyStats(stats, ss, prevkey, outputs);
-                outputs.clear();
+    MuHash3072 muhash;
+    try {
+        for (const auto& cursor : cursors) {
+            threads.emplace_back(read_ranges, std::ref(*cursor));
+        }
+        for (int range = 0; range < UTXO_STATS_RANGES; ++range) {
+            std::unique_ptr<RangeStats> range_stats;
+            while (!range_stats) {
+                boost::this_thread::interruption_point();
+                WAIT_LOCK(mutex, lock);
+                if (failed) break;
+                if (ranges[range]) {
+                    range_stats = std::move(ranges[range]);
+                    hashed_ranges = range + 1;
+                } else {
+                    cond.wait_for(lock, std::chrono::milliseconds(100));
+                }
+            }
+            if (!range_stats) break;
+            cond.notify_all();
+
+            stats.nTransactions += range_stats->stats.nTransactions;
+            stats.nTransactionOutputs += range_stats->stats.nTransactionOutputs;
+            stats.nBogoSize += range_stats->stats.nBogoSize;
+            stats.nTotalAmount += range_stats->stats.nTotalAmount;
+            stats.nContractOutputs += range_stats->stats.nContractOutputs;
+            stats.nContractAmount += range_stats->stats.nContractAmount;
+            if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+                ss.write((const char*)range_stats->serialized.data(), range_stats->serialized.size());
+            } else if (hash_type == CoinStatsHashType::MUHASH && range_stats->stats.nTransactionOutputs) {
+                muhash *= range_stats->muhash;
             }
-            prevkey = key.hash;
-            outputs[key.n] = std::move(coin);
-        } else {
-            return error("%s: unable to read value", __func__);
         }
-        pcursor->Next();
+    } catch (...) {
+        stop_threads();
+        throw;
     }
-    if (!outputs.empty()) {
-        ApplyStats(stats, ss, prevkey, outputs);
+    stop_threads();
+    if (failed) {
+        return false;
+    }
+
+    if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+        stats.hashSerialized = ss.GetHash();
+    } else if (hash_type == CoinStatsHashType::MUHASH) {
+        muhash.Finalize(stats.hashSerialized);
     }
-    stats.hashSerialized = ss.GetHash();
     stats.nDiskSize = view->EstimateSize();
     return true;
 }
@@ -11,7 +11,17 @@
 
 #include <cstdint>
 
-class CCoinsView;
+class CCoinsViewDB;
+class Coin;
+class COutPoint;
+class CScript;
+class MuHash3072;
+
+enum class CoinStatsHashType {
+    HASH_SERIALIZED,
+    MUHASH,
+    NONE,
+};
 
 struct CCoinsStats
 {
@@ -20,14 +30,28 @@ struct CCoinsStats
     uint64_t nTransactions;
     uint64_t nTransactionOutputs;
     uint64_t nBogoSize;
+    //! The hash of the kind asked for, hash_serialized_2 or the MuHash of the coins
     uint256 hashSerialized;
     uint64_t nDiskSize;
     CAmount nTotalAmount;
+    //! Outputs held by contracts, the coins the EVM UTXO trie points at
+    uint64_t nContractOutputs;
+    CAmount nContractAmount;
 
-    CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nBogoSize(0), nDiskSize(0), nTotalAmount(0) {}
+    CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nBogoSize(0), nDiskSize(0), nTotalAmount(0), nContractOutputs(0), nContractAmount(0) {}
 };
 
 //! Calculate statistics about the unspent transaction output set
-bool GetUTXOStats(CCoinsView* view, CCoinsStats& stats);
+bool GetUTXOStats(CCoinsViewDB* view, CCoinsStats& stats, CoinStatsHashType hash_type = CoinStatsHashType::HASH_SERIALIZED);
+
+//! The bogosize of an unspent output with the given script
+uint64_t GetBogoSize(const CScript& script_pub_key);
+
+//! Whether an output with the given script is held by a contract
+bool IsContractOutput(const CScript& script_pub_key);
+
+//! Add the coin to the MuHash of a coin set, or take it away
+void ApplyCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin);
+void RemoveCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin);
 
 #endif // BITCOIN_NODE_COINSTATS_H
@@ -0,0 +1,70 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_UTXO_SNAPSHOT_H
+#define BITCOIN_NODE_UTXO_SNAPSHOT_H
+
+#include <serialize.h>
+#include <uint256.h>
+
+#include <cstdint>
+
+//! Version of the snapshot file format written by dumptxoutset.
+static const uint32_t SNAPSHOT_VERSION = 1;
+
+/**
+ * Metadata describing a serialized version of a UTXO set from which a node can be
+ * bootstrapped. Besides the base block, it commits to the EVM account and UTXO
+ * trie roots of that block, so the contract state the coins belong to can be
+ * checked against the snapshot.
+ */
+class SnapshotMetadata
+{
+public:
+    uint32_t m_version = SNAPSHOT_VERSION;
+
+    //! The hash of the block that reflects the tip of the chain for the
+    //! UTXO set contained in this snapshot.
+    uint256 m_base_blockhash;
+
+    //! The number of coins in the UTXO set contained in this snapshot. Used
+    //! during snapshot load to estimate progress of UTXO set reconstruction.
+    uint64_t m_coins_count = 0;
+
+    //! Necessary to "fake" the base nChainTx so that we can estimate progress during
+    //! initial block download for the assumeutxo chainstate.
+    unsigned int m_nchaintx = 0;
+
+    //! hashStateRoot and hashUTXORoot of the base block.
+    uint256 m_hash_state_root;
+    uint256 m_hash_utxo_root;
+
+    SnapshotMetadata() { }
+    SnapshotMetadata(
+        const uint256& base_blockhash,
+        uint64_t coins_count,
+        unsigned int nchaintx,
+        const uint256& hash_state_root,
+        const uint256& hash_utxo_root) :
+            m_base_blockhash(base_blockhash),
+            m_coins_count(coins_count),
+            m_nchaintx(nchaintx),
+            m_hash_state_root(hash_state_root),
+            m_hash_utxo_root(hash_utxo_root) { }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(m_version);
+        READWRITE(m_base_blockhash);
+        READWRITE(m_coins_count);
+        READWRITE(m_nchaintx);
+        READWRITE(m_hash_state_root);
+        READWRITE(m_hash_utxo_root);
+    }
+};
+
+#endif // BITCOIN_NODE_UTXO_SNAPSHOT_H
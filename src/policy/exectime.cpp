@@ -0,0 +1,77 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <policy/exectime.h>
+
+#include <algorithm>
+
+SenderExecTimeLimits g_sender_exec_time;
+
+int64_t GetContractExecCost(int64_t nExecTime, uint64_t nGasLimit)
+{
+    return std::max(nExecTime, (int64_t)(nGasLimit / EXPECTED_GAS_PER_EXEC_MICRO));
+}
+
+void ExecTimeBucket::Drain(int64_t nLimit, int64_t nNow)
+{
+    if (nNow > m_last) {
+        int64_t nDrained = (int64_t)((double)(nNow - m_last) * nLimit / (60 * 1000000));
+        m_level = std::max<int64_t>(0, m_level - nDrained);
+        m_last = nNow;
+    }
+}
+
+bool ExecTimeBucket::IsFull(int64_t nLimit, int64_t nNow)
+{
+    if (nLimit <= 0) return false;
+    Drain(nLimit, nNow);
+    return m_level >= nLimit;
+}
+
+void ExecTimeBucket::Add(int64_t nCost, int64_t nLimit, int64_t nNow)
+{
+    if (nLimit <= 0) return;
+    Drain(nLimit, nNow);
+    m_level += nCost;
+}
+
+bool SenderExecTimeLimits::IsFull(const uint160& sender, int64_t nLimit, int64_t nNow)
+{
+    LOCK(m_mutex);
+    auto it = m_buckets.find(sender);
+    return it != m_buckets.end() && it->second.IsFull(nLimit, nNow);
+}
+
+void SenderExecTimeLimits::Add(const uint160& sender, int64_t nCost, int64_t nLimit, int64_t nNow)
+{
+    if (nLimit <= 0) return;
+    LOCK(m_mutex);
+    auto it = m_buckets.find(sender);
+    if (it == m_buckets.end()) {
+        if (m_buckets.size() >= MAX_EXEC_TIME_SENDERS) {
+            // Forget the senders whose buckets drained, then the one with the least time left in its bucket
+            for (auto drained = m_buckets.begin(); drained != m_buckets.end();) {
+                drained->second.IsFull(nLimit, nNow);
+                if (drained->second.GetLevel() == 0) {
+                    drained = m_buckets.erase(drained);
+                } else {
+                    ++drained;
+                }
+            }
+            if (m_buckets.size() >= MAX_EXEC_TIME_SENDERS) {
+                m_buckets.erase(std::min_element(m_buckets.begin(), m_buckets.end(), [](const std::pair<const uint160, ExecTimeBucket>& a, const std::pair<const uint160, ExecTimeBucket>& b) {
+                    return a.second.GetLevel() < b.second.GetLevel();
+                }));
+            }
+        }
+        it = m_buckets.emplace(sender, ExecTimeBucket()).first;
+    }
+    it->second.Add(nCost, nLimit, nNow);
+}
+
+void SenderExecTimeLimits::Clear()
+{
+    LOCK(m_mutex);
+    m_buckets.clear();
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_POLICY_EXECTIME_H
+#define BITCOIN_POLICY_EXECTIME_H
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <map>
+#include <stdint.h>
+
+/** Gas a contract execution is expected to burn per microsecond. It estimates the execution time of
+ *  the contracts that were not executed yet, and the ones observed to run slower are evicted first. */
+static const uint64_t EXPECTED_GAS_PER_EXEC_MICRO = 10;
+/** Default for -maxsenderexectime, milliseconds of contract execution the txs of one sender may add to the mempool per minute */
+static const int64_t DEFAULT_MAX_SENDER_EXEC_TIME = 10000;
+/** Default for -maxpeerexectime, milliseconds of contract execution the txs relayed by one peer may add to the mempool per minute */
+static const int64_t DEFAULT_MAX_PEER_EXEC_TIME = 30000;
+/** Maximum number of senders whose execution time is tracked */
+static const size_t MAX_EXEC_TIME_SENDERS = 10000;
+
+/** Execution cost in microseconds of contracts observed to run for nExecTime microseconds (0 when they were
+ *  not executed yet), or the time their gas limit is expected to take when that is longer */
+int64_t GetContractExecCost(int64_t nExecTime, uint64_t nGasLimit);
+
+/**
+ * Leaky bucket of contract execution time in microseconds, which drains at the limit
+ * per minute. It is full once it holds a minute worth of execution time, the cost
+ * that filled it is still accepted so a single expensive tx is never refused.
+ */
+class ExecTimeBucket
+{
+public:
+    /** Whether the bucket is full at nNow microseconds for a limit of nLimit microseconds per minute */
+    bool IsFull(int64_t nLimit, int64_t nNow);
+    void Add(int64_t nCost, int64_t nLimit, int64_t nNow);
+    int64_t GetLevel() const { return m_level; }
+    int64_t GetLastTime() const { return m_last; }
+
+private:
+    void Drain(int64_t nLimit, int64_t nNow);
+
+    int64_t m_level{0};
+    int64_t m_last{0};
+};
+
+/** Execution time buckets of the contract tx senders, which limit the execution time a sender adds to the mempool */
+class SenderExecTimeLimits
+{
+public:
+    bool IsFull(const uint160& sender, int64_t nLimit, int64_t nNow);
+    void Add(const uint160& sender, int64_t nCost, int64_t nLimit, int64_t nNow);
+    void Clear();
+
+private:
+    Mutex m_mutex;
+    std::map<uint160, ExecTimeBucket> m_buckets GUARDED_BY(m_mutex);
+};
+
+extern SenderExecTimeLimits g_sender_exec_time;
+
+#endif // BITCOIN_POLICY_EXECTIME_H
@@ -482,6 +482,9 @@ bool CBlockPolicyEstimator::removeTx(uint256 hash, bool inBlock)
         feeStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
         shortStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
         longStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
+        if (pos->second.gasTracked) {
+            gasStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.gasBucketIndex, inBlock);
+        }
         mapMemPoolTxs.erase(hash);
         return true;
     } else {
@@ -505,6 +508,17 @@ CBlockPolicyEstimator::CBlockPolicyEstimator()
     feeStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
     shortStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, SHORT_BLOCK_PERIODS, SHORT_DECAY, SHORT_SCALE));
     longStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, LONG_BLOCK_PERIODS, LONG_DECAY, LONG_SCALE));
+
+    size_t gasBucketIndex = 0;
+    for (double bucketBoundary = MIN_BUCKET_GASPRICE; bucketBoundary <= MAX_BUCKET_GASPRICE; bucketBoundary *= FEE_SPACING, gasBucketIndex++) {
+        gasBuckets.push_back(bucketBoundary);
+        gasBucketMap[bucketBoundary] = gasBucketIndex;
+    }
+    gasBuckets.push_back(INF_FEERATE);
+    gasBucketMap[INF_FEERATE] = gasBucketIndex;
+    assert(gasBucketMap.size() == gasBuckets.size());
+
+    gasStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(gasBuckets, gasBucketMap, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
 }
 
 CBlockPolicyEstimator::~CBlockPolicyEstimator()
@@ -548,6 +562,12 @@ void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, boo
     assert(bucketIndex == bucketIndex2);
     unsigned int bucketIndex3 = longStats->NewTx(txHeight, (double)feeRate.GetFeePerK());
     assert(bucketIndex == bucketIndex3);
+
+    // Contract transactions are also tracked by the gas price they pay
+    if (entry.GetTx().HasCreateOrCall() && entry.GetMinGasPrice() > 0) {
+        mapMemPoolTxs[hash].gasTracked = true;
+        mapMemPoolTxs[hash].gasBucketIndex = gasStats->NewTx(txHeight, (double)entry.GetMinGasPrice());
+    }
 }
 
 bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry)
@@ -557,11 +577,6 @@ bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxM
         return false;
     }
 
-    if(entry->GetTx().HasCreateOrCall()){
-    	//Exclude contract transactions
-    	return false;
-    }
-
     // How many blocks did it take for miners to include this transaction?
     // blocksToConfirm is 1-based, so a transaction included in the earliest
     // possible block has confirmation count of 1
@@ -573,6 +588,14 @@ bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxM
         return false;
     }
 
+    if(entry->GetTx().HasCreateOrCall()){
+        //Contract transactions are only counted for the gas price, they are not ordered by feerate
+        if (entry->GetMinGasPrice() > 0) {
+            gasStats->Record(blocksToConfirm, (double)entry->GetMinGasPrice());
+        }
+        return false;
+    }
+
     // Feerates are stored and reported as BTC-per-kb:
     CFeeRate feeRate(entry->GetFee(), entry->GetTxSize());
 
@@ -604,11 +627,13 @@ void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
     feeStats->ClearCurrent(nBlockHeight);
     shortStats->ClearCurrent(nBlockHeight);
     longStats->ClearCurrent(nBlockHeight);
+    gasStats->ClearCurrent(nBlockHeight);
 
     // Decay all exponential averages
     feeStats->UpdateMovingAverages();
     shortStats->UpdateMovingAverages();
     longStats->UpdateMovingAverages();
+    gasStats->UpdateMovingAverages();
 
     unsigned int countedTxs = 0;
     // Update averages with data points from current block
@@ -697,6 +722,30 @@ unsigned int CBlockPolicyEstimator::HighestTargetTracked(FeeEstimateHorizon hori
     }
 }
 
+unsigned int CBlockPolicyEstimator::HighestGasTargetTracked() const
+{
+    LOCK(m_cs_fee_estimator);
+    return gasStats->GetMaxConfirms();
+}
+
+CAmount CBlockPolicyEstimator::estimateGasPrice(int confTarget, int *returnedTarget) const
+{
+    LOCK(m_cs_fee_estimator);
+    if (returnedTarget) *returnedTarget = 0;
+    if (confTarget <= 0)
+        return 0;
+
+    unsigned int maxTarget = std::min(gasStats->GetMaxConfirms(), std::max(BlockSpan(), HistoricalBlockSpan()));
+    for (unsigned int target = std::min((unsigned int)confTarget, maxTarget); target > 0 && target <= maxTarget; target++) {
+        double median = gasStats->EstimateMedianVal(target, SUFFICIENT_GASTXS, SUCCESS_PCT, true, nBestSeenHeight);
+        if (median >= 0) {
+            if (returnedTarget) *returnedTarget = target;
+            return llround(median);
+        }
+    }
+    return 0;
+}
+
 unsigned int CBlockPolicyEstimator::BlockSpan() const
 {
     if (firstRecordedHeight == 0) return 0;
@@ -884,6 +933,9 @@ bool CBlockPolicyEstimator::Write(CAutoFile& fileout) const
         feeStats->Write(fileout);
         shortStats->Write(fileout);
         longStats->Write(fileout);
+        // Appended after the feerate stats, so older versions still read the file
+        fileout << gasBuckets;
+        gasStats->Write(fileout);
     }
     catch (const std::exception&) {
         LogPrintf("CBlockPolicyEstimator::Write(): unable to write policy estimator data (non-fatal)\n");
@@ -927,6 +979,19 @@ bool CBlockPolicyEstimator::Read(CAutoFile& filein)
             fileShortStats->Read(filein, nVersionThatWrote, numBuckets);
             fileLongStats->Read(filein, nVersionThatWrote, numBuckets);
 
+            // Files written before gas prices were tracked end here
+            std::unique_ptr<TxConfirmStats> fileGasStats;
+            try {
+                std::vector<double> fileGasBuckets;
+                filein >> fileGasBuckets;
+                if (fileGasBuckets == gasBuckets) {
+                    fileGasStats.reset(new TxConfirmStats(gasBuckets, gasBucketMap, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
+                    fileGasStats->Read(filein, nVersionThatWrote, gasBuckets.size());
+                }
+            } catch (const std::exception&) {
+                fileGasStats.reset();
+            }
+
             // Fee estimates file parsed correctly
             // Copy buckets from file and refresh our bucketmap
             buckets = fileBuckets;
@@ -939,6 +1004,9 @@ bool CBlockPolicyEstimator::Read(CAutoFile& filein)
             feeStats = std::move(fileFeeStats);
             shortStats = std::move(fileShortStats);
             longStats = std::move(fileLongStats);
+            if (fileGasStats) {
+                gasStats = std::move(fileGasStats);
+            }
 
             nBestSeenHeight = nFileBestSeenHeight;
             historicalFirst = nFileHistoricalFirst;
@@ -179,6 +179,15 @@ private:
      */
     static constexpr double FEE_SPACING = 1.05;
 
+    /** Minimum and Maximum values for tracking the gas prices of contract transactions,
+     * in satoshis per gas. Bucket spacing is the same as for feerates.
+     */
+    static constexpr double MIN_BUCKET_GASPRICE = 1000;
+    static constexpr double MAX_BUCKET_GASPRICE = 1e6;
+
+    /** Require an avg of 0.1 contract tx in the combined gas price bucket per block */
+    static constexpr double SUFFICIENT_GASTXS = 0.1;
+
 public:
     /** Create new BlockPolicyEstimator and initialize stats tracking classes with default values */
     CBlockPolicyEstimator();
@@ -210,6 +219,17 @@ public:
      */
     CFeeRate estimateRawFee(int confTarget, double successThreshold, FeeEstimateHorizon horizon, EstimationResult *result = nullptr) const;
 
+    /** Estimate the gas price, in satoshis per gas, a contract transaction needs to be
+     *  included in a block within confTarget blocks. Contract transactions are ordered by
+     *  gas price in the block assembler, so they are tracked apart from the feerates.
+     *  If no answer can be given at confTarget, the closest higher target with an answer
+     *  is used and returned in returnedTarget. Returns 0 when there is no estimate.
+     */
+    CAmount estimateGasPrice(int confTarget, int *returnedTarget = nullptr) const;
+
+    /** Highest target that gas price estimates are tracked for */
+    unsigned int HighestGasTargetTracked() const;
+
     /** Write estimation data to a file */
     bool Write(CAutoFile& fileout) const;
 
@@ -234,7 +254,9 @@ private:
     {
         unsigned int blockHeight;
         unsigned int bucketIndex;
-        TxStatsInfo() : blockHeight(0), bucketIndex(0) {}
+        bool gasTracked;
+        unsigned int gasBucketIndex;
+        TxStatsInfo() : blockHeight(0), bucketIndex(0), gasTracked(false), gasBucketIndex(0) {}
     };
 
     // map of txids to information about that transaction
@@ -244,12 +266,16 @@ private:
     std::unique_ptr<TxConfirmStats> feeStats PT_GUARDED_BY(m_cs_fee_estimator);
     std::unique_ptr<TxConfirmStats> shortStats PT_GUARDED_BY(m_cs_fee_estimator);
     std::unique_ptr<TxConfirmStats> longStats PT_GUARDED_BY(m_cs_fee_estimator);
+    /** Confirmation history of contract transactions by gas price */
+    std::unique_ptr<TxConfirmStats> gasStats PT_GUARDED_BY(m_cs_fee_estimator);
 
     unsigned int trackedTxs GUARDED_BY(m_cs_fee_estimator);
     unsigned int untrackedTxs GUARDED_BY(m_cs_fee_estimator);
 
     std::vector<double> buckets GUARDED_BY(m_cs_fee_estimator); // The upper-bound of the range for the bucket (inclusive)
     std::map<double, unsigned int> bucketMap GUARDED_BY(m_cs_fee_estimator); // Map of bucket upper-bound to index into all vectors by bucket
+    std::vector<double> gasBuckets GUARDED_BY(m_cs_fee_estimator); // The upper-bound of the range for the gas price bucket (inclusive)
+    std::map<double, unsigned int> gasBucketMap GUARDED_BY(m_cs_fee_estimator); // Map of gas price bucket upper-bound to index
 
     /** Process a transaction confirmed in a block*/
     bool processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry) EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
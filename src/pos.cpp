@@ -3,17 +3,28 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+
 #include <boost/assign/list_of.hpp>
+#include <boost/thread.hpp>
 
 #include <pos.h>
 #include <txdb.h>
 #include <validation.h>
 #include <arith_uint256.h>
 #include <hash.h>
+#include <crypto/common.h>
+#include <crypto/sha256.h>
 #include <timedata.h>
 #include <chainparams.h>
 #include <script/sign.h>
 #include <consensus/consensus.h>
+#include <cuckoocache.h>
+#include <random.h>
+#include <script/sigcache.h>
 
 using namespace std;
 
@@ -51,11 +62,8 @@ uint256 ComputeStakeModifier(const CBlockIndex* pindexPrev, const uint256& kerne
 //   quantities so as to generate blocks faster, degrading the system back into
 //   a proof-of-work situation.
 //
-bool CheckStakeKernelHash(CBlockIndex* pindexPrev, unsigned int nBits, uint32_t blockFromTime, CAmount prevoutValue, const COutPoint& prevout, unsigned int nTimeBlock, uint256& hashProofOfStake, uint256& targetProofOfStake, bool fPrintProofOfStake)
+static arith_uint256 GetStakeKernelTarget(unsigned int nBits, CAmount prevoutValue, const COutPoint& prevout)
 {
-    if (nTimeBlock < blockFromTime)  // Transaction timestamp violation
-        return error("CheckStakeKernelHash() : nTime violation");
-
     // Base target
     arith_uint256 bnTarget;
     bnTarget.SetCompact(nBits);
@@ -70,6 +78,35 @@ bool CheckStakeKernelHash(CBlockIndex* pindexPrev, unsigned int nBits, uint32_t
     arith_uint256 bnWeight = arith_uint256(nValueIn);
     bnTarget *= bnWeight;
 
+    return bnTarget;
+}
+
+// The time of the block at nHeight below pindexPrev, the time the staked coin was created.
+// While pindexPrev is on the active chain it is read from the chain's time array instead of
+// walking the skip list.
+static bool GetBlockFromTime(const CBlockIndex* pindexPrev, int nHeight, uint32_t& blockFromTime)
+{
+    if (nHeight < 0 || nHeight > pindexPrev->nHeight)
+        return false;
+    LOCK(cs_main);
+    if (::ChainActive().Contains(pindexPrev)) {
+        blockFromTime = ::ChainActive().TimeAt(nHeight);
+        return true;
+    }
+    const CBlockIndex* blockFrom = pindexPrev->GetAncestor(nHeight);
+    if (!blockFrom)
+        return false;
+    blockFromTime = blockFrom->nTime;
+    return true;
+}
+
+bool CheckStakeKernelHash(CBlockIndex* pindexPrev, unsigned int nBits, uint32_t blockFromTime, CAmount prevoutValue, const COutPoint& prevout, unsigned int nTimeBlock, uint256& hashProofOfStake, uint256& targetProofOfStake, bool fPrintProofOfStake)
+{
+    if (nTimeBlock < blockFromTime)  // Transaction timestamp violation
+        return error("CheckStakeKernelHash() : nTime violation");
+
+    arith_uint256 bnTarget = GetStakeKernelTarget(nBits, prevoutValue, prevout);
+
     targetProofOfStake = ArithToUint256(bnTarget);
 
     uint256 nStakeModifier = pindexPrev->nStakeModifier;
@@ -121,8 +158,8 @@ bool CheckProofOfStake(CBlockIndex* pindexPrev, CValidationState& state, const C
     if(pindexPrev->nHeight + 1 - coinPrev.nHeight < COINBASE_MATURITY){
         return state.Invalid(ValidationInvalidReason::BLOCK_INVALID_HEADER, false, REJECT_INVALID, "stake-prevout-not-mature", strprintf("CheckProofOfStake() : Stake prevout is not mature, expecting %i and only matured to %i", COINBASE_MATURITY, pindexPrev->nHeight + 1 - coinPrev.nHeight));
     }
-    CBlockIndex* blockFrom = pindexPrev->GetAncestor(coinPrev.nHeight);
-    if(!blockFrom) {
+    uint32_t blockFromTime;
+    if(!GetBlockFromTime(pindexPrev, coinPrev.nHeight, blockFromTime)) {
         return state.Invalid(ValidationInvalidReason::BLOCK_INVALID_HEADER, false, REJECT_INVALID, "stake-prevout-not-loaded", strprintf("CheckProofOfStake() : Block at height %i for prevout can not be loaded", coinPrev.nHeight));
     }
 
@@ -130,7 +167,7 @@ bool CheckProofOfStake(CBlockIndex* pindexPrev, CValidationState& state, const C
     if (!VerifySignature(coinPrev, txin.prevout.hash, tx, 0, SCRIPT_VERIFY_NONE))
         return state.Invalid(ValidationInvalidReason::BLOCK_INVALID_HEADER, false, REJECT_INVALID, "stake-verify-signature-failed", strprintf("CheckProofOfStake() : VerifySignature failed on coinstake %s", tx.GetHash().ToString()));
 
-    if (!CheckStakeKernelHash(pindexPrev, nBits, blockFrom->nTime, coinPrev.out.nValue, txin.prevout, nTimeBlock, hashProofOfStake, targetProofOfStake, LogInstance().WillLogCategory(BCLog::COINSTAKE)))
+    if (!CheckStakeKernelHash(pindexPrev, nBits, blockFromTime, coinPrev.out.nValue, txin.prevout, nTimeBlock, hashProofOfStake, targetProofOfStake, LogInstance().WillLogCategory(BCLog::COINSTAKE)))
         return state.Invalid(ValidationInvalidReason::BLOCK_HEADER_SYNC, false, REJECT_INVALID, "stake-check-kernel-failed", strprintf("CheckProofOfStake() : INFO: check kernel failed on coinstake %s, hashProof=%s", tx.GetHash().ToString(), hashProofOfStake.ToString())); // may occur during initial download or if behind on block chain sync
 
     return true;
@@ -187,7 +224,114 @@ bool CheckBlockInputPubKeyMatchesOutputPubKey(const CBlock& block, CCoinsViewCac
     return true;
 }
 
+namespace {
+/**
+ * Headers whose signature was recovered to the key of their stake, so that a header received from
+ * several peers and then with its block only goes through the key recovery once. The header hash
+ * covers the signature and the stake prevout, whose script can not change.
+ */
+class CBlockSignerCache
+{
+private:
+    //! Entries are SHA256(nonce || header hash):
+    uint256 nonce;
+    typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
+    map_type setValid;
+    boost::shared_mutex cs_signercache;
+
+public:
+    CBlockSignerCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+    }
+
+    void ComputeEntry(uint256& entry, const uint256& hash)
+    {
+        CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Finalize(entry.begin());
+    }
+
+    bool Get(const uint256& entry)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_signercache);
+        return setValid.contains(entry, false);
+    }
+
+    void Set(uint256& entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_signercache);
+        setValid.insert(entry);
+    }
+
+    uint32_t setup_bytes(size_t n)
+    {
+        return setValid.setup_bytes(n);
+    }
+};
+
+static CBlockSignerCache blockSignerCache;
+
+//! How often each recid/compressed combination recovered the signer, tried in that order
+static std::atomic<uint64_t> nSignerRecoveries[8];
+} // namespace
+
+void InitBlockSignerCache()
+{
+    size_t nElems = blockSignerCache.setup_bytes(BLOCK_SIGNER_CACHE_SIZE << 20);
+    LogPrintf("Using %zu MiB for block signer cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nElems);
+}
+
+/** The key of the coin that staked block, which must have signed it */
+static bool GetStakeSigner(const Coin& coinPrev, PKHash& keyID)
+{
+    CTxDestination address;
+    txnouttype txType=TX_NONSTANDARD;
+    if(!ExtractDestination(coinPrev.out.scriptPubKey, address, &txType) ||
+       !((txType == TX_PUBKEY || txType == TX_PUBKEYHASH) && address.type() == typeid(PKHash))) {
+        return false;
+    }
+    keyID = boost::get<PKHash>(address);
+    return true;
+}
+
+/** Recover the signer of the block and remember the block when it is keyID */
+static bool RecoverBlockSigner(const CBlockHeader& block, const PKHash& keyID, uint256& entry)
+{
+    CPubKeyRecovery recovery(block.GetHashWithoutSign(), block.vchBlockSig);
+    if(!recovery.IsValid()) {
+        return false;
+    }
+    CPubKey pubkey;
+
+    // combination i is recid i / 2, compressed i % 2
+    uint8_t order[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+    uint64_t nRecoveries[8];
+    for(int i = 0; i < 8; ++i) {
+        nRecoveries[i] = nSignerRecoveries[i].load(std::memory_order_relaxed);
+    }
+    std::stable_sort(order, order + 8, [&nRecoveries](uint8_t a, uint8_t b) { return nRecoveries[a] > nRecoveries[b]; });
+
+    for(uint8_t i : order) {
+        if(!recovery.Recover(i / 2, i % 2, pubkey)) {
+            continue;
+        }
+        if(pubkey.GetID() == keyID) {
+            nSignerRecoveries[i].fetch_add(1, std::memory_order_relaxed);
+            blockSignerCache.Set(entry);
+            return true;
+        }
+    }
+
+    return false;
+}
+
 bool CheckRecoveredPubKeyFromBlockSignature(CBlockIndex* pindexPrev, const CBlockHeader& block, CCoinsViewCache& view) {
+    uint256 entry;
+    blockSignerCache.ComputeEntry(entry, block.GetHash());
+    if(blockSignerCache.Get(entry)) {
+        return true;
+    }
+
     Coin coinPrev;
     if(!view.GetCoin(block.prevoutStake, coinPrev)){
         if(!GetSpentCoinFromMainChain(pindexPrev, block.prevoutStake, &coinPrev)) {
@@ -195,41 +339,62 @@ bool CheckRecoveredPubKeyFromBlockSignature(CBlockIndex* pindexPrev, const CBloc
         }
     }
 
-    uint256 hash = block.GetHashWithoutSign();
-    CPubKey pubkey;
-
     if(block.vchBlockSig.empty()) {
         return error("CheckRecoveredPubKeyFromBlockSignature(): Signature is empty\n");
     }
 
-    for(uint8_t recid = 0; recid <= 3; ++recid) {
-        for(uint8_t compressed = 0; compressed < 2; ++compressed) {
-            if(!pubkey.RecoverLaxDER(hash, block.vchBlockSig, recid, compressed)) {
-                continue;
-            }
+    PKHash keyID;
+    if(!GetStakeSigner(coinPrev, keyID)) {
+        return false;
+    }
 
-            CTxDestination address;
-            txnouttype txType=TX_NONSTANDARD;
-            if(ExtractDestination(coinPrev.out.scriptPubKey, address, &txType)){
-                if ((txType == TX_PUBKEY || txType == TX_PUBKEYHASH) && address.type() == typeid(PKHash)) {
-                    if(pubkey.GetID() == boost::get<PKHash>(address)) {
-                        return true;
-                    }
-                }
-            }
+    return RecoverBlockSigner(block, keyID, entry);
+}
+
+void PrecheckBlockSignatures(const std::vector<const CBlockHeader*>& headers, CCoinsViewCache& view, int nThreads)
+{
+    if(nThreads <= 0) {
+        return;
+    }
+
+    // The coins are read here, the threads only hash and recover
+    std::vector<std::pair<const CBlockHeader*, PKHash>> vSigners;
+    for(const CBlockHeader* pheader : headers) {
+        Coin coinPrev;
+        PKHash keyID;
+        if(!pheader->vchBlockSig.empty() && view.GetCoin(pheader->prevoutStake, coinPrev) && GetStakeSigner(coinPrev, keyID)) {
+            vSigners.emplace_back(pheader, keyID);
         }
     }
+    if(vSigners.size() < MIN_SIGNER_PRECHECK_HEADERS) {
+        return;
+    }
 
-    return false;
+    const size_t nLanes = std::min((size_t)nThreads, vSigners.size() / MIN_SIGNER_PRECHECK_HEADERS);
+    std::vector<std::thread> threads;
+    for(size_t i = 0; i < nLanes; i++) {
+        threads.emplace_back(&TraceThread<std::function<void()>>, "sigprecheck", std::function<void()>([i, nLanes, &vSigners] {
+            for(size_t n = i; n < vSigners.size(); n += nLanes) {
+                uint256 entry;
+                blockSignerCache.ComputeEntry(entry, vSigners[n].first->GetHash());
+                if(!blockSignerCache.Get(entry)) {
+                    RecoverBlockSigner(*vSigners[n].first, vSigners[n].second, entry);
+                }
+            }
+        }));
+    }
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
 }
 
 bool CheckKernel(CBlockIndex* pindexPrev, unsigned int nBits, uint32_t nTimeBlock, const COutPoint& prevout, CCoinsViewCache& view)
 {
-    std::map<COutPoint, CStakeCache> tmp;
+    CStakeCacheMap tmp;
     return CheckKernel(pindexPrev, nBits, nTimeBlock, prevout, view, tmp);
 }
 
-bool CheckKernel(CBlockIndex* pindexPrev, unsigned int nBits, uint32_t nTimeBlock, const COutPoint& prevout, CCoinsViewCache& view, const std::map<COutPoint, CStakeCache>& cache)
+bool CheckKernel(CBlockIndex* pindexPrev, unsigned int nBits, uint32_t nTimeBlock, const COutPoint& prevout, CCoinsViewCache& view, const CStakeCacheMap& cache)
 {
     uint256 hashProofOfStake, targetProofOfStake;
     auto it=cache.find(prevout);
@@ -245,64 +410,172 @@ bool CheckKernel(CBlockIndex* pindexPrev, unsigned int nBits, uint32_t nTimeBloc
         if(pindexPrev->nHeight + 1 - coinPrev.nHeight < COINBASE_MATURITY){
             return error("CheckKernel(): Coin not matured");
         }
-        CBlockIndex* blockFrom = pindexPrev->GetAncestor(coinPrev.nHeight);
-        if(!blockFrom) {
+        uint32_t blockFromTime;
+        if(!GetBlockFromTime(pindexPrev, coinPrev.nHeight, blockFromTime)) {
             return error("CheckKernel(): Could not find block");
         }
         if(coinPrev.IsSpent()){
             return error("CheckKernel(): Coin is spent");
         }
 
-        return CheckStakeKernelHash(pindexPrev, nBits, blockFrom->nTime, coinPrev.out.nValue, prevout,
+        return CheckStakeKernelHash(pindexPrev, nBits, blockFromTime, coinPrev.out.nValue, prevout,
                                     nTimeBlock, hashProofOfStake, targetProofOfStake);
     }else{
         //found in cache
         const CStakeCache& stake = it->second;
+        if(pindexPrev->nHeight + 1 - stake.height < COINBASE_MATURITY){
+            return error("CheckKernel(): Coin not matured");
+        }
         if(CheckStakeKernelHash(pindexPrev, nBits, stake.blockFromTime, stake.amount, prevout,
                                     nTimeBlock, hashProofOfStake, targetProofOfStake)){
-            //Cache could potentially cause false positive stakes in the event of deep reorgs, so check without cache also
+            //Cache could potentially cause false positive stakes in the event of deep reorgs, so check without cache
+            //also when blocks were disconnected since the entry was read from the chain
+            if(stake.generation == g_reorg_generation)
+                return true;
             return CheckKernel(pindexPrev, nBits, nTimeBlock, prevout, view);
         }
     }
     return false;
 }
 
-void CacheKernel(std::map<COutPoint, CStakeCache>& cache, const COutPoint& prevout, CBlockIndex* pindexPrev, CCoinsViewCache& view){
-    if(cache.find(prevout) != cache.end()){
-        //already in cache
-        return;
-    }
+// The kernel preimage is modifier (32) | blockFromTime (4) | prevout.hash (32) | prevout.n (4) | nTimeBlock (4).
+// Its first 64 bytes fill one SHA256 block that does not depend on the block time.
+static const size_t STAKE_KERNEL_PREFIX_SIZE = 64;
 
-    Coin coinPrev;
-    if(!view.GetCoin(prevout, coinPrev)){
-        return;
-    }
+// The rest is the last 4 bytes of prevout.hash, prevout.n and nTimeBlock.
+static const size_t STAKE_KERNEL_TAIL_SIZE = 12;
 
-    if(pindexPrev->nHeight + 1 - coinPrev.nHeight < COINBASE_MATURITY){
-        return;
+struct StakeKernelCandidate{
+    COutPoint prevout;
+    uint32_t blockFromTime;
+    arith_uint256 bnTarget;
+};
+
+bool FindStakeKernel(CBlockIndex* pindexPrev, unsigned int nBits, uint32_t nTimeBegin, uint32_t nTimeEnd, const std::vector<COutPoint>& prevouts, CCoinsViewCache& view, const CStakeCacheMap& cache, COutPoint& prevoutRet, uint32_t& nTimeRet)
+{
+    std::vector<StakeKernelCandidate> candidates;
+    candidates.reserve(prevouts.size());
+    // hasher states after the first block of each preimage, and the rest of it
+    std::vector<CSHA256> prefixes;
+    prefixes.reserve(prevouts.size());
+    std::vector<unsigned char> tails;
+    tails.reserve(prevouts.size() * STAKE_KERNEL_TAIL_SIZE);
+    for(const COutPoint& prevout : prevouts)
+    {
+        uint32_t blockFromTime;
+        CAmount amount;
+        auto it = cache.find(prevout);
+        if(it != cache.end()){
+            if(pindexPrev->nHeight + 1 - it->second.height < COINBASE_MATURITY)
+                continue;
+            blockFromTime = it->second.blockFromTime;
+            amount = it->second.amount;
+        }else{
+            Coin coinPrev;
+            if(!view.GetCoin(prevout, coinPrev) || pindexPrev->nHeight + 1 - coinPrev.nHeight < COINBASE_MATURITY)
+                continue;
+            if(!GetBlockFromTime(pindexPrev, coinPrev.nHeight, blockFromTime))
+                continue;
+            amount = coinPrev.out.nValue;
+        }
+
+        CDataStream ss(SER_GETHASH, 0);
+        ss << pindexPrev->nStakeModifier << blockFromTime << prevout.hash << prevout.n;
+        assert(ss.size() + sizeof(uint32_t) == STAKE_KERNEL_PREFIX_SIZE + STAKE_KERNEL_TAIL_SIZE);
+
+        candidates.emplace_back();
+        StakeKernelCandidate& candidate = candidates.back();
+        candidate.prevout = prevout;
+        candidate.blockFromTime = blockFromTime;
+        candidate.bnTarget = GetStakeKernelTarget(nBits, amount, prevout);
+        prefixes.emplace_back();
+        prefixes.back().Write((const unsigned char*)ss.data(), STAKE_KERNEL_PREFIX_SIZE);
+        tails.insert(tails.end(), ss.begin() + STAKE_KERNEL_PREFIX_SIZE, ss.end());
+        tails.resize(tails.size() + sizeof(uint32_t));
     }
-    CBlockIndex* blockFrom = pindexPrev->GetAncestor(coinPrev.nHeight);
-    if(!blockFrom) {
-        return;
+
+    if(candidates.empty())
+        return false;
+
+    std::vector<const unsigned char*> inputs;
+    inputs.reserve(candidates.size());
+    for(size_t i = 0; i < candidates.size(); i++)
+        inputs.push_back(tails.data() + i * STAKE_KERNEL_TAIL_SIZE);
+    const std::vector<size_t> lengths(candidates.size(), STAKE_KERNEL_TAIL_SIZE);
+    std::vector<uint256> hashes(candidates.size());
+
+    for(uint32_t nTimeBlock = nTimeBegin; nTimeBlock < nTimeEnd; nTimeBlock += STAKE_TIMESTAMP_MASK + 1)
+    {
+        // the kernels of all the coins for this time are hashed together
+        for(size_t i = 0; i < candidates.size(); i++)
+            WriteLE32(tails.data() + i * STAKE_KERNEL_TAIL_SIZE + STAKE_KERNEL_TAIL_SIZE - sizeof(uint32_t), nTimeBlock);
+        SHA256DMany(hashes.data()->begin(), prefixes.data(), inputs.data(), lengths.data(), candidates.size());
+
+        for(size_t i = 0; i < candidates.size(); i++)
+        {
+            const StakeKernelCandidate& candidate = candidates[i];
+            if(nTimeBlock < candidate.blockFromTime)
+                continue;
+
+            if(UintToArith256(hashes[i]) > candidate.bnTarget)
+                continue;
+
+            if(CheckKernel(pindexPrev, nBits, nTimeBlock, candidate.prevout, view, cache)){
+                prevoutRet = candidate.prevout;
+                nTimeRet = nTimeBlock;
+                return true;
+            }
+        }
     }
+    return false;
+}
 
-    CStakeCache c(blockFrom->nTime, coinPrev.out.nValue);
-    cache.insert({prevout, c});
+CStakeCacheMap::const_iterator CStakeCacheMap::find(const COutPoint& prevout) const
+{
+    auto it = std::lower_bound(entries.begin(), entries.end(), prevout,
+        [](const std::pair<COutPoint, CStakeCache>& entry, const COutPoint& key) { return entry.first < key; });
+    if(it != entries.end() && it->first == prevout)
+        return it;
+    return entries.end();
+}
+
+void CStakeCacheMap::insert(const COutPoint& prevout, const CStakeCache& stake)
+{
+    auto it = std::lower_bound(entries.begin(), entries.end(), prevout,
+        [](const std::pair<COutPoint, CStakeCache>& entry, const COutPoint& key) { return entry.first < key; });
+    if(it != entries.end() && it->first == prevout)
+        it->second = stake;
+    else
+        entries.emplace(it, prevout, stake);
+}
+
+void CStakeCacheMap::erase(const uint256& hash)
+{
+    auto it = std::lower_bound(entries.begin(), entries.end(), COutPoint(hash, 0),
+        [](const std::pair<COutPoint, CStakeCache>& entry, const COutPoint& key) { return entry.first < key; });
+    auto last = it;
+    while(last != entries.end() && last->first.hash == hash)
+        ++last;
+    entries.erase(it, last);
 }
 
 /**
  * Proof-of-stake functions needed in the wallet but wallet independent
  */
 struct ScriptsElement{
-    CScript script;
+    int height = -1;
     uint256 hash;
+    CScript script;
 };
 
 /**
- * Cache of the recent mpos scripts for the block reward recipients
- * The max size of the map is 2 * nCacheScripts - nMPoSRewardRecipients, so in this case it is 20
+ * Ring buffer of the recent mpos scripts for the block reward recipients, by height.
+ * An entry is only used for the block of its height in the active chain with the same hash,
+ * so entries of disconnected blocks never need to be cleaned and are overwritten in place.
+ * The active chain is walked under cs_main, which also guards the entries.
  */
-std::map<int, ScriptsElement> scriptsMap;
+static const int MPOS_SCRIPT_CACHE_SIZE = 128;
+static ScriptsElement scriptsCache[MPOS_SCRIPT_CACHE_SIZE] GUARDED_BY(cs_main);
 
 unsigned int GetStakeMaxCombineInputs() { return 100; }
 
@@ -312,67 +585,25 @@ unsigned int GetStakeSplitOutputs() { return 2; }
 
 int64_t GetStakeSplitThreshold() { return GetStakeSplitOutputs() * GetStakeCombineThreshold(); }
 
-bool NeedToEraseScriptFromCache(int nBlockHeight, int nCacheScripts, int nScriptHeight, const ScriptsElement& scriptElement)
+static bool ReadFromScriptCache(CScript &script, CBlockIndex* pblockindex, int nHeight) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
-    // Erase element from cache if not in range [nBlockHeight - nCacheScripts, nBlockHeight + nCacheScripts]
-    if(nScriptHeight < (nBlockHeight - nCacheScripts) ||
-            nScriptHeight > (nBlockHeight + nCacheScripts))
-        return true;
-
-    // Erase element from cache if hash different
-    CBlockIndex* pblockindex = ChainActive()[nScriptHeight];
-    if(pblockindex && pblockindex->GetBlockHash() != scriptElement.hash)
-        return true;
-
-    return false;
-}
-
-void CleanScriptCache(int nHeight, const Consensus::Params& consensusParams)
-{
-    int nCacheScripts = consensusParams.nMPoSRewardRecipients * 1.5;
-
-    // Remove the scripts from cache that are not used
-    for (std::map<int, ScriptsElement>::iterator it=scriptsMap.begin(); it!=scriptsMap.end();){
-        if(NeedToEraseScriptFromCache(nHeight, nCacheScripts, it->first, it->second))
-        {
-            it = scriptsMap.erase(it);
-        }
-        else{
-            it++;
-        }
-    }
-}
-
-bool ReadFromScriptCache(CScript &script, CBlockIndex* pblockindex, int nHeight, const Consensus::Params& consensusParams)
-{
-    CleanScriptCache(nHeight, consensusParams);
-
-    // Find the script in the cache
-    std::map<int, ScriptsElement>::iterator it = scriptsMap.find(nHeight);
-    if(it != scriptsMap.end())
-    {
-        if(it->second.hash == pblockindex->GetBlockHash())
-        {
-            script = it->second.script;
-            return true;
-        }
-    }
+    const ScriptsElement& element = scriptsCache[nHeight % MPOS_SCRIPT_CACHE_SIZE];
+    if(element.height != nHeight || element.hash != pblockindex->GetBlockHash())
+        return false;
 
-    return false;
+    script = element.script;
+    return true;
 }
 
-void AddToScriptCache(CScript script, CBlockIndex* pblockindex, int nHeight, const Consensus::Params& consensusParams)
+static void AddToScriptCache(const CScript& script, CBlockIndex* pblockindex, int nHeight) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
-    CleanScriptCache(nHeight, consensusParams);
-
-    // Add the script into the cache
-    ScriptsElement listElement;
-    listElement.script = script;
-    listElement.hash = pblockindex->GetBlockHash();
-    scriptsMap.insert(std::pair<int, ScriptsElement>(nHeight, listElement));
+    ScriptsElement& element = scriptsCache[nHeight % MPOS_SCRIPT_CACHE_SIZE];
+    element.height = nHeight;
+    element.hash = pblockindex->GetBlockHash();
+    element.script = script;
 }
 
-bool AddMPoSScript(std::vector<CScript> &mposScriptList, int nHeight, const Consensus::Params& consensusParams)
+static bool AddMPoSScript(std::vector<CScript> &mposScriptList, int nHeight, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     // Check if the block index exist into the active chain
     CBlockIndex* pblockindex = ChainActive()[nHeight];
@@ -384,7 +615,7 @@ bool AddMPoSScript(std::vector<CScript> &mposScriptList, int nHeight, const Cons
 
     // Try find the script from the cache
     CScript script;
-    if(ReadFromScriptCache(script, pblockindex, nHeight, consensusParams))
+    if(ReadFromScriptCache(script, pblockindex, nHeight))
     {
         mposScriptList.push_back(script);
         return true;
@@ -414,7 +645,7 @@ bool AddMPoSScript(std::vector<CScript> &mposScriptList, int nHeight, const Cons
         mposScriptList.push_back(script);
 
         // Update script cache
-        AddToScriptCache(script, pblockindex, nHeight, consensusParams);
+        AddToScriptCache(script, pblockindex, nHeight);
     }
     else
     {
@@ -434,6 +665,8 @@ bool AddMPoSScript(std::vector<CScript> &mposScriptList, int nHeight, const Cons
 
 bool GetMPoSOutputScripts(std::vector<CScript>& mposScriptList, int nHeight, const Consensus::Params& consensusParams)
 {
+    AssertLockHeld(cs_main);
+
     bool ret = true;
     nHeight -= COINBASE_MATURITY;
 
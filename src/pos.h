@@ -21,13 +21,37 @@
 static const uint32_t STAKE_TIMESTAMP_MASK = 15;
 
 struct CStakeCache{
-    CStakeCache(uint32_t blockFromTime_, CAmount amount_) : blockFromTime(blockFromTime_), amount(amount_){
+    CStakeCache(uint32_t blockFromTime_, CAmount amount_, int height_) : blockFromTime(blockFromTime_), amount(amount_), height(height_), generation(g_reorg_generation){
     }
     uint32_t blockFromTime;
     CAmount amount;
+    int height;
+    // g_reorg_generation when the entry was read from the active chain
+    uint64_t generation;
 };
 
-void CacheKernel(std::map<COutPoint, CStakeCache>& cache, const COutPoint& prevout, CBlockIndex* pindexPrev, CCoinsViewCache& view);
+/**
+ * Kernel data of the staker's coins by outpoint, kept sorted in one vector so that
+ * the lookups of a staking round walk contiguous memory
+ */
+class CStakeCacheMap{
+public:
+    typedef std::vector<std::pair<COutPoint, CStakeCache>>::const_iterator const_iterator;
+
+    const_iterator begin() const { return entries.begin(); }
+    const_iterator end() const { return entries.end(); }
+    size_t size() const { return entries.size(); }
+    void clear() { entries.clear(); }
+
+    const_iterator find(const COutPoint& prevout) const;
+    // Insert or replace the data of prevout
+    void insert(const COutPoint& prevout, const CStakeCache& stake);
+    // Erase all the outputs of the transaction hash
+    void erase(const uint256& hash);
+
+private:
+    std::vector<std::pair<COutPoint, CStakeCache>> entries;
+};
 
 // Compute the hash modifier for proof-of-stake
 uint256 ComputeStakeModifier(const CBlockIndex* pindexPrev, const uint256& kernel);
@@ -47,14 +71,35 @@ bool CheckCoinStakeTimestamp(uint32_t nTimeBlock);
 // Since it is only used in ConnectBlock, we know that we have access to the full contextual utxo set
 bool CheckBlockInputPubKeyMatchesOutputPubKey(const CBlock& block, CCoinsViewCache& view);
 
+// Block signer cache size in MiB
+static const unsigned int BLOCK_SIGNER_CACHE_SIZE = 4;
+
+// To be called once in AppInitMain/BasicTestingSetup to initialize the block signer cache.
+void InitBlockSignerCache();
+
 // Recover the pubkey and check that it matches the prevoutStake's scriptPubKey.
+// Headers that passed are remembered, a header checked again is accepted without recovering its key.
 bool CheckRecoveredPubKeyFromBlockSignature(CBlockIndex* pindexPrev, const CBlockHeader& block, CCoinsViewCache& view);
 
+// Headers each signer recovery thread gets at least, fewer are left to CheckRecoveredPubKeyFromBlockSignature
+static const size_t MIN_SIGNER_PRECHECK_HEADERS = 16;
+
+// Recover the signers of PoS headers on up to nThreads threads and remember the headers that passed,
+// so their CheckRecoveredPubKeyFromBlockSignature that follows does not recover them again.
+// Headers whose stake is not in view are left to that check, which also looks for spent stakes.
+void PrecheckBlockSignatures(const std::vector<const CBlockHeader*>& headers, CCoinsViewCache& view, int nThreads);
+
 // Wrapper around CheckStakeKernelHash()
 // Also checks existence of kernel input and min age
 // Convenient for searching a kernel
 bool CheckKernel(CBlockIndex* pindexPrev, unsigned int nBits, uint32_t nTimeBlock, const COutPoint& prevout, CCoinsViewCache& view);
-bool CheckKernel(CBlockIndex* pindexPrev, unsigned int nBits, uint32_t nTimeBlock, const COutPoint& prevout, CCoinsViewCache& view, const std::map<COutPoint, CStakeCache>& cache);
+bool CheckKernel(CBlockIndex* pindexPrev, unsigned int nBits, uint32_t nTimeBlock, const COutPoint& prevout, CCoinsViewCache& view, const CStakeCacheMap& cache);
+
+// Search the earliest block time from nTimeBegin up to nTimeEnd, stepping by STAKE_TIMESTAMP_MASK+1,
+// at which one of the coins meets the kernel target, trying the coins in order for each time.
+// The part of the kernel hash that does not depend on the block time is computed once per coin.
+// Sets prevoutRet and nTimeRet on success return
+bool FindStakeKernel(CBlockIndex* pindexPrev, unsigned int nBits, uint32_t nTimeBegin, uint32_t nTimeEnd, const std::vector<COutPoint>& prevouts, CCoinsViewCache& view, const CStakeCacheMap& cache, COutPoint& prevoutRet, uint32_t& nTimeRet);
 
 unsigned int GetStakeMaxCombineInputs();
 
@@ -64,8 +109,8 @@ unsigned int GetStakeSplitOutputs();
 
 int64_t GetStakeSplitThreshold();
 
-bool GetMPoSOutputScripts(std::vector<CScript> &mposScroptList, int nHeight, const Consensus::Params& consensusParams);
+bool GetMPoSOutputScripts(std::vector<CScript> &mposScroptList, int nHeight, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
-bool CreateMPoSOutputs(CMutableTransaction& txNew, int64_t nRewardPiece, int nHeight, const Consensus::Params& consensusParams);
+bool CreateMPoSOutputs(CMutableTransaction& txNew, int64_t nRewardPiece, int nHeight, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
 #endif // QUANTUM_POS_H
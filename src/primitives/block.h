@@ -172,7 +172,14 @@ public:
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
         READWRITEAS(CBlockHeader, *this);
-        READWRITE(vtx);
+        if (ser_action.ForRead()) {
+            // the txids of the whole block are hashed together
+            std::vector<CMutableTransaction> txs;
+            READWRITE(txs);
+            vtx = MakeTransactionRefs(std::move(txs));
+        } else {
+            READWRITE(vtx);
+        }
     }
 
     void SetNull()
@@ -5,7 +5,9 @@
 
 #include <primitives/transaction.h>
 
+#include <crypto/sha256.h>
 #include <hash.h>
+#include <streams.h>
 #include <tinyformat.h>
 #include <util/strencodings.h>
 
@@ -75,10 +77,72 @@ uint256 CTransaction::ComputeWitnessHash() const
     return SerializeHash(*this, SER_GETHASH, 0);
 }
 
+uint8_t CTransaction::ComputeScriptFlags() const
+{
+    uint8_t flags = 0;
+    for(const CTxIn& i : vin){
+        if(i.scriptSig.HasOpSpend()){
+            flags |= SCRIPT_OP_SPEND;
+        }
+    }
+    for(const CTxOut& v : vout){
+        if(v.scriptPubKey.HasOpCreate()){
+            flags |= SCRIPT_OP_CREATE;
+        }
+        if(v.scriptPubKey.HasOpCall()){
+            flags |= SCRIPT_OP_CALL;
+        }
+        if(v.scriptPubKey.HasOpSender()){
+            flags |= SCRIPT_OP_SENDER;
+        }
+    }
+    return flags;
+}
+
 /* For backward compatibility, the hash is initialized to 0. TODO: remove the need for this default constructor entirely. */
-CTransaction::CTransaction() : vin(), vout(), nVersion(CTransaction::CURRENT_VERSION), nLockTime(0), hash{}, m_witness_hash{} {}
-CTransaction::CTransaction(const CMutableTransaction& tx) : vin(tx.vin), vout(tx.vout), nVersion(tx.nVersion), nLockTime(tx.nLockTime), hash{ComputeHash()}, m_witness_hash{ComputeWitnessHash()} {}
-CTransaction::CTransaction(CMutableTransaction&& tx) : vin(std::move(tx.vin)), vout(std::move(tx.vout)), nVersion(tx.nVersion), nLockTime(tx.nLockTime), hash{ComputeHash()}, m_witness_hash{ComputeWitnessHash()} {}
+CTransaction::CTransaction() : vin(), vout(), nVersion(CTransaction::CURRENT_VERSION), nLockTime(0), hash{}, m_witness_hash{}, m_script_flags{0} {}
+CTransaction::CTransaction(const CMutableTransaction& tx) : vin(tx.vin), vout(tx.vout), nVersion(tx.nVersion), nLockTime(tx.nLockTime), hash{ComputeHash()}, m_witness_hash{ComputeWitnessHash()}, m_script_flags{ComputeScriptFlags()} {}
+CTransaction::CTransaction(CMutableTransaction&& tx) : vin(std::move(tx.vin)), vout(std::move(tx.vout)), nVersion(tx.nVersion), nLockTime(tx.nLockTime), hash{ComputeHash()}, m_witness_hash{ComputeWitnessHash()}, m_script_flags{ComputeScriptFlags()} {}
+CTransaction::CTransaction(CMutableTransaction&& tx, const uint256& hashIn, const uint256& witnessHashIn) : vin(std::move(tx.vin)), vout(std::move(tx.vout)), nVersion(tx.nVersion), nLockTime(tx.nLockTime), hash{hashIn}, m_witness_hash{witnessHashIn}, m_script_flags{ComputeScriptFlags()} {}
+
+std::vector<CTransactionRef> MakeTransactionRefs(std::vector<CMutableTransaction>&& txs)
+{
+    if (txs.empty())
+        return {};
+
+    // Serialize every transaction the way its hashes see it into one buffer,
+    // then hash them all together.
+    std::vector<unsigned char> buffer;
+    std::vector<size_t> begins;
+    std::vector<size_t> lengths;
+    for (const CMutableTransaction& tx : txs) {
+        begins.push_back(buffer.size());
+        CVectorWriter(SER_GETHASH, SERIALIZE_TRANSACTION_NO_WITNESS, buffer, buffer.size()) << tx;
+        lengths.push_back(buffer.size() - begins.back());
+        if (tx.HasWitness()) {
+            begins.push_back(buffer.size());
+            CVectorWriter(SER_GETHASH, 0, buffer, buffer.size()) << tx;
+            lengths.push_back(buffer.size() - begins.back());
+        }
+    }
+    std::vector<const unsigned char*> inputs;
+    inputs.reserve(begins.size());
+    for (size_t begin : begins) {
+        inputs.push_back(buffer.data() + begin);
+    }
+    std::vector<uint256> hashes(begins.size());
+    SHA256DMany(hashes.data()->begin(), inputs.data(), lengths.data(), hashes.size());
+
+    std::vector<CTransactionRef> ret;
+    ret.reserve(txs.size());
+    size_t i = 0;
+    for (CMutableTransaction& tx : txs) {
+        const uint256& hash = hashes[i++];
+        const uint256& witness_hash = tx.HasWitness() ? hashes[i++] : hash;
+        ret.push_back(std::shared_ptr<const CTransaction>(new CTransaction(std::move(tx), hash, witness_hash)));
+    }
+    return ret;
+}
 
 CAmount CTransaction::GetValueOut() const
 {
@@ -118,64 +182,12 @@ std::string CTransaction::ToString() const
 }
 
 ///////////////////////////////////////////////////////////// qtum
-bool CTransaction::HasCreateOrCall() const{
-    for(const CTxOut& v : vout){
-        if(v.scriptPubKey.HasOpCreate() || v.scriptPubKey.HasOpCall()){
-            return true;
-        }
-    }
-    return false;
-}
-
-
-
-bool CTransaction::HasOpSpend() const{
-    for(const CTxIn& i : vin){
-        if(i.scriptSig.HasOpSpend()){
-            return true;
-        }
-    }
-    return false;
-}
-/////////////////////////////////////////////////////////////
-
-bool CTransaction::HasOpCreate() const
-{
-    for(const CTxOut& v : vout){
-        if(v.scriptPubKey.HasOpCreate()){
-            return true;
-        }
-    }
-    return false;
-}
-
-bool CTransaction::HasOpCall() const
+bool CMutableTransaction::HasOpSender() const
 {
     for(const CTxOut& v : vout){
-        if(v.scriptPubKey.HasOpCall()){
-            return true;
-        }
-    }
-    return false;
-}
-
-template <class T>
-bool hasOpSender(const T& txTo)
-{
-    for(const CTxOut& v : txTo.vout){
         if(v.scriptPubKey.HasOpSender()){
             return true;
         }
     }
     return false;
 }
-
-bool CTransaction::HasOpSender() const
-{
-    return hasOpSender(*this);
-}
-
-bool CMutableTransaction::HasOpSender() const
-{
-    return hasOpSender(*this);
-}
@@ -309,12 +309,27 @@ public:
     };
 
 private:
+    // Contract opcodes found in the scripts, see ComputeScriptFlags
+    enum ScriptFlags : uint8_t
+    {
+        SCRIPT_OP_CREATE = 1,
+        SCRIPT_OP_CALL = 2,
+        SCRIPT_OP_SPEND = 4,
+        SCRIPT_OP_SENDER = 8
+    };
+
     /** Memory only. */
     const uint256 hash;
     const uint256 m_witness_hash;
+    const uint8_t m_script_flags;
 
     uint256 ComputeHash() const;
     uint256 ComputeWitnessHash() const;
+    uint8_t ComputeScriptFlags() const;
+
+    /** Take hashes computed by MakeTransactionRefs. */
+    CTransaction(CMutableTransaction &&tx, const uint256& hashIn, const uint256& witnessHashIn);
+    friend std::vector<std::shared_ptr<const CTransaction>> MakeTransactionRefs(std::vector<CMutableTransaction>&& txs);
 
 public:
     /** Construct a CTransaction that qualifies as IsNull() */
@@ -354,16 +369,17 @@ public:
     unsigned int GetTotalSize() const;
 
 //////////////////////////////////////// // qtum
-    bool HasCreateOrCall() const;
-    bool HasOpSpend() const;
+    // The scripts are classified once on construction, these only read the flags
+    bool HasCreateOrCall() const { return m_script_flags & (SCRIPT_OP_CREATE | SCRIPT_OP_CALL); }
+    bool HasOpSpend() const { return m_script_flags & SCRIPT_OP_SPEND; }
 ////////////////////////////////////////
-    bool HasOpCreate() const;
-    bool HasOpCall() const;
+    bool HasOpCreate() const { return m_script_flags & SCRIPT_OP_CREATE; }
+    bool HasOpCall() const { return m_script_flags & SCRIPT_OP_CALL; }
     inline int GetCreateOrCall() const
     {
         return (HasOpCall() ? OpCode::OpCall : 0) + (HasOpCreate() ? OpCode::OpCreate : 0);
     }
-    bool HasOpSender() const;
+    bool HasOpSender() const { return m_script_flags & SCRIPT_OP_SENDER; }
 
     bool IsCoinBase() const
     {
@@ -454,4 +470,7 @@ typedef std::shared_ptr<const CTransaction> CTransactionRef;
 static inline CTransactionRef MakeTransactionRef() { return std::make_shared<const CTransaction>(); }
 template <typename Tx> static inline CTransactionRef MakeTransactionRef(Tx&& txIn) { return std::make_shared<const CTransaction>(std::forward<Tx>(txIn)); }
 
+/** Convert many transactions at once, hashing them together on the multi-way SHA256 transforms. */
+std::vector<CTransactionRef> MakeTransactionRefs(std::vector<CMutableTransaction>&& txs);
+
 #endif // BITCOIN_PRIMITIVES_TRANSACTION_H
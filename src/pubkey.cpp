@@ -219,6 +219,42 @@ bool CPubKey::RecoverCompact(const uint256 &hash, const std::vector<unsigned cha
     return true;
 }
 
+CPubKeyRecovery::CPubKeyRecovery(const uint256& hashIn, const std::vector<unsigned char>& vchSig) : hash(hashIn) {
+    secp256k1_ecdsa_signature parsed;
+    fValid = ecdsa_signature_parse_der_lax(secp256k1_context_verify, &parsed, vchSig.data(), vchSig.size()) &&
+             secp256k1_ecdsa_signature_serialize_compact(secp256k1_context_verify, sig, &parsed);
+}
+
+bool CPubKeyRecovery::Recover(uint8_t recid, bool fComp, CPubKey& pubkey) {
+    if (!fValid || recid > 3)
+        return false;
+    if (!fTried[recid]) {
+        fTried[recid] = true;
+        secp256k1_ecdsa_recoverable_signature rsig;
+        secp256k1_pubkey point;
+        if (secp256k1_ecdsa_recoverable_signature_parse_compact(secp256k1_context_verify, &rsig, sig, recid) &&
+            secp256k1_ecdsa_recover(secp256k1_context_verify, &point, &rsig, hash.begin())) {
+            unsigned char pub[CPubKey::PUBLIC_KEY_SIZE];
+            size_t publen = CPubKey::PUBLIC_KEY_SIZE;
+            secp256k1_ec_pubkey_serialize(secp256k1_context_verify, pub, &publen, &point, SECP256K1_EC_UNCOMPRESSED);
+            keys[recid].Set(pub, pub + publen);
+        }
+    }
+    const CPubKey& key = keys[recid];
+    if (!key.IsValid())
+        return false;
+    if (!fComp) {
+        pubkey = key;
+        return true;
+    }
+    // The compressed encoding is the x coordinate tagged with the parity of y
+    unsigned char pub[CPubKey::COMPRESSED_PUBLIC_KEY_SIZE];
+    pub[0] = 0x02 | (key[64] & 1);
+    std::copy(key.begin() + 1, key.begin() + 33, pub + 1);
+    pubkey.Set(pub, pub + sizeof(pub));
+    return true;
+}
+
 bool CPubKey::IsFullyValid() const {
     if (!IsValid())
         return false;
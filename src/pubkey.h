@@ -256,6 +256,31 @@ struct CExtPubKey {
     }
 };
 
+/**
+ * Recovers the public keys a lax DER signature may come from. The signature
+ * is parsed once and every recovery id is recovered at most once, the
+ * compressed and uncompressed keys for a recovery id share the same point.
+ */
+class CPubKeyRecovery
+{
+private:
+    uint256 hash;
+    unsigned char sig[64];
+    bool fValid;
+    //! Uncompressed keys, filled in the first time a recovery id is asked for
+    CPubKey keys[4];
+    bool fTried[4] = {false, false, false, false};
+
+public:
+    CPubKeyRecovery(const uint256& hashIn, const std::vector<unsigned char>& vchSig);
+
+    //! Whether the signature could be parsed
+    bool IsValid() const { return fValid; }
+
+    //! Recover the public key for recid, like CPubKey::RecoverLaxDER
+    bool Recover(uint8_t recid, bool fComp, CPubKey& pubkey);
+};
+
 /** Users of this module must hold an ECCVerifyHandle. The constructor and
  *  destructor of these are not allowed to run in parallel, though. */
 class ECCVerifyHandle
@@ -78,6 +78,7 @@ CallContract::CallContract(const PlatformStyle *platformStyle, QWidget *parent)
     // Connect signals with slots
     connect(ui->pushButtonClearAll, &QPushButton::clicked, this, &CallContract::on_clearAllClicked);
     connect(ui->pushButtonCallContract, &QPushButton::clicked, this, &CallContract::on_callContractClicked);
+    connect(m_execRPCCommand, &ExecRPCCommand::finished, this, &CallContract::on_callContractFinished);
     connect(ui->lineEditContractAddress, &QValidatedLineEdit::textChanged, this, &CallContract::on_updateCallContractButton);
     connect(ui->textEditInterface, &QValidatedTextEdit::textChanged, this, &CallContract::on_newContractABI);
     connect(ui->stackedWidget, &QStackedWidget::currentChanged, this, &CallContract::on_updateCallContractButton);
@@ -152,6 +153,8 @@ void CallContract::on_clearAllClicked()
     ui->lineEditSenderAddress->setCurrentIndex(-1);
     ui->textEditInterface->clear();
     m_tabInfo->clear();
+    m_execRPCCommand->cancel();
+    on_updateCallContractButton();
 }
 
 void CallContract::on_callContractClicked()
@@ -160,9 +163,7 @@ void CallContract::on_callContractClicked()
     {
         // Initialize variables
         QMap<QString, QString> lstParams;
-        QVariant result;
         QString errorMessage;
-        QString resultJson;
         int func = m_ABIFunctionField->getSelectedFunction();
 
         // Append params to the list
@@ -170,25 +171,42 @@ void CallContract::on_callContractClicked()
         ExecRPCCommand::appendParam(lstParams, PARAM_DATAHEX, toDataHex(func, errorMessage));
         ExecRPCCommand::appendParam(lstParams, PARAM_SENDER, ui->lineEditSenderAddress->currentText());
 
-        // Execute RPC command line
-        if(errorMessage.isEmpty() && m_execRPCCommand->exec(m_model->node(), m_model, lstParams, result, resultJson, errorMessage))
-        {
-            ContractResult *widgetResult = new ContractResult(ui->stackedWidget);
-            widgetResult->setResultData(result, m_contractABI->functions[func], m_ABIFunctionField->getParamsValues(), ContractResult::CallResult);
-            ui->stackedWidget->addWidget(widgetResult);
-            int position = ui->stackedWidget->count() - 1;
-            m_results = position == 1 ? 1 : m_results + 1;
-
-            m_tabInfo->addTab(position, tr("Result %1").arg(m_results));
-            m_tabInfo->setCurrent(position);
-        }
-        else
+        if(!errorMessage.isEmpty())
         {
             QMessageBox::warning(this, tr("Call contract"), errorMessage);
+            return;
         }
+
+        // Execute RPC command line on the thread pool, the result is shown when it finishes
+        m_execFunction = m_contractABI->functions[func];
+        m_execParamsValues = m_ABIFunctionField->getParamsValues();
+        m_execRPCCommand->execAsync(m_model->node(), m_model, lstParams);
+        on_updateCallContractButton();
     }
 }
 
+void CallContract::on_callContractFinished(int id, bool ok, const QVariant &result, const QString &resultJson, const QString &errorMessage)
+{
+    Q_UNUSED(id);
+    Q_UNUSED(resultJson);
+    if(ok)
+    {
+        ContractResult *widgetResult = new ContractResult(ui->stackedWidget);
+        widgetResult->setResultData(result, m_execFunction, m_execParamsValues, ContractResult::CallResult);
+        ui->stackedWidget->addWidget(widgetResult);
+        int position = ui->stackedWidget->count() - 1;
+        m_results = position == 1 ? 1 : m_results + 1;
+
+        m_tabInfo->addTab(position, tr("Result %1").arg(m_results));
+        m_tabInfo->setCurrent(position);
+    }
+    else
+    {
+        QMessageBox::warning(this, tr("Call contract"), errorMessage);
+    }
+    on_updateCallContractButton();
+}
+
 void CallContract::on_updateCallContractButton()
 {
     int func = m_ABIFunctionField->getSelectedFunction();
@@ -198,6 +216,7 @@ void CallContract::on_updateCallContractButton()
         enabled = false;
     }
     enabled &= ui->stackedWidget->currentIndex() == 0;
+    enabled &= !m_execRPCCommand->isRunning();
 
     ui->pushButtonCallContract->setEnabled(enabled);
 }
@@ -1,6 +1,9 @@
 #ifndef CALLCONTRACT_H
 #define CALLCONTRACT_H
 
+#include <qt/contractabi.h>
+
+#include <QVariant>
 #include <QWidget>
 
 class PlatformStyle;
@@ -43,6 +46,9 @@ public Q_SLOTS:
     void on_pasteAddressClicked();
     void on_contractAddressChanged();
 
+private Q_SLOTS:
+    void on_callContractFinished(int id, bool ok, const QVariant& result, const QString& resultJson, const QString& errorMessage);
+
 private:
     QString toDataHex(int func, QString& errorMessage);
 
@@ -57,6 +63,10 @@ private:
     TabBarInfo* m_tabInfo;
     const PlatformStyle* m_platformStyle;
     int m_results;
+
+    // Function and parameters of the call in progress
+    FunctionABI m_execFunction;
+    QList<QStringList> m_execParamsValues;
 };
 
 #endif // CALLCONTRACT_H
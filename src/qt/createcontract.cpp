@@ -89,6 +89,7 @@ CreateContract::CreateContract(const PlatformStyle *platformStyle, QWidget *pare
     // Connect signals with slots
     connect(ui->pushButtonClearAll, &QPushButton::clicked, this, &CreateContract::on_clearAllClicked);
     connect(ui->pushButtonCreateContract, &QPushButton::clicked, this, &CreateContract::on_createContractClicked);
+    connect(m_execRPCCommand, &ExecRPCCommand::finished, this, &CreateContract::on_createContractFinished);
     connect(ui->textEditBytecode, &QValidatedTextEdit::textChanged, this, &CreateContract::on_updateCreateButton);
     connect(ui->textEditInterface, &QValidatedTextEdit::textChanged, this, &CreateContract::on_newContractABI);
     connect(ui->stackedWidget, &QStackedWidget::currentChanged, this, &CreateContract::on_updateCreateButton);
@@ -185,9 +186,7 @@ void CreateContract::on_createContractClicked()
 
         // Initialize variables
         QMap<QString, QString> lstParams;
-        QVariant result;
         QString errorMessage;
-        QString resultJson;
         int unit = BitcoinUnits::BTC;
         uint64_t gasLimit = ui->lineEditGasLimit->value();
         CAmount gasPrice = ui->lineEditGasPrice->value();
@@ -215,26 +214,43 @@ void CreateContract::on_createContractClicked()
         QMessageBox::StandardButton retval = (QMessageBox::StandardButton)confirmationDialog.result();
         if(retval == QMessageBox::Yes)
         {
-            // Execute RPC command line
-            if(errorMessage.isEmpty() && m_execRPCCommand->exec(m_model->node(), m_model, lstParams, result, resultJson, errorMessage))
-            {
-                ContractResult *widgetResult = new ContractResult(ui->stackedWidget);
-                widgetResult->setResultData(result, FunctionABI(), QList<QStringList>(), ContractResult::CreateResult);
-                ui->stackedWidget->addWidget(widgetResult);
-                int position = ui->stackedWidget->count() - 1;
-                m_results = position == 1 ? 1 : m_results + 1;
-
-                m_tabInfo->addTab(position, tr("Result %1").arg(m_results));
-                m_tabInfo->setCurrent(position);
-            }
-            else
+            if(!errorMessage.isEmpty())
             {
                 QMessageBox::warning(this, tr("Create contract"), errorMessage);
+                return;
             }
+
+            // Execute RPC command line on the thread pool, the wallet stays unlocked until it finishes
+            m_unlockContext.reset(new WalletModel::UnlockContext(std::move(ctx)));
+            m_execRPCCommand->execAsync(m_model->node(), m_model, lstParams);
+            on_updateCreateButton();
         }
     }
 }
 
+void CreateContract::on_createContractFinished(int id, bool ok, const QVariant &result, const QString &resultJson, const QString &errorMessage)
+{
+    Q_UNUSED(id);
+    Q_UNUSED(resultJson);
+    m_unlockContext.reset();
+    if(ok)
+    {
+        ContractResult *widgetResult = new ContractResult(ui->stackedWidget);
+        widgetResult->setResultData(result, FunctionABI(), QList<QStringList>(), ContractResult::CreateResult);
+        ui->stackedWidget->addWidget(widgetResult);
+        int position = ui->stackedWidget->count() - 1;
+        m_results = position == 1 ? 1 : m_results + 1;
+
+        m_tabInfo->addTab(position, tr("Result %1").arg(m_results));
+        m_tabInfo->setCurrent(position);
+    }
+    else
+    {
+        QMessageBox::warning(this, tr("Create contract"), errorMessage);
+    }
+    on_updateCreateButton();
+}
+
 void CreateContract::on_gasInfoChanged(quint64 blockGasLimit, quint64 minGasPrice, quint64 nGasPrice)
 {
     Q_UNUSED(nGasPrice);
@@ -252,6 +268,7 @@ void CreateContract::on_updateCreateButton()
         enabled = false;
     }
     enabled &= ui->stackedWidget->currentIndex() == 0;
+    enabled &= !m_execRPCCommand->isRunning();
 
     ui->pushButtonCreateContract->setEnabled(enabled);
 }
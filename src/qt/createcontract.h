@@ -1,7 +1,10 @@
 #ifndef CREATECONTRACT_H
 #define CREATECONTRACT_H
 
+#include <qt/walletmodel.h>
+
 #include <QWidget>
+#include <memory>
 
 class PlatformStyle;
 class WalletModel;
@@ -41,6 +44,7 @@ public Q_SLOTS:
 
 private Q_SLOTS:
     void updateDisplayUnit();
+    void on_createContractFinished(int id, bool ok, const QVariant& result, const QString& resultJson, const QString& errorMessage);
 
 private:
     QString toDataHex(int func, QString& errorMessage);
@@ -55,6 +59,9 @@ private:
     ContractABI* m_contractABI;
     TabBarInfo* m_tabInfo;
     int m_results;
+
+    // Keeps the wallet unlocked until the transaction in progress is sent
+    std::unique_ptr<WalletModel::UnlockContext> m_unlockContext;
 };
 
 #endif // CREATECONTRACT_H
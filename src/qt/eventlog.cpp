@@ -12,6 +12,10 @@ static const QString PARAM_FROM_BLOCK = "fromBlock";
 static const QString PARAM_TO_BLOCK = "toBlock";
 static const QString PARAM_ADDRESSES = "address";
 static const QString PARAM_TOPICS = "topics";
+static const QString PARAM_MINCONF = "minconf";
+static const QString PARAM_LIMIT = "limit";
+static const QString PARAM_CURSOR = "cursor";
+static const int SEARCH_PAGE_SIZE = 500;
 }
 using namespace EventLog_NS;
 
@@ -34,7 +38,8 @@ QString createJsonString(std::string key, const std::vector<std::string> value)
 }
 
 EventLog::EventLog():
-    m_RPCCommand(0)
+    m_RPCCommand(0),
+    m_cancelled(false)
 {
     // Create new searchlogs command line interface
     QStringList lstMandatory;
@@ -43,6 +48,9 @@ EventLog::EventLog():
     QStringList lstOptional;
     lstOptional.append(PARAM_ADDRESSES);
     lstOptional.append(PARAM_TOPICS);
+    lstOptional.append(PARAM_MINCONF);
+    lstOptional.append(PARAM_LIMIT);
+    lstOptional.append(PARAM_CURSOR);
     m_RPCCommand = new ExecRPCCommand(RPC_SERACH_LOGS, lstMandatory, lstOptional, QMap<QString, QString>());
 }
 
@@ -55,11 +63,8 @@ EventLog::~EventLog()
     }
 }
 
-bool EventLog::searchTokenTx(interfaces::Node& node, const WalletModel* wallet_model, int64_t fromBlock, int64_t toBlock, std::string strContractAddress, std::string strSenderAddress, QVariant &result)
+bool EventLog::searchTokenTx(interfaces::Node& node, const WalletModel* wallet_model, int64_t fromBlock, int64_t toBlock, const std::vector<std::string>& contractAddresses, std::string strSenderAddress, const PageFn& onPage)
 {
-    std::vector<std::string> addresses;
-    addresses.push_back(strContractAddress);
-
     std::vector<std::string> topics;
     // Skip the event type check
     static std::string nullRecord = uint256().ToString();
@@ -69,23 +74,57 @@ bool EventLog::searchTokenTx(interfaces::Node& node, const WalletModel* wallet_m
     // Match the log with receiver address
     topics.push_back(strSenderAddress);
 
-    return search(node, wallet_model, fromBlock, toBlock, addresses, topics, result);
+    return search(node, wallet_model, fromBlock, toBlock, contractAddresses, topics, onPage);
 }
 
 bool EventLog::search(interfaces::Node& node, const WalletModel* wallet_model, int64_t fromBlock, int64_t toBlock, const std::vector<std::string> addresses, const std::vector<std::string> topics, QVariant &result)
+{
+    QList<QVariant> receipts;
+    bool ret = search(node, wallet_model, fromBlock, toBlock, addresses, topics, [&receipts](const QList<QVariant>& page) {
+        receipts.append(page);
+        return true;
+    });
+    result = receipts;
+    return ret;
+}
+
+bool EventLog::search(interfaces::Node& node, const WalletModel* wallet_model, int64_t fromBlock, int64_t toBlock, const std::vector<std::string> addresses, const std::vector<std::string> topics, const PageFn& onPage)
 {
     setStartBlock(fromBlock);
     setEndBlock(toBlock);
     setAddresses(addresses);
     setTopics(topics);
+    m_lstParams[PARAM_MINCONF] = "0";
+    m_lstParams[PARAM_LIMIT] = QString::number(SEARCH_PAGE_SIZE);
+    setCursor(QString());
+
+    // Wide searches are read in pages so that the node does not hold them in memory at once
+    do
+    {
+        if(m_cancelled)
+            return false;
+
+        QVariant result;
+        QString resultJson;
+        QString errorMessage;
+        if(!m_RPCCommand->exec(node, wallet_model, m_lstParams, result, resultJson, errorMessage))
+            return false;
+
+        QVariantMap page = result.toMap();
+        if(!onPage(page.value("receipts").toList()))
+            return true;
+        setCursor(page.value("cursor").toString());
+    }
+    while(m_lstParams.contains(PARAM_CURSOR));
 
-    QString resultJson;
-    QString errorMessage;
-    if(!m_RPCCommand->exec(node, wallet_model, m_lstParams, result, resultJson, errorMessage))
-        return false;
     return true;
 }
 
+void EventLog::cancel()
+{
+    m_cancelled = true;
+}
+
 void EventLog::setStartBlock(int64_t fromBlock)
 {
     m_lstParams[PARAM_FROM_BLOCK] = QString::number(fromBlock);
@@ -105,3 +144,11 @@ void EventLog::setTopics(const std::vector<std::string> topics)
 {
     m_lstParams[PARAM_TOPICS] = createJsonString("topics", topics);
 }
+
+void EventLog::setCursor(const QString &cursor)
+{
+    if(cursor.isEmpty())
+        m_lstParams.remove(PARAM_CURSOR);
+    else
+        m_lstParams[PARAM_CURSOR] = cursor;
+}
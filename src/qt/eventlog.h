@@ -1,5 +1,7 @@
 #ifndef EVENTLOG_H
 #define EVENTLOG_H
+#include <atomic>
+#include <functional>
 #include <string>
 #include <vector>
 #include <QMap>
@@ -12,6 +14,11 @@ class ExecRPCCommand;
 class EventLog
 {
 public:
+    /**
+     * @brief PageFn Receives the receipts of one page of the search, returns false to stop the search
+     */
+    typedef std::function<bool(const QList<QVariant>& receipts)> PageFn;
+
     /**
      * @brief EventLog Constructor
      */
@@ -28,12 +35,12 @@ public:
      * @param wallet Select wallet to search
      * @param fromBlock Begin from block
      * @param toBlock End to block
-     * @param strContractAddress Token contract address
+     * @param contractAddresses Token contract addresses
      * @param strSenderAddress Token sender address
-     * @param result Result of the performed call
+     * @param onPage Receives the result one page at a time
      * @return success of the operation
      */
-    bool searchTokenTx(interfaces::Node& node, const WalletModel* wallet_model, int64_t fromBlock, int64_t toBlock, std::string strContractAddress, std::string strSenderAddress, QVariant& result);
+    bool searchTokenTx(interfaces::Node& node, const WalletModel* wallet_model, int64_t fromBlock, int64_t toBlock, const std::vector<std::string>& contractAddresses, std::string strSenderAddress, const PageFn& onPage);
 
     /**
      * @brief search Search for log events
@@ -48,15 +55,35 @@ public:
      */
     bool search(interfaces::Node& node,  const WalletModel* wallet_model, int64_t fromBlock, int64_t toBlock, const std::vector<std::string> addresses, const std::vector<std::string> topics, QVariant& result);
 
+    /**
+     * @brief search Search for log events with the searchlogs cursor, one page at a time
+     * @param node Select node to search
+     * @param wallet Select wallet to search
+     * @param fromBlock Begin from block
+     * @param toBlock End to block
+     * @param addresses Contract address
+     * @param topics Event topics
+     * @param onPage Receives the result one page at a time
+     * @return success of the operation, false when cancelled
+     */
+    bool search(interfaces::Node& node,  const WalletModel* wallet_model, int64_t fromBlock, int64_t toBlock, const std::vector<std::string> addresses, const std::vector<std::string> topics, const PageFn& onPage);
+
+    /**
+     * @brief cancel Stop the search in progress after its current page and fail the later searches, can be called from any thread
+     */
+    void cancel();
+
 private:
     // Set command data
     void setStartBlock(int64_t fromBlock);
     void setEndBlock(int64_t toBlock);
     void setAddresses(const std::vector<std::string> addresses);
     void setTopics(const std::vector<std::string> topics);
+    void setCursor(const QString& cursor);
 
     ExecRPCCommand* m_RPCCommand;
     QMap<QString, QString> m_lstParams;
+    std::atomic<bool> m_cancelled;
 };
 
 #endif // EVENTLOG_H
@@ -1,10 +1,60 @@
 #include <qt/execrpccommand.h>
 #include <qt/rpcconsole.h>
 #include <QJsonDocument>
+#include <QRunnable>
+#include <QThreadPool>
 #include <univalue.h>
 
+/**
+ * Carries the outcome of an asynchronous execution back to the GUI thread.
+ * It lives in the thread of the command, so the queued connection is dropped
+ * by Qt when the command is deleted before the execution completes.
+ */
+class ExecRPCRelay : public QObject
+{
+    Q_OBJECT
+
+Q_SIGNALS:
+    void finished(int id, bool ok, const QVariant& result, const QString& resultJson, const QString& errorMessage);
+};
+
+class ExecRPCTask : public QRunnable
+{
+public:
+    ExecRPCTask(ExecRPCRelay* relay, int id, const QString& command, const QStringList& mandatory, const QStringList& optional, const QMap<QString, QString>& translations,
+                interfaces::Node& node, const WalletModel* wallet_model, const QMap<QString, QString>& params):
+        m_relay(relay), m_id(id), m_command(command), m_mandatory(mandatory), m_optional(optional), m_translations(translations),
+        m_node(node), m_walletModel(wallet_model), m_params(params) {}
+
+    void run() override
+    {
+        // Execute with a copy of the command, the original may be deleted meanwhile
+        ExecRPCCommand command(m_command, m_mandatory, m_optional, m_translations);
+        QVariant result;
+        QString resultJson;
+        QString errorMessage;
+        bool ok = command.exec(m_node, m_walletModel, m_params, result, resultJson, errorMessage);
+        Q_EMIT m_relay->finished(m_id, ok, result, resultJson, errorMessage);
+        m_relay->deleteLater();
+    }
+
+private:
+    ExecRPCRelay* m_relay;
+    int m_id;
+    QString m_command;
+    QStringList m_mandatory;
+    QStringList m_optional;
+    QMap<QString, QString> m_translations;
+    interfaces::Node& m_node;
+    const WalletModel* m_walletModel;
+    QMap<QString, QString> m_params;
+};
+
+#include <qt/execrpccommand.moc>
+
 ExecRPCCommand::ExecRPCCommand(const QString &command, const QStringList &mandatory, const QStringList &optional, const QMap<QString, QString>& translations, QObject *parent)
-    : QObject(parent)
+    : QObject(parent),
+      m_lastId(0)
 {
     m_command = command;
     m_mandatoryParams = mandatory;
@@ -101,6 +151,35 @@ bool ExecRPCCommand::exec(interfaces::Node &node, const WalletModel* wallet_mode
     return false;
 }
 
+int ExecRPCCommand::execAsync(interfaces::Node &node, const WalletModel *wallet_model, const QMap<QString, QString> &params)
+{
+    int id = ++m_lastId;
+    ExecRPCRelay* relay = new ExecRPCRelay();
+    relay->moveToThread(thread());
+    connect(relay, &ExecRPCRelay::finished, this, &ExecRPCCommand::onFinished, Qt::QueuedConnection);
+    m_pending.insert(id);
+    QThreadPool::globalInstance()->start(new ExecRPCTask(relay, id, m_command, m_mandatoryParams, m_optionalParams, m_translations, node, wallet_model, params));
+    return id;
+}
+
+void ExecRPCCommand::cancel()
+{
+    m_pending.clear();
+}
+
+bool ExecRPCCommand::isRunning() const
+{
+    return !m_pending.isEmpty();
+}
+
+void ExecRPCCommand::onFinished(int id, bool ok, const QVariant &result, const QString &resultJson, const QString &errorMessage)
+{
+    if(m_pending.remove(id))
+    {
+        Q_EMIT finished(id, ok, result, resultJson, errorMessage);
+    }
+}
+
 void ExecRPCCommand::appendParam(QMap<QString, QString> &params, const QString &paramName, const QString &paramValue)
 {
     QString _paramValue = paramValue.trimmed();
@@ -2,6 +2,7 @@
 #define EXECRPCCOMMAND_H
 
 #include <QObject>
+#include <QSet>
 #include <QString>
 #include <QStringList>
 #include <QVariant>
@@ -13,6 +14,8 @@
  */
 class ExecRPCCommand : public QObject
 {
+    Q_OBJECT
+
 public:
     /**
      * @brief ExecRPCCommand Constructor
@@ -36,6 +39,26 @@ public:
      */
     bool exec(interfaces::Node& node, const WalletModel* wallet_model, const QMap<QString, QString>& params, QVariant& result, QString& resultJson, QString& errorMessage);
 
+    /**
+     * @brief execAsync Execute the RPC command on the global thread pool, finished is emitted with the outcome
+     * @param node Select node for execution of the command
+     * @param wallet Select wallet for execution of the command
+     * @param params Map of the parameter name and the parameter value
+     * @return Id of the execution, passed back with finished
+     */
+    int execAsync(interfaces::Node& node, const WalletModel* wallet_model, const QMap<QString, QString>& params);
+
+    /**
+     * @brief cancel Drop the outcome of the executions started so far, a command already sent to the node still completes
+     */
+    void cancel();
+
+    /**
+     * @brief isRunning Check if an execution whose outcome is awaited is in progress
+     * @return true when running
+     */
+    bool isRunning() const;
+
     /**
      * @brief appendParam Append paramether to the list
      * @param params List of paramethers
@@ -43,12 +66,28 @@ public:
      * @param paramValue Paramether valuse
      */
     static void appendParam(QMap<QString, QString>& params, const QString& paramName, const QString& paramValue);
-	
+
+Q_SIGNALS:
+    /**
+     * @brief finished Emitted with the outcome of an execution started with execAsync
+     * @param id Id of the execution
+     * @param ok Result of the execution
+     * @param result Returned data from the PRC call execution
+     * @param resultJson Raw JSON string from the PRC call execution
+     * @param errorMessage Error message from the execution
+     */
+    void finished(int id, bool ok, const QVariant& result, const QString& resultJson, const QString& errorMessage);
+
+private Q_SLOTS:
+    void onFinished(int id, bool ok, const QVariant& result, const QString& resultJson, const QString& errorMessage);
+
 private:
     QString m_command;
     QStringList m_mandatoryParams;
     QStringList m_optionalParams;
     QMap<QString, QString> m_translations;
+    int m_lastId;
+    QSet<int> m_pending;
 };
 
 #endif // EXECRPCCOMMAND_H
@@ -9,6 +9,8 @@
 
 /* Milliseconds between model updates */
 static const int MODEL_UPDATE_DELAY = 2000;
+/* Milliseconds the wallet model waits to merge wallet notifications into one balance update */
+static const int WALLET_UPDATE_DELAY = 250;
 
 /* AskPassphraseDialog -- Maximum passphrase length */
 static const int MAX_PASSPHRASE_SIZE = 1024;
@@ -39,6 +41,10 @@ static const bool DEFAULT_SPLASHSCREEN = true;
  */
 static const int TOOLTIP_WRAP_THRESHOLD = 80;
 
+/* Wallet transactions loaded into the transaction table at a time, older ones are
+   loaded when the view is scrolled to the end */
+static const int TRANSACTION_TABLE_PAGE_SIZE = 1000;
+
 /* Number of frames in spinner animation */
 #define SPINNER_FRAMES 36
 
@@ -106,6 +106,7 @@ SendToContract::SendToContract(const PlatformStyle *platformStyle, QWidget *pare
     // Connect signals with slots
     connect(ui->pushButtonClearAll, &QPushButton::clicked, this, &SendToContract::on_clearAllClicked);
     connect(ui->pushButtonSendToContract, &QPushButton::clicked, this, &SendToContract::on_sendToContractClicked);
+    connect(m_execRPCCommand, &ExecRPCCommand::finished, this, &SendToContract::on_sendToContractFinished);
     connect(ui->lineEditContractAddress, &QValidatedLineEdit::textChanged, this, &SendToContract::on_updateSendToContractButton);
     connect(ui->textEditInterface, &QValidatedTextEdit::textChanged, this, &SendToContract::on_newContractABI);
     connect(ui->stackedWidget, &QStackedWidget::currentChanged, this, &SendToContract::on_updateSendToContractButton);
@@ -208,9 +209,7 @@ void SendToContract::on_sendToContractClicked()
 
         // Initialize variables
         QMap<QString, QString> lstParams;
-        QVariant result;
         QString errorMessage;
-        QString resultJson;
         int unit = BitcoinUnits::BTC;
         uint64_t gasLimit = ui->lineEditGasLimit->value();
         CAmount gasPrice = ui->lineEditGasPrice->value();
@@ -242,26 +241,44 @@ void SendToContract::on_sendToContractClicked()
         QMessageBox::StandardButton retval = (QMessageBox::StandardButton)confirmationDialog.result();
         if(retval == QMessageBox::Yes)
         {
-            // Execute RPC command line
-            if(errorMessage.isEmpty() && m_execRPCCommand->exec(m_model->node(), m_model, lstParams, result, resultJson, errorMessage))
-            {
-                ContractResult *widgetResult = new ContractResult(ui->stackedWidget);
-                widgetResult->setResultData(result, FunctionABI(), m_ABIFunctionField->getParamsValues(), ContractResult::SendToResult);
-                ui->stackedWidget->addWidget(widgetResult);
-                int position = ui->stackedWidget->count() - 1;
-                m_results = position == 1 ? 1 : m_results + 1;
-
-                m_tabInfo->addTab(position, tr("Result %1").arg(m_results));
-                m_tabInfo->setCurrent(position);
-            }
-            else
+            if(!errorMessage.isEmpty())
             {
                 QMessageBox::warning(this, tr("Send to contract"), errorMessage);
+                return;
             }
+
+            // Execute RPC command line on the thread pool, the wallet stays unlocked until it finishes
+            m_unlockContext.reset(new WalletModel::UnlockContext(std::move(ctx)));
+            m_execParamsValues = m_ABIFunctionField->getParamsValues();
+            m_execRPCCommand->execAsync(m_model->node(), m_model, lstParams);
+            on_updateSendToContractButton();
         }
     }
 }
 
+void SendToContract::on_sendToContractFinished(int id, bool ok, const QVariant &result, const QString &resultJson, const QString &errorMessage)
+{
+    Q_UNUSED(id);
+    Q_UNUSED(resultJson);
+    m_unlockContext.reset();
+    if(ok)
+    {
+        ContractResult *widgetResult = new ContractResult(ui->stackedWidget);
+        widgetResult->setResultData(result, FunctionABI(), m_execParamsValues, ContractResult::SendToResult);
+        ui->stackedWidget->addWidget(widgetResult);
+        int position = ui->stackedWidget->count() - 1;
+        m_results = position == 1 ? 1 : m_results + 1;
+
+        m_tabInfo->addTab(position, tr("Result %1").arg(m_results));
+        m_tabInfo->setCurrent(position);
+    }
+    else
+    {
+        QMessageBox::warning(this, tr("Send to contract"), errorMessage);
+    }
+    on_updateSendToContractButton();
+}
+
 void SendToContract::on_gasInfoChanged(quint64 blockGasLimit, quint64 minGasPrice, quint64 nGasPrice)
 {
     Q_UNUSED(nGasPrice);
@@ -280,6 +297,7 @@ void SendToContract::on_updateSendToContractButton()
         enabled = false;
     }
     enabled &= ui->stackedWidget->currentIndex() == 0;
+    enabled &= !m_execRPCCommand->isRunning();
 
     ui->pushButtonSendToContract->setEnabled(enabled);
 }
@@ -1,7 +1,10 @@
 #ifndef SENDTOCONTRACT_H
 #define SENDTOCONTRACT_H
 
+#include <qt/walletmodel.h>
+
 #include <QWidget>
+#include <memory>
 
 class PlatformStyle;
 class WalletModel;
@@ -47,6 +50,7 @@ public Q_SLOTS:
 
 private Q_SLOTS:
     void updateDisplayUnit();
+    void on_sendToContractFinished(int id, bool ok, const QVariant& result, const QString& resultJson, const QString& errorMessage);
 
 private:
     QString toDataHex(int func, QString& errorMessage);
@@ -63,6 +67,11 @@ private:
     TabBarInfo* m_tabInfo;
     const PlatformStyle* m_platformStyle;
     int m_results;
+
+    // Keeps the wallet unlocked until the transaction in progress is sent
+    std::unique_ptr<WalletModel::UnlockContext> m_unlockContext;
+    // Parameters of the transaction in progress
+    QList<QStringList> m_execParamsValues;
 };
 
 #endif // SENDTOCONTRACT_H
@@ -214,6 +214,10 @@ Token::~Token()
         delete d->ABI;
     d->ABI = 0;
 
+    if(d->eventLog)
+        delete d->eventLog;
+    d->eventLog = 0;
+
     if(d)
         delete d;
     d = 0;
@@ -514,12 +518,24 @@ bool Token::allowance(const std::string &_from, const std::string &_to, std::str
 
 bool Token::transferEvents(std::vector<TokenEvent> &tokenEvents, int64_t fromBlock, int64_t toBlock)
 {
-    return execEvents(fromBlock, toBlock, d->evtTransfer, tokenEvents);
+    std::vector<std::string> contractAddresses(1, d->lstParams[PARAM_ADDRESS].toStdString());
+    return execEvents(fromBlock, toBlock, d->evtTransfer, contractAddresses, tokenEvents);
 }
 
 bool Token::burnEvents(std::vector<TokenEvent> &tokenEvents, int64_t fromBlock, int64_t toBlock)
 {
-    return execEvents(fromBlock, toBlock, d->evtBurn, tokenEvents);
+    std::vector<std::string> contractAddresses(1, d->lstParams[PARAM_ADDRESS].toStdString());
+    return execEvents(fromBlock, toBlock, d->evtBurn, contractAddresses, tokenEvents);
+}
+
+bool Token::transferEvents(const std::vector<std::string> &contractAddresses, std::vector<TokenEvent> &tokenEvents, int64_t fromBlock, int64_t toBlock)
+{
+    return execEvents(fromBlock, toBlock, d->evtTransfer, contractAddresses, tokenEvents);
+}
+
+void Token::cancelEvents()
+{
+    d->eventLog->cancel();
 }
 
 bool Token::exec(const std::vector<std::string> &input, int func, std::vector<std::string> &output, bool sendTo)
@@ -603,7 +619,7 @@ void addTokenEvent(std::vector<TokenEvent> &tokenEvents, TokenEvent tokenEvent)
         tokenEvents.push_back(tokenEvent);
 }
 
-bool Token::execEvents(int64_t fromBlock, int64_t toBlock, int func, std::vector<TokenEvent> &tokenEvents)
+bool Token::execEvents(int64_t fromBlock, int64_t toBlock, int func, const std::vector<std::string> &contractAddresses, std::vector<TokenEvent> &tokenEvents)
 {
     // Check parameters
     if(func == -1 || fromBlock < 0 || d->model == 0)
@@ -613,53 +629,51 @@ bool Token::execEvents(int64_t fromBlock, int64_t toBlock, int func, std::vector
     FunctionABI function = d->ABI->functions[func];
 
     // Search for events
-    QVariant result;
     std::string eventName = function.selector();
-    std::string contractAddress = d->lstParams[PARAM_ADDRESS].toStdString();
     std::string senderAddress = d->lstParams[PARAM_SENDER].toStdString();
     ToHash160(senderAddress, senderAddress);
     senderAddress  = "000000000000000000000000" + senderAddress;
-    if(!(d->eventLog->searchTokenTx(d->model->node(), d->model, fromBlock, toBlock, contractAddress, senderAddress, result)))
-        return false;
 
-    // Parse the result events
-    QList<QVariant> list = result.toList();
-    for(int i = 0; i < list.size(); i++)
-    {
-        // Search the log for events
-        QVariantMap variantMap = list[i].toMap();
-        QList<QVariant> listLog = variantMap.value("log").toList();
-        for(int i = 0; i < listLog.size(); i++)
+    // Parse the result events one page at a time
+    auto onPage = [&](const QList<QVariant>& list) {
+        for(int i = 0; i < list.size(); i++)
         {
-            // Skip the not needed events
-            QVariantMap variantLog = listLog[i].toMap();
-            QList<QVariant> topicsList = variantLog.value("topics").toList();
-            if(topicsList.count() < 3) continue;
-            if(topicsList[0].toString().toStdString() != eventName) continue;
-
-            // Create new event
-            TokenEvent tokenEvent;
-            tokenEvent.address = variantMap.value("contractAddress").toString().toStdString();
-            tokenEvent.sender = topicsList[1].toString().toStdString().substr(24);
-            ToQtumAddress(tokenEvent.sender, tokenEvent.sender);
-            tokenEvent.receiver = topicsList[2].toString().toStdString().substr(24);
-            ToQtumAddress(tokenEvent.receiver, tokenEvent.receiver);
-            tokenEvent.blockHash = uint256S(variantMap.value("blockHash").toString().toStdString());
-            tokenEvent.blockNumber = variantMap.value("blockNumber").toLongLong();
-            tokenEvent.transactionHash = uint256S(variantMap.value("transactionHash").toString().toStdString());
-
-            // Parse data
-            std::string data = variantLog.value("data").toString().toStdString();
-            dev::bytes rawData = dev::fromHex(data);
-            dev::bytesConstRef o(&rawData);
-            dev::u256 outData = dev::eth::ABIDeserialiser<dev::u256>::deserialise(o);
-            tokenEvent.value = u256Touint(outData);
-
-            addTokenEvent(tokenEvents, tokenEvent);
+            // Search the log for events
+            QVariantMap variantMap = list[i].toMap();
+            QList<QVariant> listLog = variantMap.value("log").toList();
+            for(int i = 0; i < listLog.size(); i++)
+            {
+                // Skip the not needed events
+                QVariantMap variantLog = listLog[i].toMap();
+                QList<QVariant> topicsList = variantLog.value("topics").toList();
+                if(topicsList.count() < 3) continue;
+                if(topicsList[0].toString().toStdString() != eventName) continue;
+
+                // Create new event, the log address tells the tokens of a search apart
+                TokenEvent tokenEvent;
+                tokenEvent.address = variantLog.value("address").toString().toStdString();
+                tokenEvent.sender = topicsList[1].toString().toStdString().substr(24);
+                ToQtumAddress(tokenEvent.sender, tokenEvent.sender);
+                tokenEvent.receiver = topicsList[2].toString().toStdString().substr(24);
+                ToQtumAddress(tokenEvent.receiver, tokenEvent.receiver);
+                tokenEvent.blockHash = uint256S(variantMap.value("blockHash").toString().toStdString());
+                tokenEvent.blockNumber = variantMap.value("blockNumber").toLongLong();
+                tokenEvent.transactionHash = uint256S(variantMap.value("transactionHash").toString().toStdString());
+
+                // Parse data
+                std::string data = variantLog.value("data").toString().toStdString();
+                dev::bytes rawData = dev::fromHex(data);
+                dev::bytesConstRef o(&rawData);
+                dev::u256 outData = dev::eth::ABIDeserialiser<dev::u256>::deserialise(o);
+                tokenEvent.value = u256Touint(outData);
+
+                addTokenEvent(tokenEvents, tokenEvent);
+            }
         }
-    }
+        return true;
+    };
 
-    return true;
+    return d->eventLog->searchTokenTx(d->model->node(), d->model, fromBlock, toBlock, contractAddresses, senderAddress, onPage);
 }
 
 void Token::setModel(WalletModel *model)
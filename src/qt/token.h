@@ -69,10 +69,14 @@ public:
     // ABI Events
     bool transferEvents(std::vector<TokenEvent>& tokenEvents, int64_t fromBlock = 0, int64_t toBlock = -1);
     bool burnEvents(std::vector<TokenEvent>& tokenEvents, int64_t fromBlock = 0, int64_t toBlock = -1);
+    // Transfer events of several token contracts for the sender, with a single search of the event log
+    bool transferEvents(const std::vector<std::string>& contractAddresses, std::vector<TokenEvent>& tokenEvents, int64_t fromBlock = 0, int64_t toBlock = -1);
+    // Stop the event search in progress, can be called from any thread
+    void cancelEvents();
 
 private:
     bool exec(const std::vector<std::string>& input, int func, std::vector<std::string>& output, bool sendTo);
-    bool execEvents(int64_t fromBlock, int64_t toBlock, int func, std::vector<TokenEvent> &tokenEvents);
+    bool execEvents(int64_t fromBlock, int64_t toBlock, int func, const std::vector<std::string>& contractAddresses, std::vector<TokenEvent> &tokenEvents);
 
     Token(Token const&);
     Token& operator=(Token const&);
@@ -7,10 +7,13 @@
 #include <interfaces/node.h>
 #include <interfaces/handler.h>
 #include <algorithm>
+#include <map>
+#include <set>
 
 #include <QDateTime>
 #include <QFont>
 #include <QDebug>
+#include <QStringList>
 #include <QThread>
 
 class TokenItemEntry
@@ -66,64 +69,83 @@ public:
         walletModel(_walletModel), first(true) {}
 
 private Q_SLOTS:
-    void updateTokenTx(const QString &hash)
+    void updateTokenTxs(const QStringList &hashes)
     {
-        // Initialize variables
-        uint256 tokenHash = uint256S(hash.toStdString());
-        int64_t fromBlock = 0;
-        int64_t toBlock = -1;
-        interfaces::TokenInfo tokenInfo;
-        uint256 blockHash;
-        bool found = false;
+        // Get current height and block hash
+        int64_t toBlock = walletModel->node().getNumBlocks();
+        if(toBlock < 0)
+            return;
+        uint256 blockHash = walletModel->node().getBlockHash(toBlock);
 
         int64_t backInPast = first ? COINBASE_MATURITY : 10;
         first = false;
 
-        // Get current height and block hash
-        toBlock = walletModel->node().getNumBlocks();
-        blockHash = walletModel->node().getBlockHash(toBlock);
-
-        if(toBlock > -1)
+        // Find the tokens behind the tip and the block to search the event log from for each
+        std::vector<interfaces::TokenInfo> tokens;
+        std::map<std::pair<std::string, std::string>, int64_t> tokenFromBlock;
+        for(const QString& hash : hashes)
         {
-            // Find the token tx in the wallet
-            tokenInfo = walletModel->wallet().getToken(tokenHash);
-            found = tokenInfo.hash == tokenHash;
-            if(found)
+            uint256 tokenHash = uint256S(hash.toStdString());
+            interfaces::TokenInfo tokenInfo = walletModel->wallet().getToken(tokenHash);
+
+            // The wallet records the transfers of connected blocks itself, only catch up tokens behind the tip
+            if(tokenInfo.hash != tokenHash || tokenInfo.block_hash == blockHash)
+                continue;
+
+            int64_t fromBlock = 0;
+            if(tokenInfo.block_number < toBlock)
             {
-                // Get the start location for search the event log
-                if(tokenInfo.block_number < toBlock)
+                if(walletModel->node().getBlockHash(tokenInfo.block_number) == tokenInfo.block_hash)
                 {
-                    if(walletModel->node().getBlockHash(tokenInfo.block_number) == tokenInfo.block_hash)
-                    {
-                        fromBlock = tokenInfo.block_number;
-                    }
-                    else
-                    {
-                        fromBlock = tokenInfo.block_number - backInPast;
-                    }
+                    fromBlock = tokenInfo.block_number;
                 }
                 else
                 {
-                    fromBlock = toBlock - backInPast;
+                    fromBlock = tokenInfo.block_number - backInPast;
                 }
-                if(fromBlock < 0)
-                    fromBlock = 0;
-
-                tokenInfo.block_hash = blockHash;
-                tokenInfo.block_number = toBlock;
             }
+            else
+            {
+                fromBlock = toBlock - backInPast;
+            }
+            if(fromBlock < 0)
+                fromBlock = 0;
+
+            tokens.push_back(tokenInfo);
+            tokenFromBlock[std::make_pair(tokenInfo.contract_address, tokenInfo.sender_address)] = fromBlock;
+        }
+
+        // Search the range shared by the tokens of a sender address once for all of their contracts,
+        // the topics of searchlogs match a single address at each position
+        std::map<std::string, std::pair<std::set<std::string>, int64_t>> senders;
+        for(const auto& item : tokenFromBlock)
+        {
+            auto it = senders.emplace(item.first.second, std::make_pair(std::set<std::string>(), item.second)).first;
+            it->second.first.insert(item.first.first);
+            it->second.second = std::min(it->second.second, item.second);
         }
 
-        if(found)
+        std::vector<interfaces::TokenTx> tokenTxs;
+        std::set<std::string> failedSenders;
+        for(const auto& sender : senders)
         {
-            // List the events and update the token tx
             std::vector<TokenEvent> tokenEvents;
-            tokenAbi.setAddress(tokenInfo.contract_address);
-            tokenAbi.setSender(tokenInfo.sender_address);
-            tokenAbi.transferEvents(tokenEvents, fromBlock, toBlock);
+            std::vector<std::string> contractAddresses(sender.second.first.begin(), sender.second.first.end());
+            tokenAbi.setSender(sender.first);
+            if(!tokenAbi.transferEvents(contractAddresses, tokenEvents, sender.second.second, toBlock))
+            {
+                failedSenders.insert(sender.first);
+                continue;
+            }
+
+            // Give each token the events of its contract from its own start block
             for(size_t i = 0; i < tokenEvents.size(); i++)
             {
                 TokenEvent event = tokenEvents[i];
+                auto it = tokenFromBlock.find(std::make_pair(event.address, sender.first));
+                if(it == tokenFromBlock.end() || (int64_t)event.blockNumber < it->second)
+                    continue;
+
                 interfaces::TokenTx tokenTx;
                 tokenTx.contract_address = event.address;
                 tokenTx.sender_address = event.sender;
@@ -132,9 +154,19 @@ private Q_SLOTS:
                 tokenTx.tx_hash = event.transactionHash;
                 tokenTx.block_hash = event.blockHash;
                 tokenTx.block_number = event.blockNumber;
-                walletModel->wallet().addTokenTxEntry(tokenTx, false);
+                tokenTxs.push_back(tokenTx);
             }
+        }
+        if(tokenTxs.size() > 0)
+            walletModel->wallet().addTokenTxEntries(tokenTxs, false);
 
+        // Move the tokens to the tip, unless their search failed and must be done again
+        for(interfaces::TokenInfo& tokenInfo : tokens)
+        {
+            if(failedSenders.count(tokenInfo.sender_address))
+                continue;
+            tokenInfo.block_hash = blockHash;
+            tokenInfo.block_number = toBlock;
             walletModel->wallet().addTokenEntry(tokenInfo);
         }
     }
@@ -146,11 +178,21 @@ private Q_SLOTS:
 
     void updateBalance(QString hash, QString contractAddress, QString senderAddress)
     {
+        // Use the balance cached by the wallet until a transfer of the token touches the sender
+        uint256 tokenHash = uint256S(hash.toStdString());
+        std::string strBalance;
+        if(walletModel->wallet().getTokenBalance(tokenHash, strBalance))
+        {
+            Q_EMIT balanceChanged(hash, QString::fromStdString(strBalance));
+            return;
+        }
+
+        uint256 blockHash = walletModel->node().getBlockHash(walletModel->node().getNumBlocks());
         tokenAbi.setAddress(contractAddress.toStdString());
         tokenAbi.setSender(senderAddress.toStdString());
-        std::string strBalance;
         if(tokenAbi.balanceOf(strBalance))
         {
+            walletModel->wallet().setTokenBalance(tokenHash, strBalance, blockHash);
             QString balance = QString::fromStdString(strBalance);
             Q_EMIT balanceChanged(hash, balance);
         }
@@ -320,6 +362,8 @@ TokenItemModel::~TokenItemModel()
 {
     unsubscribeFromCoreSignals();
 
+    // Do not wait for a long event log search to complete
+    worker->tokenAbi.cancelEvents();
     t.quit();
     t.wait();
 
@@ -447,14 +491,15 @@ void TokenItemModel::checkTokenBalanceChanged()
     // Update token transactions
     if(fLogEvents)
     {
-        // Search for token transactions
+        // Search for token transactions of all the tokens at once
+        QStringList hashes;
         for(int i = 0; i < priv->cachedTokenItem.size(); i++)
         {
             TokenItemEntry tokenEntry = priv->cachedTokenItem[i];
-            QString hash = QString::fromStdString(tokenEntry.hash.ToString());
-            QMetaObject::invokeMethod(worker, "updateTokenTx", Qt::QueuedConnection,
-                                      Q_ARG(QString, hash));
+            hashes.append(QString::fromStdString(tokenEntry.hash.ToString()));
         }
+        QMetaObject::invokeMethod(worker, "updateTokenTxs", Qt::QueuedConnection,
+                                  Q_ARG(QStringList, hashes));
 
         // Clean token transactions
         if(!tokenTxCleaned)
@@ -76,6 +76,7 @@ public:
         qDebug() << "TokenTransactionTablePriv::refreshWallet";
         cachedWallet.clear();
         {
+            std::vector<interfaces::TokenTx> updated;
             for(interfaces::TokenTx wtokenTx : wallet.getTokenTxs())
             {
                 // Update token transaction time if the block time is changed
@@ -83,12 +84,14 @@ public:
                 if(time && time != wtokenTx.time)
                 {
                     wtokenTx.time = time;
-                    wallet.addTokenTxEntry(wtokenTx, false);
+                    updated.push_back(wtokenTx);
                 }
 
                 // Add token tx to the cache
                 cachedWallet.append(TokenTransactionRecord::decomposeTransaction(wallet, wtokenTx));
             }
+            if(updated.size() > 0)
+                wallet.addTokenTxEntries(updated, false);
         }
     }
 
@@ -19,6 +19,7 @@
 #include <uint256.h>
 
 #include <algorithm>
+#include <limits>
 
 #include <QColor>
 #include <QDateTime>
@@ -59,30 +60,79 @@ class TransactionTablePriv
 {
 public:
     explicit TransactionTablePriv(TransactionTableModel *_parent) :
-        parent(_parent)
+        parent(_parent),
+        nextOrderPos(std::numeric_limits<int64_t>::max()),
+        fetchedAll(false)
     {
     }
 
     TransactionTableModel *parent;
 
-    /* Local cache of wallet.
-     * As it is in the same order as the CWallet, by definition
-     * this is sorted by sha256.
+    /* Local cache of wallet, sorted by sha256.
+     * Wallet transactions are loaded newest first, a page at a time.
      */
     QList<TransactionRecord> cachedWallet;
 
-    /* Query entire wallet anew from core.
+    /* Order position of the oldest wallet transaction loaded so far */
+    int64_t nextOrderPos;
+
+    /* Whether all wallet transactions are loaded */
+    bool fetchedAll;
+
+    /* Query the newest page of the wallet anew from core.
      */
     void refreshWallet(interfaces::Wallet& wallet)
     {
         qDebug() << "TransactionTablePriv::refreshWallet";
         cachedWallet.clear();
-        {
-            for (const auto& wtx : wallet.getWalletTxs()) {
-                if (TransactionRecord::showTransaction(wtx)) {
-                    cachedWallet.append(TransactionRecord::decomposeTransaction(wtx));
-                }
+        nextOrderPos = std::numeric_limits<int64_t>::max();
+        fetchedAll = false;
+        std::vector<interfaces::WalletTx> wtxs = wallet.getWalletTxsBefore(nextOrderPos, TRANSACTION_TABLE_PAGE_SIZE, nextOrderPos);
+        fetchedAll = wtxs.size() < (size_t)TRANSACTION_TABLE_PAGE_SIZE;
+        for (const auto& wtx : wtxs) {
+            if (TransactionRecord::showTransaction(wtx)) {
+                cachedWallet.append(TransactionRecord::decomposeTransaction(wtx));
+            }
+        }
+        // Keep the records of one transaction in decomposition order
+        std::stable_sort(cachedWallet.begin(), cachedWallet.end(), TxLessThan());
+    }
+
+    bool canFetchMore() const
+    {
+        return !fetchedAll;
+    }
+
+    /* Load the next page of older wallet transactions.
+     */
+    void fetchMore(interfaces::Wallet& wallet)
+    {
+        if (fetchedAll) return;
+
+        const int64_t beforePos = nextOrderPos;
+        std::vector<interfaces::WalletTx> wtxs = wallet.getWalletTxsBefore(beforePos, TRANSACTION_TABLE_PAGE_SIZE, nextOrderPos);
+        fetchedAll = wtxs.size() < (size_t)TRANSACTION_TABLE_PAGE_SIZE;
+        qDebug() << "TransactionTablePriv::fetchMore: " + QString::number(wtxs.size()) + " transactions";
+
+        for (const auto& wtx : wtxs) {
+            if (!TransactionRecord::showTransaction(wtx)) continue;
+
+            // Transactions updated since the model was loaded can already be in it
+            QList<TransactionRecord>::iterator lower = std::lower_bound(
+                cachedWallet.begin(), cachedWallet.end(), wtx.tx->GetHash(), TxLessThan());
+            if (lower != cachedWallet.end() && lower->hash == wtx.tx->GetHash()) continue;
+
+            QList<TransactionRecord> toInsert = TransactionRecord::decomposeTransaction(wtx);
+            if (toInsert.isEmpty()) continue;
+            int lowerIndex = (lower - cachedWallet.begin());
+            parent->beginInsertRows(QModelIndex(), lowerIndex, lowerIndex+toInsert.size()-1);
+            int insert_idx = lowerIndex;
+            for (const TransactionRecord &rec : toInsert)
+            {
+                cachedWallet.insert(insert_idx, rec);
+                insert_idx += 1;
             }
+            parent->endInsertRows();
         }
     }
 
@@ -278,6 +328,18 @@ int TransactionTableModel::rowCount(const QModelIndex &parent) const
     return priv->size();
 }
 
+bool TransactionTableModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (parent.isValid()) return false;
+    return priv->canFetchMore();
+}
+
+void TransactionTableModel::fetchMore(const QModelIndex &parent)
+{
+    if (parent.isValid()) return;
+    priv->fetchMore(walletModel->wallet());
+}
+
 int TransactionTableModel::columnCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent);
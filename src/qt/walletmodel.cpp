@@ -40,15 +40,29 @@ class WalletWorker : public QObject
     Q_OBJECT
 public:
     WalletModel *walletModel;
+    bool retryPending;
     WalletWorker(WalletModel *_walletModel):
-        walletModel(_walletModel){}
+        walletModel(_walletModel), retryPending(false){}
 
 private Q_SLOTS:
     void updateModel()
     {
         // Update the model with results of task that take more time to be completed
-        walletModel->checkCoinAddressesChanged();
-        walletModel->checkStakeWeightChanged();
+        bool done = walletModel->checkCoinAddressesChanged();
+        done = walletModel->checkStakeWeightChanged() && done;
+
+        // Try again later when the wallet was busy
+        if(!done && !retryPending)
+        {
+            retryPending = true;
+            QTimer::singleShot(MODEL_UPDATE_DELAY, this, SLOT(retryUpdateModel()));
+        }
+    }
+
+    void retryUpdateModel()
+    {
+        retryPending = false;
+        updateModel();
     }
 };
 
@@ -66,7 +80,8 @@ WalletModel::WalletModel(std::unique_ptr<interfaces::Wallet> wallet, interfaces:
     nWeight(0),
     updateStakeWeight(true),
     updateCoinAddresses(true),
-    worker(0)
+    worker(0),
+    updateTimer(nullptr)
 {
     fHaveWatchOnly = m_wallet->haveWatchOnly();
     addressTableModel = new AddressTableModel(this);
@@ -94,13 +109,30 @@ WalletModel::~WalletModel()
     t.wait();
 }
 
-void WalletModel::startPollBalance()
+void WalletModel::startBalanceUpdates()
+{
+    // The balance is only computed again when a transaction or the chain tip changes
+    updateTimer = new QTimer(this);
+    updateTimer->setSingleShot(true);
+    connect(updateTimer, &QTimer::timeout, this, &WalletModel::pollBalanceChanged);
+
+    fForceCheckBalanceChanged = true;
+    scheduleUpdate(0);
+}
+
+void WalletModel::scheduleUpdate(int delay)
 {
-    // This timer will be fired repeatedly to update the balance
-    QTimer* timer = new QTimer(this);
-    connect(timer, &QTimer::timeout, this, &WalletModel::pollBalanceChanged);
-    connect(timer, SIGNAL(timeout()), worker, SLOT(updateModel()));
-    timer->start(MODEL_UPDATE_DELAY);
+    if(!updateTimer)
+        return;
+
+    if(!updateTimer->isActive() || updateTimer->remainingTime() > delay)
+        updateTimer->start(delay);
+}
+
+void WalletModel::startWorker()
+{
+    bool invoked = QMetaObject::invokeMethod(worker, "updateModel", Qt::QueuedConnection);
+    assert(invoked);
 }
 
 void WalletModel::updateStatus()
@@ -121,6 +153,7 @@ void WalletModel::pollBalanceChanged()
     interfaces::WalletBalances new_balances;
     int numBlocks = -1;
     if (!m_wallet->tryGetBalances(new_balances, numBlocks)) {
+        scheduleUpdate(MODEL_UPDATE_DELAY);
         return;
     }
 
@@ -158,6 +191,11 @@ void WalletModel::pollBalanceChanged()
         {
             updateStakeWeight = true;
         }
+
+        if(updateCoinAddresses || updateStakeWeight)
+        {
+            startWorker();
+        }
     }
 }
 void WalletModel::updateContractBook(const QString &address, const QString &label, const QString &abi, int status)
@@ -188,6 +226,13 @@ void WalletModel::updateTransaction()
 {
     // Balance and number of transactions might have changed
     fForceCheckBalanceChanged = true;
+    scheduleUpdate(WALLET_UPDATE_DELAY);
+}
+
+void WalletModel::updateTip(bool initialDownload)
+{
+    // Confirmations and maturity might have changed, blocks arrive in bursts during the initial download
+    scheduleUpdate(initialDownload ? MODEL_UPDATE_DELAY : WALLET_UPDATE_DELAY);
 }
 
 void WalletModel::updateAddressBook(const QString &address, const QString &label,
@@ -531,6 +576,16 @@ static void NotifyTransactionChanged(WalletModel *walletmodel, const uint256 &ha
     assert(invoked);
 }
 
+static void NotifyBlockTip(WalletModel *walletmodel, bool initialDownload, int height, int64_t blockTime, double verificationProgress)
+{
+    Q_UNUSED(height);
+    Q_UNUSED(blockTime);
+    Q_UNUSED(verificationProgress);
+    bool invoked = QMetaObject::invokeMethod(walletmodel, "updateTip", Qt::QueuedConnection,
+                              Q_ARG(bool, initialDownload));
+    assert(invoked);
+}
+
 static void ShowProgress(WalletModel *walletmodel, const std::string &title, int nProgress)
 {
     // emits signal "showProgress"
@@ -580,6 +635,7 @@ void WalletModel::subscribeToCoreSignals()
     m_handler_watch_only_changed = m_wallet->handleWatchOnlyChanged(std::bind(NotifyWatchonlyChanged, this, std::placeholders::_1));
     m_handler_can_get_addrs_changed = m_wallet->handleCanGetAddressesChanged(boost::bind(NotifyCanGetAddressesChanged, this));
     m_handler_contract_book_changed = m_wallet->handleContractBookChanged(boost::bind(NotifyContractBookChanged, this, _1, _2, _3, _4));
+    m_handler_notify_block_tip = m_node.handleNotifyBlockTip(std::bind(NotifyBlockTip, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
 }
 
 void WalletModel::unsubscribeFromCoreSignals()
@@ -593,6 +649,7 @@ void WalletModel::unsubscribeFromCoreSignals()
     m_handler_watch_only_changed->disconnect();
     m_handler_can_get_addrs_changed->disconnect();
     m_handler_contract_book_changed->disconnect();
+    m_handler_notify_block_tip->disconnect();
 }
 
 // WalletModel::UnlockContext implementation
@@ -791,7 +848,7 @@ void WalletModel::setWalletUnlockStakingOnly(bool unlock)
     m_wallet->setWalletUnlockStakingOnly(unlock);
 }
 
-void WalletModel::checkCoinAddressesChanged()
+bool WalletModel::checkCoinAddressesChanged()
 {
     // Get the list of coin addresses and emit it to the subscribers
     std::vector<std::string> spendableAddresses;
@@ -811,17 +868,20 @@ void WalletModel::checkCoinAddressesChanged()
 
         updateCoinAddresses = false;
     }
+    return !updateCoinAddresses;
 }
 
-void WalletModel::checkStakeWeightChanged()
+bool WalletModel::checkStakeWeightChanged()
 {
     if(updateStakeWeight && m_wallet->tryGetStakeWeight(nWeight))
     {
         updateStakeWeight = false;
     }
+    return !updateStakeWeight;
 }
 
 void WalletModel::checkCoinAddresses()
 {
     updateCoinAddresses = true;
+    startWorker();
 }
@@ -259,6 +259,7 @@ private:
     std::unique_ptr<interfaces::Handler> m_handler_watch_only_changed;
     std::unique_ptr<interfaces::Handler> m_handler_can_get_addrs_changed;
     std::unique_ptr<interfaces::Handler> m_handler_contract_book_changed;
+    std::unique_ptr<interfaces::Handler> m_handler_notify_block_tip;
     interfaces::Node& m_node;
 
     bool fHaveWatchOnly;
@@ -290,10 +291,14 @@ private:
     QThread t;
     WalletWorker *worker;
 
+    // Merges the wallet and chain tip notifications into one balance update
+    QTimer *updateTimer;
+
     void subscribeToCoreSignals();
     void unsubscribeFromCoreSignals();
     bool checkBalanceChanged(const interfaces::WalletBalances& new_balances);
     void checkTokenBalanceChanged();
+    void startWorker();
 
 Q_SIGNALS:
     // Signal that balance in wallet changed
@@ -329,8 +334,10 @@ Q_SIGNALS:
     void availableAddressesChanged(QStringList spendableAddresses, QStringList allAddresses, bool includeZeroValue);
 
 public Q_SLOTS:
-    /* Starts a timer to periodically update the balance */
-    void startPollBalance();
+    /* Starts updating the balance when the wallet or the chain tip changes */
+    void startBalanceUpdates();
+    /* Update the balance after delay milliseconds, unless an update is already due sooner */
+    void scheduleUpdate(int delay);
 
     /* Wallet status might have changed */
     void updateStatus();
@@ -340,16 +347,18 @@ public Q_SLOTS:
     void updateAddressBook(const QString &address, const QString &label, bool isMine, const QString &purpose, int status);
     /* Watch-only added */
     void updateWatchOnlyFlag(bool fHaveWatchonly);
+    /* New block connected or disconnected */
+    void updateTip(bool initialDownload);
     /* Current, immature or unconfirmed balance might have changed - emit 'balanceChanged' if so */
     void pollBalanceChanged();
     /* New, updated or removed contract book entry */
     void updateContractBook(const QString &address, const QString &label, const QString &abi, int status);
     /* Set that update for coin address is needed */
     void checkCoinAddresses();
-    /* Update coin addresses when changed*/
-    void checkCoinAddressesChanged();
-    /* Update stake weight when changed*/
-    void checkStakeWeightChanged();
+    /* Update coin addresses when changed, false when the wallet was busy */
+    bool checkCoinAddressesChanged();
+    /* Update stake weight when changed, false when the wallet was busy */
+    bool checkStakeWeightChanged();
 };
 
 #endif // BITCOIN_QT_WALLETMODEL_H
@@ -1,6 +1,71 @@
 #include <qtum/qtumDGP.h>
 #include <chainparams.h>
 
+#include <algorithm>
+
+DGPCache dgpCache;
+
+bool DGPCache::get(const Key& key, const dev::h256& stateTag, std::vector<unsigned char>& output){
+    LOCK(cs_cache);
+    auto it = entries.find(key);
+    if(it == entries.end())
+        return false;
+    if(it->second.first != stateTag){
+        entries.erase(it);
+        return false;
+    }
+    output = it->second.second;
+    return true;
+}
+
+void DGPCache::put(const Key& key, const dev::h256& stateTag, const std::vector<unsigned char>& output){
+    LOCK(cs_cache);
+    // entries are ordered by height first, so the oldest heights are dropped first
+    while(entries.size() >= MAX_DGP_CACHE_ENTRIES){
+        entries.erase(entries.begin());
+    }
+    entries[key] = std::make_pair(stateTag, output);
+}
+
+void DGPCache::clear(){
+    LOCK(cs_cache);
+    entries.clear();
+}
+
+size_t DGPCache::size(){
+    LOCK(cs_cache);
+    return entries.size();
+}
+
+GovernanceWinnerCache governanceWinnerCache;
+
+bool GovernanceWinnerCache::get(unsigned int blockHeight, const dev::h256& stateTag, dev::Address& winner){
+    LOCK(cs_cache);
+    auto it = entries.find(blockHeight);
+    if(it == entries.end() || it->second.first != stateTag)
+        return false;
+    winner = it->second.second;
+    return true;
+}
+
+void GovernanceWinnerCache::put(unsigned int blockHeight, const dev::h256& stateTag, const dev::Address& winner){
+    LOCK(cs_cache);
+    while(entries.size() >= MAX_DGP_CACHE_ENTRIES){
+        entries.erase(entries.begin());
+    }
+    entries[blockHeight] = std::make_pair(stateTag, winner);
+}
+
+void GovernanceWinnerCache::eraseFrom(unsigned int blockHeight){
+    LOCK(cs_cache);
+    entries.erase(entries.lower_bound(blockHeight), entries.end());
+}
+
+void GovernanceWinnerCache::clear(){
+    LOCK(cs_cache);
+    entries.clear();
+}
+
 std::vector<uint32_t> createDataSchedule(const dev::eth::EVMSchedule& schedule)
 {
     std::vector<uint32_t> tempData = {schedule.tierStepGas[0], schedule.tierStepGas[1], schedule.tierStepGas[2],
@@ -19,16 +84,6 @@ std::vector<uint32_t> createDataSchedule(const dev::eth::EVMSchedule& schedule)
     return tempData;
 }
 
-std::vector<uint32_t> scheduleDataForBlockNumber(unsigned int blockHeight)
-{
-    dev::eth::EVMSchedule schedule = globalSealEngine->chainParams().scheduleForBlockNumber(blockHeight);
-    return createDataSchedule(schedule);
-}
-
-void QtumDGP::initDataSchedule(){
-    dataSchedule = scheduleDataForBlockNumber(0);
-}
-
 bool QtumDGP::checkLimitSchedule(const std::vector<uint32_t>& defaultData, const std::vector<uint32_t>& checkData, int blockHeight){
     const Consensus::Params& consensusParams = Params().GetConsensus();
 
@@ -47,8 +102,9 @@ bool QtumDGP::checkLimitSchedule(const std::vector<uint32_t>& defaultData, const
 
 dev::eth::EVMSchedule QtumDGP::getGasSchedule(int blockHeight){
     clear();
-    dataSchedule = scheduleDataForBlockNumber(blockHeight);
+    // the schedule of the fork active at blockHeight, read once and only replaced when the DGP changes it
     dev::eth::EVMSchedule schedule = globalSealEngine->chainParams().scheduleForBlockNumber(blockHeight);
+    dataSchedule = createDataSchedule(schedule);
     if(initStorages(DGPContract, blockHeight, ParseHex("26fadbe2"))){
         schedule = createEVMSchedule(schedule, blockHeight);
     }
@@ -143,117 +199,109 @@ dev::Address QtumDGP::getGovernanceWinner(unsigned int blockHeight){
     uint64_t defaultGasLimit = DEFAULT_BLOCK_GAS_LIMIT_DGP;
     bool startGovMaturity = false;
 
+    // the winner for a block is selected on top of its parent
+    int prevHeight = (int)blockHeight - 1;
+
+    dev::h256 stateTag = contractStateTag(GovernanceDGP);
+    dev::Address value;
+    if(governanceWinnerCache.get(blockHeight, stateTag, value)){
+        return value;
+    }
+
     if (gArgs.GetChainName() == CBaseChainParams::MAIN) {
-        if (::ChainActive().Tip()->nHeight > 110000 && ::ChainActive().Tip()->nHeight < 137001) {
+        if (prevHeight > 110000 && prevHeight < 137001) {
             defaultGasLimit = DEFAULT_GAS_LIMIT_DGP_WINNER_OP_SEND;
         }
-        if (::ChainActive().Tip()->nHeight < 110001) {
+        if (prevHeight < 110001) {
             defaultGasLimit = DEFAULT_GAS_LIMIT_DGP_OP_SEND;
         }
 
         // 48hr maturity fix enforcement
-        if (::ChainActive().Tip()->nHeight > 170000) {
+        if (prevHeight > 170000) {
            startGovMaturity = true;
         }
     }
 
     if (gArgs.GetChainName() == CBaseChainParams::TESTNET) {
-        if (::ChainActive().Tip()->nHeight > 187000 && ::ChainActive().Tip()->nHeight < 200001) {
+        if (prevHeight > 187000 && prevHeight < 200001) {
             defaultGasLimit = DEFAULT_GAS_LIMIT_DGP_WINNER_OP_SEND;
         }
-        if (::ChainActive().Tip()->nHeight < 187001) {
+        if (prevHeight < 187001) {
             defaultGasLimit = DEFAULT_GAS_LIMIT_DGP_OP_SEND;
         }
 
         // 48hr maturity fix enforcement
-        if (::ChainActive().Tip()->nHeight > 245000) {
+        if (prevHeight > 245000) {
            startGovMaturity = true;
         }
 
     }
 
-    dev::Address value = getAddressFromDGP(blockHeight, GovernanceDGP, ParseHex("aabe2fe3"), defaultGasLimit);
+    value = getAddressFromDGP(blockHeight, GovernanceDGP, ParseHex("aabe2fe3"), defaultGasLimit);
 
     if (startGovMaturity) {
         std::vector<uint64_t> v = getUint64VectorFromDGP(blockHeight, GovernanceDGP, ParseHex("e3eece26000000000000000000000000" + HexStr(value.asBytes())));
-        if (::ChainActive().Tip()->nHeight < v[0] + 1920){
+        if (!v.empty() && (uint64_t)prevHeight < v[0] + 1920){
             //Take the registration block and add 48hrs worth of blocks
             LogPrintf("Governor immature - Address: %s | Registration Block: %i\n", HexStr(value.asBytes()), v[0] + 1920);
             value = dev::Address(0x0);
         }
     }
+    governanceWinnerCache.put(blockHeight, stateTag, value);
     return value;
 }
 
 bool QtumDGP::initStorages(const dev::Address& addr, unsigned int blockHeight, std::vector<unsigned char> data, uint64_t defaultGasLimit){
-    initStorageDGP(addr);
     // metrix DGP contract address does not change so no need to check for it every time
     if(blockHeight > 0){
         if(!dgpevm){
             initStorageTemplate(addr);
         } else {
-            initDataTemplate(addr, data, defaultGasLimit);
+            DGPCache::Key key{addr, data, defaultGasLimit, blockHeight};
+            dev::h256 stateTag = contractStateTag(addr);
+            if(!dgpCache.get(key, stateTag, dataTemplate)){
+                initDataTemplate(addr, data, defaultGasLimit);
+                dgpCache.put(key, stateTag, dataTemplate);
+            }
         }
         return true;
     }
     return false;
 }
 
-void QtumDGP::initStorageDGP(const dev::Address& addr){
-    storageDGP = state->storage(addr);
+dev::h256 QtumDGP::contractStateTag(const dev::Address& addr){
+    dev::RLPStream s(2);
+    s << state->storageRoot(addr) << state->codeHash(addr);
+    return dev::sha3(s.out());
 }
 
 void QtumDGP::initStorageTemplate(const dev::Address& addr){
-    storageTemplate = state->storage(addr);
+    // only the few slots the parsers need are read from the trie, not the whole storage
+    templateContract = addr;
 }
 
-void QtumDGP::initDataTemplate(const dev::Address& addr, std::vector<unsigned char>& data, uint64_t defaultGasLimit){
-    // metrix send default gas limit to prevent recursive call when getting gas limit
-    dataTemplate = CallContract(addr, data, dev::Address(), 0, defaultGasLimit)[0].execRes.output;
-}
-
-void QtumDGP::createParamsInstance(){
-    dev::h256 paramsInstanceHash = sha3(dev::h256("0000000000000000000000000000000000000000000000000000000000000000"));
-    if(storageDGP.count(paramsInstanceHash)){
-        dev::u256 paramsInstanceSize = storageDGP.find(paramsInstanceHash)->second.second;
-        for(size_t i = 0; i < size_t(paramsInstanceSize); i++){
-            std::pair<unsigned int, dev::Address> params;
-            params.first = dev::toUint64(storageDGP.find(sha3(paramsInstanceHash))->second.second);
-            ++paramsInstanceHash;
-            params.second = dev::right160(dev::h256(storageDGP.find(sha3(paramsInstanceHash))->second.second));
-            ++paramsInstanceHash;
-            paramsInstance.push_back(params);
-        }
+std::vector<dev::u256> QtumDGP::readStorageSlots(size_t first, size_t count){
+    std::vector<dev::u256> values;
+    for(size_t i = first; i < first + count; i++){
+        // zero values are not kept in the storage trie
+        dev::u256 value = state->storage(templateContract, dev::u256(i));
+        if(value != 0)
+            values.push_back(value);
     }
+    return values;
 }
 
-dev::Address QtumDGP::getAddressForBlock(unsigned int blockHeight){
-    for(auto i = paramsInstance.rbegin(); i != paramsInstance.rend(); i++){
-        if(i->first <= blockHeight)
-            return i->second;
+void QtumDGP::initDataTemplate(const dev::Address& addr, std::vector<unsigned char>& data, uint64_t defaultGasLimit){
+    // metrix send default gas limit to prevent recursive call when getting gas limit
+    if(view){
+        dataTemplate = CallContract(*view, addr, data, pindex, dev::Address(), 0, defaultGasLimit)[0].execRes.output;
+        return;
     }
-    return dev::Address();
-}
-
-static inline bool sortPairs(const std::pair<dev::u256, dev::u256>& a, const std::pair<dev::u256, dev::u256>& b){
-    return a.first < b.first;
+    dataTemplate = CallContract(addr, data, dev::Address(), 0, defaultGasLimit)[0].execRes.output;
 }
 
 void QtumDGP::parseStorageScheduleContract(std::vector<uint32_t>& uint32Values){
-    std::vector<std::pair<dev::u256, dev::u256>> data;
-    for(size_t i = 0; i < 5; i++){
-        dev::h256 gasScheduleHash = sha3(dev::h256(dev::u256(i)));
-        if(storageTemplate.count(gasScheduleHash)){
-            dev::u256 key = storageTemplate.find(gasScheduleHash)->second.first;
-            dev::u256 value = storageTemplate.find(gasScheduleHash)->second.second;
-            data.push_back(std::make_pair(key, value));
-        }
-    }
-
-    std::sort(data.begin(), data.end(), sortPairs);
-
-    for(std::pair<dev::u256, dev::u256> d : data){
-        dev::u256 value = d.second;
+    for(dev::u256 value : readStorageSlots(0, 5)){
         for(size_t i = 0; i < 4; i++){
             uint64_t uint64Value = dev::toUint64(value);
             value = value >> 64;
@@ -275,9 +323,9 @@ void QtumDGP::parseDataScheduleContract(std::vector<uint32_t>& uint32Values){
 }
 
 void QtumDGP::parseStorageOneUint64(uint64_t& value){
-    dev::h256 blockSizeHash = sha3(dev::h256(dev::u256(0)));
-    if(storageTemplate.count(blockSizeHash)){
-        value = dev::toUint64(storageTemplate.find(blockSizeHash)->second.second);
+    std::vector<dev::u256> values = readStorageSlots(0, 1);
+    if(!values.empty()){
+        value = dev::toUint64(values[0]);
     }
 }
 
@@ -288,9 +336,9 @@ void QtumDGP::parseDataOneUint64(uint64_t& value){
 }
 
 void QtumDGP::parseStorageOneAddress(dev::Address& value){
-    dev::h256 blockSizeHash = sha3(dev::h256(dev::u256(0)));
-    if(storageTemplate.count(blockSizeHash)){
-        value = dev::Address(dev::h160((dev::u160)storageTemplate.find(blockSizeHash)->second.second));
+    std::vector<dev::u256> values = readStorageSlots(0, 1);
+    if(!values.empty()){
+        value = dev::Address(dev::h160((dev::u160)values[0]));
     }
 }
 
@@ -314,20 +362,7 @@ dev::Address QtumDGP::getAddressFromDGP(unsigned int blockHeight, const dev::Add
 }
 
 void QtumDGP::parseStorageUint64Vector(std::vector<uint64_t>& uint64Values){
-    std::vector<std::pair<dev::u256, dev::u256>> data;
-    for(size_t i = 0; i < 3; i++){
-        dev::h256 gasScheduleHash = sha3(dev::h256(dev::u256(i)));
-        if(storageTemplate.count(gasScheduleHash)){
-            dev::u256 key = storageTemplate.find(gasScheduleHash)->second.first;
-            dev::u256 value = storageTemplate.find(gasScheduleHash)->second.second;
-            data.push_back(std::make_pair(key, value));
-        }
-    }
-
-    std::sort(data.begin(), data.end(), sortPairs);
-
-    for(std::pair<dev::u256, dev::u256> d : data){
-        dev::u256 value = d.second;
+    for(dev::u256 value : readStorageSlots(0, 3)){
         uint64Values.push_back(dev::toUint64(value));
     }
 }
@@ -366,6 +401,10 @@ dev::eth::EVMSchedule QtumDGP::createEVMSchedule(const dev::eth::EVMSchedule &_s
     if(!checkLimitSchedule(dataSchedule, uint32Values, blockHeight))
         return schedule;
 
+    // the DGP contract usually holds the default values of the fork
+    if(uint32Values.size() >= 39 && std::equal(dataSchedule.begin(), dataSchedule.end(), uint32Values.begin()))
+        return schedule;
+
     if(uint32Values.size() >= 39){
         schedule.tierStepGas = {{uint32Values[0], uint32Values[1], uint32Values[2], uint32Values[3],
                                 uint32Values[4], uint32Values[5], uint32Values[6], uint32Values[7]}};
@@ -406,7 +445,5 @@ dev::eth::EVMSchedule QtumDGP::createEVMSchedule(const dev::eth::EVMSchedule &_s
 
 void QtumDGP::clear(){
     templateContract = dev::Address();
-    storageDGP.clear();
-    storageTemplate.clear();
-    paramsInstance.clear();
+    dataTemplate.clear();
 }
@@ -2,9 +2,13 @@
 #define QTUMDGP_H
 
 #include <qtum/qtumstate.h>
+#include <qtum/qtumstateview.h>
 #include <primitives/block.h>
 #include <validation.h>
 #include <util/strencodings.h>
+#include <sync.h>
+
+#include <tuple>
 
 static const dev::Address DGPContract = dev::Address("0x0000000000000000000000000000000000000088");
 static const dev::Address GovernanceDGP = dev::Address("0000000000000000000000000000000000000089");
@@ -38,6 +42,8 @@ static const uint64_t DEFAULT_GOVERNANCE_COLLATERAL = 750000000000000;
 
 static const uint64_t DEFAULT_BUDGET_FEE = 60000000000000;
 
+static const size_t MAX_DGP_CACHE_ENTRIES = 1024;
+
 struct DGPFeeRates
 {
     uint64_t minRelayTxFee;
@@ -45,11 +51,78 @@ struct DGPFeeRates
     uint64_t dustRelayFee;
 };
 
+/**
+ * Process-wide cache of raw DGP contract call outputs.
+ * Entries are keyed by (contract, call data, gas limit, block height) and are only
+ * served while the storage root and code of the contract are unchanged, so a block that
+ * writes to the DGP storage (or a reorg that rolls it back) invalidates them implicitly.
+ */
+class DGPCache {
+
+public:
+
+    struct Key {
+        dev::Address contract;
+        std::vector<unsigned char> data;
+        uint64_t gasLimit;
+        unsigned int blockHeight;
+
+        bool operator<(const Key& other) const {
+            return std::tie(blockHeight, contract, gasLimit, data) < std::tie(other.blockHeight, other.contract, other.gasLimit, other.data);
+        }
+    };
+
+    bool get(const Key& key, const dev::h256& stateTag, std::vector<unsigned char>& output);
+
+    void put(const Key& key, const dev::h256& stateTag, const std::vector<unsigned char>& output);
+
+    void clear();
+
+    size_t size();
+
+private:
+
+    Mutex cs_cache;
+
+    std::map<Key, std::pair<dev::h256, std::vector<unsigned char>>> entries GUARDED_BY(cs_cache);
+};
+
+extern DGPCache dgpCache;
+
+/**
+ * Governance winner per block height, shared by the staker, block validation and RPC.
+ * A cached winner is only returned while the governance contract state it was computed
+ * from is unchanged; entries above a disconnected block are dropped explicitly.
+ */
+class GovernanceWinnerCache {
+
+public:
+
+    bool get(unsigned int blockHeight, const dev::h256& stateTag, dev::Address& winner);
+
+    void put(unsigned int blockHeight, const dev::h256& stateTag, const dev::Address& winner);
+
+    void eraseFrom(unsigned int blockHeight);
+
+    void clear();
+
+private:
+
+    Mutex cs_cache;
+
+    std::map<unsigned int, std::pair<dev::h256, dev::Address>> entries GUARDED_BY(cs_cache);
+};
+
+extern GovernanceWinnerCache governanceWinnerCache;
+
 class QtumDGP {
     
 public:
 
-    QtumDGP(QtumState* _state, bool _dgpevm = true) : dgpevm(_dgpevm), state(_state) { initDataSchedule(); }
+    QtumDGP(QtumState* _state, bool _dgpevm = true) : dgpevm(_dgpevm), state(_state) {}
+
+    /** Read the DGP contracts on a state view positioned on the roots of pindex, instead of the global state at the tip */
+    QtumDGP(QtumStateView& _view, CBlockIndex* _pindex, bool _dgpevm = true) : dgpevm(_dgpevm), state(&_view.state()), view(&_view), pindex(_pindex) {}
 
     dev::eth::EVMSchedule getGasSchedule(int blockHeight);
 
@@ -71,20 +144,17 @@ private:
 
     bool initStorages(const dev::Address& addr, unsigned int blockHeight, std::vector<unsigned char> data = std::vector<unsigned char>(), uint64_t defaultGasLimit = DEFAULT_GAS_LIMIT_DGP_OP_SEND);
 
-    void initStorageDGP(const dev::Address& addr);
+    dev::h256 contractStateTag(const dev::Address& addr);
 
     void initStorageTemplate(const dev::Address& addr);
 
-    void initDataTemplate(const dev::Address& addr, std::vector<unsigned char>& data, uint64_t defaultGasLimit = DEFAULT_GAS_LIMIT_DGP_OP_SEND);
+    /** Read the non-zero storage slots first to first + count - 1 of the template contract, in slot order */
+    std::vector<dev::u256> readStorageSlots(size_t first, size_t count);
 
-    void initDataSchedule();
+    void initDataTemplate(const dev::Address& addr, std::vector<unsigned char>& data, uint64_t defaultGasLimit = DEFAULT_GAS_LIMIT_DGP_OP_SEND);
 
     bool checkLimitSchedule(const std::vector<uint32_t>& defaultData, const std::vector<uint32_t>& checkData, int blockHeight);
 
-    void createParamsInstance();
-
-    dev::Address getAddressForBlock(unsigned int blockHeight);
-
     uint64_t getUint64FromDGP(unsigned int blockHeight, const dev::Address& contract, std::vector<unsigned char> data);
 
     void parseStorageScheduleContract(std::vector<uint32_t>& uint32Values);
@@ -117,16 +187,15 @@ private:
 
     const QtumState* state;
 
-    dev::Address templateContract;
+    QtumStateView* view = nullptr;
 
-    std::map<dev::h256, std::pair<dev::u256, dev::u256>> storageDGP;
+    CBlockIndex* pindex = nullptr;
 
-    std::map<dev::h256, std::pair<dev::u256, dev::u256>> storageTemplate;
+    /** Contract the storage slots are read from with -dgpstorage */
+    dev::Address templateContract;
 
     std::vector<unsigned char> dataTemplate;
 
-    std::vector<std::pair<unsigned int, dev::Address>> paramsInstance;
-
     std::vector<uint32_t> dataSchedule;
 
 };
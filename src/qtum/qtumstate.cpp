@@ -1,6 +1,8 @@
+#include <algorithm>
 #include <sstream>
 #include <util/system.h>
 #include <validation.h>
+#include <memusage.h>
 #include <chainparams.h>
 #include <qtum/qtumstate.h>
 
@@ -8,17 +10,37 @@ using namespace std;
 using namespace dev;
 using namespace dev::eth;
 
+/** Addresses the vin cache holds before it is emptied */
+static const size_t MAX_VIN_CACHE_SIZE = 100000;
+/** Replaced vins kept to rewind the vin cache, the oldest commits are forgotten first */
+static const size_t MAX_VIN_CACHE_UNDO_SIZE = 100000;
+
 QtumState::QtumState(u256 const& _accountStartNonce, OverlayDB const& _db, const string& _path, BaseState _bs) :
         State(_accountStartNonce, _db, _bs) {
             dbUTXO = QtumState::openDB(_path + "/qtumDB", sha3(rlp("")), WithExisting::Trust);
 	        stateUTXO = SecureTrieDB<Address, OverlayDB>(&dbUTXO);
 }
 
+QtumState::QtumState(u256 const& _accountStartNonce, OverlayDB const& _db, OverlayDB const& _dbUTXO, BaseState _bs) :
+        State(_accountStartNonce, _db, _bs) {
+            dbUTXO = _dbUTXO;
+	        stateUTXO = SecureTrieDB<Address, OverlayDB>(&dbUTXO);
+}
+
 QtumState::QtumState() : dev::eth::State(dev::Invalid256, dev::OverlayDB(), dev::eth::BaseState::PreExisting) {
     dbUTXO = OverlayDB();
     stateUTXO = SecureTrieDB<Address, OverlayDB>(&dbUTXO);
 }
 
+/** State views read through the overlays of the global state, which its commits must not write to meanwhile */
+static boost::unique_lock<boost::shared_mutex> LockOverlayWrites(const QtumState* state)
+{
+    boost::unique_lock<boost::shared_mutex> lock(cs_globalOverlay, boost::defer_lock);
+    if (state == globalState.get())
+        lock.lock();
+    return lock;
+}
+
 ResultExecute QtumState::execute(EnvInfo const& _envInfo, SealEngineFace const& _sealEngine, QtumTransaction const& _t, Permanence _p, OnOpFunc const& _onOp){
 
     assert(_t.getVersion().toRaw() == VersionVM::GetEVMDefault().toRaw());
@@ -48,6 +70,8 @@ ResultExecute QtumState::execute(EnvInfo const& _envInfo, SealEngineFace const&
     CTransactionRef tx;
     u256 startGasUsed;
     const Consensus::Params& consensusParams = Params().GetConsensus();
+    // forks are gated on the height of the parent of the executed block, the tip it is connected on
+    const int64_t nPrevHeight = _envInfo.number() - 1;
     try{
         if (_t.isCreation() && _t.value())
             BOOST_THROW_EXCEPTION(CreateWithValue());
@@ -57,7 +81,7 @@ ResultExecute QtumState::execute(EnvInfo const& _envInfo, SealEngineFace const&
         startGasUsed = _envInfo.gasUsed();
         if (!e.execute()){
             e.go(onOp);
-            if(ChainActive().Height() >= consensusParams.QIP7Height){
+            if(nPrevHeight >= consensusParams.QIP7Height){
             	validateTransfersWithChangeLog();
             }
         } else {
@@ -84,8 +108,8 @@ ResultExecute QtumState::execute(EnvInfo const& _envInfo, SealEngineFace const&
                 printfErrorLog(res.excepted);
             }
 
-            qtum::commit(cacheUTXO, stateUTXO, m_cache);
-            cacheUTXO.clear();
+            auto lock = LockOverlayWrites(this);
+            commitUTXO();
             bool removeEmptyAccounts = _envInfo.number() >= _sealEngine.chainParams().EIP158ForkBlock;
             commit(removeEmptyAccounts ? State::CommitBehaviour::RemoveEmptyAccounts : State::CommitBehaviour::KeepEmptyAccounts);
         }
@@ -94,8 +118,9 @@ ResultExecute QtumState::execute(EnvInfo const& _envInfo, SealEngineFace const&
         printfErrorLog(dev::eth::toTransactionException(_e));
         res.excepted = dev::eth::toTransactionException(_e);
         res.gasUsed = _t.gas();
-        if(ChainActive().Height() < consensusParams.nFixUTXOCacheHFHeight  && _p != Permanence::Reverted){
+        if(nPrevHeight < consensusParams.nFixUTXOCacheHFHeight  && _p != Permanence::Reverted){
             deleteAccounts(_sealEngine.deleteAddresses);
+            auto lock = LockOverlayWrites(this);
             commit(CommitBehaviour::RemoveEmptyAccounts);
         } else {
             m_cache.clear();
@@ -166,6 +191,173 @@ std::unordered_map<dev::Address, Vin> QtumState::vins() const // temp
     return ret;
 }
 
+bool QtumState::liveVin(dev::Address const& _addr, Vin& _vin) const
+{
+    Vin const* v = vin(_addr);
+    if (!v || !v->alive)
+        return false;
+    _vin = *v;
+    return true;
+}
+
+dev::h256 QtumState::storagePage(dev::Address const& _id, dev::h256 const& _first, dev::h256 const& _last, size_t _limit, std::map<dev::h256, std::pair<dev::u256, dev::u256>>& _entries) const
+{
+    _entries.clear();
+    dev::eth::Account const* a = account(_id);
+    if (!a || _limit == 0)
+        return dev::h256();
+
+    // One entry past the page is read, it becomes the cursor of the next page
+    bool more = false;
+    dev::h256 next;
+    if (dev::h256 root = a->baseRoot())
+    {
+        typedef dev::eth::SecureTrieDB<dev::h256, dev::OverlayDB> StorageTrie;
+        StorageTrie memdb(const_cast<dev::OverlayDB*>(&db()), root); // only read
+        for (StorageTrie::HashedIterator it(&memdb, _first.ref()); it != memdb.hashedEnd(); ++it)
+        {
+            dev::h256 const hashedKey((*it).first);
+            if (hashedKey > _last)
+                break;
+            if (_entries.size() == _limit)
+            {
+                more = true;
+                next = hashedKey;
+                break;
+            }
+            _entries[hashedKey] = std::make_pair(dev::u256(dev::h256(it.key())), dev::RLP((*it).second).toInt<dev::u256>());
+        }
+    }
+
+    // Changes not yet committed to the trie go over the top, like in storage()
+    for (auto const& i : a->storageOverlay())
+    {
+        dev::h256 const hashedKey = dev::sha3(dev::h256(i.first));
+        if (hashedKey < _first || hashedKey > _last || (more && hashedKey >= next))
+            continue;
+        if (i.second)
+            _entries[hashedKey] = i;
+        else
+            _entries.erase(hashedKey);
+    }
+    if (_entries.size() > _limit)
+    {
+        auto it = std::next(_entries.begin(), _limit);
+        next = it->first;
+        more = true;
+        _entries.erase(it, _entries.end());
+    }
+    return more ? next : dev::h256();
+}
+
+void QtumState::popRoots()
+{
+    assert(!savedRoots.empty());
+    const std::pair<dev::h256, dev::h256>& roots = savedRoots.back();
+    if (rootHash() != roots.first)
+        setRoot(roots.first);
+    if (rootHashUTXO() != roots.second)
+        setRootUTXO(roots.second);
+    savedRoots.pop_back();
+}
+
+void QtumState::setRootUTXO(dev::h256 const& _r)
+{
+    cacheUTXO.clear();
+    stateUTXO.setRoot(_r);
+    rewindVinCache(_r);
+}
+
+size_t QtumState::DynamicMemoryUsage() const
+{
+    size_t usage = memusage::DynamicUsage(m_cache) + memusage::DynamicUsage(cacheUTXO) + memusage::DynamicUsage(vinCache);
+    for (auto const& i : m_cache)
+        usage += memusage::DynamicUsage(i.second.storageOverlay()) + memusage::MallocUsage(i.second.code().capacity());
+    usage += vinCacheUndoSize * memusage::MallocUsage(sizeof(std::tuple<dev::Address, bool, Vin>));
+    return usage;
+}
+
+/** StateCacheDB keeps the nodes it holds in memory to its subclasses, this one only reads them */
+struct OverlayDBUsage : public dev::OverlayDB
+{
+    static size_t Get(dev::OverlayDB const& _db)
+    {
+        auto const& main = _db.*(&OverlayDBUsage::m_main);
+        auto const& aux = _db.*(&OverlayDBUsage::m_aux);
+        size_t usage = memusage::DynamicUsage(main) + memusage::DynamicUsage(aux);
+        for (auto const& i : main)
+            usage += memusage::MallocUsage(i.second.first.capacity());
+        for (auto const& i : aux)
+            usage += memusage::DynamicUsage(i.second.first);
+        return usage;
+    }
+};
+
+size_t QtumState::OverlayMemoryUsage() const
+{
+    return OverlayDBUsage::Get(db()) + OverlayDBUsage::Get(dbUTXO);
+}
+
+void QtumState::rewindVinCache(dev::h256 const& _r)
+{
+    if (_r == vinCacheRoot)
+        return;
+    if (vinCache.empty() && vinCacheUndo.empty()) {
+        vinCacheRoot = _r;
+        return;
+    }
+    auto it = std::find_if(vinCacheUndo.rbegin(), vinCacheUndo.rend(), [&](VinCacheUndo const& u){ return u.root == _r; });
+    if (it == vinCacheUndo.rend())
+        return;
+    const size_t pops = std::distance(vinCacheUndo.rbegin(), it) + 1;
+    for (size_t i = 0; i < pops; i++) {
+        VinCacheUndo const& undo = vinCacheUndo.back();
+        for (auto p = undo.prev.rbegin(); p != undo.prev.rend(); ++p) {
+            if (std::get<1>(*p))
+                vinCache[std::get<0>(*p)] = std::get<2>(*p);
+            else
+                vinCache.erase(std::get<0>(*p));
+        }
+        vinCacheUndoSize -= undo.prev.size();
+        vinCacheUndo.pop_back();
+    }
+    vinCacheRoot = _r;
+}
+
+void QtumState::commitUTXO()
+{
+    const dev::h256 before = rootHashUTXO();
+    qtum::commit(cacheUTXO, stateUTXO, m_cache);
+    const dev::h256 after = rootHashUTXO();
+
+    if (before != vinCacheRoot || vinCache.size() + cacheUTXO.size() > MAX_VIN_CACHE_SIZE) {
+        // The cache holds another root, start over from the vins just written
+        vinCache.clear();
+        vinCacheUndo.clear();
+        vinCacheUndoSize = 0;
+    } else if (after != before) {
+        VinCacheUndo undo{before, {}};
+        undo.prev.reserve(cacheUTXO.size());
+        for (auto const& i : cacheUTXO) {
+            auto it = vinCache.find(i.first);
+            if (it != vinCache.end())
+                undo.prev.emplace_back(i.first, true, it->second);
+            else
+                undo.prev.emplace_back(i.first, false, Vin());
+        }
+        vinCacheUndoSize += undo.prev.size();
+        vinCacheUndo.push_back(std::move(undo));
+        while (vinCacheUndoSize > MAX_VIN_CACHE_UNDO_SIZE) {
+            vinCacheUndoSize -= vinCacheUndo.front().prev.size();
+            vinCacheUndo.pop_front();
+        }
+    }
+    for (auto const& i : cacheUTXO)
+        vinCache[i.first] = i.second;
+    vinCacheRoot = after;
+    cacheUTXO.clear();
+}
+
 void QtumState::transferBalance(dev::Address const& _from, dev::Address const& _to, dev::u256 const& _value) {
     subBalance(_from, _value);
     addBalance(_to, _value);
@@ -182,16 +374,32 @@ Vin* QtumState::vin(dev::Address const& _addr)
 {
     auto it = cacheUTXO.find(_addr);
     if (it == cacheUTXO.end()){
+        // The vin cache answers for the current root, a copy is handed out so it only changes on commit
+        const bool cached = stateUTXO.root() == vinCacheRoot;
+        if (cached) {
+            auto c = vinCache.find(_addr);
+            if (c != vinCache.end()) {
+                if (!c->second.alive)
+                    return nullptr;
+                return &cacheUTXO.emplace(_addr, c->second).first->second;
+            }
+        }
+
         std::string stateBack = stateUTXO.at(_addr);
-        if (stateBack.empty())
+        if (stateBack.empty()) {
+            if (cached && vinCache.size() < MAX_VIN_CACHE_SIZE)
+                vinCache.emplace(_addr, Vin{dev::h256(), 0, 0, 0});
             return nullptr;
-            
+        }
+
         dev::RLP state(stateBack);
         auto i = cacheUTXO.emplace(
             std::piecewise_construct,
             std::forward_as_tuple(_addr),
             std::forward_as_tuple(Vin{state[0].toHash<dev::h256>(), state[1].toInt<uint32_t>(), state[2].toInt<dev::u256>(), state[3].toInt<uint8_t>()})
         );
+        if (cached && vinCache.size() < MAX_VIN_CACHE_SIZE)
+            vinCache.emplace(_addr, i.first->second);
         return &i.first->second;
     }
     return &it->second;
@@ -311,8 +519,7 @@ void QtumState::validateTransfersWithChangeLog(){
 }
 ///////////////////////////////////////////////////////////////////////////////////////////
 CTransaction CondensingTX::createCondensingTX(){
-    selectionVin();
-    calculatePlusAndMinus();
+    collectTransfers();
     if(!createNewBalances())
         return CTransaction();
     CMutableTransaction tx;
@@ -323,72 +530,87 @@ CTransaction CondensingTX::createCondensingTX(){
 
 std::unordered_map<dev::Address, Vin> CondensingTX::createVin(const CTransaction& tx){
     std::unordered_map<dev::Address, Vin> vins;
-    for(auto& b : balances){
-        if(b.first == transaction.sender())
+    for(const AddressInfo& info : addresses){
+        if(!info.hasBalance || info.address == transaction.sender())
             continue;
 
-        if(b.second > 0){
-            vins[b.first] = Vin{uintToh256(tx.GetHash()), nVouts[b.first], b.second, 1};
+        if(info.balance > 0){
+            vins[info.address] = Vin{uintToh256(tx.GetHash()), info.nVout, info.balance, 1};
         } else {
-            vins[b.first] = Vin{uintToh256(tx.GetHash()), 0, 0, 0};
+            vins[info.address] = Vin{uintToh256(tx.GetHash()), 0, 0, 0};
         }
     }
     return vins;
 }
 
-void CondensingTX::selectionVin(){
+void CondensingTX::collectTransfers(){
+    addresses.clear();
+    addresses.reserve(transfers.size() * 2);
     for(const TransferInfo& ti : transfers){
-        if(!vins.count(ti.from)){
-            if(auto a = state->vin(ti.from))
-                vins[ti.from] = *a;
-            if(ti.from == transaction.sender() && transaction.value() > 0){
-                vins[ti.from] = Vin{transaction.getHashWith(), transaction.getNVout(), transaction.value(), 1};
-            }
-        }
+        addresses.emplace_back();
+        addresses.back().address = ti.from;
+        addresses.emplace_back();
+        addresses.back().address = ti.to;
+    }
+    std::sort(addresses.begin(), addresses.end(), [](const AddressInfo& a, const AddressInfo& b){ return a.address < b.address; });
+    addresses.erase(std::unique(addresses.begin(), addresses.end(), [](const AddressInfo& a, const AddressInfo& b){ return a.address == b.address; }), addresses.end());
 
-        if(!vins.count(ti.to)){
-            if(auto a = state->vin(ti.to))
-                vins[ti.to] = *a;
-        }
+    //The vins are selected in transfer order, the first transfer that touches an address decides its vin
+    for(const TransferInfo& ti : transfers){
+        AddressInfo& from = addressInfo(ti.from);
+        selectionVin(from, ti.from == transaction.sender());
+        from.plusMinus.second += ti.value;
+
+        AddressInfo& to = addressInfo(ti.to);
+        selectionVin(to, false);
+        to.plusMinus.first += ti.value;
     }
 }
 
-void CondensingTX::calculatePlusAndMinus(){
-    for(const TransferInfo& ti : transfers){
-        if(!plusMinusInfo.count(ti.from)){
-            plusMinusInfo[ti.from] = std::make_pair(0, ti.value);
-        } else {
-            plusMinusInfo[ti.from] = std::make_pair(plusMinusInfo[ti.from].first, plusMinusInfo[ti.from].second + ti.value);
-        }
+CondensingTX::AddressInfo& CondensingTX::addressInfo(const dev::Address& addr){
+    auto it = std::lower_bound(addresses.begin(), addresses.end(), addr, [](const AddressInfo& a, const dev::Address& b){ return a.address < b; });
+    assert(it != addresses.end() && it->address == addr);
+    return *it;
+}
 
-        if(!plusMinusInfo.count(ti.to)){
-            plusMinusInfo[ti.to] = std::make_pair(ti.value, 0);
-        } else {
-            plusMinusInfo[ti.to] = std::make_pair(plusMinusInfo[ti.to].first + ti.value, plusMinusInfo[ti.to].second);
+void CondensingTX::selectionVin(AddressInfo& info, bool isSender){
+    if(info.hasVin)
+        return;
+
+    if(!info.vinLookedUp){
+        info.vinLookedUp = true;
+        if(auto a = state->vin(info.address)){
+            info.vin = *a;
+            info.hasVin = true;
         }
     }
+    if(isSender && transaction.value() > 0){
+        info.vin = Vin{transaction.getHashWith(), transaction.getNVout(), transaction.value(), 1};
+        info.hasVin = true;
+    }
 }
 
 bool CondensingTX::createNewBalances(){
-    for(auto& p : plusMinusInfo){
+    for(AddressInfo& info : addresses){
         dev::u256 balance = 0;
-        if((vins.count(p.first) && vins[p.first].alive) || (!vins[p.first].alive && !checkDeleteAddress(p.first))){
-            balance = vins[p.first].value;
+        if(info.vin.alive || !checkDeleteAddress(info.address)){
+            balance = info.vin.value;
         }
-        balance += p.second.first;
-        if(balance < p.second.second)
+        balance += info.plusMinus.first;
+        if(balance < info.plusMinus.second)
             return false;
-        balance -= p.second.second;
-        balances[p.first] = balance;
+        balance -= info.plusMinus.second;
+        info.balance = balance;
+        info.hasBalance = true;
     }
     return true;
 }
 
 std::vector<CTxIn> CondensingTX::createVins(){
     std::vector<CTxIn> ins;
-    for(auto& v : vins){
-        if((v.second.value > 0 && v.second.alive) || (v.second.value > 0 && !vins[v.first].alive && !checkDeleteAddress(v.first)))
-            ins.push_back(CTxIn(h256Touint(v.second.hash), v.second.nVout, CScript() << OP_SPEND));
+    for(const AddressInfo& info : addresses){
+        if(info.hasVin && info.vin.value > 0 && (info.vin.alive || !checkDeleteAddress(info.address)))
+            ins.push_back(CTxIn(h256Touint(info.vin.hash), info.vin.nVout, CScript() << OP_SPEND));
     }
     return ins;
 }
@@ -396,18 +618,18 @@ std::vector<CTxIn> CondensingTX::createVins(){
 std::vector<CTxOut> CondensingTX::createVout(){
     size_t count = 0;
     std::vector<CTxOut> outs;
-    for(auto& b : balances){
-        if(b.second > 0){
+    for(AddressInfo& info : addresses){
+        if(info.balance > 0){
             CScript script;
-            auto* a = state->account(b.first);
+            auto* a = state->account(info.address);
             if(a && a->isAlive()){
                 //create a no-exec contract output
-                script = CScript() << valtype{0} << valtype{0} << valtype{0} << valtype{0} << b.first.asBytes() << OP_CALL;
+                script = CScript() << valtype{0} << valtype{0} << valtype{0} << valtype{0} << info.address.asBytes() << OP_CALL;
             } else {
-                script = CScript() << OP_DUP << OP_HASH160 << b.first.asBytes() << OP_EQUALVERIFY << OP_CHECKSIG;
+                script = CScript() << OP_DUP << OP_HASH160 << info.address.asBytes() << OP_EQUALVERIFY << OP_CHECKSIG;
             }
-            outs.push_back(CTxOut(CAmount(b.second), script));
-            nVouts[b.first] = count;
+            outs.push_back(CTxOut(CAmount(info.balance), script));
+            info.nVout = count;
             count++;
         }
         if(count > MAX_CONTRACT_VOUTS){
@@ -2,8 +2,7 @@
 
 #include <libethereum/State.h>
 #include <libevm/ExtVMFace.h>
-#include <crypto/sha256.h>
-#include <crypto/ripemd160.h>
+#include <hash.h>
 #include <uint256.h>
 #include <util/convert.h>
 #include <primitives/transaction.h>
@@ -12,6 +11,9 @@
 #include <libethereum/Executive.h>
 #include <libethcore/SealEngine.h>
 
+#include <deque>
+#include <tuple>
+
 using OnOpFunc = std::function<void(uint64_t, uint64_t, dev::eth::Instruction, dev::bigint, dev::bigint, 
     dev::bigint, dev::eth::VMFace const*, dev::eth::ExtVMFace const*)>;
 using plusAndMinus = std::pair<dev::u256, dev::u256>;
@@ -93,9 +95,13 @@ public:
 
     QtumState(dev::u256 const& _accountStartNonce, dev::OverlayDB const& _db, const std::string& _path, dev::eth::BaseState _bs = dev::eth::BaseState::PreExisting);
 
+    /** Open a state on already opened databases, used for read-only views that share the global state DB */
+    QtumState(dev::u256 const& _accountStartNonce, dev::OverlayDB const& _db, dev::OverlayDB const& _dbUTXO, dev::eth::BaseState _bs = dev::eth::BaseState::PreExisting);
+
     ResultExecute execute(dev::eth::EnvInfo const& _envInfo, dev::eth::SealEngineFace const& _sealEngine, QtumTransaction const& _t, dev::eth::Permanence _p = dev::eth::Permanence::Committed, dev::eth::OnOpFunc const& _onOp = OnOpFunc());
 
-    void setRootUTXO(dev::h256 const& _r) { cacheUTXO.clear(); stateUTXO.setRoot(_r); }
+    /** Switch the UTXO trie to another root, going back to a root logged by the vin cache rewinds it */
+    void setRootUTXO(dev::h256 const& _r);
 
     void setCacheUTXO(dev::Address const& address, Vin const& vin) { cacheUTXO.insert(std::make_pair(address, vin)); }
 
@@ -103,25 +109,47 @@ public:
 
     std::unordered_map<dev::Address, Vin> vins() const; // temp
 
+    /** The vin of an address, false when it has none */
+    bool liveVin(dev::Address const& _addr, Vin& _vin) const;
+
+    /**
+     * Read a page of the storage of an account in the order of the storage trie, which is the order
+     * of the hashed keys. Entries with a hashed key from _first up to and including _last are read,
+     * at most _limit of them. Returns the hashed key to read the next page from, or zero when the
+     * range has been read to its end. The entries map hashed keys to the key and value, like storage().
+     */
+    dev::h256 storagePage(dev::Address const& _id, dev::h256 const& _first, dev::h256 const& _last, size_t _limit, std::map<dev::h256, std::pair<dev::u256, dev::u256>>& _entries) const;
+
     dev::OverlayDB const& dbUtxo() const { return dbUTXO; }
 
+    /** Approximate heap usage of the account cache with its storage and code, and of the vin caches */
+    size_t DynamicMemoryUsage() const;
+
+    /** Heap usage of the trie nodes the state and UTXO overlays hold until their next commit, walks every node */
+    size_t OverlayMemoryUsage() const;
+
     dev::OverlayDB& dbUtxo() { return dbUTXO; }
 
-    static const dev::Address createQtumAddress(dev::h256 hashTx, uint32_t voutNumber){
-        uint256 hashTXid(h256Touint(hashTx));
-        std::vector<unsigned char> txIdAndVout(hashTXid.begin(), hashTXid.end());
-        std::vector<unsigned char> voutNumberChrs;
-        if (voutNumberChrs.size() < sizeof(voutNumber))voutNumberChrs.resize(sizeof(voutNumber));
-        std::memcpy(voutNumberChrs.data(), &voutNumber, sizeof(voutNumber));
-        txIdAndVout.insert(txIdAndVout.end(),voutNumberChrs.begin(),voutNumberChrs.end());
+    /** Push a savepoint of the state and UTXO roots, savepoints nest and are popped last in first out */
+    void pushRoots() { savedRoots.emplace_back(rootHash(), rootHashUTXO()); }
 
-        std::vector<unsigned char> SHA256TxVout(32);
-        CSHA256().Write(txIdAndVout.data(), txIdAndVout.size()).Finalize(SHA256TxVout.data());
+    /** Pop the last savepoint and go back to its roots, a trie that did not change since keeps its cache */
+    void popRoots();
 
-        std::vector<unsigned char> hashTxIdAndVout(20);
-        CRIPEMD160().Write(SHA256TxVout.data(), SHA256TxVout.size()).Finalize(hashTxIdAndVout.data());
+    /** Pop the last savepoint and keep the changes made since, the enclosing savepoint then covers them */
+    void mergeRoots() { assert(!savedRoots.empty()); savedRoots.pop_back(); }
 
-        return dev::Address(hashTxIdAndVout);
+    /** Hash160 of the 32 byte txid followed by the output index, the address of the contract the output creates */
+    static uint160 createQtumAddressHash(const unsigned char* hashTx, uint32_t voutNumber){
+        unsigned char txIdAndVout[32 + sizeof(voutNumber)];
+        std::memcpy(txIdAndVout, hashTx, 32);
+        std::memcpy(txIdAndVout + 32, &voutNumber, sizeof(voutNumber));
+        return Hash160(txIdAndVout, txIdAndVout + sizeof(txIdAndVout));
+    }
+
+    static const dev::Address createQtumAddress(dev::h256 hashTx, uint32_t voutNumber){
+        uint160 hashTxIdAndVout = createQtumAddressHash(hashTx.data(), voutNumber);
+        return dev::Address(dev::bytesConstRef(hashTxIdAndVout.begin(), hashTxIdAndVout.size()));
     }
 
     virtual ~QtumState(){}
@@ -146,6 +174,11 @@ private:
 
     void updateUTXO(const std::unordered_map<dev::Address, Vin>& vins);
 
+    /** Write the vins of cacheUTXO to the UTXO trie and carry the vin cache over to the new root */
+    void commitUTXO();
+
+    void rewindVinCache(dev::h256 const& _r);
+
     void printfErrorLog(const dev::eth::TransactionException er);
 
     dev::Address newAddress;
@@ -158,6 +191,25 @@ private:
 
 	std::unordered_map<dev::Address, Vin> cacheUTXO;
 
+    /** The values a commit to the UTXO trie replaced in the vin cache, to go back to the root before it */
+    struct VinCacheUndo{
+        dev::h256 root;
+        std::vector<std::tuple<dev::Address, bool, Vin>> prev; // address, was cached, cached value
+    };
+
+    /**
+     * Vins of the UTXO trie at vinCacheRoot, a vin that is not alive stands for an address without one.
+     * Unlike cacheUTXO it is not cleared by commits and root switches: a commit applies the vins it wrote
+     * and logs the ones they replaced, so the cache follows the chain from block to block and going back
+     * to a logged root undoes the commits since. While the trie is at another root it is left unused.
+     */
+    std::unordered_map<dev::Address, Vin> vinCache;
+    dev::h256 vinCacheRoot;
+    std::deque<VinCacheUndo> vinCacheUndo;
+    size_t vinCacheUndoSize = 0;
+
+    std::vector<std::pair<dev::h256, dev::h256>> savedRoots;
+
 	void validateTransfersWithChangeLog();
 };
 
@@ -189,13 +241,38 @@ struct TemporaryState{
     TemporaryState& operator=(TemporaryState&&) = delete;
 };
 
+struct StateSavepoint{
+    QtumState& state;
+    bool merged;
+
+    /** Savepoint of the state roots, rolled back when going out of scope unless merged first */
+    explicit StateSavepoint(QtumState& _state) : state(_state), merged(false) { state.pushRoots(); }
+
+    void Merge()
+    {
+        assert(!merged);
+        state.mergeRoots();
+        merged = true;
+    }
+
+    ~StateSavepoint(){
+        if(!merged)
+            state.popRoots();
+    }
+    StateSavepoint() = delete;
+    StateSavepoint(const StateSavepoint&) = delete;
+    StateSavepoint& operator=(const StateSavepoint&) = delete;
+    StateSavepoint(StateSavepoint&&) = delete;
+    StateSavepoint& operator=(StateSavepoint&&) = delete;
+};
+
 
 ///////////////////////////////////////////////////////////////////////////////////////////
 class CondensingTX{
 
 public:
 
-    CondensingTX(QtumState* _state, const std::vector<TransferInfo>& _transfers, const QtumTransaction& _transaction, std::set<dev::Address> _deleteAddresses = std::set<dev::Address>()) : transfers(_transfers), deleteAddresses(_deleteAddresses), transaction(_transaction), state(_state){}
+    CondensingTX(QtumState* _state, const std::vector<TransferInfo>& _transfers, const QtumTransaction& _transaction, const std::set<dev::Address>& _deleteAddresses = std::set<dev::Address>()) : transfers(_transfers), deleteAddresses(_deleteAddresses), transaction(_transaction), state(_state){}
 
     CTransaction createCondensingTX();
 
@@ -205,9 +282,23 @@ public:
 
 private:
 
-    void selectionVin();
+    /** Everything known about one address taking part in the transfers */
+    struct AddressInfo{
+        dev::Address address;
+        Vin vin{};
+        bool hasVin = false;
+        bool vinLookedUp = false;
+        plusAndMinus plusMinus;
+        dev::u256 balance;
+        bool hasBalance = false;
+        uint32_t nVout = 0;
+    };
+
+    void collectTransfers();
+
+    AddressInfo& addressInfo(const dev::Address& addr);
 
-    void calculatePlusAndMinus();
+    void selectionVin(AddressInfo& info, bool isSender);
 
     bool createNewBalances();
 
@@ -217,13 +308,8 @@ private:
 
     bool checkDeleteAddress(dev::Address addr);
 
-    std::map<dev::Address, plusAndMinus> plusMinusInfo;
-
-    std::map<dev::Address, dev::u256> balances;
-
-    std::map<dev::Address, uint32_t> nVouts;
-
-    std::map<dev::Address, Vin> vins;
+    //Sorted by address, the order of the condensing tx inputs and outputs depends on it
+    std::vector<AddressInfo> addresses;
 
     const std::vector<TransferInfo>& transfers;
 
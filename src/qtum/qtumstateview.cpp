@@ -0,0 +1,135 @@
+#include <qtum/qtumstateview.h>
+#include <chainparams.h>
+#include <validation.h>
+
+#include <libdevcore/db.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+QtumStateViewPool stateViewPool;
+
+boost::shared_mutex cs_globalOverlay;
+
+/**
+ * Database under the overlay of a state view. The view holds the nodes its own executions write,
+ * anything else is looked up in an overlay of the global state, which falls back to the state
+ * database. Views never commit, so nothing is written through it.
+ */
+class GlobalOverlayReader : public dev::db::DatabaseFace
+{
+public:
+    explicit GlobalOverlayReader(const dev::OverlayDB& overlay) : m_overlay(overlay) {}
+
+    std::string lookup(dev::db::Slice _key) const override
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_globalOverlay);
+        if (_key.size() == dev::h256::size)
+            return m_overlay.lookup(toHash(_key));
+        // auxiliary entries are keyed by the hash followed by 255
+        if (_key.size() == dev::h256::size + 1 && (dev::byte)_key[dev::h256::size] == 255) {
+            dev::bytes aux = m_overlay.lookupAux(toHash(_key));
+            return std::string(aux.begin(), aux.end());
+        }
+        return std::string();
+    }
+
+    bool exists(dev::db::Slice _key) const override
+    {
+        if (_key.size() == dev::h256::size) {
+            boost::shared_lock<boost::shared_mutex> lock(cs_globalOverlay);
+            return m_overlay.exists(toHash(_key));
+        }
+        return !lookup(_key).empty();
+    }
+
+    void insert(dev::db::Slice, dev::db::Slice) override { throw std::logic_error("state views are read-only"); }
+    void kill(dev::db::Slice) override { throw std::logic_error("state views are read-only"); }
+    std::unique_ptr<dev::db::WriteBatchFace> createWriteBatch() const override { throw std::logic_error("state views are read-only"); }
+    void commit(std::unique_ptr<dev::db::WriteBatchFace>) override { throw std::logic_error("state views are read-only"); }
+    void forEach(std::function<bool(dev::db::Slice, dev::db::Slice)>) const override { throw std::logic_error("state views cannot be iterated"); }
+
+private:
+    static dev::h256 toHash(dev::db::Slice _key) { return dev::h256((const dev::byte*)_key.data(), dev::h256::ConstructFromPointer); }
+
+    const dev::OverlayDB& m_overlay;
+};
+
+static dev::OverlayDB ReadThrough(const dev::OverlayDB& overlay)
+{
+    return dev::OverlayDB(std::unique_ptr<dev::db::DatabaseFace>(new GlobalOverlayReader(overlay)));
+}
+
+static dev::eth::ChainParams EVMChainParams()
+{
+    dev::eth::Network ethNetwork;
+    if (gArgs.GetChainName() == CBaseChainParams::MAIN) {
+        ethNetwork = dev::eth::Network::qtumMainNetwork;
+    } else {
+        ethNetwork = dev::eth::Network::qtumTestNetwork;
+    }
+    return dev::eth::ChainParams(Params().EVMGenesisInfo(ethNetwork));
+}
+
+QtumStateView::QtumStateView(const QtumState& globalStateRef) :
+    m_state(new QtumState(dev::u256(0), ReadThrough(globalStateRef.db()), ReadThrough(globalStateRef.dbUtxo()), dev::eth::BaseState::PreExisting)),
+    m_sealEngine(EVMChainParams().createSealEngine())
+{
+}
+
+void QtumStateView::setRoots(const dev::h256& stateRoot, const dev::h256& utxoRoot)
+{
+    if (hasRoots(stateRoot, utxoRoot))
+        return;
+    m_state->setRoot(stateRoot);
+    m_state->setRootUTXO(utxoRoot);
+    m_stateRoot = stateRoot;
+    m_utxoRoot = utxoRoot;
+}
+
+void QtumStateView::rollback()
+{
+    m_state->db().rollback();
+    m_state->dbUtxo().rollback();
+    m_stateRoot = dev::h256();
+    m_utxoRoot = dev::h256();
+}
+
+QtumStateViewPool::Handle QtumStateViewPool::acquire(const dev::h256& stateRoot, const dev::h256& utxoRoot)
+{
+    std::unique_ptr<QtumStateView> view;
+    {
+        LOCK(cs_pool);
+        auto it = std::find_if(m_idle.rbegin(), m_idle.rend(), [&](const std::unique_ptr<QtumStateView>& idle) {
+            return idle->hasRoots(stateRoot, utxoRoot);
+        });
+        if (it != m_idle.rend()) {
+            view = std::move(*it);
+            m_idle.erase(std::next(it).base());
+        } else if (!m_idle.empty()) {
+            view = std::move(m_idle.front());
+            m_idle.pop_front();
+        }
+    }
+    if (!view) {
+        view.reset(new QtumStateView(*globalState));
+    }
+    view->setRoots(stateRoot, utxoRoot);
+    return Handle(view.release(), Release{this});
+}
+
+void QtumStateViewPool::release(QtumStateView* view)
+{
+    std::unique_ptr<QtumStateView> owned(view);
+    LOCK(cs_pool);
+    m_idle.push_back(std::move(owned));
+    if (m_idle.size() > MAX_IDLE_STATE_VIEWS) {
+        m_idle.pop_front();
+    }
+}
+
+void QtumStateViewPool::clear()
+{
+    LOCK(cs_pool);
+    m_idle.clear();
+}
@@ -0,0 +1,89 @@
+#ifndef QTUMSTATEVIEW_H
+#define QTUMSTATEVIEW_H
+
+#include <qtum/qtumstate.h>
+#include <sync.h>
+
+#include <list>
+#include <memory>
+
+#include <boost/thread/shared_mutex.hpp>
+
+static const size_t MAX_IDLE_STATE_VIEWS = 16;
+
+/**
+ * Held shared by state views while they read trie nodes through the overlays of the global
+ * state, and exclusively while commits of the global state or FlushQtumStateToDisk write to them.
+ */
+extern boost::shared_mutex cs_globalOverlay;
+
+/**
+ * Read-only QtumState opened on the state roots of a block. Trie nodes it does not hold itself
+ * are read through the overlays of the global state, so it resolves the roots of recent blocks
+ * whose nodes are not written out yet. It has its own trie roots, account cache and seal engine,
+ * so read-only contract execution can run on it concurrently with block validation.
+ */
+class QtumStateView {
+
+public:
+
+    QtumStateView(const QtumState& globalStateRef);
+
+    void setRoots(const dev::h256& stateRoot, const dev::h256& utxoRoot);
+
+    bool hasRoots(const dev::h256& stateRoot, const dev::h256& utxoRoot) const { return m_stateRoot == stateRoot && m_utxoRoot == utxoRoot; }
+
+    QtumState& state() { return *m_state; }
+
+    dev::eth::SealEngineFace& sealEngine() { return *m_sealEngine; }
+
+    /** Drop the trie nodes written by committed executions on the view, which then needs setRoots again */
+    void rollback();
+
+private:
+
+    std::unique_ptr<QtumState> m_state;
+
+    std::unique_ptr<dev::eth::SealEngineFace> m_sealEngine;
+
+    dev::h256 m_stateRoot;
+
+    dev::h256 m_utxoRoot;
+};
+
+/**
+ * Pool of state views reused across RPC threads. Idle views are kept in least recently
+ * used order and a request for roots an idle view is already positioned on reuses it
+ * together with the trie nodes and accounts it has already loaded, so queries that keep
+ * hitting the same historical block do not start from a cold view.
+ */
+class QtumStateViewPool {
+
+public:
+
+    struct Release {
+        QtumStateViewPool* pool;
+        void operator()(QtumStateView* view) const { pool->release(view); }
+    };
+
+    using Handle = std::unique_ptr<QtumStateView, Release>;
+
+    /** Take a view positioned on the given roots, cs_main is not needed. */
+    Handle acquire(const dev::h256& stateRoot, const dev::h256& utxoRoot);
+
+    /** Drop all idle views, must be called before the global state is closed. */
+    void clear();
+
+private:
+
+    void release(QtumStateView* view);
+
+    Mutex cs_pool;
+
+    //! Idle views, least recently used first
+    std::list<std::unique_ptr<QtumStateView>> m_idle GUARDED_BY(cs_pool);
+};
+
+extern QtumStateViewPool stateViewPool;
+
+#endif
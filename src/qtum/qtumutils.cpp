@@ -1,10 +1,68 @@
 #include <qtum/qtumutils.h>
 #include <libdevcore/CommonData.h>
+#include <crypto/common.h>
+#include <crypto/sha256.h>
 #include <pubkey.h>
+#include <sync.h>
 #include <util/convert.h>
 
 using namespace dev;
 
+namespace {
+/**
+ * The signatures checked by contracts get recovered again for every execution
+ * of the transaction (mempool, block template and block connection), so the
+ * recovered key ids are remembered. The slots are indexed by the hash of the
+ * message and signature, which is also what identifies the entry.
+ */
+class RecoveryCache
+{
+    static const size_t SLOTS = 1 << 12;
+
+    struct Slot {
+        uint256 entry;
+        bool fRecovered = false;
+        CKeyID id;
+    };
+
+    Mutex cs;
+    std::vector<Slot> slots GUARDED_BY(cs);
+
+public:
+    RecoveryCache() : slots(SLOTS) {}
+
+    static uint256 ComputeEntry(const uint256& hash, const std::vector<unsigned char>& vchSig)
+    {
+        uint256 entry;
+        CSHA256().Write(hash.begin(), hash.size()).Write(vchSig.data(), vchSig.size()).Finalize(entry.begin());
+        return entry;
+    }
+
+    bool Get(const uint256& entry, bool& fRecovered, CKeyID& id)
+    {
+        LOCK(cs);
+        const Slot& slot = slots[ReadLE64(entry.begin()) % SLOTS];
+        if(slot.entry != entry) {
+            return false;
+        }
+        fRecovered = slot.fRecovered;
+        id = slot.id;
+        return true;
+    }
+
+    void Set(const uint256& entry, bool fRecovered, const CKeyID& id)
+    {
+        LOCK(cs);
+        Slot& slot = slots[ReadLE64(entry.begin()) % SLOTS];
+        slot.entry = entry;
+        slot.fRecovered = fRecovered;
+        slot.id = id;
+    }
+};
+
+RecoveryCache recoveryCache;
+}
+
 bool qtumutils::btc_ecrecover(const dev::h256 &hash, const dev::u256 &v, const dev::h256 &r, const dev::h256 &s, dev::h256 &key)
 {
     // Check input parameters
@@ -25,10 +83,22 @@ bool qtumutils::btc_ecrecover(const dev::h256 &hash, const dev::u256 &v, const d
     // Recover public key from compact signature (65 bytes)
     // The public key can be compressed (33 bytes) or uncompressed (65 bytes)
     // Pubkeyhash is RIPEMD160 hash of the public key, handled both types
-    if(pubKey.RecoverCompact(mesage, vchSig))
+    uint256 entry = RecoveryCache::ComputeEntry(mesage, vchSig);
+    bool fRecovered = false;
+    CKeyID id;
+    if(!recoveryCache.Get(entry, fRecovered, id))
+    {
+        fRecovered = pubKey.RecoverCompact(mesage, vchSig);
+        if(fRecovered)
+        {
+            // Get the pubkeyhash
+            id = pubKey.GetID();
+        }
+        recoveryCache.Set(entry, fRecovered, id);
+    }
+
+    if(fRecovered)
     {
-        // Get the pubkeyhash
-        CKeyID id = pubKey.GetID();
         size_t padding = sizeof(key) - sizeof(id);
         memset(key.data(), 0, padding);
         memcpy(key.data() + padding, id.begin(), sizeof(id));
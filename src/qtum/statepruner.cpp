@@ -0,0 +1,346 @@
+#include <qtum/statepruner.h>
+
+#include <chain.h>
+#include <dbwrapper.h>
+#include <logging.h>
+#include <shutdown.h>
+#include <util/strencodings.h>
+#include <util/time.h>
+
+#include <leveldb/db.h>
+#include <leveldb/write_batch.h>
+
+#include <memory>
+#include <string.h>
+#include <unordered_set>
+
+std::atomic<int> g_state_prune_height{0};
+std::set<int> g_state_keep_heights;
+
+/** Size of the deletions written to the trie database at once */
+static const size_t TRIE_GC_BATCH_SIZE = 4 << 20;
+
+namespace {
+
+/** Root of the empty trie, which OverlayDB may never have written */
+const uint256 EMPTY_TRIE_ROOT(ParseHex("56e81f171bcc55a6ff8345e692c0f86e5b48e01b996cadc001622fb5e363b421"));
+/** Code hash of the accounts without code */
+const uint256 EMPTY_CODE_HASH(ParseHex("c5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470"));
+
+struct TrieHasher
+{
+    size_t operator()(const uint256& hash) const { return hash.GetUint64(0); }
+};
+
+/** One item of an RLP encoding, a byte string or a list, by its payload */
+struct RLPItem
+{
+    bool list{false};
+    const unsigned char* data{nullptr};
+    size_t size{0};
+};
+
+/** Decode the item at the front of [p, end), returning its encoded length or 0 when it is malformed */
+size_t DecodeRLPItem(const unsigned char* p, const unsigned char* end, RLPItem& item)
+{
+    if (p >= end) return 0;
+    const size_t avail = end - p;
+    const unsigned char b = p[0];
+    if (b < 0x80) {
+        item.list = false;
+        item.data = p;
+        item.size = 1;
+        return 1;
+    }
+    size_t header = 1;
+    size_t length;
+    item.list = b >= 0xc0;
+    const unsigned char base = item.list ? 0xc0 : 0x80;
+    if (b - base <= 55) {
+        length = b - base;
+    } else {
+        const size_t n = b - base - 55;
+        if (n > 4 || avail < 1 + n) return 0;
+        length = 0;
+        for (size_t i = 0; i < n; i++) {
+            length = (length << 8) | p[1 + i];
+        }
+        header += n;
+    }
+    if (length > avail - header) return 0;
+    item.data = p + header;
+    item.size = length;
+    return header + length;
+}
+
+/** Decode the items of a list, failing unless they fill it exactly */
+bool DecodeRLPList(const RLPItem& list, std::vector<RLPItem>& items)
+{
+    items.clear();
+    if (!list.list) return false;
+    const unsigned char* p = list.data;
+    const unsigned char* end = p + list.size;
+    while (p < end) {
+        RLPItem item;
+        const size_t length = DecodeRLPItem(p, end, item);
+        if (length == 0) return false;
+        items.push_back(item);
+        p += length;
+    }
+    return true;
+}
+
+/** Marks the entries of a trie database reachable from a set of roots */
+class TrieMarker
+{
+public:
+    TrieMarker(leveldb::DB* db) : m_db(db) {}
+
+    std::unordered_set<uint256, TrieHasher> marked;
+
+    /** Mark everything reachable from root, false when a node is missing or malformed */
+    bool MarkRoot(const uint256& root, bool accounts)
+    {
+        Push(root, accounts);
+        std::string value;
+        while (!m_stack.empty()) {
+            const std::pair<uint256, bool> next = m_stack.back();
+            m_stack.pop_back();
+            const leveldb::Slice key((const char*)next.first.begin(), next.first.size());
+            const leveldb::Status status = m_db->Get(m_read_options, key, &value);
+            if (!status.ok()) {
+                LogPrintf("%s: cannot read trie node %s: %s\n", __func__, HexStr(next.first), status.ToString());
+                return false;
+            }
+            RLPItem node;
+            const unsigned char* begin = (const unsigned char*)value.data();
+            if (DecodeRLPItem(begin, begin + value.size(), node) != value.size() || !MarkNode(node, next.second)) {
+                LogPrintf("%s: cannot decode trie node %s\n", __func__, HexStr(next.first));
+                return false;
+            }
+            if (ShutdownRequested()) return false;
+        }
+        return true;
+    }
+
+private:
+    leveldb::DB* m_db;
+    leveldb::ReadOptions m_read_options;
+    std::vector<std::pair<uint256, bool>> m_stack;
+
+    void Push(const uint256& hash, bool accounts)
+    {
+        if (hash != EMPTY_TRIE_ROOT && marked.insert(hash).second) {
+            m_stack.emplace_back(hash, accounts);
+        }
+    }
+
+    bool MarkNode(const RLPItem& node, bool accounts)
+    {
+        if (!node.list) {
+            // The empty trie is stored as an empty string
+            return node.size == 0;
+        }
+        std::vector<RLPItem> items;
+        if (!DecodeRLPList(node, items)) return false;
+        if (items.size() == 17) {
+            for (size_t i = 0; i < 16; i++) {
+                if (!MarkRef(items[i], accounts)) return false;
+            }
+            return items[16].list || items[16].size == 0 || MarkValue(items[16], accounts);
+        }
+        if (items.size() == 2 && !items[0].list && items[0].size > 0) {
+            // The high nibble of the hex prefix path tells leaves (2, 3) from extensions (0, 1)
+            if ((items[0].data[0] >> 4) >= 2) {
+                return MarkValue(items[1], accounts);
+            }
+            return MarkRef(items[1], accounts);
+        }
+        return false;
+    }
+
+    bool MarkRef(const RLPItem& ref, bool accounts)
+    {
+        if (ref.list) {
+            // Nodes shorter than a hash are inlined in their parent
+            return MarkNode(ref, accounts);
+        }
+        if (ref.size == 0) return true;
+        if (ref.size != 32) return false;
+        uint256 hash;
+        memcpy(hash.begin(), ref.data, 32);
+        Push(hash, accounts);
+        return true;
+    }
+
+    /** Account values are [nonce, balance, storage root, code hash], other values are opaque */
+    bool MarkValue(const RLPItem& value, bool accounts)
+    {
+        if (!accounts) return true;
+        RLPItem account;
+        std::vector<RLPItem> items;
+        if (value.list || DecodeRLPItem(value.data, value.data + value.size, account) != value.size ||
+            !DecodeRLPList(account, items) || items.size() < 4 ||
+            items[2].list || items[2].size != 32 || items[3].list || items[3].size != 32) {
+            return false;
+        }
+        uint256 storage_root;
+        memcpy(storage_root.begin(), items[2].data, 32);
+        Push(storage_root, false);
+
+        uint256 code_hash;
+        memcpy(code_hash.begin(), items[3].data, 32);
+        if (code_hash != EMPTY_CODE_HASH && marked.insert(code_hash).second) {
+            std::string code;
+            const leveldb::Slice key((const char*)code_hash.begin(), code_hash.size());
+            if (!m_db->Get(m_read_options, key, &code).ok()) return false;
+        }
+        return true;
+    }
+};
+
+/** Find the leveldb directories named state OverlayDB keeps a few levels below dir */
+void FindTrieDBs(const fs::path& dir, int depth, const fs::path& exclude, std::vector<fs::path>& found)
+{
+    for (fs::directory_iterator it(dir); it != fs::directory_iterator(); ++it) {
+        const fs::path& path = it->path();
+        if (!fs::is_directory(path) || path == exclude) continue;
+        if (path.filename() == "state" && fs::exists(path / "CURRENT")) {
+            found.push_back(path);
+        } else if (depth > 0) {
+            FindTrieDBs(path, depth - 1, exclude, found);
+        }
+    }
+}
+
+bool FindTrieDB(const fs::path& dir, const fs::path& exclude, fs::path& path)
+{
+    std::vector<fs::path> found;
+    try {
+        FindTrieDBs(dir, 3, exclude, found);
+    } catch (const fs::filesystem_error& e) {
+        LogPrintf("%s: %s\n", __func__, e.what());
+        return false;
+    }
+    if (found.size() != 1) {
+        LogPrintf("%s: expected one trie database under %s, found %u\n", __func__, dir.string(), found.size());
+        return false;
+    }
+    path = found[0];
+    return true;
+}
+
+} // namespace
+
+bool CollectTrieGarbage(const fs::path& path, const std::vector<uint256>& roots, bool accounts, TrieGCStats& stats)
+{
+    // Keys and values are the raw bytes of OverlayDB, only the options of CDBWrapper are shared
+    leveldb::Options options = GetDBOptions(path.filename().string(), 8 << 20);
+    options.create_if_missing = false;
+    leveldb::DB* db = nullptr;
+    leveldb::Status status = leveldb::DB::Open(options, path.string(), &db);
+    if (!status.ok()) {
+        LogPrintf("%s: cannot open %s: %s\n", __func__, path.string(), status.ToString());
+        FreeDBOptions(options);
+        return false;
+    }
+
+    bool ret = true;
+    TrieMarker marker(db);
+    for (const uint256& root : roots) {
+        if (!marker.MarkRoot(root, accounts)) {
+            ret = false;
+            break;
+        }
+    }
+
+    if (ret) {
+        leveldb::ReadOptions iter_options;
+        iter_options.fill_cache = false;
+        std::unique_ptr<leveldb::Iterator> it(db->NewIterator(iter_options));
+        leveldb::WriteBatch batch;
+        size_t batch_size = 0;
+        for (it->SeekToFirst(); it->Valid() && ret; it->Next()) {
+            const leveldb::Slice key = it->key();
+            uint256 hash;
+            // Auxiliary entries are keyed by a hash and a suffix byte and are left alone
+            if (key.size() == hash.size()) {
+                memcpy(hash.begin(), key.data(), hash.size());
+            }
+            if (key.size() != hash.size() || hash == EMPTY_TRIE_ROOT || marker.marked.count(hash)) {
+                stats.kept++;
+                continue;
+            }
+            batch.Delete(key);
+            batch_size += key.size();
+            stats.deleted++;
+            stats.deleted_bytes += key.size() + it->value().size();
+            if (batch_size >= TRIE_GC_BATCH_SIZE) {
+                status = db->Write(leveldb::WriteOptions(), &batch);
+                batch.Clear();
+                batch_size = 0;
+                ret = status.ok() && !ShutdownRequested();
+            }
+        }
+        if (ret && !it->status().ok()) {
+            status = it->status();
+            ret = false;
+        }
+        if (ret) {
+            status = db->Write(leveldb::WriteOptions(), &batch);
+            ret = status.ok();
+        }
+        if (!status.ok()) {
+            LogPrintf("%s: cannot prune %s: %s\n", __func__, path.string(), status.ToString());
+        }
+        it.reset();
+        if (stats.deleted > 0) {
+            db->CompactRange(nullptr, nullptr);
+        }
+    }
+
+    delete db;
+    FreeDBOptions(options);
+    return ret;
+}
+
+bool IsStatePruned(int height)
+{
+    return height < g_state_prune_height && !g_state_keep_heights.count(height);
+}
+
+bool PruneContractState(const fs::path& dir, const CChain& chain, int depth, const std::set<int>& keep_heights)
+{
+    const CBlockIndex* tip = chain.Tip();
+    if (tip == nullptr) return false;
+
+    fs::path state_path, utxo_path;
+    if (!FindTrieDB(dir, dir / "qtumDB", state_path) || !FindTrieDB(dir / "qtumDB", fs::path(), utxo_path)) {
+        return false;
+    }
+
+    std::vector<uint256> state_roots, utxo_roots;
+    for (const CBlockIndex* pindex = tip; pindex && pindex->nHeight >= tip->nHeight - depth; pindex = pindex->pprev) {
+        state_roots.push_back(pindex->hashStateRoot);
+        utxo_roots.push_back(pindex->hashUTXORoot);
+    }
+    for (int height : keep_heights) {
+        if (const CBlockIndex* pindex = chain[height]) {
+            state_roots.push_back(pindex->hashStateRoot);
+            utxo_roots.push_back(pindex->hashUTXORoot);
+        }
+    }
+
+    LogPrintf("Pruning the contract state of the blocks more than %d deep...\n", depth);
+    const int64_t start = GetTimeMillis();
+    TrieGCStats state_stats, utxo_stats;
+    if (!CollectTrieGarbage(state_path, state_roots, true, state_stats) ||
+        !CollectTrieGarbage(utxo_path, utxo_roots, false, utxo_stats)) {
+        LogPrintf("Contract state pruning aborted, the state was not changed or only lost unreachable nodes\n");
+        return false;
+    }
+    LogPrintf("Pruned the contract state in %dms: deleted %u account and %u UTXO trie entries (%.1f MiB), kept %u\n",
+        GetTimeMillis() - start, state_stats.deleted, utxo_stats.deleted,
+        (state_stats.deleted_bytes + utxo_stats.deleted_bytes) / 1048576.0, state_stats.kept + utxo_stats.kept);
+    return true;
+}
@@ -0,0 +1,51 @@
+#ifndef QTUM_STATEPRUNER_H
+#define QTUM_STATEPRUNER_H
+
+#include <fs.h>
+#include <uint256.h>
+
+#include <atomic>
+#include <set>
+#include <stdint.h>
+#include <vector>
+
+class CChain;
+
+/** Default for -prunestate without -prune, 0 keeps the contract state of every block */
+static const int64_t DEFAULT_PRUNESTATE = 0;
+/** Blocks connected between two collections of the contract state */
+static const int STATE_PRUNE_INTERVAL = 1000;
+
+/** Lowest block height whose contract state is still on disk, 0 when nothing was pruned */
+extern std::atomic<int> g_state_prune_height;
+/** Heights whose contract state -prunestatekeep keeps, only set during init */
+extern std::set<int> g_state_keep_heights;
+
+/** Whether -prunestate deleted the contract state of the block at height */
+bool IsStatePruned(int height);
+
+struct TrieGCStats
+{
+    uint64_t kept{0};
+    uint64_t deleted{0};
+    uint64_t deleted_bytes{0};
+};
+
+/**
+ * Mark and sweep collection of a trie database written through dev::OverlayDB.
+ * The nodes reachable from one of the roots are kept, along with the storage
+ * tries and the code of the accounts when accounts is set, and every other
+ * entry keyed by a 32 byte hash is deleted. Nothing is deleted when a
+ * reachable node is missing or cannot be decoded, as the roots or the layout
+ * of the database are then not what we expect.
+ */
+bool CollectTrieGarbage(const fs::path& path, const std::vector<uint256>& roots, bool accounts, TrieGCStats& stats);
+
+/**
+ * Collect the nodes of the account and UTXO tries under dir that neither the
+ * state of the last depth blocks of the chain nor the state at keep_heights
+ * need. It must run before the state database is opened.
+ */
+bool PruneContractState(const fs::path& dir, const CChain& chain, int depth, const std::set<int>& keep_heights);
+
+#endif // QTUM_STATEPRUNER_H
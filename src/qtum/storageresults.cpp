@@ -1,127 +1,528 @@
 #include <qtum/storageresults.h>
+#include <clientversion.h>
+#include <dbwrapper.h>
+#include <memusage.h>
+#include <serialize.h>
+#include <streams.h>
 #include <util/convert.h>
+#include <util/strencodings.h>
 
-StorageResults::StorageResults(std::string const& _path){
+#include <leveldb/write_batch.h>
+
+#include <map>
+#include <stdexcept>
+
+/** Key of the results layout version; receipts are keyed by 32 byte hashes, so it cannot collide with them */
+static const std::string RESULTS_VERSION_KEY = "version";
+/**
+ * Layout version of the results database: 1 keys receipts by binary hashes, 2 may store them in the
+ * compact encoding, which binaries before it cannot decode. A database of a later version is refused.
+ */
+static const int RESULTS_VERSION_NUMBER = 2;
+static const std::string RESULTS_VERSION = "2";
+/** Receipts moved to binary keys per batch while migrating */
+static const size_t RESULTS_MIGRATION_BATCH = 10000;
+
+static std::string ResultKey(dev::h256 const& hashTx){
+    return std::string((const char*)hashTx.data(), dev::h256::size);
+}
+
+/** Approximate heap usage of a transaction's receipts, for the read cache budget */
+static size_t ReceiptsUsage(std::vector<TransactionReceiptInfo> const& receipts){
+    size_t usage = sizeof(receipts) + receipts.size() * sizeof(TransactionReceiptInfo);
+    for(TransactionReceiptInfo const& receipt : receipts){
+        usage += receipt.exceptedMessage.size();
+        for(dev::eth::LogEntry const& log : receipt.logs)
+            usage += sizeof(log) + log.topics.size() * sizeof(dev::h256) + log.data.size();
+        for(auto const& created : receipt.createdContracts)
+            usage += sizeof(created) + created.second.size();
+        usage += receipt.destructedContracts.size() * sizeof(dev::Address);
+    }
+    return usage;
+}
+
+/**
+ * First byte of receipts in the compact encoding. The earlier encoding is an RLP list,
+ * whose first byte is at least 0xc0, so both can be told apart without a migration.
+ */
+static const unsigned char RECEIPTS_COMPACT = 0x01;
+
+template<typename Stream, unsigned N>
+static void WriteHash(Stream& s, dev::FixedHash<N> const& hash){
+    s.write((const char*)hash.data(), N);
+}
+
+template<typename Stream, unsigned N>
+static void ReadHash(Stream& s, dev::FixedHash<N>& hash){
+    s.read((char*)hash.data(), N);
+}
+
+/**
+ * Compact encoding of a transaction's receipts: the block fields shared by every output once,
+ * varint integers, the topics of the logs in a dictionary, and the rarely read exception message
+ * and contract lists behind a length so readers of the logs can skip them. Returns false when the
+ * receipts do not share the block fields, these are kept in the RLP encoding.
+ */
+static bool EncodeCompactReceipts(dev::h256 const& hashTx, std::vector<TransactionReceiptInfo> const& receipts, std::string& out){
+    if(receipts.empty())
+        return false;
+    TransactionReceiptInfo const& first = receipts.front();
+    std::vector<dev::h256> topics;
+    std::map<dev::h256, uint64_t> topicIndexes;
+    for(TransactionReceiptInfo const& receipt : receipts){
+        if(receipt.blockHash != first.blockHash || receipt.blockNumber != first.blockNumber ||
+           receipt.transactionIndex != first.transactionIndex || uintToh256(receipt.transactionHash) != hashTx)
+            return false;
+        for(dev::eth::LogEntry const& log : receipt.logs){
+            for(dev::h256 const& topic : log.topics){
+                if(topicIndexes.emplace(topic, topics.size()).second)
+                    topics.push_back(topic);
+            }
+        }
+    }
+
+    CDataStream s(SER_DISK, CLIENT_VERSION);
+    s << RECEIPTS_COMPACT;
+    s << first.blockHash << VARINT(first.blockNumber) << VARINT(first.transactionIndex);
+    WriteCompactSize(s, topics.size());
+    for(dev::h256 const& topic : topics)
+        WriteHash(s, topic);
+    WriteCompactSize(s, receipts.size());
+    for(TransactionReceiptInfo const& receipt : receipts){
+        uint32_t excepted = static_cast<uint32_t>(receipt.excepted);
+        s << VARINT(receipt.outputIndex);
+        WriteHash(s, receipt.from);
+        WriteHash(s, receipt.to);
+        s << VARINT(receipt.cumulativeGasUsed) << VARINT(receipt.gasUsed);
+        WriteHash(s, receipt.contractAddress);
+        s << VARINT(excepted);
+        WriteHash(s, receipt.stateRoot);
+        WriteHash(s, receipt.utxoRoot);
+
+        WriteCompactSize(s, receipt.logs.size());
+        for(dev::eth::LogEntry const& log : receipt.logs){
+            WriteHash(s, log.address);
+            WriteCompactSize(s, log.topics.size());
+            for(dev::h256 const& topic : log.topics)
+                s << VARINT(topicIndexes[topic]);
+            s << log.data;
+        }
+
+        CDataStream extra(SER_DISK, CLIENT_VERSION);
+        extra << receipt.exceptedMessage;
+        WriteCompactSize(extra, receipt.createdContracts.size());
+        for(auto const& created : receipt.createdContracts){
+            WriteHash(extra, created.first);
+            extra << created.second;
+        }
+        WriteCompactSize(extra, receipt.destructedContracts.size());
+        for(dev::Address const& destructed : receipt.destructedContracts)
+            WriteHash(extra, destructed);
+        WriteCompactSize(s, extra.size());
+        s.write(extra.data(), extra.size());
+    }
+    out.assign(s.begin(), s.end());
+    return true;
+}
+
+/** Decode the compact encoding, leaving out the exception message and contract lists when only the logs are wanted */
+static bool DecodeCompactReceipts(dev::h256 const& hashTx, std::string const& value, std::vector<TransactionReceiptInfo>& result, bool logsOnly){
+    try{
+        CDataStream s(value.data(), value.data() + value.size(), SER_DISK, CLIENT_VERSION);
+        unsigned char format;
+        s >> format;
+        if(format != RECEIPTS_COMPACT)
+            return false;
+
+        TransactionReceiptInfo header{};
+        s >> header.blockHash >> VARINT(header.blockNumber) >> VARINT(header.transactionIndex);
+        header.transactionHash = h256Touint(hashTx);
+        std::vector<dev::h256> topics(ReadCompactSize(s));
+        for(dev::h256& topic : topics)
+            ReadHash(s, topic);
+
+        uint64_t count = ReadCompactSize(s);
+        result.reserve(result.size() + count);
+        for(uint64_t i = 0; i < count; i++){
+            TransactionReceiptInfo receipt = header;
+            uint32_t excepted;
+            s >> VARINT(receipt.outputIndex);
+            ReadHash(s, receipt.from);
+            ReadHash(s, receipt.to);
+            s >> VARINT(receipt.cumulativeGasUsed) >> VARINT(receipt.gasUsed);
+            ReadHash(s, receipt.contractAddress);
+            s >> VARINT(excepted);
+            receipt.excepted = static_cast<dev::eth::TransactionException>(excepted);
+            ReadHash(s, receipt.stateRoot);
+            ReadHash(s, receipt.utxoRoot);
+
+            receipt.logs.resize(ReadCompactSize(s));
+            for(dev::eth::LogEntry& log : receipt.logs){
+                ReadHash(s, log.address);
+                log.topics.resize(ReadCompactSize(s));
+                for(dev::h256& topic : log.topics){
+                    uint64_t index;
+                    s >> VARINT(index);
+                    if(index >= topics.size())
+                        return false;
+                    topic = topics[index];
+                }
+                s >> log.data;
+            }
+
+            uint64_t extraSize = ReadCompactSize(s);
+            if(logsOnly){
+                s.ignore(extraSize);
+            } else {
+                s >> receipt.exceptedMessage;
+                receipt.createdContracts.resize(ReadCompactSize(s));
+                for(auto& created : receipt.createdContracts){
+                    ReadHash(s, created.first);
+                    s >> created.second;
+                }
+                receipt.destructedContracts.resize(ReadCompactSize(s));
+                for(dev::Address& destructed : receipt.destructedContracts)
+                    ReadHash(s, destructed);
+            }
+            result.push_back(std::move(receipt));
+        }
+        return s.empty();
+    } catch(const std::ios_base::failure&){
+        return false;
+    }
+}
+
+StorageResults::StorageResults(std::string const& _path, size_t _cacheSize, bool _wipe) :
+    m_read_cache_usage(0), m_generation(0), m_read_cache_limit(_cacheSize)
+{
 	path = _path + "/resultsDB";
-    leveldb::Options options;
+    // Keys and values are raw bytes, not the serialized ones of CDBWrapper, only its options are shared
+    options = GetDBOptions("resultsDB", DEFAULT_RESULTS_DB_CACHE_SIZE << 20);
     options.create_if_missing = true;
+    if(_wipe)
+        leveldb::DestroyDB(path, leveldb::Options());
     leveldb::Status status = leveldb::DB::Open(options, path, &db);
     assert(status.ok());
     LogPrintf("Opened LevelDB successfully\n");
+    upgradeKeys();
+}
+
+void StorageResults::upgradeKeys(){
+    std::string version;
+    int32_t nVersion = 0;
+    if(db->Get(leveldb::ReadOptions(), RESULTS_VERSION_KEY, &version).ok()){
+        if(!ParseInt32(version, &nVersion) || nVersion > RESULTS_VERSION_NUMBER)
+            throw std::runtime_error(strprintf("Transaction receipts database has version %s, this release reads up to %d", version, RESULTS_VERSION_NUMBER));
+        if(nVersion == RESULTS_VERSION_NUMBER)
+            return;
+        if(nVersion >= 1){
+            // the keys are binary already, the compact encoding needs no migration of the existing receipts
+            leveldb::Status status = db->Put(leveldb::WriteOptions(), RESULTS_VERSION_KEY, RESULTS_VERSION);
+            assert(status.ok());
+            return;
+        }
+    }
+
+    // earlier versions keyed receipts by the hex string of the transaction hash
+    LogPrintf("Upgrading transaction receipts to binary keys...\n");
+    // the iterator reads the snapshot taken when it was created, so the binary keys written meanwhile are not visited
+    size_t moved = 0;
+    leveldb::WriteBatch batch;
+    size_t count = 0;
+    std::unique_ptr<leveldb::Iterator> it(db->NewIterator(leveldb::ReadOptions()));
+    for(it->SeekToFirst(); it->Valid(); it->Next()){
+        leveldb::Slice key = it->key();
+        if(key.size() != 2 * dev::h256::size || !IsHex(key.ToString()))
+            continue;
+        batch.Put(ResultKey(dev::h256(key.ToString())), it->value());
+        batch.Delete(key);
+        if(++count == RESULTS_MIGRATION_BATCH){
+            leveldb::Status status = db->Write(leveldb::WriteOptions(), &batch);
+            assert(status.ok());
+            batch.Clear();
+            moved += count;
+            count = 0;
+        }
+    }
+    assert(it->status().ok());
+    batch.Put(RESULTS_VERSION_KEY, RESULTS_VERSION);
+    leveldb::Status status = db->Write(leveldb::WriteOptions(), &batch);
+    assert(status.ok());
+    moved += count;
+    LogPrintf("Upgraded %u transaction receipts\n", moved);
 }
 
 StorageResults::~StorageResults()
 {
     delete db;
     db = NULL;
+    FreeDBOptions(options);
 }
 
 void StorageResults::addResult(dev::h256 hashTx, std::vector<TransactionReceiptInfo>& result){
-	m_cache_result.insert(std::make_pair(hashTx, result));
+    LOCK(cs_results);
+	m_cache_result.insert(std::make_pair(hashTx, std::make_shared<const std::vector<TransactionReceiptInfo>>(result)));
 }
 
 void StorageResults::clearCacheResult(){
+    LOCK(cs_results);
     m_cache_result.clear();
 }
 
+size_t StorageResults::DynamicMemoryUsage(){
+    LOCK(cs_results);
+    size_t usage = m_read_cache_usage + memusage::DynamicUsage(m_cache_result) + memusage::DynamicUsage(m_read_cache_index);
+    usage += m_read_cache.size() * memusage::MallocUsage(sizeof(m_read_cache.front()) + 2 * sizeof(void*));
+    for(auto const& pending : m_cache_result)
+        usage += ReceiptsUsage(*pending.second);
+    return usage;
+}
+
+void StorageResults::cacheResult(dev::h256 const& hashTx, TransactionReceiptsRef const& result){
+    uncacheResult(hashTx);
+    size_t usage = ReceiptsUsage(*result);
+    if(usage > m_read_cache_limit)
+        return;
+    m_read_cache.emplace_back(hashTx, result);
+    m_read_cache_index[hashTx] = std::prev(m_read_cache.end());
+    m_read_cache_usage += usage;
+    while(m_read_cache_usage > m_read_cache_limit){
+        m_read_cache_usage -= ReceiptsUsage(*m_read_cache.front().second);
+        m_read_cache_index.erase(m_read_cache.front().first);
+        m_read_cache.pop_front();
+    }
+}
+
+void StorageResults::uncacheResult(dev::h256 const& hashTx){
+    auto it = m_read_cache_index.find(hashTx);
+    if(it == m_read_cache_index.end())
+        return;
+    m_read_cache_usage -= ReceiptsUsage(*it->second->second);
+    m_read_cache.erase(it->second);
+    m_read_cache_index.erase(it);
+}
+
 void StorageResults::wipeResults(){
     LogPrintf("Wiping LevelDB in %s\n", path);
+    {
+        LOCK(cs_results);
+        m_read_cache.clear();
+        m_read_cache_index.clear();
+        m_read_cache_usage = 0;
+        m_generation++;
+    }
     bool opened = db;
     if (opened) {
         delete db;
     }
     leveldb::Status result = leveldb::DestroyDB(path, leveldb::Options());
     if (opened) {
-        leveldb::Options options;
-        options.create_if_missing = true;
         leveldb::Status status = leveldb::DB::Open(options, path, &db);
         assert(status.ok());
+        status = db->Put(leveldb::WriteOptions(), RESULTS_VERSION_KEY, RESULTS_VERSION);
+        assert(status.ok());
     }
 }
 
+void StorageResults::compactResults(){
+    db->CompactRange(nullptr, nullptr);
+}
+
 void StorageResults::deleteResults(std::vector<CTransactionRef> const& txs){
 
-    for(CTransactionRef tx : txs){
+    LOCK(cs_results);
+    leveldb::WriteBatch batch;
+    for(CTransactionRef const& tx : txs){
         dev::h256 hashTx = uintToh256(tx->GetHash());
         m_cache_result.erase(hashTx);
-
-        std::string keyTemp = hashTx.hex();
-	    leveldb::Slice key(keyTemp);
-        leveldb::Status status = db->Delete(leveldb::WriteOptions(), key);
-        assert(status.ok());
+        uncacheResult(hashTx);
+        m_generation++;
+        batch.Delete(ResultKey(hashTx));
     }
+    leveldb::Status status = db->Write(leveldb::WriteOptions(), &batch);
+    assert(status.ok());
+}
+
+static TransactionReceiptsRef EmptyReceipts(){
+    static const TransactionReceiptsRef empty = std::make_shared<const std::vector<TransactionReceiptInfo>>();
+    return empty;
 }
 
-std::vector<TransactionReceiptInfo> StorageResults::getResult(dev::h256 const& hashTx){
+TransactionReceiptsRef StorageResults::getResult(dev::h256 const& hashTx){
+    uint64_t generation;
+    {
+        LOCK(cs_results);
+        generation = m_generation;
+        auto pending = m_cache_result.find(hashTx);
+        if(pending != m_cache_result.end())
+            return pending->second;
+        auto cached = m_read_cache_index.find(hashTx);
+        if(cached != m_read_cache_index.end()){
+            m_read_cache.splice(m_read_cache.end(), m_read_cache, cached->second);
+            return cached->second->second;
+        }
+    }
     std::vector<TransactionReceiptInfo> result;
-	auto it = m_cache_result.find(hashTx);
-	if (it == m_cache_result.end()){
-		if(readResult(hashTx, result))
-			m_cache_result.insert(std::make_pair(hashTx, result));
-    } else {
-		result = it->second;
+    if(!readResult(hashTx, result))
+        return EmptyReceipts();
+    TransactionReceiptsRef shared = std::make_shared<const std::vector<TransactionReceiptInfo>>(std::move(result));
+    LOCK(cs_results);
+    // receipts deleted while reading from disk must not be cached
+    if(generation == m_generation)
+        cacheResult(hashTx, shared);
+    return shared;
+}
+
+std::vector<TransactionReceiptsRef> StorageResults::getResults(std::vector<dev::h256> const& hashTxs){
+    std::vector<TransactionReceiptsRef> results(hashTxs.size());
+    uint64_t generation;
+    {
+        LOCK(cs_results);
+        generation = m_generation;
+        for(size_t i = 0; i < hashTxs.size(); i++){
+            auto pending = m_cache_result.find(hashTxs[i]);
+            if(pending != m_cache_result.end()){
+                results[i] = pending->second;
+                continue;
+            }
+            auto cached = m_read_cache_index.find(hashTxs[i]);
+            if(cached != m_read_cache_index.end()){
+                m_read_cache.splice(m_read_cache.end(), m_read_cache, cached->second);
+                results[i] = cached->second->second;
+            }
+        }
     }
-	return result;
+    std::vector<size_t> read;
+    for(size_t i = 0; i < hashTxs.size(); i++){
+        if(results[i])
+            continue;
+        std::vector<TransactionReceiptInfo> result;
+        if(!readResult(hashTxs[i], result)){
+            results[i] = EmptyReceipts();
+            continue;
+        }
+        results[i] = std::make_shared<const std::vector<TransactionReceiptInfo>>(std::move(result));
+        read.push_back(i);
+    }
+    if(!read.empty()){
+        LOCK(cs_results);
+        if(generation == m_generation){
+            for(size_t i : read)
+                cacheResult(hashTxs[i], results[i]);
+        }
+    }
+    return results;
+}
+
+bool StorageResults::getResultLogs(dev::h256 const& hashTx, std::vector<TransactionReceiptInfo>& result){
+    {
+        LOCK(cs_results);
+        auto pending = m_cache_result.find(hashTx);
+        if(pending != m_cache_result.end()){
+            result = *pending->second;
+            return true;
+        }
+        auto cached = m_read_cache_index.find(hashTx);
+        if(cached != m_read_cache_index.end()){
+            result = *cached->second->second;
+            return true;
+        }
+    }
+    // partial receipts do not go into the read cache
+    return readResult(hashTx, result, true);
+}
+
+bool StorageResults::getRawResult(dev::h256 const& hashTx, std::string& value){
+    {
+        LOCK(cs_results);
+        auto pending = m_cache_result.find(hashTx);
+        if(pending != m_cache_result.end()){
+            value = encodeResults(hashTx, *pending->second);
+            return true;
+        }
+    }
+    leveldb::Status s = db->Get(leveldb::ReadOptions(), ResultKey(hashTx), &value);
+    return s.ok();
+}
+
+std::string StorageResults::encodeResults(dev::h256 const& hashTx, std::vector<TransactionReceiptInfo> const& receipts){
+    std::string compact;
+    if(EncodeCompactReceipts(hashTx, receipts, compact))
+        return compact;
+
+    TransactionReceiptInfoSerialized tris;
+
+    for (auto const& receipt_info: receipts) {
+        tris.blockHashes.push_back(uintToh256(receipt_info.blockHash));
+        tris.blockNumbers.push_back(receipt_info.blockNumber);
+        tris.transactionHashes.push_back(uintToh256(receipt_info.transactionHash));
+        tris.transactionIndexes.push_back(receipt_info.transactionIndex);
+        tris.outputIndexes.push_back(receipt_info.outputIndex);
+        tris.senders.push_back(receipt_info.from);
+        tris.receivers.push_back(receipt_info.to);
+        tris.cumulativeGasUsed.push_back(dev::u256(receipt_info.cumulativeGasUsed));
+        tris.gasUsed.push_back(dev::u256(receipt_info.gasUsed));
+        tris.contractAddresses.push_back(receipt_info.contractAddress);
+        tris.logs.push_back(logEntriesSerialization(receipt_info.logs));
+        tris.excepted.push_back(uint32_t(static_cast<int>(receipt_info.excepted)));
+        tris.exceptedMessage.push_back(receipt_info.exceptedMessage);
+        tris.stateRoots.push_back(receipt_info.stateRoot);
+        tris.utxoRoots.push_back(receipt_info.utxoRoot);
+        tris.createdContracts.push_back(receipt_info.createdContracts);
+        tris.destructedContracts.push_back(receipt_info.destructedContracts);
+    }
+
+    dev::RLPStream streamRLP(17);
+    streamRLP << tris.blockHashes << tris.blockNumbers << tris.transactionHashes << tris.transactionIndexes << tris.outputIndexes;
+    streamRLP << tris.senders << tris.receivers << tris.cumulativeGasUsed << tris.gasUsed << tris.contractAddresses << tris.logs << tris.excepted << tris.exceptedMessage;
+    streamRLP << tris.stateRoots << tris.utxoRoots << tris.createdContracts << tris.destructedContracts;
+
+    dev::bytes data = streamRLP.out();
+    return std::string((const char*)data.data(), data.size());
 }
 
 void StorageResults::commitResults(){
+    LOCK(cs_results);
     if(m_cache_result.size()){
 
+        // one atomic batch per block; receipts are immutable per transaction hash, so they are written without reading first
+        leveldb::WriteBatch batch;
         for (auto const& i: m_cache_result){
-            std::string valueTemp;
-            std::string keyTemp = i.first.hex();
-            leveldb::Slice key(keyTemp);
-            leveldb::Status status = db->Get(leveldb::ReadOptions(), key, &valueTemp);
-
-            if(status.IsNotFound()){
-
-                TransactionReceiptInfoSerialized tris;
-
-                for (auto const& receipt_info: i.second) {
-                    tris.blockHashes.push_back(uintToh256(receipt_info.blockHash));
-                    tris.blockNumbers.push_back(receipt_info.blockNumber);
-                    tris.transactionHashes.push_back(uintToh256(receipt_info.transactionHash));
-                    tris.transactionIndexes.push_back(receipt_info.transactionIndex);
-                    tris.outputIndexes.push_back(receipt_info.outputIndex);
-                    tris.senders.push_back(receipt_info.from);
-                    tris.receivers.push_back(receipt_info.to);
-                    tris.cumulativeGasUsed.push_back(dev::u256(receipt_info.cumulativeGasUsed));
-                    tris.gasUsed.push_back(dev::u256(receipt_info.gasUsed));
-                    tris.contractAddresses.push_back(receipt_info.contractAddress);
-                    tris.logs.push_back(logEntriesSerialization(receipt_info.logs));
-                    tris.excepted.push_back(uint32_t(static_cast<int>(receipt_info.excepted)));
-                    tris.exceptedMessage.push_back(receipt_info.exceptedMessage);
-                    tris.stateRoots.push_back(receipt_info.stateRoot);
-                    tris.utxoRoots.push_back(receipt_info.utxoRoot);
-                    tris.createdContracts.push_back(receipt_info.createdContracts);
-                    tris.destructedContracts.push_back(receipt_info.destructedContracts);
-                }
-
-                dev::RLPStream streamRLP(17);
-                streamRLP << tris.blockHashes << tris.blockNumbers << tris.transactionHashes << tris.transactionIndexes << tris.outputIndexes;
-                streamRLP << tris.senders << tris.receivers << tris.cumulativeGasUsed << tris.gasUsed << tris.contractAddresses << tris.logs << tris.excepted << tris.exceptedMessage;
-                streamRLP << tris.stateRoots << tris.utxoRoots << tris.createdContracts << tris.destructedContracts;
-
-                dev::bytes data = streamRLP.out();
-                std::string stringData(data.begin(), data.end());
-                leveldb::Slice value(stringData);
-                status = db->Put(leveldb::WriteOptions(), key, value);
-                assert(status.ok());
-            }
+            batch.Put(ResultKey(i.first), encodeResults(i.first, *i.second));
         }
+        leveldb::Status status = db->Write(leveldb::WriteOptions(), &batch);
+        assert(status.ok());
         m_cache_result.clear();
     }
 }
 
-bool StorageResults::readResult(dev::h256 const& _key, std::vector<TransactionReceiptInfo>& _result){
+void StorageResults::writeResults(std::vector<std::pair<dev::h256, std::vector<TransactionReceiptInfo>>> const& results){
+    LOCK(cs_results);
+    leveldb::WriteBatch batch;
+    for(auto const& i : results){
+        uncacheResult(i.first);
+        batch.Put(ResultKey(i.first), encodeResults(i.first, i.second));
+    }
+    m_generation++;
+    leveldb::Status status = db->Write(leveldb::WriteOptions(), &batch);
+    assert(status.ok());
+}
+
+bool StorageResults::readResult(dev::h256 const& _key, std::vector<TransactionReceiptInfo>& _result, bool logsOnly){
 
     std::string value;
-    std::string keyTemp = _key.hex();;
-    leveldb::Slice key(keyTemp);
-    leveldb::Status s = db->Get(leveldb::ReadOptions(), key, &value);
+    leveldb::Status s = db->Get(leveldb::ReadOptions(), ResultKey(_key), &value);
 
 	if(!s.IsNotFound() && s.ok()){
-        
+        if(!value.empty() && (unsigned char)value[0] == RECEIPTS_COMPACT){
+            if(!DecodeCompactReceipts(_key, value, _result, logsOnly)){
+                LogPrintf("%s: failed to decode the receipts of %s\n", __func__, _key.hex());
+                _result.clear();
+                return false;
+            }
+            return true;
+        }
+
         TransactionReceiptInfoSerialized tris;
 
 		dev::RLP state(value);
@@ -3,8 +3,17 @@
 #include <libethereum/State.h>
 #include <libethereum/Transaction.h>
 #include <leveldb/db.h>
+#include <sync.h>
 #include <util/system.h>
 
+#include <list>
+#include <memory>
+
+/** Default size of the transaction receipt read cache (MiB) */
+static const int64_t DEFAULT_RECEIPT_CACHE_SIZE = 32;
+/** Cache given to LevelDB for the receipts database, split between its block cache and write buffer (MiB) */
+static const int64_t DEFAULT_RESULTS_DB_CACHE_SIZE = 8;
+
 using logEntriesSerialize = std::vector<std::pair<dev::Address, std::pair<dev::h256s, dev::bytes>>>;
 
 struct TransactionReceiptInfo{
@@ -47,36 +56,87 @@ struct TransactionReceiptInfoSerialized{
     std::vector<std::vector<dev::h160>> destructedContracts;
 };
 
+using TransactionReceiptsRef = std::shared_ptr<const std::vector<TransactionReceiptInfo>>;
+
 class StorageResults{
 
 public:
 
-	StorageResults(std::string const& _path);
+	/** Open the results database, or an empty one with _wipe. Throws when the database is of a later layout version. */
+	StorageResults(std::string const& _path, size_t _cacheSize = DEFAULT_RECEIPT_CACHE_SIZE << 20, bool _wipe = false);
     ~StorageResults();
 
 	void addResult(dev::h256 hashTx, std::vector<TransactionReceiptInfo>& result);
 
     void deleteResults(std::vector<CTransactionRef> const& txs);
 
-    std::vector<TransactionReceiptInfo> getResult(dev::h256 const& hashTx);
+    /** Receipts of a transaction, shared with the caches; empty when there are none */
+    TransactionReceiptsRef getResult(dev::h256 const& hashTx);
+
+    /** Receipts of several transactions, like getResult but taking the lock once for all of them */
+    std::vector<TransactionReceiptsRef> getResults(std::vector<dev::h256> const& hashTxs);
+
+    /**
+     * Receipts of a transaction for readers of the logs only. The exception message and the
+     * created and destructed contracts may be left empty, they are not decoded from disk.
+     */
+    bool getResultLogs(dev::h256 const& hashTx, std::vector<TransactionReceiptInfo>& result);
+
+    /**
+     * Receipts of a transaction as stored on disk: the compact encoding when the value starts with
+     * a 0x01 byte, RLP otherwise. Returns false when there are none.
+     */
+    bool getRawResult(dev::h256 const& hashTx, std::string& value);
 
 	void commitResults();
 
+    /** Write receipts rebuilt for blocks already connected, without touching the receipts pending for the block being connected */
+    void writeResults(std::vector<std::pair<dev::h256, std::vector<TransactionReceiptInfo>>> const& results);
+
     void clearCacheResult();
 
+    /** Approximate heap usage of the receipts pending for the block being connected and of the read cache */
+    size_t DynamicMemoryUsage();
+
     void wipeResults();
 
+    /** Compact the database once a large part of it was deleted, receipts are spread over the whole key space */
+    void compactResults();
+
 private:
 
-	bool readResult(dev::h256 const& _key, std::vector<TransactionReceiptInfo>& _result);
+    /** Refuse a database of a later layout version, and move receipts stored under hex string keys to binary keys */
+    void upgradeKeys();
+
+	bool readResult(dev::h256 const& _key, std::vector<TransactionReceiptInfo>& _result, bool logsOnly = false);
+
+    std::string encodeResults(dev::h256 const& hashTx, std::vector<TransactionReceiptInfo> const& receipts);
 
 	logEntriesSerialize logEntriesSerialization(dev::eth::LogEntries const& _logs);
 
 	dev::eth::LogEntries logEntriesDeserialize(logEntriesSerialize const& _logs);
 
+    void cacheResult(dev::h256 const& hashTx, TransactionReceiptsRef const& result) EXCLUSIVE_LOCKS_REQUIRED(cs_results);
+
+    void uncacheResult(dev::h256 const& hashTx) EXCLUSIVE_LOCKS_REQUIRED(cs_results);
+
 	std::string path;
 
     leveldb::DB* db;
 
-	std::unordered_map<dev::h256, std::vector<TransactionReceiptInfo>> m_cache_result;
+    /** Options the database is opened with, from GetDBOptions */
+    leveldb::Options options;
+
+    Mutex cs_results;
+
+    /** Receipts of the block being connected, written by commitResults */
+	std::unordered_map<dev::h256, TransactionReceiptsRef> m_cache_result GUARDED_BY(cs_results);
+
+    /** Least recently read receipts first, bounded by m_read_cache_limit bytes */
+    std::list<std::pair<dev::h256, TransactionReceiptsRef>> m_read_cache GUARDED_BY(cs_results);
+    std::unordered_map<dev::h256, std::list<std::pair<dev::h256, TransactionReceiptsRef>>::iterator> m_read_cache_index GUARDED_BY(cs_results);
+    size_t m_read_cache_usage GUARDED_BY(cs_results);
+    /** Bumped by every deletion, so reads racing with one do not cache what was deleted */
+    uint64_t m_generation GUARDED_BY(cs_results);
+    const size_t m_read_cache_limit;
 };
@@ -0,0 +1,125 @@
+#include <qtum/vmlogwriter.h>
+
+#include <logging.h>
+#include <tinyformat.h>
+#include <util/system.h>
+
+#include <functional>
+
+std::unique_ptr<VMLogWriter> g_vmlog_writer;
+
+VMLogWriter::VMLogWriter(const fs::path& path, uint64_t max_file_size) :
+    m_path(path), m_max_file_size(max_file_size)
+{
+}
+
+VMLogWriter::~VMLogWriter()
+{
+    Stop();
+}
+
+bool VMLogWriter::Start()
+{
+    if (!OpenFile()) {
+        return false;
+    }
+    m_thread = std::thread(&TraceThread<std::function<void()>>, "vmlog", std::bind(&VMLogWriter::ThreadWrite, this));
+    return true;
+}
+
+void VMLogWriter::Stop()
+{
+    {
+        LOCK(m_mutex);
+        m_stop = true;
+    }
+    m_cond.notify_one();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    if (m_file) {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+void VMLogWriter::Append(std::string record)
+{
+    {
+        LOCK(m_mutex);
+        if (m_stop || m_queue_bytes + record.size() > MAX_VMLOG_QUEUE_BYTES) {
+            m_dropped++;
+            return;
+        }
+        m_queue_bytes += record.size();
+        m_queue.push_back(std::move(record));
+    }
+    m_cond.notify_one();
+}
+
+bool VMLogWriter::OpenFile()
+{
+    m_file = fsbridge::fopen(m_path, "a");
+    if (!m_file) {
+        LogPrintf("%s: Failed to open %s\n", __func__, m_path.string());
+        return false;
+    }
+    m_file_size = fs::file_size(m_path);
+    return true;
+}
+
+void VMLogWriter::Rotate()
+{
+    fclose(m_file);
+    m_file = nullptr;
+    fs::path rotated;
+    do {
+        rotated = m_path.string() + strprintf(".%u", m_next_rotation++);
+    } while (fs::exists(rotated));
+    try {
+        fs::rename(m_path, rotated);
+    } catch (const fs::filesystem_error& e) {
+        LogPrintf("%s: Failed to rotate %s: %s\n", __func__, m_path.string(), fsbridge::get_filesystem_error_message(e));
+    }
+    OpenFile();
+}
+
+void VMLogWriter::ThreadWrite()
+{
+    std::deque<std::string> records;
+    while (true) {
+        uint64_t dropped;
+        bool stop;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            m_cond.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_stop || !m_queue.empty(); });
+            records.swap(m_queue);
+            m_queue_bytes = 0;
+            dropped = m_dropped;
+            m_dropped = 0;
+            stop = m_stop;
+        }
+
+        if (dropped) {
+            LogPrintf("%s: Dropped %u EVM log records, the writer could not keep up\n", __func__, dropped);
+        }
+        for (const std::string& record : records) {
+            if (!m_file) break;
+            fwrite(record.data(), 1, record.size(), m_file);
+            fputc('\n', m_file);
+            m_file_size += record.size() + 1;
+            if (m_file_size >= m_max_file_size) {
+                Rotate();
+            }
+        }
+        records.clear();
+        if (m_file) {
+            fflush(m_file);
+        }
+
+        if (stop) {
+            // Append refuses new records once stopping, so the queue is drained
+            break;
+        }
+    }
+}
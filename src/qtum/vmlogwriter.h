@@ -0,0 +1,67 @@
+#ifndef QTUM_VMLOGWRITER_H
+#define QTUM_VMLOGWRITER_H
+
+#include <fs.h>
+#include <sync.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+
+/** File name of the EVM LOG opcode record written with -record-log-opcodes */
+static const char* const VMLOG_FILENAME = "vmExecLogs.log";
+/** Default size at which the EVM LOG opcode record is rotated (MiB) */
+static const int64_t DEFAULT_VMLOG_MAX_SIZE = 256;
+/** Maximum amount of records waiting to be written before new ones are dropped */
+static const size_t MAX_VMLOG_QUEUE_BYTES = 64 * 1024 * 1024;
+
+/**
+ * Appends the EVM LOG opcode records to disk on a thread of its own, so the
+ * validation thread only has to queue them. Every record is one JSON object
+ * on its own line. Once the file grows past the size limit it is renamed to
+ * the first free vmExecLogs.log.<n> and a new file is started.
+ */
+class VMLogWriter
+{
+public:
+    VMLogWriter(const fs::path& path, uint64_t max_file_size);
+    ~VMLogWriter();
+
+    /** Open the file and start the writer thread */
+    bool Start();
+
+    /** Write out the queued records and stop the writer thread */
+    void Stop();
+
+    /** Queue one record, dropping it when the writer falls too far behind */
+    void Append(std::string record);
+
+private:
+    void ThreadWrite();
+    bool OpenFile();
+    void Rotate();
+
+    const fs::path m_path;
+    const uint64_t m_max_file_size;
+
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<std::string> m_queue GUARDED_BY(m_mutex);
+    size_t m_queue_bytes GUARDED_BY(m_mutex){0};
+    uint64_t m_dropped GUARDED_BY(m_mutex){0};
+    bool m_stop GUARDED_BY(m_mutex){false};
+
+    /** Only used by the writer thread once started */
+    FILE* m_file{nullptr};
+    uint64_t m_file_size{0};
+    unsigned int m_next_rotation{1};
+
+    std::thread m_thread;
+};
+
+/** The writer used with -record-log-opcodes */
+extern std::unique_ptr<VMLogWriter> g_vmlog_writer;
+
+#endif // QTUM_VMLOGWRITER_H
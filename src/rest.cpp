@@ -7,25 +7,39 @@
 #include <chain.h>
 #include <chainparams.h>
 #include <core_io.h>
+#include <httprpc.h>
 #include <httpserver.h>
 #include <index/txindex.h>
+#include <policy/policy.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
+#include <qtum/qtumDGP.h>
+#include <qtum/qtumstateview.h>
+#include <qtum/storageresults.h>
 #include <rpc/blockchain.h>
 #include <rpc/protocol.h>
 #include <rpc/server.h>
 #include <streams.h>
 #include <sync.h>
+#include <txdb.h>
 #include <txmempool.h>
+#include <util/convert.h>
 #include <util/strencodings.h>
 #include <validation.h>
+#include <validationinterface.h>
 #include <version.h>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/optional.hpp>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #include <univalue.h>
 
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const int MAX_REST_LOGS_BLOCKS = 2000; //allow a max of 2000 blocks of logs to be queried at once
 
 enum class RetFormat {
     UNDEF,
@@ -622,6 +636,632 @@ static bool rest_blockhash_by_height(HTTPRequest* req,
     }
 }
 
+static bool rest_receipt(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string hashStr;
+    const RetFormat rf = ParseDataFormat(hashStr, strURIPart);
+
+    uint256 hash;
+    if (!ParseHashStr(hashStr, hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
+    if (!fLogEvents)
+        return RESTERR(req, HTTP_NOT_FOUND, "Receipts are only stored with -logevents");
+
+    switch (rf) {
+    case RetFormat::BINARY: {
+        // the stored encoding is served as is, keyed by the transaction hash of the request
+        std::string value;
+        if (!pstorageresult->getRawResult(uintToh256(hash), value))
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, value);
+        return true;
+    }
+
+    case RetFormat::HEX: {
+        std::string value;
+        if (!pstorageresult->getRawResult(uintToh256(hash), value))
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        std::string strHex = HexStr(value.begin(), value.end()) + "\n";
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, strHex);
+        return true;
+    }
+
+    case RetFormat::JSON: {
+        TransactionReceiptsRef receipts = pstorageresult->getResult(uintToh256(hash));
+        if (receipts->empty())
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        UniValue objReceipts(UniValue::VARR);
+        for (const TransactionReceiptInfo& receipt : *receipts) {
+            UniValue objReceipt(UniValue::VOBJ);
+            transactionReceiptInfoToJSON(receipt, objReceipt);
+            objReceipts.push_back(objReceipt);
+        }
+        std::string strJSON = objReceipts.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+}
+
+static bool rest_logs(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "No block range specified. Use /rest/logs/<from>/<to>.<ext>.");
+
+    int32_t from, to;
+    if (!ParseInt32(path[0], &from) || !ParseInt32(path[1], &to) || from < 1 || to < from)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid block range: " + SanitizeString(param));
+    if (to - from >= MAX_REST_LOGS_BLOCKS)
+        return RESTERR(req, HTTP_BAD_REQUEST, strprintf("Block range too large, max %d blocks", MAX_REST_LOGS_BLOCKS));
+    if (!fLogEvents)
+        return RESTERR(req, HTTP_NOT_FOUND, "Logs are only stored with -logevents");
+    if (rf == RetFormat::UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+
+    // the height index lists the transactions with logs, once per contract address logging
+    std::vector<std::vector<uint256>> blocksOfHashes;
+    pblocktree->ReadHeightIndex(from, to, 0, blocksOfHashes, std::set<dev::h160>());
+    std::vector<uint256> hashes;
+    std::set<uint256> seen;
+    for (const std::vector<uint256>& blockHashes : blocksOfHashes) {
+        for (const uint256& hash : blockHashes) {
+            if (seen.insert(hash).second)
+                hashes.push_back(hash);
+        }
+    }
+
+    if (rf == RetFormat::JSON) {
+        UniValue objReceipts(UniValue::VARR);
+        for (const uint256& hash : hashes) {
+            TransactionReceiptsRef receipts = pstorageresult->getResult(uintToh256(hash));
+            for (const TransactionReceiptInfo& receipt : *receipts) {
+                UniValue objReceipt(UniValue::VOBJ);
+                transactionReceiptInfoToJSON(receipt, objReceipt);
+                objReceipts.push_back(objReceipt);
+            }
+        }
+        std::string strJSON = objReceipts.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+
+    // each transaction hash is followed by its receipts as stored, prefixed with their size
+    CDataStream ssLogs(SER_NETWORK, PROTOCOL_VERSION);
+    for (const uint256& hash : hashes) {
+        std::string value;
+        if (!pstorageresult->getRawResult(uintToh256(hash), value))
+            continue;
+        ssLogs << hash << value;
+    }
+
+    if (rf == RetFormat::BINARY) {
+        std::string binaryLogs = ssLogs.str();
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, binaryLogs);
+        return true;
+    }
+
+    std::string strHex = HexStr(ssLogs.begin(), ssLogs.end()) + "\n";
+    req->WriteHeader("Content-Type", "text/plain");
+    req->WriteReply(HTTP_OK, strHex);
+    return true;
+}
+
+static bool rest_rpcmetrics(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!gArgs.GetBoolArg("-restrpcmetrics", DEFAULT_REST_RPC_METRICS))
+        return RESTERR(req, HTTP_NOT_FOUND, "RPC metrics are only served with -restrpcmetrics");
+    if (!strURIPart.empty())
+        return RESTERR(req, HTTP_NOT_FOUND, "Use /rest/rpcmetrics");
+
+    req->WriteHeader("Content-Type", "text/plain; version=0.0.4");
+    req->WriteReply(HTTP_OK, RPCMetricsPrometheus());
+    return true;
+}
+
+/** Open a state view on the active tip for the contract endpoints, which run without cs_main */
+static QtumStateViewPool::Handle TipStateView(HTTPRequest* req, std::shared_ptr<const ChainTipSnapshot>& snapshot)
+{
+    QtumStateViewPool::Handle view = TipStateView(snapshot);
+    if (!view) {
+        RESTERR(req, HTTP_SERVICE_UNAVAILABLE, "Chain is not loaded");
+    }
+    return view;
+}
+
+static bool ParseContractAddress(const std::string& strAddr, dev::Address& addr)
+{
+    if (strAddr.size() != 40 || !IsHex(strAddr))
+        return false;
+    addr = dev::Address(strAddr);
+    return true;
+}
+
+static void WriteContractReply(HTTPRequest* req, RetFormat rf, const std::vector<unsigned char>& data, const UniValue& json)
+{
+    switch (rf) {
+    case RetFormat::BINARY: {
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, std::string(data.begin(), data.end()));
+        return;
+    }
+    case RetFormat::HEX: {
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, HexStr(data) + "\n");
+        return;
+    }
+    default: {
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, json.write() + "\n");
+        return;
+    }
+    }
+}
+
+static bool rest_contract(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    const bool info = path.size() == 2 && path[1] == "info";
+    const bool storage = path.size() == 3 && path[1] == "storage";
+    if (!info && !storage)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Use /rest/contract/<address>/info.<ext> or /rest/contract/<address>/storage/<slot>.<ext>");
+    if (rf == RetFormat::UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    dev::Address addr;
+    if (!ParseContractAddress(path[0], addr))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address: " + SanitizeString(path[0]));
+    if (storage && (path[2].size() != 64 || !IsHex(path[2])))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid storage slot: " + SanitizeString(path[2]));
+
+    std::shared_ptr<const ChainTipSnapshot> snapshot;
+    QtumStateViewPool::Handle view = TipStateView(req, snapshot);
+    if (!view)
+        return false;
+    QtumState& state = view->state();
+    if (!state.addressInUse(addr))
+        return RESTERR(req, HTTP_NOT_FOUND, path[0] + " not found");
+
+    UniValue json(UniValue::VOBJ);
+    json.pushKV("address", path[0]);
+    json.pushKV("blockhash", snapshot->tip->GetBlockHash().GetHex());
+    json.pushKV("height", snapshot->height);
+
+    if (storage) {
+        // the value of the slot as a big endian 32 byte word
+        const dev::h256 slot(path[2]);
+        const dev::h256 value(state.storage(addr, dev::u256(slot)));
+        json.pushKV("slot", path[2]);
+        json.pushKV("value", value.hex());
+        WriteContractReply(req, rf, value.asBytes(), json);
+        return true;
+    }
+
+    const std::vector<unsigned char> code = state.code(addr);
+    const CAmount balance = CAmount(state.balance(addr));
+    const uint256 codeHash = h256Touint(state.codeHash(addr));
+    const uint256 storageRoot = h256Touint(state.storageRoot(addr));
+
+    json.pushKV("balance", balance);
+    json.pushKV("codehash", codeHash.GetHex());
+    json.pushKV("storageroot", storageRoot.GetHex());
+    json.pushKV("code", HexStr(code));
+
+    CDataStream ssInfo(SER_NETWORK, PROTOCOL_VERSION);
+    ssInfo << snapshot->tip->GetBlockHash() << snapshot->height << balance << codeHash << storageRoot << code;
+    WriteContractReply(req, rf, std::vector<unsigned char>(ssInfo.begin(), ssInfo.end()), json);
+    return true;
+}
+
+static bool rest_call(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Use /rest/call/<address>/<data>.<ext>");
+    if (rf == RetFormat::UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    dev::Address addr;
+    if (!ParseContractAddress(path[0], addr))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address: " + SanitizeString(path[0]));
+    if (path[1].size() % 2 != 0 || !IsHex(path[1]))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid data (data not hex)");
+
+    std::shared_ptr<const ChainTipSnapshot> snapshot;
+    QtumStateViewPool::Handle view = TipStateView(req, snapshot);
+    if (!view)
+        return false;
+    if (!view->state().addressInUse(addr))
+        return RESTERR(req, HTTP_NOT_FOUND, path[0] + " not found");
+
+    // same parameters as callcontract, read from the view instead of the global state
+    CBlockIndex* pblockindex = const_cast<CBlockIndex*>(snapshot->tip);
+    QtumDGP qtumDGP(*view, pblockindex, fGettingValuesDGP);
+    view->sealEngine().setQtumSchedule(qtumDGP.getGasSchedule(pblockindex->nHeight + 1));
+    const uint64_t blockGasLimit = qtumDGP.getBlockGasLimit(pblockindex->nHeight + 1);
+    const uint64_t gasLimit = std::min<uint64_t>(gArgs.GetArg("-restcallgaslimit", DEFAULT_REST_CALL_GAS_LIMIT), blockGasLimit - 1);
+
+    std::vector<ResultExecute> execResults = CallContract(*view, addr, ParseHex(path[1]), pblockindex, dev::Address(), gasLimit, blockGasLimit);
+
+    UniValue json(UniValue::VOBJ);
+    json.pushKV("address", path[0]);
+    json.pushKV("blockhash", snapshot->tip->GetBlockHash().GetHex());
+    json.pushKV("height", snapshot->height);
+    json.pushKV("executionResult", executionResultToJSON(execResults[0].execRes));
+    json.pushKV("transactionReceipt", transactionReceiptToJSON(execResults[0].txRec));
+    WriteContractReply(req, rf, execResults[0].execRes.output, json);
+    return true;
+}
+
+/** Interval between the keep-alive comments written to open /rest/subscribe streams */
+static const int REST_SUBSCRIBE_PING_SECONDS = 5;
+/** Unsent bytes after which a /rest/subscribe stream is closed as too slow */
+static const size_t REST_SUBSCRIBE_MAX_PENDING = 4 * 1024 * 1024;
+/** Most contract addresses a /rest/subscribe stream may filter logs by */
+static const size_t REST_SUBSCRIBE_MAX_ADDRESSES = 100;
+/** Most log topics a /rest/subscribe stream may filter by */
+static const size_t REST_SUBSCRIBE_MAX_TOPICS = 4;
+
+/**
+ * Server-sent event streams opened at /rest/subscribe. A stream receives new tips, new mempool
+ * transactions and the EVM logs of connected blocks, the logs optionally filtered by contract
+ * address and topics. The events come from the validation interface and are formatted once for
+ * all streams, so an open stream holds a connection but no worker thread.
+ */
+class RESTSubscriptions final : public CValidationInterface
+{
+public:
+    struct Filter {
+        bool blocks = false;
+        bool txs = false;
+        bool logs = false;
+        std::set<dev::h160> addresses;
+        std::vector<boost::optional<dev::h256>> topics;
+
+        /** Read the query of a /rest/subscribe request */
+        bool Parse(const std::string& query, std::string& error);
+        bool Match(const dev::eth::LogEntry& log) const;
+    };
+
+    /** Take over a stream whose reply was started */
+    void Add(const Filter& filter, std::unique_ptr<HTTPRequest> req);
+    size_t Size();
+
+    void Start();
+    /** Close every stream and join the thread */
+    void Stop();
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override;
+    void TransactionAddedToMempool(const CTransactionRef& tx) override;
+    void BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex, const std::vector<CTransactionRef>& txnConflicted) override;
+
+private:
+    struct Subscriber {
+        Filter filter;
+        std::unique_ptr<HTTPRequest> req;
+    };
+
+    void ThreadRun();
+
+    /** Write an event to the streams whose filter wants it */
+    void Send(const std::string& event, const std::function<bool(const Filter&)>& wants);
+
+    /** End a stream on a worker thread, ending it waits for the client to close */
+    static void Close(std::unique_ptr<HTTPRequest> req);
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::vector<Subscriber> m_subscribers;
+    bool m_running = false;
+    std::thread m_thread;
+};
+
+static RESTSubscriptions g_restSubscriptions;
+
+static std::string EventText(const std::string& name, const UniValue& data)
+{
+    return "event: " + name + "\ndata: " + data.write() + "\n\n";
+}
+
+static UniValue BlockEventToJSON(const CBlockIndex* pindex, const CBlockIndex* pindexFork)
+{
+    UniValue data(UniValue::VOBJ);
+    data.pushKV("hash", pindex->GetBlockHash().GetHex());
+    data.pushKV("height", pindex->nHeight);
+    data.pushKV("time", pindex->GetBlockTime());
+    data.pushKV("forkheight", pindexFork ? pindexFork->nHeight : -1);
+    return data;
+}
+
+bool RESTSubscriptions::Filter::Parse(const std::string& query, std::string& error)
+{
+    std::string events = "blocks";
+    std::vector<std::string> params;
+    if (!query.empty())
+        boost::split(params, query, boost::is_any_of("&"));
+    for (const std::string& param : params) {
+        const std::string::size_type pos = param.find('=');
+        const std::string key = param.substr(0, pos);
+        const std::string value = pos == std::string::npos ? "" : param.substr(pos + 1);
+        std::vector<std::string> items;
+        boost::split(items, value, boost::is_any_of(","));
+        if (key == "events") {
+            events = value;
+        } else if (key == "addresses") {
+            for (const std::string& item : items) {
+                if (item.size() != 40 || !IsHex(item)) {
+                    error = "Invalid address: " + SanitizeString(item);
+                    return false;
+                }
+                addresses.insert(dev::h160(item));
+            }
+            if (addresses.size() > REST_SUBSCRIBE_MAX_ADDRESSES) {
+                error = strprintf("Too many addresses, max %u", REST_SUBSCRIBE_MAX_ADDRESSES);
+                return false;
+            }
+        } else if (key == "topics") {
+            if (items.size() > REST_SUBSCRIBE_MAX_TOPICS) {
+                error = strprintf("Too many topics, max %u", REST_SUBSCRIBE_MAX_TOPICS);
+                return false;
+            }
+            // an empty or null topic matches any topic at its position
+            for (const std::string& item : items) {
+                if (item.empty() || item == "null") {
+                    topics.push_back(boost::none);
+                } else if (item.size() == 64 && IsHex(item)) {
+                    topics.push_back(dev::h256(item));
+                } else {
+                    error = "Invalid topic: " + SanitizeString(item);
+                    return false;
+                }
+            }
+        } else {
+            error = "Unknown parameter: " + SanitizeString(key);
+            return false;
+        }
+    }
+
+    std::vector<std::string> names;
+    boost::split(names, events, boost::is_any_of(","));
+    for (const std::string& name : names) {
+        if (name == "blocks") {
+            blocks = true;
+        } else if (name == "txs") {
+            txs = true;
+        } else if (name == "logs") {
+            logs = true;
+        } else {
+            error = "Unknown event: " + SanitizeString(name) + " (available: blocks, txs, logs)";
+            return false;
+        }
+    }
+    if (!logs && (!addresses.empty() || !topics.empty())) {
+        error = "Addresses and topics filter logs, subscribe to events=logs";
+        return false;
+    }
+    return true;
+}
+
+bool RESTSubscriptions::Filter::Match(const dev::eth::LogEntry& log) const
+{
+    if (!addresses.empty() && addresses.count(log.address) == 0)
+        return false;
+    for (size_t i = 0; i < topics.size(); i++) {
+        if (topics[i] && (i >= log.topics.size() || log.topics[i] != topics[i].get()))
+            return false;
+    }
+    return true;
+}
+
+void RESTSubscriptions::Add(const Filter& filter, std::unique_ptr<HTTPRequest> req)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_running) {
+            m_subscribers.push_back(Subscriber{filter, std::move(req)});
+            return;
+        }
+    }
+    req->ChunkEnd();
+}
+
+size_t RESTSubscriptions::Size()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_subscribers.size();
+}
+
+void RESTSubscriptions::Start()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_running)
+        return;
+    m_running = true;
+    m_thread = std::thread(&TraceThread<std::function<void()>>, "restsubscribe", std::function<void()>(std::bind(&RESTSubscriptions::ThreadRun, this)));
+    RegisterValidationInterface(this);
+}
+
+void RESTSubscriptions::Stop()
+{
+    std::vector<Subscriber> subscribers;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running)
+            return;
+        m_running = false;
+        subscribers.swap(m_subscribers);
+    }
+    UnregisterValidationInterface(this);
+    m_cond.notify_all();
+    if (m_thread.joinable())
+        m_thread.join();
+    // the workers are interrupted by now, and with RPC stopped ending a stream does not wait
+    for (Subscriber& subscriber : subscribers)
+        subscriber.req->ChunkEnd();
+}
+
+void RESTSubscriptions::Close(std::unique_ptr<HTTPRequest> req)
+{
+    auto work = [](HTTPRequest* r) { r->ChunkEnd(); };
+    if (!EnqueueHTTPWork(req, work))
+        work(req.get());
+}
+
+void RESTSubscriptions::Send(const std::string& event, const std::function<bool(const Filter&)>& wants)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (Subscriber& subscriber : m_subscribers) {
+        // closed and slow streams are removed by the thread
+        if (wants(subscriber.filter) && !subscriber.req->isConnClosed() && subscriber.req->PendingOutput() <= REST_SUBSCRIBE_MAX_PENDING)
+            subscriber.req->Chunk(event);
+    }
+}
+
+void RESTSubscriptions::UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload)
+{
+    if (fInitialDownload)
+        return;
+    Send(EventText("block", BlockEventToJSON(pindexNew, pindexFork)), [](const Filter& filter) { return filter.blocks; });
+}
+
+void RESTSubscriptions::TransactionAddedToMempool(const CTransactionRef& tx)
+{
+    UniValue data(UniValue::VOBJ);
+    data.pushKV("txid", tx->GetHash().GetHex());
+    data.pushKV("vsize", (int64_t)GetVirtualTransactionSize(*tx));
+    Send(EventText("tx", data), [](const Filter& filter) { return filter.txs; });
+}
+
+void RESTSubscriptions::BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex, const std::vector<CTransactionRef>& txnConflicted)
+{
+    if (!fLogEvents)
+        return;
+    std::vector<Filter> filters;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const Subscriber& subscriber : m_subscribers) {
+            if (subscriber.filter.logs)
+                filters.push_back(subscriber.filter);
+        }
+    }
+    if (filters.empty())
+        return;
+
+    const uint256 hashBlock = block->GetHash();
+    for (const CTransactionRef& tx : block->vtx) {
+        if (!tx->HasCreateOrCall())
+            continue;
+        // receipts of the transaction in blocks of other branches are stored under the same hash
+        TransactionReceiptsRef receipts = pstorageresult->getResult(uintToh256(tx->GetHash()));
+        for (const TransactionReceiptInfo& receipt : *receipts) {
+            if (receipt.blockHash != hashBlock)
+                continue;
+            for (const dev::eth::LogEntry& log : receipt.logs) {
+                if (std::none_of(filters.begin(), filters.end(), [&log](const Filter& filter) { return filter.Match(log); }))
+                    continue;
+                UniValue data(UniValue::VOBJ);
+                logEntryToJSON(receipt, log, data);
+                Send(EventText("log", data), [&log](const Filter& filter) { return filter.logs && filter.Match(log); });
+            }
+        }
+    }
+}
+
+void RESTSubscriptions::ThreadRun()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running) {
+        m_cond.wait_for(lock, std::chrono::seconds(REST_SUBSCRIBE_PING_SECONDS), [this] { return !m_running; });
+        if (!m_running)
+            break;
+
+        std::vector<Subscriber> closed;
+        for (auto it = m_subscribers.begin(); it != m_subscribers.end(); ) {
+            if (it->req->isConnClosed() || it->req->PendingOutput() > REST_SUBSCRIBE_MAX_PENDING) {
+                closed.push_back(std::move(*it));
+                it = m_subscribers.erase(it);
+                continue;
+            }
+            // a comment line, it also lets the connection notice a client that went away
+            it->req->Chunk(":\n\n");
+            ++it;
+        }
+        lock.unlock();
+
+        for (Subscriber& subscriber : closed) {
+            LogPrint(BCLog::HTTP, "Closing event stream to %s\n", subscriber.req->GetPeer().ToString());
+            Close(std::move(subscriber.req));
+        }
+        lock.lock();
+    }
+}
+
+static bool rest_subscribe(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    const int64_t maxSubscribers = gArgs.GetArg("-restsubscribers", DEFAULT_REST_SUBSCRIBERS);
+    if (maxSubscribers <= 0)
+        return RESTERR(req, HTTP_NOT_FOUND, "Event streams are disabled with -restsubscribers=0");
+    if (req->GetRequestMethod() != HTTPRequest::GET)
+        return RESTERR(req, HTTP_BAD_METHOD, "Use GET /rest/subscribe");
+    if (!strURIPart.empty() && strURIPart[0] != '?')
+        return RESTERR(req, HTTP_NOT_FOUND, "Use /rest/subscribe?events=<blocks,txs,logs>");
+
+    RESTSubscriptions::Filter filter;
+    std::string error;
+    if (!filter.Parse(strURIPart.empty() ? "" : strURIPart.substr(1), error))
+        return RESTERR(req, HTTP_BAD_REQUEST, error);
+    if (filter.logs && !fLogEvents)
+        return RESTERR(req, HTTP_NOT_FOUND, "Logs are only streamed with -logevents");
+    if (g_restSubscriptions.Size() >= (uint64_t)maxSubscribers)
+        return RESTERR(req, HTTP_SERVICE_UNAVAILABLE, "Too many event streams open");
+
+    std::string start = strprintf("retry: %d\n\n", REST_SUBSCRIBE_PING_SECONDS * 1000);
+    if (filter.blocks) {
+        // the current tip, so a client knows where the stream starts
+        std::shared_ptr<const ChainTipSnapshot> snapshot = GetChainTipSnapshot();
+        if (snapshot->tip)
+            start += EventText("block", BlockEventToJSON(snapshot->tip, nullptr));
+    }
+    req->WriteHeader("Content-Type", "text/event-stream");
+    req->WriteHeader("Cache-Control", "no-cache");
+    req->WriteHeader("Connection", "close");
+    req->Chunk(start);
+    req->Defer([filter](std::unique_ptr<HTTPRequest> taken) {
+        g_restSubscriptions.Add(filter, std::move(taken));
+    });
+    return true;
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -635,20 +1275,30 @@ static const struct {
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
       {"/rest/blockhashbyheight/", rest_blockhash_by_height},
+      {"/rest/receipt/", rest_receipt},
+      {"/rest/logs/", rest_logs},
+      {"/rest/contract/", rest_contract},
+      {"/rest/call/", rest_call},
+      {"/rest/rpcmetrics", rest_rpcmetrics},
+      {"/rest/subscribe", rest_subscribe},
 };
 
 void StartREST()
 {
     for (unsigned int i = 0; i < ARRAYLEN(uri_prefixes); i++)
         RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler);
+    if (gArgs.GetArg("-restsubscribers", DEFAULT_REST_SUBSCRIBERS) > 0)
+        g_restSubscriptions.Start();
 }
 
 void InterruptREST()
 {
+    g_restSubscriptions.Stop();
 }
 
 void StopREST()
 {
     for (unsigned int i = 0; i < ARRAYLEN(uri_prefixes); i++)
         UnregisterHTTPHandler(uri_prefixes[i].prefix, false);
+    g_restSubscriptions.Stop();
 }
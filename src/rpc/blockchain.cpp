@@ -11,15 +11,23 @@
 #include <chainparams.h>
 #include <coins.h>
 #include <node/coinstats.h>
+#include <node/utxo_snapshot.h>
 #include <consensus/validation.h>
 #include <core_io.h>
 #include <hash.h>
+#include <httpserver.h>
 #include <index/blockfilterindex.h>
+#include <index/coinstatsindex.h>
+#include <index/contractindex.h>
+#include <index/governanceindex.h>
+#include <index/logindex.h>
+#include <index/tokenindex.h>
 #include <key_io.h>
 #include <policy/feerate.h>
 #include <policy/policy.h>
 #include <policy/rbf.h>
 #include <primitives/transaction.h>
+#include <qtum/statepruner.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <script/descriptor.h>
@@ -48,9 +56,14 @@
 
 #include <boost/thread/thread.hpp> // boost::thread::interrupt
 
+#include <algorithm>
 #include <condition_variable>
+#include <iterator>
+#include <limits>
 #include <memory>
 #include <mutex>
+#include <thread>
+#include <tuple>
 
 /* Calculate the difficulty for a given block index.
  */
@@ -373,8 +386,7 @@ static UniValue getblockcount(const JSONRPCRequest& request)
                 },
             }.Check(request);
 
-    LOCK(cs_main);
-    return ::ChainActive().Height();
+    return GetChainTipSnapshot()->height;
 }
 
 static UniValue getbestblockhash(const JSONRPCRequest& request)
@@ -391,10 +403,11 @@ static UniValue getbestblockhash(const JSONRPCRequest& request)
                 },
             }.Check(request);
 
-    LOCK(cs_main);
-    return ::ChainActive().Tip()->GetBlockHash().GetHex();
+    return GetChainTipSnapshot()->tip->GetBlockHash().GetHex();
 }
 
+static void NotifyLogSubscriptions();
+
 void RPCNotifyBlockChange(bool ibd, const CBlockIndex * pindex)
 {
     if(pindex) {
@@ -403,6 +416,7 @@ void RPCNotifyBlockChange(bool ibd, const CBlockIndex * pindex)
         latestblock.height = pindex->nHeight;
     }
     cond_blockchange.notify_all();
+    NotifyLogSubscriptions();
 }
 
 static UniValue waitfornewblock(const JSONRPCRequest& request)
@@ -578,6 +592,7 @@ static std::string EntryDescriptionString()
            "    \"modifiedfee\" : n,      (numeric) transaction fee with fee deltas used for mining priority (DEPRECATED)\n"
            "    \"time\" : n,             (numeric) local time transaction entered pool in seconds since 1 Jan 1970 GMT\n"
            "    \"height\" : n,           (numeric) block height when transaction entered pool\n"
+           "    \"exectime\" : n,         (numeric) microseconds the contracts of the transaction took to execute, as predicted or measured by the block assembler\n"
            "    \"descendantcount\" : n,  (numeric) number of in-mempool descendant transactions (including this one)\n"
            "    \"descendantsize\" : n,   (numeric) virtual transaction size of in-mempool descendants (including this one)\n"
            "    \"descendantfees\" : n,   (numeric) modified fees (see above) of in-mempool descendants (including this one) (DEPRECATED)\n"
@@ -618,6 +633,7 @@ static void entryToJSON(const CTxMemPool& pool, UniValue& info, const CTxMemPool
     info.pushKV("modifiedfee", ValueFromAmount(e.GetModifiedFee()));
     info.pushKV("time", e.GetTime());
     info.pushKV("height", (int)e.GetHeight());
+    info.pushKV("exectime", e.GetExecTime());
     info.pushKV("descendantcount", e.GetCountWithDescendants());
     info.pushKV("descendantsize", e.GetSizeWithDescendants());
     info.pushKV("descendantfees", e.GetModFeesWithDescendants());
@@ -905,73 +921,92 @@ static UniValue getblockhash(const JSONRPCRequest& request)
                 },
             }.Check(request);
 
-    LOCK(cs_main);
-
     int nHeight = request.params[0].get_int();
-    if (nHeight < 0 || nHeight > ::ChainActive().Height())
+    const CBlockIndex* pblockindex = (*GetChainTipSnapshot())[nHeight];
+    if (!pblockindex)
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
 
-    CBlockIndex* pblockindex = ::ChainActive()[nHeight];
     return pblockindex->GetBlockHash().GetHex();
 }
 
+/** Throw when -prunestate deleted the contract state of the block */
+static void CheckStateAvailable(const CBlockIndex* pblockindex)
+{
+    if (IsStatePruned(pblockindex->nHeight)) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Contract state not available (pruned data)");
+    }
+}
+
 static UniValue getaccountinfo(const JSONRPCRequest& request)
 {
             RPCHelpMan{"getaccountinfo",
                 "\nGet contract details including balance, storage data and code.\n",
                 {
                     {"address", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The contract address"},
+                    {"storage", RPCArg::Type::BOOL, /* default */ "true", "Include the storage, getstorage with a limit reads a large storage in pages"},
                 },
                 RPCResult{
             "{\n"
             "  \"address\": \"contract address\",    (string)  address of the contract\n"
             "  \"balance\": n,                     (numeric) balance of the contract\n"
-            "  \"storage\": {...},                 (object)  storage data of the contract\n"
+            "  \"storage\": {...},                 (object)  storage data of the contract, left out with storage false\n"
             "  \"code\": \"bytecode\"                (string)  bytecode of the contract\n"
             "}\n"
                 },
                 RPCExamples{
                     HelpExampleCli("getaccountinfo", "eb23c0b3e6042821da281a2e2364feb22dd543e3")
+            + HelpExampleCli("getaccountinfo", "eb23c0b3e6042821da281a2e2364feb22dd543e3 false")
             + HelpExampleRpc("getaccountinfo", "eb23c0b3e6042821da281a2e2364feb22dd543e3")
                 },
             }.Check(request);
 
-    LOCK(cs_main);
-
     std::string strAddr = request.params[0].get_str();
     if(strAddr.size() != 40 || !CheckHex(strAddr))
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect address");
+    const bool fStorage = request.params[1].isNull() || request.params[1].get_bool();
+
+    // Read from a state view on the tip, so cs_main is not held while the storage is read
+    QtumStateViewPool::Handle view;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pblockindex = ::ChainActive().Tip();
+        view = stateViewPool.acquire(uintToh256(pblockindex->hashStateRoot), uintToh256(pblockindex->hashUTXORoot));
+    }
 
     dev::Address addrAccount(strAddr);
-    if(!globalState->addressInUse(addrAccount))
+    if(!view->state().addressInUse(addrAccount))
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Address does not exist");
     
     UniValue result(UniValue::VOBJ);
 
     result.pushKV("address", strAddr);
-    result.pushKV("balance", CAmount(globalState->balance(addrAccount)));
-    std::vector<uint8_t> code(globalState->code(addrAccount));
-    auto storage(globalState->storage(addrAccount));
+    result.pushKV("balance", CAmount(view->state().balance(addrAccount)));
+    std::vector<uint8_t> code(view->state().code(addrAccount));
 
-    UniValue storageUV(UniValue::VOBJ);
-    for (auto j: storage)
+    if (fStorage)
     {
-        UniValue e(UniValue::VOBJ);
-        e.pushKV(dev::toHex(dev::h256(j.second.first)), dev::toHex(dev::h256(j.second.second)));
-        storageUV.pushKV(j.first.hex(), e);
+        auto storage(view->state().storage(addrAccount));
+
+        UniValue storageUV(UniValue::VOBJ);
+        for (auto j: storage)
+        {
+            UniValue e(UniValue::VOBJ);
+            e.pushKV(dev::toHex(dev::h256(j.second.first)), dev::toHex(dev::h256(j.second.second)));
+            storageUV.pushKV(j.first.hex(), e);
+        }
+
+        result.pushKV("storage", storageUV);
     }
-        
-    result.pushKV("storage", storageUV);
 
     result.pushKV("code", HexStr(code.begin(), code.end()));
 
-    std::unordered_map<dev::Address, Vin> vins = globalState->vins();
-    if(vins.count(addrAccount)){
+    Vin vinAccount;
+    if(view->state().liveVin(addrAccount, vinAccount)){
         UniValue vin(UniValue::VOBJ);
-        valtype vchHash(vins[addrAccount].hash.asBytes());
+        valtype vchHash(vinAccount.hash.asBytes());
         vin.pushKV("hash", HexStr(vchHash.rbegin(), vchHash.rend()));
-        vin.pushKV("nVout", uint64_t(vins[addrAccount].nVout));
-        vin.pushKV("value", uint64_t(vins[addrAccount].value));
+        vin.pushKV("nVout", uint64_t(vinAccount.nVout));
+        vin.pushKV("value", uint64_t(vinAccount.value));
         result.pushKV("vin", vin);
     }
     return result;
@@ -995,33 +1030,40 @@ static UniValue getcontractcode(const JSONRPCRequest& request)
             }
                 .ToString());
 
-    LOCK(cs_main);
-
     std::string strAddr = request.params[0].get_str();
     if(strAddr.size() != 40 || !CheckHex(strAddr))
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect address");
 
-    TemporaryState ts(globalState);
-    if (request.params.size() > 1) {
-        if (request.params[1].isNum()) {
-            auto blockNum = request.params[1].get_int();
-            if (blockNum < 0 || blockNum > ::ChainActive().Height())
+    QtumStateViewPool::Handle view;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pblockindex = ::ChainActive().Tip();
+        if (request.params.size() > 1) {
+            if (request.params[1].isNum()) {
+                auto blockNum = request.params[1].get_int();
+                if (blockNum < 0 || blockNum > ::ChainActive().Height())
+                    throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
+                pblockindex = ::ChainActive()[blockNum];
+            } else {
                 throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
-            ts.SetRoot(uintToh256(::ChainActive()[blockNum]->hashStateRoot), uintToh256(::ChainActive()[blockNum]->hashUTXORoot));
-        } else {
-            throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
+            }
         }
+        CheckStateAvailable(pblockindex);
+        view = stateViewPool.acquire(uintToh256(pblockindex->hashStateRoot), uintToh256(pblockindex->hashUTXORoot));
     }
 
     dev::Address addrAccount(strAddr);
-    if (!globalState->addressInUse(addrAccount))
+    if (!view->state().addressInUse(addrAccount))
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Address does not exist");
 
-    std::vector<uint8_t> code(globalState->code(addrAccount));
+    std::vector<uint8_t> code(view->state().code(addrAccount));
 
     return HexStr(code.begin(), code.end());
 }
 
+/** Page size of getstorage when only a cursor or prefix is given */
+static const size_t DEFAULT_GETSTORAGE_PAGE_SIZE = 1000;
+
 static UniValue getstorage(const JSONRPCRequest& request)
 {
             RPCHelpMan{"getstorage",
@@ -1030,51 +1072,111 @@ static UniValue getstorage(const JSONRPCRequest& request)
                     {"address", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The contract address"},
                     {"blockNum", RPCArg::Type::NUM,  /* default */ "latest", "Number of block to get state from."},
                     {"index", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "Zero-based index position of the storage"},
+                    {"limit", RPCArg::Type::NUM, /* default */ "null", "Return at most this many entries as a page, see below. Defaults to "+std::to_string(DEFAULT_GETSTORAGE_PAGE_SIZE)+" when only a cursor or prefix is given."},
+                    {"cursor", RPCArg::Type::STR_HEX, /* default */ "null", "The cursor returned with the previous page, to continue from it."},
+                    {"prefix", RPCArg::Type::STR_HEX, /* default */ "null", "Only return the entries whose hashed key starts with these hex digits."},
                 },
                 RPCResult{
             "(object)  storage data of the contract\n"
+            "\nWith limit, cursor or prefix the entries are returned in pages, in the order of their hashed keys:\n"
+            "{\n"
+            "  \"storage\": {...},                 (object)  storage data as above\n"
+            "  \"cursor\": \"hex\"                   (string)  pass as cursor to get the next page, null after the last page\n"
+            "}\n"
                 },
                 RPCExamples{
                     HelpExampleCli("getstorage", "eb23c0b3e6042821da281a2e2364feb22dd543e3")
+            + HelpExampleCli("getstorage", "eb23c0b3e6042821da281a2e2364feb22dd543e3 -1 null 1000")
             + HelpExampleRpc("getstorage", "eb23c0b3e6042821da281a2e2364feb22dd543e3")
                 },
             }.Check(request);
 
-    LOCK(cs_main);
-
     std::string strAddr = request.params[0].get_str();
     if(strAddr.size() != 40 || !CheckHex(strAddr))
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect address"); 
 
-    TemporaryState ts(globalState);
-    if (request.params.size() > 1)
+    // Historical queries read from a state view on the block roots, the global state is never moved
+    QtumStateViewPool::Handle view;
     {
-        if (request.params[1].isNum())
+        LOCK(cs_main);
+        const CBlockIndex* pblockindex = ::ChainActive().Tip();
+        if (request.params.size() > 1)
         {
-            auto blockNum = request.params[1].get_int();
-            if((blockNum < 0 && blockNum != -1) || blockNum > ::ChainActive().Height())
-                throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
+            if (request.params[1].isNum())
+            {
+                auto blockNum = request.params[1].get_int();
+                if((blockNum < 0 && blockNum != -1) || blockNum > ::ChainActive().Height())
+                    throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
 
-            if(blockNum != -1)
-                ts.SetRoot(uintToh256(::ChainActive()[blockNum]->hashStateRoot), uintToh256(::ChainActive()[blockNum]->hashUTXORoot));
-                
-        } else {
-            throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
+                if(blockNum != -1)
+                    pblockindex = ::ChainActive()[blockNum];
+
+            } else {
+                throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
+            }
         }
+        CheckStateAvailable(pblockindex);
+        view = stateViewPool.acquire(uintToh256(pblockindex->hashStateRoot), uintToh256(pblockindex->hashUTXORoot));
     }
 
     dev::Address addrAccount(strAddr);
-    if(!globalState->addressInUse(addrAccount))
+    if(!view->state().addressInUse(addrAccount))
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Address does not exist");
     
+    const bool paged = !request.params[3].isNull() || !request.params[4].isNull() || !request.params[5].isNull();
+    if (paged)
+    {
+        if (!request.params[2].isNull())
+            throw JSONRPCError(RPC_INVALID_PARAMS, "index can not be used with limit, cursor or prefix");
+
+        size_t limit = DEFAULT_GETSTORAGE_PAGE_SIZE;
+        if (!request.params[3].isNull()) {
+            int n = request.params[3].get_int();
+            if (n <= 0)
+                throw JSONRPCError(RPC_INVALID_PARAMS, "limit must be positive");
+            limit = n;
+        }
+
+        // the prefix selects a range of hashed keys, the cursor moves its start
+        std::string prefix = request.params[5].isNull() ? "" : request.params[5].get_str();
+        if (prefix.size() > 64 || prefix.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)
+            throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect prefix");
+        dev::h256 first(prefix + std::string(64 - prefix.size(), '0'));
+        dev::h256 last(prefix + std::string(64 - prefix.size(), 'f'));
+        if (!request.params[4].isNull()) {
+            std::string cursor = request.params[4].get_str();
+            if (cursor.size() != 64 || !CheckHex(cursor))
+                throw JSONRPCError(RPC_INVALID_PARAMS, "Invalid cursor");
+            first = std::max(first, dev::h256(cursor));
+        }
+
+        std::map<dev::h256, std::pair<dev::u256, dev::u256>> entries;
+        dev::h256 next;
+        if (first <= last)
+            next = view->state().storagePage(addrAccount, first, last, limit, entries);
+
+        UniValue storageUV(UniValue::VOBJ);
+        for (const auto& j: entries)
+        {
+            UniValue e(UniValue::VOBJ);
+            e.pushKV(dev::toHex(dev::h256(j.second.first)), dev::toHex(dev::h256(j.second.second)));
+            storageUV.pushKV(j.first.hex(), e);
+        }
+
+        UniValue result(UniValue::VOBJ);
+        result.pushKV("storage", storageUV);
+        result.pushKV("cursor", next ? UniValue(next.hex()) : NullUniValue);
+        return result;
+    }
+
     UniValue result(UniValue::VOBJ);
 
-    bool onlyIndex = request.params.size() > 2;
+    bool onlyIndex = !request.params[2].isNull();
     unsigned index = 0;
     if (onlyIndex)
         index = request.params[2].get_int();
 
-    auto storage(globalState->storage(addrAccount));
+    auto storage(view->state().storage(addrAccount));
 
     if (onlyIndex)
     {
@@ -1098,6 +1200,77 @@ static UniValue getstorage(const JSONRPCRequest& request)
     return result;
 }
 
+/** Most slots getstorageslots reads in one call */
+static const size_t MAX_GETSTORAGESLOTS = 10000;
+
+static UniValue getstorageslots(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"getstorageslots",
+                "\nGet the values of some storage slots of a contract, all read from the state of one block.\n",
+                {
+                    {"address", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The contract address"},
+                    {"slots", RPCArg::Type::ARR, RPCArg::Optional::NO, "The slots to read, at most "+std::to_string(MAX_GETSTORAGESLOTS),
+                        {
+                            {"slot", RPCArg::Type::STR_HEX, RPCArg::Optional::OMITTED, "The slot number, up to 64 hex digits"},
+                        },
+                    },
+                    {"blockNum", RPCArg::Type::NUM,  /* default */ "latest", "Number of block to get state from, -1 for the latest."},
+                },
+                RPCResult{
+            "[                                   (array)  the values in the order of the slots\n"
+            "  \"value\",                         (string)  the 32 byte value of the slot in hex, zero when it is not set\n"
+            "  ...\n"
+            "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getstorageslots", "eb23c0b3e6042821da281a2e2364feb22dd543e3 \"[\\\"0\\\",\\\"1\\\"]\"")
+            + HelpExampleRpc("getstorageslots", "\"eb23c0b3e6042821da281a2e2364feb22dd543e3\", [\"0\",\"1\"]")
+                },
+            }.Check(request);
+
+    std::string strAddr = request.params[0].get_str();
+    if(strAddr.size() != 40 || !CheckHex(strAddr))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect address");
+
+    const UniValue& slots = request.params[1].get_array();
+    if (slots.size() > MAX_GETSTORAGESLOTS)
+        throw JSONRPCError(RPC_INVALID_PARAMS, strprintf("At most %u slots can be read at once", MAX_GETSTORAGESLOTS));
+    std::vector<dev::u256> keys;
+    keys.reserve(slots.size());
+    for (size_t i = 0; i < slots.size(); i++) {
+        const std::string& slot = slots[i].get_str();
+        if (slot.empty() || slot.size() > 64 || slot.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)
+            throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect slot " + slot);
+        keys.push_back(dev::u256(dev::h256(std::string(64 - slot.size(), '0') + slot)));
+    }
+
+    QtumStateViewPool::Handle view;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pblockindex = ::ChainActive().Tip();
+        if (!request.params[2].isNull()) {
+            auto blockNum = request.params[2].get_int();
+            if ((blockNum < 0 && blockNum != -1) || blockNum > ::ChainActive().Height())
+                throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
+            if (blockNum != -1)
+                pblockindex = ::ChainActive()[blockNum];
+        }
+        CheckStateAvailable(pblockindex);
+        view = stateViewPool.acquire(uintToh256(pblockindex->hashStateRoot), uintToh256(pblockindex->hashUTXORoot));
+    }
+
+    dev::Address addrAccount(strAddr);
+    if (!view->state().addressInUse(addrAccount))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Address does not exist");
+
+    // each slot is one lookup in the storage trie of the account, its storage is never walked
+    UniValue result(UniValue::VARR);
+    for (const dev::u256& key : keys) {
+        result.push_back(dev::toHex(dev::h256(view->state().storage(addrAccount, key))));
+    }
+    return result;
+}
+
 static UniValue getblockheader(const JSONRPCRequest& request)
 {
             RPCHelpMan{"getblockheader",
@@ -1143,17 +1316,13 @@ static UniValue getblockheader(const JSONRPCRequest& request)
     if (!request.params[1].isNull())
         fVerbose = request.params[1].get_bool();
 
-    const CBlockIndex* pblockindex;
-    const CBlockIndex* tip;
-    {
-        LOCK(cs_main);
-        pblockindex = LookupBlockIndex(hash);
-        tip = ::ChainActive().Tip();
-    }
+    const CBlockIndex* tip = GetChainTipSnapshot()->tip;
+    const CBlockIndex* pblockindex = LookupBlockIndexShared(hash);
 
     if (!pblockindex) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
     }
+    request.SetResultCacheable(pblockindex->GetBlockHash(), pblockindex->nHeight);
 
     if (!fVerbose)
     {
@@ -1204,10 +1373,11 @@ static UniValue getblock(const JSONRPCRequest& request)
     RPCHelpMan{"getblock",
                 "\nIf verbosity is 0, returns a string that is serialized, hex-encoded data for block 'hash'.\n"
                 "If verbosity is 1, returns an Object with information about block <hash>.\n"
-                "If verbosity is 2, returns an Object with information about block <hash> and information about each transaction. \n",
+                "If verbosity is 2, returns an Object with information about block <hash> and information about each transaction. \n"
+                "If verbosity is 3, the contract transactions also carry their receipts and the value transfer transactions they produced, requires -logevents.\n",
                 {
                     {"blockhash", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The block hash"},
-                    {"verbosity", RPCArg::Type::NUM, /* default */ "1", "0 for hex-encoded data, 1 for a json object, and 2 for json object with transaction data"},
+                    {"verbosity", RPCArg::Type::NUM, /* default */ "1", "0 for hex-encoded data, 1 for a json object, 2 for json object with transaction data, and 3 for transaction data with the contract receipts"},
                 },
                 {
                     RPCResult{"for verbosity = 0",
@@ -1246,6 +1416,21 @@ static UniValue getblock(const JSONRPCRequest& request)
             "         ,...\n"
             "  ],\n"
             "  ,...                     Same output as verbosity = 1.\n"
+            "}\n"
+                    },
+                    RPCResult{"for verbosity = 3",
+            "{\n"
+            "  ...,                     Same output as verbosity = 2.\n"
+            "  \"tx\" : [               (array of Objects) The transactions as for verbosity = 2, contract transactions add:\n"
+            "    {\n"
+            "      ...,\n"
+            "      \"receipt\" : [...],   (array) The receipts in the format of the gettransactionreceipt RPC\n"
+            "      \"valueTransfers\" : [ (array) The ids of the condensing transactions that paid out its value transfers\n"
+            "        \"transactionid\"\n"
+            "      ]\n"
+            "    }\n"
+            "  ],\n"
+            "  ,...                     Same output as verbosity = 1.\n"
             "}\n"
                     },
                 },
@@ -1279,6 +1464,7 @@ static UniValue getblock(const JSONRPCRequest& request)
 
         block = GetBlockChecked(pblockindex);
     }
+    request.SetResultCacheable(pblockindex->GetBlockHash(), pblockindex->nHeight);
 
     if (verbosity <= 0)
     {
@@ -1288,10 +1474,107 @@ static UniValue getblock(const JSONRPCRequest& request)
         return strHex;
     }
 
-    return blockToJSON(block, tip, pblockindex, verbosity >= 2);
+    if (verbosity == 1) {
+        return blockToJSON(block, tip, pblockindex, false);
+    }
+
+    // the receipts of all contract transactions are read at once, outside of cs_main
+    std::vector<TransactionReceiptsRef> receipts;
+    if (verbosity >= 3) {
+        if (!fLogEvents)
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Events indexing disabled");
+        std::vector<dev::h256> hashes;
+        for (const auto& tx : block.vtx) {
+            if (tx->HasCreateOrCall())
+                hashes.push_back(uintToh256(tx->GetHash()));
+        }
+        receipts = pstorageresult->getResults(hashes);
+    }
+
+    // the transaction details are the bulk of the result, they are written out one at a time
+    const UniValue header = blockToJSON(block, tip, pblockindex, false);
+    RPCResultStream result(request);
+    result.beginObject();
+    for (size_t i = 0; i < header.size() && result.good(); i++) {
+        const std::string& key = header.getKeys()[i];
+        if (key != "tx") {
+            result.pushKV(key, header.getValues()[i]);
+            continue;
+        }
+        result.key(key);
+        result.beginArray();
+        size_t nReceipts = 0;
+        for (size_t nTx = 0; nTx < block.vtx.size(); nTx++) {
+            const CTransaction& tx = *block.vtx[nTx];
+            UniValue objTx(UniValue::VOBJ);
+            TxToUniv(tx, uint256(), objTx, true, RPCSerializationFlags());
+            if (verbosity >= 3 && tx.HasCreateOrCall()) {
+                UniValue receipt(UniValue::VARR);
+                for (const TransactionReceiptInfo& t : *receipts[nReceipts++]) {
+                    // a transaction of a block that was reorganized away may have been mined again in another one
+                    if (t.blockHash != hash)
+                        continue;
+                    UniValue tri(UniValue::VOBJ);
+                    transactionReceiptInfoToJSON(t, tri);
+                    receipt.push_back(tri);
+                }
+                objTx.pushKV("receipt", receipt);
+                // the condensing transaction of a contract transaction directly follows it
+                UniValue transfers(UniValue::VARR);
+                for (size_t next = nTx + 1; next < block.vtx.size() && block.vtx[next]->HasOpSpend(); next++) {
+                    transfers.push_back(block.vtx[next]->GetHash().GetHex());
+                }
+                objTx.pushKV("valueTransfers", transfers);
+            }
+            result.value(objTx);
+            if (!result.good()) break;
+        }
+        result.endArray();
+    }
+    result.endObject();
+    return result.Finish();
 }
 
 ////////////////////////////////////////////////////////////////////// // qtum
+static dev::Address ParseContractSender(const std::string& strSender)
+{
+    CTxDestination qtumSenderAddress = DecodeDestination(strSender);
+    if (IsValidDestination(qtumSenderAddress)) {
+        const PKHash *keyid = boost::get<PKHash>(&qtumSenderAddress);
+        return dev::Address(HexStr(valtype(keyid->begin(),keyid->end())));
+    }
+    return dev::Address(strSender);
+}
+
+/** Resolve the block of a read-only call and open a state view on it. Only this part runs under cs_main,
+ *  the calls themselves execute on the view so they do not block block validation or each other. */
+static QtumStateViewPool::Handle PinCallStateView(const UniValue& blockNumParam, CBlockIndex*& pblockindex, uint64_t& blockGasLimit)
+{
+    LOCK(cs_main);
+    int blockNum;
+    if (!blockNumParam.isNull()) {
+        if (blockNumParam.isNum()) {
+            blockNum = blockNumParam.get_int();
+            if (blockNum < 0 || blockNum > ::ChainActive().Height())
+                throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
+        } else {
+            throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
+        }
+    } else {
+        blockNum = latestblock.height;
+    }
+    pblockindex = ::ChainActive()[blockNum];
+
+    QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
+    blockGasLimit = qtumDGP.getBlockGasLimit(pblockindex->nHeight + 1);
+    dev::eth::EVMSchedule schedule = qtumDGP.getGasSchedule(pblockindex->nHeight + 1);
+
+    CheckStateAvailable(pblockindex);
+    QtumStateViewPool::Handle view = stateViewPool.acquire(uintToh256(pblockindex->hashStateRoot), uintToh256(pblockindex->hashUTXORoot));
+    view->sealEngine().setQtumSchedule(schedule);
+    return view;
+}
+
 UniValue callcontract(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 2 || request.params.size() > 5)
@@ -1342,8 +1625,6 @@ UniValue callcontract(const JSONRPCRequest& request)
             }
                 .ToString());
 
-    LOCK(cs_main);
-    
     std::string strAddr = request.params[0].get_str();
     std::string data = request.params[1].get_str();
 
@@ -1355,42 +1636,25 @@ UniValue callcontract(const JSONRPCRequest& request)
     
     dev::Address senderAddress;
     if(request.params.size() >= 3){
-        CTxDestination qtumSenderAddress = DecodeDestination(request.params[2].get_str());
-        if (IsValidDestination(qtumSenderAddress)) {
-            const PKHash *keyid = boost::get<PKHash>(&qtumSenderAddress);
-            senderAddress = dev::Address(HexStr(valtype(keyid->begin(),keyid->end())));
-        }else{
-            senderAddress = dev::Address(request.params[2].get_str());
-        }
-
+        senderAddress = ParseContractSender(request.params[2].get_str());
     }
     uint64_t gasLimit=0;
     if(request.params.size() >= 4){
         gasLimit = request.params[3].get_int64();
     }
 
-    TemporaryState ts(globalState);
-    int blockNum;
-    if (request.params.size() >= 5) {
-        if (request.params[4].isNum()) {
-            blockNum = request.params[4].get_int();
-            if (blockNum < 0 || blockNum > ::ChainActive().Height())
-                throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
-            ts.SetRoot(uintToh256(::ChainActive()[blockNum]->hashStateRoot), uintToh256(::ChainActive()[blockNum]->hashUTXORoot));
-        } else {
-            throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
-        }
-    } else {
-        blockNum = latestblock.height;
-    }
+    CBlockIndex* pblockindex = nullptr;
+    uint64_t blockGasLimit = 0;
+    QtumStateViewPool::Handle view = PinCallStateView(request.params.size() >= 5 ? request.params[4] : NullUniValue, pblockindex, blockGasLimit);
 
     dev::Address addrAccount(strAddr);
-    if (!globalState->addressInUse(addrAccount))
+    if (!view->state().addressInUse(addrAccount))
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Address does not exist");
 
-    std::vector<ResultExecute> execResults = CallContract(addrAccount, ParseHex(data), blockNum, senderAddress, gasLimit);
+    std::vector<ResultExecute> execResults = CallContract(*view, addrAccount, ParseHex(data), pblockindex, senderAddress, gasLimit, blockGasLimit);
 
     if(fRecordLogOpcodes){
+        LOCK(cs_main);
         writeVMlog(execResults);
     }
 
@@ -1402,6 +1666,189 @@ UniValue callcontract(const JSONRPCRequest& request)
     return result;
 }
 
+UniValue callcontractbatch(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            RPCHelpMan{
+                "callcontractbatch",
+                "\nCall several contract methods offline against the state of one block.\n",
+                {
+                    {"calls", RPCArg::Type::ARR, RPCArg::Optional::NO, "The contract calls",
+                        {
+                            {"", RPCArg::Type::OBJ, RPCArg::Optional::OMITTED, "",
+                                {
+                                    {"address", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The contract address"},
+                                    {"data", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The data hex string"},
+                                    {"senderAddress", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "The sender address string"},
+                                    {"gasLimit", RPCArg::Type::NUM, RPCArg::Optional::OMITTED, "The gas limit for executing the contract."},
+                                },
+                            },
+                        },
+                    },
+                    {"blockNum", RPCArg::Type::NUM, /* default */ "latest", "Number of block to get state from."},
+                },
+                RPCResult{
+                    "[                                          (array)  one entry per call, in request order\n"
+                    "  {\n"
+                    "    \"address\": \"contract address\",           (string)  address of the contract\n"
+                    "    \"executionResult\": {...},                 (object)  method execution result, as in callcontract\n"
+                    "    \"transactionReceipt\": {...},              (object)  transaction receipt, as in callcontract\n"
+                    "    \"error\": \"message\"                       (string, optional) set instead of the results if the call could not be made\n"
+                    "  }\n"
+                    "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("callcontractbatch", "\"[{\\\"address\\\":\\\"eb23c0b3e6042821da281a2e2364feb22dd543e3\\\",\\\"data\\\":\\\"06fdde03\\\"}]\"")
+                     + HelpExampleRpc("callcontractbatch", "[{\"address\":\"eb23c0b3e6042821da281a2e2364feb22dd543e3\",\"data\":\"06fdde03\"}]")},
+            }
+                .ToString());
+
+    const UniValue& calls = request.params[0].get_array();
+
+    std::vector<ContractCallParams> callParams;
+    for (size_t i = 0; i < calls.size(); i++) {
+        const UniValue& call = calls[i].get_obj();
+        RPCTypeCheckObj(call,
+            {
+                {"address", UniValueType(UniValue::VSTR)},
+                {"data", UniValueType(UniValue::VSTR)},
+                {"senderAddress", UniValueType(UniValue::VSTR)},
+                {"gasLimit", UniValueType(UniValue::VNUM)},
+            }, true, true);
+
+        std::string strAddr = find_value(call, "address").get_str();
+        std::string data = find_value(call, "data").get_str();
+        if(data.size() % 2 != 0 || !CheckHex(data))
+            throw JSONRPCError(RPC_TYPE_ERROR, strprintf("Invalid data (data not hex) in call %u", i));
+        if(strAddr.size() != 40 || !CheckHex(strAddr))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, strprintf("Incorrect address in call %u", i));
+
+        ContractCallParams params{dev::Address(strAddr), ParseHex(data), dev::Address(), 0, 0};
+        if (!find_value(call, "senderAddress").isNull())
+            params.sender = ParseContractSender(find_value(call, "senderAddress").get_str());
+        if (!find_value(call, "gasLimit").isNull())
+            params.gasLimit = find_value(call, "gasLimit").get_int64();
+        callParams.push_back(params);
+    }
+
+    CBlockIndex* pblockindex = nullptr;
+    uint64_t blockGasLimit = 0;
+    QtumStateViewPool::Handle view = PinCallStateView(request.params.size() >= 2 ? request.params[1] : NullUniValue, pblockindex, blockGasLimit);
+
+    // Calls to addresses without an account are reported individually and not executed
+    std::vector<ContractCallParams> executable;
+    std::vector<bool> inUse(callParams.size());
+    for (size_t i = 0; i < callParams.size(); i++) {
+        inUse[i] = view->state().addressInUse(callParams[i].contract);
+        if (inUse[i])
+            executable.push_back(callParams[i]);
+    }
+
+    std::vector<ResultExecute> execResults = CallContracts(*view, executable, pblockindex, blockGasLimit);
+
+    if(fRecordLogOpcodes && !execResults.empty()){
+        LOCK(cs_main);
+        writeVMlog(execResults);
+    }
+
+    UniValue result(UniValue::VARR);
+    size_t nExec = 0;
+    for (size_t i = 0; i < callParams.size(); i++) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("address", callParams[i].contract.hex());
+        if (!inUse[i]) {
+            entry.pushKV("error", "Address does not exist");
+        } else {
+            entry.pushKV("executionResult", executionResultToJSON(execResults[nExec].execRes));
+            entry.pushKV("transactionReceipt", transactionReceiptToJSON(execResults[nExec].txRec));
+            nExec++;
+        }
+        result.push_back(entry);
+    }
+    return result;
+}
+
+UniValue estimategas(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 2 || request.params.size() > 6)
+        throw std::runtime_error(
+            RPCHelpMan{
+                "estimategas",
+                "\nEstimate the smallest gas limit a contract call or creation succeeds with, by executing it offline.\n"
+                "The estimate is within 1/" + i64tostr(GAS_ESTIMATE_PRECISION) + " above the smallest limit on the state of the block.\n",
+                {
+                    {"address", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The contract address, empty to create a contract with data as its bytecode"},
+                    {"data", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The data hex string"},
+                    {"senderAddress", RPCArg::Type::STR, RPCArg::Optional::OMITTED_NAMED_ARG, "The sender address string"},
+                    {"amount", RPCArg::Type::AMOUNT, /* default */ "0", "The amount in " + CURRENCY_UNIT + " sent to the contract"},
+                    {"gasLimit", RPCArg::Type::NUM, /* default */ "block gas limit", "The most gas the execution may use"},
+                    {"blockNum", RPCArg::Type::NUM, /* default */ "latest", "Number of block to get state from."},
+                },
+                RPCResult{
+                    "{\n"
+                    "  \"gasLimit\": n,                             (numeric) gas limit the execution succeeds with\n"
+                    "  \"gasUsed\": n,                              (numeric) gas used with that limit\n"
+                    "  \"newAddress\": \"contract address\"          (string)  address of the created contract, for a creation\n"
+                    "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("estimategas", "eb23c0b3e6042821da281a2e2364feb22dd543e3 06fdde03")
+                     + HelpExampleRpc("estimategas", "eb23c0b3e6042821da281a2e2364feb22dd543e3 06fdde03")},
+            }
+                .ToString());
+
+    std::string strAddr = request.params[0].get_str();
+    std::string data = request.params[1].get_str();
+
+    if(data.size() % 2 != 0 || !CheckHex(data))
+        throw JSONRPCError(RPC_TYPE_ERROR, "Invalid data (data not hex)");
+
+    if(!strAddr.empty() && (strAddr.size() != 40 || !CheckHex(strAddr)))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect address");
+
+    ContractCallParams call{strAddr.empty() ? dev::Address() : dev::Address(strAddr), ParseHex(data), dev::Address(), 0, 0};
+    if(request.params.size() >= 3 && !request.params[2].isNull()){
+        call.sender = ParseContractSender(request.params[2].get_str());
+    }
+    if(request.params.size() >= 4 && !request.params[3].isNull()){
+        call.value = AmountFromValue(request.params[3]);
+        if(call.value > 0 && strAddr.empty())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "A contract creation cannot send an amount");
+    }
+    if(request.params.size() >= 5 && !request.params[4].isNull()){
+        int64_t gasLimit = request.params[4].get_int64();
+        if(gasLimit < (int64_t)MINIMUM_GAS_LIMIT)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid value for gasLimit (Minimum is: "+i64tostr(MINIMUM_GAS_LIMIT)+")");
+        call.gasLimit = gasLimit;
+    }
+
+    CBlockIndex* pblockindex = nullptr;
+    uint64_t blockGasLimit = 0;
+    QtumStateViewPool::Handle view = PinCallStateView(request.params.size() >= 6 ? request.params[5] : NullUniValue, pblockindex, blockGasLimit);
+
+    if (!strAddr.empty() && !view->state().addressInUse(call.contract))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Address does not exist");
+    if (call.gasLimit >= blockGasLimit)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid value for gasLimit (Maximum is: "+i64tostr(blockGasLimit - 1)+")");
+
+    uint64_t gasLimit = 0;
+    ResultExecute result;
+    if (!EstimateContractGas(*view, call, pblockindex, blockGasLimit, gasLimit, result)) {
+        std::stringstream ss;
+        ss << result.execRes.excepted;
+        std::string message = exceptedMessage(result.execRes.excepted, result.execRes.output);
+        throw JSONRPCError(RPC_MISC_ERROR, "Execution fails with the most gas it may use: " + ss.str() + (message.empty() ? "" : ", " + message));
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("gasLimit", gasLimit);
+    obj.pushKV("gasUsed", CAmount(result.execRes.gasUsed));
+    if (strAddr.empty())
+        obj.pushKV("newAddress", result.execRes.newAddress.hex());
+    return obj;
+}
+
 void assignJSON(UniValue& entry, const TransactionReceiptInfo& resExec) {
     entry.pushKV("blockHash", resExec.blockHash.GetHex());
     entry.pushKV("blockNumber", uint64_t(resExec.blockNumber));
@@ -1461,6 +1908,11 @@ void transactionReceiptInfoToJSON(const TransactionReceiptInfo& resExec, UniValu
     entry.pushKV("log", logEntries);
 }
 
+void logEntryToJSON(const TransactionReceiptInfo& resExec, const dev::eth::LogEntry& log, UniValue& entry) {
+    assignJSON(entry, resExec);
+    assignJSON(entry, log, false);
+}
+
 size_t parseUInt(const UniValue& val, size_t defaultVal) {
     if (val.isNull()) {
         return defaultVal;
@@ -1579,22 +2031,117 @@ void parseParam(const UniValue& val, std::vector<boost::optional<dev::h256>> &h2
     });
 }
 
-class WaitForLogsParams {
-public:
-    int fromBlock;
-    int toBlock;
-
-    int minconf;
+/**
+ * Transactions the log index lists for the non-null filter topics, by block height. With matchAll
+ * a transaction must carry every filter topic (waitforlogs), otherwise any of them (searchlogs).
+ */
+static void CollectTopicCandidates(const std::vector<boost::optional<dev::h256>>& topics, bool matchAll,
+        int fromBlock, int toBlock, std::map<int, std::set<uint256>>& candidates)
+{
+    bool first = true;
+    for (size_t i = 0; i < topics.size() && i <= std::numeric_limits<uint8_t>::max(); i++) {
+        if (!topics[i]) {
+            continue;
+        }
+        std::map<int, std::set<uint256>> found;
+        g_logindex->FindTopicTransactions(h256Touint(topics[i].get()), (uint8_t)i, fromBlock, toBlock, found);
+        if (first || !matchAll) {
+            for (auto& entry : found) {
+                candidates[entry.first].insert(entry.second.begin(), entry.second.end());
+            }
+        } else {
+            for (auto it = candidates.begin(); it != candidates.end(); ) {
+                auto match = found.find(it->first);
+                std::set<uint256> kept;
+                if (match != found.end()) {
+                    std::set_intersection(it->second.begin(), it->second.end(), match->second.begin(), match->second.end(), std::inserter(kept, kept.end()));
+                }
+                if (kept.empty()) {
+                    it = candidates.erase(it);
+                } else {
+                    it->second.swap(kept);
+                    ++it;
+                }
+            }
+        }
+        first = false;
+    }
+}
 
-    std::set<dev::h160> addresses;
-    std::vector<boost::optional<dev::h256>> topics;
+static bool HasTopicFilter(const std::vector<boost::optional<dev::h256>>& topics)
+{
+    return std::any_of(topics.begin(), topics.end(), [](const boost::optional<dev::h256>& topic) { return bool(topic); });
+}
 
-    // bool wait;
+/**
+ * Height index scan for searchlogs. Heights covered by the log index only read the entries of
+ * blocks holding a filter topic and only keep the transactions carrying one, the rest of the
+ * range is scanned in full. Returns the same error value as ReadHeightIndex.
+ */
+static int ReadTopicFilteredHeightIndex(int fromBlock, int toBlock, int minconf, const std::set<dev::h160>& addresses,
+        const std::vector<boost::optional<dev::h256>>& topics, std::vector<std::vector<uint256>>& hashesToBlock) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    int indexedHeight = g_logindex ? g_logindex->IndexedHeight() : -1;
+    if (!HasTopicFilter(topics) || indexedHeight < fromBlock) {
+        return pblocktree->ReadHeightIndex(fromBlock, toBlock, minconf, hashesToBlock, addresses);
+    }
+    // same parameter checks as ReadHeightIndex
+    if ((toBlock < fromBlock && toBlock > -1) || (toBlock == 0 && fromBlock == 0) || (toBlock < -1 || fromBlock < 0)) {
+        return -1;
+    }
 
-    WaitForLogsParams(const UniValue& params) {
-        std::unique_lock<std::mutex> lock(cs_blockchange);
+    int indexedTo = (toBlock > -1 && toBlock < indexedHeight) ? toBlock : indexedHeight;
+    std::map<int, std::set<uint256>> candidates;
+    CollectTopicCandidates(topics, false, fromBlock, indexedTo, candidates);
 
-        fromBlock = parseBlockHeight(params[0], latestblock.height + 1);
+    int curheight = 0;
+    for (const auto& candidate : candidates) {
+        if (candidate.first == 0) {
+            continue;
+        }
+        std::vector<std::vector<uint256>> blockHashes;
+        int height = pblocktree->ReadHeightIndex(candidate.first, candidate.first, minconf, blockHashes, addresses);
+        if (height <= 0) {
+            continue;
+        }
+        curheight = height;
+        for (const auto& hashes : blockHashes) {
+            std::vector<uint256> matching;
+            std::copy_if(hashes.begin(), hashes.end(), std::back_inserter(matching), [&](const uint256& hash) { return candidate.second.count(hash) != 0; });
+            if (!matching.empty()) {
+                hashesToBlock.push_back(matching);
+            }
+        }
+    }
+    if (toBlock == -1 || toBlock > indexedTo) {
+        int height = pblocktree->ReadHeightIndex(indexedTo + 1, toBlock, minconf, hashesToBlock, addresses);
+        if (height > 0) {
+            curheight = height;
+        }
+    }
+    return curheight;
+}
+
+class WaitForLogsParams {
+public:
+    int fromBlock;
+    int toBlock;
+
+    int minconf;
+
+    std::set<dev::h160> addresses;
+    std::vector<boost::optional<dev::h256>> topics;
+
+    // bool wait;
+
+    bool operator<(const WaitForLogsParams& other) const {
+        return std::tie(fromBlock, toBlock, minconf, addresses, topics) < std::tie(other.fromBlock, other.toBlock, other.minconf, other.addresses, other.topics);
+    }
+
+    WaitForLogsParams(const UniValue& params) {
+        std::unique_lock<std::mutex> lock(cs_blockchange);
+
+        fromBlock = parseBlockHeight(params[0], latestblock.height + 1);
         toBlock = parseBlockHeight(params[1], -1);
 
         parseFilter(params[2]);
@@ -1612,54 +2159,12 @@ private:
     }
 };
 
-UniValue waitforlogs(const JSONRPCRequest& request_) {
-    // this is a long poll function. force cast to non const pointer
-    JSONRPCRequest& request = (JSONRPCRequest&) request_;
-
-            RPCHelpMan{"waitforlogs",
-                "requires -logevents to be enabled\n"
-                "\nWaits for a new logs and return matching log entries. When the call returns, it also specifies the next block number to start waiting for new logs.\n"
-                "By calling waitforlogs repeatedly using the returned `nextBlock` number, a client can receive a stream of up-to-date log entires.\n"
-                "\nThis call is different from the similarly named `searchlogs`. This call returns individual matching log entries, `searchlogs` returns a transaction receipt if one of the log entries of that transaction matches the filter conditions.\n",
-                {
-                    {"fromBlock", RPCArg::Type::NUM, /* default */ "null", "The block number to start looking for logs."},
-                    {"toBlock", RPCArg::Type::NUM, /* default */ "null", "The block number to stop looking for logs. If null, will wait indefinitely into the future."},
-                    {"filter", RPCArg::Type::STR, /* default */ "{}", "\"{ addresses?: Hex160String[], topics?: Hex256String[] }\", Filter conditions for logs."},
-                    {"minconf", RPCArg::Type::NUM, /* default */ "6", "Minimal number of confirmations before a log is returned"},
-                },
-                RPCResult{
-                "An object with the following properties:\n"
-                "1. logs (LogEntry[]) Array of matchiing log entries. This may be empty if `filter` removed all entries."
-                "2. count (int) How many log entries are returned."
-                "3. nextBlock (int) To wait for new log entries haven't seen before, use this number as `fromBlock`"
-                "\nUsage:\n"
-                "`waitforlogs` waits for new logs, starting from the tip of the chain.\n"
-                "`waitforlogs 600` waits for new logs, but starting from block 600. If there are logs available, this call will return immediately.\n"
-                "`waitforlogs 600 700` waits for new logs, but only up to 700th block\n"
-                "`waitforlogs null null` this is equivalent to `waitforlogs`, using default parameter values\n"
-                "`waitforlogs null null` { \"addresses\": [ \"ff0011...\" ], \"topics\": [ \"c0fefe\"] }` waits for logs in the future matching the specified conditions\n"
-                "\nSample Output:\n"
-                "{\n  \"entries\": [\n    {\n      \"blockHash\": \"56d5f1f5ec239ef9c822d9ed600fe9aa63727071770ac7c0eabfc903bf7316d4\",\n      \"blockNumber\": 3286,\n      \"transactionHash\": \"00aa0f041ce333bc3a855b2cba03c41427cda04f0334d7f6cb0acad62f338ddc\",\n      \"transactionIndex\": 2,\n      \"from\": \"3f6866e2b59121ada1ddfc8edc84a92d9655675f\",\n      \"to\": \"8e1ee0b38b719abe8fa984c986eabb5bb5071b6b\",\n      \"cumulativeGasUsed\": 23709,\n      \"gasUsed\": 23709,\n      \"contractAddress\": \"8e1ee0b38b719abe8fa984c986eabb5bb5071b6b\",\n      \"topics\": [\n        \"f0e1159fa6dc12bb31e0098b7a1270c2bd50e760522991c6f0119160028d9916\",\n        \"0000000000000000000000000000000000000000000000000000000000000002\"\n      ],\n      \"data\": \"00000000000000000000000000000000000000000000000000000000000000010000000000000000000000000000000000000000000000000000000000000003\"\n    }\n  ],\n\n  \"count\": 7,\n  \"nextblock\": 801\n}\n"
-                },
-                RPCExamples{
-                    HelpExampleCli("waitforlogs", "") + HelpExampleCli("waitforlogs", "600") + HelpExampleCli("waitforlogs", "600 700") + HelpExampleCli("waitforlogs", "null null")
-                    + HelpExampleCli("waitforlogs", "null null '{ \"addresses\": [ \"12ae42729af478ca92c8c66773a3e32115717be4\" ], \"topics\": [ \"b436c2bf863ccd7b8f63171201efd4792066b4ce8e543dde9c3e9e9ab98e216c\"] }'")
-            + HelpExampleRpc("waitforlogs", "") + HelpExampleRpc("waitforlogs", "600") + HelpExampleRpc("waitforlogs", "600 700") + HelpExampleRpc("waitforlogs", "null null")
-            + HelpExampleRpc("waitforlogs", "null null '{ \"addresses\": [ \"12ae42729af478ca92c8c66773a3e32115717be4\" ], \"topics\": [ \"b436c2bf863ccd7b8f63171201efd4792066b4ce8e543dde9c3e9e9ab98e216c\"] }'")
-
-                },
-            }.Check(request);
-
-    if (!fLogEvents)
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Events indexing disabled");
-
-    if(!request.req)
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "HTTP connection not available");
-
-    WaitForLogsParams params(request.params);
-
-    request.PollStart();
-
+/**
+ * Run a waitforlogs filter against the chain. Returns null while the height index has no entry
+ * for the requested range yet, otherwise the matching log entries and the next block to wait for.
+ */
+static UniValue MatchWaitForLogs(const WaitForLogsParams& params)
+{
     std::vector<std::vector<uint256>> hashesToBlock;
 
     int curheight = 0;
@@ -1667,49 +2172,31 @@ UniValue waitforlogs(const JSONRPCRequest& request_) {
     auto& addresses = params.addresses;
     auto& filterTopics = params.topics;
 
-    while (curheight == 0) {
-        {
-            LOCK(cs_main);
-            curheight = pblocktree->ReadHeightIndex(params.fromBlock, params.toBlock, params.minconf,
-                    hashesToBlock, addresses);
-        }
-
-        // if curheight >= fromBlock. Blockchain extended with new log entries. Return next block height to client.
-        //    nextBlock = curheight + 1
-        // if curheight == 0. No log entry found in index. Wait for new block then try again.
-        //    nextBlock = fromBlock
-        // if curheight == -1. Incorrect parameters has entered.
-        //
-        // if curheight advanced, but all filtered out, API should return empty array, but advancing the cursor anyway.
-
-        if (curheight > 0) {
-            break;
-        }
-
-        if (curheight == -1) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, "Incorrect params");
-        }
+    {
+        LOCK(cs_main);
+        curheight = pblocktree->ReadHeightIndex(params.fromBlock, params.toBlock, params.minconf,
+                hashesToBlock, addresses);
+    }
 
-        // wait for a new block to arrive
-        {
-            while (true) {
-                std::unique_lock<std::mutex> lock(cs_blockchange);
-                auto blockHeight = latestblock.height;
+    // if curheight >= fromBlock. Blockchain extended with new log entries. Return next block height to client.
+    //    nextBlock = curheight + 1
+    // if curheight == 0. No log entry found in index. Wait for new block then try again.
+    //    nextBlock = fromBlock
+    // if curheight == -1. Incorrect parameters has entered.
+    //
+    // if curheight advanced, but all filtered out, API should return empty array, but advancing the cursor anyway.
 
-                request.PollPing();
+    if (curheight == -1) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Incorrect params");
+    }
 
-                cond_blockchange.wait_for(lock, std::chrono::milliseconds(1000));
-                if (latestblock.height > blockHeight) {
-                    break;
-                }
+    if (curheight == 0) {
+        return NullUniValue;
+    }
 
-                // TODO: maybe just merge `IsRPCRunning` this into PollAlive
-                if (!request.PollAlive() || !IsRPCRunning()) {
-                    LogPrintf("waitforlogs client disconnected\n");
-                    return NullUniValue;
-                }
-            }
-        }
+    // the log index narrows the receipts to read when it covers everything the scan returned
+    if (g_logindex && HasTopicFilter(filterTopics)) {
+        g_logindex->BlockUntilSyncedToCurrentChain();
     }
 
     LOCK(cs_main);
@@ -1718,6 +2205,18 @@ UniValue waitforlogs(const JSONRPCRequest& request_) {
 
     std::set<uint256> dupes;
 
+    if (g_logindex && HasTopicFilter(filterTopics) && g_logindex->IndexedHeight() >= curheight) {
+        std::map<int, std::set<uint256>> candidates;
+        CollectTopicCandidates(filterTopics, true, params.fromBlock, curheight, candidates);
+        std::set<uint256> matching;
+        for (const auto& candidate : candidates) {
+            matching.insert(candidate.second.begin(), candidate.second.end());
+        }
+        for (auto& txHashes : hashesToBlock) {
+            txHashes.erase(std::remove_if(txHashes.begin(), txHashes.end(), [&](const uint256& hash) { return matching.count(hash) == 0; }), txHashes.end());
+        }
+    }
+
     for (const auto& txHashes : hashesToBlock) {
         for (const auto& txHash : txHashes) {
 
@@ -1726,10 +2225,10 @@ UniValue waitforlogs(const JSONRPCRequest& request_) {
             }
             dupes.insert(txHash);
 
-            std::vector<TransactionReceiptInfo> receipts = pstorageresult->getResult(
+            TransactionReceiptsRef receipts = pstorageresult->getResult(
                     uintToh256(txHash));
 
-            for (const auto& receipt : receipts) {
+            for (const auto& receipt : *receipts) {
                 for (const auto& log : receipt.logs) {
 
                     bool includeLog = true;
@@ -1759,8 +2258,7 @@ UniValue waitforlogs(const JSONRPCRequest& request_) {
 
                     UniValue jsonLog(UniValue::VOBJ);
 
-                    assignJSON(jsonLog, receipt);
-                    assignJSON(jsonLog, log, false);
+                    logEntryToJSON(receipt, log, jsonLog);
 
                     jsonLogs.push_back(jsonLog);
                 }
@@ -1776,6 +2274,311 @@ UniValue waitforlogs(const JSONRPCRequest& request_) {
     return result;
 }
 
+/**
+ * waitforlogs calls that found nothing yet. They are parked here rather than on an HTTP worker,
+ * re-matched when the tip changes, and subscribers with identical parameters share one match.
+ * Connections are pinged every second, like the polling loop did, to notice closed clients.
+ */
+class LogSubscriptions
+{
+public:
+    void Add(const WaitForLogsParams& params, const UniValue& id, std::unique_ptr<HTTPRequest> req);
+
+    /** Wake up the subscriptions after a tip change */
+    void Notify();
+
+    /** Cancel every subscription and join the thread, called when RPC stops */
+    void Stop();
+
+private:
+    struct Subscription {
+        UniValue id;
+        std::unique_ptr<HTTPRequest> req;
+    };
+
+    void ThreadRun();
+
+    /** Answer a parked call on a worker thread, a null result just closes it */
+    static void Reply(std::unique_ptr<HTTPRequest> req, const UniValue& id, const UniValue& result);
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::map<WaitForLogsParams, std::vector<Subscription>> m_subscriptions;
+    bool m_dirty = false;
+    bool m_running = false;
+    bool m_stopped = false;
+    std::thread m_thread;
+};
+
+static LogSubscriptions g_logSubscriptions;
+
+static void NotifyLogSubscriptions()
+{
+    g_logSubscriptions.Notify();
+}
+
+void LogSubscriptions::Add(const WaitForLogsParams& params, const UniValue& id, std::unique_ptr<HTTPRequest> req)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_stopped) {
+            m_subscriptions[params].push_back(Subscription{id, std::move(req)});
+            // match again right away, a block may have arrived since the call looked
+            m_dirty = true;
+            if (!m_running) {
+                m_running = true;
+                m_thread = std::thread(&TraceThread<std::function<void()>>, "waitforlogs", std::function<void()>(std::bind(&LogSubscriptions::ThreadRun, this)));
+                RPCServer::OnStopped([] { g_logSubscriptions.Stop(); });
+            }
+        }
+    }
+    if (req) {
+        Reply(std::move(req), id, NullUniValue);
+        return;
+    }
+    m_cond.notify_one();
+}
+
+void LogSubscriptions::Notify()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_dirty = true;
+    }
+    m_cond.notify_one();
+}
+
+void LogSubscriptions::Stop()
+{
+    std::map<WaitForLogsParams, std::vector<Subscription>> subscriptions;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopped) {
+            return;
+        }
+        m_stopped = true;
+        m_running = false;
+        subscriptions.swap(m_subscriptions);
+    }
+    m_cond.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    for (auto& entry : subscriptions) {
+        for (Subscription& subscription : entry.second) {
+            Reply(std::move(subscription.req), subscription.id, NullUniValue);
+        }
+    }
+}
+
+void LogSubscriptions::Reply(std::unique_ptr<HTTPRequest> req, const UniValue& id, const UniValue& result)
+{
+    auto work = [id, result](HTTPRequest* r) {
+        JSONRPCRequest jreq(r);
+        jreq.id = id;
+        jreq.isLongPolling = true;
+        if (result.isNull()) {
+            jreq.PollCancel();
+        } else {
+            jreq.PollReply(result);
+        }
+    };
+    // the worker threads are gone once RPC stops, and a full queue must not drop the reply
+    if (!IsRPCRunning() || !EnqueueHTTPWork(req, work)) {
+        work(req.get());
+    }
+}
+
+void LogSubscriptions::ThreadRun()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running) {
+        m_cond.wait_for(lock, std::chrono::milliseconds(1000), [this] { return !m_running || m_dirty; });
+        if (!m_running) {
+            break;
+        }
+        bool match = m_dirty;
+        m_dirty = false;
+
+        std::vector<Subscription> closed;
+        std::vector<WaitForLogsParams> filters;
+        for (auto it = m_subscriptions.begin(); it != m_subscriptions.end(); ) {
+            std::vector<Subscription>& group = it->second;
+            for (auto sub = group.begin(); sub != group.end(); ) {
+                if (sub->req->isConnClosed()) {
+                    closed.push_back(std::move(*sub));
+                    sub = group.erase(sub);
+                    continue;
+                }
+                JSONRPCRequest jreq(sub->req.get());
+                jreq.isLongPolling = true;
+                jreq.PollPing();
+                ++sub;
+            }
+            if (group.empty()) {
+                it = m_subscriptions.erase(it);
+                continue;
+            }
+            if (match) {
+                filters.push_back(it->first);
+            }
+            ++it;
+        }
+        lock.unlock();
+
+        for (Subscription& subscription : closed) {
+            LogPrintf("waitforlogs client disconnected\n");
+            Reply(std::move(subscription.req), subscription.id, NullUniValue);
+        }
+
+        std::vector<std::pair<WaitForLogsParams, UniValue>> results;
+        for (const WaitForLogsParams& filter : filters) {
+            try {
+                UniValue result = MatchWaitForLogs(filter);
+                if (!result.isNull()) {
+                    results.emplace_back(filter, result);
+                }
+            } catch (const UniValue& objError) {
+                LogPrintf("waitforlogs subscription failed: %s\n", find_value(objError, "message").get_str());
+                results.emplace_back(filter, NullUniValue);
+            } catch (const std::exception& e) {
+                LogPrintf("waitforlogs subscription failed: %s\n", e.what());
+                results.emplace_back(filter, NullUniValue);
+            }
+        }
+
+        std::vector<std::pair<Subscription, UniValue>> replies;
+        lock.lock();
+        for (auto& result : results) {
+            auto it = m_subscriptions.find(result.first);
+            if (it == m_subscriptions.end()) {
+                continue;
+            }
+            for (Subscription& subscription : it->second) {
+                replies.emplace_back(std::move(subscription), result.second);
+            }
+            m_subscriptions.erase(it);
+        }
+        lock.unlock();
+        for (auto& reply : replies) {
+            Reply(std::move(reply.first.req), reply.first.id, reply.second);
+        }
+        lock.lock();
+    }
+}
+
+UniValue waitforlogs(const JSONRPCRequest& request_) {
+    // this is a long poll function. force cast to non const pointer
+    JSONRPCRequest& request = (JSONRPCRequest&) request_;
+
+            RPCHelpMan{"waitforlogs",
+                "requires -logevents to be enabled\n"
+                "\nWaits for a new logs and return matching log entries. When the call returns, it also specifies the next block number to start waiting for new logs.\n"
+                "By calling waitforlogs repeatedly using the returned `nextBlock` number, a client can receive a stream of up-to-date log entires.\n"
+                "\nThis call is different from the similarly named `searchlogs`. This call returns individual matching log entries, `searchlogs` returns a transaction receipt if one of the log entries of that transaction matches the filter conditions.\n",
+                {
+                    {"fromBlock", RPCArg::Type::NUM, /* default */ "null", "The block number to start looking for logs."},
+                    {"toBlock", RPCArg::Type::NUM, /* default */ "null", "The block number to stop looking for logs. If null, will wait indefinitely into the future."},
+                    {"filter", RPCArg::Type::STR, /* default */ "{}", "\"{ addresses?: Hex160String[], topics?: Hex256String[] }\", Filter conditions for logs."},
+                    {"minconf", RPCArg::Type::NUM, /* default */ "6", "Minimal number of confirmations before a log is returned"},
+                },
+                RPCResult{
+                "An object with the following properties:\n"
+                "1. logs (LogEntry[]) Array of matchiing log entries. This may be empty if `filter` removed all entries."
+                "2. count (int) How many log entries are returned."
+                "3. nextBlock (int) To wait for new log entries haven't seen before, use this number as `fromBlock`"
+                "\nUsage:\n"
+                "`waitforlogs` waits for new logs, starting from the tip of the chain.\n"
+                "`waitforlogs 600` waits for new logs, but starting from block 600. If there are logs available, this call will return immediately.\n"
+                "`waitforlogs 600 700` waits for new logs, but only up to 700th block\n"
+                "`waitforlogs null null` this is equivalent to `waitforlogs`, using default parameter values\n"
+                "`waitforlogs null null` { \"addresses\": [ \"ff0011...\" ], \"topics\": [ \"c0fefe\"] }` waits for logs in the future matching the specified conditions\n"
+                "\nSample Output:\n"
+                "{\n  \"entries\": [\n    {\n      \"blockHash\": \"56d5f1f5ec239ef9c822d9ed600fe9aa63727071770ac7c0eabfc903bf7316d4\",\n      \"blockNumber\": 3286,\n      \"transactionHash\": \"00aa0f041ce333bc3a855b2cba03c41427cda04f0334d7f6cb0acad62f338ddc\",\n      \"transactionIndex\": 2,\n      \"from\": \"3f6866e2b59121ada1ddfc8edc84a92d9655675f\",\n      \"to\": \"8e1ee0b38b719abe8fa984c986eabb5bb5071b6b\",\n      \"cumulativeGasUsed\": 23709,\n      \"gasUsed\": 23709,\n      \"contractAddress\": \"8e1ee0b38b719abe8fa984c986eabb5bb5071b6b\",\n      \"topics\": [\n        \"f0e1159fa6dc12bb31e0098b7a1270c2bd50e760522991c6f0119160028d9916\",\n        \"0000000000000000000000000000000000000000000000000000000000000002\"\n      ],\n      \"data\": \"00000000000000000000000000000000000000000000000000000000000000010000000000000000000000000000000000000000000000000000000000000003\"\n    }\n  ],\n\n  \"count\": 7,\n  \"nextblock\": 801\n}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("waitforlogs", "") + HelpExampleCli("waitforlogs", "600") + HelpExampleCli("waitforlogs", "600 700") + HelpExampleCli("waitforlogs", "null null")
+                    + HelpExampleCli("waitforlogs", "null null '{ \"addresses\": [ \"12ae42729af478ca92c8c66773a3e32115717be4\" ], \"topics\": [ \"b436c2bf863ccd7b8f63171201efd4792066b4ce8e543dde9c3e9e9ab98e216c\"] }'")
+            + HelpExampleRpc("waitforlogs", "") + HelpExampleRpc("waitforlogs", "600") + HelpExampleRpc("waitforlogs", "600 700") + HelpExampleRpc("waitforlogs", "null null")
+            + HelpExampleRpc("waitforlogs", "null null '{ \"addresses\": [ \"12ae42729af478ca92c8c66773a3e32115717be4\" ], \"topics\": [ \"b436c2bf863ccd7b8f63171201efd4792066b4ce8e543dde9c3e9e9ab98e216c\"] }'")
+
+                },
+            }.Check(request);
+
+    if (!fLogEvents)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Events indexing disabled");
+
+    if(!request.req)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "HTTP connection not available");
+
+    WaitForLogsParams params(request.params);
+
+    request.PollStart();
+
+    UniValue result = MatchWaitForLogs(params);
+    if (!result.isNull()) {
+        return result;
+    }
+
+    // nothing yet: park the call so it does not hold a worker thread until a block brings new logs
+    UniValue id = request.id;
+    request.PollDefer([params, id](std::unique_ptr<HTTPRequest> req) {
+        g_logSubscriptions.Add(params, id, std::move(req));
+    });
+    return NullUniValue;
+}
+
+/** Page size of searchlogs when only a cursor is given */
+static const size_t DEFAULT_SEARCHLOGS_PAGE_SIZE = 1000;
+/** Heights read from the height index at a time by searchlogs, bounding the hashes held in memory */
+static const int SEARCHLOGS_SCAN_WINDOW = 1000;
+
+/** Position of a receipt in the chain, a paged searchlogs resumes after it */
+struct SearchLogsCursor {
+    uint32_t height = 0;
+    uint32_t txIndex = 0;
+    uint32_t outputIndex = 0;
+
+    SearchLogsCursor() {}
+    explicit SearchLogsCursor(const TransactionReceiptInfo& receipt) :
+        height(receipt.blockNumber), txIndex(receipt.transactionIndex), outputIndex(receipt.outputIndex) {}
+
+    bool operator<(const SearchLogsCursor& other) const {
+        return std::tie(height, txIndex, outputIndex) < std::tie(other.height, other.txIndex, other.outputIndex);
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(height);
+        READWRITE(txIndex);
+        READWRITE(outputIndex);
+    }
+};
+
+static std::string EncodeSearchLogsCursor(const SearchLogsCursor& cursor)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << cursor;
+    return HexStr(ss.begin(), ss.end());
+}
+
+static bool DecodeSearchLogsCursor(const std::string& str, SearchLogsCursor& cursor)
+{
+    if (!IsHex(str)) {
+        return false;
+    }
+    std::vector<unsigned char> data(ParseHex(str));
+    CDataStream ss(data, SER_NETWORK, PROTOCOL_VERSION);
+    try {
+        ss >> cursor;
+    } catch (const std::exception&) {
+        return false;
+    }
+    return ss.empty();
+}
+
 class SearchLogsParams {
 public:
     size_t fromBlock;
@@ -1785,6 +2588,11 @@ public:
     std::set<dev::h160> addresses;
     std::vector<boost::optional<dev::h256>> topics;
 
+    /** Whether a page was asked for, with its size and the position to resume after */
+    bool paged;
+    size_t limit;
+    boost::optional<SearchLogsCursor> cursor;
+
     SearchLogsParams(const UniValue& params) {
         std::unique_lock<std::mutex> lock(cs_blockchange);
 
@@ -1794,146 +2602,537 @@ public:
         parseParam(params[2]["addresses"], addresses);
         parseParam(params[3]["topics"], topics);
 
-        minconf = parseUInt(params[4], 0);
+        minconf = parseUInt(params[4], 0);
+
+        paged = !params[5].isNull() || !params[6].isNull();
+        limit = parseUInt(params[5], DEFAULT_SEARCHLOGS_PAGE_SIZE);
+        if (paged && limit == 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMS, "limit must be positive");
+        }
+        if (!params[6].isNull()) {
+            SearchLogsCursor after;
+            if (!params[6].isStr() || !DecodeSearchLogsCursor(params[6].get_str(), after)) {
+                throw JSONRPCError(RPC_INVALID_PARAMS, "Invalid cursor");
+            }
+            cursor = after;
+        }
+    }
+
+private:
+    void setFromBlock(const UniValue& val) {
+        if (!val.isNull()) {
+            fromBlock = parseBlockHeight(val);
+        } else {
+            fromBlock = latestblock.height;
+        }
+    }
+
+    void setToBlock(const UniValue& val) {
+        if (!val.isNull()) {
+            toBlock = parseBlockHeight(val);
+        } else {
+            toBlock = latestblock.height;
+        }
+    }
+
+};
+
+/** Whether a receipt has logs and, when topics are given, one of its logs carries one of them at its position */
+static bool SearchLogsMatch(const TransactionReceiptInfo& receipt, const std::vector<boost::optional<dev::h256>>& topics)
+{
+    if (receipt.logs.empty()) {
+        return false;
+    }
+
+    if (topics.empty()) {
+        return true;
+    }
+
+    for (size_t i = 0; i < topics.size(); i++) {
+        const auto& tc = topics[i];
+
+        if (!tc) {
+            continue;
+        }
+
+        for (const auto& log : receipt.logs) {
+            if (i >= log.topics.size()) {
+                continue;
+            }
+
+            if (tc.get() == log.topics[i]) {
+                return true;
+            }
+        }
+    }
+
+    // Skip the log if none of the topics are matched
+    return false;
+}
+
+/**
+ * Visit the receipts matching a searchlogs filter in chain order, after the cursor when one is
+ * given. The height index is read one window at a time and cs_main is only held while reading it,
+ * so neither the hashes nor the lock are held for the whole range. visit returns false to stop.
+ */
+static void ForEachSearchLogsReceipt(const SearchLogsParams& params, const std::function<bool(const TransactionReceiptInfo&)>& visit)
+{
+    int fromBlock = params.fromBlock;
+    int toBlock = params.toBlock;
+    if (params.cursor && (int)params.cursor->height > fromBlock) {
+        fromBlock = params.cursor->height;
+    }
+
+    while (fromBlock <= toBlock) {
+        int windowEnd = std::min(toBlock, fromBlock + SEARCHLOGS_SCAN_WINDOW - 1);
+
+        std::vector<std::vector<uint256>> hashesToBlock;
+        {
+            LOCK(cs_main);
+            // no log entries exist past the tip
+            toBlock = std::min(toBlock, ::ChainActive().Height());
+            windowEnd = std::min(windowEnd, toBlock);
+            if (windowEnd < fromBlock) {
+                break;
+            }
+            ReadTopicFilteredHeightIndex(fromBlock, windowEnd, params.minconf, params.addresses, params.topics, hashesToBlock);
+        }
+
+        std::set<uint256> dupes;
+        std::vector<TransactionReceiptsRef> refs;
+        std::vector<const TransactionReceiptInfo*> matches;
+        for (const auto& hashesTx : hashesToBlock) {
+            for (const auto& e : hashesTx) {
+                if (!dupes.insert(e).second) {
+                    continue;
+                }
+
+                TransactionReceiptsRef receipts = pstorageresult->getResult(uintToh256(e));
+                for (const auto& receipt : *receipts) {
+                    if (!SearchLogsMatch(receipt, params.topics)) {
+                        continue;
+                    }
+                    if (params.cursor && !(*params.cursor < SearchLogsCursor(receipt))) {
+                        continue;
+                    }
+                    matches.push_back(&receipt);
+                }
+                refs.push_back(std::move(receipts));
+            }
+        }
+
+        // the height index orders a block's transactions by contract address
+        std::sort(matches.begin(), matches.end(), [](const TransactionReceiptInfo* a, const TransactionReceiptInfo* b) {
+            return SearchLogsCursor(*a) < SearchLogsCursor(*b);
+        });
+        for (const TransactionReceiptInfo* receipt : matches) {
+            if (!visit(*receipt)) {
+                return;
+            }
+        }
+
+        fromBlock = windowEnd + 1;
+    }
+}
+
+UniValue searchlogs(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"searchlogs",
+                "\nSearch logs, requires -logevents to be enabled.\n",
+                {
+                    {"fromBlock", RPCArg::Type::NUM, RPCArg::Optional::NO, "The number of the earliest block (latest may be given to mean the most recent block)."},
+                    {"toBlock", RPCArg::Type::NUM, RPCArg::Optional::NO, "The number of the latest block (-1 may be given to mean the most recent block)."},
+                    {"address", RPCArg::Type::STR, RPCArg::Optional::OMITTED_NAMED_ARG, "An address or a list of addresses to only get logs from particular account(s)."},
+                    {"topics", RPCArg::Type::STR, RPCArg::Optional::OMITTED_NAMED_ARG, "An array of values from which at least one must appear in the log entries. The order is important, if you want to leave topics out use null, e.g. [\"null\", \"0x00...\"]."},
+                    {"minconf", RPCArg::Type::NUM, /* default */ "0", "Minimal number of confirmations before a log is returned"},
+                    {"limit", RPCArg::Type::NUM, /* default */ "null", "Return at most this many receipts as a page, see below. Defaults to "+std::to_string(DEFAULT_SEARCHLOGS_PAGE_SIZE)+" when only a cursor is given."},
+                    {"cursor", RPCArg::Type::STR, /* default */ "null", "The cursor returned with the previous page, to continue after it."},
+                },
+                RPCResult{
+            "[\n"
+            "  {\n"
+            "    \"blockHash\": \"hash\",             (string)  block hash\n"
+            "    \"blockNumber\": n,                (numeric)  block number\n"
+            "    \"transactionHash\": \"hash\",       (string)  transaction hash\n"
+            "    \"transactionIndex\": n,           (numeric)  transaction index\n"
+            "    \"from\": \"address\",               (string)  from address\n"
+            "    \"to\": \"address\",                 (string)  to address\n"
+            "    \"cumulativeGasUsed\": n,          (numeric)  cumulative gas used\n"
+            "    \"gasUsed\": n,                    (numeric)  gas used\n"
+            "    \"contractAddress\": \"address\",    (string)  contract address\n"
+            "    \"excepted\": \"exception\",         (string)  thrown exception\n"
+            "    \"log\": [                         (array)  logs from the receipt\n"
+            "      {\n"
+            "        \"address\": \"address\",        (string)  contract address\n"
+            "        \"topics\":                    (array)  topics\n"
+            "        [\n"
+            "          \"topics\",                  (string)  topic\n"
+            "        ],\n"
+            "        \"data\": \"data\"               (string)  logged data\n"
+            "      }\n"
+            "    ]\n"
+            "  }\n"
+            "]\n"
+            "\nWith limit or cursor the receipts are returned in pages, in chain order:\n"
+            "{\n"
+            "  \"receipts\": [ ... ],             (array)  receipts as above\n"
+            "  \"cursor\": \"hex\"                 (string)  pass as cursor to get the next page, null after the last page\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("searchlogs", "0 100 '{\"addresses\": [\"12ae42729af478ca92c8c66773a3e32115717be4\"]}' '{\"topics\": [null,\"b436c2bf863ccd7b8f63171201efd4792066b4ce8e543dde9c3e9e9ab98e216c\"]}'")
+            + HelpExampleCli("searchlogs", "0 100 null null 0 500")
+            + HelpExampleRpc("searchlogs", "0 100 '{\"addresses\": [\"12ae42729af478ca92c8c66773a3e32115717be4\"]} {\"topics\": [null,\"b436c2bf863ccd7b8f63171201efd4792066b4ce8e543dde9c3e9e9ab98e216c\"]}'")
+                },
+            }.Check(request);
+
+    if(!fLogEvents)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Events indexing disabled");
+
+    if (g_logindex) {
+        g_logindex->BlockUntilSyncedToCurrentChain();
+    }
+
+    SearchLogsParams params(request.params);
+
+    // same parameter checks as ReadHeightIndex
+    if (params.toBlock < params.fromBlock || (params.fromBlock == 0 && params.toBlock == 0)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Incorrect params");
+    }
+
+    if (params.paged) {
+        UniValue receipts(UniValue::VARR);
+        boost::optional<SearchLogsCursor> last;
+        bool more = false;
+        ForEachSearchLogsReceipt(params, [&](const TransactionReceiptInfo& receipt) {
+            if (receipts.size() == params.limit) {
+                more = true;
+                return false;
+            }
+            UniValue tri(UniValue::VOBJ);
+            transactionReceiptInfoToJSON(receipt, tri);
+            receipts.push_back(tri);
+            last = SearchLogsCursor(receipt);
+            return true;
+        });
+
+        UniValue result(UniValue::VOBJ);
+        result.pushKV("receipts", receipts);
+        result.pushKV("cursor", more ? UniValue(EncodeSearchLogsCursor(*last)) : NullUniValue);
+        return result;
+    }
+
+    // without a page the whole range is returned, streamed out when there is a connection to write to
+    RPCResultStream result(request);
+    result.beginArray();
+    ForEachSearchLogsReceipt(params, [&](const TransactionReceiptInfo& receipt) {
+        UniValue tri(UniValue::VOBJ);
+        transactionReceiptInfoToJSON(receipt, tri);
+        result.value(tri);
+        return result.good();
+    });
+    result.endArray();
+    return result.Finish();
+}
+
+/** A token holder given as a hex address or as a base58 pubkeyhash address */
+static uint160 ParseTokenHolder(const UniValue& value)
+{
+    const std::string& str = value.get_str();
+    uint160 holder;
+    if (str.size() == 40 && IsHex(str)) {
+        holder.SetReverseHex(str);
+        return holder;
+    }
+    CTxDestination dest = DecodeDestination(str);
+    const PKHash* keyID = boost::get<PKHash>(&dest);
+    if (!keyID) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid holder address, expected a hex or pubkeyhash address");
+    }
+    return *keyID;
+}
+
+static uint160 ParseTokenContract(const UniValue& value)
+{
+    const std::string& str = value.get_str();
+    if (str.size() != 40 || !IsHex(str)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid token contract address");
+    }
+    uint160 token;
+    token.SetReverseHex(str);
+    return token;
+}
+
+/** Token amounts do not fit in a JSON number, they are returned as decimal strings */
+static std::string TokenAmountToString(const uint256& amount)
+{
+    return uintTou256(amount).str();
+}
+
+UniValue gettokenbalances(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"gettokenbalances",
+                "\nGet the QRC20 token balances of an address from its Transfer events, requires -tokenindex to be enabled.\n"
+                "Tokens that assign balances without emitting a Transfer event are not accounted for.\n",
+                {
+                    {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "The holder, as a hex address or a pubkeyhash address."},
+                    {"token", RPCArg::Type::STR_HEX, RPCArg::Optional::OMITTED_NAMED_ARG, "Only get the balance of this token contract."},
+                },
+                RPCResult{
+            "[\n"
+            "  {\n"
+            "    \"token\": \"address\",              (string)  token contract address\n"
+            "    \"balance\": \"amount\",             (string)  amount received less amount sent, in token units\n"
+            "    \"received\": \"amount\",            (string)  total amount received\n"
+            "    \"sent\": \"amount\",                (string)  total amount sent\n"
+            "    \"transfers\": n                   (numeric)  number of transfers to and from the address\n"
+            "  }\n"
+            "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("gettokenbalances", "\"12ae42729af478ca92c8c66773a3e32115717be4\"")
+            + HelpExampleRpc("gettokenbalances", "\"12ae42729af478ca92c8c66773a3e32115717be4\"")
+                },
+            }.Check(request);
+
+    if (!g_tokenindex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Token index not enabled");
+
+    uint160 holder = ParseTokenHolder(request.params[0]);
+    uint160 token;
+    if (!request.params[1].isNull()) {
+        token = ParseTokenContract(request.params[1]);
     }
 
-private:
-    void setFromBlock(const UniValue& val) {
-        if (!val.isNull()) {
-            fromBlock = parseBlockHeight(val);
-        } else {
-            fromBlock = latestblock.height;
-        }
-    }
+    g_tokenindex->BlockUntilSyncedToCurrentChain();
 
-    void setToBlock(const UniValue& val) {
-        if (!val.isNull()) {
-            toBlock = parseBlockHeight(val);
-        } else {
-            toBlock = latestblock.height;
-        }
+    std::vector<TokenBalance> balances;
+    if (!g_tokenindex->FindBalances(holder, token, balances)) {
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read token balances");
     }
 
-};
+    UniValue result(UniValue::VARR);
+    for (const TokenBalance& balance : balances) {
+        const dev::u256 received = uintTou256(balance.received);
+        const dev::u256 sent = uintTou256(balance.sent);
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("token", balance.token.GetReverseHex());
+        entry.pushKV("balance", received >= sent ? dev::u256(received - sent).str() : "-" + dev::u256(sent - received).str());
+        entry.pushKV("received", TokenAmountToString(balance.received));
+        entry.pushKV("sent", TokenAmountToString(balance.sent));
+        entry.pushKV("transfers", (int64_t)balance.transfers);
+        result.push_back(entry);
+    }
+    return result;
+}
 
-UniValue searchlogs(const JSONRPCRequest& request)
+UniValue gettokentransfers(const JSONRPCRequest& request)
 {
-            RPCHelpMan{"searchlogs",
-                "\nSearch logs, requires -logevents to be enabled.\n",
+            RPCHelpMan{"gettokentransfers",
+                "\nGet the QRC20 token transfers to and from an address in chain order, requires -tokenindex to be enabled.\n",
                 {
-                    {"fromBlock", RPCArg::Type::NUM, RPCArg::Optional::NO, "The number of the earliest block (latest may be given to mean the most recent block)."},
-                    {"toBlock", RPCArg::Type::NUM, RPCArg::Optional::NO, "The number of the latest block (-1 may be given to mean the most recent block)."},
-                    {"address", RPCArg::Type::STR, RPCArg::Optional::OMITTED_NAMED_ARG, "An address or a list of addresses to only get logs from particular account(s)."},
-                    {"topics", RPCArg::Type::STR, RPCArg::Optional::OMITTED_NAMED_ARG, "An array of values from which at least one must appear in the log entries. The order is important, if you want to leave topics out use null, e.g. [\"null\", \"0x00...\"]."},
-                    {"minconf", RPCArg::Type::NUM, /* default */ "0", "Minimal number of confirmations before a log is returned"},
+                    {"token", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The token contract address."},
+                    {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "The holder, as a hex address or a pubkeyhash address."},
+                    {"fromBlock", RPCArg::Type::NUM, /* default */ "0", "The number of the earliest block."},
+                    {"toBlock", RPCArg::Type::NUM, /* default */ "-1", "The number of the latest block, -1 for the most recent block."},
+                    {"limit", RPCArg::Type::NUM, /* default */ "0", "Return at most this many transfers, 0 for all of them."},
                 },
                 RPCResult{
             "[\n"
             "  {\n"
-            "    \"blockHash\": \"hash\",             (string)  block hash\n"
-            "    \"blockNumber\": n,                (numeric)  block number\n"
             "    \"transactionHash\": \"hash\",       (string)  transaction hash\n"
+            "    \"blockNumber\": n,                (numeric)  block number\n"
             "    \"transactionIndex\": n,           (numeric)  transaction index\n"
-            "    \"from\": \"address\",               (string)  from address\n"
-            "    \"to\": \"address\",                 (string)  to address\n"
-            "    \"cumulativeGasUsed\": n,          (numeric)  cumulative gas used\n"
-            "    \"gasUsed\": n,                    (numeric)  gas used\n"
-            "    \"contractAddress\": \"address\",    (string)  contract address\n"
-            "    \"excepted\": \"exception\",         (string)  thrown exception\n"
-            "    \"log\": [                         (array)  logs from the receipt\n"
-            "      {\n"
-            "        \"address\": \"address\",        (string)  contract address\n"
-            "        \"topics\":                    (array)  topics\n"
-            "        [\n"
-            "          \"topics\",                  (string)  topic\n"
-            "        ],\n"
-            "        \"data\": \"data\"               (string)  logged data\n"
-            "      }\n"
-            "    ]\n"
+            "    \"logIndex\": n,                   (numeric)  index of the event among the logs of the transaction\n"
+            "    \"from\": \"address\",               (string)  sender\n"
+            "    \"to\": \"address\",                 (string)  receiver\n"
+            "    \"value\": \"amount\",               (string)  amount transferred, in token units\n"
+            "    \"direction\": \"in|out|self\"       (string)  whether the address received, sent or both\n"
             "  }\n"
             "]\n"
                 },
                 RPCExamples{
-                    HelpExampleCli("searchlogs", "0 100 '{\"addresses\": [\"12ae42729af478ca92c8c66773a3e32115717be4\"]}' '{\"topics\": [null,\"b436c2bf863ccd7b8f63171201efd4792066b4ce8e543dde9c3e9e9ab98e216c\"]}'")
-            + HelpExampleRpc("searchlogs", "0 100 '{\"addresses\": [\"12ae42729af478ca92c8c66773a3e32115717be4\"]} {\"topics\": [null,\"b436c2bf863ccd7b8f63171201efd4792066b4ce8e543dde9c3e9e9ab98e216c\"]}'")
+                    HelpExampleCli("gettokentransfers", "\"d4a145e59b1a1d8d4d3a1f0c3b4877b63938e0c4\" \"12ae42729af478ca92c8c66773a3e32115717be4\"")
+            + HelpExampleCli("gettokentransfers", "\"d4a145e59b1a1d8d4d3a1f0c3b4877b63938e0c4\" \"12ae42729af478ca92c8c66773a3e32115717be4\" 5000 -1 100")
+            + HelpExampleRpc("gettokentransfers", "\"d4a145e59b1a1d8d4d3a1f0c3b4877b63938e0c4\", \"12ae42729af478ca92c8c66773a3e32115717be4\"")
                 },
             }.Check(request);
 
-    if(!fLogEvents)
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Events indexing disabled");
-
-    int curheight = 0;
-    
-    LOCK(cs_main);
+    if (!g_tokenindex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Token index not enabled");
 
-    SearchLogsParams params(request.params);
-    
-    std::vector<std::vector<uint256>> hashesToBlock;
+    uint160 token = ParseTokenContract(request.params[0]);
+    uint160 holder = ParseTokenHolder(request.params[1]);
+    int fromBlock = request.params[2].isNull() ? 0 : request.params[2].get_int();
+    int toBlock = request.params[3].isNull() ? -1 : request.params[3].get_int();
+    int limit = request.params[4].isNull() ? 0 : request.params[4].get_int();
+    if (fromBlock < 0 || toBlock < -1 || (toBlock > -1 && toBlock < fromBlock) || limit < 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Incorrect params");
+    }
 
-    curheight = pblocktree->ReadHeightIndex(params.fromBlock, params.toBlock, params.minconf, hashesToBlock, params.addresses);
+    g_tokenindex->BlockUntilSyncedToCurrentChain();
 
-    if (curheight == -1) {
-        throw JSONRPCError(RPC_INVALID_PARAMETER, "Incorrect params");
+    std::vector<TokenTransfer> transfers;
+    if (!g_tokenindex->FindTransfers(token, holder, fromBlock, toBlock, limit, transfers)) {
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read token transfers");
     }
 
     UniValue result(UniValue::VARR);
+    for (const TokenTransfer& transfer : transfers) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("transactionHash", transfer.tx_hash.GetHex());
+        entry.pushKV("blockNumber", transfer.height);
+        entry.pushKV("transactionIndex", (int64_t)transfer.tx_index);
+        entry.pushKV("logIndex", (int64_t)transfer.log_index);
+        entry.pushKV("from", transfer.from.GetReverseHex());
+        entry.pushKV("to", transfer.to.GetReverseHex());
+        entry.pushKV("value", TokenAmountToString(transfer.value));
+        entry.pushKV("direction", transfer.from == transfer.to ? "self" : transfer.to == holder ? "in" : "out");
+        result.push_back(entry);
+    }
+    return result;
+}
 
-    auto topics = params.topics;
-
-    std::set<uint256> dupes;
+UniValue listgovernors(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"listgovernors",
+                "\nList the governors enrolled in the governance contract, requires -governanceindex to be enabled.\n",
+                {},
+                RPCResult{
+            "[\n"
+            "  {\n"
+            "    \"address\": \"address\",            (string)  governor address\n"
+            "    \"registrationBlock\": n,          (numeric)  block number of the enrollment\n"
+            "    \"collateral\": x.xxx,             (numeric)  collateral sent to the contract in " + CURRENCY_UNIT + "\n"
+            "    \"lastRewardBlock\": n,            (numeric)  block number of the last reward, 0 if never rewarded\n"
+            "    \"rewards\": n,                    (numeric)  number of rewards received\n"
+            "    \"lastCallBlock\": n               (numeric)  block number of the last call of the governor to the contract\n"
+            "  }\n"
+            "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("listgovernors", "")
+            + HelpExampleRpc("listgovernors", "")
+                },
+            }.Check(request);
 
-    for(const auto& hashesTx : hashesToBlock)
-    {
-        for(const auto& e : hashesTx)
-        {
+    if (!g_governanceindex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Governance index not enabled");
 
-            if(dupes.find(e) != dupes.end()) {
-                continue;
-            }
-            dupes.insert(e);
+    g_governanceindex->BlockUntilSyncedToCurrentChain();
 
-            std::vector<TransactionReceiptInfo> receipts = pstorageresult->getResult(uintToh256(e));
+    std::vector<GovernorEntry> governors;
+    if (!g_governanceindex->FindGovernors(governors)) {
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read governors");
+    }
 
-            for(const auto& receipt : receipts) {
-                if(receipt.logs.empty()) {
-                    continue;
-                }
+    UniValue result(UniValue::VARR);
+    for (const GovernorEntry& governor : governors) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("address", governor.address.GetReverseHex());
+        entry.pushKV("registrationBlock", governor.registration_height);
+        entry.pushKV("collateral", ValueFromAmount(governor.collateral));
+        entry.pushKV("lastRewardBlock", governor.last_reward_height);
+        entry.pushKV("rewards", (int64_t)governor.rewards);
+        entry.pushKV("lastCallBlock", governor.last_call_height);
+        result.push_back(entry);
+    }
+    return result;
+}
 
-                if (!topics.empty()) {
-                    for (size_t i = 0; i < topics.size(); i++) {
-                        const auto& tc = topics[i];
+static UniValue ListBudgetCalls(const JSONRPCRequest& request, bool votes)
+{
+    if (!g_governanceindex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Governance index not enabled");
 
-                        if (!tc) {
-                            continue;
-                        }
+    int fromBlock = request.params[0].isNull() ? 0 : request.params[0].get_int();
+    int toBlock = request.params[1].isNull() ? -1 : request.params[1].get_int();
+    if (fromBlock < 0 || toBlock < -1 || (toBlock > -1 && toBlock < fromBlock)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Incorrect params");
+    }
 
-                        for (const auto& log: receipt.logs) {
-                            auto filterTopicContent = tc.get();
+    g_governanceindex->BlockUntilSyncedToCurrentChain();
 
-                            if (i >= log.topics.size()) {
-                                continue;
-                            }
+    std::vector<BudgetCall> calls;
+    if (!g_governanceindex->FindBudgetCalls(votes, fromBlock, toBlock, calls)) {
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read budget calls");
+    }
 
-                            if (filterTopicContent == log.topics[i]) {
-                                goto push;
-                            }
-                        }
-                    }
+    UniValue result(UniValue::VARR);
+    for (const BudgetCall& call : calls) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("transactionHash", call.tx_hash.GetHex());
+        entry.pushKV("outputIndex", (int64_t)call.vout);
+        entry.pushKV("blockNumber", call.height);
+        entry.pushKV(votes ? "voter" : "proposer", call.sender.GetReverseHex());
+        if (!votes) {
+            entry.pushKV("fee", ValueFromAmount(call.value));
+        }
+        entry.pushKV("data", HexStr(call.data));
+        result.push_back(entry);
+    }
+    return result;
+}
 
-                    // Skip the log if none of the topics are matched
-                    continue;
-                }
+UniValue listbudgetproposals(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"listbudgetproposals",
+                "\nList the proposals made to the budget contract in chain order, requires -governanceindex to be enabled.\n"
+                "A proposal is a successful call to the budget contract paying the proposal fee, its arguments are in the call data.\n",
+                {
+                    {"fromBlock", RPCArg::Type::NUM, /* default */ "0", "The number of the earliest block."},
+                    {"toBlock", RPCArg::Type::NUM, /* default */ "-1", "The number of the latest block, -1 for the most recent block."},
+                },
+                RPCResult{
+            "[\n"
+            "  {\n"
+            "    \"transactionHash\": \"hash\",       (string)  transaction hash\n"
+            "    \"outputIndex\": n,                (numeric)  output of the call\n"
+            "    \"blockNumber\": n,                (numeric)  block number\n"
+            "    \"proposer\": \"address\",           (string)  sender of the call\n"
+            "    \"fee\": x.xxx,                    (numeric)  value sent with the call in " + CURRENCY_UNIT + "\n"
+            "    \"data\": \"hex\"                    (string)  ABI encoded call data\n"
+            "  }\n"
+            "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("listbudgetproposals", "")
+            + HelpExampleCli("listbudgetproposals", "5000 -1")
+            + HelpExampleRpc("listbudgetproposals", "5000, -1")
+                },
+            }.Check(request);
 
-            push:
+    return ListBudgetCalls(request, false);
+}
 
-                UniValue tri(UniValue::VOBJ);
-                transactionReceiptInfoToJSON(receipt, tri);
-                result.push_back(tri);
-            }
-        }
-    }
+UniValue listbudgetvotes(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"listbudgetvotes",
+                "\nList the votes made to the budget contract in chain order, requires -governanceindex to be enabled.\n"
+                "A vote is a successful call to the budget contract without value, the proposal and the vote are in the call data.\n",
+                {
+                    {"fromBlock", RPCArg::Type::NUM, /* default */ "0", "The number of the earliest block."},
+                    {"toBlock", RPCArg::Type::NUM, /* default */ "-1", "The number of the latest block, -1 for the most recent block."},
+                },
+                RPCResult{
+            "[\n"
+            "  {\n"
+            "    \"transactionHash\": \"hash\",       (string)  transaction hash\n"
+            "    \"outputIndex\": n,                (numeric)  output of the call\n"
+            "    \"blockNumber\": n,                (numeric)  block number\n"
+            "    \"voter\": \"address\",              (string)  sender of the call\n"
+            "    \"data\": \"hex\"                    (string)  ABI encoded call data\n"
+            "  }\n"
+            "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("listbudgetvotes", "")
+            + HelpExampleCli("listbudgetvotes", "5000 -1")
+            + HelpExampleRpc("listbudgetvotes", "5000, -1")
+                },
+            }.Check(request);
 
-    return result;
+    return ListBudgetCalls(request, true);
 }
 
 UniValue gettransactionreceipt(const JSONRPCRequest& request)
@@ -1978,8 +3177,6 @@ UniValue gettransactionreceipt(const JSONRPCRequest& request)
     if(!fLogEvents)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Events indexing disabled");
 
-    LOCK(cs_main);
-
     std::string hashTemp = request.params[0].get_str();
     if(hashTemp.size() != 64){
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect hash");
@@ -1987,14 +3184,28 @@ UniValue gettransactionreceipt(const JSONRPCRequest& request)
     
     uint256 hash(uint256S(hashTemp));
 
-    std::vector<TransactionReceiptInfo> transactionReceiptInfo = pstorageresult->getResult(uintToh256(hash));
+    // resultsDB has a lock of its own, the receipts do not depend on the chain tip
+    TransactionReceiptsRef transactionReceiptInfo = pstorageresult->getResult(uintToh256(hash));
 
     UniValue result(UniValue::VARR);
-    for(TransactionReceiptInfo& t : transactionReceiptInfo){
+    for(const TransactionReceiptInfo& t : *transactionReceiptInfo){
         UniValue tri(UniValue::VOBJ);
         transactionReceiptInfoToJSON(t, tri);
         result.push_back(tri);
     }
+
+    // the receipts of a confirmed transaction only change when its block is disconnected
+    if (!transactionReceiptInfo->empty()) {
+        const uint256& blockHash = transactionReceiptInfo->front().blockHash;
+        bool oneBlock = true;
+        for (const TransactionReceiptInfo& t : *transactionReceiptInfo) {
+            oneBlock &= t.blockHash == blockHash;
+        }
+        const CBlockIndex* pblockindex = oneBlock ? LookupBlockIndexShared(blockHash) : nullptr;
+        if (pblockindex) {
+            request.SetResultCacheable(blockHash, pblockindex->nHeight);
+        }
+    }
     return result;
 }
 
@@ -2041,8 +3252,6 @@ UniValue getblocktransactionreceipts(const JSONRPCRequest& request)
     if (!fLogEvents)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Events indexing disabled");
 
-    LOCK(cs_main);
-
     std::string hashTemp = request.params[0].get_str();
     if (hashTemp.size() != 64) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect hash");
@@ -2050,21 +3259,30 @@ UniValue getblocktransactionreceipts(const JSONRPCRequest& request)
 
     uint256 hash(uint256S(hashTemp));
 
-    const CBlockIndex* pblockindex = LookupBlockIndex(hash);
-    if (!pblockindex) {
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+    CBlock block;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pblockindex = LookupBlockIndex(hash);
+        if (!pblockindex) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
+        block = GetBlockChecked(pblockindex);
     }
-    const CBlock block = GetBlockChecked(pblockindex);
 
-    UniValue result(UniValue::VARR);
+    std::vector<dev::h256> hashes;
     for (const auto& tx: block.vtx) {
-        if (tx->HasCreateOrCall()) {
-            const std::vector<TransactionReceiptInfo> transactionReceiptInfo = pstorageresult->getResult(uintToh256(tx->GetHash()));
-            for (const TransactionReceiptInfo& t : transactionReceiptInfo) {
-                UniValue tri(UniValue::VOBJ);
-                transactionReceiptInfoToJSON(t, tri);
-                result.push_back(tri);
-            }
+        if (tx->HasCreateOrCall())
+            hashes.push_back(uintToh256(tx->GetHash()));
+    }
+
+    UniValue result(UniValue::VARR);
+    for (const TransactionReceiptsRef& transactionReceiptInfo : pstorageresult->getResults(hashes)) {
+        for (const TransactionReceiptInfo& t : *transactionReceiptInfo) {
+            if (t.blockHash != hash)
+                continue;
+            UniValue tri(UniValue::VOBJ);
+            transactionReceiptInfoToJSON(t, tri);
+            result.push_back(tri);
         }
     }
 
@@ -2075,10 +3293,14 @@ UniValue getblocktransactionreceipts(const JSONRPCRequest& request)
 UniValue listcontracts(const JSONRPCRequest& request)
 {
             RPCHelpMan{"listcontracts",
-                "\nGet the contracts list.\n",
+                "\nGet the contracts list.\n"
+                "With -contractindex the contracts are listed in creation order from the index and can be\n"
+                "restricted to a range of creation heights, otherwise every account of the state is walked.\n",
                 {
                     {"start", RPCArg::Type::NUM, /* default */ "1", "The starting account index"},
                     {"maxDisplay", RPCArg::Type::NUM, /* default */ "20", "Max accounts to list"},
+                    {"fromBlock", RPCArg::Type::NUM, /* default */ "0", "The earliest creation height, requires -contractindex."},
+                    {"toBlock", RPCArg::Type::NUM, /* default */ "-1", "The latest creation height, -1 for the most recent block, requires -contractindex."},
                 },
                 RPCResult{
             "{\n"
@@ -2088,12 +3310,11 @@ UniValue listcontracts(const JSONRPCRequest& request)
                 },
                 RPCExamples{
                     HelpExampleCli("listcontracts", "")
+            + HelpExampleCli("listcontracts", "1 100 5000 6000")
             + HelpExampleRpc("listcontracts", "")
                 },
             }.Check(request);
 
-	LOCK(cs_main);
-
 	int start=1;
 	if (request.params.size() > 0){
 		start = request.params[0].get_int();
@@ -2108,8 +3329,40 @@ UniValue listcontracts(const JSONRPCRequest& request)
 			throw JSONRPCError(RPC_TYPE_ERROR, "Invalid maxDisplay");
 	}
 
+	int fromBlock = request.params[2].isNull() ? 0 : request.params[2].get_int();
+	int toBlock = request.params[3].isNull() ? -1 : request.params[3].get_int();
+	if (fromBlock < 0 || toBlock < -1 || (toBlock > -1 && toBlock < fromBlock))
+		throw JSONRPCError(RPC_INVALID_PARAMETER, "Incorrect params");
+	bool fHeightRange = !request.params[2].isNull() || !request.params[3].isNull();
+
 	UniValue result(UniValue::VOBJ);
 
+	if (g_contractindex) {
+		g_contractindex->BlockUntilSyncedToCurrentChain();
+
+		uint64_t contractsCount = 0;
+		if (!fHeightRange && !g_contractindex->CountContracts(contractsCount))
+			throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read the contract count");
+		if (!fHeightRange && contractsCount>0 && (uint64_t)start > contractsCount)
+			throw JSONRPCError(RPC_TYPE_ERROR, "start greater than max index "+ i64tostr(contractsCount));
+
+		std::vector<ContractEntry> contracts;
+		if (!g_contractindex->FindContracts(fromBlock, toBlock, start-1, maxDisplay, contracts))
+			throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read contracts");
+
+		LOCK(cs_main);
+		for (const ContractEntry& contract : contracts) {
+			dev::Address address(contract.address.GetReverseHex());
+			result.pushKV(address.hex(),ValueFromAmount(CAmount(globalState->balance(address))));
+		}
+		return result;
+	}
+
+	if (fHeightRange)
+		throw JSONRPCError(RPC_MISC_ERROR, "Contract index not enabled");
+
+	LOCK(cs_main);
+
 	auto map = globalState->addresses();
 	int contractsCount=(int)map.size();
 
@@ -2146,18 +3399,22 @@ UniValue listallcontracts(const JSONRPCRequest& request)
             }
                 .ToString());
 
-    LOCK(cs_main);
-
-    TemporaryState ts(globalState);
-    if (request.params.size() > 0) {
-        int blockNum = request.params[0].get_int();
-        if (blockNum < 0 || blockNum > ::ChainActive().Height())
-            throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
-        ts.SetRoot(uintToh256(::ChainActive()[blockNum]->hashStateRoot), uintToh256(::ChainActive()[blockNum]->hashUTXORoot));
+    QtumStateViewPool::Handle view;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pblockindex = ::ChainActive().Tip();
+        if (request.params.size() > 0) {
+            int blockNum = request.params[0].get_int();
+            if (blockNum < 0 || blockNum > ::ChainActive().Height())
+                throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
+            pblockindex = ::ChainActive()[blockNum];
+        }
+        CheckStateAvailable(pblockindex);
+        view = stateViewPool.acquire(uintToh256(pblockindex->hashStateRoot), uintToh256(pblockindex->hashUTXORoot));
     }
 
     UniValue result(UniValue::VARR);
-    auto map = globalState->addresses();
+    auto map = view->state().addresses();
     for (const auto& item: map) {
         result.push_back(item.first.hex());
     }
@@ -2224,47 +3481,200 @@ static UniValue gettxoutsetinfo(const JSONRPCRequest& request)
 {
             RPCHelpMan{"gettxoutsetinfo",
                 "\nReturns statistics about the unspent transaction output set.\n"
-                "Note this call may take some time.\n",
-                {},
+                "Note this call may take some time, unless -coinstatsindex is enabled and the muhash or none hash_type is asked for.\n",
+                {
+                    {"hash_type", RPCArg::Type::STR, /* default */ "hash_serialized_2", "Which UTXO set hash should be calculated. Options: 'hash_serialized_2' (the legacy algorithm), 'muhash', 'none'."},
+                    {"use_index", RPCArg::Type::BOOL, /* default */ "true", "Use the coin stats index when it is available and the hash_type is not hash_serialized_2."},
+                },
                 RPCResult{
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) The hash of the block at the tip of the chain\n"
-            "  \"transactions\": n,      (numeric) The number of transactions with unspent outputs\n"
+            "  \"transactions\": n,      (numeric) The number of transactions with unspent outputs, not available from the coin stats index\n"
             "  \"txouts\": n,            (numeric) The number of unspent transaction outputs\n"
             "  \"bogosize\": n,          (numeric) A meaningless metric for UTXO set size\n"
-            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash, only with hash_type hash_serialized_2\n"
+            "  \"muhash\": \"hash\",       (string) The MuHash of the unspent outputs, only with hash_type muhash\n"
             "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
+            "  \"contract_txouts\": n,   (numeric) The number of unspent outputs held by contracts\n"
+            "  \"contract_amount\": x.xxx       (numeric) The total amount held by contracts\n"
+            "  \"hashStateRoot\": \"hex\", (string) The EVM state root at the tip of the chain\n"
+            "  \"hashUTXORoot\": \"hex\",  (string) The EVM UTXO root at the tip of the chain\n"
             "}\n"
                 },
                 RPCExamples{
                     HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "\"muhash\"")
             + HelpExampleRpc("gettxoutsetinfo", "")
                 },
             }.Check(request);
 
     UniValue ret(UniValue::VOBJ);
 
+    CoinStatsHashType hash_type = CoinStatsHashType::HASH_SERIALIZED;
+    if (!request.params[0].isNull()) {
+        const std::string hash_type_input = request.params[0].get_str();
+        if (hash_type_input == "hash_serialized_2") {
+            hash_type = CoinStatsHashType::HASH_SERIALIZED;
+        } else if (hash_type_input == "muhash") {
+            hash_type = CoinStatsHashType::MUHASH;
+        } else if (hash_type_input == "none") {
+            hash_type = CoinStatsHashType::NONE;
+        } else {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("%s is not a valid hash_type", hash_type_input));
+        }
+    }
+    const bool use_index = request.params[1].isNull() || request.params[1].get_bool();
+
     CCoinsStats stats;
-    ::ChainstateActive().ForceFlushStateToDisk();
+    bool from_index = false;
+    if (use_index && hash_type != CoinStatsHashType::HASH_SERIALIZED && g_coin_stats_index && g_coin_stats_index->BlockUntilSyncedToCurrentChain()) {
+        const CBlockIndex* tip = WITH_LOCK(cs_main, return ::ChainActive().Tip());
+        from_index = g_coin_stats_index->LookUpStats(tip, stats);
+    }
+    if (from_index) {
+        stats.nDiskSize = WITH_LOCK(cs_main, return ::ChainstateActive().CoinsDB().EstimateSize());
+    } else {
+        ::ChainstateActive().ForceFlushStateToDisk();
+        CCoinsViewDB* coins_view = WITH_LOCK(cs_main, return &::ChainstateActive().CoinsDB());
+        if (!GetUTXOStats(coins_view, stats, hash_type)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+        }
+    }
 
-    CCoinsView* coins_view = WITH_LOCK(cs_main, return &ChainstateActive().CoinsDB());
-    if (GetUTXOStats(coins_view, stats)) {
-        ret.pushKV("height", (int64_t)stats.nHeight);
-        ret.pushKV("bestblock", stats.hashBlock.GetHex());
+    const CBlockIndex* pindex = WITH_LOCK(cs_main, return LookupBlockIndex(stats.hashBlock));
+    ret.pushKV("height", (int64_t)stats.nHeight);
+    ret.pushKV("bestblock", stats.hashBlock.GetHex());
+    if (!from_index) {
         ret.pushKV("transactions", (int64_t)stats.nTransactions);
-        ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
-        ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
+    }
+    ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
+    ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
+    if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
         ret.pushKV("hash_serialized_2", stats.hashSerialized.GetHex());
-        ret.pushKV("disk_size", stats.nDiskSize);
-        ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
-    } else {
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+    } else if (hash_type == CoinStatsHashType::MUHASH) {
+        ret.pushKV("muhash", stats.hashSerialized.GetHex());
+    }
+    ret.pushKV("disk_size", stats.nDiskSize);
+    ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
+    ret.pushKV("contract_txouts", (int64_t)stats.nContractOutputs);
+    ret.pushKV("contract_amount", ValueFromAmount(stats.nContractAmount));
+    if (pindex) {
+        ret.pushKV("hashStateRoot", pindex->hashStateRoot.GetHex());
+        ret.pushKV("hashUTXORoot", pindex->hashUTXORoot.GetHex());
     }
     return ret;
 }
 
+static UniValue dumptxoutset(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"dumptxoutset",
+                "\nWrite the serialized UTXO set to disk, along with the EVM state roots of the block it belongs to.\n"
+                "Incidentally flushes the latest coinsdb (leveldb) to disk.\n",
+                {
+                    {"path", RPCArg::Type::STR, RPCArg::Optional::NO, "path to the output file. If relative, will be prefixed by datadir."},
+                },
+                RPCResult{
+            "{\n"
+            "  \"coins_written\": n,           (numeric) the number of coins written in the snapshot\n"
+            "  \"base_hash\": \"hash\",          (string) the hash of the base of the snapshot\n"
+            "  \"base_height\": n,             (numeric) the height of the base of the snapshot\n"
+            "  \"hash_state_root\": \"hash\",    (string) the EVM account trie root of the base block\n"
+            "  \"hash_utxo_root\": \"hash\",     (string) the EVM UTXO trie root of the base block\n"
+            "  \"hash_serialized_2\": \"hash\",  (string) the serialized hash of the UTXO set, as in gettxoutsetinfo\n"
+            "  \"path\": \"path\"                (string) the absolute path that the snapshot was written to\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("dumptxoutset", "utxo.dat")
+                },
+            }.Check(request);
+
+    fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    // Write to a temporary path and then move into `path` on completion
+    // to avoid confusion due to an interruption.
+    fs::path temppath = fs::absolute(request.params[0].get_str() + ".incomplete", GetDataDir());
+
+    if (fs::exists(path)) {
+        throw JSONRPCError(
+            RPC_INVALID_PARAMETER,
+            path.string() + " already exists. If you are sure this is what you want, "
+            "move it out of the way first");
+    }
+
+    FILE* file{fsbridge::fopen(temppath, "wb")};
+    CAutoFile afile{file, SER_DISK, CLIENT_VERSION};
+    if (afile.IsNull()) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Unable to open " + temppath.string() + " for writing");
+    }
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+    CCoinsStats stats;
+    CBlockIndex* tip;
+
+    {
+        // We need to lock cs_main to ensure that the coinsdb isn't written to
+        // between (i) flushing coins cache to disk (coinsdb), (ii) getting stats
+        // based upon the coinsdb, and (iii) constructing a cursor to the
+        // coinsdb for use below this block.
+        //
+        // Cursors returned by leveldb iterate over snapshots, so the contents
+        // of the pcursor will not be affected by simultaneous writes during
+        // use below this block.
+        //
+        // See discussion here:
+        //   https://github.com/bitcoin/bitcoin/pull/15606#discussion_r274479369
+        //
+        LOCK(::cs_main);
+
+        ::ChainstateActive().ForceFlushStateToDisk();
+
+        if (!GetUTXOStats(&::ChainstateActive().CoinsDB(), stats)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+        }
+
+        pcursor = std::unique_ptr<CCoinsViewCursor>(::ChainstateActive().CoinsDB().Cursor());
+        tip = LookupBlockIndex(stats.hashBlock);
+        if (!tip) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to find the block of the UTXO set");
+        }
+    }
+
+    SnapshotMetadata metadata{tip->GetBlockHash(), stats.nTransactionOutputs, tip->nChainTx, tip->hashStateRoot, tip->hashUTXORoot};
+
+    afile << metadata;
+
+    COutPoint key;
+    Coin coin;
+    unsigned int iter{0};
+
+    while (pcursor->Valid()) {
+        if (iter % 5000 == 0 && !IsRPCRunning()) {
+            throw JSONRPCError(RPC_CLIENT_NOT_CONNECTED, "Shutting down");
+        }
+        ++iter;
+        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
+            afile << key;
+            afile << coin;
+        }
+
+        pcursor->Next();
+    }
+
+    afile.fclose();
+    fs::rename(temppath, path);
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("coins_written", stats.nTransactionOutputs);
+    result.pushKV("base_hash", tip->GetBlockHash().ToString());
+    result.pushKV("base_height", tip->nHeight);
+    result.pushKV("hash_state_root", tip->hashStateRoot.GetHex());
+    result.pushKV("hash_utxo_root", tip->hashUTXORoot.GetHex());
+    result.pushKV("hash_serialized_2", stats.hashSerialized.GetHex());
+    result.pushKV("path", path.string());
+    return result;
+}
+
 UniValue gettxout(const JSONRPCRequest& request)
 {
             RPCHelpMan{"gettxout",
@@ -2671,6 +4081,8 @@ UniValue MempoolInfoToJSON(const CTxMemPool& pool)
     ret.pushKV("maxmempool", (int64_t) maxmempool);
     ret.pushKV("mempoolminfee", ValueFromAmount(std::max(pool.GetMinFee(maxmempool), ::minRelayTxFee).GetFeePerK()));
     ret.pushKV("minrelaytxfee", ValueFromAmount(::minRelayTxFee.GetFeePerK()));
+    ret.pushKV("gas", pool.GetTotalGasLimit());
+    ret.pushKV("maxmempoolgas", gArgs.GetArg("-maxmempoolgas", DEFAULT_MAX_MEMPOOL_GAS));
 
     return ret;
 }
@@ -2689,6 +4101,8 @@ static UniValue getmempoolinfo(const JSONRPCRequest& request)
             "  \"maxmempool\": xxxxx,         (numeric) Maximum memory usage for the mempool\n"
             "  \"mempoolminfee\": xxxxx       (numeric) Minimum fee rate in " + CURRENCY_UNIT + "/kB for tx to be accepted. Is the maximum of minrelaytxfee and minimum mempool fee\n"
             "  \"minrelaytxfee\": xxxxx       (numeric) Current minimum relay fee for transactions\n"
+            "  \"gas\": xxxxx,                (numeric) Sum of the gas limits of the contract transactions\n"
+            "  \"maxmempoolgas\": xxxxx,      (numeric) Maximum gas of the contract transactions for the mempool\n"
             "}\n"
                 },
                 RPCExamples{
@@ -2812,6 +4226,51 @@ static UniValue reconsiderblock(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
+static UniValue getblockconnecttimes(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"getblockconnecttimes",
+                "\nReturns the time spent connecting blocks to the chain since startup, split into its parts.\n"
+                "The same times are logged for every block with -debug=bench.\n",
+                {},
+                RPCResult{
+            "{\n"
+            "  \"blocks\": n,             (numeric) The number of blocks the times add up\n"
+            "  \"parts\": [               (json array) The parts, each followed by the parts it consists of\n"
+            "    {\n"
+            "      \"part\": \"name\",      (string) The part, e.g. \"connect.verify.transactions.execution\" for contract execution\n"
+            "      \"total_ms\": x.xxx,   (numeric) Milliseconds spent in it\n"
+            "      \"avg_ms\": x.xxx      (numeric) Milliseconds per block\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getblockconnecttimes", "")
+            + HelpExampleRpc("getblockconnecttimes", "")
+                },
+            }.Check(request);
+
+    BlockConnectTimes times;
+    {
+        LOCK(cs_main);
+        times = GetBlockConnectTimes();
+    }
+
+    UniValue parts(UniValue::VARR);
+    for (const auto& part : times.parts) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("part", part.first);
+        entry.pushKV("total_ms", part.second * 0.001);
+        entry.pushKV("avg_ms", times.blocks ? part.second * 0.001 / times.blocks : 0.0);
+        parts.push_back(entry);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("blocks", times.blocks);
+    ret.pushKV("parts", parts);
+    return ret;
+}
+
 static UniValue getchaintxstats(const JSONRPCRequest& request)
 {
             RPCHelpMan{"getchaintxstats",
@@ -3515,6 +4974,7 @@ static const CRPCCommand commands[] = {
     { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      {} },
     { "blockchain",         "getchaintxstats",        &getchaintxstats,        {"nblocks", "blockhash"} },
     { "blockchain",         "getblockstats",          &getblockstats,          {"hash_or_height", "stats"} },
+    { "blockchain",         "getblockconnecttimes",   &getblockconnecttimes,   {} },
     { "blockchain",         "getbestblockhash",       &getbestblockhash,       {} },
     { "blockchain",         "getblockcount",          &getblockcount,          {} },
     { "blockchain",         "getblock",               &getblock,               {"blockhash","verbosity|verbose"} },
@@ -3528,31 +4988,40 @@ static const CRPCCommand commands[] = {
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         {} },
     { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"} },
     { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {"hash_type", "use_index"} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        {"height"} },
     { "blockchain",         "savemempool",            &savemempool,            {} },
     { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"} },
-    { "blockchain",         "getaccountinfo",         &getaccountinfo,         {"contract_address"} },
+    { "blockchain",         "getaccountinfo",         &getaccountinfo,         {"contract_address", "storage"} },
     { "blockchain",         "getcontractcode",        &getcontractcode,        {"address", "blockNum"} },
-    { "blockchain",         "getstorage",             &getstorage,             {"address", "index", "blockNum"} },
+    { "blockchain",         "getstorage",             &getstorage,             {"address", "index", "blockNum", "limit", "cursor", "prefix"} },
+    { "blockchain",         "getstorageslots",        &getstorageslots,        {"address", "slots", "blockNum"} },
 
     { "blockchain",         "preciousblock",          &preciousblock,          {"blockhash"} },
     { "blockchain",         "scantxoutset",           &scantxoutset,           {"action", "scanobjects"} },
     { "blockchain",         "getblockfilter",         &getblockfilter,         {"blockhash", "filtertype"} },
 
     { "blockchain",         "callcontract",           &callcontract,           {"address","data", "senderAddress", "gasLimit"} },
+    { "blockchain",         "callcontractbatch",      &callcontractbatch,      {"calls", "blockNum"} },
+    { "blockchain",         "estimategas",            &estimategas,            {"address", "data", "senderAddress", "amount", "gasLimit", "blockNum"} },
     /* Not shown in help */
     { "hidden",             "invalidateblock",        &invalidateblock,        {"blockhash"} },
     { "hidden",             "reconsiderblock",        &reconsiderblock,        {"blockhash"} },
+    { "hidden",             "dumptxoutset",           &dumptxoutset,           {"path"} },
     { "hidden",             "waitfornewblock",        &waitfornewblock,        {"timeout"} },
     { "hidden",             "waitforblock",           &waitforblock,           {"blockhash","timeout"} },
     { "hidden",             "waitforblockheight",     &waitforblockheight,     {"height","timeout"} },
     { "hidden",             "syncwithvalidationinterfacequeue", &syncwithvalidationinterfacequeue, {} },
-    { "blockchain",         "listcontracts",          &listcontracts,          {"start", "maxDisplay"} },
+    { "blockchain",         "listcontracts",          &listcontracts,          {"start", "maxDisplay", "fromBlock", "toBlock"} },
     { "blockchain",         "listallcontracts",       &listallcontracts,       {"height"} },
     { "blockchain",         "gettransactionreceipt",  &gettransactionreceipt,  {"hash"} },
     { "blockchain",         "getblocktransactionreceipts",  &getblocktransactionreceipts,  {"hash"} },
-    { "blockchain",         "searchlogs",             &searchlogs,             {"fromBlock", "toBlock", "address", "topics"} },
+    { "blockchain",         "searchlogs",             &searchlogs,             {"fromBlock", "toBlock", "address", "topics", "minconf", "limit", "cursor"} },
+    { "blockchain",         "gettokenbalances",       &gettokenbalances,       {"address", "token"} },
+    { "blockchain",         "gettokentransfers",      &gettokentransfers,      {"token", "address", "fromBlock", "toBlock", "limit"} },
+    { "blockchain",         "listgovernors",          &listgovernors,          {} },
+    { "blockchain",         "listbudgetproposals",    &listbudgetproposals,    {"fromBlock", "toBlock"} },
+    { "blockchain",         "listbudgetvotes",        &listbudgetvotes,        {"fromBlock", "toBlock"} },
 
     { "blockchain",         "waitforlogs",            &waitforlogs,            {"fromBlock", "nblocks", "address", "topics"} },
     { "blockchain",         "getestimatedannualroi",  &getestimatedannualroi,  {} },
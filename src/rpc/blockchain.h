@@ -16,7 +16,16 @@ extern RecursiveMutex cs_main;
 class CBlock;
 class CBlockIndex;
 class CTxMemPool;
+class QtumTransactionReceipt;
 class UniValue;
+struct TransactionReceiptInfo;
+
+namespace dev {
+namespace eth {
+struct ExecutionResult;
+struct LogEntry;
+}
+}
 
 static constexpr int NUM_GETBLOCKSTATS_PERCENTILES = 5;
 
@@ -43,6 +52,16 @@ UniValue MempoolToJSON(const CTxMemPool& pool, bool verbose = false);
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex* tip, const CBlockIndex* blockindex) LOCKS_EXCLUDED(cs_main);
 
+/** Transaction receipt to JSON, as returned by gettransactionreceipt */
+void transactionReceiptInfoToJSON(const TransactionReceiptInfo& resExec, UniValue& entry);
+
+/** Result of a contract call to JSON, as returned by callcontract */
+UniValue executionResultToJSON(const dev::eth::ExecutionResult& exRes);
+UniValue transactionReceiptToJSON(const QtumTransactionReceipt& txRec);
+
+/** Log entry of a receipt to JSON, as returned by waitforlogs */
+void logEntryToJSON(const TransactionReceiptInfo& resExec, const dev::eth::LogEntry& log, UniValue& entry);
+
 /** Used by getblockstats to get feerates at different percentiles by weight  */
 void CalculatePercentilesByWeight(CAmount result[NUM_GETBLOCKSTATS_PERCENTILES], std::vector<std::pair<CAmount, int64_t>>& scores, int64_t total_weight);
 
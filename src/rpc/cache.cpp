@@ -0,0 +1,215 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rpc/cache.h>
+
+#include <chain.h>
+#include <rpc/server.h>
+#include <sync.h>
+#include <util/strencodings.h>
+#include <validation.h>
+
+#include <algorithm>
+#include <iterator>
+#include <list>
+#include <map>
+#include <set>
+#include <unordered_map>
+
+#include <univalue.h>
+
+namespace {
+
+/** Bytes counted for an entry besides its strings, the key is also held by the map */
+const size_t ENTRY_OVERHEAD = 160;
+
+const std::string CONFIRMATIONS_KEY = "\"confirmations\":";
+const std::string NEXTBLOCKHASH_KEY = "\"nextblockhash\":\"";
+
+/**
+ * A written result, split around the value of its first confirmations field when it has one.
+ * The result holds while the block after the one it was computed from stays in the active
+ * chain, which also keeps a nextblockhash field right.
+ */
+struct RPCCacheEntry {
+    std::string key;
+    std::string prefix;
+    std::string suffix;
+    bool has_confirmations;
+    int height;
+    uint256 next_hash;
+
+    size_t Size() const { return 2 * key.size() + prefix.size() + suffix.size() + ENTRY_OVERHEAD; }
+};
+
+struct RPCCache {
+    Mutex cs;
+    size_t max_bytes GUARDED_BY(cs){0};
+    int min_depth GUARDED_BY(cs){DEFAULT_RPC_CACHE_DEPTH};
+    size_t bytes GUARDED_BY(cs){0};
+    uint64_t hits GUARDED_BY(cs){0};
+    uint64_t misses GUARDED_BY(cs){0};
+    /** Most recently used first */
+    std::list<RPCCacheEntry> lru GUARDED_BY(cs);
+    std::unordered_map<std::string, std::list<RPCCacheEntry>::iterator> entries GUARDED_BY(cs);
+    /** Methods that stored a result, the others are not looked up */
+    std::set<std::string> methods GUARDED_BY(cs);
+
+    void Erase(std::list<RPCCacheEntry>::iterator it) EXCLUSIVE_LOCKS_REQUIRED(cs)
+    {
+        bytes -= it->Size();
+        entries.erase(it->key);
+        lru.erase(it);
+    }
+};
+
+RPCCache g_rpc_cache;
+
+/** Write params with the keys of objects sorted, the order of named arguments does not matter */
+void WriteNormalized(const UniValue& value, std::string& out)
+{
+    if (value.isObject()) {
+        std::map<std::string, const UniValue*> sorted;
+        for (size_t i = 0; i < value.size(); i++) {
+            sorted.emplace(value.getKeys()[i], &value.getValues()[i]);
+        }
+        out += "{";
+        for (const auto& entry : sorted) {
+            if (out.back() != '{') out += ",";
+            out += UniValue(entry.first).write() + ":";
+            WriteNormalized(*entry.second, out);
+        }
+        out += "}";
+    } else {
+        out += value.write();
+    }
+}
+
+} // namespace
+
+void InitRPCCache(size_t max_bytes, int min_depth)
+{
+    LOCK(g_rpc_cache.cs);
+    g_rpc_cache.max_bytes = max_bytes;
+    // the block after the result's one is needed to tell a reorg
+    g_rpc_cache.min_depth = std::max(min_depth, 2);
+    while (g_rpc_cache.bytes > g_rpc_cache.max_bytes) {
+        g_rpc_cache.Erase(std::prev(g_rpc_cache.lru.end()));
+    }
+    if (g_rpc_cache.lru.empty()) g_rpc_cache.methods.clear();
+}
+
+bool RPCCacheEnabled()
+{
+    LOCK(g_rpc_cache.cs);
+    return g_rpc_cache.max_bytes > 0;
+}
+
+size_t RPCCacheMaxEntrySize()
+{
+    LOCK(g_rpc_cache.cs);
+    return g_rpc_cache.max_bytes / 8;
+}
+
+/** The cache key of a parsed request: its method and parameters */
+static std::string RPCCacheKey(const JSONRPCRequest& request)
+{
+    std::string key = request.strMethod + "\n";
+    WriteNormalized(request.params, key);
+    return key;
+}
+
+bool RPCCacheLookup(const JSONRPCRequest& request, std::string& result)
+{
+    {
+        LOCK(g_rpc_cache.cs);
+        if (!g_rpc_cache.methods.count(request.strMethod)) return false;
+    }
+    const std::string key = RPCCacheKey(request);
+    const std::shared_ptr<const ChainTipSnapshot> snapshot = GetChainTipSnapshot();
+    LOCK(g_rpc_cache.cs);
+    auto it = g_rpc_cache.entries.find(key);
+    if (it == g_rpc_cache.entries.end()) {
+        g_rpc_cache.misses++;
+        return false;
+    }
+    const RPCCacheEntry& entry = *it->second;
+    const CBlockIndex* next = (*snapshot)[entry.height + 1];
+    if (!next || next->GetBlockHash() != entry.next_hash) {
+        // reorganized away
+        g_rpc_cache.Erase(it->second);
+        g_rpc_cache.misses++;
+        return false;
+    }
+    result = entry.prefix;
+    if (entry.has_confirmations) {
+        result += itostr(snapshot->height - entry.height + 1);
+        result += entry.suffix;
+    }
+    g_rpc_cache.lru.splice(g_rpc_cache.lru.begin(), g_rpc_cache.lru, it->second);
+    g_rpc_cache.hits++;
+    return true;
+}
+
+void RPCCacheStore(const JSONRPCRequest& request, const std::string& result)
+{
+    if (!request.cacheInfo || request.cacheInfo->height < 0) return;
+    const int height = request.cacheInfo->height;
+
+    // the block must still be the one the result was computed from
+    const std::shared_ptr<const ChainTipSnapshot> snapshot = GetChainTipSnapshot();
+    const CBlockIndex* pindex = (*snapshot)[height];
+    const CBlockIndex* next = (*snapshot)[height + 1];
+    if (!pindex || !next || pindex->GetBlockHash() != request.cacheInfo->block_hash) return;
+
+    RPCCacheEntry entry;
+    entry.key = RPCCacheKey(request);
+    entry.height = height;
+    entry.next_hash = next->GetBlockHash();
+
+    const size_t next_pos = result.find(NEXTBLOCKHASH_KEY);
+    if (next_pos != std::string::npos && result.compare(next_pos + NEXTBLOCKHASH_KEY.size(), 64, entry.next_hash.GetHex()) != 0) {
+        return;
+    }
+
+    // strings in the result have their quotes escaped, the first match is a key
+    const size_t conf_pos = result.find(CONFIRMATIONS_KEY);
+    entry.has_confirmations = conf_pos != std::string::npos;
+    if (entry.has_confirmations) {
+        const size_t value_pos = conf_pos + CONFIRMATIONS_KEY.size();
+        const size_t value_end = result.find_first_not_of("0123456789", value_pos);
+        if (value_end == value_pos || value_end == std::string::npos) return;
+        entry.prefix = result.substr(0, value_pos);
+        entry.suffix = result.substr(value_end);
+    } else {
+        entry.prefix = result;
+    }
+
+    LOCK(g_rpc_cache.cs);
+    if (snapshot->height - height + 1 < g_rpc_cache.min_depth) return;
+    if (entry.Size() > g_rpc_cache.max_bytes / 8) return;
+    auto it = g_rpc_cache.entries.find(entry.key);
+    if (it != g_rpc_cache.entries.end()) {
+        g_rpc_cache.Erase(it->second);
+    }
+    g_rpc_cache.methods.insert(request.strMethod);
+    g_rpc_cache.bytes += entry.Size();
+    g_rpc_cache.lru.push_front(std::move(entry));
+    g_rpc_cache.entries.emplace(g_rpc_cache.lru.front().key, g_rpc_cache.lru.begin());
+    while (g_rpc_cache.bytes > g_rpc_cache.max_bytes) {
+        g_rpc_cache.Erase(std::prev(g_rpc_cache.lru.end()));
+    }
+}
+
+UniValue RPCCacheInfo()
+{
+    LOCK(g_rpc_cache.cs);
+    UniValue info(UniValue::VOBJ);
+    info.pushKV("entries", (uint64_t)g_rpc_cache.lru.size());
+    info.pushKV("bytes", (uint64_t)g_rpc_cache.bytes);
+    info.pushKV("maxbytes", (uint64_t)g_rpc_cache.max_bytes);
+    info.pushKV("hits", g_rpc_cache.hits);
+    info.pushKV("misses", g_rpc_cache.misses);
+    return info;
+}
@@ -0,0 +1,42 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RPC_CACHE_H
+#define BITCOIN_RPC_CACHE_H
+
+#include <stdint.h>
+#include <string>
+
+class JSONRPCRequest;
+class UniValue;
+
+/** Size of the RPC response cache in MiB, 0 disables it */
+static const int64_t DEFAULT_RPC_CACHE_SIZE = 0;
+/** Confirmations the block of a result needs before the result is cached */
+static const int DEFAULT_RPC_CACHE_DEPTH = 6;
+
+/**
+ * Set up the cache of serialized results of RPC calls on confirmed blocks, see
+ * JSONRPCRequest::SetResultCacheable. max_bytes of 0 disables and empties it.
+ */
+void InitRPCCache(size_t max_bytes, int min_depth);
+
+bool RPCCacheEnabled();
+
+/** Largest written result the cache takes */
+size_t RPCCacheMaxEntrySize();
+
+/**
+ * Look up the written result of a parsed request, with its confirmations brought up to date.
+ * Requests are keyed by method and parameters.
+ */
+bool RPCCacheLookup(const JSONRPCRequest& request, std::string& result);
+
+/** Keep the written result of request when its method marked it cacheable and the block is deep enough */
+void RPCCacheStore(const JSONRPCRequest& request, const std::string& result);
+
+/** Size and hit counts of the cache */
+UniValue RPCCacheInfo();
+
+#endif // BITCOIN_RPC_CACHE_H
@@ -94,6 +94,15 @@ static const CRPCConvertParam vRPCConvertParams[] = {
     { "searchlogs", 1, "toBlock"},
     { "searchlogs", 2, "address"},
     { "searchlogs", 3, "topics"},
+    { "searchlogs", 4, "minconf"},
+    { "searchlogs", 5, "limit"},
+    { "gettokentransfers", 2, "fromBlock"},
+    { "gettokentransfers", 3, "toBlock"},
+    { "gettokentransfers", 4, "limit"},
+    { "listbudgetproposals", 0, "fromBlock"},
+    { "listbudgetproposals", 1, "toBlock"},
+    { "listbudgetvotes", 0, "fromBlock"},
+    { "listbudgetvotes", 1, "toBlock"},
     { "waitforlogs", 0, "fromBlock"},
     { "waitforlogs", 1, "nblocks"},
     { "waitforlogs", 2, "address"},
@@ -119,6 +128,8 @@ static const CRPCConvertParam vRPCConvertParams[] = {
     { "gettransaction", 2, "verbose" },
     { "gettransaction", 3, "waitconf" },
     { "getrawtransaction", 1, "verbose" },
+    { "getrawtransactions", 0, "txids" },
+    { "getrawtransactions", 1, "verbose" },
     { "createrawtransaction", 0, "inputs" },
     { "createrawtransaction", 1, "outputs" },
     { "createrawtransaction", 2, "locktime" },
@@ -155,6 +166,7 @@ static const CRPCConvertParam vRPCConvertParams[] = {
     { "converttopsbt", 2, "iswitness"},
     { "gettxout", 1, "n" },
     { "gettxout", 2, "include_mempool" },
+    { "gettxoutsetinfo", 1, "use_index" },
     { "gettxoutproof", 0, "txids" },
     { "lockunspent", 0, "unlock" },
     { "lockunspent", 1, "transactions" },
@@ -172,6 +184,7 @@ static const CRPCConvertParam vRPCConvertParams[] = {
     { "keypoolrefill", 0, "newsize" },
     { "getrawmempool", 0, "verbose" },
     { "estimatesmartfee", 0, "conf_target" },
+    { "estimategasprice", 0, "conf_target" },
     { "estimaterawfee", 0, "conf_target" },
     { "estimaterawfee", 1, "threshold" },
     { "prioritisetransaction", 1, "dummy" },
@@ -185,6 +198,9 @@ static const CRPCConvertParam vRPCConvertParams[] = {
     { "bumpfee", 1, "options" },
     { "logging", 0, "include" },
     { "logging", 1, "exclude" },
+    { "getlockstats", 0, "reset" },
+    { "getvalidationqueueinfo", 0, "reset" },
+    { "getdbcompactioninfo", 0, "reset" },
     { "disconnectnode", 1, "nodeid" },
     { "createcontract", 0, "bytecode" },
     { "createcontract", 1, "gasLimit" },
@@ -205,15 +221,26 @@ static const CRPCConvertParam vRPCConvertParams[] = {
     { "callcontract", 2, "senderAddress" },
     { "callcontract", 3, "gasLimit" },
     { "callcontract", 4, "blockNum" },
+    { "callcontractbatch", 0, "calls" },
+    { "callcontractbatch", 1, "blockNum" },
+    { "estimategas", 3, "amount" },
+    { "estimategas", 4, "gasLimit" },
+    { "estimategas", 5, "blockNum" },
     { "reservebalance", 0, "reserve"},
     { "reservebalance", 1, "amount"},
     { "listcontracts", 0, "start" },
     { "listcontracts", 1, "maxDisplay" },
+    { "listcontracts", 2, "fromBlock" },
+    { "listcontracts", 3, "toBlock" },
     { "listallcontracts", 0, "height" },
     { "getcontractcode", 1, "blockNum" },
+    { "getaccountinfo", 1, "storage" },
     { "getstorage", 0, "address" },
     { "getstorage", 1, "index" },
     { "getstorage", 2, "blockNum" },
+    { "getstorage", 3, "limit" },
+    { "getstorageslots", 1, "slots" },
+    { "getstorageslots", 2, "blockNum" },
     { "preciousblock", 0, "blockhash" },
     { "getblockfilter", 0, "blockhash" },
     { "getblockfilter", 1, "filtertype" },
@@ -344,6 +344,128 @@ static UniValue getstakinginfo(const JSONRPCRequest& request)
     return obj;
 }
 
+#ifdef ENABLE_WALLET
+static UniValue StakingLatencyToJSON(const StakingLatency& latency)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("count", latency.nCount);
+    obj.pushKV("average", latency.nCount ? latency.nTotal / (int64_t)latency.nCount / 1000 : 0);
+    obj.pushKV("max", latency.nMax / 1000);
+    UniValue buckets(UniValue::VOBJ);
+    for (size_t i = 0; i < STAKING_LATENCY_BUCKET_COUNT; i++) {
+        buckets.pushKV(i < STAKING_LATENCY_BUCKET_COUNT - 1 ? std::to_string(STAKING_LATENCY_BUCKETS[i]) : "inf", latency.nBuckets[i]);
+    }
+    obj.pushKV("buckets", buckets);
+    return obj;
+}
+#endif
+
+static UniValue getstakingstats(const JSONRPCRequest& request)
+{
+    const std::string latencyHelp =
+        "    \"count\": n,                (numeric) Number of measures\n"
+        "    \"average\": n,              (numeric) Average in milliseconds\n"
+        "    \"max\": n,                  (numeric) Longest in milliseconds\n"
+        "    \"buckets\": {               (json object) Number of measures up to each bound in milliseconds, \"inf\" for the longer ones\n"
+        "      \"10\": n,\n"
+        "      ...\n"
+        "    }\n";
+            RPCHelpMan{"getstakingstats",
+                "\nReturns the counters of the blocks staked with the wallet since it started staking.\n",
+                {},
+                RPCResult{
+                           "{\n"
+                           "  \"staking\": xxx,             (bool) 'true' if the wallet is staking\n"
+                           "  \"kernels\": n,               (numeric) Kernels found that signed a block\n"
+                           "  \"staked\": n,                (numeric) Blocks accepted by CheckStake\n"
+                           "  \"rejected\": n,              (numeric) Blocks refused by CheckStake\n"
+                           "  \"expired\": n,               (numeric) Blocks that took too long to create and expired\n"
+                           "  \"orphaned\": n,              (numeric) Blocks orphaned by another block before their time was valid\n"
+                           "  \"warmtemplates\": n,         (numeric) Blocks filled from the template kept warm in the background\n"
+                           "  \"kerneltostake\": {          (json object) Time from the kernel signing a block to CheckStake\n"
+                           + latencyHelp +
+                           "  },\n"
+                           "  \"createblock\": {            (json object) Time to fill the block with transactions\n"
+                           + latencyHelp +
+                           "  },\n"
+                           "  \"contractexec\": {           (json object) Time executing contracts while filling the block\n"
+                           + latencyHelp +
+                           "  }\n"
+                           "}\n"
+                       },
+                RPCExamples{
+                    HelpExampleCli("getstakingstats", "")
+            + HelpExampleRpc("getstakingstats", "")
+                },
+            }.Check(request);
+
+#ifdef ENABLE_WALLET
+    std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
+    CWallet* const pwallet = wallet.get();
+    if (!pwallet) {
+        throw JSONRPCError(RPC_WALLET_NOT_FOUND, "No wallet is loaded");
+    }
+
+    StakingStats stats;
+    bool staking = GetStakingStats(pwallet, stats);
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("staking", staking);
+    obj.pushKV("kernels", stats.nKernels);
+    obj.pushKV("staked", stats.nStaked);
+    obj.pushKV("rejected", stats.nRejected);
+    obj.pushKV("expired", stats.nExpired);
+    obj.pushKV("orphaned", stats.nOrphaned);
+    obj.pushKV("warmtemplates", stats.nWarmTemplates);
+    obj.pushKV("kerneltostake", StakingLatencyToJSON(stats.kernelToStake));
+    obj.pushKV("createblock", StakingLatencyToJSON(stats.createBlock));
+    obj.pushKV("contractexec", StakingLatencyToJSON(stats.contractExec));
+    return obj;
+#else
+    throw JSONRPCError(RPC_METHOD_NOT_FOUND, "Wallet support is not compiled in");
+#endif
+}
+
+static UniValue getcontractexectimes(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"getcontractexectimes",
+                "\nReturns the execution times of the contract calls the block assembler executed, by contract and by selector.\n"
+                "These predict how long a contract transaction takes when filling a block, the ones that would run past the\n"
+                "time left for contracts are skipped.\n",
+                {},
+                RPCResult{
+                           "[\n"
+                           "  {\n"
+                           "    \"address\": \"hex\",         (string) The contract address, all zeros for contract creations\n"
+                           "    \"selector\": \"hex\",        (string) The first 4 bytes of the call data\n"
+                           "    \"count\": n,               (numeric) Number of executions\n"
+                           "    \"average\": n,             (numeric) Moving average of the execution time in microseconds\n"
+                           "    \"max\": n,                 (numeric) Longest execution time in microseconds\n"
+                           "    \"lasttime\": n             (numeric) Time of the last execution in seconds since epoch\n"
+                           "  }\n"
+                           "  ,...\n"
+                           "]\n"
+                       },
+                RPCExamples{
+                    HelpExampleCli("getcontractexectimes", "")
+            + HelpExampleRpc("getcontractexectimes", "")
+                },
+            }.Check(request);
+
+    UniValue result(UniValue::VARR);
+    for (const auto& entry : g_contract_exec_times.GetAll()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("address", entry.first.first.hex());
+        obj.pushKV("selector", strprintf("%08x", entry.first.second));
+        obj.pushKV("count", entry.second.nCount);
+        obj.pushKV("average", entry.second.nAverage);
+        obj.pushKV("max", entry.second.nMax);
+        obj.pushKV("lasttime", entry.second.nLastTime);
+        result.push_back(obj);
+    }
+    return result;
+}
+
 // NOTE: Unlike wallet RPC (which use BTC values), mining RPCs follow GBT (BIP 22) in using satoshi amounts
 static UniValue prioritisetransaction(const JSONRPCRequest& request)
 {
@@ -621,8 +743,22 @@ static UniValue getblocktemplate(const JSONRPCRequest& request)
     static CBlockIndex* pindexPrev;
     static int64_t nStart;
     static std::unique_ptr<CBlockTemplate> pblocktemplate;
+    // The assembler of pblocktemplate, kept to add the transactions entering the mempool to it
+    static std::unique_ptr<BlockAssembler> assembler;
+    if (pindexPrev == ::ChainActive().Tip() && mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast &&
+        GetTime() - nStart <= BLOCK_TEMPLATE_REBUILD_INTERVAL)
+    {
+        // Clear pindexPrev so future calls make a new block, despite any failures from here on
+        pindexPrev = nullptr;
+
+        unsigned int nTransactionsUpdated = mempool.GetTransactionsUpdated();
+        if (assembler && assembler->UpdateNewBlock(pblocktemplate)) {
+            nTransactionsUpdatedLast = nTransactionsUpdated;
+            pindexPrev = ::ChainActive().Tip();
+        }
+    }
     if (pindexPrev != ::ChainActive().Tip() ||
-        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5))
+        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > BLOCK_TEMPLATE_REBUILD_INTERVAL))
     {
         // Clear pindexPrev so future calls make a new block, despite any failures from here on
         pindexPrev = nullptr;
@@ -634,7 +770,8 @@ static UniValue getblocktemplate(const JSONRPCRequest& request)
 
         // Create new block
         CScript scriptDummy = CScript() << OP_TRUE;
-        pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptDummy, true, ::ChainActive().Tip()->nHeight>=Params().GetConsensus().nLastPOWBlock?true:false);
+        assembler.reset(new BlockAssembler(Params()));
+        pblocktemplate = assembler->CreateNewBlock(scriptDummy, true, ::ChainActive().Tip()->nHeight>=Params().GetConsensus().nLastPOWBlock?true:false);
         if (!pblocktemplate)
             throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
 
@@ -974,6 +1111,61 @@ static UniValue estimatesmartfee(const JSONRPCRequest& request)
     return result;
 }
 
+static UniValue estimategasprice(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"estimategasprice",
+                "\nEstimates the approximate gas price needed for a contract transaction to begin\n"
+                "confirmation within conf_target blocks if possible and return the number of blocks\n"
+                "for which the estimate is valid. The estimate is never below the minimum gas price\n"
+                "set by the DGP.\n",
+                {
+                    {"conf_target", RPCArg::Type::NUM, RPCArg::Optional::NO, "Confirmation target in blocks"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"gasprice\" : x.x,    (numeric, optional) estimate gas price in " + CURRENCY_UNIT + " per gas unit\n"
+            "  \"errors\": [ str... ] (json array of strings, optional) Errors encountered during processing\n"
+            "  \"blocks\" : n         (numeric) block number where estimate was found\n"
+            "}\n"
+            "\n"
+            "The request target will be clamped between 1 and the highest target\n"
+            "gas price estimation is able to return.\n"
+            "An error is returned if not enough contract transactions and blocks\n"
+            "have been observed to make an estimate for any number of blocks.\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("estimategasprice", "6")
+                  + HelpExampleRpc("estimategasprice", "6")
+                },
+            }.Check(request);
+
+    RPCTypeCheck(request.params, {UniValue::VNUM});
+    unsigned int max_target = ::feeEstimator.HighestGasTargetTracked();
+    int target = request.params[0].get_int();
+    if (target < 1 || (unsigned int)target > max_target) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Invalid conf_target, must be between %u - %u", 1, max_target));
+    }
+
+    UniValue result(UniValue::VOBJ);
+    UniValue errors(UniValue::VARR);
+    int returnedTarget = 0;
+    CAmount gasPrice = ::feeEstimator.estimateGasPrice(target, &returnedTarget);
+    if (gasPrice > 0) {
+        std::shared_ptr<const ChainTipSnapshot> snapshot;
+        QtumStateViewPool::Handle view = TipStateView(snapshot);
+        if (!view)
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Chain is not loaded");
+        QtumDGP qtumDGP(*view, const_cast<CBlockIndex*>(snapshot->tip), fGettingValuesDGP);
+        CAmount minGasPrice = qtumDGP.getMinGasPrice(snapshot->height + 1);
+        result.pushKV("gasprice", ValueFromAmount(std::max(gasPrice, minGasPrice)));
+    } else {
+        errors.push_back("Insufficient data or no gas price found");
+        result.pushKV("errors", errors);
+    }
+    result.pushKV("blocks", returnedTarget);
+    return result;
+}
+
 static UniValue estimaterawfee(const JSONRPCRequest& request)
 {
             RPCHelpMan{"estimaterawfee",
@@ -1091,10 +1283,13 @@ static const CRPCCommand commands[] = {
 
     { "mining",             "getsubsidy",             &getsubsidy,             {"height"} },
     { "mining",             "getstakinginfo",         &getstakinginfo,         {} },
+    { "mining",             "getstakingstats",        &getstakingstats,        {} },
+    { "mining",             "getcontractexectimes",   &getcontractexectimes,   {} },
 
     { "generating",         "generatetoaddress",      &generatetoaddress,      {"nblocks","address","maxtries"} },
 
     { "util",               "estimatesmartfee",       &estimatesmartfee,       {"conf_target", "estimate_mode"} },
+    { "util",               "estimategasprice",       &estimategasprice,       {"conf_target"} },
 
     { "hidden",             "estimaterawfee",         &estimaterawfee,         {"conf_target", "threshold"} },
 };
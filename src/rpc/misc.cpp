@@ -3,28 +3,54 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <blockcache.h>
+#include <coins.h>
 #include <crypto/ripemd160.h>
+#include <dbscheduler.h>
 #include <key_io.h>
 #include <httpserver.h>
+#include <memusage.h>
+#include <net.h>
 #include <outputtype.h>
+#include <qtum/qtumstate.h>
+#include <qtum/storageresults.h>
 #include <rpc/blockchain.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <script/descriptor.h>
+#include <sync.h>
+#include <txmempool.h>
 #include <util/system.h>
 #include <util/strencodings.h>
 #include <util/validation.h>
+#include <validation.h>
+#include <validationinterface.h>
 
 #ifdef ENABLE_BITCORE_RPC
-#include <txmempool.h>
-#include <validation.h>
+#include <clientversion.h>
+#include <compat/byteswap.h>
+#include <index/addressindex.h>
+#include <streams.h>
 #endif
 
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <map>
+#include <queue>
 #include <stdint.h>
+#include <thread>
 #include <tuple>
 #ifdef HAVE_MALLOC_INFO
 #include <malloc.h>
 #endif
+#ifdef USE_JEMALLOC
+#include <jemalloc/jemalloc.h>
+#endif
+#ifdef USE_MIMALLOC
+#include <mimalloc.h>
+#endif
 
 #ifdef ENABLE_WALLET
 #include <wallet/wallet.h>
@@ -96,25 +122,119 @@ UniValue getdgpinfo(const JSONRPCRequest& request)
             }.Check(request);
 
 
-    LOCK(cs_main);
+    std::shared_ptr<const ChainTipSnapshot> snapshot;
+    QtumStateViewPool::Handle view = TipStateView(snapshot);
+    if (!view)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Chain is not loaded");
 
-    QtumDGP qtumDGP(globalState.get());
-    DGPFeeRates dgpFeeRates = qtumDGP.getFeeRates(::ChainActive().Height());
+    const int nHeight = snapshot->height;
+    QtumDGP qtumDGP(*view, const_cast<CBlockIndex*>(snapshot->tip));
+    DGPFeeRates dgpFeeRates = qtumDGP.getFeeRates(nHeight);
 
     UniValue obj(UniValue::VOBJ);
-    obj.pushKV("maxblocksize", (uint64_t)qtumDGP.getBlockSize(::ChainActive().Height()));
-    obj.pushKV("mingasprice", (uint64_t)qtumDGP.getMinGasPrice(::ChainActive().Height()));
-    obj.pushKV("blockgaslimit", (uint64_t)qtumDGP.getBlockGasLimit(::ChainActive().Height()));
+    obj.pushKV("maxblocksize", (uint64_t)qtumDGP.getBlockSize(nHeight));
+    obj.pushKV("mingasprice", (uint64_t)qtumDGP.getMinGasPrice(nHeight));
+    obj.pushKV("blockgaslimit", (uint64_t)qtumDGP.getBlockGasLimit(nHeight));
     obj.pushKV("minrelaytxfee", (uint64_t)dgpFeeRates.minRelayTxFee);
     obj.pushKV("incrementalrelayfee", (uint64_t)dgpFeeRates.incrementalRelayFee);
     obj.pushKV("dustrelayfee", (uint64_t)dgpFeeRates.dustRelayFee);
-    obj.pushKV("governancecollateral", (uint64_t)qtumDGP.getGovernanceCollateral(::ChainActive().Height()));
-    obj.pushKV("budgetfee", (uint64_t)qtumDGP.getBudgetFee(::ChainActive().Height()));
+    obj.pushKV("governancecollateral", (uint64_t)qtumDGP.getGovernanceCollateral(nHeight));
+    obj.pushKV("budgetfee", (uint64_t)qtumDGP.getBudgetFee(nHeight));
 
     return obj;
 }
 
 #ifdef ENABLE_BITCORE_RPC
+/** Most threads reading the index entries of the addresses of one query */
+static const size_t MAX_ADDRESS_READ_THREADS = 8;
+
+/** Fewest addresses read by each thread, shorter lists are read on the RPC thread */
+static const size_t ADDRESS_READ_SHARD = 16;
+
+/** Call read for each address of a list, spread over threads for long lists. LevelDB serves the
+ *  reads concurrently. An exception of a read is thrown again once all the threads are done. */
+void readAddressesParallel(size_t nAddresses, const std::function<void(size_t)>& read)
+{
+    size_t nThreads = std::min(MAX_ADDRESS_READ_THREADS, (nAddresses + ADDRESS_READ_SHARD - 1) / ADDRESS_READ_SHARD);
+    if (nThreads <= 1) {
+        for (size_t i = 0; i < nAddresses; i++) {
+            read(i);
+        }
+        return;
+    }
+
+    std::vector<std::exception_ptr> errors(nThreads);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < nThreads; t++) {
+        threads.emplace_back([&, t] {
+            try {
+                for (size_t i = t; i < nAddresses; i += nThreads) {
+                    read(i);
+                }
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+/** Merge lists that are each in order already, comparing only the heads of the lists. At most limit
+ *  items are merged when it is set. Returns whether items were left out. */
+template <typename T, typename Less>
+bool mergeOrdered(const std::vector<std::vector<T> >& lists, Less less, size_t limit, std::vector<T>& merged)
+{
+    // head of each list, the smallest item on top
+    auto later = [&](const std::pair<size_t, size_t>& a, const std::pair<size_t, size_t>& b) {
+        return less(lists[b.first][b.second], lists[a.first][a.second]);
+    };
+    std::priority_queue<std::pair<size_t, size_t>, std::vector<std::pair<size_t, size_t> >, decltype(later)> heads(later);
+    for (size_t i = 0; i < lists.size(); i++) {
+        if (!lists[i].empty()) {
+            heads.emplace(i, 0);
+        }
+    }
+
+    size_t nMerged = 0;
+    while (!heads.empty()) {
+        if (limit > 0 && nMerged == limit) {
+            return true;
+        }
+        std::pair<size_t, size_t> head = heads.top();
+        heads.pop();
+        merged.push_back(lists[head.first][head.second]);
+        nMerged++;
+        if (++head.second < lists[head.first].size()) {
+            heads.push(head);
+        }
+    }
+    return false;
+}
+
+/** Wait for the address index to catch up with the active chain, so that queries answer for the tip */
+void waitForAddressIndex()
+{
+    if (!g_addressindex || !g_addressindex->BlockUntilSyncedToCurrentChain()) {
+        return;
+    }
+    // A disconnected tip is only taken out of the index once the queue gets to it
+    bool fAtTip;
+    {
+        LOCK(cs_main);
+        fAtTip = g_addressindex->GetBestBlockIndex() == ::ChainActive().Tip();
+    }
+    if (!fAtTip) {
+        SyncWithValidationInterfaceQueue();
+    }
+}
+
 bool getAddressesFromParams(const UniValue& params, std::vector<std::pair<uint256, int> > &addresses)
 {
     if (params[0].isStr()) {
@@ -159,6 +279,91 @@ bool timestampSort(std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> a,
     return a.second.time < b.second.time;
 }
 
+/** Order of the address index entries of several addresses. The output index is stored little-endian,
+ *  it is compared byte swapped to follow the order of the database. */
+bool addressIndexPositionLess(const std::pair<CAddressIndexKey, CAmount>& a, const std::pair<CAddressIndexKey, CAmount>& b)
+{
+    return std::make_tuple(a.first.blockHeight, a.first.txindex, a.first.txhash, bswap_32((uint32_t)a.first.index), a.first.spending) <
+           std::make_tuple(b.first.blockHeight, b.first.txindex, b.first.txhash, bswap_32((uint32_t)b.first.index), b.first.spending);
+}
+
+void getAddressPageFromParams(const UniValue& params, size_t& limit, bool& reverse, std::unique_ptr<CAddressIndexKey>& cursor)
+{
+    limit = 0;
+    reverse = false;
+    if (!params[0].isObject()) {
+        return;
+    }
+
+    UniValue limitValue = find_value(params[0].get_obj(), "limit");
+    if (limitValue.isNum()) {
+        if (limitValue.get_int() <= 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Limit is expected to be greater than zero");
+        }
+        limit = limitValue.get_int();
+    }
+
+    UniValue reverseValue = find_value(params[0].get_obj(), "reverse");
+    if (reverseValue.isBool()) {
+        reverse = reverseValue.get_bool();
+    }
+
+    UniValue cursorValue = find_value(params[0].get_obj(), "cursor");
+    if (cursorValue.isStr()) {
+        if (limit == 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor is expected with a limit");
+        }
+        if (!IsHex(cursorValue.get_str())) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+        }
+        CDataStream ssCursor(ParseHex(cursorValue.get_str()), SER_DISK, CLIENT_VERSION);
+        cursor.reset(new CAddressIndexKey());
+        try {
+            ssCursor >> *cursor;
+        } catch (const std::exception&) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+        }
+    }
+}
+
+/** Cursor continuing a paged query past an address index position, the address is left out */
+std::string getAddressIndexCursor(int height, unsigned int txindex, const uint256& txhash, size_t index, bool spending)
+{
+    CDataStream ssCursor(SER_DISK, CLIENT_VERSION);
+    ssCursor << CAddressIndexKey(0, uint256(), height, txindex, txhash, index, spending);
+    return HexStr(ssCursor.begin(), ssCursor.end());
+}
+
+/** Read a page of the address index entries of the addresses, merged in height order. Returns whether
+ *  entries may be left past the page. */
+bool getAddressIndexPage(const std::vector<std::pair<uint256, int> >& addresses, int start, int end, const CAddressIndexKey* cursor,
+                         bool reverse, size_t limit, std::vector<std::pair<CAddressIndexKey, CAmount> >& page)
+{
+    std::vector<std::vector<std::pair<CAddressIndexKey, CAmount> > > reads(addresses.size());
+    readAddressesParallel(addresses.size(), [&](size_t i) {
+        if (!GetAddressIndexPage(addresses[i].first, addresses[i].second, start, end, cursor, reverse, limit, reads[i])) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+    });
+
+    bool fMore = false;
+    for (const std::vector<std::pair<CAddressIndexKey, CAmount> >& read : reads) {
+        if (limit > 0 && read.size() == limit) {
+            fMore = true;
+        }
+    }
+
+    bool fLeftOut;
+    if (reverse) {
+        fLeftOut = mergeOrdered(reads, [](const std::pair<CAddressIndexKey, CAmount>& a, const std::pair<CAddressIndexKey, CAmount>& b) {
+            return addressIndexPositionLess(b, a);
+        }, limit, page);
+    } else {
+        fLeftOut = mergeOrdered(reads, addressIndexPositionLess, limit, page);
+    }
+    return fMore || fLeftOut;
+}
+
 bool getAddressFromIndex(const int &type, const uint256 &hash, std::string &address)
 {
     if (type == 2) {
@@ -193,6 +398,9 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
                         {"start", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "The start block height"},
                         {"end", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "The end block height"},
                         {"chainInfo", RPCArg::Type::BOOL, RPCArg::Optional::OMITTED_NAMED_ARG, "Include chain info in results, only applies if start and end specified"},
+                        {"limit", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "The most changes to return, the result is then an object with the deltas and a cursor"},
+                        {"reverse", RPCArg::Type::BOOL, /* default */ "false", "Return the changes from the highest block down"},
+                        {"cursor", RPCArg::Type::STR_HEX, RPCArg::Optional::OMITTED_NAMED_ARG, "The cursor of the previous page, to return the changes following it"},
                     }
                 }
             },
@@ -206,12 +414,19 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         "    \"address\"  (string) The metrix address\n"
         "  }\n"
         "]\n"
+        "or, with a limit\n"
+        "{\n"
+        "  \"deltas\"  (array) The changes, as above\n"
+        "  \"cursor\"  (string) The cursor of the next page, null when there are no more changes\n"
+        "}\n"
             },
             RPCExamples{
                 HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"]}'")
         + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"]}") +
                 HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"], \"start\": 5000, \"end\": 5500, \"chainInfo\": true}'")
-        + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"], \"start\": 5000, \"end\": 5500, \"chainInfo\": true}")
+        + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"], \"start\": 5000, \"end\": 5500, \"chainInfo\": true}") +
+                HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"], \"limit\": 50, \"reverse\": true}'")
+        + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"], \"limit\": 50, \"reverse\": true}")
             },
         }.Check(request);
 
@@ -245,41 +460,27 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
-    }
+    waitForAddressIndex();
 
-    UniValue deltas(UniValue::VARR);
+    size_t limit = 0;
+    bool reverse = false;
+    std::unique_ptr<CAddressIndexKey> cursor;
+    getAddressPageFromParams(request.params, limit, reverse, cursor);
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
-        }
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    bool fMore = getAddressIndexPage(addresses, start, end, cursor.get(), reverse, limit, addressIndex);
 
-        UniValue delta(UniValue::VOBJ);
-        delta.pushKV("satoshis", it->second);
-        delta.pushKV("txid", it->first.txhash.GetHex());
-        delta.pushKV("index", (int)it->first.index);
-        delta.pushKV("blockindex", (int)it->first.txindex);
-        delta.pushKV("height", it->first.blockHeight);
-        delta.pushKV("address", address);
-        deltas.push_back(delta);
+    UniValue nextCursor(UniValue::VNULL);
+    if (fMore && !addressIndex.empty()) {
+        const CAddressIndexKey& last = addressIndex.back().first;
+        nextCursor = getAddressIndexCursor(last.blockHeight, last.txindex, last.txhash, last.index, last.spending);
     }
 
-    UniValue result(UniValue::VOBJ);
-
-    if (includeChainInfo && start > 0 && end > 0) {
+    // the range is checked before anything is written out
+    bool fChainInfo = includeChainInfo && start > 0 && end > 0;
+    UniValue startInfo(UniValue::VOBJ);
+    UniValue endInfo(UniValue::VOBJ);
+    if (fChainInfo) {
         LOCK(cs_main);
 
         if (start > ::ChainActive().Height() || end > ::ChainActive().Height()) {
@@ -289,23 +490,49 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         CBlockIndex* startIndex = ::ChainActive()[start];
         CBlockIndex* endIndex = ::ChainActive()[end];
 
-        UniValue startInfo(UniValue::VOBJ);
-        UniValue endInfo(UniValue::VOBJ);
-
         startInfo.pushKV("hash", startIndex->GetBlockHash().GetHex());
         startInfo.pushKV("height", start);
 
         endInfo.pushKV("hash", endIndex->GetBlockHash().GetHex());
         endInfo.pushKV("height", end);
+    }
 
-        result.pushKV("deltas", deltas);
-        result.pushKV("start", startInfo);
-        result.pushKV("end", endInfo);
+    // the deltas are written out one at a time, a wide range does not build the whole result first
+    RPCResultStream result(request);
+    bool fObject = fChainInfo || limit > 0;
+    if (fObject) {
+        result.beginObject();
+        result.key("deltas");
+    }
+    result.beginArray();
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end() && result.good(); it++) {
+        std::string address;
+        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+        }
 
-        return result;
-    } else {
-        return deltas;
+        UniValue delta(UniValue::VOBJ);
+        delta.pushKV("satoshis", it->second);
+        delta.pushKV("txid", it->first.txhash.GetHex());
+        delta.pushKV("index", (int)it->first.index);
+        delta.pushKV("blockindex", (int)it->first.txindex);
+        delta.pushKV("height", it->first.blockHeight);
+        delta.pushKV("address", address);
+        result.value(delta);
+    }
+    result.endArray();
+
+    if (fObject) {
+        if (fChainInfo) {
+            result.pushKV("start", startInfo);
+            result.pushKV("end", endInfo);
+        }
+        if (limit > 0) {
+            result.pushKV("cursor", nextCursor);
+        }
+        result.endObject();
     }
+    return result.Finish();
 }
 
 UniValue getaddressbalance(const JSONRPCRequest& request)
@@ -322,6 +549,8 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
             "{\n"
             "  \"balance\"  (string) The current balance in satoshis\n"
             "  \"received\"  (string) The total number of satoshis received (including change)\n"
+            "  \"immature\"  (string) The satoshis of the stake outputs that are not mature yet\n"
+            "  \"txcount\"  (numeric) The number of transactions spending from or paying to the addresses\n"
             "}\n"
                 },
                 RPCExamples{
@@ -336,31 +565,48 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
-    }
+    waitForAddressIndex();
 
     CAmount balance = 0;
     CAmount received = 0;
     CAmount immature = 0;
+    int64_t txCount = 0;
+
+    {
+        // Totals and recent entries of the same tip
+        LOCK(cs_main);
+        int nHeight = ::ChainActive().Height();
+
+        std::vector<CAddressBalanceValue> values(addresses.size());
+        std::vector<std::vector<std::pair<CAddressIndexKey, CAmount> > > addressIndexes(addresses.size());
+        readAddressesParallel(addresses.size(), [&](size_t i) {
+            if (!GetAddressBalance(addresses[i].first, addresses[i].second, values[i])) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
+
+            // Only the entries of the blocks not yet mature can be immature stake outputs
+            if (!GetAddressIndex(addresses[i].first, addresses[i].second, addressIndexes[i], std::max(1, nHeight - COINBASE_MATURITY + 1), std::max(1, nHeight))) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
+        });
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+        for (size_t i = 0; i < addresses.size(); i++) {
+            balance += values[i].balance;
+            received += values[i].received;
+            txCount += values[i].txCount;
+
+            for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndexes[i].begin(); it!=addressIndexes[i].end(); it++) {
+                if (it->first.txindex == 1 && ((nHeight - it->first.blockHeight) < COINBASE_MATURITY))
+                    immature += it->second; //immature stake outputs
+            }
         }
-        balance += it->second;
-        if (it->first.txindex == 1 && ((::ChainActive().Height() - it->first.blockHeight) < COINBASE_MATURITY))
-            immature += it->second; //immature stake outputs
     }
 
     UniValue result(UniValue::VOBJ);
     result.pushKV("balance", balance);
     result.pushKV("received", received);
     result.pushKV("immature", immature);
+    result.pushKV("txcount", txCount);
 
     return result;
 }
@@ -415,15 +661,19 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    waitForAddressIndex();
 
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
+    // The outputs of an address are sorted by height on the thread reading them, then merged
+    std::vector<std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > > addressOutputs(addresses.size());
+    readAddressesParallel(addresses.size(), [&](size_t i) {
+        if (!GetAddressUnspent(addresses[i].first, addresses[i].second, addressOutputs[i])) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
-    }
+        std::stable_sort(addressOutputs[i].begin(), addressOutputs[i].end(), heightSort);
+    });
 
-    std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    mergeOrdered(addressOutputs, heightSort, 0, unspentOutputs);
 
     UniValue utxos(UniValue::VARR);
 
@@ -529,7 +779,8 @@ UniValue getaddressmempool(const JSONRPCRequest& request)
 UniValue getblockhashes(const JSONRPCRequest& request)
 {
             RPCHelpMan{"getblockhashes",
-                "\nReturns array of hashes of blocks within the timestamp range provided.\n",
+                "\nReturns array of hashes of blocks within the timestamp range provided.\n"
+                "The blocks of the active chain are found in memory. Blocks of stale forks are only included with -addrindex.\n",
                 {
                     {"high", RPCArg::Type::NUM, RPCArg::Optional::NO, "The newer block timestamp"},
                     {"low", RPCArg::Type::NUM, RPCArg::Optional::NO, "The older block timestamp"},
@@ -576,10 +827,10 @@ UniValue getblockhashes(const JSONRPCRequest& request)
         }
     }
 
-    std::vector<std::pair<uint256, unsigned int> > blockHashes;
+    if (!fActiveOnly)
+        waitForAddressIndex();
 
-    if (fActiveOnly)
-        LOCK(cs_main);
+    std::vector<std::pair<uint256, unsigned int> > blockHashes;
 
     if (!GetTimestampIndex(high, low, fActiveOnly, blockHashes)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for block hashes");
@@ -636,6 +887,8 @@ UniValue getspentinfo(const JSONRPCRequest& request)
     uint256 txid = ParseHashV(txidValue, "txid");
     int outputIndex = indexValue.get_int();
 
+    waitForAddressIndex();
+
     CSpentIndexKey key(txid, outputIndex);
     CSpentIndexValue value;
 
@@ -665,6 +918,9 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
                             },
                             {"start", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "The start block height"},
                             {"end", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "The end block height"},
+                            {"limit", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "The most txids to return, the result is then an object with the txids and a cursor"},
+                            {"reverse", RPCArg::Type::BOOL, /* default */ "false", "Return the txids from the highest block down"},
+                            {"cursor", RPCArg::Type::STR_HEX, RPCArg::Optional::OMITTED_NAMED_ARG, "The cursor of the previous page, to return the txids following it"},
                         }
                     }
                 },
@@ -673,12 +929,19 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
             "  \"transactionid\"  (string) The transaction id\n"
             "  ,...\n"
             "]\n"
+            "or, with a limit\n"
+            "{\n"
+            "  \"txids\"  (array) The transaction ids, as above\n"
+            "  \"cursor\"  (string) The cursor of the next page, null when there are no more txids\n"
+            "}\n"
                 },
                 RPCExamples{
                     HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"]}'")
             + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"]}") +
                     HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"], \"start\": 5000, \"end\": 5500}'")
-            + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"], \"start\": 5000, \"end\": 5500}")
+            + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"], \"start\": 5000, \"end\": 5500}") +
+                    HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"], \"limit\": 50, \"reverse\": true}'")
+            + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"], \"limit\": 50, \"reverse\": true}")
                 },
             }.Check(request);
 
@@ -688,6 +951,8 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    waitForAddressIndex();
+
     int start = 0;
     int end = 0;
     if (request.params[0].isObject()) {
@@ -699,40 +964,48 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
         }
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    size_t limit = 0;
+    bool reverse = false;
+    std::unique_ptr<CAddressIndexKey> cursor;
+    getAddressPageFromParams(request.params, limit, reverse, cursor);
+
+    // The entries of a transaction are next to each other, a page of txids ends past all the entries of its last
+    // transaction. Pages of entries are read until the txids fill the limit.
+    std::vector<uint256> txids;
+    bool fMore = true;
+    bool fFull = false;
+    while (fMore && !fFull && (limit == 0 || txids.size() < limit)) {
+        std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+        fMore = getAddressIndexPage(addresses, start, end, cursor.get(), reverse, limit, addressIndex);
+
+        for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
+            if (!txids.empty() && it->first.txhash == txids.back()) {
+                continue;
             }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            if (limit > 0 && txids.size() == limit) {
+                fFull = true;
+                break;
             }
+            txids.push_back(it->first.txhash);
+            cursor.reset(new CAddressIndexKey(0, uint256(), it->first.blockHeight, it->first.txindex, it->first.txhash,
+                                              reverse ? 0 : std::numeric_limits<uint32_t>::max(), !reverse));
         }
     }
 
-    std::set<std::pair<int, std::string> > txids;
     UniValue result(UniValue::VARR);
-
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        int height = it->first.blockHeight;
-        std::string txid = it->first.txhash.GetHex();
-
-        if (addresses.size() > 1) {
-            txids.insert(std::make_pair(height, txid));
-        } else {
-            if (txids.insert(std::make_pair(height, txid)).second) {
-                result.push_back(txid);
-            }
-        }
+    for (const uint256& txid : txids) {
+        result.push_back(txid.GetHex());
     }
 
-    if (addresses.size() > 1) {
-        for (std::set<std::pair<int, std::string> >::const_iterator it=txids.begin(); it!=txids.end(); it++) {
-            result.push_back(it->second);
+    if (limit > 0) {
+        UniValue page(UniValue::VOBJ);
+        page.pushKV("txids", result);
+        if ((fMore || fFull) && cursor) {
+            page.pushKV("cursor", getAddressIndexCursor(cursor->blockHeight, cursor->txindex, cursor->txhash, cursor->index, cursor->spending));
+        } else {
+            page.pushKV("cursor", NullUniValue);
         }
+        return page;
     }
 
     return result;
@@ -1062,6 +1335,50 @@ static UniValue RPCLockedMemoryInfo()
     return obj;
 }
 
+static UniValue RPCSubsystemMemoryInfo()
+{
+    UniValue obj(UniValue::VOBJ);
+    {
+        LOCK(cs_main);
+        obj.pushKV("coins", uint64_t(pcoinsTip ? pcoinsTip->DynamicMemoryUsage() : 0));
+        const BlockMap& block_index = ::BlockIndex();
+        obj.pushKV("block_index", uint64_t(memusage::DynamicUsage(block_index) + block_index.size() * memusage::MallocUsage(sizeof(CBlockIndex))));
+        obj.pushKV("evm_state", uint64_t(globalState ? globalState->DynamicMemoryUsage() : 0));
+    }
+    obj.pushKV("receipts", uint64_t(pstorageresult ? pstorageresult->DynamicMemoryUsage() : 0));
+    obj.pushKV("mempool", uint64_t(mempool.DynamicMemoryUsage()));
+    obj.pushKV("recent_blocks", uint64_t(g_recent_blocks.DynamicMemoryUsage()));
+    obj.pushKV("net_buffers", uint64_t(g_connman ? g_connman->GetBufferedBytes() : 0));
+    return obj;
+}
+
+static UniValue RPCAllocatorInfo()
+{
+    UniValue obj(UniValue::VOBJ);
+#if defined(USE_JEMALLOC)
+    obj.pushKV("name", "jemalloc");
+    // The statistics are a snapshot taken when the epoch advances
+    uint64_t epoch = 1;
+    size_t len = sizeof(epoch);
+    mallctl("epoch", &epoch, &len, &epoch, len);
+    size_t allocated = 0, resident = 0;
+    len = sizeof(size_t);
+    if (mallctl("stats.allocated", &allocated, &len, nullptr, 0) == 0 && mallctl("stats.resident", &resident, &len, nullptr, 0) == 0) {
+        obj.pushKV("allocated", uint64_t(allocated));
+        obj.pushKV("resident", uint64_t(resident));
+    }
+#elif defined(USE_MIMALLOC)
+    obj.pushKV("name", "mimalloc");
+    size_t elapsed, user, system, rss, peak_rss, commit, peak_commit, faults;
+    mi_process_info(&elapsed, &user, &system, &rss, &peak_rss, &commit, &peak_commit, &faults);
+    obj.pushKV("allocated", uint64_t(commit));
+    obj.pushKV("resident", uint64_t(rss));
+#else
+    obj.pushKV("name", "system");
+#endif
+    return obj;
+}
+
 #ifdef HAVE_MALLOC_INFO
 static std::string RPCMallocInfo()
 {
@@ -1103,6 +1420,20 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
             "    \"locked\": xxxxxx,       (numeric) Amount of bytes that succeeded locking. If this number is smaller than total, locking pages failed at some point and key data could be swapped to disk.\n"
             "    \"chunks_used\": xxxxx,   (numeric) Number allocated chunks\n"
             "    \"chunks_free\": xxxxx,   (numeric) Number unused chunks\n"
+            "  },\n"
+            "  \"subsystems\": {           (json object) Estimated bytes held by the caches and queues of the node\n"
+            "    \"coins\": xxxxx,         (numeric) The UTXO cache, bounded by -dbcache\n"
+            "    \"block_index\": xxxxx,   (numeric) The block index\n"
+            "    \"evm_state\": xxxxx,     (numeric) The account and vin caches of the contract state\n"
+            "    \"receipts\": xxxxx,      (numeric) The transaction receipts pending and cached for reading\n"
+            "    \"mempool\": xxxxx,       (numeric) The memory pool, bounded by -maxmempool\n"
+            "    \"recent_blocks\": xxxxx, (numeric) Deserialized blocks kept for readers, bounded by -recentblockcache\n"
+            "    \"net_buffers\": xxxxx    (numeric) Messages queued to be sent to or processed from the peers\n"
+            "  },\n"
+            "  \"allocator\": {            (json object) The allocator the node was built with\n"
+            "    \"name\": \"name\",       (string) system, jemalloc or mimalloc\n"
+            "    \"allocated\": xxxxx,     (numeric, optional) Bytes allocated by the node, not known for the system allocator\n"
+            "    \"resident\": xxxxx       (numeric, optional) Bytes the allocator keeps resident\n"
             "  }\n"
             "}\n"
                     },
@@ -1120,6 +1451,8 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
     if (mode == "stats") {
         UniValue obj(UniValue::VOBJ);
         obj.pushKV("locked", RPCLockedMemoryInfo());
+        obj.pushKV("subsystems", RPCSubsystemMemoryInfo());
+        obj.pushKV("allocator", RPCAllocatorInfo());
         return obj;
     } else if (mode == "mallocinfo") {
 #ifdef HAVE_MALLOC_INFO
@@ -1132,6 +1465,183 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
     }
 }
 
+static UniValue getlockstats(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"getlockstats",
+                "Returns how long locks were waited for and held, per lock and per place they are taken.\n"
+                "Acquisitions are only counted while the node runs with -lockstats.\n",
+                {
+                    {"reset", RPCArg::Type::BOOL, /* default */ "false", "Clear the statistics after returning them"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"enabled\": true|false,      (boolean) Whether acquisitions are counted\n"
+            "  \"locks\": {                  (json object) The sites of each lock added up\n"
+            "    \"name\": {\n"
+            "      \"acquisitions\": n,      (numeric) Number of times the lock was taken\n"
+            "      \"contentions\": n,       (numeric) Number of times another thread held it\n"
+            "      \"wait_us\": n,           (numeric) Microseconds spent waiting for it\n"
+            "      \"hold_us\": n            (numeric) Microseconds it was held\n"
+            "    }, ...\n"
+            "  },\n"
+            "  \"sites\": [                  (json array) The places locks are taken, longest wait first\n"
+            "    {\n"
+            "      \"lock\": \"name\",         (string) The lock as named at the site\n"
+            "      \"file\": \"file\",         (string) Source file\n"
+            "      \"line\": n,              (numeric) Source line\n"
+            "      \"acquisitions\": n,      (numeric) Number of times the lock was taken here\n"
+            "      \"contentions\": n,       (numeric) Number of times another thread held it\n"
+            "      \"wait_us\": n,           (numeric) Microseconds spent waiting\n"
+            "      \"max_wait_us\": n,       (numeric) Longest single wait\n"
+            "      \"hold_us\": n,           (numeric) Microseconds the lock was held from here\n"
+            "      \"max_hold_us\": n        (numeric) Longest single hold\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getlockstats", "")
+            + HelpExampleCli("getlockstats", "true")
+            + HelpExampleRpc("getlockstats", "")
+                },
+            }.Check(request);
+
+    std::vector<const LockSiteStats*> sites = GetLockSites();
+    std::sort(sites.begin(), sites.end(), [](const LockSiteStats* a, const LockSiteStats* b) { return a->wait_micros > b->wait_micros; });
+
+    struct LockTotals {
+        uint64_t acquisitions = 0;
+        uint64_t contentions = 0;
+        uint64_t wait_micros = 0;
+        uint64_t hold_micros = 0;
+    };
+    std::map<std::string, LockTotals> locks;
+    UniValue sitesArr(UniValue::VARR);
+    for (const LockSiteStats* site : sites) {
+        const uint64_t acquisitions = site->acquisitions;
+        if (acquisitions == 0) continue;
+
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("lock", site->name);
+        entry.pushKV("file", site->file);
+        entry.pushKV("line", site->line);
+        entry.pushKV("acquisitions", acquisitions);
+        entry.pushKV("contentions", site->contentions.load());
+        entry.pushKV("wait_us", site->wait_micros.load());
+        entry.pushKV("max_wait_us", site->max_wait_micros.load());
+        entry.pushKV("hold_us", site->hold_micros.load());
+        entry.pushKV("max_hold_us", site->max_hold_micros.load());
+        sitesArr.push_back(entry);
+
+        // ::cs_main and cs_main are the same lock
+        std::string name = site->name;
+        if (name.compare(0, 2, "::") == 0) name.erase(0, 2);
+        LockTotals& totals = locks[name];
+        totals.acquisitions += acquisitions;
+        totals.contentions += site->contentions;
+        totals.wait_micros += site->wait_micros;
+        totals.hold_micros += site->hold_micros;
+    }
+
+    UniValue locksObj(UniValue::VOBJ);
+    for (const auto& lock : locks) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("acquisitions", lock.second.acquisitions);
+        entry.pushKV("contentions", lock.second.contentions);
+        entry.pushKV("wait_us", lock.second.wait_micros);
+        entry.pushKV("hold_us", lock.second.hold_micros);
+        locksObj.pushKV(lock.first, entry);
+    }
+
+    if (!request.params[0].isNull() && request.params[0].get_bool()) {
+        ResetLockStats();
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("enabled", g_lock_stats.load());
+    obj.pushKV("locks", locksObj);
+    obj.pushKV("sites", sitesArr);
+    return obj;
+}
+
+static UniValue getvalidationqueueinfo(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"getvalidationqueueinfo",
+                "Returns the depth of the validation notification queues. The shared queue hands the events to the\n"
+                "subscribers with queues of their own, such as the wallets and the indexes, and block connection\n"
+                "waits once one of them falls too far behind.\n",
+                {
+                    {"reset", RPCArg::Type::BOOL, /* default */ "false", "Restart the max_pending figures from the current depths"},
+                },
+                RPCResult{
+            "[                        (json array) The shared queue first, then the subscriber queues by name\n"
+            "  {\n"
+            "    \"name\": \"name\",      (string) \"validation\" for the shared queue, else the subscriber\n"
+            "    \"pending\": n,        (numeric) Callbacks waiting to run\n"
+            "    \"max_pending\": n     (numeric) The most callbacks that waited at once\n"
+            "  }, ...\n"
+            "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getvalidationqueueinfo", "")
+            + HelpExampleRpc("getvalidationqueueinfo", "")
+                },
+            }.Check(request);
+
+    const bool reset = !request.params[0].isNull() && request.params[0].get_bool();
+
+    UniValue result(UniValue::VARR);
+    for (const CMainSignals::QueueInfo& queue : GetMainSignals().GetQueueInfo(reset)) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("name", queue.name);
+        entry.pushKV("pending", (uint64_t)queue.pending);
+        entry.pushKV("max_pending", (uint64_t)queue.max_pending);
+        result.push_back(entry);
+    }
+    return result;
+}
+
+static UniValue getdbcompactioninfo(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"getdbcompactioninfo",
+                "Returns the table files the LevelDB databases wrote as they compacted or dumped their memtables, and how long\n"
+                "the writes waited. They wait while the chain state is flushed or the staker submits a block, and for the\n"
+                "-dbcompactionrate budget all databases share.\n",
+                {
+                    {"reset", RPCArg::Type::BOOL, /* default */ "false", "Restart the figures from zero"},
+                },
+                RPCResult{
+            "[                        (json array) The databases in the order they first wrote a table file\n"
+            "  {\n"
+            "    \"name\": \"name\",      (string) The directory of the database, e.g. \"chainstate\" or \"index\"\n"
+            "    \"files\": n,          (numeric) Table files written\n"
+            "    \"bytes\": n,          (numeric) Bytes written to them\n"
+            "    \"deferred_ms\": n,    (numeric) Milliseconds the writes waited for a flush or the staker\n"
+            "    \"throttled_ms\": n    (numeric) Milliseconds the writes waited for the rate budget\n"
+            "  }, ...\n"
+            "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getdbcompactioninfo", "")
+            + HelpExampleRpc("getdbcompactioninfo", "")
+                },
+            }.Check(request);
+
+    const bool reset = !request.params[0].isNull() && request.params[0].get_bool();
+
+    UniValue result(UniValue::VARR);
+    for (const DBCompactionStats& stats : GetDBCompactionStats(reset)) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("name", stats.name);
+        entry.pushKV("files", stats.files);
+        entry.pushKV("bytes", stats.bytes);
+        entry.pushKV("deferred_ms", stats.deferred_ms);
+        entry.pushKV("throttled_ms", stats.throttled_ms);
+        result.push_back(entry);
+    }
+    return result;
+}
+
 static void EnableOrDisableLogCategories(UniValue cats, bool enable) {
     cats = cats.get_array();
     for (unsigned int i = 0; i < cats.size(); ++i) {
@@ -1240,6 +1750,9 @@ static const CRPCCommand commands[] = {
   //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "getmemoryinfo",          &getmemoryinfo,          {"mode"} },
+    { "control",            "getlockstats",           &getlockstats,           {"reset"} },
+    { "control",            "getvalidationqueueinfo", &getvalidationqueueinfo, {"reset"} },
+    { "control",            "getdbcompactioninfo",    &getdbcompactioninfo,    {"reset"} },
     { "control",            "logging",                &logging,                {"include", "exclude"}},
     { "util",               "validateaddress",        &validateaddress,        {"address"} },
     { "util",               "createmultisig",         &createmultisig,         {"nrequired","keys","address_type"} },
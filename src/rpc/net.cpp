@@ -19,6 +19,7 @@
 #include <timedata.h>
 #include <util/strencodings.h>
 #include <util/system.h>
+#include <util/threadaffinity.h>
 #include <validation.h>
 #include <version.h>
 #include <warnings.h>
@@ -110,6 +111,14 @@ static UniValue getpeerinfo(const JSONRPCRequest& request)
             "    ],\n"
             "    \"whitelisted\": true|false, (boolean) Whether the peer is whitelisted\n"
             "    \"minfeefilter\": n,         (numeric) The minimum fee rate for transactions this peer accepts\n"
+            "    \"historicalblockbytes\": n, (numeric) The bytes of historical blocks served to this peer\n"
+            "    \"historicalblockdeferrals\": n, (numeric) The times a historical block waited for -maxpeerblockrate\n"
+            "    \"compression\": {            (json object) Messages compressed with NODE_COMPRESSED\n"
+            "       \"bytessent\": n,           (numeric) The bytes of compressed messages sent\n"
+            "       \"rawbytessent\": n,        (numeric) The bytes they wrap before compression\n"
+            "       \"bytesrecv\": n,           (numeric) The bytes of compressed messages received\n"
+            "       \"rawbytesrecv\": n,        (numeric) The bytes they wrap after decompression\n"
+            "    },\n"
             "    \"bytessent_per_msg\": {\n"
             "       \"msg\": n,               (numeric) The total bytes sent aggregated by message type\n"
             "                               When a message type is not listed in this json object, the bytes sent are 0.\n"
@@ -190,6 +199,14 @@ static UniValue getpeerinfo(const JSONRPCRequest& request)
         }
         obj.pushKV("permissions", permissions);
         obj.pushKV("minfeefilter", ValueFromAmount(stats.minFeeFilter));
+        obj.pushKV("historicalblockbytes", stats.nHistoricalBlockBytes);
+        obj.pushKV("historicalblockdeferrals", stats.nHistoricalBlockDeferrals);
+        UniValue compression(UniValue::VOBJ);
+        compression.pushKV("bytessent", stats.nCompressedBytesSent);
+        compression.pushKV("rawbytessent", stats.nCompressedRawBytesSent);
+        compression.pushKV("bytesrecv", stats.nCompressedBytesRecv);
+        compression.pushKV("rawbytesrecv", stats.nCompressedRawBytesRecv);
+        obj.pushKV("compression", compression);
 
         UniValue sendPerMsgCmd(UniValue::VOBJ);
         for (const auto& i : stats.mapSendBytesPerMsgCmd) {
@@ -479,6 +496,13 @@ static UniValue getnetworkinfo(const JSONRPCRequest& request)
             "  }\n"
             "  ,...\n"
             "  ]\n"
+            "  \"threadaffinity\": {                    (json object) CPUs the threads were pinned to by -threadaffinity\n"
+            "    \"policy\": \"xxxx\",                  (string) the -threadaffinity policy\n"
+            "    \"node\": n,                         (numeric) NUMA node of validation and its memory, -1 when not known\n"
+            "    \"validation\": \"xxxx\",              (string) CPUs of the validation and contract execution threads, like \"0-6\"\n"
+            "    \"staker\": \"xxxx\",                  (string) CPUs of the staker threads\n"
+            "    \"net\": \"xxxx\"                      (string) CPUs of the network and RPC threads\n"
+            "  },\n"
             "  \"warnings\": \"...\"                    (string) any network and blockchain warnings\n"
             "}\n"
                 },
@@ -520,6 +544,14 @@ static UniValue getnetworkinfo(const JSONRPCRequest& request)
         }
     }
     obj.pushKV("localaddresses", localAddresses);
+    const ThreadPlacement placement = util::GetThreadPlacement();
+    UniValue affinity(UniValue::VOBJ);
+    affinity.pushKV("policy", placement.policy);
+    affinity.pushKV("node", placement.validation_node);
+    affinity.pushKV("validation", util::FormatCPUList(placement.validation_cpus));
+    affinity.pushKV("staker", util::FormatCPUList(placement.staker_cpus));
+    affinity.pushKV("net", util::FormatCPUList(placement.net_cpus));
+    obj.pushKV("threadaffinity", affinity);
     obj.pushKV("warnings",       GetWarnings("statusbar"));
     return obj;
 }
@@ -40,6 +40,9 @@
 
 #include <univalue.h>
 
+/** Maximum number of transactions getrawtransactions looks up in one call */
+static constexpr unsigned int MAX_RAW_TRANSACTIONS_BATCH = 1000;
+
 /** Maximum fee rate for sendrawtransaction and testmempoolaccept.
  * By default, a transaction with a fee rate higher than this will be rejected
  * by the RPCs. This can be overridden with the maxfeerate argument.
@@ -47,8 +50,12 @@
 // Metrix: This replaces DEFAULT_MAX_RAW_TX_FEE_RATE to get the fee rates from the DGP
 static CFeeRate DefaultMaxRawTxFeeRate()
 {
-    QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
-    DGPFeeRates dgpFeeRates = qtumDGP.getFeeRates(::ChainActive().Height());
+    std::shared_ptr<const ChainTipSnapshot> snapshot;
+    QtumStateViewPool::Handle view = TipStateView(snapshot);
+    if (!view)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Chain is not loaded");
+    QtumDGP qtumDGP(*view, const_cast<CBlockIndex*>(snapshot->tip), fGettingValuesDGP);
+    DGPFeeRates dgpFeeRates = qtumDGP.getFeeRates(snapshot->height);
     return CFeeRate(10000 * dgpFeeRates.minRelayTxFee);
 }
 
@@ -226,6 +233,39 @@ static UniValue fromhexaddress(const JSONRPCRequest& request) {
     return EncodeDestination(dest);
 }
 
+/** The verbose output of getrawtransaction for a transaction found in the given block, or in the mempool when null */
+static void TxToVerboseJSON(const CTransaction& tx, const uint256& hash_block, UniValue& result)
+{
+#ifdef ENABLE_BITCORE_RPC
+    //////////////////////////////////////////////////////// // qtum
+    int nHeight = 0;
+    int nConfirmations = 0;
+    int nBlockTime = 0;
+    {
+        LOCK(cs_main);
+        BlockMap::iterator mi = ::BlockIndex().find(hash_block);
+        if (mi != ::BlockIndex().end() && (*mi).second) {
+            CBlockIndex* pindex = (*mi).second;
+            if (::ChainActive().Contains(pindex)) {
+                nHeight = pindex->nHeight;
+                nConfirmations = 1 + ::ChainActive().Height() - pindex->nHeight;
+                nBlockTime = pindex->GetBlockTime();
+            } else {
+                nHeight = -1;
+                nConfirmations = 0;
+                nBlockTime = pindex->GetBlockTime();
+            }
+        }
+    }
+    ////////////////////////////////////////////////////////
+
+    result.pushKV("hex", EncodeHexTx(tx, RPCSerializationFlags()));
+    TxToJSONExpanded(tx, hash_block, result, nHeight, nConfirmations, nBlockTime);
+#else
+    TxToJSON(tx, hash_block, result);
+#endif
+}
+
 static UniValue getrawtransaction(const JSONRPCRequest& request)
 {
     RPCHelpMan{
@@ -358,42 +398,84 @@ static UniValue getrawtransaction(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, errmsg + ". Use gettransaction for wallet transactions.");
     }
 
-    if (!fVerbose) {
-        return EncodeHexTx(*tx, RPCSerializationFlags());
+    // a lookup by txid alone may find the transaction in the mempool, only the given block pins the result
+    if (blockindex && in_active_chain) {
+        request.SetResultCacheable(blockindex->GetBlockHash(), blockindex->nHeight);
     }
 
-#ifdef ENABLE_BITCORE_RPC
-    //////////////////////////////////////////////////////// // qtum
-    int nHeight = 0;
-    int nConfirmations = 0;
-    int nBlockTime = 0;
-    {
-        LOCK(cs_main);
-        BlockMap::iterator mi = ::BlockIndex().find(hash_block);
-        if (mi != ::BlockIndex().end() && (*mi).second) {
-            CBlockIndex* pindex = (*mi).second;
-            if (::ChainActive().Contains(pindex)) {
-                nHeight = pindex->nHeight;
-                nConfirmations = 1 + ::ChainActive().Height() - pindex->nHeight;
-                nBlockTime = pindex->GetBlockTime();
-            } else {
-                nHeight = -1;
-                nConfirmations = 0;
-                nBlockTime = pindex->GetBlockTime();
-            }
-        }
+    if (!fVerbose) {
+        return EncodeHexTx(*tx, RPCSerializationFlags());
     }
-    ////////////////////////////////////////////////////////
-#endif
 
     UniValue result(UniValue::VOBJ);
     if (blockindex) result.pushKV("in_active_chain", in_active_chain);
-#ifdef ENABLE_BITCORE_RPC
-    result.pushKV("hex", EncodeHexTx(*tx, RPCSerializationFlags()));
-    TxToJSONExpanded(*tx, hash_block, result, nHeight, nConfirmations, nBlockTime);
-#else
-    TxToJSON(*tx, hash_block, result);
-#endif
+    TxToVerboseJSON(*tx, hash_block, result);
+    return result;
+}
+
+static UniValue getrawtransactions(const JSONRPCRequest& request)
+{
+    RPCHelpMan{
+                "getrawtransactions",
+                "\nReturn the raw data of several transactions at once, from the mempool or with -txindex from the\n"
+                "blockchain. The transactions are looked up in one batch, which is much faster than calling\n"
+                "getrawtransaction for each of them.\n",
+                {
+                    {"txids", RPCArg::Type::ARR, RPCArg::Optional::NO, "A json array of transaction ids",
+                        {
+                            {"txid", RPCArg::Type::STR_HEX, RPCArg::Optional::OMITTED, "A transaction id"},
+                        },
+                    },
+                    {"verbose", RPCArg::Type::BOOL, /* default */ "false", "If false, return strings, otherwise return json objects as getrawtransaction does"},
+                },
+                RPCResult{
+            "[\n"
+            "  \"data\" | {...} | null,  (string or json object) The transaction as getrawtransaction returns it, null if not found\n"
+            "  ,...\n"
+            "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getrawtransactions", "\"[\\\"mytxid\\\",\\\"mytxid2\\\"]\"")
+            + HelpExampleCli("getrawtransactions", "\"[\\\"mytxid\\\",\\\"mytxid2\\\"]\" true")
+            + HelpExampleRpc("getrawtransactions", "[\"mytxid\",\"mytxid2\"], true")
+                },
+    }.Check(request);
+
+    const UniValue& txids = request.params[0].get_array();
+    if (txids.size() > MAX_RAW_TRANSACTIONS_BATCH) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("At most %u transactions can be looked up at once", MAX_RAW_TRANSACTIONS_BATCH));
+    }
+    std::vector<uint256> hashes;
+    hashes.reserve(txids.size());
+    for (size_t i = 0; i < txids.size(); ++i) {
+        hashes.push_back(ParseHashV(txids[i], "txid"));
+    }
+
+    bool fVerbose = false;
+    if (!request.params[1].isNull()) {
+        fVerbose = request.params[1].isNum() ? (request.params[1].get_int() != 0) : request.params[1].get_bool();
+    }
+
+    if (g_txindex) {
+        g_txindex->BlockUntilSyncedToCurrentChain();
+    }
+
+    std::vector<CTransactionRef> txs;
+    std::vector<uint256> block_hashes;
+    GetTransactions(hashes, txs, block_hashes);
+
+    UniValue result(UniValue::VARR);
+    for (size_t i = 0; i < txs.size(); ++i) {
+        if (!txs[i]) {
+            result.push_back(NullUniValue);
+        } else if (!fVerbose) {
+            result.push_back(EncodeHexTx(*txs[i], RPCSerializationFlags()));
+        } else {
+            UniValue entry(UniValue::VOBJ);
+            TxToVerboseJSON(*txs[i], block_hashes[i], entry);
+            result.push_back(entry);
+        }
+    }
     return result;
 }
 
@@ -2074,6 +2156,7 @@ static const CRPCCommand commands[] = {
   //  category              name                            actor (function)            argNames
   //  --------------------- ------------------------        -----------------------     ----------
     { "rawtransactions",    "getrawtransaction",            &getrawtransaction,         {"txid","verbose","blockhash"} },
+    { "rawtransactions",    "getrawtransactions",           &getrawtransactions,        {"txids","verbose"} },
     { "rawtransactions",    "createrawtransaction",         &createrawtransaction,      {"inputs","outputs","locktime","replaceable"} },
     { "rawtransactions",    "decoderawtransaction",         &decoderawtransaction,      {"hexstring","iswitness"} },
     { "rawtransactions",    "decodescript",                 &decodescript,              {"hexstring"} },
@@ -115,10 +115,13 @@ CMutableTransaction ConstructTransaction(const UniValue& inputs_in, const UniVal
                 throw JSONRPCError(RPC_INVALID_PARAMETER, std::string("Invalid parameter, need to be object: ")+name_);
 
             // Get dgp gas limit and gas price
-            LOCK(cs_main);
-            QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
-            uint64_t blockGasLimit = qtumDGP.getBlockGasLimit(::ChainActive().Height());
-            uint64_t minGasPrice = CAmount(qtumDGP.getMinGasPrice(::ChainActive().Height()));
+            std::shared_ptr<const ChainTipSnapshot> snapshot;
+            QtumStateViewPool::Handle view = TipStateView(snapshot);
+            if (!view)
+                throw JSONRPCError(RPC_INTERNAL_ERROR, "Chain is not loaded");
+            QtumDGP qtumDGP(*view, const_cast<CBlockIndex*>(snapshot->tip), fGettingValuesDGP);
+            uint64_t blockGasLimit = qtumDGP.getBlockGasLimit(snapshot->height);
+            uint64_t minGasPrice = CAmount(qtumDGP.getMinGasPrice(snapshot->height));
             CAmount nGasPrice = (minGasPrice>DEFAULT_GAS_PRICE)?minGasPrice:DEFAULT_GAS_PRICE;
 
             bool createContract = Contract.exists("bytecode") && Contract["bytecode"].isStr();
@@ -190,7 +193,7 @@ CMutableTransaction ConstructTransaction(const UniValue& inputs_in, const UniVal
                     throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect contract address");
 
                 dev::Address addrAccount(contractaddress);
-                if(!globalState->addressInUse(addrAccount))
+                if(!view->state().addressInUse(addrAccount))
                     throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "contract address does not exist");
 
                 // Get the contract data
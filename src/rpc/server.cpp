@@ -7,17 +7,22 @@
 
 #include <fs.h>
 #include <key_io.h>
+#include <rpc/cache.h>
 #include <rpc/util.h>
 #include <shutdown.h>
 #include <sync.h>
 #include <util/strencodings.h>
 #include <util/system.h>
 #include <httpserver.h>
+#include <validation.h>
 
 #include <boost/signals2/signal.hpp>
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <memory> // for unique_ptr
 #include <unordered_map>
 
@@ -37,10 +42,65 @@ struct RPCCommandExecutionInfo
     int64_t start;
 };
 
+/** Histogram with power of two buckets, bucket i counts the samples up to 2^i */
+struct RPCHistogram
+{
+    static const int BUCKETS = 40;
+
+    uint64_t count{0};
+    uint64_t total{0};
+    uint64_t max{0};
+    uint64_t buckets[BUCKETS] = {};
+
+    static int Bucket(uint64_t value)
+    {
+        int i = 0;
+        while (i < BUCKETS - 1 && (uint64_t{1} << i) < value) i++;
+        return i;
+    }
+
+    void Add(int64_t sample)
+    {
+        const uint64_t value = std::max<int64_t>(sample, 0);
+        count++;
+        total += value;
+        max = std::max(max, value);
+        buckets[Bucket(value)]++;
+    }
+
+    UniValue ToJSON() const
+    {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("count", count);
+        obj.pushKV("total", total);
+        obj.pushKV("max", max);
+        UniValue counts(UniValue::VOBJ);
+        for (int i = 0; i < BUCKETS; i++) {
+            if (buckets[i]) counts.pushKV(std::to_string(uint64_t{1} << i), buckets[i]);
+        }
+        obj.pushKV("buckets", counts);
+        return obj;
+    }
+};
+
+struct RPCMethodMetrics
+{
+    uint64_t errors{0};
+    /** Microseconds between queueing the HTTP request and running the call */
+    RPCHistogram queue;
+    /** Microseconds spent executing */
+    RPCHistogram execution;
+    /** Microseconds of the execution spent waiting for cs_main */
+    RPCHistogram lockwait;
+    /** Bytes of the reply */
+    RPCHistogram response;
+};
+
 struct RPCServerInfo
 {
     Mutex mutex;
     std::list<RPCCommandExecutionInfo> active_commands GUARDED_BY(mutex);
+    std::map<std::string, RPCMethodMetrics> metrics GUARDED_BY(mutex);
 };
 
 static RPCServerInfo g_rpc_server_info;
@@ -48,18 +108,83 @@ static RPCServerInfo g_rpc_server_info;
 struct RPCCommandExecution
 {
     std::list<RPCCommandExecutionInfo>::iterator it;
-    explicit RPCCommandExecution(const std::string& method)
+    const JSONRPCRequest& request;
+    LockWaitTracker lock_wait;
+    bool failed{true};
+
+    explicit RPCCommandExecution(const JSONRPCRequest& request_in) : request(request_in), lock_wait(&cs_main)
     {
         LOCK(g_rpc_server_info.mutex);
-        it = g_rpc_server_info.active_commands.insert(g_rpc_server_info.active_commands.end(), {method, GetTimeMicros()});
+        it = g_rpc_server_info.active_commands.insert(g_rpc_server_info.active_commands.end(), {request.strMethod, GetTimeMicros()});
     }
     ~RPCCommandExecution()
     {
+        const int64_t now = GetTimeMicros();
         LOCK(g_rpc_server_info.mutex);
+        RPCMethodMetrics& metrics = g_rpc_server_info.metrics[it->method];
+        if (request.nQueueTime >= 0) {
+            metrics.queue.Add(it->start - request.nQueueTime);
+        }
+        metrics.execution.Add(now - it->start);
+        metrics.lockwait.Add(lock_wait.Micros());
+        if (failed) metrics.errors++;
         g_rpc_server_info.active_commands.erase(it);
     }
 };
 
+void RPCRecordResponseSize(const std::string& method, size_t bytes)
+{
+    LOCK(g_rpc_server_info.mutex);
+    auto it = g_rpc_server_info.metrics.find(method);
+    if (it != g_rpc_server_info.metrics.end()) {
+        it->second.response.Add(bytes);
+    }
+}
+
+/** Append a histogram in the Prometheus text format, scaled to the base unit */
+static void PrometheusHistogram(std::string& out, const std::string& name, const std::string& method, const RPCHistogram& hist, double scale)
+{
+    uint64_t cumulative = 0;
+    for (int i = 0; i < RPCHistogram::BUCKETS && cumulative < hist.count; i++) {
+        cumulative += hist.buckets[i];
+        out += strprintf("%s_bucket{method=\"%s\",le=\"%g\"} %u\n", name, method, (uint64_t{1} << i) * scale, cumulative);
+    }
+    out += strprintf("%s_bucket{method=\"%s\",le=\"+Inf\"} %u\n", name, method, hist.count);
+    out += strprintf("%s_sum{method=\"%s\"} %g\n", name, method, hist.total * scale);
+    out += strprintf("%s_count{method=\"%s\"} %u\n", name, method, hist.count);
+}
+
+std::string RPCMetricsPrometheus()
+{
+    LOCK(g_rpc_server_info.mutex);
+    const std::map<std::string, RPCMethodMetrics>& metrics = g_rpc_server_info.metrics;
+    std::string out;
+    out += "# HELP metrix_rpc_errors_total RPC calls that failed\n";
+    out += "# TYPE metrix_rpc_errors_total counter\n";
+    for (const auto& entry : metrics) {
+        out += strprintf("metrix_rpc_errors_total{method=\"%s\"} %u\n", entry.first, entry.second.errors);
+    }
+    const struct {
+        const char* name;
+        const char* help;
+        RPCHistogram RPCMethodMetrics::*hist;
+        double scale;
+    } histograms[] = {
+        {"metrix_rpc_queue_seconds", "Time RPC calls waited for a worker", &RPCMethodMetrics::queue, 1e-6},
+        {"metrix_rpc_execution_seconds", "Time RPC calls spent executing", &RPCMethodMetrics::execution, 1e-6},
+        {"metrix_rpc_lock_wait_seconds", "Time RPC calls waited for cs_main", &RPCMethodMetrics::lockwait, 1e-6},
+        {"metrix_rpc_response_bytes", "Size of RPC replies", &RPCMethodMetrics::response, 1},
+    };
+    for (const auto& hist : histograms) {
+        out += strprintf("# HELP %s %s\n", hist.name, hist.help);
+        out += strprintf("# TYPE %s histogram\n", hist.name);
+        for (const auto& entry : metrics) {
+            PrometheusHistogram(out, hist.name, entry.first, entry.second.*hist.hist, hist.scale);
+        }
+    }
+    return out;
+}
+
 static struct CRPCSignals
 {
     boost::signals2::signal<void ()> Started;
@@ -208,6 +333,13 @@ static UniValue getrpcinfo(const JSONRPCRequest& request)
             "    \"duration\"     (numeric)  The running time in microseconds\n"
             "   },...\n"
             "  ],\n"
+            " \"cache\": {        (object) The response cache of -rpccachesize\n"
+            "  \"entries\": n,     (numeric) Cached results\n"
+            "  \"bytes\": n,       (numeric) Bytes used\n"
+            "  \"maxbytes\": n,    (numeric) Bytes the cache may use\n"
+            "  \"hits\": n,        (numeric) Calls answered from the cache\n"
+            "  \"misses\": n       (numeric) Calls of unknown or reorganized results\n"
+            " },\n"
             " \"logpath\": \"xxx\" (string) The complete file path to the debug log\n"
             "}\n"
                 },
@@ -227,6 +359,7 @@ static UniValue getrpcinfo(const JSONRPCRequest& request)
 
     UniValue result(UniValue::VOBJ);
     result.pushKV("active_commands", active_commands);
+    result.pushKV("cache", RPCCacheInfo());
 
     const std::string path = LogInstance().m_file_path.string();
     UniValue log_path(UniValue::VSTR, path);
@@ -235,12 +368,70 @@ static UniValue getrpcinfo(const JSONRPCRequest& request)
     return result;
 }
 
+static UniValue getrpcmetrics(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"getrpcmetrics",
+                "\nReturns per method statistics of the RPC calls since startup.\n"
+                "Each statistic is a histogram with power of two buckets: the bucket named n counts the samples\n"
+                "greater than n/2 and up to n, the first bucket also counts zeros.\n",
+                {
+                    {"format", RPCArg::Type::STR, /* default */ "json", "\"json\", or \"prometheus\" for a string in the Prometheus text format"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"method\": {           (object) The statistics of a method\n"
+            "    \"errors\": n,        (numeric) Calls that failed\n"
+            "    \"queue\": {          (object) Microseconds between queueing the HTTP request and running the call\n"
+            "      \"count\": n,       (numeric) Number of samples\n"
+            "      \"total\": n,       (numeric) Sum of the samples\n"
+            "      \"max\": n,         (numeric) Largest sample\n"
+            "      \"buckets\": {      (object) Samples per bucket, empty buckets are left out\n"
+            "        \"n\": n,\n"
+            "        ...\n"
+            "      }\n"
+            "    },\n"
+            "    \"execution\": {...}, (object) Microseconds spent executing\n"
+            "    \"lockwait\": {...},  (object) Microseconds of the execution spent waiting for cs_main\n"
+            "    \"response\": {...}   (object) Bytes of the replies, not counted for calls in a batch\n"
+            "  },\n"
+            "  ...\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getrpcmetrics", "")
+                + HelpExampleCli("getrpcmetrics", "prometheus")
+                + HelpExampleRpc("getrpcmetrics", "")},
+            }.Check(request);
+
+    const std::string format = request.params[0].isNull() ? "json" : request.params[0].get_str();
+    if (format == "prometheus") {
+        return RPCMetricsPrometheus();
+    }
+    if (format != "json") {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown format " + format);
+    }
+
+    LOCK(g_rpc_server_info.mutex);
+    UniValue result(UniValue::VOBJ);
+    for (const auto& entry : g_rpc_server_info.metrics) {
+        UniValue method(UniValue::VOBJ);
+        method.pushKV("errors", entry.second.errors);
+        method.pushKV("queue", entry.second.queue.ToJSON());
+        method.pushKV("execution", entry.second.execution.ToJSON());
+        method.pushKV("lockwait", entry.second.lockwait.ToJSON());
+        method.pushKV("response", entry.second.response.ToJSON());
+        result.pushKV(entry.first, method);
+    }
+    return result;
+}
+
 // clang-format off
 static const CRPCCommand vRPCCommands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
     /* Overall control/query calls */
     { "control",            "getrpcinfo",             &getrpcinfo,             {}  },
+    { "control",            "getrpcmetrics",          &getrpcmetrics,          {"format"}  },
     { "control",            "help",                   &help,                   {"command"}  },
     { "control",            "stop",                   &stop,                   {"wait"}  },
     { "control",            "uptime",                 &uptime,                 {}  },
@@ -331,6 +522,7 @@ bool RPCIsInWarmup(std::string *outStatus)
 
 JSONRPCRequest::JSONRPCRequest(HTTPRequest *_req): JSONRPCRequest() {
 	req = _req;
+	nQueueTime = req->GetQueueTime();
 }
 
 bool JSONRPCRequest::PollAlive() {
@@ -357,6 +549,12 @@ void JSONRPCRequest::PollCancel() {
     req->ChunkEnd();
 }
 
+void JSONRPCRequest::PollDefer(std::function<void(std::unique_ptr<HTTPRequest>)> take) {
+    assert(isLongPolling);
+    req->Defer(std::move(take));
+    isDeferred = true;
+}
+
 void JSONRPCRequest::PollReply(const UniValue& result) {
     assert(isLongPolling);
     UniValue reply(UniValue::VOBJ);
@@ -368,6 +566,144 @@ void JSONRPCRequest::PollReply(const UniValue& result) {
     req->ChunkEnd();
 }
 
+void JSONRPCRequest::StreamStart() {
+    assert(!isLongPolling && !isStreaming);
+    req->WriteHeader("Content-Type", "application/json");
+    req->WriteHeader("Connection", "close");
+    const std::string start = "{\"result\":";
+    req->Chunk(start);
+    nStreamedBytes = start.size();
+    isStreaming = true;
+}
+
+void JSONRPCRequest::StreamWrite(const std::string& data) {
+    assert(isStreaming);
+    req->Chunk(data);
+    nStreamedBytes += data.size();
+}
+
+void JSONRPCRequest::StreamEnd() {
+    assert(isStreaming);
+    const std::string end = ",\"error\":null,\"id\":" + id.write() + "}\n";
+    req->Chunk(end);
+    nStreamedBytes += end.size();
+    req->ChunkEnd();
+}
+
+/** Size of the chunks a streamed result is sent in */
+static const size_t RPC_STREAM_CHUNK = 64 * 1024;
+
+RPCResultStream::RPCResultStream(const JSONRPCRequest& request)
+{
+    // the stream writes the reply itself. force cast to non const pointer
+    m_request = request.req ? (JSONRPCRequest*) &request : nullptr;
+    if (m_request) {
+        m_writer.reset(new UniValueStreamWriter([this](const std::string& chunk) {
+            if (!m_started) {
+                m_request->StreamStart();
+                m_started = true;
+            } else if (!m_request->PollAlive()) {
+                return false;
+            }
+            m_request->StreamWrite(chunk);
+            KeepForCache(chunk);
+            return true;
+        }, RPC_STREAM_CHUNK));
+    }
+}
+
+void RPCResultStream::KeepForCache(const std::string& chunk)
+{
+    const std::shared_ptr<RPCResultCacheInfo>& info = m_request->cacheInfo;
+    if (!info || info->height < 0) return;
+    if (info->streamed.size() + chunk.size() > RPCCacheMaxEntrySize()) {
+        // too large to be cached
+        info->height = -1;
+        std::string().swap(info->streamed);
+        return;
+    }
+    info->streamed += chunk;
+}
+
+void RPCResultStream::Add(const UniValue& val)
+{
+    if (m_stack.empty()) {
+        m_result = val;
+    } else if (m_stack.back().isObject()) {
+        m_stack.back().pushKV(m_key, val);
+    } else {
+        m_stack.back().push_back(val);
+    }
+}
+
+void RPCResultStream::beginObject()
+{
+    if (m_writer) return m_writer->beginObject();
+    m_keys.push_back(m_key);
+    m_stack.emplace_back(UniValue::VOBJ);
+}
+
+void RPCResultStream::beginArray()
+{
+    if (m_writer) return m_writer->beginArray();
+    m_keys.push_back(m_key);
+    m_stack.emplace_back(UniValue::VARR);
+}
+
+void RPCResultStream::endObject()
+{
+    if (m_writer) return m_writer->endObject();
+    assert(!m_stack.empty() && m_stack.back().isObject());
+    UniValue val = std::move(m_stack.back());
+    m_stack.pop_back();
+    m_key = m_keys.back();
+    m_keys.pop_back();
+    Add(val);
+}
+
+void RPCResultStream::endArray()
+{
+    if (m_writer) return m_writer->endArray();
+    assert(!m_stack.empty() && m_stack.back().isArray());
+    UniValue val = std::move(m_stack.back());
+    m_stack.pop_back();
+    m_key = m_keys.back();
+    m_keys.pop_back();
+    Add(val);
+}
+
+void RPCResultStream::key(const std::string& key)
+{
+    if (m_writer) return m_writer->key(key);
+    m_key = key;
+}
+
+void RPCResultStream::value(const UniValue& val)
+{
+    if (m_writer) return m_writer->value(val);
+    Add(val);
+}
+
+bool RPCResultStream::good() const
+{
+    return !m_writer || m_writer->good();
+}
+
+UniValue RPCResultStream::Finish()
+{
+    if (!m_writer) {
+        assert(m_stack.empty());
+        return m_result;
+    }
+    m_writer->flush();
+    if (!m_started) {
+        // an empty result still needs its reply
+        m_request->StreamStart();
+    }
+    m_request->StreamEnd();
+    return NullUniValue;
+}
+
 bool IsDeprecatedRPCEnabled(const std::string& method)
 {
     const std::vector<std::string> enabled_methods = gArgs.GetArgs("-deprecatedrpc");
@@ -379,6 +715,9 @@ static UniValue JSONRPCExecOne(JSONRPCRequest jreq, const UniValue& req)
 {
     UniValue rpc_result(UniValue::VOBJ);
 
+    // a batch shares one reply, the calls cannot write to the connection themselves
+    jreq.req = nullptr;
+
     try {
         jreq.parse(req);
 
@@ -398,12 +737,60 @@ static UniValue JSONRPCExecOne(JSONRPCRequest jreq, const UniValue& req)
     return rpc_result;
 }
 
+namespace {
+/**
+ * The calls of a batch, claimed one at a time by the thread handling the request and
+ * by the HTTP workers helping it. The request thread only waits for calls that are
+ * already running, so a batch completes even when no worker is free to help. Helpers
+ * that start after the last call was claimed return without touching the request.
+ */
+struct RPCBatch
+{
+    const JSONRPCRequest jreq;
+    const UniValue& requests;
+    std::vector<UniValue> results;
+    std::atomic<size_t> next{0};
+
+    Mutex cs;
+    std::condition_variable cond;
+    size_t done GUARDED_BY(cs){0};
+
+    RPCBatch(const JSONRPCRequest& jreq_in, const UniValue& requests_in) :
+        jreq(jreq_in), requests(requests_in), results(requests_in.size()) {}
+
+    void Work()
+    {
+        size_t i;
+        while ((i = next++) < results.size()) {
+            results[i] = JSONRPCExecOne(jreq, requests[i]);
+            LOCK(cs);
+            if (++done == results.size()) {
+                cond.notify_all();
+            }
+        }
+    }
+};
+} // namespace
+
 std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq)
 {
-    UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(jreq, vReq[reqIdx]));
+    auto batch = std::make_shared<RPCBatch>(jreq, vReq);
+    const size_t threads = std::max<int64_t>(1, gArgs.GetArg("-rpcbatchthreads", DEFAULT_RPC_BATCH_THREADS));
+    for (size_t i = 1; i < std::min(threads, vReq.size()); i++) {
+        if (!EnqueueHTTPTask([batch] { batch->Work(); })) {
+            break;
+        }
+    }
+    batch->Work();
+    {
+        WAIT_LOCK(batch->cs, lock);
+        while (batch->done < batch->results.size()) {
+            batch->cond.wait(lock);
+        }
+    }
 
+    UniValue ret(UniValue::VARR);
+    ret.push_backV(batch->results);
     return ret.write() + "\n";
 }
 
@@ -483,13 +870,16 @@ static bool ExecuteCommand(const CRPCCommand& command, const JSONRPCRequest& req
 {
     try
     {
-        RPCCommandExecution execution(request.strMethod);
+        RPCCommandExecution execution(request);
         // Execute, convert arguments to array if necessary
+        bool handled;
         if (request.params.isObject()) {
-            return command.actor(transformNamedArguments(request, command.argNames), result, last_handler);
+            handled = command.actor(transformNamedArguments(request, command.argNames), result, last_handler);
         } else {
-            return command.actor(request, result, last_handler);
+            handled = command.actor(request, result, last_handler);
         }
+        execution.failed = false;
+        return handled;
     }
     catch (const std::exception& e)
     {
@@ -12,6 +12,7 @@
 
 #include <list>
 #include <map>
+#include <memory>
 #include <stdint.h>
 #include <string>
 #include <functional>
@@ -22,6 +23,8 @@
 #include <util/system.h>
 
 static const unsigned int DEFAULT_RPC_SERIALIZE_VERSION = 1;
+/** Default for -rpcbatchthreads, the threads one batch request may use including its own */
+static const int DEFAULT_RPC_BATCH_THREADS = 4;
 
 struct CUpdatedBlock
 {
@@ -42,12 +45,25 @@ namespace RPCServer
     void OnStopped(std::function<void ()> slot);
 }
 
+/** What a method tells about the cacheability of its result, see JSONRPCRequest::SetResultCacheable */
+struct RPCResultCacheInfo
+{
+    uint256 block_hash;
+    int height{-1};
+    /** The streamed result, kept for the cache */
+    std::string streamed;
+};
+
 class JSONRPCRequest : public JSONRPCRequestBase
 {
 public:
     JSONRPCRequest() : JSONRPCRequestBase() {
         req = NULL;
         isLongPolling = false;
+        isDeferred = false;
+        isStreaming = false;
+        nQueueTime = -1;
+        nStreamedBytes = 0;
     };
 
     JSONRPCRequest(HTTPRequest *_req);
@@ -77,12 +93,112 @@ public:
      */
     void PollReply(const UniValue& result);
 
+    /**
+     * Keep a long poll open after the handler returns, freeing the worker thread.
+     * take receives ownership of the HTTP request and must eventually reply or cancel.
+     */
+    void PollDefer(std::function<void(std::unique_ptr<HTTPRequest>)> take);
+
+    /**
+     * Start a reply whose result is written piece by piece with StreamWrite,
+     * so a large result does not have to be built in memory first.
+     */
+    void StreamStart();
+
+    void StreamWrite(const std::string& data);
+
+    /**
+     * Close the result and the reply object. The handler has replied by itself then.
+     */
+    void StreamEnd();
+
     bool isLongPolling;
 
+    bool isDeferred;
+
+    bool isStreaming;
+
+    /** When the HTTP request was queued for a worker, in microseconds. -1 without one */
+    int64_t nQueueTime;
+
+    /** Bytes of the reply written by the Stream functions */
+    size_t nStreamedBytes;
+
+    /** Set when the result may be cached, shared by the copies of the request */
+    std::shared_ptr<RPCResultCacheInfo> cacheInfo;
+
+    /**
+     * Mark the result as computed from the block at height of the active chain only. It stays the
+     * same while that block and the next one stay in the active chain, apart from a top level
+     * confirmations field. Results of blocks still near the tip are not cached.
+     */
+    void SetResultCacheable(const uint256& block_hash, int height) const
+    {
+        if (cacheInfo) {
+            cacheInfo->block_hash = block_hash;
+            cacheInfo->height = height;
+        }
+    }
+
     // FIXME: make this private?
     HTTPRequest *req;
 };
 
+/**
+ * The result of an RPC method produced piece by piece. When the request has an HTTP
+ * connection the pieces are streamed out as chunks, so a large result is never held
+ * as a UniValue tree and a string at once. Without one (batches, the GUI console,
+ * tests) they are collected into a UniValue. Nothing is sent before the first flush,
+ * errors thrown until then get a normal error reply.
+ */
+class RPCResultStream
+{
+public:
+    explicit RPCResultStream(const JSONRPCRequest& request);
+    RPCResultStream(const RPCResultStream&) = delete;
+    RPCResultStream& operator=(const RPCResultStream&) = delete;
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+    void key(const std::string& key);
+    void value(const UniValue& val);
+    void pushKV(const std::string& key, const UniValue& val)
+    {
+        this->key(key);
+        value(val);
+    }
+
+    /** False once the client went away, the remaining result may be skipped */
+    bool good() const;
+
+    /** End the result. Returns what the RPC method returns: the collected result, or null when it was streamed */
+    UniValue Finish();
+
+private:
+    JSONRPCRequest* m_request;
+    std::unique_ptr<UniValueStreamWriter> m_writer;
+    bool m_started{false};
+
+    std::vector<UniValue> m_stack;
+    std::vector<std::string> m_keys;
+    std::string m_key;
+    UniValue m_result;
+
+    void Add(const UniValue& val);
+    void KeepForCache(const std::string& chunk);
+};
+
+/** Count the reply to a call of method in its metrics, see getrpcmetrics */
+void RPCRecordResponseSize(const std::string& method, size_t bytes);
+
+/** The metrics of getrpcmetrics in the Prometheus text format */
+std::string RPCMetricsPrometheus();
+
+/** Serve the RPC metrics on the REST interface */
+static const bool DEFAULT_REST_RPC_METRICS = false;
+
 /** Query whether RPC is running */
 bool IsRPCRunning();
 
@@ -223,6 +339,8 @@ extern double GetEstimatedAnnualROI();
 void StartRPC();
 void InterruptRPC();
 void StopRPC();
+/** Run the calls of a batch request, spread over up to -rpcbatchthreads HTTP workers. The
+ * replies are in request order, the calls themselves may run in any order. */
 std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq);
 
 // Retrieves any serialization flags requested in command line argument
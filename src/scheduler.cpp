@@ -7,6 +7,7 @@
 #include <random.h>
 #include <reverselock.h>
 
+#include <algorithm>
 #include <assert.h>
 #include <utility>
 
@@ -192,6 +193,7 @@ void SingleThreadedSchedulerClient::AddToProcessQueue(std::function<void ()> fun
     {
         LOCK(m_cs_callbacks_pending);
         m_callbacks_pending.emplace_back(std::move(func));
+        m_max_callbacks_pending = std::max(m_max_callbacks_pending, m_callbacks_pending.size());
     }
     MaybeScheduleProcessQueue();
 }
@@ -210,3 +212,10 @@ size_t SingleThreadedSchedulerClient::CallbacksPending() {
     LOCK(m_cs_callbacks_pending);
     return m_callbacks_pending.size();
 }
+
+size_t SingleThreadedSchedulerClient::MaxCallbacksPending(bool reset) {
+    LOCK(m_cs_callbacks_pending);
+    size_t result = m_max_callbacks_pending;
+    if (reset) m_max_callbacks_pending = m_callbacks_pending.size();
+    return result;
+}
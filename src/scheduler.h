@@ -101,6 +101,7 @@ private:
     CCriticalSection m_cs_callbacks_pending;
     std::list<std::function<void ()>> m_callbacks_pending GUARDED_BY(m_cs_callbacks_pending);
     bool m_are_callbacks_running GUARDED_BY(m_cs_callbacks_pending) = false;
+    size_t m_max_callbacks_pending GUARDED_BY(m_cs_callbacks_pending) = 0;
 
     void MaybeScheduleProcessQueue();
     void ProcessQueue();
@@ -121,6 +122,9 @@ public:
     void EmptyQueue();
 
     size_t CallbacksPending();
+
+    // The most callbacks that were pending at once, since the start or the last reset
+    size_t MaxCallbacksPending(bool reset = false);
 };
 
 #endif
@@ -249,19 +249,18 @@ bool CScript::IsBurnt() const
     return false;
 }
 
-bool CScript::IsDGPContractCall(std::vector<unsigned char> vContractAddr, std::vector<unsigned char> vContractData) const
+bool CScript::IsDGPContractCall(const std::vector<unsigned char>& vContractAddr, const std::vector<unsigned char>& vContractData) const
 {
-    if ((*this)[size()-1] == OP_CALL)
+    // Compared in place, most scripts checked here are not calls and nothing is copied for them
+    if (vContractAddr.size() == 20 && size() > 21 && back() == OP_CALL)
     {
-        const std::vector<unsigned char> vCallAddr = std::vector<unsigned char>(this->end() - 21, this->end() - 1);
-        if (vContractAddr != vCallAddr)
+        if (!std::equal(vContractAddr.begin(), vContractAddr.end(), this->end() - 21))
             return false;
 
         int i = this->size() - 22;
-        while (i > 0)
+        while (i > 0 && i >= (int)vContractData.size())
         {
-            const std::vector<unsigned char> vCallData = std::vector<unsigned char>(this->begin() + i - vContractData.size(), this->begin() + i);
-            if (vCallData == vContractData)
+            if (std::equal(vContractData.begin(), vContractData.end(), this->begin() + i - vContractData.size()))
                 return true;
             i -= vContractData.size();
         }
@@ -659,7 +659,7 @@ public:
     ///////////////////////////////////////// metrix
     bool IsBurnt() const;
 
-    bool IsDGPContractCall(std::vector<unsigned char> vContractAddr, std::vector<unsigned char> vContractData) const;
+    bool IsDGPContractCall(const std::vector<unsigned char>& vContractAddr, const std::vector<unsigned char>& vContractData) const;
     /////////////////////////////////////////
 
     void clear()
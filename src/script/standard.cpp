@@ -640,7 +640,7 @@ bool ExtractDestination(const COutPoint& prevout, const CScript& scriptPubKey, C
         return true;
     }
     else if (whichType == TX_CREATE) {
-        addressRet = PKHash(uint160(QtumState::createQtumAddress(uintToh256(prevout.hash), prevout.n).asBytes()));
+        addressRet = PKHash(QtumState::createQtumAddressHash(prevout.hash.begin(), prevout.n));
         return true;
     }
     return false;
@@ -99,6 +99,11 @@ template<typename Stream> inline void ser_writedata64(Stream &s, uint64_t obj)
     obj = htole64(obj);
     s.write((char*)&obj, 8);
 }
+template<typename Stream> inline void ser_writedata64be(Stream &s, uint64_t obj)
+{
+    obj = htobe64(obj);
+    s.write((char*)&obj, 8);
+}
 template<typename Stream> inline uint8_t ser_readdata8(Stream &s)
 {
     uint8_t obj;
@@ -135,6 +140,12 @@ template<typename Stream> inline uint64_t ser_readdata64(Stream &s)
     s.read((char*)&obj, 8);
     return le64toh(obj);
 }
+template<typename Stream> inline uint64_t ser_readdata64be(Stream &s)
+{
+    uint64_t obj;
+    s.read((char*)&obj, 8);
+    return be64toh(obj);
+}
 inline uint64_t ser_double_to_uint64(double x)
 {
     union { double x; uint64_t y; } tmp;
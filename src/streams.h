@@ -8,6 +8,7 @@
 
 #include <support/allocators/zeroafterfree.h>
 #include <serialize.h>
+#include <span.h>
 
 #include <algorithm>
 #include <assert.h>
@@ -195,6 +196,100 @@ public:
     }
 };
 
+/** Minimal stream for reading from an existing byte span without copying it
+ */
+class SpanReader
+{
+private:
+    const int m_type;
+    const int m_version;
+    Span<const unsigned char> m_data;
+
+public:
+
+    /**
+     * @param[in]  type Serialization Type
+     * @param[in]  version Serialization Version (including any flags)
+     * @param[in]  data Referenced byte span to read from
+     */
+    SpanReader(int type, int version, Span<const unsigned char> data)
+        : m_type(type), m_version(version), m_data(data) {}
+
+    template<typename T>
+    SpanReader& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+
+    int GetVersion() const { return m_version; }
+    int GetType() const { return m_type; }
+
+    size_t size() const { return m_data.size(); }
+    bool empty() const { return m_data.size() == 0; }
+
+    void read(char* dst, size_t n)
+    {
+        if (n == 0) {
+            return;
+        }
+        if (n > size()) {
+            throw std::ios_base::failure("SpanReader::read(): end of data");
+        }
+        memcpy(dst, m_data.data(), n);
+        m_data = m_data.subspan(n);
+    }
+
+    void ignore(size_t n)
+    {
+        if (n > size()) {
+            throw std::ios_base::failure("SpanReader::ignore(): end of data");
+        }
+        m_data = m_data.subspan(n);
+    }
+};
+
+/** XOR data with the repeated key, starting at byte key_offset of the key.
+ *
+ * The 8 byte keys of the database obfuscation are applied a 64 bit word at a
+ * time, which is what these values spend most of their deobfuscation in.
+ */
+inline void Xor(Span<char> data, const std::vector<unsigned char>& key, size_t key_offset = 0)
+{
+    if (key.size() == 0) {
+        return;
+    }
+
+    size_t i = 0, j = key_offset % key.size();
+    if (key.size() == sizeof(uint64_t)) {
+        unsigned char rotated[sizeof(uint64_t)];
+        for (size_t k = 0; k < sizeof(uint64_t); k++) {
+            rotated[k] = key[(j + k) % sizeof(uint64_t)];
+        }
+        uint64_t word_key;
+        memcpy(&word_key, rotated, sizeof(word_key));
+        const size_t size = data.size();
+        for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+            uint64_t word;
+            memcpy(&word, data.data() + i, sizeof(word));
+            word ^= word_key;
+            memcpy(data.data() + i, &word, sizeof(word));
+        }
+        // Whole words leave the key index where it was
+    }
+    for (; i < (size_t)data.size(); i++) {
+        data[i] ^= key[j++];
+
+        // This potentially acts on very many bytes of data, so it's
+        // important that we calculate `j`, i.e. the `key` index in this
+        // way instead of doing a %, which would effectively be a division
+        // for each byte Xor'd -- much slower than need be.
+        if (j == key.size())
+            j = 0;
+    }
+}
+
 /** Double ended buffer combining vector and stream-like interfaces.
  *
  * >> and << read and write unformatted data using the above serialization templates.
@@ -475,20 +570,7 @@ public:
      */
     void Xor(const std::vector<unsigned char>& key)
     {
-        if (key.size() == 0) {
-            return;
-        }
-
-        for (size_type i = 0, j = 0; i != size(); i++) {
-            vch[i] ^= key[j++];
-
-            // This potentially acts on very many bytes of data, so it's
-            // important that we calculate `j`, i.e. the `key` index in this
-            // way instead of doing a %, which would effectively be a division
-            // for each byte Xor'd -- much slower than need be.
-            if (j == key.size())
-                j = 0;
-        }
+        ::Xor(Span<char>(vch.data(), size()), key);
     }
 };
 
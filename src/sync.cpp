@@ -18,6 +18,7 @@
 #include <map>
 #include <memory>
 #include <set>
+#include <tuple>
 
 #ifdef DEBUG_LOCKCONTENTION
 #if !defined(HAVE_THREAD_LOCAL)
@@ -30,6 +31,132 @@ void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 }
 #endif /* DEBUG_LOCKCONTENTION */
 
+#if defined(HAVE_THREAD_LOCAL)
+namespace {
+/** The lock whose waits the current thread times, see LockWaitTracker */
+struct LockWaitState {
+    const void* cs = nullptr;
+    int64_t micros = 0;
+};
+thread_local LockWaitState g_lock_wait;
+} // namespace
+
+LockWaitTracker::LockWaitTracker(const void* cs) : m_prev_cs(g_lock_wait.cs), m_prev_micros(g_lock_wait.micros)
+{
+    g_lock_wait.cs = cs;
+    g_lock_wait.micros = 0;
+}
+
+LockWaitTracker::~LockWaitTracker()
+{
+    // a tracker of the same lock further up the stack also counts our waits
+    const int64_t micros = g_lock_wait.cs == m_prev_cs ? g_lock_wait.micros : 0;
+    g_lock_wait.cs = m_prev_cs;
+    g_lock_wait.micros = m_prev_micros + micros;
+}
+
+int64_t LockWaitTracker::Micros() const { return g_lock_wait.micros; }
+
+bool IsLockWaitTracked(const void* cs) { return cs != nullptr && g_lock_wait.cs == cs; }
+
+void AddLockWait(int64_t micros) { g_lock_wait.micros += micros; }
+#else
+LockWaitTracker::LockWaitTracker(const void* cs) : m_prev_cs(nullptr), m_prev_micros(0) {}
+LockWaitTracker::~LockWaitTracker() {}
+int64_t LockWaitTracker::Micros() const { return 0; }
+bool IsLockWaitTracked(const void* cs) { return false; }
+void AddLockWait(int64_t micros) {}
+#endif
+
+std::atomic<bool> g_lock_stats{false};
+
+namespace {
+/** Sites are keyed by their text, __FILE__ of a header differs between translation units */
+typedef std::tuple<std::string, int, std::string> LockSiteKey;
+
+struct LockSiteRegistry {
+    std::mutex mutex;
+    std::map<LockSiteKey, std::unique_ptr<LockSiteStats>> sites;
+};
+LockSiteRegistry& GetLockSiteRegistry()
+{
+    // leaked so that locks taken during static destruction can still be counted
+    static LockSiteRegistry* registry = new LockSiteRegistry();
+    return *registry;
+}
+
+LockSiteStats& LookupLockSite(const char* pszName, const char* pszFile, int nLine)
+{
+    LockSiteRegistry& registry = GetLockSiteRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    std::unique_ptr<LockSiteStats>& stats = registry.sites[LockSiteKey(pszFile, nLine, pszName)];
+    if (!stats) {
+        stats.reset(new LockSiteStats(pszName, pszFile, nLine));
+    }
+    return *stats;
+}
+
+void UpdateMax(std::atomic<uint64_t>& max, uint64_t value)
+{
+    uint64_t prev = max.load(std::memory_order_relaxed);
+    while (prev < value && !max.compare_exchange_weak(prev, value, std::memory_order_relaxed)) {}
+}
+} // namespace
+
+LockSiteStats& GetLockSiteStats(const char* pszName, const char* pszFile, int nLine)
+{
+#if defined(HAVE_THREAD_LOCAL)
+    // the literals of a site do not move, so each thread looks them up once
+    static thread_local std::map<std::tuple<const char*, int, const char*>, LockSiteStats*> cache;
+    LockSiteStats*& stats = cache[std::make_tuple(pszFile, nLine, pszName)];
+    if (!stats) {
+        stats = &LookupLockSite(pszName, pszFile, nLine);
+    }
+    return *stats;
+#else
+    return LookupLockSite(pszName, pszFile, nLine);
+#endif
+}
+
+void RecordLockWait(LockSiteStats& stats, int64_t micros)
+{
+    stats.contentions.fetch_add(1, std::memory_order_relaxed);
+    stats.wait_micros.fetch_add(micros, std::memory_order_relaxed);
+    UpdateMax(stats.max_wait_micros, micros);
+}
+
+void RecordLockHold(LockSiteStats& stats, int64_t micros)
+{
+    stats.hold_micros.fetch_add(micros, std::memory_order_relaxed);
+    UpdateMax(stats.max_hold_micros, micros);
+}
+
+std::vector<const LockSiteStats*> GetLockSites()
+{
+    LockSiteRegistry& registry = GetLockSiteRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    std::vector<const LockSiteStats*> sites;
+    for (const auto& site : registry.sites) {
+        sites.push_back(site.second.get());
+    }
+    return sites;
+}
+
+void ResetLockStats()
+{
+    LockSiteRegistry& registry = GetLockSiteRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (const auto& site : registry.sites) {
+        LockSiteStats& stats = *site.second;
+        stats.acquisitions = 0;
+        stats.contentions = 0;
+        stats.wait_micros = 0;
+        stats.max_wait_micros = 0;
+        stats.hold_micros = 0;
+        stats.max_hold_micros = 0;
+    }
+}
+
 #ifdef DEBUG_LOCKORDER
 //
 // Early deadlock detection.
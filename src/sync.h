@@ -8,9 +8,13 @@
 
 #include <threadsafety.h>
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <stdint.h>
 #include <thread>
 #include <mutex>
+#include <vector>
 
 
 ////////////////////////////////////////////////
@@ -114,30 +118,115 @@ typedef AnnotatedMixin<std::mutex> Mutex;
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/**
+ * Counts how long the current thread waits for a lock held by another thread, while
+ * the tracker lives. Only contended acquisitions of that one lock are timed. Without
+ * thread_local support nothing is counted.
+ */
+class LockWaitTracker
+{
+public:
+    explicit LockWaitTracker(const void* cs);
+    ~LockWaitTracker();
+
+    LockWaitTracker(const LockWaitTracker&) = delete;
+    LockWaitTracker& operator=(const LockWaitTracker&) = delete;
+
+    /** Microseconds waited so far */
+    int64_t Micros() const;
+
+private:
+    const void* m_prev_cs;
+    int64_t m_prev_micros;
+};
+
+/** Whether the current thread times its waits for cs */
+bool IsLockWaitTracked(const void* cs);
+void AddLockWait(int64_t micros);
+
+static const bool DEFAULT_LOCK_STATS = false;
+/** Whether acquisitions through LOCK and friends are profiled, set with -lockstats */
+extern std::atomic<bool> g_lock_stats;
+
+/**
+ * Acquisitions of one lock at one call site while -lockstats is on. The hold
+ * time runs until the end of the scope, so time a WAIT_LOCK spends waiting on
+ * a condition variable is counted as held.
+ */
+struct LockSiteStats
+{
+    LockSiteStats(const char* pszName, const char* pszFile, int nLine) : name(pszName), file(pszFile), line(nLine) {}
+
+    const char* const name;
+    const char* const file;
+    const int line;
+
+    std::atomic<uint64_t> acquisitions{0};
+    //! Acquisitions that had to wait for another thread
+    std::atomic<uint64_t> contentions{0};
+    std::atomic<uint64_t> wait_micros{0};
+    std::atomic<uint64_t> max_wait_micros{0};
+    std::atomic<uint64_t> hold_micros{0};
+    std::atomic<uint64_t> max_hold_micros{0};
+};
+
+/** The statistics of a call site, created on first use and never freed */
+LockSiteStats& GetLockSiteStats(const char* pszName, const char* pszFile, int nLine);
+void RecordLockWait(LockSiteStats& stats, int64_t micros);
+void RecordLockHold(LockSiteStats& stats, int64_t micros);
+/** All call sites seen so far */
+std::vector<const LockSiteStats*> GetLockSites();
+void ResetLockStats();
+
 /** Wrapper around std::unique_lock style lock for Mutex. */
 template <typename Mutex, typename Base = typename Mutex::UniqueLock>
 class SCOPED_LOCKABLE UniqueLock : public Base
 {
 private:
+    //! Set while -lockstats profiles this acquisition
+    LockSiteStats* m_stats{nullptr};
+    std::chrono::steady_clock::time_point m_acquired;
+
+    void Acquired()
+    {
+        m_stats->acquisitions.fetch_add(1, std::memory_order_relaxed);
+        m_acquired = std::chrono::steady_clock::now();
+    }
+
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(Base::mutex()));
-#ifdef DEBUG_LOCKCONTENTION
+        if (g_lock_stats.load(std::memory_order_relaxed)) {
+            m_stats = &GetLockSiteStats(pszName, pszFile, nLine);
+        }
         if (!Base::try_lock()) {
+#ifdef DEBUG_LOCKCONTENTION
             PrintLockContention(pszName, pszFile, nLine);
 #endif
-            Base::lock();
-#ifdef DEBUG_LOCKCONTENTION
+            const bool tracked = IsLockWaitTracked(Base::mutex());
+            if (tracked || m_stats) {
+                const auto start = std::chrono::steady_clock::now();
+                Base::lock();
+                const int64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+                if (tracked) AddLockWait(micros);
+                if (m_stats) RecordLockWait(*m_stats, micros);
+            } else {
+                Base::lock();
+            }
         }
-#endif
+        if (m_stats) Acquired();
     }
 
     bool TryEnter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(Base::mutex()), true);
         Base::try_lock();
-        if (!Base::owns_lock())
+        if (!Base::owns_lock()) {
             LeaveCritical();
+        } else if (g_lock_stats.load(std::memory_order_relaxed)) {
+            m_stats = &GetLockSiteStats(pszName, pszFile, nLine);
+            Acquired();
+        }
         return Base::owns_lock();
     }
 
@@ -163,8 +252,12 @@ public:
 
     ~UniqueLock() UNLOCK_FUNCTION()
     {
-        if (Base::owns_lock())
+        if (Base::owns_lock()) {
+            if (m_stats) {
+                RecordLockHold(*m_stats, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_acquired).count());
+            }
             LeaveCritical();
+        }
     }
 
     operator bool()
@@ -321,6 +321,50 @@ BOOST_AUTO_TEST_CASE(EmptyBlockRoundTripTest)
     }
 }
 
+BOOST_AUTO_TEST_CASE(ProducerTransactionsPrefilledTest)
+{
+    CTxMemPool pool;
+    CBlock block(BuildBlockTestCase());
+
+    // A condensing transaction spends the outputs of a contract with OP_SPEND
+    CMutableTransaction condensing(*block.vtx[2]);
+    condensing.vin[0].scriptSig = CScript() << OP_SPEND;
+    block.vtx[2] = MakeTransactionRef(condensing);
+
+    {
+        CBlockHeaderAndShortTxIDs shortIDs(block, true);
+        BOOST_CHECK_EQUAL(shortIDs.BlockTxCount(), 3U);
+
+        CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+        stream << shortIDs;
+        CBlockHeaderAndShortTxIDs shortIDs2;
+        stream >> shortIDs2;
+
+        PartiallyDownloadedBlock partialBlock(&pool);
+        BOOST_CHECK(partialBlock.InitData(shortIDs2, extra_txn) == READ_STATUS_OK);
+        BOOST_CHECK( partialBlock.IsTxAvailable(0));
+        BOOST_CHECK(!partialBlock.IsTxAvailable(1));
+        BOOST_CHECK( partialBlock.IsTxAvailable(2));
+    }
+
+    // The coinstake of a proof-of-stake block is never in a mempool either
+    block.prevoutStake = block.vtx[1]->vin[0].prevout;
+    {
+        CBlockHeaderAndShortTxIDs shortIDs(block, true);
+
+        CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+        stream << shortIDs;
+        CBlockHeaderAndShortTxIDs shortIDs2;
+        stream >> shortIDs2;
+
+        PartiallyDownloadedBlock partialBlock(&pool);
+        BOOST_CHECK(partialBlock.InitData(shortIDs2, extra_txn) == READ_STATUS_OK);
+        BOOST_CHECK(partialBlock.IsTxAvailable(0));
+        BOOST_CHECK(partialBlock.IsTxAvailable(1));
+        BOOST_CHECK(partialBlock.IsTxAvailable(2));
+    }
+}
+
 BOOST_AUTO_TEST_CASE(TransactionsRequestSerializationTest) {
     BlockTransactionsRequest req1;
     req1.blockhash = InsecureRand256();
@@ -39,6 +39,63 @@ BOOST_AUTO_TEST_CASE(gcsfilter_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(gcsfilter_query_test)
+{
+    // Small and large element sets take the merge and the decoded search paths
+    for (int n_query : {3, 300}) {
+        GCSFilter::ElementSet query_elements;
+        for (int i = 0; i < n_query; ++i) {
+            GCSFilter::Element element(32);
+            element[0] = i;
+            element[1] = i >> 8;
+            element[2] = 1;
+            query_elements.insert(std::move(element));
+        }
+
+        std::vector<GCSFilter> filters;
+        for (int f = 0; f < 64; ++f) {
+            GCSFilter::ElementSet elements;
+            for (int i = 0; i < 20; ++i) {
+                GCSFilter::Element element(32);
+                element[0] = i;
+                element[1] = f;
+                elements.insert(std::move(element));
+            }
+            // every fourth filter holds one of the queried elements
+            if (f % 4 == 0) elements.insert(*query_elements.begin());
+            filters.emplace_back(GCSFilter::Params(f, 0, 10, 1 << 10), elements);
+        }
+
+        const GCSFilterQuery query(query_elements);
+        BOOST_CHECK_EQUAL(query.size(), query_elements.size());
+        std::vector<const GCSFilter*> filter_ptrs;
+        for (const GCSFilter& filter : filters) {
+            filter_ptrs.push_back(&filter);
+        }
+        const std::vector<unsigned char> matches = query.MatchAll(filter_ptrs, 4);
+        BOOST_REQUIRE_EQUAL(matches.size(), filters.size());
+        for (size_t f = 0; f < filters.size(); ++f) {
+            BOOST_CHECK_EQUAL(bool(matches[f]), filters[f].MatchAny(query_elements));
+            BOOST_CHECK_EQUAL(filters[f].MatchAny(query), filters[f].MatchAny(query_elements));
+            if (f % 4 == 0) BOOST_CHECK(matches[f]);
+
+            // the encoding decodes to the same filter
+            GCSFilter decoded(filters[f].GetParams(), filters[f].GetEncoded());
+            BOOST_CHECK_EQUAL(decoded.GetN(), filters[f].GetN());
+        }
+    }
+
+    // excess data is rejected
+    GCSFilter::ElementSet elements;
+    elements.insert(GCSFilter::Element(32, 7));
+    GCSFilter filter({0, 0, 10, 1 << 10}, elements);
+    std::vector<unsigned char> encoded = filter.GetEncoded();
+    encoded.push_back(0);
+    BOOST_CHECK_THROW(GCSFilter(filter.GetParams(), encoded), std::ios_base::failure);
+    encoded.resize(encoded.size() - 2);
+    BOOST_CHECK_THROW(GCSFilter(filter.GetParams(), encoded), std::ios_base::failure);
+}
+
 BOOST_AUTO_TEST_CASE(gcsfilter_default_constructor)
 {
     GCSFilter filter;
@@ -125,6 +182,36 @@ BOOST_AUTO_TEST_CASE(blockfilter_basic_test)
     BOOST_CHECK(default_ctor_block_filter_1.GetEncodedFilter() == default_ctor_block_filter_2.GetEncodedFilter());
 }
 
+BOOST_AUTO_TEST_CASE(blockfilter_evmlog_test)
+{
+    BlockFilterType filter_type;
+    BOOST_CHECK(BlockFilterTypeByName("evmlog", filter_type));
+    BOOST_CHECK(filter_type == BlockFilterType::EVM_LOGS);
+    BOOST_CHECK_EQUAL(BlockFilterTypeName(BlockFilterType::EVM_LOGS), "evmlog");
+
+    // A contract address and a Transfer topic are included, another address is not.
+    GCSFilter::Element address(20, 0x11), topic(32, 0x22), other_address(20, 0x33);
+    GCSFilter::ElementSet elements{address, topic};
+
+    uint256 block_hash = uint256S("0x5c8a0f1fd8a6d9e3a7b1c2e4f6a8b0c2d4e6f8a0b2c4d6e8f0a2b4c6d8e0f2a4");
+    BlockFilter block_filter(BlockFilterType::EVM_LOGS, block_hash, elements);
+    BOOST_CHECK(block_filter.GetFilter().Match(address));
+    BOOST_CHECK(block_filter.GetFilter().Match(topic));
+    BOOST_CHECK(!block_filter.GetFilter().Match(other_address));
+
+    BlockFilter block_filter2;
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << block_filter;
+    stream >> block_filter2;
+
+    BOOST_CHECK(block_filter2.GetFilterType() == BlockFilterType::EVM_LOGS);
+    BOOST_CHECK_EQUAL(block_filter2.GetBlockHash(), block_hash);
+    BOOST_CHECK(block_filter2.GetFilter().Match(address));
+
+    // The log filters are not built from the block outputs.
+    BOOST_CHECK_THROW(BlockFilter(BlockFilterType::EVM_LOGS, CBlock(), CBlockUndo()), std::invalid_argument);
+}
+
 BOOST_AUTO_TEST_CASE(blockfilters_json_test)
 {
     UniValue json;
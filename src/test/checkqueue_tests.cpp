@@ -124,6 +124,62 @@ struct FrozenCleanupCheck {
     void swap(FrozenCleanupCheck& x){std::swap(should_freeze, x.should_freeze);};
 };
 
+struct CountedFailingCheck {
+    static std::atomic<size_t> n_calls;
+    bool fails;
+    CountedFailingCheck(bool _fails) : fails(_fails){};
+    CountedFailingCheck() : fails(false){};
+    bool operator()()
+    {
+        n_calls.fetch_add(1, std::memory_order_relaxed);
+        return !fails;
+    }
+    void swap(CountedFailingCheck& x)
+    {
+        std::swap(fails, x.fails);
+    };
+};
+
+struct ShardCheck {
+    static std::mutex m;
+    static std::unordered_multiset<size_t> results;
+    size_t check_id;
+    ShardCheck(size_t check_id_in) : check_id(check_id_in){};
+    ShardCheck() : check_id(0){};
+    bool operator()()
+    {
+        std::lock_guard<std::mutex> l(m);
+        results.insert(check_id);
+        return true;
+    }
+    void swap(ShardCheck& x) { std::swap(x.check_id, check_id); };
+};
+
+struct LiveCheck {
+    static std::atomic<int64_t> nLive;
+    bool live {false};
+    bool operator()()
+    {
+        // give the master a chance to finish before the workers are done
+        std::this_thread::yield();
+        return true;
+    }
+    LiveCheck(){};
+    LiveCheck(const LiveCheck& x) : live(x.live)
+    {
+        nLive.fetch_add(live, std::memory_order_relaxed);
+    };
+    LiveCheck(bool live_) : live(live_)
+    {
+        nLive.fetch_add(live, std::memory_order_relaxed);
+    };
+    ~LiveCheck()
+    {
+        nLive.fetch_sub(live, std::memory_order_relaxed);
+    };
+    void swap(LiveCheck& x) { std::swap(live, x.live); };
+};
+
 // Static Allocations
 std::mutex FrozenCleanupCheck::m{};
 std::atomic<uint64_t> FrozenCleanupCheck::nFrozen{0};
@@ -132,6 +188,10 @@ std::mutex UniqueCheck::m;
 std::unordered_multiset<size_t> UniqueCheck::results;
 std::atomic<size_t> FakeCheckCheckCompletion::n_calls{0};
 std::atomic<size_t> MemoryCheck::fake_allocated_memory{0};
+std::atomic<size_t> CountedFailingCheck::n_calls{0};
+std::mutex ShardCheck::m;
+std::unordered_multiset<size_t> ShardCheck::results;
+std::atomic<int64_t> LiveCheck::nLive{0};
 
 // Queue Typedefs
 typedef CCheckQueue<FakeCheckCheckCompletion> Correct_Queue;
@@ -140,6 +200,9 @@ typedef CCheckQueue<FailingCheck> Failing_Queue;
 typedef CCheckQueue<UniqueCheck> Unique_Queue;
 typedef CCheckQueue<MemoryCheck> Memory_Queue;
 typedef CCheckQueue<FrozenCleanupCheck> FrozenCleanup_Queue;
+typedef CCheckQueue<CountedFailingCheck> CountedFailing_Queue;
+typedef CCheckQueue<ShardCheck> Shard_Queue;
+typedef CCheckQueue<LiveCheck> Live_Queue;
 
 
 /** This test case checks that the CCheckQueue works properly
@@ -380,6 +443,108 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_FrozenCleanup)
 }
 
 
+// Test that a failure skipping the rest of its checks is not carried over,
+// and the next verification runs every one of its checks again.
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Failure_Reset_Between_Uses)
+{
+    auto queue = MakeUnique<CountedFailing_Queue>(QUEUE_BATCH_SIZE);
+    boost::thread_group tg;
+    for (auto x = 0; x < nScriptCheckThreads; ++x) {
+       tg.create_thread([&]{queue->Thread();});
+    }
+
+    for (auto times = 0; times < 10; ++times) {
+        {
+            CCheckQueueControl<CountedFailingCheck> control(queue.get());
+            for (size_t i = 0; i < 100; ++i) {
+                std::vector<CountedFailingCheck> vChecks(10);
+                vChecks[0] = CountedFailingCheck(i == 0);
+                control.Add(vChecks);
+            }
+            BOOST_REQUIRE(!control.Wait());
+        }
+        CountedFailingCheck::n_calls = 0;
+        {
+            CCheckQueueControl<CountedFailingCheck> control(queue.get());
+            for (size_t i = 0; i < 100; ++i) {
+                std::vector<CountedFailingCheck> vChecks(10);
+                control.Add(vChecks);
+            }
+            BOOST_REQUIRE(control.Wait());
+        }
+        BOOST_REQUIRE_EQUAL(CountedFailingCheck::n_calls, 1000U);
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+// Test that checks spread over all the shards are run exactly once when
+// there are fewer threads than shards, so they have to be stolen.
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Steals_From_All_Shards)
+{
+    for (const unsigned int nWorkers : {0U, 1U, 2U}) {
+        BOOST_REQUIRE(nWorkers + 1 < CHECKQUEUE_SHARDS);
+        auto queue = MakeUnique<Shard_Queue>(QUEUE_BATCH_SIZE);
+        boost::thread_group tg;
+        for (unsigned int x = 0; x < nWorkers; ++x) {
+            tg.create_thread([&]{queue->Thread();});
+        }
+
+        for (const size_t COUNT : {(size_t)CHECKQUEUE_SHARDS, (size_t)1000, (size_t)CHECKQUEUE_SHARDS * QUEUE_BATCH_SIZE * 4}) {
+            ShardCheck::results.clear();
+            size_t total = COUNT;
+            {
+                CCheckQueueControl<ShardCheck> control(queue.get());
+                // small batches go to the next shard in turn, the last large one is split over all of them
+                while (total > COUNT / 2) {
+                    const size_t r = 1 + InsecureRandRange(3);
+                    std::vector<ShardCheck> vChecks;
+                    for (size_t k = 0; k < r && total; k++)
+                        vChecks.emplace_back(--total);
+                    control.Add(vChecks);
+                }
+                std::vector<ShardCheck> vChecks;
+                while (total)
+                    vChecks.emplace_back(--total);
+                control.Add(vChecks);
+                BOOST_REQUIRE(control.Wait());
+            }
+            BOOST_REQUIRE_EQUAL(ShardCheck::results.size(), COUNT);
+            for (size_t i = 0; i < COUNT; ++i)
+                BOOST_REQUIRE_EQUAL(ShardCheck::results.count(i), 1U);
+        }
+        tg.interrupt_all();
+        tg.join_all();
+    }
+}
+
+// Test that Wait() only returns once every check is destroyed, including
+// those the workers still hold when the master runs out of checks.
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Wait_After_Destruction)
+{
+    auto queue = MakeUnique<Live_Queue>(QUEUE_BATCH_SIZE);
+    boost::thread_group tg;
+    for (auto x = 0; x < nScriptCheckThreads; ++x) {
+       tg.create_thread([&]{queue->Thread();});
+    }
+
+    for (size_t i = 0; i < 200; ++i) {
+        CCheckQueueControl<LiveCheck> control(queue.get());
+        size_t total = 1 + InsecureRandRange(1000);
+        while (total) {
+            const size_t r = 1 + InsecureRandRange(2);
+            std::vector<LiveCheck> vChecks;
+            for (size_t k = 0; k < r && total; k++, total--)
+                vChecks.emplace_back(true);
+            control.Add(vChecks);
+        }
+        BOOST_REQUIRE(control.Wait());
+        BOOST_REQUIRE_EQUAL(LiveCheck::nLive, 0);
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
 /** Test that CCheckQueueControl is threadsafe */
 BOOST_AUTO_TEST_CASE(test_CheckQueueControl_Locks)
 {
@@ -8,6 +8,7 @@
 #include <script/standard.h>
 #include <streams.h>
 #include <test/setup_common.h>
+#include <txdb.h>
 #include <uint256.h>
 #include <undo.h>
 #include <util/strencodings.h>
@@ -592,7 +593,8 @@ void GetCoinsMapEntry(const CCoinsMap& map, CAmount& value, char& flags)
 
 void WriteCoinsViewEntry(CCoinsView& view, CAmount value, char flags)
 {
-    CCoinsMap map;
+    CCoinsMapMemoryResource resource;
+    CCoinsMap map(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &resource);
     InsertCoinsMapEntry(map, value, flags);
     BOOST_CHECK(view.BatchWrite(map, {}));
 }
@@ -861,4 +863,63 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_cache_base_coin)
+{
+    CCoinsView root;
+    CCoinsViewCacheTest cache{&root};
+    COutPoint outpoint(InsecureRand256(), 0);
+    Coin coin;
+    coin.out.nValue = VALUE1;
+    coin.out.scriptPubKey.assign(uint32_t{56}, 1);
+
+    // A coin read from the base is cached clean, so flushing does not write it back
+    cache.CacheBaseCoin(outpoint, Coin(coin));
+    BOOST_CHECK(cache.HaveCoinInCache(outpoint));
+    BOOST_CHECK_EQUAL(cache.map().at(outpoint).flags, 0);
+    BOOST_CHECK_EQUAL(cache.AccessCoin(outpoint).out.nValue, VALUE1);
+    cache.SelfTest();
+
+    // Entries already in the cache are kept, including their modifications
+    BOOST_CHECK(cache.SpendCoin(outpoint));
+    cache.CacheBaseCoin(outpoint, Coin(coin));
+    BOOST_CHECK(cache.AccessCoin(outpoint).IsSpent());
+    BOOST_CHECK_EQUAL(cache.map().at(outpoint).flags, DIRTY);
+    cache.SelfTest();
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_flush_buffer)
+{
+    CCoinsViewDB db(GetDataDir() / "flushbuffer", 1 << 20, true, true);
+    CCoinsViewFlushBuffer buffer(&db, db);
+    CCoinsViewCacheTest cache{&buffer};
+
+    COutPoint outpoint(InsecureRand256(), 0);
+    Coin coin;
+    coin.out.nValue = VALUE1;
+    coin.out.scriptPubKey.assign(uint32_t{56}, 1);
+    const uint256 block1 = InsecureRand256();
+    cache.AddCoin(outpoint, Coin(coin), false);
+    cache.SetBestBlock(block1);
+
+    // The flushed coin is readable while and after it is written
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    BOOST_CHECK(buffer.HaveCoin(outpoint));
+    BOOST_CHECK(buffer.GetBestBlock() == block1);
+    BOOST_CHECK(buffer.Wait());
+    BOOST_CHECK_EQUAL(buffer.DynamicMemoryUsage(), 0U);
+    BOOST_CHECK(db.HaveCoin(outpoint));
+    BOOST_CHECK(db.GetBestBlock() == block1);
+
+    // Spending it goes through the buffer too
+    const uint256 block2 = InsecureRand256();
+    BOOST_CHECK(cache.SpendCoin(outpoint));
+    cache.SetBestBlock(block2);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(!buffer.HaveCoin(outpoint));
+    BOOST_CHECK(buffer.Wait());
+    BOOST_CHECK(!db.HaveCoin(outpoint));
+    BOOST_CHECK(db.GetBestBlock() == block2);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
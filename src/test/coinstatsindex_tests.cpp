@@ -0,0 +1,75 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/coinstatsindex.h>
+#include <node/coinstats.h>
+#include <script/standard.h>
+#include <test/setup_common.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(coinstatsindex_tests)
+
+static void CheckIndexMatchesCoinsDB(const CoinStatsIndex& index)
+{
+    const CBlockIndex* tip = WITH_LOCK(cs_main, return ::ChainActive().Tip());
+    CCoinsStats index_stats;
+    BOOST_REQUIRE(index.LookUpStats(tip, index_stats));
+
+    ::ChainstateActive().ForceFlushStateToDisk();
+    CCoinsStats scan_stats;
+    BOOST_REQUIRE(GetUTXOStats(WITH_LOCK(cs_main, return &::ChainstateActive().CoinsDB()), scan_stats, CoinStatsHashType::MUHASH));
+
+    BOOST_CHECK_EQUAL(index_stats.hashBlock, scan_stats.hashBlock);
+    BOOST_CHECK_EQUAL(index_stats.nHeight, scan_stats.nHeight);
+    BOOST_CHECK_EQUAL(index_stats.hashSerialized, scan_stats.hashSerialized);
+    BOOST_CHECK_EQUAL(index_stats.nTransactionOutputs, scan_stats.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(index_stats.nBogoSize, scan_stats.nBogoSize);
+    BOOST_CHECK_EQUAL(index_stats.nTotalAmount, scan_stats.nTotalAmount);
+    BOOST_CHECK_EQUAL(index_stats.nContractOutputs, scan_stats.nContractOutputs);
+    BOOST_CHECK_EQUAL(index_stats.nContractAmount, scan_stats.nContractAmount);
+}
+
+BOOST_FIXTURE_TEST_CASE(coinstatsindex_initial_sync, TestChain100Setup)
+{
+    CoinStatsIndex coin_stats_index(1 << 20, true);
+
+    // Nothing can be looked up before the index is started.
+    const CBlockIndex* tip = WITH_LOCK(cs_main, return ::ChainActive().Tip());
+    CCoinsStats stats;
+    BOOST_CHECK(!coin_stats_index.LookUpStats(tip, stats));
+    BOOST_CHECK(!coin_stats_index.BlockUntilSyncedToCurrentChain());
+
+    coin_stats_index.Start();
+
+    // Allow the index to catch up with the block index.
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!coin_stats_index.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        MilliSleep(100);
+    }
+    CheckIndexMatchesCoinsDB(coin_stats_index);
+
+    // New blocks are applied on top of the indexed state.
+    CScript coinbase_script_pub_key = GetScriptForDestination(PKHash(coinbaseKey.GetPubKey()));
+    for (int i = 0; i < 5; i++) {
+        std::vector<CMutableTransaction> no_txns;
+        CreateAndProcessBlock(no_txns, coinbase_script_pub_key);
+        BOOST_CHECK(coin_stats_index.BlockUntilSyncedToCurrentChain());
+    }
+    CheckIndexMatchesCoinsDB(coin_stats_index);
+
+    // shutdown sequence (c.f. Shutdown() in init.cpp)
+    coin_stats_index.Stop();
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+
+    // Rest of shutdown sequence and destructors happen in ~TestingSetup()
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -9,11 +9,13 @@
 #include <crypto/hkdf_sha256_32.h>
 #include <crypto/hmac_sha256.h>
 #include <crypto/hmac_sha512.h>
+#include <crypto/muhash.h>
 #include <crypto/ripemd160.h>
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
 #include <crypto/sha512.h>
 #include <random.h>
+#include <streams.h>
 #include <util/strencodings.h>
 #include <test/setup_common.h>
 
@@ -749,4 +751,115 @@ BOOST_AUTO_TEST_CASE(sha256d64)
     }
 }
 
+BOOST_AUTO_TEST_CASE(sha256dmany)
+{
+    for (int i = 0; i <= 32; ++i) {
+        std::vector<std::vector<unsigned char>> in(i);
+        std::vector<const unsigned char*> inputs;
+        std::vector<size_t> lengths;
+        std::vector<CSHA256> prefixes(i);
+        unsigned char prefix[128];
+        for (int j = 0; j < 128; ++j) {
+            prefix[j] = InsecureRandBits(8);
+        }
+        for (int j = 0; j < i; ++j) {
+            // lengths around the one and two block paddings
+            in[j].resize(InsecureRandRange(200));
+            for (unsigned char& c : in[j]) {
+                c = InsecureRandBits(8);
+            }
+            inputs.push_back(in[j].data());
+            lengths.push_back(in[j].size());
+            prefixes[j].Write(prefix, 64 * (j % 3));
+        }
+        std::vector<unsigned char> out1(32 * i), out2(32 * i), out3(32 * i), out4(32 * i);
+        for (int j = 0; j < i; ++j) {
+            CHash256().Write(inputs[j], lengths[j]).Finalize(out1.data() + 32 * j);
+            CSHA256 sha = prefixes[j];
+            sha.Write(inputs[j], lengths[j]).Finalize(out3.data() + 32 * j);
+            CSHA256().Write(out3.data() + 32 * j, 32).Finalize(out3.data() + 32 * j);
+        }
+        SHA256DMany(out2.data(), inputs.data(), lengths.data(), i);
+        SHA256DMany(out4.data(), prefixes.data(), inputs.data(), lengths.data(), i);
+        BOOST_CHECK(out1 == out2);
+        BOOST_CHECK(out3 == out4);
+    }
+}
+
+static MuHash3072 FromInt(unsigned char i) {
+    unsigned char tmp[32] = {i, 0};
+    return MuHash3072(Span<const unsigned char>(tmp, sizeof(tmp)));
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests)
+{
+    uint256 out;
+
+    for (int iter = 0; iter < 10; ++iter) {
+        uint256 res;
+        int table[4];
+        for (int i = 0; i < 4; ++i) {
+            table[i] = InsecureRandBits(3);
+        }
+        for (int order = 0; order < 4; ++order) {
+            MuHash3072 acc;
+            for (int i = 0; i < 4; ++i) {
+                int t = table[i ^ order];
+                if (t & 4) {
+                    acc /= FromInt(t & 3);
+                } else {
+                    acc *= FromInt(t & 3);
+                }
+            }
+            acc.Finalize(out);
+            if (order == 0) {
+                res = out;
+            } else {
+                BOOST_CHECK(res == out);
+            }
+        }
+
+        MuHash3072 x = FromInt(InsecureRandBits(4)); // x=X
+        MuHash3072 y = FromInt(InsecureRandBits(4)); // x=X, y=Y
+        MuHash3072 z; // x=X, y=Y, z=1
+        z *= x; // x=X, y=Y, z=X
+        z *= y; // x=X, y=Y, z=X*Y
+        y *= x; // x=X, y=Y*X, z=X*Y
+        z /= y; // x=X, y=Y*X, z=1
+        z.Finalize(out);
+
+        uint256 out2;
+        MuHash3072 a;
+        a.Finalize(out2);
+
+        BOOST_CHECK_EQUAL(out, out2);
+    }
+
+    MuHash3072 acc = FromInt(0);
+    acc *= FromInt(1);
+    acc /= FromInt(2);
+    acc.Finalize(out);
+    BOOST_CHECK_EQUAL(out, uint256S("10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a607d5863"));
+
+    MuHash3072 acc2 = FromInt(0);
+    unsigned char tmp[32] = {1, 0};
+    acc2.Insert(Span<const unsigned char>(tmp, sizeof(tmp)));
+    unsigned char tmp2[32] = {2, 0};
+    acc2.Remove(Span<const unsigned char>(tmp2, sizeof(tmp2)));
+    acc2.Finalize(out);
+    BOOST_CHECK_EQUAL(out, uint256S("10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a607d5863"));
+
+    // Serialization keeps both parts of the fraction
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    MuHash3072 serchk = FromInt(1);
+    serchk /= FromInt(2);
+    ss << serchk;
+    BOOST_CHECK_EQUAL(ss.size(), 2 * Num3072::BYTE_SIZE);
+    MuHash3072 deserchk;
+    ss >> deserchk;
+    deserchk *= FromInt(0);
+    deserchk.Finalize(out);
+    BOOST_CHECK_EQUAL(out, uint256S("10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a607d5863"));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
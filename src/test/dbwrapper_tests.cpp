@@ -319,4 +319,39 @@ BOOST_AUTO_TEST_CASE(iterator_string_ordering)
 
 
 
+BOOST_AUTO_TEST_CASE(dbwrapper_options)
+{
+    leveldb::Options options = GetDBOptions("testdb", 1 << 20);
+    BOOST_CHECK(options.filter_policy != nullptr);
+    BOOST_CHECK_EQUAL(options.write_buffer_size, (size_t)(1 << 18));
+    const size_t default_max_file_size = options.max_file_size;
+    FreeDBOptions(options);
+
+    // Settings apply to the database they name only
+    gArgs.ForceSetArg("-dboption", "testdb:maxfilesize=8388608");
+    options = GetDBOptions("testdb", 1 << 20);
+    BOOST_CHECK_EQUAL(options.max_file_size, (size_t)8388608);
+    FreeDBOptions(options);
+    options = GetDBOptions("otherdb", 1 << 20);
+    BOOST_CHECK_EQUAL(options.max_file_size, default_max_file_size);
+    FreeDBOptions(options);
+
+    gArgs.ForceSetArg("-dboption", "testdb:bloombits=0");
+    options = GetDBOptions("testdb", 1 << 20);
+    BOOST_CHECK(options.filter_policy == nullptr);
+    FreeDBOptions(options);
+
+    // Invalid values keep the default
+    gArgs.ForceSetArg("-dboption", "testdb:writebuffer=-1");
+    options = GetDBOptions("testdb", 1 << 20);
+    BOOST_CHECK_EQUAL(options.write_buffer_size, (size_t)(1 << 18));
+    FreeDBOptions(options);
+
+    gArgs.ForceSetArg("-dboption", "testdb:compression=snappy");
+    options = GetDBOptions("testdb", 1 << 20);
+    BOOST_CHECK(options.compression == leveldb::kSnappyCompression);
+    FreeDBOptions(options);
+    gArgs.ForceSetArg("-dboption", "");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -123,4 +123,47 @@ BOOST_AUTO_TEST_CASE(flatfile_flush)
     BOOST_CHECK_EQUAL(fs::file_size(seq.FileName(FlatFilePos(0, 1))), 1);
 }
 
+BOOST_AUTO_TEST_CASE(flatfile_archive)
+{
+    if (!CanArchiveFlatFiles()) return;
+
+    const auto data_dir = GetDataDir();
+    FlatFileSeq seq(data_dir, "a", 16 * 1024);
+
+    // Three frames and a bit, with data that differs between them
+    std::vector<unsigned char> data(3 * FLATFILE_ARCHIVE_FRAME_SIZE + 1000);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (i * 7 + i / 1000) & 0xff;
+    }
+    {
+        CAutoFile file(seq.Open(FlatFilePos(0, 0)), SER_DISK, CLIENT_VERSION);
+        file.write((const char*)data.data(), data.size());
+    }
+
+    BOOST_CHECK(!seq.IsArchived(FlatFilePos(0, 0)));
+    BOOST_CHECK(seq.Archive(FlatFilePos(0, 0)));
+    BOOST_CHECK(seq.IsArchived(FlatFilePos(0, 0)));
+    BOOST_CHECK(!fs::exists(seq.FileName(FlatFilePos(0, 0))));
+
+    // A read across a frame boundary and one to the end of the file
+    const size_t pos = 2 * FLATFILE_ARCHIVE_FRAME_SIZE - 100;
+    {
+        CAutoFile file(seq.Open(FlatFilePos(0, pos), true, 200), SER_DISK, CLIENT_VERSION);
+        std::vector<unsigned char> read(200);
+        file.read((char*)read.data(), read.size());
+        BOOST_CHECK(std::equal(read.begin(), read.end(), data.begin() + pos));
+    }
+    {
+        CAutoFile file(seq.Open(FlatFilePos(0, 0), true), SER_DISK, CLIENT_VERSION);
+        std::vector<unsigned char> read(data.size());
+        file.read((char*)read.data(), read.size());
+        BOOST_CHECK(read == data);
+        char extra;
+        BOOST_CHECK_THROW(file.read(&extra, 1), std::ios_base::failure);
+    }
+
+    // Archived files are not written any more
+    BOOST_CHECK(seq.Open(FlatFilePos(0, 0)) == nullptr);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -125,6 +125,22 @@ BOOST_AUTO_TEST_CASE(key_test1)
         BOOST_CHECK(rkey2  == pubkey2);
         BOOST_CHECK(rkey1C == pubkey1C);
         BOOST_CHECK(rkey2C == pubkey2C);
+
+        // recovery of all candidates of a DER signature
+
+        CPubKeyRecovery recovery(hashMsg, sign1);
+        BOOST_CHECK(recovery.IsValid());
+        bool fFound = false;
+        for (int i = 0; i < 8; i++) {
+            CPubKey rkey, rkeyLax;
+            bool fRecovered = recovery.Recover(i / 2, i % 2, rkey);
+            BOOST_CHECK_EQUAL(fRecovered, rkeyLax.RecoverLaxDER(hashMsg, sign1, i / 2, i % 2));
+            if (fRecovered) {
+                BOOST_CHECK(rkey == rkeyLax);
+                fFound |= rkey == (i % 2 ? pubkey1C : pubkey1);
+            }
+        }
+        BOOST_CHECK(fFound);
     }
 
     // test deterministic signing
@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <policy/exectime.h>
 #include <policy/policy.h>
 #include <txmempool.h>
 #include <util/system.h>
@@ -751,4 +752,34 @@ BOOST_AUTO_TEST_CASE(MempoolAncestryTests)
     BOOST_CHECK_EQUAL(descendants, 6ULL);
 }
 
+BOOST_AUTO_TEST_CASE(ExecTimeLimitTest)
+{
+    // The cost is the observed time, or the time the gas limit is expected to take when longer
+    BOOST_CHECK_EQUAL(GetContractExecCost(0, 250000), (int64_t)(250000 / EXPECTED_GAS_PER_EXEC_MICRO));
+    BOOST_CHECK_EQUAL(GetContractExecCost(1000000, 250000), 1000000);
+
+    const int64_t nLimit = 60 * 1000;
+    const int64_t nStart = 1000 * 1000000LL;
+    ExecTimeBucket bucket;
+    BOOST_CHECK(!bucket.IsFull(nLimit, nStart));
+    bucket.Add(nLimit / 2, nLimit, nStart);
+    BOOST_CHECK(!bucket.IsFull(nLimit, nStart));
+    // The cost that fills the bucket is accepted even when it overflows it
+    bucket.Add(nLimit, nLimit, nStart);
+    BOOST_CHECK(bucket.IsFull(nLimit, nStart));
+    BOOST_CHECK_EQUAL(bucket.GetLevel(), nLimit + nLimit / 2);
+    // It drains at the limit per minute, a millisecond per second here
+    BOOST_CHECK(bucket.IsFull(nLimit, nStart + 30 * 1000000LL));
+    BOOST_CHECK(!bucket.IsFull(nLimit, nStart + 31 * 1000000LL));
+    BOOST_CHECK(!bucket.IsFull(0, nStart));
+
+    SenderExecTimeLimits limits;
+    uint160 sender1(std::vector<unsigned char>(20, 1));
+    uint160 sender2(std::vector<unsigned char>(20, 2));
+    limits.Add(sender1, nLimit, nLimit, nStart);
+    BOOST_CHECK(limits.IsFull(sender1, nLimit, nStart));
+    BOOST_CHECK(!limits.IsFull(sender2, nLimit, nStart));
+    BOOST_CHECK(!limits.IsFull(sender1, nLimit, nStart + 60 * 1000000LL));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -12,10 +12,12 @@
 #include <streams.h>
 #include <net.h>
 #include <netbase.h>
+#include <netcompression.h>
 #include <chainparams.h>
 #include <util/memory.h>
 #include <util/system.h>
 
+#include <limits>
 #include <memory>
 
 class CAddrManSerializationMock : public CAddrMan
@@ -190,6 +192,113 @@ BOOST_AUTO_TEST_CASE(cnode_simple_test)
     BOOST_CHECK(pnode2->fFeeler == false);
 }
 
+BOOST_AUTO_TEST_CASE(cnode_shared_message)
+{
+    CConnman connman(0x1337, 0x1337);
+    CAddress addr(CService(CNetAddr(), 7777), NODE_NETWORK);
+    CNode node1(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", false);
+    CNode node2(1, NODE_NETWORK, 0, INVALID_SOCKET, addr, 1, 1, CAddress(), "", false);
+
+    CSerializedNetMsg msg;
+    msg.command = NetMsgType::PING;
+    msg.data = {1, 2, 3, 4, 5, 6, 7, 8};
+    const CSharedNetMsg shared = connman.ShareMessage(std::move(msg));
+    const size_t header_size = CMessageHeader::HEADER_SIZE;
+    BOOST_CHECK_EQUAL(shared.header->size(), header_size);
+    BOOST_CHECK(std::equal(Params().MessageStart(), Params().MessageStart() + CMessageHeader::MESSAGE_START_SIZE, shared.header->begin()));
+    BOOST_CHECK_EQUAL(shared.data->size(), 8U);
+
+    // Both peers queue the same buffers, nothing is sent on an invalid socket
+    connman.PushMessage(&node1, shared);
+    connman.PushMessage(&node2, shared);
+    for (CNode* pnode : {&node1, &node2}) {
+        LOCK(pnode->cs_vSend);
+        BOOST_CHECK_EQUAL(pnode->vSendMsg.size(), 2U);
+        BOOST_CHECK(pnode->vSendMsg[0] == shared.header);
+        BOOST_CHECK(pnode->vSendMsg[1] == shared.data);
+        BOOST_CHECK_EQUAL(pnode->nSendSize, header_size + 8);
+    }
+
+    // An empty payload queues the header alone
+    CSerializedNetMsg empty;
+    empty.command = NetMsgType::VERACK;
+    connman.PushMessage(&node1, std::move(empty));
+    LOCK(node1.cs_vSend);
+    BOOST_CHECK_EQUAL(node1.vSendMsg.size(), 3U);
+    BOOST_CHECK_EQUAL(node1.vSendMsg[2]->size(), header_size);
+}
+
+BOOST_AUTO_TEST_CASE(compressed_message)
+{
+    if (!CanCompressNetMessages()) return;
+
+    CSerializedNetMsg small;
+    small.command = NetMsgType::TX;
+    small.data.assign(MIN_COMPRESSED_MESSAGE_SIZE - 1, 0);
+    BOOST_CHECK(!CompressNetMessage(small));
+
+    CSerializedNetMsg ping;
+    ping.command = NetMsgType::PING;
+    ping.data.assign(MIN_COMPRESSED_MESSAGE_SIZE * 4, 0);
+    BOOST_CHECK(!CompressNetMessage(ping));
+
+    CSerializedNetMsg msg;
+    msg.command = NetMsgType::BLOCK;
+    for (int i = 0; i < 10000; i++) {
+        msg.data.push_back(i % 7);
+    }
+    const std::vector<unsigned char> raw = msg.data;
+    BOOST_CHECK(CompressNetMessage(msg));
+    BOOST_CHECK_EQUAL(msg.command, NetMsgType::COMPRESSED);
+    BOOST_CHECK(msg.data.size() < raw.size());
+
+    CDataStream stream(msg.data, SER_NETWORK, PROTOCOL_VERSION);
+    std::string command;
+    CDataStream payload(SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK(DecompressNetMessage(stream, command, payload));
+    BOOST_CHECK_EQUAL(command, NetMsgType::BLOCK);
+    BOOST_CHECK(std::equal(raw.begin(), raw.end(), payload.begin()) && payload.size() == raw.size());
+
+    // A payload that expands beyond its declared size is rejected, the header keeps its length
+    std::vector<unsigned char> bad;
+    CVectorWriter{SER_NETWORK, PROTOCOL_VERSION, bad, 0, std::string(NetMsgType::BLOCK), (uint32_t)(raw.size() - 1)};
+    bad.insert(bad.end(), msg.data.begin() + bad.size(), msg.data.end());
+    CDataStream bad_stream(bad, SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK(!DecompressNetMessage(bad_stream, command, payload));
+}
+
+BOOST_AUTO_TEST_CASE(block_serve_bucket)
+{
+    const int64_t rate = 1000;
+    BlockServeBucket bucket;
+
+    // The first refill starts with a full burst
+    bucket.Refill(rate, rate, 1000000);
+    BOOST_CHECK_EQUAL(bucket.nTokens, rate);
+    BOOST_CHECK(bucket.Available());
+
+    // A block above the burst is let through and leaves a debt
+    bucket.Consume(2500);
+    BOOST_CHECK_EQUAL(bucket.nTokens, -1500);
+    BOOST_CHECK(!bucket.Available());
+
+    // The debt is paid back at the rate, time going backwards earns nothing
+    bucket.Refill(rate, rate, 2000000);
+    BOOST_CHECK_EQUAL(bucket.nTokens, -500);
+    bucket.Refill(rate, rate, 1500000);
+    BOOST_CHECK_EQUAL(bucket.nTokens, -500);
+    bucket.Refill(rate, rate, 2500001);
+    BOOST_CHECK_EQUAL(bucket.nTokens, 0);
+    BOOST_CHECK(!bucket.Available());
+    bucket.Refill(rate, rate, 2600001);
+    BOOST_CHECK_EQUAL(bucket.nTokens, 100);
+    BOOST_CHECK(bucket.Available());
+
+    // A long idle time fills the bucket up to the burst only
+    bucket.Refill(rate, rate, std::numeric_limits<int64_t>::max());
+    BOOST_CHECK_EQUAL(bucket.nTokens, rate);
+}
+
 // prior to PR #14728, this test triggers an undefined behavior
 BOOST_AUTO_TEST_CASE(ipv4_peer_with_ipv6_addrMe_test)
 {
@@ -0,0 +1,75 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <memusage.h>
+#include <support/allocators/pool.h>
+#include <test/setup_common.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(pool_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(basic_allocating)
+{
+    PoolResource<8, 8> resource(1024);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+
+    // blocks are carved out of the chunk, freed blocks are served again first
+    void* block = resource.Allocate(8, 8);
+    void* other = resource.Allocate(8, 8);
+    BOOST_CHECK(block != other);
+    resource.Deallocate(block, 8, 8);
+    BOOST_CHECK_EQUAL(resource.Allocate(8, 8), block);
+
+    // zero sized and smaller allocations use one block too
+    void* small = resource.Allocate(0, 1);
+    resource.Deallocate(small, 0, 1);
+    BOOST_CHECK_EQUAL(resource.Allocate(1, 1), small);
+
+    // larger sizes and alignments bypass the pool
+    void* big = resource.Allocate(16, 8);
+    resource.Deallocate(big, 16, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+
+    // exhausting the chunk allocates a new one
+    for (int i = 0; i < 1024 / 8; ++i) {
+        resource.Allocate(8, 8);
+    }
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(unordered_map_in_pool)
+{
+    using Map = std::unordered_map<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+        PoolAllocator<std::pair<const uint64_t, uint64_t>, sizeof(std::pair<const uint64_t, uint64_t>) + sizeof(void*) * 4, alignof(void*)>>;
+    Map::allocator_type::ResourceType resource(4096);
+    {
+        Map map(0, std::hash<uint64_t>(), std::equal_to<uint64_t>(), &resource);
+        for (uint64_t i = 0; i < 10000; ++i) {
+            map[i] = i;
+        }
+        const size_t chunks = resource.NumAllocatedChunks();
+        BOOST_CHECK(chunks > 1);
+        BOOST_CHECK(memusage::DynamicUsage(map) >= chunks * resource.ChunkSizeBytes());
+
+        // erased nodes go to the freelist and are reused without growing the pool
+        for (uint64_t i = 0; i < 5000; ++i) {
+            map.erase(i);
+        }
+        for (uint64_t i = 20000; i < 25000; ++i) {
+            map[i] = i;
+        }
+        BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), chunks);
+        for (uint64_t i = 20000; i < 25000; ++i) {
+            BOOST_CHECK_EQUAL(map[i], i);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
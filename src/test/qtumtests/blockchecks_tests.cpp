@@ -0,0 +1,185 @@
+#include <boost/test/unit_test.hpp>
+#include <qtumtests/test_utils.h>
+#include <consensus/merkle.h>
+#include <pos.h>
+#include <validationinterface.h>
+
+namespace blockChecksTest{
+
+const valtype code(ParseHex("600160005560006000a000"));
+
+struct BlockCheckedReason : public CValidationInterface {
+    uint256 hash;
+    std::string reason;
+
+    void BlockChecked(const CBlock& block, const CValidationState& state) override {
+        if (block.GetHash() == hash)
+            reason = state.GetRejectReason();
+    }
+};
+
+// Same transaction with a byte of its signature flipped, so it still parses but does not verify
+CMutableTransaction badSignature(const CMutableTransaction& tx){
+    CMutableTransaction bad(tx);
+    bad.vin[0].scriptSig[10] ^= 0x01;
+    return bad;
+}
+
+struct BlockChecksSetup : public TestChain100Setup {
+    CScript scriptPubKey;
+
+    BlockChecksSetup() {
+        fLogEvents = true;
+        scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+        // make the second coinbase mature, one coin stakes and the other pays the contract
+        CreateAndProcessBlock({}, scriptPubKey);
+    }
+
+    ~BlockChecksSetup() {
+        fLogEvents = false;
+    }
+
+    CBlockIndex* Tip() {
+        LOCK(cs_main);
+        return ::ChainActive().Tip();
+    }
+
+    // A template of the mempool with the contract transaction, for the roots and gas refunds its execution leads to
+    std::unique_ptr<CBlockTemplate> ContractTemplate(const CMutableTransaction& tx) {
+        BOOST_CHECK(addToMempool(tx));
+        std::unique_ptr<CBlockTemplate> pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptPubKey);
+        BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 2U);
+        return pblocktemplate;
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(blockchecks_tests, BlockChecksSetup)
+
+BOOST_AUTO_TEST_CASE(bad_contract_signature_leaves_no_state){
+    BOOST_REQUIRE(nScriptCheckThreads > 1);
+    CBlockIndex* pindexPrev = Tip();
+    const dev::h256 hashStateRoot = globalState->rootHash();
+    const dev::h256 hashUTXORoot = globalState->rootHashUTXO();
+
+    CMutableTransaction tx = createContractTx(coinbaseKey, m_coinbase_txns[1], code);
+    std::unique_ptr<CBlockTemplate> pblocktemplate = ContractTemplate(tx);
+    CBlock& block = pblocktemplate->block;
+    CMutableTransaction badTx = badSignature(tx);
+    block.vtx[1] = MakeTransactionRef(badTx);
+    {
+        LOCK(cs_main);
+        unsigned int extraNonce = 0;
+        IncrementExtraNonce(&block, pindexPrev, extraNonce);
+    }
+    while (!CheckProofOfWork(block.GetHash(), block.nBits, Params().GetConsensus())) ++block.nNonce;
+
+    // the contract runs before its signature is known to be bad, the failed check queue rejects the block
+    BlockCheckedReason checked;
+    checked.hash = block.GetHash();
+    RegisterValidationInterface(&checked);
+    ProcessNewBlock(Params(), std::make_shared<const CBlock>(block), true, nullptr);
+    UnregisterValidationInterface(&checked);
+    BOOST_CHECK_EQUAL(checked.reason, "block-validation-failed");
+
+    BOOST_CHECK_EQUAL(Tip(), pindexPrev);
+    BOOST_CHECK(globalState->rootHash() == hashStateRoot);
+    BOOST_CHECK(globalState->rootHashUTXO() == hashUTXORoot);
+    BOOST_CHECK(uintToh256(pindexPrev->hashStateRoot) == hashStateRoot);
+    BOOST_CHECK(pstorageresult->getResult(uintToh256(badTx.GetHash()))->empty());
+}
+
+BOOST_AUTO_TEST_CASE(bad_block_and_contract_signatures_leave_no_state){
+    BOOST_REQUIRE(nScriptCheckThreads > 1);
+    const CChainParams& chainparams = Params();
+    CBlockIndex* pindexPrev = Tip();
+    const dev::h256 hashStateRoot = globalState->rootHash();
+    const dev::h256 hashUTXORoot = globalState->rootHashUTXO();
+
+    CMutableTransaction tx = createContractTx(coinbaseKey, m_coinbase_txns[1], code);
+    std::unique_ptr<CBlockTemplate> pblocktemplate = ContractTemplate(tx);
+    const CBlock& powBlock = pblocktemplate->block;
+    CMutableTransaction badTx = badSignature(tx);
+
+    CBlock block;
+    block.nVersion = powBlock.nVersion;
+    block.hashPrevBlock = pindexPrev->GetBlockHash();
+    block.hashStateRoot = powBlock.hashStateRoot;
+    block.hashUTXORoot = powBlock.hashUTXORoot;
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vin[0].scriptSig = CScript() << (pindexPrev->nHeight + 1) << OP_0;
+    coinbase.vout.resize(1);
+    coinbase.vout[0].SetEmpty();
+
+    // the coinstake carries the gas refunds the miner put in its coinbase
+    const CTransactionRef& stakeTx = m_coinbase_txns[0];
+    CMutableTransaction coinstake;
+    coinstake.vin.push_back(CTxIn(COutPoint(stakeTx->GetHash(), 0)));
+    coinstake.vout.resize(1);
+    coinstake.vout[0].SetEmpty();
+    coinstake.vout.push_back(CTxOut(stakeTx->vout[0].nValue, scriptPubKey));
+    coinstake.vout.insert(coinstake.vout.end(), powBlock.vtx[0]->vout.begin() + 1, powBlock.vtx[0]->vout.end());
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, coinstake, 0, SIGHASH_ALL, stakeTx->vout[0].nValue, SigVersion::BASE);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    coinstake.vin[0].scriptSig << vchSig;
+
+    block.vtx = {MakeTransactionRef(coinbase), MakeTransactionRef(coinstake), MakeTransactionRef(badTx)};
+    block.prevoutStake = coinstake.vin[0].prevout;
+    block.nBits = GetNextWorkRequired(pindexPrev, &block, chainparams.GetConsensus(), true);
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    {
+        LOCK(cs_main);
+        CCoinsViewCache view(&::ChainstateActive().CoinsTip());
+        block.nTime = (pindexPrev->GetBlockTime() + STAKE_TIMESTAMP_MASK + 1) & ~STAKE_TIMESTAMP_MASK;
+        while (!CheckKernel(pindexPrev, block.nBits, block.nTime, block.prevoutStake, view))
+            block.nTime += STAKE_TIMESTAMP_MASK + 1;
+    }
+    // so the block time is not in the future
+    SetMockTime(block.nTime);
+
+    // signed by another key than the one the coinstake pays to
+    CKey otherKey;
+    otherKey.MakeNewKey(true);
+    BOOST_CHECK(otherKey.Sign(block.GetHashWithoutSign(), block.vchBlockSig));
+    BOOST_CHECK(!CheckBlockSignature(block));
+    BOOST_CHECK(!CScriptCheck(block)());
+
+    // a block read back from disk had its signature checked when it was accepted, so it is left to the
+    // check queue; this is what ConnectTip does with it
+    BOOST_CHECK(!block.fChecked);
+    {
+        LOCK(cs_main);
+        uint256 blockHash = block.GetHash();
+        CBlockIndex index(block);
+        index.pprev = pindexPrev;
+        index.nHeight = pindexPrev->nHeight + 1;
+        index.phashBlock = &blockHash;
+        CCoinsViewCache view(&::ChainstateActive().CoinsTip());
+        CValidationState state;
+        BOOST_CHECK(!::ChainstateActive().ConnectBlock(block, state, &index, view, chainparams));
+        BOOST_CHECK_EQUAL(state.GetRejectReason(), "block-validation-failed");
+        globalState->setRoot(hashStateRoot);
+        globalState->setRootUTXO(hashUTXORoot);
+        pstorageresult->clearCacheResult();
+    }
+    BOOST_CHECK(!block.fChecked);
+    BOOST_CHECK_EQUAL(Tip(), pindexPrev);
+    BOOST_CHECK(pstorageresult->getResult(uintToh256(badTx.GetHash()))->empty());
+
+    BOOST_CHECK(globalState->rootHash() == hashStateRoot);
+    BOOST_CHECK(globalState->rootHashUTXO() == hashUTXORoot);
+
+    // the job passes once the block is signed by the staker
+    BOOST_CHECK(coinbaseKey.Sign(block.GetHashWithoutSign(), block.vchBlockSig));
+    BOOST_CHECK(CheckBlockSignature(block));
+    BOOST_CHECK(CScriptCheck(block)());
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
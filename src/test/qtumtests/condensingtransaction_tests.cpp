@@ -342,4 +342,29 @@ BOOST_AUTO_TEST_CASE(condensingtransactionpaytopubkeyhash_tests){
     BOOST_CHECK(result.second.valueTransfers[0].vout[1].scriptPubKey.HasOpCall());
 }
 
+BOOST_AUTO_TEST_CASE(condensingtransactionvincache_tests){
+    initState();
+    dev::h256 hashTemp(hash);
+    std::vector<QtumTransaction> txs;
+    txs.push_back(createQtumTransaction(code[0], 0, dev::u256(500000), dev::u256(1), hashTemp, dev::Address(), 0));
+    dev::Address address = createQtumAddress(hashTemp, 0);
+    executeBC(txs);
+    const dev::h256 rootBefore = globalState->rootHashUTXO();
+
+    txs.clear();
+    txs.push_back(createQtumTransaction(valtype(), 8000, dev::u256(500000), dev::u256(1), hashTemp, address));
+    executeBC(txs);
+    const dev::h256 rootAfter = globalState->rootHashUTXO();
+    Vin vin;
+    BOOST_CHECK(globalState->liveVin(address, vin) && vin.value == 8000);
+
+    // Going back rewinds the cached vin, coming forward again reads it from the trie
+    globalState->setRootUTXO(rootBefore);
+    BOOST_CHECK(!globalState->liveVin(address, vin));
+    globalState->setRootUTXO(rootAfter);
+    BOOST_CHECK(globalState->liveVin(address, vin) && vin.value == 8000);
+    globalState->setRootUTXO(rootBefore);
+    BOOST_CHECK(!globalState->liveVin(address, vin));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
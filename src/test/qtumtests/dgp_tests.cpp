@@ -592,6 +592,109 @@ BOOST_AUTO_TEST_CASE(min_gas_price_passage_from_130_to_0_three_paramsInstance_te
     }
 }
 
+BOOST_AUTO_TEST_CASE(dgp_cache_state_tag_test){
+    DGPCache cache;
+    DGPCache::Key key{DGPContract, ParseHex("2cc8377d"), DEFAULT_GAS_LIMIT_DGP_OP_SEND, 100};
+    dev::h256 tag1(dev::sha3(dev::rlp("tag1")));
+    dev::h256 tag2(dev::sha3(dev::rlp("tag2")));
+    std::vector<unsigned char> output(ParseHex("00000000000000000000000000000000000000000000000000000000000f4240"));
+    std::vector<unsigned char> result;
+
+    BOOST_CHECK(!cache.get(key, tag1, result));
+    cache.put(key, tag1, output);
+    BOOST_CHECK(cache.get(key, tag1, result));
+    BOOST_CHECK(result == output);
+
+    // a changed contract state must not be served from the cache
+    BOOST_CHECK(!cache.get(key, tag2, result));
+    BOOST_CHECK(cache.size() == 0);
+
+    DGPCache::Key otherHeight{DGPContract, ParseHex("2cc8377d"), DEFAULT_GAS_LIMIT_DGP_OP_SEND, 101};
+    cache.put(key, tag1, output);
+    BOOST_CHECK(!cache.get(otherHeight, tag1, result));
+
+    for(unsigned int i = 0; i < MAX_DGP_CACHE_ENTRIES + 10; i++){
+        cache.put(DGPCache::Key{DGPContract, ParseHex("2cc8377d"), DEFAULT_GAS_LIMIT_DGP_OP_SEND, 200 + i}, tag1, output);
+    }
+    BOOST_CHECK(cache.size() == MAX_DGP_CACHE_ENTRIES);
+    BOOST_CHECK(!cache.get(key, tag1, result));
+}
+
+BOOST_AUTO_TEST_CASE(dgp_cache_contract_state_change_test){
+    initState();
+    contractLoading();
+    dgpCache.clear();
+
+    dev::h256 hashTemp(hash);
+    std::vector<QtumTransaction> txs;
+    txs.push_back(createQtumTransaction(code[0], 0, dev::u256(500000), dev::u256(1), hashTemp, DGPContract, 0));
+    txs.push_back(createQtumTransaction(code[10], 0, dev::u256(500000), dev::u256(1), ++hashTemp, dev::Address(), 0));
+    txs.push_back(createQtumTransaction(code[2], 0, dev::u256(500000), dev::u256(1), ++hashTemp, DGPContract, 0));
+    executeBC(txs);
+    const unsigned int firstHeight = ::ChainActive().Height() + 10;
+    const unsigned int secondHeight = ::ChainActive().Height() + 70;
+
+    // a second read of the same height is served from the cache
+    QtumDGP qtumDGP(globalState.get());
+    BOOST_CHECK(qtumDGP.getMinGasPrice(secondHeight) == 13);
+    size_t cached = dgpCache.size();
+    BOOST_CHECK(cached > 0);
+    BOOST_CHECK(qtumDGP.getMinGasPrice(secondHeight) == 13);
+    BOOST_CHECK(dgpCache.size() == cached);
+
+    dev::h256 oldHashStateRoot = globalState->rootHash();
+    dev::h256 oldHashUTXORoot = globalState->rootHashUTXO();
+    for(size_t i = 0; i < 50; i++)
+        CreateAndProcessBlock({}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+    globalState->setRoot(oldHashStateRoot);
+    globalState->setRootUTXO(oldHashUTXORoot);
+
+    // a new params instance changes the storage of the DGP contract, the cached output must not be returned
+    txs.clear();
+    txs.push_back(createQtumTransaction(code[11], 0, dev::u256(500000), dev::u256(1), ++hashTemp, dev::Address(), 0));
+    txs.push_back(createQtumTransaction(code[4], 0, dev::u256(500000), dev::u256(1), ++hashTemp, DGPContract, 0));
+    executeBC(txs);
+    QtumDGP qtumDGPChanged(globalState.get());
+    BOOST_CHECK(qtumDGPChanged.getMinGasPrice(secondHeight) == 9850);
+    BOOST_CHECK(qtumDGPChanged.getMinGasPrice(firstHeight) == 13);
+
+    // and going back to the old state does not return the outputs of the new one
+    globalState->setRoot(oldHashStateRoot);
+    globalState->setRootUTXO(oldHashUTXORoot);
+    QtumDGP qtumDGPRewound(globalState.get());
+    BOOST_CHECK(qtumDGPRewound.getMinGasPrice(secondHeight) == 13);
+    BOOST_CHECK(qtumDGPRewound.getMinGasPrice(firstHeight) == 13);
+}
+
+BOOST_AUTO_TEST_CASE(governance_winner_cache_test){
+    GovernanceWinnerCache cache;
+    dev::h256 tag1(dev::sha3(dev::rlp("tag1")));
+    dev::h256 tag2(dev::sha3(dev::rlp("tag2")));
+    dev::Address winner1("0101010101010101010101010101010101010101");
+    dev::Address winner2("0202020202020202020202020202020202020202");
+    dev::Address result;
+
+    BOOST_CHECK(!cache.get(100, tag1, result));
+    cache.put(100, tag1, winner1);
+    cache.put(101, tag1, winner2);
+    BOOST_CHECK(cache.get(100, tag1, result));
+    BOOST_CHECK(result == winner1);
+    BOOST_CHECK(cache.get(101, tag1, result));
+    BOOST_CHECK(result == winner2);
+
+    // a changed governance contract state is a miss, the winner is computed again
+    BOOST_CHECK(!cache.get(100, tag2, result));
+    cache.put(100, tag2, winner2);
+    BOOST_CHECK(cache.get(100, tag2, result));
+    BOOST_CHECK(result == winner2);
+    BOOST_CHECK(!cache.get(100, tag1, result));
+
+    // a disconnected block drops the winners from its height up
+    cache.eraseFrom(101);
+    BOOST_CHECK(!cache.get(101, tag1, result));
+    BOOST_CHECK(cache.get(100, tag2, result));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }
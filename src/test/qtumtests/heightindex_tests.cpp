@@ -0,0 +1,61 @@
+#include <boost/test/unit_test.hpp>
+#include <test/setup_common.h>
+#include <txdb.h>
+
+namespace heightIndexTest{
+
+std::vector<std::vector<uint256>> readHeightIndex(CBlockTreeDB& db, int low, int high, const std::set<dev::h160>& addresses, int& curheight){
+    std::vector<std::vector<uint256>> blocksOfHashes;
+    curheight = db.ReadHeightIndex(low, high, 0, blocksOfHashes, addresses);
+    return blocksOfHashes;
+}
+
+BOOST_FIXTURE_TEST_SUITE(heightindex_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(heightindex_address_scan_matches_height_scan){
+    CBlockTreeDB db(1 << 20, true);
+    std::vector<dev::h160> contracts = {dev::h160(0x01), dev::h160(0x02), dev::h160(0x03)};
+    for(unsigned int height = 1; height <= 50; height++){
+        for(size_t i = 0; i < contracts.size(); i++){
+            if((height + i) % 3 == 0)
+                continue;
+            BOOST_CHECK(db.WriteHeightIndex(CHeightTxIndexKey(height, contracts[i]), {InsecureRand256()}));
+        }
+    }
+
+    std::vector<std::set<dev::h160>> filters = {{}, {contracts[0]}, {contracts[1], contracts[2]}, {dev::h160(0x04)}};
+    std::vector<std::pair<int, int>> ranges = {{1, -1}, {5, 40}, {10, 10}, {49, -1}, {60, -1}};
+    std::map<std::pair<size_t, size_t>, std::pair<int, std::vector<std::vector<uint256>>>> heightOrdered;
+    for(size_t f = 0; f < filters.size(); f++){
+        for(size_t r = 0; r < ranges.size(); r++){
+            int curheight;
+            auto result = readHeightIndex(db, ranges[r].first, ranges[r].second, filters[f], curheight);
+            heightOrdered[std::make_pair(f, r)] = std::make_pair(curheight, result);
+        }
+    }
+
+    // the address ordered copy answers the same scans, including the height the scan reached
+    BOOST_CHECK(db.UpgradeHeightIndex());
+    for(size_t f = 0; f < filters.size(); f++){
+        for(size_t r = 0; r < ranges.size(); r++){
+            int curheight;
+            auto result = readHeightIndex(db, ranges[r].first, ranges[r].second, filters[f], curheight);
+            BOOST_CHECK_EQUAL(curheight, heightOrdered[std::make_pair(f, r)].first);
+            BOOST_CHECK(result == heightOrdered[std::make_pair(f, r)].second);
+        }
+    }
+
+    // being erased and pruned removes both orderings
+    BOOST_CHECK(db.EraseHeightIndex(50));
+    BOOST_CHECK(db.PruneHeightIndex(10));
+    int curheight;
+    BOOST_CHECK(readHeightIndex(db, 1, 10, {contracts[0]}, curheight).empty());
+    BOOST_CHECK_EQUAL(curheight, 0);
+    BOOST_CHECK(readHeightIndex(db, 50, -1, {contracts[0]}, curheight).empty());
+    BOOST_CHECK(readHeightIndex(db, 11, -1, {contracts[0]}, curheight) == readHeightIndex(db, 11, -1, {contracts[0], dev::h160(0x04)}, curheight));
+    BOOST_CHECK_EQUAL(curheight, 49);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -167,4 +167,29 @@ BOOST_AUTO_TEST_CASE(parse_incorrect_txcall_overflow){
     runFailingTest(false, 120, script1, script2);
 }
 
+BOOST_AUTO_TEST_CASE(extract_contract_txs_cache){
+    mempool.clear();
+    TestMemPoolEntryHelper entry;
+    std::vector<CTxOut> outs1 = {CTxOut(value, CScript() << OP_DUP << OP_HASH160 << address << OP_EQUALVERIFY << OP_CHECKSIG)};
+    CMutableTransaction tx1 = createTX(outs1);
+    mempool.addUnchecked(entry.Fee(1000).Time(GetTime()).SpendsCoinbase(true).FromTx(tx1));
+    CScript script1 = CScript() << CScriptNum(VersionVM::GetEVMDefault().toRaw()) << CScriptNum(int64_t(gasLimit)) << CScriptNum(int64_t(gasPrice)) << data << address << OP_CALL;
+    CMutableTransaction tx2 = createTX({CTxOut(value, script1)}, tx1.GetHash());
+    CTransaction transaction(tx2);
+
+    // Not kept without fCache
+    ContractTxsRef first, second;
+    BOOST_CHECK(ExtractContractTxs(transaction, NULL, NULL, SCRIPT_EXEC_BYTE_CODE, first));
+    BOOST_CHECK(ExtractContractTxs(transaction, NULL, NULL, SCRIPT_EXEC_BYTE_CODE, second, true));
+    BOOST_CHECK(first != second);
+    checkResult(false, second->first, tx2.GetHash());
+
+    // Shared once cached, for the same script flags only
+    ContractTxsRef cached, otherFlags;
+    BOOST_CHECK(ExtractContractTxs(transaction, NULL, NULL, SCRIPT_EXEC_BYTE_CODE, cached));
+    BOOST_CHECK(cached == second);
+    BOOST_CHECK(ExtractContractTxs(transaction, NULL, NULL, SCRIPT_EXEC_BYTE_CODE | SCRIPT_OUTPUT_SENDER, otherFlags));
+    BOOST_CHECK(otherFlags != second);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
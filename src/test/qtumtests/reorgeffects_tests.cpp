@@ -0,0 +1,137 @@
+#include <boost/test/unit_test.hpp>
+#include <qtumtests/test_utils.h>
+#include <shutdown.h>
+#include <txdb.h>
+
+namespace reorgEffectsTest{
+
+// stores 1 at slot 0 and logs from the constructor, so the block has receipts and height index entries
+const valtype code(ParseHex("600160005560006000a000"));
+
+struct ReorgSetup : public TestChain100Setup {
+    CScript scriptPubKey;
+    CBlockIndex* pindexFork;
+    std::vector<CBlockIndex*> vpindexA;
+    std::vector<CBlockIndex*> vpindexB;
+    std::vector<uint256> vtxidB;
+
+    ReorgSetup() {
+        fLogEvents = true;
+        scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+        {
+            LOCK(cs_main);
+            pindexFork = ::ChainActive().Tip();
+        }
+    }
+
+    ~ReorgSetup() {
+        fLogEvents = false;
+    }
+
+    CBlockIndex* Tip() {
+        LOCK(cs_main);
+        return ::ChainActive().Tip();
+    }
+
+    // Mine four empty blocks and invalidate them, then three blocks with a contract each in their place
+    void BuildFork() {
+        for (int i = 0; i < 4; i++) {
+            CreateAndProcessBlock({}, scriptPubKey);
+            vpindexA.push_back(Tip());
+        }
+        CValidationState state;
+        BOOST_CHECK(InvalidateBlock(state, Params(), vpindexA[0]));
+        BOOST_CHECK_EQUAL(Tip(), pindexFork);
+
+        for (int i = 0; i < 3; i++) {
+            CMutableTransaction tx = createContractTx(coinbaseKey, m_coinbase_txns[i], code);
+            BOOST_CHECK(addToMempool(tx));
+            CBlock block = createAndProcessMempoolBlock(scriptPubKey);
+            BOOST_CHECK_EQUAL(block.vtx.size(), 2U);
+            vtxidB.push_back(tx.GetHash());
+            vpindexB.push_back(Tip());
+        }
+        BOOST_CHECK_EQUAL(Tip()->nHeight, pindexFork->nHeight + 3);
+        BOOST_CHECK(Tip()->hashStateRoot != pindexFork->hashStateRoot);
+        for (const uint256& txid : vtxidB) {
+            BOOST_CHECK(!pstorageresult->getResult(uintToh256(txid))->empty());
+        }
+        BOOST_CHECK(!ReadHeightIndex(vpindexB.front()->nHeight, vpindexB.back()->nHeight).empty());
+    }
+
+    // Bring the longer chain of empty blocks back, which makes the node reorg to it
+    bool ReorgToA() {
+        {
+            LOCK(cs_main);
+            ResetBlockFailureFlags(vpindexA[0]);
+        }
+        CValidationState state;
+        return ActivateBestChain(state, Params());
+    }
+
+    std::vector<std::vector<uint256>> ReadHeightIndex(int low, int high) {
+        std::vector<std::vector<uint256>> blocksOfHashes;
+        pblocktree->ReadHeightIndex(low, high, 0, blocksOfHashes, {});
+        return blocksOfHashes;
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(reorgeffects_tests, ReorgSetup)
+
+BOOST_AUTO_TEST_CASE(reorg_writes_the_effects_of_all_disconnected_blocks){
+    BuildFork();
+    BOOST_CHECK(ReorgToA());
+    BOOST_CHECK_EQUAL(Tip(), vpindexA.back());
+
+    // the empty blocks leave the contract state at the fork point
+    BOOST_CHECK(vpindexA.back()->hashStateRoot == pindexFork->hashStateRoot);
+    BOOST_CHECK(vpindexA.back()->hashUTXORoot == pindexFork->hashUTXORoot);
+    BOOST_CHECK(globalState->rootHash() == uintToh256(pindexFork->hashStateRoot));
+    BOOST_CHECK(globalState->rootHashUTXO() == uintToh256(pindexFork->hashUTXORoot));
+
+    for (const uint256& txid : vtxidB) {
+        BOOST_CHECK(pstorageresult->getResult(uintToh256(txid))->empty());
+    }
+    BOOST_CHECK(ReadHeightIndex(vpindexB.front()->nHeight, vpindexB.back()->nHeight).empty());
+
+    // the blocks connected in their place have their own stake index entries
+    for (CBlockIndex* pindex : vpindexA) {
+        uint160 address;
+        BOOST_CHECK(pblocktree->ReadStakeIndex(pindex->nHeight, address));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(failed_reorg_writes_the_effects_gathered_so_far){
+    BuildFork();
+
+    // the second contract block can't be disconnected without its undo data
+    {
+        LOCK(cs_main);
+        vpindexB[1]->nStatus &= ~BLOCK_HAVE_UNDO;
+    }
+    BOOST_CHECK(!ReorgToA());
+    AbortShutdown();
+    BOOST_CHECK_EQUAL(Tip(), vpindexB[1]);
+
+    // the last block was disconnected, so its effects are written and those below it are kept
+    BOOST_CHECK(globalState->rootHash() == uintToh256(vpindexB[1]->hashStateRoot));
+    BOOST_CHECK(globalState->rootHashUTXO() == uintToh256(vpindexB[1]->hashUTXORoot));
+    BOOST_CHECK(pstorageresult->getResult(uintToh256(vtxidB[2]))->empty());
+    BOOST_CHECK(!pstorageresult->getResult(uintToh256(vtxidB[1]))->empty());
+    BOOST_CHECK(ReadHeightIndex(vpindexB[2]->nHeight, vpindexB[2]->nHeight).empty());
+    BOOST_CHECK(!ReadHeightIndex(vpindexB[1]->nHeight, vpindexB[1]->nHeight).empty());
+
+    // the stake index has nothing left from the height of the disconnected block up
+    uint160 address;
+    BOOST_CHECK(!pblocktree->ReadStakeIndex(vpindexB[2]->nHeight, address));
+    BOOST_CHECK(pblocktree->ReadStakeIndex(vpindexB[1]->nHeight, address));
+
+    {
+        LOCK(cs_main);
+        vpindexB[1]->nStatus |= BLOCK_HAVE_UNDO;
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
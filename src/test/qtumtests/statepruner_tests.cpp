@@ -0,0 +1,71 @@
+#include <boost/test/unit_test.hpp>
+#include <test/setup_common.h>
+#include <qtumtests/test_utils.h>
+#include <qtum/statepruner.h>
+#include <chain.h>
+
+namespace statePrunerTest{
+
+const dev::u256 GASLIMIT = dev::u256(500000);
+
+/* Stores one byte in slot 0 and deploys a single STOP */
+valtype storeCode(unsigned char value){
+    return ParseHex(strprintf("60%02x6000556001601160003960016000f300", value));
+}
+
+void openState(const fs::path& dir){
+    const dev::h256 hashDB(dev::sha3(dev::rlp("")));
+    globalState = std::unique_ptr<QtumState>(new QtumState(dev::u256(0), QtumState::openDB(dir.string(), hashDB, dev::WithExisting::Trust), dir.string(), dev::eth::BaseState::Empty));
+}
+
+dev::Address deploy(unsigned char value, const dev::h256& hashTx){
+    QtumTransaction txEth = createQtumTransaction(storeCode(value), 0, GASLIMIT, dev::u256(1), hashTx, dev::Address());
+    executeBC(std::vector<QtumTransaction>(1, txEth));
+    return createQtumAddress(txEth.getHashWith(), txEth.getNVout());
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(statepruner_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(statepruner_keeps_recent_state){
+    const fs::path dir = GetDataDir() / "stateQtumPrune";
+    statePrunerTest::openState(dir);
+    globalState->setRootUTXO(dev::sha3(dev::rlp("")));
+
+    dev::Address first = statePrunerTest::deploy(0x2a, dev::h256(ParseHex("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa")));
+    const dev::h256 root1 = globalState->rootHash();
+    dev::Address second = statePrunerTest::deploy(0x2b, dev::h256(ParseHex("bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb")));
+    const dev::h256 root2 = globalState->rootHash();
+    BOOST_CHECK(root1 != root2);
+    globalState.reset();
+
+    CBlockIndex index1, index2;
+    index1.nHeight = 0;
+    index1.hashStateRoot = h256Touint(root1);
+    index1.hashUTXORoot = h256Touint(dev::sha3(dev::rlp("")));
+    index2.nHeight = 1;
+    index2.pprev = &index1;
+    index2.hashStateRoot = h256Touint(root2);
+    index2.hashUTXORoot = index1.hashUTXORoot;
+    CChain chain;
+    chain.SetTip(&index2);
+
+    // The state of a block kept by height survives
+    BOOST_CHECK(PruneContractState(dir, chain, 0, {0}));
+    statePrunerTest::openState(dir);
+    globalState->setRoot(root1);
+    BOOST_CHECK(globalState->storage(first, 0) == 0x2a);
+    BOOST_CHECK(!globalState->addressInUse(second));
+    globalState.reset();
+
+    BOOST_CHECK(PruneContractState(dir, chain, 0, {}));
+    statePrunerTest::openState(dir);
+    BOOST_CHECK_THROW(globalState->setRoot(root1), std::exception);
+    globalState->setRoot(root2);
+    BOOST_CHECK(globalState->storage(first, 0) == 0x2a);
+    BOOST_CHECK(globalState->storage(second, 0) == 0x2b);
+    BOOST_CHECK(globalState->code(second) == valtype(1, 0));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,106 @@
+#include <boost/test/unit_test.hpp>
+#include <test/setup_common.h>
+#include <qtum/storageresults.h>
+#include <util/convert.h>
+#include <random.h>
+
+namespace storageResultsTest{
+
+TransactionReceiptInfo createReceipt(const uint256& blockHash, const uint256& txHash, uint32_t outputIndex){
+    dev::h256s topics = {dev::h256(1), dev::h256(2)};
+    dev::eth::LogEntries logs;
+    logs.push_back(dev::eth::LogEntry(dev::Address(0xab), topics, dev::bytes(3, 0x11)));
+    logs.push_back(dev::eth::LogEntry(dev::Address(0xcd), dev::h256s{dev::h256(2), dev::h256(3)}, dev::bytes()));
+    return TransactionReceiptInfo{
+        blockHash,
+        1000,
+        txHash,
+        7,
+        outputIndex,
+        dev::Address(0x01),
+        dev::Address(0x02),
+        uint64_t(50000) * (outputIndex + 1),
+        50000,
+        dev::Address(0x03),
+        logs,
+        dev::eth::TransactionException::OutOfGas,
+        "out of gas",
+        dev::h256(0x10 + outputIndex),
+        dev::h256(0x20 + outputIndex),
+        {std::make_pair(dev::Address(0x04), dev::bytes(5, 0x22))},
+        {dev::Address(0x05)}
+    };
+}
+
+void checkReceipt(const TransactionReceiptInfo& a, const TransactionReceiptInfo& b, bool logsOnly){
+    BOOST_CHECK(a.blockHash == b.blockHash);
+    BOOST_CHECK(a.blockNumber == b.blockNumber);
+    BOOST_CHECK(a.transactionHash == b.transactionHash);
+    BOOST_CHECK(a.transactionIndex == b.transactionIndex);
+    BOOST_CHECK(a.outputIndex == b.outputIndex);
+    BOOST_CHECK(a.from == b.from);
+    BOOST_CHECK(a.to == b.to);
+    BOOST_CHECK(a.cumulativeGasUsed == b.cumulativeGasUsed);
+    BOOST_CHECK(a.gasUsed == b.gasUsed);
+    BOOST_CHECK(a.contractAddress == b.contractAddress);
+    BOOST_CHECK(a.excepted == b.excepted);
+    BOOST_CHECK(a.stateRoot == b.stateRoot);
+    BOOST_CHECK(a.utxoRoot == b.utxoRoot);
+    BOOST_REQUIRE(a.logs.size() == b.logs.size());
+    for(size_t i = 0; i < a.logs.size(); i++){
+        BOOST_CHECK(a.logs[i].address == b.logs[i].address);
+        BOOST_CHECK(a.logs[i].topics == b.logs[i].topics);
+        BOOST_CHECK(a.logs[i].data == b.logs[i].data);
+    }
+    if(!logsOnly){
+        BOOST_CHECK(a.exceptedMessage == b.exceptedMessage);
+        BOOST_CHECK(a.createdContracts == b.createdContracts);
+        BOOST_CHECK(a.destructedContracts == b.destructedContracts);
+    }
+}
+
+void checkRoundTrip(std::vector<TransactionReceiptInfo> receipts){
+    fs::path path = fs::temp_directory_path() / strprintf("test_receipts_%lu_%i", (unsigned long)GetTime(), (int)(GetRand(100000)));
+    fs::create_directories(path);
+    const dev::h256 hashTx = uintToh256(receipts.front().transactionHash);
+    {
+        // no read cache, every read decodes from disk
+        StorageResults results(path.string(), 0);
+        results.addResult(hashTx, receipts);
+        results.commitResults();
+
+        TransactionReceiptsRef stored = results.getResult(hashTx);
+        BOOST_REQUIRE(stored->size() == receipts.size());
+        for(size_t i = 0; i < receipts.size(); i++)
+            checkReceipt((*stored)[i], receipts[i], false);
+
+        std::vector<TransactionReceiptInfo> logs;
+        BOOST_CHECK(results.getResultLogs(hashTx, logs));
+        BOOST_REQUIRE(logs.size() == receipts.size());
+        for(size_t i = 0; i < receipts.size(); i++)
+            checkReceipt(logs[i], receipts[i], true);
+
+        std::vector<TransactionReceiptInfo> missing;
+        BOOST_CHECK(!results.getResultLogs(dev::h256(0x99), missing));
+        BOOST_CHECK(results.getResult(dev::h256(0x99))->empty());
+    }
+    fs::remove_all(path);
+}
+
+BOOST_FIXTURE_TEST_SUITE(storageresults_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(storageresults_compact_roundtrip){
+    uint256 blockHash = InsecureRand256();
+    uint256 txHash = InsecureRand256();
+    checkRoundTrip({createReceipt(blockHash, txHash, 0), createReceipt(blockHash, txHash, 1)});
+}
+
+BOOST_AUTO_TEST_CASE(storageresults_mixed_blocks_roundtrip){
+    // receipts not sharing the block fields keep the RLP encoding
+    uint256 txHash = InsecureRand256();
+    checkRoundTrip({createReceipt(InsecureRand256(), txHash, 0), createReceipt(InsecureRand256(), txHash, 1)});
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -3,6 +3,11 @@
 #include <util/strencodings.h>
 #include <util/convert.h>
 #include <test/setup_common.h>
+#include <consensus/validation.h>
+#include <key.h>
+#include <miner.h>
+#include <pow.h>
+#include <script/interpreter.h>
 #include <boost/filesystem/operations.hpp>
 #include <fs.h>
 
@@ -61,6 +66,7 @@ inline QtumTransaction createQtumTransaction(valtype data, dev::u256 value, dev:
 }
 
 inline std::pair<std::vector<ResultExecute>, ByteCodeExecResult> executeBC(std::vector<QtumTransaction> txs){
+    LOCK(cs_main);
     CBlock block(generateBlock());
     QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
     uint64_t blockGasLimit = qtumDGP.getBlockGasLimit(ChainActive().Tip()->nHeight + 1);
@@ -73,3 +79,44 @@ inline std::pair<std::vector<ResultExecute>, ByteCodeExecResult> executeBC(std::
     globalState->dbUtxo().commit();
     return std::make_pair(res, bceExecRes);
 }
+
+/** A contract creation spending output 0 of prevTx, paid by key, with the gas stipend as fee and the rest back to key */
+inline CMutableTransaction createContractTx(const CKey& key, const CTransactionRef& prevTx, const valtype& code, uint64_t gasLimit = 100000, uint64_t gasPrice = DEFAULT_MIN_GAS_PRICE_DGP){
+    CScript scriptPubKey = CScript() << ToByteVector(key.GetPubKey()) << OP_CHECKSIG;
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(prevTx->GetHash(), 0);
+    CAmount fee = gasLimit * gasPrice + CENT;
+    tx.vout.push_back(CTxOut(0, CScript() << CScriptNum(VersionVM::GetEVMDefault().toRaw()) << CScriptNum(gasLimit) << CScriptNum(gasPrice) << code << OP_CREATE));
+    tx.vout.push_back(CTxOut(prevTx->vout[0].nValue - fee, scriptPubKey));
+
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, tx, 0, SIGHASH_ALL, prevTx->vout[0].nValue, SigVersion::BASE);
+    BOOST_CHECK(key.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    tx.vin[0].scriptSig << vchSig;
+    return tx;
+}
+
+inline bool addToMempool(const CMutableTransaction& tx){
+    LOCK(cs_main);
+    CValidationState state;
+    return AcceptToMemoryPool(mempool, state, MakeTransactionRef(tx), nullptr, nullptr, true, 0);
+}
+
+/** Mine the mempool on top of the tip, the contracts executed and refunded by the miner, and process the block */
+inline CBlock createAndProcessMempoolBlock(const CScript& scriptPubKey){
+    const CChainParams& chainparams = Params();
+    std::unique_ptr<CBlockTemplate> pblocktemplate = BlockAssembler(chainparams).CreateNewBlock(scriptPubKey);
+    CBlock& block = pblocktemplate->block;
+    {
+        LOCK(cs_main);
+        unsigned int extraNonce = 0;
+        IncrementExtraNonce(&block, ::ChainActive().Tip(), extraNonce);
+    }
+    while (!CheckProofOfWork(block.GetHash(), block.nBits, chainparams.GetConsensus())) ++block.nNonce;
+
+    std::shared_ptr<const CBlock> shared_pblock = std::make_shared<const CBlock>(block);
+    ProcessNewBlock(chainparams, shared_pblock, true, nullptr);
+    return block;
+}
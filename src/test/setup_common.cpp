@@ -14,6 +14,7 @@
 #include <miner.h>
 #include <net.h>
 #include <noui.h>
+#include <pos.h>
 #include <pow.h>
 #include <rpc/register.h>
 #include <rpc/server.h>
@@ -57,6 +58,7 @@ BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
     SetupNetworking();
     InitSignatureCache();
     InitScriptExecutionCache();
+    InitBlockSignerCache();
     fCheckBlockIndex = true;
     static bool noui_connected = false;
     if (!noui_connected) {
@@ -188,4 +188,57 @@ BOOST_AUTO_TEST_CASE(findearliestatleast_edge_test)
     BOOST_CHECK(ret2->nTimeMax >= 200 && ret2->nHeight == 4);
 }
 
+static void CheckTimeAt(const CChain& chain)
+{
+    for (int i = 0; i <= chain.Height(); i++) {
+        BOOST_CHECK_EQUAL(chain.TimeAt(i), chain[i]->nTime);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(timeat_test)
+{
+    // A main branch of 100 blocks and a fork of 60 blocks from height 50, with other times
+    std::vector<CBlockIndex> vBlocksMain(100);
+    for (unsigned int i=0; i<vBlocksMain.size(); i++) {
+        vBlocksMain[i].nHeight = i;
+        vBlocksMain[i].pprev = i ? &vBlocksMain[i - 1] : nullptr;
+        vBlocksMain[i].nTime = 1000 + i * 10;
+    }
+    std::vector<CBlockIndex> vBlocksSide(60);
+    for (unsigned int i=0; i<vBlocksSide.size(); i++) {
+        vBlocksSide[i].nHeight = 50 + i;
+        vBlocksSide[i].pprev = i ? &vBlocksSide[i - 1] : &vBlocksMain[49];
+        vBlocksSide[i].nTime = 5000 + i * 7;
+    }
+
+    CChain chain;
+    chain.SetTip(&vBlocksMain.back());
+    CheckTimeAt(chain);
+
+    // Moving to the fork rewrites the times above the fork point, including the heights the main branch did not reach
+    chain.SetTip(&vBlocksSide.back());
+    BOOST_CHECK_EQUAL(chain.Height(), 109);
+    CheckTimeAt(chain);
+    BOOST_CHECK_EQUAL(chain.TimeAt(49), vBlocksMain[49].nTime);
+    BOOST_CHECK_EQUAL(chain.TimeAt(50), vBlocksSide[0].nTime);
+
+    // And moving back restores them
+    chain.SetTip(&vBlocksMain.back());
+    BOOST_CHECK_EQUAL(chain.Height(), 99);
+    CheckTimeAt(chain);
+    BOOST_CHECK_EQUAL(chain.TimeAt(50), vBlocksMain[50].nTime);
+
+    // A tip below the fork point, then the fork again from there
+    chain.SetTip(&vBlocksMain[30]);
+    CheckTimeAt(chain);
+    chain.SetTip(&vBlocksSide[10]);
+    BOOST_CHECK_EQUAL(chain.Height(), 60);
+    CheckTimeAt(chain);
+
+    chain.SetTip(nullptr);
+    BOOST_CHECK_EQUAL(chain.Height(), -1);
+    chain.SetTip(&vBlocksMain.back());
+    CheckTimeAt(chain);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
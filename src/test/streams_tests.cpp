@@ -203,6 +203,40 @@ BOOST_AUTO_TEST_CASE(streams_serializedata_xor)
             std::string(ds.begin(), ds.end()));
 }
 
+BOOST_AUTO_TEST_CASE(streams_xor_words)
+{
+    // The word at a time path of the 8 byte keys against the plain repetition of the key
+    const std::vector<unsigned char> key{0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef};
+    for (size_t size = 0; size < 40; size++) {
+        for (size_t offset = 0; offset < 2 * key.size(); offset++) {
+            std::vector<char> data(size);
+            for (size_t i = 0; i < size; i++) data[i] = (char)(i * 37);
+            std::vector<char> expected(data);
+            for (size_t i = 0; i < size; i++) expected[i] ^= key[(i + offset) % key.size()];
+            Xor(MakeSpan(data), key, offset);
+            BOOST_CHECK(data == expected);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(streams_span_reader)
+{
+    const std::vector<unsigned char> data{1, 255, 3, 4, 5, 6};
+    SpanReader reader(0, 0, MakeSpan(data));
+    unsigned char a;
+    uint16_t b;
+    reader >> a >> b;
+    BOOST_CHECK_EQUAL(a, 1);
+    BOOST_CHECK_EQUAL(b, 0x03ff);
+    reader.ignore(2);
+    BOOST_CHECK_EQUAL(reader.size(), 1U);
+    BOOST_CHECK_THROW(reader >> b, std::ios_base::failure);
+    reader >> a;
+    BOOST_CHECK_EQUAL(a, 6);
+    BOOST_CHECK(reader.empty());
+    BOOST_CHECK_THROW(reader.ignore(1), std::ios_base::failure);
+}
+
 BOOST_AUTO_TEST_CASE(streams_buffered_file)
 {
     FILE* file = fsbridge::fopen("streams_test_tmp", "w+b");
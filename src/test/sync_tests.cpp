@@ -7,6 +7,9 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <cstring>
+#include <thread>
+
 namespace {
 template <typename MutexType>
 void TestPotentialDeadLockDetected(MutexType& mutex1, MutexType& mutex2)
@@ -49,4 +52,39 @@ BOOST_AUTO_TEST_CASE(potential_deadlock_detected)
     #endif
 }
 
+BOOST_AUTO_TEST_CASE(lock_stats)
+{
+    const bool prev = g_lock_stats;
+    g_lock_stats = true;
+
+    Mutex lockstats_mutex;
+    std::thread thread;
+    {
+        LOCK(lockstats_mutex);
+        thread = std::thread([&] { LOCK(lockstats_mutex); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    thread.join();
+
+    uint64_t acquisitions = 0, contentions = 0, wait_micros = 0, hold_micros = 0;
+    for (const LockSiteStats* site : GetLockSites()) {
+        if (strcmp(site->name, "lockstats_mutex") == 0) {
+            acquisitions += site->acquisitions;
+            contentions += site->contentions;
+            wait_micros += site->wait_micros;
+            hold_micros += site->hold_micros;
+        }
+    }
+    BOOST_CHECK_EQUAL(acquisitions, 2U);
+    BOOST_CHECK_EQUAL(contentions, 1U);
+    BOOST_CHECK(wait_micros > 0);
+    BOOST_CHECK(hold_micros >= 20000);
+
+    ResetLockStats();
+    for (const LockSiteStats* site : GetLockSites()) {
+        BOOST_CHECK_EQUAL(site->acquisitions.load(), 0U);
+    }
+    g_lock_stats = prev;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -770,4 +770,25 @@ BOOST_AUTO_TEST_CASE(test_IsStandard)
     BOOST_CHECK(!IsStandardTx(CTransaction(t), reason));
 }
 
+BOOST_AUTO_TEST_CASE(test_script_flags)
+{
+    CMutableTransaction t;
+    t.vin.resize(1);
+    t.vout.resize(1);
+    t.vout[0].scriptPubKey = CScript() << OP_DUP;
+    CTransaction plain(t);
+    BOOST_CHECK(!plain.HasCreateOrCall() && !plain.HasOpCreate() && !plain.HasOpCall() && !plain.HasOpSpend() && !plain.HasOpSender());
+
+    t.vin[0].scriptSig = CScript() << OP_SPEND;
+    t.vout.resize(2);
+    t.vout[1].scriptPubKey = CScript() << CScriptNum(4) << CScriptNum(250000) << CScriptNum(40) << ParseHex("00") << ParseHex("0102030405060708090a0b0c0d0e0f1011121314") << OP_CALL;
+    for (const CTransactionRef& tx : MakeTransactionRefs({t})) {
+        BOOST_CHECK(tx->HasCreateOrCall() && tx->HasOpCall() && tx->HasOpSpend());
+        BOOST_CHECK(!tx->HasOpCreate() && !tx->HasOpSender());
+        BOOST_CHECK_EQUAL(tx->GetCreateOrCall(), CTransaction::OpCall);
+        BOOST_CHECK(tx->vout[1].scriptPubKey.IsDGPContractCall(ParseHex("0102030405060708090a0b0c0d0e0f1011121314"), ParseHex("00")));
+        BOOST_CHECK(!tx->vout[0].scriptPubKey.IsDGPContractCall(ParseHex("0102030405060708090a0b0c0d0e0f1011121314"), ParseHex("00")));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,16 +3,30 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <chainparams.h>
+#include <consensus/validation.h>
+#include <dbwrapper.h>
 #include <index/txindex.h>
+#include <script/interpreter.h>
 #include <script/standard.h>
 #include <test/setup_common.h>
 #include <util/system.h>
 #include <util/time.h>
+#include <validation.h>
 
 #include <boost/test/unit_test.hpp>
 
 BOOST_AUTO_TEST_SUITE(txindex_tests)
 
+static void WaitForSync(TxIndex& txindex)
+{
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!txindex.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        MilliSleep(100);
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(txindex_initial_sync, TestChain100Setup)
 {
     TxIndex txindex(1 << 20, true);
@@ -53,6 +67,25 @@ BOOST_FIXTURE_TEST_CASE(txindex_initial_sync, TestChain100Setup)
         }
     }
 
+    // Check that a batch lookup finds the same transactions, and nothing for an unknown hash.
+    std::vector<uint256> tx_hashes;
+    for (const auto& txn : m_coinbase_txns) {
+        tx_hashes.push_back(txn->GetHash());
+    }
+    tx_hashes.push_back(uint256S("0x01"));
+    std::vector<uint256> block_hashes;
+    std::vector<CTransactionRef> txs;
+    txindex.FindTxs(tx_hashes, block_hashes, txs);
+    BOOST_REQUIRE_EQUAL(txs.size(), tx_hashes.size());
+    for (size_t i = 0; i < m_coinbase_txns.size(); ++i) {
+        BOOST_REQUIRE(txs[i]);
+        BOOST_CHECK_EQUAL(txs[i]->GetHash(), tx_hashes[i]);
+        BOOST_CHECK(txindex.FindTx(tx_hashes[i], block_hash, tx_disk));
+        BOOST_CHECK_EQUAL(block_hashes[i], block_hash);
+    }
+    BOOST_CHECK(!txs.back());
+    BOOST_CHECK(block_hashes.back().IsNull());
+
     // Check that new transactions in new blocks make it into the index.
     for (int i = 0; i < 10; i++) {
         CScript coinbase_script_pub_key = GetScriptForDestination(PKHash(coinbaseKey.GetPubKey()));
@@ -77,4 +110,121 @@ BOOST_FIXTURE_TEST_CASE(txindex_initial_sync, TestChain100Setup)
     // Rest of shutdown sequence and destructors happen in ~TestingSetup()
 }
 
+BOOST_FIXTURE_TEST_CASE(txindex_migrates_full_txid_keys, TestChain100Setup)
+{
+    const fs::path path = GetDataDir() / "indexes" / "txindex";
+
+    // Write the coinbases the way earlier versions did, keyed by the full txid, with the index
+    // synced to the tip so that nothing is indexed again
+    {
+        CDBWrapper db(path, 1 << 20);
+        CDBBatch batch(db);
+        LOCK(cs_main);
+        for (int height = 1; height <= ::ChainActive().Height(); ++height) {
+            const CBlockIndex* pindex = ::ChainActive()[height];
+            CBlock block;
+            BOOST_REQUIRE(ReadBlockFromDisk(block, pindex, Params().GetConsensus()));
+            CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
+            batch.Write(std::make_pair('t', block.vtx[0]->GetHash()), pos);
+        }
+        batch.Write('B', ::ChainActive().GetLocator());
+        BOOST_REQUIRE(db.WriteBatch(batch, true));
+    }
+
+    {
+        TxIndex txindex(1 << 20);
+        txindex.Start();
+        WaitForSync(txindex);
+
+        CTransactionRef tx_disk;
+        uint256 block_hash;
+        for (const auto& txn : m_coinbase_txns) {
+            if (!txindex.FindTx(txn->GetHash(), block_hash, tx_disk)) {
+                BOOST_ERROR("FindTx failed");
+            } else {
+                BOOST_CHECK_EQUAL(tx_disk->GetHash(), txn->GetHash());
+            }
+        }
+        BOOST_CHECK(!txindex.FindTx(uint256S("0x01"), block_hash, tx_disk));
+        txindex.Stop();
+    }
+
+    // No entry is left under the full txid
+    {
+        CDBWrapper db(path, 1 << 20);
+        std::unique_ptr<CDBIterator> cursor(db.NewIterator());
+        cursor->Seek(std::make_pair('t', uint256()));
+        std::pair<char, uint256> key;
+        BOOST_CHECK(!cursor->Valid() || !cursor->GetKey(key) || key.first != 't');
+    }
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+BOOST_FIXTURE_TEST_CASE(txindex_prefers_active_chain, TestChain100Setup)
+{
+    TxIndex txindex(1 << 20, true);
+    txindex.Start();
+    WaitForSync(txindex);
+
+    // A spend of the first coinbase, mined in two competing blocks at the same height
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(m_coinbase_txns[0]->GetHash(), 0);
+    spend.vout.resize(1);
+    spend.vout[0].nValue = 11 * CENT;
+    spend.vout[0].scriptPubKey = scriptPubKey;
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, spend, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+
+    const CBlock blockA = CreateAndProcessBlock({spend}, scriptPubKey);
+    WaitForSync(txindex);
+    CBlockIndex* pindexA = WITH_LOCK(cs_main, return LookupBlockIndex(blockA.GetHash()));
+    {
+        CValidationState state;
+        BOOST_CHECK(InvalidateBlock(state, Params(), pindexA));
+    }
+    // another coinbase script so the block is not the same
+    const CBlock blockB = CreateAndProcessBlock({spend}, GetScriptForDestination(PKHash(coinbaseKey.GetPubKey())));
+    WaitForSync(txindex);
+    BOOST_CHECK(blockA.GetHash() != blockB.GetHash());
+    CBlockIndex* pindexB = WITH_LOCK(cs_main, return LookupBlockIndex(blockB.GetHash()));
+    BOOST_CHECK_EQUAL(WITH_LOCK(cs_main, return ::ChainActive().Tip()), pindexB);
+
+    CTransactionRef tx_disk;
+    uint256 block_hash;
+    BOOST_REQUIRE(txindex.FindTx(spend.GetHash(), block_hash, tx_disk));
+    BOOST_CHECK_EQUAL(tx_disk->GetHash(), spend.GetHash());
+    BOOST_CHECK_EQUAL(block_hash, blockB.GetHash());
+
+    // the other way round once the first block is back in the active chain
+    {
+        CValidationState state;
+        BOOST_CHECK(InvalidateBlock(state, Params(), pindexB));
+        WITH_LOCK(cs_main, ResetBlockFailureFlags(pindexA));
+        BOOST_CHECK(ActivateBestChain(state, Params()));
+    }
+    BOOST_CHECK_EQUAL(WITH_LOCK(cs_main, return ::ChainActive().Tip()), pindexA);
+    WaitForSync(txindex);
+    BOOST_REQUIRE(txindex.FindTx(spend.GetHash(), block_hash, tx_disk));
+    BOOST_CHECK_EQUAL(block_hash, blockA.GetHash());
+
+    std::vector<uint256> block_hashes;
+    std::vector<CTransactionRef> txs;
+    txindex.FindTxs({spend.GetHash(), m_coinbase_txns[0]->GetHash()}, block_hashes, txs);
+    BOOST_REQUIRE(txs[0] && txs[1]);
+    BOOST_CHECK_EQUAL(block_hashes[0], blockA.GetHash());
+
+    txindex.Stop();
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
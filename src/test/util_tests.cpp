@@ -11,6 +11,7 @@
 #include <util/moneystr.h>
 #include <util/strencodings.h>
 #include <util/string.h>
+#include <util/threadaffinity.h>
 #include <util/time.h>
 
 #include <stdint.h>
@@ -1590,4 +1591,22 @@ BOOST_AUTO_TEST_CASE(test_LogEscapeMessage)
     BOOST_CHECK_EQUAL(BCLog::LogEscapeMessage(NUL), R"(O\x00O)");
 }
 
+BOOST_AUTO_TEST_CASE(test_CPUList)
+{
+    std::vector<int> cpus;
+    BOOST_CHECK(util::ParseCPUList("0-3,8,10-11\n", cpus));
+    BOOST_CHECK(cpus == std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+    BOOST_CHECK_EQUAL(util::FormatCPUList(cpus), "0-3,8,10-11");
+
+    BOOST_CHECK(util::ParseCPUList("5,4,4", cpus));
+    BOOST_CHECK_EQUAL(util::FormatCPUList(cpus), "4-5");
+    BOOST_CHECK(util::ParseCPUList("", cpus));
+    BOOST_CHECK(cpus.empty());
+    BOOST_CHECK_EQUAL(util::FormatCPUList(cpus), "");
+
+    BOOST_CHECK(!util::ParseCPUList("3-1", cpus));
+    BOOST_CHECK(!util::ParseCPUList("a", cpus));
+    BOOST_CHECK(!util::ParseCPUList("1-", cpus));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -205,6 +205,22 @@ BOOST_AUTO_TEST_CASE(processnewblock_signals_ordering)
 
     LOCK(cs_main);
     BOOST_CHECK_EQUAL(sub.m_expected_tip, ::ChainActive().Tip()->GetBlockHash());
+
+    // the snapshot for readers without cs_main follows the active chain
+    const std::shared_ptr<const ChainTipSnapshot> snapshot = GetChainTipSnapshot();
+    BOOST_CHECK(snapshot->tip == ::ChainActive().Tip());
+    BOOST_CHECK_EQUAL(snapshot->height, ::ChainActive().Height());
+    BOOST_CHECK(snapshot->hashStateRoot == ::ChainActive().Tip()->hashStateRoot);
+    for (int height = 0; height <= snapshot->height; height++) {
+        BOOST_CHECK((*snapshot)[height] == ::ChainActive()[height]);
+    }
+    BOOST_CHECK((*snapshot)[snapshot->height + 1] == nullptr);
+    BOOST_CHECK((*snapshot)[-1] == nullptr);
+    for (const auto& block : blocks) {
+        const CBlockIndex* pindex = LookupBlockIndex(block->GetHash());
+        BOOST_CHECK(LookupBlockIndexShared(block->GetHash()) == pindex);
+        BOOST_CHECK_EQUAL(snapshot->Contains(pindex), ::ChainActive().Contains(pindex));
+    }
 }
 
 /**
@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <blockcache.h>
 #include <chainparams.h>
 #include <net.h>
 #include <validation.h>
@@ -102,4 +103,68 @@ BOOST_AUTO_TEST_CASE(test_combiner_all)
     Test.disconnect(&ReturnTrue);
     BOOST_CHECK(Test());
 }
+BOOST_AUTO_TEST_CASE(recent_block_cache)
+{
+    auto make_block = [](uint32_t nonce) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vout.resize(1);
+        tx.vout[0].nValue = nonce;
+        auto pblock = std::make_shared<CBlock>();
+        pblock->nNonce = nonce;
+        pblock->vtx.push_back(MakeTransactionRef(std::move(tx)));
+        return std::shared_ptr<const CBlock>(pblock);
+    };
+    std::vector<std::shared_ptr<const CBlock>> blocks;
+    for (uint32_t i = 0; i < 4; i++)
+        blocks.push_back(make_block(i));
+
+    RecentBlockCache cache;
+    for (const auto& pblock : blocks)
+        cache.Add(pblock);
+    for (const auto& pblock : blocks)
+        BOOST_CHECK(cache.Get(pblock->GetHash()) == pblock);
+
+    // Shrinking the budget keeps the most recently used block
+    cache.Get(blocks[1]->GetHash());
+    cache.SetMaxBytes(1);
+    BOOST_CHECK(cache.Get(blocks[1]->GetHash()) == blocks[1]);
+    BOOST_CHECK(!cache.Get(blocks[3]->GetHash()));
+
+    cache.SetMaxBytes(0);
+    BOOST_CHECK(!cache.Get(blocks[1]->GetHash()));
+    cache.Add(blocks[0]);
+    BOOST_CHECK(!cache.Get(blocks[0]->GetHash()));
+}
+
+BOOST_FIXTURE_TEST_CASE(active_blocks_by_time, TestChain100Setup)
+{
+    // Logical timestamps computed the way the -addrindex timestamp index does
+    std::vector<std::pair<uint256, unsigned int>> expected;
+    {
+        LOCK(cs_main);
+        unsigned int prev = 0;
+        for (int height = 1; height <= ::ChainActive().Height(); height++) {
+            const CBlockIndex* pindex = ::ChainActive()[height];
+            unsigned int logical = pindex->nTime <= prev ? prev + 1 : pindex->nTime;
+            expected.emplace_back(pindex->GetBlockHash(), logical);
+            prev = logical;
+        }
+    }
+    BOOST_REQUIRE(expected.size() > 20);
+
+    std::vector<std::pair<uint256, unsigned int>> hashes;
+    FindActiveBlocksByTime(std::numeric_limits<unsigned int>::max(), 0, hashes);
+    BOOST_CHECK(hashes == expected);
+
+    // [low, high) around a part of the chain
+    hashes.clear();
+    FindActiveBlocksByTime(expected[20].second, expected[10].second, hashes);
+    BOOST_CHECK(hashes == std::vector<std::pair<uint256, unsigned int>>(expected.begin() + 10, expected.begin() + 20));
+
+    hashes.clear();
+    FindActiveBlocksByTime(expected[0].second, 0, hashes);
+    BOOST_CHECK(hashes.empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -5,16 +5,19 @@
 
 #include <txdb.h>
 
+#include <dbscheduler.h>
 #include <pow.h>
 #include <random.h>
 #include <shutdown.h>
 #include <ui_interface.h>
 #include <uint256.h>
+#include <util/memory.h>
 #include <util/system.h>
 #include <util/translation.h>
 #include <validation.h>
 #include <chainparams.h>
 
+#include <limits>
 #include <stdint.h>
 
 #include <boost/thread.hpp>
@@ -27,6 +30,9 @@ static const char DB_BLOCK_INDEX = 'b';
 ////////////////////////////////////////// // qtum
 static const char DB_HEIGHTINDEX = 'h';
 static const char DB_STAKEINDEX = 's';
+static const char DB_RECEIPT_PRUNE_HEIGHT = 'P';
+static const char DB_STATE_PRUNE_HEIGHT = 'T';
+static const char DB_ADDRESSHEIGHTINDEX = 'j';
 //////////////////////////////////////////
 
 static const char DB_BEST_BLOCK = 'B';
@@ -35,16 +41,6 @@ static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
 
-#ifdef ENABLE_BITCORE_RPC
-////////////////////////////////////////// // qtum
-static const char DB_ADDRESSINDEX = 'a';
-static const char DB_ADDRESSUNSPENTINDEX = 'u';
-static const char DB_TIMESTAMPINDEX = 'S';
-static const char DB_BLOCKHASHINDEX = 'z';
-static const char DB_SPENTINDEX = 'p';
-//////////////////////////////////////////
-#endif
-
 namespace {
 
 struct CoinEntry {
@@ -97,6 +93,12 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
 }
 
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    bool ret = WriteCoins(mapCoins, hashBlock);
+    mapCoins.clear();
+    return ret;
+}
+
+bool CCoinsViewDB::WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
@@ -121,7 +123,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     batch.Erase(DB_BEST_BLOCK);
     batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, old_tip});
 
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); ++it) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
             CoinEntry entry(&it->first);
             if (it->second.coin.IsSpent())
@@ -131,8 +133,6 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             db.WriteBatch(batch);
@@ -157,12 +157,106 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     return ret;
 }
 
+CCoinsViewFlushBuffer::CCoinsViewFlushBuffer(CCoinsView* viewIn, CCoinsViewDB& db) : CCoinsViewBacked(viewIn), m_db(db) {}
+
+CCoinsViewFlushBuffer::~CCoinsViewFlushBuffer()
+{
+    Wait();
+}
+
+bool CCoinsViewFlushBuffer::GetCoin(const COutPoint &outpoint, Coin &coin) const
+{
+    {
+        LOCK(m_mutex);
+        if (m_changes) {
+            CCoinsMap::const_iterator it = m_changes->coins.find(outpoint);
+            if (it != m_changes->coins.end()) {
+                coin = it->second.coin;
+                return !coin.IsSpent();
+            }
+        }
+    }
+    // Outpoints the write does not touch read the same from the database before and after it
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewFlushBuffer::HaveCoin(const COutPoint &outpoint) const
+{
+    Coin coin;
+    return GetCoin(outpoint, coin);
+}
+
+uint256 CCoinsViewFlushBuffer::GetBestBlock() const
+{
+    {
+        LOCK(m_mutex);
+        if (m_changes) return m_changes->hashBlock;
+    }
+    return base->GetBestBlock();
+}
+
+bool CCoinsViewFlushBuffer::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock)
+{
+    if (!Wait()) {
+        mapCoins.clear();
+        return false;
+    }
+
+    std::unique_ptr<Changes> changes = MakeUnique<Changes>();
+    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); it = mapCoins.erase(it)) {
+        if (!(it->second.flags & CCoinsCacheEntry::DIRTY)) continue;
+        CCoinsCacheEntry& entry = changes->coins[it->first];
+        entry.coin = std::move(it->second.coin);
+        entry.flags = CCoinsCacheEntry::DIRTY;
+        changes->coinsUsage += entry.coin.DynamicMemoryUsage();
+    }
+    changes->hashBlock = hashBlock;
+
+    const Changes* pchanges = changes.get();
+    {
+        LOCK(m_mutex);
+        m_changes = std::move(changes);
+    }
+    // The changes are not modified until the write completes, so lookups read them concurrently
+    m_thread = std::thread(&TraceThread<std::function<void()>>, "coinsflush", std::function<void()>([this, pchanges] {
+        bool fOk = false;
+        try {
+            DBPriorityScope priority(DB_FLUSH_MAX_DEFER);
+            fOk = m_db.WriteCoins(pchanges->coins, pchanges->hashBlock);
+        } catch (const std::exception& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+        }
+        LOCK(m_mutex);
+        if (fOk) {
+            m_changes.reset();
+        } else {
+            m_failed = true;
+        }
+    }));
+    return true;
+}
+
+bool CCoinsViewFlushBuffer::Wait()
+{
+    if (m_thread.joinable()) m_thread.join();
+    LOCK(m_mutex);
+    return !m_failed;
+}
+
+size_t CCoinsViewFlushBuffer::DynamicMemoryUsage() const
+{
+    LOCK(m_mutex);
+    if (!m_changes) return 0;
+    return memusage::DynamicUsage(m_changes->coins) + m_changes->coinsUsage;
+}
+
 size_t CCoinsViewDB::EstimateSize() const
 {
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index", nCacheSize, fMemory, fWipe) {
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index", nCacheSize, fMemory, fWipe)
+{
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -202,6 +296,30 @@ CCoinsViewCursor *CCoinsViewDB::Cursor() const
     return i;
 }
 
+std::vector<std::unique_ptr<CCoinsViewDBCursor>> CCoinsViewDB::Cursors(size_t count) const
+{
+    std::shared_ptr<const leveldb::Snapshot> snapshot = db.GetSnapshot();
+
+    // The best block is read from the snapshot too, GetBestBlock could see a later write
+    uint256 hashBestChain;
+    {
+        std::unique_ptr<CDBIterator> it(db.NewIterator(snapshot));
+        it->Seek(DB_BEST_BLOCK);
+        char key;
+        if (!it->Valid() || !it->GetKey(key) || key != DB_BEST_BLOCK || !it->GetValue(hashBestChain)) {
+            hashBestChain.SetNull();
+        }
+    }
+
+    std::vector<std::unique_ptr<CCoinsViewDBCursor>> cursors;
+    for (size_t i = 0; i < count; ++i) {
+        std::unique_ptr<CCoinsViewDBCursor> cursor(new CCoinsViewDBCursor(db.NewIterator(snapshot), hashBestChain));
+        cursor->Seek(COutPoint(uint256(), 0));
+        cursors.push_back(std::move(cursor));
+    }
+    return cursors;
+}
+
 bool CCoinsViewDBCursor::GetKey(COutPoint &key) const
 {
     // Return cached key
@@ -238,6 +356,17 @@ void CCoinsViewDBCursor::Next()
     }
 }
 
+void CCoinsViewDBCursor::Seek(const COutPoint& start)
+{
+    pcursor->Seek(CoinEntry(&start));
+    CoinEntry entry(&keyTmp.second);
+    if (!pcursor->Valid() || !pcursor->GetKey(entry)) {
+        keyTmp.first = 0;
+    } else {
+        keyTmp.first = entry.key;
+    }
+}
+
 bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo) {
     CDBBatch batch(*this);
     for (std::vector<std::pair<int, const CBlockFileInfo*> >::const_iterator it=fileInfo.begin(); it != fileInfo.end(); it++) {
@@ -245,11 +374,49 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     }
     batch.Write(DB_LAST_BLOCK, nLastFile);
     for (std::vector<const CBlockIndex*>::const_iterator it=blockinfo.begin(); it != blockinfo.end(); it++) {
-        batch.Write(std::make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()), CDiskBlockIndex(*it));
+        CDiskBlockIndex diskindex(*it);
+        // The signature of entries loaded at startup is not kept in memory, rewrite the stored one
+        if (diskindex.vchBlockSig.empty() && diskindex.IsProofOfStake() && !ReadBlockSignature((*it)->GetBlockHash(), diskindex.vchBlockSig))
+            return error("%s: failed to read the signature of block %s", __func__, (*it)->GetBlockHash().ToString());
+        batch.Write(std::make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()), diskindex);
     }
     return WriteBatch(batch, true);
 }
 
+bool CBlockTreeDB::ReadBlockSignature(const uint256& hash, std::vector<unsigned char>& vchBlockSig) {
+    {
+        LOCK(cs_sig_cache);
+        auto it = m_sig_cache_index.find(hash);
+        if (it != m_sig_cache_index.end()) {
+            m_sig_cache.splice(m_sig_cache.end(), m_sig_cache, it->second);
+            vchBlockSig = it->second->second;
+            return true;
+        }
+    }
+
+    CDiskBlockIndex diskindex;
+    if (!Read(std::make_pair(DB_BLOCK_INDEX, hash), diskindex))
+        return false;
+    vchBlockSig = std::move(diskindex.vchBlockSig);
+
+    // The signature of a block hash never changes, nothing has to be evicted on writes
+    LOCK(cs_sig_cache);
+    if (m_sig_cache_index.count(hash) == 0) {
+        m_sig_cache.emplace_back(hash, vchBlockSig);
+        m_sig_cache_index.emplace(hash, std::prev(m_sig_cache.end()));
+        if (m_sig_cache.size() > nBlockSigCacheSize) {
+            m_sig_cache_index.erase(m_sig_cache.front().first);
+            m_sig_cache.pop_front();
+        }
+    }
+    return true;
+}
+
+bool ReadBlockIndexSignature(const CBlockIndex& index, std::vector<unsigned char>& vchBlockSig)
+{
+    return pblocktree && pblocktree->ReadBlockSignature(index.GetBlockHash(), vchBlockSig);
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
@@ -266,9 +433,48 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
 bool CBlockTreeDB::WriteHeightIndex(const CHeightTxIndexKey &heightIndex, const std::vector<uint256>& hash) {
     CDBBatch batch(*this);
     batch.Write(std::make_pair(DB_HEIGHTINDEX, heightIndex), hash);
+    batch.Write(std::make_pair(DB_ADDRESSHEIGHTINDEX, CAddressHeightIndexKey(heightIndex.address, heightIndex.height)), hash);
     return WriteBatch(batch);
 }
 
+void CBlockTreeDB::EraseHeightIndexEntry(CDBBatch& batch, const CHeightTxIndexKey& key) {
+    batch.Erase(std::make_pair(DB_HEIGHTINDEX, key));
+    batch.Erase(std::make_pair(DB_ADDRESSHEIGHTINDEX, CAddressHeightIndexKey(key.address, key.height)));
+}
+
+int CBlockTreeDB::ReadLastIndexedHeight(int low, int high, int minconf) {
+
+    if (minconf > 0) {
+        int maxconfirmed = ::ChainActive().Height() - minconf;
+        if (maxconfirmed < low) {
+            return 0;
+        }
+        if (high == -1 || maxconfirmed < high) {
+            high = maxconfirmed;
+        }
+    }
+
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+
+    // step back from the first key after the range
+    if (high > -1) {
+        pcursor->Seek(std::make_pair(DB_HEIGHTINDEX, CHeightTxIndexIteratorKey(high + 1)));
+    } else {
+        pcursor->Seek(char(DB_HEIGHTINDEX + 1));
+    }
+    if (pcursor->Valid()) {
+        pcursor->Prev();
+    } else {
+        pcursor->SeekToLast();
+    }
+
+    std::pair<char, CHeightTxIndexKey> key;
+    if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_HEIGHTINDEX || (int)key.second.height < low) {
+        return 0;
+    }
+    return key.second.height;
+}
+
 int CBlockTreeDB::ReadHeightIndex(int low, int high, int minconf,
         std::vector<std::vector<uint256>> &blocksOfHashes,
         std::set<dev::h160> const &addresses) {
@@ -277,6 +483,36 @@ int CBlockTreeDB::ReadHeightIndex(int low, int high, int minconf,
        return -1;
     }
 
+    // a few addresses over a long range seek each address instead of rejecting every other contract in the range
+    if (fAddressHeightIndex && !addresses.empty() && (high == -1 || addresses.size() < (size_t)(high - low + 1))) {
+        int curheight = ReadLastIndexedHeight(low, high, minconf);
+        if (curheight == 0) {
+            return 0;
+        }
+
+        // same order as the height ordered scan
+        std::map<std::pair<unsigned int, dev::h160>, std::vector<uint256>> entries;
+        std::unique_ptr<CDBIterator> pcursor(NewIterator());
+        for (const dev::h160& address : addresses) {
+            pcursor->Seek(std::make_pair(DB_ADDRESSHEIGHTINDEX, CAddressHeightIndexKey(address, low)));
+            for (; pcursor->Valid(); pcursor->Next()) {
+                std::pair<char, CAddressHeightIndexKey> key;
+                if (!pcursor->GetKey(key) || key.first != DB_ADDRESSHEIGHTINDEX || key.second.address != address || (int)key.second.height > curheight) {
+                    break;
+                }
+                std::vector<uint256> hashesTx;
+                if (!pcursor->GetValue(hashesTx)) {
+                    break;
+                }
+                entries[std::make_pair(key.second.height, address)] = std::move(hashesTx);
+            }
+        }
+        for (auto& entry : entries) {
+            blocksOfHashes.push_back(std::move(entry.second));
+        }
+        return curheight;
+    }
+
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
     pcursor->Seek(std::make_pair(DB_HEIGHTINDEX, CHeightTxIndexIteratorKey(low)));
@@ -324,39 +560,60 @@ int CBlockTreeDB::ReadHeightIndex(int low, int high, int minconf,
     return curheight;
 }
 
-bool CBlockTreeDB::EraseHeightIndex(const unsigned int &height) {
+bool CBlockTreeDB::UpgradeHeightIndex() {
+
+    bool fUpgraded = false;
+    if (ReadFlag("addressheightindex", fUpgraded) && fUpgraded) {
+        fAddressHeightIndex = true;
+        return true;
+    }
 
+    LogPrintf("Upgrading height index to address ordered lookups...\n");
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
     CDBBatch batch(*this);
 
-    pcursor->Seek(std::make_pair(DB_HEIGHTINDEX, CHeightTxIndexIteratorKey(height)));
+    pcursor->Seek(DB_HEIGHTINDEX);
 
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         std::pair<char, CHeightTxIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_HEIGHTINDEX && key.second.height == height) {
-            batch.Erase(key);
+        std::vector<uint256> hashesTx;
+        if (pcursor->GetKey(key) && key.first == DB_HEIGHTINDEX) {
+            if (!pcursor->GetValue(hashesTx)) {
+                return error("%s: cannot parse height index entry", __func__);
+            }
+            batch.Write(std::make_pair(DB_ADDRESSHEIGHTINDEX, CAddressHeightIndexKey(key.second.address, key.second.height)), hashesTx);
+            if (batch.SizeEstimate() > nDefaultDbBatchSize) {
+                if (!WriteBatch(batch)) {
+                    return false;
+                }
+                batch.Clear();
+            }
             pcursor->Next();
         } else {
             break;
         }
     }
 
-    return WriteBatch(batch);
+    if (!WriteBatch(batch) || !WriteFlag("addressheightindex", true)) {
+        return false;
+    }
+    fAddressHeightIndex = true;
+    return true;
 }
 
-bool CBlockTreeDB::WipeHeightIndex() {
+bool CBlockTreeDB::EraseHeightIndex(const unsigned int &height) {
 
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
     CDBBatch batch(*this);
 
-    pcursor->Seek(DB_HEIGHTINDEX);
+    pcursor->Seek(std::make_pair(DB_HEIGHTINDEX, CHeightTxIndexIteratorKey(height)));
 
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         std::pair<char, CHeightTxIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_HEIGHTINDEX) {
-            batch.Erase(key);
+        if (pcursor->GetKey(key) && key.first == DB_HEIGHTINDEX && key.second.height == height) {
+            EraseHeightIndexEntry(batch, key.second);
             pcursor->Next();
         } else {
             break;
@@ -366,184 +623,108 @@ bool CBlockTreeDB::WipeHeightIndex() {
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::PruneHeightIndex(const unsigned int &height) {
 
-bool CBlockTreeDB::WriteStakeIndex(unsigned int height, uint160 address) {
-    CDBBatch batch(*this);
-    batch.Write(std::make_pair(DB_STAKEINDEX, height), address);
-    return WriteBatch(batch);
-}
-
-bool CBlockTreeDB::ReadStakeIndex(unsigned int height, uint160& address){
-    std::unique_ptr<CDBIterator> pcursor(NewIterator());
-
-    pcursor->Seek(std::make_pair(DB_STAKEINDEX, height));
-
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char, CHeightTxIndexKey> key;
-        pcursor->GetKey(key); //note: it's apparently ok if this returns an error https://github.com/bitcoin/bitcoin/issues/7890
-        if (key.first == DB_STAKEINDEX) {
-            pcursor->GetValue(address);
-            return true;
-        }else{
-            return false;
-        }
-    }
-    return false;
-}
-bool CBlockTreeDB::ReadStakeIndex(unsigned int high, unsigned int low, std::vector<uint160> addresses){
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    CDBBatch batch(*this);
 
-    pcursor->Seek(std::make_pair(DB_STAKEINDEX, low));
+    pcursor->Seek(DB_HEIGHTINDEX);
 
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         std::pair<char, CHeightTxIndexKey> key;
-        pcursor->GetKey(key); //note: it's apparently ok if this returns an error https://github.com/bitcoin/bitcoin/issues/7890
-        if (key.first == DB_STAKEINDEX && key.second.height < high) {
-            uint160 value;
-            pcursor->GetValue(value);
-            addresses.push_back(value);
+        if (pcursor->GetKey(key) && key.first == DB_HEIGHTINDEX && key.second.height <= height) {
+            EraseHeightIndexEntry(batch, key.second);
             pcursor->Next();
         } else {
             break;
         }
     }
 
+    if (!WriteBatch(batch)) {
+        return false;
+    }
+    CompactRange(std::make_pair(DB_HEIGHTINDEX, CHeightTxIndexIteratorKey(0)), std::make_pair(DB_HEIGHTINDEX, CHeightTxIndexIteratorKey(height + 1)));
+    // the pruned address ordered entries are spread over the whole address range
+    CompactRange(DB_ADDRESSHEIGHTINDEX, char(DB_ADDRESSHEIGHTINDEX + 1));
     return true;
 }
 
-bool CBlockTreeDB::EraseStakeIndex(unsigned int height) {
-
-    std::unique_ptr<CDBIterator> pcursor(NewIterator());
-    CDBBatch batch(*this);
-
-    pcursor->Seek(std::make_pair(DB_STAKEINDEX, height));
-
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char, CHeightTxIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_HEIGHTINDEX && key.second.height == height) {
-            batch.Erase(key);
-            pcursor->Next();
-        } else {
-            break;
-        }
-    }
+bool CBlockTreeDB::WriteReceiptPruneHeight(int height) {
+    return Write(DB_RECEIPT_PRUNE_HEIGHT, height);
+}
 
-    return WriteBatch(batch);
+bool CBlockTreeDB::ReadReceiptPruneHeight(int &height) {
+    return Read(DB_RECEIPT_PRUNE_HEIGHT, height);
 }
 
-#ifdef ENABLE_BITCORE_RPC
-bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Write(std::make_pair(DB_ADDRESSINDEX, it->first), it->second);
-    return WriteBatch(batch);
+bool CBlockTreeDB::WriteStatePruneHeight(int height) {
+    return Write(DB_STATE_PRUNE_HEIGHT, height);
 }
 
-bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Erase(std::make_pair(DB_ADDRESSINDEX, it->first));
-    return WriteBatch(batch);
+bool CBlockTreeDB::ReadStatePruneHeight(int &height) {
+    return Read(DB_STATE_PRUNE_HEIGHT, height);
 }
 
-bool CBlockTreeDB::ReadAddressIndex(uint256 addressHash, int type,
-                                    std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                                    int start, int end) {
+bool CBlockTreeDB::WipeHeightIndex() {
 
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    CDBBatch batch(*this);
 
-    if (start > 0 && end > 0) {
-        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
-    } else {
-        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
-    }
+    pcursor->Seek(DB_HEIGHTINDEX);
 
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        std::pair<char,CAddressIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash) {
-            if (end > 0 && key.second.blockHeight > end) {
-                break;
-            }
-            CAmount nValue;
-            if (pcursor->GetValue(nValue)) {
-                addressIndex.push_back(std::make_pair(key.second, nValue));
-                pcursor->Next();
-            } else {
-                return error("failed to get address index value");
-            }
+        std::pair<char, CHeightTxIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_HEIGHTINDEX) {
+            EraseHeightIndexEntry(batch, key.second);
+            pcursor->Next();
         } else {
             break;
         }
     }
 
-    return true;
+    return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
+
+bool CBlockTreeDB::WriteStakeIndex(unsigned int height, uint160 address) {
     CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(std::make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
-        } else {
-            batch.Write(std::make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
-        }
-    }
+    batch.Write(std::make_pair(DB_STAKEINDEX, height), address);
     return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::ReadAddressUnspentIndex(uint256 addressHash, int type,
-                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
-
+bool CBlockTreeDB::ReadStakeIndex(unsigned int height, uint160& address){
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
-    pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+
+    pcursor->Seek(std::make_pair(DB_STAKEINDEX, height));
 
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        std::pair<char,CAddressUnspentKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
-            CAddressUnspentValue nValue;
-            if (pcursor->GetValue(nValue)) {
-                unspentOutputs.push_back(std::make_pair(key.second, nValue));
-                pcursor->Next();
-            } else {
-                return error("failed to get address unspent value");
-            }
-        } else {
-            break;
+        std::pair<char, CHeightTxIndexKey> key;
+        pcursor->GetKey(key); //note: it's apparently ok if this returns an error https://github.com/bitcoin/bitcoin/issues/7890
+        if (key.first == DB_STAKEINDEX) {
+            pcursor->GetValue(address);
+            return true;
+        }else{
+            return false;
         }
     }
-
-    return true;
-}
-
-bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
-    CDBBatch batch(*this);
-    batch.Write(std::make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
-    return WriteBatch(batch);
+    return false;
 }
-
-bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &hashes) {
-
+bool CBlockTreeDB::ReadStakeIndex(unsigned int high, unsigned int low, std::vector<uint160> addresses){
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
-    pcursor->Seek(std::make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low)));
+    pcursor->Seek(std::make_pair(DB_STAKEINDEX, low));
 
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        std::pair<char, CTimestampIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp < high) {
-            if (fActiveOnly) {
-                if (blockOnchainActive(key.second.blockHash)) {
-                    hashes.push_back(std::make_pair(key.second.blockHash, key.second.timestamp));
-                }
-            } else {
-                hashes.push_back(std::make_pair(key.second.blockHash, key.second.timestamp));
-            }
-
+        std::pair<char, CHeightTxIndexKey> key;
+        pcursor->GetKey(key); //note: it's apparently ok if this returns an error https://github.com/bitcoin/bitcoin/issues/7890
+        if (key.first == DB_STAKEINDEX && key.second.height < high) {
+            uint160 value;
+            pcursor->GetValue(value);
+            addresses.push_back(value);
             pcursor->Next();
         } else {
             break;
@@ -553,48 +734,40 @@ bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned i
     return true;
 }
 
-bool CBlockTreeDB::WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts) {
+bool CBlockTreeDB::EraseStakeIndex(unsigned int height) {
+    // stake entries are keyed by the height alone, as WriteStakeIndex writes them
     CDBBatch batch(*this);
-    batch.Write(std::make_pair(DB_BLOCKHASHINDEX, blockhashIndex), logicalts);
+    batch.Erase(std::make_pair(DB_STAKEINDEX, height));
     return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::ReadTimestampBlockIndex(const uint256 &hash, unsigned int &ltimestamp) {
-
-    CTimestampBlockIndexValue(lts);
-    if (!Read(std::make_pair(DB_BLOCKHASHINDEX, hash), lts))
-       return false;
+bool CBlockTreeDB::EraseBlockRange(unsigned int low, unsigned int high, bool fHeightIndex) {
 
-    ltimestamp = lts.ltimestamp;
-    return true;
-}
+    CDBBatch batch(*this);
 
-bool CBlockTreeDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value) {
-    return Read(std::make_pair(DB_SPENTINDEX, key), value);
-}
+    if (fHeightIndex) {
+        std::unique_ptr<CDBIterator> pcursor(NewIterator());
+        pcursor->Seek(std::make_pair(DB_HEIGHTINDEX, CHeightTxIndexIteratorKey(low)));
 
-bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(std::make_pair(DB_SPENTINDEX, it->first));
-        } else {
-            batch.Write(std::make_pair(DB_SPENTINDEX, it->first), it->second);
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            std::pair<char, CHeightTxIndexKey> key;
+            if (pcursor->GetKey(key) && key.first == DB_HEIGHTINDEX && key.second.height <= high) {
+                EraseHeightIndexEntry(batch, key.second);
+                pcursor->Next();
+            } else {
+                break;
+            }
         }
     }
-    return WriteBatch(batch);
-}
 
-bool CBlockTreeDB::blockOnchainActive(const uint256 &hash) {
-    CBlockIndex* pblockindex = ::BlockIndex()[hash];
-
-    if (!::ChainActive().Contains(pblockindex)) {
-       return false;
+    for (unsigned int height = low; height <= high; height++) {
+        batch.Erase(std::make_pair(DB_STAKEINDEX, height));
     }
 
-    return true;
+    return WriteBatch(batch);
 }
-#endif
+
 ///////////////////////////////////////////////////////
 
 bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
@@ -630,7 +803,7 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
                 pindexNew->hashUTXORoot   = diskindex.hashUTXORoot; // qtum
                 pindexNew->nStakeModifier = diskindex.nStakeModifier;
                 pindexNew->prevoutStake   = diskindex.prevoutStake;
-                pindexNew->vchBlockSig    = diskindex.vchBlockSig; // qtum
+                // vchBlockSig is left on disk, see ReadBlockIndexSignature()
 
                 if (!CheckIndexProof(*pindexNew, Params().GetConsensus()))
                     return error("%s: CheckIndexProof failed: %s", __func__, pindexNew->ToString());
@@ -10,12 +10,16 @@
 #include <dbwrapper.h>
 #include <chain.h>
 #include <primitives/block.h>
+#include <sync.h>
 #include <libdevcore/Common.h>
 #include <libdevcore/FixedHash.h>
 
+#include <list>
 #include <map>
 #include <memory>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -23,6 +27,7 @@ class CBlockIndex;
 class CCoinsViewDBCursor;
 class uint256;
 struct CHeightTxIndexKey;
+struct CAddressHeightIndexKey;
 struct CHeightTxIndexIteratorKey;
 #ifdef ENABLE_BITCORE_RPC
 //////////////////////////////////// //qtum
@@ -56,10 +61,26 @@ static const int64_t nMaxBlockDBCache = 2;
 // Unlike for the UTXO database, for the txindex scenario the leveldb cache make
 // a meaningful difference: https://github.com/bitcoin/bitcoin/pull/8273#issuecomment-229601991
 static const int64_t nMaxTxIndexCache = 1024;
+//! Max memory allocated to log index DB specific cache (MiB)
+static const int64_t nMaxLogIndexCache = 256;
+//! Max memory allocated to token index DB specific cache (MiB)
+static const int64_t nMaxTokenIndexCache = 256;
+//! Max memory allocated to contract index DB specific cache (MiB)
+static const int64_t nMaxContractIndexCache = 64;
+//! Max memory allocated to governance index DB specific cache (MiB)
+static const int64_t nMaxGovernanceIndexCache = 16;
+//! Max memory allocated to coin stats index DB specific cache (MiB)
+static const int64_t nMaxCoinStatsIndexCache = 16;
+//! Max memory allocated to address index DB specific cache (MiB)
+static const int64_t nMaxAddressIndexCache = 1024;
 //! Max memory allocated to all block filter index caches combined in MiB.
 static const int64_t max_filter_index_cache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! Number of proof-of-stake block signatures kept after being read back from the block tree DB, a headers message has 2000
+static const size_t nBlockSigCacheSize = 4096;
+//! Max memory allocated to uncommitted EVM state trie nodes (MiB)
+static const int64_t nMaxStateCache = 256;
 
 struct CDiskTxPos : public FlatFilePos
 {
@@ -104,6 +125,12 @@ public:
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
 
+    //! Get cursors over one snapshot of the coins, so several threads can read the same state.
+    std::vector<std::unique_ptr<CCoinsViewDBCursor>> Cursors(size_t count) const;
+
+    //! Write the dirty entries of mapCoins without modifying it, so other threads can keep reading it.
+    bool WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock);
+
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
@@ -122,6 +149,9 @@ public:
     bool Valid() const override;
     void Next() override;
 
+    //! Move to the first coin at or after start.
+    void Seek(const COutPoint& start);
+
 private:
     CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn):
         CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn) {}
@@ -131,6 +161,79 @@ private:
     friend class CCoinsViewDB;
 };
 
+/**
+ * Layer between the coins cache and the coin database that takes over the changes of a
+ * flush, so the cache is emptied right away and the changes are written to the database
+ * on a background thread. Until the write completes, lookups are answered from the
+ * changes being written. A flush waits for the write of the previous one, and a failed
+ * write keeps its changes readable and fails every later flush.
+ */
+class CCoinsViewFlushBuffer final : public CCoinsViewBacked
+{
+public:
+    CCoinsViewFlushBuffer(CCoinsView* viewIn, CCoinsViewDB& db);
+    ~CCoinsViewFlushBuffer();
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    bool HaveCoin(const COutPoint &outpoint) const override;
+    uint256 GetBestBlock() const override;
+    //! Take the dirty entries of mapCoins over and start writing them, the map is left empty.
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+
+    //! Wait for the write in progress. Returns false when a write has failed.
+    bool Wait();
+
+    //! Memory held by the changes being written.
+    size_t DynamicMemoryUsage() const;
+
+private:
+    struct Changes {
+        CCoinsMapMemoryResource resource;
+        CCoinsMap coins{0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &resource};
+        uint256 hashBlock;
+        size_t coinsUsage = 0;
+    };
+
+    CCoinsViewDB& m_db;
+    mutable Mutex m_mutex;
+    //! The changes being written, null when there are none.
+    std::unique_ptr<const Changes> m_changes GUARDED_BY(m_mutex);
+    bool m_failed GUARDED_BY(m_mutex) = false;
+    std::thread m_thread;
+};
+
+#ifdef ENABLE_BITCORE_RPC
+/** Running totals of the address index entries of an address, so its balance is a point lookup */
+struct CAddressBalanceValue {
+    CAmount balance;
+    CAmount received;
+    int64_t txCount;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(balance);
+        READWRITE(received);
+        READWRITE(txCount);
+    }
+
+    CAddressBalanceValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+        txCount = 0;
+    }
+
+    bool IsNull() const {
+        return (balance == 0 && received == 0 && txCount == 0);
+    }
+};
+#endif
+
 /** Access to the block database (blocks/index/) */
 class CBlockTreeDB : public CDBWrapper
 {
@@ -139,6 +242,7 @@ public:
 
     bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo);
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo &info);
+    bool ReadBlockSignature(const uint256& hash, std::vector<unsigned char>& vchBlockSig);
     bool ReadLastBlockFile(int &nFile);
     bool WriteReindexing(bool fReindexing);
     void ReadReindexing(bool &fReindexing);
@@ -163,35 +267,49 @@ public:
     int ReadHeightIndex(int low, int high, int minconf,
             std::vector<std::vector<uint256>> &blocksOfHashes,
             std::set<dev::h160> const &addresses);
+    /** Add the address ordered copy of the height index when the database predates it */
+    bool UpgradeHeightIndex();
     bool EraseHeightIndex(const unsigned int &height);
+    /** Erase the entries of all blocks up to height and compact the range they used */
+    bool PruneHeightIndex(const unsigned int &height);
     bool WipeHeightIndex();
 
+    /** Height up to which -logeventsprune deleted the receipts and the height index */
+    bool WriteReceiptPruneHeight(int height);
+    bool ReadReceiptPruneHeight(int &height);
+
+    /** Lowest height whose contract state -prunestate kept */
+    bool WriteStatePruneHeight(int height);
+    bool ReadStatePruneHeight(int &height);
+
 
     bool WriteStakeIndex(unsigned int height, uint160 address);
     bool ReadStakeIndex(unsigned int height, uint160& address);
     bool ReadStakeIndex(unsigned int high, unsigned int low, std::vector<uint160> addresses);
     bool EraseStakeIndex(unsigned int height);
-
-#ifdef ENABLE_BITCORE_RPC
-    // Block explorer database functions
-    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
-    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
-    bool ReadAddressIndex(uint256 addressHash, int type,
-                        std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                        int start = 0, int end = 0);
-    bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
-    bool ReadAddressUnspentIndex(uint256 addressHash, int type,
-                                std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
-    bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
-    bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &vect);
-    bool WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts);
-    bool ReadTimestampBlockIndex(const uint256 &hash, unsigned int &logicalTS);
-    bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
-    bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
-    bool blockOnchainActive(const uint256 &hash);
-#endif
+    /** Erase the stake index entries of the heights low to high, and their height index entries when fHeightIndex, in one batch */
+    bool EraseBlockRange(unsigned int low, unsigned int high, bool fHeightIndex);
 
     //////////////////////////////////////////////////////////////////////////////
+
+private:
+    /** Whether every height index entry also has its address ordered copy */
+    bool fAddressHeightIndex = false;
+
+    /** Signatures read by ReadBlockSignature, least recently used first */
+    typedef std::list<std::pair<uint256, std::vector<unsigned char>>> BlockSigList;
+    struct BlockSigHasher
+    {
+        size_t operator()(const uint256& hash) const { return hash.GetUint64(0); }
+    };
+    Mutex cs_sig_cache;
+    BlockSigList m_sig_cache GUARDED_BY(cs_sig_cache);
+    std::unordered_map<uint256, BlockSigList::iterator, BlockSigHasher> m_sig_cache_index GUARDED_BY(cs_sig_cache);
+
+    /** Last height in the height index from low to high, as the height ordered scan would reach it */
+    int ReadLastIndexedHeight(int low, int high, int minconf);
+
+    void EraseHeightIndexEntry(CDBBatch& batch, const CHeightTxIndexKey& key);
 };
 
 //////////////////////////////////////////////////////////// // qtum
@@ -258,6 +376,42 @@ struct CHeightTxIndexKey {
     }
 };
 
+/** Same entries as CHeightTxIndexKey ordered by address first, for scans filtered on a few contracts */
+struct CAddressHeightIndexKey {
+    dev::h160 address;
+    unsigned int height;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 25;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s << address.asBytes();
+        ser_writedata32be(s, height);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        valtype tmp;
+        s >> tmp;
+        address = dev::h160(tmp);
+        height = ser_readdata32be(s);
+    }
+
+    CAddressHeightIndexKey(dev::h160 _address, unsigned int _height) {
+        address = _address;
+        height = _height;
+    }
+
+    CAddressHeightIndexKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        address.clear();
+        height = 0;
+    }
+};
+
 #ifdef ENABLE_BITCORE_RPC
 struct CTimestampIndexIteratorKey {
     unsigned int timestamp;
@@ -10,6 +10,7 @@
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
 #include <validation.h>
+#include <policy/exectime.h>
 #include <policy/policy.h>
 #include <policy/fees.h>
 #include <policy/settings.h>
@@ -21,12 +22,36 @@
 #include <script/sign.h>
 #endif
 
+static uint64_t GetContractTxsGas(const ContractTxsRef& contractTxs)
+{
+    uint64_t nGas = 0;
+    if (contractTxs) {
+        // Mempool accept keeps each gas limit within 32 bits
+        for (const QtumTransaction& qtumTransaction : contractTxs->first)
+            nGas += (uint64_t)qtumTransaction.gas();
+    }
+    return nGas;
+}
+
+/** Large creations are extracted again when mined rather than keeping their code twice for the whole stay in the mempool */
+static ContractTxsRef KeepContractTxs(const ContractTxsRef& contractTxs)
+{
+    size_t nData = 0;
+    if (contractTxs) {
+        for (const QtumTransaction& qtumTransaction : contractTxs->first)
+            nData += qtumTransaction.data().size();
+    }
+    return nData <= MAX_MEMPOOL_CONTRACT_TXS_DATA ? contractTxs : nullptr;
+}
+
 CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& _tx, const CAmount& _nFee,
                                  int64_t _nTime, unsigned int _entryHeight,
-                                 bool _spendsCoinbase, int64_t _sigOpsCost, LockPoints lp, CAmount _nMinGasPrice)
+                                 bool _spendsCoinbase, int64_t _sigOpsCost, LockPoints lp, CAmount _nMinGasPrice,
+                                 ContractTxsRef _contractTxs, unsigned int _nContractFlags)
     : tx(_tx), nFee(_nFee), nTxWeight(GetTransactionWeight(*tx)), nUsageSize(RecursiveDynamicUsage(tx)), nTime(_nTime), entryHeight(_entryHeight),
     spendsCoinbase(_spendsCoinbase), sigOpCost(_sigOpsCost), lockPoints(lp),
-    nMinGasPrice(_nMinGasPrice)
+    nMinGasPrice(_nMinGasPrice), contractTxs(KeepContractTxs(_contractTxs)), nContractFlags(_nContractFlags),
+    nGasLimit(GetContractTxsGas(_contractTxs)), nExecTime(0)
 {
     nCountWithDescendants = 1;
     nSizeWithDescendants = GetTxSize();
@@ -38,6 +63,8 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& _tx, const CAmount& _nFe
     nSizeWithAncestors = GetTxSize();
     nModFeesWithAncestors = nFee;
     nSigOpCostWithAncestors = sigOpCost;
+
+    m_epoch = 0;
 }
 
 void CTxMemPoolEntry::UpdateFeeDelta(int64_t newFeeDelta)
@@ -57,18 +84,33 @@ size_t CTxMemPoolEntry::GetTxSize() const
     return GetVirtualTransactionSize(nTxWeight, sigOpCost);
 }
 
+double CTxMemPoolEntry::GetEvictionGasPrice() const
+{
+    double fGasPrice = nMinGasPrice;
+    uint64_t nExpectedGas = (uint64_t)std::max<int64_t>(nExecTime, 0) * EXPECTED_GAS_PER_EXEC_MICRO;
+    if (nExpectedGas > nGasLimit) {
+        fGasPrice = fGasPrice * nGasLimit / nExpectedGas;
+    }
+    return fGasPrice;
+}
+
 // Update the given tx for any in-mempool descendants.
 // Assumes that setMemPoolChildren is correct for the given tx and all
 // descendants.
 void CTxMemPool::UpdateForDescendants(txiter updateIt, cacheMap &cachedDescendants, const std::set<uint256> &setExclude)
 {
-    setEntries stageEntries, setAllDescendants;
-    stageEntries = GetMemPoolChildren(updateIt);
+    const EpochGuard epoch(*this);
+    std::vector<txiter> stageEntries, allDescendants;
+    for (txiter childEntry : GetMemPoolChildren(updateIt)) {
+        if (!visited(childEntry)) {
+            stageEntries.push_back(childEntry);
+        }
+    }
 
     while (!stageEntries.empty()) {
-        const txiter cit = *stageEntries.begin();
-        setAllDescendants.insert(cit);
-        stageEntries.erase(cit);
+        const txiter cit = stageEntries.back();
+        stageEntries.pop_back();
+        allDescendants.push_back(cit);
         const setEntries &setChildren = GetMemPoolChildren(cit);
         for (txiter childEntry : setChildren) {
             cacheMap::iterator cacheIt = cachedDescendants.find(childEntry);
@@ -76,20 +118,22 @@ void CTxMemPool::UpdateForDescendants(txiter updateIt, cacheMap &cachedDescendan
                 // We've already calculated this one, just add the entries for this set
                 // but don't traverse again.
                 for (txiter cacheEntry : cacheIt->second) {
-                    setAllDescendants.insert(cacheEntry);
+                    if (!visited(cacheEntry)) {
+                        allDescendants.push_back(cacheEntry);
+                    }
                 }
-            } else if (!setAllDescendants.count(childEntry)) {
+            } else if (!visited(childEntry)) {
                 // Schedule for later processing
-                stageEntries.insert(childEntry);
+                stageEntries.push_back(childEntry);
             }
         }
     }
-    // setAllDescendants now contains all in-mempool descendants of updateIt.
+    // allDescendants now contains all in-mempool descendants of updateIt.
     // Update and add to cached descendant map
     int64_t modifySize = 0;
     CAmount modifyFee = 0;
     int64_t modifyCount = 0;
-    for (txiter cit : setAllDescendants) {
+    for (txiter cit : allDescendants) {
         if (!setExclude.count(cit->GetTx().GetHash())) {
             modifySize += cit->GetTxSize();
             modifyFee += cit->GetModifiedFee();
@@ -152,9 +196,14 @@ void CTxMemPool::UpdateTransactionsFromBlock(const std::vector<uint256> &vHashes
 
 bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntries &setAncestors, uint64_t limitAncestorCount, uint64_t limitAncestorSize, uint64_t limitDescendantCount, uint64_t limitDescendantSize, std::string &errString, bool fSearchForParents /* = true */) const
 {
-    setEntries parentHashes;
+    const EpochGuard epoch(*this);
+    std::vector<txiter> parentHashes;
     const CTransaction &tx = entry.GetTx();
 
+    for (txiter ancestor : setAncestors) {
+        visited(ancestor);
+    }
+
     if (fSearchForParents) {
         // Get parents of this transaction that are in the mempool
         // GetMemPoolParents() is only valid for entries in the mempool, so we
@@ -162,7 +211,9 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         for (unsigned int i = 0; i < tx.vin.size(); i++) {
             boost::optional<txiter> piter = GetIter(tx.vin[i].prevout.hash);
             if (piter) {
-                parentHashes.insert(*piter);
+                if (!visited(*piter)) {
+                    parentHashes.push_back(*piter);
+                }
                 if (parentHashes.size() + 1 > limitAncestorCount) {
                     errString = strprintf("too many unconfirmed parents [limit: %u]", limitAncestorCount);
                     return false;
@@ -173,16 +224,20 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         // If we're not searching for parents, we require this to be an
         // entry in the mempool already.
         txiter it = mapTx.iterator_to(entry);
-        parentHashes = GetMemPoolParents(it);
+        for (txiter parent : GetMemPoolParents(it)) {
+            if (!visited(parent)) {
+                parentHashes.push_back(parent);
+            }
+        }
     }
 
     size_t totalSizeWithAncestors = entry.GetTxSize();
 
     while (!parentHashes.empty()) {
-        txiter stageit = *parentHashes.begin();
+        txiter stageit = parentHashes.back();
 
         setAncestors.insert(stageit);
-        parentHashes.erase(stageit);
+        parentHashes.pop_back();
         totalSizeWithAncestors += stageit->GetTxSize();
 
         if (stageit->GetSizeWithDescendants() + entry.GetTxSize() > limitDescendantSize) {
@@ -199,8 +254,8 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         const setEntries & setMemPoolParents = GetMemPoolParents(stageit);
         for (txiter phash : setMemPoolParents) {
             // If this is a new ancestor, add it.
-            if (setAncestors.count(phash) == 0) {
-                parentHashes.insert(phash);
+            if (!visited(phash)) {
+                parentHashes.push_back(phash);
             }
             if (parentHashes.size() + setAncestors.size() + 1 > limitAncestorCount) {
                 errString = strprintf("too many unconfirmed ancestors [limit: %u]", limitAncestorCount);
@@ -338,6 +393,21 @@ CTxMemPool::CTxMemPool(CBlockPolicyEstimator* estimator)
     nCheckFrequency = 0;
 }
 
+CTxMemPool::EpochGuard::EpochGuard(const CTxMemPool& in) : pool(in)
+{
+    AssertLockHeld(pool.cs);
+    assert(!pool.m_has_epoch_guard);
+    ++pool.m_epoch;
+    pool.m_has_epoch_guard = true;
+}
+
+CTxMemPool::EpochGuard::~EpochGuard()
+{
+    // Entries visited in this epoch must not count as visited in the next one
+    ++pool.m_epoch;
+    pool.m_has_epoch_guard = false;
+}
+
 bool CTxMemPool::isSpent(const COutPoint& outpoint) const
 {
     LOCK(cs);
@@ -399,6 +469,7 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry, setEntries &setAnces
 
     nTransactionsUpdated++;
     totalTxSize += entry.GetTxSize();
+    totalGasLimit += entry.GetGasLimit();
     if (minerPolicyEstimator) {minerPolicyEstimator->processTransaction(entry, validFeeEstimate);}
 
     vTxHashes.emplace_back(tx.GetWitnessHash(), newit);
@@ -422,12 +493,16 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
         vTxHashes.clear();
 
     totalTxSize -= it->GetTxSize();
+    totalGasLimit -= it->GetGasLimit();
     cachedInnerUsage -= it->DynamicMemoryUsage();
     cachedInnerUsage -= memusage::DynamicUsage(mapLinks[it].parents) + memusage::DynamicUsage(mapLinks[it].children);
     mapLinks.erase(it);
     mapTx.erase(it);
     nTransactionsUpdated++;
     if (minerPolicyEstimator) {minerPolicyEstimator->removeTx(hash, false);}
+#ifdef ENABLE_BITCORE_RPC
+    removeAddressIndex(hash);
+#endif
 }
 
 // Calculates descendants of entry that are not already in setDescendants, and adds to
@@ -438,22 +513,24 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 // can save time by not iterating over those entries.
 void CTxMemPool::CalculateDescendants(txiter entryit, setEntries& setDescendants) const
 {
-    setEntries stage;
+    const EpochGuard epoch(*this);
+    std::vector<txiter> stage;
     if (setDescendants.count(entryit) == 0) {
-        stage.insert(entryit);
+        visited(entryit);
+        stage.push_back(entryit);
     }
     // Traverse down the children of entry, only adding children that are not
     // accounted for in setDescendants already (because those children have either
     // already been walked, or will be walked in this iteration).
     while (!stage.empty()) {
-        txiter it = *stage.begin();
+        txiter it = stage.back();
         setDescendants.insert(it);
-        stage.erase(it);
+        stage.pop_back();
 
         const setEntries &setChildren = GetMemPoolChildren(it);
         for (txiter childiter : setChildren) {
-            if (!setDescendants.count(childiter)) {
-                stage.insert(childiter);
+            if (!visited(childiter) && !setDescendants.count(childiter)) {
+                stage.push_back(childiter);
             }
         }
     }
@@ -584,7 +661,11 @@ void CTxMemPool::_clear()
     mapLinks.clear();
     mapTx.clear();
     mapNextTx.clear();
+#ifdef ENABLE_BITCORE_RPC
+    m_address_index.Clear();
+#endif
     totalTxSize = 0;
+    totalGasLimit = 0;
     cachedInnerUsage = 0;
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = false;
@@ -619,6 +700,7 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
     LogPrint(BCLog::MEMPOOL, "Checking mempool with %u transactions and %u inputs\n", (unsigned int)mapTx.size(), (unsigned int)mapNextTx.size());
 
     uint64_t checkTotal = 0;
+    uint64_t checkGasLimit = 0;
     uint64_t innerUsage = 0;
 
     CCoinsViewCache mempoolDuplicate(const_cast<CCoinsViewCache*>(pcoins));
@@ -628,6 +710,7 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
     for (indexed_transaction_set::const_iterator it = mapTx.begin(); it != mapTx.end(); it++) {
         unsigned int i = 0;
         checkTotal += it->GetTxSize();
+        checkGasLimit += it->GetGasLimit();
         innerUsage += it->DynamicMemoryUsage();
         const CTransaction& tx = it->GetTx();
         txlinksMap::const_iterator linksiter = mapLinks.find(it);
@@ -720,6 +803,7 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
     }
 
     assert(totalTxSize == checkTotal);
+    assert(totalGasLimit == checkGasLimit);
     assert(innerUsage == cachedInnerUsage);
 }
 
@@ -1068,6 +1152,46 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
     }
 }
 
+void CTxMemPool::TrimToGasLimit(uint64_t gaslimit, std::vector<COutPoint>* pvNoSpendsRemaining) {
+    AssertLockHeld(cs);
+
+    unsigned nTxnRemoved = 0;
+    CAmount maxGasPriceRemoved = 0;
+    while (!mapTx.empty() && totalGasLimit > gaslimit) {
+        indexed_transaction_set::index<gas_score>::type::iterator it = mapTx.get<gas_score>().begin();
+        // The contract txs sort first, so there are none left when this one has no gas
+        if (it->GetGasLimit() == 0)
+            break;
+        maxGasPriceRemoved = std::max(maxGasPriceRemoved, it->GetMinGasPrice());
+
+        setEntries stage;
+        CalculateDescendants(mapTx.project<0>(it), stage);
+        nTxnRemoved += stage.size();
+
+        std::vector<CTransaction> txn;
+        if (pvNoSpendsRemaining) {
+            txn.reserve(stage.size());
+            for (txiter iter : stage)
+                txn.push_back(iter->GetTx());
+        }
+        RemoveStaged(stage, false, MemPoolRemovalReason::SIZELIMIT);
+        if (pvNoSpendsRemaining) {
+            for (const CTransaction& tx : txn) {
+                for (const CTxIn& txin : tx.vin) {
+                    if (exists(txin.prevout.hash)) continue;
+                    if (!mapNextTx.count(txin.prevout)) {
+                        pvNoSpendsRemaining->push_back(txin.prevout);
+                    }
+                }
+            }
+        }
+    }
+
+    if (nTxnRemoved > 0) {
+        LogPrint(BCLog::MEMPOOL, "Removed %u txn over the mempool gas limit, up to gas price %d\n", nTxnRemoved, maxGasPriceRemoved);
+    }
+}
+
 uint64_t CTxMemPool::CalculateDescendantMaximum(txiter entry) const {
     // find parent with highest descendant count
     std::vector<txiter> candidates;
@@ -1116,11 +1240,10 @@ SaltedTxidHasher::SaltedTxidHasher() : k0(GetRand(std::numeric_limits<uint64_t>:
 
 #ifdef ENABLE_BITCORE_RPC
 /////////////////////////////////////////////////////// // qtum
-void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view)
+void CMempoolAddressIndex::Add(const CTransaction& tx, int64_t time, const CCoinsViewCache& view)
 {
-    LOCK(cs);
-    const CTransaction& tx = entry.GetTx();
-    std::vector<CMempoolAddressDeltaKey> inserted;
+    std::vector<std::pair<AddressKey, TxKey> > inserted;
+    std::vector<CMempoolAddressDelta> deltas;
 
     uint256 txhash = tx.GetHash();
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
@@ -1135,10 +1258,8 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
             }
             valtype addressBytes(32);
             std::copy(bytesID.begin(), bytesID.end(), addressBytes.begin());
-            CMempoolAddressDeltaKey key(dest.which(), uint256(addressBytes), txhash, j, 1);
-            CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            inserted.emplace_back(AddressKey{dest.which(), uint256(addressBytes)}, TxKey{txhash, j, 1});
+            deltas.emplace_back(time, prevout.nValue * -1, input.prevout.hash, input.prevout.n);
         }
     }
 
@@ -1153,41 +1274,110 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
             }
             valtype addressBytes(32);
             std::copy(bytesID.begin(), bytesID.end(), addressBytes.begin());
-            CMempoolAddressDeltaKey key(dest.which(), uint256(addressBytes), txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            inserted.emplace_back(AddressKey{dest.which(), uint256(addressBytes)}, TxKey{txhash, k, 0});
+            deltas.emplace_back(time, out.nValue);
         }
     }
 
-    mapAddressInserted.insert(std::make_pair(txhash, inserted));
+    // One shard locked at a time
+    for (size_t i = 0; i < inserted.size(); i++) {
+        Shard& shard = ShardOf(inserted[i].first);
+        LOCK(shard.mutex);
+        shard.buckets[inserted[i].first].emplace(inserted[i].second, deltas[i]);
+    }
+
+    LOCK(m_inserted_mutex);
+    m_inserted.emplace(txhash, std::move(inserted));
 }
 
-bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint256, int> > &addresses, std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > &results)
+void CMempoolAddressIndex::Remove(const uint256& txhash)
 {
-    LOCK(cs);
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        addressDeltaMap::iterator ait = mapAddress.lower_bound(CMempoolAddressDeltaKey((*it).second, (*it).first));
-        while (ait != mapAddress.end() && (*ait).first.addressBytes == (*it).first && (*ait).first.type == (*it).second) {
-            results.push_back(*ait);
-            ait++;
+    std::vector<std::pair<AddressKey, TxKey> > inserted;
+    {
+        LOCK(m_inserted_mutex);
+        auto it = m_inserted.find(txhash);
+        if (it == m_inserted.end()) {
+            return;
+        }
+        inserted = std::move(it->second);
+        m_inserted.erase(it);
+    }
+
+    for (const auto& entry : inserted) {
+        Shard& shard = ShardOf(entry.first);
+        LOCK(shard.mutex);
+        auto bucket = shard.buckets.find(entry.first);
+        if (bucket == shard.buckets.end()) {
+            continue;
+        }
+        bucket->second.erase(entry.second);
+        if (bucket->second.empty()) {
+            shard.buckets.erase(bucket);
         }
     }
-    return true;
 }
 
-bool CTxMemPool::removeAddressIndex(const uint256 txhash)
+void CMempoolAddressIndex::Get(const std::vector<std::pair<uint256, int> >& addresses,
+                               std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> >& results) const
 {
-    LOCK(cs);
-    addressDeltaMapInserted::iterator it = mapAddressInserted.find(txhash);
+    for (const auto& address : addresses) {
+        const AddressKey key{address.second, address.first};
+        const Shard& shard = ShardOf(key);
+        LOCK(shard.mutex);
+        auto bucket = shard.buckets.find(key);
+        if (bucket == shard.buckets.end()) {
+            continue;
+        }
+        for (const auto& entry : bucket->second) {
+            results.emplace_back(CMempoolAddressDeltaKey(key.type, key.bytes, entry.first.txhash, entry.first.index, entry.first.spending), entry.second);
+        }
+    }
+}
 
-    if (it != mapAddressInserted.end()) {
-        std::vector<CMempoolAddressDeltaKey> keys = (*it).second;
-        for (std::vector<CMempoolAddressDeltaKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapAddress.erase(*mit);
+void CMempoolAddressIndex::Clear()
+{
+    LOCK(m_inserted_mutex);
+    m_inserted.clear();
+    for (Shard& shard : m_shards) {
+        LOCK(shard.mutex);
+        shard.buckets.clear();
+    }
+}
+
+size_t CMempoolAddressIndex::DynamicMemoryUsage() const
+{
+    size_t usage = 0;
+    {
+        LOCK(m_inserted_mutex);
+        usage += memusage::DynamicUsage(m_inserted);
+        for (const auto& entry : m_inserted) {
+            usage += memusage::DynamicUsage(entry.second);
         }
-        mapAddressInserted.erase(it);
     }
+    for (const Shard& shard : m_shards) {
+        LOCK(shard.mutex);
+        usage += memusage::DynamicUsage(shard.buckets);
+        for (const auto& bucket : shard.buckets) {
+            usage += memusage::DynamicUsage(bucket.second);
+        }
+    }
+    return usage;
+}
+
+void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view)
+{
+    m_address_index.Add(entry.GetTx(), entry.GetTime(), view);
+}
 
+bool CTxMemPool::getAddressIndex(const std::vector<std::pair<uint256, int> > &addresses, std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > &results)
+{
+    m_address_index.Get(addresses, results);
+    return true;
+}
+
+bool CTxMemPool::removeAddressIndex(const uint256 txhash)
+{
+    m_address_index.Remove(txhash);
     return true;
 }
 
@@ -11,6 +11,8 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <tuple>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -30,8 +32,17 @@
 #include <boost/signals2/signal.hpp>
 
 class CBlockIndex;
+class QtumTransaction;
+struct EthTransactionParams;
 extern CCriticalSection cs_main;
 
+/** Contract transactions extracted from a transaction, shared with the entry once it is in the mempool */
+using ContractTxsRef = std::shared_ptr<const std::pair<std::vector<QtumTransaction>, std::vector<EthTransactionParams>>>;
+
+/** Contract data above which a mempool entry drops its extracted contract transactions,
+ *  they hold a second copy of the bytecode of the scripts */
+static const size_t MAX_MEMPOOL_CONTRACT_TXS_DATA = 1024;
+
 /** Fake height value used in Coin to signify they are only in the memory pool (since 0.8) */
 static const uint32_t MEMPOOL_HEIGHT = 0x0FFFFFFF;
 
@@ -163,6 +174,10 @@ private:
     int64_t feeDelta;          //!< Used for determining the priority of the transaction for mining in a block
     LockPoints lockPoints;     //!< Track the height and time at which tx was final
     CAmount nMinGasPrice;      //!< The minimum gas price among the contract outputs of the tx
+    const ContractTxsRef contractTxs;  //!< Contract transactions extracted when entering the mempool
+    const unsigned int nContractFlags; //!< Script flags the contract transactions were extracted with
+    const uint64_t nGasLimit;          //!< Gas declared by the contract transactions
+    int64_t nExecTime;                 //!< Microseconds the contracts took to execute, predicted when entering the mempool and measured by the block assembler
 
     // Information about descendants of this transaction that are in the
     // mempool; if we remove this transaction we must remove all of these
@@ -181,7 +196,8 @@ public:
     CTxMemPoolEntry(const CTransactionRef& _tx, const CAmount& _nFee,
                     int64_t _nTime, unsigned int _entryHeight,
                     bool spendsCoinbase,
-                    int64_t nSigOpsCost, LockPoints lp, CAmount _nMinGasPrice = 0);
+                    int64_t nSigOpsCost, LockPoints lp, CAmount _nMinGasPrice = 0,
+                    ContractTxsRef _contractTxs = nullptr, unsigned int _nContractFlags = 0);
 
     const CTransaction& GetTx() const { return *this->tx; }
     CTransactionRef GetSharedTx() const { return this->tx; }
@@ -195,6 +211,14 @@ public:
     size_t DynamicMemoryUsage() const { return nUsageSize; }
     const LockPoints& GetLockPoints() const { return lockPoints; }
     const CAmount& GetMinGasPrice() const { return nMinGasPrice; }
+    /** The contract transactions extracted when entering the mempool, null when they were not
+     *  extracted, not kept for their size or when the script flags differ from the ones given */
+    ContractTxsRef GetContractTxs(unsigned int flags) const { return flags == nContractFlags ? contractTxs : nullptr; }
+    uint64_t GetGasLimit() const { return nGasLimit; }
+    int64_t GetExecTime() const { return nExecTime; }
+    /** The gas price the entry is evicted by. It is lowered in proportion when the contracts were
+     *  observed to burn less than EXPECTED_GAS_PER_EXEC_MICRO of their gas limit per microsecond. */
+    double GetEvictionGasPrice() const;
 
     // Adjusts the descendant state.
     void UpdateDescendantState(int64_t modifySize, CAmount modifyFee, int64_t modifyCount);
@@ -205,6 +229,8 @@ public:
     void UpdateFeeDelta(int64_t feeDelta);
     // Update the LockPoints after a reorg
     void UpdateLockPoints(const LockPoints& lp);
+    // Update the execution time of the contracts
+    void UpdateExecTime(int64_t nMicros) { nExecTime = nMicros; }
 
     uint64_t GetCountWithDescendants() const { return nCountWithDescendants; }
     uint64_t GetSizeWithDescendants() const { return nSizeWithDescendants; }
@@ -218,6 +244,7 @@ public:
     int64_t GetSigOpCostWithAncestors() const { return nSigOpCostWithAncestors; }
 
     mutable size_t vTxHashesIdx; //!< Index in mempool's vTxHashes
+    mutable uint64_t m_epoch;    //!< Last mempool epoch that visited the entry, see CTxMemPool::EpochGuard
 };
 
 // Helpers for modifying CTxMemPool::mapTx, which is a boost multi_index.
@@ -262,6 +289,16 @@ private:
     int64_t feeDelta;
 };
 
+struct update_exec_time
+{
+    explicit update_exec_time(int64_t _nMicros) : nMicros(_nMicros) { }
+
+    void operator() (CTxMemPoolEntry &e) { e.UpdateExecTime(nMicros); }
+
+private:
+    int64_t nMicros;
+};
+
 struct update_lock_points
 {
     explicit update_lock_points(const LockPoints& _lp) : lp(_lp) { }
@@ -454,11 +491,44 @@ public:
     }
 };
 
+/** \class CompareTxMemPoolEntryByGasScore
+ *
+ *  Sort the contract txs by the minimum gas price among their outputs, lowered for
+ *  the contracts observed to execute slowly, then by fee rate, in ascending order,
+ *  so the EVM work that pays the least comes first when the gas declared by the
+ *  mempool is over its limit. Txs that do not run contracts sort after all the
+ *  contract txs.
+ */
+class CompareTxMemPoolEntryByGasScore
+{
+public:
+    bool operator()(const CTxMemPoolEntry& a, const CTxMemPoolEntry& b) const
+    {
+        bool fAHasGas = a.GetGasLimit() > 0;
+        bool fBHasGas = b.GetGasLimit() > 0;
+        if (fAHasGas != fBHasGas) {
+            return fAHasGas;
+        }
+        double fAGasPrice = a.GetEvictionGasPrice();
+        double fBGasPrice = b.GetEvictionGasPrice();
+        if (fAGasPrice != fBGasPrice) {
+            return fAGasPrice < fBGasPrice;
+        }
+        double f1 = (double)a.GetModifiedFee() * b.GetTxSize();
+        double f2 = (double)b.GetModifiedFee() * a.GetTxSize();
+        if (f1 == f2) {
+            return a.GetTx().GetHash() < b.GetTx().GetHash();
+        }
+        return f1 < f2;
+    }
+};
+
 // Multi_index tag names
 struct descendant_score {};
 struct entry_time {};
 struct ancestor_score {};
 struct ancestor_score_or_gas_price {};
+struct gas_score {};
 
 class CBlockPolicyEstimator;
 
@@ -506,6 +576,62 @@ public:
     }
 };
 
+#ifdef ENABLE_BITCORE_RPC
+/**
+ * The mempool side of -addrindex. The inputs and outputs of the transactions
+ * are bucketed per address, and the buckets are spread over shards that each
+ * have their own lock. getaddressmempool reads them without mempool.cs, so
+ * address queries do not wait for AcceptToMemoryPool, and transactions paying
+ * different addresses update different shards. A query may see part of the
+ * entries of a transaction that is being added or removed.
+ */
+class CMempoolAddressIndex
+{
+public:
+    void Add(const CTransaction& tx, int64_t time, const CCoinsViewCache& view);
+    void Remove(const uint256& txhash);
+    //! Entries of the addresses, ordered by transaction within each address
+    void Get(const std::vector<std::pair<uint256, int> >& addresses,
+             std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> >& results) const;
+    void Clear();
+    size_t DynamicMemoryUsage() const;
+
+private:
+    static constexpr size_t SHARDS = 16;
+
+    struct AddressKey {
+        int type;
+        uint256 bytes;
+        bool operator==(const AddressKey& other) const { return type == other.type && bytes == other.bytes; }
+    };
+    struct AddressKeyHasher {
+        size_t operator()(const AddressKey& key) const { return key.bytes.GetUint64(0) ^ key.type; }
+    };
+    //! An input or output within the bucket of its address
+    struct TxKey {
+        uint256 txhash;
+        unsigned int index;
+        int spending;
+        bool operator<(const TxKey& other) const {
+            return std::tie(txhash, index, spending) < std::tie(other.txhash, other.index, other.spending);
+        }
+    };
+    typedef std::map<TxKey, CMempoolAddressDelta> Bucket;
+    struct Shard {
+        mutable Mutex mutex;
+        std::unordered_map<AddressKey, Bucket, AddressKeyHasher> buckets GUARDED_BY(mutex);
+    };
+
+    Shard m_shards[SHARDS];
+    mutable Mutex m_inserted_mutex;
+    //! What each transaction added, to remove it again
+    std::unordered_map<uint256, std::vector<std::pair<AddressKey, TxKey> >, SaltedTxidHasher> m_inserted GUARDED_BY(m_inserted_mutex);
+
+    Shard& ShardOf(const AddressKey& key) { return m_shards[AddressKeyHasher()(key) % SHARDS]; }
+    const Shard& ShardOf(const AddressKey& key) const { return m_shards[AddressKeyHasher()(key) % SHARDS]; }
+};
+#endif
+
 /**
  * CTxMemPool stores valid-according-to-the-current-best-chain transactions
  * that may be included in the next block.
@@ -587,6 +713,7 @@ private:
 
     uint64_t totalTxSize;      //!< sum of all mempool tx's virtual sizes. Differs from serialized tx size since witness data is discounted. Defined in BIP 141.
     uint64_t cachedInnerUsage; //!< sum of dynamic memory usage of all the map elements (NOT the maps themselves)
+    uint64_t totalGasLimit;    //!< sum of the gas declared by the contract txs of the mempool
 
     mutable int64_t lastRollingFeeUpdate;
     mutable bool blockSinceLastRollingFeeBump;
@@ -596,6 +723,9 @@ private:
 
     bool m_is_loaded GUARDED_BY(cs){false};
 
+    mutable uint64_t m_epoch GUARDED_BY(cs){0};
+    mutable bool m_has_epoch_guard GUARDED_BY(cs){false};
+
 public:
 
     static const int ROLLING_FEE_HALFLIFE = 60 * 60 * 12; // public only for testing
@@ -628,6 +758,12 @@ public:
                 boost::multi_index::tag<ancestor_score_or_gas_price>,
                 boost::multi_index::identity<CTxMemPoolEntry>,
                 CompareTxMemPoolEntryByAncestorFeeOrGasPrice
+            >,
+            // sorted by gas price and fee rate of the contract txs, for eviction
+            boost::multi_index::ordered_non_unique<
+                boost::multi_index::tag<gas_score>,
+                boost::multi_index::identity<CTxMemPoolEntry>,
+                CompareTxMemPoolEntryByGasScore
             >
         >
     > indexed_transaction_set;
@@ -688,11 +824,8 @@ private:
 
 #ifdef ENABLE_BITCORE_RPC
     //////////////////////////////////////////////////////////////// // qtum
-    typedef std::map<CMempoolAddressDeltaKey, CMempoolAddressDelta, CMempoolAddressDeltaKeyCompare> addressDeltaMap;
-    addressDeltaMap mapAddress;
-
-    typedef std::map<uint256, std::vector<CMempoolAddressDeltaKey> > addressDeltaMapInserted;
-    addressDeltaMapInserted mapAddressInserted;
+    //! Not guarded by cs, it has its own locks
+    CMempoolAddressIndex m_address_index;
 
     typedef std::map<CSpentIndexKey, CSpentIndexValue, CSpentIndexKeyCompare> mapSpentIndex;
     mapSpentIndex mapSpent;
@@ -737,7 +870,7 @@ public:
 #ifdef ENABLE_BITCORE_RPC
     ///////////////////////////////////////////////////////// // qtum
     void addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view);
-    bool getAddressIndex(std::vector<std::pair<uint256, int> > &addresses,
+    bool getAddressIndex(const std::vector<std::pair<uint256, int> > &addresses,
                          std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > &results);
     bool removeAddressIndex(const uint256 txhash);
 
@@ -830,6 +963,12 @@ public:
       */
     void TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpendsRemaining = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
+    /** Remove the contract txs paying the lowest gas price, with their descendants, until the gas
+      * declared by the mempool is at most gaslimit. Unlike TrimToSize this leaves the rolling
+      * minimum fee alone, which would also hold back the txs that run no contract.
+      */
+    void TrimToGasLimit(uint64_t gaslimit, std::vector<COutPoint>* pvNoSpendsRemaining = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
     /** Expire all transaction (and their dependencies) in the mempool older than time. Return the number of removed transactions. */
     int Expire(int64_t time) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
@@ -857,6 +996,12 @@ public:
         return totalTxSize;
     }
 
+    uint64_t GetTotalGasLimit() const
+    {
+        LOCK(cs);
+        return totalGasLimit;
+    }
+
     bool exists(const uint256& hash) const
     {
         LOCK(cs);
@@ -880,6 +1025,26 @@ public:
     boost::signals2::signal<void (CTransactionRef, MemPoolRemovalReason)> NotifyEntryRemoved;
 
 private:
+    /** Marks the entries visited by one walk of the transaction graph in the entries
+     *  themselves, instead of collecting them in a temporary setEntries. Only one walk
+     *  can be in progress at a time.
+     */
+    class EpochGuard {
+        const CTxMemPool& pool;
+    public:
+        explicit EpochGuard(const CTxMemPool& in);
+        ~EpochGuard();
+    };
+
+    /** Mark an entry visited in the current epoch, returning whether it was already */
+    bool visited(txiter it) const EXCLUSIVE_LOCKS_REQUIRED(cs)
+    {
+        assert(m_has_epoch_guard);
+        bool ret = it->m_epoch >= m_epoch;
+        it->m_epoch = std::max(it->m_epoch, m_epoch);
+        return ret;
+    }
+
     /** UpdateForDescendants is used by UpdateTransactionsFromBlock to update
      *  the descendants for a single transaction that has been added to the
      *  mempool but may have child transactions in the mempool, eg during a
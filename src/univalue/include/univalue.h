@@ -9,9 +9,13 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <utility>
 #include <cassert>
 
 #include <sstream>        // .get_int64()
@@ -47,7 +51,10 @@ public:
         std::string s(val_);
         setStr(s);
     }
-    ~UniValue() {}
+    UniValue(const UniValue& other);
+    UniValue(UniValue&& other) = default;
+    UniValue& operator=(const UniValue& other);
+    UniValue& operator=(UniValue&& other) = default;
 
     void clear();
 
@@ -85,9 +92,10 @@ public:
     bool isObject() const { return (typ == VOBJ); }
 
     bool push_back(const UniValue& val);
+    bool push_back(UniValue&& val);
     bool push_back(const std::string& val_) {
         UniValue tmpVal(VSTR, val_);
-        return push_back(tmpVal);
+        return push_back(std::move(tmpVal));
     }
     bool push_back(const char *val_) {
         std::string s(val_);
@@ -95,27 +103,29 @@ public:
     }
     bool push_back(uint64_t val_) {
         UniValue tmpVal(val_);
-        return push_back(tmpVal);
+        return push_back(std::move(tmpVal));
     }
     bool push_back(int64_t val_) {
         UniValue tmpVal(val_);
-        return push_back(tmpVal);
+        return push_back(std::move(tmpVal));
     }
     bool push_back(int val_) {
         UniValue tmpVal(val_);
-        return push_back(tmpVal);
+        return push_back(std::move(tmpVal));
     }
     bool push_back(double val_) {
         UniValue tmpVal(val_);
-        return push_back(tmpVal);
+        return push_back(std::move(tmpVal));
     }
     bool push_backV(const std::vector<UniValue>& vec);
 
     void __pushKV(const std::string& key, const UniValue& val);
+    void __pushKV(std::string&& key, UniValue&& val);
     bool pushKV(const std::string& key, const UniValue& val);
+    bool pushKV(const std::string& key, UniValue&& val);
     bool pushKV(const std::string& key, const std::string& val_) {
         UniValue tmpVal(VSTR, val_);
-        return pushKV(key, tmpVal);
+        return pushKV(key, std::move(tmpVal));
     }
     bool pushKV(const std::string& key, const char *val_) {
         std::string _val(val_);
@@ -123,23 +133,23 @@ public:
     }
     bool pushKV(const std::string& key, int64_t val_) {
         UniValue tmpVal(val_);
-        return pushKV(key, tmpVal);
+        return pushKV(key, std::move(tmpVal));
     }
     bool pushKV(const std::string& key, uint64_t val_) {
         UniValue tmpVal(val_);
-        return pushKV(key, tmpVal);
+        return pushKV(key, std::move(tmpVal));
     }
     bool pushKV(const std::string& key, bool val_) {
         UniValue tmpVal((bool)val_);
-        return pushKV(key, tmpVal);
+        return pushKV(key, std::move(tmpVal));
     }
     bool pushKV(const std::string& key, int val_) {
         UniValue tmpVal((int64_t)val_);
-        return pushKV(key, tmpVal);
+        return pushKV(key, std::move(tmpVal));
     }
     bool pushKV(const std::string& key, double val_) {
         UniValue tmpVal(val_);
-        return pushKV(key, tmpVal);
+        return pushKV(key, std::move(tmpVal));
     }
     bool pushKVs(const UniValue& obj);
 
@@ -157,7 +167,10 @@ private:
     std::string val;                       // numbers are stored as C++ strings
     std::vector<std::string> keys;
     std::vector<UniValue> values;
+    // position of each key, only kept for objects with many keys
+    std::unique_ptr<std::unordered_map<std::string, size_t> > keyIndex;
 
+    void pushKey(std::string&& key);
     bool findKey(const std::string& key, size_t& retIdx) const;
     void writeArray(unsigned int prettyIndent, unsigned int indentLevel, std::string& s) const;
     void writeObject(unsigned int prettyIndent, unsigned int indentLevel, std::string& s) const;
@@ -179,6 +192,48 @@ public:
     friend const UniValue& find_value( const UniValue& obj, const std::string& name);
 };
 
+/**
+ * Writes a JSON document piece by piece instead of from a complete UniValue
+ * tree. The text is handed to the flush function whenever more than
+ * flushSize bytes are buffered, so only the value being written has to be
+ * held in memory. Once flush returns false nothing more is written and
+ * good() turns false, producers may stop early then.
+ */
+class UniValueStreamWriter {
+public:
+    typedef std::function<bool(const std::string&)> FlushFn;
+
+    explicit UniValueStreamWriter(const FlushFn& flushFn, size_t flushSize = 65536)
+        : out(flushFn), threshold(flushSize), ok(true), afterKey(false) {}
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+    // inside an object, the next value written belongs to key
+    void key(const std::string& key);
+    void value(const UniValue& val);
+    void pushKV(const std::string& key_, const UniValue& val) {
+        key(key_);
+        value(val);
+    }
+
+    // hand the buffered text to the flush function
+    bool flush();
+    bool good() const { return ok; }
+
+private:
+    FlushFn out;
+    size_t threshold;
+    std::string buf;
+    std::vector<bool> first;            // per open container: no element yet
+    bool ok;
+    bool afterKey;
+
+    void separator();
+    void written();
+};
+
 enum jtokentype {
     JTOK_ERR        = -1,
     JTOK_NONE       = 0,                           // eof
@@ -40,6 +40,37 @@ static const char *hatoui(const char *first, const char *last,
     return first;
 }
 
+// true if any byte of the word is below 0x20, at least 0x80, '"' or '\\'
+static inline bool json_word_special(uint64_t w)
+{
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    uint64_t quote = w ^ (ones * '"');
+    uint64_t bslash = w ^ (ones * '\\');
+    return (((w - ones * 0x20) | (quote - ones) | (bslash - ones) | w) & highs) != 0;
+}
+
+static inline bool json_plain_char(unsigned char ch)
+{
+    return ch >= 0x20 && ch < 0x80 && ch != '"' && ch != '\\';
+}
+
+// end of the run of printable ASCII characters other than '"' and '\\' from raw,
+// tested eight bytes at a time
+static const char *json_plain_run(const char *raw, const char *end)
+{
+    while (end - raw >= 8) {
+        uint64_t w;
+        memcpy(&w, raw, sizeof(w));
+        if (json_word_special(w))
+            break;
+        raw += 8;
+    }
+    while (raw < end && json_plain_char(*raw))
+        raw++;
+    return raw;
+}
+
 enum jtokentype getJsonToken(std::string& tokenVal, unsigned int& consumed,
                             const char *raw, const char *end)
 {
@@ -176,6 +207,13 @@ enum jtokentype getJsonToken(std::string& tokenVal, unsigned int& consumed,
         JSONUTF8StringFilter writer(valStr);
 
         while (true) {
+            // most of a string is printable ASCII, hand it over in one piece
+            const char *run = json_plain_run(raw, end);
+            if (run != raw) {
+                writer.append(raw, run - raw);
+                raw = run;
+            }
+
             if (raw >= end || (unsigned char)*raw < 0x20)
                 return JTOK_ERR;
 
@@ -226,7 +264,7 @@ enum jtokentype getJsonToken(std::string& tokenVal, unsigned int& consumed,
 
         if (!writer.finalize())
             return JTOK_ERR;
-        tokenVal = valStr;
+        tokenVal.swap(valStr);
         consumed = (raw - rawStart);
         return JTOK_STRING;
         }
@@ -315,9 +353,8 @@ bool UniValue::read(const char *raw, size_t size)
                     setArray();
                 stack.push_back(this);
             } else {
-                UniValue tmpVal(utyp);
                 UniValue *top = stack.back();
-                top->values.push_back(tmpVal);
+                top->values.emplace_back(utyp);
 
                 UniValue *newTop = &(top->values.back());
                 stack.push_back(newTop);
@@ -389,26 +426,27 @@ bool UniValue::read(const char *raw, size_t size)
             }
 
             if (!stack.size()) {
-                *this = tmpVal;
+                *this = std::move(tmpVal);
                 break;
             }
 
             UniValue *top = stack.back();
-            top->values.push_back(tmpVal);
+            top->values.push_back(std::move(tmpVal));
 
             setExpect(NOT_VALUE);
             break;
             }
 
         case JTOK_NUMBER: {
-            UniValue tmpVal(VNUM, tokenVal);
+            UniValue tmpVal(VNUM);
+            tmpVal.val.swap(tokenVal);
             if (!stack.size()) {
-                *this = tmpVal;
+                *this = std::move(tmpVal);
                 break;
             }
 
             UniValue *top = stack.back();
-            top->values.push_back(tmpVal);
+            top->values.push_back(std::move(tmpVal));
 
             setExpect(NOT_VALUE);
             break;
@@ -417,17 +455,18 @@ bool UniValue::read(const char *raw, size_t size)
         case JTOK_STRING: {
             if (expect(OBJ_NAME)) {
                 UniValue *top = stack.back();
-                top->keys.push_back(tokenVal);
+                top->pushKey(std::move(tokenVal));
                 clearExpect(OBJ_NAME);
                 setExpect(COLON);
             } else {
-                UniValue tmpVal(VSTR, tokenVal);
+                UniValue tmpVal(VSTR);
+                tmpVal.val.swap(tokenVal);
                 if (!stack.size()) {
-                    *this = tmpVal;
+                    *this = std::move(tmpVal);
                     break;
                 }
                 UniValue *top = stack.back();
-                top->values.push_back(tmpVal);
+                top->values.push_back(std::move(tmpVal));
             }
 
             setExpect(NOT_VALUE);
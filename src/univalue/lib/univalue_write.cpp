@@ -111,3 +111,75 @@ void UniValue::writeObject(unsigned int prettyIndent, unsigned int indentLevel,
     s += "}";
 }
 
+
+void UniValueStreamWriter::separator()
+{
+    if (afterKey) {
+        afterKey = false;
+    } else if (!first.empty()) {
+        if (!first.back())
+            buf += ",";
+        first.back() = false;
+    }
+}
+
+void UniValueStreamWriter::written()
+{
+    if (!ok)
+        buf.clear();
+    else if (buf.size() >= threshold)
+        flush();
+}
+
+void UniValueStreamWriter::beginObject()
+{
+    separator();
+    buf += "{";
+    first.push_back(true);
+}
+
+void UniValueStreamWriter::endObject()
+{
+    assert(!first.empty() && !afterKey);
+    buf += "}";
+    first.pop_back();
+    written();
+}
+
+void UniValueStreamWriter::beginArray()
+{
+    separator();
+    buf += "[";
+    first.push_back(true);
+}
+
+void UniValueStreamWriter::endArray()
+{
+    assert(!first.empty() && !afterKey);
+    buf += "]";
+    first.pop_back();
+    written();
+}
+
+void UniValueStreamWriter::key(const std::string& key)
+{
+    assert(!afterKey);
+    separator();
+    buf += "\"" + json_escape(key) + "\":";
+    afterKey = true;
+}
+
+void UniValueStreamWriter::value(const UniValue& val)
+{
+    separator();
+    buf += val.write();
+    written();
+}
+
+bool UniValueStreamWriter::flush()
+{
+    if (ok && !buf.empty())
+        ok = out(buf);
+    buf.clear();
+    return ok;
+}
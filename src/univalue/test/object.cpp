@@ -393,6 +393,105 @@ BOOST_AUTO_TEST_CASE(univalue_readwrite)
     BOOST_CHECK(!v.read("{} 42"));
 }
 
+BOOST_AUTO_TEST_CASE(univalue_streamwriter)
+{
+    std::string out;
+    size_t flushes = 0;
+    UniValueStreamWriter writer([&](const std::string& chunk) {
+        out += chunk;
+        flushes++;
+        return true;
+    }, 8);
+
+    writer.beginObject();
+    writer.pushKV("a", UniValue(1));
+    writer.key("b\"");
+    writer.beginArray();
+    for (int i = 0; i < 3; i++) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("i", i);
+        writer.value(obj);
+    }
+    writer.beginArray();
+    writer.endArray();
+    writer.endArray();
+    writer.pushKV("c", NullUniValue);
+    writer.endObject();
+    BOOST_CHECK(writer.flush());
+    BOOST_CHECK(writer.good());
+    BOOST_CHECK(flushes > 1);
+    BOOST_CHECK_EQUAL(out, "{\"a\":1,\"b\\\"\":[{\"i\":0},{\"i\":1},{\"i\":2},[]],\"c\":null}");
+
+    UniValue v;
+    BOOST_CHECK(v.read(out));
+    BOOST_CHECK_EQUAL(v["b\""].size(), 4);
+
+    // a failed flush stops the writer
+    size_t calls = 0;
+    UniValueStreamWriter failing([&](const std::string&) {
+        calls++;
+        return false;
+    }, 1);
+    failing.beginArray();
+    failing.value(UniValue(1));
+    failing.value(UniValue(2));
+    failing.endArray();
+    BOOST_CHECK(!failing.flush());
+    BOOST_CHECK(!failing.good());
+    BOOST_CHECK_EQUAL(calls, 1);
+}
+
+BOOST_AUTO_TEST_CASE(univalue_largeobject)
+{
+    // enough keys for the hash index
+    UniValue obj(UniValue::VOBJ);
+    for (int i = 0; i < 100; i++) {
+        std::ostringstream key;
+        key << "key" << i;
+        BOOST_CHECK(obj.pushKV(key.str(), UniValue(i)));
+    }
+    BOOST_CHECK_EQUAL(obj.size(), 100);
+    BOOST_CHECK_EQUAL(obj["key0"].get_int(), 0);
+    BOOST_CHECK_EQUAL(obj["key99"].get_int(), 99);
+    BOOST_CHECK_EQUAL(find_value(obj, "key42").get_int(), 42);
+    BOOST_CHECK(!obj.exists("key100"));
+
+    // pushKV replaces the value of a known key
+    BOOST_CHECK(obj.pushKV("key7", UniValue("seven")));
+    BOOST_CHECK_EQUAL(obj.size(), 100);
+    BOOST_CHECK_EQUAL(obj["key7"].get_str(), "seven");
+
+    // copies have their own index
+    UniValue copy(obj);
+    copy.pushKV("extra", true);
+    BOOST_CHECK(copy.exists("extra"));
+    BOOST_CHECK(!obj.exists("extra"));
+    UniValue assigned;
+    assigned = copy;
+    BOOST_CHECK_EQUAL(assigned["key99"].get_int(), 99);
+    BOOST_CHECK(assigned["extra"].isTrue());
+
+    // a moved value keeps its index
+    UniValue moved(std::move(assigned));
+    BOOST_CHECK_EQUAL(moved["key41"].get_int(), 41);
+
+    UniValue arr(UniValue::VARR);
+    BOOST_CHECK(arr.push_back(std::move(moved)));
+    BOOST_CHECK_EQUAL(arr[0]["key98"].get_int(), 98);
+
+    // the first of duplicate keys is found, as without the index
+    UniValue v;
+    std::string json = obj.write();
+    json.insert(json.size() - 1, ",\"key3\":\"dup\"");
+    BOOST_CHECK(v.read(json));
+    BOOST_CHECK_EQUAL(v.size(), 101);
+    BOOST_CHECK_EQUAL(v["key3"].get_int(), 3);
+    BOOST_CHECK_EQUAL(v["key99"].get_int(), 99);
+
+    v.setObject();
+    BOOST_CHECK(!v.exists("key3"));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 int main (int argc, char *argv[])
@@ -403,6 +502,8 @@ int main (int argc, char *argv[])
     univalue_array();
     univalue_object();
     univalue_readwrite();
+    univalue_streamwriter();
+    univalue_largeobject();
     return 0;
 }
 
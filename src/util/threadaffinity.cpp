@@ -0,0 +1,222 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
+#include <util/threadaffinity.h>
+
+#include <fs.h>
+#include <logging.h>
+#include <sync.h>
+#include <tinyformat.h>
+#include <util/strencodings.h>
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+Mutex g_placement_mutex;
+ThreadPlacement g_placement GUARDED_BY(g_placement_mutex);
+bool g_pinned GUARDED_BY(g_placement_mutex){false};
+
+/** Threads that validate blocks, execute contracts or fill the coins cache */
+const char* const VALIDATION_THREADS[] = {"msghand", "scriptch.", "loadblk", "contractprefetch", "inputprefetch", "sigprecheck", "blockread", "undoread", "coinsflush", "verifydb"};
+/** Threads that serve the peers and the RPC clients */
+const char* const NET_THREADS[] = {"net", "dnsseed", "addcon", "opencon", "upnp", "torcontrol", "http", "httpworker.", "zmqpub"};
+
+/** A name ending in a dot matches the numbered threads of a pool */
+bool MatchesThread(const std::string& thread_name, const char* const name)
+{
+    const std::string pattern(name);
+    if (!pattern.empty() && pattern.back() == '.') return thread_name.compare(0, pattern.size(), pattern) == 0;
+    return thread_name == pattern;
+}
+
+template <size_t N>
+bool MatchesAny(const std::string& thread_name, const char* const (&names)[N])
+{
+    return std::any_of(names, names + N, [&](const char* name) { return MatchesThread(thread_name, name); });
+}
+
+#ifdef __linux__
+/** The CPUs of the NUMA nodes the process may run on, by node */
+std::map<int, std::vector<int>> GetNodeCPUs(const std::vector<int>& allowed)
+{
+    std::map<int, std::vector<int>> nodes;
+    try {
+        const fs::path base("/sys/devices/system/node");
+        if (!fs::is_directory(base)) return nodes;
+        for (fs::directory_iterator it(base); it != fs::directory_iterator(); ++it) {
+            const std::string name = it->path().filename().string();
+            int32_t node;
+            if (name.compare(0, 4, "node") != 0 || !ParseInt32(name.substr(4), &node)) continue;
+            fsbridge::ifstream file(it->path() / "cpulist");
+            std::string list;
+            std::vector<int> cpus;
+            if (!std::getline(file, list) || !util::ParseCPUList(list, cpus)) continue;
+            std::vector<int> usable;
+            std::set_intersection(cpus.begin(), cpus.end(), allowed.begin(), allowed.end(), std::back_inserter(usable));
+            if (!usable.empty()) nodes[node] = usable;
+        }
+    } catch (const fs::filesystem_error& e) {
+        LogPrintf("%s: %s\n", __func__, e.what());
+    }
+    return nodes;
+}
+
+void PinThread(const std::string& thread_name, const std::vector<int>& cpus, int node)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    }
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        LogPrintf("Cannot pin thread %s to cpus %s\n", thread_name, util::FormatCPUList(cpus));
+        return;
+    }
+#ifdef SYS_set_mempolicy
+    if (node >= 0 && node < 63) {
+        // MPOL_PREFERRED, from numaif.h which needs libnuma
+        const int mpol_preferred = 1;
+        unsigned long mask = 1UL << node;
+        syscall(SYS_set_mempolicy, mpol_preferred, &mask, sizeof(mask) * 8);
+    }
+#endif
+}
+#endif
+
+} // namespace
+
+namespace util {
+
+bool ParseCPUList(const std::string& list, std::vector<int>& cpus)
+{
+    cpus.clear();
+    std::istringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        range.erase(std::remove_if(range.begin(), range.end(), IsSpace), range.end());
+        if (range.empty()) continue;
+        const size_t dash = range.find('-');
+        int32_t first, last;
+        if (!ParseInt32(range.substr(0, dash), &first)) return false;
+        last = first;
+        if (dash != std::string::npos && !ParseInt32(range.substr(dash + 1), &last)) return false;
+        if (first < 0 || last < first) return false;
+        for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return true;
+}
+
+std::string FormatCPUList(const std::vector<int>& cpus)
+{
+    std::string list;
+    for (size_t i = 0; i < cpus.size();) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) j++;
+        if (!list.empty()) list += ",";
+        list += j == i ? strprintf("%d", cpus[i]) : strprintf("%d-%d", cpus[i], cpus[j]);
+        i = j + 1;
+    }
+    return list;
+}
+
+bool SetupThreadAffinity(const std::string& policy, std::string& error)
+{
+    ThreadPlacement placement;
+    placement.policy = policy;
+    if (policy == "none") {
+        LOCK(g_placement_mutex);
+        g_placement = placement;
+        g_pinned = false;
+        return true;
+    }
+    if (policy != "numa") {
+        error = strprintf("Unknown -threadaffinity policy %s, use none or numa", policy);
+        return false;
+    }
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+        error = "Cannot read the CPUs the process may run on for -threadaffinity";
+        return false;
+    }
+    std::vector<int> allowed;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set)) allowed.push_back(cpu);
+    }
+
+    std::map<int, std::vector<int>> nodes = GetNodeCPUs(allowed);
+    if (nodes.empty()) nodes[-1] = allowed;
+
+    placement.validation_node = nodes.begin()->first;
+    placement.validation_cpus = nodes.begin()->second;
+    for (auto it = std::next(nodes.begin()); it != nodes.end(); ++it) {
+        placement.net_cpus.insert(placement.net_cpus.end(), it->second.begin(), it->second.end());
+    }
+    // The staker keeps a core to itself, the kernels it checks are timed
+    if (placement.validation_cpus.size() > 1) {
+        placement.staker_cpus.push_back(placement.validation_cpus.back());
+        placement.validation_cpus.pop_back();
+    } else {
+        placement.staker_cpus = placement.validation_cpus;
+    }
+    if (placement.net_cpus.empty()) {
+        placement.net_cpus = placement.validation_cpus;
+    }
+
+    LogPrintf("Thread affinity: validation on cpus %s of node %d, staker on cpus %s, network on cpus %s\n",
+        FormatCPUList(placement.validation_cpus), placement.validation_node, FormatCPUList(placement.staker_cpus), FormatCPUList(placement.net_cpus));
+    LOCK(g_placement_mutex);
+    g_placement = placement;
+    g_pinned = true;
+    return true;
+#else
+    error = "-threadaffinity is only supported on Linux";
+    return false;
+#endif
+}
+
+void ApplyThreadAffinity(const std::string& thread_name)
+{
+#ifdef __linux__
+    std::vector<int> cpus;
+    int node = -1;
+    {
+        LOCK(g_placement_mutex);
+        if (!g_pinned) return;
+        if (MatchesAny(thread_name, VALIDATION_THREADS)) {
+            cpus = g_placement.validation_cpus;
+            node = g_placement.validation_node;
+        } else if (thread_name.compare(0, 9, "qtumstake") == 0) {
+            cpus = g_placement.staker_cpus;
+        } else if (MatchesAny(thread_name, NET_THREADS)) {
+            cpus = g_placement.net_cpus;
+        }
+    }
+    if (!cpus.empty()) PinThread(thread_name, cpus, node);
+#endif
+}
+
+ThreadPlacement GetThreadPlacement()
+{
+    LOCK(g_placement_mutex);
+    return g_placement;
+}
+
+} // namespace util
@@ -0,0 +1,51 @@
+// Copyright (c) 2021 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTIL_THREADAFFINITY_H
+#define BITCOIN_UTIL_THREADAFFINITY_H
+
+#include <string>
+#include <vector>
+
+/** Default for -threadaffinity */
+static const char* const DEFAULT_THREAD_AFFINITY = "none";
+
+/** CPUs the threads of each group were placed on, empty lists when the threads are not pinned */
+struct ThreadPlacement
+{
+    std::string policy;
+    //! NUMA node of the validation CPUs and of the memory they allocate, -1 when not known
+    int validation_node{-1};
+    std::vector<int> validation_cpus;
+    std::vector<int> staker_cpus;
+    std::vector<int> net_cpus;
+};
+
+namespace util {
+
+/**
+ * Choose the CPUs of the threads for -threadaffinity. With "numa" the
+ * threads validating blocks and executing contracts run on the CPUs of the
+ * first NUMA node the process may use, less one CPU kept for the staker,
+ * and prefer the memory of that node, so the coins cache they fill stays
+ * local. The network and RPC threads run on the other nodes, or share the
+ * validation CPUs on a machine with a single node. "none" leaves the
+ * placement to the operating system. Call before the threads start.
+ */
+bool SetupThreadAffinity(const std::string& policy, std::string& error);
+
+/** Pin the calling thread according to its name, called when a thread is named */
+void ApplyThreadAffinity(const std::string& thread_name);
+
+ThreadPlacement GetThreadPlacement();
+
+/** Parse a list of CPUs like "0-3,8", as the kernel formats them */
+bool ParseCPUList(const std::string& list, std::vector<int>& cpus);
+
+/** Format sorted CPUs as a list like "0-3,8" */
+std::string FormatCPUList(const std::vector<int>& cpus);
+
+} // namespace util
+
+#endif // BITCOIN_UTIL_THREADAFFINITY_H
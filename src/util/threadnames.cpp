@@ -14,6 +14,7 @@
 #include <pthread_np.h>
 #endif
 
+#include <util/threadaffinity.h>
 #include <util/threadnames.h>
 
 #ifdef HAVE_SYS_PRCTL_H
@@ -58,6 +59,7 @@ static void SetInternalName(std::string name) { }
 void util::ThreadRename(std::string&& name)
 {
     SetThreadName(("b-" + name).c_str());
+    ApplyThreadAffinity(name);
     SetInternalName(std::move(name));
 }
 
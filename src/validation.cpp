@@ -6,6 +6,7 @@
 #include <validation.h>
 
 #include <arith_uint256.h>
+#include <blockcache.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
@@ -16,13 +17,19 @@
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
 #include <cuckoocache.h>
+#include <dbscheduler.h>
 #include <flatfile.h>
 #include <hash.h>
+#include <index/addressindex.h>
 #include <index/txindex.h>
+#include <mempooljournal.h>
+#include <miner.h>
+#include <policy/exectime.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <policy/settings.h>
 #include <pow.h>
+#include <qtum/vmlogwriter.h>
 #include <pos.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
@@ -57,9 +64,13 @@
 #include <util/convert.h>
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <list>
 #include <future>
 #include <sstream>
 #include <string>
+#include <thread>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/thread.hpp>
@@ -80,7 +91,6 @@
 std::unique_ptr<QtumState> globalState;
 std::shared_ptr<dev::eth::SealEngineFace> globalSealEngine;
 bool fRecordLogOpcodes = false;
-bool fIsVMlogFile = false;
 bool fGettingValuesDGP = false;
  //////////////////////////////
 
@@ -134,7 +144,10 @@ CBlockIndex *pindexBestHeader = nullptr;
 Mutex g_best_block_mutex;
 std::condition_variable g_best_block_cv;
 uint256 g_best_block;
+std::atomic<uint64_t> g_reorg_generation{0};
 int nScriptCheckThreads = 0;
+int nContractPrefetchThreads = DEFAULT_CONTRACT_PREFETCH_THREADS;
+int nInputPrefetchThreads = DEFAULT_INPUT_PREFETCH_THREADS;
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
 #ifdef ENABLE_BITCORE_RPC
@@ -143,10 +156,12 @@ bool fAddressIndex = false; // qtum
 bool fLogEvents = false;
 bool fHavePruned = false;
 bool fPruneMode = false;
+unsigned int nLogEventsPrune = DEFAULT_LOGEVENTSPRUNE;
 bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
 size_t nCoinCacheUsage = 5000 * 300;
+size_t nStateCacheUsage = nMaxStateCache << 20;
 uint64_t nPruneTarget = 0;
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
 
@@ -188,6 +203,114 @@ CBlockIndex* LookupBlockIndex(const uint256& hash)
     return it == g_blockman.m_block_index.end() ? nullptr : it->second;
 }
 
+const CBlockIndex* LookupBlockIndexShared(const uint256& hash)
+{
+    return g_blockman.LookupShared(hash);
+}
+
+static std::shared_ptr<const ChainTipSnapshot> chainTipSnapshot;
+
+const CBlockIndex* ChainTipSnapshot::operator[](int nHeight) const
+{
+    if (!tip || nHeight < 0 || nHeight > height) {
+        return nullptr;
+    }
+    return tip->GetAncestor(nHeight);
+}
+
+bool ChainTipSnapshot::Contains(const CBlockIndex* pindex) const
+{
+    return pindex && (*this)[pindex->nHeight] == pindex;
+}
+
+std::shared_ptr<const ChainTipSnapshot> GetChainTipSnapshot()
+{
+    std::shared_ptr<const ChainTipSnapshot> snapshot = std::atomic_load(&chainTipSnapshot);
+    if (!snapshot) {
+        static const std::shared_ptr<const ChainTipSnapshot> empty = std::make_shared<ChainTipSnapshot>();
+        return empty;
+    }
+    return snapshot;
+}
+
+QtumStateViewPool::Handle TipStateView(std::shared_ptr<const ChainTipSnapshot>& snapshot)
+{
+    snapshot = GetChainTipSnapshot();
+    if (!snapshot->tip) {
+        return QtumStateViewPool::Handle(nullptr, QtumStateViewPool::Release{&stateViewPool});
+    }
+    return stateViewPool.acquire(uintToh256(snapshot->hashStateRoot), uintToh256(snapshot->hashUTXORoot));
+}
+
+/** Logical timestamps of the active chain by height, see FindActiveBlocksByTime */
+class BlockTimeIndex
+{
+public:
+    void SetTip(const CBlockIndex* tip)
+    {
+        LOCK(m_mutex);
+        if (!tip) {
+            m_tip = nullptr;
+            m_times.clear();
+            return;
+        }
+        // Keep the times of the blocks shared with the previous tip, normally all but the new tip
+        const CBlockIndex* fork = m_tip ? LastCommonAncestor(m_tip, tip) : nullptr;
+        size_t keep = std::min(m_times.size(), fork ? (size_t)fork->nHeight + 1 : 0);
+        m_times.resize(keep);
+        std::vector<unsigned int> times;
+        for (const CBlockIndex* pindex = tip; pindex && (size_t)pindex->nHeight >= keep; pindex = pindex->pprev)
+            times.push_back(pindex->nTime);
+        for (auto it = times.rbegin(); it != times.rend(); ++it) {
+            // The genesis block has no logical timestamp, it stays 0 below every other
+            m_times.push_back(m_times.empty() ? 0 : std::max(*it, m_times.back() + 1));
+        }
+        m_tip = tip;
+    }
+
+    void Find(unsigned int high, unsigned int low, std::vector<std::pair<uint256, unsigned int> >& hashes) const
+    {
+        LOCK(m_mutex);
+        if (m_times.size() < 2) return;
+        auto begin = std::lower_bound(m_times.begin() + 1, m_times.end(), low);
+        auto end = std::lower_bound(begin, m_times.end(), high);
+        if (begin == end) return;
+        const size_t first = hashes.size();
+        const CBlockIndex* pindex = m_tip->GetAncestor(end - m_times.begin() - 1);
+        for (auto it = end; it != begin; pindex = pindex->pprev) {
+            --it;
+            hashes.emplace_back(pindex->GetBlockHash(), *it);
+        }
+        std::reverse(hashes.begin() + first, hashes.end());
+    }
+
+private:
+    mutable Mutex m_mutex;
+    const CBlockIndex* m_tip GUARDED_BY(m_mutex){nullptr};
+    std::vector<unsigned int> m_times GUARDED_BY(m_mutex);
+};
+
+static BlockTimeIndex blockTimeIndex;
+
+void FindActiveBlocksByTime(unsigned int high, unsigned int low, std::vector<std::pair<uint256, unsigned int> >& hashes)
+{
+    blockTimeIndex.Find(high, low, hashes);
+}
+
+/** Replace the snapshot of the active tip, called with every change of the tip */
+static void PublishChainTipSnapshot(const CBlockIndex* tip)
+{
+    std::shared_ptr<ChainTipSnapshot> next = std::make_shared<ChainTipSnapshot>();
+    if (tip) {
+        next->tip = tip;
+        next->height = tip->nHeight;
+        next->hashStateRoot = tip->hashStateRoot;
+        next->hashUTXORoot = tip->hashUTXORoot;
+    }
+    std::atomic_store(&chainTipSnapshot, std::shared_ptr<const ChainTipSnapshot>(std::move(next)));
+    blockTimeIndex.SetTip(tip);
+}
+
 CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& locator)
 {
     AssertLockHeld(cs_main);
@@ -215,6 +338,7 @@ static void FindFilesToPruneManual(std::set<int>& setFilesToPrune, int nManualPr
 static void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight);
 bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks = nullptr);
 static FILE* OpenUndoFile(const FlatFilePos &pos, bool fReadOnly = false);
+static FILE* OpenFileRecord(FlatFileSeq seq, const FlatFilePos& pos, size_t trailer, bool header = false);
 static FlatFileSeq BlockFileSeq();
 static FlatFileSeq UndoFileSeq();
 
@@ -353,6 +477,7 @@ static void LimitMempoolSize(CTxMemPool& pool, size_t limit, unsigned long age)
 
     std::vector<COutPoint> vNoSpendsRemaining;
     pool.TrimToSize(limit, &vNoSpendsRemaining);
+    pool.TrimToGasLimit(gArgs.GetArg("-maxmempoolgas", DEFAULT_MAX_MEMPOOL_GAS), &vNoSpendsRemaining);
     for (const COutPoint& removed : vNoSpendsRemaining)
         ::ChainstateActive().CoinsTip().Uncache(removed);
 }
@@ -457,6 +582,29 @@ static bool CheckInputsFromMempoolAndCache(const CTransaction& tx, CValidationSt
     return CheckInputs(tx, state, view, flags, cacheSigStore, true, txdata);
 }
 
+/** DGP parameters contract txs entering the mempool are checked against, read once per tip state */
+struct MempoolDGPParams {
+    uint256 hashTip;
+    dev::h256 stateRoot;
+    uint64_t minGasPrice = 0;
+    uint64_t blockGasLimit = 0;
+};
+static MempoolDGPParams mempoolDGPParams GUARDED_BY(cs_main);
+
+static const MempoolDGPParams& GetMempoolDGPParams() EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    const CBlockIndex* tip = ::ChainActive().Tip();
+    const dev::h256 stateRoot = globalState->rootHash();
+    if (mempoolDGPParams.hashTip != tip->GetBlockHash() || mempoolDGPParams.stateRoot != stateRoot) {
+        QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
+        mempoolDGPParams.minGasPrice = qtumDGP.getMinGasPrice(tip->nHeight + 1);
+        mempoolDGPParams.blockGasLimit = qtumDGP.getBlockGasLimit(tip->nHeight + 1);
+        mempoolDGPParams.hashTip = tip->GetBlockHash();
+        mempoolDGPParams.stateRoot = stateRoot;
+    }
+    return mempoolDGPParams;
+}
+
 namespace {
 
 class MemPoolAccept
@@ -488,6 +636,11 @@ public:
         std::vector<COutPoint>& m_coins_to_uncache;
         const bool m_test_accept;
         bool m_raw_tx;
+        /*
+         * The transaction passed the script checks against the UTXO set of
+         * the current tip before, e.g. it was in the mempool at shutdown.
+         */
+        const bool m_trusted;
     };
 
     // Single transaction acceptance
@@ -507,6 +660,7 @@ private:
         CAmount m_modified_fees;
         CAmount m_conflicting_fees;
         size_t m_conflicting_size;
+        std::set<uint160> m_contract_senders;
 
         const CTransactionRef& m_ptx;
         const uint256& m_hash;
@@ -737,6 +891,8 @@ bool MemPoolAccept::PreChecks(ATMPArgs& args, Workspace& ws)
     int64_t nSigOpsCost = GetTransactionSigOpCost(tx, m_view, STANDARD_SCRIPT_VERIFY_FLAGS);
 
     dev::u256 txMinGasPrice = 0;
+    ContractTxsRef contractTxs;
+    unsigned int contractflags = 0;
 
     //////////////////////////////////////////////////////////// // qtum
     if(!CheckOpSender(tx, chainparams, GetSpendHeight(m_view))){
@@ -748,20 +904,18 @@ bool MemPoolAccept::PreChecks(ATMPArgs& args, Workspace& ws)
             return state.Invalid(ValidationInvalidReason::TX_INVALID_SENDER_SCRIPT, false, REJECT_INVALID, "bad-txns-invalid-sender-script");
         }
 
-        QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
-        uint64_t minGasPrice = qtumDGP.getMinGasPrice(::ChainActive().Tip()->nHeight + 1);
-        uint64_t blockGasLimit = qtumDGP.getBlockGasLimit(::ChainActive().Tip()->nHeight + 1);
+        const MempoolDGPParams& dgpParams = GetMempoolDGPParams();
+        const uint64_t minGasPrice = dgpParams.minGasPrice;
+        const uint64_t blockGasLimit = dgpParams.blockGasLimit;
         size_t count = 0;
         for(const CTxOut& o : tx.vout)
             count += o.scriptPubKey.HasOpCreate() || o.scriptPubKey.HasOpCall() ? 1 : 0;
-        unsigned int contractflags = GetContractScriptFlags(GetSpendHeight(m_view), chainparams.GetConsensus());
-        QtumTxConverter converter(tx, NULL, NULL, contractflags);
-        ExtractQtumTX resultConverter;
-        if(!converter.extractionQtumTransactions(resultConverter)){
+        contractflags = GetContractScriptFlags(GetSpendHeight(m_view), chainparams.GetConsensus());
+        if(!ExtractContractTxs(tx, &m_view, NULL, contractflags, contractTxs, true)){
             return state.Invalid(ValidationInvalidReason::CONSENSUS, error("AcceptToMempool(): Contract transaction of the wrong format"), REJECT_INVALID, "bad-tx-bad-contract-format");
         }
-        std::vector<QtumTransaction> qtumTransactions = resultConverter.first;
-        std::vector<EthTransactionParams> qtumETP = resultConverter.second;
+        const std::vector<QtumTransaction>& qtumTransactions = contractTxs->first;
+        const std::vector<EthTransactionParams>& qtumETP = contractTxs->second;
 
         dev::u256 sumGas = dev::u256(0);
         dev::u256 gasAllTxs = dev::u256(0);
@@ -821,6 +975,15 @@ bool MemPoolAccept::PreChecks(ATMPArgs& args, Workspace& ws)
             return state.Invalid(ValidationInvalidReason::TX_NOT_STANDARD, false,
                 REJECT_HIGHFEE, "absurdly-high-fee",
                 strprintf("%d > %d", nFees, nAbsurdFee));
+
+        // Limit the contract execution time the txs of a sender add to the mempool
+        const int64_t nSenderExecLimit = gArgs.GetArg("-maxsenderexectime", DEFAULT_MAX_SENDER_EXEC_TIME) * 1000;
+        for (const QtumTransaction& qtumTransaction : qtumTransactions) {
+            uint160 sender(qtumTransaction.sender().asBytes());
+            if (!bypass_limits && g_sender_exec_time.IsFull(sender, nSenderExecLimit, GetTimeMicros()))
+                return state.Invalid(ValidationInvalidReason::TX_MEMPOOL_POLICY, false, REJECT_INSUFFICIENTFEE, "sender-exec-time-limit");
+            ws.m_contract_senders.insert(sender);
+        }
     }
     ////////////////////////////////////////////////////////////
 
@@ -841,7 +1004,10 @@ bool MemPoolAccept::PreChecks(ATMPArgs& args, Workspace& ws)
     }
 
     entry.reset(new CTxMemPoolEntry(ptx, nFees, nAcceptTime, ::ChainActive().Height(),
-            fSpendsCoinbase, nSigOpsCost, lp, CAmount(txMinGasPrice)));
+            fSpendsCoinbase, nSigOpsCost, lp, CAmount(txMinGasPrice), contractTxs, contractflags));
+    // Until the block assembler executes the contracts, they are expected to take as long as the same calls took before
+    if (contractTxs)
+        entry->UpdateExecTime(g_contract_exec_times.Predict(contractTxs->first));
     unsigned int nSize = entry->GetTxSize();
 
     if (nSigOpsCost > dgpMaxTxSigOps)
@@ -1158,6 +1324,14 @@ bool MemPoolAccept::Finalize(ATMPArgs& args, Workspace& ws)
     // Store transaction in memory
     m_pool.addUnchecked(*entry, setAncestors, validForFeeEstimation);
 
+    if (!bypass_limits && !ws.m_contract_senders.empty()) {
+        const int64_t nSenderExecLimit = gArgs.GetArg("-maxsenderexectime", DEFAULT_MAX_SENDER_EXEC_TIME) * 1000;
+        const int64_t nCost = GetContractExecCost(entry->GetExecTime(), entry->GetGasLimit());
+        const int64_t nNow = GetTimeMicros();
+        for (const uint160& sender : ws.m_contract_senders)
+            g_sender_exec_time.Add(sender, nCost, nSenderExecLimit, nNow);
+    }
+
     // trim mempool and check if tx was trimmed
     if (!bypass_limits) {
         LimitMempoolSize(m_pool, gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
@@ -1182,9 +1356,11 @@ bool MemPoolAccept::AcceptSingleTransaction(const CTransactionRef& ptx, ATMPArgs
     // checks pass, to mitigate CPU exhaustion denial-of-service attacks.
     PrecomputedTransactionData txdata(*ptx);
 
-    if (!PolicyScriptChecks(args, workspace, txdata)) return false;
+    if (!args.m_trusted) {
+        if (!PolicyScriptChecks(args, workspace, txdata)) return false;
 
-    if (!ConsensusScriptChecks(args, workspace, txdata)) return false;
+        if (!ConsensusScriptChecks(args, workspace, txdata)) return false;
+    }
 
     // Tx was accepted, but not added
     if (args.m_test_accept) return true;
@@ -1201,10 +1377,10 @@ bool MemPoolAccept::AcceptSingleTransaction(const CTransactionRef& ptx, ATMPArgs
 /** (try to) add transaction to memory pool with a specified acceptance time **/
 static bool AcceptToMemoryPoolWithTime(const CChainParams& chainparams, CTxMemPool& pool, CValidationState &state, const CTransactionRef &tx,
                         bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
-                        bool bypass_limits, const CAmount nAbsurdFee, bool test_accept, bool rawTx = false) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+                        bool bypass_limits, const CAmount nAbsurdFee, bool test_accept, bool rawTx = false, bool trusted = false) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     std::vector<COutPoint> coins_to_uncache;
-    MemPoolAccept::ATMPArgs args { chainparams, state, pfMissingInputs, nAcceptTime, plTxnReplaced, bypass_limits, nAbsurdFee, coins_to_uncache, test_accept, rawTx };
+    MemPoolAccept::ATMPArgs args { chainparams, state, pfMissingInputs, nAcceptTime, plTxnReplaced, bypass_limits, nAbsurdFee, coins_to_uncache, test_accept, rawTx, trusted };
     bool res = MemPoolAccept(pool).AcceptSingleTransaction(tx, args);
     if (!res) {
         // Remove coins that were not present in the coins cache before calling ATMPW;
@@ -1285,6 +1461,33 @@ bool GetTransaction(const uint256& hash, CTransactionRef& txOut, const Consensus
     return false;
 }
 
+void GetTransactions(const std::vector<uint256>& hashes, std::vector<CTransactionRef>& txs, std::vector<uint256>& block_hashes)
+{
+    txs.assign(hashes.size(), nullptr);
+    block_hashes.assign(hashes.size(), uint256());
+
+    std::vector<uint256> index_hashes;
+    std::vector<size_t> index_positions;
+    for (size_t i = 0; i < hashes.size(); ++i) {
+        txs[i] = mempool.get(hashes[i]);
+        if (!txs[i]) {
+            index_hashes.push_back(hashes[i]);
+            index_positions.push_back(i);
+        }
+    }
+    if (!g_txindex || index_hashes.empty()) {
+        return;
+    }
+
+    std::vector<CTransactionRef> index_txs;
+    std::vector<uint256> index_block_hashes;
+    g_txindex->FindTxs(index_hashes, index_block_hashes, index_txs);
+    for (size_t i = 0; i < index_positions.size(); ++i) {
+        txs[index_positions[i]] = std::move(index_txs[i]);
+        block_hashes[index_positions[i]] = index_block_hashes[i];
+    }
+}
+
 bool CheckHeaderPoW(const CBlockHeader& block, const Consensus::Params& consensusParams)
 {
     // Check for proof of work block header
@@ -1389,6 +1592,11 @@ bool ReadBlockFromDisk(Block& block, const FlatFilePos& pos, const Consensus::Pa
 
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
+    if (std::shared_ptr<const CBlock> pcached = g_recent_blocks.Get(pindex->GetBlockHash())) {
+        block = *pcached;
+        return true;
+    }
+
     FlatFilePos blockPos;
     {
         LOCK(cs_main);
@@ -1403,11 +1611,22 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+bool ReadBlockFromDisk(std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+{
+    pblock = g_recent_blocks.Get(pindex->GetBlockHash());
+    if (pblock) return true;
+
+    std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+    if (!ReadBlockFromDisk(*pblockRead, pindex, consensusParams))
+        return false;
+    pblock = std::move(pblockRead);
+    return true;
+}
+
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, const CMessageHeader::MessageStartChars& message_start)
 {
-    FlatFilePos hpos = pos;
-    hpos.nPos -= 8; // Seek back 8 bytes for meta header
-    CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
+    // Open at the meta header 8 bytes before the block
+    CAutoFile filein(OpenFileRecord(BlockFileSeq(), pos, 0, true), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull()) {
         return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
     }
@@ -1576,11 +1795,12 @@ CoinsViews::CoinsViews(
     bool in_memory,
     bool should_wipe) : m_dbview(
                             GetDataDir() / ldb_name, cache_size_bytes, in_memory, should_wipe),
-                        m_catcherview(&m_dbview) {}
+                        m_catcherview(&m_dbview),
+                        m_flushview(&m_catcherview, m_dbview) {}
 
 void CoinsViews::InitCache()
 {
-    m_cacheview = MakeUnique<CCoinsViewCache>(&m_catcherview);
+    m_cacheview = MakeUnique<CCoinsViewCache>(&m_flushview);
 }
 
 // NOTE: for now m_blockman is set to a global, but this will be changed
@@ -1780,6 +2000,9 @@ void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight)
 }
 
 bool CScriptCheck::operator()() {
+    if(pblock)
+        return CheckBlockSignature(*pblock);
+
     if(checkOutput())
     {
         // Check the sender signature inside the output, used to identify VM sender
@@ -1950,15 +2173,10 @@ static bool UndoWriteToDisk(const CBlockUndo& blockundo, FlatFilePos& pos, const
     return true;
 }
 
-bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
+static bool UndoReadFromDisk(CBlockUndo& blockundo, const FlatFilePos& pos, const uint256& hashPrevBlock)
 {
-    FlatFilePos pos = pindex->GetUndoPos();
-    if (pos.IsNull()) {
-        return error("%s: no undo data available", __func__);
-    }
-
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
+    // Open history file to read, the checksum follows the undo data
+    CAutoFile filein(OpenFileRecord(UndoFileSeq(), pos, sizeof(uint256)), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull())
         return error("%s: OpenUndoFile failed", __func__);
 
@@ -1966,7 +2184,7 @@ bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
     uint256 hashChecksum;
     CHashVerifier<CAutoFile> verifier(&filein); // We need a CHashVerifier as reserializing may lose data
     try {
-        verifier << pindex->pprev->GetBlockHash();
+        verifier << hashPrevBlock;
         verifier >> blockundo;
         filein >> hashChecksum;
     }
@@ -1981,6 +2199,165 @@ bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
     return true;
 }
 
+/** Most blocks whose undo data is kept in memory */
+static const size_t UNDO_CACHE_BLOCKS = 16;
+
+/**
+ * Keeps the undo data of the blocks connected last, which the indexes and short reorgs read
+ * next, and reads the undo data of the blocks sequential consumers are about to need on a
+ * background thread. The undo files are still written by ConnectBlock and fsynced in batches
+ * by FlushBlockFile; entries are only ever copies of what is on disk.
+ */
+class UndoCache
+{
+public:
+    ~UndoCache()
+    {
+        {
+            LOCK(m_mutex);
+            m_stop = true;
+        }
+        m_cond.notify_all();
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    /** Keep the undo data just written for the block hash */
+    void Add(const uint256& hash, const CBlockUndo& blockundo)
+    {
+        std::shared_ptr<const CBlockUndo> pundo = std::make_shared<const CBlockUndo>(blockundo);
+        LOCK(m_mutex);
+        Entry* entry = Insert(hash);
+        if (entry) {
+            entry->pundo = std::move(pundo);
+            entry->fPending = false;
+        }
+    }
+
+    /** Start reading the undo data of pindex unless it is in memory or being read already */
+    void Prefetch(const CBlockIndex* pindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+    {
+        FlatFilePos pos = pindex->GetUndoPos();
+        if (pos.IsNull() || !pindex->pprev)
+            return;
+        {
+            LOCK(m_mutex);
+            if (m_entries.count(pindex->GetBlockHash()))
+                return;
+            Entry* entry = Insert(pindex->GetBlockHash());
+            if (!entry)
+                return;
+            entry->fPending = true;
+            m_queue.push_back(Read{pindex->GetBlockHash(), pos, pindex->pprev->GetBlockHash()});
+            if (!m_thread.joinable())
+                m_thread = std::thread(&TraceThread<std::function<void()>>, "undoread", std::function<void()>(std::bind(&UndoCache::ThreadRead, this)));
+        }
+        m_cond.notify_all();
+    }
+
+    /** Copy the undo data of the block hash out of memory, waiting for it if it is being read */
+    bool Get(const uint256& hash, CBlockUndo& blockundo)
+    {
+        std::shared_ptr<const CBlockUndo> pundo;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            m_cond.wait(lock, [this, &hash] { auto it = m_entries.find(hash); return it == m_entries.end() || !it->second.fPending; });
+            auto it = m_entries.find(hash);
+            if (it == m_entries.end() || !it->second.pundo)
+                return false;
+            m_lru.splice(m_lru.end(), m_lru, it->second.lru);
+            pundo = it->second.pundo;
+        }
+        blockundo = *pundo;
+        return true;
+    }
+
+private:
+    struct Entry {
+        //! Null when a read failed, the caller reads the file itself and reports the error
+        std::shared_ptr<const CBlockUndo> pundo;
+        bool fPending = false;
+        std::list<uint256>::iterator lru;
+    };
+    struct Read {
+        uint256 hash;
+        FlatFilePos pos;
+        uint256 hashPrevBlock;
+    };
+
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    std::map<uint256, Entry> m_entries GUARDED_BY(m_mutex);
+    //! Least recently used first
+    std::list<uint256> m_lru GUARDED_BY(m_mutex);
+    std::deque<Read> m_queue GUARDED_BY(m_mutex);
+    bool m_stop GUARDED_BY(m_mutex) = false;
+    std::thread m_thread;
+
+    /** The entry of hash, made room for by evicting the least recently used entry not being read */
+    Entry* Insert(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(m_mutex)
+    {
+        auto it = m_entries.find(hash);
+        if (it != m_entries.end())
+            return &it->second;
+        if (m_entries.size() >= UNDO_CACHE_BLOCKS) {
+            auto evict = std::find_if(m_lru.begin(), m_lru.end(), [this](const uint256& h) { return !m_entries.at(h).fPending; });
+            if (evict == m_lru.end())
+                return nullptr;
+            m_entries.erase(*evict);
+            m_lru.erase(evict);
+        }
+        Entry& entry = m_entries[hash];
+        entry.lru = m_lru.insert(m_lru.end(), hash);
+        return &entry;
+    }
+
+    void ThreadRead()
+    {
+        while (true) {
+            Read read;
+            {
+                WAIT_LOCK(m_mutex, lock);
+                m_cond.wait(lock, [this] { return !m_queue.empty() || m_stop; });
+                if (m_stop)
+                    return;
+                read = m_queue.front();
+                m_queue.pop_front();
+            }
+            std::shared_ptr<CBlockUndo> pundo = std::make_shared<CBlockUndo>();
+            if (!UndoReadFromDisk(*pundo, read.pos, read.hashPrevBlock))
+                pundo.reset();
+            {
+                LOCK(m_mutex);
+                auto it = m_entries.find(read.hash);
+                if (it != m_entries.end() && it->second.fPending) {
+                    it->second.pundo = std::move(pundo);
+                    it->second.fPending = false;
+                }
+            }
+            m_cond.notify_all();
+        }
+    }
+};
+
+static UndoCache undoCache;
+
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    FlatFilePos pos = pindex->GetUndoPos();
+    if (pos.IsNull()) {
+        return error("%s: no undo data available", __func__);
+    }
+    if (undoCache.Get(pindex->GetBlockHash(), blockundo))
+        return true;
+    return UndoReadFromDisk(blockundo, pos, pindex->pprev->GetBlockHash());
+}
+
+void PrefetchUndo(const CBlockIndex* pindex)
+{
+    undoCache.Prefetch(pindex);
+}
+
 /** Abort with a message */
 static bool AbortNode(const std::string& strMessage, const std::string& userMessage = "", unsigned int prefix = 0)
 {
@@ -2037,7 +2414,7 @@ int ApplyTxInUndo(Coin&& undo, CCoinsViewCache& view, const COutPoint& out)
 
 /** Undo the effects of this block (with given index) on the UTXO set represented by coins.
  *  When FAILED is returned, view is left in an indeterminate state. */
-DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean)
+DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean, DisconnectedBlockEffects* effects)
 {
     assert(pindex->GetBlockHash() == view.GetBestBlock());
     if (pfClean)
@@ -2055,13 +2432,6 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
         return DISCONNECT_FAILED;
     }
 
-#ifdef ENABLE_BITCORE_RPC
-    /////////////////////////////////////////////////////////// // qtum
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
-    ///////////////////////////////////////////////////////////
-#endif
-
     // undo transactions in reverse order
     for (int i = block.vtx.size() - 1; i >= 0; i--) {
         const CTransaction &tx = *(block.vtx[i]);
@@ -2082,31 +2452,6 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
             }
         }
 
-#ifdef ENABLE_BITCORE_RPC
-        /////////////////////////////////////////////////////////// // qtum
-        if (pfClean == NULL && fAddressIndex) {
-
-            for (unsigned int k = tx.vout.size(); k-- > 0;) {
-                const CTxOut &out = tx.vout[k];
-
-                CTxDestination dest;
-                if (ExtractDestination({hash, k}, out.scriptPubKey, dest)) {
-                    valtype bytesID(boost::apply_visitor(DataVisitor(), dest));
-                    if(bytesID.empty()) {
-                        continue;
-                    }
-                    valtype addressBytes(32);
-                    std::copy(bytesID.begin(), bytesID.end(), addressBytes.begin());
-                    // undo receiving activity
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(dest.which(), uint256(addressBytes), pindex->nHeight, i, hash, k, false), out.nValue));
-                    // undo unspent index
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(dest.which(), uint256(addressBytes), hash, k), CAddressUnspentValue()));
-                }
-            }
-        }
-        ///////////////////////////////////////////////////////////
-#endif
-
         // restore inputs
         if (i > 0) { // not coinbases
             CTxUndo &txundo = blockUndo.vtxundo[i-1];
@@ -2119,29 +2464,6 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
                 int res = ApplyTxInUndo(std::move(txundo.vprevout[j]), view, out);
                 if (res == DISCONNECT_FAILED) return DISCONNECT_FAILED;
                 fClean = fClean && res != DISCONNECT_UNCLEAN;
-
-#ifdef ENABLE_BITCORE_RPC
-                const auto &undo = txundo.vprevout[j];
-                const bool isTxCoinStake = tx.IsCoinStake();
-                const CTxIn input = tx.vin[j];
-                if (pfClean == NULL && fAddressIndex) {
-                    const CTxOut &prevout = view.GetOutputFor(input);
-
-                    CTxDestination dest;
-                    if (ExtractDestination(input.prevout, prevout.scriptPubKey, dest)) {
-                        valtype bytesID(boost::apply_visitor(DataVisitor(), dest));
-                        if(bytesID.empty()) {
-                            continue;
-                        }
-                        valtype addressBytes(32);
-                        std::copy(bytesID.begin(), bytesID.end(), addressBytes.begin());
-                        // undo spending activity
-                        addressIndex.push_back(std::make_pair(CAddressIndexKey(dest.which(), uint256(addressBytes), pindex->nHeight, i, hash, j, true), prevout.nValue * -1));
-                        // restore unspent index
-                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(dest.which(), uint256(addressBytes), input.prevout.hash, input.prevout.n), CAddressUnspentValue(prevout.nValue, prevout.scriptPubKey, undo.nHeight, isTxCoinStake)));
-                    }
-                }
-#endif
             }
             // At this point, all of txundo.vprevout should have been moved out.
         }
@@ -2150,6 +2472,18 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
+    governanceWinnerCache.eraseFrom(pindex->nHeight); // metrix
+
+    if (effects) {
+        // Setting the roots drops the account cache of the state, so that is done once for the whole reorg
+        if (!effects->pindexFork)
+            effects->nHighest = pindex->nHeight;
+        effects->pindexFork = pindex->pprev;
+        if (fLogEvents)
+            effects->vtxResults.insert(effects->vtxResults.end(), block.vtx.begin(), block.vtx.end());
+        return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
+    }
+
     globalState->setRoot(uintToh256(pindex->pprev->hashStateRoot)); // qtum
     globalState->setRootUTXO(uintToh256(pindex->pprev->hashUTXORoot)); // qtum
 
@@ -2159,21 +2493,6 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
     }
     pblocktree->EraseStakeIndex(pindex->nHeight);
 
-#ifdef ENABLE_BITCORE_RPC
-    //////////////////////////////////////////////////// // qtum
-    if (pfClean == NULL && fAddressIndex) {
-        if (!pblocktree->EraseAddressIndex(addressIndex)) {
-            error("Failed to delete address index");
-            return DISCONNECT_FAILED;
-        }
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            error("Failed to write address unspent index");
-            return DISCONNECT_FAILED;
-        }
-    }
-    ////////////////////////////////////////////////////
-#endif
-
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
@@ -2208,6 +2527,7 @@ static bool WriteUndoDataForBlock(const CBlockUndo& blockundo, CValidationState&
         pindex->nUndoPos = _pos.nPos;
         pindex->nStatus |= BLOCK_HAVE_UNDO;
         setDirtyBlockIndex.insert(pindex);
+        undoCache.Add(pindex->GetBlockHash(), blockundo);
     }
 
     return true;
@@ -2344,17 +2664,115 @@ static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 static int64_t nBlocksTotal = 0;
+// qtum: the contract parts of ConnectBlock
+static int64_t nTimeDGPParams = 0;
+static int64_t nTimeContractChecks = 0;
+static int64_t nTimeContractExec = 0;
+static int64_t nTimeContractResults = 0;
+static int64_t nTimeReceipts = 0;
+static int64_t nTimeScriptWait = 0;
+static int64_t nTimeCondensing = 0;
+static int64_t nTimeChainIndexes = 0;
+static int64_t nTimeReceiptsCommit = 0;
+
+/** Add the time of a part of ConnectBlock to its total and log both */
+static void AddBenchTime(const char* pszPart, int64_t nMicros, int64_t& nTotal)
+{
+    nTotal += nMicros;
+    LogPrint(BCLog::BENCH, "%s: %.2fms [%.2fs (%.2fms/blk)]\n", pszPart, MILLI * nMicros, nTotal * MICRO, nTotal * MILLI / std::max<int64_t>(nBlocksTotal, 1));
+}
 
 /////////////////////////////////////////////////////////////////////// qtum
+/** Most coins kept by the spent coin journal, about 30 MiB */
+static const size_t MAX_SPENT_COIN_JOURNAL_COINS = 200000;
+
+/**
+ * The coins spent by the last COINBASE_MATURITY blocks of the active chain, by outpoint, so that
+ * GetSpentCoinFromMainChain finds the stake of a fork without reading those blocks and their undo
+ * data from disk. It covers the blocks connected since startup, the older ones are still scanned.
+ */
+class SpentCoinJournal
+{
+public:
+    void BlockConnected(const CBlock& block, const CBlockUndo& blockundo, int nHeight) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+    {
+        if (!m_blocks.empty() && m_blocks.back().first != nHeight - 1)
+            Clear();
+        if (blockundo.vtxundo.size() != block.vtx.size() - 1) {
+            Clear();
+            return;
+        }
+
+        std::vector<COutPoint> spent;
+        for (size_t j = 1; j < block.vtx.size(); ++j) {
+            const CTransaction& tx = *block.vtx[j];
+            const CTxUndo& txundo = blockundo.vtxundo[j - 1];
+            for (size_t k = 0; k < tx.vin.size() && k < txundo.vprevout.size(); ++k) {
+                spent.push_back(tx.vin[k].prevout);
+                m_coins.emplace(tx.vin[k].prevout, std::make_pair(nHeight, txundo.vprevout[k]));
+            }
+        }
+        m_blocks.emplace_back(nHeight, std::move(spent));
+
+        while (!m_blocks.empty() && (m_blocks.front().first <= nHeight - COINBASE_MATURITY || m_coins.size() > MAX_SPENT_COIN_JOURNAL_COINS)) {
+            EraseBlock(m_blocks.front());
+            m_blocks.pop_front();
+        }
+    }
+
+    void BlockDisconnected(int nHeight) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+    {
+        if (m_blocks.empty() || m_blocks.back().first != nHeight) {
+            Clear();
+            return;
+        }
+        EraseBlock(m_blocks.back());
+        m_blocks.pop_back();
+    }
+
+    /** First height of the journal when it ends at nTipHeight, above nTipHeight when it covers nothing */
+    int CoveredFrom(int nTipHeight) const EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+    {
+        if (m_blocks.empty() || m_blocks.back().first != nTipHeight)
+            return nTipHeight + 1;
+        return m_blocks.front().first;
+    }
+
+    /** The height that spent prevout and the coin it spent */
+    const std::pair<int, Coin>* Find(const COutPoint& prevout) const EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+    {
+        auto it = m_coins.find(prevout);
+        return it == m_coins.end() ? nullptr : &it->second;
+    }
+
+private:
+    std::unordered_map<COutPoint, std::pair<int, Coin>, SaltedOutpointHasher> m_coins GUARDED_BY(cs_main);
+    std::deque<std::pair<int, std::vector<COutPoint>>> m_blocks GUARDED_BY(cs_main);
+
+    void EraseBlock(const std::pair<int, std::vector<COutPoint>>& spent) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+    {
+        for (const COutPoint& prevout : spent.second)
+            m_coins.erase(prevout);
+    }
+
+    void Clear() EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+    {
+        m_coins.clear();
+        m_blocks.clear();
+    }
+};
+
+static SpentCoinJournal spentCoinJournal;
+
 bool GetSpentCoinFromBlock(const CBlockIndex* pindex, COutPoint prevout, Coin* coin) {
-    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-    CBlock& block = *pblock;
-    if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+    std::shared_ptr<const CBlock> pblock;
+    if (!ReadBlockFromDisk(pblock, pindex, Params().GetConsensus())) {
         return error("GetSpentCoinFromBlock(): Could not read block from disk");
     }
+    const CBlock& block = *pblock;
 
     for(size_t j = 1; j < block.vtx.size(); ++j) {
-        CTransactionRef& tx = block.vtx[j];
+        const CTransactionRef& tx = block.vtx[j];
         for(size_t k = 0; k < tx->vin.size(); ++k) {
             const COutPoint& tmpprevout = tx->vin[k].prevout;
             if(tmpprevout == prevout) {
@@ -2405,8 +2823,17 @@ bool GetSpentCoinFromMainChain(const CBlockIndex* pforkPrev, COutPoint prevoutSt
 
     // Scan through blocks until we reach the forkbase to check if the prevoutStake has been spent in one of those blocks
     // If it not in any of those blocks, and not in the utxo set, it can't be spendable in the orphan chain.
+    // The most recent blocks are looked up in the spent coin journal, only the older ones are read from disk.
     {
-        CBlockIndex* pindex = ChainActive().Tip();
+        const int nCoveredFrom = spentCoinJournal.CoveredFrom(ChainActive().Height());
+        const std::pair<int, Coin>* spent = nCoveredFrom <= ChainActive().Height() ? spentCoinJournal.Find(prevoutStake) : nullptr;
+        if(spent && spent->first > pforkBase->nHeight) {
+            *coin = spent->second;
+            return true;
+        }
+
+        const int nHeight = std::min(nCoveredFrom - 1, ChainActive().Height());
+        CBlockIndex* pindex = nHeight > pforkBase->nHeight ? ChainActive()[nHeight] : nullptr;
         while(pindex && pindex != pforkBase) {
             if(GetSpentCoinFromBlock(pindex, prevoutStake, coin)) {
                 return true;
@@ -2446,7 +2873,7 @@ bool CheckOpSender(const CTransaction& tx, const CChainParams& chainparams, int
 
 bool CheckSenderScript(const CCoinsViewCache& view, const CTransaction& tx){
     // Check for the sender that pays the coins
-    CScript script = view.AccessCoin(tx.vin[0].prevout).out.scriptPubKey;
+    const CScript& script = view.AccessCoin(tx.vin[0].prevout).out.scriptPubKey;
     if(!script.IsPayToPubkeyHash() && !script.IsPayToPubkey()){
         return false;
     }
@@ -2500,18 +2927,90 @@ std::vector<ResultExecute> CallContract(const dev::Address& addrContract, std::v
     return CallContract(addrContract, opcode, pblockindex, sender, gasLimit, blockGasLimit);
 }
 
+/** Whether committed executions left trie nodes in the global state overlays, written out by FlushQtumStateToDisk */
+static bool fStateCacheDirty GUARDED_BY(cs_main) = false;
+/** Memory of the global state overlays when last measured, measuring walks every node so it is only redone after they changed */
+static size_t nStateCacheDirty GUARDED_BY(cs_main) = 0;
+static bool fStateCacheMeasured GUARDED_BY(cs_main) = true;
+
+void MarkQtumStateCacheDirty()
+{
+    AssertLockHeld(cs_main);
+    fStateCacheDirty = true;
+    fStateCacheMeasured = false;
+}
+
+size_t QtumStateCacheUsage()
+{
+    AssertLockHeld(cs_main);
+    if (!fStateCacheMeasured) {
+        nStateCacheDirty = globalState ? globalState->OverlayMemoryUsage() : 0;
+        fStateCacheMeasured = true;
+    }
+    return nStateCacheDirty;
+}
+
+void FlushQtumStateToDisk()
+{
+    AssertLockHeld(cs_main);
+    if(!fStateCacheDirty || !globalState)
+        return;
+    const size_t usage = QtumStateCacheUsage();
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_globalOverlay);
+        globalState->db().commit();
+        globalState->dbUtxo().commit();
+    }
+    LogPrint(BCLog::COINDB, "Committed %.1f MiB of EVM state\n", usage * (1.0 / 1024 / 1024));
+    nStateCacheDirty = 0;
+    fStateCacheDirty = false;
+}
+
+/** Header plus coinbase (and coinstake) of the last block a contract call was made on */
+static Mutex cs_callTemplate;
+static uint256 callTemplateHash GUARDED_BY(cs_callTemplate);
+static CBlock callTemplate GUARDED_BY(cs_callTemplate);
+
+static CBlock MakeCallTemplate(const CBlock& block)
+{
+    CBlock callBlock(block.GetBlockHeader());
+    size_t nTxs = block.IsProofOfStake() ? 2 : 1;
+    callBlock.vtx.assign(block.vtx.begin(), block.vtx.begin() + std::min(nTxs, block.vtx.size()));
+    return callBlock;
+}
+
+void SetCallContractTemplate(const CBlock& block, const CBlockIndex* pindex)
+{
+    CBlock callBlock(MakeCallTemplate(block));
+    LOCK(cs_callTemplate);
+    callTemplateHash = pindex->GetBlockHash();
+    callTemplate = std::move(callBlock);
+}
+
+static bool GetCallContractTemplate(CBlock& block, const CBlockIndex* pindex)
+{
+    {
+        LOCK(cs_callTemplate);
+        if (callTemplateHash == pindex->GetBlockHash()) {
+            block = callTemplate;
+            return true;
+        }
+    }
+    std::shared_ptr<const CBlock> pblockFull;
+    if (!ReadBlockFromDisk(pblockFull, pindex, Params().GetConsensus()))
+        return false;
+    block = MakeCallTemplate(*pblockFull);
+    SetCallContractTemplate(*pblockFull, pindex);
+    return true;
+}
+
 std::vector<ResultExecute> CallContract(const dev::Address& addrContract, std::vector<unsigned char> opcode, CBlockIndex* pblockindex, const dev::Address& sender, uint64_t gasLimit, uint64_t blockGasLimit) {
     CBlock block;
     CMutableTransaction tx;
 
-    ReadBlockFromDisk(block, pblockindex, Params().GetConsensus());
+    GetCallContractTemplate(block, pblockindex);
     block.nTime = GetAdjustedTime();
 
-    if (block.IsProofOfStake())
-        block.vtx.erase(block.vtx.begin() + 2, block.vtx.end());
-    else
-        block.vtx.erase(block.vtx.begin() + 1, block.vtx.end());
-
     if (blockGasLimit == 0)
     {
         QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
@@ -2535,10 +3034,86 @@ std::vector<ResultExecute> CallContract(const dev::Address& addrContract, std::v
     return exec.getResult();
 }
 
-bool CheckMinGasPrice(std::vector<EthTransactionParams>& etps, const uint64_t& minGasPrice){
-    for(EthTransactionParams& etp : etps){
-        if(etp.gasPrice < dev::u256(minGasPrice))
-            return false;
+std::vector<ResultExecute> CallContract(QtumStateView& view, const dev::Address& addrContract, std::vector<unsigned char> opcode, CBlockIndex* pblockindex, const dev::Address& sender, uint64_t gasLimit, uint64_t blockGasLimit) {
+    return CallContracts(view, std::vector<ContractCallParams>(1, ContractCallParams{addrContract, opcode, sender, gasLimit, 0}), pblockindex, blockGasLimit);
+}
+
+std::vector<ResultExecute> CallContracts(QtumStateView& view, const std::vector<ContractCallParams>& calls, CBlockIndex* pblockindex, uint64_t blockGasLimit) {
+    assert(blockGasLimit > 0);
+    CBlock block;
+    GetCallContractTemplate(block, pblockindex);
+    block.nTime = GetAdjustedTime();
+
+    std::vector<QtumTransaction> callTransactions;
+    callTransactions.reserve(calls.size());
+    for (const ContractCallParams& call : calls) {
+        uint64_t gasLimit = call.gasLimit == 0 ? blockGasLimit - 1 : call.gasLimit;
+        dev::Address senderAddress = call.sender == dev::Address() ? dev::Address("ffffffffffffffffffffffffffffffffffffffff") : call.sender;
+        QtumTransaction callTransaction = call.contract == dev::Address() ?
+            QtumTransaction(dev::u256(call.value), 1, dev::u256(gasLimit), call.data, dev::u256(0)) :
+            QtumTransaction(dev::u256(call.value), 1, dev::u256(gasLimit), call.contract, call.data, dev::u256(0));
+        callTransaction.forceSender(senderAddress);
+        callTransaction.setVersion(VersionVM::GetEVMDefault());
+        callTransactions.push_back(callTransaction);
+
+        // every call gets the transaction paying its own sender, like a single CallContract
+        CMutableTransaction tx;
+        tx.vout.push_back(CTxOut(0, CScript() << OP_DUP << OP_HASH160 << senderAddress.asBytes() << OP_EQUALVERIFY << OP_CHECKSIG));
+        block.vtx.push_back(MakeTransactionRef(CTransaction(tx)));
+    }
+
+    // Reverted executions drop their state changes, so every call sees the same pinned state
+    ByteCodeExec exec(block, callTransactions, blockGasLimit, pblockindex, &view.state(), &view.sealEngine());
+    exec.performByteCode(dev::eth::Permanence::Reverted);
+    return exec.getResult();
+}
+
+bool EstimateContractGas(QtumStateView& view, const ContractCallParams& call, CBlockIndex* pblockindex, uint64_t blockGasLimit, uint64_t& gasLimit, ResultExecute& result) {
+    ContractCallParams probe = call;
+    uint64_t hi = call.gasLimit == 0 ? blockGasLimit - 1 : call.gasLimit;
+    probe.gasLimit = hi;
+    result = CallContracts(view, std::vector<ContractCallParams>(1, probe), pblockindex, blockGasLimit)[0];
+    // A call that fails with all the gas it may have fails with less, whether it ran out or reverted
+    if (result.execRes.excepted != dev::eth::TransactionException::None)
+        return false;
+
+    // The gas used is net of the refunds, the call spent at least as much before them
+    uint64_t lo = std::max(MINIMUM_GAS_LIMIT, uint64_t(result.execRes.gasUsed)) - 1;
+    bool first = true;
+    while (hi - lo > std::max<uint64_t>(1, hi / GAS_ESTIMATE_PRECISION)) {
+        // Most calls succeed with little more than they used, which saves the bisection
+        uint64_t mid = first ? lo + 1 + lo / GAS_ESTIMATE_PRECISION : lo + (hi - lo) / 2;
+        if (mid >= hi)
+            mid = lo + (hi - lo) / 2;
+        first = false;
+
+        probe.gasLimit = mid;
+        ResultExecute probeResult = CallContracts(view, std::vector<ContractCallParams>(1, probe), pblockindex, blockGasLimit)[0];
+        if (probeResult.execRes.excepted == dev::eth::TransactionException::None) {
+            hi = mid;
+            result = std::move(probeResult);
+        } else {
+            lo = mid;
+        }
+    }
+    gasLimit = hi;
+    return true;
+}
+
+bool EstimateContractGas(const ContractCallParams& call, uint64_t& gasLimit, ResultExecute& result) {
+    AssertLockHeld(cs_main);
+    CBlockIndex* pblockindex = ::ChainActive().Tip();
+    QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
+    uint64_t blockGasLimit = qtumDGP.getBlockGasLimit(pblockindex->nHeight + 1);
+    QtumStateViewPool::Handle view = stateViewPool.acquire(uintToh256(pblockindex->hashStateRoot), uintToh256(pblockindex->hashUTXORoot));
+    view->sealEngine().setQtumSchedule(qtumDGP.getGasSchedule(pblockindex->nHeight + 1));
+    return EstimateContractGas(*view, call, pblockindex, blockGasLimit, gasLimit, result);
+}
+
+bool CheckMinGasPrice(const std::vector<EthTransactionParams>& etps, const uint64_t& minGasPrice){
+    for(const EthTransactionParams& etp : etps){
+        if(etp.gasPrice < dev::u256(minGasPrice))
+            return false;
     }
     return true;
 }
@@ -2860,30 +3435,32 @@ UniValue vmLogToJSON(const ResultExecute& execRes, const CTransaction& tx, const
 }
 
 void writeVMlog(const std::vector<ResultExecute>& res, const CTransaction& tx, const CBlock& block){
-    boost::filesystem::path qtumDir = GetDataDir() / "vmExecLogs.json";
-    std::stringstream ss;
-    if(fIsVMlogFile){
-        ss << ",";
-    } else {
-        std::ofstream file(qtumDir.string(), std::ios::out | std::ios::app);
-        file << "{\"logs\":[]}";
-        file.close();
+    if(!g_vmlog_writer)
+        return;
+    for(const ResultExecute& execRes : res){
+        g_vmlog_writer->Append(vmLogToJSON(execRes, tx, block).write());
     }
+}
 
-    for(size_t i = 0; i < res.size(); i++){
-        ss << vmLogToJSON(res[i], tx, block).write();
-        if(i != res.size() - 1){
-            ss << ",";
-        } else {
-            ss << "]}";
-        }
+/** Preceding hashes of the active chain tip, replaced as a whole so readers never need cs_main */
+struct TipLastHashes {
+    uint256 tip;
+    dev::h256s hashes;
+};
+static std::shared_ptr<const TipLastHashes> tipLastHashes;
+
+static std::shared_ptr<TipLastHashes> WalkLastHashes(const CBlockIndex *tip)
+{
+    std::shared_ptr<TipLastHashes> walked = std::make_shared<TipLastHashes>();
+    walked->tip = tip ? tip->GetBlockHash() : uint256();
+    walked->hashes.resize(LAST_HASHES_COUNT);
+    for(size_t i=0;i<LAST_HASHES_COUNT;i++){
+        if(!tip)
+            break;
+        walked->hashes[i]= uintToh256(*tip->phashBlock);
+        tip = tip->pprev;
     }
-    
-    std::ofstream file(qtumDir.string(), std::ios::in | std::ios::out);
-    file.seekp(-2, std::ios::end);
-    file << ss.str();
-    file.close();
-    fIsVMlogFile = true;
+    return walked;
 }
 
 LastHashes::LastHashes()
@@ -2891,25 +3468,41 @@ LastHashes::LastHashes()
 
 void LastHashes::set(const CBlockIndex *tip)
 {
-    clear();
+    std::shared_ptr<const TipLastHashes> current = std::atomic_load(&tipLastHashes);
+    if(current && tip && current->tip == tip->GetBlockHash()){
+        m_lastHashes = std::shared_ptr<const dev::h256s>(current, &current->hashes);
+        return;
+    }
+    // off the active tip (historical calls, candidate reorgs): walk the index
+    std::shared_ptr<const TipLastHashes> walked = WalkLastHashes(tip);
+    m_lastHashes = std::shared_ptr<const dev::h256s>(walked, &walked->hashes);
+}
 
-    m_lastHashes.resize(256);
-    for(int i=0;i<256;i++){
-        if(!tip)
-            break;
-        m_lastHashes[i]= uintToh256(*tip->phashBlock);
-        tip = tip->pprev;
+void LastHashes::updateTip(const CBlockIndex *tip)
+{
+    std::shared_ptr<const TipLastHashes> current = std::atomic_load(&tipLastHashes);
+    std::shared_ptr<TipLastHashes> next;
+    if(current && tip && tip->pprev && current->tip == tip->pprev->GetBlockHash()){
+        // connected on top of the previous tip: shift by one instead of walking 256 blocks
+        next = std::make_shared<TipLastHashes>();
+        next->tip = tip->GetBlockHash();
+        next->hashes.reserve(LAST_HASHES_COUNT);
+        next->hashes.push_back(uintToh256(next->tip));
+        next->hashes.insert(next->hashes.end(), current->hashes.begin(), current->hashes.end() - 1);
+    }else{
+        next = WalkLastHashes(tip);
     }
+    std::atomic_store(&tipLastHashes, std::shared_ptr<const TipLastHashes>(std::move(next)));
 }
 
 dev::h256s LastHashes::precedingHashes(const dev::h256 &) const
 {
-    return m_lastHashes;
+    return m_lastHashes ? *m_lastHashes : dev::h256s();
 }
 
 void LastHashes::clear()
 {
-    m_lastHashes.clear();
+    m_lastHashes.reset();
 }
 
 bool ByteCodeExec::performByteCode(dev::eth::Permanence type){
@@ -2918,8 +3511,8 @@ bool ByteCodeExec::performByteCode(dev::eth::Permanence type){
         if(tx.getVersion().toRaw() != VersionVM::GetEVMDefault().toRaw()){
             return false;
         }
-        dev::eth::EnvInfo envInfo(BuildEVMEnvironment());
-        if(!tx.isCreation() && !globalState->addressInUse(tx.receiveAddress())){
+        // calls to addresses without an account are refunded without touching the EVM
+        if(!tx.isCreation() && !state->addressInUse(tx.receiveAddress())){
             dev::eth::ExecutionResult execRes;
             execRes.excepted = dev::eth::TransactionException::Unknown;
             result.push_back(ResultExecute{
@@ -2929,11 +3522,13 @@ bool ByteCodeExec::performByteCode(dev::eth::Permanence type){
             });
             continue;
         }
-        result.push_back(globalState->execute(envInfo, *globalSealEngine.get(), tx, type, OnOpFunc()));
+        result.push_back(state->execute(envInfo(), *sealEngine, tx, type, OnOpFunc()));
+        // the trie nodes stay in the global overlay until FlushStateToDisk writes them out; views never persist anything
+        if(type == dev::eth::Permanence::Committed && state == globalState.get()){
+            MarkQtumStateCacheDirty();
+        }
     }
-    globalState->db().commit();
-    globalState->dbUtxo().commit();
-    globalSealEngine.get()->deleteAddresses.clear();
+    sealEngine->deleteAddresses.clear();
     return true;
 }
 
@@ -2985,24 +3580,33 @@ bool ByteCodeExec::processingResults(ByteCodeExecResult& resultBCE){
     return true;
 }
 
-dev::eth::EnvInfo ByteCodeExec::BuildEVMEnvironment(){
-    CBlockIndex* tip = pindex;
+static dev::eth::BlockHeader EVMBlockHeader(const CBlock& block, const CBlockIndex* pindexPrev, uint64_t blockGasLimit){
     dev::eth::BlockHeader header;
-    header.setNumber(tip->nHeight + 1);
+    header.setNumber(pindexPrev->nHeight + 1);
     header.setTimestamp(block.nTime);
     header.setDifficulty(dev::u256(block.nBits));
     header.setGasLimit(blockGasLimit);
-
-    lastHashes.set(tip);
-
     if(block.IsProofOfStake()){
-        header.setAuthor(EthAddrFromScript(block.vtx[1]->vout[1].scriptPubKey));
+        header.setAuthor(ByteCodeExec::EthAddrFromScript(block.vtx[1]->vout[1].scriptPubKey));
     }else {
-        header.setAuthor(EthAddrFromScript(block.vtx[0]->vout[0].scriptPubKey));
+        header.setAuthor(ByteCodeExec::EthAddrFromScript(block.vtx[0]->vout[0].scriptPubKey));
+    }
+    return header;
+}
+
+EVMBlockEnvironment::EVMBlockEnvironment(const CBlock& block, const CBlockIndex* pindexPrev, uint64_t blockGasLimit) :
+    m_envInfo(EVMBlockHeader(block, pindexPrev, blockGasLimit), m_lastHashes, dev::u256())
+{
+    // m_envInfo only keeps a reference to the hashes, so they can be filled in afterwards
+    m_lastHashes.set(pindexPrev);
+}
+
+const dev::eth::EnvInfo& ByteCodeExec::envInfo(){
+    if(!env){
+        ownEnv.reset(new EVMBlockEnvironment(block, pindex, blockGasLimit));
+        env = ownEnv.get();
     }
-    dev::u256 gasUsed;
-    dev::eth::EnvInfo env(header, lastHashes, gasUsed);
-    return env;
+    return env->envInfo();
 }
 
 dev::Address ByteCodeExec::EthAddrFromScript(const CScript& script){
@@ -3033,7 +3637,7 @@ bool QtumTxConverter::extractionQtumTransactions(ExtractQtumTX& qtumtx){
                 EthTransactionParams params;
                 if(parseEthTXParams(params)){
                     resultTX.push_back(createEthTX(params, i));
-                    resultETP.push_back(params);
+                    resultETP.push_back(std::move(params));
                 }else{
                     return false;
                 }
@@ -3042,7 +3646,57 @@ bool QtumTxConverter::extractionQtumTransactions(ExtractQtumTX& qtumtx){
             }
         }
     }
-    qtumtx = std::make_pair(resultTX, resultETP);
+    qtumtx = std::make_pair(std::move(resultTX), std::move(resultETP));
+    return true;
+}
+
+/** Contract transactions extracted by ExtractContractTxs, by txid and script flags, the oldest are dropped first */
+class ContractTxCache
+{
+public:
+    using Key = std::pair<uint256, unsigned int>;
+
+    ContractTxsRef get(const Key& key)
+    {
+        LOCK(m_mutex);
+        auto it = m_txs.find(key);
+        return it != m_txs.end() ? it->second : nullptr;
+    }
+
+    void insert(const Key& key, const ContractTxsRef& contractTxs)
+    {
+        LOCK(m_mutex);
+        if (!m_txs.emplace(key, contractTxs).second)
+            return;
+        m_order.push_back(key);
+        if (m_order.size() > MAX_CONTRACT_TX_CACHE_SIZE) {
+            m_txs.erase(m_order.front());
+            m_order.pop_front();
+        }
+    }
+
+private:
+    Mutex m_mutex;
+    std::map<Key, ContractTxsRef> m_txs GUARDED_BY(m_mutex);
+    std::deque<Key> m_order GUARDED_BY(m_mutex);
+};
+
+static ContractTxCache contractTxCache;
+
+bool ExtractContractTxs(const CTransaction& tx, CCoinsViewCache* view, const std::vector<CTransactionRef>* blockTxs, unsigned int flags, ContractTxsRef& contractTxs, bool fCache)
+{
+    ContractTxCache::Key key(tx.GetHash(), flags);
+    contractTxs = contractTxCache.get(key);
+    if (contractTxs)
+        return true;
+
+    QtumTxConverter convert(tx, view, blockTxs, flags);
+    ExtractQtumTX resultConverter;
+    if (!convert.extractionQtumTransactions(resultConverter))
+        return false;
+    contractTxs = std::make_shared<const ExtractQtumTX>(std::move(resultConverter));
+    if (fCache)
+        contractTxCache.insert(key, contractTxs);
     return true;
 }
 
@@ -3082,7 +3736,8 @@ bool QtumTxConverter::parseEthTXParams(EthTransactionParams& params){
         if(stack.back().size() < 1){
             return false;
         }
-        valtype code(stack.back());
+        // The bytecode is taken over from the stack, it is the largest element and only copied once into the QtumTransaction
+        valtype code(std::move(stack.back()));
         stack.pop_back();
         uint64_t gasPrice = CScriptNum::vch_to_uint64(stack.back());
         stack.pop_back();
@@ -3104,7 +3759,7 @@ bool QtumTxConverter::parseEthTXParams(EthTransactionParams& params){
         params.version = version;
         params.gasPrice = dev::u256(gasPrice);
         params.receiveAddress = receiveAddress;
-        params.code = code;
+        params.code = std::move(code);
         params.gasLimit = dev::u256(gasLimit);
         return true;
     }
@@ -3138,11 +3793,81 @@ size_t QtumTxConverter::correctedStackSize(size_t size){
 }
 ///////////////////////////////////////////////////////////////////////
 
+/**
+ * Speculatively executes the contract transactions of a block in parallel on read-only
+ * state views opened on the parent block, while ConnectBlock executes them for real.
+ * Transactions are grouped into lanes by their target contract and every lane runs with
+ * Permanence::Reverted, so nothing is written; the only effect is that the trie nodes,
+ * code and storage the block needs are already loaded from disk when the sequential,
+ * authoritative execution reaches them. Results are never used for consensus, which keeps
+ * hashStateRoot, hashUTXORoot and the receipts identical to a purely sequential run.
+ */
+class ContractPrefetcher
+{
+public:
+    ContractPrefetcher(const CBlock& block, CBlockIndex* pindexPrev, uint64_t blockGasLimit, const dev::eth::EVMSchedule& schedule, const EVMBlockEnvironment& env, CCoinsViewCache& view, unsigned int contractflags) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+    {
+        if (nContractPrefetchThreads <= 0 || !pindexPrev)
+            return;
+
+        std::map<dev::Address, size_t> laneByContract;
+        std::vector<std::vector<QtumTransaction>> lanes;
+        size_t nContractTxs = 0;
+        for (const CTransactionRef& tx : block.vtx) {
+            if (!tx->HasCreateOrCall() || tx->HasOpSpend() || tx->IsCoinStake())
+                continue;
+            ContractTxsRef contractTxs;
+            if (!ExtractContractTxs(*tx, &view, &block.vtx, contractflags, contractTxs, true))
+                continue;
+            for (const QtumTransaction& qtx : contractTxs->first) {
+                dev::Address target = qtx.isCreation() ? dev::Address() : qtx.receiveAddress();
+                auto it = laneByContract.find(target);
+                if (it == laneByContract.end()) {
+                    it = laneByContract.emplace(target, laneByContract.size() % (size_t)nContractPrefetchThreads).first;
+                    if (it->second >= lanes.size())
+                        lanes.emplace_back();
+                }
+                lanes[it->second].push_back(qtx);
+                nContractTxs++;
+            }
+        }
+        if (nContractTxs < MIN_CONTRACT_PREFETCH_TXS || lanes.size() < 2)
+            return;
+
+        m_lanes = std::move(lanes);
+        for (size_t i = 0; i < m_lanes.size(); i++) {
+            m_views.push_back(stateViewPool.acquire(uintToh256(pindexPrev->hashStateRoot), uintToh256(pindexPrev->hashUTXORoot)));
+            m_views.back()->sealEngine().setQtumSchedule(schedule);
+        }
+        for (size_t i = 0; i < m_lanes.size(); i++) {
+            m_threads.emplace_back(&TraceThread<std::function<void()>>, "contractprefetch", std::function<void()>([this, i, &block, pindexPrev, blockGasLimit, &env] {
+                try {
+                    ByteCodeExec exec(block, m_lanes[i], blockGasLimit, pindexPrev, &m_views[i]->state(), &m_views[i]->sealEngine(), &env);
+                    exec.performByteCode(dev::eth::Permanence::Reverted);
+                } catch (const std::exception& e) {
+                    LogPrint(BCLog::BENCH, "Contract prefetch lane %u stopped: %s\n", i, e.what());
+                }
+            }));
+        }
+    }
+
+    ~ContractPrefetcher()
+    {
+        for (std::thread& thread : m_threads)
+            thread.join();
+    }
+
+private:
+    std::vector<std::vector<QtumTransaction>> m_lanes;
+    std::vector<QtumStateViewPool::Handle> m_views;
+    std::vector<std::thread> m_threads;
+};
+
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins.
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
  *  can fail if those validity checks fail (among other reasons). */
 bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex,
-                  CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck)
+                  CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck, CBlockUndo* pblockundo)
 {
     AssertLockHeld(cs_main);
     assert(pindex);
@@ -3151,7 +3876,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
     ///////////////////////////////////////////////// // qtum
     QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
-    globalSealEngine->setQtumSchedule(qtumDGP.getGasSchedule(pindex->nHeight + (pindex->nHeight+1 >= chainparams.GetConsensus().QIP7Height ? 0 : 1) ));
+    dev::eth::EVMSchedule gasSchedule = qtumDGP.getGasSchedule(pindex->nHeight + (pindex->nHeight+1 >= chainparams.GetConsensus().QIP7Height ? 0 : 1));
+    globalSealEngine->setQtumSchedule(gasSchedule);
     uint32_t sizeBlockDGP = qtumDGP.getBlockSize(pindex->nHeight + (pindex->nHeight+1 >= chainparams.GetConsensus().QIP7Height ? 0 : 1));
     uint64_t minGasPrice = qtumDGP.getMinGasPrice(pindex->nHeight + (pindex->nHeight+1 >= chainparams.GetConsensus().QIP7Height ? 0 : 1));
     uint64_t blockGasLimit = qtumDGP.getBlockGasLimit(pindex->nHeight + (pindex->nHeight+1 >= chainparams.GetConsensus().QIP7Height ? 0 : 1));
@@ -3159,6 +3885,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     updateBlockSizeParams(dgpMaxBlockSize);
     CBlock checkBlock(block.GetBlockHeader());
     std::vector<CTxOut> checkVouts;
+    const int64_t nTimeDGPParamsBlock = GetTimeMicros() - nTimeStart;
+    int64_t nTimeContractChecksBlock = 0, nTimeContractExecBlock = 0, nTimeContractResultsBlock = 0, nTimeReceiptsBlock = 0;
 
     /////////////////////////////////////////////////
     // We recheck the hardened checkpoints here since ContextualCheckBlock(Header) is not called in ConnectBlock.
@@ -3193,7 +3921,10 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     // is enforced in ContextualCheckBlockHeader(); we wouldn't want to
     // re-enforce that rule here (at least until we make it impossible for
     // GetAdjustedTime() to go backward).
-    if (!CheckBlock(block, state, chainparams.GetConsensus(), !fJustCheck, !fJustCheck)) {
+    // With script check threads, the signature of a proof-of-stake block that was not checked yet
+    // is verified on the script check queue along with the inputs
+    const bool fDeferBlockSig = nScriptCheckThreads && !block.fChecked && block.IsProofOfStake();
+    if (!CheckBlock(block, state, chainparams.GetConsensus(), !fJustCheck, !fJustCheck, !fDeferBlockSig)) {
         if (state.GetReason() == ValidationInvalidReason::BLOCK_MUTATED) {
             // We don't write down blocks to disk if they may have been
             // corrupted, so this should be impossible unless we're having hardware
@@ -3360,6 +4091,19 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     CBlockUndo blockundo;
 
     CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : nullptr);
+    if (fDeferBlockSig) {
+        if (fScriptChecks) {
+            std::vector<CScriptCheck> vBlockSigCheck(1);
+            CScriptCheck(block).swap(vBlockSigCheck.back());
+            control.Add(vBlockSigCheck);
+        } else if (!CheckBlockSignature(block)) {
+            return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): bad proof-of-stake block signature"), REJECT_INVALID, "bad-blk-signature");
+        }
+    }
+
+    // qtum: warm the state trie with a parallel speculative run of the contract transactions
+    EVMBlockEnvironment evmEnv(block, pindex->pprev, blockGasLimit);
+    ContractPrefetcher contractPrefetcher(block, pindex->pprev, blockGasLimit, gasSchedule, evmEnv, view, contractflags);
 
     std::vector<int> prevheights;
     CAmount nFees = 0;
@@ -3369,11 +4113,6 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
 
     ///////////////////////////////////////////////////////// // qtum
-#ifdef ENABLE_BITCORE_RPC
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
-    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
-#endif
     std::map<dev::Address, std::pair<CHeightTxIndexKey, std::vector<uint256>>> heightIndexes;
     /////////////////////////////////////////////////////////
 
@@ -3423,33 +4162,6 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
                 return state.Invalid(ValidationInvalidReason::CONSENSUS, error("%s: contains a non-BIP68-final transaction", __func__),
                                  REJECT_INVALID, "bad-txns-nonfinal");
             }
-
-#ifdef ENABLE_BITCORE_RPC
-            ////////////////////////////////////////////////////////////////// // qtum
-            if (fAddressIndex)
-            {
-                for (size_t j = 0; j < tx.vin.size(); j++) {
-                    const CTxIn input = tx.vin[j];
-                    const CTxOut &prevout = view.GetOutputFor(tx.vin[j]);
-
-                    CTxDestination dest;
-                    if (ExtractDestination(input.prevout, prevout.scriptPubKey, dest)) {
-                        valtype bytesID(boost::apply_visitor(DataVisitor(), dest));
-                        if(bytesID.empty()) {
-                            continue;
-                        }
-                        valtype addressBytes(32);
-                        std::copy(bytesID.begin(), bytesID.end(), addressBytes.begin());
-                        addressIndex.push_back(std::make_pair(CAddressIndexKey(dest.which(), uint256(addressBytes), pindex->nHeight, i, tx.GetHash(), j, true), prevout.nValue * -1));
-
-                        // remove address from unspent index
-                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(dest.which(), uint256(addressBytes), input.prevout.hash, input.prevout.n), CAddressUnspentValue()));
-                        spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue(tx.GetHash(), j, pindex->nHeight, prevout.nValue, dest.which(), uint256(addressBytes))));
-                    }
-                }
-            }
-            //////////////////////////////////////////////////////////////////
-#endif
         }
 
         // GetTransactionSigOpCost counts 3 types of sigops:
@@ -3473,7 +4185,9 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             std::vector<CScriptCheck> vChecks;
             bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
             //note that coinbase and coinstake can not contain any contract opcodes, this is checked in CheckBlock
-            if (fScriptChecks && !CheckInputs(tx, state, view, flags, fCacheResults, fCacheResults, txdata[i], (hasOpSpend || tx.HasCreateOrCall()) ? nullptr : (nScriptCheckThreads ? &vChecks : nullptr))) {//nScriptCheckThreads ? &vChecks : nullptr))
+            //the inputs and OP_SENDER outputs of contract calls are queued too, a failure discards the contract state of
+            //the whole block; only the OP_SPEND transactions made by the VM are checked right away
+            if (fScriptChecks && !CheckInputs(tx, state, view, flags, fCacheResults, fCacheResults, txdata[i], hasOpSpend ? nullptr : (nScriptCheckThreads ? &vChecks : nullptr))) {
                 if (state.GetReason() == ValidationInvalidReason::TX_NOT_STANDARD) {
                     // CheckInputs may return NOT_STANDARD for extra flags we passed,
                     // but we can't return that, as it's not defined for a block, so
@@ -3517,30 +4231,30 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             checkBlock.vtx.push_back(block.vtx[i]);
         }
         if(tx.HasCreateOrCall() && !hasOpSpend){
+            const int64_t nTimeChecksStart = GetTimeMicros();
 
             if(!CheckSenderScript(view, tx)){
                 return state.Invalid(ValidationInvalidReason::CONSENSUS, false, REJECT_INVALID, "bad-txns-invalid-sender-script");
             }
 
-            QtumTxConverter convert(tx, &view, &block.vtx, contractflags);
-
-            ExtractQtumTX resultConvertQtumTX;
-            if(!convert.extractionQtumTransactions(resultConvertQtumTX)){
+            ContractTxsRef contractTxs;
+            if(!ExtractContractTxs(tx, &view, &block.vtx, contractflags, contractTxs)){
                 return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Contract transaction of the wrong format"), REJECT_INVALID, "bad-tx-bad-contract-format");
             }
+            const ExtractQtumTX& resultConvertQtumTX = *contractTxs;
             if(!CheckMinGasPrice(resultConvertQtumTX.second, minGasPrice))
                 return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Contract execution has lower gas price than allowed"), REJECT_INVALID, "bad-tx-low-gas-price");
 
 
             dev::u256 gasAllTxs = dev::u256(0);
-            ByteCodeExec exec(block, resultConvertQtumTX.first, blockGasLimit, pindex->pprev);
+            ByteCodeExec exec(block, resultConvertQtumTX.first, blockGasLimit, pindex->pprev, nullptr, nullptr, &evmEnv);
             //validate VM version and other ETH params before execution
             //Reject anything unknown (could be changed later by DGP)
             //TODO evaluate if this should be relaxed for soft-fork purposes
             bool nonZeroVersion=false;
             dev::u256 sumGas = dev::u256(0);
             CAmount nTxFee = view.GetValueIn(tx)-tx.GetValueOut();
-            for(QtumTransaction& qtx : resultConvertQtumTX.first){
+            for(const QtumTransaction& qtx : resultConvertQtumTX.first){
                 sumGas += qtx.gas() * qtx.gasPrice();
 
                 if(sumGas > dev::u256(INT64_MAX)) {
@@ -3592,17 +4306,24 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
                 }
             }
 
+            const int64_t nTimeExecStart = GetTimeMicros();
+            nTimeContractChecksBlock += nTimeExecStart - nTimeChecksStart;
+
             if (!tx.IsCoinStake())
             {
                 if(!exec.performByteCode()){
                     return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Unknown error during contract execution"), REJECT_INVALID, "bad-tx-unknown-error");
                 }
+                const int64_t nTimeResultsStart = GetTimeMicros();
+                nTimeContractExecBlock += nTimeResultsStart - nTimeExecStart;
 
                 std::vector<ResultExecute> resultExec(exec.getResult());
                 ByteCodeExecResult bcer;
                 if(!exec.processingResults(bcer)){
                     return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Error processing VM execution results"), REJECT_INVALID, "bad-vm-exec-processing");
                 }
+                const int64_t nTimeReceiptsStart = GetTimeMicros();
+                nTimeContractResultsBlock += nTimeReceiptsStart - nTimeResultsStart;
 
                 std::vector<TransactionReceiptInfo> tri;
                 if (fLogEvents && !fJustCheck)
@@ -3640,6 +4361,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
                     pstorageresult->addResult(uintToh256(tx.GetHash()), tri);
                 }
+                nTimeReceiptsBlock += GetTimeMicros() - nTimeReceiptsStart;
 
                 blockGasUsed += bcer.usedGas;
                 if(blockGasUsed > blockGasLimit){
@@ -3664,32 +4386,6 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         }
 /////////////////////////////////////////////////////////////////////////////////////////
 
-#ifdef ENABLE_BITCORE_RPC
-        /////////////////////////////////////////////////////////////////////////////////// // qtum
-        if (fAddressIndex) {
-
-            for (unsigned int k = 0; k < tx.vout.size(); k++) {
-                const CTxOut &out = tx.vout[k];
-                const bool isTxCoinStake = tx.IsCoinStake();
-
-                CTxDestination dest;
-                if (ExtractDestination({tx.GetHash(), k}, out.scriptPubKey, dest)) {
-                    valtype bytesID(boost::apply_visitor(DataVisitor(), dest));
-                    if(bytesID.empty()) {
-                        continue;
-                    }
-                    valtype addressBytes(32);
-                    std::copy(bytesID.begin(), bytesID.end(), addressBytes.begin());
-                    // record receiving activity
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(dest.which(), uint256(addressBytes), pindex->nHeight, i, tx.GetHash(), k, false), out.nValue));
-                    // record unspent output
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(dest.which(), uint256(addressBytes), tx.GetHash(), k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight, isTxCoinStake)));
-                }
-            }
-        }
-        ///////////////////////////////////////////////////////////////////////////////////
-#endif
-
         CTxUndo undoDummy;
         if (i > 0) {
             blockundo.vtxundo.push_back(CTxUndo());
@@ -3703,14 +4399,19 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     {
         unsigned int i = 1;
         const CTransaction &tx = *(block.vtx[i]);
+        const int64_t nTimeChecksStart = GetTimeMicros();
         std::vector<QtumTransaction> qtumTransactions = GetDGPTransactions(block, qtumDGP, pindex->nHeight);
+        const int64_t nTimeExecStart = GetTimeMicros();
+        nTimeContractChecksBlock += nTimeExecStart - nTimeChecksStart;
         if (qtumTransactions.size() > 0)
         {
-            ByteCodeExec exec(block, qtumTransactions, blockGasLimit, pindex->pprev);
+            ByteCodeExec exec(block, qtumTransactions, blockGasLimit, pindex->pprev, nullptr, nullptr, &evmEnv);
             if (!exec.performByteCode())
             {
                 return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Unknown error during contract execution"), REJECT_INVALID, "bad-tx-unknown-error");
             }
+            const int64_t nTimeResultsStart = GetTimeMicros();
+            nTimeContractExecBlock += nTimeResultsStart - nTimeExecStart;
 
             std::vector<ResultExecute> resultExec(exec.getResult());
             ByteCodeExecResult bcer;
@@ -3718,6 +4419,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             {
                 return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Error processing VM execution results"), REJECT_INVALID, "bad-vm-exec-processing");
             }
+            const int64_t nTimeReceiptsStart = GetTimeMicros();
+            nTimeContractResultsBlock += nTimeReceiptsStart - nTimeResultsStart;
 
             std::vector<TransactionReceiptInfo> tri;
             if (fLogEvents && !fJustCheck)
@@ -3755,6 +4458,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
                 pstorageresult->addResult(uintToh256(tx.GetHash()), tri);
             }
+            nTimeReceiptsBlock += GetTimeMicros() - nTimeReceiptsStart;
 
             // insert coinstake value transfers as last contracts in block
             int nInsertAt = GetDGPValueTransferInsertLocation(checkBlock);
@@ -3777,16 +4481,23 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
     int64_t nTime3 = GetTimeMicros(); nTimeConnect += nTime3 - nTime2;
     LogPrint(BCLog::BENCH, "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs (%.2fms/blk)]\n", (unsigned)block.vtx.size(), MILLI * (nTime3 - nTime2), MILLI * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : MILLI * (nTime3 - nTime2) / (nInputs-1), nTimeConnect * MICRO, nTimeConnect * MILLI / nBlocksTotal);
+    AddBenchTime("        - DGP parameters", nTimeDGPParamsBlock, nTimeDGPParams);
+    AddBenchTime("        - Contract checks", nTimeContractChecksBlock, nTimeContractChecks);
+    AddBenchTime("        - Contract execution", nTimeContractExecBlock, nTimeContractExec);
+    AddBenchTime("        - Contract results", nTimeContractResultsBlock, nTimeContractResults);
+    AddBenchTime("        - Receipts", nTimeReceiptsBlock, nTimeReceipts);
 
     if(nFees < gasRefunds) { //make sure it won't overflow
         return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Less total fees than gas refund fees"), REJECT_INVALID, "bad-blk-fees-greater-gasrefund");
     }
     if(!CheckReward(block, state, pindex->nHeight, chainparams.GetConsensus(), nFees, gasRefunds, nActualStakeReward, checkVouts))
         return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Reward check failed"), REJECT_INVALID, "block-reward-invalid");
+    const int64_t nTimeWaitStart = GetTimeMicros();
     if (!control.Wait())
         return state.Invalid(ValidationInvalidReason::CONSENSUS, error("%s: CheckQueue failed", __func__), REJECT_INVALID, "block-validation-failed");
     int64_t nTime4 = GetTimeMicros(); nTimeVerify += nTime4 - nTime2;
     LogPrint(BCLog::BENCH, "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs (%.2fms/blk)]\n", nInputs - 1, MILLI * (nTime4 - nTime2), nInputs <= 1 ? 0 : MILLI * (nTime4 - nTime2) / (nInputs-1), nTimeVerify * MICRO, nTimeVerify * MILLI / nBlocksTotal);
+    AddBenchTime("      - Wait for script checks", nTime4 - nTimeWaitStart, nTimeScriptWait);
 
 ////////////////////////////////////////////////////////////////// // qtum
     checkBlock.hashMerkleRoot = BlockMerkleRoot(checkBlock);
@@ -3846,6 +4557,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
         return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Incorrect AAL transactions or hashes (hashStateRoot, hashUTXORoot)"), REJECT_INVALID, "incorrect-transactions-or-hashes-block");
     }
+    AddBenchTime("      - Condensing transaction checks", GetTimeMicros() - nTime4, nTimeCondensing);
 
     if (fJustCheck)
     {
@@ -3877,6 +4589,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         pindex->RaiseValidity(BLOCK_VALID_SCRIPTS);
         setDirtyBlockIndex.insert(pindex);
     }
+    const int64_t nTimeIndexesStart = GetTimeMicros();
     if (fLogEvents)
     {
         for (const auto& e: heightIndexes)
@@ -3898,43 +4611,9 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     }else{
         pblocktree->WriteStakeIndex(pindex->nHeight, uint160());
     }
+    AddBenchTime("      - Height and stake index", GetTimeMicros() - nTimeIndexesStart, nTimeChainIndexes);
 
     assert(pindex->phashBlock);
-#ifdef ENABLE_BITCORE_RPC
-    ///////////////////////////////////////////////////////////// // qtum
-    if (fAddressIndex) {
-        if (!pblocktree->WriteAddressIndex(addressIndex)) {
-            return AbortNode(state, "Failed to write address index");
-        }
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            return AbortNode(state, "Failed to write address unspent index");
-        }
-
-        if (!pblocktree->UpdateSpentIndex(spentIndex))
-            return AbortNode(state, "Failed to write transaction index");
-
-        unsigned int logicalTS = pindex->nTime;
-        unsigned int prevLogicalTS = 0;
-
-        // retrieve logical timestamp of the previous block
-        if (pindex->pprev)
-            if (!pblocktree->ReadTimestampBlockIndex(pindex->pprev->GetBlockHash(), prevLogicalTS))
-                LogPrintf("%s: Failed to read previous block's logical timestamp\n", __func__);
-
-        if (logicalTS <= prevLogicalTS) {
-            logicalTS = prevLogicalTS + 1;
-            LogPrintf("%s: Previous logical timestamp is newer Actual[%d] prevLogical[%d] Logical[%d]\n", __func__, pindex->nTime, prevLogicalTS, logicalTS);
-        }
-
-        if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(logicalTS, pindex->GetBlockHash())))
-            return AbortNode(state, "Failed to write timestamp index");
-
-        if (!pblocktree->WriteTimestampBlockIndex(CTimestampBlockIndexKey(pindex->GetBlockHash()), CTimestampBlockIndexValue(logicalTS)))
-            return AbortNode(state, "Failed to write blockhash index");
-    }
-    /////////////////////////////////////////////////////////////
-#endif
-
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
@@ -3944,8 +4623,14 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     int64_t nTime6 = GetTimeMicros(); nTimeCallbacks += nTime6 - nTime5;
     LogPrint(BCLog::BENCH, "    - Callbacks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime6 - nTime5), nTimeCallbacks * MICRO, nTimeCallbacks * MILLI / nBlocksTotal);
 
-    if (fLogEvents)
+    if (fLogEvents) {
+        const int64_t nTimeCommitStart = GetTimeMicros();
         pstorageresult->commitResults();
+        AddBenchTime("    - Receipts commit", GetTimeMicros() - nTimeCommitStart, nTimeReceiptsCommit);
+    }
+
+    if (pblockundo)
+        *pblockundo = std::move(blockundo);
 
     return true;
 }
@@ -3961,9 +4646,20 @@ bool CChainState::FlushStateToDisk(
     assert(this->CanFlushToDisk());
     static int64_t nLastWrite = 0;
     static int64_t nLastFlush = 0;
+    // Chain state the background coins write in progress brings to disk, announced once it completed
+    static CBlockLocator locatorWriting;
+    CBlockLocator locatorWritten;
     std::set<int> setFilesToPrune;
-    bool full_flush_completed = false;
     try {
+    auto WaitCoinsWrite = [&]() EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+        if (!CoinsFlushBuffer().Wait())
+            return false;
+        if (!locatorWriting.IsNull()) {
+            locatorWritten = std::move(locatorWriting);
+            locatorWriting.SetNull();
+        }
+        return true;
+    };
     {
         bool fFlushForPrune = false;
         bool fDoFullFlush = false;
@@ -3996,6 +4692,11 @@ bool CChainState::FlushStateToDisk(
         int64_t nTotalSpace = nCoinCacheUsage + std::max<int64_t>(nMempoolSizeMax - nMempoolUsage, 0);
         // The cache is large and we're within 10% and 10 MiB of the limit, but we have time now (not in the middle of a block processing).
         bool fCacheLarge = mode == FlushStateMode::PERIODIC && cacheSize > std::max((9 * nTotalSpace) / 10, nTotalSpace - MAX_BLOCK_COINSDB_USAGE * 1024 * 1024);
+        // The changes of the previous flush count against the limit until they are written, wait for them rather than go over it.
+        if (mode == FlushStateMode::IF_NEEDED && cacheSize + (int64_t)CoinsFlushBuffer().DynamicMemoryUsage() > nTotalSpace) {
+            if (!WaitCoinsWrite())
+                return AbortNode(state, "Failed to write to coin database");
+        }
         // The cache is over the limit, we have to write now.
         bool fCacheCritical = mode == FlushStateMode::IF_NEEDED && cacheSize > nTotalSpace;
         // It's been a while since we wrote the block index to disk. Do this frequently, so we don't need to redownload after a crash.
@@ -4010,6 +4711,8 @@ bool CChainState::FlushStateToDisk(
             if (!CheckDiskSpace(GetBlocksDir())) {
                 return AbortNode(state, "Disk space is too low!", _("Error: Disk space is too low!").translated, CClientUIInterface::MSG_NOPREFIX);
             }
+            // Compactions wait for the block index write, it syncs
+            DBPriorityScope priority(DB_FLUSH_MAX_DEFER);
             // First make sure all block and undo data is flushed to disk.
             FlushBlockFile();
             // Then update all block file information (which may refer to block and undo files).
@@ -4021,20 +4724,29 @@ bool CChainState::FlushStateToDisk(
                     setDirtyFileInfo.erase(it++);
                 }
                 std::vector<const CBlockIndex*> vBlocks;
+                std::vector<CBlockIndex*> vSigned;
                 vBlocks.reserve(setDirtyBlockIndex.size());
                 for (std::set<CBlockIndex*>::iterator it = setDirtyBlockIndex.begin(); it != setDirtyBlockIndex.end(); ) {
                     vBlocks.push_back(*it);
+                    if (!(*it)->vchBlockSig.empty())
+                        vSigned.push_back(*it);
                     setDirtyBlockIndex.erase(it++);
                 }
                 if (!pblocktree->WriteBatchSync(vFiles, nLastBlockFile, vBlocks)) {
                     return AbortNode(state, "Failed to write to block index database");
                 }
+                // Written signatures are read back from the block tree database by GetBlockHeader
+                for (CBlockIndex* pindex : vSigned) {
+                    std::vector<unsigned char>().swap(pindex->vchBlockSig);
+                }
             }
-            // Finally remove any pruned files
-            if (fFlushForPrune)
-                UnlinkPrunedFiles(setFilesToPrune);
             nLastWrite = nNow;
         }
+        // Write the EVM state trie nodes before the chainstate that refers to their roots, or on their own once over budget.
+        if (fDoFullFlush || QtumStateCacheUsage() > nStateCacheUsage) {
+            DBPriorityScope priority(DB_FLUSH_MAX_DEFER);
+            FlushQtumStateToDisk();
+        }
         // Flush best chain related state. This can only be done if the blocks / block index write was also done.
         if (fDoFullFlush && !CoinsTip().GetBestBlock().IsNull()) {
             // Typical Coin structures on disk are around 48 bytes in size.
@@ -4045,16 +4757,25 @@ bool CChainState::FlushStateToDisk(
             if (!CheckDiskSpace(GetDataDir(), 48 * 2 * 2 * CoinsTip().GetCacheSize())) {
                 return AbortNode(state, "Disk space is too low!", _("Error: Disk space is too low!").translated, CClientUIInterface::MSG_NOPREFIX);
             }
-            // Flush the chainstate (which may refer to block index entries).
-            if (!CoinsTip().Flush())
+            // Flush the chainstate (which may refer to block index entries). The coins are written
+            // to the database in the background, after the EVM state trie nodes above. The write
+            // before it completes first.
+            if (!WaitCoinsWrite() || !CoinsTip().Flush())
                 return AbortNode(state, "Failed to write to coin database");
+            locatorWriting = m_chain.GetLocator();
             nLastFlush = nNow;
-            full_flush_completed = true;
         }
+        // Callers forcing a flush read the coin database next, or are shutting down. Block files are
+        // only removed once the chainstate is on disk past them, a crash could not replay them.
+        if ((mode == FlushStateMode::ALWAYS || fFlushForPrune) && !WaitCoinsWrite()) {
+            return AbortNode(state, "Failed to write to coin database");
+        }
+        if (fFlushForPrune)
+            UnlinkPrunedFiles(setFilesToPrune);
     }
-    if (full_flush_completed) {
+    if (!locatorWritten.IsNull()) {
         // Update best block in wallet (so we can detect restored wallets).
-        GetMainSignals().ChainStateFlushed(m_chain.GetLocator());
+        GetMainSignals().ChainStateFlushed(locatorWritten);
     }
     } catch (const std::runtime_error& e) {
         return AbortNode(state, std::string("System error while flushing: ") + e.what());
@@ -4153,6 +4874,8 @@ void static UpdateTip(const CBlockIndex* pindexNew, const CChainParams& chainPar
 {
     // New best block
     mempool.AddTransactionsUpdated(1);
+    LastHashes::updateTip(pindexNew); // qtum
+    PublishChainTipSnapshot(pindexNew);
 
     {
         LOCK(g_best_block_mutex);
@@ -4210,7 +4933,7 @@ void static UpdateTip(const CBlockIndex* pindexNew, const CChainParams& chainPar
   * disconnectpool (note that the caller is responsible for mempool consistency
   * in any case).
   */
-bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& chainparams, DisconnectedBlockTransactions *disconnectpool)
+bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& chainparams, DisconnectedBlockTransactions *disconnectpool, DisconnectedBlockEffects* effects)
 {
     CBlockIndex *pindexDelete = m_chain.Tip();
     assert(pindexDelete);
@@ -4224,14 +4947,15 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
     {
         CCoinsViewCache view(&CoinsTip());
         assert(view.GetBestBlock() == pindexDelete->GetBlockHash());
-        if (DisconnectBlock(block, pindexDelete, view, nullptr) != DISCONNECT_OK)
+        if (DisconnectBlock(block, pindexDelete, view, nullptr, effects) != DISCONNECT_OK)
             return error("DisconnectTip(): DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
         bool flushed = view.Flush();
         assert(flushed);
+        spentCoinJournal.BlockDisconnected(pindexDelete->nHeight);
     }
     LogPrint(BCLog::BENCH, "- Disconnect block: %.2fms\n", (GetTimeMicros() - nStart) * MILLI);
-    // Write the chain state to disk, if necessary.
-    if (!FlushStateToDisk(chainparams, state, FlushStateMode::IF_NEEDED))
+    // Write the chain state to disk, if necessary. A reorg does so once WriteDisconnectedEffects wrote the rest.
+    if (!effects && !FlushStateToDisk(chainparams, state, FlushStateMode::IF_NEEDED))
         return false;
 
     if (disconnectpool) {
@@ -4248,6 +4972,7 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
     }
 
     m_chain.SetTip(pindexDelete->pprev);
+    ++g_reorg_generation;
 
     UpdateTip(pindexDelete->pprev, chainparams);
     // Let wallets know transactions went from 1-confirmed to
@@ -4256,12 +4981,182 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
     return true;
 }
 
+/**
+ * Reads the coins spent by a block that are missing from the coins cache from the database on
+ * several threads and adds them to the cache, so ConnectBlock finds every input in memory instead
+ * of missing on them one after the other. Runs under cs_main right before the block is connected,
+ * reading through the flush buffer below the cache like the cache itself, so the coins read are
+ * the ones the cache would have loaded.
+ * The contract state the block touches is warmed separately, by ContractPrefetcher.
+ */
+static void PrefetchBlockInputs(const CBlock& block, CCoinsViewCache& cache, const CCoinsView& db) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (nInputPrefetchThreads <= 0)
+        return;
+
+    // Outputs created by the block itself are not in the database yet
+    std::set<uint256> setBlockTxids;
+    std::vector<COutPoint> vMissing;
+    for (const CTransactionRef& tx : block.vtx) {
+        if (!tx->IsCoinBase()) {
+            for (const CTxIn& txin : tx->vin) {
+                if (!setBlockTxids.count(txin.prevout.hash) && !cache.HaveCoinInCache(txin.prevout))
+                    vMissing.push_back(txin.prevout);
+            }
+        }
+        setBlockTxids.insert(tx->GetHash());
+    }
+    if (vMissing.size() < MIN_INPUT_PREFETCH_COINS)
+        return;
+
+    int64_t nTimeStart = GetTimeMicros();
+    const size_t nThreads = std::min((size_t)nInputPrefetchThreads, vMissing.size() / MIN_INPUT_PREFETCH_COINS);
+    std::vector<std::vector<std::pair<COutPoint, Coin>>> vRead(nThreads);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < nThreads; i++) {
+        threads.emplace_back(&TraceThread<std::function<void()>>, "inputprefetch", std::function<void()>([i, nThreads, &vMissing, &vRead, &db] {
+            try {
+                for (size_t n = i; n < vMissing.size(); n += nThreads) {
+                    Coin coin;
+                    if (db.GetCoin(vMissing[n], coin))
+                        vRead[i].emplace_back(vMissing[n], std::move(coin));
+                }
+            } catch (const std::exception& e) {
+                // ConnectBlock reads the rest through the error catcher, which handles database errors
+                LogPrint(BCLog::BENCH, "Input prefetch lane %u stopped: %s\n", i, e.what());
+            }
+        }));
+    }
+    size_t nRead = 0;
+    for (size_t i = 0; i < nThreads; i++) {
+        threads[i].join();
+        for (auto& entry : vRead[i])
+            cache.CacheBaseCoin(entry.first, std::move(entry.second));
+        nRead += vRead[i].size();
+    }
+    LogPrint(BCLog::BENCH, "    - Prefetch %u inputs on %u threads: %.2fms\n", nRead, nThreads, (GetTimeMicros() - nTimeStart) * MILLI);
+}
+
+/** Number of blocks past the one being connected that are read from disk ahead of time */
+static const int BLOCK_READ_AHEAD = 4;
+
+/**
+ * Reads the next blocks to connect from disk on their own threads, so block N+1 is deserialized
+ * while block N executes its contracts. Requests outlive ActivateBestChainStep, which returns after
+ * every block that improves the tip; reads that were not taken are dropped once the tip passes them.
+ */
+class BlockReadAhead
+{
+public:
+    ~BlockReadAhead()
+    {
+        for (auto& entry : m_entries)
+            entry.second.thread.join();
+    }
+
+    /** Start reading the blocks after pindex on the way to pindexLast, skipping pindexLast when the caller has it */
+    void Request(const CBlockIndex* pindex, const CBlockIndex* pindexLast, bool fHaveLast, const Consensus::Params& params) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+    {
+        // Drop the reads of a branch that is not being connected any more
+        for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+            if (pindexLast->GetAncestor(it->second.nHeight) == it->second.pindex) {
+                ++it;
+                continue;
+            }
+            it->second.thread.join();
+            it = m_entries.erase(it);
+        }
+
+        int nLastHeight = std::min(pindex->nHeight + BLOCK_READ_AHEAD, pindexLast->nHeight - (fHaveLast ? 1 : 0));
+        for (int nHeight = pindex->nHeight + 1; nHeight <= nLastHeight; nHeight++) {
+            const CBlockIndex* pindexNext = pindexLast->GetAncestor(nHeight);
+            if (!(pindexNext->nStatus & BLOCK_HAVE_DATA) || m_entries.count(pindexNext->GetBlockHash()))
+                continue;
+            if (m_entries.size() >= (size_t)BLOCK_READ_AHEAD)
+                break;
+            Entry& entry = m_entries[pindexNext->GetBlockHash()];
+            entry.pindex = pindexNext;
+            entry.nHeight = nHeight;
+            entry.read = std::make_shared<Read>();
+            std::shared_ptr<Read> read = entry.read;
+            FlatFilePos pos = pindexNext->GetBlockPos();
+            entry.thread = std::thread(&TraceThread<std::function<void()>>, "blockread", std::function<void()>([read, pos, &params] {
+                read->fOk = ReadBlockFromDisk(read->block, pos, params);
+            }));
+        }
+    }
+
+    /** The block of pindex if it was read ahead, null otherwise */
+    std::shared_ptr<const CBlock> Take(const CBlockIndex* pindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+    {
+        std::shared_ptr<const CBlock> pblock;
+        for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+            if (it->second.nHeight > pindex->nHeight) {
+                ++it;
+                continue;
+            }
+            it->second.thread.join();
+            const Read& read = *it->second.read;
+            if (it->second.pindex == pindex && read.fOk && read.block.GetHash() == it->first)
+                pblock = std::shared_ptr<const CBlock>(it->second.read, &read.block);
+            it = m_entries.erase(it);
+        }
+        return pblock;
+    }
+
+private:
+    struct Read {
+        CBlock block;
+        bool fOk = false;
+    };
+    struct Entry {
+        const CBlockIndex* pindex;
+        int nHeight;
+        std::shared_ptr<Read> read;
+        std::thread thread;
+    };
+    std::map<uint256, Entry> m_entries GUARDED_BY(cs_main);
+};
+
+static BlockReadAhead blockReadAhead;
+
 static int64_t nTimeReadFromDisk = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
 static int64_t nTimePostConnect = 0;
 
+BlockConnectTimes GetBlockConnectTimes()
+{
+    AssertLockHeld(cs_main);
+    BlockConnectTimes times;
+    times.blocks = nBlocksTotal;
+    times.parts = {
+        {"load", nTimeReadFromDisk},
+        {"connect", nTimeConnectTotal},
+        {"connect.checks", nTimeCheck},
+        {"connect.checks.dgp", nTimeDGPParams},
+        {"connect.forks", nTimeForks},
+        {"connect.verify", nTimeVerify},
+        {"connect.verify.transactions", nTimeConnect},
+        {"connect.verify.transactions.contractchecks", nTimeContractChecks},
+        {"connect.verify.transactions.execution", nTimeContractExec},
+        {"connect.verify.transactions.results", nTimeContractResults},
+        {"connect.verify.transactions.receipts", nTimeReceipts},
+        {"connect.verify.scriptwait", nTimeScriptWait},
+        {"connect.index", nTimeIndex},
+        {"connect.index.condensing", nTimeCondensing},
+        {"connect.index.chainindexes", nTimeChainIndexes},
+        {"connect.callbacks", nTimeCallbacks},
+        {"connect.receiptscommit", nTimeReceiptsCommit},
+        {"flush", nTimeFlush},
+        {"chainstate", nTimeChainState},
+        {"postconnect", nTimePostConnect},
+        {"total", nTimeTotal},
+    };
+    return times;
+}
+
 struct PerBlockConnectTrace {
     CBlockIndex* pindex = nullptr;
     std::shared_ptr<const CBlock> pblock;
@@ -4335,14 +5230,12 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     assert(pindexNew->pprev == m_chain.Tip());
     // Read block from disk.
     int64_t nTime1 = GetTimeMicros();
-    std::shared_ptr<const CBlock> pthisBlock;
-    if (!pblock) {
+    std::shared_ptr<const CBlock> pthisBlock = pblock ? pblock : blockReadAhead.Take(pindexNew);
+    if (!pthisBlock) {
         std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
         if (!ReadBlockFromDisk(*pblockNew, pindexNew, chainparams.GetConsensus()))
             return AbortNode(state, "Failed to read block");
         pthisBlock = pblockNew;
-    } else {
-        pthisBlock = pblock;
     }
     const CBlock& blockConnecting = *pthisBlock;
     // Apply the block atomically to the chain state.
@@ -4350,12 +5243,14 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     int64_t nTime3;
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
     {
+        PrefetchBlockInputs(blockConnecting, CoinsTip(), CoinsFlushBuffer());
         CCoinsViewCache view(&CoinsTip());
 
         dev::h256 oldHashStateRoot(globalState->rootHash()); // qtum
         dev::h256 oldHashUTXORoot(globalState->rootHashUTXO()); // qtum
 
-        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams);
+        CBlockUndo blockundo;
+        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams, false, &blockundo);
         GetMainSignals().BlockChecked(blockConnecting, state);
         if (!rv) {
             if (state.IsInvalid())
@@ -4370,6 +5265,7 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
         LogPrint(BCLog::BENCH, "  - Connect total: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime3 - nTime2) * MILLI, nTimeConnectTotal * MICRO, nTimeConnectTotal * MILLI / nBlocksTotal);
         bool flushed = view.Flush();
         assert(flushed);
+        spentCoinJournal.BlockConnected(blockConnecting, blockundo, pindexNew->nHeight);
     }
     int64_t nTime4 = GetTimeMicros(); nTimeFlush += nTime4 - nTime3;
     LogPrint(BCLog::BENCH, "  - Flush: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime4 - nTime3) * MILLI, nTimeFlush * MICRO, nTimeFlush * MILLI / nBlocksTotal);
@@ -4384,6 +5280,8 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     // Update m_chain & related variables.
     m_chain.SetTip(pindexNew);
     UpdateTip(pindexNew, chainparams);
+    SetCallContractTemplate(blockConnecting, pindexNew); // qtum
+    g_recent_blocks.Add(pthisBlock);
 
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
     LogPrint(BCLog::BENCH, "  - Connect postprocess: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime5) * MILLI, nTimePostConnect * MICRO, nTimePostConnect * MILLI / nBlocksTotal);
@@ -4470,6 +5368,26 @@ void CChainState::PruneBlockIndexCandidates() {
  *
  * @returns true unless a system error occurred
  */
+bool CChainState::WriteDisconnectedEffects(CValidationState& state, const CChainParams& chainparams, DisconnectedBlockEffects& effects)
+{
+    AssertLockHeld(cs_main);
+    if (!effects.pindexFork)
+        return true;
+
+    int64_t nStart = GetTimeMicros();
+    globalState->setRoot(uintToh256(effects.pindexFork->hashStateRoot)); // qtum
+    globalState->setRootUTXO(uintToh256(effects.pindexFork->hashUTXORoot)); // qtum
+    if (fLogEvents)
+        pstorageresult->deleteResults(effects.vtxResults);
+    bool fOk = pblocktree->EraseBlockRange(effects.pindexFork->nHeight + 1, effects.nHighest, fLogEvents);
+    LogPrint(BCLog::BENCH, "- Write effects of %u disconnected blocks: %.2fms\n", effects.nHighest - effects.pindexFork->nHeight, (GetTimeMicros() - nStart) * MILLI);
+    effects = DisconnectedBlockEffects();
+    if (!fOk)
+        return AbortNode(state, "Failed to erase the index entries of the disconnected blocks");
+
+    return FlushStateToDisk(chainparams, state, FlushStateMode::IF_NEEDED);
+}
+
 bool CChainState::ActivateBestChainStep(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexMostWork, const std::shared_ptr<const CBlock>& pblock, bool& fInvalidFound, ConnectTrace& connectTrace)
 {
     AssertLockHeld(cs_main);
@@ -4478,10 +5396,19 @@ bool CChainState::ActivateBestChainStep(CValidationState& state, const CChainPar
     const CBlockIndex *pindexFork = m_chain.FindFork(pindexMostWork);
 
     // Disconnect active blocks which are no longer in the best chain.
+    // Their effects past the coins are written together once the last is disconnected.
     bool fBlocksDisconnected = false;
     DisconnectedBlockTransactions disconnectpool;
+    DisconnectedBlockEffects disconnectedEffects;
     while (m_chain.Tip() && m_chain.Tip() != pindexFork) {
-        if (!DisconnectTip(state, chainparams, &disconnectpool)) {
+        // Read the undo data of the next blocks to disconnect while this one is
+        const CBlockIndex* pindexAhead = m_chain.Tip()->pprev;
+        for (int i = 0; i < UNDO_READ_AHEAD && pindexAhead && pindexAhead != pindexFork; i++, pindexAhead = pindexAhead->pprev)
+            PrefetchUndo(pindexAhead);
+        if (!DisconnectTip(state, chainparams, &disconnectpool, &disconnectedEffects)) {
+            // Bring the contract state and the indexes to the blocks that were disconnected
+            CValidationState stateWrite;
+            WriteDisconnectedEffects(stateWrite, chainparams, disconnectedEffects);
             // This is likely a fatal error, but keep the mempool consistent,
             // just in case. Only remove from the mempool in this case.
             UpdateMempoolForReorg(disconnectpool, false);
@@ -4494,6 +5421,10 @@ bool CChainState::ActivateBestChainStep(CValidationState& state, const CChainPar
         }
         fBlocksDisconnected = true;
     }
+    if (!WriteDisconnectedEffects(state, chainparams, disconnectedEffects)) {
+        UpdateMempoolForReorg(disconnectpool, false);
+        return false;
+    }
 
     // Build list of new blocks to connect.
     std::vector<CBlockIndex*> vpindexToConnect;
@@ -4514,6 +5445,7 @@ bool CChainState::ActivateBestChainStep(CValidationState& state, const CChainPar
 
         // Connect new blocks.
         for (CBlockIndex *pindexConnect : reverse_iterate(vpindexToConnect)) {
+            blockReadAhead.Request(pindexConnect, pindexMostWork, pblock != nullptr, chainparams.GetConsensus());
             if (!ConnectTip(state, chainparams, pindexConnect, pindexConnect == pindexMostWork ? pblock : std::shared_ptr<const CBlock>(), connectTrace, disconnectpool)) {
                 if (state.IsInvalid()) {
                     // The block violates a consensus rule.
@@ -4583,7 +5515,9 @@ static bool NotifyHeaderTip() LOCKS_EXCLUDED(cs_main) {
 static void LimitValidationInterfaceQueue() LOCKS_EXCLUDED(cs_main) {
     AssertLockNotHeld(cs_main);
 
-    if (GetMainSignals().CallbacksPending() > 10) {
+    // The subscribers with queues of their own hold on to every block handed to them, so a slow
+    // one has to hold up block connection too once it falls far enough behind
+    if (GetMainSignals().CallbacksPending() > 10 || GetMainSignals().MaxSubscriberCallbacksPending() > MAX_SUBSCRIBER_CALLBACKS_PENDING) {
         SyncWithValidationInterfaceQueue();
     }
 }
@@ -4918,6 +5852,8 @@ CBlockIndex* BlockManager::AddToBlockIndex(const CBlockHeader& block)
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
     pindexNew->nSequenceId = 0;
+    // readers without cs_main only find the entry once it is linked to its parent
+    LOCK(m_lookup_mutex);
     BlockMap::iterator mi = m_block_index.insert(std::make_pair(hash, pindexNew)).first;
     if (pindexNew->IsProofOfStake())
         ::ChainstateActive().setStakeSeen.insert(std::make_pair(pindexNew->prevoutStake, pindexNew->nTime));
@@ -5101,7 +6037,7 @@ bool SignBlock(std::shared_ptr<CBlock> pblock, CWallet& wallet, const CAmount& n
     //IsProtocolV2 mean POS 2 or higher, so the modified line is:
     auto locked_chain = wallet.chain().lock();
     LOCK(wallet.cs_wallet);
-    if (wallet.CreateCoinStake(*locked_chain, wallet, pblock->nBits, nTotalFees, nTimeBlock, txCoinStake, key, setCoins))
+    if (wallet.CreateCoinStake(*locked_chain, pblock->nBits, nTotalFees, nTimeBlock, txCoinStake, key, setCoins))
     {
         if (nTimeBlock >= ::ChainActive().Tip()->GetMedianTimePast()+1)
         {
@@ -5322,7 +6258,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
     if (nSigOps * WITNESS_SCALE_FACTOR > dgpMaxBlockSigOps)
         return state.Invalid(ValidationInvalidReason::CONSENSUS, false, REJECT_INVALID, "bad-blk-sigops", "out-of-bounds SigOpCount");
 
-    if (fCheckPOW && fCheckMerkleRoot)
+    if (fCheckPOW && fCheckMerkleRoot && fCheckSig)
         block.fChecked = true;
 
     return true;
@@ -5718,6 +6654,18 @@ bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidatio
 
     {
         LOCK(cs_main);
+
+        // The PoS headers below are checked one at a time, recover the signers of the new ones in parallel first
+        if (!::ChainstateActive().IsInitialBlockDownload()) {
+            const CBlockIndex* pindexPrev = headers.empty() ? nullptr : LookupBlockIndex(headers[0].hashPrevBlock);
+            std::vector<const CBlockHeader*> vHeadersPoS;
+            for (size_t i = 0; pindexPrev && i < headers.size(); ++i) {
+                if (headers[i].IsProofOfStake() && pindexPrev->nHeight + (int)i >= chainparams.GetConsensus().nEnableHeaderSignatureHeight && !::BlockIndex().count(headers[i].GetHash()))
+                    vHeadersPoS.push_back(&headers[i]);
+            }
+            PrecheckBlockSignatures(vHeadersPoS, ::ChainstateActive().CoinsTip(), nScriptCheckThreads);
+        }
+
         bool bFirst = true;
         bool fInstantBan = false;
         for (size_t i = 0; i < headers.size(); ++i) {
@@ -6064,10 +7012,65 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
         FlatFilePos pos(*it, 0);
         fs::remove(BlockFileSeq().FileName(pos));
         fs::remove(UndoFileSeq().FileName(pos));
+        fs::remove(BlockFileSeq().ArchiveName(pos));
+        fs::remove(UndoFileSeq().ArchiveName(pos));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
     }
 }
 
+/** Receipts below this height were deleted by -logeventsprune, -1 until read from the block tree */
+static int nReceiptPruneHeight = -1;
+
+/** Blocks read for their transaction hashes before their receipts are deleted in one batch */
+static const int RECEIPT_PRUNE_BATCH = 1000;
+
+/**
+ * Delete the receipts and height index entries of the blocks more than nLogEventsPrune deep, and of
+ * all blocks in the block files about to be pruned, since their receipts could not be found anymore.
+ * Must run before PruneOneBlockFile forgets where the blocks are.
+ */
+static void PruneReceipts(const std::set<int>& setFilesToPrune) EXCLUSIVE_LOCKS_REQUIRED(cs_main, cs_LastBlockFile)
+{
+    if (!fLogEvents || nLogEventsPrune == 0 || ::ChainActive().Tip() == nullptr)
+        return;
+
+    int nPruneHeight = ::ChainActive().Tip()->nHeight - (int)nLogEventsPrune;
+    for (int fileNumber : setFilesToPrune) {
+        nPruneHeight = std::max(nPruneHeight, (int)vinfoBlockFile[fileNumber].nHeightLast);
+    }
+    if (nReceiptPruneHeight < 0 && !pblocktree->ReadReceiptPruneHeight(nReceiptPruneHeight)) {
+        nReceiptPruneHeight = 0;
+    }
+    if (nPruneHeight <= nReceiptPruneHeight)
+        return;
+
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    int nHeight = nReceiptPruneHeight + 1;
+    int count = 0;
+    while (nHeight <= nPruneHeight) {
+        std::vector<CTransactionRef> txs;
+        int nBatchEnd = std::min(nPruneHeight, nHeight + RECEIPT_PRUNE_BATCH - 1);
+        for (; nHeight <= nBatchEnd; nHeight++) {
+            const CBlockIndex* pindex = ::ChainActive()[nHeight];
+            CBlock block;
+            // blocks pruned before -logeventsprune was enabled keep their receipts
+            if (!(pindex->nStatus & BLOCK_HAVE_DATA) || !ReadBlockFromDisk(block, pindex, consensusParams))
+                continue;
+            for (const CTransactionRef& tx : block.vtx) {
+                if (tx->HasCreateOrCall() || tx->IsCoinStake())
+                    txs.push_back(tx);
+            }
+        }
+        count += txs.size();
+        pstorageresult->deleteResults(txs);
+    }
+    pblocktree->PruneHeightIndex(nPruneHeight);
+    pstorageresult->compactResults();
+    nReceiptPruneHeight = nPruneHeight;
+    pblocktree->WriteReceiptPruneHeight(nReceiptPruneHeight);
+    LogPrint(BCLog::PRUNE, "Prune: deleted receipts of %d transactions up to height %d\n", count, nReceiptPruneHeight);
+}
+
 /* Calculate the block/rev files to delete based on height specified by user with RPC command pruneblockchain */
 static void FindFilesToPruneManual(std::set<int>& setFilesToPrune, int nManualPruneHeight)
 {
@@ -6083,10 +7086,13 @@ static void FindFilesToPruneManual(std::set<int>& setFilesToPrune, int nManualPr
     for (int fileNumber = 0; fileNumber < nLastBlockFile; fileNumber++) {
         if (vinfoBlockFile[fileNumber].nSize == 0 || vinfoBlockFile[fileNumber].nHeightLast > nLastBlockWeCanPrune)
             continue;
-        PruneOneBlockFile(fileNumber);
         setFilesToPrune.insert(fileNumber);
         count++;
     }
+    PruneReceipts(setFilesToPrune);
+    for (int fileNumber : setFilesToPrune) {
+        PruneOneBlockFile(fileNumber);
+    }
     LogPrintf("Prune (Manual): prune_height=%d removed %d blk/rev pairs\n", nLastBlockWeCanPrune, count);
 }
 
@@ -6158,13 +7164,17 @@ static void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfte
             if (vinfoBlockFile[fileNumber].nHeightLast > nLastBlockWeCanPrune)
                 continue;
 
-            PruneOneBlockFile(fileNumber);
             // Queue up the files for removal
             setFilesToPrune.insert(fileNumber);
             nCurrentUsage -= nBytesToPrune;
             count++;
         }
     }
+    // the receipts are found through the blocks, so they go before the block files
+    PruneReceipts(setFilesToPrune);
+    for (int fileNumber : setFilesToPrune) {
+        PruneOneBlockFile(fileNumber);
+    }
 
     LogPrint(BCLog::PRUNE, "Prune: target=%dMiB actual=%dMiB diff=%dMiB max_prune_height=%d removed %d blk/rev pairs\n",
            nPruneTarget/1024/1024, nCurrentUsage/1024/1024,
@@ -6183,6 +7193,9 @@ static FlatFileSeq UndoFileSeq()
 }
 
 FILE* OpenBlockFile(const FlatFilePos &pos, bool fReadOnly) {
+    if (fReadOnly && pos.nPos >= 8) {
+        return OpenFileRecord(BlockFileSeq(), pos, 0);
+    }
     return BlockFileSeq().Open(pos, fReadOnly);
 }
 
@@ -6191,11 +7204,95 @@ static FILE* OpenUndoFile(const FlatFilePos &pos, bool fReadOnly) {
     return UndoFileSeq().Open(pos, fReadOnly);
 }
 
+/**
+ * Open a block or undo file for reading the record at pos, which follows the message start
+ * and its size. Of an archived file only the frames holding the record and the trailer bytes
+ * after it are decompressed. With header set the handle is at the message start.
+ */
+static FILE* OpenFileRecord(FlatFileSeq seq, const FlatFilePos& pos, size_t trailer, bool header)
+{
+    const FlatFilePos hpos(pos.nFile, pos.nPos - 8);
+    if (pos.nPos < 8 || !seq.IsArchived(pos)) {
+        return seq.Open(header ? hpos : pos, true);
+    }
+    unsigned int size;
+    {
+        CAutoFile file(seq.Open(FlatFilePos(pos.nFile, pos.nPos - 4), true, 4), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull()) {
+            return nullptr;
+        }
+        try {
+            file >> size;
+        } catch (const std::exception& e) {
+            LogPrintf("%s: cannot read the record size at %s: %s\n", __func__, pos.ToString(), e.what());
+            return nullptr;
+        }
+    }
+    return header ? seq.Open(hpos, true, 8 + (size_t)size + trailer) : seq.Open(pos, true, (size_t)size + trailer);
+}
+
 fs::path GetBlockPosFilename(const FlatFilePos &pos)
 {
     return BlockFileSeq().FileName(pos);
 }
 
+bool IsBlockFileArchived(const FlatFilePos &pos)
+{
+    return BlockFileSeq().IsArchived(pos);
+}
+
+/** Archive one block or undo file of blocks more than depth deep, false when none was */
+static bool ArchiveBlockFiles(int depth)
+{
+    if (fImporting || fReindex) return false;
+
+    std::vector<int> candidates;
+    {
+        LOCK2(cs_main, cs_LastBlockFile);
+        const CBlockIndex* tip = ::ChainActive().Tip();
+        if (!tip) return false;
+        // The file blocks are written to, and the undo data of its blocks, stays hot
+        for (int n = 0; n < nLastBlockFile; n++) {
+            if (vinfoBlockFile[n].nBlocks > 0 && (int)vinfoBlockFile[n].nHeightLast < tip->nHeight - depth) {
+                candidates.push_back(n);
+            }
+        }
+    }
+
+    for (int n : candidates) {
+        const FlatFilePos pos(n, 0);
+        for (FlatFileSeq seq : {BlockFileSeq(), UndoFileSeq()}) {
+            if (fs::exists(seq.FileName(pos))) {
+                return seq.Archive(pos);
+            }
+        }
+        if (ShutdownRequested()) break;
+    }
+    return false;
+}
+
+void ThreadArchiveBlockFiles(int depth)
+{
+    LogPrintf("Archiving the block and undo files of blocks more than %d deep\n", depth);
+    while (true) {
+        MilliSleep(BLOCK_ARCHIVE_INTERVAL * 1000);
+        while (!ShutdownRequested() && ArchiveBlockFiles(depth)) {
+            boost::this_thread::interruption_point();
+        }
+    }
+}
+
+void DeleteArchivedUndoFiles()
+{
+    for (int n = 0; fs::exists(BlockFileSeq().FileName(FlatFilePos(n, 0))) || BlockFileSeq().IsArchived(FlatFilePos(n, 0)); n++) {
+        const FlatFilePos pos(n, 0);
+        if (UndoFileSeq().IsArchived(pos)) {
+            LogPrintf("Deleting archived undo file %s, the reindex writes it again\n", UndoFileSeq().ArchiveName(pos).filename().string());
+            fs::remove(UndoFileSeq().ArchiveName(pos));
+        }
+    }
+}
+
 CBlockIndex * BlockManager::InsertBlockIndex(const uint256& hash)
 {
     AssertLockHeld(cs_main);
@@ -6210,6 +7307,7 @@ CBlockIndex * BlockManager::InsertBlockIndex(const uint256& hash)
 
     // Create new
     CBlockIndex* pindexNew = new CBlockIndex();
+    LOCK(m_lookup_mutex);
     mi = m_block_index.insert(std::make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
@@ -6275,6 +7373,7 @@ void BlockManager::Unload() {
     m_failed_blocks.clear();
     m_blocks_unlinked.clear();
 
+    LOCK(m_lookup_mutex);
     for (const BlockMap::value_type& entry : m_block_index) {
         delete entry.second;
     }
@@ -6282,6 +7381,14 @@ void BlockManager::Unload() {
     m_block_index.clear();
 }
 
+CBlockIndex* BlockManager::LookupShared(const uint256& hash) const
+{
+    // m_block_index only changes with m_lookup_mutex held besides cs_main
+    LOCK(m_lookup_mutex);
+    BlockMap::const_iterator it = m_block_index.find(hash);
+    return it == m_block_index.end() ? nullptr : it->second;
+}
+
 bool static LoadBlockIndexDB(const CChainParams& chainparams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     if (!g_blockman.LoadBlockIndex(
@@ -6318,6 +7425,9 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams) EXCLUSIVE_LOCKS_RE
     for (std::set<int>::iterator it = setBlkDataFiles.begin(); it != setBlkDataFiles.end(); it++)
     {
         FlatFilePos pos(*it, 0);
+        if (BlockFileSeq().IsArchived(pos)) {
+            continue;
+        }
         if (CAutoFile(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION).IsNull()) {
             return false;
         }
@@ -6333,12 +7443,6 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams) EXCLUSIVE_LOCKS_RE
     pblocktree->ReadReindexing(fReindexing);
     if(fReindexing) fReindex = true;
 
-#ifdef ENABLE_BITCORE_RPC
-    ///////////////////////////////////////////////////////////// // qtum
-    pblocktree->ReadFlag("addrindex", fAddressIndex);
-    LogPrintf("LoadBlockIndexDB(): address index %s\n", fAddressIndex ? "enabled" : "disabled");
-    /////////////////////////////////////////////////////////////
-#endif
     // Check whether we have a transaction index
     pblocktree->ReadFlag("logevents", fLogEvents);
     LogPrintf("%s: log events index %s\n", __func__, fLogEvents ? "enabled" : "disabled");
@@ -6364,6 +7468,7 @@ bool CChainState::LoadChainTip(const CChainParams& chainparams)
     }
     m_chain.SetTip(pindex);
     PruneBlockIndexCandidates();
+    PublishChainTipSnapshot(pindex);
 
     tip = m_chain.Tip();
     LogPrintf("Loaded best chain: hashBestChain=%s height=%d date=%s progress=%f\n",
@@ -6384,6 +7489,68 @@ CVerifyDB::~CVerifyDB()
     uiInterface.ShowProgress("", 100, false);
 }
 
+/** Most blocks VerifyDB reads and checks at once, their undo data fits the undo cache for level 3 */
+static const size_t VERIFY_BATCH_BLOCKS = UNDO_CACHE_BLOCKS;
+
+/** A block checked at levels 0 to 2 of VerifyDB, with the block index fields copied under cs_main */
+struct VerifyRead {
+    CBlockIndex* pindex;
+    FlatFilePos pos;
+    FlatFilePos undoPos;
+    uint256 hash;
+    uint256 hashPrevBlock;
+    CBlock block;
+    //! Empty when the checks passed
+    std::string strError;
+
+    explicit VerifyRead(CBlockIndex* pindexIn) : pindex(pindexIn), pos(pindexIn->GetBlockPos()), undoPos(pindexIn->GetUndoPos()),
+        hash(pindexIn->GetBlockHash()), hashPrevBlock(pindexIn->pprev->GetBlockHash()) {}
+};
+
+/**
+ * Levels 0 to 2 of VerifyDB for every block of vRead, which neither depend on the other blocks
+ * nor on the coins, on up to -par threads. The undo data read is kept in the undo cache for the
+ * level 3 disconnect that follows.
+ */
+static void VerifyBlocksData(std::vector<VerifyRead>& vRead, int nCheckLevel, const Consensus::Params& params)
+{
+    std::atomic<size_t> nNext{0};
+    auto check = [&vRead, &nNext, nCheckLevel, &params] {
+        for (size_t i = nNext++; i < vRead.size(); i = nNext++) {
+            VerifyRead& read = vRead[i];
+            // check level 0: read from disk
+            if (!ReadBlockFromDisk(read.block, read.pos, params) || read.block.GetHash() != read.hash) {
+                read.strError = strprintf("ReadBlockFromDisk failed at %d, hash=%s", read.pindex->nHeight, read.hash.ToString());
+                continue;
+            }
+            // check level 1: verify block validity
+            CValidationState state;
+            if (nCheckLevel >= 1 && !CheckBlock(read.block, state, params, false)) {
+                read.strError = strprintf("found bad block at %d, hash=%s (%s)", read.pindex->nHeight, read.hash.ToString(), FormatStateMessage(state));
+                continue;
+            }
+            // check level 2: verify undo validity
+            if (nCheckLevel >= 2 && !read.undoPos.IsNull()) {
+                CBlockUndo undo;
+                if (!UndoReadFromDisk(undo, read.undoPos, read.hashPrevBlock)) {
+                    read.strError = strprintf("found bad undo data at %d, hash=%s", read.pindex->nHeight, read.hash.ToString());
+                    continue;
+                }
+                if (nCheckLevel >= 3)
+                    undoCache.Add(read.hash, undo);
+            }
+        }
+    };
+
+    const size_t nThreads = std::min((size_t)std::max(1, nScriptCheckThreads), vRead.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < nThreads; i++)
+        threads.emplace_back(&TraceThread<std::function<void()>>, "verifydb", std::function<void()>(check));
+    check();
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
 bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview, int nCheckLevel, int nCheckDepth)
 {
     LOCK(cs_main);
@@ -6409,63 +7576,72 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
 //////////////////////////////////////////////////////////////////////////
 
     LogPrintf("[0%%]..."); /* Continued */
-    for (pindex = ::ChainActive().Tip(); pindex && pindex->pprev; pindex = pindex->pprev) {
-        boost::this_thread::interruption_point();
-        const int percentageDone = std::max(1, std::min(99, (int)(((double)(::ChainActive().Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100))));
-        if (reportDone < percentageDone/10) {
-            // report every 10% step
-            LogPrintf("[%d%%]...", percentageDone); /* Continued */
-            reportDone = percentageDone/10;
-        }
-        uiInterface.ShowProgress(_("Verifying blocks...").translated, percentageDone, false);
-        if (pindex->nHeight <= ::ChainActive().Height()-nCheckDepth)
-            break;
-        if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
-            // If pruning, only go back as far as we have data.
-            LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
-            break;
+    pindex = ::ChainActive().Tip();
+    bool fDone = false;
+    while (!fDone) {
+        // Collect the next blocks to check that share a DGP block size, CheckBlock reads it from the globals
+        std::vector<VerifyRead> vRead;
+        uint32_t nBatchBlockSize = 0;
+        uint32_t nBlockSize = dgpMaxBlockSize;
+        for (; pindex && pindex->pprev; pindex = pindex->pprev) {
+            if (pindex->nHeight <= ::ChainActive().Height()-nCheckDepth) {
+                fDone = true;
+                break;
+            }
+            if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
+                // If pruning, only go back as far as we have data.
+                LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
+                fDone = true;
+                break;
+            }
+            ///////////////////////////////////////////////////////////////// // qtum
+            uint32_t sizeBlockDGP = qtumDGP.getBlockSize(pindex->nHeight);
+            nBlockSize = sizeBlockDGP ? sizeBlockDGP : nBlockSize;
+            /////////////////////////////////////////////////////////////////
+            if (vRead.size() >= VERIFY_BATCH_BLOCKS || (!vRead.empty() && nBlockSize != nBatchBlockSize))
+                break;
+            nBatchBlockSize = nBlockSize;
+            vRead.emplace_back(pindex);
         }
+        if (!pindex || !pindex->pprev)
+            fDone = true;
+        if (vRead.empty())
+            break;
 
-        ///////////////////////////////////////////////////////////////////// // qtum
-        uint32_t sizeBlockDGP = qtumDGP.getBlockSize(pindex->nHeight);
-        dgpMaxBlockSize = sizeBlockDGP ? sizeBlockDGP : dgpMaxBlockSize;
+        dgpMaxBlockSize = nBatchBlockSize;
         updateBlockSizeParams(dgpMaxBlockSize);
-        /////////////////////////////////////////////////////////////////////
+        VerifyBlocksData(vRead, nCheckLevel, chainparams.GetConsensus());
 
-        CBlock block;
-        // check level 0: read from disk
-        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
-            return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-        // check level 1: verify block validity
-        if (nCheckLevel >= 1 && !CheckBlock(block, state, chainparams.GetConsensus(),false))
-            return error("%s: *** found bad block at %d, hash=%s (%s)\n", __func__,
-                         pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
-        // check level 2: verify undo validity
-        if (nCheckLevel >= 2 && pindex) {
-            CBlockUndo undo;
-            if (!pindex->GetUndoPos().IsNull()) {
-                if (!UndoReadFromDisk(undo, pindex)) {
-                    return error("VerifyDB(): *** found bad undo data at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
-                }
-            }
-        }
-        // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
-        if (nCheckLevel >= 3 && (coins.DynamicMemoryUsage() + ::ChainstateActive().CoinsTip().DynamicMemoryUsage()) <= nCoinCacheUsage) {
-            assert(coins.GetBestBlock() == pindex->GetBlockHash());
-            bool fClean=true;
-            DisconnectResult res = ::ChainstateActive().DisconnectBlock(block, pindex, coins, &fClean);
-            if (res == DISCONNECT_FAILED) {
-                return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+        for (VerifyRead& read : vRead) {
+            boost::this_thread::interruption_point();
+            const int percentageDone = std::max(1, std::min(99, (int)(((double)(::ChainActive().Height() - read.pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100))));
+            if (reportDone < percentageDone/10) {
+                // report every 10% step
+                LogPrintf("[%d%%]...", percentageDone); /* Continued */
+                reportDone = percentageDone/10;
             }
-            if (res == DISCONNECT_UNCLEAN) {
-                nGoodTransactions = 0;
-                pindexFailure = pindex;
-            } else {
-                nGoodTransactions += block.vtx.size();
+            uiInterface.ShowProgress(_("Verifying blocks...").translated, percentageDone, false);
+            // check levels 0 to 2: read from disk, verify block validity and undo validity
+            if (!read.strError.empty())
+                return error("VerifyDB(): *** %s", read.strError);
+            // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
+            if (nCheckLevel >= 3 && (coins.DynamicMemoryUsage() + ::ChainstateActive().CoinsTip().DynamicMemoryUsage()) <= nCoinCacheUsage) {
+                assert(coins.GetBestBlock() == read.pindex->GetBlockHash());
+                bool fClean=true;
+                DisconnectResult res = ::ChainstateActive().DisconnectBlock(read.block, read.pindex, coins, &fClean);
+                if (res == DISCONNECT_FAILED) {
+                    return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", read.pindex->nHeight, read.pindex->GetBlockHash().ToString());
+                }
+                if (res == DISCONNECT_UNCLEAN) {
+                    nGoodTransactions = 0;
+                    pindexFailure = read.pindex;
+                } else {
+                    nGoodTransactions += read.block.vtx.size();
+                }
             }
+            if (ShutdownRequested())
+                return true;
         }
-        if (ShutdownRequested())
-            return true;
     }
     if (pindexFailure)
         return error("VerifyDB(): *** coin database inconsistencies found (last %i blocks, %i good transactions before that)\n", ::ChainActive().Height() - pindexFailure->nHeight + 1, nGoodTransactions);
@@ -6511,6 +7687,66 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
     return true;
 }
 
+/** Pause between the blocks -checkblocksample reads, keeping its disk reads out of the way of validation */
+static const int64_t CHECK_SAMPLE_INTERVAL_MS = 100;
+
+void ThreadCheckBlockSample(int nBlocks)
+{
+    // Reindexing and importing rewrite the files being sampled
+    while (fReindex || fImporting)
+        MilliSleep(1000);
+
+    const Consensus::Params& params = Params().GetConsensus();
+    FastRandomContext rng;
+    int nChecked = 0;
+    LogPrintf("Checking %d random blocks in the background\n", nBlocks);
+    for (int i = 0; i < nBlocks; i++) {
+        MilliSleep(CHECK_SAMPLE_INTERVAL_MS);
+
+        const CBlockIndex* pindex;
+        FlatFilePos pos, undoPos;
+        uint256 hashPrevBlock;
+        {
+            LOCK(cs_main);
+            if (::ChainActive().Height() < 1)
+                break;
+            pindex = ::ChainActive()[1 + rng.randrange(::ChainActive().Height())];
+            if (!(pindex->nStatus & BLOCK_HAVE_DATA))
+                continue;
+            pos = pindex->GetBlockPos();
+            undoPos = pindex->GetUndoPos();
+            hashPrevBlock = pindex->pprev->GetBlockHash();
+        }
+
+        std::string strError;
+        CBlock block;
+        bool mutated;
+        if (!ReadBlockFromDisk(block, pos, params) || block.GetHash() != pindex->GetBlockHash()) {
+            strError = "ReadBlockFromDisk failed";
+        } else if (BlockMerkleRoot(block, &mutated) != block.hashMerkleRoot || mutated) {
+            strError = "hashMerkleRoot mismatch";
+        } else if (!undoPos.IsNull()) {
+            CBlockUndo undo;
+            if (!UndoReadFromDisk(undo, undoPos, hashPrevBlock) || undo.vtxundo.size() + 1 != block.vtx.size())
+                strError = "bad undo data";
+        }
+        if (!strError.empty()) {
+            {
+                // The files of the block may have been pruned while it was read
+                LOCK(cs_main);
+                if (!(pindex->nStatus & BLOCK_HAVE_DATA))
+                    continue;
+            }
+            LogPrintf("ERROR: %s: %s at %d, hash=%s\n", __func__, strError, pindex->nHeight, pindex->GetBlockHash().ToString());
+            SetMiscWarning(strprintf(_("Warning: Block %s failed the background check of the block files (%s). Your block files may be corrupted, restart with -reindex.").translated,
+                                     pindex->GetBlockHash().ToString(), strError));
+            return;
+        }
+        nChecked++;
+    }
+    LogPrintf("Checked %d random blocks in the background, no corruption found\n", nChecked);
+}
+
 /** Apply the effects of a block on the utxo cache, ignoring that it may already have been applied. */
 bool CChainState::RollforwardBlock(const CBlockIndex* pindex, CCoinsViewCache& inputs, const CChainParams& params)
 {
@@ -6761,6 +7997,7 @@ void UnloadBlockIndex()
 {
     LOCK(cs_main);
     ::ChainActive().SetTip(nullptr);
+    PublishChainTipSnapshot(nullptr);
     g_blockman.Unload();
     pindexBestInvalid = nullptr;
     pindexBestHeader = nullptr;
@@ -6799,12 +8036,7 @@ bool LoadBlockIndex(const CChainParams& chainparams)
         // Use the provided setting for -logevents in the new database
         fLogEvents = gArgs.GetBoolArg("-logevents", DEFAULT_LOGEVENTS);
         pblocktree->WriteFlag("logevents", fLogEvents);
-#ifdef ENABLE_BITCORE_RPC
-        /////////////////////////////////////////////////////////////// // qtum
-        fAddressIndex = gArgs.GetBoolArg("-addrindex", DEFAULT_ADDRINDEX);
-        pblocktree->WriteFlag("addrindex", fAddressIndex);
-        ///////////////////////////////////////////////////////////////
-#endif
+        pblocktree->WriteFlag("receiptbackfill", false);
     }
     return true;
 }
@@ -6840,35 +8072,93 @@ bool LoadGenesisBlock(const CChainParams& chainparams)
     return ::ChainstateActive().LoadGenesisBlock(chainparams);
 }
 
-bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, FlatFilePos *dbp)
+namespace {
+/** Blocks LoadExternalBlockFile keeps deserialized ahead of the one it is accepting */
+static const size_t SCAN_AHEAD_BLOCKS = 32;
+
+/**
+ * Finds, deserializes and hashes the blocks of a block file on its own thread, so that
+ * LoadExternalBlockFile accepts and connects a block while the following ones are read.
+ * Blocks come out in file order, which the handling of out of order blocks relies on.
+ */
+class BlockFileScanner
 {
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, FlatFilePos> mapBlocksUnknownParent;
-    int64_t nStart = GetTimeMillis();
+public:
+    struct ScannedBlock {
+        uint64_t nPos = 0;
+        std::shared_ptr<CBlock> pblock;
+        uint256 hash;
+    };
 
-    int nLoaded = 0;
-    try {
-        // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
-        CBufferedFile blkdat(fileIn, 2*dgpMaxBlockSerSize, dgpMaxBlockSerSize+8, SER_DISK, CLIENT_VERSION);
-        uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
-            boost::this_thread::interruption_point();
+    // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
+    BlockFileScanner(FILE* fileIn, const CChainParams& chainparams) :
+        m_blkdat(fileIn, 2*dgpMaxBlockSerSize, dgpMaxBlockSerSize+8, SER_DISK, CLIENT_VERSION),
+        m_max_block_size(dgpMaxBlockSerSize), m_chainparams(chainparams)
+    {
+        m_thread = std::thread(&TraceThread<std::function<void()>>, "loadblkscan", std::function<void()>(std::bind(&BlockFileScanner::Scan, this)));
+    }
 
-            blkdat.SetPos(nRewind);
+    ~BlockFileScanner()
+    {
+        {
+            LOCK(m_mutex);
+            m_stop = true;
+        }
+        m_cond.notify_all();
+        m_thread.join();
+    }
+
+    /** Wait for the next block of the file, false once the file is scanned */
+    bool Next(ScannedBlock& scanned)
+    {
+        WAIT_LOCK(m_mutex, lock);
+        m_cond.wait(lock, [this] { return !m_blocks.empty() || m_done; });
+        if (m_blocks.empty())
+            return false;
+        scanned = std::move(m_blocks.front());
+        m_blocks.pop_front();
+        m_cond.notify_all();
+        return true;
+    }
+
+private:
+    CBufferedFile m_blkdat;
+    //! The DGP block size when the scan started, the connecting thread updates dgpMaxBlockSerSize
+    const unsigned int m_max_block_size;
+    const CChainParams& m_chainparams;
+
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<ScannedBlock> m_blocks GUARDED_BY(m_mutex);
+    bool m_stop GUARDED_BY(m_mutex) = false;
+    bool m_done GUARDED_BY(m_mutex) = false;
+    std::thread m_thread;
+
+    bool Stopped()
+    {
+        LOCK(m_mutex);
+        return m_stop;
+    }
+
+    void Scan()
+    {
+        uint64_t nRewind = m_blkdat.GetPos();
+        while (!m_blkdat.eof() && !Stopped()) {
+            m_blkdat.SetPos(nRewind);
             nRewind++; // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
+            m_blkdat.SetLimit(); // remove former limit
             unsigned int nSize = 0;
             try {
                 // locate a header
                 unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
-                blkdat.FindByte(chainparams.MessageStart()[0]);
-                nRewind = blkdat.GetPos()+1;
-                blkdat >> buf;
-                if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
+                m_blkdat.FindByte(m_chainparams.MessageStart()[0]);
+                nRewind = m_blkdat.GetPos()+1;
+                m_blkdat >> buf;
+                if (memcmp(buf, m_chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
                     continue;
                 // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > dgpMaxBlockSerSize)
+                m_blkdat >> nSize;
+                if (nSize < 80 || nSize > m_max_block_size)
                     continue;
             } catch (const std::exception&) {
                 // no valid block header found; don't complain
@@ -6876,17 +8166,53 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, FlatFi
             }
             try {
                 // read block
-                uint64_t nBlockPos = blkdat.GetPos();
+                ScannedBlock scanned;
+                scanned.nPos = m_blkdat.GetPos();
+                m_blkdat.SetLimit(scanned.nPos + nSize);
+                m_blkdat.SetPos(scanned.nPos);
+                scanned.pblock = std::make_shared<CBlock>();
+                m_blkdat >> *scanned.pblock;
+                nRewind = m_blkdat.GetPos();
+                scanned.hash = scanned.pblock->GetHash();
+
+                WAIT_LOCK(m_mutex, lock);
+                m_cond.wait(lock, [this] { return m_blocks.size() < SCAN_AHEAD_BLOCKS || m_stop; });
+                if (m_stop)
+                    break;
+                m_blocks.push_back(std::move(scanned));
+                m_cond.notify_all();
+            } catch (const std::exception& e) {
+                LogPrintf("LoadExternalBlockFile: Deserialize or I/O error - %s\n", e.what());
+            }
+        }
+
+        LOCK(m_mutex);
+        m_done = true;
+        m_cond.notify_all();
+    }
+};
+} // namespace
+
+bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, FlatFilePos *dbp)
+{
+    // Map of disk positions for blocks with unknown parent (only used for reindex)
+    static std::multimap<uint256, FlatFilePos> mapBlocksUnknownParent;
+    int64_t nStart = GetTimeMillis();
+
+    int nLoaded = 0;
+    try {
+        BlockFileScanner scanner(fileIn, chainparams);
+        BlockFileScanner::ScannedBlock scanned;
+        while (scanner.Next(scanned)) {
+            boost::this_thread::interruption_point();
+
+            try {
                 if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+                    dbp->nPos = scanned.nPos;
+                std::shared_ptr<CBlock> pblock = std::move(scanned.pblock);
                 CBlock& block = *pblock;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
 
-                uint256 hash = block.GetHash();
+                uint256 hash = scanned.hash;
                 {
                     LOCK(cs_main);
                     // detect out of order blocks, and store them for later
@@ -7224,16 +8550,76 @@ int VersionBitsTipStateSinceHeight(const Consensus::Params& params, Consensus::D
 
 static const uint64_t MEMPOOL_DUMP_VERSION = 1;
 
+/**
+ * Verify the scripts of a batch of transactions on the script check threads. The valid
+ * signatures end up in the signature cache, so accepting the transactions one at a time
+ * afterwards does not verify them again. Inputs may spend outputs of earlier transactions
+ * in the batch. Transactions with inputs that are not found, and failing scripts, are left
+ * for the mempool checks to reject.
+ */
+static void PreVerifyTransactionScripts(CTxMemPool& pool, const std::vector<CTransactionRef>& txs) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (nScriptCheckThreads == 0 || txs.empty())
+        return;
+
+    LOCK(pool.cs);
+    CCoinsViewMemPool viewMemPool(&::ChainstateActive().CoinsTip(), pool);
+    CCoinsViewCache view(&viewMemPool);
+    std::map<uint256, const CTransaction*> batchTxs;
+    for (const CTransactionRef& tx : txs) {
+        batchTxs.emplace(tx->GetHash(), tx.get());
+    }
+
+    // The checks keep pointers to their precomputed data
+    std::vector<PrecomputedTransactionData> txdata;
+    txdata.reserve(txs.size());
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    for (const CTransactionRef& ptx : txs) {
+        const CTransaction& tx = *ptx;
+        if (tx.IsCoinBase() || tx.IsCoinStake())
+            continue;
+
+        std::vector<CTxOut> spent;
+        spent.reserve(tx.vin.size());
+        for (const CTxIn& txin : tx.vin) {
+            const Coin& coin = view.AccessCoin(txin.prevout);
+            if (!coin.IsSpent()) {
+                spent.push_back(coin.out);
+                continue;
+            }
+            auto it = batchTxs.find(txin.prevout.hash);
+            if (it == batchTxs.end() || txin.prevout.n >= it->second->vout.size())
+                break;
+            spent.push_back(it->second->vout[txin.prevout.n]);
+        }
+        if (spent.size() != tx.vin.size())
+            continue;
+
+        txdata.emplace_back(tx);
+        std::vector<CScriptCheck> checks;
+        for (unsigned int i = 0; i < tx.vin.size(); i++) {
+            checks.emplace_back(spent[i], tx, i, STANDARD_SCRIPT_VERIFY_FLAGS, true, &txdata.back());
+        }
+        for (unsigned int i = 0; i < tx.vout.size(); i++) {
+            if (tx.vout[i].scriptPubKey.HasOpSender()) {
+                checks.emplace_back(tx, i, STANDARD_SCRIPT_VERIFY_FLAGS, true, &txdata.back());
+            }
+        }
+        control.Add(checks);
+    }
+    // Failures are found again by AcceptToMemoryPool, which reports them
+    control.Wait();
+}
+
 bool LoadMempool(CTxMemPool& pool)
+{
+    return LoadMempool(pool, MempoolJournalContents());
+}
+
+bool LoadMempool(CTxMemPool& pool, const MempoolJournalContents& journal)
 {
     const CChainParams& chainparams = Params();
     int64_t nExpiryTimeout = gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
-    FILE* filestr = fsbridge::fopen(GetDataDir() / "mempool.dat", "rb");
-    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
-    if (file.IsNull()) {
-        LogPrintf("Failed to open mempool file from disk. Continuing anyway.\n");
-        return false;
-    }
 
     int64_t count = 0;
     int64_t expired = 0;
@@ -7241,24 +8627,35 @@ bool LoadMempool(CTxMemPool& pool)
     int64_t already_there = 0;
     int64_t nNow = GetTime();
 
-    try {
-        uint64_t version;
-        file >> version;
-        if (version != MEMPOOL_DUMP_VERSION) {
-            return false;
+    // A journal closed at shutdown holds the fee deltas of the whole pool
+    const bool closed = !journal.closed_tip.IsNull();
+    // The pool of a clean shutdown passed the script checks against the UTXO set of the
+    // tip it was closed at, they need not run again while that is still the tip
+    bool trusted = false;
+    if (closed) {
+        LOCK(cs_main);
+        trusted = ::ChainActive().Tip() && ::ChainActive().Tip()->GetBlockHash() == journal.closed_tip;
+    }
+
+    // Verify the signatures of a batch of transactions in parallel and accept them in order
+    auto accept_batch = [&](const std::vector<PersistedMempoolTx>& batch) {
+        if (!trusted) {
+            std::vector<CTransactionRef> unexpired;
+            for (const auto& entry : batch) {
+                if (entry.nTime + nExpiryTimeout > nNow) {
+                    unexpired.push_back(entry.tx);
+                }
+            }
+            LOCK(cs_main);
+            PreVerifyTransactionScripts(pool, unexpired);
         }
-        uint64_t num;
-        file >> num;
-        while (num--) {
-            CTransactionRef tx;
-            int64_t nTime;
-            int64_t nFeeDelta;
-            file >> tx;
-            file >> nTime;
-            file >> nFeeDelta;
-
-            CAmount amountdelta = nFeeDelta;
-            if (amountdelta) {
+
+        for (const auto& entry : batch) {
+            const CTransactionRef& tx = entry.tx;
+            const int64_t nTime = entry.nTime;
+
+            CAmount amountdelta = entry.nFeeDelta;
+            if (amountdelta && !closed) {
                 pool.PrioritiseTransaction(tx->GetHash(), amountdelta);
             }
             CValidationState state;
@@ -7266,7 +8663,7 @@ bool LoadMempool(CTxMemPool& pool)
                 LOCK(cs_main);
                 AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, nullptr /* pfMissingInputs */, nTime,
                                            nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */,
-                                           false /* test_accept */);
+                                           false /* test_accept */, false /* rawTx */, trusted);
                 if (state.IsValid()) {
                     ++count;
                 } else {
@@ -7286,22 +8683,72 @@ bool LoadMempool(CTxMemPool& pool)
             if (ShutdownRequested())
                 return false;
         }
-        std::map<uint256, CAmount> mapDeltas;
-        file >> mapDeltas;
+        return true;
+    };
+
+    bool ret = true;
+    FILE* filestr = fsbridge::fopen(GetDataDir() / "mempool.dat", "rb");
+    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        LogPrintf("Failed to open mempool file from disk. Continuing anyway.\n");
+        ret = false;
+    }
 
-        for (const auto& i : mapDeltas) {
-            pool.PrioritiseTransaction(i.first, i.second);
+    try {
+        uint64_t version = MEMPOOL_DUMP_VERSION;
+        if (ret) {
+            file >> version;
+        }
+        if (ret && version == MEMPOOL_DUMP_VERSION) {
+            uint64_t num;
+            file >> num;
+            while (num) {
+                // The dump lists parents before their children, the transactions the
+                // journal changed are replayed from it afterwards
+                std::vector<PersistedMempoolTx> batch;
+                while (num && batch.size() < MEMPOOL_LOAD_BATCH_SIZE) {
+                    PersistedMempoolTx entry;
+                    file >> entry.tx;
+                    file >> entry.nTime;
+                    file >> entry.nFeeDelta;
+                    if (!journal.touched.count(entry.tx->GetHash())) {
+                        batch.push_back(std::move(entry));
+                    }
+                    num--;
+                }
+                if (!accept_batch(batch)) return false;
+            }
+            std::map<uint256, CAmount> mapDeltas;
+            file >> mapDeltas;
+
+            if (!closed) {
+                for (const auto& i : mapDeltas) {
+                    pool.PrioritiseTransaction(i.first, i.second);
+                }
+            }
+        } else {
+            ret = false;
         }
     } catch (const std::exception& e) {
         LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
-        return false;
+        ret = false;
     }
 
-    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there\n", count, failed, expired, already_there);
-    return true;
+    for (size_t i = 0; i < journal.added.size(); i += MEMPOOL_LOAD_BATCH_SIZE) {
+        const auto first = journal.added.begin() + i;
+        const std::vector<PersistedMempoolTx> batch(first, first + std::min(MEMPOOL_LOAD_BATCH_SIZE, journal.added.size() - i));
+        if (!accept_batch(batch)) return false;
+    }
+    for (const auto& i : journal.deltas) {
+        pool.PrioritiseTransaction(i.first, i.second);
+    }
+
+    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there%s\n", count, failed, expired, already_there,
+        trusted ? " (scripts verified before shutdown)" : "");
+    return ret || journal.records > 0;
 }
 
-bool DumpMempool(const CTxMemPool& pool)
+bool WriteMempoolSnapshot(const CTxMemPool& pool, const std::function<void()>& on_copied)
 {
     int64_t start = GetTimeMicros();
 
@@ -7317,6 +8764,7 @@ bool DumpMempool(const CTxMemPool& pool)
             mapDeltas[i.first] = i.second;
         }
         vinfo = pool.infoAll();
+        if (on_copied) on_copied();
     }
 
     int64_t mid = GetTimeMicros();
@@ -7354,6 +8802,15 @@ bool DumpMempool(const CTxMemPool& pool)
     return true;
 }
 
+bool DumpMempool(const CTxMemPool& pool)
+{
+    // With the journal mempool.dat is only up to date together with it
+    if (g_mempool_journal && &g_mempool_journal->GetPool() == &pool) {
+        return g_mempool_journal->Compact();
+    }
+    return WriteMempoolSnapshot(pool, nullptr);
+}
+
 //! Guess how far we are in the verification process at the given block index
 //! require cs_main if pindex has not been validated yet (because nChainTx might be unset)
 double GuessVerificationProgress(const ChainTxData& data, const CBlockIndex *pindex) {
@@ -7420,24 +8877,47 @@ static CMainCleanup instance_of_cmaincleanup;
 ////////////////////////////////////////////////////////////////////////////////// // qtum
 bool GetAddressIndex(uint256 addressHash, int type, std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end)
 {
-    if (!fAddressIndex)
+    if (!fAddressIndex || !g_addressindex)
+        return error("address index not enabled");
+
+    if (!g_addressindex->FindAddressIndex(addressHash, type, addressIndex, start, end))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
+bool GetAddressIndexPage(uint256 addressHash, int type, int start, int end, const CAddressIndexKey* cursor, bool reverse, size_t limit,
+                         std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex)
+{
+    if (!fAddressIndex || !g_addressindex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
+    if (!g_addressindex->FindAddressIndexPage(addressHash, type, start, end, cursor, reverse, limit, addressIndex))
         return error("unable to get txids for address");
 
     return true;
 }
 
+bool GetAddressBalance(uint256 addressHash, int type, CAddressBalanceValue &value)
+{
+    if (!fAddressIndex || !g_addressindex)
+        return error("address index not enabled");
+
+    if (!g_addressindex->FindAddressBalance(addressHash, type, value))
+        return error("unable to get balance for address");
+
+    return true;
+}
+
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
 {
-    if (!fAddressIndex)
+    if (!fAddressIndex || !g_addressindex)
         return false;
 
     if (mempool.getSpentIndex(key, value))
         return true;
 
-    if (!pblocktree->ReadSpentIndex(key, value))
+    if (!g_addressindex->FindSpentIndex(key, value))
         return false;
 
     return true;
@@ -7445,10 +8925,10 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
 
 bool GetAddressUnspent(uint256 addressHash, int type, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
 {
-    if (!fAddressIndex)
+    if (!fAddressIndex || !g_addressindex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
+    if (!g_addressindex->FindAddressUnspent(addressHash, type, unspentOutputs))
         return error("unable to get txids for address");
 
     return true;
@@ -7456,10 +8936,13 @@ bool GetAddressUnspent(uint256 addressHash, int type, std::vector<std::pair<CAdd
 
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &hashes)
 {
-    if (!fAddressIndex)
-        return error("Timestamp index not enabled");
+    // The active chain is searched in memory, only the blocks of stale forks need the index
+    if (fActiveOnly || !fAddressIndex || !g_addressindex) {
+        FindActiveBlocksByTime(high, low, hashes);
+        return true;
+    }
 
-    if (!pblocktree->ReadTimestampIndex(high, low, fActiveOnly, hashes))
+    if (!g_addressindex->FindTimestampIndex(high, low, fActiveOnly, hashes))
         return error("Unable to get hashes for timestamps");
 
     return true;
@@ -25,6 +25,7 @@
 #include <algorithm>
 #include <atomic>
 #include <exception>
+#include <functional>
 #include <map>
 #include <memory>
 #include <set>
@@ -46,12 +47,12 @@ class CWalletTx;
 #include <libethashseal/GenesisInfo.h>
 #include <script/standard.h>
 #include <qtum/storageresults.h>
+#include <qtum/qtumstateview.h>
 
 
 extern std::unique_ptr<QtumState> globalState;
 extern std::shared_ptr<dev::eth::SealEngineFace> globalSealEngine;
 extern bool fRecordLogOpcodes;
-extern bool fIsVMlogFile;
 extern bool fGettingValuesDGP;
 
 struct EthTransactionParams;
@@ -72,17 +73,22 @@ class CTxMemPool;
 class CValidationState;
 struct CDiskTxPos;
 class CWallet;
+class QtumDGP;
 struct ChainTxData;
 
 struct DisconnectedBlockTransactions;
 struct PrecomputedTransactionData;
 struct LockPoints;
+struct MempoolJournalContents;
 
 /** Minimum gas limit that is allowed in a transaction within a block - prevent various types of tx and mempool spam **/
 static const uint64_t MINIMUM_GAS_LIMIT = 10000;
 
 static const uint64_t MEMPOOL_MIN_GAS_LIMIT = 22000;
 
+/** Default for -maxmempoolgas, maximum gas declared by the contract txs of the mempool, about 50 full blocks */
+static const uint64_t DEFAULT_MAX_MEMPOOL_GAS = 2000000000;
+
 /** Default for -minrelaytxfee, minimum relay fee for transactions */
 static const unsigned int DEFAULT_MIN_RELAY_TX_FEE = 1000000000;
 /** Default for -limitancestorcount, max number of in-mempool ancestors */
@@ -101,6 +107,8 @@ static const unsigned int DEFAULT_DESCENDANT_SIZE_LIMIT = 101;
 static const unsigned int EXTRA_DESCENDANT_TX_SIZE_LIMIT = 10000;
 /** Default for -mempoolexpiry, expiration time for mempool transactions in hours */
 static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 336;
+/** Transactions read from mempool.dat at a time, their signatures are verified in parallel */
+static const size_t MEMPOOL_LOAD_BATCH_SIZE = 1000;
 /** Maximum kilobytes for transactions to store for processing during reorg */
 static const unsigned int MAX_DISCONNECTED_TX_POOL_SIZE = 20000;
 /** The maximum size of a blk?????.dat file (since 0.8) */
@@ -152,6 +160,21 @@ static const bool DEFAULT_TXINDEX = false;
 static const bool DEFAULT_ADDRINDEX = false;
 #endif
 static const bool DEFAULT_LOGEVENTS = false;
+static const char* const DEFAULT_EVM_BACKEND = "legacy";
+/** Depth below which pruned nodes delete transaction receipts, 0 keeps them all */
+static const unsigned int DEFAULT_LOGEVENTSPRUNE = 0;
+/** Number of threads pre-executing the contract transactions of a connecting block, 0 disables it */
+static const int DEFAULT_CONTRACT_PREFETCH_THREADS = 0;
+static const int MAX_CONTRACT_PREFETCH_THREADS = 16;
+/** Blocks with fewer contract executions than this are not worth the thread startup */
+static const size_t MIN_CONTRACT_PREFETCH_TXS = 4;
+/** Number of threads reading the coins spent by a connecting block from the database ahead of ConnectBlock, 0 disables it */
+static const int DEFAULT_INPUT_PREFETCH_THREADS = 4;
+static const int MAX_INPUT_PREFETCH_THREADS = 16;
+/** Each input prefetch thread reads at least this many coins, blocks with fewer cache misses are read inline */
+static const size_t MIN_INPUT_PREFETCH_COINS = 32;
+/** Blocks ahead of the one being read whose undo data sequential readers prefetch */
+static const int UNDO_READ_AHEAD = 4;
 static const char* const DEFAULT_BLOCKFILTERINDEX = "0";
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 /** Default for -persistmempool */
@@ -172,6 +195,10 @@ static const uint64_t DEFAULT_GAS_LIMIT_OP_CREATE=2500000;
 static const uint64_t DEFAULT_GAS_LIMIT_OP_SEND=250000;
 static const CAmount DEFAULT_GAS_PRICE=5000;
 static const CAmount MAX_RPC_GAS_PRICE=2*DEFAULT_GAS_PRICE;
+/** The gas estimate stops within 1/GAS_ESTIMATE_PRECISION above the smallest limit a call succeeds with */
+static const uint64_t GAS_ESTIMATE_PRECISION=64;
+/** Percent the wallet adds to an estimated gas limit, for the state to change before its transaction is mined */
+static const uint64_t GAS_ESTIMATE_MARGIN_PERCENT=10;
 
 static const size_t MAX_CONTRACT_VOUTS = 1000; // qtum
 
@@ -184,6 +211,14 @@ struct BlockHasher
 };
 
 extern CScript COINBASE_FLAGS;
+/**
+ * Guards the active chain, the coins, the global EVM state and changes to the block index.
+ * What only needs part of it has its own lock or a lock-free copy, taken after cs_main when both are held:
+ * - block index lookups: BlockManager::m_lookup_mutex, see LookupBlockIndexShared
+ * - the header spam filter of headers sync: cs_service_headers in net_processing
+ * - reads of the tip, its DGP parameters and contracts: GetChainTipSnapshot and TipStateView
+ * The coins and the EVM state still change under cs_main while blocks are connected.
+ */
 extern CCriticalSection cs_main;
 extern CBlockPolicyEstimator feeEstimator;
 extern CTxMemPool mempool;
@@ -191,9 +226,13 @@ typedef std::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
 extern Mutex g_best_block_mutex;
 extern std::condition_variable g_best_block_cv;
 extern uint256 g_best_block;
+/** Number of blocks disconnected from the active chain, lets caches of chain data tell they may be stale */
+extern std::atomic<uint64_t> g_reorg_generation;
 extern std::atomic_bool fImporting;
 extern std::atomic_bool fReindex;
 extern int nScriptCheckThreads;
+extern int nContractPrefetchThreads;
+extern int nInputPrefetchThreads;
 #ifdef ENABLE_BITCORE_RPC
 extern bool fAddressIndex;
 #endif
@@ -202,6 +241,8 @@ extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
 extern size_t nCoinCacheUsage;
+/** Memory budget for EVM state trie nodes not yet committed to the state database */
+extern size_t nStateCacheUsage;
 /** A fee rate smaller than this is considered zero fee (for relaying, mining and transaction creation) */
 extern CFeeRate minRelayTxFee;
 /** If the tip is older than this (in seconds), the node is considered to be in initial block download. */
@@ -223,13 +264,21 @@ extern bool fHavePruned;
 extern bool fPruneMode;
 /** Number of MiB of block files that we're trying to stay below. */
 extern uint64_t nPruneTarget;
+/** Number of blocks from the tip whose receipts are kept by -logeventsprune, 0 keeps them all. */
+extern unsigned int nLogEventsPrune;
 /** Block files containing a block-height within MIN_BLOCKS_TO_KEEP of ::ChainActive().Tip() will not be pruned. */
 static const unsigned int MIN_BLOCKS_TO_KEEP = 288;
+/** Default for -archiveblocks, 0 keeps the block and undo files uncompressed */
+static const int64_t DEFAULT_ARCHIVE_BLOCKS = 0;
+/** Seconds between two looks for block and undo files to archive */
+static const int64_t BLOCK_ARCHIVE_INTERVAL = 60;
 /** Minimum blocks required to signal NODE_NETWORK_LIMITED */
 static const unsigned int NODE_NETWORK_LIMITED_MIN_BLOCKS = 288;
 
 static const signed int DEFAULT_CHECKBLOCKS = 6;
 static const unsigned int DEFAULT_CHECKLEVEL = 3;
+/** Random blocks of the active chain checked in the background after startup, 0 disables it */
+static const int DEFAULT_CHECKBLOCKSAMPLE = 0;
 
 // Require that user allocate at least 550 MiB for block & undo files (blk???.dat and rev???.dat)
 // At 1MB per block, 288 blocks = 288MB.
@@ -283,6 +332,15 @@ bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& block, CValidationS
 FILE* OpenBlockFile(const FlatFilePos &pos, bool fReadOnly = false);
 /** Translation to a filesystem path */
 fs::path GetBlockPosFilename(const FlatFilePos &pos);
+/** Whether the block file was replaced by its compressed archive */
+bool IsBlockFileArchived(const FlatFilePos &pos);
+/**
+ * Compress the block and undo files whose blocks are all more than depth below the tip into
+ * archives, which the block and undo reads decompress transparently. Runs until interrupted.
+ */
+void ThreadArchiveBlockFiles(int depth);
+/** Delete the archived undo files before a reindex writes the undo data again */
+void DeleteArchivedUndoFiles();
 /** Import blocks from an external file */
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, FlatFilePos *dbp = nullptr);
 /** Ensures we have a genesis block in the block tree, possibly writing one to disk. */
@@ -296,6 +354,8 @@ void UnloadBlockIndex();
 void ThreadScriptCheck(int worker_num);
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
 bool GetTransaction(const uint256& hash, CTransactionRef& tx, const Consensus::Params& params, uint256& hashBlock, const CBlockIndex* const blockIndex = nullptr, bool fAllowSlow = false);
+/** Look up several transactions by hash at once, from the mempool or else the transaction index, read in one batch. The entries of transactions not found are null. */
+void GetTransactions(const std::vector<uint256>& hashes, std::vector<CTransactionRef>& txs, std::vector<uint256>& block_hashes);
 /**
  * Find the best known block, and make it the tip of the block chain
  *
@@ -308,6 +368,9 @@ CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams, c
 CAmount GetGovernorSubsidy(int nHeight, uint64_t nCollateral);
 CAmount GetBudgetSubsidy(CAmount blockReward, CAmount governorReward, int nHeight);
 bool GetDGPVout(std::vector<CTxOut> vTempVouts, std::vector<unsigned char> vContractAddr, std::vector<unsigned char> vContractData, CTxOut& vout, uint32_t& n);
+bool GetDGPVout(const CBlock& block, std::vector<unsigned char> vContractAddr, std::vector<unsigned char> vContractData, CTxOut& vout, uint32_t& n);
+/** The DGP contract calls the coinstake of a proof of stake block pays for, executed after the block's transactions */
+std::vector<QtumTransaction> GetDGPTransactions(const CBlock& block, QtumDGP qtumDGP, int nHeight);
 
 /** Guess verification progress (as a fraction between 0.0=genesis and 1.0=current tip). */
 double GuessVerificationProgress(const ChainTxData& data, const CBlockIndex* pindex);
@@ -394,13 +457,17 @@ private:
     ScriptError error;
     PrecomputedTransactionData *txdata;
     int nOut;
+    const CBlock *pblock;
 
 public:
-    CScriptCheck(): ptxTo(nullptr), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR), nOut(-1) {}
+    CScriptCheck(): ptxTo(nullptr), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR), nOut(-1), pblock(nullptr) {}
     CScriptCheck(const CTxOut& outIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn, PrecomputedTransactionData* txdataIn) :
-        m_tx_out(outIn), ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn), nOut(-1) { }
+        m_tx_out(outIn), ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn), nOut(-1), pblock(nullptr) { }
     CScriptCheck(const CTransaction& txToIn, int nOutIn, unsigned int nFlagsIn, bool cacheIn, PrecomputedTransactionData* txdataIn) :
-        ptxTo(&txToIn), nIn(0), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn), nOut(nOutIn) { }
+        ptxTo(&txToIn), nIn(0), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn), nOut(nOutIn), pblock(nullptr) { }
+    /** Check the proof-of-stake signature of a block header */
+    explicit CScriptCheck(const CBlock& blockIn) :
+        ptxTo(nullptr), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(nullptr), nOut(-1), pblock(&blockIn) { }
 
     bool operator()();
 
@@ -413,6 +480,7 @@ public:
         std::swap(error, check.error);
         std::swap(txdata, check.txdata);
         std::swap(nOut, check.nOut);
+        std::swap(pblock, check.pblock);
     }
 
     ScriptError GetScriptError() const { return error; }
@@ -429,6 +497,11 @@ bool GetAddressIndex(uint256 addressHash, int type,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                      int start = 0, int end = 0);
 
+bool GetAddressIndexPage(uint256 addressHash, int type, int start, int end, const CAddressIndexKey* cursor, bool reverse, size_t limit,
+                         std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex);
+
+bool GetAddressBalance(uint256 addressHash, int type, CAddressBalanceValue &value);
+
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
 
 bool GetAddressUnspent(uint256 addressHash, int type,
@@ -443,10 +516,14 @@ bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, const
 template <typename Block>
 bool ReadBlockFromDisk(Block& block, const FlatFilePos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** Read the block of pindex, sharing it with the recent block cache when it is there */
+bool ReadBlockFromDisk(std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, const CMessageHeader::MessageStartChars& message_start);
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
 
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
+/** Start reading the undo data of pindex on a background thread, for a UndoReadFromDisk that follows */
+void PrefetchUndo(const CBlockIndex* pindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
 bool CheckIndexProof(const CBlockIndex& block, const Consensus::Params& consensusParams);
 
@@ -454,6 +531,9 @@ bool CheckIndexProof(const CBlockIndex& block, const Consensus::Params& consensu
 
 /** Context-independent validity checks */
 bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckMerkleRoot = true, bool fCheckSig=true);
+
+/** Check the signature of a proof-of-stake block, or that a proof-of-work block has none */
+bool CheckBlockSignature(const CBlock& block);
 bool GetBlockPublicKey(const CBlock& block, std::vector<unsigned char>& vchPubKey);
 bool SignBlock(std::shared_ptr<CBlock> pblock, CWallet& wallet, const CAmount& nTotalFees, uint32_t nTime, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoins);
 bool CheckCanonicalBlockSignature(const CBlockHeader* pblock);
@@ -485,8 +565,52 @@ public:
     bool VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview, int nCheckLevel, int nCheckDepth);
 };
 
+/**
+ * Check nBlocks random blocks of the active chain, below the tip blocks VerifyDB covers at startup:
+ * read them, verify their merkle roots and read their undo data, one at a time without holding
+ * cs_main. A failure only raises a warning, the node keeps running on a chain it already validated.
+ */
+void ThreadCheckBlockSample(int nBlocks);
+
 CBlockIndex* LookupBlockIndex(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+/** Find a block index entry without cs_main. Entries are never freed while the node runs,
+ * their header fields do not change, status fields may be read while they are updated. */
+const CBlockIndex* LookupBlockIndexShared(const uint256& hash);
+
+/**
+ * The active chain tip, replaced as a whole after every tip change so read-only
+ * queries such as getblockcount or getblockhash do not wait for cs_main while a
+ * block with contract executions is connected.
+ */
+struct ChainTipSnapshot
+{
+    const CBlockIndex* tip{nullptr};
+    int height{-1};
+    uint256 hashStateRoot;
+    uint256 hashUTXORoot;
+
+    /** The block of the snapshot's chain at nHeight, or nullptr when out of range */
+    const CBlockIndex* operator[](int nHeight) const;
+    bool Contains(const CBlockIndex* pindex) const;
+};
+
+/** The snapshot of the last tip change, empty before the chain is loaded. Never null. */
+std::shared_ptr<const ChainTipSnapshot> GetChainTipSnapshot();
+
+/** Take the current snapshot and a state view on its tip, to read contracts and the DGP without cs_main.
+ *  The view is null when the chain is not loaded yet. */
+QtumStateViewPool::Handle TipStateView(std::shared_ptr<const ChainTipSnapshot>& snapshot);
+
+/**
+ * The blocks of the active chain whose logical timestamp is in [low, high), oldest first, with
+ * those timestamps. A block's logical timestamp is its time, raised to one past the logical
+ * timestamp of its parent when it is not newer, so they increase with the height and are found
+ * by binary search in an array kept in memory and updated with every tip change. The genesis
+ * block is not included, as in the timestamp index of -addrindex.
+ */
+void FindActiveBlocksByTime(unsigned int high, unsigned int low, std::vector<std::pair<uint256, unsigned int> >& hashes);
+
 extern std::unique_ptr<StorageResults> pstorageresult;
 
 bool CheckReward(const CBlock& block, CValidationState& state, int nHeight, const Consensus::Params& consensusParams, CAmount nFees, CAmount gasRefunds, CAmount nActualStakeReward, const std::vector<CTxOut>& vouts);
@@ -506,11 +630,48 @@ std::vector<ResultExecute> CallContract(const dev::Address& addrContract, std::v
 
 std::vector<ResultExecute> CallContract(const dev::Address& addrContract, std::vector<unsigned char> opcode, CBlockIndex* pblockindex, const dev::Address& sender = dev::Address(), uint64_t gasLimit = 0, uint64_t blockGasLimit=0);
 
+/** Execute a read-only contract call on a state view instead of the global state. blockGasLimit must be resolved by the caller. */
+std::vector<ResultExecute> CallContract(QtumStateView& view, const dev::Address& addrContract, std::vector<unsigned char> opcode, CBlockIndex* pblockindex, const dev::Address& sender, uint64_t gasLimit, uint64_t blockGasLimit);
+
+struct ContractCallParams{
+    //! Null to create a contract with data as its bytecode
+    dev::Address contract;
+    std::vector<unsigned char> data;
+    dev::Address sender;
+    uint64_t gasLimit;
+    CAmount value;
+};
+
+/** Execute several read-only contract calls against the same state view, sharing the block template. Results are returned in order. */
+std::vector<ResultExecute> CallContracts(QtumStateView& view, const std::vector<ContractCallParams>& calls, CBlockIndex* pblockindex, uint64_t blockGasLimit);
+
+/**
+ * Find the smallest gas limit a call succeeds with on a state view, up to GAS_ESTIMATE_PRECISION. The call is
+ * executed with call.gasLimit (the block gas limit when 0) first, a call that fails with it returns false with
+ * result set to that execution. Otherwise the limit is searched between the gas used and call.gasLimit, trying
+ * just above the gas used first, and result is set to the execution with the returned gasLimit. Every execution
+ * is reverted, so they all run on the pinned state and reuse the accounts and code the view loaded.
+ */
+bool EstimateContractGas(QtumStateView& view, const ContractCallParams& call, CBlockIndex* pblockindex, uint64_t blockGasLimit, uint64_t& gasLimit, ResultExecute& result);
+
+/** Estimate on the state of the active tip, for the wallet sending a contract transaction without a gas limit. Needs cs_main. */
+bool EstimateContractGas(const ContractCallParams& call, uint64_t& gasLimit, ResultExecute& result);
+
+/** Remember the header and coinbase/coinstake of a block so contract calls on top of it do not read it from disk */
+void SetCallContractTemplate(const CBlock& block, const CBlockIndex* pindex);
+
+/** Note that a committed execution left trie nodes in the global state overlay */
+void MarkQtumStateCacheDirty() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+/** Memory held by uncommitted global state trie nodes, measured again after they changed */
+size_t QtumStateCacheUsage() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+/** Write the uncommitted global state trie nodes to the state database */
+void FlushQtumStateToDisk() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 bool CheckOpSender(const CTransaction& tx, const CChainParams& chainparams, int nHeight);
 
 bool CheckSenderScript(const CCoinsViewCache& view, const CTransaction& tx);
 
-bool CheckMinGasPrice(std::vector<EthTransactionParams>& etps, const uint64_t& minGasPrice);
+bool CheckMinGasPrice(const std::vector<EthTransactionParams>& etps, const uint64_t& minGasPrice);
 
 void writeVMlog(const std::vector<ResultExecute>& res, const CTransaction& tx = CTransaction(), const CBlock& block = CBlock());
 
@@ -523,7 +684,7 @@ struct EthTransactionParams{
     valtype code;
     dev::Address receiveAddress;
 
-    bool operator!=(EthTransactionParams etp){
+    bool operator!=(const EthTransactionParams& etp) const{
         if(this->version.toRaw() != etp.version.toRaw() || this->gasLimit != etp.gasLimit ||
         this->gasPrice != etp.gasPrice || this->code != etp.code ||
         this->receiveAddress != etp.receiveAddress)
@@ -543,7 +704,10 @@ class QtumTxConverter{
 
 public:
 
-    QtumTxConverter(CTransaction tx, CCoinsViewCache* v = NULL, const std::vector<CTransactionRef>* blockTxs = NULL, unsigned int flags = SCRIPT_EXEC_BYTE_CODE) : txBit(tx), view(v), blockTransactions(blockTxs), sender(false), nFlags(flags){}
+    QtumTxConverter(const CTransaction& tx, CCoinsViewCache* v = NULL, const std::vector<CTransactionRef>* blockTxs = NULL, unsigned int flags = SCRIPT_EXEC_BYTE_CODE) : txBit(tx), view(v), blockTransactions(blockTxs), sender(false), nFlags(flags){}
+
+    // The converter keeps a reference to the transaction
+    QtumTxConverter(CTransaction&& tx, CCoinsViewCache* v = NULL, const std::vector<CTransactionRef>* blockTxs = NULL, unsigned int flags = SCRIPT_EXEC_BYTE_CODE) = delete;
 
     bool extractionQtumTransactions(ExtractQtumTX& qtumTx);
 
@@ -557,7 +721,7 @@ private:
 
     size_t correctedStackSize(size_t size);
 
-    const CTransaction txBit;
+    const CTransaction& txBit;
     const CCoinsViewCache* view;
     std::vector<valtype> stack;
     opcodetype opcode;
@@ -567,26 +731,66 @@ private:
     unsigned int nFlags;
 };
 
+/** Most transactions whose extracted contract transactions are kept in the contract tx cache */
+static const size_t MAX_CONTRACT_TX_CACHE_SIZE = 5000;
+
+/**
+ * Extract the contract transactions of tx like QtumTxConverter, from the contract tx cache when
+ * the transaction was already extracted with the same script flags. The extraction only reads the
+ * outputs and the sender of the first input, so the cache is keyed by txid. The result is added
+ * to the cache when fCache is set, which mempool accept and the contract prefetcher do so the
+ * block assembler, ConnectBlock and the receipt index find it there.
+ */
+bool ExtractContractTxs(const CTransaction& tx, CCoinsViewCache* view, const std::vector<CTransactionRef>* blockTxs, unsigned int flags, ContractTxsRef& contractTxs, bool fCache = false);
+
+/** Number of preceding block hashes exposed to the BLOCKHASH opcode */
+static const size_t LAST_HASHES_COUNT = 256;
+
 class LastHashes: public dev::eth::LastBlockHashesFace
 {
 public:
     explicit LastHashes();
 
+    /** Take the hashes preceding tip, shared with the chain tip when tip is the active one */
     void set(CBlockIndex const* tip);
 
     dev::h256s precedingHashes(dev::h256 const&) const;
 
     void clear();
 
+    /** Move the shared hashes to a new active tip, called on every connect and disconnect */
+    static void updateTip(CBlockIndex const* tip);
+
+private:
+    std::shared_ptr<const dev::h256s> m_lastHashes;
+};
+
+/** EVM environment (header and preceding hashes) of a block, built once and shared by the ByteCodeExec instances running its transactions */
+class EVMBlockEnvironment {
+
+public:
+
+    EVMBlockEnvironment(const CBlock& block, const CBlockIndex* pindexPrev, uint64_t blockGasLimit);
+
+    EVMBlockEnvironment(const EVMBlockEnvironment&) = delete;
+    EVMBlockEnvironment& operator=(const EVMBlockEnvironment&) = delete;
+
+    const dev::eth::EnvInfo& envInfo() const { return m_envInfo; }
+
 private:
-    dev::h256s m_lastHashes;
+
+    LastHashes m_lastHashes;
+
+    dev::eth::EnvInfo m_envInfo;
 };
 
 class ByteCodeExec {
 
 public:
 
-    ByteCodeExec(const CBlock& _block, std::vector<QtumTransaction> _txs, const uint64_t _blockGasLimit, CBlockIndex* _pindex) : txs(_txs), block(_block), blockGasLimit(_blockGasLimit), pindex(_pindex) {}
+    ByteCodeExec(const CBlock& _block, std::vector<QtumTransaction> _txs, const uint64_t _blockGasLimit, CBlockIndex* _pindex, QtumState* _state = nullptr, dev::eth::SealEngineFace* _sealEngine = nullptr, const EVMBlockEnvironment* _env = nullptr) :
+        txs(_txs), block(_block), blockGasLimit(_blockGasLimit), pindex(_pindex),
+        state(_state ? _state : globalState.get()), sealEngine(_sealEngine ? _sealEngine : globalSealEngine.get()), env(_env) {}
 
     bool performByteCode(dev::eth::Permanence type = dev::eth::Permanence::Committed);
 
@@ -594,11 +798,12 @@ public:
 
     std::vector<ResultExecute>& getResult(){ return result; }
 
-private:
+    static dev::Address EthAddrFromScript(const CScript& scriptIn);
 
-    dev::eth::EnvInfo BuildEVMEnvironment();
+private:
 
-    dev::Address EthAddrFromScript(const CScript& scriptIn);
+    /** Shared environment when one was passed in, otherwise built on the first transaction that needs the EVM */
+    const dev::eth::EnvInfo& envInfo();
 
     std::vector<QtumTransaction> txs;
 
@@ -610,7 +815,13 @@ private:
 
     CBlockIndex* pindex;
 
-    LastHashes lastHashes;
+    QtumState* state;
+
+    dev::eth::SealEngineFace* sealEngine;
+
+    const EVMBlockEnvironment* env;
+
+    std::unique_ptr<EVMBlockEnvironment> ownEnv;
 };
 
 /** Find the last common block between the parameter chain and a locator. */
@@ -625,6 +836,20 @@ enum DisconnectResult
 
 class ConnectTrace;
 
+/**
+ * What the blocks a reorg disconnects leave to be written once the last of them
+ * is disconnected: the contract state roots go straight to those of the fork
+ * point, and the receipts, height index and stake index entries of all of them
+ * are erased in one batch per database.
+ */
+struct DisconnectedBlockEffects
+{
+    //! The block below the lowest block disconnected so far, null before the first
+    const CBlockIndex* pindexFork{nullptr};
+    unsigned int nHighest{0};
+    std::vector<CTransactionRef> vtxResults;
+};
+
 /** @see CChainState::FlushStateToDisk */
 enum class FlushStateMode {
     NONE,
@@ -649,6 +874,9 @@ class BlockManager {
 public:
     BlockMap m_block_index GUARDED_BY(cs_main);
 
+    /** Held besides cs_main while m_block_index changes, so it can be searched without cs_main */
+    mutable Mutex m_lookup_mutex;
+
     /** In order to efficiently track invalidity of headers, we keep the set of
       * blocks which we tried to connect and found to be invalid here (ie which
       * were set to BLOCK_FAILED_VALID since the last restart). We can then
@@ -696,6 +924,9 @@ public:
     /** Create a new block index entry for a given block hash */
     CBlockIndex* InsertBlockIndex(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    /** Find an entry of m_block_index without cs_main */
+    CBlockIndex* LookupShared(const uint256& hash) const NO_THREAD_SAFETY_ANALYSIS;
+
     /**
      * If a block header hasn't already been seen, call CheckBlockHeader on it, ensure
      * that it doesn't descend from an invalid block, and then add it to m_block_index.
@@ -726,6 +957,9 @@ public:
     //! This view wraps access to the leveldb instance and handles read errors gracefully.
     CCoinsViewErrorCatcher m_catcherview GUARDED_BY(cs_main);
 
+    //! This view holds the changes of a flush while they are written to the database in the background.
+    CCoinsViewFlushBuffer m_flushview GUARDED_BY(cs_main);
+
     //! This is the top layer of the cache hierarchy - it keeps as many coins in memory as
     //! can fit per the dbcache setting.
     std::unique_ptr<CCoinsViewCache> m_cacheview GUARDED_BY(cs_main);
@@ -848,6 +1082,13 @@ public:
         return m_coins_views->m_dbview;
     }
 
+    //! @returns A reference to the view taking the changes of the coins cache
+    //!     over while they are written to the database.
+    CCoinsViewFlushBuffer& CoinsFlushBuffer() EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+    {
+        return m_coins_views->m_flushview;
+    }
+
     //! @returns A reference to a wrapped view of the in-memory UTXO set that
     //!     handles disk read errors gracefully.
     CCoinsViewErrorCatcher& CoinsErrorCatcher() EXCLUSIVE_LOCKS_REQUIRED(cs_main)
@@ -904,13 +1145,16 @@ public:
     bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const FlatFilePos* dbp, bool* fNewBlock) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     // Block (dis)connection on a given view:
-    DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean);
+    /** The effects past the coins are recorded in effects instead of written when given */
+    DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean, DisconnectedBlockEffects* effects = nullptr);
+    /** The undo data of the block is moved to pblockundo when given */
     bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex,
-                      CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck = false) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+                      CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck = false, CBlockUndo* pblockundo = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     bool UpdateHashProof(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, CBlockIndex* pindex, CCoinsViewCache& view);
 
     // Apply the effects of a block disconnection on the UTXO set.
-    bool DisconnectTip(CValidationState& state, const CChainParams& chainparams, DisconnectedBlockTransactions* disconnectpool) EXCLUSIVE_LOCKS_REQUIRED(cs_main, ::mempool.cs);
+    // With effects, the rest is left to WriteDisconnectedEffects and the chain state is not flushed.
+    bool DisconnectTip(CValidationState& state, const CChainParams& chainparams, DisconnectedBlockTransactions* disconnectpool, DisconnectedBlockEffects* effects = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main, ::mempool.cs);
 
     // Manual block validity manipulation:
     bool PreciousBlock(CValidationState& state, const CChainParams& params, CBlockIndex* pindex) LOCKS_EXCLUDED(cs_main);
@@ -942,6 +1186,7 @@ public:
     bool LoadChainTip(const CChainParams& chainparams) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
 private:
+    bool WriteDisconnectedEffects(CValidationState& state, const CChainParams& chainparams, DisconnectedBlockEffects& effects) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     bool ActivateBestChainStep(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexMostWork, const std::shared_ptr<const CBlock>& pblock, bool& fInvalidFound, ConnectTrace& connectTrace) EXCLUSIVE_LOCKS_REQUIRED(cs_main, ::mempool.cs);
     bool ConnectTip(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexNew, const std::shared_ptr<const CBlock>& pblock, ConnectTrace& connectTrace, DisconnectedBlockTransactions& disconnectpool) EXCLUSIVE_LOCKS_REQUIRED(cs_main, ::mempool.cs);
 
@@ -1010,12 +1255,27 @@ static const unsigned int REJECT_HIGHFEE = 0x100;
 /** Get block file info entry for one block file */
 CBlockFileInfo* GetBlockFileInfo(size_t n);
 
-/** Dump the mempool to disk. */
+/** Microseconds spent in the parts of block connection since startup */
+struct BlockConnectTimes
+{
+    int64_t blocks;
+    //! Parts named by their position, "connect.verify" is a part of "connect"
+    std::vector<std::pair<std::string, int64_t>> parts;
+};
+BlockConnectTimes GetBlockConnectTimes() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+/** Dump the mempool to disk, folding mempool.journal into it when the pool has one. */
 bool DumpMempool(const CTxMemPool& pool);
 
+/** Write mempool.dat, on_copied is called with the pool lock held once the pool was copied. */
+bool WriteMempoolSnapshot(const CTxMemPool& pool, const std::function<void()>& on_copied);
+
 /** Load the mempool from disk. */
 bool LoadMempool(CTxMemPool& pool);
 
+/** Load the mempool from disk, replaying the changes of mempool.journal on top of mempool.dat. */
+bool LoadMempool(CTxMemPool& pool, const MempoolJournalContents& journal);
+
 //! Check whether the block associated with this index entry is pruned or not.
 inline bool IsBlockPruned(const CBlockIndex* pblockindex)
 {
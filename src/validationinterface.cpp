@@ -7,8 +7,10 @@
 
 #include <primitives/block.h>
 #include <scheduler.h>
+#include <sync.h>
 #include <txmempool.h>
 
+#include <algorithm>
 #include <list>
 #include <atomic>
 #include <future>
@@ -27,6 +29,74 @@ struct ValidationInterfaceConnections {
     boost::signals2::scoped_connection NewPoWValidBlock;
 };
 
+/**
+ * Runs the callbacks of one subscriber in order on a queue of its own. The shared queue only
+ * hands the events over, so a slow subscriber no longer counts against CallbacksPending, only
+ * against MaxSubscriberCallbacksPending.
+ */
+class QueuedValidationInterface final : public CValidationInterface {
+public:
+    QueuedValidationInterface(CValidationInterface* listener, CScheduler* scheduler, const std::string& name) : m_listener(listener), m_name(name), m_scheduler(scheduler), m_schedulerClient(scheduler) {}
+
+    CValidationInterface* const m_listener;
+    const std::string m_name;
+    CScheduler* const m_scheduler;
+    SingleThreadedSchedulerClient m_schedulerClient;
+
+    /** Block until the callbacks queued so far ran */
+    void Sync() {
+        // at shutdown the scheduler thread is gone and the queue runs on the calling thread
+        if (!m_scheduler->AreThreadsServicingQueue()) {
+            m_schedulerClient.EmptyQueue();
+            return;
+        }
+        std::promise<void> promise;
+        m_schedulerClient.AddToProcessQueue([&promise] {
+            promise.set_value();
+        });
+        promise.get_future().wait();
+    }
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override {
+        m_schedulerClient.AddToProcessQueue([this, pindexNew, pindexFork, fInitialDownload] {
+            m_listener->UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
+        });
+    }
+    void TransactionAddedToMempool(const CTransactionRef &ptxn) override {
+        m_schedulerClient.AddToProcessQueue([this, ptxn] {
+            m_listener->TransactionAddedToMempool(ptxn);
+        });
+    }
+    void TransactionRemovedFromMempool(const CTransactionRef &ptx) override {
+        m_schedulerClient.AddToProcessQueue([this, ptx] {
+            m_listener->TransactionRemovedFromMempool(ptx);
+        });
+    }
+    void BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex, const std::vector<CTransactionRef> &txnConflicted) override {
+        m_schedulerClient.AddToProcessQueue([this, block, pindex, txnConflicted] {
+            m_listener->BlockConnected(block, pindex, txnConflicted);
+        });
+    }
+    void BlockDisconnected(const std::shared_ptr<const CBlock> &block) override {
+        m_schedulerClient.AddToProcessQueue([this, block] {
+            m_listener->BlockDisconnected(block);
+        });
+    }
+    void ChainStateFlushed(const CBlockLocator &locator) override {
+        m_schedulerClient.AddToProcessQueue([this, locator] {
+            m_listener->ChainStateFlushed(locator);
+        });
+    }
+    // BlockChecked and NewPoWValidBlock are synchronous by contract
+    void BlockChecked(const CBlock& block, const CValidationState& state) override {
+        m_listener->BlockChecked(block, state);
+    }
+    void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block) override {
+        m_listener->NewPoWValidBlock(pindex, block);
+    }
+};
+
 struct MainSignalsInstance {
     boost::signals2::signal<void (const CBlockIndex *, const CBlockIndex *, bool fInitialDownload)> UpdatedBlockTip;
     boost::signals2::signal<void (const CTransactionRef &)> TransactionAddedToMempool;
@@ -43,7 +113,11 @@ struct MainSignalsInstance {
     SingleThreadedSchedulerClient m_schedulerClient;
     std::unordered_map<CValidationInterface*, ValidationInterfaceConnections> m_connMainSignals;
 
-    explicit MainSignalsInstance(CScheduler *pscheduler) : m_schedulerClient(pscheduler) {}
+    CScheduler* const m_scheduler;
+    Mutex m_queued_mutex;
+    std::unordered_map<CValidationInterface*, std::shared_ptr<QueuedValidationInterface>> m_queued GUARDED_BY(m_queued_mutex);
+
+    explicit MainSignalsInstance(CScheduler *pscheduler) : m_schedulerClient(pscheduler), m_scheduler(pscheduler) {}
 };
 
 static CMainSignals g_signals;
@@ -65,6 +139,10 @@ void CMainSignals::UnregisterBackgroundSignalScheduler() {
 void CMainSignals::FlushBackgroundCallbacks() {
     if (m_internals) {
         m_internals->m_schedulerClient.EmptyQueue();
+        LOCK(m_internals->m_queued_mutex);
+        for (const auto& queued : m_internals->m_queued) {
+            queued.second->m_schedulerClient.EmptyQueue();
+        }
     }
 }
 
@@ -73,6 +151,29 @@ size_t CMainSignals::CallbacksPending() {
     return m_internals->m_schedulerClient.CallbacksPending();
 }
 
+size_t CMainSignals::MaxSubscriberCallbacksPending() {
+    if (!m_internals) return 0;
+    size_t result = 0;
+    LOCK(m_internals->m_queued_mutex);
+    for (const auto& queued : m_internals->m_queued) {
+        result = std::max(result, queued.second->m_schedulerClient.CallbacksPending());
+    }
+    return result;
+}
+
+std::vector<CMainSignals::QueueInfo> CMainSignals::GetQueueInfo(bool reset_max) {
+    std::vector<QueueInfo> result;
+    if (!m_internals) return result;
+    result.push_back({"validation", m_internals->m_schedulerClient.CallbacksPending(), m_internals->m_schedulerClient.MaxCallbacksPending(reset_max)});
+    LOCK(m_internals->m_queued_mutex);
+    for (const auto& queued : m_internals->m_queued) {
+        SingleThreadedSchedulerClient& client = queued.second->m_schedulerClient;
+        result.push_back({queued.second->m_name, client.CallbacksPending(), client.MaxCallbacksPending(reset_max)});
+    }
+    std::sort(result.begin() + 1, result.end(), [](const QueueInfo& a, const QueueInfo& b) { return a.name < b.name; });
+    return result;
+}
+
 void CMainSignals::RegisterWithMempoolSignals(CTxMemPool& pool) {
     g_connNotifyEntryRemoved.emplace(std::piecewise_construct,
         std::forward_as_tuple(&pool),
@@ -114,6 +215,32 @@ void UnregisterAllValidationInterfaces() {
     g_signals.m_internals->m_connMainSignals.clear();
 }
 
+void RegisterQueuedValidationInterface(CValidationInterface* pwalletIn, const std::string& name) {
+    auto queued = std::make_shared<QueuedValidationInterface>(pwalletIn, g_signals.m_internals->m_scheduler, name);
+    {
+        LOCK(g_signals.m_internals->m_queued_mutex);
+        g_signals.m_internals->m_queued[pwalletIn] = queued;
+    }
+    RegisterValidationInterface(queued.get());
+}
+
+void UnregisterQueuedValidationInterface(CValidationInterface* pwalletIn) {
+    if (!g_signals.m_internals) {
+        return;
+    }
+    std::shared_ptr<QueuedValidationInterface> queued;
+    {
+        LOCK(g_signals.m_internals->m_queued_mutex);
+        auto it = g_signals.m_internals->m_queued.find(pwalletIn);
+        if (it == g_signals.m_internals->m_queued.end()) return;
+        queued = it->second;
+        g_signals.m_internals->m_queued.erase(it);
+    }
+    UnregisterValidationInterface(queued.get());
+    // the callbacks still queued may use the wallet, which is about to go away
+    queued->Sync();
+}
+
 void CallFunctionInValidationInterfaceQueue(std::function<void ()> func) {
     g_signals.m_internals->m_schedulerClient.AddToProcessQueue(std::move(func));
 }
@@ -126,6 +253,18 @@ void SyncWithValidationInterfaceQueue() {
         promise.set_value();
     });
     promise.get_future().wait();
+
+    // then until the subscribers with queues of their own ran what the validation queue handed over
+    std::vector<std::shared_ptr<QueuedValidationInterface>> queued;
+    {
+        LOCK(g_signals.m_internals->m_queued_mutex);
+        for (const auto& item : g_signals.m_internals->m_queued) {
+            queued.push_back(item.second);
+        }
+    }
+    for (const auto& subscriber : queued) {
+        subscriber->Sync();
+    }
 }
 
 void CMainSignals::MempoolEntryRemoved(CTransactionRef ptx, MemPoolRemovalReason reason) {
@@ -11,8 +11,13 @@
 
 #include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 
 extern CCriticalSection cs_main;
+
+/** Callbacks pending on the queue of one subscriber before block connection waits for the queues to drain */
+static const size_t MAX_SUBSCRIBER_CALLBACKS_PENDING = 100;
 class CBlock;
 class CBlockIndex;
 struct CBlockLocator;
@@ -32,6 +37,16 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn);
 void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
 void UnregisterAllValidationInterfaces();
+/**
+ * Register a subscriber whose callbacks are queued apart from the shared notification queue, so
+ * that its processing does not hold up the other subscribers. The queues are serviced by all the
+ * scheduler threads, the callbacks of one subscriber still run one at a time and in order.
+ * SyncWithValidationInterfaceQueue also waits for these queues. The name shows in the queue
+ * statistics.
+ */
+void RegisterQueuedValidationInterface(CValidationInterface* pwalletIn, const std::string& name);
+/** Unregister a wallet registered with RegisterQueuedValidationInterface, after running its queued callbacks */
+void UnregisterQueuedValidationInterface(CValidationInterface* pwalletIn) LOCKS_EXCLUDED(cs_main);
 /**
  * Pushes a function to callback onto the notification queue, guaranteeing any
  * callbacks generated prior to now are finished when the function is called.
@@ -146,6 +161,7 @@ protected:
     friend void ::RegisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
+    friend class QueuedValidationInterface;
 };
 
 struct MainSignalsInstance;
@@ -157,6 +173,9 @@ private:
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
     friend void ::CallFunctionInValidationInterfaceQueue(std::function<void ()> func);
+    friend void ::RegisterQueuedValidationInterface(CValidationInterface*, const std::string&);
+    friend void ::UnregisterQueuedValidationInterface(CValidationInterface*);
+    friend void ::SyncWithValidationInterfaceQueue();
 
     void MempoolEntryRemoved(CTransactionRef tx, MemPoolRemovalReason reason);
 
@@ -170,6 +189,18 @@ public:
 
     size_t CallbacksPending();
 
+    /** The most callbacks pending on the queue of one subscriber registered with RegisterQueuedValidationInterface */
+    size_t MaxSubscriberCallbacksPending();
+
+    struct QueueInfo {
+        std::string name;
+        size_t pending;
+        //! The most callbacks pending at once since the start or the last reset
+        size_t max_pending;
+    };
+    /** The depth of the shared notification queue, named "validation", followed by those of the subscriber queues */
+    std::vector<QueueInfo> GetQueueInfo(bool reset_max = false);
+
     /** Register with mempool to call TransactionRemovedFromMempool callbacks */
     void RegisterWithMempoolSignals(CTxMemPool& pool);
     /** Unregister with mempool */
@@ -167,24 +167,24 @@ bool SelectCoinsBnB(std::vector<OutputGroup>& utxo_pool, const CAmount& target_v
     return true;
 }
 
-static void ApproximateBestSubset(const std::vector<OutputGroup>& groups, const CAmount& nTotalLower, const CAmount& nTargetValue,
+static void ApproximateBestSubset(const std::vector<CAmount>& values, const CAmount& nTotalLower, const CAmount& nTargetValue,
                                   std::vector<char>& vfBest, CAmount& nBest, int iterations = 1000)
 {
     std::vector<char> vfIncluded;
 
-    vfBest.assign(groups.size(), true);
+    vfBest.assign(values.size(), true);
     nBest = nTotalLower;
 
     FastRandomContext insecure_rand;
 
     for (int nRep = 0; nRep < iterations && nBest != nTargetValue; nRep++)
     {
-        vfIncluded.assign(groups.size(), false);
+        vfIncluded.assign(values.size(), false);
         CAmount nTotal = 0;
         bool fReachedTarget = false;
         for (int nPass = 0; nPass < 2 && !fReachedTarget; nPass++)
         {
-            for (unsigned int i = 0; i < groups.size(); i++)
+            for (unsigned int i = 0; i < values.size(); i++)
             {
                 //The solver here uses a randomized algorithm,
                 //the randomness serves no real security purpose but is just
@@ -194,7 +194,7 @@ static void ApproximateBestSubset(const std::vector<OutputGroup>& groups, const
                 //the selection random.
                 if (nPass == 0 ? insecure_rand.randbool() : !vfIncluded[i])
                 {
-                    nTotal += groups[i].m_value;
+                    nTotal += values[i];
                     vfIncluded[i] = true;
                     if (nTotal >= nTargetValue)
                     {
@@ -204,7 +204,7 @@ static void ApproximateBestSubset(const std::vector<OutputGroup>& groups, const
                             nBest = nTotal;
                             vfBest = vfIncluded;
                         }
-                        nTotal -= groups[i].m_value;
+                        nTotal -= values[i];
                         vfIncluded[i] = false;
                     }
                 }
@@ -218,62 +218,71 @@ bool KnapsackSolver(const CAmount& nTargetValue, std::vector<OutputGroup>& group
     setCoinsRet.clear();
     nValueRet = 0;
 
-    // List of values less than target
-    boost::optional<OutputGroup> lowest_larger;
-    std::vector<OutputGroup> applicable_groups;
+    // List of values less than target, as indices into groups so that large wallets do not copy
+    // every group with its outputs
+    boost::optional<size_t> lowest_larger;
+    std::vector<size_t> applicable_groups;
     CAmount nTotalLower = 0;
 
     Shuffle(groups.begin(), groups.end(), FastRandomContext());
 
-    for (const OutputGroup& group : groups) {
+    for (size_t i = 0; i < groups.size(); ++i) {
+        const OutputGroup& group = groups[i];
         if (group.m_value == nTargetValue) {
             util::insert(setCoinsRet, group.m_outputs);
             nValueRet += group.m_value;
             return true;
         } else if (group.m_value < nTargetValue + MIN_CHANGE) {
-            applicable_groups.push_back(group);
+            applicable_groups.push_back(i);
             nTotalLower += group.m_value;
-        } else if (!lowest_larger || group.m_value < lowest_larger->m_value) {
-            lowest_larger = group;
+        } else if (!lowest_larger || group.m_value < groups[*lowest_larger].m_value) {
+            lowest_larger = i;
         }
     }
 
     if (nTotalLower == nTargetValue) {
-        for (const auto& group : applicable_groups) {
-            util::insert(setCoinsRet, group.m_outputs);
-            nValueRet += group.m_value;
+        for (size_t i : applicable_groups) {
+            util::insert(setCoinsRet, groups[i].m_outputs);
+            nValueRet += groups[i].m_value;
         }
         return true;
     }
 
     if (nTotalLower < nTargetValue) {
         if (!lowest_larger) return false;
-        util::insert(setCoinsRet, lowest_larger->m_outputs);
-        nValueRet += lowest_larger->m_value;
+        util::insert(setCoinsRet, groups[*lowest_larger].m_outputs);
+        nValueRet += groups[*lowest_larger].m_value;
         return true;
     }
 
     // Solve subset sum by stochastic approximation
-    std::sort(applicable_groups.begin(), applicable_groups.end(), descending);
+    std::sort(applicable_groups.begin(), applicable_groups.end(), [&groups](size_t a, size_t b) {
+        return descending(groups[a], groups[b]);
+    });
+    std::vector<CAmount> applicable_values;
+    applicable_values.reserve(applicable_groups.size());
+    for (size_t i : applicable_groups) {
+        applicable_values.push_back(groups[i].m_value);
+    }
     std::vector<char> vfBest;
     CAmount nBest;
 
-    ApproximateBestSubset(applicable_groups, nTotalLower, nTargetValue, vfBest, nBest);
+    ApproximateBestSubset(applicable_values, nTotalLower, nTargetValue, vfBest, nBest);
     if (nBest != nTargetValue && nTotalLower >= nTargetValue + MIN_CHANGE) {
-        ApproximateBestSubset(applicable_groups, nTotalLower, nTargetValue + MIN_CHANGE, vfBest, nBest);
+        ApproximateBestSubset(applicable_values, nTotalLower, nTargetValue + MIN_CHANGE, vfBest, nBest);
     }
 
     // If we have a bigger coin and (either the stochastic approximation didn't find a good solution,
     //                                   or the next bigger coin is closer), return the bigger coin
     if (lowest_larger &&
-        ((nBest != nTargetValue && nBest < nTargetValue + MIN_CHANGE) || lowest_larger->m_value <= nBest)) {
-        util::insert(setCoinsRet, lowest_larger->m_outputs);
-        nValueRet += lowest_larger->m_value;
+        ((nBest != nTargetValue && nBest < nTargetValue + MIN_CHANGE) || groups[*lowest_larger].m_value <= nBest)) {
+        util::insert(setCoinsRet, groups[*lowest_larger].m_outputs);
+        nValueRet += groups[*lowest_larger].m_value;
     } else {
         for (unsigned int i = 0; i < applicable_groups.size(); i++) {
             if (vfBest[i]) {
-                util::insert(setCoinsRet, applicable_groups[i].m_outputs);
-                nValueRet += applicable_groups[i].m_value;
+                util::insert(setCoinsRet, groups[applicable_groups[i]].m_outputs);
+                nValueRet += applicable_values[i];
             }
         }
 
@@ -281,7 +290,7 @@ bool KnapsackSolver(const CAmount& nTargetValue, std::vector<OutputGroup>& group
             LogPrint(BCLog::SELECTCOINS, "SelectCoins() best subset: "); /* Continued */
             for (unsigned int i = 0; i < applicable_groups.size(); i++) {
                 if (vfBest[i]) {
-                    LogPrint(BCLog::SELECTCOINS, "%s ", FormatMoney(applicable_groups[i].m_value)); /* Continued */
+                    LogPrint(BCLog::SELECTCOINS, "%s ", FormatMoney(applicable_values[i])); /* Continued */
                 }
             }
             LogPrint(BCLog::SELECTCOINS, "total %s\n", FormatMoney(nBest));
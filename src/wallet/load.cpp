@@ -85,6 +85,9 @@ void StartWallets(CScheduler& scheduler)
     // Schedule periodic wallet flushes and tx rebroadcasts
     scheduler.scheduleEvery(MaybeCompactWalletDB, 500);
     scheduler.scheduleEvery(MaybeResendWalletTxs, 1000);
+    if (gArgs.GetBoolArg("-stakeconsolidation", DEFAULT_STAKE_CONSOLIDATION)) {
+        scheduler.scheduleEvery(MaybeConsolidateStakes, STAKE_CONSOLIDATION_INTERVAL);
+    }
 }
 
 void FlushWallets()
@@ -254,6 +254,28 @@ bool SetDefaultSignSenderAddress(CWallet* const pwallet, interfaces::Chain::Lock
     return !boost::get<CNoDestination>(&destAdress);
 }
 
+/** The EVM sender of a contract transaction signed by dest, null when the sender is not known yet */
+static dev::Address GetContractSender(CWallet* const pwallet, const CTxDestination& dest)
+{
+    CKeyID key_id = GetKeyForDestination(*pwallet, dest);
+    return key_id.IsNull() ? dev::Address() : dev::Address(HexStr(key_id.begin(), key_id.end()));
+}
+
+/** Gas limit for a contract transaction sent without one, estimated on the tip with GAS_ESTIMATE_MARGIN_PERCENT on top */
+static uint64_t EstimateGasLimit(const ContractCallParams& call, uint64_t blockGasLimit)
+{
+    uint64_t gasLimit = 0;
+    ResultExecute result;
+    if (!EstimateContractGas(call, gasLimit, result)) {
+        std::stringstream ss;
+        ss << result.execRes.excepted;
+        std::string message = exceptedMessage(result.execRes.excepted, result.execRes.output);
+        throw JSONRPCError(RPC_WALLET_ERROR, "The contract execution fails: " + ss.str() + (message.empty() ? "" : ", " + message) + " (pass a gasLimit to send it anyway)");
+    }
+    gasLimit += gasLimit * GAS_ESTIMATE_MARGIN_PERCENT / 100;
+    return std::min(std::max(gasLimit, MINIMUM_GAS_LIMIT), blockGasLimit);
+}
+
 static UniValue getnewaddress(const JSONRPCRequest& request)
 {
     std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
@@ -583,6 +605,18 @@ static UniValue sendtoaddress(const JSONRPCRequest& request)
     return tx->GetHash().GetHex();
 }
 
+/** Default gas price of contract transactions, estimated for the wallet confirmation target when there is enough data */
+static CAmount GetDefaultGasPrice(CWallet& wallet, CAmount minGasPrice)
+{
+    CAmount nGasPrice = wallet.chain().estimateGasPrice(wallet.m_confirm_target);
+    if (nGasPrice <= 0) {
+        nGasPrice = DEFAULT_GAS_PRICE;
+    } else {
+        nGasPrice = std::min(nGasPrice, (CAmount)gArgs.GetArg("-rpcmaxgasprice", MAX_RPC_GAS_PRICE));
+    }
+    return std::max(nGasPrice, minGasPrice);
+}
+
 static UniValue createcontract(const JSONRPCRequest& request){
 
     std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
@@ -597,14 +631,14 @@ static UniValue createcontract(const JSONRPCRequest& request){
     QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
     uint64_t blockGasLimit = qtumDGP.getBlockGasLimit(::ChainActive().Height());
     uint64_t minGasPrice = CAmount(qtumDGP.getMinGasPrice(::ChainActive().Height()));
-    CAmount nGasPrice = (minGasPrice>DEFAULT_GAS_PRICE)?minGasPrice:DEFAULT_GAS_PRICE;
+    CAmount nGasPrice = GetDefaultGasPrice(*pwallet, minGasPrice);
 
                 RPCHelpMan{"createcontract",
                 "\nCreate a contract with bytcode." +
                 HelpRequiringPassphrase(pwallet) + "\n",
                 {
                     {"bytecode", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "contract bytcode."},
-                    {"gasLimit", RPCArg::Type::AMOUNT, RPCArg::Optional::OMITTED, "gasLimit, default: "+i64tostr(DEFAULT_GAS_LIMIT_OP_CREATE)+", max: "+i64tostr(blockGasLimit)},
+                    {"gasLimit", RPCArg::Type::AMOUNT, RPCArg::Optional::OMITTED, "gasLimit, default: estimated plus "+i64tostr(GAS_ESTIMATE_MARGIN_PERCENT)+"%, max: "+i64tostr(blockGasLimit)},
                     {"gasPrice", RPCArg::Type::AMOUNT, RPCArg::Optional::OMITTED, "gasPrice MRX price per gas unit, default: "+FormatMoney(nGasPrice)+", min:"+FormatMoney(minGasPrice)},
                     {"senderaddress", RPCArg::Type::STR_HEX, RPCArg::Optional::OMITTED, "The metrix address that will be used to create the contract."},
                     {"broadcast", RPCArg::Type::BOOL, RPCArg::Optional::OMITTED, "Whether to broadcast the transaction or not."},
@@ -633,7 +667,8 @@ static UniValue createcontract(const JSONRPCRequest& request){
         throw JSONRPCError(RPC_TYPE_ERROR, "Invalid data (data not hex)");
 
     uint64_t nGasLimit=DEFAULT_GAS_LIMIT_OP_CREATE;
-    if (request.params.size() > 1){
+    bool fEstimateGas = request.params.size() <= 1 || request.params[1].isNull();
+    if (!fEstimateGas){
         nGasLimit = request.params[1].get_int64();
         if (nGasLimit > blockGasLimit)
             throw JSONRPCError(RPC_TYPE_ERROR, "Invalid value for gasLimit (Maximum is: "+i64tostr(blockGasLimit)+")");
@@ -730,6 +765,11 @@ static UniValue createcontract(const JSONRPCRequest& request){
             SetDefaultSignSenderAddress(pwallet, *locked_chain, signSenderAddress);
         }
     }
+
+    if (fEstimateGas) {
+        dev::Address sender = GetContractSender(pwallet, IsValidDestination(signSenderAddress) ? signSenderAddress : senderAddress);
+        nGasLimit = EstimateGasLimit(ContractCallParams{dev::Address(), ParseHex(bytecode), sender, 0, 0}, blockGasLimit);
+    }
     EnsureWalletIsUnlocked(pwallet);
 
     CAmount nGasFee=nGasPrice*nGasLimit;
@@ -843,7 +883,7 @@ static UniValue sendtocontract(const JSONRPCRequest& request){
     QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
     uint64_t blockGasLimit = qtumDGP.getBlockGasLimit(::ChainActive().Height());
     uint64_t minGasPrice = CAmount(qtumDGP.getMinGasPrice(::ChainActive().Height()));
-    CAmount nGasPrice = (minGasPrice>DEFAULT_GAS_PRICE)?minGasPrice:DEFAULT_GAS_PRICE;
+    CAmount nGasPrice = GetDefaultGasPrice(*pwallet, minGasPrice);
 
                 RPCHelpMan{"sendtocontract",
                     "\nSend funds and data to a contract." +
@@ -852,7 +892,7 @@ static UniValue sendtocontract(const JSONRPCRequest& request){
                         {"contractaddress", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The contract address that will receive the funds and data."},
                         {"datahex", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "data to send."},
                         {"amount", RPCArg::Type::AMOUNT, RPCArg::Optional::OMITTED, "The amount in " + CURRENCY_UNIT + " to send. eg 0.1, default: 0"},
-                        {"gasLimit", RPCArg::Type::AMOUNT, RPCArg::Optional::OMITTED, "gasLimit, default: "+i64tostr(DEFAULT_GAS_LIMIT_OP_SEND)+", max: "+i64tostr(blockGasLimit)},
+                        {"gasLimit", RPCArg::Type::AMOUNT, RPCArg::Optional::OMITTED, "gasLimit, default: estimated plus "+i64tostr(GAS_ESTIMATE_MARGIN_PERCENT)+"%, max: "+i64tostr(blockGasLimit)},
                         {"gasPrice", RPCArg::Type::AMOUNT, RPCArg::Optional::OMITTED, "gasPrice Metrix price per gas unit, default: "+FormatMoney(nGasPrice)+", min:"+FormatMoney(minGasPrice)},
                         {"senderaddress", RPCArg::Type::STR_HEX, RPCArg::Optional::OMITTED, "The metrix address that will be used as sender."},
                         {"broadcast", RPCArg::Type::BOOL, RPCArg::Optional::OMITTED, "Whether to broadcast the transaction or not."},
@@ -894,7 +934,8 @@ static UniValue sendtocontract(const JSONRPCRequest& request){
     }
 
     uint64_t nGasLimit=DEFAULT_GAS_LIMIT_OP_SEND;
-    if (request.params.size() > 3){
+    bool fEstimateGas = request.params.size() <= 3 || request.params[3].isNull();
+    if (!fEstimateGas){
         nGasLimit = request.params[3].get_int64();
         if (nGasLimit > blockGasLimit)
             throw JSONRPCError(RPC_TYPE_ERROR, "Invalid value for gasLimit (Maximum is: "+i64tostr(blockGasLimit)+")");
@@ -993,6 +1034,11 @@ static UniValue sendtocontract(const JSONRPCRequest& request){
         }
     }
 
+    if (fEstimateGas) {
+        dev::Address sender = GetContractSender(pwallet, IsValidDestination(signSenderAddress) ? signSenderAddress : senderAddress);
+        nGasLimit = EstimateGasLimit(ContractCallParams{addrAccount, ParseHex(datahex), sender, 0, nAmount}, blockGasLimit);
+    }
+
     EnsureWalletIsUnlocked(pwallet);
 
     CAmount nGasFee=nGasPrice*nGasLimit;
@@ -2130,6 +2176,56 @@ static void ListTransactions(interfaces::Chain::Lock& locked_chain, CWallet* con
     }
 }
 
+/**
+ * Call fn with the txs of the wallet from the newest to the oldest, starting below the order
+ * position nBefore, until it returns false. With a label only the txs paying to its addresses
+ * are visited, merged from the index of the txs by destination rather than walking all txs.
+ */
+static void ForEachTxNewestFirst(CWallet* const pwallet, const std::string* filter_label, int64_t nBefore, const std::function<bool(int64_t, const CWalletTx&)>& fn) EXCLUSIVE_LOCKS_REQUIRED(pwallet->cs_wallet)
+{
+    typedef CWallet::TxItems::const_reverse_iterator TxItemsRit;
+    if (!filter_label) {
+        for (TxItemsRit it(pwallet->wtxOrdered.lower_bound(nBefore)); it != pwallet->wtxOrdered.rend(); ++it) {
+            if (!fn(it->first, *it->second)) return;
+        }
+        return;
+    }
+
+    std::vector<std::pair<TxItemsRit, TxItemsRit>> ranges;
+    for (const std::pair<const CTxDestination, CAddressBookData>& item : pwallet->mapAddressBook) {
+        if (item.second.name != *filter_label) continue;
+        auto it = pwallet->m_wtx_by_destination.find(item.first);
+        if (it == pwallet->m_wtx_by_destination.end()) continue;
+        TxItemsRit first(it->second.lower_bound(nBefore));
+        if (first != it->second.rend()) ranges.emplace_back(first, it->second.rend());
+    }
+    // Heap of the ranges by their newest tx not visited yet
+    auto older = [](const std::pair<TxItemsRit, TxItemsRit>& a, const std::pair<TxItemsRit, TxItemsRit>& b) {
+        return a.first->first < b.first->first;
+    };
+    std::make_heap(ranges.begin(), ranges.end(), older);
+    // A tx paying to several addresses with the label is in several ranges at the same position
+    int64_t nPos = 0;
+    std::set<const CWalletTx*> setVisited;
+    while (!ranges.empty()) {
+        std::pop_heap(ranges.begin(), ranges.end(), older);
+        std::pair<TxItemsRit, TxItemsRit>& range = ranges.back();
+        const int64_t nTxPos = range.first->first;
+        const CWalletTx* pwtx = range.first->second;
+        if (++range.first == range.second) {
+            ranges.pop_back();
+        } else {
+            std::push_heap(ranges.begin(), ranges.end(), older);
+        }
+        if (setVisited.empty() || nTxPos != nPos) {
+            setVisited.clear();
+            nPos = nTxPos;
+        }
+        if (!setVisited.insert(pwtx).second) continue;
+        if (!fn(nTxPos, *pwtx)) return;
+    }
+}
+
 UniValue listtransactions(const JSONRPCRequest& request)
 {
     std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
@@ -2141,13 +2237,18 @@ UniValue listtransactions(const JSONRPCRequest& request)
 
             RPCHelpMan{"listtransactions",
                 "\nIf a label name is provided, this will return only incoming transactions paying to addresses with the specified label.\n"
-                "\nReturns up to 'count' most recent transactions skipping the first 'from' transactions.\n",
+                "\nReturns up to 'count' most recent transactions skipping the first 'from' transactions.\n"
+                "\nWith a cursor the transactions are returned in pages that stay stable as new transactions arrive. Pass \"\" for the\n"
+                "most recent page, then the cursor returned with each page for the page of older transactions. A page ends with\n"
+                "all the entries of its oldest transaction, so it can hold more than 'count' entries.\n",
                 {
                     {"label", RPCArg::Type::STR, RPCArg::Optional::OMITTED_NAMED_ARG, "If set, should be a valid label name to return only incoming transactions\n"
             "              with the specified label, or \"*\" to disable filtering and return all transactions."},
                     {"count", RPCArg::Type::NUM, /* default */ "10", "The number of transactions to return"},
                     {"skip", RPCArg::Type::NUM, /* default */ "0", "The number of transactions to skip"},
                     {"include_watchonly", RPCArg::Type::BOOL, /* default */ "true for watch-only wallets, otherwise false", "Include transactions to watch-only addresses (see 'importaddress')"},
+                    {"cursor", RPCArg::Type::STR, RPCArg::Optional::OMITTED_NAMED_ARG, "If set, return the page of transactions older than this cursor, \"\" for the most recent page,\n"
+            "              as an object with the \"transactions\" and the \"cursor\" of the next page, which is \"\" after the oldest page"},
                 },
                 RPCResult{
             "[\n"
@@ -2187,6 +2288,8 @@ UniValue listtransactions(const JSONRPCRequest& request)
             + HelpExampleCli("listtransactions", "") +
             "\nList transactions 100 to 120\n"
             + HelpExampleCli("listtransactions", "\"*\" 20 100") +
+            "\nList the most recent page of 100 transactions, and the cursor of the next page\n"
+            + HelpExampleCli("listtransactions", "\"*\" 100 0 false \"\"") +
             "\nAs a JSON-RPC call\n"
             + HelpExampleRpc("listtransactions", "\"*\", 20, 100")
                 },
@@ -2220,25 +2323,43 @@ UniValue listtransactions(const JSONRPCRequest& request)
     if (nFrom < 0)
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative from");
 
+    // The cursor is the order position of the oldest transaction of the previous page
+    const bool fCursor = !request.params[4].isNull();
+    int64_t nBefore = std::numeric_limits<int64_t>::max();
+    if (fCursor) {
+        if (nFrom > 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Cannot skip transactions with a cursor");
+        const std::string& cursor = request.params[4].get_str();
+        if (!cursor.empty() && !ParseInt64(cursor, &nBefore))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+
     UniValue ret(UniValue::VARR);
+    bool fOldest = true;
+    int64_t nOldestPos = nBefore;
 
     {
         auto locked_chain = pwallet->chain().lock();
         LOCK(pwallet->cs_wallet);
 
-        const CWallet::TxItems & txOrdered = pwallet->wtxOrdered;
-
         // iterate backwards until we have nCount items to return:
-        for (CWallet::TxItems::const_reverse_iterator it = txOrdered.rbegin(); it != txOrdered.rend(); ++it)
-        {
-            CWalletTx *const pwtx = (*it).second;
-            ListTransactions(*locked_chain, pwallet, *pwtx, 0, true, ret, filter, filter_label);
-            if ((int)ret.size() >= (nCount+nFrom)) break;
-        }
+        ForEachTxNewestFirst(pwallet, filter_label, nBefore, [&](int64_t nPos, const CWalletTx& wtx) EXCLUSIVE_LOCKS_REQUIRED(pwallet->cs_wallet) {
+            if ((int)ret.size() >= (nCount+nFrom)) {
+                fOldest = false;
+                return false;
+            }
+            ListTransactions(*locked_chain, pwallet, wtx, 0, true, ret, filter, filter_label);
+            nOldestPos = nPos;
+            return true;
+        });
     }
 
     // ret is newest to oldest
 
+    // A page keeps all the entries of its oldest transaction, the next one starts below it
+    if (fCursor)
+        nCount = ret.size();
+
     if (nFrom > (int)ret.size())
         nFrom = ret.size();
     if ((nFrom + nCount) > (int)ret.size())
@@ -2260,6 +2381,13 @@ UniValue listtransactions(const JSONRPCRequest& request)
     ret.setArray();
     ret.push_backV(arrTmp);
 
+    if (fCursor) {
+        UniValue page(UniValue::VOBJ);
+        page.pushKV("transactions", ret);
+        page.pushKV("cursor", fOldest ? std::string() : i64tostr(nOldestPos));
+        return page;
+    }
+
     return ret;
 }
 
@@ -2367,11 +2495,31 @@ static UniValue listsinceblock(const JSONRPCRequest& request)
 
     UniValue transactions(UniValue::VARR);
 
-    for (const std::pair<const uint256, CWalletTx>& pairWtx : pwallet->mapWallet) {
-        CWalletTx tx = pairWtx.second;
+    if (depth == -1 || depth > (int)pwallet->mapWallet.size()) {
+        for (const std::pair<const uint256, CWalletTx>& pairWtx : pwallet->mapWallet) {
+            const CWalletTx& tx = pairWtx.second;
 
-        if (depth == -1 || tx.GetDepthInMainChain(*locked_chain) < depth) {
-            ListTransactions(*locked_chain, pwallet, tx, 0, true, transactions, filter, nullptr /* filter_label */);
+            if (depth == -1 || tx.GetDepthInMainChain(*locked_chain) < depth) {
+                ListTransactions(*locked_chain, pwallet, tx, 0, true, transactions, filter, nullptr /* filter_label */);
+            }
+        }
+    } else {
+        // Only the txs in the blocks after the given one, and the ones not confirmed in a block, have fewer confirmations
+        std::vector<const CWalletTx*> vTxs;
+        auto add_block = [&](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(pwallet->cs_wallet) {
+            auto it = pwallet->m_wtx_by_block.find(hash);
+            if (it != pwallet->m_wtx_by_block.end()) vTxs.insert(vTxs.end(), it->second.begin(), it->second.end());
+        };
+        add_block(uint256());
+        for (int h = *height + 1; h <= *tip_height; h++) {
+            add_block(locked_chain->getBlockHash(h));
+        }
+        // In the order of mapWallet, like when all the txs are walked
+        std::sort(vTxs.begin(), vTxs.end(), [](const CWalletTx* a, const CWalletTx* b) { return a->GetHash() < b->GetHash(); });
+        for (const CWalletTx* pwtx : vTxs) {
+            if (pwtx->GetDepthInMainChain(*locked_chain) < depth) {
+                ListTransactions(*locked_chain, pwallet, *pwtx, 0, true, transactions, filter, nullptr /* filter_label */);
+            }
         }
     }
 
@@ -2789,6 +2937,10 @@ static UniValue walletpassphrase(const JSONRPCRequest& request)
 
     pwallet->TopUpKeyPool();
 
+    if (pwallet->m_wallet_unlock_staking_only) {
+        pwallet->CacheStakingKeys(*locked_chain);
+    }
+
     pwallet->nRelockTime = GetTime() + nSleepTime;
 
     // Keep a weak pointer to the wallet so that it is possible to unload the
@@ -5322,7 +5474,7 @@ static const CRPCCommand commands[] =
     { "wallet",             "listreceivedbyaddress",            &listreceivedbyaddress,         {"minconf","include_empty","include_watchonly","address_filter"} },
     { "wallet",             "listreceivedbylabel",              &listreceivedbylabel,           {"minconf","include_empty","include_watchonly"} },
     { "wallet",             "listsinceblock",                   &listsinceblock,                {"blockhash","target_confirmations","include_watchonly","include_removed"} },
-    { "wallet",             "listtransactions",                 &listtransactions,              {"label|dummy","count","skip","include_watchonly"} },
+    { "wallet",             "listtransactions",                 &listtransactions,              {"label|dummy","count","skip","include_watchonly","cursor"} },
     { "wallet",             "listunspent",                      &listunspent,                   {"minconf","maxconf","addresses","include_unsafe","query_options"} },
     { "wallet",             "listwalletdir",                    &listwalletdir,                 {} },
     { "wallet",             "listwallets",                      &listwallets,                   {} },
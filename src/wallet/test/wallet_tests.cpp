@@ -327,6 +327,34 @@ BOOST_AUTO_TEST_CASE(ComputeTimeSmart)
     SetMockTime(0);
 }
 
+BOOST_AUTO_TEST_CASE(WalletTxIndexes)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CTxDestination dest = PKHash(key.GetPubKey());
+    CMutableTransaction mtx;
+    mtx.vout.emplace_back(COIN, GetScriptForDestination(dest));
+    mtx.vout.emplace_back(COIN, GetScriptForDestination(dest));
+    CWalletTx wtx(&m_wallet, MakeTransactionRef(mtx));
+    const uint256 block_hash = GetRandHash();
+
+    LOCK(m_wallet.cs_wallet);
+    wtx.SetConf(CWalletTx::Status::CONFIRMED, block_hash, 0);
+    m_wallet.AddToWallet(wtx);
+    CWalletTx& indexed = m_wallet.mapWallet.at(wtx.GetHash());
+
+    // Indexed once under its destination, even with two outputs paying to it
+    BOOST_CHECK_EQUAL(m_wallet.m_wtx_by_destination.at(dest).size(), 1U);
+    BOOST_CHECK(m_wallet.m_wtx_by_destination.at(dest).begin()->second == &indexed);
+    BOOST_CHECK(m_wallet.m_wtx_by_block.at(block_hash).count(&indexed));
+
+    // Unconfirmed txs move under the null hash
+    wtx.SetConf(CWalletTx::Status::UNCONFIRMED, uint256(), 0);
+    m_wallet.AddToWallet(wtx);
+    BOOST_CHECK(!m_wallet.m_wtx_by_block.count(block_hash));
+    BOOST_CHECK(m_wallet.m_wtx_by_block.at(uint256()).count(&indexed));
+}
+
 BOOST_AUTO_TEST_CASE(LoadReceiveRequests)
 {
     CTxDestination dest = PKHash();
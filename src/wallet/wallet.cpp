@@ -9,6 +9,7 @@
 #include <consensus/consensus.h>
 #include <consensus/validation.h>
 #include <fs.h>
+#include <index/blockfilterindex.h>
 #include <interfaces/chain.h>
 #include <interfaces/wallet.h>
 #include <key.h>
@@ -17,10 +18,12 @@
 #include <policy/policy.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
+#include <qtum/storageresults.h>
 #include <script/descriptor.h>
 #include <script/script.h>
 #include <script/signingprovider.h>
 #include <util/bip32.h>
+#include <util/convert.h>
 #include <util/error.h>
 #include <util/fees.h>
 #include <util/moneystr.h>
@@ -35,6 +38,7 @@
 #include <algorithm>
 #include <assert.h>
 #include <future>
+#include <thread>
 
 #include <boost/algorithm/string/replace.hpp>
 
@@ -501,8 +505,12 @@ bool CWallet::AddCScript(const CScript& redeemScript)
 
 bool CWallet::AddCScriptWithDB(WalletBatch& batch, const CScript& redeemScript)
 {
-    if (!FillableSigningProvider::AddCScript(redeemScript))
-        return false;
+    {
+        LOCK(cs_KeyStore);
+        if (!FillableSigningProvider::AddCScript(redeemScript))
+            return false;
+        ClearIsMineCache();
+    }
     if (batch.WriteCScript(Hash160(redeemScript), redeemScript)) {
         UnsetWalletFlagWithDB(batch, WALLET_FLAG_BLANK_WALLET);
         return true;
@@ -522,6 +530,8 @@ bool CWallet::LoadCScript(const CScript& redeemScript)
         return true;
     }
 
+    LOCK(cs_KeyStore);
+    ClearIsMineCache();
     return FillableSigningProvider::AddCScript(redeemScript);
 }
 
@@ -535,6 +545,7 @@ static bool ExtractPubKey(const CScript &dest, CPubKey& pubKeyOut)
 bool CWallet::AddWatchOnlyInMem(const CScript &dest)
 {
     LOCK(cs_KeyStore);
+    ClearIsMineCache();
     setWatchOnly.insert(dest);
     CPubKey pubKey;
     if (ExtractPubKey(dest, pubKey)) {
@@ -581,6 +592,7 @@ bool CWallet::RemoveWatchOnly(const CScript &dest)
     AssertLockHeld(cs_wallet);
     {
         LOCK(cs_KeyStore);
+        ClearIsMineCache();
         setWatchOnly.erase(dest);
         CPubKey pubKey;
         if (ExtractPubKey(dest, pubKey)) {
@@ -590,6 +602,8 @@ bool CWallet::RemoveWatchOnly(const CScript &dest)
         // harmless (see comment in ImplicitlyLearnRelatedKeyScripts).
     }
 
+    InvalidateStakeableCoins();
+
     if (!HaveWatchOnly())
         NotifyWatchonlyChanged(false);
     if (!WalletBatch(*database).EraseWatchOnly(dest))
@@ -1043,12 +1057,23 @@ int64_t CWallet::IncOrderPosNext(WalletBatch* batch)
     return nRet;
 }
 
+void CWalletTx::MarkDirty()
+{
+    m_amounts[DEBIT].Reset();
+    m_amounts[CREDIT].Reset();
+    m_amounts[IMMATURE_CREDIT].Reset();
+    m_amounts[AVAILABLE_CREDIT].Reset();
+    fChangeCached = false;
+    if (pwallet) pwallet->MarkBalanceDirty();
+}
+
 void CWallet::MarkDirty()
 {
     {
         LOCK(cs_wallet);
         for (std::pair<const uint256, CWalletTx>& item : mapWallet)
             item.second.MarkDirty();
+        InvalidateStakeableCoins();
     }
 }
 
@@ -1137,6 +1162,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
         wtx.nTimeReceived = chain().getAdjustedTime();
         wtx.nOrderPos = IncOrderPosNext(&batch);
         wtx.m_it_wtxOrdered = wtxOrdered.insert(std::make_pair(wtx.nOrderPos, &wtx));
+        AddToTxIndexes(wtx);
         wtx.nTimeSmart = ComputeTimeSmart(wtx);
         AddToSpends(hash);
     }
@@ -1148,6 +1174,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
             wtx.m_confirm.status = wtxIn.m_confirm.status;
             wtx.m_confirm.nIndex = wtxIn.m_confirm.nIndex;
             wtx.m_confirm.hashBlock = wtxIn.m_confirm.hashBlock;
+            UpdateTxBlockIndex(wtx);
             fUpdated = true;
         } else {
             assert(wtx.m_confirm.nIndex == wtxIn.m_confirm.nIndex);
@@ -1172,6 +1199,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
             AddToSpends(hash);
         }
     }
+    MarkStakeDirty(wtx);
 
     //// debug print
     WalletLogPrintf("AddToWallet %s  %s%s\n", wtxIn.GetHash().ToString(), (fInsertedNew ? "new" : ""), (fUpdated ? "update" : ""));
@@ -1221,6 +1249,7 @@ void CWallet::LoadToWallet(CWalletTx& wtxIn)
     wtx.BindWallet(this);
     if (/* insertion took place */ ins.second) {
         wtx.m_it_wtxOrdered = wtxOrdered.insert(std::make_pair(wtx.nOrderPos, &wtx));
+        AddToTxIndexes(wtx);
     }
     AddToSpends(hash);
     for (const CTxIn& txin : wtx.tx->vin) {
@@ -1234,6 +1263,60 @@ void CWallet::LoadToWallet(CWalletTx& wtxIn)
     }
 }
 
+void CWallet::AddToTxIndexes(CWalletTx& wtx)
+{
+    AssertLockHeld(cs_wallet);
+    std::set<CTxDestination> destinations;
+    for (const CTxOut& txout : wtx.tx->vout) {
+        CTxDestination dest;
+        if (ExtractDestination(txout.scriptPubKey, dest) && destinations.insert(dest).second) {
+            m_wtx_by_destination[dest].insert(std::make_pair(wtx.m_it_wtxOrdered->first, &wtx));
+        }
+    }
+    wtx.m_indexed_block = wtx.isConfirmed() ? wtx.m_confirm.hashBlock : uint256();
+    m_wtx_by_block[wtx.m_indexed_block].insert(&wtx);
+}
+
+void CWallet::UpdateTxBlockIndex(CWalletTx& wtx)
+{
+    AssertLockHeld(cs_wallet);
+    const uint256 block = wtx.isConfirmed() ? wtx.m_confirm.hashBlock : uint256();
+    if (block == wtx.m_indexed_block) return;
+    auto it = m_wtx_by_block.find(wtx.m_indexed_block);
+    if (it != m_wtx_by_block.end()) {
+        it->second.erase(&wtx);
+        if (it->second.empty()) m_wtx_by_block.erase(it);
+    }
+    wtx.m_indexed_block = block;
+    m_wtx_by_block[block].insert(&wtx);
+}
+
+void CWallet::RemoveFromTxIndexes(CWalletTx& wtx)
+{
+    AssertLockHeld(cs_wallet);
+    // Indexed under the order position wtxOrdered has, which the tx is still in
+    const int64_t nOrderKey = wtx.m_it_wtxOrdered->first;
+    for (const CTxOut& txout : wtx.tx->vout) {
+        CTxDestination dest;
+        if (!ExtractDestination(txout.scriptPubKey, dest)) continue;
+        auto it = m_wtx_by_destination.find(dest);
+        if (it == m_wtx_by_destination.end()) continue;
+        auto range = it->second.equal_range(nOrderKey);
+        for (auto item = range.first; item != range.second; ++item) {
+            if (item->second == &wtx) {
+                it->second.erase(item);
+                break;
+            }
+        }
+        if (it->second.empty()) m_wtx_by_destination.erase(it);
+    }
+    auto it = m_wtx_by_block.find(wtx.m_indexed_block);
+    if (it != m_wtx_by_block.end()) {
+        it->second.erase(&wtx);
+        if (it->second.empty()) m_wtx_by_block.erase(it);
+    }
+}
+
 bool CWallet::AddToWalletIfInvolvingMe(const CTransactionRef& ptx, CWalletTx::Status status, const uint256& block_hash, int posInBlock, bool fUpdate)
 {
     const CTransaction& tx = *ptx;
@@ -1345,7 +1428,9 @@ bool CWallet::AbandonTransaction(interfaces::Chain::Lock& locked_chain, const ui
             assert(!wtx.InMempool());
             wtx.m_confirm.nIndex = 0;
             wtx.setAbandoned();
+            UpdateTxBlockIndex(wtx);
             wtx.MarkDirty();
+            MarkStakeDirty(wtx);
             batch.WriteTx(wtx);
             NotifyTransactionChanged(this, wtx.GetHash(), CT_UPDATED);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them abandoned too
@@ -1400,7 +1485,9 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
             wtx.m_confirm.nIndex = 0;
             wtx.m_confirm.hashBlock = hashBlock;
             wtx.setConflicted();
+            UpdateTxBlockIndex(wtx);
             wtx.MarkDirty();
+            MarkStakeDirty(wtx);
             batch.WriteTx(wtx);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them conflicted too
             TxSpends::const_iterator iter = mapTxSpends.lower_bound(COutPoint(now, 0));
@@ -1448,6 +1535,7 @@ void CWallet::TransactionAddedToMempool(const CTransactionRef& ptx) {
     auto it = mapWallet.find(ptx->GetHash());
     if (it != mapWallet.end()) {
         it->second.fInMempool = true;
+        MarkBalanceDirty();
     }
 }
 
@@ -1456,6 +1544,7 @@ void CWallet::TransactionRemovedFromMempool(const CTransactionRef &ptx) {
     auto it = mapWallet.find(ptx->GetHash());
     if (it != mapWallet.end()) {
         it->second.fInMempool = false;
+        MarkBalanceDirty();
     }
 }
 
@@ -1472,6 +1561,11 @@ void CWallet::BlockConnected(const CBlock& block, const std::vector<CTransaction
         TransactionRemovedFromMempool(ptx);
     }
 
+    if (fLogEvents && !mapToken.empty()) {
+        Optional<int> height = locked_chain->getBlockHeight(block_hash);
+        if (height) SyncTokenTransfers(block, *height);
+    }
+
     m_last_block_processed = block_hash;
 }
 
@@ -1487,6 +1581,102 @@ void CWallet::BlockDisconnected(const CBlock& block) {
         int posInBlock = ptx->IsCoinStake() ? -1 : 0;
         SyncTransaction(ptx, CWalletTx::Status::UNCONFIRMED, {} /* block hash */, posInBlock /* position in block */);
     }
+
+    // Step the tokens synced to this block back to its parent, the balances may have changed
+    const uint256 block_hash = block.GetHash();
+    for (auto& item : mapToken) {
+        CTokenInfo& token = item.second;
+        if (token.blockHash == block_hash) {
+            token.blockHash = block.hashPrevBlock;
+            token.blockNumber--;
+        }
+        token.strCachedBalance.clear();
+        token.cachedBalanceBlockHash.SetNull();
+    }
+}
+
+void CWallet::SyncTokenTransfers(const CBlock& block, int height)
+{
+    // Holders of each token contract in the wallet
+    std::map<dev::Address, std::pair<std::string, std::set<uint160>>> tracked;
+    for (const auto& item : mapToken) {
+        const CTokenInfo& token = item.second;
+        CTxDestination dest = DecodeDestination(token.strSenderAddress);
+        const PKHash* keyid = boost::get<PKHash>(&dest);
+        if (!keyid || !IsHex(token.strContractAddress) || token.strContractAddress.size() != 40) continue;
+        auto& holders = tracked[dev::Address(token.strContractAddress)];
+        holders.first = token.strContractAddress;
+        holders.second.insert(uint160(*keyid));
+    }
+
+    // keccak256("Transfer(address,address,uint256)")
+    static const dev::h256 transferTopic("ddf252ad1be2c89b69c2b068fc378daa952ba7f163c4a11628f55a4df523b3ef");
+
+    // Transfers of the same transaction between the same addresses are added up, like the token page does
+    const uint256 block_hash = block.GetHash();
+    std::vector<CTokenTx> tokenTxs;
+    for (const CTransactionRef& tx : block.vtx) {
+        if (!tx->HasCreateOrCall()) continue;
+        std::vector<TransactionReceiptInfo> receipts;
+        if (!pstorageresult->getResultLogs(uintToh256(tx->GetHash()), receipts)) continue;
+        for (const TransactionReceiptInfo& receipt : receipts) {
+            if (receipt.blockHash != block_hash) continue;
+            for (const dev::eth::LogEntry& log : receipt.logs) {
+                if (log.topics.size() != 3 || log.topics[0] != transferTopic || log.data.size() != 32) continue;
+                auto it = tracked.find(log.address);
+                if (it == tracked.end()) continue;
+                const uint160 from(dev::right160(log.topics[1]).asBytes());
+                const uint160 to(dev::right160(log.topics[2]).asBytes());
+                if (!it->second.second.count(from) && !it->second.second.count(to)) continue;
+
+                CTokenTx tokenTx;
+                tokenTx.strContractAddress = it->second.first;
+                tokenTx.strSenderAddress = EncodeDestination(PKHash(from));
+                tokenTx.strReceiverAddress = EncodeDestination(PKHash(to));
+                tokenTx.nValue = uint256(log.data);
+                tokenTx.transactionHash = tx->GetHash();
+                tokenTx.blockHash = block_hash;
+                tokenTx.blockNumber = height;
+
+                auto same = std::find_if(tokenTxs.begin(), tokenTxs.end(), [&](const CTokenTx& other) {
+                    return other.transactionHash == tokenTx.transactionHash &&
+                           other.strContractAddress == tokenTx.strContractAddress &&
+                           other.strSenderAddress == tokenTx.strSenderAddress &&
+                           other.strReceiverAddress == tokenTx.strReceiverAddress;
+                });
+                if (same != tokenTxs.end()) {
+                    same->nValue = u256Touint(uintTou256(same->nValue) + uintTou256(tokenTx.nValue));
+                } else {
+                    tokenTxs.push_back(tokenTx);
+                }
+            }
+        }
+    }
+
+    if (!tokenTxs.empty()) {
+        AddTokenTxEntries(tokenTxs, false);
+    }
+    for (const CTokenTx& tokenTx : tokenTxs) {
+
+        // The balances of the holders involved are read again
+        for (auto& item : mapToken) {
+            CTokenInfo& token = item.second;
+            if (token.strContractAddress == tokenTx.strContractAddress &&
+                (token.strSenderAddress == tokenTx.strSenderAddress || token.strSenderAddress == tokenTx.strReceiverAddress)) {
+                token.strCachedBalance.clear();
+                token.cachedBalanceBlockHash.SetNull();
+            }
+        }
+    }
+
+    // Tokens synced up to the parent are now synced to this block, the others are caught up by the token page
+    for (auto& item : mapToken) {
+        CTokenInfo& token = item.second;
+        if (token.blockHash == block.hashPrevBlock) {
+            token.blockHash = block_hash;
+            token.blockNumber = height;
+        }
+    }
 }
 
 void CWallet::UpdatedBlockTip()
@@ -1541,7 +1731,16 @@ CAmount CWallet::GetDebit(const CTxIn &txin, const isminefilter& filter) const
 
 isminetype CWallet::IsMine(const CTxOut& txout) const
 {
-    return ::IsMine(*this, txout.scriptPubKey);
+    LOCK(cs_KeyStore);
+    auto it = m_ismine_cache.find(txout.scriptPubKey);
+    if (it != m_ismine_cache.end())
+        return it->second;
+
+    isminetype mine = ::IsMine(*this, txout.scriptPubKey);
+    if (m_ismine_cache.size() >= MAX_ISMINE_CACHE_SIZE)
+        m_ismine_cache.clear();
+    m_ismine_cache.emplace(txout.scriptPubKey, mine);
+    return mine;
 }
 
 CAmount CWallet::GetCredit(const CTxOut& txout, const isminefilter& filter) const
@@ -1824,6 +2023,7 @@ bool CWallet::DummySignTx(CMutableTransaction &txNew, const std::vector<CTxOut>
 
 bool CWallet::ImportScripts(const std::set<CScript> scripts, int64_t timestamp)
 {
+    InvalidateStakeableCoins();
     WalletBatch batch(*database);
     for (const auto& entry : scripts) {
         CScriptID id(entry);
@@ -1848,6 +2048,7 @@ bool CWallet::ImportScripts(const std::set<CScript> scripts, int64_t timestamp)
 
 bool CWallet::ImportPrivKeys(const std::map<CKeyID, CKey>& privkey_map, const int64_t timestamp)
 {
+    InvalidateStakeableCoins();
     WalletBatch batch(*database);
     for (const auto& entry : privkey_map) {
         const CKey& key = entry.second;
@@ -1871,6 +2072,7 @@ bool CWallet::ImportPrivKeys(const std::map<CKeyID, CKey>& privkey_map, const in
 
 bool CWallet::ImportPubKeys(const std::vector<CKeyID>& ordered_pubkeys, const std::map<CKeyID, CPubKey>& pubkey_map, const std::map<CKeyID, std::pair<CPubKey, KeyOriginInfo>>& key_origins, const bool add_keypool, const bool internal, const int64_t timestamp)
 {
+    InvalidateStakeableCoins();
     WalletBatch batch(*database);
     for (const auto& entry : key_origins) {
         AddKeyOriginWithDB(batch, entry.second.first, entry.second.second);
@@ -1903,6 +2105,7 @@ bool CWallet::ImportPubKeys(const std::vector<CKeyID>& ordered_pubkeys, const st
 
 bool CWallet::ImportScriptPubKeys(const std::string& label, const std::set<CScript>& script_pub_keys, const bool have_solving_data, const bool apply_label, const int64_t timestamp)
 {
+    InvalidateStakeableCoins();
     WalletBatch batch(*database);
     for (const CScript& script : script_pub_keys) {
         if (!have_solving_data || !::IsMine(*this, script)) { // Always call AddWatchOnly for non-solvable watch-only, so that watch timestamp gets updated
@@ -2052,11 +2255,66 @@ int64_t CWallet::RescanFromTime(int64_t startTime, const WalletRescanReserver& r
     return startTime;
 }
 
+namespace {
+
+/** A block read ahead of a rescan, with the transactions paying to the wallet flagged */
+struct RescanBlock {
+    uint256 hash;
+    int height;
+    const CBlockIndex* pindex = nullptr;
+    FlatFilePos pos;
+    //! The block filter rules out every script of the wallet, the block was not read
+    bool filtered_out = false;
+    bool read = false;
+    CBlock block;
+    //! Transactions with an output of the wallet, empty when they were not checked
+    std::vector<bool> pays_wallet;
+
+    RescanBlock(const uint256& hash_in, int height_in) : hash(hash_in), height(height_in) {}
+};
+
+/** Scripts the wallet could have received to or spent from, to match against block filters. */
+bool GetRescanFilterElements(const CWallet& wallet, GCSFilter::ElementSet& elements)
+{
+    // watch-only scripts cannot be listed
+    if (wallet.HaveWatchOnly()) return false;
+
+    auto add = [&](const CScript& script) { elements.emplace(script.begin(), script.end()); };
+    for (const CKeyID& keyid : wallet.GetKeys()) {
+        CPubKey pubkey;
+        if (!wallet.GetPubKey(keyid, pubkey)) return false;
+        add(GetScriptForRawPubKey(pubkey));
+        add(GetScriptForDestination(PKHash(keyid)));
+        if (pubkey.IsCompressed()) {
+            CScript witness = GetScriptForDestination(WitnessV0KeyHash(keyid));
+            add(witness);
+            add(GetScriptForDestination(ScriptHash(witness)));
+        }
+    }
+    for (const CScriptID& scriptid : wallet.GetCScripts()) {
+        CScript script;
+        if (!wallet.GetCScript(scriptid, script)) return false;
+        add(script);
+        add(GetScriptForDestination(ScriptHash(script)));
+        CScript witness = GetScriptForDestination(WitnessV0ScriptHash(script));
+        add(witness);
+        add(GetScriptForDestination(ScriptHash(witness)));
+    }
+    return true;
+}
+
+} // namespace
+
 /**
  * Scan the block chain (starting in start_block) for transactions
  * from or to us. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
  *
+ * Blocks are read and their outputs matched against the wallet on several
+ * threads ahead of the scan, skipping the blocks whose basic block filter
+ * matches no script of the wallet when -blockfilterindex is enabled. The
+ * transactions are then applied in chain order on the calling thread.
+ *
  * @param[in] start_block Scan starting block. If block is not on the active
  *                        chain, the scan will return SUCCESS immediately.
  * @param[in] stop_block  Scan ending block. If block is not on the active
@@ -2102,41 +2360,166 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
         progress_end = chain().guessVerificationProgress(stop_block.IsNull() ? tip_hash : stop_block);
     }
     double progress_current = progress_begin;
-    while (block_height && !fAbortRescan && !chain().shutdownRequested()) {
-        m_scanning_progress = (progress_current - progress_begin) / (progress_end - progress_begin);
-        if (*block_height % 100 == 0 && progress_end - progress_begin > 0.0) {
-            ShowProgress(strprintf("%s " + _("Rescanning...").translated, GetDisplayName()), std::max(1, std::min(99, (int)(m_scanning_progress * 100))));
-        }
-        if (GetTime() >= nNow + 60) {
-            nNow = GetTime();
-            WalletLogPrintf("Still rescanning. At block %d. Progress=%f\n", *block_height, progress_current);
-        }
 
-        CBlock block;
-        if (chain().findBlock(block_hash, &block) && !block.IsNull()) {
+    const int n_threads = std::max(1, std::min(GetNumCores(), MAX_RESCAN_THREADS));
+    const BlockFilterIndex* filter_index = GetBlockFilterIndex(BlockFilterType::BASIC);
+    // keys added during the scan, by the keypool top up, invalidate what was matched ahead
+    auto key_generation = [this]() {
+        AssertLockHeld(cs_wallet);
+        return mapKeyMetadata.size() + m_script_metadata.size();
+    };
+    size_t filter_generation = 0;
+    std::shared_ptr<const GCSFilterQuery> filter_query;
+
+    bool done = false;
+    while (block_height && !done && !fAbortRescan && !chain().shutdownRequested()) {
+        // Collect the next blocks up to stop_block
+        std::vector<RescanBlock> batch;
+        size_t generation;
+        {
             auto locked_chain = chain().lock();
             LOCK(cs_wallet);
-            if (!locked_chain->getBlockHeight(block_hash)) {
-                // Abort scan if current block is no longer active, to prevent
-                // marking transactions as coming from the wrong block.
-                // TODO: This should return success instead of failure, see
-                // https://github.com/bitcoin/bitcoin/pull/14711#issuecomment-458342518
+            Optional<int> tip_height = locked_chain->getHeight();
+            batch.emplace_back(block_hash, *block_height);
+            for (int height = *block_height + 1; tip_height && height <= *tip_height && batch.size() < (size_t)(n_threads * RESCAN_SHARD) && batch.back().hash != stop_block; height++) {
+                batch.emplace_back(locked_chain->getBlockHash(height), height);
+            }
+            // the threads reading ahead cannot take cs_main, which callers of the scan may hold
+            LOCK(cs_main);
+            for (RescanBlock& next : batch) {
+                next.pindex = LookupBlockIndex(next.hash);
+                if (next.pindex && (next.pindex->nStatus & BLOCK_HAVE_DATA)) {
+                    next.pos = next.pindex->GetBlockPos();
+                }
+            }
+            generation = key_generation();
+            if (filter_index && (!filter_query || generation != filter_generation)) {
+                GCSFilter::ElementSet elements;
+                filter_query = GetRescanFilterElements(*this, elements) ? std::make_shared<const GCSFilterQuery>(elements) : nullptr;
+                filter_generation = generation;
+            }
+        }
+
+        // Read the filters of the whole batch in one pass over the index and match them all at once
+        bool batch_matched = false;
+        if (filter_query && batch.back().pindex) {
+            std::vector<BlockFilter> filters;
+            if (filter_index->LookupFilterRange(batch.front().height, batch.back().pindex, filters) && filters.size() == batch.size()) {
+                std::vector<const GCSFilter*> gcs_filters;
+                gcs_filters.reserve(filters.size());
+                for (const BlockFilter& filter : filters) {
+                    gcs_filters.push_back(&filter.GetFilter());
+                }
+                const std::vector<unsigned char> matches = filter_query->MatchAll(gcs_filters, n_threads);
+                for (size_t i = 0; i < batch.size(); i++) {
+                    batch[i].filtered_out = !matches[i] && filters[i].GetBlockHash() == batch[i].hash;
+                }
+                batch_matched = true;
+            }
+        }
+
+        auto read_shard = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end && !fAbortRescan && !chain().shutdownRequested(); i++) {
+                RescanBlock& next = batch[i];
+                if (batch_matched) {
+                    if (next.filtered_out) continue;
+                } else if (filter_query && next.pindex) {
+                    BlockFilter filter;
+                    if (filter_index->LookupFilter(next.pindex, filter) && !filter.GetFilter().MatchAny(*filter_query)) {
+                        next.filtered_out = true;
+                        continue;
+                    }
+                }
+                if (next.pos.IsNull() || !ReadBlockFromDisk(next.block, next.pos, Params().GetConsensus()) || next.block.GetHash() != next.hash) {
+                    next.block.SetNull();
+                    continue;
+                }
+                next.read = true;
+                next.pays_wallet.reserve(next.block.vtx.size());
+                for (const CTransactionRef& tx : next.block.vtx) {
+                    bool pays = false;
+                    for (const CTxOut& txout : tx->vout) {
+                        if (IsMine(txout) != ISMINE_NO) {
+                            pays = true;
+                            break;
+                        }
+                    }
+                    next.pays_wallet.push_back(pays);
+                }
+            }
+        };
+
+        // consecutive blocks per thread
+        std::vector<std::thread> threads;
+        for (size_t begin = RESCAN_SHARD; begin < batch.size(); begin += RESCAN_SHARD) {
+            threads.emplace_back(read_shard, begin, std::min(batch.size(), begin + RESCAN_SHARD));
+        }
+        read_shard(0, std::min(batch.size(), (size_t)RESCAN_SHARD));
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+
+        for (RescanBlock& next : batch) {
+            if (fAbortRescan || chain().shutdownRequested()) {
+                break;
+            }
+            block_hash = next.hash;
+            block_height = next.height;
+            progress_current = chain().guessVerificationProgress(block_hash);
+            m_scanning_progress = (progress_current - progress_begin) / (progress_end - progress_begin);
+            if (*block_height % 100 == 0 && progress_end - progress_begin > 0.0) {
+                ShowProgress(strprintf("%s " + _("Rescanning...").translated, GetDisplayName()), std::max(1, std::min(99, (int)(m_scanning_progress * 100))));
+            }
+            if (GetTime() >= nNow + 60) {
+                nNow = GetTime();
+                WalletLogPrintf("Still rescanning. At block %d. Progress=%f\n", *block_height, progress_current);
+            }
+
+            if (WITH_LOCK(cs_wallet, return key_generation() != generation)) {
+                // read the block again against the current keys
+                next.filtered_out = false;
+                next.read = chain().findBlock(block_hash, &next.block) && !next.block.IsNull();
+                next.pays_wallet.clear();
+            }
+
+            if (next.filtered_out || next.read) {
+                auto locked_chain = chain().lock();
+                LOCK(cs_wallet);
+                if (!locked_chain->getBlockHeight(block_hash)) {
+                    // Abort scan if current block is no longer active, to prevent
+                    // marking transactions as coming from the wrong block.
+                    // TODO: This should return success instead of failure, see
+                    // https://github.com/bitcoin/bitcoin/pull/14711#issuecomment-458342518
+                    result.last_failed_block = block_hash;
+                    result.status = ScanResult::FAILURE;
+                    done = true;
+                    break;
+                }
+                for (size_t posInBlock = 0; next.read && posInBlock < next.block.vtx.size(); ++posInBlock) {
+                    const CTransactionRef& tx = next.block.vtx[posInBlock];
+                    // transactions that neither pay to the wallet nor spend from it are of no interest
+                    if (!next.pays_wallet.empty() && !next.pays_wallet[posInBlock] && !mapWallet.count(tx->GetHash()) &&
+                        std::none_of(tx->vin.begin(), tx->vin.end(), [&](const CTxIn& txin) {
+                            return mapWallet.count(txin.prevout.hash) || mapTxSpends.count(txin.prevout);
+                        })) {
+                        continue;
+                    }
+                    SyncTransaction(tx, CWalletTx::Status::CONFIRMED, block_hash, posInBlock, fUpdate);
+                }
+                // scan succeeded, record block as most recent successfully scanned
+                result.last_scanned_block = block_hash;
+                result.last_scanned_height = *block_height;
+            } else {
+                // could not scan block, keep scanning but record this block as the most recent failure
                 result.last_failed_block = block_hash;
                 result.status = ScanResult::FAILURE;
-                break;
             }
-            for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
-                SyncTransaction(block.vtx[posInBlock], CWalletTx::Status::CONFIRMED, block_hash, posInBlock, fUpdate);
+            if (block_hash == stop_block) {
+                done = true;
+                break;
             }
-            // scan succeeded, record block as most recent successfully scanned
-            result.last_scanned_block = block_hash;
-            result.last_scanned_height = *block_height;
-        } else {
-            // could not scan block, keep scanning but record this block as the most recent failure
-            result.last_failed_block = block_hash;
-            result.status = ScanResult::FAILURE;
         }
-        if (block_hash == stop_block) {
+        if (done || fAbortRescan || chain().shutdownRequested()) {
             break;
         }
         {
@@ -2150,7 +2533,6 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
 
             // increment block and verification progress
             block_hash = locked_chain->getBlockHash(++*block_height);
-            progress_current = chain().guessVerificationProgress(block_hash);
 
             // handle updated tip hash
             const uint256 prev_tip_hash = tip_hash;
@@ -2461,6 +2843,8 @@ void CWallet::ResendWalletTransactions()
 
 /** @} */ // end of mapWallet
 
+SaltedScriptHasher::SaltedScriptHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
 void MaybeResendWalletTxs()
 {
     for (const std::shared_ptr<CWallet>& pwallet : GetWallets()) {
@@ -2468,6 +2852,13 @@ void MaybeResendWalletTxs()
     }
 }
 
+void MaybeConsolidateStakes()
+{
+    for (const std::shared_ptr<CWallet>& pwallet : GetWallets()) {
+        pwallet->ConsolidateStakes();
+    }
+}
+
 
 /** @defgroup Actions
  *
@@ -2482,6 +2873,16 @@ CWallet::Balance CWallet::GetBalance(const int min_depth, bool avoid_reuse) cons
     {
         auto locked_chain = chain().lock();
         LOCK(cs_wallet);
+
+        // The balances only move with the wallet transactions and the depth of the chain
+        Optional<int> tip_height = locked_chain->getHeight();
+        const uint256 tip = tip_height ? locked_chain->getBlockHash(*tip_height) : uint256();
+        const uint64_t generation = m_balance_generation;
+        auto cached = m_balance_cache.find(std::make_pair(min_depth, avoid_reuse));
+        if (cached != m_balance_cache.end() && cached->second.tip == tip && cached->second.generation == generation) {
+            return cached->second.balance;
+        }
+
         for (const auto& entry : mapWallet)
         {
             const CWalletTx& wtx = entry.second;
@@ -2502,6 +2903,8 @@ CWallet::Balance CWallet::GetBalance(const int min_depth, bool avoid_reuse) cons
             ret.m_mine_stake += wtx.GetStakeCredit(*locked_chain);
             ret.m_watchonly_stake += wtx.GetStakeWatchOnlyCredit(*locked_chain);
         }
+
+        m_balance_cache[std::make_pair(min_depth, avoid_reuse)] = CachedBalance{tip, generation, ret};
     }
     return ret;
 }
@@ -2534,10 +2937,21 @@ void CWallet::AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<
     const int min_depth = {coinControl ? coinControl->m_min_depth : DEFAULT_MIN_DEPTH};
     const int max_depth = {coinControl ? coinControl->m_max_depth : DEFAULT_MAX_DEPTH};
 
-    for (const auto& entry : mapWallet)
+    UpdateUnspentCoins(locked_chain);
+
+    auto coin = m_unspent_coins.begin();
+    while (coin != m_unspent_coins.end())
     {
-        const uint256& wtxid = entry.first;
-        const CWalletTx& wtx = entry.second;
+        const uint256 wtxid = coin->first.hash;
+        // the outputs of a transaction follow each other
+        auto tx_coins_end = m_unspent_coins.upper_bound(COutPoint(wtxid, std::numeric_limits<uint32_t>::max()));
+        auto tx_coins_begin = coin;
+        coin = tx_coins_end;
+
+        auto it = mapWallet.find(wtxid);
+        if (it == mapWallet.end())
+            continue;
+        const CWalletTx& wtx = it->second;
 
         if (!locked_chain.checkFinalTx(*wtx.tx)) {
             continue;
@@ -2596,24 +3010,22 @@ void CWallet::AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<
             continue;
         }
 
-        for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+        for (auto tx_coin = tx_coins_begin; tx_coin != tx_coins_end; ++tx_coin) {
+            const unsigned int i = tx_coin->first.n;
             if (wtx.tx->vout[i].nValue < nMinimumAmount || wtx.tx->vout[i].nValue > nMaximumAmount)
                 continue;
 
-            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(entry.first, i)))
+            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(wtxid, i)))
                 continue;
 
-            if (IsLockedCoin(entry.first, i))
+            if (IsLockedCoin(wtxid, i))
                 continue;
 
+            // the spends of the coins may have changed without the wallet noticing, see m_unspent_coins
             if (IsSpent(locked_chain, wtxid, i))
                 continue;
 
-            isminetype mine = IsMine(wtx.tx->vout[i]);
-
-            if (mine == ISMINE_NO) {
-                continue;
-            }
+            isminetype mine = tx_coin->second;
 
             if (!allow_used_addresses && IsUsedDestination(wtxid, i)) {
                 continue;
@@ -2641,6 +3053,138 @@ void CWallet::AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<
     }
 }
 
+void CWallet::MarkStakeDirty(const CWalletTx& wtx)
+{
+    m_stake_dirty.insert(wtx.GetHash());
+    m_unspent_coins_dirty.insert(wtx.GetHash());
+    if (wtx.IsCoinBase())
+        return;
+    // spending or releasing the inputs adds them to or removes them from the stake cache
+    for (const CTxIn& txin : wtx.tx->vin) {
+        if (mapWallet.count(txin.prevout.hash)) {
+            m_stake_dirty.insert(txin.prevout.hash);
+            m_unspent_coins_dirty.insert(txin.prevout.hash);
+        }
+    }
+}
+
+void CWallet::UpdateUnspentCoins(interfaces::Chain::Lock& locked_chain) const
+{
+    if (!m_unspent_coins_valid) {
+        m_unspent_coins.clear();
+        m_unspent_coins_dirty.clear();
+        for (const auto& item : mapWallet)
+            m_unspent_coins_dirty.insert(item.first);
+        m_unspent_coins_valid = true;
+    }
+
+    for (const uint256& wtxid : m_unspent_coins_dirty) {
+        auto coin = m_unspent_coins.lower_bound(COutPoint(wtxid, 0));
+        while (coin != m_unspent_coins.end() && coin->first.hash == wtxid)
+            coin = m_unspent_coins.erase(coin);
+
+        auto it = mapWallet.find(wtxid);
+        if (it == mapWallet.end())
+            continue;
+        const CWalletTx& wtx = it->second;
+        for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+            isminetype mine = IsMine(wtx.tx->vout[i]);
+            if (mine == ISMINE_NO || IsSpent(locked_chain, wtxid, i))
+                continue;
+            m_unspent_coins.emplace(COutPoint(wtxid, i), mine);
+        }
+    }
+    m_unspent_coins_dirty.clear();
+}
+
+void CWallet::UpdateStakeableCoins(interfaces::Chain::Lock& locked_chain, const uint256& wtxid, int nTipHeight, bool fStakeCache) const
+{
+    stakeCache.erase(wtxid);
+    auto coin = m_stakeable_coins.lower_bound(COutPoint(wtxid, 0));
+    while (coin != m_stakeable_coins.end() && coin->first.hash == wtxid) {
+        if (coin->second.fWeight)
+            m_stake_weight -= coin->second.nValue;
+        coin = m_stakeable_coins.erase(coin);
+    }
+    auto maturity = m_stake_maturity_height.find(wtxid);
+    if (maturity != m_stake_maturity_height.end()) {
+        m_stake_maturity[maturity->second].erase(wtxid);
+        if (m_stake_maturity[maturity->second].empty())
+            m_stake_maturity.erase(maturity->second);
+        m_stake_maturity_height.erase(maturity);
+    }
+
+    auto it = mapWallet.find(wtxid);
+    if (it == mapWallet.end())
+        return;
+    const CWalletTx* pcoin = &it->second;
+    if (pcoin->GetDepthInMainChain(locked_chain) < 1)
+        return;
+    Optional<int> nHeight = locked_chain.getBlockHeight(pcoin->m_confirm.hashBlock);
+    if (!nHeight)
+        return;
+
+    // same maturity as GetBlocksToMaturity and COINBASE_MATURITY confirmations for the others
+    int nMatureHeight = *nHeight + COINBASE_MATURITY - 1 + ((pcoin->IsCoinBase() || pcoin->IsCoinStake()) ? 1 : 0);
+    if (nMatureHeight > nTipHeight) {
+        m_stake_maturity[nMatureHeight].insert(wtxid);
+        m_stake_maturity_height[wtxid] = nMatureHeight;
+        return;
+    }
+
+    uint32_t blockFromTime = fStakeCache ? locked_chain.getBlockTime(*nHeight) : 0;
+    for (unsigned int i = 0; i < pcoin->tx->vout.size(); i++) {
+        const CTxOut& txout = pcoin->tx->vout[i];
+        if (txout.nValue <= 0 || txout.scriptPubKey.HasOpCall() || txout.scriptPubKey.HasOpCreate())
+            continue;
+        isminetype mine = IsMine(txout);
+        if (mine == ISMINE_NO)
+            continue;
+        bool solvable = IsSolvable(*this, txout.scriptPubKey);
+        bool spendable = ((mine & ISMINE_SPENDABLE) != ISMINE_NO) || (((mine & ISMINE_WATCH_ONLY) != ISMINE_NO) && solvable);
+        bool spent = IsSpent(locked_chain, wtxid, i);
+        bool weight = !spent && !IsLockedCoin(wtxid, i);
+        m_stakeable_coins.emplace(COutPoint(wtxid, i), StakeableCoin{nMatureHeight, spendable, solvable, txout.nValue, weight});
+        if (weight)
+            m_stake_weight += txout.nValue;
+        if (fStakeCache && !spent)
+            stakeCache.insert(COutPoint(wtxid, i), CStakeCache(blockFromTime, txout.nValue, *nHeight));
+    }
+}
+
+void CWallet::UpdateStakeableCoins(interfaces::Chain::Lock& locked_chain) const
+{
+    Optional<int> tip_height = locked_chain.getHeight();
+    int nTipHeight = tip_height ? *tip_height : -1;
+
+    if (m_stake_tip_height < 0) {
+        m_stakeable_coins.clear();
+        m_stake_weight = 0;
+        stakeCache.clear();
+        m_stake_maturity.clear();
+        m_stake_maturity_height.clear();
+        m_stake_dirty.clear();
+        for (const auto& item : mapWallet)
+            m_stake_dirty.insert(item.first);
+    } else if (nTipHeight < m_stake_tip_height) {
+        // blocks were disconnected, coins mature above the new tip wait for it again
+        for (const auto& coin : m_stakeable_coins) {
+            if (coin.second.nMatureHeight > nTipHeight)
+                m_stake_dirty.insert(coin.first.hash);
+        }
+    }
+    while (!m_stake_maturity.empty() && m_stake_maturity.begin()->first <= nTipHeight) {
+        m_stake_dirty.insert(m_stake_maturity.begin()->second.begin(), m_stake_maturity.begin()->second.end());
+        m_stake_maturity.erase(m_stake_maturity.begin());
+    }
+
+    bool fStakeCache = gArgs.GetBoolArg("-stakecache", DEFAULT_STAKE_CACHE);
+    for (const uint256& wtxid : m_stake_dirty)
+        UpdateStakeableCoins(locked_chain, wtxid, nTipHeight, fStakeCache);
+    m_stake_dirty.clear();
+    m_stake_tip_height = nTipHeight;
+}
+
 void CWallet::AvailableCoinsForStaking(interfaces::Chain::Lock& locked_chain, std::vector<COutput>& vCoins) const
 {
     AssertLockHeld(cs_main);
@@ -2648,30 +3192,30 @@ void CWallet::AvailableCoinsForStaking(interfaces::Chain::Lock& locked_chain, st
 
     vCoins.clear();
 
-    for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-    {
-        const uint256& wtxid = it->first;
-        const CWalletTx* pcoin = &(*it).second;
-        int nDepth = pcoin->GetDepthInMainChain(locked_chain);
-
-        if (nDepth < 1)
-            continue;
+    UpdateStakeableCoins(locked_chain);
 
-        if (nDepth < COINBASE_MATURITY)
-            continue;
+    const CWalletTx* pcoin = nullptr;
+    int nDepth = 0;
+    for (const auto& coin : m_stakeable_coins)
+    {
+        const COutPoint& output = coin.first;
+        // the outputs of a transaction follow each other
+        if (!pcoin || pcoin->GetHash() != output.hash) {
+            auto it = mapWallet.find(output.hash);
+            if (it == mapWallet.end()) {
+                pcoin = nullptr;
+                continue;
+            }
+            pcoin = &it->second;
+            nDepth = pcoin->GetDepthInMainChain(locked_chain);
+        }
 
-        if (pcoin->GetBlocksToMaturity(locked_chain) > 0)
+        // the chain may be ahead of the wallet notifications the coins were updated from
+        if (nDepth < COINBASE_MATURITY || pcoin->GetBlocksToMaturity(locked_chain) > 0)
             continue;
 
-        for (unsigned int i = 0; i < pcoin->tx->vout.size(); i++) {
-            isminetype mine = IsMine(pcoin->tx->vout[i]);
-            bool solvable = IsSolvable(*this, pcoin->tx->vout[i].scriptPubKey);
-            bool spendable = ((mine & ISMINE_SPENDABLE) != ISMINE_NO) || (((mine & ISMINE_WATCH_ONLY) != ISMINE_NO) && solvable);
-            if (!(IsSpent(locked_chain, wtxid, i)) && mine != ISMINE_NO &&
-                !IsLockedCoin((*it).first, i) && (pcoin->tx->vout[i].nValue > 0) &&
-                !pcoin->tx->vout[i].scriptPubKey.HasOpCall() && !pcoin->tx->vout[i].scriptPubKey.HasOpCreate())
-                    vCoins.push_back(COutput(pcoin, i, nDepth, spendable, solvable, pcoin->IsTrusted(locked_chain)));
-        }
+        if (!IsSpent(locked_chain, output.hash, output.n) && !IsLockedCoin(output.hash, output.n))
+            vCoins.push_back(COutput(pcoin, output.n, nDepth, coin.second.fSpendable, coin.second.fSolvable, pcoin->IsTrusted(locked_chain)));
     }
 }
 
@@ -2739,7 +3283,7 @@ const CTxOut& CWallet::FindNonChangeParentOutput(const CTransaction& tx, int out
     return ptx->vout[n];
 }
 
-bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const CoinEligibilityFilter& eligibility_filter, std::vector<OutputGroup> groups,
+bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const CoinEligibilityFilter& eligibility_filter, const std::vector<OutputGroup>& groups,
                                  std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, const CoinSelectionParams& coin_selection_params, bool& bnb_used) const
 {
     setCoinsRet.clear();
@@ -2757,9 +3301,11 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const CoinEligibil
         CAmount cost_of_change = GetDiscardRate(*this).GetFee(coin_selection_params.change_spend_size) + coin_selection_params.effective_fee.GetFee(coin_selection_params.change_output_size);
 
         // Filter by the min conf specs and add to utxo_pool and calculate effective value
-        for (OutputGroup& group : groups) {
-            if (!group.EligibleForSpending(eligibility_filter)) continue;
+        for (const OutputGroup& eligible_group : groups) {
+            if (!eligible_group.EligibleForSpending(eligibility_filter)) continue;
 
+            utxo_pool.push_back(eligible_group);
+            OutputGroup& group = utxo_pool.back();
             group.fee = 0;
             group.long_term_fee = 0;
             group.effective_value = 0;
@@ -2776,7 +3322,7 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const CoinEligibil
                     it = group.Discard(coin);
                 }
             }
-            if (group.effective_value > 0) utxo_pool.push_back(group);
+            if (group.effective_value <= 0) utxo_pool.pop_back();
         }
         // Calculate the fees for things that aren't inputs
         CAmount not_input_fees = coin_selection_params.effective_fee.GetFee(coin_selection_params.tx_noinputs_size);
@@ -3509,14 +4055,20 @@ bool CWallet::CreateTransaction(interfaces::Chain::Lock& locked_chain, const std
 
 uint64_t CWallet::GetStakeWeight(interfaces::Chain::Lock& locked_chain) const
 {
+    AssertLockHeld(cs_wallet);
+
+    // Without a reserve the staker selects all the stakeable coins, whose sum is kept up to date
+    if (m_reserve_balance <= 0) {
+        UpdateStakeableCoins(locked_chain);
+        return m_stake_weight;
+    }
+
     // Choose coins to use
     CAmount nBalance = GetBalance().m_mine_trusted;
 
     if (nBalance <= m_reserve_balance)
         return 0;
 
-    std::vector<const CWalletTx*> vwtxPrev;
-
     std::set<std::pair<const CWalletTx*,unsigned int> > setCoins;
     CAmount nValueIn = 0;
 
@@ -3538,7 +4090,7 @@ uint64_t CWallet::GetStakeWeight(interfaces::Chain::Lock& locked_chain) const
     return nWeight;
 }
 
-bool CWallet::CreateCoinStake(interfaces::Chain::Lock& locked_chain, const FillableSigningProvider& keystore, unsigned int nBits, const CAmount& nTotalFees, uint32_t nTimeBlock, CMutableTransaction& tx, CKey& key, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoins)
+bool CWallet::CreateCoinStake(interfaces::Chain::Lock& locked_chain, unsigned int nBits, const CAmount& nTotalFees, uint32_t nTimeBlock, CMutableTransaction& tx, CKey& key, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoins)
 {
     CBlockIndex* pindexPrev = ::ChainActive().Tip();
     arith_uint256 bnTargetPerCoinDay;
@@ -3564,20 +4116,6 @@ bool CWallet::CreateCoinStake(interfaces::Chain::Lock& locked_chain, const Filla
     if (setCoins.empty())
         return false;
 
-    if(stakeCache.size() > setCoins.size() + 100){
-        //Determining if the cache is still valid is harder than just clearing it when it gets too big, so instead just clear it
-        //when it has more than 100 entries more than the actual setCoins.
-        stakeCache.clear();
-    }
-    if(gArgs.GetBoolArg("-stakecache", DEFAULT_STAKE_CACHE)) {
-
-        for(const std::pair<const CWalletTx*,unsigned int> &pcoin : setCoins)
-        {
-            boost::this_thread::interruption_point();
-            COutPoint prevoutStake = COutPoint(pcoin.first->GetHash(), pcoin.second);
-            CacheKernel(stakeCache, prevoutStake, pindexPrev, ::ChainstateActive().CoinsTip()); //this will do a 2 disk loads per op
-        }
-    }
     int64_t nCredit = 0;
     CScript scriptPubKeyKernel;
     CScript aggregateScriptPubKeyHashKernel;
@@ -3613,12 +4151,13 @@ bool CWallet::CreateCoinStake(interfaces::Chain::Lock& locked_chain, const Filla
                 // convert to pay to public key type
                 uint160 hash160(vSolutions[0]);
                 CKeyID pubKeyHash(hash160);
-                if (!keystore.GetKey(pubKeyHash, key))
+                CPubKey pubKey;
+                if (!GetStakingKey(pubKeyHash, key, pubKey))
                 {
                     LogPrint(BCLog::COINSTAKE, "CreateCoinStake : failed to get key for kernel type=%d\n", whichType);
                     break;  // unable to find corresponding public key
                 }
-                scriptPubKeyOut << key.GetPubKey().getvch() << OP_CHECKSIG;
+                scriptPubKeyOut << pubKey.getvch() << OP_CHECKSIG;
                 aggregateScriptPubKeyHashKernel = scriptPubKeyKernel;
             }
             if (whichType == TX_PUBKEY)
@@ -3627,13 +4166,14 @@ bool CWallet::CreateCoinStake(interfaces::Chain::Lock& locked_chain, const Filla
                 CPubKey pubKey(vchPubKey);
                 uint160 hash160(Hash160(vchPubKey));
                 CKeyID pubKeyHash(hash160);
-                if (!keystore.GetKey(pubKeyHash, key))
+                CPubKey keyPubKey;
+                if (!GetStakingKey(pubKeyHash, key, keyPubKey))
                 {
                     LogPrint(BCLog::COINSTAKE, "CreateCoinStake : failed to get key for kernel type=%d\n", whichType);
                     break;  // unable to find corresponding public key
                 }
 
-                if (key.GetPubKey() != pubKey)
+                if (keyPubKey != pubKey)
                 {
                     LogPrint(BCLog::COINSTAKE, "CreateCoinStake : invalid key for kernel type=%d\n", whichType);
                     break; // keys mismatch
@@ -3846,10 +4386,13 @@ DBErrors CWallet::ZapSelectTx(std::vector<uint256>& vHashIn, std::vector<uint256
     DBErrors nZapSelectTxRet = WalletBatch(*database, "cr+").ZapSelectTx(vHashIn, vHashOut);
     for (uint256 hash : vHashOut) {
         const auto& it = mapWallet.find(hash);
+        RemoveFromTxIndexes(it->second);
         wtxOrdered.erase(it->second.m_it_wtxOrdered);
         mapWallet.erase(it);
+        MarkBalanceDirty();
         NotifyTransactionChanged(this, hash, CT_DELETED);
     }
+    m_unspent_coins_valid = false;
 
     if (nZapSelectTxRet == DBErrors::NEED_REWRITE)
     {
@@ -4483,17 +5026,21 @@ void CWallet::LockCoin(const COutPoint& output)
 {
     AssertLockHeld(cs_wallet);
     setLockedCoins.insert(output);
+    m_stake_dirty.insert(output.hash);
 }
 
 void CWallet::UnlockCoin(const COutPoint& output)
 {
     AssertLockHeld(cs_wallet);
     setLockedCoins.erase(output);
+    m_stake_dirty.insert(output.hash);
 }
 
 void CWallet::UnlockAllCoins()
 {
     AssertLockHeld(cs_wallet);
+    for (const COutPoint& output : setLockedCoins)
+        m_stake_dirty.insert(output.hash);
     setLockedCoins.clear();
 }
 
@@ -5194,38 +5741,61 @@ bool CWallet::AddTokenEntry(const CTokenInfo &token, bool fFlushOnClose)
 }
 
 bool CWallet::AddTokenTxEntry(const CTokenTx &tokenTx, bool fFlushOnClose)
+{
+    return AddTokenTxEntries({tokenTx}, fFlushOnClose);
+}
+
+bool CWallet::AddTokenTxEntries(const std::vector<CTokenTx> &tokenTxs, bool fFlushOnClose)
 {
     LOCK(cs_wallet);
 
     WalletBatch batch(*database, "r+", fFlushOnClose);
 
-    uint256 hash = tokenTx.GetHash();
+    // Write to disk in a single database transaction
+    std::vector<std::pair<CTokenTx, bool>> written;
+    if (!batch.TxnBegin())
+        return false;
+    for (const CTokenTx& tokenTx : tokenTxs)
+    {
+        uint256 hash = tokenTx.GetHash();
 
-    bool fInsertedNew = true;
+        bool fInsertedNew = true;
 
-    std::map<uint256, CTokenTx>::iterator it = mapTokenTx.find(hash);
-    if(it!=mapTokenTx.end())
-    {
-        fInsertedNew = false;
-    }
+        std::map<uint256, CTokenTx>::iterator it = mapTokenTx.find(hash);
+        if(it!=mapTokenTx.end())
+        {
+            fInsertedNew = false;
+        }
 
-    // Write to disk
-    CTokenTx wtokenTx = tokenTx;
-    if(!fInsertedNew)
-    {
-        wtokenTx.strLabel = it->second.strLabel;
-    }
-    const CBlockIndex *pIndex = ChainActive()[wtokenTx.blockNumber];
-    wtokenTx.nCreateTime = pIndex ? pIndex->GetBlockTime() : chain().getAdjustedTime();
+        CTokenTx wtokenTx = tokenTx;
+        if(!fInsertedNew)
+        {
+            wtokenTx.strLabel = it->second.strLabel;
+        }
+        const CBlockIndex *pIndex = ChainActive()[wtokenTx.blockNumber];
+        wtokenTx.nCreateTime = pIndex ? pIndex->GetBlockTime() : chain().getAdjustedTime();
 
-    if (!batch.WriteTokenTx(wtokenTx))
+        if (!batch.WriteTokenTx(wtokenTx))
+        {
+            batch.TxnAbort();
+            return false;
+        }
+        written.emplace_back(wtokenTx, fInsertedNew);
+    }
+    if (!batch.TxnCommit())
         return false;
 
-    mapTokenTx[hash] = wtokenTx;
+    for (const auto& item : written)
+    {
+        const CTokenTx& wtokenTx = item.first;
+        uint256 hash = wtokenTx.GetHash();
+
+        mapTokenTx[hash] = wtokenTx;
 
-    NotifyTokenTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
+        NotifyTokenTransactionChanged(this, hash, item.second ? CT_NEW : CT_UPDATED);
 
-    LogPrintf("AddTokenTxEntry %s\n", wtokenTx.GetHash().ToString());
+        LogPrintf("AddTokenTxEntry %s\n", hash.ToString());
+    }
 
     return true;
 }
@@ -5313,8 +5883,11 @@ std::vector<OutputGroup> CWallet::GroupOutputs(const std::vector<COutput>& outpu
         if (output.fSpendable) {
             CInputCoin input_coin = output.GetInputCoin();
 
-            size_t ancestors, descendants;
-            chain().getTransactionAncestry(output.tx->GetHash(), ancestors, descendants);
+            // confirmed transactions have no mempool ancestry, which spares a mempool lookup per coin
+            size_t ancestors = 0, descendants = 0;
+            if (output.nDepth == 0) {
+                chain().getTransactionAncestry(output.tx->GetHash(), ancestors, descendants);
+            }
             if (!single_coin && ExtractDestination(output.tx->tx->vout[output.i].scriptPubKey, dst)) {
                 // Limit output groups to no more than 10 entries, to protect
                 // against inadvertently creating a too-large transaction
@@ -5393,6 +5966,7 @@ bool CWallet::Lock()
     {
         LOCK(cs_KeyStore);
         vMasterKey.clear();
+        m_staking_keys.clear();
     }
 
     NotifyStatusChanged(this);
@@ -5453,6 +6027,13 @@ bool CWallet::GetKey(const CKeyID &address, CKey& keyOut) const
         return FillableSigningProvider::GetKey(address, keyOut);
     }
 
+    // the coinstake is signed with the keys found for its kernel
+    auto it = m_staking_keys.find(address);
+    if (it != m_staking_keys.end()) {
+        keyOut = it->second.first;
+        return true;
+    }
+
     CryptedKeyMap::const_iterator mi = mapCryptedKeys.find(address);
     if (mi != mapCryptedKeys.end())
     {
@@ -5463,6 +6044,52 @@ bool CWallet::GetKey(const CKeyID &address, CKey& keyOut) const
     return false;
 }
 
+bool CWallet::GetStakingKey(const CKeyID &address, CKey& keyOut, CPubKey& pubKeyOut) const
+{
+    LOCK(cs_KeyStore);
+    if (!IsCrypted()) {
+        if (!FillableSigningProvider::GetKey(address, keyOut)) return false;
+        pubKeyOut = keyOut.GetPubKey();
+        return true;
+    }
+
+    auto it = m_staking_keys.find(address);
+    if (it != m_staking_keys.end()) {
+        keyOut = it->second.first;
+        pubKeyOut = it->second.second;
+        return true;
+    }
+
+    CryptedKeyMap::const_iterator mi = mapCryptedKeys.find(address);
+    if (mi == mapCryptedKeys.end() || !DecryptKey(vMasterKey, mi->second.second, mi->second.first, keyOut)) {
+        return false;
+    }
+    pubKeyOut = mi->second.first;
+    if (m_staking_keys.size() < MAX_STAKING_KEY_CACHE_SIZE) {
+        m_staking_keys.emplace(address, std::make_pair(keyOut, pubKeyOut));
+    }
+    return true;
+}
+
+void CWallet::CacheStakingKeys(interfaces::Chain::Lock& locked_chain)
+{
+    if (!IsCrypted() || IsLocked()) return;
+
+    std::vector<COutput> vCoins;
+    AvailableCoinsForStaking(locked_chain, vCoins);
+    CKey key;
+    CPubKey pubKey;
+    for (const COutput& out : vCoins) {
+        std::vector<valtype> vSolutions;
+        txnouttype whichType = Solver(out.tx->tx->vout[out.i].scriptPubKey, vSolutions);
+        if (whichType == TX_PUBKEYHASH) {
+            GetStakingKey(CKeyID(uint160(vSolutions[0])), key, pubKey);
+        } else if (whichType == TX_PUBKEY) {
+            GetStakingKey(CKeyID(Hash160(vSolutions[0])), key, pubKey);
+        }
+    }
+}
+
 bool CWallet::GetWatchPubKey(const CKeyID &address, CPubKey &pubkey_out) const
 {
     LOCK(cs_KeyStore);
@@ -5533,6 +6160,7 @@ bool CWallet::AddKeyPubKeyInner(const CKey& key, const CPubKey &pubkey)
 {
     LOCK(cs_KeyStore);
     if (!IsCrypted()) {
+        ClearIsMineCache();
         return FillableSigningProvider::AddKeyPubKey(key, pubkey);
     }
 
@@ -5560,6 +6188,7 @@ bool CWallet::AddCryptedKeyInner(const CPubKey &vchPubKey, const std::vector<uns
         return false;
     }
 
+    ClearIsMineCache();
     mapCryptedKeys[vchPubKey.GetID()] = make_pair(vchPubKey, vchCryptedSecret);
     ImplicitlyLearnRelatedKeyScripts(vchPubKey);
     return true;
@@ -5665,6 +6294,39 @@ bool CWallet::RemoveTokenEntry(const uint256 &tokenHash, bool fFlushOnClose)
     return true;
 }
 
+bool CWallet::GetTokenBalance(const uint256& tokenHash, std::string& balance) const
+{
+    LOCK(cs_wallet);
+
+    // Without receipts the transfers that change the balance are not seen
+    if (!fLogEvents)
+        return false;
+
+    auto it = mapToken.find(tokenHash);
+    if (it == mapToken.end() || it->second.cachedBalanceBlockHash.IsNull())
+        return false;
+
+    balance = it->second.strCachedBalance;
+    return true;
+}
+
+bool CWallet::SetTokenBalance(const uint256& tokenHash, const std::string& balance, const uint256& blockHash)
+{
+    LOCK(cs_wallet);
+
+    // A block connected since the balance was read may have cleared it already
+    if (!fLogEvents || blockHash.IsNull() || blockHash != m_last_block_processed)
+        return false;
+
+    auto it = mapToken.find(tokenHash);
+    if (it == mapToken.end())
+        return false;
+
+    it->second.strCachedBalance = balance;
+    it->second.cachedBalanceBlockHash = blockHash;
+    return true;
+}
+
 bool CWallet::CleanTokenTxEntries(bool fFlushOnClose)
 {
     LOCK(cs_wallet);
@@ -5780,7 +6442,7 @@ bool CWallet::LoadContractData(const std::string &address, const std::string &ke
 
 void CWallet::StakeQtums(bool fStake, CConnman* connman)
 {
-    ::StakeQtums(fStake, this, connman, stakeThread);
+    ::StakeQtums(fStake, this, connman);
 }
 
 void CWallet::StartStake(CConnman *connman)
@@ -5792,11 +6454,88 @@ void CWallet::StartStake(CConnman *connman)
 void CWallet::StopStake()
 {
     m_enabled_staking = false;
-    if(stakeThread)
-    {
-        auto locked_chain = chain().lock();
-        LOCK(cs_wallet);
-        StakeQtums(false, 0);
+    StakeQtums(false, 0);
+}
+
+bool CWallet::ConsolidateStakes()
+{
+    if (chain().isInitialBlockDownload())
+        return false;
+
+    auto locked_chain = chain().lock();
+    LOCK(cs_wallet);
+
+    // staking only unlocks cannot sign anything but coinstakes
+    if (IsLocked() || m_wallet_unlock_staking_only)
+        return false;
+
+    std::vector<COutput> vCoins;
+    AvailableCoinsForStaking(*locked_chain, vCoins);
+
+    const CAmount nCombineThreshold = GetStakeCombineThreshold();
+    std::vector<CRecipient> vecSend;
+    CCoinControl coin_control;
+    coin_control.fAllowOtherInputs = false;
+    coin_control.m_confirm_target = 1008;
+    coin_control.m_fee_mode = FeeEstimateMode::ECONOMICAL;
+
+    // split the first oversized coin into coins of the combine threshold
+    for (const COutput& out : vCoins) {
+        const CTxOut& txout = out.tx->tx->vout[out.i];
+        if (!out.fSpendable || txout.nValue < GetStakeSplitThreshold())
+            continue;
+        unsigned int nOutputs = std::min<CAmount>(txout.nValue / nCombineThreshold, GetStakeMaxCombineInputs());
+        CAmount nValue = (txout.nValue / nOutputs / CENT) * CENT;
+        for (unsigned int i = 0; i < nOutputs; i++) {
+            CAmount nAmount = i + 1 < nOutputs ? nValue : txout.nValue - nValue * (nOutputs - 1);
+            vecSend.push_back({txout.scriptPubKey, nAmount, i + 1 == nOutputs});
+        }
+        coin_control.Select(COutPoint(out.tx->GetHash(), out.i));
+        break;
+    }
+
+    // or combine the smallest coins
+    if (vecSend.empty()) {
+        std::vector<const COutput*> vSmall;
+        for (const COutput& out : vCoins) {
+            if (out.fSpendable && out.tx->tx->vout[out.i].nValue < nCombineThreshold)
+                vSmall.push_back(&out);
+        }
+        std::sort(vSmall.begin(), vSmall.end(), [](const COutput* a, const COutput* b) {
+            return a->tx->tx->vout[a->i].nValue < b->tx->tx->vout[b->i].nValue;
+        });
+
+        CAmount nTotal = 0;
+        unsigned int nInputs = 0;
+        const COutput* pLargest = nullptr;
+        for (const COutput* out : vSmall) {
+            const CAmount nValue = out->tx->tx->vout[out->i].nValue;
+            if (nInputs >= GetStakeMaxCombineInputs() || (nInputs > 0 && nTotal + nValue > nCombineThreshold))
+                break;
+            coin_control.Select(COutPoint(out->tx->GetHash(), out->i));
+            nTotal += nValue;
+            nInputs++;
+            pLargest = out;
+        }
+
+        if (nInputs < STAKE_CONSOLIDATION_MIN_INPUTS)
+            return false;
+        vecSend.push_back({pLargest->tx->tx->vout[pLargest->i].scriptPubKey, nTotal, true});
     }
-    stakeThread = 0;
+
+    CTransactionRef tx;
+    CAmount nFeeRet;
+    int nChangePosRet = -1;
+    std::string strError;
+    if (!CreateTransaction(*locked_chain, vecSend, tx, nFeeRet, nChangePosRet, strError, coin_control)) {
+        WalletLogPrintf("%s: %s\n", __func__, strError);
+        return false;
+    }
+    CValidationState state;
+    if (!CommitTransaction(tx, {}, {} /* orderForm */, state)) {
+        WalletLogPrintf("%s: transaction rejected: %s\n", __func__, FormatStateMessage(state));
+        return false;
+    }
+    WalletLogPrintf("%s: %s spends %d coins into %d\n", __func__, tx->GetHash().ToString(), tx->vin.size(), tx->vout.size());
+    return true;
 }
@@ -7,6 +7,7 @@
 #define BITCOIN_WALLET_WALLET_H
 
 #include <amount.h>
+#include <crypto/siphash.h>
 #include <interfaces/chain.h>
 #include <interfaces/handler.h>
 #include <outputtype.h>
@@ -33,6 +34,7 @@
 #include <stdexcept>
 #include <stdint.h>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -81,11 +83,24 @@ static const bool DEFAULT_AVOIDPARTIALSPENDS = false;
 //! -txconfirmtarget default
 static const unsigned int DEFAULT_TX_CONFIRM_TARGET = 6;
 //! -walletrbf default
+//! Most threads reading and filtering blocks ahead of a rescan
+static const int MAX_RESCAN_THREADS = 8;
+//! Consecutive blocks read by each rescan thread per batch
+static const int RESCAN_SHARD = 16;
 static const bool DEFAULT_WALLET_RBF = false;
 static const bool DEFAULT_WALLETBROADCAST = true;
 static const bool DEFAULT_DISABLE_WALLET = false;
 static const bool DEFAULT_USE_CHANGE_ADDRESS = true;
 static const CAmount DEFAULT_RESERVE_BALANCE = 0;
+static const bool DEFAULT_STAKE_CONSOLIDATION = false;
+//! Number of scripts whose IsMine result the wallet remembers before starting over
+static const size_t MAX_ISMINE_CACHE_SIZE = 200000;
+//! Number of decrypted staking keys the wallet keeps while it is unlocked
+static const size_t MAX_STAKING_KEY_CACHE_SIZE = 1000;
+//! Interval in milliseconds between two stake consolidation runs
+static const int64_t STAKE_CONSOLIDATION_INTERVAL = 10 * 60 * 1000;
+//! Smallest number of coins combined by a stake consolidation, so that the fee pays for a smaller stake set
+static const unsigned int STAKE_CONSOLIDATION_MIN_INPUTS = 10;
 //! -maxtxfee default
 constexpr CAmount DEFAULT_TRANSACTION_MAXFEE{10000 * DEFAULT_TRANSACTION_MINFEE};
 //! Discourage users to set fees higher than this amount (in satoshis) per kB
@@ -105,7 +120,6 @@ class CContractBookData;
 struct FeeCalculation;
 enum class FeeEstimateMode;
 class ReserveDestination;
-namespace boost { class thread_group; }
 
 /** (client) version numbers for particular wallet features */
 enum WalletFeature
@@ -456,6 +470,7 @@ public:
     bool fFromMe;
     int64_t nOrderPos; //!< position in ordered transaction list
     std::multimap<int64_t, CWalletTx*>::const_iterator m_it_wtxOrdered;
+    uint256 m_indexed_block; //!< block the tx is indexed under in CWallet::m_wtx_by_block, null when not confirmed
 
     // memory only
     enum AmountType { DEBIT, CREDIT, IMMATURE_CREDIT, AVAILABLE_CREDIT, AMOUNTTYPE_ENUM_ELEMENTS };
@@ -578,14 +593,8 @@ public:
     }
 
     //! make sure balances are recalculated
-    void MarkDirty()
-    {
-        m_amounts[DEBIT].Reset();
-        m_amounts[CREDIT].Reset();
-        m_amounts[IMMATURE_CREDIT].Reset();
-        m_amounts[AVAILABLE_CREDIT].Reset();
-        fChangeCached = false;
-    }
+    //! Drop the cached amounts, and the balances of the wallet summed from them
+    void MarkDirty();
 
     void BindWallet(CWallet *pwalletIn)
     {
@@ -668,6 +677,7 @@ public:
     void setConflicted() { m_confirm.status = CWalletTx::CONFLICTED; }
     bool isUnconfirmed() const { return m_confirm.status == CWalletTx::UNCONFIRMED; }
     void setUnconfirmed() { m_confirm.status = CWalletTx::UNCONFIRMED; }
+    bool isConfirmed() const { return m_confirm.status == CWalletTx::CONFIRMED; }
     void setConfirmed() { m_confirm.status = CWalletTx::CONFIRMED; }
     const uint256& GetHash() const { return tx->GetHash(); }
     bool IsCoinBase() const { return tx->IsCoinBase(); }
@@ -733,6 +743,21 @@ struct CoinSelectionParams
     CoinSelectionParams() {}
 };
 
+/** Salted SipHash of a script, for the IsMine cache of the wallet */
+class SaltedScriptHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+public:
+    SaltedScriptHasher();
+
+    size_t operator()(const CScript& script) const noexcept {
+        return CSipHasher(k0, k1).Write(script.data(), script.size()).Finalize();
+    }
+};
+
 class WalletRescanReserver; //forward declarations for ScanForWalletTransactions/RescanFromTime
 /**
  * A CWallet is an extension of a keystore, which also maintains a set of transactions and balances,
@@ -767,6 +792,21 @@ private:
     bool AddCryptedKeyInner(const CPubKey &vchPubKey, const std::vector<unsigned char> &vchCryptedSecret);
     bool AddKeyPubKeyInner(const CKey& key, const CPubKey &pubkey);
 
+    /**
+     * IsMine of the output scripts the wallet was asked about, so that the outputs of every connected
+     * block and staking pass are matched with one hash probe instead of solving the script again.
+     * Emptied whenever a key, a script or a watch-only script is added or removed.
+     */
+    mutable std::unordered_map<CScript, isminetype, SaltedScriptHasher> m_ismine_cache GUARDED_BY(cs_KeyStore);
+    void ClearIsMineCache() EXCLUSIVE_LOCKS_REQUIRED(cs_KeyStore) { m_ismine_cache.clear(); }
+
+    /**
+     * Keys of the staking coins with their public keys, kept decrypted while the wallet is unlocked so
+     * that staking does not decrypt and verify them again for every kernel and coinstake signature.
+     * CKey holds its secret in locked memory and wipes it when freed, the map is emptied on Lock.
+     */
+    mutable std::map<CKeyID, std::pair<CKey, CPubKey>> m_staking_keys GUARDED_BY(cs_KeyStore);
+
     std::atomic<bool> fAbortRescan{false};
     std::atomic<bool> fScanningWallet{false}; // controlled by WalletRescanReserver
     std::atomic<int64_t> m_scanning_start{0};
@@ -788,7 +828,51 @@ private:
     // Local time that the tip block was received. Used to schedule wallet rebroadcasts.
     std::atomic<int64_t> m_best_block_time {0};
 
-    std::map<COutPoint, CStakeCache> stakeCache;
+    /** Kernel data of the stakeable coins that are not spent, maintained together with m_stakeable_coins */
+    mutable CStakeCacheMap stakeCache GUARDED_BY(cs_wallet);
+
+    /** Output that can stake while unspent and unlocked, with what IsMine told about it */
+    struct StakeableCoin {
+        int nMatureHeight;
+        bool fSpendable;
+        bool fSolvable;
+        CAmount nValue;
+        //! Counted in m_stake_weight, unspent and unlocked when it was evaluated
+        bool fWeight;
+    };
+
+    /**
+     * Mature, non-contract outputs of the wallet, so that staking rounds do not walk mapWallet.
+     * Confirmed transactions that are not mature yet wait in height buckets, and transactions
+     * changed by the wallet are evaluated again before the next round reads the coins.
+     */
+    mutable std::map<COutPoint, StakeableCoin> m_stakeable_coins GUARDED_BY(cs_wallet);
+    mutable std::map<int, std::set<uint256>> m_stake_maturity GUARDED_BY(cs_wallet);
+    mutable std::map<uint256, int> m_stake_maturity_height GUARDED_BY(cs_wallet);
+    mutable std::set<uint256> m_stake_dirty GUARDED_BY(cs_wallet);
+    /** Sum of the stakeable coins that are unspent and unlocked */
+    mutable CAmount m_stake_weight GUARDED_BY(cs_wallet) = 0;
+    /** Tip height the stakeable coins are up to date with, -1 to rebuild them from mapWallet */
+    mutable int m_stake_tip_height GUARDED_BY(cs_wallet) = -1;
+
+    void UpdateStakeableCoins(interfaces::Chain::Lock& locked_chain) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void UpdateStakeableCoins(interfaces::Chain::Lock& locked_chain, const uint256& wtxid, int nTipHeight, bool fStakeCache) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Evaluate the outputs of wtx and of the transactions it spends again before the next staking round or coin listing */
+    void MarkStakeDirty(const CWalletTx& wtx) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Rebuild the stakeable and unspent coins before they are next read, when what IsMine tells about the outputs changed */
+    void InvalidateStakeableCoins() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet) { m_stake_tip_height = -1; m_unspent_coins_valid = false; }
+
+    /**
+     * Outputs of the wallet that no wallet transaction spent when they were last evaluated, with what
+     * IsMine told about them, so that AvailableCoins does not walk mapWallet. Transactions changed by the
+     * wallet are evaluated again before the next listing, which still checks the spends of these coins.
+     */
+    mutable std::map<COutPoint, isminetype> m_unspent_coins GUARDED_BY(cs_wallet);
+    mutable std::set<uint256> m_unspent_coins_dirty GUARDED_BY(cs_wallet);
+    /** False to rebuild the unspent coins from mapWallet */
+    mutable bool m_unspent_coins_valid GUARDED_BY(cs_wallet) = false;
+
+    void UpdateUnspentCoins(interfaces::Chain::Lock& locked_chain) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     /**
      * Used to keep track of spent outpoints, and
@@ -901,7 +985,6 @@ private:
     /**
      * Wallet staking coins.
      */
-    boost::thread_group* stakeThread = nullptr;
     void StakeQtums(bool fStake, CConnman* connman);
 
 public:
@@ -978,6 +1061,10 @@ public:
 
     typedef std::multimap<int64_t, CWalletTx*> TxItems;
     TxItems wtxOrdered;
+    //! Txs by the destinations their outputs pay to, keyed by order position like wtxOrdered
+    std::map<CTxDestination, TxItems> m_wtx_by_destination GUARDED_BY(cs_wallet);
+    //! Txs by the block they are confirmed in, the ones not confirmed in a block are under the null hash
+    std::map<uint256, std::set<CWalletTx*>> m_wtx_by_block GUARDED_BY(cs_wallet);
 
     int64_t nOrderPosNext GUARDED_BY(cs_wallet) = 0;
     uint64_t nAccountingEntryNumber = 0;
@@ -1032,7 +1119,7 @@ public:
      * completion the coin set and corresponding actual target value is
      * assembled
      */
-    bool SelectCoinsMinConf(const CAmount& nTargetValue, const CoinEligibilityFilter& eligibility_filter, std::vector<OutputGroup> groups,
+    bool SelectCoinsMinConf(const CAmount& nTargetValue, const CoinEligibilityFilter& eligibility_filter, const std::vector<OutputGroup>& groups,
         std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, const CoinSelectionParams& coin_selection_params, bool& bnb_used) const;
 
     bool IsSpent(interfaces::Chain::Lock& locked_chain, const uint256& hash, unsigned int n) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
@@ -1082,6 +1169,10 @@ public:
     //! Adds an encrypted key to the store, without saving it to disk (used by LoadWallet)
     bool LoadCryptedKey(const CPubKey &vchPubKey, const std::vector<unsigned char> &vchCryptedSecret);
     bool GetKey(const CKeyID &address, CKey& keyOut) const override;
+    //! GetKey for the keys of staking coins, remembering them decrypted until the wallet locks
+    bool GetStakingKey(const CKeyID &address, CKey& keyOut, CPubKey& pubKeyOut) const;
+    //! Decrypt the keys of the coins available for staking before the first kernel is found
+    void CacheStakingKeys(interfaces::Chain::Lock& locked_chain) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     bool GetPubKey(const CKeyID &address, CPubKey& vchPubKeyOut) const override;
     bool HaveKey(const CKeyID &address) const override;
     std::set<CKeyID> GetKeys() const override;
@@ -1138,10 +1229,17 @@ public:
     void MarkDirty();
     bool AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose=true);
     void LoadToWallet(CWalletTx& wtxIn) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Add a tx inserted in mapWallet and wtxOrdered to m_wtx_by_destination and m_wtx_by_block */
+    void AddToTxIndexes(CWalletTx& wtx) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Move a tx to the block it is now confirmed in within m_wtx_by_block */
+    void UpdateTxBlockIndex(CWalletTx& wtx) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void RemoveFromTxIndexes(CWalletTx& wtx) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void TransactionAddedToMempool(const CTransactionRef& tx) override;
     void BlockConnected(const CBlock& block, const std::vector<CTransactionRef>& vtxConflicted) override;
     void BlockDisconnected(const CBlock& block) override;
     void UpdatedBlockTip() override;
+    /** Record the Transfer events of the wallet tokens found in the receipts of a connected block */
+    void SyncTokenTransfers(const CBlock& block, int height) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     int64_t RescanFromTime(int64_t startTime, const WalletRescanReserver& reserver, bool update);
 
     struct ScanResult {
@@ -1174,6 +1272,18 @@ public:
         CAmount m_watchonly_stake{0};
     };
     Balance GetBalance(int min_depth = 0, bool avoid_reuse = true) const;
+
+    /** Drop the balances cached by GetBalance, on any change to the wallet transactions that may move them */
+    void MarkBalanceDirty() { m_balance_generation++; }
+
+    /** Balances summed by GetBalance, by min_depth and avoid_reuse. Valid while the chain tip and the balance generation are unchanged. */
+    struct CachedBalance {
+        uint256 tip;
+        uint64_t generation;
+        Balance balance;
+    };
+    mutable std::map<std::pair<int, bool>, CachedBalance> m_balance_cache GUARDED_BY(cs_wallet);
+    std::atomic<uint64_t> m_balance_generation{0};
     CAmount GetAvailableBalance(const CCoinControl* coinControl = nullptr) const;
 
     OutputType TransactionChangeType(OutputType change_type, const std::vector<CRecipient>& vecSend);
@@ -1194,8 +1304,8 @@ public:
                            std::string& strFailReason, const CCoinControl& coin_control, bool sign = true, CAmount nGasFee=0, bool hasSender=false, const CTxDestination& signSenderAddress = CNoDestination());
     bool CommitTransaction(CTransactionRef tx, mapValue_t mapValue, std::vector<std::pair<std::string, std::string>> orderForm, CValidationState& state);
 
-    uint64_t GetStakeWeight(interfaces::Chain::Lock& locked_chain) const;
-    bool CreateCoinStake(interfaces::Chain::Lock& locked_chain, const FillableSigningProvider &keystore, unsigned int nBits, const CAmount& nTotalFees, uint32_t nTimeBlock, CMutableTransaction& tx, CKey& key, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoins);
+    uint64_t GetStakeWeight(interfaces::Chain::Lock& locked_chain) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    bool CreateCoinStake(interfaces::Chain::Lock& locked_chain, unsigned int nBits, const CAmount& nTotalFees, uint32_t nTimeBlock, CMutableTransaction& tx, CKey& key, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoins);
 
     bool DummySignTx(CMutableTransaction &txNew, const std::set<CTxOut> &txouts, bool use_max_sig = false) const
     {
@@ -1495,6 +1605,9 @@ public:
     /* Add token tx entry into the wallet */
     bool AddTokenTxEntry(const CTokenTx& tokenTx, bool fFlushOnClose=true);
 
+    /* Add token tx entries into the wallet, written in a single database transaction */
+    bool AddTokenTxEntries(const std::vector<CTokenTx>& tokenTxs, bool fFlushOnClose=true);
+
     /* Get details token tx entry into the wallet */
     bool GetTokenTxDetails(const CTokenTx &wtx, uint256& credit, uint256& debit, std::string& tokenSymbol, uint8_t& decimals) const;
 
@@ -1507,12 +1620,25 @@ public:
     /* Clean token transaction entries in the wallet */
     bool CleanTokenTxEntries(bool fFlushOnClose=true);
 
+    /* Get the cached balance of a token */
+    bool GetTokenBalance(const uint256& tokenHash, std::string& balance) const;
+
+    /* Cache the balance of a token read at blockHash, ignored when the wallet has moved past that block */
+    bool SetTokenBalance(const uint256& tokenHash, const std::string& balance, const uint256& blockHash);
+
     /* Start staking MRX */
     void StartStake(CConnman* connman = CWallet::defaultConnman);
 
     /* Stop staking MRX */
     void StopStake();
 
+    /**
+     * Send one low fee transaction that splits a coin above the stake split threshold, or else combines
+     * the smallest stakeable coins up to the stake combine threshold, so that staking walks fewer coins.
+     * Returns true when a transaction was sent.
+     */
+    bool ConsolidateStakes();
+
     static CConnman* defaultConnman;
 };
 
@@ -1522,6 +1648,9 @@ public:
  */
 void MaybeResendWalletTxs();
 
+/** Called periodically by the schedule thread when -stakeconsolidation is set */
+void MaybeConsolidateStakes();
+
 /** RAII object to check and reserve a wallet rescan */
 class WalletRescanReserver
 {
@@ -1582,6 +1711,11 @@ public:
     uint256 blockHash;
     int64_t blockNumber;
 
+    // Cached balance of the sender address and the tip it was read at, not serialized.
+    // Cleared when a Transfer event of the token touching the sender is connected.
+    std::string strCachedBalance;
+    uint256 cachedBalanceBlockHash;
+
     CTokenInfo()
     {
         SetNull();
@@ -1616,6 +1750,8 @@ public:
         strSenderAddress = "";
         blockHash.SetNull();
         blockNumber = -1;
+        strCachedBalance = "";
+        cachedBalanceBlockHash.SetNull();
     }
 
     uint256 GetHash() const;
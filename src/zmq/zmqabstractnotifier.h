@@ -7,6 +7,7 @@
 
 #include <zmq/zmqconfig.h>
 
+class CBlock;
 class CBlockIndex;
 class CZMQAbstractNotifier;
 
@@ -40,8 +41,16 @@ public:
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
 
-    virtual bool NotifyBlock(const CBlockIndex *pindex);
+    /** pblock is the connected block when it is at hand, null otherwise */
+    virtual bool NotifyBlock(const CBlockIndex *pindex, const CBlock *pblock);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    /** Called once the receipts of a connected block are stored, only with -logevents */
+    virtual bool NotifyReceipts(const CBlock &block, const CBlockIndex *pindex);
+    /** Chain and mempool events, in the order they happen */
+    virtual bool NotifyBlockConnect(const CBlockIndex *pindex);
+    virtual bool NotifyBlockDisconnect(const CBlock &block);
+    virtual bool NotifyTransactionAcceptance(const CTransaction &transaction);
+    virtual bool NotifyTransactionRemoval(const CTransaction &transaction);
 
 protected:
     void *psocket;
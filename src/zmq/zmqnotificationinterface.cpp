@@ -47,6 +47,9 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     factories["pubhashtx"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionNotifier>;
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
+    factories["pubsequence"] = CZMQAbstractNotifier::Create<CZMQPublishSequenceNotifier>;
+    factories["pubrawreceipt"] = CZMQAbstractNotifier::Create<CZMQPublishRawReceiptNotifier>;
+    factories["publogs"] = CZMQAbstractNotifier::Create<CZMQPublishLogsNotifier>;
 
     for (const auto& entry : factories)
     {
@@ -116,6 +119,8 @@ bool CZMQNotificationInterface::Initialize()
         return false;
     }
 
+    StartZMQPublisher();
+
     return true;
 }
 
@@ -125,6 +130,9 @@ void CZMQNotificationInterface::Shutdown()
     LogPrint(BCLog::ZMQ, "zmq: Shutdown notification interface\n");
     if (pcontext)
     {
+        // send what is still queued while the sockets are open
+        StopZMQPublisher();
+
         for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
         {
             CZMQAbstractNotifier *notifier = *i;
@@ -137,15 +145,16 @@ void CZMQNotificationInterface::Shutdown()
     }
 }
 
-void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
-{
-    if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
-        return;
+namespace {
 
+/** Run func on every notifier, shutting down and dropping the ones it fails for */
+template <typename Function>
+void TryForEachAndRemoveFailed(std::list<CZMQAbstractNotifier*>& notifiers, const Function& func)
+{
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlock(pindexNew))
+        if (func(notifier))
         {
             i++;
         }
@@ -157,41 +166,83 @@ void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, co
     }
 }
 
+} // anonymous namespace
+
+void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    // BlockConnected signalled the new tip just before, its block saves reading it back from disk
+    std::shared_ptr<const CBlock> pblock = std::move(lastConnectedBlock);
+    lastConnectedBlock.reset();
+
+    if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
+        return;
+
+    if (pblock && pblock->GetHash() != pindexNew->GetBlockHash())
+        pblock.reset();
+
+    TryForEachAndRemoveFailed(notifiers, [pindexNew, &pblock](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyBlock(pindexNew, pblock.get());
+    });
+}
+
+void CZMQNotificationInterface::NotifyTransactions(const std::vector<CTransactionRef>& vtx)
+{
+    for (const CTransactionRef& ptx : vtx) {
+        const CTransaction& tx = *ptx;
+        TryForEachAndRemoveFailed(notifiers, [&tx](CZMQAbstractNotifier* notifier) {
+            return notifier->NotifyTransaction(tx);
+        });
+    }
+}
+
 void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef& ptx)
 {
-    // Used by BlockConnected and BlockDisconnected as well, because they're
-    // all the same external callback.
     const CTransaction& tx = *ptx;
 
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
-    {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyTransaction(tx))
-        {
-            i++;
-        }
-        else
-        {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
-        }
-    }
+    TryForEachAndRemoveFailed(notifiers, [&tx](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyTransaction(tx) && notifier->NotifyTransactionAcceptance(tx);
+    });
+}
+
+void CZMQNotificationInterface::TransactionRemovedFromMempool(const CTransactionRef& ptx)
+{
+    // Called for evictions, expiry and replacements; transactions mined or
+    // conflicted by a block are covered by the block connect event.
+    const CTransaction& tx = *ptx;
+
+    TryForEachAndRemoveFailed(notifiers, [&tx](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyTransactionRemoval(tx);
+    });
 }
 
 void CZMQNotificationInterface::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted)
 {
-    for (const CTransactionRef& ptx : pblock->vtx) {
-        // Do a normal notify for each transaction added in the block
-        TransactionAddedToMempool(ptx);
-    }
+    lastConnectedBlock = pblock;
+
+    // Do a normal notify for each transaction added in the block
+    NotifyTransactions(pblock->vtx);
+
+    TryForEachAndRemoveFailed(notifiers, [pindexConnected](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyBlockConnect(pindexConnected);
+    });
+
+    // ConnectBlock stored the receipts before signalling the block, they are only kept with -logevents
+    if (!fLogEvents)
+        return;
+
+    TryForEachAndRemoveFailed(notifiers, [&pblock, pindexConnected](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyReceipts(*pblock, pindexConnected);
+    });
 }
 
 void CZMQNotificationInterface::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock)
 {
-    for (const CTransactionRef& ptx : pblock->vtx) {
-        // Do a normal notify for each transaction removed in block disconnection
-        TransactionAddedToMempool(ptx);
-    }
+    // Do a normal notify for each transaction removed in block disconnection
+    NotifyTransactions(pblock->vtx);
+
+    TryForEachAndRemoveFailed(notifiers, [&pblock](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyBlockDisconnect(*pblock);
+    });
 }
 
 CZMQNotificationInterface* g_zmq_notification_interface = nullptr;
@@ -9,6 +9,8 @@
 #include <string>
 #include <map>
 #include <list>
+#include <memory>
+#include <vector>
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
@@ -28,6 +30,7 @@ protected:
 
     // CValidationInterface
     void TransactionAddedToMempool(const CTransactionRef& tx) override;
+    void TransactionRemovedFromMempool(const CTransactionRef& tx) override;
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted) override;
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) override;
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
@@ -35,8 +38,13 @@ protected:
 private:
     CZMQNotificationInterface();
 
+    /** hashtx and rawtx for the transactions of a connected or disconnected block */
+    void NotifyTransactions(const std::vector<CTransactionRef>& vtx);
+
     void *pcontext;
     std::list<CZMQAbstractNotifier*> notifiers;
+    /** The block of the last BlockConnected, kept for the UpdatedBlockTip that follows it */
+    std::shared_ptr<const CBlock> lastConnectedBlock;
 };
 
 extern CZMQNotificationInterface* g_zmq_notification_interface;
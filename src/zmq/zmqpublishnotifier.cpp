@@ -9,6 +9,14 @@
 #include <validation.h>
 #include <util/system.h>
 #include <rpc/server.h>
+#include <qtum/storageresults.h>
+#include <util/convert.h>
+#include <util/strencodings.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <thread>
 
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
@@ -16,6 +24,9 @@ static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
+static const char *MSG_RAWRECEIPT = "rawreceipt";
+static const char *MSG_LOGS      = "logs";
+static const char *MSG_SEQUENCE  = "sequence";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -60,6 +71,116 @@ static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
     return 0;
 }
 
+namespace {
+
+/**
+ * Sends the messages of all publish notifiers from a thread of its own, so
+ * a slow subscriber never holds up the validation callbacks. ZMQ sockets are
+ * not thread safe: once the thread runs, it is the only one sending.
+ */
+class ZMQPublisher
+{
+private:
+    struct Message {
+        void *psocket;
+        const char *command;
+        std::string data;
+        unsigned char msgseq[sizeof(uint32_t)];
+    };
+
+    Mutex mutex;
+    std::condition_variable cond;
+    std::deque<Message> queue GUARDED_BY(mutex);
+    size_t queueBytes GUARDED_BY(mutex) {0};
+    bool sending GUARDED_BY(mutex) {false};
+    bool stop GUARDED_BY(mutex) {false};
+    std::thread thread;
+
+    void ThreadPublish()
+    {
+        while (true) {
+            Message message;
+            {
+                WAIT_LOCK(mutex, lock);
+                sending = false;
+                cond.notify_all();
+                cond.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(mutex) { return stop || !queue.empty(); });
+                if (queue.empty())
+                    return;
+                message = std::move(queue.front());
+                queue.pop_front();
+                queueBytes -= message.data.size();
+                sending = true;
+            }
+            /* send three parts, command & data & a LE 4byte sequence number */
+            if (zmq_send_multipart(message.psocket, message.command, strlen(message.command), message.data.data(), message.data.size(), message.msgseq, (size_t)sizeof(uint32_t), nullptr) == -1)
+                LogPrint(BCLog::ZMQ, "zmq: Failed to publish %s\n", message.command);
+        }
+    }
+
+public:
+    void Start()
+    {
+        {
+            LOCK(mutex);
+            stop = false;
+        }
+        thread = std::thread(&TraceThread<std::function<void()>>, "zmqpub", std::bind(&ZMQPublisher::ThreadPublish, this));
+    }
+
+    /** Send what is queued and stop the thread */
+    void Stop()
+    {
+        {
+            LOCK(mutex);
+            stop = true;
+        }
+        cond.notify_all();
+        if (thread.joinable())
+            thread.join();
+    }
+
+    /** Wait until nothing is queued or being sent, before a socket is closed */
+    void Flush()
+    {
+        WAIT_LOCK(mutex, lock);
+        cond.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(mutex) { return !thread.joinable() || (queue.empty() && !sending); });
+    }
+
+    /** Queue a message, or drop it once the queue is full like a socket past its high water mark */
+    bool Push(void *psocket, const char *command, const void* data, size_t size, uint32_t nSequence)
+    {
+        {
+            LOCK(mutex);
+            if (stop || !thread.joinable() || queueBytes + size > CZMQAbstractPublishNotifier::MAX_QUEUE_BYTES)
+                return false;
+            Message message;
+            message.psocket = psocket;
+            message.command = command;
+            message.data.assign((const char*)data, size);
+            WriteLE32(&message.msgseq[0], nSequence);
+            queueBytes += size;
+            queue.push_back(std::move(message));
+        }
+        cond.notify_all();
+        return true;
+    }
+};
+
+ZMQPublisher g_zmq_publisher;
+
+} // anonymous namespace
+
+void StartZMQPublisher()
+{
+    g_zmq_publisher.Start();
+}
+
+void StopZMQPublisher()
+{
+    g_zmq_publisher.Stop();
+}
+
 bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 {
     assert(!psocket);
@@ -114,6 +235,9 @@ void CZMQAbstractPublishNotifier::Shutdown()
 {
     assert(psocket);
 
+    // messages still queued for the socket must be sent before it is closed
+    g_zmq_publisher.Flush();
+
     int count = mapPublishNotifiers.count(address);
 
     // remove this notifier from the list of publishers using this address
@@ -144,20 +268,17 @@ bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* d
 {
     assert(psocket);
 
-    /* send three parts, command & data & a LE 4byte sequence number */
-    unsigned char msgseq[sizeof(uint32_t)];
-    WriteLE32(&msgseq[0], nSequence);
-    int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), nullptr);
-    if (rc == -1)
-        return false;
+    // a dropped message still takes its sequence number, so subscribers see the gap
+    if (!g_zmq_publisher.Push(psocket, command, data, size, nSequence))
+        LogPrint(BCLog::ZMQ, "zmq: Publish queue full, dropped %s\n", command);
 
-    /* increment memory only sequence number after sending */
+    /* increment memory only sequence number after queueing */
     nSequence++;
 
     return true;
 }
 
-bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const CBlock * /*pblock*/)
 {
     uint256 hash = pindex->GetBlockHash();
     LogPrint(BCLog::ZMQ, "zmq: Publish hashblock %s\n", hash.GetHex());
@@ -177,22 +298,24 @@ bool CZMQPublishHashTransactionNotifier::NotifyTransaction(const CTransaction &t
     return SendMessage(MSG_HASHTX, data, 32);
 }
 
-bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const CBlock *pblock)
 {
     LogPrint(BCLog::ZMQ, "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
 
-    const Consensus::Params& consensusParams = Params().GetConsensus();
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    {
+    if (pblock) {
+        ss << *pblock;
+    } else {
+        const Consensus::Params& consensusParams = Params().GetConsensus();
         LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
+        std::shared_ptr<const CBlock> pblockRead;
+        if(!ReadBlockFromDisk(pblockRead, pindex, consensusParams))
         {
             zmqError("Can't read block from disk");
             return false;
         }
 
-        ss << block;
+        ss << *pblockRead;
     }
 
     return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
@@ -206,3 +329,105 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+/** The body of a sequence message: the hash, reversed like hashblock and hashtx, then the event label */
+static bool SendSequenceMsg(CZMQAbstractPublishNotifier& notifier, const uint256& hash, char label)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish sequence %s %c\n", hash.GetHex(), label);
+    unsigned char data[33];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    data[32] = label;
+    return notifier.SendMessage(MSG_SEQUENCE, data, sizeof(data));
+}
+
+bool CZMQPublishSequenceNotifier::NotifyBlockConnect(const CBlockIndex *pindex)
+{
+    return SendSequenceMsg(*this, pindex->GetBlockHash(), 'C');
+}
+
+bool CZMQPublishSequenceNotifier::NotifyBlockDisconnect(const CBlock &block)
+{
+    return SendSequenceMsg(*this, block.GetHash(), 'D');
+}
+
+bool CZMQPublishSequenceNotifier::NotifyTransactionAcceptance(const CTransaction &transaction)
+{
+    return SendSequenceMsg(*this, transaction.GetHash(), 'A');
+}
+
+bool CZMQPublishSequenceNotifier::NotifyTransactionRemoval(const CTransaction &transaction)
+{
+    return SendSequenceMsg(*this, transaction.GetHash(), 'R');
+}
+
+bool CZMQPublishRawReceiptNotifier::NotifyReceipts(const CBlock &block, const CBlockIndex *pindex)
+{
+    for (const CTransactionRef& tx : block.vtx) {
+        // contract transactions and the coinstake running the DGP contracts carry receipts
+        if (!tx->HasCreateOrCall() && !tx->IsCoinStake())
+            continue;
+        // the receipts are published as stored, like the binary /rest/receipt
+        std::string value;
+        if (!pstorageresult->getRawResult(uintToh256(tx->GetHash()), value))
+            continue;
+        LogPrint(BCLog::ZMQ, "zmq: Publish rawreceipt %s\n", tx->GetHash().GetHex());
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << tx->GetHash() << value;
+        if (!SendMessage(MSG_RAWRECEIPT, &(*ss.begin()), ss.size()))
+            return false;
+    }
+    return true;
+}
+
+bool CZMQPublishLogsNotifier::Initialize(void *pcontext)
+{
+    for (const std::string& address : gArgs.GetArgs("-zmqpublogsaddress")) {
+        if (address.size() != 40 || !IsHex(address)) {
+            LogPrintf("zmq: Invalid -zmqpublogsaddress %s\n", address);
+            return false;
+        }
+        addresses.insert(dev::Address(address));
+    }
+    return CZMQAbstractPublishNotifier::Initialize(pcontext);
+}
+
+bool CZMQPublishLogsNotifier::NotifyReceipts(const CBlock &block, const CBlockIndex *pindex)
+{
+    const uint256 block_hash = pindex->GetBlockHash();
+    for (const CTransactionRef& tx : block.vtx) {
+        if (!tx->HasCreateOrCall() && !tx->IsCoinStake())
+            continue;
+        std::vector<TransactionReceiptInfo> receipts;
+        if (!pstorageresult->getResultLogs(uintToh256(tx->GetHash()), receipts))
+            continue;
+
+        // one message per transaction: its hash, then the matching logs with the output that emitted them
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << tx->GetHash();
+        uint32_t count = 0;
+        CDataStream ssLogs(SER_NETWORK, PROTOCOL_VERSION);
+        for (const TransactionReceiptInfo& receipt : receipts) {
+            if (h256Touint(receipt.blockHash) != block_hash)
+                continue;
+            for (const dev::eth::LogEntry& log : receipt.logs) {
+                if (!addresses.empty() && !addresses.count(log.address))
+                    continue;
+                std::vector<uint256> topics;
+                for (const dev::h256& topic : log.topics)
+                    topics.push_back(h256Touint(topic));
+                ssLogs << receipt.outputIndex << uint160(log.address.asBytes()) << topics << log.data;
+                count++;
+            }
+        }
+        if (count == 0)
+            continue;
+        WriteCompactSize(ss, count);
+        ss.write(&(*ssLogs.begin()), ssLogs.size());
+
+        LogPrint(BCLog::ZMQ, "zmq: Publish logs %s\n", tx->GetHash().GetHex());
+        if (!SendMessage(MSG_LOGS, &(*ss.begin()), ss.size()))
+            return false;
+    }
+    return true;
+}
@@ -7,6 +7,10 @@
 
 #include <zmq/zmqabstractnotifier.h>
 
+#include <libdevcore/FixedHash.h>
+
+#include <set>
+
 class CBlockIndex;
 
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
@@ -15,8 +19,10 @@ private:
     uint32_t nSequence {0U}; //!< upcounting per message sequence number
 
 public:
+    /** Most bytes queued for sending over all publish notifiers */
+    static const size_t MAX_QUEUE_BYTES {256 * 1024 * 1024};
 
-    /* send zmq multipart message
+    /* queue zmq multipart message for the publisher thread
        parts:
           * command
           * data
@@ -31,7 +37,7 @@ public:
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex) override;
+    bool NotifyBlock(const CBlockIndex *pindex, const CBlock *pblock) override;
 };
 
 class CZMQPublishHashTransactionNotifier : public CZMQAbstractPublishNotifier
@@ -43,7 +49,7 @@ public:
 class CZMQPublishRawBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex) override;
+    bool NotifyBlock(const CBlockIndex *pindex, const CBlock *pblock) override;
 };
 
 class CZMQPublishRawTransactionNotifier : public CZMQAbstractPublishNotifier
@@ -52,4 +58,33 @@ public:
     bool NotifyTransaction(const CTransaction &transaction) override;
 };
 
+class CZMQPublishSequenceNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlockConnect(const CBlockIndex *pindex) override;
+    bool NotifyBlockDisconnect(const CBlock &block) override;
+    bool NotifyTransactionAcceptance(const CTransaction &transaction) override;
+    bool NotifyTransactionRemoval(const CTransaction &transaction) override;
+};
+
+class CZMQPublishRawReceiptNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyReceipts(const CBlock &block, const CBlockIndex *pindex) override;
+};
+
+class CZMQPublishLogsNotifier : public CZMQAbstractPublishNotifier
+{
+private:
+    std::set<dev::Address> addresses; //!< contracts whose logs are published, all when empty
+
+public:
+    bool Initialize(void *pcontext) override;
+    bool NotifyReceipts(const CBlock &block, const CBlockIndex *pindex) override;
+};
+
+/** Start and stop the thread sending the messages of all publish notifiers */
+void StartZMQPublisher();
+void StopZMQPublisher();
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
@@ -39,6 +39,12 @@ class TestBitcoinCli(BitcoinTestFramework):
         assert_equal(["foo", "bar"], self.nodes[0].cli('-rpcuser=%s' % user, '-stdin', '-stdinrpcpass', input=password + "\nfoo\nbar").echo())
         assert_raises_process_error(1, "Incorrect rpcuser or rpcpassword", self.nodes[0].cli('-rpcuser=%s' % user, '-stdin', '-stdinrpcpass', input="foo").echo)
 
+        self.log.info("Test -stdinrpcpipe")
+        out = self.nodes[0].cli('-stdinrpcpipe', input="getblockcount\necho foo 'bar baz'\n\ngetblockhash 0\n").send_cli()
+        assert_equal(out.split("\n"), [str(self.nodes[0].getblockcount()), '["foo","bar baz"]', self.nodes[0].getblockhash(0)])
+        assert_raises_process_error(1, "", self.nodes[0].cli('-stdinrpcpipe', input="getblockhash 0\ngetblockhash -1\n").send_cli)
+        assert_raises_process_error(1, "takes no command", self.nodes[0].cli('-stdinrpcpipe', input="getblockcount").getblockcount)
+
         self.log.info("Test connecting to a non-existing server")
         assert_raises_process_error(1, "Could not connect to the server", self.nodes[0].cli('-rpcport=1').echo)
 
@@ -329,5 +329,40 @@ class RESTTest (BitcoinTestFramework):
         json_obj = self.test_rest_request("/chaininfo")
         assert_equal(json_obj['bestblockhash'], bb_hash)
 
+        self.log.info("Test the /subscribe URI")
+
+        conn = http.client.HTTPConnection(self.url.hostname, self.url.port)
+        conn.request('GET', '/rest/subscribe?events=blocks')
+        resp = conn.getresponse()
+        assert_equal(resp.status, 200)
+        assert_equal(resp.getheader('Content-Type'), 'text/event-stream')
+
+        def read_event():
+            name, data = None, None
+            while True:
+                line = resp.readline().decode('utf-8').rstrip('\n')
+                if line.startswith('event: '):
+                    name = line[len('event: '):]
+                elif line.startswith('data: '):
+                    data = json.loads(line[len('data: '):])
+                elif line == '' and name is not None:
+                    return name, data
+
+        # the current tip comes first, then every new tip
+        name, data = read_event()
+        assert_equal(name, 'block')
+        assert_equal(data['hash'], bb_hash)
+        newblockhash = self.nodes[0].generate(1)[0]
+        name, data = read_event()
+        assert_equal(name, 'block')
+        assert_equal(data['hash'], newblockhash)
+        assert_equal(data['height'], self.nodes[0].getblockcount())
+        conn.close()
+
+        for query in ['events=unknown', 'events=blocks&topics=null', 'addresses=00']:
+            conn = http.client.HTTPConnection(self.url.hostname, self.url.port)
+            conn.request('GET', '/rest/subscribe?' + query)
+            assert_equal(conn.getresponse().status, 400)
+
 if __name__ == '__main__':
     RESTTest().main()
@@ -7,7 +7,7 @@
 import os
 from test_framework.authproxy import JSONRPCException
 from test_framework.test_framework import BitcoinTestFramework
-from test_framework.util import assert_equal, assert_greater_than_or_equal
+from test_framework.util import assert_equal, assert_greater_than_or_equal, assert_raises_rpc_error
 
 def expect_http_status(expected_http_status, expected_rpc_code,
                        fcn, *args):
@@ -60,16 +60,55 @@ class RPCInterfaceTest(BitcoinTestFramework):
         assert_equal(result_by_id[3]['error'], None)
         assert result_by_id[3]['result'] is not None
 
+        self.log.info("Testing JSON-RPC batch replies keep the request order...")
+        best_block_hash = self.nodes[0].getbestblockhash()
+        requests = []
+        for i in range(100):
+            if i % 2:
+                requests.append({"method": "getbestblockhash", "id": i})
+            else:
+                requests.append({"method": "getblockhash", "params": [i], "id": i})
+        results = self.nodes[0].batch(requests)
+        assert_equal([res["id"] for res in results], list(range(100)))
+        assert_equal(results[0]['result'], self.nodes[0].getblockhash(0))
+        for res in results[1:]:
+            if res["id"] % 2:
+                assert_equal(res['result'], best_block_hash)
+            else:
+                assert_equal(res['error']['code'], -8)
+
     def test_http_status_codes(self):
         self.log.info("Testing HTTP status codes for JSON-RPC requests...")
 
         expect_http_status(404, -32601, self.nodes[0].invalidmethod)
         expect_http_status(500, -8, self.nodes[0].getblockhash, 42)
 
+    def test_getrpcmetrics(self):
+        self.log.info("Testing getrpcmetrics...")
+
+        node = self.nodes[0]
+        baseline = node.getrpcmetrics().get('getblockhash', {'errors': 0, 'execution': {'count': 0}})
+        node.getblockhash(0)
+        assert_raises_rpc_error(-8, "Block height out of range", node.getblockhash, 42)
+
+        metrics = node.getrpcmetrics()['getblockhash']
+        assert_equal(metrics['errors'], baseline['errors'] + 1)
+        assert_equal(metrics['execution']['count'], baseline['execution']['count'] + 2)
+        assert_equal(sum(metrics['execution']['buckets'].values()), metrics['execution']['count'])
+        assert_greater_than_or_equal(metrics['queue']['count'], 2)
+        assert_greater_than_or_equal(metrics['response']['count'], 1)
+        assert_greater_than_or_equal(metrics['response']['total'], len(node.getblockhash(0)))
+
+        text = node.getrpcmetrics("prometheus")
+        assert 'metrix_rpc_execution_seconds_count{method="getblockhash"}' in text
+        assert 'metrix_rpc_lock_wait_seconds_bucket{method="getblockhash",le="+Inf"}' in text
+        assert_raises_rpc_error(-8, "Unknown format", node.getrpcmetrics, "xml")
+
     def run_test(self):
         self.test_getrpcinfo()
         self.test_batch_request()
         self.test_http_status_codes()
+        self.test_getrpcmetrics()
 
 
 if __name__ == '__main__':
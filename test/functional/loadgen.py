@@ -0,0 +1,262 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021 The Metrix Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Generate contract traffic on a regtest node and report how the node copes.
+
+This is not a test and test_runner does not run it. Start it by hand, for example:
+
+    test/functional/loadgen.py --tps=20 --duration=300 --tokens=10 --senders=50 --randomseed=1
+
+It creates --tokens token contracts and --senders funded sender addresses, then sends
+a mix of token transfers, contract creations and DGP proposals (--mix) at --tps,
+and mines a block every --blockinterval seconds. The choices are drawn from the
+test framework PRNG, so a run with the same --randomseed sends the same traffic.
+
+At the end it reports:
+- the mempool accept latency, which is the time sendrawtransaction takes;
+- the share of transactions included in the next block and by the end of the run;
+- the ConnectBlock time of the blocks mined during the load, from the -debug=bench log.
+
+--report writes the same numbers as JSON, so runs on different commits can be compared.
+"""
+
+import itertools
+import json
+import os
+import random
+import re
+import time
+
+from test_framework.authproxy import JSONRPCException
+from test_framework.qtum import DGP_GOVERNANCE_BYTECODE, DGPState, p2pkh_to_hex_hash
+from test_framework.qtumconfig import COINBASE_MATURITY, QTUM_MIN_GAS_PRICE_STR
+from test_framework.test_framework import BitcoinTestFramework
+
+# A minimal MRC20 style token. The constructor gives the whole supply to the creator.
+# Only transfer(address,uint256) and balanceOf(address) exist, balances are stored
+# under the address itself.
+#
+#   constructor: PUSH32 supply CALLER SSTORE, then return the runtime code
+#   runtime:     selector = CALLDATALOAD(0) / 2**224
+#     a9059cbb:  amount = CALLDATALOAD(0x24); revert if SLOAD(CALLER) < amount
+#                SSTORE(CALLER, SLOAD(CALLER) - amount)
+#                SSTORE(CALLDATALOAD(4), SLOAD(CALLDATALOAD(4)) + amount); return 1
+#     70a08231:  return SLOAD(CALLDATALOAD(4))
+#     otherwise: revert
+TOKEN_BYTECODE = (
+    "7f000000000000000000000000000000000000000c9f2c9cd04674edea40000000"
+    "3355606c80602e6000396000f3"
+    "6000357c0100000000000000000000000000000000000000000000000000000000"
+    "90048063a9059cbb14603b576370a0823114605f575b600080fd5b602435335481"
+    "81106036578190033355600435805482019055600160005260206000f35b600435"
+    "5460005260206000f3"
+)
+TOKEN_TRANSFER = "a9059cbb"
+TOKENS_PER_SENDER = 10**24
+
+TRANSFER_GAS = 100000
+CREATE_GAS = 500000
+DGP_GAS = 2000000
+
+# Unconfirmed transactions a single address may chain before a block is needed
+MAX_UNCONFIRMED_SETUP_TXS = 20
+
+TX_KINDS = ("transfer", "create", "dgp")
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def summary(values):
+    return {
+        "count": len(values),
+        "mean": sum(values) / len(values) if values else 0.0,
+        "p50": percentile(values, 50),
+        "p90": percentile(values, 90),
+        "p99": percentile(values, 99),
+        "max": max(values) if values else 0.0,
+    }
+
+
+class LoadGenerator(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [['-debug=bench', '-minmempoolgaslimit=21000']]
+
+    def add_options(self, parser):
+        parser.add_argument("--tps", dest="tps", default=10.0, type=float,
+                            help="Transactions sent per second (default: %(default)s)")
+        parser.add_argument("--duration", dest="duration", default=60, type=int,
+                            help="Seconds the load is sent for (default: %(default)s)")
+        parser.add_argument("--tokens", dest="tokens", default=5, type=int,
+                            help="Token contracts created before the load starts (default: %(default)s)")
+        parser.add_argument("--senders", dest="senders", default=20, type=int,
+                            help="Funded sender addresses (default: %(default)s)")
+        parser.add_argument("--utxospersender", dest="utxos_per_sender", default=10, type=int,
+                            help="Coins each sender is funded with (default: %(default)s)")
+        parser.add_argument("--mix", dest="mix", default="transfer:90,create:5,dgp:5",
+                            help="Weights of the transaction kinds %s (default: %%(default)s)" % ", ".join(TX_KINDS))
+        parser.add_argument("--blockinterval", dest="block_interval", default=5.0, type=float,
+                            help="Seconds between the blocks mined during the load (default: %(default)s)")
+        parser.add_argument("--report", dest="report",
+                            help="Write the results as JSON to this file")
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def parse_mix(self):
+        weights = dict.fromkeys(TX_KINDS, 0)
+        for item in self.options.mix.split(","):
+            kind, _, weight = item.partition(":")
+            if kind not in weights:
+                raise ValueError("Unknown transaction kind in --mix: %s" % kind)
+            weights[kind] = int(weight)
+        if not any(weights.values()):
+            raise ValueError("--mix has no transaction kind with a weight")
+        if self.options.senders < 2:
+            raise ValueError("--senders must be at least 2")
+        return [kind for kind in TX_KINDS if weights[kind]], [weights[kind] for kind in TX_KINDS if weights[kind]]
+
+    def setup_contracts(self):
+        node = self.nodes[0]
+        self.log.info("Mining %d blocks to fund the wallet" % (COINBASE_MATURITY + 100))
+        node.generate(COINBASE_MATURITY + 100)
+
+        # Every sender gets several coins so it can send that many transactions per block
+        self.deployer = node.getnewaddress()
+        self.dgp_admin = node.getnewaddress()
+        self.senders = [node.getnewaddress() for _ in range(self.options.senders)]
+        for _ in range(self.options.utxos_per_sender):
+            outputs = {sender: 100 for sender in self.senders + [self.dgp_admin]}
+            outputs[self.deployer] = 1000
+            node.sendmany("", outputs)
+        node.generate(1)
+
+        self.log.info("Creating %d token contracts" % self.options.tokens)
+        self.token_contracts = []
+        for n in range(self.options.tokens):
+            self.token_contracts.append(node.createcontract(TOKEN_BYTECODE, CREATE_GAS, QTUM_MIN_GAS_PRICE_STR, self.deployer, True, True)['address'])
+            if n % MAX_UNCONFIRMED_SETUP_TXS == MAX_UNCONFIRMED_SETUP_TXS - 1:
+                node.generate(1)
+        self.dgp = DGPState(node, node.createcontract(DGP_GOVERNANCE_BYTECODE, 4000000, QTUM_MIN_GAS_PRICE_STR, self.deployer, True, True)['address'])
+        node.generate(1)
+        node.sendtocontract(self.dgp.contract_address, self.dgp.abiSetInitialAdmin, 0, DGP_GAS, QTUM_MIN_GAS_PRICE_STR, self.dgp_admin, True, True)
+        node.generate(1)
+
+        self.log.info("Handing out tokens to the senders")
+        for n, (token, sender) in enumerate(itertools.product(self.token_contracts, self.senders)):
+            data = TOKEN_TRANSFER + p2pkh_to_hex_hash(sender).zfill(64) + hex(TOKENS_PER_SENDER)[2:].zfill(64)
+            node.sendtocontract(token, data, 0, TRANSFER_GAS, QTUM_MIN_GAS_PRICE_STR, self.deployer, True, True)
+            if n % MAX_UNCONFIRMED_SETUP_TXS == MAX_UNCONFIRMED_SETUP_TXS - 1:
+                node.generate(1)
+        node.generate(1)
+
+    def build_tx(self, kind):
+        """Build and sign a transaction of the given kind without sending it, returns the raw transaction"""
+        node = self.nodes[0]
+        if kind == "transfer":
+            sender, receiver = random.sample(self.senders, 2)
+            data = TOKEN_TRANSFER + p2pkh_to_hex_hash(receiver).zfill(64) + hex(random.randint(1, 1000))[2:].zfill(64)
+            return node.sendtocontract(random.choice(self.token_contracts), data, 0, TRANSFER_GAS, QTUM_MIN_GAS_PRICE_STR, sender, False, True)['raw transaction']
+        if kind == "create":
+            return node.createcontract(TOKEN_BYTECODE, CREATE_GAS, QTUM_MIN_GAS_PRICE_STR, random.choice(self.senders), False, True)['raw transaction']
+        # Alternate the number of admin votes a proposal needs. Proposals that conflict with
+        # one still on vote are reverted by the contract but are still mined.
+        self.dgp_value ^= 1
+        data = self.dgp.abiChangeValueProposal + hex(self.dgp_value)[2:].zfill(64) + "0".zfill(64)
+        return node.sendtocontract(self.dgp.contract_address, data, 0, DGP_GAS, QTUM_MIN_GAS_PRICE_STR, self.dgp_admin, False, True)['raw transaction']
+
+    def mine_block(self):
+        node = self.nodes[0]
+        block_hash = node.generate(1)[0]
+        block = node.getblock(block_hash)
+        for txid in block['tx']:
+            sent = self.pending.pop(txid, None)
+            if sent is not None:
+                self.blocks_to_inclusion.append(block['height'] - sent)
+        self.block_tx_counts.append(len(block['tx']))
+
+    def run_test(self):
+        node = self.nodes[0]
+        kinds, weights = self.parse_mix()
+        self.setup_contracts()
+
+        debug_log = os.path.join(node.datadir, 'regtest', 'debug.log')
+        log_offset = os.path.getsize(debug_log)
+
+        self.dgp_value = 0
+        self.pending = {}
+        self.blocks_to_inclusion = []
+        self.block_tx_counts = []
+        latencies = {kind: [] for kind in kinds}
+        failures = {kind: 0 for kind in kinds}
+
+        self.log.info("Sending %.1f transactions per second for %d seconds" % (self.options.tps, self.options.duration))
+        start = time.time()
+        next_block = start + self.options.block_interval
+        sent = 0
+        while time.time() - start < self.options.duration:
+            now = time.time()
+            if now >= next_block:
+                self.mine_block()
+                next_block += self.options.block_interval
+            send_time = start + sent / self.options.tps
+            if send_time > now:
+                time.sleep(max(0, min(send_time, next_block) - now))
+                continue
+
+            sent += 1
+            kind = random.choices(kinds, weights)[0]
+            try:
+                raw_tx = self.build_tx(kind)
+                accept_start = time.perf_counter()
+                txid = node.sendrawtransaction(raw_tx)
+                latencies[kind].append((time.perf_counter() - accept_start) * 1000)
+            except JSONRPCException as e:
+                # Most likely the sender ran out of confirmed coins, more senders or coins help
+                self.log.debug("Sending a %s transaction failed: %s" % (kind, e.error['message']))
+                failures[kind] += 1
+                continue
+            self.pending[txid] = node.getblockcount()
+        elapsed = time.time() - start
+        self.mine_block()
+
+        with open(debug_log, encoding='utf-8') as f:
+            f.seek(log_offset)
+            connect_times = [float(m.group(1)) for m in re.finditer(r"- Connect total: ([0-9.]+)ms", f.read())]
+
+        accepted = sum(len(values) for values in latencies.values())
+        results = {
+            "tps_target": self.options.tps,
+            "tps_sent": accepted / elapsed,
+            "accept_latency_ms": {kind: summary(values) for kind, values in latencies.items()},
+            "failed": failures,
+            "included_next_block": sum(1 for blocks in self.blocks_to_inclusion if blocks <= 1) / max(1, accepted),
+            "included": len(self.blocks_to_inclusion) / max(1, accepted),
+            "block_txs": summary(self.block_tx_counts),
+            "connect_block_ms": summary(connect_times),
+        }
+
+        self.log.info("Sent %d transactions, %.1f per second" % (accepted, results["tps_sent"]))
+        for kind, stats in results["accept_latency_ms"].items():
+            self.log.info("  %s: accept latency mean %.2fms p50 %.2fms p90 %.2fms p99 %.2fms max %.2fms, %d failed to send" %
+                          (kind, stats["mean"], stats["p50"], stats["p90"], stats["p99"], stats["max"], failures[kind]))
+        self.log.info("Included in the next block: %.1f%%, by the end: %.1f%%" %
+                      (100 * results["included_next_block"], 100 * results["included"]))
+        stats = results["connect_block_ms"]
+        self.log.info("ConnectBlock over %d blocks: mean %.2fms p50 %.2fms p90 %.2fms max %.2fms" %
+                      (stats["count"], stats["mean"], stats["p50"], stats["p90"], stats["max"]))
+
+        if self.options.report:
+            with open(self.options.report, 'w', encoding='utf-8') as f:
+                json.dump(results, f, indent=2)
+
+
+if __name__ == '__main__':
+    LoadGenerator().main()
@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the callcontractbatch RPC.
+
+Every call of the batch runs against the state of the same block and returns
+what callcontract returns for it, with its own sender.
+"""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+)
+from test_framework.qtumconfig import COINBASE_MATURITY, QTUM_MIN_GAS_PRICE_STR
+
+# Stores the word it is called with at slot 0 and returns the caller and slot 0,
+# calls with any other data size only return them
+STORAGE_CONTRACT = "601e80600b6000396000f3" "3660201415600e576000356000555b3360005260005460205260406000f3"
+READ = "00"
+
+def word(value):
+    return "%064x" % value
+
+class QtumCallContractBatchTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+
+        senders = [node.getnewaddress(), node.getnewaddress()]
+        hash160s = [node.gethexaddress(sender) for sender in senders]
+        for sender in senders:
+            node.sendtoaddress(sender, 100)
+        node.generate(1)
+
+        contract = node.createcontract(STORAGE_CONTRACT)['address']
+        node.generate(1)
+        set_height = node.getblockcount() + 1
+        node.sendtocontract(contract, word(7), 0, 100000, QTUM_MIN_GAS_PRICE_STR, senders[0])
+        set_hash = node.generate(1)[0]
+
+        self.log.info("Calls from two senders return each its own caller against the same state")
+        calls = [
+            {"address": contract, "data": READ, "senderAddress": senders[0]},
+            {"address": contract, "data": READ, "senderAddress": senders[1]},
+            {"address": contract, "data": READ, "senderAddress": hash160s[1], "gasLimit": 100000},
+        ]
+        result = node.callcontractbatch(calls)
+        assert_equal(len(result), len(calls))
+        for i, sender in enumerate([hash160s[0], hash160s[1], hash160s[1]]):
+            assert_equal(result[i]['address'], contract)
+            assert_equal(result[i]['executionResult']['excepted'], "None")
+            assert_equal(result[i]['executionResult']['output'], "0" * 24 + sender + word(7))
+            assert 'error' not in result[i]
+        assert_equal(result[2]['executionResult']['gasUsed'], result[1]['executionResult']['gasUsed'])
+
+        self.log.info("The results match callcontract")
+        for i, call in enumerate(calls):
+            single = node.callcontract(contract, READ, call['senderAddress'])
+            assert_equal(result[i]['executionResult']['output'], single['executionResult']['output'])
+            assert_equal(result[i]['executionResult']['gasUsed'], single['executionResult']['gasUsed'])
+
+        self.log.info("A call that writes does not change what the next call of the batch reads")
+        result = node.callcontractbatch([
+            {"address": contract, "data": word(9), "senderAddress": senders[1]},
+            {"address": contract, "data": READ, "senderAddress": senders[0]},
+        ])
+        assert_equal(result[0]['executionResult']['output'], "0" * 24 + hash160s[1] + word(9))
+        assert_equal(result[1]['executionResult']['output'], "0" * 24 + hash160s[0] + word(7))
+
+        self.log.info("Calls against an earlier block see the state of that block")
+        result = node.callcontractbatch([{"address": contract, "data": READ, "senderAddress": senders[0]}], set_height - 1)
+        assert_equal(result[0]['executionResult']['output'], "0" * 24 + hash160s[0] + word(0))
+
+        self.log.info("The state follows the tip when the block that wrote it is disconnected")
+        node.invalidateblock(set_hash)
+        result = node.callcontractbatch(calls[:2])
+        assert_equal(result[0]['executionResult']['output'], "0" * 24 + hash160s[0] + word(0))
+        assert_equal(result[1]['executionResult']['output'], "0" * 24 + hash160s[1] + word(0))
+        assert_raises_rpc_error(-32602, "Incorrect block number", node.callcontractbatch, calls, set_height)
+        node.reconsiderblock(set_hash)
+        result = node.callcontractbatch(calls[:2], set_height)
+        assert_equal(result[0]['executionResult']['output'], "0" * 24 + hash160s[0] + word(7))
+        assert_equal(result[1]['executionResult']['output'], "0" * 24 + hash160s[1] + word(7))
+
+        self.log.info("A call to an address without a contract reports an error in its entry only")
+        missing = "00" * 20
+        result = node.callcontractbatch([{"address": missing, "data": READ}, calls[0]])
+        assert_equal(result[0], {"address": missing, "error": "Address does not exist"})
+        assert_equal(result[1]['executionResult']['excepted'], "None")
+        assert_equal(node.callcontractbatch([]), [])
+
+        self.log.info("Malformed calls fail the whole batch")
+        assert_raises_rpc_error(-3, "Invalid data (data not hex) in call 1", node.callcontractbatch, [calls[0], {"address": contract, "data": "0"}])
+        assert_raises_rpc_error(-5, "Incorrect address in call 0", node.callcontractbatch, [{"address": contract[2:], "data": READ}])
+        assert_raises_rpc_error(-3, "Expected type string", node.callcontractbatch, [{"address": contract, "data": 1}])
+        assert_raises_rpc_error(-1, "JSON value is not a string as expected", node.callcontractbatch, [{"data": READ}])
+        assert_raises_rpc_error(-32602, "Incorrect block number", node.callcontractbatch, calls, -1)
+
+if __name__ == '__main__':
+    QtumCallContractBatchTest().main()
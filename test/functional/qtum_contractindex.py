@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test listcontracts with -contractindex.
+
+Node 0 lists the live contracts from the contract index in creation order,
+node 1 walks the state trie. Both must agree on the contracts and their
+balances, a destructed contract leaves the index, and a disconnected block
+takes its creations and destructions back.
+"""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+    connect_nodes_bi,
+)
+from test_framework.qtumconfig import COINBASE_MATURITY, QTUM_MIN_GAS_PRICE_STR
+
+# Returns the caller and the word it stores at slot 0
+STORAGE_CONTRACT = "601e80600b6000396000f3" "3660201415600e576000356000555b3360005260005460205260406000f3"
+# Destructs itself when it is called
+SUICIDE_CONTRACT = "600280600b6000396000f3" "33ff"
+
+class QtumContractIndexTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [["-logevents", "-contractindex"], ["-logevents"]]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def create(self, *bytecodes):
+        results = [self.nodes[0].createcontract(bytecode) for bytecode in bytecodes]
+        block_hash = self.nodes[0].generate(1)[0]
+        self.sync_all()
+        # contracts of the same block are listed in the order of their transactions
+        block_txids = self.nodes[0].getblock(block_hash)['tx']
+        results.sort(key=lambda result: block_txids.index(result['txid']))
+        return [result['address'] for result in results], block_hash
+
+    def call(self, contract, amount=0):
+        self.nodes[0].sendtocontract(contract, "00", amount, 100000, QTUM_MIN_GAS_PRICE_STR)
+        block_hash = self.nodes[0].generate(1)[0]
+        self.sync_all()
+        return block_hash
+
+    def check_contracts(self, expected):
+        listed = self.nodes[0].listcontracts(1, 100)
+        assert_equal(list(listed.keys()), [contract for contract, _ in expected])
+        assert_equal(list(listed.values()), [balance for _, balance in expected])
+        # the state trie also holds the contracts of the genesis state
+        walked = self.nodes[1].listcontracts(1, 10000)
+        for contract, balance in expected:
+            assert_equal(walked[contract], balance)
+        return listed
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+        self.sync_all()
+
+        heights = []
+        contracts = []
+        for bytecodes in [[STORAGE_CONTRACT], [SUICIDE_CONTRACT], [STORAGE_CONTRACT], [STORAGE_CONTRACT, STORAGE_CONTRACT]]:
+            created, _ = self.create(*bytecodes)
+            contracts += created
+            heights.append(node.getblockcount())
+        a, suicide, b, c, d = contracts
+
+        self.log.info("Contracts are listed in creation order with their balances")
+        self.call(a, 1)
+        expected = [(a, 1), (suicide, 0), (b, 0), (c, 0), (d, 0)]
+        self.check_contracts(expected)
+        assert_equal(list(node.listcontracts(2, 2).keys()), [suicide, b])
+        assert_equal(list(node.listcontracts(5, 100).keys()), [d])
+
+        self.log.info("A height range lists the contracts created in it")
+        assert_equal(list(node.listcontracts(1, 100, heights[1], heights[2]).keys()), [suicide, b])
+        assert_equal(list(node.listcontracts(1, 100, heights[3]).keys()), [c, d])
+        assert_equal(list(node.listcontracts(2, 100, heights[3], -1).keys()), [d])
+        assert_equal(list(node.listcontracts(1, 1, heights[0], heights[3]).keys()), [a])
+        assert_equal(node.listcontracts(1, 100, heights[3] + 1), {})
+
+        self.log.info("A destructed contract leaves the index")
+        destruct_hash = self.call(suicide)
+        expected.remove((suicide, 0))
+        self.check_contracts(expected)
+        assert suicide not in node.listcontracts(1, 100, heights[1], heights[1])
+        assert suicide not in self.nodes[1].listcontracts(1, 10000)
+
+        self.log.info("A disconnected block takes its destructions and creations back")
+        for n in self.nodes:
+            n.invalidateblock(destruct_hash)
+        assert_equal(list(node.listcontracts(1, 100).keys()), [a, suicide, b, c, d])
+        for n in self.nodes:
+            n.reconsiderblock(destruct_hash)
+        self.check_contracts(expected)
+        creation_hash = node.getblockhash(heights[3])
+        for n in self.nodes:
+            n.invalidateblock(creation_hash)
+        # the blocks after it go too, the payment and the destruction with them
+        assert_equal(node.listcontracts(1, 100), {a: 0, suicide: 0, b: 0})
+        assert_equal(node.listcontracts(1, 100, heights[3]), {})
+        for n in self.nodes:
+            n.reconsiderblock(creation_hash)
+        listed = self.check_contracts(expected)
+
+        self.log.info("An index built on an existing chain lists the same contracts")
+        self.restart_node(1, ["-logevents", "-contractindex"])
+        connect_nodes_bi(self.nodes, 0, 1)
+        assert_equal(self.nodes[1].listcontracts(1, 100), listed)
+        assert_equal(self.nodes[1].listcontracts(1, 100, heights[2]), node.listcontracts(1, 100, heights[2]))
+
+        self.log.info("Error paths")
+        assert_raises_rpc_error(-3, "start greater than max index 4", node.listcontracts, 5, 100)
+        assert_raises_rpc_error(-8, "Incorrect params", node.listcontracts, 1, 100, -1)
+        assert_raises_rpc_error(-8, "Incorrect params", node.listcontracts, 1, 100, 0, -2)
+        assert_raises_rpc_error(-8, "Incorrect params", node.listcontracts, 1, 100, heights[2], heights[1])
+        self.restart_node(1, ["-logevents"])
+        assert_raises_rpc_error(-1, "Contract index not enabled", self.nodes[1].listcontracts, 1, 100, heights[0])
+        self.stop_node(1)
+        self.nodes[1].assert_start_raises_init_error(["-contractindex"], "Error: -contractindex requires -logevents.")
+        self.nodes[1].assert_start_raises_init_error(["-logevents", "-contractindex", "-prune=550"], "Error: Prune mode is incompatible with -contractindex.")
+
+if __name__ == '__main__':
+    QtumContractIndexTest().main()
@@ -62,6 +62,16 @@ class CreatecontractTest(BitcoinTestFramework):
         }
         assert_equal(ret, expected_account_info)
 
+        # the storage can be left out, or read in pages
+        del expected_account_info["storage"]
+        assert_equal(self.node.getaccountinfo(contract_address, False), expected_account_info)
+        page = self.node.getstorage(contract_address, -1, None, 1)
+        assert_equal(page, {"storage": ret["storage"], "cursor": None})
+        page = self.node.getstorage(contract_address, -1, None, None, None, "290d")
+        assert_equal(page["storage"], ret["storage"])
+        page = self.node.getstorage(contract_address, -1, None, None, None, "290e")
+        assert_equal(page, {"storage": {}, "cursor": None})
+
     def createcontract_with_sender_test(self):
         self.node.importprivkey("cQWxca9y9XBf4c6ohTwRQ9Kf4GZyRybhGBfzaFgkvRpw8HjbRC58")
         self.node.sendtoaddress("qabmqZk3re5b9UpUcznxDkCnCsnKdmPktT", 0.1)
@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test estimategas and the gas limit the wallet estimates for contract sends.
+
+A transaction sent with the estimated gas limit succeeds and uses the gas
+that was estimated, a limit 1/64 below it runs out of gas. The estimate
+follows the state of the block it is asked for, also after a reorg.
+"""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_greater_than,
+    assert_raises_rpc_error,
+)
+from test_framework.qtumconfig import COINBASE_MATURITY, QTUM_MIN_GAS_PRICE_STR
+
+# Returns the caller and the word it stores at slot 0
+STORAGE_CONTRACT = "601e80600b6000396000f3" "3660201415600e576000356000555b3360005260005460205260406000f3"
+# Reverts every call
+REVERT_CONTRACT = "600580600b6000396000f3" "60006000fd"
+
+def word(value):
+    return "%064x" % value
+
+class QtumEstimateGasTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [["-logevents"]]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def check_estimate(self, address, data, estimate):
+        """The limit 1/64 below the estimate runs out of gas, the estimate does not"""
+        node = self.nodes[0]
+        result = node.callcontract(address, data, self.sender, estimate['gasLimit'])['executionResult']
+        assert_equal(result['excepted'], 'None')
+        assert_equal(result['gasUsed'], estimate['gasUsed'])
+        below = estimate['gasLimit'] - estimate['gasLimit'] // 64 - 1
+        assert_equal(node.callcontract(address, data, self.sender, below)['executionResult']['excepted'], 'OutOfGas')
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+        self.sender = node.getnewaddress()
+        node.sendtoaddress(self.sender, 100)
+        node.generate(1)
+
+        self.log.info("A contract created with the estimated gas limit succeeds")
+        estimate = node.estimategas("", STORAGE_CONTRACT, self.sender)
+        assert_equal(len(estimate['newAddress']), 40)
+        assert_greater_than(estimate['gasLimit'], estimate['gasUsed'] - 1)
+        result = node.createcontract(STORAGE_CONTRACT, estimate['gasLimit'], QTUM_MIN_GAS_PRICE_STR, self.sender)
+        storage, create_txid = result['address'], result['txid']
+        node.generate(1)
+        receipt = node.gettransactionreceipt(create_txid)[0]
+        assert_equal(receipt['excepted'], 'None')
+        assert_equal(receipt['gasUsed'], estimate['gasUsed'])
+        created_height = node.getblockcount()
+        revert = node.createcontract(REVERT_CONTRACT, 100000, QTUM_MIN_GAS_PRICE_STR, self.sender)['address']
+        node.generate(1)
+
+        self.log.info("A call sent with the estimated gas limit succeeds")
+        first_write = node.estimategas(storage, word(7), self.sender)
+        assert 'newAddress' not in first_write
+        self.check_estimate(storage, word(7), first_write)
+        txid = node.sendtocontract(storage, word(7), 0, first_write['gasLimit'], QTUM_MIN_GAS_PRICE_STR, self.sender)['txid']
+        write_hash = node.generate(1)[0]
+        receipt = node.gettransactionreceipt(txid)[0]
+        assert_equal(receipt['excepted'], 'None')
+        assert_equal(receipt['gasUsed'], first_write['gasUsed'])
+
+        self.log.info("The estimate follows the state of the block")
+        # a slot that is set already costs less to write again
+        rewrite = node.estimategas(storage, word(9), self.sender)
+        assert_greater_than(first_write['gasUsed'], rewrite['gasUsed'])
+        self.check_estimate(storage, word(9), rewrite)
+        assert_equal(node.estimategas(storage, word(9), self.sender, 0, None, created_height), first_write)
+        with_limit = node.estimategas(storage, word(9), self.sender, 0, 1000000)
+        assert_equal(with_limit['gasUsed'], rewrite['gasUsed'])
+        self.check_estimate(storage, word(9), with_limit)
+        assert_equal(node.estimategas(storage, "00", self.sender, 1)['gasUsed'], node.estimategas(storage, "00", self.sender)['gasUsed'])
+
+        self.log.info("The estimate goes back with the tip when the block is disconnected")
+        node.invalidateblock(write_hash)
+        assert_equal(node.estimategas(storage, word(9), self.sender), first_write)
+        node.reconsiderblock(write_hash)
+        assert_equal(node.estimategas(storage, word(9), self.sender), rewrite)
+
+        self.log.info("The wallet estimates the gas limit of a contract send without one")
+        txid = node.sendtocontract(storage, word(11))['txid']
+        node.generate(1)
+        receipt = node.gettransactionreceipt(txid)[0]
+        assert_equal(receipt['excepted'], 'None')
+        assert_raises_rpc_error(-4, "The contract execution fails: Revert", node.sendtocontract, revert, "00")
+        txid = node.sendtocontract(revert, "00", 0, 100000, QTUM_MIN_GAS_PRICE_STR)['txid']
+        node.generate(1)
+        assert_equal(node.gettransactionreceipt(txid)[0]['excepted'], 'Revert')
+
+        self.log.info("Error paths")
+        assert_raises_rpc_error(-3, "Invalid data (data not hex)", node.estimategas, storage, "zz")
+        assert_raises_rpc_error(-3, "Invalid data (data not hex)", node.estimategas, storage, "0")
+        assert_raises_rpc_error(-5, "Incorrect address", node.estimategas, storage[2:], "00")
+        assert_raises_rpc_error(-5, "Address does not exist", node.estimategas, "11" * 20, "00")
+        assert_raises_rpc_error(-5, "Address does not exist", node.estimategas, storage, "00", self.sender, 0, None, created_height - 1)
+        assert_raises_rpc_error(-8, "A contract creation cannot send an amount", node.estimategas, "", STORAGE_CONTRACT, self.sender, 1)
+        assert_raises_rpc_error(-8, "Invalid value for gasLimit (Minimum is: 10000)", node.estimategas, storage, "00", self.sender, 0, 9999)
+        assert_raises_rpc_error(-8, "Invalid value for gasLimit (Maximum is", node.estimategas, storage, "00", self.sender, 0, 10 ** 12)
+        assert_raises_rpc_error(-32602, "Incorrect block number", node.estimategas, storage, "00", self.sender, 0, None, node.getblockcount() + 1)
+        assert_raises_rpc_error(-1, "Execution fails with the most gas it may use: Revert", node.estimategas, revert, "00")
+        assert_raises_rpc_error(-1, "Execution fails with the most gas it may use: OutOfGas", node.estimategas, storage, word(13), self.sender, 0, 25000)
+
+if __name__ == '__main__':
+    QtumEstimateGasTest().main()
@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test getblock with verbosity 3.
+
+The contract transactions of the block carry the receipts of that block and
+the condensing transactions that pay out their value transfers, the rest of
+the result is the same as with verbosity 2.
+"""
+
+from decimal import Decimal
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+)
+from test_framework.qtum import assert_vin
+from test_framework.qtumconfig import COINBASE_MATURITY, QTUM_MIN_GAS_PRICE_STR
+
+# Returns the caller and the word it stores at slot 0
+STORAGE_CONTRACT = "601e80600b6000396000f3" "3660201415600e576000356000555b3360005260005460205260406000f3"
+# Destructs itself when it is called, the caller gets its balance
+SUICIDE_CONTRACT = "600280600b6000396000f3" "33ff"
+
+def word(value):
+    return "%064x" % value
+
+class QtumGetBlockReceiptsTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [["-logevents"], []]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def contract_txs(self, block_hash):
+        """Check the block against verbosity 2 and return its contract transactions by txid"""
+        node = self.nodes[0]
+        verbose = node.getblock(block_hash, 2)
+        block = node.getblock(block_hash, 3)
+        txs = block.pop('tx')
+        verbose_txs = verbose.pop('tx')
+        assert_equal(block, verbose)
+        contract_txs = {}
+        receipts = []
+        for index, (tx, verbose_tx) in enumerate(zip(txs, verbose_txs)):
+            if 'receipt' in tx:
+                contract_txs[tx['txid']] = (index, tx)
+                receipts += tx['receipt']
+                tx = dict(tx)
+                del tx['receipt']
+                del tx['valueTransfers']
+            assert_equal(tx, verbose_tx)
+        assert_equal(len(txs), len(verbose_txs))
+        assert_equal(node.getblocktransactionreceipts(block_hash), receipts)
+        return contract_txs, txs
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+        self.sync_all()
+
+        storage = node.createcontract(STORAGE_CONTRACT)['address']
+        suicide = node.createcontract(SUICIDE_CONTRACT)['address']
+        node.generate(1)
+        self.sync_all()
+
+        storage_txid = node.sendtocontract(storage, word(7))['txid']
+        suicide_txid = node.sendtocontract(suicide, "00", 1, 100000, QTUM_MIN_GAS_PRICE_STR)['txid']
+        block_hash = node.generate(1)[0]
+        self.sync_all()
+
+        self.log.info("Contract transactions carry their receipts")
+        contract_txs, txs = self.contract_txs(block_hash)
+        assert_equal(set(contract_txs.keys()), {storage_txid, suicide_txid})
+        for txid, (_, tx) in contract_txs.items():
+            assert_equal(len(tx['receipt']), 1)
+            assert_equal(tx['receipt'], node.gettransactionreceipt(txid))
+            assert_equal(tx['receipt'][0]['blockHash'], block_hash)
+        assert_equal(contract_txs[storage_txid][1]['receipt'][0]['contractAddress'], storage)
+        assert_equal(contract_txs[storage_txid][1]['receipt'][0]['excepted'], 'None')
+
+        self.log.info("Value transfers point at the condensing transaction that follows")
+        assert_equal(contract_txs[storage_txid][1]['valueTransfers'], [])
+        index, tx = contract_txs[suicide_txid]
+        condensing = txs[index + 1]
+        assert_equal(tx['valueTransfers'], [condensing['txid']])
+        assert_vin(condensing, [('OP_SPEND', )])
+        assert_equal(sum(vout['value'] for vout in condensing['vout']), Decimal('1'))
+        assert 'receipt' not in condensing
+
+        self.log.info("A block that was reorganized away only has the receipts of its own")
+        for n in self.nodes:
+            n.invalidateblock(block_hash)
+        for _, tx in self.contract_txs(block_hash)[0].values():
+            assert_equal(tx['receipt'], [])
+        new_hash = node.generate(1)[0]
+        self.sync_all()
+        assert new_hash != block_hash
+        for _, tx in self.contract_txs(block_hash)[0].values():
+            assert_equal(tx['receipt'], [])
+        contract_txs = self.contract_txs(new_hash)[0]
+        assert_equal(set(contract_txs.keys()), {storage_txid, suicide_txid})
+        for txid, (_, tx) in contract_txs.items():
+            assert_equal(tx['receipt'][0]['blockHash'], new_hash)
+            assert_equal(tx['receipt'], node.gettransactionreceipt(txid))
+
+        self.log.info("Error paths")
+        assert_raises_rpc_error(-32603, "Events indexing disabled", self.nodes[1].getblock, new_hash, 3)
+        assert_equal(len(self.nodes[1].getblock(new_hash, 2)['tx']), len(node.getblock(new_hash, 2)['tx']))
+        assert_raises_rpc_error(-5, "Block not found", node.getblock, "00" * 32, 3)
+        assert_raises_rpc_error(-5, "Incorrect hash", node.getblocktransactionreceipts, "00")
+
+if __name__ == '__main__':
+    QtumGetBlockReceiptsTest().main()
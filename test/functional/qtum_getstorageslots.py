@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test getstorageslots.
+
+The slots a contract wrote are read back in request order from the state of
+the tip or of an earlier block, and follow the tip when a block is
+disconnected.
+"""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+)
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+# Stores the second word it is called with at the slot of the first one
+SLOTS_CONTRACT = "600880600b6000396000f3" "6020356000355500"
+BIG_SLOT = "f" * 63 + "e"
+
+def word(value):
+    return "%064x" % value
+
+class QtumGetStorageSlotsTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def store(self, *writes):
+        for slot, value in writes:
+            self.nodes[0].sendtocontract(self.contract, slot + word(value))
+        block_hash = self.nodes[0].generate(1)[0]
+        return block_hash, self.nodes[0].getblockcount()
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+
+        self.contract = node.createcontract(SLOTS_CONTRACT)['address']
+        node.generate(1)
+        created_height = node.getblockcount()
+        _, first_height = self.store((word(0), 7))
+        _, second_height = self.store((word(1), 8), (BIG_SLOT, 9))
+        last_hash, last_height = self.store((word(0), 10))
+
+        self.log.info("Slots are read in request order, unset slots are zero")
+        slots = ["0", "1", BIG_SLOT, "2"]
+        assert_equal(node.getstorageslots(self.contract, slots), [word(10), word(8), word(9), word(0)])
+        assert_equal(node.getstorageslots(self.contract, ["1", "0", "1"]), [word(8), word(10), word(8)])
+        assert_equal(node.getstorageslots(self.contract, [word(1), "01", BIG_SLOT.upper()]), [word(8), word(8), word(9)])
+        assert_equal(node.getstorageslots(self.contract, []), [])
+
+        self.log.info("Slots are read from the state of the block asked for")
+        assert_equal(node.getstorageslots(self.contract, slots, created_height), [word(0)] * 4)
+        assert_equal(node.getstorageslots(self.contract, slots, first_height), [word(7), word(0), word(0), word(0)])
+        assert_equal(node.getstorageslots(self.contract, slots, second_height), [word(7), word(8), word(9), word(0)])
+        assert_equal(node.getstorageslots(self.contract, slots, -1), node.getstorageslots(self.contract, slots))
+
+        self.log.info("The slots follow the tip when a block is disconnected")
+        node.invalidateblock(last_hash)
+        assert_equal(node.getstorageslots(self.contract, slots), [word(7), word(8), word(9), word(0)])
+        assert_raises_rpc_error(-32602, "Incorrect block number", node.getstorageslots, self.contract, slots, last_height)
+        node.reconsiderblock(last_hash)
+        assert_equal(node.getstorageslots(self.contract, slots, last_height), [word(10), word(8), word(9), word(0)])
+
+        self.log.info("Error paths")
+        assert_raises_rpc_error(-5, "Incorrect address", node.getstorageslots, self.contract[2:], slots)
+        assert_raises_rpc_error(-5, "Incorrect address", node.getstorageslots, "zz" + self.contract[2:], slots)
+        assert_raises_rpc_error(-5, "Address does not exist", node.getstorageslots, "11" * 20, slots)
+        assert_raises_rpc_error(-5, "Address does not exist", node.getstorageslots, self.contract, slots, created_height - 1)
+        assert_raises_rpc_error(-32602, "Incorrect slot", node.getstorageslots, self.contract, [""])
+        assert_raises_rpc_error(-32602, "Incorrect slot 0x1", node.getstorageslots, self.contract, ["0x1"])
+        assert_raises_rpc_error(-32602, "Incorrect slot", node.getstorageslots, self.contract, ["0" + word(1)])
+        assert_raises_rpc_error(-32602, "At most 10000 slots can be read at once", node.getstorageslots, self.contract, ["0"] * 10001)
+        assert_raises_rpc_error(-32602, "Incorrect block number", node.getstorageslots, self.contract, slots, -2)
+        assert_raises_rpc_error(-32602, "Incorrect block number", node.getstorageslots, self.contract, slots, last_height + 1)
+
+if __name__ == '__main__':
+    QtumGetStorageSlotsTest().main()
@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test listgovernors, listbudgetproposals and listbudgetvotes with -governanceindex.
+
+Governors enroll in and leave the governance contract of the genesis state.
+The index follows the successful calls only, takes a disconnected block
+back and is the same when it is built on an existing chain.
+"""
+
+from decimal import Decimal
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+    connect_nodes_bi,
+)
+from test_framework.qtumconfig import COINBASE_MATURITY, QTUM_MIN_GAS_PRICE_STR
+
+GOVERNANCE_CONTRACT = "0000000000000000000000000000000000000089"
+BUDGET_CONTRACT = "0000000000000000000000000000000000000090"
+ENROLL = "e65f2a7e"
+# unenroll(bool force)
+UNENROLL = "fba71397"
+
+def word(value):
+    return "%064x" % value
+
+def governor(address, height, collateral):
+    return {"address": address, "registrationBlock": height, "collateral": collateral,
+            "lastRewardBlock": 0, "rewards": 0, "lastCallBlock": height}
+
+class QtumGovernanceIndexTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [["-logevents", "-governanceindex"], ["-logevents"]]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def call(self, contract, data, amount, sender, gas_limit=None):
+        txid = self.nodes[0].sendtocontract(contract, data, amount, gas_limit, QTUM_MIN_GAS_PRICE_STR, sender)['txid']
+        block_hash = self.nodes[0].generate(1)[0]
+        self.sync_all()
+        return txid, block_hash
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+        self.sync_all()
+
+        collateral = Decimal(node.getdgpinfo()['governancecollateral']) / 100000000
+        addresses = [node.getnewaddress() for _ in range(3)]
+        hex_addresses = [node.gethexaddress(address) for address in addresses]
+        for address in addresses:
+            node.sendtoaddress(address, collateral + 10)
+        node.generate(1)
+        self.sync_all()
+
+        self.log.info("Successful enrollments are listed by address")
+        heights = []
+        hashes = []
+        for address in addresses[:2]:
+            txid, block_hash = self.call(GOVERNANCE_CONTRACT, ENROLL, collateral, address)
+            assert_equal(node.gettransactionreceipt(txid)[0]['excepted'], 'None')
+            heights.append(node.getblockcount())
+            hashes.append(block_hash)
+        expected = sorted([governor(hex_addresses[i], heights[i], collateral) for i in range(2)], key=lambda entry: entry['address'])
+        assert_equal(node.listgovernors(), expected)
+
+        self.log.info("Calls that fail are not indexed")
+        txid, _ = self.call(GOVERNANCE_CONTRACT, "00000000", 1, addresses[2], 250000)
+        assert node.gettransactionreceipt(txid)[0]['excepted'] != 'None'
+        txid, _ = self.call(BUDGET_CONTRACT, "00000000", 1, addresses[2], 250000)
+        assert node.gettransactionreceipt(txid)[0]['excepted'] != 'None'
+        assert_equal(node.listgovernors(), expected)
+        assert_equal(node.listbudgetproposals(), [])
+        assert_equal(node.listbudgetvotes(), [])
+
+        self.log.info("A disconnected block takes its enrollment back")
+        for n in self.nodes:
+            n.invalidateblock(hashes[1])
+        assert_equal(node.listgovernors(), [governor(hex_addresses[0], heights[0], collateral)])
+        for n in self.nodes:
+            n.reconsiderblock(hashes[1])
+        assert_equal(node.listgovernors(), expected)
+
+        self.log.info("A governor leaves when its collateral is paid back")
+        txid, unenroll_hash = self.call(GOVERNANCE_CONTRACT, UNENROLL + word(1), 0, addresses[0])
+        assert_equal(node.gettransactionreceipt(txid)[0]['excepted'], 'None')
+        remaining = [governor(hex_addresses[1], heights[1], collateral)]
+        assert_equal(node.listgovernors(), remaining)
+        for n in self.nodes:
+            n.invalidateblock(unenroll_hash)
+        assert_equal(node.listgovernors(), expected)
+        for n in self.nodes:
+            n.reconsiderblock(unenroll_hash)
+        assert_equal(node.listgovernors(), remaining)
+
+        self.log.info("An index built on an existing chain lists the same governors")
+        self.restart_node(1, ["-logevents", "-governanceindex"])
+        connect_nodes_bi(self.nodes, 0, 1)
+        assert_equal(self.nodes[1].listgovernors(), remaining)
+        assert_equal(self.nodes[1].listbudgetproposals(), [])
+
+        self.log.info("Error paths")
+        assert_raises_rpc_error(-8, "Incorrect params", node.listbudgetproposals, -1)
+        assert_raises_rpc_error(-8, "Incorrect params", node.listbudgetproposals, 0, -2)
+        assert_raises_rpc_error(-8, "Incorrect params", node.listbudgetvotes, heights[1], heights[0])
+        self.restart_node(1, ["-logevents"])
+        assert_raises_rpc_error(-1, "Governance index not enabled", self.nodes[1].listgovernors)
+        assert_raises_rpc_error(-1, "Governance index not enabled", self.nodes[1].listbudgetproposals)
+        assert_raises_rpc_error(-1, "Governance index not enabled", self.nodes[1].listbudgetvotes)
+        self.stop_node(1)
+        self.nodes[1].assert_start_raises_init_error(["-governanceindex"], "Error: -governanceindex requires -logevents.")
+        self.nodes[1].assert_start_raises_init_error(["-logevents", "-governanceindex", "-prune=550"], "Error: Prune mode is incompatible with -governanceindex.")
+
+if __name__ == '__main__':
+    QtumGovernanceIndexTest().main()
@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test searchlogs topic filters with -logindex.
+
+Node 0 answers topic filters from the log index, node 1 scans the receipts.
+Both must return the same receipts, also after a reorg and after node 1
+builds the index of a chain it already has.
+"""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+    connect_nodes_bi,
+)
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+# Emits a LOG2 with the two words it is called with as its topics
+LOG_CONTRACT = "600c80600b6000396000f3" "60203560003560006000a200"
+
+def word(value):
+    return "%064x" % value
+
+A, B, C, D = word(0xa), word(0xb), word(0xc), word(0xd)
+
+class QtumLogIndexTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [["-logevents", "-logindex"], ["-logevents"]]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def emit(self, *logs):
+        for topics in logs:
+            self.nodes[0].sendtocontract(self.contract, "".join(topics))
+        block_hash = self.nodes[0].generate(1)[0]
+        self.sync_all()
+        return block_hash
+
+    def search(self, node, topics):
+        return node.searchlogs(self.start, -1, {"addresses": [self.contract]}, {"topics": topics})
+
+    def check_filters(self, expected):
+        for topics, count in expected:
+            result = self.search(self.nodes[0], topics)
+            assert_equal(len(result), count)
+            assert_equal(result, self.search(self.nodes[1], topics))
+            paged = self.nodes[0].searchlogs(self.start, -1, {"addresses": [self.contract]}, {"topics": topics}, 0, 1)
+            assert_equal(paged['receipts'], result[:1])
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+        self.sync_all()
+
+        self.contract = node.createcontract(LOG_CONTRACT)['address']
+        node.generate(1)
+        self.sync_all()
+        self.start = node.getblockcount() + 1
+
+        self.emit((A, B))
+        self.emit((A, C), (C, B))
+        last_hash = self.emit((B, A))
+
+        self.log.info("Topic filters match the receipt scan")
+        self.check_filters([
+            ([A], 2),
+            ([None, B], 2),
+            ([A, B], 3),
+            ([C], 1),
+            ([B], 1),
+            ([None, A], 1),
+            ([D], 0),
+            ([D, None], 0),
+        ])
+        for entry in self.search(node, [C]):
+            assert_equal(entry['log'][0]['topics'], [C, B])
+
+        self.log.info("Entries of a disconnected block are not returned")
+        for n in self.nodes:
+            n.invalidateblock(last_hash)
+        self.check_filters([([B], 0), ([None, A], 0), ([A], 2)])
+
+        self.log.info("The same transaction mined in another block is found there")
+        new_hash = node.generate(1)[0]
+        self.sync_all()
+        assert new_hash != last_hash
+        self.check_filters([([B], 1), ([None, A], 1)])
+        assert_equal(self.search(node, [B])[0]['blockHash'], new_hash)
+
+        self.log.info("An index built on an existing chain matches the receipt scan")
+        self.restart_node(1, ["-logevents", "-logindex"])
+        connect_nodes_bi(self.nodes, 0, 1)
+        self.restart_node(0, ["-logevents"])
+        connect_nodes_bi(self.nodes, 0, 1)
+        self.check_filters([([A], 2), ([None, B], 2), ([A, B], 3), ([B], 1)])
+
+        self.log.info("Error paths")
+        assert_raises_rpc_error(-32602, "Invalid hex 256 string", node.searchlogs, self.start, -1, None, {"topics": [A[2:]]})
+        assert_raises_rpc_error(-32602, "Expect an array of hex 256 strings", node.searchlogs, self.start, -1, None, {"topics": A})
+        assert_raises_rpc_error(-8, "Incorrect params", node.searchlogs, self.start, self.start - 1, None, {"topics": [A]})
+        self.stop_node(1)
+        self.nodes[1].assert_start_raises_init_error(["-logindex"], "Error: -logindex requires -logevents.")
+        self.nodes[1].assert_start_raises_init_error(["-logevents", "-logindex", "-prune=550"], "Error: Prune mode is incompatible with -logindex.")
+
+if __name__ == '__main__':
+    QtumLogIndexTest().main()
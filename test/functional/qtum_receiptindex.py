@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test enabling -logevents on a node with a chain.
+
+Node 0 runs -logevents from the start, node 1 enables it later and rebuilds
+the receipts of the blocks it already has in the background. The receipts
+and logs of both nodes must match, before and after a reorg. Node 2 is
+pruned and must be reindexed instead.
+"""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+    connect_nodes_bi,
+    wait_until,
+)
+from test_framework.test_node import ErrorMatch
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+# Emits a LOG2 with the two words it is called with as its topics
+LOG_CONTRACT = "600c80600b6000396000f3" "60203560003560006000a200"
+
+def word(value):
+    return "%064x" % value
+
+class QtumReceiptIndexTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 3
+        self.extra_args = [["-logevents"], [], ["-prune=1"]]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def emit(self, count):
+        txids = []
+        for i in range(count):
+            txids.append(self.nodes[0].sendtocontract(self.contract, word(i) + word(len(self.txids) + i))['txid'])
+        self.nodes[0].generate(1)
+        self.sync_all()
+        self.txids += txids
+
+    def restart_with_logevents(self):
+        self.restart_node(1, ["-logevents"])
+        connect_nodes_bi(self.nodes, 0, 1)
+        connect_nodes_bi(self.nodes, 1, 2)
+
+    def check_receipts(self):
+        for txid in [self.create_txid] + self.txids:
+            receipt = self.nodes[0].gettransactionreceipt(txid)
+            assert_equal(len(receipt), 1)
+            assert_equal(self.nodes[1].gettransactionreceipt(txid), receipt)
+        logs = self.nodes[0].searchlogs(self.start, -1, {"addresses": [self.contract]})
+        assert_equal(len(logs), len(self.txids))
+        assert_equal(self.nodes[1].searchlogs(self.start, -1, {"addresses": [self.contract]}), logs)
+        assert_equal(self.nodes[1].waitforlogs(self.start, -1, {"addresses": [self.contract]}, 0),
+                     self.nodes[0].waitforlogs(self.start, -1, {"addresses": [self.contract]}, 0))
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+        self.sync_all()
+
+        result = node.createcontract(LOG_CONTRACT)
+        self.contract = result['address']
+        self.create_txid = result['txid']
+        node.generate(1)
+        self.sync_all()
+        self.start = node.getblockcount() + 1
+        self.txids = []
+        for count in [1, 3, 2]:
+            self.emit(count)
+
+        # a block node 1 disconnects before it has receipts
+        reorged = node.getbestblockhash()
+        for n in self.nodes:
+            n.invalidateblock(reorged)
+        for n in self.nodes:
+            n.reconsiderblock(reorged)
+        self.sync_all()
+        node.generate(20)
+        self.sync_all()
+        assert_raises_rpc_error(-32603, "Events indexing disabled", self.nodes[1].gettransactionreceipt, self.txids[0])
+
+        self.log.info("Receipts of the blocks connected before -logevents are rebuilt")
+        self.restart_with_logevents()
+        wait_until(lambda: self.nodes[1].gettransactionreceipt(self.txids[-1]) != [], timeout=60)
+        self.check_receipts()
+
+        self.log.info("Blocks connected after the rebuild have their receipts")
+        self.emit(2)
+        self.check_receipts()
+
+        self.log.info("The rebuilt receipts follow a reorg")
+        tip = node.getbestblockhash()
+        last_txids = self.txids[-2:]
+        for n in self.nodes[:2]:
+            n.invalidateblock(tip)
+        for txid in last_txids:
+            assert_equal(node.gettransactionreceipt(txid), [])
+            assert_equal(self.nodes[1].gettransactionreceipt(txid), [])
+        self.txids = self.txids[:-2]
+        self.check_receipts()
+        for n in self.nodes[:2]:
+            n.reconsiderblock(tip)
+        self.txids += last_txids
+        self.check_receipts()
+
+        self.log.info("A restart does not rebuild the receipts again")
+        self.restart_with_logevents()
+        self.check_receipts()
+        self.emit(1)
+        self.check_receipts()
+
+        self.log.info("A pruned node must be reindexed to enable -logevents")
+        self.stop_node(2)
+        self.nodes[2].assert_start_raises_init_error(["-prune=1", "-logevents"], "You need to rebuild the database using -reindex to enable -logevents", match=ErrorMatch.PARTIAL_REGEX)
+
+if __name__ == '__main__':
+    QtumReceiptIndexTest().main()
@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test -logeventsprune.
+
+Node 0 prunes the receipts of blocks more than LOGEVENTS_PRUNE deep when it
+prunes its block files, node 1 keeps every receipt. Receipts above the
+horizon must still match those of node 1, also after a reorg and a restart.
+"""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    connect_nodes_bi,
+)
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+# Emits a LOG2 with the two words it is called with as its topics
+LOG_CONTRACT = "600c80600b6000396000f3" "60203560003560006000a200"
+LOGEVENTS_PRUNE = 50
+
+def word(value):
+    return "%064x" % value
+
+class QtumReceiptPruningTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [["-logevents", "-prune=1", "-logeventsprune=%d" % LOGEVENTS_PRUNE], ["-logevents"]]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def emit(self):
+        txid = self.nodes[0].sendtocontract(self.contract, word(0xa) + word(0xb))['txid']
+        block_hash = self.nodes[0].generate(1)[0]
+        self.sync_all()
+        return txid, block_hash
+
+    def assert_pruned(self, txid):
+        assert_equal(self.nodes[0].gettransactionreceipt(txid), [])
+        assert_equal(len(self.nodes[1].gettransactionreceipt(txid)), 1)
+
+    def assert_kept(self, txid):
+        receipt = self.nodes[0].gettransactionreceipt(txid)
+        assert_equal(len(receipt), 1)
+        assert_equal(receipt, self.nodes[1].gettransactionreceipt(txid))
+
+    def search(self, node, height):
+        return node.searchlogs(height, height, {"addresses": [self.contract]})
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 50)
+        self.sync_all()
+
+        self.contract = node.createcontract(LOG_CONTRACT)['address']
+        node.generate(1)
+        self.sync_all()
+        old = [self.emit() for _ in range(3)]
+        old_heights = [node.getblock(block_hash)['height'] for _, block_hash in old]
+        node.generate(LOGEVENTS_PRUNE + 10)
+        self.sync_all()
+        recent_txid, recent_hash = self.emit()
+        recent_height = node.getblockcount()
+        node.generate(5)
+        self.sync_all()
+
+        self.log.info("Receipts are kept until the block files are pruned")
+        for txid, _ in old:
+            self.assert_kept(txid)
+
+        self.log.info("Pruning deletes the receipts and logs below the horizon")
+        node.pruneblockchain(1)
+        for (txid, _), height in zip(old, old_heights):
+            self.assert_pruned(txid)
+            assert_equal(self.search(node, height), [])
+            assert_equal(len(self.search(self.nodes[1], height)), 1)
+        self.assert_kept(recent_txid)
+        assert_equal(self.search(node, recent_height), self.search(self.nodes[1], recent_height))
+
+        self.log.info("Receipts above the horizon follow a reorg")
+        node.invalidateblock(recent_hash)
+        assert_equal(node.gettransactionreceipt(recent_txid), [])
+        assert_equal(self.search(node, recent_height), [])
+        node.reconsiderblock(recent_hash)
+        assert_equal(node.getbestblockhash(), self.nodes[1].getbestblockhash())
+        self.assert_kept(recent_txid)
+        for txid, _ in old:
+            self.assert_pruned(txid)
+
+        self.log.info("The horizon moves on after a restart")
+        self.restart_node(0)
+        connect_nodes_bi(self.nodes, 0, 1)
+        for txid, _ in old:
+            self.assert_pruned(txid)
+        node = self.nodes[0]
+        node.pruneblockchain(1)
+        self.assert_kept(recent_txid)
+        node.generate(LOGEVENTS_PRUNE)
+        self.sync_all()
+        node.pruneblockchain(1)
+        self.assert_pruned(recent_txid)
+        assert_equal(self.search(node, recent_height), [])
+
+        self.log.info("Error paths")
+        self.stop_node(1)
+        self.nodes[1].assert_start_raises_init_error(["-logevents", "-logeventsprune=10"], "Error: -logeventsprune requires -prune and -logevents.")
+        self.nodes[1].assert_start_raises_init_error(["-prune=1", "-logeventsprune=10"], "Error: -logeventsprune requires -prune and -logevents.")
+        self.nodes[1].assert_start_raises_init_error(["-prune=1", "-logevents", "-logeventsprune=-1"], "Error: -logeventsprune cannot be configured with a negative value.")
+
+if __name__ == '__main__':
+    QtumReceiptPruningTest().main()
@@ -80,8 +80,44 @@ class QtumBitcoreTest(BitcoinTestFramework):
         ret = node.getaddressdeltas({'addresses': [confirmed_address]})
         assert_equal(len(ret), 10)
 
+        # pages of the index follow each other, newest first when reversed
+        txids = []
+        cursor = None
+        while True:
+            params = {'addresses': [confirmed_address], 'limit': 3, 'reverse': True}
+            if cursor:
+                params['cursor'] = cursor
+            page = node.getaddresstxids(params)
+            assert len(page['txids']) <= 3
+            txids += page['txids']
+            cursor = page['cursor']
+            if cursor is None:
+                break
+        assert_equal(len(txids), 10)
+        assert_equal(set(txids), set(expected_address_txids))
+
+        page = node.getaddressdeltas({'addresses': [confirmed_address], 'limit': 4})
+        assert_equal(len(page['deltas']), 4)
+        rest = node.getaddressdeltas({'addresses': [confirmed_address], 'limit': 10, 'cursor': page['cursor']})
+        assert_equal(len(rest['deltas']), 6)
+        assert_equal(rest['cursor'], None)
+        assert_equal(page['deltas'] + rest['deltas'], ret)
+
+        ret = node.getaddressbalance({'addresses': [confirmed_address]})
+        assert_equal(ret['balance'], 10000000000)
+        assert_equal(ret['received'], 10000000000)
+        assert_equal(ret['txcount'], 10)
+
+        # the balances follow a disconnected block
+        tip = node.getbestblockhash()
+        node.invalidateblock(tip)
+        ret = node.getaddressbalance({'addresses': [confirmed_address]})
+        assert_equal(ret['balance'], 0)
+        assert_equal(ret['txcount'], 0)
+        node.reconsiderblock(tip)
         ret = node.getaddressbalance({'addresses': [confirmed_address]})
         assert_equal(ret['balance'], 10000000000)
+        assert_equal(ret['txcount'], 10)
 
         ret = node.getaddressutxos({'addresses': [confirmed_address]})
 
@@ -101,6 +137,13 @@ class QtumBitcoreTest(BitcoinTestFramework):
         assert_equal(ret, {"txid": expected_address_txids[0], "index": 0, "height": 1002})
         self.sync_all()
 
+        # enabling the index on a node that has the chain already builds it in the background
+        self.restart_node(1, ['-addrindex=1'])
+        expected_balance = node.getaddressbalance({'addresses': [confirmed_address]})
+        wait_until(lambda: self.nodes[1].getaddressbalance({'addresses': [confirmed_address]}) == expected_balance)
+        assert_equal(set(self.nodes[1].getaddresstxids({'addresses': [confirmed_address]})), set(expected_address_txids))
+        assert_equal(self.nodes[1].getspentinfo({"txid": spent_prevout['txid'], "index": spent_prevout['vout']}), ret)
+
 
 if __name__ == '__main__':
     QtumBitcoreTest().main()
\ No newline at end of file
@@ -7,13 +7,16 @@ from test_framework.test_framework import BitcoinTestFramework
 from test_framework.util import *
 from test_framework.script import *
 from test_framework.mininode import *
+import http.client
+import json
 import sys
+import urllib.parse
 
 class QtumRPCSearchlogsTest(BitcoinTestFramework):
     def set_test_params(self):
         self.setup_clean_chain = True
         self.num_nodes = 1
-        self.extra_args = [["-logevents"]]
+        self.extra_args = [["-logevents", "-rest"]]
 
     def skip_test_if_missing_module(self):
         self.skip_if_no_wallet()
@@ -82,6 +85,52 @@ class QtumRPCSearchlogsTest(BitcoinTestFramework):
 
         assert_equal(self.nodes[0].searchlogs(604,604,addresses,topics),[])
 
+        # pages of one receipt walk the whole range
+        pages = []
+        page = self.nodes[0].searchlogs(600,604,None,None,0,1)
+        while True:
+            assert(len(page['receipts']) <= 1)
+            pages.extend(page['receipts'])
+            if page['cursor'] is None:
+                break
+            page = self.nodes[0].searchlogs(600,604,None,None,0,1,page['cursor'])
+        assert_equal(len(pages), 2)
+        assert_equal(pages, self.nodes[0].searchlogs(600,604))
+        assert_raises_rpc_error(-32602, "Invalid cursor", self.nodes[0].searchlogs, 600, 604, None, None, 0, 1, "zz")
+
+        # the REST endpoints serve the same receipts
+        url = urllib.parse.urlparse(self.nodes[0].url)
+        def rest_get(uri, status=200):
+            conn = http.client.HTTPConnection(url.hostname, url.port)
+            conn.request('GET', '/rest' + uri)
+            resp = conn.getresponse()
+            assert_equal(resp.status, status)
+            return resp.read()
+        txid = pages[0]['transactionHash']
+        assert_equal(json.loads(rest_get('/receipt/%s.json' % txid).decode('utf-8')), self.nodes[0].gettransactionreceipt(txid))
+        assert_equal(rest_get('/receipt/%s.hex' % txid).decode('utf-8').strip(), rest_get('/receipt/%s.bin' % txid).hex())
+        rest_get('/receipt/%s.bin' % ("00" * 32), 404)
+        assert_equal(json.loads(rest_get('/logs/600/604.json').decode('utf-8')), pages)
+        assert(rest_get('/logs/600/604.bin').startswith(bytes.fromhex(txid)[::-1]))
+        rest_get('/logs/604/600.json', 400)
+
+        # and the contract state of the tip
+        info = json.loads(rest_get('/contract/%s/info.json' % contract_address).decode('utf-8'))
+        assert_equal(info['code'], self.nodes[0].getcontractcode(contract_address))
+        assert_equal(info['blockhash'], self.nodes[0].getbestblockhash())
+        slot = "00" * 32
+        stored = [list(entry.items())[0] for entry in self.nodes[0].getstorage(contract_address).values()]
+        storage = json.loads(rest_get('/contract/%s/storage/%s.json' % (contract_address, slot)).decode('utf-8'))
+        assert_equal(storage['value'], dict(stored)[slot])
+        assert_equal(rest_get('/contract/%s/storage/%s.bin' % (contract_address, slot)).hex(), storage['value'])
+        rest_get('/contract/%s/info.json' % ("00" * 20), 404)
+        rest_get('/contract/%s/storage/00.json' % contract_address, 400)
+        data = "94e8767d" + "00" * 31 + "07"
+        call = json.loads(rest_get('/call/%s/%s.json' % (contract_address, data)).decode('utf-8'))
+        assert_equal(call['executionResult'], self.nodes[0].callcontract(contract_address, data)['executionResult'])
+        assert_equal(rest_get('/call/%s/%s.bin' % (contract_address, data)).hex(), call['executionResult']['output'])
+        rest_get('/call/%s/0.json' % contract_address, 400)
+
 
 if __name__ == '__main__':
     QtumRPCSearchlogsTest().main()
@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test gettokenbalances and gettokentransfers with -tokenindex.
+
+A minimal token emits a Transfer event for every call and mints to its
+creator. The balances and transfers of the holders follow the events, are
+taken back when their block is disconnected and are the same when the index
+is built on an existing chain.
+"""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+    connect_nodes_bi,
+)
+from test_framework.qtumconfig import COINBASE_MATURITY, QTUM_MIN_GAS_PRICE_STR
+
+TRANSFER_TOPIC = "ddf252ad1be2c89b69c2b068fc378daa952ba7f163c4a11628f55a4df523b3ef"
+# Emits Transfer(0, creator, 1000) when created and Transfer(caller, to, value) when called with (to, value),
+# there are no balances in the contract, the index only follows the events
+TOKEN_CONTRACT = ("6103e86000523360007f" + TRANSFER_TOPIC + "60206000a3603180603a6000396000f3"
+                  "602035600052600035337f" + TRANSFER_TOPIC + "60206000a300")
+ZERO = "00" * 20
+
+def word(value):
+    return "%064x" % value
+
+def balance(token, received, sent, transfers):
+    return {"token": token, "balance": str(received - sent), "received": str(received), "sent": str(sent), "transfers": transfers}
+
+class QtumTokenIndexTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [["-logevents", "-tokenindex"], ["-logevents"]]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def transfer(self, sender, to, value):
+        data = "00" * 12 + self.hex[to] + word(value)
+        txid = self.nodes[0].sendtocontract(self.token, data, 0, 100000, QTUM_MIN_GAS_PRICE_STR, self.addresses[sender])['txid']
+        block_hash = self.nodes[0].generate(1)[0]
+        self.sync_all()
+        return txid, block_hash
+
+    def check_balances(self, node, expected):
+        for holder, entry in expected.items():
+            assert_equal(node.gettokenbalances(self.hex[holder]), [entry])
+            assert_equal(node.gettokenbalances(self.addresses[holder], self.token), [entry])
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+        self.sync_all()
+
+        self.addresses = [node.getnewaddress(), node.getnewaddress()]
+        self.hex = [node.gethexaddress(address) for address in self.addresses]
+        for address in self.addresses:
+            node.sendtoaddress(address, 100)
+        node.generate(1)
+        self.sync_all()
+
+        result = node.createcontract(TOKEN_CONTRACT, 200000, QTUM_MIN_GAS_PRICE_STR, self.addresses[0])
+        self.token = result['address']
+        mint_height = node.getblockcount() + 1
+        node.generate(1)
+        self.sync_all()
+
+        self.transfer(0, 1, 300)
+        self.transfer(1, 0, 50)
+        self_txid, self_hash = self.transfer(1, 1, 20)
+        self_height = node.getblockcount()
+
+        self.log.info("Balances follow the Transfer events")
+        expected = {
+            0: balance(self.token, 1050, 300, 3),
+            1: balance(self.token, 320, 70, 4),
+        }
+        self.check_balances(node, expected)
+        assert_equal(node.gettokenbalances(ZERO), [balance(self.token, 0, 1000, 1)])
+        assert_equal(node.gettokenbalances(self.hex[0], "11" * 20), [])
+
+        self.log.info("Transfers are listed in chain order, a transfer to self once")
+        transfers = node.gettokentransfers(self.token, self.hex[1])
+        assert_equal([t['direction'] for t in transfers], ["in", "out", "self"])
+        assert_equal([t['value'] for t in transfers], ["300", "50", "20"])
+        assert_equal(transfers[0]['from'], self.hex[0])
+        assert_equal(transfers[0]['to'], self.hex[1])
+        assert_equal(transfers[2]['transactionHash'], self_txid)
+        assert_equal(transfers[2]['blockNumber'], self_height)
+        assert_equal(transfers[2]['transactionIndex'], 1)
+        assert_equal(transfers[2]['logIndex'], 0)
+        transfers = node.gettokentransfers(self.token, self.addresses[0])
+        assert_equal([(t['direction'], t['blockNumber']) for t in transfers][0], ("in", mint_height))
+        assert_equal(transfers[0]['from'], ZERO)
+        assert_equal(node.gettokentransfers(self.token, self.hex[1], 0, -1, 2), node.gettokentransfers(self.token, self.hex[1])[:2])
+        assert_equal(node.gettokentransfers(self.token, self.hex[1], self_height), node.gettokentransfers(self.token, self.hex[1])[2:])
+        assert_equal(node.gettokentransfers(self.token, self.hex[1], 0, self_height - 1), node.gettokentransfers(self.token, self.hex[1])[:2])
+
+        self.log.info("A disconnected block takes its transfers back")
+        for n in self.nodes:
+            n.invalidateblock(self_hash)
+        self.check_balances(node, {
+            0: balance(self.token, 1050, 300, 3),
+            1: balance(self.token, 300, 50, 2),
+        })
+        assert_equal(len(node.gettokentransfers(self.token, self.hex[1])), 2)
+        new_hash = node.generate(1)[0]
+        assert new_hash != self_hash
+        self.sync_all()
+        self.check_balances(node, expected)
+        assert_equal(node.gettokentransfers(self.token, self.hex[1])[2]['transactionHash'], self_txid)
+
+        self.log.info("An index built on an existing chain has the same balances")
+        self.restart_node(1, ["-logevents", "-tokenindex"])
+        connect_nodes_bi(self.nodes, 0, 1)
+        self.check_balances(self.nodes[1], expected)
+        for holder in [0, 1]:
+            assert_equal(self.nodes[1].gettokentransfers(self.token, self.hex[holder]), node.gettokentransfers(self.token, self.hex[holder]))
+
+        self.log.info("Error paths")
+        assert_raises_rpc_error(-5, "Invalid holder address", node.gettokenbalances, "00")
+        assert_raises_rpc_error(-5, "Invalid token contract address", node.gettokenbalances, self.hex[0], "00")
+        assert_raises_rpc_error(-5, "Invalid token contract address", node.gettokentransfers, self.addresses[0], self.hex[0])
+        assert_raises_rpc_error(-8, "Incorrect params", node.gettokentransfers, self.token, self.hex[0], 10, 5)
+        assert_raises_rpc_error(-8, "Incorrect params", node.gettokentransfers, self.token, self.hex[0], -1)
+        assert_raises_rpc_error(-8, "Incorrect params", node.gettokentransfers, self.token, self.hex[0], 0, -1, -1)
+        self.restart_node(1, ["-logevents"])
+        assert_raises_rpc_error(-1, "Token index not enabled", self.nodes[1].gettokenbalances, self.hex[0])
+        assert_raises_rpc_error(-1, "Token index not enabled", self.nodes[1].gettokentransfers, self.token, self.hex[0])
+        self.stop_node(1)
+        self.nodes[1].assert_start_raises_init_error(["-tokenindex"], "Error: -tokenindex requires -logevents.")
+
+if __name__ == '__main__':
+    QtumTokenIndexTest().main()
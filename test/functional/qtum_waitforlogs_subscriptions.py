@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test waitforlogs calls parked in the subscription registry.
+
+More calls wait than there are RPC threads, the node keeps answering other
+calls, the waiters return when a block with logs arrives, and a waiter
+only sees logs of the active chain after a reorg.
+"""
+
+import threading
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+    connect_nodes_bi,
+    disconnect_nodes,
+    get_rpc_proxy,
+    wait_until,
+)
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+# Emits a LOG2 with the two words it is called with as its topics
+LOG_CONTRACT = "600c80600b6000396000f3" "60203560003560006000a200"
+RPC_THREADS = 2
+
+def word(value):
+    return "%064x" % value
+
+class WaitForLogsThread(threading.Thread):
+    def __init__(self, node, *args):
+        threading.Thread.__init__(self)
+        self.args = args
+        self.result = None
+        self.error = None
+        # a connection of its own, one connection can't be used from two threads
+        self.node = get_rpc_proxy(node.url, 0, timeout=600, coveragedir=node.coverage_dir)
+
+    def run(self):
+        try:
+            self.result = self.node.waitforlogs(*self.args)
+        except Exception as e:
+            self.error = e
+
+class QtumWaitForLogsSubscriptionsTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [["-logevents", "-rpcthreads=%d" % RPC_THREADS], []]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def start_waiters(self, count, *args):
+        waiters = [WaitForLogsThread(self.nodes[0], *args) for _ in range(count)]
+        for waiter in waiters:
+            waiter.start()
+        return waiters
+
+    def assert_waiting(self, waiters):
+        for waiter in waiters:
+            waiter.join(1)
+            assert waiter.is_alive()
+
+    def join(self, waiters):
+        for waiter in waiters:
+            waiter.join(30)
+            assert not waiter.is_alive()
+            assert waiter.error is None
+        return [waiter.result for waiter in waiters]
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+        self.sync_all()
+
+        contracts = [node.createcontract(LOG_CONTRACT)['address'], node.createcontract(LOG_CONTRACT)['address']]
+        node.generate(1)
+        self.sync_all()
+        start = node.getblockcount() + 1
+
+        self.log.info("More calls wait than there are RPC threads and the node still answers")
+        waiters_x = self.start_waiters(RPC_THREADS + 1, start, None, {"addresses": [contracts[0]]}, 0)
+        waiters_y = self.start_waiters(RPC_THREADS + 1, start, None, {"addresses": [contracts[1]]}, 0)
+        self.assert_waiting(waiters_x + waiters_y)
+        assert_equal(node.getblockcount(), start - 1)
+        node.generate(1)
+        self.sync_all()
+        self.assert_waiting(waiters_x + waiters_y)
+
+        self.log.info("Waiters with the same filter share the result, the others advance past the block")
+        txid = node.sendtocontract(contracts[0], word(0xa) + word(0xb))['txid']
+        block_hash = node.generate(1)[0]
+        self.sync_all()
+        results = self.join(waiters_x)
+        for result in results:
+            assert_equal(result, results[0])
+        assert_equal(results[0]['count'], 1)
+        assert_equal(results[0]['nextblock'], start + 2)
+        entry = results[0]['entries'][0]
+        assert_equal(entry['blockHash'], block_hash)
+        assert_equal(entry['blockNumber'], start + 1)
+        assert_equal(entry['transactionHash'], txid)
+        assert_equal(entry['contractAddress'], contracts[0])
+        assert_equal(entry['topics'], [word(0xa), word(0xb)])
+        for result in self.join(waiters_y):
+            assert_equal(result, {"entries": [], "count": 0, "nextblock": start + 2})
+
+        waiters_y = self.start_waiters(RPC_THREADS + 1, start + 2, None, {"addresses": [contracts[1]]}, 0)
+        self.assert_waiting(waiters_y)
+        node.sendtocontract(contracts[1], word(0xc) + word(0xd))
+        node.generate(1)
+        self.sync_all()
+        results = self.join(waiters_y)
+        assert_equal(results[0]['entries'][0]['topics'], [word(0xc), word(0xd)])
+        assert_equal(results[0]['nextblock'], start + 3)
+
+        self.log.info("Topic filters apply to the entries of a parked call")
+        waiters = self.start_waiters(1, start + 3, None, {"addresses": [contracts[0]], "topics": [None, word(0xe)]}, 0)
+        self.assert_waiting(waiters)
+        node.sendtocontract(contracts[0], word(0xa) + word(0xb))
+        node.sendtocontract(contracts[0], word(0xa) + word(0xe))
+        node.generate(1)
+        self.sync_all()
+        result = self.join(waiters)[0]
+        assert_equal(result['count'], 1)
+        assert_equal(result['entries'][0]['topics'], [word(0xa), word(0xe)])
+
+        self.log.info("A waiter only sees logs of the active chain after a reorg")
+        height = node.getblockcount()
+        # with one confirmation required the log of the block that is reorganized away is never returned
+        waiters = self.start_waiters(1, height + 1, None, {"addresses": [contracts[0]]}, 1)
+        disconnect_nodes(node, 1)
+        self.nodes[1].generate(2)
+        txid = node.sendtocontract(contracts[0], word(0xf) + word(0xf))['txid']
+        orphaned = node.generate(1)[0]
+        self.assert_waiting(waiters)
+        connect_nodes_bi(self.nodes, 0, 1)
+        self.sync_blocks()
+        assert_equal(node.getblockcount(), height + 2)
+        wait_until(lambda: txid in node.getrawmempool(), timeout=30)
+        self.assert_waiting(waiters)
+        node.generate(2)
+        result = self.join(waiters)[0]
+        assert_equal(result['count'], 1)
+        assert_equal(result['entries'][0]['transactionHash'], txid)
+        assert_equal(result['entries'][0]['blockNumber'], height + 3)
+        assert result['entries'][0]['blockHash'] != orphaned
+
+        self.log.info("Parked calls end when the node stops")
+        waiters = self.start_waiters(RPC_THREADS + 1, node.getblockcount() + 1, None, {"addresses": [contracts[1]]}, 0)
+        self.assert_waiting(waiters)
+        self.restart_node(0)
+        for waiter in waiters:
+            waiter.join(30)
+            assert not waiter.is_alive()
+            assert waiter.result is None
+
+        self.log.info("Error paths")
+        node = self.nodes[0]
+        assert_raises_rpc_error(-8, "Incorrect params", node.waitforlogs, 200, 100)
+        assert_raises_rpc_error(-8, "Incorrect params", node.waitforlogs, 0, 0)
+        assert_raises_rpc_error(-32602, "Invalid hex 160 string", node.waitforlogs, None, None, {"addresses": ["00"]})
+        assert_raises_rpc_error(-32602, "Invalid hex 256 string", node.waitforlogs, None, None, {"topics": ["00"]})
+        assert_raises_rpc_error(-32603, "Events indexing disabled", self.nodes[1].waitforlogs)
+
+if __name__ == '__main__':
+    QtumWaitForLogsSubscriptionsTest().main()
@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021 The Metrix Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the RPC response cache of -rpccachesize.
+
+Results of calls on confirmed blocks are answered from the cache, with
+their confirmations kept current, until the block is reorganized away.
+"""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+
+
+class RPCCacheTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+        self.setup_clean_chain = True
+        self.extra_args = [["-rpccachesize=1", "-rpccachedepth=2"]]
+
+    def cache_hits(self):
+        return self.nodes[0].getrpcinfo()['cache']['hits']
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(5)
+        block_hash = node.getblockhash(2)
+
+        self.log.info("Repeated calls are answered from the cache")
+        hits = self.cache_hits()
+        block = node.getblock(block_hash)
+        assert_equal(node.getblock(block_hash), block)
+        assert_equal(self.cache_hits(), hits + 1)
+        header = node.getblockheader(block_hash, False)
+        assert_equal(node.getblockheader(block_hash, False), header)
+        assert_equal(self.cache_hits(), hits + 2)
+
+        self.log.info("Cached results keep their confirmations current")
+        node.generate(1)
+        cached = node.getblock(block_hash)
+        assert_equal(self.cache_hits(), hits + 3)
+        assert_equal(cached['confirmations'], block['confirmations'] + 1)
+        del cached['confirmations']
+        del block['confirmations']
+        assert_equal(cached, block)
+
+        self.log.info("Blocks near the tip are not cached")
+        tip = node.getbestblockhash()
+        node.getblock(tip)
+        node.getblock(tip)
+        assert_equal(self.cache_hits(), hits + 3)
+
+        self.log.info("A reorg of the next block drops the result")
+        next_hash = node.getblockhash(3)
+        node.invalidateblock(next_hash)
+        assert 'nextblockhash' not in node.getblock(block_hash)
+        assert_equal(self.cache_hits(), hits + 3)
+        node.reconsiderblock(next_hash)
+        assert_equal(node.getblock(block_hash)['nextblockhash'], next_hash)
+
+
+if __name__ == '__main__':
+    RPCCacheTest().main()
@@ -0,0 +1,43 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the generation of UTXO snapshots using `dumptxoutset`.
+"""
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_raises_rpc_error
+
+import os
+
+
+class DumptxoutsetTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def run_test(self):
+        """Test a trivial usage of the dumptxoutset RPC command."""
+        node = self.nodes[0]
+        node.generatetoaddress(100, node.get_deterministic_priv_key().address)
+
+        FILENAME = 'txoutset.dat'
+        out = node.dumptxoutset(FILENAME)
+        expected_path = os.path.join(node.datadir, self.chain, FILENAME)
+
+        tip = node.getblock(node.getbestblockhash())
+        assert_equal(out['coins_written'], node.gettxoutsetinfo()['txouts'])
+        assert_equal(out['base_height'], 100)
+        assert_equal(out['base_hash'], tip['hash'])
+        assert_equal(out['hash_state_root'], tip['hashStateRoot'])
+        assert_equal(out['hash_utxo_root'], tip['hashUTXORoot'])
+        assert_equal(out['hash_serialized_2'], node.gettxoutsetinfo()['hash_serialized_2'])
+        assert_equal(out['path'], expected_path)
+        assert os.path.exists(expected_path)
+        assert not os.path.exists(expected_path + '.incomplete')
+
+        # Specifying a path to an existing file will fail.
+        assert_raises_rpc_error(
+            -8, '{} already exists'.format(FILENAME),  node.dumptxoutset, FILENAME)
+
+if __name__ == '__main__':
+    DumptxoutsetTest().main()
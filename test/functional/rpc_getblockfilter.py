@@ -55,5 +55,8 @@ class GetBlockFilterTest(BitcoinTestFramework):
         genesis_hash = self.nodes[0].getblockhash(0)
         assert_raises_rpc_error(-5, "Unknown filtertype", self.nodes[0].getblockfilter, genesis_hash, "unknown")
 
+        # Test getblockfilter with the EVM log filters, which are not indexed without -logevents
+        assert_raises_rpc_error(-1, "Index is not enabled for filtertype evmlog", self.nodes[0].getblockfilter, genesis_hash, "evmlog")
+
 if __name__ == '__main__':
     GetBlockFilterTest().main()
@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the getrawtransactions RPC.
+
+Looks up transactions of the mempool and of the txindex in one batch, checks
+them against getrawtransaction, and checks they follow the active chain when
+the block they are in is disconnected and connected again.
+"""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+)
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+MAX_RAW_TRANSACTIONS_BATCH = 1000
+
+class GetRawTransactionsTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [["-txindex"]]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+        address = node.getnewaddress()
+
+        confirmed = [node.sendtoaddress(address, 1), node.sendtoaddress(address, 2)]
+        block_hash = node.generate(1)[0]
+        unconfirmed = node.sendtoaddress(address, 3)
+        unknown = "00" * 32
+
+        self.log.info("Hex results match getrawtransaction, unknown txids are null")
+        txids = confirmed + [unknown, unconfirmed]
+        result = node.getrawtransactions(txids)
+        assert_equal(len(result), len(txids))
+        assert_equal(result[0], node.getrawtransaction(confirmed[0]))
+        assert_equal(result[1], node.getrawtransaction(confirmed[1]))
+        assert_equal(result[2], None)
+        assert_equal(result[3], node.getrawtransaction(unconfirmed))
+        assert_equal(node.getrawtransactions([]), [])
+
+        self.log.info("Verbose results match getrawtransaction")
+        for verbose in [True, 1]:
+            result = node.getrawtransactions(txids, verbose)
+            assert_equal(result[0], node.getrawtransaction(confirmed[0], True))
+            assert_equal(result[0]['blockhash'], block_hash)
+            assert_equal(result[0]['confirmations'], 1)
+            assert_equal(result[1]['txid'], confirmed[1])
+            assert_equal(result[2], None)
+            assert_equal(result[3]['txid'], unconfirmed)
+            assert 'blockhash' not in result[3]
+        assert_equal(node.getrawtransactions(txids, 0), node.getrawtransactions(txids))
+
+        self.log.info("A txid that is given twice is returned twice")
+        assert_equal(node.getrawtransactions([confirmed[0], confirmed[0]]), [node.getrawtransaction(confirmed[0])] * 2)
+
+        self.log.info("Coinbase transactions are found through the txindex")
+        coinbase = node.getblock(block_hash)['tx'][0]
+        assert_equal(node.getrawtransactions([coinbase], True)[0]['blockhash'], block_hash)
+
+        self.log.info("Transactions follow the active chain when their block is disconnected")
+        node.invalidateblock(block_hash)
+        result = node.getrawtransactions(confirmed, True)
+        for i, tx in enumerate(result):
+            assert_equal(tx['txid'], confirmed[i])
+            assert 'blockhash' not in tx
+        # the txindex keeps the coinbase of the disconnected block, which is no longer confirmed
+        result = node.getrawtransactions([coinbase], True)
+        assert_equal(result[0]['blockhash'], block_hash)
+        assert_equal(result[0]['confirmations'], 0)
+        node.reconsiderblock(block_hash)
+        assert_equal(node.getbestblockhash(), block_hash)
+        result = node.getrawtransactions(confirmed + [coinbase], True)
+        for tx in result:
+            assert_equal(tx['blockhash'], block_hash)
+            assert_equal(tx['confirmations'], 1)
+
+        self.log.info("Error paths")
+        assert_raises_rpc_error(-8, "txid must be of length 64", node.getrawtransactions, ["abcd"])
+        assert_raises_rpc_error(-8, "txid must be hexadecimal string", node.getrawtransactions, ["ZZ" * 32])
+        assert_raises_rpc_error(-1, "JSON value is not an array as expected", node.getrawtransactions, confirmed[0])
+        assert_raises_rpc_error(-8, "At most %d transactions can be looked up at once" % MAX_RAW_TRANSACTIONS_BATCH,
+                                node.getrawtransactions, [unknown] * (MAX_RAW_TRANSACTIONS_BATCH + 1))
+        assert_equal(node.getrawtransactions([unknown] * MAX_RAW_TRANSACTIONS_BATCH), [None] * MAX_RAW_TRANSACTIONS_BATCH)
+
+if __name__ == '__main__':
+    GetRawTransactionsTest().main()
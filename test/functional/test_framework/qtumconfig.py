@@ -1,10 +1,10 @@
-COINBASE_MATURITY = 500
+COINBASE_MATURITY = 960
 INITIAL_BLOCK_REWARD = 20000
 INITIAL_HASH_UTXO_ROOT = 0x21b463e3b52f6201c0ad6c991be0485b6ef8c092e64583ffa655cc1b171fe856
 INITIAL_HASH_STATE_ROOT = 0x9514771014c9ae803d8cea2731b2063e83de44802b40dce2d06acd02d0ff65e9
 MAX_BLOCK_BASE_SIZE = 2000000
-QTUM_MIN_GAS_PRICE = 40
-QTUM_MIN_GAS_PRICE_STR = "0.00000040"
+QTUM_MIN_GAS_PRICE = 5000
+QTUM_MIN_GAS_PRICE_STR = "0.00005000"
 NUM_DEFAULT_DGP_CONTRACTS = 5
 MPOS_PARTICIPANTS = 10
 LAST_POW_BLOCK = 5000
@@ -107,8 +107,10 @@ BASE_SCRIPTS = [
     'wallet_listreceivedby.py',
     'wallet_abandonconflict.py',
     'rpc_rawtransaction.py',
+    'rpc_getrawtransactions.py',
     'wallet_address_types.py',
     'p2p_feefilter.py',
+    'p2p_blockfilters.py',
     'feature_reindex.py',
     'feature_abortnode.py',
     # vv Tests less than 30s vv
@@ -163,6 +165,7 @@ BASE_SCRIPTS = [
     'feature_notifications.py',
     'rpc_getblockfilter.py',
     'rpc_invalidateblock.py',
+    'rpc_cache.py',
     'feature_rbf.py',
     'mempool_packages.py',
     'mempool_package_onemore.py',
@@ -202,6 +205,7 @@ BASE_SCRIPTS = [
     'rpc_deriveaddresses.py',
     'rpc_deriveaddresses.py --usecli',
     'rpc_scantxoutset.py',
+    'rpc_dumptxoutset.py',
     'feature_logging.py',
     'p2p_node_network_limited.py',
     'p2p_permissions.py',
@@ -269,7 +273,18 @@ BASE_SCRIPTS = [
     'qtum_evm_staticcall.py',
     'qtum_evm_constantinople_precompiles.py',
     'qtum_evm_constantinople_opcodes.py',
-    'qtum_block_index_cleanup.py'
+    'qtum_block_index_cleanup.py',
+    'qtum_callcontractbatch.py',
+    'qtum_logindex.py',
+    'qtum_waitforlogs_subscriptions.py',
+    'qtum_receiptindex.py',
+    'qtum_receiptpruning.py',
+    'qtum_tokenindex.py',
+    'qtum_contractindex.py',
+    'qtum_getblock_receipts.py',
+    'qtum_getstorageslots.py',
+    'qtum_estimategas.py',
+    'qtum_governanceindex.py',
 ]
 
 # Place EXTENDED_SCRIPTS first since it has the 3 longest running tests
@@ -279,6 +294,7 @@ NON_SCRIPTS = [
     # These are python files that live in the functional tests directory, but are not test scripts.
     "combine_logs.py",
     "create_cache.py",
+    "loadgen.py",
     "test_runner.py",
 ]
 